@@ -0,0 +1,384 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiomixer.h"
+
+#include <cmath>
+#include <limits>
+
+#include "common/threadpolicy.h"
+#include "decoder/decoderpool.h"
+#include "mixkernels.h"
+
+AudioMixer::Clip::Clip() :
+  stream(nullptr),
+  gain(1.0f),
+  pan(0.0f)
+{
+}
+
+AudioMixer::AudioMixer(AudioRingBuffer *buffer) :
+  buffer_(buffer),
+  sample_rate_(48000),
+  channels_(2),
+  period_(480),
+  start_sample_(0),
+  running_(0),
+  scrubbing_(false),
+  scrub_sample_(0),
+  scrub_serial_(0)
+{
+}
+
+AudioMixer::~AudioMixer()
+{
+  StopMixing();
+}
+
+void AudioMixer::SetFormat(int sample_rate, int channels, int period)
+{
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  period_ = qMax(1, period);
+}
+
+void AudioMixer::AddClip(const AudioMixer::Clip &clip)
+{
+  clips_.append(clip);
+}
+
+void AudioMixer::AddStream(AudioStream *stream)
+{
+  Clip clip;
+  clip.stream = stream;
+  AddClip(clip);
+}
+
+void AudioMixer::ClearClips()
+{
+  clips_.clear();
+}
+
+const QList<AudioMixer::Clip> &AudioMixer::clips() const
+{
+  return clips_;
+}
+
+void AudioMixer::StartMixing(const rational &time)
+{
+  StopMixing();
+
+  start_sample_ = static_cast<int64_t>(time.ToDouble() * sample_rate_);
+
+  scrubbing_ = false;
+  running_ = 1;
+
+  start(QThread::TimeCriticalPriority);
+}
+
+void AudioMixer::StartScrubbing()
+{
+  StopMixing();
+
+  // Clips can be anywhere relative to the playhead, so none are skipped up front
+  start_sample_ = 0;
+
+  scrubbing_ = true;
+  scrub_serial_ = 0;
+  running_ = 1;
+
+  start(QThread::TimeCriticalPriority);
+}
+
+void AudioMixer::Scrub(const rational &time)
+{
+  scrub_sample_.store(static_cast<qint64>(time.ToDouble() * sample_rate_));
+
+  // Released after the sample so the thread never sees the new serial with the old position
+  scrub_serial_.fetchAndAddRelease(1);
+}
+
+bool AudioMixer::IsScrubbing()
+{
+  return isRunning() && scrubbing_;
+}
+
+void AudioMixer::StopMixing()
+{
+  running_ = 0;
+
+  wait();
+
+  scrubbing_ = false;
+}
+
+void AudioMixer::run()
+{
+  ThreadPolicy::Apply(ThreadPolicy::kRoleAudio);
+
+  // Everything mixing needs is allocated up front
+  QVector<ActiveClip> clips;
+  clips.reserve(clips_.size());
+
+  foreach (const Clip& c, clips_) {
+    ActiveClip active;
+
+    active.stream = c.stream;
+    active.start = static_cast<int64_t>(c.start.ToDouble() * sample_rate_);
+    active.media_start = static_cast<int64_t>(c.media_start.ToDouble() * sample_rate_);
+    active.gains = ChannelGains(c);
+
+    if (c.length > rational(0)) {
+      active.end = active.start + static_cast<int64_t>(c.length.ToDouble() * sample_rate_);
+    } else if (c.stream->duration() > 0 && c.stream->timebase() > rational(0)) {
+      rational stream_length = rational(c.stream->duration()) * c.stream->timebase();
+      active.end = active.start + static_cast<int64_t>(stream_length.ToDouble() * sample_rate_) - active.media_start;
+    } else {
+      active.end = std::numeric_limits<int64_t>::max();
+    }
+
+    if (active.end <= start_sample_) {
+      continue;
+    }
+
+    if (ConformCache::NeedsConform(c.stream, sample_rate_, channels_)) {
+      active.conformed = std::make_shared<ConformCache>();
+
+      if (!active.conformed->Open(c.stream, sample_rate_, channels_)) {
+        active.conformed = nullptr;
+      }
+    }
+
+    clips.append(active);
+  }
+
+  QVector<float> bus_data(period_ * channels_);
+
+  QVector<float*> bus(channels_);
+
+  for (int i=0;i<channels_;i++) {
+    bus[i] = bus_data.data() + i * period_;
+  }
+
+  QVector<float> block(period_ * channels_);
+
+  int64_t position = start_sample_;
+
+  QVector<float> grain_window;
+  int grain_done = 0;
+  int handled_scrub = 0;
+
+  if (scrubbing_) {
+    grain_window = ScrubWindow();
+
+    // Nothing to play until the first Scrub()
+    grain_done = grain_window.size();
+  }
+
+  while (running_.load() != 0) {
+    int frames = period_;
+
+    if (scrubbing_) {
+      int serial = scrub_serial_.loadAcquire();
+
+      if (serial != handled_scrub) {
+        // The playhead has moved on, so the rest of the last grain is stale whether it's been mixed yet or not
+        handled_scrub = serial;
+        buffer_->Discard();
+
+        position = qMax(int64_t(0), static_cast<int64_t>(scrub_sample_.load()) - grain_window.size() / 2);
+        grain_done = 0;
+      } else if (grain_done == grain_window.size()) {
+        usleep(kIdleInterval);
+        continue;
+      }
+
+      frames = qMin(period_, grain_window.size() - grain_done);
+
+    } else if (!buffer_->NeedsSamples()) {
+      // Only mix ahead as far as the ring buffer's adaptive target, so latency stays low while playback is smooth
+      usleep(kIdleInterval);
+      continue;
+    }
+
+    if (buffer_->free_space() < frames * channels_) {
+      usleep(kIdleInterval);
+      continue;
+    }
+
+    bus_data.fill(0.0f);
+
+    for (int i=0;i<clips.size();i++) {
+      ActiveClip& c = clips[i];
+
+      if (c.end <= position) {
+
+        // The clip has ended, its decoder can go back to the pool (unless scrubbing, which can go back to it)
+        if (c.decoder != nullptr && !scrubbing_) {
+          olive::decoder_pool.Release(c.decoder, rational(c.media_start + c.end - c.start, sample_rate_));
+          c.decoder = nullptr;
+        }
+
+      } else if (c.start < position + frames) {
+        MixClip(&c, position, frames, bus.constData());
+      }
+    }
+
+    if (scrubbing_) {
+      for (int i=0;i<channels_;i++) {
+        float* channel = bus[i];
+        const float* window = grain_window.constData() + grain_done;
+
+        for (int j=0;j<frames;j++) {
+          channel[j] *= window[j];
+        }
+      }
+
+      grain_done += frames;
+    }
+
+    olive::audio::InterleaveClamped(bus.constData(), channels_, block.data(), frames);
+
+    buffer_->Write(block.constData(), frames * channels_);
+
+    position += frames;
+  }
+
+  for (int i=0;i<clips.size();i++) {
+    if (clips.at(i).decoder != nullptr) {
+      olive::decoder_pool.Release(clips.at(i).decoder,
+                                  rational(clips.at(i).media_start + position - clips.at(i).start, sample_rate_));
+    }
+  }
+}
+
+QVector<float> AudioMixer::ChannelGains(const AudioMixer::Clip &clip) const
+{
+  QVector<float> gains(channels_, clip.gain);
+
+  if (channels_ == 2 && clip.pan != 0.0f) {
+    float pan = qBound(-1.0f, clip.pan, 1.0f);
+
+    if (clip.stream->channels() == 1) {
+      // Constant power, scaled so the centre is unity like an unpanned mono clip
+      const float kQuarterPi = 0.785398163f;
+      const float kSqrt2 = 1.414213562f;
+
+      float angle = (pan + 1.0f) * kQuarterPi;
+
+      gains[0] = clip.gain * kSqrt2 * std::cos(angle);
+      gains[1] = clip.gain * kSqrt2 * std::sin(angle);
+    } else {
+      gains[0] = clip.gain * qMin(1.0f, 1.0f - pan);
+      gains[1] = clip.gain * qMin(1.0f, 1.0f + pan);
+    }
+  }
+
+  return gains;
+}
+
+QVector<float> AudioMixer::ScrubWindow() const
+{
+  const float kPi = 3.14159265f;
+
+  int length = qMax(1, sample_rate_ * kScrubGrain / 1000);
+  int fade = qMin(length / 2, sample_rate_ * kScrubFade / 1000);
+
+  QVector<float> window(length, 1.0f);
+
+  for (int i=0;i<fade;i++) {
+    float gain = 0.5f - 0.5f * std::cos(kPi * static_cast<float>(i) / static_cast<float>(fade));
+
+    window[i] = gain;
+    window[length - 1 - i] = gain;
+  }
+
+  return window;
+}
+
+void AudioMixer::MixClip(AudioMixer::ActiveClip *clip, int64_t block_start, int block_frames, float * const *bus)
+{
+  // Part of the block the clip covers
+  int offset = static_cast<int>(qMax(int64_t(0), clip->start - block_start));
+  int64_t from = block_start + offset;
+  int frames = static_cast<int>(qMin(block_start + block_frames, clip->end) - from);
+
+  int64_t media_sample = clip->media_start + from - clip->start;
+
+  if (clip->conformed != nullptr) {
+    for (int i=0;i<channels_;i++) {
+      if (clip->gains.at(i) == 0.0f) {
+        continue;
+      }
+
+      // The cache can only be read up to the end of each of its blocks at a time
+      int done = 0;
+
+      while (done < frames) {
+        int count = frames - done;
+        const float* samples = clip->conformed->Samples(i, media_sample + done, &count);
+
+        if (samples == nullptr) {
+          break;
+        }
+
+        olive::audio::MixScaled(samples, bus[i] + offset + done, count, clip->gains.at(i));
+
+        done += count;
+      }
+    }
+
+    return;
+  }
+
+  rational media_time(media_sample, sample_rate_);
+
+  if (clip->decoder == nullptr) {
+    clip->decoder = olive::decoder_pool.Acquire(clip->stream, media_time);
+
+    if (clip->decoder == nullptr) {
+      // Don't try again every block
+      clip->end = block_start;
+      return;
+    }
+
+    clip->decoder->set_output_sample_rate(sample_rate_);
+  }
+
+  FramePtr frame = clip->decoder->Retrieve(media_time, rational(frames, sample_rate_));
+
+  if (frame == nullptr || frame->channels() <= 0) {
+    return;
+  }
+
+  // Decoders return planar float samples
+  const float* const* planes = reinterpret_cast<const float* const*>(frame->data());
+  int src_channels = frame->channels();
+  frames = qMin(frames, frame->sample_count());
+
+  for (int i=0;i<channels_;i++) {
+    // Mono is sent to every channel
+    int src = (src_channels == 1) ? 0 : i;
+
+    if (src < src_channels && clip->gains.at(i) != 0.0f) {
+      olive::audio::MixScaled(planes[src], bus[i] + offset, frames, clip->gains.at(i));
+    }
+  }
+}
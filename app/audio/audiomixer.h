@@ -0,0 +1,215 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QList>
+#include <QThread>
+#include <QVector>
+
+#include "audioringbuffer.h"
+#include "common/rational.h"
+#include "decoder/conformcache.h"
+#include "decoder/decoder.h"
+#include "project/item/footage/audiostream.h"
+
+/**
+ * @brief A thread that decodes and mixes audio clips into an AudioRingBuffer ahead of playback
+ *
+ * The mixer keeps the ring buffer filled to its target level (see AudioRingBuffer::target_fill()), so decoding
+ * hiccups are absorbed by the buffered audio rather than reaching the audio device. Audio is mixed in blocks of one
+ * device period (see SetFormat()): every clip active in the block has that part pulled from its Decoder and added to
+ * a planar bus with the clip's gain and pan, then the bus is interleaved into the ring buffer (see
+ * olive::audio::MixScaled() and olive::audio::InterleaveClamped()).
+ *
+ * The bus and block buffers are allocated before mixing starts, so mixing itself allocates nothing and never locks.
+ * Decoders are acquired when their clip becomes active and released once it ends, so long timelines don't hold a
+ * decoder for every clip. Streams with a ConformCache for the mixing format are read straight from it instead, without
+ * decoding or resampling (see ConformTask). The device pulls from the ring buffer without ever waiting on this thread.
+ *
+ * While the playhead is dragged the mixer runs in scrub mode instead (see StartScrubbing()): rather than mixing ahead
+ * continuously, it mixes one short grain around each position passed to Scrub(), faded in and out so grains don't
+ * click. A new position cuts off the grain being mixed and discards whatever of it hasn't been heard yet, so audio
+ * follows the mouse without lagging behind it. Grains come from the same conform caches and decoders as playback,
+ * which stay open for the whole scrub.
+ *
+ * Mono clips are panned with a constant power law (with unity gain in the centre), clips with more channels are
+ * balanced by attenuating the opposite side. Pan only applies to stereo output. With no clips, silence is written so
+ * the audio clock still runs.
+ */
+class AudioMixer : public QThread
+{
+public:
+  /**
+   * @brief A stream placed on the timeline
+   */
+  struct Clip {
+    Clip();
+
+    /// Stream to play, must stay valid until it's removed with ClearClips()
+    AudioStream* stream;
+
+    /// Timeline time the clip starts at
+    rational start;
+
+    /// Length of the clip, or 0 to play until the stream ends
+    rational length;
+
+    /// Time in the stream the clip starts from
+    rational media_start;
+
+    /// Linear gain
+    float gain;
+
+    /// -1.0 (left) to 1.0 (right)
+    float pan;
+  };
+
+  AudioMixer(AudioRingBuffer* buffer);
+
+  virtual ~AudioMixer() override;
+
+  /**
+   * @brief Set the format to mix to, only while stopped
+   *
+   * @param sample_rate
+   *
+   * Usually the Sequence's audio_sampling_rate().
+   *
+   * @param period
+   *
+   * Number of sample frames mixed at a time, usually the output device's buffer size.
+   */
+  void SetFormat(int sample_rate, int channels, int period);
+
+  /**
+   * @brief Add a clip to play, only while stopped
+   */
+  void AddClip(const Clip& clip);
+
+  /**
+   * @brief Add a stream to play from the start of the timeline at unity gain, only while stopped
+   */
+  void AddStream(AudioStream* stream);
+
+  void ClearClips();
+
+  const QList<Clip>& clips() const;
+
+  /**
+   * @brief Start mixing into the ring buffer from a certain time
+   */
+  void StartMixing(const rational& time);
+
+  /**
+   * @brief Start the thread in scrub mode, where it only mixes grains requested with Scrub()
+   */
+  void StartScrubbing();
+
+  /**
+   * @brief Mix a grain around a time, replacing any grain still being played (thread-safe)
+   */
+  void Scrub(const rational& time);
+
+  bool IsScrubbing();
+
+  /**
+   * @brief Stop mixing or scrubbing, waiting for the thread to finish
+   */
+  void StopMixing();
+
+protected:
+  virtual void run() override;
+
+private:
+  /**
+   * @brief How long the thread sleeps for when the ring buffer is full in microseconds
+   */
+  static const unsigned long kIdleInterval = 1000;
+
+  /**
+   * @brief Length of each scrub grain in milliseconds
+   */
+  static const int kScrubGrain = 80;
+
+  /**
+   * @brief Length of the fade at each end of a scrub grain in milliseconds
+   */
+  static const int kScrubFade = 10;
+
+  /**
+   * @brief A Clip converted to sample positions at the mixing sample rate, with the gain of each output channel
+   */
+  struct ActiveClip {
+    AudioStream* stream;
+
+    int64_t start;
+    int64_t end;
+    int64_t media_start;
+
+    QVector<float> gains;
+
+    DecoderPtr decoder;
+
+    // Set if the stream has been conformed to the mixing format, in which case no decoder is used
+    std::shared_ptr<ConformCache> conformed;
+  };
+
+  /**
+   * @brief Calculate the gain a clip is mixed into each output channel with
+   */
+  QVector<float> ChannelGains(const Clip& clip) const;
+
+  /**
+   * @brief Create the window scrub grains are multiplied by, a raised cosine fade at each end with a flat top
+   */
+  QVector<float> ScrubWindow() const;
+
+  /**
+   * @brief Mix the part of a clip that's in a block into the bus
+   */
+  void MixClip(ActiveClip* clip, int64_t block_start, int block_frames, float* const* bus);
+
+  AudioRingBuffer* buffer_;
+
+  int sample_rate_;
+
+  int channels_;
+
+  int period_;
+
+  QList<Clip> clips_;
+
+  int64_t start_sample_;
+
+  QAtomicInt running_;
+
+  bool scrubbing_;
+
+  // Sample the last Scrub() asked for, and how many times it's been called so the thread can tell a new request
+  QAtomicInteger<qint64> scrub_sample_;
+
+  QAtomicInt scrub_serial_;
+};
+
+#endif // AUDIOMIXER_H
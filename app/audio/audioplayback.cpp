@@ -0,0 +1,344 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioplayback.h"
+
+#include <QDebug>
+#include <cstring>
+
+#include "task/conform/conform.h"
+
+AudioRingDevice::AudioRingDevice(AudioRingBuffer *buffer) :
+  buffer_(buffer),
+  float_output_(true),
+  channels_(2)
+{
+}
+
+void AudioRingDevice::SetFormat(bool float_output, int channels)
+{
+  float_output_ = float_output;
+  channels_ = qMax(1, channels);
+}
+
+bool AudioRingDevice::isSequential() const
+{
+  return true;
+}
+
+qint64 AudioRingDevice::readData(char *data, qint64 maxlen)
+{
+  qint64 sample_size = float_output_ ? static_cast<qint64>(sizeof(float)) : static_cast<qint64>(sizeof(qint16));
+
+  // Only read whole sample frames so channels never shift if the mixer falls behind
+  int count = static_cast<int>(maxlen / sample_size);
+  count -= count % channels_;
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  float* samples;
+
+  if (float_output_) {
+    samples = reinterpret_cast<float*>(data);
+  } else {
+    conversion_buffer_.resize(count);
+    samples = conversion_buffer_.data();
+  }
+
+  int read = buffer_->Read(samples, count);
+
+  if (read < count) {
+    // Play silence rather than stalling the device
+    memset(samples + read, 0, static_cast<size_t>(count - read) * sizeof(float));
+  }
+
+  if (!float_output_) {
+    qint16* out = reinterpret_cast<qint16*>(data);
+
+    for (int i=0;i<count;i++) {
+      out[i] = static_cast<qint16>(qRound(samples[i] * 32767.0f));
+    }
+  }
+
+  return count * sample_size;
+}
+
+qint64 AudioRingDevice::writeData(const char *, qint64)
+{
+  return -1;
+}
+
+AudioPlayback::AudioPlayback(QObject *parent) :
+  QObject(parent),
+  mixer_(&buffer_),
+  device_(&buffer_),
+  output_(nullptr),
+  buffer_size_(20),
+  sample_rate_(48000),
+  channels_(2),
+  last_played_(0),
+  last_result_(0)
+{
+  scrub_timer_.setSingleShot(true);
+  scrub_timer_.setInterval(kScrubTimeout);
+  connect(&scrub_timer_, SIGNAL(timeout()), this, SLOT(ScrubTimeout()));
+}
+
+AudioPlayback::~AudioPlayback()
+{
+  Stop();
+}
+
+void AudioPlayback::SetBufferSize(int msecs)
+{
+  if (msecs < kMinimumBufferSize) {
+    buffer_size_ = kMinimumBufferSize;
+  } else {
+    buffer_size_ = msecs;
+  }
+}
+
+int AudioPlayback::buffer_size()
+{
+  return buffer_size_;
+}
+
+void AudioPlayback::SetFormat(int sample_rate, int channels)
+{
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+}
+
+AudioMixer *AudioPlayback::mixer()
+{
+  return &mixer_;
+}
+
+bool AudioPlayback::Start(const rational &time)
+{
+  Stop();
+
+  QAudioDeviceInfo info;
+
+  if (!OpenDevice(&info)) {
+    return false;
+  }
+
+  int samples_per_second = format_.sampleRate() * format_.channelCount();
+
+  // Start two device buffers ahead, the target grows if the mixer can't keep up with that
+  int device_buffer = samples_per_second * buffer_size_ / 1000;
+  buffer_.SetTargetRange(device_buffer * 2, samples_per_second * kRingBufferSize / 1000);
+
+  QueueConform();
+
+  // Mix a device buffer at a time
+  mixer_.SetFormat(format_.sampleRate(), format_.channelCount(), format_.sampleRate() * buffer_size_ / 1000);
+  mixer_.StartMixing(time);
+
+  // Give the mixer a moment to fill the device's first buffer so playback doesn't start with a dropout
+  int prefill = device_buffer;
+
+  QElapsedTimer prefill_timer;
+  prefill_timer.start();
+
+  while (buffer_.available() < prefill && prefill_timer.elapsed() < kPrefillTimeout) {
+    QThread::usleep(500);
+  }
+
+  return StartOutput(info);
+}
+
+void AudioPlayback::Scrub(const rational &time)
+{
+  if (!mixer_.IsScrubbing()) {
+    Stop();
+
+    QAudioDeviceInfo info;
+
+    if (!OpenDevice(&info)) {
+      return;
+    }
+
+    QueueConform();
+
+    // Grains are mixed a device buffer at a time so a new position is picked up within one buffer
+    mixer_.SetFormat(format_.sampleRate(), format_.channelCount(), format_.sampleRate() * buffer_size_ / 1000);
+    mixer_.StartScrubbing();
+
+    if (!StartOutput(info)) {
+      return;
+    }
+  }
+
+  mixer_.Scrub(time);
+
+  scrub_timer_.start();
+}
+
+bool AudioPlayback::OpenDevice(QAudioDeviceInfo *info)
+{
+  *info = QAudioDeviceInfo::defaultOutputDevice();
+
+  if (info->isNull()) {
+    qWarning() << tr("No audio output device is available");
+    return false;
+  }
+
+  // Mix in float if the device takes it, otherwise 16-bit integers which every device supports
+  QAudioFormat format;
+  format.setSampleRate(sample_rate_);
+  format.setChannelCount(channels_);
+  format.setCodec("audio/pcm");
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  format.setSampleType(QAudioFormat::Float);
+  format.setSampleSize(32);
+
+  if (!info->isFormatSupported(format)) {
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setSampleSize(16);
+
+    if (!info->isFormatSupported(format)) {
+      format = info->nearestFormat(format);
+
+      bool usable = (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32)
+          || (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16);
+
+      if (!usable || format.codec() != "audio/pcm" || format.byteOrder() != QAudioFormat::LittleEndian) {
+        qWarning() << tr("The audio output device doesn't support a usable sample format");
+        return false;
+      }
+    }
+  }
+
+  format_ = format;
+
+  device_.SetFormat(format_.sampleType() == QAudioFormat::Float, format_.channelCount());
+  device_.open(QIODevice::ReadOnly);
+
+  buffer_.Allocate(format_.sampleRate() * format_.channelCount() * kRingBufferSize / 1000);
+  buffer_.ResetStatistics();
+
+  return true;
+}
+
+bool AudioPlayback::StartOutput(const QAudioDeviceInfo &info)
+{
+  output_ = new QAudioOutput(info, format_, this);
+  output_->setBufferSize(format_.bytesForDuration(static_cast<qint64>(buffer_size_) * 1000));
+
+  last_played_ = 0;
+  last_result_ = 0;
+  last_played_timer_.start();
+
+  output_->start(&device_);
+
+  if (output_->error() != QAudio::NoError) {
+    qWarning() << tr("Failed to start audio output");
+    Stop();
+    return false;
+  }
+
+  return true;
+}
+
+void AudioPlayback::QueueConform()
+{
+  // Streams that don't match the format are resampled in real time until they've been conformed in the background
+  foreach (const AudioMixer::Clip& clip, mixer_.clips()) {
+    ConformTask::Queue(clip.stream, format_.sampleRate(), format_.channelCount());
+  }
+}
+
+void AudioPlayback::Stop()
+{
+  scrub_timer_.stop();
+
+  if (output_ != nullptr) {
+    output_->stop();
+    delete output_;
+    output_ = nullptr;
+  }
+
+  mixer_.StopMixing();
+
+  buffer_.Clear();
+
+  device_.close();
+}
+
+bool AudioPlayback::IsRunning()
+{
+  return (output_ != nullptr && !mixer_.IsScrubbing());
+}
+
+bool AudioPlayback::IsScrubbing()
+{
+  return (output_ != nullptr && mixer_.IsScrubbing());
+}
+
+qint64 AudioPlayback::elapsed_nsecs()
+{
+  if (output_ == nullptr) {
+    return 0;
+  }
+
+  // Audio the device has been given, minus what's still waiting in its buffer, is what's been heard
+  qint64 buffered = format_.durationForBytes(output_->bufferSize() - output_->bytesFree());
+  qint64 played = qMax(Q_INT64_C(0), output_->processedUSecs() - buffered) * 1000;
+
+  if (played != last_played_) {
+    last_played_ = played;
+    last_played_timer_.restart();
+  }
+
+  // Extrapolate between the device's updates, but never by more than one buffer
+  qint64 extrapolated = last_played_ + qMin(last_played_timer_.nsecsElapsed(),
+                                            static_cast<qint64>(buffer_size_) * 1000000);
+
+  last_result_ = qMax(last_result_, extrapolated);
+
+  return last_result_;
+}
+
+int AudioPlayback::dropouts()
+{
+  return buffer_.underruns();
+}
+
+int AudioPlayback::target_latency()
+{
+  int samples_per_second = format_.sampleRate() * format_.channelCount();
+
+  if (samples_per_second <= 0) {
+    return 0;
+  }
+
+  return static_cast<int>(static_cast<qint64>(buffer_.target_fill()) * 1000 / samples_per_second);
+}
+
+void AudioPlayback::ScrubTimeout()
+{
+  if (IsScrubbing()) {
+    Stop();
+  }
+}
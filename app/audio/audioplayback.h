@@ -0,0 +1,223 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOPLAYBACK_H
+#define AUDIOPLAYBACK_H
+
+#include <QAudioDeviceInfo>
+#include <QAudioFormat>
+#include <QAudioOutput>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QTimer>
+
+#include "audiomixer.h"
+#include "audioringbuffer.h"
+
+/**
+ * @brief An internal class only used by AudioPlayback
+ *
+ * The QIODevice QAudioOutput pulls samples from. Reads never wait: samples are taken straight from the ring buffer
+ * and converted to the device's sample format, and if the mixer hasn't kept up the rest is filled with silence (which
+ * the ring buffer counts as an underrun).
+ */
+class AudioRingDevice : public QIODevice
+{
+public:
+  AudioRingDevice(AudioRingBuffer* buffer);
+
+  /**
+   * @brief Set whether the device takes float samples (TRUE) or 16-bit signed integers (FALSE) and its channel count
+   */
+  void SetFormat(bool float_output, int channels);
+
+  virtual bool isSequential() const override;
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxlen) override;
+
+  virtual qint64 writeData(const char *data, qint64 len) override;
+
+private:
+  AudioRingBuffer* buffer_;
+
+  bool float_output_;
+
+  int channels_;
+
+  QVector<float> conversion_buffer_;
+};
+
+/**
+ * @brief Plays mixed audio through the default output device and provides the audio clock playback is timed by
+ *
+ * Audio is mixed on an AudioMixer thread into a lock-free AudioRingBuffer, which the device pulls from without ever
+ * waiting on the mixer. The device's own buffer (see SetBufferSize()) can therefore be kept very small for low
+ * latency, since decoding hiccups are absorbed by the ring buffer instead.
+ *
+ * elapsed_nsecs() reports how much audio has actually reached the speakers since Start(), so video presented against
+ * it stays in sync with what's heard. See PlaybackEngine::SetAudioPlayback().
+ *
+ * Scrub() plays short grains around the playhead while it's dragged instead (see AudioMixer::StartScrubbing()).
+ */
+class AudioPlayback : public QObject
+{
+  Q_OBJECT
+public:
+  AudioPlayback(QObject* parent = nullptr);
+
+  virtual ~AudioPlayback() override;
+
+  /**
+   * @brief Smallest device buffer size in milliseconds
+   */
+  static const int kMinimumBufferSize = 5;
+
+  /**
+   * @brief Set the device's buffer size in milliseconds, takes effect on the next Start()
+   *
+   * Smaller buffers reduce latency but need the main thread to be responsive enough to refill them in time. Values
+   * below kMinimumBufferSize are raised to it.
+   */
+  void SetBufferSize(int msecs);
+
+  int buffer_size();
+
+  /**
+   * @brief Set the sample rate and channel count to play at (usually the Sequence's), takes effect on the next Start()
+   */
+  void SetFormat(int sample_rate, int channels);
+
+  /**
+   * @brief Access the mixer to add clips to play (only while stopped)
+   */
+  AudioMixer* mixer();
+
+  /**
+   * @brief Start playing from a certain time
+   *
+   * @return
+   *
+   * FALSE if no output device supports the format, in which case nothing is played.
+   */
+  bool Start(const rational& time);
+
+  /**
+   * @brief Play a short grain of audio around a time while the playhead is being dragged
+   *
+   * Stops playback and opens the device in scrub mode if it isn't already. A grain still playing from the last call
+   * is cut off, so audio always follows the playhead. The device is closed again once kScrubTimeout passes without
+   * another call.
+   */
+  void Scrub(const rational& time);
+
+  /**
+   * @brief Stop playing or scrubbing
+   */
+  void Stop();
+
+  /**
+   * @brief Returns TRUE while playing (but not while scrubbing, which has no clock to follow)
+   */
+  bool IsRunning();
+
+  bool IsScrubbing();
+
+  /**
+   * @brief Nanoseconds of audio that have been heard since Start()
+   *
+   * The device only reports its progress every time it pulls a buffer, so this is extrapolated in between and never
+   * goes backwards.
+   */
+  qint64 elapsed_nsecs();
+
+  /**
+   * @brief Number of times the device needed samples the mixer hadn't provided yet since Start()
+   */
+  int dropouts();
+
+  /**
+   * @brief Duration of audio the mixer is currently trying to keep ahead of the device in milliseconds
+   */
+  int target_latency();
+
+private:
+  /**
+   * @brief Find the format to use with the default device and prepare the ring buffer and device for it
+   */
+  bool OpenDevice(QAudioDeviceInfo* info);
+
+  /**
+   * @brief Start the device pulling from the ring buffer
+   */
+  bool StartOutput(const QAudioDeviceInfo& info);
+
+  /**
+   * @brief Have every clip that doesn't match the output format conformed in the background
+   */
+  void QueueConform();
+
+  /**
+   * @brief Longest duration of audio kept mixed ahead of the device in milliseconds
+   *
+   * The mixer normally stays a couple of device buffers ahead and only goes this far after repeated dropouts (see
+   * AudioRingBuffer::target_fill()).
+   */
+  static const int kRingBufferSize = 250;
+
+  /**
+   * @brief Longest Start() waits for the mixer to fill the device buffer in milliseconds
+   */
+  static const int kPrefillTimeout = 50;
+
+  /**
+   * @brief How long the device stays open in scrub mode after the last Scrub() in milliseconds
+   */
+  static const int kScrubTimeout = 500;
+
+  AudioRingBuffer buffer_;
+
+  AudioMixer mixer_;
+
+  AudioRingDevice device_;
+
+  QAudioOutput* output_;
+
+  QAudioFormat format_;
+
+  int buffer_size_;
+
+  int sample_rate_;
+
+  int channels_;
+
+  qint64 last_played_;
+
+  qint64 last_result_;
+
+  QElapsedTimer last_played_timer_;
+
+  QTimer scrub_timer_;
+
+private slots:
+  void ScrubTimeout();
+};
+
+#endif // AUDIOPLAYBACK_H
@@ -0,0 +1,211 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioringbuffer.h"
+
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer() :
+  mask_(0),
+  read_pos_(0),
+  write_pos_(0),
+  discard_pos_(0),
+  target_minimum_(0),
+  target_maximum_(0),
+  target_fill_(0),
+  clean_samples_(0),
+  underruns_(0),
+  underrun_samples_(0)
+{
+}
+
+void AudioRingBuffer::Allocate(int samples)
+{
+  quint32 size = 1;
+
+  while (size < static_cast<quint32>(qMax(1, samples))) {
+    size <<= 1;
+  }
+
+  buffer_.resize(static_cast<int>(size));
+  mask_ = size - 1;
+
+  if (target_maximum_ > capacity()) {
+    SetTargetRange(target_minimum_, capacity());
+  }
+
+  Clear();
+}
+
+void AudioRingBuffer::Clear()
+{
+  read_pos_.store(0);
+  write_pos_.store(0);
+  discard_pos_.store(0);
+}
+
+int AudioRingBuffer::capacity()
+{
+  return buffer_.size();
+}
+
+int AudioRingBuffer::available()
+{
+  return static_cast<int>(write_pos_.loadAcquire() - read_pos_.loadAcquire());
+}
+
+int AudioRingBuffer::free_space()
+{
+  return capacity() - available();
+}
+
+int AudioRingBuffer::Write(const float *data, int count)
+{
+  if (buffer_.isEmpty() || count <= 0) {
+    return 0;
+  }
+
+  // Only this thread changes write_pos_, the consumer may advance read_pos_ at any time which only frees more space
+  quint32 write = write_pos_.load();
+  quint32 read = read_pos_.loadAcquire();
+
+  int free = capacity() - static_cast<int>(write - read);
+  int n = qMin(count, free);
+
+  if (n <= 0) {
+    return 0;
+  }
+
+  int start = static_cast<int>(write & mask_);
+  int first = qMin(n, capacity() - start);
+
+  memcpy(buffer_.data() + start, data, static_cast<size_t>(first) * sizeof(float));
+  memcpy(buffer_.data(), data + first, static_cast<size_t>(n - first) * sizeof(float));
+
+  // Release so the consumer sees the samples before it sees the new position
+  write_pos_.storeRelease(write + static_cast<quint32>(n));
+
+  return n;
+}
+
+int AudioRingBuffer::Read(float *data, int count)
+{
+  if (buffer_.isEmpty() || count <= 0) {
+    return 0;
+  }
+
+  quint32 read = read_pos_.load();
+  quint32 discard = discard_pos_.loadAcquire();
+  quint32 write = write_pos_.loadAcquire();
+
+  // Skip anything the producer has discarded (compared as a difference so it works across wrapping)
+  if (static_cast<qint32>(discard - read) > 0) {
+    read = discard;
+
+    // Hand the space back straight away in case nothing is read below
+    read_pos_.storeRelease(read);
+  }
+
+  int n = qMin(count, static_cast<int>(write - read));
+
+  UpdateTarget(n < count, count);
+
+  if (n < count) {
+    underruns_.ref();
+    underrun_samples_.fetchAndAddRelaxed(count - qMax(0, n));
+  }
+
+  if (n <= 0) {
+    return 0;
+  }
+
+  int start = static_cast<int>(read & mask_);
+  int first = qMin(n, capacity() - start);
+
+  memcpy(data, buffer_.constData() + start, static_cast<size_t>(first) * sizeof(float));
+  memcpy(data + first, buffer_.constData(), static_cast<size_t>(n - first) * sizeof(float));
+
+  // Release so the producer doesn't overwrite these samples before they've been copied
+  read_pos_.storeRelease(read + static_cast<quint32>(n));
+
+  return n;
+}
+
+void AudioRingBuffer::Discard()
+{
+  discard_pos_.storeRelease(write_pos_.load());
+}
+
+void AudioRingBuffer::SetTargetRange(int minimum, int maximum)
+{
+  target_maximum_ = qMax(1, qMin(maximum, capacity() > 0 ? capacity() : maximum));
+  target_minimum_ = qBound(1, minimum, target_maximum_);
+
+  target_fill_.store(target_minimum_);
+
+  clean_samples_ = 0;
+}
+
+int AudioRingBuffer::target_fill()
+{
+  return target_fill_.load();
+}
+
+bool AudioRingBuffer::NeedsSamples()
+{
+  return available() < target_fill_.load();
+}
+
+int AudioRingBuffer::underruns()
+{
+  return underruns_.load();
+}
+
+int AudioRingBuffer::underrun_samples()
+{
+  return underrun_samples_.load();
+}
+
+void AudioRingBuffer::ResetStatistics()
+{
+  underruns_.store(0);
+  underrun_samples_.store(0);
+  clean_samples_ = 0;
+}
+
+void AudioRingBuffer::UpdateTarget(bool underrun, int count)
+{
+  int target = target_fill_.load();
+
+  if (underrun) {
+    // The producer couldn't keep up, give it more headroom straight away
+    target_fill_.store(qMin(target_maximum_, target * 2));
+    clean_samples_ = 0;
+    return;
+  }
+
+  clean_samples_ += count;
+
+  // Playback has been smooth for a while, win back some latency
+  if (clean_samples_ >= static_cast<qint64>(target_maximum_) * kDecayPeriods) {
+    target_fill_.store(qMax(target_minimum_, target - target / 4));
+    clean_samples_ = 0;
+  }
+}
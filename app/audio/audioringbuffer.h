@@ -0,0 +1,162 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QVector>
+
+/**
+ * @brief A lock-free single-producer single-consumer ring buffer of interleaved float samples
+ *
+ * One thread may Write() while another Read()s at the same time without either ever blocking, which is what lets the
+ * audio device pull samples without waiting on the mixer. Positions only ever increase and wrap around naturally as
+ * unsigned integers, and the capacity is a power of two so they can be masked into the buffer.
+ *
+ * The buffer also tracks how full the producer should keep it (see target_fill()). Keeping it full adds nothing but
+ * memory, while keeping it nearly empty means any hiccup on the producer side is heard, so the target adapts: every
+ * underrun doubles it (up to the maximum set by SetTargetRange()), and once kDecayPeriods times the maximum has been
+ * read without an underrun it drops back by a quarter (down to the minimum). Underruns are counted for diagnostics.
+ *
+ * Allocate(), Clear(), SetTargetRange() and ResetStatistics() are not thread-safe and must only be called while
+ * neither side is running.
+ */
+class AudioRingBuffer
+{
+public:
+  AudioRingBuffer();
+
+  /**
+   * @brief Allocate space for at least `samples` samples (rounded up to a power of two), discarding the contents
+   */
+  void Allocate(int samples);
+
+  /**
+   * @brief Discard the contents
+   */
+  void Clear();
+
+  int capacity();
+
+  /**
+   * @brief Number of samples that can currently be read
+   */
+  int available();
+
+  /**
+   * @brief Number of samples that can currently be written
+   */
+  int free_space();
+
+  /**
+   * @brief Write up to `count` samples, only called from the producer thread
+   *
+   * @return
+   *
+   * The number of samples written, which is less than `count` if the buffer is full.
+   */
+  int Write(const float* data, int count);
+
+  /**
+   * @brief Read up to `count` samples, only called from the consumer thread
+   *
+   * @return
+   *
+   * The number of samples read, which is less than `count` if the buffer ran out.
+   */
+  int Read(float* data, int count);
+
+  /**
+   * @brief Drop every sample that hasn't been read yet, only called from the producer thread
+   *
+   * The consumer skips them on its next Read(), so this never waits on it. Until then available() and free_space()
+   * still count them.
+   */
+  void Discard();
+
+  /**
+   * @brief Set the range target_fill() adapts within in samples, the target starts again from the minimum
+   *
+   * The maximum is limited to the capacity.
+   */
+  void SetTargetRange(int minimum, int maximum);
+
+  /**
+   * @brief Number of samples the producer should keep available ahead of the consumer
+   */
+  int target_fill();
+
+  /**
+   * @brief Returns TRUE if fewer samples than target_fill() are available, only called from the producer thread
+   */
+  bool NeedsSamples();
+
+  /**
+   * @brief Number of Read()s that couldn't be fully satisfied since the last ResetStatistics()
+   */
+  int underruns();
+
+  /**
+   * @brief Total number of samples Read()s were short by since the last ResetStatistics()
+   */
+  int underrun_samples();
+
+  void ResetStatistics();
+
+private:
+  /**
+   * @brief How many times the maximum target must be read without an underrun before the target is lowered
+   */
+  static const int kDecayPeriods = 16;
+
+  /**
+   * @brief Adapt the target after a Read(), only called from the consumer thread
+   */
+  void UpdateTarget(bool underrun, int count);
+
+  QVector<float> buffer_;
+
+  quint32 mask_;
+
+  QAtomicInteger<quint32> read_pos_;
+
+  QAtomicInteger<quint32> write_pos_;
+
+  // Set by Discard(), the consumer jumps read_pos_ forward to it
+  QAtomicInteger<quint32> discard_pos_;
+
+  int target_minimum_;
+
+  int target_maximum_;
+
+  // Only written by the consumer, read by the producer
+  QAtomicInt target_fill_;
+
+  // Samples read since the last underrun or target change, only accessed by the consumer
+  qint64 clean_samples_;
+
+  QAtomicInt underruns_;
+
+  QAtomicInt underrun_samples_;
+};
+
+#endif // AUDIORINGBUFFER_H
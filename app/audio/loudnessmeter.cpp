@@ -0,0 +1,374 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "loudnessmeter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mixkernels.h"
+
+const double LoudnessMeter::kSilence = -200.0;
+
+// Blocks quieter than this are never counted (LUFS)
+const double kAbsoluteGate = -70.0;
+
+// Relative gates for integrated loudness and loudness range (LU)
+const double kIntegratedGate = -10.0;
+const double kRangeGate = -20.0;
+
+// Steps in each momentary (400 ms) and short-term (3 s) block
+const int kMomentarySteps = 4;
+const int kShortTermSteps = 30;
+
+// Input samples each true peak output is interpolated from
+const int kTapsPerPhase = 12;
+
+// Lowest rate true peak is measured at
+const int kTruePeakRate = 176400;
+
+LoudnessMeter::LoudnessMeter() :
+  channels_(0),
+  sample_rate_(0),
+  step_frames_(1),
+  step_energy_(0),
+  step_count_(0),
+  oversample_(1),
+  true_peak_(0),
+  sample_peak_(0),
+  integrated_(kSilence),
+  range_(0)
+{
+}
+
+void LoudnessMeter::Create(int channels, int sample_rate)
+{
+  const double kPi = 3.14159265358979323846;
+
+  channels_ = channels;
+  sample_rate_ = sample_rate;
+  step_frames_ = qMax(1, sample_rate_ * kStepMilliseconds / 1000);
+
+  weights_.fill(1.0, channels_);
+
+  if (channels_ == 5 || channels_ == 6) {
+    weights_[channels_ - 2] = 1.41;
+    weights_[channels_ - 1] = 1.41;
+  }
+
+  if (channels_ == 6) {
+    weights_[3] = 0.0;
+  }
+
+  // BS.1770 only lists the K-weighting coefficients at 48 kHz, so they're derived from the analog prototypes
+  double k = std::tan(kPi * 1681.974450955533 / sample_rate_);
+  double q = 0.7071752369554196;
+  double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+
+  Biquad shelf;
+  shelf.b0 = (vh + vb * k / q + k * k) / a0;
+  shelf.b1 = 2.0 * (k * k - vh) / a0;
+  shelf.b2 = (vh - vb * k / q + k * k) / a0;
+  shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+  shelf.a2 = (1.0 - k / q + k * k) / a0;
+  shelf.z1 = 0;
+  shelf.z2 = 0;
+
+  k = std::tan(kPi * 38.13547087602444 / sample_rate_);
+  q = 0.5003270373238773;
+  a0 = 1.0 + k / q + k * k;
+
+  Biquad highpass;
+  highpass.b0 = 1.0;
+  highpass.b1 = -2.0;
+  highpass.b2 = 1.0;
+  highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+  highpass.a2 = (1.0 - k / q + k * k) / a0;
+  highpass.z1 = 0;
+  highpass.z2 = 0;
+
+  filters_.resize(channels_ * 2);
+
+  for (int i=0;i<channels_;i++) {
+    filters_[i * 2] = shelf;
+    filters_[i * 2 + 1] = highpass;
+  }
+
+  filtered_.resize(step_frames_);
+
+  step_energy_ = 0;
+  step_count_ = 0;
+
+  steps_.clear();
+  momentary_blocks_.clear();
+  short_term_blocks_.clear();
+  momentary_.clear();
+  short_term_.clear();
+
+  // Lanczos kernel taps for each fractional position between the two middle input samples
+  oversample_ = 1;
+
+  while (sample_rate_ * oversample_ < kTruePeakRate) {
+    oversample_ *= 2;
+  }
+
+  phases_.resize(oversample_);
+
+  for (int p=0;p<oversample_;p++) {
+    double frac = static_cast<double>(p) / static_cast<double>(oversample_);
+    double half = kTapsPerPhase / 2;
+
+    phases_[p].resize(kTapsPerPhase);
+
+    for (int j=0;j<kTapsPerPhase;j++) {
+      // Distance from the output position to input sample j of the window
+      double d = (half - 1.0) + frac - j;
+
+      double tap = 1.0;
+
+      if (d != 0.0) {
+        tap = (qAbs(d) < half) ? std::sin(kPi * d) / (kPi * d) * std::sin(kPi * d / half) / (kPi * d / half) : 0.0;
+      }
+
+      phases_[p][j] = static_cast<float>(tap);
+    }
+  }
+
+  history_.resize(channels_);
+
+  for (int i=0;i<channels_;i++) {
+    history_[i].fill(0.0f, kTapsPerPhase - 1);
+  }
+
+  true_peak_ = 0;
+  sample_peak_ = 0;
+  integrated_ = kSilence;
+  range_ = 0;
+}
+
+void LoudnessMeter::AddSamples(const float * const *planes, int frames)
+{
+  int done = 0;
+
+  while (done < frames) {
+    // Each step's energy is accumulated separately
+    int count = qMin(frames - done, step_frames_ - step_count_);
+
+    for (int i=0;i<channels_;i++) {
+      const float* src = planes[i] + done;
+
+      sample_peak_ = qMax(sample_peak_, olive::audio::PeakAbsolute(src, count));
+
+      MeasureTruePeak(i, src, count);
+
+      if (weights_.at(i) == 0.0) {
+        continue;
+      }
+
+      Biquad* shelf = &filters_[i * 2];
+      Biquad* highpass = &filters_[i * 2 + 1];
+
+      for (int j=0;j<count;j++) {
+        filtered_[j] = static_cast<float>(Process(highpass, Process(shelf, static_cast<double>(src[j]))));
+      }
+
+      step_energy_ += weights_.at(i) * olive::audio::DotProduct(filtered_.constData(), filtered_.constData(), count);
+    }
+
+    step_count_ += count;
+    done += count;
+
+    if (step_count_ == step_frames_) {
+      FinishStep();
+    }
+  }
+}
+
+void LoudnessMeter::Finalize()
+{
+  QVector<double> integrated_blocks = Gate(momentary_blocks_, kIntegratedGate);
+
+  integrated_ = EnergyToLoudness(Mean(integrated_blocks, 0, integrated_blocks.size()));
+
+  // Loudness range is the spread between the 10th and 95th percentiles of gated short-term loudness (EBU Tech 3342)
+  QVector<double> range_blocks = Gate(short_term_blocks_, kRangeGate);
+
+  if (range_blocks.isEmpty()) {
+    range_ = 0;
+    return;
+  }
+
+  std::sort(range_blocks.begin(), range_blocks.end());
+
+  int last = range_blocks.size() - 1;
+  double low = EnergyToLoudness(range_blocks.at(qRound(last * 0.10)));
+  double high = EnergyToLoudness(range_blocks.at(qRound(last * 0.95)));
+
+  range_ = high - low;
+}
+
+double LoudnessMeter::integrated() const
+{
+  return integrated_;
+}
+
+double LoudnessMeter::range() const
+{
+  return range_;
+}
+
+double LoudnessMeter::true_peak() const
+{
+  return (true_peak_ > 0) ? 20.0 * std::log10(static_cast<double>(true_peak_)) : kSilence;
+}
+
+double LoudnessMeter::sample_peak() const
+{
+  return (sample_peak_ > 0) ? 20.0 * std::log10(static_cast<double>(sample_peak_)) : kSilence;
+}
+
+const QVector<float> &LoudnessMeter::momentary() const
+{
+  return momentary_;
+}
+
+const QVector<float> &LoudnessMeter::short_term() const
+{
+  return short_term_;
+}
+
+double LoudnessMeter::EnergyToLoudness(double energy)
+{
+  return (energy > 0) ? -0.691 + 10.0 * std::log10(energy) : kSilence;
+}
+
+double LoudnessMeter::LoudnessToEnergy(double loudness)
+{
+  return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+double LoudnessMeter::Mean(const QVector<double> &values, int from, int to)
+{
+  if (to <= from) {
+    return 0;
+  }
+
+  double sum = 0;
+
+  for (int i=from;i<to;i++) {
+    sum += values.at(i);
+  }
+
+  return sum / (to - from);
+}
+
+double LoudnessMeter::Process(LoudnessMeter::Biquad *filter, double sample)
+{
+  double out = filter->b0 * sample + filter->z1;
+
+  filter->z1 = filter->b1 * sample - filter->a1 * out + filter->z2;
+  filter->z2 = filter->b2 * sample - filter->a2 * out;
+
+  return out;
+}
+
+QVector<double> LoudnessMeter::Gate(const QVector<double> &blocks, double relative_gate)
+{
+  double absolute = LoudnessToEnergy(kAbsoluteGate);
+
+  QVector<double> above_absolute;
+
+  foreach (double e, blocks) {
+    if (e > absolute) {
+      above_absolute.append(e);
+    }
+  }
+
+  double relative = LoudnessToEnergy(EnergyToLoudness(Mean(above_absolute, 0, above_absolute.size())) + relative_gate);
+
+  QVector<double> gated;
+
+  foreach (double e, above_absolute) {
+    if (e > relative) {
+      gated.append(e);
+    }
+  }
+
+  return gated;
+}
+
+void LoudnessMeter::MeasureTruePeak(int channel, const float *samples, int frames)
+{
+  if (oversample_ == 1) {
+    // Already at a high enough rate, the true peak is the sample peak
+    true_peak_ = qMax(true_peak_, olive::audio::PeakAbsolute(samples, frames));
+    return;
+  }
+
+  QVector<float>& window = history_[channel];
+  int kept = kTapsPerPhase - 1;
+
+  window.resize(kept + frames);
+  memcpy(window.data() + kept, samples, static_cast<size_t>(frames) * sizeof(float));
+
+  float peak = 0;
+
+  for (int i=0;i<frames;i++) {
+    const float* input = window.constData() + i;
+
+    for (int p=0;p<oversample_;p++) {
+      peak = qMax(peak, std::fabs(olive::audio::DotProduct(phases_.at(p).constData(), input, kTapsPerPhase)));
+    }
+  }
+
+  true_peak_ = qMax(true_peak_, peak);
+
+  // Keep the last samples for interpolating across the next call
+  memmove(window.data(), window.constData() + frames, static_cast<size_t>(kept) * sizeof(float));
+  window.resize(kept);
+}
+
+void LoudnessMeter::FinishStep()
+{
+  steps_.append(step_energy_ / step_frames_);
+
+  step_energy_ = 0;
+  step_count_ = 0;
+
+  int n = steps_.size();
+
+  double momentary = Mean(steps_, qMax(0, n - kMomentarySteps), n);
+  double short_term = Mean(steps_, qMax(0, n - kShortTermSteps), n);
+
+  // Meters show partial blocks at the start, but only complete blocks are gated
+  if (n >= kMomentarySteps) {
+    momentary_blocks_.append(momentary);
+  }
+
+  if (n >= kShortTermSteps) {
+    short_term_blocks_.append(short_term);
+  }
+
+  momentary_.append(static_cast<float>(EnergyToLoudness(momentary)));
+  short_term_.append(static_cast<float>(EnergyToLoudness(short_term)));
+}
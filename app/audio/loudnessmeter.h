@@ -0,0 +1,177 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <QVector>
+
+/**
+ * @brief Measures loudness according to ITU-R BS.1770-4 and EBU R128
+ *
+ * Samples are fed in with AddSamples() in any number of calls, and every kStepMilliseconds the momentary (400 ms)
+ * and short-term (3 s) loudness ending there is recorded, so meters can be drawn for any position afterwards.
+ * Finalize() then gates the blocks to calculate the integrated loudness and loudness range.
+ *
+ * Each channel is K-weighted by two biquads. Those are recursive so they run sample by sample, but the energy and
+ * peak reductions and the true peak interpolation filter run through the vectorised olive::audio kernels. True peak
+ * is measured by oversampling to at least 176.4 kHz with a Lanczos interpolator, as BS.1770 Annex 2 describes.
+ *
+ * Channels are assumed to be in FFmpeg's default order: for 5 and 6 channel audio the last two are the surrounds,
+ * which are weighted by +1.5 dB, and the fourth of 6 is the LFE, which isn't measured.
+ */
+class LoudnessMeter
+{
+public:
+  LoudnessMeter();
+
+  /**
+   * @brief Interval momentary and short-term loudness are recorded at in milliseconds
+   */
+  static const int kStepMilliseconds = 100;
+
+  /**
+   * @brief Loudness reported for digital silence (and when everything is below the gates) in LUFS or dBTP
+   */
+  static const double kSilence;
+
+  /**
+   * @brief Reset the meter for audio of a certain format
+   */
+  void Create(int channels, int sample_rate);
+
+  /**
+   * @brief Measure planar float samples (as returned by Decoder::Retrieve())
+   */
+  void AddSamples(const float* const* planes, int frames);
+
+  /**
+   * @brief Calculate integrated loudness and loudness range from everything added so far
+   */
+  void Finalize();
+
+  /**
+   * @brief Gated loudness of the whole programme in LUFS
+   */
+  double integrated() const;
+
+  /**
+   * @brief Loudness range (LRA) in LU
+   */
+  double range() const;
+
+  /**
+   * @brief Highest true peak of any channel in dBTP
+   */
+  double true_peak() const;
+
+  /**
+   * @brief Highest sample of any channel in dBFS
+   */
+  double sample_peak() const;
+
+  /**
+   * @brief Momentary loudness (LUFS) at the end of each step
+   */
+  const QVector<float>& momentary() const;
+
+  /**
+   * @brief Short-term loudness (LUFS) at the end of each step
+   */
+  const QVector<float>& short_term() const;
+
+private:
+  /**
+   * @brief Transposed direct form II biquad state
+   */
+  struct Biquad {
+    double b0, b1, b2, a1, a2;
+    double z1, z2;
+  };
+
+  static double EnergyToLoudness(double energy);
+
+  static double LoudnessToEnergy(double loudness);
+
+  static double Mean(const QVector<double>& values, int from, int to);
+
+  static double Process(Biquad* filter, double sample);
+
+  /**
+   * @brief Returns the block energies above the absolute gate (-70 LUFS) that are also no more than `relative_gate` LU
+   * below the loudness of those
+   */
+  static QVector<double> Gate(const QVector<double>& blocks, double relative_gate);
+
+  void MeasureTruePeak(int channel, const float* samples, int frames);
+
+  /**
+   * @brief Record the step that has just been completed
+   */
+  void FinishStep();
+
+  int channels_;
+
+  int sample_rate_;
+
+  int step_frames_;
+
+  QVector<double> weights_;
+
+  // Two K-weighting stages per channel
+  QVector<Biquad> filters_;
+
+  QVector<float> filtered_;
+
+  // Weighted energy of the step being accumulated and how many frames it has so far
+  double step_energy_;
+
+  int step_count_;
+
+  // Mean weighted energy of every completed step
+  QVector<double> steps_;
+
+  // Energy of every 400 ms and 3 s block (one ending on each step)
+  QVector<double> momentary_blocks_;
+
+  QVector<double> short_term_blocks_;
+
+  QVector<float> momentary_;
+
+  QVector<float> short_term_;
+
+  // True peak interpolator, one set of taps per phase stored reversed so each output is a single dot product
+  int oversample_;
+
+  QVector< QVector<float> > phases_;
+
+  // Last samples of each channel, followed by room for the samples being measured
+  QVector< QVector<float> > history_;
+
+  float true_peak_;
+
+  float sample_peak_;
+
+  double integrated_;
+
+  double range_;
+};
+
+#endif // LOUDNESSMETER_H
@@ -0,0 +1,329 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "mixkernels.h"
+
+#include <QtGlobal>
+#include <cmath>
+
+#include "common/clamp.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OLIVE_AUDIO_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_AUDIO_NEON
+#include <arm_neon.h>
+#endif
+
+namespace olive {
+namespace audio {
+
+namespace {
+
+/*
+ * Plain C++ kernels, used without SIMD support and for the remaining samples at the end of each block
+ */
+
+void MixScaledScalar(const float* src, float* dst, int count, float gain)
+{
+  for (int i=0;i<count;i++) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+void ScaleRampScalar(const float* src, float* dst, int count, float gain, float step)
+{
+  for (int i=0;i<count;i++) {
+    dst[i] = src[i] * gain;
+    gain += step;
+  }
+}
+
+void InterleaveClampedScalar(const float* const* planes, int channels, float* dst, int offset, int count)
+{
+  for (int i=offset;i<count;i++) {
+    for (int j=0;j<channels;j++) {
+      dst[i * channels + j] = clamp(planes[j][i], -1.0f, 1.0f);
+    }
+  }
+}
+
+float DotProductScalar(const float* a, const float* b, int count)
+{
+  float sum = 0.0f;
+
+  for (int i=0;i<count;i++) {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+float PeakAbsoluteScalar(const float* src, int count)
+{
+  float peak = 0.0f;
+
+  for (int i=0;i<count;i++) {
+    peak = qMax(peak, std::fabs(src[i]));
+  }
+
+  return peak;
+}
+
+}
+
+#if defined(OLIVE_AUDIO_SSE)
+
+/*
+ * SSE kernels (4 samples per iteration)
+ */
+
+void MixScaled(const float* src, float* dst, int count, float gain)
+{
+  const __m128 g = _mm_set1_ps(gain);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+  }
+
+  MixScaledScalar(src + i, dst + i, count - i, gain);
+}
+
+void ScaleRamp(const float* src, float* dst, int count, float from, float to)
+{
+  float step = (count > 0) ? (to - from) / static_cast<float>(count) : 0.0f;
+
+  __m128 g = _mm_add_ps(_mm_set1_ps(from), _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(step)));
+  const __m128 g_step = _mm_set1_ps(step * 4.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+    g = _mm_add_ps(g, g_step);
+  }
+
+  ScaleRampScalar(src + i, dst + i, count - i, from + step * static_cast<float>(i), step);
+}
+
+void InterleaveClamped(const float* const* planes, int channels, float* dst, int count)
+{
+  // Stereo is by far the most common output, anything else is interleaved one sample at a time
+  if (channels != 2) {
+    InterleaveClampedScalar(planes, channels, dst, 0, count);
+    return;
+  }
+
+  const __m128 lo = _mm_set1_ps(-1.0f);
+  const __m128 hi = _mm_set1_ps(1.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    __m128 l = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(planes[0] + i), lo), hi);
+    __m128 r = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(planes[1] + i), lo), hi);
+
+    _mm_storeu_ps(dst + i*2, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(dst + i*2 + 4, _mm_unpackhi_ps(l, r));
+  }
+
+  InterleaveClampedScalar(planes, channels, dst, i, count);
+}
+
+float DotProduct(const float* a, const float* b, int count)
+{
+  __m128 sum = _mm_setzero_ps();
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, sum);
+
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + DotProductScalar(a + i, b + i, count - i);
+}
+
+float PeakAbsolute(const float* src, int count)
+{
+  // Clearing the sign bit is the absolute value
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+  __m128 peak = _mm_setzero_ps();
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(src + i), abs_mask));
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, peak);
+
+  float result = qMax(qMax(lanes[0], lanes[1]), qMax(lanes[2], lanes[3]));
+
+  return qMax(result, PeakAbsoluteScalar(src + i, count - i));
+}
+
+const char* KernelName()
+{
+  return "SSE";
+}
+
+#elif defined(OLIVE_AUDIO_NEON)
+
+/*
+ * NEON kernels (4 samples per iteration)
+ */
+
+void MixScaled(const float* src, float* dst, int count, float gain)
+{
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), gain));
+  }
+
+  MixScaledScalar(src + i, dst + i, count - i, gain);
+}
+
+void ScaleRamp(const float* src, float* dst, int count, float from, float to)
+{
+  float step = (count > 0) ? (to - from) / static_cast<float>(count) : 0.0f;
+
+  const float offsets[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+
+  float32x4_t g = vmlaq_n_f32(vdupq_n_f32(from), vld1q_f32(offsets), step);
+  const float32x4_t g_step = vdupq_n_f32(step * 4.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), g));
+    g = vaddq_f32(g, g_step);
+  }
+
+  ScaleRampScalar(src + i, dst + i, count - i, from + step * static_cast<float>(i), step);
+}
+
+void InterleaveClamped(const float* const* planes, int channels, float* dst, int count)
+{
+  if (channels != 2) {
+    InterleaveClampedScalar(planes, channels, dst, 0, count);
+    return;
+  }
+
+  const float32x4_t lo = vdupq_n_f32(-1.0f);
+  const float32x4_t hi = vdupq_n_f32(1.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    float32x4x2_t lr;
+    lr.val[0] = vminq_f32(vmaxq_f32(vld1q_f32(planes[0] + i), lo), hi);
+    lr.val[1] = vminq_f32(vmaxq_f32(vld1q_f32(planes[1] + i), lo), hi);
+
+    // Interleaving store
+    vst2q_f32(dst + i*2, lr);
+  }
+
+  InterleaveClampedScalar(planes, channels, dst, i, count);
+}
+
+float DotProduct(const float* a, const float* b, int count)
+{
+  float32x4_t sum = vdupq_n_f32(0.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+
+  float lanes[4];
+  vst1q_f32(lanes, sum);
+
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + DotProductScalar(a + i, b + i, count - i);
+}
+
+float PeakAbsolute(const float* src, int count)
+{
+  float32x4_t peak = vdupq_n_f32(0.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(src + i)));
+  }
+
+  float lanes[4];
+  vst1q_f32(lanes, peak);
+
+  float result = qMax(qMax(lanes[0], lanes[1]), qMax(lanes[2], lanes[3]));
+
+  return qMax(result, PeakAbsoluteScalar(src + i, count - i));
+}
+
+const char* KernelName()
+{
+  return "NEON";
+}
+
+#else
+
+void MixScaled(const float* src, float* dst, int count, float gain)
+{
+  MixScaledScalar(src, dst, count, gain);
+}
+
+void ScaleRamp(const float* src, float* dst, int count, float from, float to)
+{
+  ScaleRampScalar(src, dst, count, from, (count > 0) ? (to - from) / static_cast<float>(count) : 0.0f);
+}
+
+void InterleaveClamped(const float* const* planes, int channels, float* dst, int count)
+{
+  InterleaveClampedScalar(planes, channels, dst, 0, count);
+}
+
+float DotProduct(const float* a, const float* b, int count)
+{
+  return DotProductScalar(a, b, count);
+}
+
+float PeakAbsolute(const float* src, int count)
+{
+  return PeakAbsoluteScalar(src, count);
+}
+
+const char* KernelName()
+{
+  return "Scalar";
+}
+
+#endif
+
+}
+}
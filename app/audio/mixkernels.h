@@ -0,0 +1,66 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MIXKERNELS_H
+#define MIXKERNELS_H
+
+namespace olive {
+namespace audio {
+
+/**
+ * @brief Add `count` samples of `src` multiplied by `gain` to `dst`
+ */
+void MixScaled(const float* src, float* dst, int count, float gain);
+
+/**
+ * @brief Write `count` samples of `src` to `dst` multiplied by a gain ramping linearly from `from` to `to`
+ *
+ * `to` is the gain the sample after the last one would get, so consecutive blocks ramp seamlessly. `src` and `dst` may
+ * be the same.
+ */
+void ScaleRamp(const float* src, float* dst, int count, float from, float to);
+
+/**
+ * @brief Interleave `count` samples from each of `channels` planes into `dst`, clamping them to -1.0-1.0
+ */
+void InterleaveClamped(const float* const* planes, int channels, float* dst, int count);
+
+/**
+ * @brief Returns the sum of `a[i] * b[i]` over `count` samples (so `DotProduct(a, a, count)` is the signal's energy)
+ */
+float DotProduct(const float* a, const float* b, int count);
+
+/**
+ * @brief Returns the largest absolute value of `count` samples, or 0 if `count` is 0
+ */
+float PeakAbsolute(const float* src, int count);
+
+/**
+ * @brief Returns the name of the instruction set the kernels use ("SSE", "NEON" or "Scalar")
+ *
+ * SSE is part of every x86-64 CPU, so unlike the pixel kernels (see olive::pixel::GetKernels()) nothing is checked at
+ * runtime. Audio mixing is bound by memory bandwidth rather than arithmetic, so wider instruction sets gain little.
+ */
+const char* KernelName();
+
+}
+}
+
+#endif // MIXKERNELS_H
@@ -0,0 +1,73 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "samplebuffer.h"
+
+#include <algorithm>
+
+SampleBuffer::SampleBuffer() :
+  channels_(0),
+  sample_count_(0),
+  sample_rate_(0)
+{
+}
+
+void SampleBuffer::Create(int channels, int sample_count, int sample_rate)
+{
+  channels_ = channels;
+  sample_count_ = sample_count;
+  sample_rate_ = sample_rate;
+
+  int size = channels_ * sample_count_;
+
+  if (data_.size() < size) {
+    data_.resize(size);
+  }
+}
+
+int SampleBuffer::channels() const
+{
+  return channels_;
+}
+
+int SampleBuffer::sample_count() const
+{
+  return sample_count_;
+}
+
+int SampleBuffer::sample_rate() const
+{
+  return sample_rate_;
+}
+
+float *SampleBuffer::channel(int index)
+{
+  return data_.data() + index * sample_count_;
+}
+
+const float *SampleBuffer::channel(int index) const
+{
+  return data_.constData() + index * sample_count_;
+}
+
+void SampleBuffer::Silence()
+{
+  std::fill(data_.begin(), data_.begin() + channels_ * sample_count_, 0.0f);
+}
@@ -0,0 +1,70 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SAMPLEBUFFER_H
+#define SAMPLEBUFFER_H
+
+#include <QVector>
+
+/**
+ * @brief A block of planar float audio passed between nodes (see NodeParam::kSamples and AudioProcessor)
+ *
+ * Each channel's samples are contiguous so nodes can process a whole channel in one vectorised call. Create() only
+ * allocates when the buffer needs to grow, so a node reusing its buffer for every block doesn't allocate once it has
+ * seen the largest block.
+ */
+class SampleBuffer
+{
+public:
+  SampleBuffer();
+
+  /**
+   * @brief Set the format of the buffer, the samples are left undefined
+   */
+  void Create(int channels, int sample_count, int sample_rate);
+
+  int channels() const;
+
+  /**
+   * @brief Number of samples in each channel
+   */
+  int sample_count() const;
+
+  int sample_rate() const;
+
+  float* channel(int index);
+  const float* channel(int index) const;
+
+  /**
+   * @brief Set every sample to 0
+   */
+  void Silence();
+
+private:
+  QVector<float> data_;
+
+  int channels_;
+
+  int sample_count_;
+
+  int sample_rate_;
+};
+
+#endif // SAMPLEBUFFER_H
@@ -0,0 +1,168 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+/**
+ * @brief A thread-safe FIFO queue holding at most a fixed number of items
+ *
+ * Connects the stages of a pipeline running on different threads. Push() waits while the queue is full, so a stage
+ * that gets ahead of the next one is held back (backpressure) and the memory the pipeline uses stays fixed. Pop()
+ * waits while the queue is empty.
+ *
+ * Close() lets the consumer drain what's left once the producer is done, Abort() wakes everyone up immediately.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  BoundedQueue(int capacity) :
+    capacity_(qMax(1, capacity)),
+    closed_(false),
+    aborted_(false)
+  {
+  }
+
+  BoundedQueue(const BoundedQueue& other) = delete;
+  BoundedQueue(BoundedQueue&& other) = delete;
+  BoundedQueue& operator=(const BoundedQueue& other) = delete;
+  BoundedQueue& operator=(BoundedQueue&& other) = delete;
+
+  /**
+   * @brief Add an item to the back of the queue, waiting until there's room
+   *
+   * @return
+   *
+   * FALSE if the queue was closed or aborted, in which case the item wasn't added.
+   */
+  bool Push(const T& item)
+  {
+    QMutexLocker locker(&mutex_);
+
+    while (queue_.size() >= capacity_ && !closed_ && !aborted_) {
+      not_full_.wait(&mutex_);
+    }
+
+    if (closed_ || aborted_) {
+      return false;
+    }
+
+    queue_.enqueue(item);
+
+    not_empty_.wakeOne();
+
+    return true;
+  }
+
+  /**
+   * @brief Take the item at the front of the queue, waiting until there is one
+   *
+   * @return
+   *
+   * FALSE if the queue was aborted, or closed with nothing left in it.
+   */
+  bool Pop(T* item)
+  {
+    QMutexLocker locker(&mutex_);
+
+    while (queue_.isEmpty() && !closed_ && !aborted_) {
+      not_empty_.wait(&mutex_);
+    }
+
+    if (aborted_ || queue_.isEmpty()) {
+      return false;
+    }
+
+    *item = queue_.dequeue();
+
+    not_full_.wakeOne();
+
+    return true;
+  }
+
+  /**
+   * @brief Stop accepting items, Pop() keeps returning the items already queued
+   */
+  void Close()
+  {
+    QMutexLocker locker(&mutex_);
+
+    closed_ = true;
+
+    not_empty_.wakeAll();
+    not_full_.wakeAll();
+  }
+
+  /**
+   * @brief Stop accepting and returning items
+   *
+   * @return
+   *
+   * The items that were still queued, so the caller can free them.
+   */
+  QQueue<T> Abort()
+  {
+    QMutexLocker locker(&mutex_);
+
+    aborted_ = true;
+
+    QQueue<T> remaining = queue_;
+    queue_.clear();
+
+    not_empty_.wakeAll();
+    not_full_.wakeAll();
+
+    return remaining;
+  }
+
+  int size()
+  {
+    QMutexLocker locker(&mutex_);
+
+    return queue_.size();
+  }
+
+  int capacity() const
+  {
+    return capacity_;
+  }
+
+private:
+  QQueue<T> queue_;
+
+  int capacity_;
+
+  bool closed_;
+
+  bool aborted_;
+
+  QMutex mutex_;
+
+  QWaitCondition not_empty_;
+
+  QWaitCondition not_full_;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "cachestatistics.h"
+
+#include <algorithm>
+
+CacheStatistics::CacheStatistics() :
+  used_bytes(0),
+  budget(-1),
+  entries(0),
+  hits(0),
+  misses(0)
+{
+}
+
+double CacheStatistics::hit_rate() const
+{
+  qint64 lookups = hits + misses;
+
+  if (lookups == 0) {
+    return -1.0;
+  }
+
+  return static_cast<double>(hits) / static_cast<double>(lookups);
+}
+
+void CacheStatistics::AddConsumer(const QString &name, qint64 bytes, int entries)
+{
+  for (int i=0;i<consumers.size();i++) {
+    Consumer& c = consumers[i];
+
+    if (c.name == name) {
+      c.bytes = (c.bytes < 0 || bytes < 0) ? -1 : c.bytes + bytes;
+      c.entries += entries;
+      return;
+    }
+  }
+
+  consumers.append({name, bytes, entries});
+}
+
+void CacheStatistics::SortConsumers()
+{
+  // Consumers of unknown size are ordered by how many entries they hold
+  std::stable_sort(consumers.begin(), consumers.end(), [](const Consumer& a, const Consumer& b) {
+    if (a.bytes != b.bytes) {
+      return a.bytes > b.bytes;
+    }
+
+    return a.entries > b.entries;
+  });
+
+  if (consumers.size() > kMaxConsumers) {
+    consumers.resize(kMaxConsumers);
+  }
+}
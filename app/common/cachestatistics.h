@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CACHESTATISTICS_H
+#define CACHESTATISTICS_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief A snapshot of how full an application-wide cache is and how often it's been able to serve requests
+ *
+ * Caches return one of these from their statistics() function for the cache inspector panel. Hits and misses are
+ * counted since the application started.
+ */
+struct CacheStatistics {
+  /**
+   * @brief Something holding part of a cache (e.g. a file, a stream or a buffer size)
+   */
+  struct Consumer {
+    QString name;
+
+    // Bytes held, or -1 if the cache doesn't know
+    qint64 bytes;
+
+    int entries;
+  };
+
+  /**
+   * @brief Maximum number of consumers kept by SortConsumers()
+   */
+  static const int kMaxConsumers = 10;
+
+  CacheStatistics();
+
+  /**
+   * @brief Returns the fraction of lookups that were hits, or -1.0 if there haven't been any
+   */
+  double hit_rate() const;
+
+  /**
+   * @brief Add bytes and entries to the consumer with this name, adding it if it isn't listed yet
+   */
+  void AddConsumer(const QString& name, qint64 bytes, int entries = 1);
+
+  /**
+   * @brief Sort consumers from biggest to smallest and drop all but the first kMaxConsumers
+   */
+  void SortConsumers();
+
+  // Bytes held, or -1 if the cache doesn't know
+  qint64 used_bytes;
+
+  // Maximum bytes the cache may hold, or -1 if it isn't limited
+  qint64 budget;
+
+  int entries;
+
+  qint64 hits;
+  qint64 misses;
+
+  QVector<Consumer> consumers;
+};
+
+#endif // CACHESTATISTICS_H
@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framerunlist.h"
+
+#include <algorithm>
+
+FrameRunList::FrameRunList()
+{
+}
+
+void FrameRunList::Insert(int64_t frame)
+{
+  Insert(frame, frame);
+}
+
+void FrameRunList::Insert(int64_t first, int64_t last)
+{
+  if (last < first) {
+    return;
+  }
+
+  // Runs ending right before `first` touch it and are merged too
+  int index = FirstEndingFrom(first - 1);
+  int end = index;
+
+  Run merged = {first, last};
+
+  while (end < runs_.size() && runs_.at(end).first <= last + 1) {
+    merged.first = qMin(merged.first, runs_.at(end).first);
+    merged.last = qMax(merged.last, runs_.at(end).last);
+    end++;
+  }
+
+  if (end - index == 1) {
+    runs_[index] = merged;
+  } else {
+    runs_.remove(index, end - index);
+    runs_.insert(index, merged);
+  }
+}
+
+void FrameRunList::Insert(const FrameRunList &list)
+{
+  foreach (const Run& run, list.runs_) {
+    Insert(run.first, run.last);
+  }
+}
+
+void FrameRunList::Remove(int64_t frame)
+{
+  Remove(frame, frame);
+}
+
+void FrameRunList::Remove(int64_t first, int64_t last)
+{
+  if (last < first) {
+    return;
+  }
+
+  int index = FirstEndingFrom(first);
+
+  if (index == runs_.size() || runs_.at(index).first > last) {
+    return;
+  }
+
+  // Removing from the middle of a run leaves a piece on either side
+  if (runs_.at(index).first < first && runs_.at(index).last > last) {
+    Run after = {last + 1, runs_.at(index).last};
+    runs_[index].last = first - 1;
+    runs_.insert(index + 1, after);
+    return;
+  }
+
+  // Trim the run the range starts in
+  if (runs_.at(index).first < first) {
+    runs_[index].last = first - 1;
+    index++;
+  }
+
+  // Drop the runs it covers entirely and trim the one it ends in
+  int end = index;
+
+  while (end < runs_.size() && runs_.at(end).last <= last) {
+    end++;
+  }
+
+  if (end < runs_.size() && runs_.at(end).first <= last) {
+    runs_[end].first = last + 1;
+  }
+
+  runs_.remove(index, end - index);
+}
+
+bool FrameRunList::Contains(int64_t frame) const
+{
+  int index = FirstEndingFrom(frame);
+
+  return index < runs_.size() && runs_.at(index).first <= frame;
+}
+
+int64_t FrameRunList::RunEnd(int64_t frame) const
+{
+  int index = FirstEndingFrom(frame);
+
+  if (index < runs_.size() && runs_.at(index).first <= frame) {
+    return runs_.at(index).last;
+  }
+
+  return frame - 1;
+}
+
+QVector<FrameRunList::Run> FrameRunList::RunsBetween(int64_t first, int64_t last) const
+{
+  QVector<Run> runs;
+
+  for (int i=FirstEndingFrom(first);i<runs_.size() && runs_.at(i).first <= last;i++) {
+    Run r = {qMax(runs_.at(i).first, first), qMin(runs_.at(i).last, last)};
+    runs.append(r);
+  }
+
+  return runs;
+}
+
+int64_t FrameRunList::frame_count() const
+{
+  int64_t count = 0;
+
+  foreach (const Run& run, runs_) {
+    count += run.last - run.first + 1;
+  }
+
+  return count;
+}
+
+bool FrameRunList::isEmpty() const
+{
+  return runs_.isEmpty();
+}
+
+void FrameRunList::clear()
+{
+  runs_.clear();
+}
+
+const QVector<FrameRunList::Run> &FrameRunList::runs() const
+{
+  return runs_;
+}
+
+int FrameRunList::FirstEndingFrom(int64_t frame) const
+{
+  QVector<Run>::const_iterator i = std::lower_bound(runs_.constBegin(),
+                                                    runs_.constEnd(),
+                                                    frame,
+                                                    [](const Run& run, int64_t f) {
+    return run.last < f;
+  });
+
+  return static_cast<int>(i - runs_.constBegin());
+}
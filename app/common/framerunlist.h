@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMERUNLIST_H
+#define FRAMERUNLIST_H
+
+#include <cstdint>
+#include <QVector>
+
+/**
+ * @brief A set of frame numbers, stored as sorted runs of consecutive frames
+ *
+ * Long stretches (e.g. every frame of a rendered segment) take one run however many frames they cover, so whole
+ * timelines can be queried and drawn without touching every frame. Lookups are binary searches over the runs.
+ */
+class FrameRunList
+{
+public:
+  /**
+   * @brief Consecutive frames from first to last (inclusive)
+   */
+  struct Run {
+    int64_t first;
+    int64_t last;
+  };
+
+  FrameRunList();
+
+  void Insert(int64_t frame);
+
+  /**
+   * @brief Add the frames from first to last (inclusive), merging with any runs they overlap or touch
+   */
+  void Insert(int64_t first, int64_t last);
+
+  /**
+   * @brief Add every frame of another list
+   */
+  void Insert(const FrameRunList& list);
+
+  void Remove(int64_t frame);
+
+  /**
+   * @brief Remove the frames from first to last (inclusive), splitting any run they fall inside
+   */
+  void Remove(int64_t first, int64_t last);
+
+  bool Contains(int64_t frame) const;
+
+  /**
+   * @brief The last frame of the run containing `frame`, or `frame - 1` if it isn't in the set
+   *
+   * Useful for skipping over frames in the set, the first frame after it that isn't in the set is the result + 1.
+   */
+  int64_t RunEnd(int64_t frame) const;
+
+  /**
+   * @brief The runs overlapping first to last, clipped to that range (e.g. to draw the visible part of a timeline)
+   */
+  QVector<Run> RunsBetween(int64_t first, int64_t last) const;
+
+  /**
+   * @brief Number of frames in the set
+   */
+  int64_t frame_count() const;
+
+  bool isEmpty() const;
+
+  void clear();
+
+  /**
+   * @brief The runs, sorted and neither overlapping nor touching
+   */
+  const QVector<Run>& runs() const;
+
+private:
+  /**
+   * @brief Index of the first run ending at or after `frame`
+   */
+  int FirstEndingFrom(int64_t frame) const;
+
+  QVector<Run> runs_;
+};
+
+#endif // FRAMERUNLIST_H
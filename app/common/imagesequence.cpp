@@ -0,0 +1,185 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "imagesequence.h"
+
+#include <QHash>
+#include <QMap>
+
+ImageSequence::ImageSequence() :
+  digits_(0),
+  first_(0),
+  last_(-1)
+{
+}
+
+ImageSequence ImageSequence::FromFilename(const QString &filename)
+{
+  ImageSequence sequence;
+
+  int name_start = filename.lastIndexOf('/') + 1;
+  int extension_start = filename.lastIndexOf('.');
+
+  if (extension_start <= name_start
+      || !IsSequenceExtension(filename.mid(extension_start + 1).toLower())) {
+    return sequence;
+  }
+
+  // Walk back over the digits right before the extension
+  int number_start = extension_start;
+
+  while (number_start > name_start && filename.at(number_start - 1).isDigit()) {
+    number_start--;
+  }
+
+  int digits = extension_start - number_start;
+
+  // An int64_t can hold any 18 digit number
+  if (digits == 0 || digits > 18) {
+    return sequence;
+  }
+
+  bool ok;
+  int64_t frame = static_cast<int64_t>(filename.mid(number_start, digits).toLongLong(&ok));
+
+  if (!ok) {
+    return sequence;
+  }
+
+  sequence.prefix_ = filename.left(number_start);
+  sequence.suffix_ = filename.mid(extension_start);
+  sequence.digits_ = digits;
+  sequence.first_ = frame;
+  sequence.last_ = frame;
+
+  return sequence;
+}
+
+QList<ImageSequence> ImageSequence::Detect(const QList<QFileInfo> &files)
+{
+  // Numbered files by everything around their numbers, sorted by frame
+  QHash<QString, QMap<int64_t, ImageSequence> > groups;
+
+  foreach (const QFileInfo& info, files) {
+    if (!info.isFile()) {
+      continue;
+    }
+
+    ImageSequence frame = FromFilename(info.absoluteFilePath());
+
+    if (frame.IsValid()) {
+      groups[frame.prefix_ + '\n' + frame.suffix_].insert(frame.first_, frame);
+    }
+  }
+
+  QList<ImageSequence> sequences;
+
+  foreach (const QMap<int64_t, ImageSequence>& group, groups) {
+    ImageSequence run;
+
+    for (QMap<int64_t, ImageSequence>::const_iterator i=group.constBegin();i!=group.constEnd();i++) {
+      const ImageSequence& frame = i.value();
+
+      // Extend the run if this is its next frame and is named the way the run numbers its frames
+      if (run.IsValid()
+          && frame.first_ == run.last_ + 1
+          && run.FrameFilename(frame.first_) == frame.FrameFilename(frame.first_)) {
+        run.last_ = frame.first_;
+        continue;
+      }
+
+      if (run.frame_count() >= kMinimumFrames) {
+        sequences.append(run);
+      }
+
+      run = frame;
+    }
+
+    if (run.frame_count() >= kMinimumFrames) {
+      sequences.append(run);
+    }
+  }
+
+  return sequences;
+}
+
+bool ImageSequence::IsSequenceExtension(const QString &extension)
+{
+  return extension == "exr"
+      || extension == "dpx"
+      || extension == "png"
+      || extension == "tif"
+      || extension == "tiff";
+}
+
+bool ImageSequence::IsValid() const
+{
+  return last_ >= first_;
+}
+
+int64_t ImageSequence::first() const
+{
+  return first_;
+}
+
+int64_t ImageSequence::last() const
+{
+  return last_;
+}
+
+int64_t ImageSequence::frame_count() const
+{
+  return last_ - first_ + 1;
+}
+
+void ImageSequence::SetRange(int64_t first, int64_t last)
+{
+  first_ = first;
+  last_ = last;
+}
+
+QString ImageSequence::FrameFilename(int64_t frame) const
+{
+  return prefix_ + QString::number(frame).rightJustified(digits_, '0') + suffix_;
+}
+
+QString ImageSequence::Name() const
+{
+  QString prefix = prefix_.mid(prefix_.lastIndexOf('/') + 1);
+
+  return QStringLiteral("%1[%2-%3]%4").arg(prefix,
+                                           QString::number(first_).rightJustified(digits_, '0'),
+                                           QString::number(last_).rightJustified(digits_, '0'),
+                                           suffix_);
+}
+
+QString ImageSequence::extension() const
+{
+  return suffix_.mid(1).toLower();
+}
+
+bool ImageSequence::operator==(const ImageSequence &other) const
+{
+  return prefix_ == other.prefix_
+      && suffix_ == other.suffix_
+      && digits_ == other.digits_
+      && first_ == other.first_
+      && last_ == other.last_;
+}
@@ -0,0 +1,104 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef IMAGESEQUENCE_H
+#define IMAGESEQUENCE_H
+
+#include <QFileInfo>
+#include <QList>
+#include <QString>
+#include <stdint.h>
+
+/**
+ * @brief A run of consecutively numbered still images used as one video stream (e.g. plate.1001.dpx to plate.1240.dpx)
+ *
+ * The frame number is the last run of digits before the file's extension. Numbers are zero-padded to the width of
+ * the first frame's number, so both padded ("0998", "0999", "1000") and unpadded ("9", "10") numbering work. Only
+ * still formats that are delivered as sequences are recognized (see IsSequenceExtension()).
+ *
+ * A default constructed ImageSequence is invalid, which is what regular (non-sequence) Footage uses.
+ */
+class ImageSequence
+{
+public:
+  ImageSequence();
+
+  /**
+   * @brief The sequence a file would belong to, containing only that file's frame
+   *
+   * Invalid if the file has no frame number or isn't a sequence format. Use SetRange() to cover the other frames.
+   */
+  static ImageSequence FromFilename(const QString& filename);
+
+  /**
+   * @brief Find the sequences in a directory's files
+   *
+   * Files that aren't part of a run of at least kMinimumFrames consecutive frames aren't in any sequence (a couple of
+   * numbered stills are more likely to be separate images than a sequence).
+   */
+  static QList<ImageSequence> Detect(const QList<QFileInfo>& files);
+
+  /**
+   * @brief Returns TRUE for the (lowercase) extensions of formats delivered as sequences (EXR, DPX, PNG, TIFF)
+   */
+  static bool IsSequenceExtension(const QString& extension);
+
+  bool IsValid() const;
+
+  int64_t first() const;
+
+  int64_t last() const;
+
+  int64_t frame_count() const;
+
+  void SetRange(int64_t first, int64_t last);
+
+  /**
+   * @brief Absolute filename of a frame
+   */
+  QString FrameFilename(int64_t frame) const;
+
+  /**
+   * @brief Name shown for the sequence, e.g. "plate.[1001-1240].dpx"
+   */
+  QString Name() const;
+
+  /**
+   * @brief Lowercase extension of the sequence's files
+   */
+  QString extension() const;
+
+  bool operator==(const ImageSequence& other) const;
+
+  static const int kMinimumFrames = 3;
+
+private:
+  // Everything before the frame number (including the directory) and after it (including the extension)
+  QString prefix_;
+  QString suffix_;
+
+  // Width frame numbers are zero-padded to
+  int digits_;
+
+  int64_t first_;
+  int64_t last_;
+};
+
+#endif // IMAGESEQUENCE_H
@@ -0,0 +1,306 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorypressure.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MAC)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#endif
+
+MemoryPressure olive::memory_pressure;
+
+// How often the level is read
+const int kPollInterval = 1000;
+
+// Polls the level must stay lower for before it falls
+const int kCalmPolls = 10;
+
+#ifdef Q_OS_LINUX
+// Fraction of the cgroup limit or of total memory in use at each level
+const double kWarningUsage = 0.80;
+const double kCriticalUsage = 0.90;
+
+// Percentage of the last 10 seconds some (or all) tasks were stalled waiting for memory at each level
+const double kWarningStall = 10.0;
+const double kCriticalStall = 5.0;
+
+/**
+ * @brief Read a file of "key value" lines (e.g. memory.stat or /proc/meminfo) into a hash
+ */
+static QHash<QString, qint64> ReadKeyValues(const QString& filename)
+{
+  QHash<QString, qint64> values;
+
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return values;
+  }
+
+  foreach (const QByteArray& line, file.readAll().split('\n')) {
+    QList<QByteArray> parts = line.simplified().split(' ');
+
+    if (parts.size() >= 2) {
+      QByteArray key = parts.at(0);
+
+      // /proc/meminfo has a trailing colon and values in kB
+      if (key.endsWith(':')) {
+        key.chop(1);
+        values.insert(QString::fromLatin1(key), parts.at(1).toLongLong() * 1024);
+      } else {
+        values.insert(QString::fromLatin1(key), parts.at(1).toLongLong());
+      }
+    }
+  }
+
+  return values;
+}
+
+/**
+ * @brief Read a file containing a single number, returns -1 if it doesn't (e.g. memory.max is "max" without a limit)
+ */
+static qint64 ReadNumber(const QString& filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return -1;
+  }
+
+  bool ok;
+  qint64 value = file.readAll().trimmed().toLongLong(&ok);
+
+  return ok ? value : -1;
+}
+
+/**
+ * @brief Fraction of the cgroup memory limit in use, or -1 if there's no limit
+ *
+ * Usage excludes inactive file cache, which the kernel reclaims before killing anything.
+ */
+static double CgroupUsage()
+{
+  // cgroup v2
+  qint64 limit = ReadNumber(QStringLiteral("/sys/fs/cgroup/memory.max"));
+
+  if (limit > 0) {
+    qint64 usage = ReadNumber(QStringLiteral("/sys/fs/cgroup/memory.current"));
+
+    if (usage < 0) {
+      return -1;
+    }
+
+    usage -= ReadKeyValues(QStringLiteral("/sys/fs/cgroup/memory.stat")).value(QStringLiteral("inactive_file"));
+
+    return static_cast<double>(usage) / static_cast<double>(limit);
+  }
+
+  // cgroup v1, where no limit is reported as a huge number
+  limit = ReadNumber(QStringLiteral("/sys/fs/cgroup/memory/memory.limit_in_bytes"));
+
+  qint64 total = ReadKeyValues(QStringLiteral("/proc/meminfo")).value(QStringLiteral("MemTotal"));
+
+  if (limit <= 0 || (total > 0 && limit >= total)) {
+    return -1;
+  }
+
+  qint64 usage = ReadNumber(QStringLiteral("/sys/fs/cgroup/memory/memory.usage_in_bytes"));
+
+  if (usage < 0) {
+    return -1;
+  }
+
+  usage -= ReadKeyValues(QStringLiteral("/sys/fs/cgroup/memory/memory.stat"))
+      .value(QStringLiteral("total_inactive_file"));
+
+  return static_cast<double>(usage) / static_cast<double>(limit);
+}
+
+/**
+ * @brief Read the avg10 of the "some" and "full" lines of /proc/pressure/memory (kernel 4.20+)
+ */
+static void ReadStall(double* some, double* full)
+{
+  *some = 0;
+  *full = 0;
+
+  QFile file(QStringLiteral("/proc/pressure/memory"));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  foreach (const QByteArray& line, file.readAll().split('\n')) {
+    QList<QByteArray> parts = line.split(' ');
+
+    foreach (const QByteArray& part, parts) {
+      if (part.startsWith("avg10=")) {
+        double value = part.mid(6).toDouble();
+
+        if (line.startsWith("some")) {
+          *some = value;
+        } else if (line.startsWith("full")) {
+          *full = value;
+        }
+      }
+    }
+  }
+}
+#endif
+
+MemoryPressure::MemoryPressure() :
+  level_(kNormal),
+  calm_polls_(0)
+{
+  timer_.setInterval(kPollInterval);
+
+  connect(&timer_, SIGNAL(timeout()), this, SLOT(Poll()));
+}
+
+void MemoryPressure::Start()
+{
+  timer_.start();
+
+  Poll();
+}
+
+void MemoryPressure::Stop()
+{
+  timer_.stop();
+}
+
+MemoryPressure::Level MemoryPressure::level()
+{
+  return level_;
+}
+
+MemoryPressure::Level MemoryPressure::ReadLevel()
+{
+#if defined(Q_OS_LINUX)
+  Level level = kNormal;
+
+  double cgroup = CgroupUsage();
+
+  if (cgroup >= kCriticalUsage) {
+    return kCritical;
+  } else if (cgroup >= kWarningUsage) {
+    level = kWarning;
+  }
+
+  double some, full;
+  ReadStall(&some, &full);
+
+  if (full >= kCriticalStall) {
+    return kCritical;
+  } else if (some >= kWarningStall) {
+    level = kWarning;
+  }
+
+  QHash<QString, qint64> meminfo = ReadKeyValues(QStringLiteral("/proc/meminfo"));
+
+  qint64 total = meminfo.value(QStringLiteral("MemTotal"));
+
+  if (total > 0 && meminfo.contains(QStringLiteral("MemAvailable"))) {
+    double used = 1.0 - static_cast<double>(meminfo.value(QStringLiteral("MemAvailable"))) / static_cast<double>(total);
+
+    if (used >= kCriticalUsage) {
+      return kCritical;
+    } else if (used >= kWarningUsage) {
+      level = kWarning;
+    }
+  }
+
+  return level;
+#elif defined(Q_OS_MAC)
+  int pressure = 0;
+  size_t size = sizeof(pressure);
+
+  if (sysctlbyname("kern.memorystatus_vm_pressure_level", &pressure, &size, nullptr, 0) != 0) {
+    return kNormal;
+  }
+
+  // DISPATCH_MEMORYPRESSURE_WARN is 2, DISPATCH_MEMORYPRESSURE_CRITICAL is 4
+  if (pressure >= 4) {
+    return kCritical;
+  } else if (pressure >= 2) {
+    return kWarning;
+  }
+
+  return kNormal;
+#elif defined(Q_OS_WIN)
+  static HANDLE low_memory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+
+  BOOL low = FALSE;
+
+  if (low_memory != nullptr && QueryMemoryResourceNotification(low_memory, &low) && low) {
+    return kCritical;
+  }
+
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+
+  // Percentage of physical memory in use
+  if (GlobalMemoryStatusEx(&status) && status.dwMemoryLoad >= 85) {
+    return kWarning;
+  }
+
+  return kNormal;
+#else
+  return kNormal;
+#endif
+}
+
+void MemoryPressure::Poll()
+{
+  Level level = ReadLevel();
+
+  if (level > level_) {
+    calm_polls_ = 0;
+  } else if (level < level_) {
+    calm_polls_++;
+
+    if (calm_polls_ < kCalmPolls) {
+      return;
+    }
+
+    calm_polls_ = 0;
+  } else {
+    calm_polls_ = 0;
+    return;
+  }
+
+  if (level > level_) {
+    qWarning() << "Memory pressure rose to level" << level;
+  } else {
+    qDebug() << "Memory pressure fell to level" << level;
+  }
+
+  level_ = level;
+
+  emit LevelChanged(level_);
+}
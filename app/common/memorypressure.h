@@ -0,0 +1,101 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYPRESSURE_H
+#define MEMORYPRESSURE_H
+
+#include <QObject>
+#include <QTimer>
+
+/**
+ * @brief Watches how close the system (or the container Olive runs in) is to running out of memory
+ *
+ * The level is polled from what each OS reports:
+ *
+ * * Linux: the cgroup's memory limit (v2 or v1) against its working set (usage minus inactive file cache), Pressure
+ *   Stall Information from /proc/pressure/memory and MemAvailable from /proc/meminfo. In a container, the cgroup limit
+ *   is what gets the process killed, usually without any other warning.
+ * * macOS: the kernel's memory pressure level (kern.memorystatus_vm_pressure_level).
+ * * Windows: the low memory resource notification and the system's memory load.
+ *
+ * The level rises as soon as a poll sees more pressure, but only falls once it's stayed lower for several polls, so
+ * caches don't grow back and get shrunk again over and over. Start() must be called from the main thread once the
+ * application instance exists.
+ *
+ * Use the application-wide olive::memory_pressure.
+ */
+class MemoryPressure : public QObject
+{
+  Q_OBJECT
+public:
+  enum Level {
+    /// Plenty of memory, caches can use their full budgets
+    kNormal,
+
+    /// Memory is getting short, free what's cheap to get back
+    kWarning,
+
+    /// Close to running out, free everything that isn't needed right now
+    kCritical
+  };
+
+  MemoryPressure();
+
+  /**
+   * @brief Start polling (every second)
+   */
+  void Start();
+
+  void Stop();
+
+  Level level();
+
+  /**
+   * @brief Read the current level from the OS without any smoothing
+   */
+  static Level ReadLevel();
+
+signals:
+  /**
+   * @brief Emitted on the main thread when the level changes
+   */
+  void LevelChanged(MemoryPressure::Level level);
+
+private:
+  QTimer timer_;
+
+  Level level_;
+
+  // Consecutive polls that read a lower level than level_
+  int calm_polls_;
+
+private slots:
+  void Poll();
+
+};
+
+namespace olive {
+/**
+ * @brief Application-wide memory pressure monitor
+ */
+extern MemoryPressure memory_pressure;
+}
+
+#endif // MEMORYPRESSURE_H
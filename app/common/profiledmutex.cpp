@@ -0,0 +1,205 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "profiledmutex.h"
+
+#ifdef OLIVE_LOCK_PROFILING
+
+#include <chrono>
+#include <QHash>
+#include <QMutexLocker>
+
+#include "tracing.h"
+
+struct ProfiledMutex::Stats {
+  const char* name;
+
+  QAtomicInteger<qint64> acquisitions;
+  QAtomicInteger<qint64> contentions;
+  QAtomicInteger<qint64> wait_nsecs;
+  QAtomicInteger<qint64> max_wait_nsecs;
+  QAtomicInteger<qint64> hold_nsecs;
+  QAtomicInteger<qint64> max_hold_nsecs;
+};
+
+namespace {
+
+// Statistics of every name, never freed since mutexes may be destroyed and created again at any time
+QMutex stats_mutex;
+QHash<QByteArray, ProfiledMutex::Stats*> stats_by_name;
+
+qint64 Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StoreMax(QAtomicInteger<qint64>& max, qint64 value)
+{
+  qint64 current = max.load();
+
+  while (value > current && !max.testAndSetRelaxed(current, value)) {
+    current = max.load();
+  }
+}
+
+}
+
+ProfiledMutex::ProfiledMutex(const char *name) :
+  name_(name),
+  acquired_(0)
+{
+  QByteArray key(name);
+
+  QMutexLocker locker(&stats_mutex);
+
+  stats_ = stats_by_name.value(key);
+
+  if (stats_ == nullptr) {
+    stats_ = new Stats();
+    stats_->name = name;
+    stats_by_name.insert(key, stats_);
+  }
+}
+
+void ProfiledMutex::lock()
+{
+  if (mutex_.tryLock()) {
+    acquired_ = Now();
+    stats_->acquisitions.fetchAndAddRelaxed(1);
+    return;
+  }
+
+  // Someone else has it, this is what we're here to measure
+  qint64 start = Now();
+
+  {
+    Tracing::Span span("lock", name_);
+
+    mutex_.lock();
+  }
+
+  acquired_ = Now();
+
+  qint64 wait = acquired_ - start;
+
+  stats_->acquisitions.fetchAndAddRelaxed(1);
+  stats_->contentions.fetchAndAddRelaxed(1);
+  stats_->wait_nsecs.fetchAndAddRelaxed(wait);
+  StoreMax(stats_->max_wait_nsecs, wait);
+}
+
+bool ProfiledMutex::tryLock()
+{
+  if (!mutex_.tryLock()) {
+    return false;
+  }
+
+  acquired_ = Now();
+  stats_->acquisitions.fetchAndAddRelaxed(1);
+
+  return true;
+}
+
+void ProfiledMutex::unlock()
+{
+  qint64 hold = Now() - acquired_;
+
+  mutex_.unlock();
+
+  stats_->hold_nsecs.fetchAndAddRelaxed(hold);
+  StoreMax(stats_->max_hold_nsecs, hold);
+}
+
+bool ProfiledMutex::Wait(QWaitCondition *cond, unsigned long time)
+{
+  qint64 hold = Now() - acquired_;
+
+  stats_->hold_nsecs.fetchAndAddRelaxed(hold);
+  StoreMax(stats_->max_hold_nsecs, hold);
+
+  bool woken = cond->wait(&mutex_, time);
+
+  // Reacquired, which counts as a new hold
+  acquired_ = Now();
+
+  return woken;
+}
+
+bool LockProfiling::IsAvailable()
+{
+  return true;
+}
+
+QVector<LockProfiling::Summary> LockProfiling::Summaries()
+{
+  QMutexLocker locker(&stats_mutex);
+
+  QVector<Summary> summaries;
+  summaries.reserve(stats_by_name.size());
+
+  foreach (ProfiledMutex::Stats* s, stats_by_name) {
+    Summary summary;
+
+    summary.name = QString::fromLatin1(s->name);
+    summary.acquisitions = s->acquisitions.load();
+    summary.contentions = s->contentions.load();
+    summary.wait_nsecs = s->wait_nsecs.load();
+    summary.max_wait_nsecs = s->max_wait_nsecs.load();
+    summary.hold_nsecs = s->hold_nsecs.load();
+    summary.max_hold_nsecs = s->max_hold_nsecs.load();
+
+    summaries.append(summary);
+  }
+
+  return summaries;
+}
+
+void LockProfiling::Reset()
+{
+  QMutexLocker locker(&stats_mutex);
+
+  foreach (ProfiledMutex::Stats* s, stats_by_name) {
+    s->acquisitions.store(0);
+    s->contentions.store(0);
+    s->wait_nsecs.store(0);
+    s->max_wait_nsecs.store(0);
+    s->hold_nsecs.store(0);
+    s->max_hold_nsecs.store(0);
+  }
+}
+
+#else
+
+bool LockProfiling::IsAvailable()
+{
+  return false;
+}
+
+QVector<LockProfiling::Summary> LockProfiling::Summaries()
+{
+  return QVector<LockProfiling::Summary>();
+}
+
+void LockProfiling::Reset()
+{
+}
+
+#endif
@@ -0,0 +1,179 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROFILEDMUTEX_H
+#define PROFILEDMUTEX_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+#ifdef OLIVE_LOCK_PROFILING
+#include <QAtomicInteger>
+#endif
+
+/**
+ * @brief A QMutex that can record how it's used, to find locks threads queue up on
+ *
+ * When Olive is built with LOCK_PROFILING (which defines OLIVE_LOCK_PROFILING), every ProfiledMutex counts how often
+ * it's acquired, how often a thread had to wait for it and for how long, and how long it's held. Mutexes with the same
+ * name add up to one set of statistics (e.g. every Item's mutex), see LockProfiling. Waits also appear as spans in the
+ * "lock" category while tracing (see Tracing), and Tracing::Stop() adds every lock's totals to the trace.
+ *
+ * Otherwise it's a plain QMutex with no overhead.
+ *
+ * Lock with ProfiledMutexLocker rather than QMutexLocker, and wait on a QWaitCondition with Wait().
+ */
+class ProfiledMutex
+{
+public:
+  /**
+   * @param name
+   *
+   * Name to record statistics under. Must be a string literal (or otherwise outlive the mutex and the trace).
+   */
+  explicit ProfiledMutex(const char* name);
+
+  ProfiledMutex(const ProfiledMutex& other) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex& other) = delete;
+
+  void lock();
+
+  bool tryLock();
+
+  void unlock();
+
+  /**
+   * @brief Wait on a condition with this mutex (which must be locked), time spent waiting isn't counted as held
+   */
+  bool Wait(QWaitCondition* cond, unsigned long time = ULONG_MAX);
+
+#ifdef OLIVE_LOCK_PROFILING
+  // Shared by every mutex with the same name
+  struct Stats;
+#endif
+
+private:
+  QMutex mutex_;
+
+#ifdef OLIVE_LOCK_PROFILING
+  const char* name_;
+
+  Stats* stats_;
+
+  // When the mutex was acquired, only valid while it's locked
+  qint64 acquired_;
+#endif
+};
+
+/**
+ * @brief QMutexLocker for ProfiledMutex
+ */
+class ProfiledMutexLocker
+{
+public:
+  explicit ProfiledMutexLocker(ProfiledMutex* mutex) :
+    mutex_(mutex)
+  {
+    mutex_->lock();
+  }
+
+  ~ProfiledMutexLocker()
+  {
+    mutex_->unlock();
+  }
+
+  ProfiledMutexLocker(const ProfiledMutexLocker& other) = delete;
+  ProfiledMutexLocker& operator=(const ProfiledMutexLocker& other) = delete;
+
+private:
+  ProfiledMutex* mutex_;
+};
+
+/**
+ * @brief Statistics recorded by every ProfiledMutex (only available with OLIVE_LOCK_PROFILING)
+ */
+class LockProfiling
+{
+public:
+  /**
+   * @brief Totals for every mutex with one name
+   */
+  struct Summary {
+    QString name;
+
+    qint64 acquisitions;
+
+    // Acquisitions that had to wait for another thread
+    qint64 contentions;
+
+    qint64 wait_nsecs;
+    qint64 max_wait_nsecs;
+
+    qint64 hold_nsecs;
+    qint64 max_hold_nsecs;
+  };
+
+  /**
+   * @brief Returns TRUE if Olive was built with lock profiling
+   */
+  static bool IsAvailable();
+
+  /**
+   * @brief Returns the totals of every name since the last Reset() (empty without lock profiling)
+   */
+  static QVector<Summary> Summaries();
+
+  /**
+   * @brief Set every total to zero (Tracing::Start() does this so a trace only covers its own time)
+   */
+  static void Reset();
+};
+
+#ifndef OLIVE_LOCK_PROFILING
+
+inline ProfiledMutex::ProfiledMutex(const char *)
+{
+}
+
+inline void ProfiledMutex::lock()
+{
+  mutex_.lock();
+}
+
+inline bool ProfiledMutex::tryLock()
+{
+  return mutex_.tryLock();
+}
+
+inline void ProfiledMutex::unlock()
+{
+  mutex_.unlock();
+}
+
+inline bool ProfiledMutex::Wait(QWaitCondition *cond, unsigned long time)
+{
+  return cond->wait(&mutex_, time);
+}
+
+#endif
+
+#endif // PROFILEDMUTEX_H
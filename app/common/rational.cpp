@@ -20,283 +20,78 @@
 
 #include "rational.h"
 
-rational::rational(const int64_t &numerator) :
-  numerator_(numerator),
-  denominator_(1)
-{
-  if (numerator_ == 0) {
-    denominator_ = 0;
-  }
-}
-
-rational::rational(const int64_t &numerator, const int64_t &denominator) :
-  numerator_(numerator),
-  denominator_(denominator)
-{
-  if (denominator_ != 0) {
-
-    if (numerator_ != 0) {
-      FixSigns();
-      Reduce();
-    } else {
-      denominator_ = 0;
-    }
-
-  } else {
-    numerator_ = 0;
-  }
-}
-
 rational::rational(const AVRational &r) :
   numerator_(r.num),
   denominator_(r.den)
 {
+  // FFmpeg's rationals aren't necessarily reduced, and store zero as 0/1
+  Normalize();
 }
 
-rational::rational(const rational &r) :
-  numerator_(r.numerator_),
-  denominator_(r.denominator_)
-{
-}
-
-const rational &rational::operator=(const rational &r)
-{
-  if (this != &r) {
-    numerator_ = r.numerator_;
-    denominator_ = r.denominator_;
-  }
-
-  return *this;
-}
-
-const rational &rational::operator+=(const rational &r)
-{
-  if (numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ == 0) {
-    numerator_ = 0;
-    denominator_ = 0;
-  } else {
-    if(numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-      // The other rational == 0, no addition needs to be done
-    } else {
-      if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0)
-      {
-        numerator_ = r.numerator_;
-        denominator_ = r.denominator_;
-      }
-      else
-      {
-        numerator_ = (numerator_ * r.denominator_) + (r.numerator_ * denominator_);
-        denominator_ = denominator_ * r.denominator_;
-        FixSigns();
-        Reduce();
-      }
-    }
-  }
-  return *this;
-}
-
-const rational &rational::operator-=(const rational &r)
+const rational &rational::operator/=(const rational &r)
 {
-  if(numerator_ * denominator_ == 0 && r.numerator_ * r.numerator_ == 0) {
+  if (numerator_ == 0 || r.numerator_ == 0) {
+    // Dividing by zero gives zero, like every other operation on zero denominators
     numerator_ = 0;
     denominator_ = 0;
-  } else {
-    if(numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-
-    } else {
-      if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0) {
-        numerator_ = -(r.numerator_);
-        denominator_ = r.denominator_;
-      } else {
-        numerator_ = (numerator_ * r.denominator_) - (r.numerator_ * denominator_);
-        numerator_ = denominator_ * r.denominator_;
-        FixSigns();
-        Reduce();
-      }
-    }
+    return *this;
   }
-  return *this;
-}
 
-const rational &rational::operator/=(const rational &r)
-{
-  numerator_ = numerator_ * r.denominator_;
-  denominator_ = denominator_ * r.numerator_;
-  FixSigns();
-  Reduce();
+  // Multiply by the reciprocal
+  SetWide(static_cast<rational_wide_t>(numerator_) * static_cast<rational_wide_t>(r.denominator_),
+          static_cast<rational_wide_t>(denominator_) * static_cast<rational_wide_t>(r.numerator_));
   return *this;
 }
 
 const rational &rational::operator*=(const rational &r)
 {
-  numerator_ = numerator_ * r.numerator_;
-  denominator_ = denominator_ * r.denominator_;
-  FixSigns();
-  Reduce();
-  return *this;
-}
-
-rational rational::operator+(const rational &r) const
-{
-  rational result(*this);
-  result += r;
-  return result;
-}
-
-rational rational::operator-(const rational &r) const
-{
-  rational result(*this);
-  result -= r;
-  return result;
-}
-
-rational rational::operator/(const rational &r) const
-{
-  rational result(*this);
-  result /= r;
-  return result;
-}
-
-rational rational::operator*(const rational &r) const
-{
-  rational result(*this);
-  result *= r;
-  return result;
-}
-
-bool rational::operator<(const rational &r) const
-{
-  if (numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ == 0) {
-    return false;
-  } else {
-    if (numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-      if(numerator_ * denominator_ < 0)
-        return true;
-      else
-        return false;
-    }
-    else {
-      if (numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0) {
-        if (r.numerator_ * r.denominator_ < 0) {
-          return false;
-        } else {
-          return true;
-        }
-      } else {
-        return ((numerator_ * r.denominator_) < (denominator_ * r.numerator_));
-      }
-    }
-  }
-}
-
-bool rational::operator<=(const rational &r) const
-{
-  if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ == 0) {
-    return true;
-  } else {
-    if(numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-      if(numerator_ * denominator_ < 0) {
-        return true;
-      } else {
-        return false;
-      }
-    } else {
-      if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0) {
-        if(r.numerator_ * r.denominator_ < 0) {
-          return false;
-        } else {
-          return true;
-        }
-      } else {
-        return ((numerator_ * r.denominator_) <= (denominator_ * r.numerator_));
-      }
-    }
+  if (numerator_ == 0 || r.numerator_ == 0) {
+    numerator_ = 0;
+    denominator_ = 0;
+    return *this;
   }
-}
 
-bool rational::operator>(const rational &r) const
-{
-  if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ == 0) {
-    return false;
-  } else {
-    if(numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-      if(numerator_ * denominator_ > 0) {
-        return true;
-      } else {
-        return false;
-      }
-    } else {
-      if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0) {
-        if(r.numerator_ * r.denominator_ > 0) {
-          return false;
-        } else {
-          return true;
-        }
-      } else {
-        return ((numerator_ * r.denominator_) > (denominator_ * r.numerator_));
-      }
-    }
-  }
-}
+#if defined(__GNUC__)
+  // Multiplying by an integer (e.g. a timebase by a frame number) stays in 64 bits unless it overflows
+  if (r.denominator_ == 1) {
+    int64_t product;
 
-bool rational::operator>=(const rational &r) const
-{
-  if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ == 0) {
-    return true;
-  } else {
-    if(numerator_ * denominator_ != 0 && r.numerator_ * r.denominator_ == 0) {
-      if(numerator_ * denominator_ > 0) {
-        return true;
-      } else {
-        return false;
-      }
-    } else {
-      if(numerator_ * denominator_ == 0 && r.numerator_ * r.denominator_ != 0) {
-        if(r.numerator_ * r.denominator_ > 0) {
-          return false;
-        } else {
-          return true;
-        }
-      } else {
-        return ((numerator_ * r.denominator_) >= (denominator_ * r.numerator_));
-      }
+    if (!__builtin_mul_overflow(numerator_, r.numerator_, &product)) {
+      numerator_ = product;
+      Reduce();
+      return *this;
     }
   }
-}
-
-bool rational::operator==(const rational &r) const
-{
-  return (numerator_ == r.numerator_ && denominator_ == r.denominator_);
-}
+#endif
 
-bool rational::operator!=(const rational &r) const
-{
-  return (numerator_ != r.numerator_) || (denominator_ != r.denominator_);
+  SetWide(static_cast<rational_wide_t>(numerator_) * static_cast<rational_wide_t>(r.numerator_),
+          static_cast<rational_wide_t>(denominator_) * static_cast<rational_wide_t>(r.denominator_));
+  return *this;
 }
 
 const rational &rational::operator++()
 {
-  numerator_ += denominator_;
+  *this += rational(1);
   return *this;
 }
 
 rational rational::operator++(int)
 {
   rational tmp = *this;
-  numerator_ += denominator_;
+  *this += rational(1);
   return tmp;
 }
 
 const rational &rational::operator--()
 {
-  numerator_ -= denominator_;
+  *this -= rational(1);
   return *this;
 }
 
 rational rational::operator--(int)
 {
-  rational tmp;
-  numerator_ -= denominator_;
+  rational tmp = *this;
+  *this -= rational(1);
   return tmp;
 }
 
@@ -305,33 +100,82 @@ const rational &rational::operator+() const
   return *this;
 }
 
-rational rational::operator-() const
-{
-  return rational(numerator_, -denominator_);
-}
-
 bool rational::operator!() const
 {
   return !numerator_;
 }
 
-double rational::ToDouble() const
+void rational::Add(int64_t n, int64_t d)
 {
-  if (denominator_ == 0) {
-    return 0;
-  } else {
-    return static_cast<double>(numerator_)/static_cast<double>(denominator_);
+  if (n == 0 || d == 0) {
+    // Adding zero
+    return;
   }
+
+  if (numerator_ == 0) {
+    // Zero plus a value is that value
+    numerator_ = n;
+    denominator_ = d;
+    return;
+  }
+
+  // Only multiply by the parts of the denominators that differ so the intermediates stay small
+  int64_t g = GreatestCommonDenominator(denominator_, d);
+
+  rational_wide_t this_factor = static_cast<rational_wide_t>(d / g);
+  rational_wide_t other_factor = static_cast<rational_wide_t>(denominator_ / g);
+
+  SetWide(static_cast<rational_wide_t>(numerator_) * this_factor + static_cast<rational_wide_t>(n) * other_factor,
+          static_cast<rational_wide_t>(denominator_) * this_factor);
 }
 
-const int64_t &rational::numerator()
+void rational::SetWide(rational_wide_t n, rational_wide_t d)
 {
-  return numerator_;
+  if (n == 0 || d == 0) {
+    numerator_ = 0;
+    denominator_ = 0;
+    return;
+  }
+
+  if (d < 0) {
+    n = -n;
+    d = -d;
+  }
+
+#if defined(OLIVE_RATIONAL_HAS_INT128)
+  // Reduce in 128 bits first, most results fit in 64 bits again once they're reduced
+  rational_wide_t x = (n < 0) ? -n : n;
+  rational_wide_t y = d;
+
+  while (y != 0) {
+    rational_wide_t tmp = x % y;
+    x = y;
+    y = tmp;
+  }
+
+  if (x > 1) {
+    n /= x;
+    d /= x;
+  }
+#endif
+
+  const rational_wide_t max = static_cast<rational_wide_t>(INT64_MAX);
+
+  while (n > max || n < -max || d > max) {
+    n /= 2;
+    d /= 2;
+  }
+
+  numerator_ = static_cast<int64_t>(n);
+  denominator_ = static_cast<int64_t>(d);
+
+  Normalize();
 }
 
-const int64_t &rational::denominator()
+void rational::Normalize()
 {
-  return denominator_;
+  FixSigns();
+  Reduce();
 }
 
 void rational::FixSigns()
@@ -351,26 +195,31 @@ void rational::FixSigns()
 
 void rational::Reduce()
 {
-  int64_t d = 1;
-
-  if(denominator_ != 0 && numerator_ != 0) {
-    d = GreatestCommonDenominator(numerator_, denominator_);
+  if (denominator_ == 1 || numerator_ == 0) {
+    return;
   }
 
+  int64_t d = GreatestCommonDenominator(numerator_, denominator_);
+
   if(d > 1) {
     numerator_ /= d;
     denominator_ /= d;
   }
 }
 
-int64_t rational::GreatestCommonDenominator(const int64_t& x, const int64_t& y)
+int64_t rational::GreatestCommonDenominator(int64_t x, int64_t y)
 {
-  if (y == 0) {
-    return x;
-  } else {
+  if (x < 0) {
+    x = -x;
+  }
+
+  while (y != 0) {
     int64_t tmp = x % y;
-    return GreatestCommonDenominator(y, tmp);
+    x = y;
+    y = tmp;
   }
+
+  return x;
 }
 
 std::ostream &operator<<(std::ostream &out, const rational &value)
@@ -397,8 +246,7 @@ std::istream &operator>>(std::istream &in, rational &value)
     if(ch == '/')
     {
       in >> value.denominator_;
-      value.FixSigns();
-      value.Reduce();
+      value.Normalize();
     }
     else
       in.putback(ch);
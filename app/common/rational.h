@@ -23,6 +23,7 @@
 
 // Adapted from https://github.com/angularadam/Qt-Class-rational used in compliance with the GNU General Public License
 
+#include <cstdint>
 #include <iostream>
 
 /**
@@ -32,40 +33,127 @@ extern "C" {
   #include <libavformat/avformat.h>
 }
 
+#if defined(__SIZEOF_INT128__)
+/**
+ * 128-bit intermediates so products of two 64-bit values can't overflow (__extension__ keeps -pedantic quiet about
+ * the type not being standard). Compilers without it (e.g. MSVC) fall back to long double.
+ */
+__extension__ typedef __int128 rational_wide_t;
+#define OLIVE_RATIONAL_HAS_INT128
+#else
+typedef long double rational_wide_t;
+#endif
+
 /**
  * @brief A rational (numerator/denominator) class with C++ operations built in for ease of use.
  *
  * Rationals in Olive most frequently represent timing information to easily handle timing in various different
  * frame/sample rates without the inaccuracy/rounding errors of a floating point type.
+ *
+ * Values are always stored reduced with a positive denominator, and zero is stored as 0/0. Timestamps pass through
+ * here constantly, so the common cases are inline: values with the same denominator (e.g. two times in the same
+ * timebase) are added, subtracted and compared without any multiplication or GCD, and other comparisons
+ * cross-multiply in 128 bits rather than reducing anything. Only the general arithmetic cases are out of line, and
+ * they compute with 128-bit intermediates so they don't overflow either.
  */
 class rational {
 public:
   // Constructors
-  rational(const int64_t& numerator = 0);
-  rational(const int64_t& numerator, const int64_t& denominator);
+  rational(const int64_t& numerator = 0) :
+    numerator_(numerator),
+    denominator_((numerator != 0) ? 1 : 0)
+  {
+  }
+
+  rational(const int64_t& numerator, const int64_t& denominator) :
+    numerator_(numerator),
+    denominator_(denominator)
+  {
+    if (denominator_ != 1 || numerator_ == 0) {
+      Normalize();
+    }
+  }
+
   rational(const AVRational& r); // Auto-convert from an FFmpeg AVRational
-  rational(const rational& r);
+
+  rational(const rational& r) :
+    numerator_(r.numerator_),
+    denominator_(r.denominator_)
+  {
+  }
 
   // Assignment Operators
-  const rational& operator=(const rational& r);
-  const rational& operator+=(const rational& r);
-  const rational& operator-=(const rational& r);
+  const rational& operator=(const rational& r)
+  {
+    numerator_ = r.numerator_;
+    denominator_ = r.denominator_;
+    return *this;
+  }
+
+  const rational& operator+=(const rational& r)
+  {
+    if (!AddSameDenominator(r.numerator_, r.denominator_)) {
+      Add(r.numerator_, r.denominator_);
+    }
+    return *this;
+  }
+
+  const rational& operator-=(const rational& r)
+  {
+    if (!AddSameDenominator(-r.numerator_, r.denominator_)) {
+      Add(-r.numerator_, r.denominator_);
+    }
+    return *this;
+  }
+
   const rational& operator/=(const rational& r);
   const rational& operator*=(const rational& r);
 
   // Math Operators
-  rational operator+(const rational& r) const;
-  rational operator-(const rational& r) const;
-  rational operator/(const rational& r) const;
-  rational operator*(const rational& r) const;
+  rational operator+(const rational& r) const
+  {
+    rational result(*this);
+    result += r;
+    return result;
+  }
+
+  rational operator-(const rational& r) const
+  {
+    rational result(*this);
+    result -= r;
+    return result;
+  }
+
+  rational operator/(const rational& r) const
+  {
+    rational result(*this);
+    result /= r;
+    return result;
+  }
+
+  rational operator*(const rational& r) const
+  {
+    rational result(*this);
+    result *= r;
+    return result;
+  }
 
   // Relational and Equality Operators
-  bool operator<(const rational &r) const;
-  bool operator<=(const rational &r) const;
-  bool operator>(const rational &r) const;
-  bool operator>=(const rational &r) const;
-  bool operator==(const rational &r) const;
-  bool operator!=(const rational &r) const;
+  bool operator<(const rational &r) const { return Compare(r) < 0; }
+  bool operator<=(const rational &r) const { return Compare(r) <= 0; }
+  bool operator>(const rational &r) const { return Compare(r) > 0; }
+  bool operator>=(const rational &r) const { return Compare(r) >= 0; }
+
+  // Values are always reduced, so equal values have identical numerators and denominators
+  bool operator==(const rational &r) const
+  {
+    return (numerator_ == r.numerator_ && denominator_ == r.denominator_);
+  }
+
+  bool operator!=(const rational &r) const
+  {
+    return (numerator_ != r.numerator_ || denominator_ != r.denominator_);
+  }
 
   //Unary operators
   const rational& operator++(); //prefix
@@ -73,7 +161,15 @@ public:
   const rational& operator--(); //prefix
   rational operator--(int);     //postfix
   const rational& operator+() const;
-  rational operator-() const;
+
+  rational operator-() const
+  {
+    // Negating can't unreduce a value, so skip the constructor's normalization
+    rational result(*this);
+    result.numerator_ = -numerator_;
+    return result;
+  }
+
   bool operator!() const;
 
   // IO
@@ -81,18 +177,99 @@ public:
   friend std::istream& operator>>(std::istream &in, rational& value);
 
   // Convert to double
-  double ToDouble() const;
+  double ToDouble() const
+  {
+    if (denominator_ == 0) {
+      return 0;
+    }
+
+    return static_cast<double>(numerator_) / static_cast<double>(denominator_);
+  }
 
   // Specific values
-  const int64_t& numerator();
-  const int64_t& denominator();
+  const int64_t& numerator() { return numerator_; }
+  const int64_t& denominator() { return denominator_; }
+
 private:
   int64_t numerator_;
   int64_t denominator_;
 
+  /**
+   * @brief Returns a negative number, zero or a positive number if this is less than, equal to or more than `r`
+   */
+  int Compare(const rational& r) const
+  {
+    // Same denominator (including both being zero), the numerators compare the same way as the values
+    if (denominator_ == r.denominator_) {
+      return (numerator_ < r.numerator_) ? -1 : (numerator_ > r.numerator_) ? 1 : 0;
+    }
+
+    // Zero is stored as 0/0 but cross-multiplies like 0/1 (denominators are otherwise always positive)
+    rational_wide_t left = static_cast<rational_wide_t>(numerator_)
+        * static_cast<rational_wide_t>((r.denominator_ != 0) ? r.denominator_ : 1);
+    rational_wide_t right = static_cast<rational_wide_t>(r.numerator_)
+        * static_cast<rational_wide_t>((denominator_ != 0) ? denominator_ : 1);
+
+    return (left < right) ? -1 : (left > right) ? 1 : 0;
+  }
+
+  /**
+   * @brief Add n/d if d is this value's denominator and the sum doesn't overflow
+   *
+   * @return
+   *
+   * FALSE if nothing was added, in which case Add() has to be used instead.
+   */
+  bool AddSameDenominator(int64_t n, int64_t d)
+  {
+    if (d != denominator_ || d == 0) {
+      return false;
+    }
+
+    int64_t sum;
+
+#if defined(__GNUC__)
+    if (__builtin_add_overflow(numerator_, n, &sum)) {
+      return false;
+    }
+#else
+    if ((n > 0 && numerator_ > INT64_MAX - n) || (n < 0 && numerator_ < INT64_MIN - n)) {
+      return false;
+    }
+    sum = numerator_ + n;
+#endif
+
+    numerator_ = sum;
+
+    // Integers (e.g. frame counts) stay reduced on their own, anything else may have a common factor now
+    if (denominator_ != 1 || numerator_ == 0) {
+      Normalize();
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief General case of adding n/d (with 128-bit intermediates)
+   */
+  void Add(int64_t n, int64_t d);
+
+  /**
+   * @brief Set this value from a (possibly unreduced or negative) 128-bit fraction
+   *
+   * If the reduced fraction still doesn't fit in 64 bits, both halves are scaled down until it does, which is as
+   * close as a 64-bit rational can get to a value that large anyway.
+   */
+  void SetWide(rational_wide_t n, rational_wide_t d);
+
+  /**
+   * @brief Make the denominator positive, reduce, and store zero as 0/0
+   */
+  void Normalize();
+
   void FixSigns();
   void Reduce();
-  int64_t GreatestCommonDenominator(const int64_t &x, const int64_t &y);
+  static int64_t GreatestCommonDenominator(int64_t x, int64_t y);
 };
 
 #endif // RATIONAL_H
@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "startupjobs.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include "common/tracing.h"
+
+class StartupJobs::JobRunnable : public QRunnable
+{
+public:
+  JobRunnable(StartupJobs* jobs, const QString& name, const std::function<void()>& job) :
+    jobs_(jobs),
+    name_(name),
+    job_(job)
+  {
+  }
+
+  virtual void run() override
+  {
+    Tracing::Span span("startup", "StartupJobs::Run");
+
+    if (span.IsActive()) {
+      span.SetDetail(name_);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    job_();
+
+    jobs_->Finish(name_, timer.nsecsElapsed());
+  }
+
+private:
+  StartupJobs* jobs_;
+
+  QString name_;
+
+  std::function<void()> job_;
+};
+
+StartupJobs::StartupJobs()
+{
+}
+
+StartupJobs::~StartupJobs()
+{
+  WaitForAll();
+}
+
+void StartupJobs::Run(const QString &name, const std::function<void ()> &job)
+{
+  mutex_.lock();
+  running_.insert(name);
+  mutex_.unlock();
+
+  pool_.start(new JobRunnable(this, name, job));
+}
+
+void StartupJobs::Wait(const QString &name)
+{
+  QMutexLocker locker(&mutex_);
+
+  while (running_.contains(name)) {
+    finished_.wait(&mutex_);
+  }
+}
+
+void StartupJobs::WaitForAll()
+{
+  pool_.waitForDone();
+}
+
+QStringList StartupJobs::durations()
+{
+  QMutexLocker locker(&mutex_);
+
+  return durations_;
+}
+
+void StartupJobs::Finish(const QString &name, qint64 nsecs)
+{
+  QMutexLocker locker(&mutex_);
+
+  running_.remove(name);
+
+  durations_.append(QStringLiteral("%1 %2 ms").arg(name,
+                                                   QString::number(static_cast<double>(nsecs) / 1000000.0, 'f', 1)));
+
+  finished_.wakeAll();
+}
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef STARTUPJOBS_H
+#define STARTUPJOBS_H
+
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <functional>
+
+/**
+ * @brief Runs independent pieces of startup work on background threads while the main thread carries on
+ *
+ * Each job has a name, and code that depends on a job calls Wait() with its name just before it needs the result, so
+ * the main thread only blocks on the work it actually depends on. Jobs must not need the main thread (e.g. to create
+ * QObjects that live there), since it may be waiting for them.
+ */
+class StartupJobs
+{
+public:
+  StartupJobs();
+
+  /**
+   * @brief Destructor, waits for every job to finish
+   */
+  ~StartupJobs();
+
+  StartupJobs(const StartupJobs& other) = delete;
+  StartupJobs(StartupJobs&& other) = delete;
+  StartupJobs& operator=(const StartupJobs& other) = delete;
+  StartupJobs& operator=(StartupJobs&& other) = delete;
+
+  /**
+   * @brief Start a job on a background thread
+   */
+  void Run(const QString& name, const std::function<void()>& job);
+
+  /**
+   * @brief Block until a job has finished, returns straight away if it has already (or was never started)
+   */
+  void Wait(const QString& name);
+
+  /**
+   * @brief Block until every job started so far has finished
+   */
+  void WaitForAll();
+
+  /**
+   * @brief How long each finished job took, as "name time ms" in the order they finished
+   */
+  QStringList durations();
+
+private:
+  class JobRunnable;
+
+  void Finish(const QString& name, qint64 nsecs);
+
+  QThreadPool pool_;
+
+  QSet<QString> running_;
+
+  QStringList durations_;
+
+  QMutex mutex_;
+
+  QWaitCondition finished_;
+};
+
+#endif // STARTUPJOBS_H
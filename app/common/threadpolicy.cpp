@@ -0,0 +1,304 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "threadpolicy.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_MAC)
+#include <pthread.h>
+#include <pthread/qos.h>
+#elif defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+QMutex affinity_mutex;
+QHash<int, QVector<int> > affinity;
+
+// Parse a Linux style CPU list (e.g. "0-3,8,10-11")
+bool ParseCpuList(const QString& list, QVector<int>* cpus)
+{
+  foreach (const QString& part, list.trimmed().split(',')) {
+    if (part.trimmed().isEmpty()) {
+      continue;
+    }
+
+    QStringList range = part.split('-');
+
+    bool ok_first = false;
+    bool ok_last = false;
+
+    int first = range.first().trimmed().toInt(&ok_first);
+    int last = (range.size() == 2) ? range.last().trimmed().toInt(&ok_last) : first;
+
+    if (!ok_first || (range.size() == 2 && !ok_last) || range.size() > 2 || first < 0 || last < first) {
+      return false;
+    }
+
+    for (int i=first;i<=last;i++) {
+      cpus->append(i);
+    }
+  }
+
+  return true;
+}
+
+#ifdef Q_OS_LINUX
+// From linux/ioprio.h, which glibc doesn't wrap
+const int kIOPrioWhoProcess = 1;
+const int kIOPrioClassShift = 13;
+const int kIOPrioClassBestEffort = 2;
+const int kIOPrioClassIdle = 3;
+
+void SetIOPriority(int io_class, int level)
+{
+  syscall(SYS_ioprio_set, kIOPrioWhoProcess, static_cast<int>(syscall(SYS_gettid)),
+          (io_class << kIOPrioClassShift) | level);
+}
+#endif
+
+}
+
+void ThreadPolicy::Apply(ThreadPolicy::Role role, int index, int count)
+{
+  ApplyPriority(role);
+
+  affinity_mutex.lock();
+  QVector<int> cpus = affinity.value(role);
+  affinity_mutex.unlock();
+
+  if (cpus.isEmpty() && role == kRoleRender && count > 1) {
+    const QVector<QVector<int> >& nodes = NumaNodes();
+
+    if (nodes.size() > 1) {
+      // Interleave render threads across nodes so each node gets an equal share
+      cpus = nodes.at(index % nodes.size());
+    }
+  }
+
+  if (!cpus.isEmpty()) {
+    ApplyAffinity(cpus);
+  }
+}
+
+void ThreadPolicy::SetAffinity(ThreadPolicy::Role role, const QVector<int> &cpus)
+{
+  QMutexLocker locker(&affinity_mutex);
+
+  affinity.insert(role, cpus);
+}
+
+bool ThreadPolicy::SetAffinity(const QString &spec)
+{
+  static const QStringList role_names = {"audio", "present", "decode", "render", "worker", "background"};
+
+  int equals = spec.indexOf('=');
+
+  if (equals < 0) {
+    return false;
+  }
+
+  int role = role_names.indexOf(spec.left(equals).trimmed().toLower());
+
+  QVector<int> cpus;
+
+  if (role < 0 || !ParseCpuList(spec.mid(equals + 1), &cpus)) {
+    return false;
+  }
+
+  SetAffinity(static_cast<Role>(role), cpus);
+
+  return true;
+}
+
+const QVector<QVector<int> > &ThreadPolicy::NumaNodes()
+{
+  static const QVector<QVector<int> > nodes = []() {
+    QVector<QVector<int> > found;
+
+#if defined(Q_OS_LINUX)
+    QDir dir(QStringLiteral("/sys/devices/system/node"));
+
+    foreach (const QString& name, dir.entryList({QStringLiteral("node*")}, QDir::Dirs)) {
+      QFile file(dir.filePath(name + QStringLiteral("/cpulist")));
+
+      QVector<int> cpus;
+
+      if (file.open(QFile::ReadOnly) && ParseCpuList(QString::fromLatin1(file.readAll()), &cpus) && !cpus.isEmpty()) {
+        found.append(cpus);
+      }
+    }
+#elif defined(Q_OS_WIN)
+    ULONG highest = 0;
+
+    if (GetNumaHighestNodeNumber(&highest)) {
+      for (ULONG i=0;i<=highest;i++) {
+        ULONGLONG mask = 0;
+
+        // Only covers the first processor group, which is the one threads start in
+        if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(i), &mask) || mask == 0) {
+          continue;
+        }
+
+        QVector<int> cpus;
+
+        for (int j=0;j<64;j++) {
+          if (mask & (1ULL << j)) {
+            cpus.append(j);
+          }
+        }
+
+        found.append(cpus);
+      }
+    }
+#endif
+
+    if (found.size() < 2) {
+      found = {QVector<int>()};
+    }
+
+    return found;
+  }();
+
+  return nodes;
+}
+
+void ThreadPolicy::ApplyPriority(ThreadPolicy::Role role)
+{
+#if defined(Q_OS_WIN)
+  HANDLE thread = GetCurrentThread();
+
+  // Background mode has to be left explicitly (this fails harmlessly if the thread isn't in it)
+  if (role == kRoleBackground) {
+    SetThreadPriority(thread, THREAD_MODE_BACKGROUND_BEGIN);
+  } else {
+    SetThreadPriority(thread, THREAD_MODE_BACKGROUND_END);
+
+    int priority = THREAD_PRIORITY_NORMAL;
+
+    if (role == kRoleAudio) {
+      priority = THREAD_PRIORITY_TIME_CRITICAL;
+    } else if (role == kRolePresent) {
+      priority = THREAD_PRIORITY_HIGHEST;
+    }
+
+    SetThreadPriority(thread, priority);
+  }
+
+#ifdef THREAD_POWER_THROTTLING_CURRENT_VERSION
+  // EcoQoS, which schedules the thread on efficiency cores on hybrid CPUs
+  THREAD_POWER_THROTTLING_STATE throttling;
+  ZeroMemory(&throttling, sizeof(throttling));
+  throttling.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+  throttling.ControlMask = THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+  throttling.StateMask = (role == kRoleBackground) ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+
+  SetThreadInformation(thread, ThreadPowerThrottling, &throttling, sizeof(throttling));
+#endif
+
+#elif defined(Q_OS_MAC)
+  qos_class_t qos = QOS_CLASS_USER_INITIATED;
+
+  if (role == kRoleAudio || role == kRolePresent) {
+    qos = QOS_CLASS_USER_INTERACTIVE;
+  } else if (role == kRoleBackground) {
+    // Runs on efficiency cores on Apple silicon
+    qos = QOS_CLASS_BACKGROUND;
+  }
+
+  pthread_set_qos_class_self_np(qos, 0);
+
+#elif defined(Q_OS_LINUX)
+  sched_param param;
+  param.sched_priority = 0;
+
+  if (role == kRoleAudio) {
+    // Real-time if we're allowed to, audio underruns are the one thing users can't miss
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+      return;
+    }
+
+    param.sched_priority = 0;
+  }
+
+  // Unlike raising nice again, leaving SCHED_BATCH doesn't need privileges, so pool threads can switch back and forth
+  pthread_setschedparam(pthread_self(), (role == kRoleBackground) ? SCHED_BATCH : SCHED_OTHER, &param);
+
+  if (role == kRoleBackground) {
+    SetIOPriority(kIOPrioClassIdle, 0);
+  } else {
+    SetIOPriority(kIOPrioClassBestEffort, 4);
+  }
+
+  if (role == kRolePresent || role == kRoleAudio) {
+    // Only works with CAP_SYS_NICE or an RLIMIT_NICE, and is applied once so it never needs undoing
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), (role == kRoleAudio) ? -10 : -5);
+  }
+
+#else
+  Q_UNUSED(role)
+#endif
+}
+
+void ThreadPolicy::ApplyAffinity(const QVector<int> &cpus)
+{
+#if defined(Q_OS_WIN)
+  DWORD_PTR mask = 0;
+
+  foreach (int cpu, cpus) {
+    if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+      mask |= (static_cast<DWORD_PTR>(1) << cpu);
+    }
+  }
+
+  if (mask != 0) {
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+  }
+#elif defined(Q_OS_LINUX)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  foreach (int cpu, cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  // macOS only takes affinity hints between threads, not CPUs
+  Q_UNUSED(cpus)
+#endif
+}
@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THREADPOLICY_H
+#define THREADPOLICY_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Scheduling priority and CPU affinity of Olive's threads, chosen by what each thread does
+ *
+ * Threads call Apply() with their Role when they start. Roles map to what each OS offers:
+ *
+ * * kRoleAudio: real-time scheduling where the OS allows it (SCHED_FIFO on Linux, which needs an rtprio limit or
+ *   CAP_SYS_NICE), otherwise the highest priority available.
+ * * kRolePresent: above normal, for the main thread that presents frames in viewers.
+ * * kRoleDecode, kRoleRender and kRoleWorker: normal.
+ * * kRoleBackground: background priority, which also lowers I/O priority and prefers efficiency cores where the OS
+ *   has them (QOS_CLASS_BACKGROUND on macOS, EcoQoS on Windows 11). On Linux it's SCHED_BATCH with idle I/O
+ *   priority, since an unprivileged thread could never raise its nice value back.
+ *
+ * Switching between kRoleWorker and kRoleBackground is always possible, so pool threads can run background work at
+ * background priority and go back to normal afterwards.
+ *
+ * On machines with more than one NUMA node (e.g. dual socket workstations), render threads are spread across nodes and
+ * kept on their node's CPUs so the memory they allocate stays local. SetAffinity() overrides affinity for any role.
+ * Affinity isn't supported on macOS. Failures (e.g. insufficient privileges) are ignored, the thread simply keeps the
+ * priority it had.
+ */
+class ThreadPolicy
+{
+public:
+  enum Role {
+    kRoleAudio,
+    kRolePresent,
+    kRoleDecode,
+    kRoleRender,
+    kRoleWorker,
+    kRoleBackground
+  };
+
+  /**
+   * @brief Apply a role's priority and affinity to the calling thread
+   *
+   * @param index
+   *
+   * Index of this thread among `count` threads with the same role (e.g. RendererThread::index()), used to spread
+   * them across NUMA nodes.
+   */
+  static void Apply(Role role, int index = 0, int count = 1);
+
+  /**
+   * @brief Keep threads with a role on these logical CPUs (or let the OS decide again if `cpus` is empty)
+   *
+   * Only affects threads that call Apply() afterwards.
+   */
+  static void SetAffinity(Role role, const QVector<int>& cpus);
+
+  /**
+   * @brief Parse SetAffinity() arguments from a string like "render=0-7,16" (e.g. from the command line)
+   *
+   * @return
+   *
+   * FALSE if the string isn't valid.
+   */
+  static bool SetAffinity(const QString& spec);
+
+  /**
+   * @brief Logical CPUs of each NUMA node (a single node with no CPUs listed if there's only one or it's unknown)
+   */
+  static const QVector<QVector<int> >& NumaNodes();
+
+private:
+  static void ApplyPriority(Role role);
+
+  static void ApplyAffinity(const QVector<int>& cpus);
+};
+
+#endif // THREADPOLICY_H
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "tickrescaler.h"
+
+TickRescaler::TickRescaler() :
+  multiplier_(1),
+  divisor_(1)
+{
+}
+
+TickRescaler::TickRescaler(const rational &from, const rational &to) :
+  multiplier_(1),
+  divisor_(1)
+{
+  // Olive's rational represents zero as 0/0, a zero timebase can't be converted from or to
+  if (from == rational() || to == rational()) {
+    multiplier_ = 0;
+    return;
+  }
+
+  rational factor = from / to;
+
+  multiplier_ = factor.numerator();
+  divisor_ = factor.denominator();
+}
+
+TickRescaler TickRescaler::Inverted() const
+{
+  TickRescaler inverted;
+
+  if (multiplier_ == 0) {
+    inverted.multiplier_ = 0;
+  } else if (multiplier_ < 0) {
+    inverted.multiplier_ = -divisor_;
+    inverted.divisor_ = -multiplier_;
+  } else {
+    inverted.multiplier_ = divisor_;
+    inverted.divisor_ = multiplier_;
+  }
+
+  return inverted;
+}
+
+namespace olive {
+
+int64_t TimeToTicks(const rational &time, const rational &base)
+{
+  if (base == rational()) {
+    return 0;
+  }
+
+  // Dividing exactly first means the numerator and denominator can't overflow av_rescale() like their products could
+  rational ticks = time / base;
+
+  if (ticks.denominator() == 0) {
+    return 0;
+  }
+
+  if (ticks.denominator() == 1) {
+    return ticks.numerator();
+  }
+
+  return av_rescale(ticks.numerator(), 1, ticks.denominator());
+}
+
+rational TicksToTime(int64_t ticks, const rational &base)
+{
+  return rational(ticks) * base;
+}
+
+}
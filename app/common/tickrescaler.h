@@ -0,0 +1,83 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TICKRESCALER_H
+#define TICKRESCALER_H
+
+#include "common/rational.h"
+
+/**
+ * @brief Converts integer ticks of one timebase to ticks of another at a precomputed factor
+ *
+ * Hot paths (seeking, frame lookups, cache keys) can count time as int64 ticks of a fixed timebase (e.g. frames of
+ * the sequence's video timebase, or an AVStream's timestamps) and compare integers rather than rationals. Doubles
+ * can't do this exactly: by a few hours into a timeline at 1001/30000 they round to the wrong frame.
+ *
+ * Results are identical to av_rescale_q(ticks, from, to) (rounded to the nearest tick, halfway cases away from zero),
+ * but the factor between the two timebases is reduced once on construction rather than on every call, and
+ * conversions between timebases that are integer multiples of each other are a single multiplication.
+ */
+class TickRescaler
+{
+public:
+  /**
+   * @brief Construct an identity rescaler
+   */
+  TickRescaler();
+
+  TickRescaler(const rational& from, const rational& to);
+
+  int64_t Rescale(int64_t ticks) const
+  {
+    if (divisor_ == 1) {
+      return ticks * multiplier_;
+    }
+
+    return av_rescale(ticks, multiplier_, divisor_);
+  }
+
+  /**
+   * @brief The rescaler converting back from `to` to `from`
+   */
+  TickRescaler Inverted() const;
+
+private:
+  // Ticks of `to` = ticks of `from` * multiplier_ / divisor_ (reduced, divisor_ is always positive)
+  int64_t multiplier_;
+  int64_t divisor_;
+};
+
+namespace olive {
+
+/**
+ * @brief The number of ticks of `base` closest to `time`, rounded like av_rescale_q()
+ *
+ * Exact for any time, using 128-bit intermediates rather than going through doubles.
+ */
+int64_t TimeToTicks(const rational& time, const rational& base);
+
+/**
+ * @brief The time of a number of ticks of `base`
+ */
+rational TicksToTime(int64_t ticks, const rational& base);
+
+}
+
+#endif // TICKRESCALER_H
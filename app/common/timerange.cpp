@@ -0,0 +1,155 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "timerange.h"
+
+#include <algorithm>
+
+TimeRange::TimeRange()
+{
+}
+
+TimeRange::TimeRange(const rational &in, const rational &out) :
+  in_(in),
+  out_(out)
+{
+  // Keep in before out however the range was given
+  if (out_ < in_) {
+    std::swap(in_, out_);
+  }
+}
+
+const rational &TimeRange::in() const
+{
+  return in_;
+}
+
+const rational &TimeRange::out() const
+{
+  return out_;
+}
+
+bool TimeRange::OverlapsWith(const TimeRange &other) const
+{
+  return in_ <= other.out_ && other.in_ <= out_;
+}
+
+bool TimeRange::Contains(const TimeRange &other) const
+{
+  return in_ <= other.in_ && other.out_ <= out_;
+}
+
+TimeRange TimeRange::Combined(const TimeRange &other) const
+{
+  return TimeRange(qMin(in_, other.in_), qMax(out_, other.out_));
+}
+
+TimeRange TimeRange::Intersected(const TimeRange &other) const
+{
+  return TimeRange(qMax(in_, other.in_), qMin(out_, other.out_));
+}
+
+TimeRange TimeRange::All()
+{
+  // INT64_MIN itself can't be negated, so stay one inside it
+  return TimeRange(rational(INT64_MIN + 1), rational(INT64_MAX));
+}
+
+TimeRangeList::TimeRangeList()
+{
+}
+
+void TimeRangeList::Insert(const TimeRange &range)
+{
+  // Find the first range that ends at or after this one starts, everything before it is unaffected
+  QVector<TimeRange>::iterator first = std::lower_bound(ranges_.begin(),
+                                                        ranges_.end(),
+                                                        range,
+                                                        [](const TimeRange& a, const TimeRange& b) {
+    return a.out() < b.in();
+  });
+
+  TimeRange merged = range;
+
+  // Absorb every range this one overlaps
+  QVector<TimeRange>::iterator last = first;
+
+  while (last != ranges_.end() && last->OverlapsWith(merged)) {
+    merged = merged.Combined(*last);
+    last++;
+  }
+
+  int index = static_cast<int>(first - ranges_.begin());
+  int count = static_cast<int>(last - first);
+
+  if (count == 1) {
+    ranges_[index] = merged;
+  } else {
+    ranges_.remove(index, count);
+    ranges_.insert(index, merged);
+  }
+}
+
+void TimeRangeList::Insert(const TimeRangeList &list)
+{
+  foreach (const TimeRange& range, list.ranges_) {
+    Insert(range);
+  }
+}
+
+bool TimeRangeList::Contains(const TimeRange &range) const
+{
+  QVector<TimeRange>::const_iterator i = std::lower_bound(ranges_.constBegin(),
+                                                          ranges_.constEnd(),
+                                                          range,
+                                                          [](const TimeRange& a, const TimeRange& b) {
+    return a.out() < b.in();
+  });
+
+  // Ranges are merged, so if any range contains this one it's the first one that could overlap it
+  return i != ranges_.constEnd() && i->Contains(range);
+}
+
+bool TimeRangeList::Overlaps(const TimeRange &range) const
+{
+  QVector<TimeRange>::const_iterator i = std::lower_bound(ranges_.constBegin(),
+                                                          ranges_.constEnd(),
+                                                          range,
+                                                          [](const TimeRange& a, const TimeRange& b) {
+    return a.out() < b.in();
+  });
+
+  return i != ranges_.constEnd() && i->OverlapsWith(range);
+}
+
+bool TimeRangeList::isEmpty() const
+{
+  return ranges_.isEmpty();
+}
+
+void TimeRangeList::clear()
+{
+  ranges_.clear();
+}
+
+const QVector<TimeRange> &TimeRangeList::ranges() const
+{
+  return ranges_;
+}
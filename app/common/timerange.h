@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TIMERANGE_H
+#define TIMERANGE_H
+
+#include <QVector>
+
+#include "common/rational.h"
+
+/**
+ * @brief A range of time from in to out (inclusive)
+ */
+class TimeRange
+{
+public:
+  TimeRange();
+  TimeRange(const rational& in, const rational& out);
+
+  const rational& in() const;
+  const rational& out() const;
+
+  /**
+   * @brief Returns TRUE if this range and another overlap or touch
+   */
+  bool OverlapsWith(const TimeRange& other) const;
+
+  /**
+   * @brief Returns TRUE if another range lies entirely within this one
+   */
+  bool Contains(const TimeRange& other) const;
+
+  /**
+   * @brief Returns the smallest range covering both this range and another
+   */
+  TimeRange Combined(const TimeRange& other) const;
+
+  /**
+   * @brief Returns the part of this range that another range also covers (only meaningful if they overlap)
+   */
+  TimeRange Intersected(const TimeRange& other) const;
+
+  /**
+   * @brief Returns a range covering every time a timestamp can represent
+   */
+  static TimeRange All();
+
+private:
+  rational in_;
+
+  rational out_;
+};
+
+/**
+ * @brief A set of time ranges, kept sorted with overlapping ranges merged
+ */
+class TimeRangeList
+{
+public:
+  TimeRangeList();
+
+  /**
+   * @brief Add a range, merging it with any ranges it overlaps or touches
+   */
+  void Insert(const TimeRange& range);
+
+  /**
+   * @brief Add every range of another list
+   */
+  void Insert(const TimeRangeList& list);
+
+  /**
+   * @brief Returns TRUE if a range is entirely covered by this set
+   */
+  bool Contains(const TimeRange& range) const;
+
+  /**
+   * @brief Returns TRUE if any range in this set overlaps or touches a range
+   */
+  bool Overlaps(const TimeRange& range) const;
+
+  bool isEmpty() const;
+
+  void clear();
+
+  /**
+   * @brief The ranges, sorted and non-overlapping
+   */
+  const QVector<TimeRange>& ranges() const;
+
+private:
+  QVector<TimeRange> ranges_;
+};
+
+#endif // TIMERANGE_H
@@ -0,0 +1,293 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "tracing.h"
+
+#include <memory>
+#include <vector>
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+#include "profiledmutex.h"
+
+namespace {
+
+struct Event {
+  const char* category;
+  const char* name;
+  qint64 start;
+  qint64 end;
+  QString detail;
+};
+
+struct ThreadBuffer {
+  int tid;
+  QString thread_name;
+
+  // Only contended while a trace is being started or written
+  QMutex mutex;
+  QVector<Event> events;
+};
+
+QAtomicInt enabled(0);
+
+QElapsedTimer trace_clock;
+
+QString trace_filename;
+
+// Every thread that has ever recorded a span, kept until exit since threads may record again in a later trace
+QMutex buffers_mutex;
+std::vector< std::unique_ptr<ThreadBuffer> > buffers;
+
+thread_local ThreadBuffer* current_buffer = nullptr;
+
+ThreadBuffer* CurrentBuffer()
+{
+  if (current_buffer == nullptr) {
+    QMutexLocker locker(&buffers_mutex);
+
+    buffers.emplace_back(new ThreadBuffer());
+
+    current_buffer = buffers.back().get();
+    current_buffer->tid = static_cast<int>(buffers.size());
+
+    QThread* thread = QThread::currentThread();
+
+    if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread()) {
+      current_buffer->thread_name = QStringLiteral("Main");
+    } else if (!thread->objectName().isEmpty()) {
+      current_buffer->thread_name = thread->objectName();
+    } else {
+      current_buffer->thread_name = QStringLiteral("%1 %2").arg(thread->metaObject()->className(),
+                                                                QString::number(current_buffer->tid));
+    }
+  }
+
+  return current_buffer;
+}
+
+QString JsonString(const QString& s)
+{
+  QString escaped;
+  escaped.reserve(s.size() + 2);
+
+  escaped.append('"');
+
+  foreach (QChar c, s) {
+    if (c == '"' || c == '\\') {
+      escaped.append('\\');
+      escaped.append(c);
+    } else if (c.unicode() < 0x20) {
+      escaped.append(QStringLiteral("\\u%1").arg(c.unicode(), 4, 16, QChar('0')));
+    } else {
+      escaped.append(c);
+    }
+  }
+
+  escaped.append('"');
+
+  return escaped;
+}
+
+QString Microseconds(qint64 nsecs)
+{
+  return QString::number(static_cast<double>(nsecs) / 1000.0, 'f', 3);
+}
+
+}
+
+void Tracing::Start(const QString &filename)
+{
+  enabled.store(0);
+
+  QMutexLocker locker(&buffers_mutex);
+
+  for (size_t i=0;i<buffers.size();i++) {
+    QMutexLocker buffer_locker(&buffers.at(i)->mutex);
+    buffers.at(i)->events.clear();
+  }
+
+  trace_filename = filename;
+  trace_clock.start();
+
+  // Lock totals are written with the trace, so they should cover the same time
+  LockProfiling::Reset();
+
+  enabled.store(1);
+}
+
+bool Tracing::Stop()
+{
+  if (enabled.fetchAndStoreOrdered(0) == 0) {
+    return false;
+  }
+
+  QFile file(trace_filename);
+
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open trace file" << trace_filename;
+    return false;
+  }
+
+  QString pid = QString::number(QCoreApplication::applicationPid());
+
+  file.write("{\"traceEvents\":[\n");
+
+  bool first = true;
+
+  QMutexLocker locker(&buffers_mutex);
+
+  for (size_t i=0;i<buffers.size();i++) {
+    ThreadBuffer* buffer = buffers.at(i).get();
+
+    QMutexLocker buffer_locker(&buffer->mutex);
+
+    if (buffer->events.isEmpty()) {
+      continue;
+    }
+
+    QString tid = QString::number(buffer->tid);
+
+    // Name the thread's track
+    QString line = QStringLiteral("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%1,\"tid\":%2,"
+                                  "\"args\":{\"name\":%3}}").arg(pid, tid, JsonString(buffer->thread_name));
+
+    if (!first) {
+      file.write(",\n");
+    }
+    file.write(line.toUtf8());
+    first = false;
+
+    foreach (const Event& e, buffer->events) {
+      line = QStringLiteral("{\"ph\":\"X\",\"cat\":%1,\"name\":%2,\"pid\":%3,\"tid\":%4,\"ts\":%5,\"dur\":%6")
+          .arg(JsonString(QString::fromLatin1(e.category)),
+               JsonString(QString::fromLatin1(e.name)),
+               pid,
+               tid,
+               Microseconds(e.start),
+               Microseconds(e.end - e.start));
+
+      if (!e.detail.isEmpty()) {
+        line.append(QStringLiteral(",\"args\":{\"detail\":%1}").arg(JsonString(e.detail)));
+      }
+
+      line.append('}');
+
+      file.write(",\n");
+      file.write(line.toUtf8());
+    }
+
+    buffer->events.clear();
+  }
+
+  // Add the totals of every lock as global instant events (see ProfiledMutex)
+  QString end = Microseconds(Now());
+
+  foreach (const LockProfiling::Summary& summary, LockProfiling::Summaries()) {
+    if (summary.acquisitions == 0) {
+      continue;
+    }
+
+    QString line = QStringLiteral("{\"ph\":\"i\",\"s\":\"g\",\"cat\":\"lock\",\"name\":%1,\"pid\":%2,\"tid\":0,\"ts\":%3,")
+        .arg(JsonString(summary.name), pid, end);
+
+    line.append(QStringLiteral("\"args\":{\"acquisitions\":%1,\"contentions\":%2,\"wait_ms\":%3,\"max_wait_ms\":%4,")
+                .arg(QString::number(summary.acquisitions),
+                     QString::number(summary.contentions),
+                     QString::number(summary.wait_nsecs / 1000000.0, 'f', 3),
+                     QString::number(summary.max_wait_nsecs / 1000000.0, 'f', 3)));
+
+    line.append(QStringLiteral("\"hold_ms\":%1,\"max_hold_ms\":%2}}")
+                .arg(QString::number(summary.hold_nsecs / 1000000.0, 'f', 3),
+                     QString::number(summary.max_hold_nsecs / 1000000.0, 'f', 3)));
+
+    if (!first) {
+      file.write(",\n");
+    }
+    file.write(line.toUtf8());
+    first = false;
+  }
+
+  file.write("\n]}\n");
+
+  return file.error() == QFile::NoError;
+}
+
+bool Tracing::IsEnabled()
+{
+  return enabled.load() != 0;
+}
+
+void Tracing::Record(const char *category, const char *name, qint64 start, qint64 end, const QString &detail)
+{
+  if (enabled.load() == 0) {
+    return;
+  }
+
+  ThreadBuffer* buffer = CurrentBuffer();
+
+  QMutexLocker locker(&buffer->mutex);
+
+  // Tracing may have been restarted while the span was open, which clears the buffer and resets the clock
+  if (enabled.load() == 0 || start > end) {
+    return;
+  }
+
+  Event e = {category, name, start, end, detail};
+  buffer->events.append(e);
+}
+
+qint64 Tracing::Now()
+{
+  return trace_clock.nsecsElapsed();
+}
+
+Tracing::Span::Span(const char *category, const char *name) :
+  category_(category),
+  name_(name),
+  start_(IsEnabled() ? Now() : -1)
+{
+}
+
+Tracing::Span::~Span()
+{
+  if (start_ >= 0) {
+    Record(category_, name_, start_, Now(), detail_);
+  }
+}
+
+bool Tracing::Span::IsActive() const
+{
+  return start_ >= 0;
+}
+
+void Tracing::Span::SetDetail(const QString &detail)
+{
+  if (IsActive()) {
+    detail_ = detail;
+  }
+}
@@ -0,0 +1,100 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Application-wide timeline of what every thread was doing, written as a Chrome trace
+ *
+ * Code marks the work it does with Span objects. While tracing is enabled (see Start()), each Span records when it
+ * started and how long it lasted on its thread. Stop() writes them all in the Chrome Trace Event JSON format, which
+ * can be opened in chrome://tracing or Perfetto (ui.perfetto.dev).
+ *
+ * When tracing is disabled, a Span costs one relaxed atomic load. Each thread records into its own buffer, so spans
+ * on different threads never contend.
+ *
+ * In builds with LOCK_PROFILING, the trace also shows every wait for a ProfiledMutex and ends with each lock's totals.
+ */
+class Tracing
+{
+public:
+  /**
+   * @brief Start recording spans, discarding any recorded before
+   *
+   * @param filename
+   *
+   * Where Stop() writes the trace.
+   */
+  static void Start(const QString& filename);
+
+  /**
+   * @brief Stop recording and write the trace to the file given to Start()
+   *
+   * @return
+   *
+   * FALSE if tracing wasn't started or the file couldn't be written.
+   */
+  static bool Stop();
+
+  static bool IsEnabled();
+
+  /**
+   * @brief Records the time from its construction to its destruction on this thread
+   *
+   * `category` and `name` must be string literals (or otherwise outlive the trace), they're stored as pointers.
+   */
+  class Span {
+  public:
+    Span(const char* category, const char* name);
+
+    ~Span();
+
+    /**
+     * @brief Returns TRUE if this span is being recorded (so it's worth building a detail string)
+     */
+    bool IsActive() const;
+
+    /**
+     * @brief Attach extra information (e.g. a node's ID) shown with the span
+     */
+    void SetDetail(const QString& detail);
+
+  private:
+    const char* category_;
+
+    const char* name_;
+
+    // -1 if not recording
+    qint64 start_;
+
+    QString detail_;
+  };
+
+private:
+  static void Record(const char* category, const char* name, qint64 start, qint64 end, const QString& detail);
+
+  static qint64 Now();
+};
+
+#endif // TRACING_H
@@ -20,6 +20,11 @@
 
 #include "core.h"
 
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavfilter/avfilter.h>
+}
+
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
@@ -27,12 +32,40 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QHBoxLayout>
-
+#include <QSplashScreen>
+#include <QTimer>
+
+#include "common/threadpolicy.h"
+#include "common/tracing.h"
+#include "decoder/decoderpool.h"
+#include "decoder/ffmpeg/ffmpegpacketcache.h"
+#include "decoder/remote/decodeworker.h"
+#include "decoder/remote/decodeworkerpool.h"
+#include "decoder/streamframecache.h"
+#include "decoder/thumbnailservice.h"
+#include "node/benchmark/benchmarkbaseline.h"
+#include "node/benchmark/graphbenchmark.h"
+#include "node/benchmark/playbackbenchmark.h"
+#include "node/benchmark/primitivebenchmark.h"
+#include "node/processor/renderer/renderjob.h"
+#include "node/processor/renderer/renderprofiler.h"
+#include "node/processor/shader/usershaderlibrary.h"
 #include "panel/panelfocusmanager.h"
 #include "panel/project/project.h"
 #include "project/item/footage/footage.h"
+#include "project/projectfile.h"
+#include "render/colormanagement.h"
+#include "render/diskframecache.h"
+#include "render/framecache.h"
+#include "render/gl/shadercache.h"
+#include "render/headlessrender.h"
+#include "render/memorypool.h"
+#include "render/rendercoordinator.h"
+#include "task/analyze/analyze.h"
 #include "task/import/import.h"
+#include "task/index/index.h"
 #include "task/taskmanager.h"
+#include "task/validate/validate.h"
 #include "ui/style/style.h"
 #include "undo/undostack.h"
 #include "widget/menu/menushared.h"
@@ -43,12 +76,18 @@ Core olive::core;
 Core::Core() :
   main_window_(nullptr),
   tool_(olive::tool::kPointer),
-  snapping_(true)
+  snapping_(true),
+  startup_phase_start_(0),
+  normal_packet_cache_budget_(0),
+  normal_memory_pool_budget_(0),
+  normal_stream_frame_cache_budget_(0)
 {
 }
 
 void Core::Start()
 {
+  startup_timer_.start();
+
   //
   // Parse command line arguments
   //
@@ -68,6 +107,129 @@ void Core::Start()
   QCommandLineOption fullscreen_option({"f", "fullscreen"}, tr("Start in full screen mode"));
   parser.addOption(fullscreen_option);
 
+  // Create node graph benchmark option
+  QCommandLineOption benchmark_option("benchmark-graph",
+                                      tr("Benchmark node graph evaluation and write the results as JSON to <file> "
+                                         "(- for standard output) instead of starting the GUI"),
+                                      tr("file"));
+  parser.addOption(benchmark_option);
+
+  QCommandLineOption primitives_option("benchmark-primitives",
+                                       tr("Benchmark low-level operations (rational math, pixel conversion, buffer "
+                                          "caching, keyframes) and write the results as JSON to <file> (- for "
+                                          "standard output) instead of starting the GUI"),
+                                       tr("file"));
+  parser.addOption(primitives_option);
+
+  QCommandLineOption playback_benchmark_option("benchmark-playback",
+                                               tr("Benchmark playback of generated media in several formats and "
+                                                  "resolutions and write the results as JSON to <file> (- for "
+                                                  "standard output) instead of starting the GUI"),
+                                               tr("file"));
+  parser.addOption(playback_benchmark_option);
+
+  QCommandLineOption baseline_option("benchmark-baseline",
+                                     tr("Compare benchmark results with the baseline in <file> and exit with an error "
+                                        "if any regressed (the results are recorded as the baseline if <file> "
+                                        "doesn't exist)"),
+                                     tr("file"));
+  parser.addOption(baseline_option);
+
+  QCommandLineOption tolerance_option("benchmark-tolerance",
+                                      tr("Fraction by which a benchmark result may be worse than the baseline before "
+                                         "it counts as a regression (default 0.25)"),
+                                      tr("fraction"));
+  parser.addOption(tolerance_option);
+
+  // Create headless render options
+  QCommandLineOption render_option("render",
+                                   tr("Render the project's sequence to a video file or to image files named <file> "
+                                      "(# characters are replaced by the frame number) without starting the GUI, "
+                                      "printing progress as JSON lines"),
+                                   tr("file"));
+  parser.addOption(render_option);
+
+  QCommandLineOption sequence_option("sequence",
+                                     tr("Name of the sequence to render (defaults to the first one)"),
+                                     tr("name"));
+  parser.addOption(sequence_option);
+
+  QCommandLineOption in_option("in", tr("First frame to render (defaults to 0)"), tr("frame"), "0");
+  parser.addOption(in_option);
+
+  QCommandLineOption out_option("out", tr("Last frame to render"), tr("frame"));
+  parser.addOption(out_option);
+
+  QCommandLineOption codec_option("codec",
+                                  tr("FFmpeg encoder to render video files with (defaults to the container's)"),
+                                  tr("encoder"));
+  parser.addOption(codec_option);
+
+  QCommandLineOption hardware_encode_option("hardware-encode",
+                                            tr("Encode video files with a hardware encoder (NVENC, VAAPI, QSV, "
+                                               "VideoToolbox or AMF) when one works on this system"));
+  parser.addOption(hardware_encode_option);
+
+  QCommandLineOption passthrough_option("passthrough",
+                                        tr("Copy the ranges of a video file render listed in <file> from their source "
+                                           "streams instead of rendering them where the codecs match, one per line as "
+                                           "\"<in> <out> <media in seconds> <stream index> <source file>\""),
+                                        tr("file"));
+  parser.addOption(passthrough_option);
+
+  QCommandLineOption workers_option("workers",
+                                    tr("Split the render into chunks and render them with the worker commands listed "
+                                       "in <file>, one per line (e.g. \"ssh render01 olive\"), which must see the "
+                                       "project, media and output at the same paths"),
+                                    tr("file"));
+  parser.addOption(workers_option);
+
+  QCommandLineOption chunk_option("chunk-frames",
+                                  tr("Number of frames each worker renders at a time (defaults to 600)"),
+                                  tr("frames"),
+                                  "600");
+  parser.addOption(chunk_option);
+
+  // Create decode worker options
+  QCommandLineOption decode_workers_option("decode-workers",
+                                           tr("Decode media in this many helper processes instead of in Olive itself, "
+                                              "so a codec that crashes only takes a worker down with it"),
+                                           tr("count"));
+  parser.addOption(decode_workers_option);
+
+  QCommandLineOption decode_worker_option("decode-worker",
+                                          tr("Run as a decode worker for the Olive listening on <server> (used "
+                                             "internally by --decode-workers)"),
+                                          tr("server"));
+  parser.addOption(decode_worker_option);
+
+  // Create tracing option
+  QCommandLineOption trace_option("trace",
+                                  tr("Record what every thread does and write it to <file> as a Chrome trace when "
+                                     "quitting (open it in chrome://tracing or Perfetto)"),
+                                  tr("file"));
+  parser.addOption(trace_option);
+
+  // Create thread affinity option
+  QCommandLineOption affinity_option("affinity",
+                                     tr("Keep threads with a role (audio, present, decode, render, worker or background) "
+                                        "on these CPUs, e.g. render=0-7,16 (may be given more than once)"),
+                                     tr("role=cpus"));
+  parser.addOption(affinity_option);
+
+  // Create per-screen display option
+  QCommandLineOption screen_display_option("screen-display",
+                                           tr("Show viewers on a screen through an OCIO display and view, e.g. "
+                                              "HDMI-1=P3-D65/Film (may be given more than once)"),
+                                           tr("screen=display[/view]"));
+  parser.addOption(screen_display_option);
+
+  // Create preview cache compression option
+  QCommandLineOption compress_cache_option("compress-preview-cache",
+                                           tr("Keep rendered preview frames block-compressed in VRAM, so several times "
+                                              "as many fit at slightly lower quality"));
+  parser.addOption(compress_cache_option);
+
   // Parse options
   parser.process(*app);
 
@@ -78,24 +240,206 @@ void Core::Start()
     startup_project_ = args.first();
   }
 
+  MarkStartupPhase("arguments");
+
   // Declare custom types for Qt signal/slot syste
   DeclareTypesForQt();
 
+  StartBackgroundJobs(parser.isSet(decode_worker_option));
+
+  foreach (const QString& affinity, parser.values(affinity_option)) {
+    if (!ThreadPolicy::SetAffinity(affinity)) {
+      qWarning() << "Ignoring invalid affinity" << affinity;
+    }
+  }
+
+  if (parser.isSet(decode_worker_option)) {
+    // Runs until Olive disconnects, see DecodeWorker
+    DecodeWorker* worker = new DecodeWorker(app);
+
+    startup_jobs_.Wait("codecs");
+
+    if (!worker->Start(parser.value(decode_worker_option))) {
+      QTimer::singleShot(0, []() {
+        QCoreApplication::exit(1);
+      });
+    }
+
+    return;
+  }
+
+  foreach (const QString& assignment, parser.values(screen_display_option)) {
+    int equals = assignment.indexOf('=');
+
+    if (equals <= 0) {
+      qWarning() << "Ignoring invalid screen display" << assignment;
+      continue;
+    }
+
+    QString display_view = assignment.mid(equals + 1);
+
+    olive::color::SetScreenDisplay(assignment.left(equals),
+                                   display_view.section('/', 0, 0),
+                                   display_view.section('/', 1));
+  }
+
+  FrameCache::set_compression_enabled(parser.isSet(compress_cache_option));
+
+  if (parser.isSet(trace_option)) {
+    Tracing::Start(parser.value(trace_option));
+
+    // Written once the event loop ends, however it does
+    connect(app, &QCoreApplication::aboutToQuit, []() {
+      Tracing::Stop();
+    });
+  }
+
+  double benchmark_tolerance = BenchmarkBaseline::kDefaultTolerance;
+
+  if (parser.isSet(tolerance_option)) {
+    bool tolerance_ok;
+    benchmark_tolerance = parser.value(tolerance_option).toDouble(&tolerance_ok);
+
+    if (!tolerance_ok || benchmark_tolerance < 0) {
+      qWarning() << "Invalid benchmark tolerance" << parser.value(tolerance_option);
+      benchmark_tolerance = BenchmarkBaseline::kDefaultTolerance;
+    }
+  }
+
+  // Benchmarks decode and encode straight away
+  if (parser.isSet(benchmark_option) || parser.isSet(primitives_option) || parser.isSet(playback_benchmark_option)) {
+    startup_jobs_.Wait("codecs");
+  }
+
+  if (parser.isSet(benchmark_option)) {
+    bool ok = NodeGraphBenchmark::RunToFile(parser.value(benchmark_option),
+                                            240,
+                                            parser.value(baseline_option),
+                                            benchmark_tolerance);
+
+    // Quit as soon as the event loop starts
+    QTimer::singleShot(0, [ok]() {
+      QCoreApplication::exit(ok ? 0 : 1);
+    });
+
+    return;
+  }
+
+  if (parser.isSet(primitives_option)) {
+    bool ok = PrimitiveBenchmark::RunToFile(parser.value(primitives_option),
+                                            parser.value(baseline_option),
+                                            benchmark_tolerance);
+
+    QTimer::singleShot(0, [ok]() {
+      QCoreApplication::exit(ok ? 0 : 1);
+    });
+
+    return;
+  }
+
+  if (parser.isSet(playback_benchmark_option)) {
+    // Plays each scenario in an event loop of its own
+    bool ok = PlaybackBenchmark::RunToFile(parser.value(playback_benchmark_option),
+                                           10,
+                                           parser.value(baseline_option),
+                                           benchmark_tolerance);
+
+    QTimer::singleShot(0, [ok]() {
+      QCoreApplication::exit(ok ? 0 : 1);
+    });
+
+    return;
+  }
+
+  // Headless renders on render nodes need this most, their container is killed without warning at its memory limit
+  connect(&olive::memory_pressure,
+          SIGNAL(LevelChanged(MemoryPressure::Level)),
+          this,
+          SLOT(MemoryPressureChanged(MemoryPressure::Level)));
+  olive::memory_pressure.Start();
+
+  // Projects may use user shaders, so they have to be read before any are opened
+  olive::user_shaders.Start();
+
+  // This thread presents frames in viewers (a headless render has none to keep smooth)
+  if (!parser.isSet(render_option)) {
+    ThreadPolicy::Apply(ThreadPolicy::kRolePresent);
+  }
+
+  if (parser.isSet(decode_workers_option)) {
+    bool count_ok;
+    int count = parser.value(decode_workers_option).toInt(&count_ok);
+
+    if (count_ok && count >= 0) {
+      olive::decode_worker_pool.SetWorkerCount(count);
+    } else {
+      qWarning() << "Invalid decode worker count" << parser.value(decode_workers_option);
+    }
+  }
+
+  if (parser.isSet(render_option)) {
+    startup_jobs_.Wait("codecs");
+
+    StartHeadlessRender(parser.value(render_option),
+                        parser.value(sequence_option),
+                        parser.value(in_option),
+                        parser.value(out_option),
+                        parser.value(codec_option),
+                        parser.isSet(hardware_encode_option),
+                        parser.value(workers_option),
+                        parser.value(chunk_option),
+                        parser.value(passthrough_option));
+
+    MarkStartupPhase("headless render");
+    LogStartupTime();
+    return;
+  }
+
 
   //
-  // Start GUI (TODO CLI mode)
+  // Start GUI
   //
 
   StartGUI(parser.isSet(fullscreen_option));
 
-  // Create new project on startup
-  // TODO: Load project from startup_project_ instead if not empty
-  AddOpenProject(std::make_shared<Project>());
+  // Opening a project can take a while, so it waits for the event loop to let the main window show up first
+  QTimer::singleShot(0, this, [this]() {
+    MarkStartupPhase("first events");
+
+    // Opening a project probes its footage
+    startup_jobs_.Wait("codecs");
+
+    MarkStartupPhase("codecs");
+
+    // Load the project from the command line, or create a new one if there isn't one (or it couldn't be opened)
+    if (startup_project_.isEmpty() || !OpenProject(startup_project_)) {
+      AddOpenProject(std::make_shared<Project>());
+    }
+
+    MarkStartupPhase("project");
+    LogStartupTime();
+  });
 }
 
 void Core::Stop()
 {
+  // Nothing started in the background may still be running while everything is torn down
+  startup_jobs_.WaitForAll();
+
+  olive::memory_pressure.Stop();
+
   delete main_window_;
+
+  // Free any decoders still open
+  olive::decoder_pool.Clear();
+
+  olive::decode_worker_pool.SetWorkerCount(0);
+
+  // Cached frames go back to olive::memory_pool, which may be destroyed before the cache is
+  olive::stream_frame_cache.Clear();
+
+  // Frames rendered just before quitting are still worth keeping for next time
+  DiskFrameCache::WaitForWrites();
 }
 
 olive::MainWindow *Core::main_window()
@@ -215,6 +559,223 @@ void Core::CreateNewFolder()
   active_project_panel->Edit(new_folder.get());
 }
 
+bool Core::OpenProject(const QString &filename)
+{
+  ProjectPtr project = ProjectFile::Open(filename);
+
+  if (project == nullptr) {
+    QMessageBox::critical(main_window_,
+                          tr("Failed to open project"),
+                          tr("\"%1\" could not be opened as an Olive project.").arg(filename));
+    return false;
+  }
+
+  // Changes made since the project was last saved can be replayed before anything shows the project
+  ProjectJournal* journal = JournalOf(project.get());
+
+  if (ProjectJournal::HasChanges(filename)
+      && QMessageBox::question(main_window_,
+                               tr("Recover Project"),
+                               tr("\"%1\" has changes that were autosaved but never saved. Recover them?")
+                               .arg(filename)) == QMessageBox::Yes) {
+    journal->Recover();
+  } else {
+    journal->Start();
+  }
+
+  AddOpenProject(project);
+
+  // The project is usable straight away, Footage is flagged as it's checked
+  ValidateFootage(project.get());
+
+  return true;
+}
+
+void Core::DialogOpenProject()
+{
+  QString filename = QFileDialog::getOpenFileName(main_window_,
+                                                  tr("Open Project"),
+                                                  QString(),
+                                                  tr("Olive Project (*.ove)"));
+
+  if (!filename.isEmpty()) {
+    OpenProject(filename);
+  }
+}
+
+void Core::SaveActiveProject()
+{
+  Project* project = GetActiveProject();
+
+  if (project == nullptr) {
+    QMessageBox::critical(main_window_, tr("Failed to save project"), tr("Failed to find active Project panel"));
+    return;
+  }
+
+  // Projects that have never been saved need a filename first
+  if (project->filename().isEmpty()) {
+    SaveActiveProjectAs();
+    return;
+  }
+
+  SaveProject(project, project->filename());
+}
+
+void Core::SaveActiveProjectAs()
+{
+  Project* project = GetActiveProject();
+
+  if (project == nullptr) {
+    QMessageBox::critical(main_window_, tr("Failed to save project"), tr("Failed to find active Project panel"));
+    return;
+  }
+
+  QString filename = QFileDialog::getSaveFileName(main_window_,
+                                                  tr("Save Project As"),
+                                                  project->filename(),
+                                                  tr("Olive Project (*.ove)"));
+
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  if (!filename.endsWith(".ove", Qt::CaseInsensitive)) {
+    filename.append(".ove");
+  }
+
+  SaveProject(project, filename);
+}
+
+Project *Core::GetActiveProject()
+{
+  ProjectPanel* active_project_panel = olive::panel_focus_manager->MostRecentlyFocused<ProjectPanel>();
+
+  if (active_project_panel == nullptr) {
+    return nullptr;
+  }
+
+  return active_project_panel->project();
+}
+
+bool Core::SaveProject(Project *project, const QString &filename)
+{
+  if (!ProjectFile::Save(project, filename)) {
+    QMessageBox::critical(main_window_,
+                          tr("Failed to save project"),
+                          tr("The project could not be saved to \"%1\".").arg(filename));
+    return false;
+  }
+
+  // Everything journaled so far is in the file now
+  JournalOf(project)->Start();
+
+  return true;
+}
+
+ProjectJournal *Core::JournalOf(Project *project)
+{
+  ProjectJournal* journal = journals_.value(project);
+
+  if (journal == nullptr) {
+    journal = new ProjectJournal(project, this);
+    journals_.insert(project, journal);
+  }
+
+  return journal;
+}
+
+void Core::ValidateFootage(Project *project)
+{
+  QHash<QString, QList<FootagePtr> > footage;
+
+  GatherFootage(project->root(), footage);
+
+  QList<TaskPtr> tasks;
+
+  foreach (const QList<FootagePtr>& directory, footage) {
+    for (int i=0;i<directory.size();i+=ValidateTask::kBatchSize) {
+      TaskPtr t = std::make_shared<ValidateTask>(directory.mid(i, ValidateTask::kBatchSize));
+
+      connect(t.get(), SIGNAL(Finished()), this, SLOT(ValidateTaskFinished()));
+
+      tasks.append(t);
+    }
+  }
+
+  // Checking isn't an undoable action
+  foreach (TaskPtr t, tasks) {
+    olive::task_manager.AddTask(t);
+  }
+}
+
+void Core::GatherFootage(Item *item, QHash<QString, QList<FootagePtr> > &footage)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kFootage) {
+      FootagePtr f = std::static_pointer_cast<Footage>(item->shared_ptr_from_raw(child));
+
+      // Only the path is needed here, QFileInfo doesn't touch the file for it
+      footage[QFileInfo(f->filename()).absolutePath()].append(f);
+    }
+
+    GatherFootage(child, footage);
+  }
+}
+
+void Core::ValidateTaskFinished()
+{
+  ValidateTask* task = static_cast<ValidateTask*>(sender());
+
+  foreach (FootagePtr f, task->reprobed()) {
+    olive::task_manager.AddTask(std::make_shared<AnalyzeTask>(f));
+    olive::task_manager.AddTask(std::make_shared<IndexTask>(f));
+  }
+}
+
+void Core::MemoryPressureChanged(MemoryPressure::Level level)
+{
+  if (level == MemoryPressure::kNormal) {
+    olive::memory_pool.set_max_cached_bytes(normal_memory_pool_budget_);
+    olive::thumbnail_service.set_cache_budget(ThumbnailService::kCacheBudget);
+    olive::packet_cache.set_budget(normal_packet_cache_budget_);
+    olive::stream_frame_cache.set_budget(normal_stream_frame_cache_budget_);
+
+    // Decoders are opened again as they're needed
+    return;
+  }
+
+  // Record the budgets to go back to, unless they've been shrunk already
+  if (olive::packet_cache.budget() >= normal_packet_cache_budget_) {
+    normal_packet_cache_budget_ = olive::packet_cache.budget();
+  }
+
+  if (olive::memory_pool.max_cached_bytes() >= normal_memory_pool_budget_) {
+    normal_memory_pool_budget_ = olive::memory_pool.max_cached_bytes();
+  }
+
+  if (olive::stream_frame_cache.budget() >= normal_stream_frame_cache_budget_) {
+    normal_stream_frame_cache_budget_ = olive::stream_frame_cache.budget();
+  }
+
+  // Buffers waiting for reuse and thumbnails (which are on disk too) cost next to nothing to get back
+  olive::memory_pool.set_max_cached_bytes(0);
+  olive::thumbnail_service.set_cache_budget(0);
+
+  if (level == MemoryPressure::kWarning) {
+    olive::packet_cache.set_budget(normal_packet_cache_budget_ / 2);
+    olive::stream_frame_cache.set_budget(normal_stream_frame_cache_budget_ / 2);
+    return;
+  }
+
+  // Frames have to be decoded again, packets read again and idle decoders opened again, but that beats the process
+  // being killed
+  olive::packet_cache.set_budget(0);
+  olive::stream_frame_cache.set_budget(0);
+  olive::decoder_pool.Clear();
+}
+
 void Core::AddOpenProject(ProjectPtr p)
 {
   open_projects_.append(p);
@@ -225,16 +786,172 @@ void Core::AddOpenProject(ProjectPtr p)
 void Core::DeclareTypesForQt()
 {
   qRegisterMetaType<Task::Status>("Task::Status");
+  qRegisterMetaType<RenderJobPtr>("RenderJobPtr");
+  qRegisterMetaType<RenderProfile>("RenderProfile");
+}
+
+void Core::MarkStartupPhase(const QString &name)
+{
+  qint64 now = startup_timer_.nsecsElapsed();
+
+  startup_phases_.append(QStringLiteral("%1 %2 ms").arg(name,
+                                                        QString::number(static_cast<double>(now - startup_phase_start_)
+                                                                        / 1000000.0, 'f', 1)));
+
+  startup_phase_start_ = now;
+}
+
+void Core::LogStartupTime()
+{
+  QString phases = startup_phases_.join(", ");
+
+  // Background jobs overlap the phases, so they're listed separately
+  QStringList background = startup_jobs_.durations();
+
+  if (!background.isEmpty()) {
+    phases.append(QStringLiteral("; in the background: %1").arg(background.join(", ")));
+  }
+
+  qDebug().noquote() << QStringLiteral("Started in %1 ms (%2)").arg(QString::number(startup_timer_.elapsed()), phases);
+}
+
+void Core::StartBackgroundJobs(bool decode_worker)
+{
+  startup_jobs_.Run("codecs", []() {
+    // Register FFmpeg codecs and filters (deprecated in 4.0+)
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
+#if LIBAVFILTER_VERSION_INT < AV_VERSION_INT(7, 14, 100)
+    avfilter_register_all();
+#endif
+  });
+
+  // Decode workers don't render anything
+  if (decode_worker) {
+    return;
+  }
+
+  startup_jobs_.Run("color config", []() {
+    // Parsed the first time it's asked for, OCIO makes anything else asking for it meanwhile wait
+    try {
+      olive::color::GetConfig();
+    } catch (OCIO::Exception& e) {
+      qWarning() << "Failed to load OCIO config:" << e.what();
+    }
+  });
+
+  startup_jobs_.Run("shader cache", []() {
+    olive::gl::shader_cache.WarmUp();
+  });
+}
+
+void Core::StartHeadlessRender(const QString &output,
+                               const QString &sequence,
+                               const QString &in,
+                               const QString &out,
+                               const QString &codec,
+                               bool hardware_encoding,
+                               const QString &workers,
+                               const QString &chunk_frames,
+                               const QString &passthrough)
+{
+  HeadlessRender::Params params;
+  params.project = startup_project_;
+  params.sequence = sequence;
+  params.output = output;
+  params.codec = codec;
+  params.hardware_encoding = hardware_encoding;
+
+  bool in_ok, out_ok;
+  params.in = in.toLongLong(&in_ok);
+  params.out = out.toLongLong(&out_ok);
+
+  // Let HeadlessRender report the missing or invalid frame
+  if (!in_ok) {
+    params.in = -1;
+  }
+
+  if (!out_ok) {
+    params.out = -1;
+  }
+
+  if (!passthrough.isEmpty()) {
+    QString error;
+
+    if (!HeadlessRender::ReadSegments(passthrough, &params.passthrough, &error)) {
+      qWarning() << error;
+
+      QTimer::singleShot(0, []() {
+        QCoreApplication::exit(1);
+      });
+
+      return;
+    }
+  }
+
+  if (!workers.isEmpty()) {
+    // Chunks are rendered separately, so a segment's copied range could be split between workers
+    if (!params.passthrough.isEmpty()) {
+      qWarning() << "Passthrough segments are ignored when rendering with workers";
+    }
+
+    RenderCoordinator::Params coordinator_params;
+    coordinator_params.render = params;
+    coordinator_params.workers = RenderCoordinator::ReadWorkers(workers);
+    coordinator_params.chunk_frames = chunk_frames.toLongLong();
+
+    RenderCoordinator* coordinator = new RenderCoordinator(QCoreApplication::instance());
+
+    connect(coordinator, &RenderCoordinator::Finished, this, [](bool ok) {
+      QCoreApplication::exit(ok ? 0 : 1);
+    }, Qt::QueuedConnection);
+
+    if (!coordinator->Start(coordinator_params)) {
+      QTimer::singleShot(0, []() {
+        QCoreApplication::exit(1);
+      });
+    }
+
+    return;
+  }
+
+  HeadlessRender* render = new HeadlessRender(QCoreApplication::instance());
+
+  // Exit once the render is done (queued, since rendering may finish before the event loop has started)
+  connect(render, &HeadlessRender::Finished, this, [](bool ok) {
+    QCoreApplication::exit(ok ? 0 : 1);
+  }, Qt::QueuedConnection);
+
+  if (!render->Start(params)) {
+    QTimer::singleShot(0, []() {
+      QCoreApplication::exit(1);
+    });
+  }
 }
 
 void Core::StartGUI(bool full_screen)
 {
+  // Shown while the main window is being built, which blocks the event loop
+  QSplashScreen* splash = new QSplashScreen(QPixmap(":/graphics/olive-splash.png"));
+  splash->setAttribute(Qt::WA_DeleteOnClose);
+  splash->show();
+
+  // Let it paint before the event loop starts
+  QCoreApplication::processEvents();
+
+  MarkStartupPhase("splash");
+
   // Set UI style
   olive::style::AppSetDefault();
 
+  MarkStartupPhase("style");
+
   // Set up shared menus
   olive::menu_shared.Initialize();
 
+  MarkStartupPhase("menus");
+
   // Since we're starting GUI mode, create a PanelFocusManager (auto-deletes with QObject)
   olive::panel_focus_manager = new PanelFocusManager(this);
 
@@ -246,12 +963,19 @@ void Core::StartGUI(bool full_screen)
 
   // Create main window and open it
   main_window_ = new olive::MainWindow();
+
+  MarkStartupPhase("main window");
+
   if (full_screen) {
     main_window_->showFullScreen();
   } else {
     main_window_->showMaximized();
   }
 
+  splash->finish(main_window_);
+
+  MarkStartupPhase("show");
+
   // When a new project is opened, update the mainwindow
   connect(this, SIGNAL(ProjectOpened(Project*)), main_window_, SLOT(ProjectOpen(Project*)));
 
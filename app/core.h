@@ -21,9 +21,15 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QList>
+#include <QStringList>
 
+#include "common/memorypressure.h"
+#include "common/startupjobs.h"
 #include "project/project.h"
+#include "project/projectjournal.h"
 #include "project/projectviewmodel.h"
 #include "window/mainwindow/mainwindow.h"
 #include "task/task.h"
@@ -101,6 +107,15 @@ public:
    */
   void StartModalTask(Task* t);
 
+  /**
+   * @brief Open a project file and add it to the open projects
+   *
+   * @return
+   *
+   * TRUE if the project was opened. Otherwise an error message has been shown.
+   */
+  bool OpenProject(const QString& filename);
+
 public slots:
   /**
    * @brief Set the current application-wide tool
@@ -124,6 +139,21 @@ public slots:
    */
   void CreateNewFolder();
 
+  /**
+   * @brief Show a file dialog and open the project file selected (runs OpenProject())
+   */
+  void DialogOpenProject();
+
+  /**
+   * @brief Save the currently active project to the file it was opened from (or ask for one if it hasn't been saved)
+   */
+  void SaveActiveProject();
+
+  /**
+   * @brief Show a file dialog and save the currently active project to the file selected
+   */
+  void SaveActiveProjectAs();
+
 signals:
   /**
    * @brief Signal emitted when a project is opened
@@ -145,11 +175,36 @@ signals:
   void SnappingChanged(const bool& b);
 
 private:
+  /**
+   * @brief Return the Project of the most recently focused Project panel, or nullptr if there isn't one
+   */
+  Project* GetActiveProject();
+
+  /**
+   * @brief Save a project, showing an error message if it fails
+   */
+  bool SaveProject(Project* project, const QString& filename);
+
+  /**
+   * @brief Return the autosave journal of a project, creating it if it doesn't have one yet
+   */
+  ProjectJournal* JournalOf(Project* project);
+
   /**
    * @brief Creates an empty project and adds it to the "open projects"
    */
   void AddOpenProject(ProjectPtr p);
 
+  /**
+   * @brief Queue ValidateTasks to check every Footage in a project that was just opened against its file
+   */
+  void ValidateFootage(Project* project);
+
+  /**
+   * @brief Add every Footage in an Item and its children to a list of Footage per directory
+   */
+  static void GatherFootage(Item* item, QHash<QString, QList<FootagePtr> >& footage);
+
   /**
    * @brief Declare custom types/classes for Qt's signal/slot system
    *
@@ -158,6 +213,27 @@ private:
    */
   void DeclareTypesForQt();
 
+  /**
+   * @brief Start the startup work that doesn't have to happen in order on the main thread (see startup_jobs_)
+   *
+   * Registers FFmpeg's codecs ("codecs", which anything decoding or encoding has to Wait() for), and unless this is a
+   * decode worker, parses the OCIO config and reads the shader cache into memory (which nothing waits for, both are
+   * thread-safe and just block whatever needs them first until they're done).
+   */
+  void StartBackgroundJobs(bool decode_worker);
+
+  /**
+   * @brief Record that a startup phase has finished (timed from the end of the previous phase)
+   */
+  void MarkStartupPhase(const QString& name);
+
+  /**
+   * @brief Log how long startup took and how long each phase took, in one line
+   *
+   * Timed from the start of Start(), so creating the application instance beforehand isn't included.
+   */
+  void LogStartupTime();
+
   /**
    * @brief Start GUI portion of Olive
    *
@@ -166,6 +242,27 @@ private:
    */
   void StartGUI(bool full_screen);
 
+  /**
+   * @brief Render the startup project's sequence without starting the GUI (see HeadlessRender)
+   *
+   * If a file of worker commands is given, the render is split into chunks that are rendered by the workers instead
+   * (see RenderCoordinator).
+   *
+   * If a passthrough list is given, a video file is smart rendered with the segments listed in it (see
+   * HeadlessRender::ReadSegments()).
+   *
+   * The application exits once the render is done, with a non-zero code if it failed.
+   */
+  void StartHeadlessRender(const QString& output,
+                           const QString& sequence,
+                           const QString& in,
+                           const QString& out,
+                           const QString& codec,
+                           bool hardware_encoding,
+                           const QString& workers,
+                           const QString& chunk_frames,
+                           const QString& passthrough);
+
   /**
    * @brief Get the currently active project
    *
@@ -196,6 +293,11 @@ private:
    */
   QList<ProjectPtr> open_projects_;
 
+  /**
+   * @brief Autosave journals of open projects that have been saved (see ProjectJournal)
+   */
+  QHash<Project*, ProjectJournal*> journals_;
+
   /**
    * @brief Currently active tool
    */
@@ -206,6 +308,47 @@ private:
    */
   bool snapping_;
 
+  /**
+   * @brief Started at the beginning of Start() to time startup
+   */
+  QElapsedTimer startup_timer_;
+
+  /**
+   * @brief Startup phases that have finished and how long each took (see MarkStartupPhase())
+   */
+  QStringList startup_phases_;
+
+  /**
+   * @brief Time the current startup phase started at in nanoseconds (relative to startup_timer_)
+   */
+  qint64 startup_phase_start_;
+
+  /**
+   * @brief Startup work running in the background while the main thread starts everything else
+   */
+  StartupJobs startup_jobs_;
+
+  /**
+   * @brief Budgets of the caches MemoryPressureChanged() shrinks, recorded when pressure rises from kNormal
+   */
+  qint64 normal_packet_cache_budget_;
+  qint64 normal_memory_pool_budget_;
+  qint64 normal_stream_frame_cache_budget_;
+
+private slots:
+  /**
+   * @brief Queue AnalyzeTasks for the Footage a finished ValidateTask probed again
+   */
+  void ValidateTaskFinished();
+
+  /**
+   * @brief Shrink or grow the application-wide caches as memory pressure changes (see MemoryPressure)
+   *
+   * Caches are shrunk in order of how cheap their contents are to get back: pooled buffers and thumbnails first, then
+   * decoded source frames and cached packets, then idle decoders. They're given their budgets back once pressure falls.
+   */
+  void MemoryPressureChanged(MemoryPressure::Level level);
+
 };
 
 namespace olive {
@@ -0,0 +1,213 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "blockcache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMultiMap>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// Default disk budget
+const qint64 kDefaultBlockCacheBudget = Q_INT64_C(2) * 1024 * 1024 * 1024;
+
+struct BlockEntry {
+  qint64 size;
+
+  // Higher is more recently used
+  quint64 last_access;
+};
+
+QMutex cache_mutex;
+
+// Every cached block by filename, protected by cache_mutex
+QHash<QString, BlockEntry> entries;
+bool entries_loaded = false;
+qint64 used_bytes = 0;
+quint64 access_counter = 0;
+
+qint64 cache_budget = kDefaultBlockCacheBudget;
+
+}
+
+QString BlockCache::FileKey(const QString &filename, qint64 size, qint64 last_modified)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(filename.toUtf8());
+  hash.addData(QByteArray::number(size));
+  hash.addData(QByteArray::number(last_modified));
+
+  return QString(hash.result().toHex());
+}
+
+bool BlockCache::Load(const QString &key, qint64 index, QByteArray *data)
+{
+  QString filename = GetFilename(key, index);
+
+  QMutexLocker locker(&cache_mutex);
+
+  LoadEntries();
+
+  QHash<QString, BlockEntry>::iterator entry = entries.find(filename);
+
+  if (entry == entries.end()) {
+    return false;
+  }
+
+  entry->last_access = ++access_counter;
+
+  locker.unlock();
+
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  *data = file.readAll();
+
+  return true;
+}
+
+void BlockCache::Save(const QString &key, qint64 index, const QByteArray &data)
+{
+  QString filename = GetFilename(key, index);
+  qint64 size = data.size();
+
+  QMutexLocker locker(&cache_mutex);
+
+  if (size > cache_budget) {
+    return;
+  }
+
+  LoadEntries();
+
+  if (entries.contains(filename)) {
+    return;
+  }
+
+  MakeSpace(size);
+
+  // Count the block straight away so concurrent saves can't overshoot the budget
+  entries.insert(filename, {size, ++access_counter});
+  used_bytes += size;
+
+  locker.unlock();
+
+  QDir().mkpath(QFileInfo(filename).path());
+
+  // QSaveFile ensures a partially written block can never be read by Load()
+  QSaveFile file(filename);
+
+  if (file.open(QFile::WriteOnly) && file.write(data) == size && file.commit()) {
+    return;
+  }
+
+  locker.relock();
+
+  if (entries.remove(filename) > 0) {
+    used_bytes -= size;
+  }
+}
+
+qint64 BlockCache::budget()
+{
+  QMutexLocker locker(&cache_mutex);
+
+  return cache_budget;
+}
+
+void BlockCache::set_budget(qint64 bytes)
+{
+  QMutexLocker locker(&cache_mutex);
+
+  cache_budget = bytes;
+
+  if (entries_loaded) {
+    MakeSpace(0);
+  }
+}
+
+QString BlockCache::GetDirectory()
+{
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("blocks");
+}
+
+QString BlockCache::GetFilename(const QString &key, qint64 index)
+{
+  // One directory per file so no single directory gets too large
+  return QDir(GetDirectory()).filePath(QStringLiteral("%1/%2").arg(key, QString::number(index)));
+}
+
+void BlockCache::LoadEntries()
+{
+  if (entries_loaded) {
+    return;
+  }
+
+  entries_loaded = true;
+
+  // Blocks from previous sessions are ordered by when they were written
+  QMultiMap<QDateTime, QFileInfo> existing;
+
+  QDirIterator it(GetDirectory(), QDir::Files, QDirIterator::Subdirectories);
+
+  while (it.hasNext()) {
+    it.next();
+
+    existing.insert(it.fileInfo().lastModified(), it.fileInfo());
+  }
+
+  foreach (const QFileInfo& info, existing) {
+    entries.insert(info.filePath(), {info.size(), ++access_counter});
+    used_bytes += info.size();
+  }
+
+  MakeSpace(0);
+}
+
+void BlockCache::MakeSpace(qint64 incoming)
+{
+  while (used_bytes + incoming > cache_budget && !entries.isEmpty()) {
+    QHash<QString, BlockEntry>::iterator oldest = entries.begin();
+
+    for (QHash<QString, BlockEntry>::iterator i=entries.begin();i!=entries.end();i++) {
+      if (i->last_access < oldest->last_access) {
+        oldest = i;
+      }
+    }
+
+    QFile::remove(oldest.key());
+
+    used_bytes -= oldest->size;
+
+    entries.erase(oldest);
+  }
+}
@@ -0,0 +1,93 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief A persistent local cache of fixed-size blocks read from remote media
+ *
+ * Reading from network storage (SMB/NFS mounts, HTTP) costs a round trip per request, so blocks FFmpegBufferedIO
+ * fetches from remote files are also written to the local cache directory. Reading the same part of a file again
+ * (e.g. scrubbing back over it, or reopening the project) is then served from local disk.
+ *
+ * Blocks are keyed by a file's identity (see FileKey()), so a file that's modified or replaced on the server is simply
+ * read again. The least recently used blocks are deleted once the cache exceeds its budget. All functions are
+ * thread-safe.
+ */
+class BlockCache
+{
+public:
+  /**
+   * @brief Identity of a file's current contents, combining its location, size and modification time
+   *
+   * @param last_modified
+   *
+   * Modification time in milliseconds since epoch, or 0 if it's unknown (e.g. for most HTTP sources).
+   */
+  static QString FileKey(const QString& filename, qint64 size, qint64 last_modified);
+
+  /**
+   * @brief Read a cached block
+   *
+   * @return
+   *
+   * TRUE if the block was cached and read into `data`.
+   */
+  static bool Load(const QString& key, qint64 index, QByteArray* data);
+
+  /**
+   * @brief Cache a block, evicting the least recently used blocks if this exceeds the budget
+   *
+   * Does nothing if the cache is disabled (budget of 0).
+   */
+  static void Save(const QString& key, qint64 index, const QByteArray& data);
+
+  static qint64 budget();
+
+  /**
+   * @brief Set the maximum number of bytes cached blocks may use on disk, 0 disables the cache
+   */
+  static void set_budget(qint64 bytes);
+
+private:
+  static QString GetDirectory();
+
+  static QString GetFilename(const QString& key, qint64 index);
+
+  /**
+   * @brief Scan the cache directory once so blocks cached by previous sessions count towards the budget
+   *
+   * Must be called with the cache mutex held.
+   */
+  static void LoadEntries();
+
+  /**
+   * @brief Remove least recently used blocks until `incoming` more bytes fit in the budget
+   *
+   * Must be called with the cache mutex held.
+   */
+  static void MakeSpace(qint64 incoming);
+};
+
+#endif // BLOCKCACHE_H
@@ -0,0 +1,283 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "conformcache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <cstddef>
+#include <cstring>
+
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief Header of a conform cache file
+ *
+ * The header is followed by the blocks of samples (see ConformCache).
+ */
+struct ConformHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t channels;
+  int32_t sample_rate;
+  int64_t sample_count;
+};
+
+const char kConformMagic[4] = {'O', 'V', 'C', 'F'};
+const uint32_t kConformVersion = 1;
+
+ConformCache::ConformCache() :
+  channels_(0),
+  sample_rate_(0),
+  sample_count_(0),
+  writer_(nullptr),
+  block_frames_(0),
+  map_(nullptr)
+{
+}
+
+ConformCache::~ConformCache()
+{
+  Close();
+}
+
+bool ConformCache::Create(AudioStream *stream, int sample_rate, int channels)
+{
+  Close();
+
+  channels_ = channels;
+  sample_rate_ = sample_rate;
+  sample_count_ = 0;
+  block_frames_ = 0;
+  block_.resize(kBlockFrames * channels_);
+
+  // QSaveFile ensures a partially written cache can never be read by Open()
+  writer_ = new QSaveFile(GetCacheFilename(stream, sample_rate, channels));
+
+  if (!writer_->open(QFile::WriteOnly)) {
+    qWarning() << QStringLiteral("Failed to write conform cache for %1").arg(stream->footage()->filename());
+    Close();
+    return false;
+  }
+
+  // The sample count is filled in by Commit()
+  ConformHeader header;
+  memcpy(header.magic, kConformMagic, sizeof(kConformMagic));
+  header.version = kConformVersion;
+  header.channels = channels_;
+  header.sample_rate = sample_rate_;
+  header.sample_count = 0;
+
+  writer_->write(reinterpret_cast<const char*>(&header), sizeof(ConformHeader));
+
+  return true;
+}
+
+bool ConformCache::AddSamples(const float * const *planes, int src_channels, int frames)
+{
+  int i = 0;
+
+  while (i < frames) {
+    int copy = qMin(frames - i, kBlockFrames - block_frames_);
+
+    for (int j=0;j<channels_;j++) {
+      float* dst = block_.data() + j * kBlockFrames + block_frames_;
+
+      // Mono is sent to every channel
+      int src = (src_channels == 1) ? 0 : j;
+
+      if (src < src_channels) {
+        memcpy(dst, planes[src] + i, static_cast<size_t>(copy) * sizeof(float));
+      } else {
+        memset(dst, 0, static_cast<size_t>(copy) * sizeof(float));
+      }
+    }
+
+    block_frames_ += copy;
+    i += copy;
+
+    if (block_frames_ == kBlockFrames && !FlushBlock()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ConformCache::Commit()
+{
+  if (writer_ == nullptr) {
+    return false;
+  }
+
+  bool ok = FlushBlock();
+
+  if (ok) {
+    qint64 bytes = static_cast<qint64>(sizeof(sample_count_));
+
+    ok = writer_->seek(offsetof(ConformHeader, sample_count))
+        && writer_->write(reinterpret_cast<const char*>(&sample_count_), bytes) == bytes
+        && writer_->commit();
+  }
+
+  Close();
+
+  return ok;
+}
+
+bool ConformCache::Open(AudioStream *stream, int sample_rate, int channels)
+{
+  Close();
+
+  file_.setFileName(GetCacheFilename(stream, sample_rate, channels));
+
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  qint64 file_size = file_.size();
+
+  if (file_size < static_cast<qint64>(sizeof(ConformHeader))) {
+    Close();
+    return false;
+  }
+
+  map_ = file_.map(0, file_size);
+
+  if (map_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  const ConformHeader* header = reinterpret_cast<const ConformHeader*>(map_);
+
+  qint64 expected_size = static_cast<qint64>(sizeof(ConformHeader))
+      + header->sample_count * header->channels * static_cast<qint64>(sizeof(float));
+
+  if (memcmp(header->magic, kConformMagic, sizeof(kConformMagic)) != 0
+      || header->version != kConformVersion
+      || header->channels != channels
+      || header->sample_rate != sample_rate
+      || header->sample_count < 0
+      || expected_size != file_size) {
+    Close();
+    return false;
+  }
+
+  channels_ = header->channels;
+  sample_rate_ = header->sample_rate;
+  sample_count_ = header->sample_count;
+
+  return true;
+}
+
+void ConformCache::Close()
+{
+  delete writer_;
+  writer_ = nullptr;
+  block_.clear();
+
+  if (map_ != nullptr) {
+    file_.unmap(map_);
+    map_ = nullptr;
+  }
+
+  file_.close();
+
+  sample_count_ = 0;
+}
+
+int64_t ConformCache::sample_count() const
+{
+  return sample_count_;
+}
+
+const float *ConformCache::Samples(int channel, int64_t sample, int *count) const
+{
+  if (map_ == nullptr || sample < 0 || sample >= sample_count_ || channel < 0 || channel >= channels_) {
+    *count = 0;
+    return nullptr;
+  }
+
+  int64_t block = sample / kBlockFrames;
+  int64_t block_start = block * kBlockFrames;
+
+  // Only the last block can be shorter
+  int64_t block_length = qMin(static_cast<int64_t>(kBlockFrames), sample_count_ - block_start);
+
+  *count = static_cast<int>(qMin(static_cast<int64_t>(*count), block_start + block_length - sample));
+
+  const float* samples = reinterpret_cast<const float*>(map_ + sizeof(ConformHeader));
+
+  return samples + block_start * channels_ + channel * block_length + (sample - block_start);
+}
+
+bool ConformCache::NeedsConform(AudioStream *stream, int sample_rate, int channels)
+{
+  return stream->sample_rate() != sample_rate || stream->channels() != channels;
+}
+
+bool ConformCache::Exists(AudioStream *stream, int sample_rate, int channels)
+{
+  return QFileInfo::exists(GetCacheFilename(stream, sample_rate, channels));
+}
+
+QString ConformCache::GetCacheFilename(AudioStream *stream, int sample_rate, int channels)
+{
+  Footage* footage = stream->footage();
+
+  // Generate a unique hash for this file, stream and format
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage->filename().toUtf8());
+  hash.addData(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(QFileInfo(footage->filename()).size()));
+  hash.addData(QByteArray::number(stream->index()));
+  hash.addData(QByteArray::number(sample_rate));
+  hash.addData(QByteArray::number(channels));
+
+  QDir conform_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("conform"));
+  conform_dir.mkpath(".");
+
+  return conform_dir.filePath(QString(hash.result().toHex()));
+}
+
+bool ConformCache::FlushBlock()
+{
+  if (block_frames_ == 0) {
+    return true;
+  }
+
+  // Partial blocks (only ever the last one) keep their channels next to each other
+  for (int i=0;i<channels_;i++) {
+    qint64 bytes = static_cast<qint64>(block_frames_) * static_cast<qint64>(sizeof(float));
+
+    if (writer_->write(reinterpret_cast<const char*>(block_.constData() + i * kBlockFrames), bytes) != bytes) {
+      return false;
+    }
+  }
+
+  sample_count_ += block_frames_;
+  block_frames_ = 0;
+
+  return true;
+}
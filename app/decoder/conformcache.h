@@ -0,0 +1,146 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CONFORMCACHE_H
+#define CONFORMCACHE_H
+
+#include <QFile>
+#include <QSaveFile>
+#include <QVector>
+
+#include "project/item/footage/audiostream.h"
+
+/**
+ * @brief An AudioStream decoded and resampled to a certain sample rate and channel count, stored as float PCM
+ *
+ * Resampling audio in real time costs CPU that video decoding needs, so streams that don't match the format they're
+ * played at are conformed once in the background (see ConformTask) and read from this cache instead.
+ *
+ * The file is memory-mapped when it's read, so Samples() returns pointers straight into the file without decoding or
+ * copying anything. Samples are stored planar in blocks of kBlockFrames sample frames (each block holds every
+ * channel's samples for its frames one after the other), so each channel's samples are contiguous within a block and
+ * the file can still be written as the stream is decoded.
+ *
+ * Mono streams are sent to every channel, otherwise each channel comes from the same channel of the stream (or is
+ * silent if the stream has fewer channels), the same as AudioMixer does with streams it decodes itself.
+ */
+class ConformCache
+{
+public:
+  ConformCache();
+
+  ~ConformCache();
+
+  ConformCache(const ConformCache& other) = delete;
+  ConformCache(ConformCache&& other) = delete;
+  ConformCache& operator=(const ConformCache& other) = delete;
+  ConformCache& operator=(ConformCache&& other) = delete;
+
+  /**
+   * @brief Number of sample frames in each block of the file
+   */
+  static const int kBlockFrames = 65536;
+
+  /**
+   * @brief Start writing a cache file, samples are then added with AddSamples() and the file written with Commit()
+   */
+  bool Create(AudioStream* stream, int sample_rate, int channels);
+
+  /**
+   * @brief Add planar float samples (as returned by Decoder::Retrieve()) of the stream's own channel count
+   */
+  bool AddSamples(const float* const* planes, int src_channels, int frames);
+
+  /**
+   * @brief Write the remaining samples and replace any previous cache file, only complete files are ever read
+   */
+  bool Commit();
+
+  /**
+   * @brief Map a cache file to read it with Samples()
+   *
+   * @return
+   *
+   * TRUE if a valid cache exists for this stream and format.
+   */
+  bool Open(AudioStream* stream, int sample_rate, int channels);
+
+  /**
+   * @brief Unmap the file (called automatically on destruction)
+   */
+  void Close();
+
+  /**
+   * @brief Number of sample frames in the cache
+   */
+  int64_t sample_count() const;
+
+  /**
+   * @brief Returns a pointer to a channel's samples from a certain sample frame onwards
+   *
+   * @param count
+   *
+   * The number of samples wanted. Set to how many can be read from the pointer, which is less if the block or the
+   * cache ends first.
+   *
+   * @return
+   *
+   * Pointer into the mapped file, or nullptr if `sample` isn't in the cache.
+   */
+  const float* Samples(int channel, int64_t sample, int* count) const;
+
+  /**
+   * @brief Returns whether a stream needs to be conformed to be played at a certain format
+   */
+  static bool NeedsConform(AudioStream* stream, int sample_rate, int channels);
+
+  /**
+   * @brief Returns whether a cache file exists for this stream and format
+   */
+  static bool Exists(AudioStream* stream, int sample_rate, int channels);
+
+  static QString GetCacheFilename(AudioStream* stream, int sample_rate, int channels);
+
+private:
+  /**
+   * @brief Write the samples collected in block_ as a (possibly partial) block
+   */
+  bool FlushBlock();
+
+  int channels_;
+
+  int sample_rate_;
+
+  int64_t sample_count_;
+
+  // Writing
+  QSaveFile* writer_;
+
+  QVector<float> block_;
+
+  int block_frames_;
+
+  // Reading
+  QFile file_;
+
+  uchar* map_;
+};
+
+#endif // CONFORMCACHE_H
@@ -20,13 +20,35 @@
 
 #include "decoder.h"
 
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include "project/item/footage/videostream.h"
+
 Decoder::Decoder() :
-  open_(false)
+  open_(false),
+  target_width_(0),
+  target_height_(0),
+  output_sample_rate_(0),
+  purpose_(kInteractive),
+  threading_mode_(kThreadingAuto),
+  thread_count_(0),
+  cancel_token_(nullptr),
+  stream_(nullptr)
 {
 }
 
 Decoder::Decoder(Stream *fs) :
   open_(false),
+  target_width_(0),
+  target_height_(0),
+  output_sample_rate_(0),
+  purpose_(kInteractive),
+  threading_mode_(kThreadingAuto),
+  thread_count_(0),
+  cancel_token_(nullptr),
   stream_(fs)
 {
 }
@@ -46,3 +68,113 @@ void Decoder::set_stream(Stream *fs)
 
   stream_ = fs;
 }
+
+bool Decoder::DeepProbe(Footage *f)
+{
+  Q_UNUSED(f)
+
+  return true;
+}
+
+void Decoder::set_target_resolution(const int &width, const int &height)
+{
+  target_width_ = width;
+  target_height_ = height;
+}
+
+void Decoder::set_output_sample_rate(const int &sample_rate)
+{
+  output_sample_rate_ = sample_rate;
+}
+
+Decoder::Purpose Decoder::purpose() const
+{
+  return purpose_;
+}
+
+void Decoder::set_purpose(Decoder::Purpose purpose)
+{
+  purpose_ = purpose;
+}
+
+void Decoder::set_threading(Decoder::ThreadingMode mode, int thread_count)
+{
+  threading_mode_ = mode;
+  thread_count_ = thread_count;
+}
+
+void Decoder::set_cancel_token(const QAtomicInt *token)
+{
+  cancel_token_ = token;
+}
+
+bool Decoder::Analyze()
+{
+  return true;
+}
+
+qint64 Decoder::bytes_read()
+{
+  return 0;
+}
+
+QString Decoder::GetIndexFilename()
+{
+  if (stream_ == nullptr || stream_->footage() == nullptr) {
+    return QString();
+  }
+
+  Footage* footage = stream_->footage();
+
+  // Generate a unique hash for this file and stream
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage->filename().toUtf8());
+  hash.addData(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(QFileInfo(footage->filename()).size()));
+  hash.addData(QByteArray::number(stream_->index()));
+
+  // Proxies have their own index
+  bool is_proxy;
+  QString media_filename = GetMediaFilename(&is_proxy);
+
+  if (is_proxy) {
+    hash.addData(media_filename.toUtf8());
+  }
+
+  QDir index_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("index"));
+  index_dir.mkpath(".");
+
+  return index_dir.filePath(QString(hash.result().toHex()));
+}
+
+QString Decoder::GetMediaFilename(bool *is_proxy)
+{
+  bool use_proxy = false;
+  QString filename;
+
+  Footage* footage = stream_->footage();
+
+  if (stream_->type() == Stream::kVideo) {
+    VideoStream* video_stream = static_cast<VideoStream*>(stream_);
+
+    // Proxy information may be set by a ProxyTask at any time
+    footage->Lock();
+
+    if (video_stream->CanUseProxy(target_width_, target_height_)) {
+      use_proxy = true;
+      filename = video_stream->proxy_filename();
+    }
+
+    footage->Unlock();
+  }
+
+  if (!use_proxy) {
+    filename = footage->filename();
+  }
+
+  if (is_proxy != nullptr) {
+    *is_proxy = use_proxy;
+  }
+
+  return filename;
+}
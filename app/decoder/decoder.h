@@ -21,6 +21,7 @@
 #ifndef DECODER_H
 #define DECODER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include <stdint.h>
 
@@ -54,9 +55,76 @@ public:
 
   virtual ~Decoder();
 
+  /**
+   * @brief What the decoded frames are for, which decides whether latency or throughput matters more
+   */
+  enum Purpose {
+    /// Viewers, scrubbing and thumbnails, where each frame should arrive as soon as possible
+    kInteractive,
+
+    /// Exporting, where frames are read in order and total throughput matters most
+    kExport
+  };
+
+  /**
+   * @brief How a Decoder splits decoding over threads
+   */
+  enum ThreadingMode {
+    /// Picked by the Decoder for the codec and purpose (the default)
+    kThreadingAuto,
+
+    /// Threads work on different parts of the same frame, adding no latency
+    kThreadingSlice,
+
+    /// Threads work on consecutive frames, which has the most throughput but delays each frame by a frame per thread
+    kThreadingFrame
+  };
+
   Stream* stream();
   void set_stream(Stream* fs);
 
+  /**
+   * @brief Set the resolution decoded frames will be displayed at
+   *
+   * Decoders can use this to decode a lower resolution version of the media (e.g. a proxy) if it still has enough
+   * resolution for display. Takes effect the next time the Decoder is opened. Set to 0x0 (the default) to always
+   * decode at full resolution.
+   */
+  void set_target_resolution(const int& width, const int& height);
+
+  /**
+   * @brief Set the sample rate audio will be returned at from Retrieve()
+   *
+   * Usually this is the Sequence's audio_sampling_rate(). Takes effect on the next Retrieve(). Set to 0 (the default)
+   * to return audio at the stream's own sample rate.
+   */
+  void set_output_sample_rate(const int& sample_rate);
+
+  Purpose purpose() const;
+
+  /**
+   * @brief Set what the decoded frames are for (kInteractive by default), takes effect the next time it's opened
+   */
+  void set_purpose(Purpose purpose);
+
+  /**
+   * @brief Set how decoding is split over threads, takes effect the next time the Decoder is opened
+   *
+   * @param thread_count
+   *
+   * Number of threads, or 0 (the default) to let the Decoder pick based on the number of cores and how many other
+   * Decoders are open.
+   */
+  void set_threading(ThreadingMode mode, int thread_count = 0);
+
+  /**
+   * @brief Set a flag that aborts blocking IO in Probe(), DeepProbe(), Open() and Analyze() once it becomes non-zero
+   *
+   * Usually a Task's cancel_token(), so a Task stuck on unresponsive storage can still be cancelled quickly. The flag
+   * must outlive any use of this Decoder. Set to nullptr (the default) to never abort.
+   */
+  void set_cancel_token(const QAtomicInt* token);
+
   /**
    * @brief Probe a footage file and dump metadata about it
    *
@@ -84,6 +152,20 @@ public:
    */
   virtual bool Probe(Footage* f) = 0;
 
+  /**
+   * @brief Fill in exact metadata for a Footage that has already been probed by this Decoder
+   *
+   * Probe() is expected to be fast so imported Footage becomes usable immediately, which can mean some of its
+   * metadata (e.g. durations) is estimated. DeepProbe() analyzes the file fully and updates the Footage's existing
+   * Stream objects. It's run at a lower priority after Probe() (see olive::DeepProbeMedia()).
+   *
+   * The default implementation does nothing and returns TRUE.
+   *
+   * @return
+   *
+   * TRUE if the Footage's metadata is now exact, FALSE if the analysis failed (the metadata from Probe() is kept).
+   */
+  virtual bool DeepProbe(Footage* f);
 
 
   /**
@@ -139,16 +221,66 @@ public:
   /**
    * @brief Prepare footage for use by a Decoder later
    *
-   * Needs fleshing out. This functions purpose will be to perform initial analyses of a video file. Any caching,
-   * indexing, or transcoding to help make this media performant and reliable should be done here.
+   * Performs initial analyses of a media file. Any caching, indexing, or transcoding to help make this media
+   * performant and reliable should be done here. Results should be stored on disk (see GetIndexFilename()) so that
+   * later calls to Open() can use them instead of having to analyze the file again.
+   *
+   * The default implementation does nothing, which is appropriate for Decoders that don't need any analysis.
+   *
+   * @return
+   *
+   * TRUE if the media was analyzed successfully (or didn't need analyzing), FALSE if an error occurred.
    */
-  //virtual void Analyze();// = 0;
-
+  virtual bool Analyze();
 
+  /**
+   * @brief Total number of bytes this Decoder has read from storage since it was created
+   *
+   * Used for Task telemetry, so it only needs to be an estimate. The default implementation returns 0.
+   */
+  virtual qint64 bytes_read();
 
 protected:
+  /**
+   * @brief Get a filename for storing the results of Analyze() for the current stream
+   *
+   * The filename is unique to the stream's footage filename, last modified timestamp, and file size, so if the file
+   * is changed or replaced, a new analysis will automatically be required. Any directories in the path are created
+   * by this function.
+   *
+   * @return
+   *
+   * An absolute path in the application cache directory, or an empty string if no stream is set.
+   */
+  QString GetIndexFilename();
+
+  /**
+   * @brief Returns the media filename this Decoder should open for the current stream
+   *
+   * This will be the stream's proxy file if one exists and it's large enough for the target resolution (see
+   * set_target_resolution()). Otherwise it's the footage's original filename.
+   *
+   * @param is_proxy
+   *
+   * Set to TRUE if the returned filename is a proxy (optional).
+   */
+  QString GetMediaFilename(bool* is_proxy = nullptr);
+
   bool open_;
 
+  int target_width_;
+  int target_height_;
+
+  int output_sample_rate_;
+
+  Purpose purpose_;
+
+  ThreadingMode threading_mode_;
+
+  int thread_count_;
+
+  const QAtomicInt* cancel_token_;
+
 private:
   Stream* stream_;
 };
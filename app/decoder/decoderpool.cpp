@@ -0,0 +1,237 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decoderpool.h"
+
+#include <QMutexLocker>
+
+#include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "decoder/imagesequence/imagesequencedecoder.h"
+#include "decoder/remote/decodeworkerpool.h"
+#include "decoder/remote/remotedecoder.h"
+#include "project/item/footage/videostream.h"
+
+DecoderPool olive::decoder_pool;
+
+DecoderPool::DecoderPool() :
+  hits_(0),
+  misses_(0)
+{
+}
+
+DecoderPool::~DecoderPool()
+{
+  Clear();
+}
+
+DecoderPtr DecoderPool::Acquire(Stream *stream, const rational &time, int target_width, int target_height,
+                                Decoder::Purpose purpose)
+{
+  bool proxy = WillUseProxy(stream, target_width, target_height);
+
+  QMutexLocker locker(&mutex_);
+
+  QList<PooledDecoder>& list = decoders_[stream];
+
+  int best_forward = -1;
+  int best_any = -1;
+
+  for (int i=0;i<list.size();i++) {
+    const PooledDecoder& pd = list.at(i);
+
+    // Only reuse Decoders that are decoding the same file (original or proxy) this caller needs, set up for the same
+    // purpose
+    if (pd.in_use || pd.proxy != proxy || pd.purpose != purpose) {
+      continue;
+    }
+
+    // Prefer a Decoder positioned at or just before the requested time since it can decode forward
+    if (pd.last_time <= time
+        && (best_forward == -1 || pd.last_time > list.at(best_forward).last_time)) {
+      best_forward = i;
+    }
+
+    // Otherwise, fall back to whichever Decoder is closest either way
+    if (best_any == -1
+        || qAbs((pd.last_time - time).ToDouble()) < qAbs((list.at(best_any).last_time - time).ToDouble())) {
+      best_any = i;
+    }
+  }
+
+  int chosen = (best_forward > -1) ? best_forward : best_any;
+
+  if (chosen > -1) {
+    list[chosen].in_use = true;
+    list[chosen].last_time = time;
+    hits_++;
+    return list.at(chosen).decoder;
+  }
+
+  misses_++;
+
+  // No idle Decoders for this Stream, create a new one. We don't need the lock while opening since the new Decoder
+  // isn't in the list yet.
+  locker.unlock();
+
+  DecoderPtr decoder = CreateDecoder(stream, target_width, target_height, purpose);
+
+  if (decoder == nullptr) {
+    return nullptr;
+  }
+
+  locker.relock();
+
+  PooledDecoder pd;
+  pd.decoder = decoder;
+  pd.last_time = time;
+  pd.in_use = true;
+  pd.proxy = proxy;
+  pd.purpose = purpose;
+  decoders_[stream].append(pd);
+
+  return decoder;
+}
+
+void DecoderPool::Release(DecoderPtr decoder, const rational &last_time)
+{
+  QMutexLocker locker(&mutex_);
+
+  QList<PooledDecoder>& list = decoders_[decoder->stream()];
+
+  for (int i=0;i<list.size();i++) {
+    if (list.at(i).decoder == decoder) {
+      list[i].in_use = false;
+      list[i].last_time = last_time;
+      return;
+    }
+  }
+}
+
+void DecoderPool::Clear(Stream *stream)
+{
+  QMutexLocker locker(&mutex_);
+
+  QList<PooledDecoder>& list = decoders_[stream];
+
+  // Decoders that are in use are kept, they'll be freed by a later Clear() once they've been released
+  for (int i=0;i<list.size();i++) {
+    if (!list.at(i).in_use) {
+      list.removeAt(i);
+      i--;
+    }
+  }
+
+  if (list.isEmpty()) {
+    decoders_.remove(stream);
+  }
+}
+
+void DecoderPool::Clear()
+{
+  QList<Stream*> streams;
+
+  mutex_.lock();
+  streams = decoders_.keys();
+  mutex_.unlock();
+
+  foreach (Stream* s, streams) {
+    Clear(s);
+  }
+}
+
+CacheStatistics DecoderPool::statistics()
+{
+  CacheStatistics s;
+
+  s.used_bytes = -1;
+
+  QMap<Stream*, int> counts;
+
+  mutex_.lock();
+
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QMap<Stream*, QList<PooledDecoder> >::const_iterator i;
+
+  for (i=decoders_.constBegin();i!=decoders_.constEnd();i++) {
+    if (!i->isEmpty()) {
+      counts.insert(i.key(), i->size());
+      s.entries += i->size();
+    }
+  }
+
+  mutex_.unlock();
+
+  // Footage can stay locked for a while (e.g. while it is probed), so don't hold up the pool waiting for it
+  QMap<Stream*, int>::const_iterator j;
+
+  for (j=counts.constBegin();j!=counts.constEnd();j++) {
+    Footage* footage = j.key()->footage();
+
+    footage->Lock();
+    QString filename = footage->filename();
+    footage->Unlock();
+
+    s.AddConsumer(QStringLiteral("%1 #%2").arg(filename, QString::number(j.key()->index())), -1, j.value());
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+bool DecoderPool::WillUseProxy(Stream *stream, int target_width, int target_height)
+{
+  if (stream->type() != Stream::kVideo) {
+    return false;
+  }
+
+  stream->footage()->Lock();
+  bool proxy = static_cast<VideoStream*>(stream)->CanUseProxy(target_width, target_height);
+  stream->footage()->Unlock();
+
+  return proxy;
+}
+
+DecoderPtr DecoderPool::CreateDecoder(Stream *stream, int target_width, int target_height, Decoder::Purpose purpose)
+{
+  // FIXME: This should use whichever Decoder probed the Footage
+  DecoderPtr decoder;
+
+  // Proxies of image sequences are regular video files
+  if (stream->footage()->image_sequence().IsValid() && !WillUseProxy(stream, target_width, target_height)) {
+    decoder = std::make_shared<ImageSequenceDecoder>();
+  } else if (olive::decode_worker_pool.IsEnabled()) {
+    decoder = std::make_shared<RemoteDecoder>();
+  } else {
+    decoder = std::make_shared<FFmpegDecoder>();
+  }
+
+  decoder->set_stream(stream);
+  decoder->set_target_resolution(target_width, target_height);
+  decoder->set_purpose(purpose);
+
+  if (!decoder->Open()) {
+    return nullptr;
+  }
+
+  return decoder;
+}
@@ -0,0 +1,153 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODERPOOL_H
+#define DECODERPOOL_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+
+#include "common/cachestatistics.h"
+#include "decoder/decoder.h"
+
+/**
+ * @brief A shared pool of open Decoders for each Stream
+ *
+ * Opening a Decoder is expensive (the container needs to be opened, probed, and the codec initialized), so rather
+ * than every consumer constructing its own, Decoders should be borrowed from this pool with Acquire() and handed
+ * back with Release() once the consumer is done with it.
+ *
+ * The pool remembers the last time each Decoder was asked to retrieve. When a Decoder is requested for a certain
+ * time, the pool prefers an idle Decoder that is just behind that time (so it can decode forward without seeking),
+ * meaning timelines with many cuts from the same source reuse warm codec contexts in the best possible position.
+ *
+ * All functions are thread-safe.
+ */
+class DecoderPool
+{
+public:
+  DecoderPool();
+
+  /**
+   * @brief Destructor, frees all pooled Decoders
+   */
+  ~DecoderPool();
+
+  /**
+   * @brief Borrow an open Decoder for a Stream
+   *
+   * @param stream
+   *
+   * The Stream to decode.
+   *
+   * @param time
+   *
+   * The time the caller is about to Retrieve(). Used to pick the Decoder closest to this time.
+   *
+   * @param target_width
+   *
+   * The width the frames will be displayed at. If the Stream has a proxy large enough for this resolution, the
+   * Decoder will decode the proxy instead (see Decoder::set_target_resolution()). 0 always decodes the original.
+   *
+   * @param target_height
+   *
+   * The height the frames will be displayed at.
+   *
+   * @param purpose
+   *
+   * What the frames are for (see Decoder::set_purpose()). Decoders are only reused for the same purpose since it
+   * decides how they were set up.
+   *
+   * @return
+   *
+   * An open Decoder that nothing else is using, or nullptr if no Decoder could be opened for this Stream. The Decoder
+   * must be returned with Release() when the caller is finished with it.
+   */
+  DecoderPtr Acquire(Stream* stream, const rational& time, int target_width = 0, int target_height = 0,
+                     Decoder::Purpose purpose = Decoder::kInteractive);
+
+  /**
+   * @brief Return a Decoder borrowed with Acquire() to the pool
+   *
+   * @param decoder
+   *
+   * The Decoder to return.
+   *
+   * @param last_time
+   *
+   * The last time that was retrieved from this Decoder (its current position).
+   */
+  void Release(DecoderPtr decoder, const rational& last_time);
+
+  /**
+   * @brief Free all idle Decoders belonging to a certain Stream
+   *
+   * Use this if a Stream is about to be deleted or its file has changed.
+   */
+  void Clear(Stream* stream);
+
+  /**
+   * @brief Free all idle Decoders
+   */
+  void Clear();
+
+  /**
+   * @brief Open Decoders by Stream, and how many Acquire() calls reused one (hits) or opened one (misses)
+   *
+   * The pool doesn't know how much memory a Decoder uses, so consumers are only counted in Decoders.
+   */
+  CacheStatistics statistics();
+
+  /**
+   * @brief Returns whether a Decoder opened for this target resolution would decode the Stream's proxy
+   */
+  static bool WillUseProxy(Stream* stream, int target_width, int target_height);
+
+private:
+  struct PooledDecoder {
+    DecoderPtr decoder;
+    rational last_time;
+    bool in_use;
+    bool proxy;
+    Decoder::Purpose purpose;
+  };
+
+  /**
+   * @brief Create and open a new Decoder for this Stream
+   */
+  DecoderPtr CreateDecoder(Stream* stream, int target_width, int target_height, Decoder::Purpose purpose);
+
+  QMap<Stream*, QList<PooledDecoder> > decoders_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide Decoder pool
+ */
+extern DecoderPool decoder_pool;
+}
+
+#endif // DECODERPOOL_H
@@ -0,0 +1,402 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegbufferedio.h"
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+#include <cstring>
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStorageInfo>
+
+#include "common/tracing.h"
+#include "decoder/blockcache.h"
+
+namespace {
+
+// Size of the blocks files are read in, large enough that each request's latency is spread over a lot of data
+const qint64 kBlockSize = 1024 * 1024;
+
+// Size of the buffer FFmpeg reads into
+const int kIOBufferSize = 256 * 1024;
+
+QAtomicInteger<qint64> read_ahead_bytes(16 * kBlockSize);
+
+QAtomicInt max_parallel_requests(4);
+
+}
+
+class FFmpegBufferedIO::FetchRunnable : public QRunnable
+{
+public:
+  FetchRunnable(SourcePtr source, BlockPtr block) :
+    source_(source),
+    block_(block)
+  {
+  }
+
+  virtual void run() override;
+
+private:
+  SourcePtr source_;
+
+  BlockPtr block_;
+};
+
+void FFmpegBufferedIO::FetchRunnable::run()
+{
+  QMutexLocker locker(&block_->mutex);
+
+  if (block_->cancelled) {
+    block_->done = true;
+    block_->done_cond.wakeAll();
+    return;
+  }
+
+  locker.unlock();
+
+  Tracing::Span span("decoder", "FFmpegBufferedIO::Fetch");
+
+  QByteArray data;
+
+  if (source_->cache_key.isEmpty() || !BlockCache::Load(source_->cache_key, block_->index, &data)) {
+    qint64 offset = block_->index * kBlockSize;
+
+    if (ReadRange(*source_, offset, qMin(kBlockSize, source_->size - offset), &data)
+        && !source_->cache_key.isEmpty()) {
+      BlockCache::Save(source_->cache_key, block_->index, data);
+    }
+  }
+
+  locker.relock();
+
+  block_->data = data;
+  block_->done = true;
+  block_->done_cond.wakeAll();
+}
+
+FFmpegBufferedIO::Block::Block() :
+  index(0),
+  done(false),
+  cancelled(false)
+{
+}
+
+FFmpegBufferedIO::FFmpegBufferedIO() :
+  pos_(0),
+  avio_ctx_(nullptr)
+{
+}
+
+FFmpegBufferedIO::~FFmpegBufferedIO()
+{
+  Close();
+}
+
+bool FFmpegBufferedIO::IsRemote(const QString &filename)
+{
+  if (filename.contains(QStringLiteral("://"))) {
+    return !filename.startsWith(QStringLiteral("file:"));
+  }
+
+  QString fs_type = QString::fromUtf8(QStorageInfo(QFileInfo(filename).absolutePath()).fileSystemType());
+
+  return fs_type.startsWith(QStringLiteral("nfs"))
+      || fs_type.startsWith(QStringLiteral("smb"))
+      || fs_type == QStringLiteral("cifs")
+      || fs_type == QStringLiteral("afpfs")
+      || fs_type == QStringLiteral("webdav")
+      || fs_type == QStringLiteral("davfs")
+      || fs_type == QStringLiteral("9p")
+      || fs_type == QStringLiteral("fuse.sshfs");
+}
+
+bool FFmpegBufferedIO::Open(const QString &filename)
+{
+  Close();
+
+  SourcePtr source = std::make_shared<Source>();
+  source->filename = filename;
+  source->is_url = filename.contains(QStringLiteral("://"));
+
+  qint64 last_modified = 0;
+
+  if (source->is_url) {
+    AVIOContext* probe_ctx = nullptr;
+
+    if (avio_open2(&probe_ctx, filename.toUtf8().constData(), AVIO_FLAG_READ, nullptr, nullptr) < 0) {
+      return false;
+    }
+
+    source->size = avio_size(probe_ctx);
+
+    avio_closep(&probe_ctx);
+  } else {
+    QFileInfo info(filename);
+
+    if (!info.isFile()) {
+      return false;
+    }
+
+    source->size = info.size();
+    last_modified = info.lastModified().toMSecsSinceEpoch();
+  }
+
+  // Without a size we can't tell which blocks exist
+  if (source->size <= 0) {
+    return false;
+  }
+
+  if (BlockCache::budget() > 0) {
+    source->cache_key = BlockCache::FileKey(filename, source->size, last_modified);
+  }
+
+  uint8_t* buffer = static_cast<uint8_t*>(av_malloc(kIOBufferSize));
+
+  if (buffer == nullptr) {
+    return false;
+  }
+
+  avio_ctx_ = avio_alloc_context(buffer, kIOBufferSize, 0, this, ReadPacket, nullptr, SeekPacket);
+
+  if (avio_ctx_ == nullptr) {
+    av_free(buffer);
+    return false;
+  }
+
+  source_ = source;
+  pos_ = 0;
+
+  // Containers mostly keep their headers at the start of the file, start reading it straight away
+  ReadAheadFrom(0);
+
+  return true;
+}
+
+void FFmpegBufferedIO::Close()
+{
+  foreach (BlockPtr block, blocks_) {
+    QMutexLocker locker(&block->mutex);
+
+    block->cancelled = true;
+  }
+
+  blocks_.clear();
+
+  if (avio_ctx_ != nullptr) {
+    // FFmpeg may have replaced the buffer we allocated, so free whichever one the context holds now
+    av_freep(&avio_ctx_->buffer);
+    avio_context_free(&avio_ctx_);
+    avio_ctx_ = nullptr;
+  }
+
+  source_ = nullptr;
+  pos_ = 0;
+}
+
+AVIOContext *FFmpegBufferedIO::context() const
+{
+  return avio_ctx_;
+}
+
+qint64 FFmpegBufferedIO::read_ahead()
+{
+  return read_ahead_bytes.load();
+}
+
+void FFmpegBufferedIO::set_read_ahead(qint64 bytes)
+{
+  read_ahead_bytes.store(qMax(Q_INT64_C(0), bytes));
+}
+
+int FFmpegBufferedIO::parallel_requests()
+{
+  return max_parallel_requests.load();
+}
+
+void FFmpegBufferedIO::set_parallel_requests(int n)
+{
+  max_parallel_requests.store(qMax(1, n));
+}
+
+QThreadPool *FFmpegBufferedIO::io_pool()
+{
+  static QThreadPool pool;
+
+  int threads = parallel_requests();
+
+  if (pool.maxThreadCount() != threads) {
+    pool.setMaxThreadCount(threads);
+  }
+
+  return &pool;
+}
+
+bool FFmpegBufferedIO::ReadRange(const Source &source, qint64 offset, qint64 length, QByteArray *data)
+{
+  data->resize(static_cast<int>(length));
+
+  if (source.is_url) {
+    // Seeking makes FFmpeg's network protocols (e.g. HTTP) request just this range
+    AVIOContext* ctx = nullptr;
+
+    if (avio_open2(&ctx, source.filename.toUtf8().constData(), AVIO_FLAG_READ, nullptr, nullptr) < 0) {
+      return false;
+    }
+
+    bool ok = (avio_seek(ctx, offset, SEEK_SET) == offset);
+    int total = 0;
+
+    while (ok && total < length) {
+      int r = avio_read(ctx, reinterpret_cast<unsigned char*>(data->data()) + total, static_cast<int>(length) - total);
+
+      if (r <= 0) {
+        ok = false;
+      } else {
+        total += r;
+      }
+    }
+
+    avio_closep(&ctx);
+
+    return ok;
+  }
+
+  QFile file(source.filename);
+
+  return file.open(QFile::ReadOnly)
+      && file.seek(offset)
+      && file.read(data->data(), length) == length;
+}
+
+int FFmpegBufferedIO::ReadPacket(void *opaque, uint8_t *buf, int buf_size)
+{
+  FFmpegBufferedIO* io = static_cast<FFmpegBufferedIO*>(opaque);
+
+  if (io->pos_ >= io->source_->size) {
+    return AVERROR_EOF;
+  }
+
+  qint64 index = io->pos_ / kBlockSize;
+
+  io->ReadAheadFrom(index);
+
+  BlockPtr block = io->blocks_.value(index);
+
+  QMutexLocker locker(&block->mutex);
+
+  while (!block->done) {
+    block->done_cond.wait(&block->mutex);
+  }
+
+  if (block->data.isEmpty()) {
+    // Try again next time rather than keeping the failure around
+    locker.unlock();
+    io->blocks_.remove(index);
+    return AVERROR(EIO);
+  }
+
+  qint64 offset_in_block = io->pos_ - index * kBlockSize;
+  int read_size = static_cast<int>(qMin(static_cast<qint64>(buf_size), block->data.size() - offset_in_block));
+
+  memcpy(buf, block->data.constData() + offset_in_block, static_cast<size_t>(read_size));
+
+  io->pos_ += read_size;
+
+  return read_size;
+}
+
+int64_t FFmpegBufferedIO::SeekPacket(void *opaque, int64_t offset, int whence)
+{
+  FFmpegBufferedIO* io = static_cast<FFmpegBufferedIO*>(opaque);
+
+  // Make sure FFmpeg knows the file size so it doesn't have to seek to the end to find it
+  if (whence & AVSEEK_SIZE) {
+    return io->source_->size;
+  }
+
+  int64_t new_pos;
+
+  switch (whence & ~AVSEEK_FORCE) {
+  case SEEK_SET:
+    new_pos = offset;
+    break;
+  case SEEK_CUR:
+    new_pos = io->pos_ + offset;
+    break;
+  case SEEK_END:
+    new_pos = io->source_->size + offset;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  if (new_pos < 0) {
+    return AVERROR(EINVAL);
+  }
+
+  // Nothing's read until the next ReadPacket(), so seeking around (e.g. while probing) is free
+  io->pos_ = new_pos;
+
+  return new_pos;
+}
+
+void FFmpegBufferedIO::ReadAheadFrom(qint64 index)
+{
+  qint64 block_count = (source_->size + kBlockSize - 1) / kBlockSize;
+  qint64 end = qMin(index + 1 + (read_ahead() + kBlockSize - 1) / kBlockSize, block_count);
+
+  // Keep the block before this one too, demuxers often step back a little
+  qint64 start = qMax(Q_INT64_C(0), index - 1);
+
+  // Abandon blocks that are no longer near the read position (e.g. after seeking)
+  QMap<qint64, BlockPtr>::iterator i = blocks_.begin();
+
+  while (i != blocks_.end()) {
+    if (i.key() < start || i.key() >= end) {
+      QMutexLocker locker(&i.value()->mutex);
+      i.value()->cancelled = true;
+      locker.unlock();
+
+      i = blocks_.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  for (qint64 j=index;j<end;j++) {
+    if (!blocks_.contains(j)) {
+      BlockPtr block = std::make_shared<Block>();
+      block->index = j;
+
+      blocks_.insert(j, block);
+
+      // The block being read goes to the front of the queue
+      io_pool()->start(new FetchRunnable(source_, block), (j == index) ? 1 : 0);
+    }
+  }
+}
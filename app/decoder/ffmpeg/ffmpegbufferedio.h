@@ -0,0 +1,177 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGBUFFEREDIO_H
+#define FFMPEGBUFFEREDIO_H
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+#include <memory>
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/**
+ * @brief Custom AVIOContext for media on network storage, reading ahead in parallel and caching blocks locally
+ *
+ * With FFmpeg's own IO, every seek into a file on an SMB/NFS mount or an HTTP server waits for a round trip before
+ * decoding can continue, and reads are issued one at a time. This instead reads the file in fixed-size blocks: the
+ * block being read and the ones after it (up to read_ahead() bytes) are requested in parallel on a pool of IO threads,
+ * each with its own connection to the file, so most reads are served from memory. Blocks are also kept in the local
+ * BlockCache, so parts of the file that have been read before don't go over the network again.
+ *
+ * Files on local storage should use FFmpegMappedIO instead (see IsRemote()).
+ */
+class FFmpegBufferedIO
+{
+public:
+  FFmpegBufferedIO();
+
+  /**
+   * @brief Destructor, abandons every block being read and frees the AVIOContext
+   */
+  ~FFmpegBufferedIO();
+
+  FFmpegBufferedIO(const FFmpegBufferedIO& other) = delete;
+  FFmpegBufferedIO(FFmpegBufferedIO&& other) = delete;
+  FFmpegBufferedIO& operator=(const FFmpegBufferedIO& other) = delete;
+  FFmpegBufferedIO& operator=(FFmpegBufferedIO&& other) = delete;
+
+  /**
+   * @brief Returns TRUE if `filename` is a URL or a file on a network filesystem
+   */
+  static bool IsRemote(const QString& filename);
+
+  /**
+   * @brief Open `filename` (a file path or any URL FFmpeg can read) and create an AVIOContext reading from it
+   *
+   * @return
+   *
+   * FALSE if the file couldn't be opened or its size couldn't be determined (e.g. a live stream), in which case the
+   * caller should let FFmpeg open the file itself.
+   */
+  bool Open(const QString& filename);
+
+  /**
+   * @brief Abandon every block being read and free the AVIOContext
+   *
+   * Must only be called after the AVFormatContext using context() has been closed.
+   */
+  void Close();
+
+  /**
+   * @brief The AVIOContext to set as AVFormatContext::pb (nullptr if not open)
+   */
+  AVIOContext* context() const;
+
+  /**
+   * @brief Bytes read ahead of the current position (rounded up to whole blocks)
+   */
+  static qint64 read_ahead();
+
+  /**
+   * @brief Set how far ahead of the current position files are read, takes effect on the next read
+   */
+  static void set_read_ahead(qint64 bytes);
+
+  /**
+   * @brief Maximum number of blocks requested at once (per process)
+   */
+  static int parallel_requests();
+
+  static void set_parallel_requests(int n);
+
+private:
+  class FetchRunnable;
+
+  /**
+   * @brief The file being read, shared with the runnables reading from it so they can outlive Close()
+   */
+  struct Source {
+    QString filename;
+
+    bool is_url;
+
+    qint64 size;
+
+    // BlockCache key, empty if blocks shouldn't be cached
+    QString cache_key;
+  };
+
+  using SourcePtr = std::shared_ptr<Source>;
+
+  /**
+   * @brief A block that's being read ahead, shared with the runnable reading it
+   */
+  struct Block {
+    Block();
+
+    qint64 index;
+
+    // Everything below is protected by mutex
+    QMutex mutex;
+
+    QWaitCondition done_cond;
+
+    // Set once the block has been read (or failed to)
+    bool done;
+
+    // Set when nobody wants the block any more, the runnable skips its work
+    bool cancelled;
+
+    // Contents of the block, empty if reading it failed
+    QByteArray data;
+  };
+
+  using BlockPtr = std::shared_ptr<Block>;
+
+  static QThreadPool* io_pool();
+
+  /**
+   * @brief Read `length` bytes at `offset` from a source, opening a connection just for this read
+   */
+  static bool ReadRange(const Source& source, qint64 offset, qint64 length, QByteArray* data);
+
+  static int ReadPacket(void* opaque, uint8_t* buf, int buf_size);
+
+  static int64_t SeekPacket(void* opaque, int64_t offset, int whence);
+
+  /**
+   * @brief Start reading the blocks from `index` on and abandon the ones that are no longer needed
+   */
+  void ReadAheadFrom(qint64 index);
+
+  SourcePtr source_;
+
+  qint64 pos_;
+
+  // Blocks in memory or being read, by index from the start of the file
+  QMap<qint64, BlockPtr> blocks_;
+
+  AVIOContext* avio_ctx_;
+
+};
+
+#endif // FFMPEGBUFFEREDIO_H
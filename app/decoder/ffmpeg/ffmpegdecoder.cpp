@@ -23,63 +23,234 @@
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
 }
 
+#include <QFile>
+#include <QRunnable>
+#include <QSaveFile>
 #include <QStatusBar>
 #include <QString>
+#include <QThread>
+#include <QThreadPool>
 #include <QtMath>
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+#include "common/tracing.h"
+#include "render/allocationcounters.h"
+#include "render/performancecounters.h"
+
+/**
+ * @brief Header at the start of every on-disk index file (see FFmpegDecoder::SaveIndex())
+ *
+ * The header is followed by `frame_count` int64_t frame timestamps and `keyframe_count` int64_t keyframe timestamps.
+ */
+struct FFmpegIndexHeader {
+  char magic[4];
+  uint32_t version;
+  int64_t frame_count;
+  int64_t keyframe_count;
+
+  // Number of frames in the longest GOP
+  int64_t max_gop_length;
+};
+
+const char kIndexMagic[4] = {'O', 'V', 'I', 'X'};
+const uint32_t kIndexVersion = 2;
+
+// Requests this far ahead of the cached audio (in seconds) are decoded forward instead of seeking
+const int kAudioSeekThreshold = 1;
+
+// Maximum amount of audio (in seconds) kept in the cache behind the most recent request
+const int kAudioCacheLength = 10;
+
+QAtomicInt FFmpegDecoder::open_video_decoders_;
+
+// Frames up to this fraction of a frame after a requested time are shown at that time, see GetFrameTimestamp()
+const int kFrameToleranceDivisor = 4;
+
+// Maximum amount of memory (in bytes) each decoder's recently decoded frames may use, see CacheFrame()
+const qint64 kFrameCacheBudget = Q_INT64_C(256) * 1024 * 1024;
+
+// Intra-only frames this far ahead of the current one are reached by reading forward instead of seeking
+const int kIntraForwardFrames = 4;
+
+// Consecutive requests stepping backwards before a decoder switches to reverse playback, see IsPlayingBackward()
+const int kReverseRequests = 2;
+
+// Requests further back than this many frames are seeks rather than reverse playback
+const int kReverseMaxStep = 4;
+
+namespace {
+
+QThreadPool* PrefetchPool()
+{
+  // Kept apart from the global pool so GOP prefetches never hold up rendering
+  static QThreadPool pool;
+
+  return &pool;
+}
+
+}
+
+class FFmpegDecoder::PrefetchRunnable : public QRunnable
+{
+public:
+  PrefetchRunnable(FFmpegDecoder* parent, int64_t keyframe, int max_frames) :
+    parent_(parent),
+    keyframe_(keyframe),
+    max_frames_(max_frames)
+  {
+  }
+
+  virtual void run() override
+  {
+    AllocationCounters::ScopedTag tag(AllocationCounters::kDecoder);
+
+    FFmpegDecoder* decoder = parent_->prefetch_decoder_.get();
+
+    QVector<DecodedFrame> frames;
+
+    if (decoder->open_ || decoder->Open()) {
+      decoder->DecodeGop(keyframe_, AV_NOPTS_VALUE, max_frames_, &frames);
+    }
+
+    QMutexLocker locker(&parent_->prefetch_mutex_);
+
+    parent_->prefetch_frames_ = frames;
+    parent_->prefetch_running_ = false;
+    parent_->prefetch_done_.wakeAll();
+  }
+
+private:
+  FFmpegDecoder* parent_;
+
+  int64_t keyframe_;
+
+  int max_frames_;
+};
 
 FFmpegDecoder::FFmpegDecoder() :
   fmt_ctx_(nullptr),
+  demuxer_stream_(-1),
+  demuxer_bytes_read_(0),
   codec_ctx_(nullptr),
-  opts_(nullptr)
+  avstream_(nullptr),
+  pkt_(nullptr),
+  next_pkt_(nullptr),
+  frame_(nullptr),
+  opts_(nullptr),
+  hw_device_ctx_(nullptr),
+  hw_pix_fmt_(AV_PIX_FMT_NONE),
+  sw_frame_(nullptr),
+  frame_pool_(nullptr),
+  frame_pool_size_(0),
+  hw_accel_enabled_(true),
+  counted_as_open_(false),
+  swr_ctx_(nullptr),
+  audio_sample_rate_(0),
+  audio_channel_layout_(0),
+  audio_cache_start_(AV_NOPTS_VALUE),
+  audio_eof_(false),
+  intra_only_(false),
+  intra_eof_(false),
+  max_gop_length_(0),
+  last_pts_(AV_NOPTS_VALUE),
+  last_duration_(0),
+  frame_tolerance_(0),
+  frame_cache_capacity_(-1),
+  frame_cache_access_(0),
+  last_request_ts_(AV_NOPTS_VALUE),
+  backward_requests_(0),
+  prefetch_keyframe_(AV_NOPTS_VALUE),
+  prefetch_running_(false),
+  bytes_read_(0)
+{
+}
+
+FFmpegDecoder::~FFmpegDecoder()
 {
+  Close();
 }
 
 bool FFmpegDecoder::Open()
 {
+  Tracing::Span span("decoder", "FFmpegDecoder::Open");
+
   if (open_) {
     return true;
   }
 
   int error_code;
 
-  // Convert QString to a C strng
-  QByteArray ba = stream()->footage()->filename().toUtf8();
-  const char* filename = ba.constData();
+  // Use a proxy instead of the original file if one exists with enough resolution for the target size
+  bool is_proxy;
+  QString media_filename = GetMediaFilename(&is_proxy);
 
-  // Open file in a format context
-  error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
+  // Proxies only contain the one stream they were generated from
+  int stream_index = is_proxy ? 0 : stream()->index();
+
+  // A stream probed with its codec parameters doesn't need analyzing again, only the container's header is read.
+  // Proxies are different files, so they're analyzed like any other file.
+  bool probed = (!is_proxy && HasCodecParameters(stream()));
+
+  FFmpegDemuxer::Analysis analysis = FFmpegDemuxer::kAnalyzeHeader;
+
+  if (!probed) {
+    // If the Footage has been deep probed, its metadata is already exact and the codec parameters only need a bounded
+    // analysis, otherwise let FFmpeg analyze the stream fully
+    stream()->footage()->Lock();
+    bool analyzed = (stream()->footage()->status() == Footage::kReady);
+    stream()->footage()->Unlock();
+
+    analysis = analyzed ? FFmpegDemuxer::kAnalyzeFast : FFmpegDemuxer::kAnalyzeFully;
+  }
+
+  // Open file in a format context (shared with decoders of the file's other streams) and get stream information
+  error_code = OpenFormatContext(media_filename, stream_index, analysis);
 
   // Handle format context error
-  if (error_code != 0) {
+  if (error_code < 0) {
     FFmpegErr(error_code);
     return false;
   }
 
-  // Get stream information from format
-  error_code = avformat_find_stream_info(fmt_ctx_, nullptr);
+  // Get reference to correct AVStream
+  if (stream_index < 0 || static_cast<unsigned int>(stream_index) >= fmt_ctx_->nb_streams) {
+    Error(tr("Stream %1 doesn't exist in %2").arg(QString::number(stream_index), media_filename));
+    return false;
+  }
+
+  avstream_ = fmt_ctx_->streams[stream_index];
+  stream_timebase_ = avstream_->time_base;
 
-  // Handle get stream information error
-  if (error_code < 0) {
-    FFmpegErr(error_code);
+  // Parameters of the stream as probed, or as just analyzed
+  AVCodecParameters* codecpar = avcodec_parameters_alloc();
+
+  if (codecpar == nullptr) {
+    Error(tr("Failed to allocate codec parameters (%1)").arg(stream()->footage()->filename()));
     return false;
   }
 
-  // Dump format information
-  av_dump_format(fmt_ctx_, stream()->index(), filename, 0);
+  error_code = probed ? GetCodecParameters(stream(), codecpar) : avcodec_parameters_copy(codecpar, avstream_->codecpar);
 
-  // Get reference to correct AVStream
-  avstream_ = fmt_ctx_->streams[stream()->index()];
+  if (error_code < 0) {
+    avcodec_parameters_free(&codecpar);
+    FFmpegErr(error_code);
+    return false;
+  }
 
   // Find decoder
-  AVCodec* codec = avcodec_find_decoder(avstream_->codecpar->codec_id);
+  AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
 
   // Handle failure to find decoder
   if (codec == nullptr) {
     Error(tr("Failed to find appropriate decoder for this codec (%1 :: %2)")
-          .arg(stream()->footage()->filename(), avstream_->codecpar->codec_id));
+          .arg(stream()->footage()->filename(), avcodec_get_name(codecpar->codec_id)));
+    avcodec_parameters_free(&codecpar);
     return false;
   }
 
@@ -87,27 +258,42 @@ bool FFmpegDecoder::Open()
   codec_ctx_ = avcodec_alloc_context3(codec);
   if (codec_ctx_ == nullptr) {
     Error(tr("Failed to allocate codec context (%1 :: %2)").arg(stream()->footage()->filename(), stream()->index()));
+    avcodec_parameters_free(&codecpar);
     return false;
   }
 
-  // Copy parameters from the AVStream to the AVCodecContext
-  error_code = avcodec_parameters_to_context(codec_ctx_, avstream_->codecpar);
+  // Copy parameters to the AVCodecContext
+  error_code = avcodec_parameters_to_context(codec_ctx_, codecpar);
 
   // Handle failure to copy parameters
   if (error_code < 0) {
+    avcodec_parameters_free(&codecpar);
     FFmpegErr(error_code);
     return false;
   }
 
-  // enable multithreading on decoding
-  error_code = av_dict_set(&opts_, "threads", "auto", 0);
+  // Decoders are opened all the time (e.g. one per DecoderPool instance), so what they'd say about the stream on every
+  // open is demoted from information to verbose output. Warnings and errors are still shown.
+  codec_ctx_->log_level_offset = AV_LOG_VERBOSE - AV_LOG_INFO;
 
-  // Handle failure to set multithreaded decoding
-  if (error_code < 0) {
-    FFmpegErr(error_code);
-    return false;
+  // Try to decode in hardware, InitHardwareDecoding() leaves codec_ctx_ untouched if it can't
+  if (hw_accel_enabled_) {
+    InitHardwareDecoding(codec);
   }
 
+  // Every frame of an intra-only codec (e.g. ProRes, DNxHD, MJPEG, FFV1) can be decoded on its own, so frames can be
+  // decoded straight from the packet they're in without an index (see RetrieveIntraFrame())
+  const AVCodecDescriptor* descriptor = avcodec_descriptor_get(codecpar->codec_id);
+
+  intra_only_ = (codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+                 && descriptor != nullptr
+                 && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY));
+
+  avcodec_parameters_free(&codecpar);
+
+  // Pick a threading mode and thread count for this codec and purpose
+  ConfigureThreading(codec);
+
   // Open codec
   error_code = avcodec_open2(codec_ctx_, codec, &opts_);
   if (error_code < 0) {
@@ -115,23 +301,361 @@ bool FFmpegDecoder::Open()
     return false;
   }
 
+  // Allocate the packet and frame that decoding will read into
+  pkt_ = av_packet_alloc();
+  next_pkt_ = av_packet_alloc();
+  frame_ = av_frame_alloc();
+  sw_frame_ = av_frame_alloc();
+
+  if (pkt_ == nullptr || next_pkt_ == nullptr || frame_ == nullptr || sw_frame_ == nullptr) {
+    Error(tr("Failed to allocate packet/frame (%1)").arg(stream()->footage()->filename()));
+    return false;
+  }
+
+  // Load (or build) a timestamp/keyframe index so Retrieve() knows when it has to seek. Intra-only streams can seek
+  // straight to any frame so they don't need one.
+  if (!intra_only_ && !LoadIndex() && IndexStream()) {
+    SaveIndex();
+  }
+
+  last_pts_ = AV_NOPTS_VALUE;
+  last_duration_ = 0;
+
+  if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    // A frame whose timestamp is a little after a requested time (e.g. due to the jitter in VFR timestamps) is taken
+    // as the frame at that time rather than showing the previous frame for a second time
+    frame_tolerance_ = GetTypicalFrameDuration() / kFrameToleranceDivisor;
+
+    open_video_decoders_.ref();
+    counted_as_open_ = true;
+  }
+
   open_ = true;
 
   return true;
 }
 
+void FFmpegDecoder::ConfigureThreading(AVCodec *codec)
+{
+  ThreadingMode mode = threading_mode_;
+
+  bool can_slice = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS);
+  bool can_frame = (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS);
+
+  if (mode == kThreadingAuto) {
+    if (intra_only_) {
+      // Frame threading would mean decoding several frames to get one out. DecoderPool decodes different frames of the
+      // file in parallel on separate Decoders instead.
+      mode = kThreadingSlice;
+    } else if (purpose_ == kExport) {
+      mode = can_frame ? kThreadingFrame : kThreadingSlice;
+    } else {
+      // Seeking and scrubbing need each frame as soon as possible, but if the codec can't split frames into slices,
+      // frame threading is still much faster than a single thread for playback
+      mode = can_slice ? kThreadingSlice : kThreadingFrame;
+    }
+  }
+
+  int thread_count = thread_count_;
+
+  if (thread_count <= 0) {
+    // Share the cores between every open video decoder (counting this one) rather than each of them starting a
+    // thread per core
+    int cores = QThread::idealThreadCount();
+    int decoders = open_video_decoders_.load() + 1;
+
+    thread_count = qMax(1, cores / decoders);
+  }
+
+  // Audio codecs barely benefit from threads and frame threading would only add latency
+  if (avstream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    thread_count = 1;
+  }
+
+  if ((mode == kThreadingSlice && !can_slice) || (mode == kThreadingFrame && !can_frame)) {
+    thread_count = 1;
+  }
+
+  codec_ctx_->thread_type = (mode == kThreadingFrame) ? FF_THREAD_FRAME : FF_THREAD_SLICE;
+  codec_ctx_->thread_count = thread_count;
+}
+
 FramePtr FFmpegDecoder::Retrieve(const rational &timecode, const rational &length)
 {
-  // FIXME: Fill this out
+  AllocationCounters::ScopedTag tag(AllocationCounters::kDecoder);
+
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kDecode);
+
+  Tracing::Span span("decoder", "FFmpegDecoder::Retrieve");
+
+  if (!open_ && !Open()) {
+    return nullptr;
+  }
+
+  if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+    return RetrieveAudio(timecode, length);
+  }
+
+  // Find the exact timestamp of the frame that should be showing at this time
+  int64_t target_ts = GetFrameTimestamp(timecode);
+
+  if (intra_only_) {
+    return RetrieveIntraFrame(target_ts);
+  }
+
+  if (target_ts == AV_NOPTS_VALUE) {
+    return nullptr;
+  }
+
+  UpdateDirection(target_ts);
+
+  // Frames decoded recently (e.g. on the way to a later frame before stepping back) don't need their GOP decoded again.
+  // The decoder's position is left as it is.
+  if (target_ts != last_pts_) {
+    FramePtr cached = RetrieveCachedFrame(target_ts);
+
+    if (cached != nullptr) {
+      // Keep the GOP before this one decoding while this one is played out
+      if (IsPlayingBackward()) {
+        StartPrefetch(target_ts);
+      }
+
+      return cached;
+    }
+
+    // Playing backwards, decode the whole GOP once instead of a seek and a partial GOP for every frame
+    if (IsPlayingBackward() && RetrieveGopBackward(target_ts)) {
+      cached = RetrieveCachedFrame(target_ts);
+
+      if (cached != nullptr) {
+        return cached;
+      }
+    }
+  }
+
+  // Only seek if we can't get to the target by decoding forward from the current position (seeking on every frame
+  // would force a decode from the previous keyframe every time)
+  if (!CanDecodeForwardTo(target_ts)) {
+    Seek(target_ts);
+  }
+
+  // Decode forward until we reach the target frame
+  while (last_pts_ == AV_NOPTS_VALUE || last_pts_ < target_ts) {
+    int error_code = GetFrame();
+
+    if (error_code < 0) {
+      if (error_code != AVERROR_EOF) {
+        FFmpegErr(error_code);
+      }
+
+      // If we got nothing at all, there's nothing to return
+      if (last_pts_ == AV_NOPTS_VALUE) {
+        return nullptr;
+      }
+
+      // Otherwise return the last frame we managed to decode
+      break;
+    }
+
+    last_pts_ = frame_->best_effort_timestamp;
+
+    CacheFrame();
+  }
+
+  return CopyFrame();
+}
+
+FramePtr FFmpegDecoder::CopyFrame()
+{
+  AVFrame* copy = CloneFrame();
 
-  Q_UNUSED(timecode)
-  Q_UNUSED(length)
+  if (copy == nullptr) {
+    return nullptr;
+  }
+
+  FramePtr f = std::make_shared<Frame>();
+  f->SetAVFrame(copy, avstream_->time_base);
+
+  return f;
+}
+
+AVFrame *FFmpegDecoder::CloneFrame()
+{
+  AVFrame* decoded = frame_;
+
+  // Download hardware frames into system memory for the rest of the pipeline
+  if (hw_pix_fmt_ != AV_PIX_FMT_NONE && frame_->format == hw_pix_fmt_) {
+    av_frame_unref(sw_frame_);
+
+    // Download into a pooled buffer rather than letting FFmpeg allocate a new one for every frame
+    AVHWFramesContext* hw_frames = reinterpret_cast<AVHWFramesContext*>(frame_->hw_frames_ctx->data);
+
+    if (!AllocatePooledFrame(sw_frame_, hw_frames->sw_format, frame_->width, frame_->height)) {
+      return nullptr;
+    }
+
+    int error_code = av_hwframe_transfer_data(sw_frame_, frame_, 0);
+
+    if (error_code < 0) {
+      FFmpegErr(error_code);
+      return nullptr;
+    }
+
+    av_frame_copy_props(sw_frame_, frame_);
+
+    decoded = sw_frame_;
+  }
+
+  // Create a reference to the decoded data so frame_ can keep being decoded into. This doesn't copy any pixels, the
+  // buffer is shared until every reference has been freed.
+  return av_frame_clone(decoded);
+}
+
+FramePtr FFmpegDecoder::RetrieveIntraFrame(int64_t target_ts)
+{
+  // Reading a few packets forward is cheaper than seeking, anything further away (or behind) is seeked to directly.
+  // If the next packet is already known to be after the target (or there are none), the current frame is the target.
+  bool decode_forward = (last_pts_ != AV_NOPTS_VALUE
+                         && target_ts >= last_pts_
+                         && (intra_eof_
+                             || target_ts - last_pts_ <= kIntraForwardFrames * last_duration_
+                             || (next_pkt_->buf != nullptr && GetPacketTimestamp(next_pkt_) > target_ts)));
+
+  if (!decode_forward) {
+    av_packet_unref(next_pkt_);
+
+    demuxer_->Seek(avstream_->index, target_ts, AVSEEK_FLAG_BACKWARD);
+
+    last_pts_ = AV_NOPTS_VALUE;
+    intra_eof_ = false;
+  }
+
+  // Find the last packet at or before the target without decoding any of them. If the target is before the first
+  // packet, the first packet is used.
+  AVPacket* target_pkt = pkt_;
+  bool found = false;
+
+  av_packet_unref(target_pkt);
+
+  forever {
+    if (next_pkt_->buf == nullptr) {
+      if (intra_eof_) {
+        break;
+      }
+
+      av_packet_unref(next_pkt_);
+
+      int error_code = demuxer_->ReadPacket(avstream_->index, next_pkt_, cancel_token_);
+
+      if (error_code < 0) {
+        av_packet_unref(next_pkt_);
+
+        if (error_code != AVERROR_EOF) {
+          FFmpegErr(error_code);
+          return nullptr;
+        }
+
+        intra_eof_ = true;
+        break;
+      }
+    }
+
+    if (GetPacketTimestamp(next_pkt_) > target_ts && (found || last_pts_ != AV_NOPTS_VALUE)) {
+      // The next packet is after the target, so it's kept for the next call
+      break;
+    }
+
+    av_packet_unref(target_pkt);
+    av_packet_move_ref(target_pkt, next_pkt_);
+    found = true;
+  }
+
+  if (found) {
+    // Decode exactly this one packet
+    int error_code = avcodec_send_packet(codec_ctx_, target_pkt);
+
+    if (error_code >= 0) {
+      error_code = avcodec_receive_frame(codec_ctx_, frame_);
+
+      // Some decoders (e.g. hardware ones) hold onto frames until they're told nothing else is coming
+      if (error_code == AVERROR(EAGAIN)) {
+        avcodec_send_packet(codec_ctx_, nullptr);
+        error_code = avcodec_receive_frame(codec_ctx_, frame_);
+        avcodec_flush_buffers(codec_ctx_);
+      }
+    }
+
+    int64_t pkt_ts = GetPacketTimestamp(target_pkt);
+    last_duration_ = target_pkt->duration;
+
+    av_packet_unref(target_pkt);
+
+    if (error_code < 0) {
+      FFmpegErr(error_code);
+      return nullptr;
+    }
+
+    last_pts_ = pkt_ts;
+  } else if (last_pts_ == AV_NOPTS_VALUE) {
+    // Nothing in the stream at all
+    return nullptr;
+  }
 
-  return nullptr;
+  return CopyFrame();
 }
 
 void FFmpegDecoder::Close()
 {
+  StopPrefetch();
+
+  if (frame_ != nullptr) {
+    av_frame_free(&frame_);
+    frame_ = nullptr;
+  }
+
+  if (pkt_ != nullptr) {
+    av_packet_free(&pkt_);
+    pkt_ = nullptr;
+  }
+
+  if (next_pkt_ != nullptr) {
+    av_packet_free(&next_pkt_);
+    next_pkt_ = nullptr;
+  }
+
+  if (sw_frame_ != nullptr) {
+    av_frame_free(&sw_frame_);
+    sw_frame_ = nullptr;
+  }
+
+  // Buffers still referenced by Frames outside the decoder stay valid, the pool is only freed once they're returned
+  if (frame_pool_ != nullptr) {
+    av_buffer_pool_uninit(&frame_pool_);
+    frame_pool_size_ = 0;
+  }
+
+  frame_index_.clear();
+  keyframe_index_.clear();
+  max_gop_length_ = 0;
+  last_pts_ = AV_NOPTS_VALUE;
+  last_duration_ = 0;
+  frame_tolerance_ = 0;
+
+  ClearFrameCache();
+  last_request_ts_ = AV_NOPTS_VALUE;
+  backward_requests_ = 0;
+  intra_only_ = false;
+  intra_eof_ = false;
+
+  if (swr_ctx_ != nullptr) {
+    swr_free(&swr_ctx_);
+    swr_ctx_ = nullptr;
+  }
+
+  ClearAudioCache();
+  audio_cache_.clear();
+  audio_sample_rate_ = 0;
+
   if (opts_ != nullptr) {
     av_dict_free(&opts_);
     opts_ = nullptr;
@@ -142,14 +666,73 @@ void FFmpegDecoder::Close()
     codec_ctx_ = nullptr;
   }
 
-  if (fmt_ctx_ != nullptr) {
-    avformat_close_input(&fmt_ctx_);
+  if (demuxer_ != nullptr) {
+    bytes_read_ += demuxer_->bytes_read() - demuxer_bytes_read_;
+
+    if (demuxer_stream_ >= 0) {
+      demuxer_->Release(demuxer_stream_);
+    }
+
+    // The file is closed once no other decoder is using it either
+    demuxer_ = nullptr;
     fmt_ctx_ = nullptr;
+    demuxer_stream_ = -1;
+  }
+
+  if (hw_device_ctx_ != nullptr) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_device_ctx_ = nullptr;
+  }
+
+  hw_pix_fmt_ = AV_PIX_FMT_NONE;
+
+  if (counted_as_open_) {
+    open_video_decoders_.deref();
+    counted_as_open_ = false;
   }
 
   open_ = false;
 }
 
+bool FFmpegDecoder::Analyze()
+{
+  bool was_open = open_;
+
+  // Open() will either load a valid index from disk or index the stream and save it
+  if (!Open()) {
+    return false;
+  }
+
+  if (!was_open) {
+    Close();
+  }
+
+  return true;
+}
+
+void FFmpegDecoder::SetHardwareAccelerationEnabled(bool e)
+{
+  hw_accel_enabled_ = e;
+}
+
+bool FFmpegDecoder::IsHardwareAccelerated()
+{
+  return (hw_pix_fmt_ != AV_PIX_FMT_NONE);
+}
+
+qint64 FFmpegDecoder::bytes_read()
+{
+  qint64 bytes = bytes_read_;
+
+  // Include what the currently open file has read so far (decoders sharing the file each count all of it, but this
+  // is only an estimate)
+  if (demuxer_ != nullptr) {
+    bytes += demuxer_->bytes_read() - demuxer_bytes_read_;
+  }
+
+  return bytes;
+}
+
 bool FFmpegDecoder::Probe(Footage *f)
 {
   // Variable for receiving errors from FFmpeg
@@ -162,8 +745,9 @@ bool FFmpegDecoder::Probe(Footage *f)
   QByteArray ba = f->filename().toUtf8();
   const char* filename = ba.constData();
 
-  // Open file in a format context
-  error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
+  // Open file in a format context, only doing a fast analysis so imported files are available immediately
+  // (see DeepProbe() for the full analysis)
+  error_code = OpenFormatContext(f->filename(), -1, FFmpegDemuxer::kAnalyzeFast);
 
   // Handle format context error
   if (error_code == 0) {
@@ -181,23 +765,12 @@ bool FFmpegDecoder::Probe(Footage *f)
       if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
 
         // Create a video stream object
-        VideoStream* video_stream = new VideoStream();
-
-        video_stream->set_width(avstream_->codecpar->width);
-        video_stream->set_height(avstream_->codecpar->height);
-
-        str = video_stream;
+        str = new VideoStream();
 
       } else if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
 
         // Create an audio stream object
-        AudioStream* audio_stream = new AudioStream();
-
-        audio_stream->set_layout(avstream_->codecpar->channel_layout);
-        audio_stream->set_channels(avstream_->codecpar->channels);
-        audio_stream->set_sample_rate(avstream_->codecpar->sample_rate);
-
-        str = audio_stream;
+        str = new AudioStream();
 
       } else {
 
@@ -230,9 +803,7 @@ bool FFmpegDecoder::Probe(Footage *f)
 
       }
 
-      str->set_index(avstream_->index);
-      str->set_timebase(avstream_->time_base);
-      str->set_duration(avstream_->duration);
+      FillStream(str, avstream_);
 
       f->add_stream(str);
     }
@@ -247,19 +818,1163 @@ bool FFmpegDecoder::Probe(Footage *f)
   return result;
 }
 
-void FFmpegDecoder::FFmpegErr(int error_code)
+bool FFmpegDecoder::DeepProbe(Footage *f)
 {
-  char err[1024];
-  av_strerror(error_code, err, 1024);
+  // Analyze the file as much as FFmpeg needs to
+  int error_code = OpenFormatContext(f->filename(), -1, FFmpegDemuxer::kAnalyzeFully);
 
-  Error(tr("Error decoding %1 - %2 %3").arg(stream()->footage()->filename(),
-                                            QString::number(error_code),
-                                            err));
+  bool result = false;
+
+  if (error_code == 0 && fmt_ctx_->nb_streams == static_cast<unsigned int>(f->stream_count())) {
+
+    // Update the existing Stream objects rather than recreating them since other objects may be referencing them
+    for (int i=0;i<f->stream_count();i++) {
+      Stream* str = f->stream(i);
+
+      FillStream(str, fmt_ctx_->streams[str->index()]);
+
+      // Fall back to the container's duration if the stream doesn't have its own
+      if (str->duration() == AV_NOPTS_VALUE && fmt_ctx_->duration != AV_NOPTS_VALUE) {
+        str->set_duration(av_rescale_q(fmt_ctx_->duration, AV_TIME_BASE_Q, fmt_ctx_->streams[str->index()]->time_base));
+      }
+    }
+
+    result = true;
+  }
+
+  // Free all memory
+  Close();
+
+  return result;
 }
 
-void FFmpegDecoder::Error(const QString &s)
+int FFmpegDecoder::OpenFormatContext(const QString &filename, int stream_index, FFmpegDemuxer::Analysis analysis)
 {
-  qWarning() << s;
+  int error_code;
 
-  Close();
+  if (stream_index < 0) {
+    // Probing looks at every stream, so it gets a demuxer of its own
+    demuxer_ = std::make_shared<FFmpegDemuxer>();
+    error_code = demuxer_->Open(filename, analysis, cancel_token_);
+  } else {
+    demuxer_ = FFmpegDemuxer::Acquire(filename, stream_index, analysis, cancel_token_, &error_code);
+  }
+
+  if (error_code < 0) {
+    demuxer_ = nullptr;
+    return error_code;
+  }
+
+  fmt_ctx_ = demuxer_->format_context();
+  demuxer_stream_ = stream_index;
+  demuxer_bytes_read_ = demuxer_->bytes_read();
+
+  return 0;
+}
+
+void FFmpegDecoder::FillStream(Stream *str, AVStream *avstream)
+{
+  if (str->type() == Stream::kVideo) {
+    VideoStream* video_stream = static_cast<VideoStream*>(str);
+
+    video_stream->set_width(avstream->codecpar->width);
+    video_stream->set_height(avstream->codecpar->height);
+    video_stream->set_frame_rate(av_guess_frame_rate(fmt_ctx_, avstream, nullptr));
+  } else if (str->type() == Stream::kAudio) {
+    AudioStream* audio_stream = static_cast<AudioStream*>(str);
+
+    audio_stream->set_layout(avstream->codecpar->channel_layout);
+    audio_stream->set_channels(avstream->codecpar->channels);
+    audio_stream->set_sample_rate(avstream->codecpar->sample_rate);
+  }
+
+  str->set_index(avstream->index);
+  str->set_timebase(avstream->time_base);
+  str->set_duration(avstream->duration);
+
+  // Keep everything a decoder needs so opening one doesn't have to analyze the file again
+  const AVCodecParameters* par = avstream->codecpar;
+
+  Stream::CodecParameters params;
+
+  params.codec_id = par->codec_id;
+  params.codec_tag = par->codec_tag;
+
+  if (par->extradata != nullptr && par->extradata_size > 0) {
+    params.extradata = QByteArray(reinterpret_cast<const char*>(par->extradata), par->extradata_size);
+  }
+
+  params.format = par->format;
+  params.bit_rate = par->bit_rate;
+  params.bits_per_coded_sample = par->bits_per_coded_sample;
+  params.bits_per_raw_sample = par->bits_per_raw_sample;
+  params.profile = par->profile;
+  params.level = par->level;
+
+  params.sample_aspect_ratio = par->sample_aspect_ratio;
+  params.field_order = par->field_order;
+  params.color_range = par->color_range;
+  params.color_primaries = par->color_primaries;
+  params.color_trc = par->color_trc;
+  params.color_space = par->color_space;
+  params.chroma_location = par->chroma_location;
+  params.video_delay = par->video_delay;
+
+  params.block_align = par->block_align;
+  params.frame_size = par->frame_size;
+  params.initial_padding = par->initial_padding;
+  params.seek_preroll = par->seek_preroll;
+
+  str->set_codec_parameters(params);
+}
+
+bool FFmpegDecoder::HasCodecParameters(Stream *str)
+{
+  const Stream::CodecParameters& params = str->codec_parameters();
+
+  if (params.codec_id == AV_CODEC_ID_NONE || params.format < 0) {
+    return false;
+  }
+
+  if (str->type() == Stream::kVideo) {
+    VideoStream* video_stream = static_cast<VideoStream*>(str);
+
+    return video_stream->width() > 0 && video_stream->height() > 0;
+  } else if (str->type() == Stream::kAudio) {
+    AudioStream* audio_stream = static_cast<AudioStream*>(str);
+
+    return audio_stream->channels() > 0 && audio_stream->sample_rate() > 0;
+  }
+
+  return false;
+}
+
+int FFmpegDecoder::GetCodecParameters(Stream *str, AVCodecParameters *par)
+{
+  const Stream::CodecParameters& params = str->codec_parameters();
+
+  par->codec_id = params.codec_id;
+  par->codec_tag = params.codec_tag;
+  par->format = params.format;
+  par->bit_rate = params.bit_rate;
+  par->bits_per_coded_sample = params.bits_per_coded_sample;
+  par->bits_per_raw_sample = params.bits_per_raw_sample;
+  par->profile = params.profile;
+  par->level = params.level;
+
+  if (!params.extradata.isEmpty()) {
+    // FFmpeg expects extradata to be followed by zeroed padding
+    par->extradata = static_cast<uint8_t*>(av_mallocz(params.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+
+    if (par->extradata == nullptr) {
+      return AVERROR(ENOMEM);
+    }
+
+    memcpy(par->extradata, params.extradata.constData(), params.extradata.size());
+    par->extradata_size = params.extradata.size();
+  }
+
+  if (str->type() == Stream::kVideo) {
+    VideoStream* video_stream = static_cast<VideoStream*>(str);
+
+    par->codec_type = AVMEDIA_TYPE_VIDEO;
+    par->width = video_stream->width();
+    par->height = video_stream->height();
+    par->sample_aspect_ratio = params.sample_aspect_ratio;
+    par->field_order = params.field_order;
+    par->color_range = params.color_range;
+    par->color_primaries = params.color_primaries;
+    par->color_trc = params.color_trc;
+    par->color_space = params.color_space;
+    par->chroma_location = params.chroma_location;
+    par->video_delay = params.video_delay;
+  } else if (str->type() == Stream::kAudio) {
+    AudioStream* audio_stream = static_cast<AudioStream*>(str);
+
+    par->codec_type = AVMEDIA_TYPE_AUDIO;
+    par->channel_layout = audio_stream->layout();
+    par->channels = audio_stream->channels();
+    par->sample_rate = audio_stream->sample_rate();
+    par->block_align = params.block_align;
+    par->frame_size = params.frame_size;
+    par->initial_padding = params.initial_padding;
+    par->seek_preroll = params.seek_preroll;
+  }
+
+  return 0;
+}
+
+void FFmpegDecoder::FFmpegErr(int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  Error(tr("Error decoding %1 - %2 %3").arg(stream()->footage()->filename(),
+                                            QString::number(error_code),
+                                            err));
+}
+
+void FFmpegDecoder::Error(const QString &s)
+{
+  qWarning() << s;
+
+  Close();
+}
+
+bool FFmpegDecoder::IndexStream()
+{
+  frame_index_.clear();
+  keyframe_index_.clear();
+
+  demuxer_->SetSequential(true);
+
+  int error_code;
+
+  // Read every packet header of our stream
+  while ((error_code = demuxer_->ReadPacket(avstream_->index, pkt_, cancel_token_)) >= 0) {
+    int64_t ts = GetPacketTimestamp(pkt_);
+
+    if (ts != AV_NOPTS_VALUE) {
+      frame_index_.append(ts);
+
+      if (pkt_->flags & AV_PKT_FLAG_KEY) {
+        keyframe_index_.append(ts);
+      }
+    }
+
+    av_packet_unref(pkt_);
+  }
+
+  // Packets are stored in decode order, which differs from presentation order when B-frames are used
+  std::sort(frame_index_.begin(), frame_index_.end());
+  std::sort(keyframe_index_.begin(), keyframe_index_.end());
+
+  max_gop_length_ = GetMaxGopLength();
+
+  demuxer_->SetSequential(false);
+
+  // Return to the start of the stream ready for decoding
+  int64_t start = keyframe_index_.isEmpty() ? 0 : keyframe_index_.first();
+  demuxer_->Seek(avstream_->index, start, AVSEEK_FLAG_BACKWARD);
+
+  return (error_code == AVERROR_EOF);
+}
+
+int FFmpegDecoder::GetMaxGopLength()
+{
+  int gop_length = 0;
+
+  for (int i=1;i<keyframe_index_.size();i++) {
+    int frames = static_cast<int>(std::lower_bound(frame_index_.constBegin(), frame_index_.constEnd(),
+                                                   keyframe_index_.at(i))
+                                  - std::lower_bound(frame_index_.constBegin(), frame_index_.constEnd(),
+                                                     keyframe_index_.at(i - 1)));
+
+    gop_length = qMax(gop_length, frames);
+  }
+
+  if (!keyframe_index_.isEmpty()) {
+    gop_length = qMax(gop_length,
+                      static_cast<int>(frame_index_.constEnd()
+                                       - std::lower_bound(frame_index_.constBegin(), frame_index_.constEnd(),
+                                                          keyframe_index_.last())));
+  }
+
+  return gop_length;
+}
+
+bool FFmpegDecoder::LoadIndex()
+{
+  QFile index_file(GetIndexFilename());
+
+  if (!index_file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  qint64 file_size = index_file.size();
+
+  if (file_size < static_cast<qint64>(sizeof(FFmpegIndexHeader))) {
+    return false;
+  }
+
+  uchar* map = index_file.map(0, file_size);
+
+  if (map == nullptr) {
+    return false;
+  }
+
+  bool result = false;
+
+  const FFmpegIndexHeader* header = reinterpret_cast<const FFmpegIndexHeader*>(map);
+
+  // Validate header and make sure the file is the size the header says it is
+  if (memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) == 0
+      && header->version == kIndexVersion
+      && header->frame_count >= 0
+      && header->keyframe_count >= 0
+      && header->max_gop_length >= 0
+      && header->max_gop_length <= header->frame_count
+      && file_size == static_cast<qint64>(sizeof(FFmpegIndexHeader))
+                      + (header->frame_count + header->keyframe_count) * static_cast<qint64>(sizeof(int64_t))) {
+
+    const int64_t* timestamps = reinterpret_cast<const int64_t*>(map + sizeof(FFmpegIndexHeader));
+
+    frame_index_.resize(static_cast<int>(header->frame_count));
+    memcpy(frame_index_.data(), timestamps, static_cast<size_t>(header->frame_count) * sizeof(int64_t));
+
+    keyframe_index_.resize(static_cast<int>(header->keyframe_count));
+    memcpy(keyframe_index_.data(),
+           timestamps + header->frame_count,
+           static_cast<size_t>(header->keyframe_count) * sizeof(int64_t));
+
+    max_gop_length_ = static_cast<int>(header->max_gop_length);
+
+    result = true;
+  }
+
+  index_file.unmap(map);
+
+  return result;
+}
+
+void FFmpegDecoder::SaveIndex()
+{
+  // QSaveFile ensures a partially written index can never be read by LoadIndex()
+  QSaveFile index_file(GetIndexFilename());
+
+  if (!index_file.open(QFile::WriteOnly)) {
+    qWarning() << tr("Failed to write index file for %1").arg(stream()->footage()->filename());
+    return;
+  }
+
+  FFmpegIndexHeader header;
+  memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version = kIndexVersion;
+  header.frame_count = frame_index_.size();
+  header.keyframe_count = keyframe_index_.size();
+  header.max_gop_length = max_gop_length_;
+
+  index_file.write(reinterpret_cast<const char*>(&header), sizeof(FFmpegIndexHeader));
+  index_file.write(reinterpret_cast<const char*>(frame_index_.constData()),
+                   static_cast<qint64>(frame_index_.size()) * static_cast<qint64>(sizeof(int64_t)));
+  index_file.write(reinterpret_cast<const char*>(keyframe_index_.constData()),
+                   static_cast<qint64>(keyframe_index_.size()) * static_cast<qint64>(sizeof(int64_t)));
+
+  index_file.commit();
+}
+
+bool FFmpegDecoder::InitHardwareDecoding(AVCodec *codec)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 0, 0)
+  // Device types to try in order of preference for this platform
+  QList<AVHWDeviceType> device_types;
+
+#if defined(Q_OS_WIN)
+  device_types.append(AV_HWDEVICE_TYPE_D3D11VA);
+  device_types.append(AV_HWDEVICE_TYPE_CUDA);
+#elif defined(Q_OS_MAC)
+  device_types.append(AV_HWDEVICE_TYPE_VIDEOTOOLBOX);
+#elif defined(Q_OS_LINUX)
+  device_types.append(AV_HWDEVICE_TYPE_VAAPI);
+  device_types.append(AV_HWDEVICE_TYPE_CUDA);
+#endif
+
+  foreach (AVHWDeviceType type, device_types) {
+
+    // Check if this decoder supports this device type
+    const AVCodecHWConfig* config;
+
+    for (int i=0;(config = avcodec_get_hw_config(codec, i)) != nullptr;i++) {
+      if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+        break;
+      }
+    }
+
+    if (config == nullptr) {
+      continue;
+    }
+
+    // Try to create the device (this will fail if e.g. there's no driver for it on this system)
+    if (av_hwdevice_ctx_create(&hw_device_ctx_, type, nullptr, nullptr, 0) < 0) {
+      hw_device_ctx_ = nullptr;
+      continue;
+    }
+
+    hw_pix_fmt_ = config->pix_fmt;
+
+    codec_ctx_->hw_device_ctx = av_buffer_ref(hw_device_ctx_);
+    codec_ctx_->opaque = this;
+    codec_ctx_->get_format = GetHardwarePixelFormat;
+
+    return true;
+  }
+#else
+  Q_UNUSED(codec)
+#endif
+
+  return false;
+}
+
+AVPixelFormat FFmpegDecoder::GetHardwarePixelFormat(AVCodecContext *ctx, const AVPixelFormat *formats)
+{
+  FFmpegDecoder* decoder = static_cast<FFmpegDecoder*>(ctx->opaque);
+
+  for (const AVPixelFormat* p = formats;*p != AV_PIX_FMT_NONE;p++) {
+    if (*p == decoder->hw_pix_fmt_) {
+      return *p;
+    }
+  }
+
+  // The hardware can't decode this particular stream (e.g. unsupported profile), fall back to software
+  decoder->hw_pix_fmt_ = AV_PIX_FMT_NONE;
+
+  return avcodec_default_get_format(ctx, formats);
+}
+
+bool FFmpegDecoder::AllocatePooledFrame(AVFrame *dst, AVPixelFormat format, int width, int height)
+{
+  // Align each plane to 32 bytes for SIMD
+  const int kAlignment = 32;
+
+  int size = av_image_get_buffer_size(format, width, height, kAlignment);
+
+  if (size < 0) {
+    FFmpegErr(size);
+    return false;
+  }
+
+  // Recreate the pool if the frame size has changed
+  if (frame_pool_ != nullptr && frame_pool_size_ != size) {
+    av_buffer_pool_uninit(&frame_pool_);
+  }
+
+  if (frame_pool_ == nullptr) {
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 0, 0)
+    frame_pool_ = av_buffer_pool_init(static_cast<size_t>(size), av_buffer_alloc);
+#else
+    frame_pool_ = av_buffer_pool_init(size, av_buffer_alloc);
+#endif
+    frame_pool_size_ = size;
+
+    if (frame_pool_ == nullptr) {
+      return false;
+    }
+  }
+
+  dst->buf[0] = av_buffer_pool_get(frame_pool_);
+
+  if (dst->buf[0] == nullptr) {
+    return false;
+  }
+
+  int error_code = av_image_fill_arrays(dst->data,
+                                        dst->linesize,
+                                        dst->buf[0]->data,
+                                        format,
+                                        width,
+                                        height,
+                                        kAlignment);
+
+  if (error_code < 0) {
+    av_frame_unref(dst);
+    FFmpegErr(error_code);
+    return false;
+  }
+
+  dst->format = format;
+  dst->width = width;
+  dst->height = height;
+
+  return true;
+}
+
+FramePtr FFmpegDecoder::RetrieveAudio(const rational &timecode, const rational &length)
+{
+  Tracing::Span span("decoder", "FFmpegDecoder::RetrieveAudio");
+
+  int sample_rate = (output_sample_rate_ > 0) ? output_sample_rate_ : codec_ctx_->sample_rate;
+
+  if ((swr_ctx_ == nullptr || audio_sample_rate_ != sample_rate) && !InitResampler(sample_rate)) {
+    return nullptr;
+  }
+
+  AVRational sample_timebase = {1, sample_rate};
+
+  // Convert the requested span to sample indices
+  rational start_time = timecode;
+  rational duration = length;
+
+  int64_t start = (start_time.denominator() == 0)
+      ? 0 : av_rescale(start_time.numerator(), sample_rate, start_time.denominator());
+  int64_t count = (duration.denominator() == 0)
+      ? 0 : av_rescale(duration.numerator(), sample_rate, duration.denominator());
+
+  if (count <= 0) {
+    return nullptr;
+  }
+
+  int64_t end = start + count;
+
+  // Seek if the request isn't within or shortly after the cached audio
+  if (audio_cache_start_ == AV_NOPTS_VALUE
+      || start < audio_cache_start_
+      || start > AudioCacheEnd() + kAudioSeekThreshold * sample_rate) {
+    ClearAudioCache();
+
+    // The resampler may still have samples buffered from before the seek
+    if (!InitResampler(sample_rate)) {
+      return nullptr;
+    }
+
+    Seek(GetTimestampFromTime(timecode));
+  } else if (start - audio_cache_start_ > kAudioCacheLength * sample_rate) {
+    // Drop audio that has fallen too far behind the request. The request can start after the end of the cache (see
+    // kAudioSeekThreshold), in which case everything cached is stale and decoding carries on from where it ends.
+    int64_t cache_end = AudioCacheEnd();
+    int64_t keep_from = qMin(start - kAudioCacheLength * sample_rate, cache_end);
+
+    if (keep_from == cache_end) {
+      for (int i=0;i<audio_cache_.size();i++) {
+        audio_cache_[i].clear();
+      }
+    } else {
+      int drop = static_cast<int>(keep_from - audio_cache_start_);
+
+      for (int i=0;i<audio_cache_.size();i++) {
+        audio_cache_[i].remove(0, drop);
+      }
+    }
+
+    audio_cache_start_ = keep_from;
+  }
+
+  // Decode until the whole span is cached
+  while (!audio_eof_ && (audio_cache_start_ == AV_NOPTS_VALUE || AudioCacheEnd() < end)) {
+    int error_code = DecodeAudio();
+
+    if (error_code == AVERROR_EOF) {
+      audio_eof_ = true;
+    } else if (error_code < 0) {
+      FFmpegErr(error_code);
+      return nullptr;
+    }
+  }
+
+  // Copy the span out of the cache
+  AVFrame* out = av_frame_alloc();
+
+  if (out == nullptr) {
+    return nullptr;
+  }
+
+  out->format = AV_SAMPLE_FMT_FLTP;
+  out->channel_layout = static_cast<uint64_t>(audio_channel_layout_);
+  out->channels = audio_cache_.size();
+  out->sample_rate = sample_rate;
+  out->nb_samples = static_cast<int>(count);
+  out->pts = start;
+
+  if (av_frame_get_buffer(out, 0) < 0) {
+    av_frame_free(&out);
+    return nullptr;
+  }
+
+  int64_t copy_start = start;
+  int64_t copy_end = end;
+
+  if (audio_cache_start_ == AV_NOPTS_VALUE) {
+    copy_end = copy_start;
+  } else {
+    copy_start = qMax(copy_start, audio_cache_start_);
+    copy_end = qMin(copy_end, AudioCacheEnd());
+  }
+
+  for (int i=0;i<audio_cache_.size();i++) {
+    float* dst = reinterpret_cast<float*>(out->extended_data[i]);
+
+    // Anything not covered by the cache (before the stream starts or after it ends) is silence
+    memset(dst, 0, static_cast<size_t>(count) * sizeof(float));
+
+    if (copy_end > copy_start) {
+      memcpy(dst + (copy_start - start),
+             audio_cache_.at(i).constData() + (copy_start - audio_cache_start_),
+             static_cast<size_t>(copy_end - copy_start) * sizeof(float));
+    }
+  }
+
+  FramePtr f = std::make_shared<Frame>();
+  f->SetAVFrame(out, sample_timebase);
+
+  return f;
+}
+
+bool FFmpegDecoder::InitResampler(int sample_rate)
+{
+  if (swr_ctx_ != nullptr) {
+    swr_free(&swr_ctx_);
+  }
+
+  ClearAudioCache();
+
+  audio_channel_layout_ = static_cast<int64_t>(codec_ctx_->channel_layout);
+
+  if (audio_channel_layout_ == 0) {
+    audio_channel_layout_ = av_get_default_channel_layout(codec_ctx_->channels);
+  }
+
+  swr_ctx_ = swr_alloc_set_opts(nullptr,
+                                audio_channel_layout_,
+                                AV_SAMPLE_FMT_FLTP,
+                                sample_rate,
+                                audio_channel_layout_,
+                                codec_ctx_->sample_fmt,
+                                codec_ctx_->sample_rate,
+                                0,
+                                nullptr);
+
+  if (swr_ctx_ == nullptr) {
+    Error(tr("Failed to allocate resampler (%1)").arg(stream()->footage()->filename()));
+    return false;
+  }
+
+  int error_code = swr_init(swr_ctx_);
+
+  if (error_code < 0) {
+    FFmpegErr(error_code);
+    return false;
+  }
+
+  audio_sample_rate_ = sample_rate;
+  ts_to_samples_ = TickRescaler(avstream_->time_base, rational(1, sample_rate));
+  audio_cache_.resize(codec_ctx_->channels);
+
+  return true;
+}
+
+int FFmpegDecoder::DecodeAudio()
+{
+  int error_code = GetFrame();
+
+  if (error_code == AVERROR_EOF) {
+    // Flush any samples still buffered in the resampler
+    error_code = ResampleIntoCache(nullptr, 0);
+
+    return (error_code < 0) ? error_code : AVERROR_EOF;
+  } else if (error_code < 0) {
+    return error_code;
+  }
+
+  last_pts_ = frame_->best_effort_timestamp;
+
+  // The first frame after a seek determines where the cache starts
+  if (audio_cache_start_ == AV_NOPTS_VALUE) {
+    int64_t pts = (frame_->best_effort_timestamp == AV_NOPTS_VALUE) ? 0 : frame_->best_effort_timestamp;
+
+    if (avstream_->start_time != AV_NOPTS_VALUE) {
+      pts -= avstream_->start_time;
+    }
+
+    audio_cache_start_ = ts_to_samples_.Rescale(pts);
+  }
+
+  return ResampleIntoCache(const_cast<const uint8_t**>(frame_->extended_data), frame_->nb_samples);
+}
+
+int FFmpegDecoder::ResampleIntoCache(const uint8_t **in, int in_count)
+{
+  int out_count = swr_get_out_samples(swr_ctx_, in_count);
+
+  if (out_count <= 0 || audio_cache_.isEmpty()) {
+    return 0;
+  }
+
+  int old_size = audio_cache_.first().size();
+
+  // Convert directly into the end of the cache
+  QVector<uint8_t*> out(audio_cache_.size());
+
+  for (int i=0;i<audio_cache_.size();i++) {
+    audio_cache_[i].resize(old_size + out_count);
+    out[i] = reinterpret_cast<uint8_t*>(audio_cache_[i].data() + old_size);
+  }
+
+  int converted = swr_convert(swr_ctx_, out.data(), out_count, in, in_count);
+
+  for (int i=0;i<audio_cache_.size();i++) {
+    audio_cache_[i].resize(old_size + qMax(0, converted));
+  }
+
+  return (converted < 0) ? converted : 0;
+}
+
+void FFmpegDecoder::ClearAudioCache()
+{
+  for (int i=0;i<audio_cache_.size();i++) {
+    audio_cache_[i].clear();
+  }
+
+  audio_cache_start_ = AV_NOPTS_VALUE;
+  audio_eof_ = false;
+}
+
+int64_t FFmpegDecoder::AudioCacheEnd()
+{
+  if (audio_cache_start_ == AV_NOPTS_VALUE || audio_cache_.isEmpty()) {
+    return audio_cache_start_;
+  }
+
+  return audio_cache_start_ + audio_cache_.first().size();
+}
+
+int FFmpegDecoder::GetFrame()
+{
+  int error_code;
+
+  // Keep feeding packets until the decoder gives us a complete frame
+  while ((error_code = avcodec_receive_frame(codec_ctx_, frame_)) == AVERROR(EAGAIN)) {
+
+    // Read the next packet that belongs to our stream
+    av_packet_unref(pkt_);
+    error_code = demuxer_->ReadPacket(avstream_->index, pkt_, cancel_token_);
+
+    if (error_code == AVERROR_EOF) {
+      // No more packets, send a null packet to drain any frames still buffered in the decoder
+      error_code = avcodec_send_packet(codec_ctx_, nullptr);
+    } else if (error_code >= 0) {
+      error_code = avcodec_send_packet(codec_ctx_, pkt_);
+      av_packet_unref(pkt_);
+    }
+
+    // AVERROR_EOF here just means the decoder is already draining, avcodec_receive_frame() will tell us when it's done
+    if (error_code < 0 && error_code != AVERROR_EOF) {
+      return error_code;
+    }
+  }
+
+  return error_code;
+}
+
+void FFmpegDecoder::Seek(int64_t timestamp)
+{
+  // Find the closest keyframe at or before this timestamp
+  QVector<int64_t>::const_iterator it = std::upper_bound(keyframe_index_.constBegin(),
+                                                         keyframe_index_.constEnd(),
+                                                         timestamp);
+
+  if (it != keyframe_index_.constBegin()) {
+    timestamp = *(it - 1);
+  }
+
+  avcodec_flush_buffers(codec_ctx_);
+
+  demuxer_->Seek(avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
+
+  last_pts_ = AV_NOPTS_VALUE;
+}
+
+void FFmpegDecoder::CacheFrame()
+{
+  // Hardware frames would each have to be downloaded (and would hold onto the decoder's limited surfaces)
+  if (hw_pix_fmt_ != AV_PIX_FMT_NONE && frame_->format == hw_pix_fmt_) {
+    return;
+  }
+
+  UpdateFrameCacheCapacity();
+
+  if (frame_cache_capacity_ == 0 || frame_cache_.contains(last_pts_)) {
+    return;
+  }
+
+  // Only references the decoded buffers, nothing is copied
+  AVFrame* copy = av_frame_clone(frame_);
+
+  if (copy != nullptr) {
+    InsertCachedFrame(last_pts_, copy);
+  }
+}
+
+void FFmpegDecoder::InsertCachedFrame(int64_t ts, AVFrame *frame)
+{
+  if (frame_cache_capacity_ <= 0) {
+    av_frame_free(&frame);
+    return;
+  }
+
+  QMap<int64_t, CachedFrame>::iterator existing = frame_cache_.find(ts);
+
+  if (existing != frame_cache_.end()) {
+    av_frame_free(&existing->frame);
+    frame_cache_.erase(existing);
+  }
+
+  // Free the least recently used frame to make room
+  if (frame_cache_.size() >= frame_cache_capacity_) {
+    QMap<int64_t, CachedFrame>::iterator oldest = frame_cache_.begin();
+
+    for (QMap<int64_t, CachedFrame>::iterator i=frame_cache_.begin();i!=frame_cache_.end();i++) {
+      if (i->last_access < oldest->last_access) {
+        oldest = i;
+      }
+    }
+
+    av_frame_free(&oldest->frame);
+    frame_cache_.erase(oldest);
+  }
+
+  frame_cache_.insert(ts, {frame, ++frame_cache_access_});
+}
+
+FramePtr FFmpegDecoder::RetrieveCachedFrame(int64_t ts)
+{
+  QMap<int64_t, CachedFrame>::iterator cached = frame_cache_.find(ts);
+
+  if (cached == frame_cache_.end()) {
+    return nullptr;
+  }
+
+  cached->last_access = ++frame_cache_access_;
+
+  AVFrame* copy = av_frame_clone(cached->frame);
+
+  if (copy == nullptr) {
+    return nullptr;
+  }
+
+  FramePtr f = std::make_shared<Frame>();
+  f->SetAVFrame(copy, avstream_->time_base);
+
+  return f;
+}
+
+void FFmpegDecoder::UpdateFrameCacheCapacity()
+{
+  if (frame_cache_capacity_ >= 0) {
+    return;
+  }
+
+  // Hardware frames are cached after they've been downloaded, so size them in their software format
+  AVPixelFormat format = static_cast<AVPixelFormat>(frame_->format);
+
+  if (hw_pix_fmt_ != AV_PIX_FMT_NONE && format == hw_pix_fmt_) {
+    format = reinterpret_cast<AVHWFramesContext*>(frame_->hw_frames_ctx->data)->sw_format;
+  }
+
+  int frame_size = av_image_get_buffer_size(format, frame_->width, frame_->height, 1);
+
+  // Enough frames to step back through the longest GOP, as long as they fit in the budget
+  frame_cache_capacity_ = (frame_size > 0) ? static_cast<int>(qMin(static_cast<qint64>(max_gop_length_),
+                                                                   kFrameCacheBudget / frame_size)) : 0;
+}
+
+void FFmpegDecoder::ClearFrameCache()
+{
+  for (QMap<int64_t, CachedFrame>::iterator i=frame_cache_.begin();i!=frame_cache_.end();i++) {
+    av_frame_free(&i->frame);
+  }
+
+  frame_cache_.clear();
+  frame_cache_capacity_ = -1;
+}
+
+void FFmpegDecoder::DecodeGop(int64_t keyframe, int64_t last_ts, int max_frames, QVector<DecodedFrame> *frames)
+{
+  if (last_ts == AV_NOPTS_VALUE) {
+    // Decode up to the last frame before the next keyframe (or the end of the stream)
+    QVector<int64_t>::const_iterator next = std::upper_bound(keyframe_index_.constBegin(),
+                                                             keyframe_index_.constEnd(),
+                                                             keyframe);
+
+    last_ts = (next == keyframe_index_.constEnd()) ? frame_index_.last() : GetClosestTimestampInIndex(*next - 1);
+  }
+
+  Seek(keyframe);
+
+  forever {
+    int error_code = GetFrame();
+
+    if (error_code < 0) {
+      if (error_code != AVERROR_EOF) {
+        FFmpegErr(error_code);
+      }
+
+      break;
+    }
+
+    last_pts_ = frame_->best_effort_timestamp;
+
+    // Frames of an open GOP shown before its keyframe belong to the previous GOP
+    if (last_pts_ >= keyframe && last_pts_ <= last_ts) {
+      AVFrame* copy = CloneFrame();
+
+      if (copy != nullptr) {
+        frames->append({last_pts_, copy});
+
+        if (frames->size() > max_frames) {
+          av_frame_free(&frames->first().frame);
+          frames->removeFirst();
+        }
+      }
+    }
+
+    if (last_pts_ >= last_ts) {
+      break;
+    }
+  }
+}
+
+bool FFmpegDecoder::RetrieveGopBackward(int64_t target_ts)
+{
+  // Nothing's been decoded yet to size the cache with
+  if (frame_cache_capacity_ <= 0) {
+    return false;
+  }
+
+  int64_t keyframe = GetKeyframeBefore(target_ts);
+
+  QVector<DecodedFrame> frames;
+
+  {
+    QMutexLocker locker(&prefetch_mutex_);
+
+    if (prefetch_keyframe_ == keyframe) {
+      while (prefetch_running_) {
+        prefetch_done_.wait(&prefetch_mutex_);
+      }
+
+      frames = prefetch_frames_;
+      prefetch_frames_.clear();
+      prefetch_keyframe_ = AV_NOPTS_VALUE;
+    }
+  }
+
+  bool has_target = false;
+
+  foreach (const DecodedFrame& f, frames) {
+    if (f.timestamp == target_ts) {
+      has_target = true;
+      break;
+    }
+  }
+
+  // The prefetch may only have kept the end of a GOP that doesn't fit in the cache
+  if (!has_target) {
+    for (int i=0;i<frames.size();i++) {
+      av_frame_free(&frames[i].frame);
+    }
+
+    frames.clear();
+
+    DecodeGop(keyframe, target_ts, frame_cache_capacity_, &frames);
+  }
+
+  foreach (const DecodedFrame& f, frames) {
+    InsertCachedFrame(f.timestamp, f.frame);
+  }
+
+  StartPrefetch(target_ts);
+
+  return frame_cache_.contains(target_ts);
+}
+
+void FFmpegDecoder::StartPrefetch(int64_t ts)
+{
+  if (frame_cache_capacity_ <= 0 || keyframe_index_.isEmpty()) {
+    return;
+  }
+
+  int64_t current = GetKeyframeBefore(ts);
+
+  QVector<int64_t>::const_iterator it = std::lower_bound(keyframe_index_.constBegin(),
+                                                         keyframe_index_.constEnd(),
+                                                         current);
+
+  // This is the first GOP, there's nothing before it
+  if (it == keyframe_index_.constBegin()) {
+    return;
+  }
+
+  int64_t previous = *(it - 1);
+
+  // The previous GOP is already cached (e.g. it was played forward a moment ago)
+  if (frame_cache_.contains(GetClosestTimestampInIndex(current - 1))) {
+    return;
+  }
+
+  QMutexLocker locker(&prefetch_mutex_);
+
+  if (prefetch_running_ || prefetch_keyframe_ == previous) {
+    return;
+  }
+
+  for (int i=0;i<prefetch_frames_.size();i++) {
+    av_frame_free(&prefetch_frames_[i].frame);
+  }
+
+  prefetch_frames_.clear();
+
+  if (prefetch_decoder_ == nullptr) {
+    // A decoder of its own so it has a read position (and codec state) of its own
+    prefetch_decoder_.reset(new FFmpegDecoder());
+    prefetch_decoder_->set_stream(stream());
+    prefetch_decoder_->set_target_resolution(target_width_, target_height_);
+    prefetch_decoder_->set_purpose(purpose_);
+    prefetch_decoder_->set_threading(threading_mode_, thread_count_);
+    prefetch_decoder_->set_cancel_token(&prefetch_cancel_);
+    prefetch_decoder_->SetHardwareAccelerationEnabled(hw_accel_enabled_);
+  }
+
+  prefetch_keyframe_ = previous;
+  prefetch_running_ = true;
+
+  PrefetchPool()->start(new PrefetchRunnable(this, previous, frame_cache_capacity_));
+}
+
+void FFmpegDecoder::StopPrefetch()
+{
+  prefetch_cancel_.store(1);
+
+  {
+    QMutexLocker locker(&prefetch_mutex_);
+
+    while (prefetch_running_) {
+      prefetch_done_.wait(&prefetch_mutex_);
+    }
+
+    for (int i=0;i<prefetch_frames_.size();i++) {
+      av_frame_free(&prefetch_frames_[i].frame);
+    }
+
+    prefetch_frames_.clear();
+    prefetch_keyframe_ = AV_NOPTS_VALUE;
+  }
+
+  prefetch_decoder_ = nullptr;
+
+  prefetch_cancel_.store(0);
+}
+
+void FFmpegDecoder::UpdateDirection(int64_t target_ts)
+{
+  if (last_request_ts_ != AV_NOPTS_VALUE && target_ts != last_request_ts_) {
+    // frame_tolerance_ is a fraction of a typical frame, see Open()
+    int64_t max_step = kReverseMaxStep * frame_tolerance_ * kFrameToleranceDivisor;
+
+    if (target_ts < last_request_ts_ && last_request_ts_ - target_ts <= max_step) {
+      backward_requests_++;
+    } else {
+      backward_requests_ = 0;
+    }
+  }
+
+  last_request_ts_ = target_ts;
+}
+
+bool FFmpegDecoder::IsPlayingBackward()
+{
+  return (backward_requests_ >= kReverseRequests && !keyframe_index_.isEmpty());
+}
+
+int64_t FFmpegDecoder::GetKeyframeBefore(int64_t ts)
+{
+  QVector<int64_t>::const_iterator it = std::upper_bound(keyframe_index_.constBegin(),
+                                                         keyframe_index_.constEnd(),
+                                                         ts);
+
+  if (it == keyframe_index_.constBegin()) {
+    return keyframe_index_.isEmpty() ? AV_NOPTS_VALUE : keyframe_index_.first();
+  }
+
+  return *(it - 1);
+}
+
+int64_t FFmpegDecoder::GetPacketTimestamp(const AVPacket *pkt)
+{
+  // Some containers (e.g. AVI) don't store a PTS, in which case the DTS is the best we have
+  return (pkt->pts != AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+}
+
+int64_t FFmpegDecoder::GetTimestampFromTime(const rational &time)
+{
+  // Use the AVStream's own timebase since a proxy's timebase may differ from the original stream's (TimeToTicks()
+  // returns 0 for a zero time or timebase)
+  int64_t ts = olive::TimeToTicks(time, stream_timebase_);
+
+  // Timecodes are relative to the start of the media, but the stream's first timestamp isn't necessarily 0
+  if (avstream_->start_time != AV_NOPTS_VALUE) {
+    ts += avstream_->start_time;
+  }
+
+  return ts;
+}
+
+int64_t FFmpegDecoder::GetFrameTimestamp(const rational &time)
+{
+  int64_t ts = GetTimestampFromTime(time) + frame_tolerance_;
+
+  // Intra-only streams aren't indexed, seeking to the timestamp finds the frame instead
+  if (intra_only_) {
+    return ts;
+  }
+
+  return GetClosestTimestampInIndex(ts);
+}
+
+int64_t FFmpegDecoder::GetTypicalFrameDuration()
+{
+  if (frame_index_.size() > 1) {
+    // The median interval between frames, which gaps and bursts in VFR footage don't skew
+    QVector<int64_t> intervals(frame_index_.size() - 1);
+
+    for (int i=1;i<frame_index_.size();i++) {
+      intervals[i - 1] = frame_index_.at(i) - frame_index_.at(i - 1);
+    }
+
+    std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+
+    return intervals.at(intervals.size() / 2);
+  }
+
+  AVRational rate = av_guess_frame_rate(fmt_ctx_, avstream_, nullptr);
+
+  if (rate.num <= 0 || rate.den <= 0) {
+    return 0;
+  }
+
+  return av_rescale_q(1, av_inv_q(rate), avstream_->time_base);
+}
+
+int64_t FFmpegDecoder::GetClosestTimestampInIndex(const int64_t &ts)
+{
+  if (frame_index_.isEmpty()) {
+    return AV_NOPTS_VALUE;
+  }
+
+  QVector<int64_t>::const_iterator it = std::upper_bound(frame_index_.constBegin(), frame_index_.constEnd(), ts);
+
+  // The requested time is before the first frame, the first frame is the closest we have
+  if (it == frame_index_.constBegin()) {
+    return frame_index_.first();
+  }
+
+  return *(it - 1);
+}
+
+bool FFmpegDecoder::CanDecodeForwardTo(const int64_t &target_ts)
+{
+  // Nothing decoded yet (just opened or seeked), so we're positioned at a keyframe already
+  if (last_pts_ == AV_NOPTS_VALUE) {
+    return false;
+  }
+
+  // We'd have to go backwards, a seek is unavoidable
+  if (target_ts < last_pts_) {
+    return false;
+  }
+
+  // Check whether a keyframe lies between the current position and the target (i.e. the target is in a later GOP)
+  QVector<int64_t>::const_iterator next_keyframe = std::upper_bound(keyframe_index_.constBegin(),
+                                                                    keyframe_index_.constEnd(),
+                                                                    last_pts_);
+
+  return (next_keyframe == keyframe_index_.constEnd() || *next_keyframe > target_ts);
 }
@@ -21,9 +21,19 @@
 #ifndef FFMPEGDECODER_H
 #define FFMPEGDECODER_H
 
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+#include <QMap>
+#include <QMutex>
 #include <QVector>
+#include <QWaitCondition>
+#include <memory>
 
+#include "common/tickrescaler.h"
 #include "decoder/decoder.h"
+#include "decoder/ffmpeg/ffmpegdemuxer.h"
 
 /**
  * @brief A Decoder derivative that wraps FFmpeg functions as on Olive decoder
@@ -33,25 +43,589 @@ class FFmpegDecoder : public Decoder
 public:
   FFmpegDecoder();
 
+  /**
+   * @brief Destructor, ensures all FFmpeg memory is freed
+   */
+  virtual ~FFmpegDecoder() override;
+
   virtual bool Probe(Footage *f) override;
+  virtual bool DeepProbe(Footage *f) override;
 
   virtual bool Open() override;
   virtual FramePtr Retrieve(const rational &timecode, const rational &length = 0) override;
   virtual void Close() override;
 
+  /**
+   * @brief Index the stream and store the index on disk for later Open() calls
+   *
+   * If a valid index already exists on disk for this stream, it's used as-is.
+   *
+   * Intra-only streams are never indexed, see RetrieveIntraFrame().
+   */
+  virtual bool Analyze() override;
+
+  /**
+   * @brief Set whether Open() should try to set up hardware accelerated decoding (TRUE by default)
+   *
+   * Takes effect on the next Open(). If hardware decoding can't be set up for this codec/platform, Open() silently
+   * falls back to software decoding.
+   */
+  void SetHardwareAccelerationEnabled(bool e);
+
+  /**
+   * @brief Returns whether the currently open stream is being decoded in hardware
+   */
+  bool IsHardwareAccelerated();
+
+  virtual qint64 bytes_read() override;
+
 protected:
   void FFmpegErr(int error_code);
   void Error(const QString& s);
 
+  /**
+   * @brief Get a demuxer for `filename` into demuxer_ and fmt_ctx_ (see FFmpegDemuxer::Open())
+   *
+   * @param stream_index
+   *
+   * The stream this decoder will read, the demuxer is shared with decoders of the file's other streams. Use -1 to get
+   * a demuxer of its own (e.g. for probing).
+   *
+   * @param analysis
+   *
+   * How much of the file to analyze, see FFmpegDemuxer::Analysis.
+   *
+   * @return
+   *
+   * 0 on success or a negative FFmpeg error code.
+   */
+  int OpenFormatContext(const QString& filename, int stream_index, FFmpegDemuxer::Analysis analysis);
+
+  /**
+   * @brief Copy metadata from an AVStream, including its codec parameters, into a Stream object
+   */
+  void FillStream(Stream* str, AVStream* avstream);
+
+  /**
+   * @brief Returns TRUE if a Stream was probed with everything needed to open a decoder for it
+   */
+  static bool HasCodecParameters(Stream* str);
+
+  /**
+   * @brief Write a Stream's probed codec parameters to `par` (see HasCodecParameters())
+   *
+   * @return
+   *
+   * 0 on success or a negative FFmpeg error code.
+   */
+  static int GetCodecParameters(Stream* str, AVCodecParameters* par);
+
+  /**
+   * @brief Scan the whole stream and fill frame_index_, keyframe_index_ and max_gop_length_
+   *
+   * Only packet headers are read (nothing is decoded) so this is fairly fast, but it still has to read through the
+   * entire file once. The format context is seeked back to the start of the stream before returning.
+   *
+   * @return
+   *
+   * TRUE if the whole stream was read, FALSE if reading failed or was cancelled part way through (the index only
+   * covers the start of the stream then, so it shouldn't be saved).
+   */
+  bool IndexStream();
+
+  /**
+   * @brief Number of frames in the longest GOP in frame_index_ and keyframe_index_
+   */
+  int GetMaxGopLength();
+
+  /**
+   * @brief Try to load frame_index_, keyframe_index_ and max_gop_length_ from the on-disk index created by a previous
+   * SaveIndex()
+   *
+   * The index file is memory-mapped and copied directly into the index arrays without any parsing.
+   *
+   * @return
+   *
+   * TRUE if a valid index was found and loaded, FALSE if the stream needs to be indexed with IndexStream().
+   */
+  bool LoadIndex();
+
+  /**
+   * @brief Write frame_index_, keyframe_index_ and max_gop_length_ to disk so subsequent Open() calls can use
+   * LoadIndex()
+   */
+  void SaveIndex();
+
+  /**
+   * @brief Try to attach a hardware device to codec_ctx_ for hardware accelerated decoding
+   *
+   * The device type is picked based on the platform (VAAPI on Linux, D3D11VA/NVDEC on Windows, VideoToolbox on
+   * macOS). Must be called after codec_ctx_ is allocated and before avcodec_open2().
+   *
+   * @return
+   *
+   * TRUE if a hardware device was attached, FALSE if this stream will be decoded in software.
+   */
+  bool InitHardwareDecoding(AVCodec* codec);
+
+  /**
+   * @brief Set codec_ctx_'s threading mode and thread count before it's opened
+   *
+   * Unless set_threading() asked for something specific, intra-only codecs use slice threading, export uses frame
+   * threading if the codec supports it, and anything else prefers slice threading so seeking and scrubbing aren't
+   * delayed by a frame per thread. The cores are shared between every open video decoder.
+   */
+  void ConfigureThreading(AVCodec* codec);
+
+  /**
+   * @brief AVCodecContext::get_format callback that picks the hardware pixel format if the decoder offers it
+   */
+  static AVPixelFormat GetHardwarePixelFormat(AVCodecContext* ctx, const AVPixelFormat* formats);
+
+  /**
+   * @brief Allocate buffers for `dst` from frame_pool_
+   *
+   * Buffers are returned to the pool when the last reference to them is freed, so frames that are repeatedly
+   * allocated at the same size (e.g. hardware frames downloaded to system memory) don't need a new allocation each
+   * time. The pool is recreated if the required size changes.
+   *
+   * @return
+   *
+   * TRUE on success. `dst` must be unreferenced beforehand.
+   */
+  bool AllocatePooledFrame(AVFrame* dst, AVPixelFormat format, int width, int height);
+
+  /**
+   * @brief Retrieve() implementation for audio streams
+   *
+   * Audio is decoded, converted once to planar float at the output sample rate (see
+   * Decoder::set_output_sample_rate()) and kept in audio_cache_. Requests within or just after the cached range are
+   * served from the cache, decoding forward only as far as necessary. Any other request seeks.
+   *
+   * @return
+   *
+   * A Frame containing exactly the requested span of samples. Any part of the span outside of the stream is silent.
+   */
+  FramePtr RetrieveAudio(const rational& timecode, const rational& length);
+
+  /**
+   * @brief Retrieve() implementation for intra-only video streams (see intra_only_)
+   *
+   * Packets are read (but not decoded) from the current position, or from a seek straight to `target_ts` if it's
+   * behind or more than a few frames ahead, up to the last one at or before the target. Only that packet is decoded,
+   * so any frame costs one seek and one decode regardless of where it is in the file.
+   */
+  FramePtr RetrieveIntraFrame(int64_t target_ts);
+
+  /**
+   * @brief Create a Frame referencing the frame in frame_, downloading it to system memory if it's a hardware frame
+   */
+  FramePtr CopyFrame();
+
+  /**
+   * @brief Reference the frame in frame_ in a new AVFrame, downloading it to system memory if it's a hardware frame
+   *
+   * @return
+   *
+   * The new AVFrame (which must be freed with av_frame_free()) or nullptr on failure.
+   */
+  AVFrame* CloneFrame();
+
+  /**
+   * @brief (Re)create swr_ctx_ to convert this stream to planar float at `sample_rate`
+   *
+   * Also clears the audio cache since it was converted at the previous rate.
+   */
+  bool InitResampler(int sample_rate);
+
+  /**
+   * @brief Decode the next audio frame and append it to audio_cache_
+   *
+   * @return
+   *
+   * 0 on success, AVERROR_EOF if the end of the stream was reached (the resampler is flushed into the cache), or
+   * another negative FFmpeg error code.
+   */
+  int DecodeAudio();
+
+  /**
+   * @brief Convert audio samples through swr_ctx_ and append them to audio_cache_
+   *
+   * Set `in` to nullptr to flush the resampler.
+   */
+  int ResampleIntoCache(const uint8_t** in, int in_count);
+
+  /**
+   * @brief Clear audio_cache_
+   */
+  void ClearAudioCache();
+
+  /**
+   * @brief Sample index (at the output rate) just after the last sample in audio_cache_
+   */
+  int64_t AudioCacheEnd();
+
+  /**
+   * @brief Decode the next frame of this stream into frame_
+   *
+   * Handles the send/receive loop of the FFmpeg decoding API, reading as many packets as necessary to produce a
+   * complete frame.
+   *
+   * @return
+   *
+   * 0 on success, AVERROR_EOF if the end of the stream was reached, or another negative FFmpeg error code.
+   */
+  int GetFrame();
+
+  /**
+   * @brief Seek to the closest keyframe at or before `timestamp` and flush the decoder
+   */
+  void Seek(int64_t timestamp);
+
+  /**
+   * @brief Keep a reference to the frame in frame_ (at last_pts_) in frame_cache_
+   *
+   * The cache holds as many frames as the longest GOP in the stream (so stepping backwards through a GOP only decodes
+   * it once) unless that would exceed kFrameCacheBudget, in which case it holds as many as fit. The least recently
+   * used frame is freed to make room. Hardware frames aren't cached.
+   */
+  void CacheFrame();
+
+  /**
+   * @brief Add a frame to frame_cache_ at `ts`, taking ownership of it
+   *
+   * The least recently used frame is freed to make room. `frame` is freed instead if the cache can't hold any frames.
+   */
+  void InsertCachedFrame(int64_t ts, AVFrame* frame);
+
+  /**
+   * @brief Returns a Frame referencing the frame at `ts` in frame_cache_, or nullptr if it isn't cached
+   */
+  FramePtr RetrieveCachedFrame(int64_t ts);
+
+  /**
+   * @brief Work out frame_cache_capacity_ from the frame in frame_ if it hasn't been yet
+   */
+  void UpdateFrameCacheCapacity();
+
+  /**
+   * @brief Free every frame in frame_cache_
+   */
+  void ClearFrameCache();
+
+  /**
+   * @brief A decoded frame and its timestamp, see DecodeGop()
+   */
+  struct DecodedFrame {
+    int64_t timestamp;
+    AVFrame* frame;
+  };
+
+  /**
+   * @brief Decode the GOP starting at `keyframe` forward in one pass
+   *
+   * @param last_ts
+   *
+   * Timestamp of the last frame to decode, or AV_NOPTS_VALUE for the whole GOP.
+   *
+   * @param max_frames
+   *
+   * Only the last `max_frames` frames are kept, the ones before them are freed as soon as they're decoded.
+   *
+   * @param frames
+   *
+   * Filled with the decoded frames in presentation order, which the caller must free. Hardware frames are downloaded.
+   */
+  void DecodeGop(int64_t keyframe, int64_t last_ts, int max_frames, QVector<DecodedFrame>* frames);
+
+  /**
+   * @brief Reverse playback: put the GOP containing `target_ts` in frame_cache_ and start prefetching the one before
+   *
+   * The GOP is taken from the prefetch if it's there (waiting for it to finish if necessary), otherwise it's decoded
+   * on this thread.
+   *
+   * @return
+   *
+   * TRUE if the frame at `target_ts` is now in frame_cache_.
+   */
+  bool RetrieveGopBackward(int64_t target_ts);
+
+  /**
+   * @brief Start decoding the GOP before the one containing `ts` on prefetch_decoder_ in the background
+   *
+   * Does nothing if that GOP is already cached or being prefetched, or another prefetch is still running.
+   */
+  void StartPrefetch(int64_t ts);
+
+  /**
+   * @brief Wait for a running prefetch, then free the prefetched frames and prefetch_decoder_
+   */
+  void StopPrefetch();
+
+  /**
+   * @brief Record a video request at `target_ts`, entering or leaving reverse playback (see IsPlayingBackward())
+   */
+  void UpdateDirection(int64_t target_ts);
+
+  /**
+   * @brief Returns whether recent requests have been stepping backwards through the stream frame by frame
+   */
+  bool IsPlayingBackward();
+
+  /**
+   * @brief Timestamp of the keyframe at or before `ts` (the first keyframe if there's none)
+   */
+  int64_t GetKeyframeBefore(int64_t ts);
+
+  /**
+   * @brief Returns a packet's PTS, or its DTS if it doesn't have one
+   */
+  static int64_t GetPacketTimestamp(const AVPacket* pkt);
+
+  /**
+   * @brief Convert a rational timecode (in seconds) to a timestamp in this stream's timebase
+   */
+  int64_t GetTimestampFromTime(const rational& time);
+
+  /**
+   * @brief Find the timestamp of the frame that should be shown at `time` without decoding anything
+   *
+   * Frames are looked up in frame_index_ by their actual timestamps, so variable frame rate footage is conformed to
+   * whatever rate it's requested at without drifting. A frame that starts slightly after `time` (less than a quarter of
+   * a typical frame) is still used for it, so timestamp jitter doesn't make frames repeat and drop.
+   *
+   * For intra-only streams, this is just the timestamp to seek to.
+   */
+  int64_t GetFrameTimestamp(const rational& time);
+
+  /**
+   * @brief The median interval between frames in frame_index_, or one frame at the stream's guessed rate if unindexed
+   */
+  int64_t GetTypicalFrameDuration();
+
+  /**
+   * @brief Find the timestamp of the frame that should be shown at `ts`
+   *
+   * @return
+   *
+   * The largest timestamp in frame_index_ that is <= ts (or the first timestamp if ts is before the first frame).
+   * AV_NOPTS_VALUE if the index is empty.
+   */
+  int64_t GetClosestTimestampInIndex(const int64_t& ts);
+
+  /**
+   * @brief Determine whether a frame at `target_ts` can be reached by decoding forward from the current position
+   *
+   * Decoding forward is preferred as long as the target is ahead of the last decoded frame and no keyframe lies
+   * between them. If there is a keyframe in between, seeking to it is always cheaper than decoding the rest of the
+   * current GOP.
+   */
+  bool CanDecodeForwardTo(const int64_t& target_ts);
+
+  /**
+   * @brief demuxer_'s format context, packets must be read and seeked through demuxer_
+   */
   AVFormatContext* fmt_ctx_;
+
+  FFmpegDemuxerPtr demuxer_;
+
+  /**
+   * @brief Stream this decoder reads from demuxer_, -1 if demuxer_ isn't shared
+   */
+  int demuxer_stream_;
+
+  /**
+   * @brief demuxer_'s bytes_read() when it was acquired
+   */
+  qint64 demuxer_bytes_read_;
   AVCodecContext* codec_ctx_;
   AVStream* avstream_;
+
+  /**
+   * @brief avstream_'s timebase, converted once rather than on every seek
+   */
+  rational stream_timebase_;
+
   AVPacket* pkt_;
+
+  /**
+   * @brief The packet after the current frame of an intra-only stream, read but not decoded yet (empty if unknown)
+   */
+  AVPacket* next_pkt_;
   AVFrame* frame_;
   AVDictionary* opts_;
 
+  /**
+   * @brief Hardware device context (nullptr if decoding in software)
+   */
+  AVBufferRef* hw_device_ctx_;
+
+  /**
+   * @brief The pixel format hardware frames will be in (AV_PIX_FMT_NONE if decoding in software)
+   */
+  AVPixelFormat hw_pix_fmt_;
+
+  /**
+   * @brief Frame used to download hardware frames into system memory
+   */
+  AVFrame* sw_frame_;
+
+  /**
+   * @brief Buffer pool for frames the decoder allocates itself (see AllocatePooledFrame())
+   */
+  AVBufferPool* frame_pool_;
+
+  /**
+   * @brief Size of the buffers in frame_pool_
+   */
+  int frame_pool_size_;
+
+  bool hw_accel_enabled_;
+
+  /**
+   * @brief Number of open FFmpegDecoders decoding video, see ConfigureThreading()
+   */
+  static QAtomicInt open_video_decoders_;
+
+  /**
+   * @brief Set if this decoder is counted in open_video_decoders_
+   */
+  bool counted_as_open_;
+
+  /**
+   * @brief Resampler converting audio to planar float at audio_sample_rate_
+   */
+  SwrContext* swr_ctx_;
+
+  int audio_sample_rate_;
+
+  /**
+   * @brief Converts avstream_ timestamps to sample indices at audio_sample_rate_
+   */
+  TickRescaler ts_to_samples_;
+
+  int64_t audio_channel_layout_;
+
+  /**
+   * @brief Decoded and converted audio, one array per channel
+   */
+  QVector< QVector<float> > audio_cache_;
+
+  /**
+   * @brief Sample index (at audio_sample_rate_) of the first sample in audio_cache_, AV_NOPTS_VALUE if empty
+   */
+  int64_t audio_cache_start_;
+
+  /**
+   * @brief Set if audio_cache_ reaches the end of the stream
+   */
+  bool audio_eof_;
+
+  /**
+   * @brief Set if every frame of the stream is a keyframe, in which case the stream isn't indexed
+   */
+  bool intra_only_;
+
+  /**
+   * @brief Set once an intra-only stream has read its last packet (cleared by seeking)
+   */
+  bool intra_eof_;
+
+  /**
+   * @brief Sorted (presentation order) list of every frame timestamp in the stream
+   */
   QVector<int64_t> frame_index_;
 
+  /**
+   * @brief Sorted list of every keyframe timestamp in the stream
+   */
+  QVector<int64_t> keyframe_index_;
+
+  /**
+   * @brief Number of frames in the longest GOP of the stream, see GetMaxGopLength()
+   */
+  int max_gop_length_;
+
+  /**
+   * @brief Timestamp of the frame currently in frame_ or AV_NOPTS_VALUE if we just opened or seeked
+   */
+  int64_t last_pts_;
+
+  /**
+   * @brief Duration of the frame in frame_ (intra-only streams only, 0 if unknown)
+   */
+  int64_t last_duration_;
+
+  /**
+   * @brief How far after a requested time a frame may start and still be used for it, see GetFrameTimestamp()
+   */
+  int64_t frame_tolerance_;
+
+  struct CachedFrame {
+    AVFrame* frame;
+
+    // Higher is more recently used
+    qint64 last_access;
+  };
+
+  /**
+   * @brief Recently decoded frames by timestamp, see CacheFrame()
+   */
+  QMap<int64_t, CachedFrame> frame_cache_;
+
+  /**
+   * @brief Maximum number of frames in frame_cache_, -1 until it's been worked out from the first frame
+   */
+  int frame_cache_capacity_;
+
+  qint64 frame_cache_access_;
+
+  /**
+   * @brief Timestamp of the last video frame requested, AV_NOPTS_VALUE if none
+   */
+  int64_t last_request_ts_;
+
+  /**
+   * @brief Number of consecutive requests that stepped backwards, see IsPlayingBackward()
+   */
+  int backward_requests_;
+
+  class PrefetchRunnable;
+
+  /**
+   * @brief Second decoder of this stream (with a read position of its own) that prefetches GOPs in reverse playback
+   */
+  std::unique_ptr<FFmpegDecoder> prefetch_decoder_;
+
+  /**
+   * @brief Keyframe of the GOP being or last prefetched, AV_NOPTS_VALUE if none
+   */
+  int64_t prefetch_keyframe_;
+
+  /**
+   * @brief Frames prefetched from the GOP at prefetch_keyframe_
+   */
+  QVector<DecodedFrame> prefetch_frames_;
+
+  /**
+   * @brief Set while a PrefetchRunnable is decoding on prefetch_decoder_
+   */
+  bool prefetch_running_;
+
+  /**
+   * @brief Aborts prefetch_decoder_'s IO when the prefetch is stopped
+   */
+  QAtomicInt prefetch_cancel_;
+
+  QMutex prefetch_mutex_;
+
+  QWaitCondition prefetch_done_;
+
+  /**
+   * @brief Bytes read by format contexts that have already been closed (see bytes_read())
+   */
+  qint64 bytes_read_;
+
 };
 
 #endif // FFMPEGDECODER_H
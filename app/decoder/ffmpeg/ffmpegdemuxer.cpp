@@ -0,0 +1,434 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegdemuxer.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "decoder/ffmpeg/ffmpegpacketcache.h"
+
+// Bounds for fast stream analysis (bytes and microseconds respectively), see Open()
+const int64_t kFastProbeSize = 1024 * 1024;
+const int64_t kFastAnalyzeDuration = 500000;
+
+const qint64 FFmpegDemuxer::kMaxQueuedBytes = 64 * 1024 * 1024;
+
+QMutex FFmpegDemuxer::registry_mutex_;
+QHash< QString, QList< std::weak_ptr<FFmpegDemuxer> > > FFmpegDemuxer::registry_;
+
+FFmpegDemuxer::Consumer::Consumer() :
+  queued_bytes(0),
+  lost_position(false),
+  last_ts(AV_NOPTS_VALUE),
+  returned_ts(AV_NOPTS_VALUE),
+  seek_ts(AV_NOPTS_VALUE),
+  seek_flags(0),
+  cached_start(AV_NOPTS_VALUE)
+{
+}
+
+FFmpegDemuxer::FFmpegDemuxer() :
+  fmt_ctx_(nullptr),
+  sequential_(false),
+  at_start_(true),
+  cancel_token_(nullptr)
+{
+}
+
+FFmpegDemuxer::~FFmpegDemuxer()
+{
+  Close();
+}
+
+FFmpegDemuxerPtr FFmpegDemuxer::Acquire(const QString &filename, int stream_index, Analysis analysis,
+                                        const QAtomicInt *cancel_token, int *error_code)
+{
+  *error_code = 0;
+
+  QMutexLocker registry_locker(&registry_mutex_);
+
+  QList< std::weak_ptr<FFmpegDemuxer> >& list = registry_[filename];
+
+  for (int i=0;i<list.size();i++) {
+    FFmpegDemuxerPtr demuxer = list.at(i).lock();
+
+    if (demuxer == nullptr) {
+      // Every decoder using this one has closed
+      list.removeAt(i);
+      i--;
+      continue;
+    }
+
+    QMutexLocker locker(&demuxer->mutex_);
+
+    if (!demuxer->consumers_.contains(stream_index)) {
+      Consumer consumer;
+
+      // The file has been read already, so the new stream starts by seeking to the start
+      consumer.lost_position = !demuxer->at_start_;
+
+      demuxer->consumers_.insert(stream_index, consumer);
+
+      return demuxer;
+    }
+  }
+
+  registry_locker.unlock();
+
+  // Nothing else can see the new demuxer yet, so it can be opened without holding any locks
+  FFmpegDemuxerPtr demuxer = std::make_shared<FFmpegDemuxer>();
+
+  *error_code = demuxer->Open(filename, analysis, cancel_token);
+
+  if (*error_code < 0) {
+    return nullptr;
+  }
+
+  demuxer->consumers_.insert(stream_index, Consumer());
+
+  registry_locker.relock();
+
+  registry_[filename].append(demuxer);
+
+  return demuxer;
+}
+
+int FFmpegDemuxer::Open(const QString &filename, Analysis analysis, const QAtomicInt *cancel_token)
+{
+  QMutexLocker locker(&mutex_);
+
+  Close();
+
+  cancel_token_ = cancel_token;
+
+  // Packets cached from a file that's been modified since aren't used
+  cache_key_ = QStringLiteral("%1:%2").arg(QString::number(QFileInfo(filename).lastModified().toMSecsSinceEpoch()),
+                                           filename);
+
+  AVDictionary* format_opts = nullptr;
+
+  if (analysis != kAnalyzeFully) {
+    av_dict_set_int(&format_opts, "probesize", kFastProbeSize, 0);
+    av_dict_set_int(&format_opts, "analyzeduration", kFastAnalyzeDuration, 0);
+  }
+
+  // Set up the context ourselves so FFmpeg's blocking IO can be interrupted by cancelling
+  fmt_ctx_ = avformat_alloc_context();
+  fmt_ctx_->interrupt_callback.callback = InterruptCallback;
+  fmt_ctx_->interrupt_callback.opaque = this;
+
+  // Read remote files through a read-ahead cache and local files through a memory map. If neither can be set up,
+  // FFmpeg opens the file with its own IO.
+  if (FFmpegBufferedIO::IsRemote(filename)) {
+    if (buffered_io_.Open(filename)) {
+      fmt_ctx_->pb = buffered_io_.context();
+    }
+  } else if (mapped_io_.Open(filename)) {
+    fmt_ctx_->pb = mapped_io_.context();
+  }
+
+  // On failure, this frees fmt_ctx_ and sets it back to nullptr
+  int error_code = avformat_open_input(&fmt_ctx_, filename.toUtf8().constData(), nullptr, &format_opts);
+
+  av_dict_free(&format_opts);
+
+  // Streams found in the header already have the codec parameters they were probed with, the packets FFmpeg would
+  // read to analyze them are only needed if there could be streams the header doesn't mention
+  if (error_code == 0
+      && (analysis != kAnalyzeHeader || fmt_ctx_->nb_streams == 0 || (fmt_ctx_->ctx_flags & AVFMTCTX_NOHEADER))) {
+    error_code = avformat_find_stream_info(fmt_ctx_, nullptr);
+  }
+
+  cancel_token_ = nullptr;
+
+  if (error_code < 0) {
+    Close();
+    return error_code;
+  }
+
+  return 0;
+}
+
+void FFmpegDemuxer::Release(int stream_index)
+{
+  QMutexLocker locker(&mutex_);
+
+  QMap<int, Consumer>::iterator consumer = consumers_.find(stream_index);
+
+  if (consumer != consumers_.end()) {
+    ClearQueue(&consumer.value());
+    consumers_.erase(consumer);
+  }
+}
+
+AVFormatContext *FFmpegDemuxer::format_context() const
+{
+  return fmt_ctx_;
+}
+
+int FFmpegDemuxer::ReadPacket(int stream_index, AVPacket *pkt, const QAtomicInt *cancel_token)
+{
+  QMutexLocker locker(&mutex_);
+
+  Consumer& consumer = consumers_[stream_index];
+
+  // Packets read for this stream while others were reading
+  if (!consumer.queue.isEmpty()) {
+    AVPacket* queued = consumer.queue.takeFirst();
+
+    consumer.queued_bytes -= queued->size;
+
+    av_packet_move_ref(pkt, queued);
+    av_packet_free(&queued);
+
+    consumer.returned_ts = GetPacketDecodeTimestamp(pkt);
+    consumer.seek_ts = AV_NOPTS_VALUE;
+
+    return 0;
+  }
+
+  // Continue from the packet cache if it has the keyframe Seek() found or the packet after the last one returned
+  if (!sequential_) {
+    bool cached = false;
+
+    if (consumer.cached_start != AV_NOPTS_VALUE) {
+      cached = olive::packet_cache.Get(cache_key_, stream_index, consumer.cached_start, pkt);
+
+      // If it's been freed since, the file is seeked as usual below
+      consumer.cached_start = AV_NOPTS_VALUE;
+    } else if (consumer.returned_ts != AV_NOPTS_VALUE) {
+      cached = olive::packet_cache.GetNext(cache_key_, stream_index, consumer.returned_ts, pkt);
+    }
+
+    if (cached) {
+      // The file isn't read, so once the cached packets run out it has to be seeked to where they ended
+      consumer.lost_position = true;
+      consumer.last_ts = pkt->dts;
+      consumer.returned_ts = pkt->dts;
+      consumer.seek_ts = AV_NOPTS_VALUE;
+
+      return 0;
+    }
+  }
+
+  int64_t skip_until = AV_NOPTS_VALUE;
+
+  if (consumer.lost_position) {
+    skip_until = RestorePosition(stream_index);
+  }
+
+  at_start_ = false;
+  cancel_token_ = cancel_token;
+
+  int error_code;
+
+  forever {
+    error_code = av_read_frame(fmt_ctx_, pkt);
+
+    if (error_code < 0) {
+      break;
+    }
+
+    int64_t ts = GetPacketDecodeTimestamp(pkt);
+
+    if (pkt->stream_index == stream_index) {
+      // Skip packets this stream has already had before another stream seeked the file
+      if (skip_until != AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE && ts <= skip_until) {
+        av_packet_unref(pkt);
+        continue;
+      }
+
+      if (!sequential_) {
+        olive::packet_cache.Insert(cache_key_, stream_index, consumer.last_ts, pkt);
+      }
+
+      consumer.last_ts = ts;
+      consumer.returned_ts = ts;
+      consumer.seek_ts = AV_NOPTS_VALUE;
+      break;
+    }
+
+    QMap<int, Consumer>::iterator other = consumers_.find(pkt->stream_index);
+
+    // Queue packets for the other streams being read, unless they're elsewhere in the file anyway
+    if (other != consumers_.end() && !other->lost_position) {
+      if (other->queued_bytes + pkt->size > kMaxQueuedBytes) {
+        // This stream isn't being read, drop what it has queued rather than buffering the file in memory
+        ClearQueue(&other.value());
+        other->last_ts = other->returned_ts;
+        other->lost_position = true;
+      } else {
+        if (!sequential_) {
+          olive::packet_cache.Insert(cache_key_, pkt->stream_index, other->last_ts, pkt);
+        }
+
+        AVPacket* queued = av_packet_alloc();
+
+        if (queued != nullptr) {
+          av_packet_move_ref(queued, pkt);
+
+          other->queue.append(queued);
+          other->queued_bytes += queued->size;
+          other->last_ts = ts;
+        }
+      }
+    }
+
+    av_packet_unref(pkt);
+  }
+
+  cancel_token_ = nullptr;
+
+  return error_code;
+}
+
+int FFmpegDemuxer::Seek(int stream_index, int64_t timestamp, int flags)
+{
+  QMutexLocker locker(&mutex_);
+
+  Consumer& consumer = consumers_[stream_index];
+
+  ClearQueue(&consumer);
+  consumer.last_ts = AV_NOPTS_VALUE;
+  consumer.returned_ts = AV_NOPTS_VALUE;
+  consumer.seek_ts = timestamp;
+  consumer.seek_flags = flags;
+  consumer.cached_start = AV_NOPTS_VALUE;
+
+  // If the keyframe is cached, start from there without moving the file
+  if (!sequential_ && (flags & AVSEEK_FLAG_BACKWARD)) {
+    consumer.cached_start = olive::packet_cache.FindKeyframe(cache_key_, stream_index, timestamp);
+
+    if (consumer.cached_start != AV_NOPTS_VALUE) {
+      consumer.lost_position = true;
+      return 0;
+    }
+  }
+
+  consumer.lost_position = false;
+
+  InvalidateOthers(stream_index);
+
+  at_start_ = false;
+
+  return av_seek_frame(fmt_ctx_, stream_index, timestamp, flags);
+}
+
+void FFmpegDemuxer::SetSequential(bool e)
+{
+  QMutexLocker locker(&mutex_);
+
+  sequential_ = e;
+
+  mapped_io_.SetSequential(e);
+}
+
+qint64 FFmpegDemuxer::bytes_read()
+{
+  QMutexLocker locker(&mutex_);
+
+  if (fmt_ctx_ != nullptr && fmt_ctx_->pb != nullptr) {
+    return fmt_ctx_->pb->bytes_read;
+  }
+
+  return 0;
+}
+
+int FFmpegDemuxer::InterruptCallback(void *opaque)
+{
+  // Only called from within Open(), ReadPacket() and Seek() so cancel_token_ is safe to read
+  const QAtomicInt* token = static_cast<FFmpegDemuxer*>(opaque)->cancel_token_;
+
+  return (token != nullptr && token->load() != 0) ? 1 : 0;
+}
+
+int64_t FFmpegDemuxer::GetPacketDecodeTimestamp(const AVPacket *pkt)
+{
+  // Unlike PTS, DTS always increases through a stream so it tells whether a packet comes before or after another
+  return (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+}
+
+int64_t FFmpegDemuxer::RestorePosition(int stream_index)
+{
+  Consumer& consumer = consumers_[stream_index];
+
+  consumer.lost_position = false;
+
+  InvalidateOthers(stream_index);
+
+  if (consumer.last_ts != AV_NOPTS_VALUE) {
+    // Go back to the last packet this stream had, the ones up to and including it are skipped by ReadPacket()
+    av_seek_frame(fmt_ctx_, stream_index, consumer.last_ts, AVSEEK_FLAG_BACKWARD);
+    return consumer.last_ts;
+  }
+
+  if (consumer.seek_ts != AV_NOPTS_VALUE) {
+    // Redo the stream's last seek
+    av_seek_frame(fmt_ctx_, stream_index, consumer.seek_ts, consumer.seek_flags);
+  } else {
+    // Nothing read yet, start from the beginning
+    AVStream* stream = fmt_ctx_->streams[stream_index];
+
+    av_seek_frame(fmt_ctx_,
+                  stream_index,
+                  (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0,
+                  AVSEEK_FLAG_BACKWARD);
+  }
+
+  return AV_NOPTS_VALUE;
+}
+
+void FFmpegDemuxer::InvalidateOthers(int stream_index)
+{
+  for (QMap<int, Consumer>::iterator i=consumers_.begin();i!=consumers_.end();i++) {
+    // Queued packets are still the next ones the stream needs, it only has to seek once they've been used up
+    if (i.key() != stream_index) {
+      i->lost_position = true;
+    }
+  }
+}
+
+void FFmpegDemuxer::ClearQueue(Consumer *consumer)
+{
+  foreach (AVPacket* pkt, consumer->queue) {
+    av_packet_free(&pkt);
+  }
+
+  consumer->queue.clear();
+  consumer->queued_bytes = 0;
+}
+
+void FFmpegDemuxer::Close()
+{
+  for (QMap<int, Consumer>::iterator i=consumers_.begin();i!=consumers_.end();i++) {
+    ClearQueue(&i.value());
+  }
+
+  if (fmt_ctx_ != nullptr) {
+    avformat_close_input(&fmt_ctx_);
+    fmt_ctx_ = nullptr;
+  }
+
+  // Only safe once the format context no longer references the AVIOContext
+  mapped_io_.Close();
+  buffered_io_.Close();
+}
@@ -0,0 +1,254 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGDEMUXER_H
+#define FFMPEGDEMUXER_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <memory>
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include "decoder/ffmpeg/ffmpegbufferedio.h"
+#include "decoder/ffmpeg/ffmpegmappedio.h"
+
+class FFmpegDemuxer;
+using FFmpegDemuxerPtr = std::shared_ptr<FFmpegDemuxer>;
+
+/**
+ * @brief An open media file (AVFormatContext) whose packets can be shared by decoders of its different streams
+ *
+ * Decoders for the video and audio of the same file would otherwise each open the container and read through it,
+ * reading every packet twice and seeking twice as often, which is exactly what's slow on spinning disks and network
+ * storage. Instead, each FFmpegDecoder gets the demuxer for its file from Acquire() and reads its stream's packets
+ * through ReadPacket(). Every packet is read from the file once: packets for the stream being read are returned and
+ * packets for the other decoders' streams are queued for them.
+ *
+ * Since there's only one read position, a decoder that seeks moves every other decoder of the file too. They're
+ * marked as having lost their position and, once they've used up their queued packets, their next read seeks back to
+ * the last packet they were given and skips what they've already seen. Decoders reading the same part of the file
+ * (e.g. during playback) never need to do this, decoders far apart in the file cost a seek each time they take turns.
+ * The same happens if a decoder falls so far behind that its queue has to be dropped (see kMaxQueuedBytes).
+ *
+ * Packets read are also added to olive::packet_cache. Seeking to a keyframe that's cached, and reading packets that
+ * follow on from cached ones, doesn't touch the file at all (or move the other decoders).
+ *
+ * All functions are thread-safe.
+ */
+class FFmpegDemuxer
+{
+public:
+  /**
+   * @brief How much of a file Open() analyzes to fill in the codec parameters of its streams
+   */
+  enum Analysis {
+    /// Let FFmpeg analyze as much of the file as it needs
+    kAnalyzeFully,
+
+    /// Analysis is bounded (see kFastProbeSize and kFastAnalyzeDuration) so it's quick even for files without complete
+    /// headers
+    kAnalyzeFast,
+
+    /// Only read the container's header, for decoders that already have their stream's codec parameters from probing.
+    /// Containers that don't declare every stream in their header (e.g. MPEG-TS) are analyzed as with kAnalyzeFast.
+    kAnalyzeHeader
+  };
+
+  FFmpegDemuxer();
+
+  /**
+   * @brief Destructor, closes the file
+   */
+  ~FFmpegDemuxer();
+
+  FFmpegDemuxer(const FFmpegDemuxer& other) = delete;
+  FFmpegDemuxer(FFmpegDemuxer&& other) = delete;
+  FFmpegDemuxer& operator=(const FFmpegDemuxer& other) = delete;
+  FFmpegDemuxer& operator=(FFmpegDemuxer&& other) = delete;
+
+  /**
+   * @brief Returns a demuxer for `filename` that no other decoder reads `stream_index` from, opening one if necessary
+   *
+   * Decoders of the same stream (e.g. several DecoderPool instances decoding different frames) need their own read
+   * positions, so they never share a demuxer. Release() the stream once it's no longer being read.
+   *
+   * @param error_code
+   *
+   * Set to 0 on success or the FFmpeg error code Open() failed with, in which case nullptr is returned.
+   */
+  static FFmpegDemuxerPtr Acquire(const QString& filename, int stream_index, Analysis analysis,
+                                  const QAtomicInt* cancel_token, int* error_code);
+
+  /**
+   * @brief Open `filename` and read its stream information
+   *
+   * Files on network storage are read through FFmpegBufferedIO and local files through FFmpegMappedIO rather than
+   * FFmpeg's own file IO.
+   *
+   * @param analysis
+   *
+   * How much of the file to analyze, see Analysis.
+   *
+   * @param cancel_token
+   *
+   * Blocking IO is aborted once this becomes non-zero (may be nullptr).
+   *
+   * @return
+   *
+   * 0 on success or a negative FFmpeg error code.
+   */
+  int Open(const QString& filename, Analysis analysis, const QAtomicInt* cancel_token);
+
+  /**
+   * @brief Stop queueing packets for a stream acquired with Acquire() and free the ones that are queued
+   */
+  void Release(int stream_index);
+
+  /**
+   * @brief The open format context (nullptr if not open)
+   *
+   * Only read its metadata (e.g. streams), reading packets or seeking must go through ReadPacket() and Seek().
+   */
+  AVFormatContext* format_context() const;
+
+  /**
+   * @brief Read the next packet of a stream into `pkt`
+   *
+   * @return
+   *
+   * 0 on success, AVERROR_EOF if the end of the file was reached, or another negative FFmpeg error code.
+   */
+  int ReadPacket(int stream_index, AVPacket* pkt, const QAtomicInt* cancel_token);
+
+  /**
+   * @brief Seek a stream (and with it the file) with av_seek_frame()
+   *
+   * Backward seeks to a keyframe that's in the packet cache only move this stream, the file isn't seeked until it
+   * reads past what's cached.
+   */
+  int Seek(int stream_index, int64_t timestamp, int flags);
+
+  /**
+   * @brief Hint that a stream is about to be read through from start to end once (e.g. for indexing)
+   *
+   * Packets read until this is reset aren't added to the packet cache, since they'd only push out packets that are
+   * actually being reused.
+   */
+  void SetSequential(bool e);
+
+  /**
+   * @brief Bytes read from the file so far
+   */
+  qint64 bytes_read();
+
+  /**
+   * @brief Most bytes of packets queued for one stream before they're dropped (and the stream has to seek back)
+   */
+  static const qint64 kMaxQueuedBytes;
+
+private:
+  struct Consumer {
+    Consumer();
+
+    // Packets read for this stream while others were reading, in file order
+    QList<AVPacket*> queue;
+
+    qint64 queued_bytes;
+
+    // Set if the file has been seeked since this stream last read (or queued) a packet
+    bool lost_position;
+
+    // Decode timestamp of the last packet returned from ReadPacket() or queued
+    int64_t last_ts;
+
+    // Decode timestamp of the last packet returned from ReadPacket()
+    int64_t returned_ts;
+
+    // Last Seek() if nothing has been returned from ReadPacket() since, AV_NOPTS_VALUE if none
+    int64_t seek_ts;
+
+    int seek_flags;
+
+    // Decode timestamp of a keyframe in the packet cache that a Seek() found, read next
+    int64_t cached_start;
+  };
+
+  static int InterruptCallback(void* opaque);
+
+  /**
+   * @brief Returns a packet's DTS, or its PTS if it doesn't have one
+   */
+  static int64_t GetPacketDecodeTimestamp(const AVPacket* pkt);
+
+  /**
+   * @brief Seek the file back to where a stream that lost its position left off (mutex_ must be locked)
+   *
+   * @return
+   *
+   * Decode timestamp packets of this stream must be after to be new to it (AV_NOPTS_VALUE if none need skipping).
+   */
+  int64_t RestorePosition(int stream_index);
+
+  /**
+   * @brief Mark every stream except `stream_index` as having lost its position (mutex_ must be locked)
+   */
+  void InvalidateOthers(int stream_index);
+
+  void ClearQueue(Consumer* consumer);
+
+  void Close();
+
+  AVFormatContext* fmt_ctx_;
+
+  FFmpegMappedIO mapped_io_;
+
+  FFmpegBufferedIO buffered_io_;
+
+  // Identifies the file's contents in the packet cache
+  QString cache_key_;
+
+  // Set while the file is being read through once, packets aren't cached then
+  bool sequential_;
+
+  // Streams being read, by index
+  QMap<int, Consumer> consumers_;
+
+  // Set until the file is first read or seeked, streams added until then don't need to seek to the start
+  bool at_start_;
+
+  // Cancel token of the operation in progress, for InterruptCallback()
+  const QAtomicInt* cancel_token_;
+
+  QMutex mutex_;
+
+  static QMutex registry_mutex_;
+
+  // Open demuxers by filename
+  static QHash< QString, QList< std::weak_ptr<FFmpegDemuxer> > > registry_;
+};
+
+#endif // FFMPEGDEMUXER_H
@@ -0,0 +1,227 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegmappedio.h"
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+#include <QFileInfo>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Size of the buffer FFmpeg reads into, larger than FFmpeg's default since filling it is just a memcpy
+const int kIOBufferSize = 256 * 1024;
+
+// Amount of the file (in bytes) the kernel is asked to read ahead of the read position
+const qint64 kPrefetchWindow = 8 * 1024 * 1024;
+
+FFmpegMappedIO::FFmpegMappedIO() :
+  map_(nullptr),
+  size_(0),
+  pos_(0),
+  last_read_end_(0),
+  prefetched_end_(0),
+  avio_ctx_(nullptr)
+{
+}
+
+FFmpegMappedIO::~FFmpegMappedIO()
+{
+  Close();
+}
+
+bool FFmpegMappedIO::Open(const QString &filename)
+{
+  Close();
+
+  if (!QFileInfo(filename).isFile()) {
+    return false;
+  }
+
+  file_.setFileName(filename);
+
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  size_ = file_.size();
+
+  // Empty files can't be mapped
+  if (size_ > 0) {
+    map_ = file_.map(0, size_);
+  }
+
+  if (map_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  uint8_t* buffer = static_cast<uint8_t*>(av_malloc(kIOBufferSize));
+
+  if (buffer == nullptr) {
+    Close();
+    return false;
+  }
+
+  avio_ctx_ = avio_alloc_context(buffer, kIOBufferSize, 0, this, ReadPacket, nullptr, SeekPacket);
+
+  if (avio_ctx_ == nullptr) {
+    av_free(buffer);
+    Close();
+    return false;
+  }
+
+  // Containers mostly keep their headers at the start of the file, get those (and the first packets) in early
+  Prefetch(0);
+
+  return true;
+}
+
+void FFmpegMappedIO::Close()
+{
+  if (avio_ctx_ != nullptr) {
+    // FFmpeg may have replaced the buffer we allocated, so free whichever one the context holds now
+    av_freep(&avio_ctx_->buffer);
+    avio_context_free(&avio_ctx_);
+    avio_ctx_ = nullptr;
+  }
+
+  if (map_ != nullptr) {
+    file_.unmap(map_);
+    map_ = nullptr;
+  }
+
+  file_.close();
+
+  size_ = 0;
+  pos_ = 0;
+  last_read_end_ = 0;
+  prefetched_end_ = 0;
+}
+
+AVIOContext *FFmpegMappedIO::context() const
+{
+  return avio_ctx_;
+}
+
+void FFmpegMappedIO::SetSequential(bool e)
+{
+  if (map_ == nullptr) {
+    return;
+  }
+
+#if defined(Q_OS_UNIX)
+  madvise(map_, static_cast<size_t>(size_), e ? MADV_SEQUENTIAL : MADV_NORMAL);
+#endif
+
+#if defined(Q_OS_LINUX)
+  posix_fadvise(file_.handle(), 0, 0, e ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL);
+#endif
+}
+
+int FFmpegMappedIO::ReadPacket(void *opaque, uint8_t *buf, int buf_size)
+{
+  FFmpegMappedIO* io = static_cast<FFmpegMappedIO*>(opaque);
+
+  if (io->pos_ >= io->size_) {
+    return AVERROR_EOF;
+  }
+
+  int read_size = static_cast<int>(qMin(static_cast<qint64>(buf_size), io->size_ - io->pos_));
+
+  // Start a new window wherever FFmpeg seeked to, and keep the kernel a window ahead of contiguous reads
+  if (io->pos_ != io->last_read_end_) {
+    io->Prefetch(io->pos_);
+  } else if (io->pos_ + kPrefetchWindow / 2 > io->prefetched_end_) {
+    io->Prefetch(qMax(io->pos_, io->prefetched_end_));
+  }
+
+  memcpy(buf, io->map_ + io->pos_, static_cast<size_t>(read_size));
+
+  io->pos_ += read_size;
+  io->last_read_end_ = io->pos_;
+
+  return read_size;
+}
+
+int64_t FFmpegMappedIO::SeekPacket(void *opaque, int64_t offset, int whence)
+{
+  FFmpegMappedIO* io = static_cast<FFmpegMappedIO*>(opaque);
+
+  // Make sure FFmpeg knows the file size so it doesn't have to seek to the end to find it
+  if (whence & AVSEEK_SIZE) {
+    return io->size_;
+  }
+
+  int64_t new_pos;
+
+  switch (whence & ~AVSEEK_FORCE) {
+  case SEEK_SET:
+    new_pos = offset;
+    break;
+  case SEEK_CUR:
+    new_pos = io->pos_ + offset;
+    break;
+  case SEEK_END:
+    new_pos = io->size_ + offset;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  if (new_pos < 0) {
+    return AVERROR(EINVAL);
+  }
+
+  // Seeking past the end is valid, reads will just return EOF
+  io->pos_ = new_pos;
+
+  return new_pos;
+}
+
+void FFmpegMappedIO::Prefetch(qint64 offset)
+{
+  qint64 end = qMin(offset + kPrefetchWindow, size_);
+
+  prefetched_end_ = end;
+
+  if (offset >= end) {
+    return;
+  }
+
+#if defined(Q_OS_UNIX)
+  // madvise() needs a page-aligned address, the map itself is page-aligned since it starts at offset 0
+  static const qint64 page_size = sysconf(_SC_PAGESIZE);
+  qint64 aligned_offset = offset - (offset % page_size);
+
+  madvise(map_ + aligned_offset, static_cast<size_t>(end - aligned_offset), MADV_WILLNEED);
+#endif
+
+#if defined(Q_OS_LINUX)
+  posix_fadvise(file_.handle(), offset, end - offset, POSIX_FADV_WILLNEED);
+#endif
+}
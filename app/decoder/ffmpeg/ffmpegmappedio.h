@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGMAPPEDIO_H
+#define FFMPEGMAPPEDIO_H
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+#include <QFile>
+
+/**
+ * @brief Custom AVIOContext that reads a local file through a memory map
+ *
+ * Packets are copied straight out of the mapped file into FFmpeg's IO buffer, so reading doesn't cost a read()
+ * syscall (and the kernel->user copy that goes with it) per buffer fill. Since the pages belong to the OS page cache,
+ * several decoders of the same file (e.g. DecoderPool instances or render threads) share one copy of it in memory.
+ *
+ * The kernel is given read-ahead hints based on how the file is being accessed. Contiguous reads prefetch a window
+ * ahead of the read position and reads that jump (i.e. FFmpeg seeked) prefetch a window at the new position.
+ * SetSequential() can be used for operations that read the entire file once (e.g. indexing).
+ *
+ * The file must not be truncated while it's mapped.
+ */
+class FFmpegMappedIO
+{
+public:
+  FFmpegMappedIO();
+
+  /**
+   * @brief Destructor, unmaps the file and frees the AVIOContext
+   */
+  ~FFmpegMappedIO();
+
+  FFmpegMappedIO(const FFmpegMappedIO& other) = delete;
+  FFmpegMappedIO(FFmpegMappedIO&& other) = delete;
+  FFmpegMappedIO& operator=(const FFmpegMappedIO& other) = delete;
+  FFmpegMappedIO& operator=(FFmpegMappedIO&& other) = delete;
+
+  /**
+   * @brief Map `filename` and create an AVIOContext reading from it
+   *
+   * @return
+   *
+   * FALSE if the file isn't a local file or couldn't be mapped (e.g. it's empty or too large for the address space),
+   * in which case the caller should let FFmpeg open the file itself.
+   */
+  bool Open(const QString& filename);
+
+  /**
+   * @brief Unmap the file and free the AVIOContext
+   *
+   * Must only be called after the AVFormatContext using context() has been closed.
+   */
+  void Close();
+
+  /**
+   * @brief The AVIOContext to set as AVFormatContext::pb (nullptr if not open)
+   */
+  AVIOContext* context() const;
+
+  /**
+   * @brief Hint that the file is about to be read through from start to end once
+   *
+   * Lets the kernel read ahead aggressively and drop pages sooner once they've been read. Reset to FALSE once done.
+   */
+  void SetSequential(bool e);
+
+private:
+  static int ReadPacket(void* opaque, uint8_t* buf, int buf_size);
+
+  static int64_t SeekPacket(void* opaque, int64_t offset, int whence);
+
+  /**
+   * @brief Ask the kernel to start reading kPrefetchWindow bytes of the file at `offset` into the page cache
+   */
+  void Prefetch(qint64 offset);
+
+  QFile file_;
+
+  uchar* map_;
+
+  qint64 size_;
+
+  qint64 pos_;
+
+  /**
+   * @brief File offset the last read ended at, a read starting anywhere else means FFmpeg seeked
+   */
+  qint64 last_read_end_;
+
+  /**
+   * @brief End of the most recently prefetched window
+   */
+  qint64 prefetched_end_;
+
+  AVIOContext* avio_ctx_;
+
+};
+
+#endif // FFMPEGMAPPEDIO_H
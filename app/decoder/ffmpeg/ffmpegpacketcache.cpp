@@ -0,0 +1,318 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegpacketcache.h"
+
+#include <QMutexLocker>
+
+// Default budget
+const qint64 kDefaultPacketCacheBudget = Q_INT64_C(1024) * 1024 * 1024;
+
+FFmpegPacketCache olive::packet_cache;
+
+FFmpegPacketCache::FFmpegPacketCache() :
+  lru_head_(nullptr),
+  lru_tail_(nullptr),
+  budget_(kDefaultPacketCacheBudget),
+  used_bytes_(0),
+  hits_(0),
+  misses_(0)
+{
+}
+
+FFmpegPacketCache::~FFmpegPacketCache()
+{
+  Clear();
+}
+
+void FFmpegPacketCache::Insert(const QString &file, int stream_index, int64_t previous_dts, const AVPacket *pkt)
+{
+  if (pkt->dts == AV_NOPTS_VALUE) {
+    return;
+  }
+
+  qint64 size = EntrySize(pkt);
+  StreamKey key(file, stream_index);
+
+  QMutexLocker locker(&mutex_);
+
+  if (size > budget_) {
+    return;
+  }
+
+  QMap<int64_t, Entry*>::iterator existing;
+
+  if (streams_.contains(key) && streams_[key].contains(pkt->dts)) {
+    existing = streams_[key].find(pkt->dts);
+
+    Touch(existing.value());
+  } else {
+    FreeForIncoming(size);
+
+    AVPacket* copy = av_packet_clone(pkt);
+
+    if (copy == nullptr) {
+      return;
+    }
+
+    Entry* e = new Entry();
+    e->pkt = copy;
+    e->continues = false;
+    e->file = file;
+    e->stream_index = stream_index;
+    e->lru_prev = nullptr;
+    e->lru_next = nullptr;
+
+    QMap<int64_t, Entry*>& map = streams_[key];
+
+    existing = map.insert(pkt->dts, e);
+    LRUAppend(e);
+    used_bytes_ += size;
+    stream_bytes_[key] += size;
+
+    // Whatever was cached as following the entry before this one no longer does
+    if (existing != map.begin()) {
+      (existing - 1).value()->continues = false;
+    }
+  }
+
+  // Link this packet to the one before it, now that both are known to be consecutive
+  if (previous_dts != AV_NOPTS_VALUE && existing != streams_[key].begin()) {
+    QMap<int64_t, Entry*>::iterator previous = existing - 1;
+
+    if (previous.key() == previous_dts) {
+      previous.value()->continues = true;
+    }
+  }
+}
+
+bool FFmpegPacketCache::GetNext(const QString &file, int stream_index, int64_t dts, AVPacket *pkt)
+{
+  QMutexLocker locker(&mutex_);
+
+  QHash< StreamKey, QMap<int64_t, Entry*> >::iterator map = streams_.find(StreamKey(file, stream_index));
+
+  if (map == streams_.end()) {
+    misses_++;
+    return false;
+  }
+
+  QMap<int64_t, Entry*>::iterator current = map->find(dts);
+
+  if (current == map->end() || !current.value()->continues) {
+    misses_++;
+    return false;
+  }
+
+  Entry* next = (current + 1).value();
+
+  Touch(next);
+  hits_++;
+
+  return av_packet_ref(pkt, next->pkt) >= 0;
+}
+
+int64_t FFmpegPacketCache::FindKeyframe(const QString &file, int stream_index, int64_t timestamp)
+{
+  QMutexLocker locker(&mutex_);
+
+  QHash< StreamKey, QMap<int64_t, Entry*> >::iterator map = streams_.find(StreamKey(file, stream_index));
+
+  if (map == streams_.end()) {
+    return AV_NOPTS_VALUE;
+  }
+
+  // A packet can't be decoded after it's presented, so any packet presented at or before the timestamp is here or
+  // before it
+  QMap<int64_t, Entry*>::iterator i = map->upperBound(timestamp);
+
+  while (i != map->begin()) {
+    i--;
+
+    const AVPacket* p = i.value()->pkt;
+
+    if ((p->flags & AV_PKT_FLAG_KEY) && (p->pts == AV_NOPTS_VALUE || p->pts <= timestamp)) {
+      return i.key();
+    }
+  }
+
+  return AV_NOPTS_VALUE;
+}
+
+bool FFmpegPacketCache::Get(const QString &file, int stream_index, int64_t dts, AVPacket *pkt)
+{
+  QMutexLocker locker(&mutex_);
+
+  QHash< StreamKey, QMap<int64_t, Entry*> >::iterator map = streams_.find(StreamKey(file, stream_index));
+
+  if (map == streams_.end()) {
+    misses_++;
+    return false;
+  }
+
+  QMap<int64_t, Entry*>::iterator e = map->find(dts);
+
+  if (e == map->end()) {
+    misses_++;
+    return false;
+  }
+
+  Touch(e.value());
+  hits_++;
+
+  return av_packet_ref(pkt, e.value()->pkt) >= 0;
+}
+
+void FFmpegPacketCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  while (lru_head_ != nullptr) {
+    RemoveEntry(lru_head_);
+  }
+}
+
+qint64 FFmpegPacketCache::budget()
+{
+  QMutexLocker locker(&mutex_);
+
+  return budget_;
+}
+
+void FFmpegPacketCache::set_budget(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  budget_ = bytes;
+
+  FreeForIncoming(0);
+}
+
+qint64 FFmpegPacketCache::used_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return used_bytes_;
+}
+
+CacheStatistics FFmpegPacketCache::statistics()
+{
+  QMutexLocker locker(&mutex_);
+
+  CacheStatistics s;
+
+  s.used_bytes = used_bytes_;
+  s.budget = budget_;
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QHash< StreamKey, QMap<int64_t, Entry*> >::const_iterator map;
+
+  for (map=streams_.constBegin();map!=streams_.constEnd();map++) {
+    const QString& file = map.key().first;
+
+    s.entries += map->size();
+    s.AddConsumer(file.mid(file.indexOf(':') + 1), stream_bytes_.value(map.key()), map->size());
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+void FFmpegPacketCache::Touch(Entry *e)
+{
+  LRURemove(e);
+  LRUAppend(e);
+}
+
+void FFmpegPacketCache::LRURemove(Entry *e)
+{
+  if (e->lru_prev != nullptr) {
+    e->lru_prev->lru_next = e->lru_next;
+  } else {
+    lru_head_ = e->lru_next;
+  }
+
+  if (e->lru_next != nullptr) {
+    e->lru_next->lru_prev = e->lru_prev;
+  } else {
+    lru_tail_ = e->lru_prev;
+  }
+
+  e->lru_prev = nullptr;
+  e->lru_next = nullptr;
+}
+
+void FFmpegPacketCache::LRUAppend(Entry *e)
+{
+  e->lru_prev = lru_tail_;
+  e->lru_next = nullptr;
+
+  if (lru_tail_ != nullptr) {
+    lru_tail_->lru_next = e;
+  } else {
+    lru_head_ = e;
+  }
+
+  lru_tail_ = e;
+}
+
+void FFmpegPacketCache::FreeForIncoming(qint64 incoming)
+{
+  while (used_bytes_ + incoming > budget_ && lru_head_ != nullptr) {
+    RemoveEntry(lru_head_);
+  }
+}
+
+void FFmpegPacketCache::RemoveEntry(Entry *e)
+{
+  QHash< StreamKey, QMap<int64_t, Entry*> >::iterator map = streams_.find(StreamKey(e->file, e->stream_index));
+
+  QMap<int64_t, Entry*>::iterator it = map->find(e->pkt->dts);
+
+  // The packet before this one no longer continues into a cached packet
+  if (it != map->begin()) {
+    (it - 1).value()->continues = false;
+  }
+
+  map->erase(it);
+
+  qint64 size = EntrySize(e->pkt);
+
+  if (map->isEmpty()) {
+    stream_bytes_.remove(map.key());
+    streams_.erase(map);
+  } else {
+    stream_bytes_[map.key()] -= size;
+  }
+
+  LRURemove(e);
+
+  used_bytes_ -= size;
+
+  av_packet_free(&e->pkt);
+  delete e;
+}
+
+qint64 FFmpegPacketCache::EntrySize(const AVPacket *pkt)
+{
+  return static_cast<qint64>(sizeof(Entry)) + static_cast<qint64>(sizeof(AVPacket)) + pkt->size;
+}
@@ -0,0 +1,195 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGPACKETCACHE_H
+#define FFMPEGPACKETCACHE_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+
+#include "common/cachestatistics.h"
+
+/**
+ * @brief A RAM cache of the compressed packets recently read from media files
+ *
+ * Compressed packets are a small fraction of the size of the frames they decode to, so for the same amount of memory
+ * far more of a timeline can be kept hot as packets than as decoded frames. FFmpegDemuxer adds the packets it reads
+ * and serves runs of cached packets to decoders without touching the file, so re-decoding a recently used range (e.g.
+ * looping playback, scrubbing back over a clip, or a second decoder of the same clip) costs no disk or network IO.
+ *
+ * Packets are stored per file and stream by decode timestamp, along with whether the packet that follows each one in
+ * the stream is cached too. A run of consecutive packets can only be served from its first keyframe, since that's
+ * where a decoder has to start. Packets are reference counted, so caching one doesn't copy it. Once the cache exceeds
+ * its budget the least recently used packets are freed.
+ *
+ * All functions are thread-safe.
+ */
+class FFmpegPacketCache
+{
+public:
+  FFmpegPacketCache();
+
+  /**
+   * @brief Destructor, frees all packets
+   */
+  ~FFmpegPacketCache();
+
+  FFmpegPacketCache(const FFmpegPacketCache& other) = delete;
+  FFmpegPacketCache(FFmpegPacketCache&& other) = delete;
+  FFmpegPacketCache& operator=(const FFmpegPacketCache& other) = delete;
+  FFmpegPacketCache& operator=(FFmpegPacketCache&& other) = delete;
+
+  /**
+   * @brief Cache a packet read from a file
+   *
+   * @param file
+   *
+   * Identity of the file's contents (e.g. its path and modification time).
+   *
+   * @param previous_dts
+   *
+   * Decode timestamp of the packet read from this stream just before this one, or AV_NOPTS_VALUE if that's not known
+   * (e.g. this is the first packet after a seek). Packets without a decode timestamp aren't cached.
+   */
+  void Insert(const QString& file, int stream_index, int64_t previous_dts, const AVPacket* pkt);
+
+  /**
+   * @brief Reference the packet that follows the packet at `dts` into `pkt`
+   *
+   * @return
+   *
+   * TRUE if the next packet is cached.
+   */
+  bool GetNext(const QString& file, int stream_index, int64_t dts, AVPacket* pkt);
+
+  /**
+   * @brief Find the keyframe a decoder would start from to decode `timestamp`, like av_seek_frame(AVSEEK_FLAG_BACKWARD)
+   *
+   * @return
+   *
+   * Decode timestamp of the last cached keyframe presented at or before `timestamp`, or AV_NOPTS_VALUE if there isn't
+   * one. Fetch it with Get().
+   */
+  int64_t FindKeyframe(const QString& file, int stream_index, int64_t timestamp);
+
+  /**
+   * @brief Reference the packet at `dts` into `pkt`
+   *
+   * @return
+   *
+   * TRUE if the packet is cached.
+   */
+  bool Get(const QString& file, int stream_index, int64_t dts, AVPacket* pkt);
+
+  /**
+   * @brief Free every packet
+   */
+  void Clear();
+
+  qint64 budget();
+
+  /**
+   * @brief Set the maximum number of bytes cached packets may use (defaults to 1 GiB), 0 disables the cache
+   */
+  void set_budget(qint64 bytes);
+
+  qint64 used_bytes();
+
+  /**
+   * @brief Cached packets by file, and how many packets were served from the cache (hits) or not (misses)
+   *
+   * Consumers are named after the part of the file identity after the first colon (the path for FFmpegDemuxer).
+   */
+  CacheStatistics statistics();
+
+private:
+  struct Entry {
+    AVPacket* pkt;
+
+    // Set if the packet after this one in the stream is the next entry in its map
+    bool continues;
+
+    QString file;
+
+    int stream_index;
+
+    // Neighbors in the LRU list (head is least recently used)
+    Entry* lru_prev;
+    Entry* lru_next;
+  };
+
+  using StreamKey = QPair<QString, int>;
+
+  /**
+   * @brief Move an entry to the most recently used end of the LRU list (mutex_ must be locked)
+   */
+  void Touch(Entry* e);
+
+  void LRURemove(Entry* e);
+
+  void LRUAppend(Entry* e);
+
+  /**
+   * @brief Free least recently used packets until `incoming` more bytes fit in the budget (mutex_ must be locked)
+   */
+  void FreeForIncoming(qint64 incoming);
+
+  /**
+   * @brief Remove an entry from its map and free it (mutex_ must be locked)
+   */
+  void RemoveEntry(Entry* e);
+
+  static qint64 EntrySize(const AVPacket* pkt);
+
+  // Cached packets by file and stream, then by decode timestamp
+  QHash< StreamKey, QMap<int64_t, Entry*> > streams_;
+
+  // Bytes cached for each stream in streams_, so statistics() doesn't have to walk every packet
+  QHash<StreamKey, qint64> stream_bytes_;
+
+  Entry* lru_head_;
+  Entry* lru_tail_;
+
+  qint64 budget_;
+
+  qint64 used_bytes_;
+
+  // Get() and GetNext() calls that found a packet, and that didn't
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide packet cache
+ */
+extern FFmpegPacketCache packet_cache;
+}
+
+#endif // FFMPEGPACKETCACHE_H
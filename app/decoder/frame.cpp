@@ -23,40 +23,59 @@
 #include <QtGlobal>
 
 Frame::Frame() :
-  frame_(nullptr)
+  frame_(nullptr),
+  tracked_bytes_(0),
+  tag_(AllocationCounters::kOther)
 {
 }
 
 Frame::Frame(AVFrame *f) :
-  frame_(f)
+  frame_(f),
+  tracked_bytes_(0),
+  tag_(AllocationCounters::kOther)
 {
+  Track();
 }
 
 Frame::Frame(const Frame &f) :
-  frame_(nullptr)
+  frame_(nullptr),
+  tracked_bytes_(0),
+  tag_(AllocationCounters::kOther)
 {
-  Q_UNUSED(f)
+  RefFrom(f);
 }
 
 Frame::Frame(Frame &&f) :
-  frame_(f.frame_)
+  frame_(f.frame_),
+  timestamp_(f.timestamp_),
+  tracked_bytes_(f.tracked_bytes_),
+  tag_(f.tag_)
 {
   f.frame_ = nullptr;
+  f.tracked_bytes_ = 0;
 }
 
 Frame &Frame::operator=(const Frame &f)
 {
-  Q_UNUSED(f)
+  if (&f != this) {
+    FreeChild();
+    RefFrom(f);
+  }
 
-  frame_ = nullptr;
   return *this;
 }
 
 Frame &Frame::operator=(Frame &&f)
 {
   if (&f != this) {
+    FreeChild();
+
     frame_ = f.frame_;
+    timestamp_ = f.timestamp_;
+    tracked_bytes_ = f.tracked_bytes_;
+    tag_ = f.tag_;
     f.frame_ = nullptr;
+    f.tracked_bytes_ = 0;
   }
 
   return *this;
@@ -71,8 +90,10 @@ void Frame::SetAVFrame(AVFrame *f, AVRational timebase)
 {
   FreeChild();
 
-  f = frame_;
+  frame_ = f;
   timestamp_ = rational(timebase.num*f->pts, timebase.den);
+
+  Track();
 }
 
 const int &Frame::width()
@@ -85,6 +106,16 @@ const int &Frame::height()
   return frame_->height;
 }
 
+const int &Frame::sample_count()
+{
+  return frame_->nb_samples;
+}
+
+const int &Frame::channels()
+{
+  return frame_->channels;
+}
+
 const rational &Frame::timestamp()
 {
   return timestamp_;
@@ -95,6 +126,16 @@ const int &Frame::format()
   return frame_->format;
 }
 
+AVColorSpace Frame::colorspace()
+{
+  return frame_->colorspace;
+}
+
+AVColorRange Frame::color_range()
+{
+  return frame_->color_range;
+}
+
 uint8_t **Frame::data()
 {
   return frame_->data;
@@ -105,10 +146,68 @@ int *Frame::linesize()
   return frame_->linesize;
 }
 
+bool Frame::is_shared()
+{
+  if (frame_ == nullptr || frame_->buf[0] == nullptr) {
+    return false;
+  }
+
+  return !av_buffer_is_writable(frame_->buf[0]);
+}
+
+void Frame::RefFrom(const Frame &f)
+{
+  timestamp_ = f.timestamp_;
+
+  if (f.frame_ == nullptr) {
+    return;
+  }
+
+  frame_ = av_frame_alloc();
+
+  // Reference the same buffers rather than copying them
+  if (frame_ != nullptr && av_frame_ref(frame_, f.frame_) < 0) {
+    av_frame_free(&frame_);
+  }
+
+  Track();
+}
+
 void Frame::FreeChild()
 {
+  if (tracked_bytes_ > 0) {
+    AllocationCounters::Freed(AllocationCounters::kFrame, tag_, tracked_bytes_);
+    tracked_bytes_ = 0;
+  }
+
   if (frame_ != nullptr) {
     av_frame_free(&frame_);
     frame_ = nullptr;
   }
 }
+
+void Frame::Track()
+{
+  if (frame_ == nullptr) {
+    return;
+  }
+
+  qint64 bytes = 0;
+
+  for (int i=0;i<AV_NUM_DATA_POINTERS;i++) {
+    if (frame_->buf[i] != nullptr) {
+      bytes += static_cast<qint64>(frame_->buf[i]->size);
+    }
+  }
+
+  for (int i=0;i<frame_->nb_extended_buf;i++) {
+    bytes += static_cast<qint64>(frame_->extended_buf[i]->size);
+  }
+
+  if (bytes > 0) {
+    tag_ = AllocationCounters::CurrentTag();
+    tracked_bytes_ = bytes;
+
+    AllocationCounters::Allocated(AllocationCounters::kFrame, tag_, tracked_bytes_);
+  }
+}
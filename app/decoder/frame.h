@@ -28,13 +28,16 @@ extern "C" {
 #include <memory>
 
 #include "common/rational.h"
+#include "render/allocationcounters.h"
 
 /**
  * @brief Video frame data or audio sample data from a Decoder
  *
  * Abstraction from AVFrame. Currently a simple AVFrame wrapper.
  *
- * This class does not support copying at this time.
+ * Frame data is reference counted. Copying a Frame creates a new reference to the same buffers (no pixels are copied)
+ * and the buffers are freed (or returned to the Decoder's pool) once the last Frame referencing them is destroyed.
+ * Since the data may be shared, it should be treated as read-only unless is_shared() returns FALSE.
  */
 class Frame
 {
@@ -50,13 +53,13 @@ public:
   /// AVFrame constructor
   Frame(AVFrame* f);
 
-  /// Copy constructor
+  /// Copy constructor, references the same data as `f`
   Frame(const Frame& f);
 
   /// Move constructor
   Frame(Frame&& f);
 
-  /// Copy assignment operator
+  /// Copy assignment operator, references the same data as `f`
   Frame& operator=(const Frame& f);
 
   /// Move assignment operator
@@ -86,6 +89,16 @@ public:
    */
   const int& height();
 
+  /**
+   * @brief Get the number of audio samples (per channel) in this frame
+   */
+  const int& sample_count();
+
+  /**
+   * @brief Get the number of audio channels in this frame
+   */
+  const int& channels();
+
   /**
    * @brief Get frame's timestamp.
    *
@@ -102,6 +115,16 @@ public:
    */
   const int& format();
 
+  /**
+   * @brief Get the Y'CbCr matrix of this frame (AVCOL_SPC_UNSPECIFIED if the decoder didn't set one)
+   */
+  AVColorSpace colorspace();
+
+  /**
+   * @brief Get whether this frame is full range (AVCOL_RANGE_JPEG) or limited range (AVCOL_RANGE_MPEG)
+   */
+  AVColorRange color_range();
+
   /**
    * @brief Get the data buffer of this frame
    */
@@ -112,12 +135,30 @@ public:
    */
   int* linesize();
 
+  /**
+   * @brief Returns TRUE if another Frame (or the Decoder) also references this Frame's data
+   */
+  bool is_shared();
+
 private:
+  /**
+   * @brief Reference the data of `f`, frame_ must be empty beforehand
+   */
+  void RefFrom(const Frame& f);
 
   void FreeChild();
 
+  /**
+   * @brief Count frame_'s buffers in AllocationCounters under the current tag
+   */
+  void Track();
+
   AVFrame* frame_;
   rational timestamp_;
+
+  // Bytes of frame_'s buffers counted in AllocationCounters, and what they're counted under
+  qint64 tracked_bytes_;
+  AllocationCounters::Tag tag_;
 };
 
 using FramePtr = std::shared_ptr<Frame>;
@@ -0,0 +1,449 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "imagesequencedecoder.h"
+
+#include <cstring>
+#include <limits>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "common/tickrescaler.h"
+#include "common/tracing.h"
+#include "project/item/footage/videostream.h"
+#include "render/allocationcounters.h"
+#include "render/performancecounters.h"
+
+namespace {
+
+// Image files don't store a frame rate
+const int kDefaultFrameRate = 24;
+
+// Frames read and decoded ahead of the last retrieved frame
+const int kPrefetchFrames = 8;
+
+// Files read at once (per process), reads mostly wait on storage so this is independent of the number of cores
+const int kIOThreads = 4;
+
+}
+
+class ImageSequenceDecoder::ReadRunnable : public QRunnable
+{
+public:
+  ReadRunnable(PrefetchPtr prefetch) :
+    prefetch_(prefetch)
+  {
+  }
+
+  virtual void run() override;
+
+private:
+  PrefetchPtr prefetch_;
+};
+
+class ImageSequenceDecoder::DecodeRunnable : public QRunnable
+{
+public:
+  DecodeRunnable(PrefetchPtr prefetch, const QByteArray& data) :
+    prefetch_(prefetch),
+    data_(data)
+  {
+  }
+
+  virtual void run() override;
+
+private:
+  PrefetchPtr prefetch_;
+
+  QByteArray data_;
+};
+
+void ImageSequenceDecoder::ReadRunnable::run()
+{
+  QMutexLocker locker(&prefetch_->mutex);
+
+  if (prefetch_->cancelled) {
+    prefetch_->done = true;
+    prefetch_->done_cond.wakeAll();
+    return;
+  }
+
+  locker.unlock();
+
+  Tracing::Span span("decoder", "ImageSequenceDecoder::Read");
+
+  QByteArray data;
+  bool ok = ReadFile(prefetch_->filename, &data);
+
+  locker.relock();
+
+  prefetch_->bytes = ok ? data.size() - AV_INPUT_BUFFER_PADDING_SIZE : 0;
+
+  if (!ok || prefetch_->cancelled) {
+    prefetch_->done = true;
+    prefetch_->done_cond.wakeAll();
+    return;
+  }
+
+  decode_pool()->start(new DecodeRunnable(prefetch_, data));
+}
+
+void ImageSequenceDecoder::DecodeRunnable::run()
+{
+  QMutexLocker locker(&prefetch_->mutex);
+
+  if (!prefetch_->cancelled) {
+    locker.unlock();
+
+    AllocationCounters::ScopedTag tag(AllocationCounters::kDecoder);
+    Tracing::Span span("decoder", "ImageSequenceDecoder::Decode");
+
+    AVFrame* frame = DecodeFile(data_, prefetch_->codec_id);
+
+    locker.relock();
+
+    prefetch_->frame = frame;
+  }
+
+  prefetch_->done = true;
+  prefetch_->done_cond.wakeAll();
+}
+
+ImageSequenceDecoder::Prefetch::Prefetch(const QString &f, AVCodecID c) :
+  filename(f),
+  codec_id(c),
+  done(false),
+  cancelled(false),
+  bytes(0),
+  frame(nullptr)
+{
+}
+
+ImageSequenceDecoder::Prefetch::~Prefetch()
+{
+  av_frame_free(&frame);
+}
+
+ImageSequenceDecoder::ImageSequenceDecoder() :
+  codec_id_(AV_CODEC_ID_NONE),
+  timebase_({1, kDefaultFrameRate}),
+  bytes_read_(0)
+{
+}
+
+ImageSequenceDecoder::~ImageSequenceDecoder()
+{
+  Close();
+}
+
+bool ImageSequenceDecoder::Probe(Footage *f)
+{
+  const ImageSequence& sequence = f->image_sequence();
+
+  if (!sequence.IsValid()) {
+    return false;
+  }
+
+  QByteArray data;
+
+  if (!ReadFile(sequence.FrameFilename(sequence.first()), &data)) {
+    return false;
+  }
+
+  bytes_read_ += data.size() - AV_INPUT_BUFFER_PADDING_SIZE;
+
+  AVFrame* frame = DecodeFile(data, CodecForExtension(sequence.extension()));
+
+  if (frame == nullptr) {
+    return false;
+  }
+
+  VideoStream* video_stream = new VideoStream();
+  video_stream->set_width(frame->width);
+  video_stream->set_height(frame->height);
+  video_stream->set_frame_rate(rational(kDefaultFrameRate));
+  video_stream->set_index(0);
+  video_stream->set_timebase(rational(1, kDefaultFrameRate));
+  video_stream->set_duration(sequence.frame_count());
+
+  f->add_stream(video_stream);
+
+  av_frame_free(&frame);
+
+  return true;
+}
+
+bool ImageSequenceDecoder::Open()
+{
+  if (open_) {
+    return true;
+  }
+
+  sequence_ = stream()->footage()->image_sequence();
+
+  if (!sequence_.IsValid()) {
+    qWarning() << tr("%1 isn't an image sequence").arg(stream()->footage()->filename());
+    return false;
+  }
+
+  codec_id_ = CodecForExtension(sequence_.extension());
+
+  if (avcodec_find_decoder(codec_id_) == nullptr) {
+    qWarning() << tr("Failed to find a decoder for %1").arg(stream()->footage()->filename());
+    return false;
+  }
+
+  rational timebase = stream()->timebase();
+  timebase_ = {static_cast<int>(timebase.numerator()), static_cast<int>(timebase.denominator())};
+
+  open_ = true;
+
+  return true;
+}
+
+FramePtr ImageSequenceDecoder::Retrieve(const rational &timecode, const rational &length)
+{
+  Q_UNUSED(length)
+
+  AllocationCounters::ScopedTag tag(AllocationCounters::kDecoder);
+
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kDecode);
+
+  Tracing::Span span("decoder", "ImageSequenceDecoder::Retrieve");
+
+  if (!open_ && !Open()) {
+    return nullptr;
+  }
+
+  int64_t index = olive::TimeToTicks(timecode, timebase_);
+
+  if (index < 0 || index >= sequence_.frame_count()) {
+    return nullptr;
+  }
+
+  AVFrame* decoded = nullptr;
+
+  PrefetchPtr prefetch = prefetches_.take(index);
+
+  if (prefetch != nullptr) {
+    QMutexLocker locker(&prefetch->mutex);
+
+    while (!prefetch->done) {
+      prefetch->done_cond.wait(&prefetch->mutex);
+    }
+
+    decoded = prefetch->frame;
+    prefetch->frame = nullptr;
+    bytes_read_ += prefetch->bytes;
+  } else {
+    // Not read ahead (this is the first frame or we've seeked), the calling thread might as well do it
+    QByteArray data;
+
+    if (ReadFile(sequence_.FrameFilename(sequence_.first() + index), &data)) {
+      bytes_read_ += data.size() - AV_INPUT_BUFFER_PADDING_SIZE;
+      decoded = DecodeFile(data, codec_id_);
+    }
+  }
+
+  PrefetchFrom(index + 1);
+
+  if (decoded == nullptr) {
+    qWarning() << tr("Failed to decode %1").arg(sequence_.FrameFilename(sequence_.first() + index));
+    return nullptr;
+  }
+
+  decoded->pts = index;
+
+  FramePtr f = std::make_shared<Frame>();
+  f->SetAVFrame(decoded, timebase_);
+
+  return f;
+}
+
+void ImageSequenceDecoder::Close()
+{
+  foreach (PrefetchPtr prefetch, prefetches_) {
+    Cancel(prefetch);
+  }
+
+  prefetches_.clear();
+
+  open_ = false;
+}
+
+qint64 ImageSequenceDecoder::bytes_read()
+{
+  return bytes_read_;
+}
+
+QThreadPool *ImageSequenceDecoder::io_pool()
+{
+  // Reads hand their files to the decode pool, so it has to be created first to be destroyed last
+  decode_pool();
+
+  static QThreadPool pool;
+
+  if (pool.maxThreadCount() != kIOThreads) {
+    pool.setMaxThreadCount(kIOThreads);
+  }
+
+  return &pool;
+}
+
+QThreadPool *ImageSequenceDecoder::decode_pool()
+{
+  static QThreadPool pool;
+
+  return &pool;
+}
+
+AVCodecID ImageSequenceDecoder::CodecForExtension(const QString &extension)
+{
+  if (extension == "exr") {
+    return AV_CODEC_ID_EXR;
+  } else if (extension == "dpx") {
+    return AV_CODEC_ID_DPX;
+  } else if (extension == "png") {
+    return AV_CODEC_ID_PNG;
+  } else if (extension == "tif" || extension == "tiff") {
+    return AV_CODEC_ID_TIFF;
+  }
+
+  return AV_CODEC_ID_NONE;
+}
+
+bool ImageSequenceDecoder::ReadFile(const QString &filename, QByteArray *data)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    qWarning() << tr("Failed to open %1").arg(filename);
+    return false;
+  }
+
+  qint64 size = file.size();
+
+  // Packets are limited to an int's worth of bytes
+  if (size <= 0 || size > std::numeric_limits<int>::max() - AV_INPUT_BUFFER_PADDING_SIZE) {
+    qWarning() << tr("%1 is empty or too large").arg(filename);
+    return false;
+  }
+
+  data->resize(static_cast<int>(size) + AV_INPUT_BUFFER_PADDING_SIZE);
+
+  if (file.read(data->data(), size) != size) {
+    qWarning() << tr("Failed to read %1").arg(filename);
+    data->clear();
+    return false;
+  }
+
+  memset(data->data() + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+  return true;
+}
+
+AVFrame *ImageSequenceDecoder::DecodeFile(const QByteArray &data, AVCodecID codec_id)
+{
+  AVCodec* codec = avcodec_find_decoder(codec_id);
+
+  if (codec == nullptr) {
+    return nullptr;
+  }
+
+  AVCodecContext* ctx = avcodec_alloc_context3(codec);
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+
+  // Several files are already being decoded at once, one thread each
+  ctx->thread_count = 1;
+
+  int error_code = -1;
+
+  if (ctx != nullptr && pkt != nullptr && frame != nullptr && avcodec_open2(ctx, codec, nullptr) >= 0) {
+    // The packet only points into data, it isn't reference counted so av_packet_free() won't free it
+    pkt->data = reinterpret_cast<uint8_t*>(const_cast<char*>(data.constData()));
+    pkt->size = data.size() - AV_INPUT_BUFFER_PADDING_SIZE;
+
+    error_code = avcodec_send_packet(ctx, pkt);
+
+    if (error_code >= 0) {
+      error_code = avcodec_receive_frame(ctx, frame);
+
+      // Some codecs wait for the end of the stream before outputting anything
+      if (error_code == AVERROR(EAGAIN)) {
+        avcodec_send_packet(ctx, nullptr);
+        error_code = avcodec_receive_frame(ctx, frame);
+      }
+    }
+  }
+
+  av_packet_free(&pkt);
+  avcodec_free_context(&ctx);
+
+  if (error_code < 0) {
+    av_frame_free(&frame);
+    return nullptr;
+  }
+
+  return frame;
+}
+
+void ImageSequenceDecoder::PrefetchFrom(int64_t index)
+{
+  int64_t end = qMin(index + kPrefetchFrames, sequence_.frame_count());
+
+  // Abandon frames that are no longer ahead (e.g. after seeking)
+  QMap<int64_t, PrefetchPtr>::iterator i = prefetches_.begin();
+
+  while (i != prefetches_.end()) {
+    if (i.key() < index || i.key() >= end) {
+      Cancel(i.value());
+      i = prefetches_.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  for (int64_t j=index;j<end;j++) {
+    if (!prefetches_.contains(j)) {
+      PrefetchPtr prefetch = std::make_shared<Prefetch>(sequence_.FrameFilename(sequence_.first() + j), codec_id_);
+
+      prefetches_.insert(j, prefetch);
+
+      io_pool()->start(new ReadRunnable(prefetch));
+    }
+  }
+}
+
+void ImageSequenceDecoder::Cancel(PrefetchPtr prefetch)
+{
+  QMutexLocker locker(&prefetch->mutex);
+
+  prefetch->cancelled = true;
+
+  bytes_read_ += prefetch->bytes;
+}
@@ -0,0 +1,154 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef IMAGESEQUENCEDECODER_H
+#define IMAGESEQUENCEDECODER_H
+
+#include <memory>
+#include <QMap>
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include "common/imagesequence.h"
+#include "decoder/decoder.h"
+
+/**
+ * @brief A Decoder for image sequences (Footage with a valid ImageSequence), reading and decoding frames ahead
+ *
+ * Every frame is a file of its own that doesn't depend on any other, so frames can be read and decoded in any order.
+ * After each Retrieve(), the frames following it are read on a pool of IO threads and each file is decoded on a pool
+ * of CPU threads as soon as it's been read. Slow storage and expensive codecs (e.g. EXR, DPX) are spread over several
+ * threads instead of holding up playback one frame at a time.
+ *
+ * Files are decoded as a single packet by the FFmpeg image codec for their extension, the same way FFmpeg's image2
+ * demuxer reads them, so frames come out in the same formats as single stills decoded by FFmpegDecoder.
+ */
+class ImageSequenceDecoder : public Decoder
+{
+public:
+  ImageSequenceDecoder();
+
+  virtual ~ImageSequenceDecoder() override;
+
+  /**
+   * @brief Only accepts Footage that was imported as an image sequence, reading its size from the first frame
+   *
+   * Image files don't store a frame rate, so sequences are probed at 24 fps.
+   */
+  virtual bool Probe(Footage *f) override;
+
+  virtual bool Open() override;
+
+  virtual FramePtr Retrieve(const rational &timecode, const rational &length = 0) override;
+
+  /**
+   * @brief Abandons every frame being read or decoded ahead
+   */
+  virtual void Close() override;
+
+  virtual qint64 bytes_read() override;
+
+private:
+  class ReadRunnable;
+  class DecodeRunnable;
+
+  /**
+   * @brief A frame that's being read and decoded ahead of Retrieve()
+   *
+   * Shared with the runnables working on it, so it can be abandoned without waiting for them.
+   */
+  struct Prefetch {
+    Prefetch(const QString& f, AVCodecID c);
+
+    ~Prefetch();
+
+    QString filename;
+
+    AVCodecID codec_id;
+
+    // Everything below is protected by mutex
+    QMutex mutex;
+
+    QWaitCondition done_cond;
+
+    // Set once the frame has been decoded (or failed to)
+    bool done;
+
+    // Set when nobody wants the frame any more, the runnables skip their work
+    bool cancelled;
+
+    qint64 bytes;
+
+    // Decoded frame, owned by this until it's taken (nullptr if reading or decoding failed)
+    AVFrame* frame;
+  };
+
+  using PrefetchPtr = std::shared_ptr<Prefetch>;
+
+  /**
+   * @brief Threads reading files, more than there are cores since they mostly wait on storage
+   */
+  static QThreadPool* io_pool();
+
+  /**
+   * @brief Threads decoding files that have been read, one per core
+   */
+  static QThreadPool* decode_pool();
+
+  static AVCodecID CodecForExtension(const QString& extension);
+
+  /**
+   * @brief Read a whole file, followed by the zeroed padding FFmpeg expects after packet data
+   */
+  static bool ReadFile(const QString& filename, QByteArray* data);
+
+  /**
+   * @brief Decode a file read with ReadFile()
+   *
+   * @return
+   *
+   * The decoded frame (which the caller is responsible for freeing) or nullptr if it couldn't be decoded.
+   */
+  static AVFrame* DecodeFile(const QByteArray& data, AVCodecID codec_id);
+
+  /**
+   * @brief Start reading the frames from `index` on and abandon the ones that are no longer ahead of it
+   */
+  void PrefetchFrom(int64_t index);
+
+  /**
+   * @brief Abandon a prefetched frame, counting what it read
+   */
+  void Cancel(PrefetchPtr prefetch);
+
+  ImageSequence sequence_;
+
+  AVCodecID codec_id_;
+
+  AVRational timebase_;
+
+  // Frames being read or decoded ahead, by index from the start of the sequence
+  QMap<int64_t, PrefetchPtr> prefetches_;
+
+  qint64 bytes_read_;
+};
+
+#endif // IMAGESEQUENCEDECODER_H
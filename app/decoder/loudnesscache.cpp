@@ -0,0 +1,203 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "loudnesscache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+/**
+ * @brief Header of a loudness cache file
+ *
+ * The header is followed by `step_count` floats of momentary loudness and then `step_count` floats of short-term
+ * loudness.
+ */
+struct LoudnessHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t step_milliseconds;
+  int32_t step_count;
+  double integrated;
+  double range;
+  double true_peak;
+  double sample_peak;
+};
+
+const char kLoudnessMagic[4] = {'O', 'V', 'L', 'D'};
+const uint32_t kLoudnessVersion = 1;
+
+LoudnessCache::LoudnessCache() :
+  integrated_(LoudnessMeter::kSilence),
+  range_(0),
+  true_peak_(LoudnessMeter::kSilence),
+  sample_peak_(LoudnessMeter::kSilence)
+{
+}
+
+void LoudnessCache::Set(const LoudnessMeter &meter)
+{
+  integrated_ = meter.integrated();
+  range_ = meter.range();
+  true_peak_ = meter.true_peak();
+  sample_peak_ = meter.sample_peak();
+  momentary_ = meter.momentary();
+  short_term_ = meter.short_term();
+}
+
+bool LoudnessCache::Save(AudioStream *stream)
+{
+  // QSaveFile ensures a partially written cache can never be read by Load()
+  QSaveFile file(GetCacheFilename(stream));
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << QStringLiteral("Failed to write loudness cache for %1").arg(stream->footage()->filename());
+    return false;
+  }
+
+  LoudnessHeader header;
+  memcpy(header.magic, kLoudnessMagic, sizeof(kLoudnessMagic));
+  header.version = kLoudnessVersion;
+  header.step_milliseconds = LoudnessMeter::kStepMilliseconds;
+  header.step_count = momentary_.size();
+  header.integrated = integrated_;
+  header.range = range_;
+  header.true_peak = true_peak_;
+  header.sample_peak = sample_peak_;
+
+  qint64 series_bytes = static_cast<qint64>(momentary_.size()) * static_cast<qint64>(sizeof(float));
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(LoudnessHeader));
+  file.write(reinterpret_cast<const char*>(momentary_.constData()), series_bytes);
+  file.write(reinterpret_cast<const char*>(short_term_.constData()), series_bytes);
+
+  return file.commit();
+}
+
+bool LoudnessCache::Load(AudioStream *stream)
+{
+  QFile file(GetCacheFilename(stream));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  LoudnessHeader header;
+
+  if (file.read(reinterpret_cast<char*>(&header), sizeof(LoudnessHeader)) != sizeof(LoudnessHeader)
+      || memcmp(header.magic, kLoudnessMagic, sizeof(kLoudnessMagic)) != 0
+      || header.version != kLoudnessVersion
+      || header.step_milliseconds != LoudnessMeter::kStepMilliseconds
+      || header.step_count < 0) {
+    return false;
+  }
+
+  qint64 series_bytes = static_cast<qint64>(header.step_count) * static_cast<qint64>(sizeof(float));
+
+  if (file.size() != static_cast<qint64>(sizeof(LoudnessHeader)) + series_bytes * 2) {
+    return false;
+  }
+
+  momentary_.resize(header.step_count);
+  short_term_.resize(header.step_count);
+
+  if (file.read(reinterpret_cast<char*>(momentary_.data()), series_bytes) != series_bytes
+      || file.read(reinterpret_cast<char*>(short_term_.data()), series_bytes) != series_bytes) {
+    momentary_.clear();
+    short_term_.clear();
+    return false;
+  }
+
+  integrated_ = header.integrated;
+  range_ = header.range;
+  true_peak_ = header.true_peak;
+  sample_peak_ = header.sample_peak;
+
+  return true;
+}
+
+bool LoudnessCache::Exists(AudioStream *stream)
+{
+  return QFileInfo::exists(GetCacheFilename(stream));
+}
+
+double LoudnessCache::integrated() const
+{
+  return integrated_;
+}
+
+double LoudnessCache::range() const
+{
+  return range_;
+}
+
+double LoudnessCache::true_peak() const
+{
+  return true_peak_;
+}
+
+double LoudnessCache::sample_peak() const
+{
+  return sample_peak_;
+}
+
+float LoudnessCache::MomentaryAt(const rational &time) const
+{
+  return StepAt(momentary_, time);
+}
+
+float LoudnessCache::ShortTermAt(const rational &time) const
+{
+  return StepAt(short_term_, time);
+}
+
+QString LoudnessCache::GetCacheFilename(AudioStream *stream)
+{
+  Footage* footage = stream->footage();
+
+  // Generate a unique hash for this file and stream
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage->filename().toUtf8());
+  hash.addData(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(QFileInfo(footage->filename()).size()));
+  hash.addData(QByteArray::number(stream->index()));
+
+  QDir loudness_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("loudness"));
+  loudness_dir.mkpath(".");
+
+  return loudness_dir.filePath(QString(hash.result().toHex()));
+}
+
+float LoudnessCache::StepAt(const QVector<float> &steps, const rational &time)
+{
+  // Each value is the loudness of the block ending on its step
+  int step = static_cast<int>(time.ToDouble() * 1000.0 / LoudnessMeter::kStepMilliseconds);
+
+  if (step < 0 || step >= steps.size()) {
+    return static_cast<float>(LoudnessMeter::kSilence);
+  }
+
+  return steps.at(step);
+}
@@ -0,0 +1,114 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef LOUDNESSCACHE_H
+#define LOUDNESSCACHE_H
+
+#include <QVector>
+
+#include "audio/loudnessmeter.h"
+#include "common/rational.h"
+#include "project/item/footage/audiostream.h"
+
+/**
+ * @brief Stored EBU R128 loudness measurements of an AudioStream
+ *
+ * Measuring loudness means decoding the whole stream, so it's done once in the background (see LoudnessTask) and
+ * the results kept in a small cache file: the integrated loudness, loudness range and peaks for delivery checks, and
+ * momentary and short-term loudness every LoudnessMeter::kStepMilliseconds for meters.
+ */
+class LoudnessCache
+{
+public:
+  LoudnessCache();
+
+  /**
+   * @brief Take the results of a finalized LoudnessMeter
+   */
+  void Set(const LoudnessMeter& meter);
+
+  /**
+   * @brief Write the cache to the cache file for this stream
+   */
+  bool Save(AudioStream* stream);
+
+  /**
+   * @brief Load the cache from the cache file for this stream
+   *
+   * @return
+   *
+   * TRUE if a valid cache exists for this stream and was loaded.
+   */
+  bool Load(AudioStream* stream);
+
+  /**
+   * @brief Returns whether a cache file exists for this stream
+   */
+  static bool Exists(AudioStream* stream);
+
+  /**
+   * @brief Integrated loudness in LUFS
+   */
+  double integrated() const;
+
+  /**
+   * @brief Loudness range in LU
+   */
+  double range() const;
+
+  /**
+   * @brief True peak in dBTP
+   */
+  double true_peak() const;
+
+  /**
+   * @brief Sample peak in dBFS
+   */
+  double sample_peak() const;
+
+  /**
+   * @brief Momentary loudness in LUFS at a time in the stream (LoudnessMeter::kSilence outside of it)
+   */
+  float MomentaryAt(const rational& time) const;
+
+  /**
+   * @brief Short-term loudness in LUFS at a time in the stream (LoudnessMeter::kSilence outside of it)
+   */
+  float ShortTermAt(const rational& time) const;
+
+private:
+  static QString GetCacheFilename(AudioStream* stream);
+
+  static float StepAt(const QVector<float>& steps, const rational& time);
+
+  double integrated_;
+
+  double range_;
+
+  double true_peak_;
+
+  double sample_peak_;
+
+  QVector<float> momentary_;
+
+  QVector<float> short_term_;
+};
+
+#endif // LOUDNESSCACHE_H
@@ -0,0 +1,362 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "probecache.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "project/item/footage/audiostream.h"
+#include "project/item/footage/videostream.h"
+
+namespace {
+
+const quint32 kProbeCacheMagic = 0x4F505243; // "OPRC"
+
+// Increment whenever the format changes or Decoders start collecting different metadata
+const quint32 kProbeCacheVersion = 3;
+
+// Codecs and formats are written by name, since FFmpeg's enum values may change between versions
+void WriteCodecParameters(QDataStream& out, Stream* s)
+{
+  const Stream::CodecParameters& params = s->codec_parameters();
+
+  QString codec;
+  QString format;
+
+  if (params.codec_id != AV_CODEC_ID_NONE) {
+    codec = avcodec_get_name(params.codec_id);
+  }
+
+  if (params.format >= 0) {
+    if (s->type() == Stream::kVideo) {
+      format = av_get_pix_fmt_name(static_cast<AVPixelFormat>(params.format));
+    } else if (s->type() == Stream::kAudio) {
+      format = av_get_sample_fmt_name(static_cast<AVSampleFormat>(params.format));
+    }
+  }
+
+  out << codec
+      << format
+      << static_cast<quint32>(params.codec_tag)
+      << params.extradata
+      << static_cast<qint64>(params.bit_rate)
+      << static_cast<qint32>(params.bits_per_coded_sample)
+      << static_cast<qint32>(params.bits_per_raw_sample)
+      << static_cast<qint32>(params.profile)
+      << static_cast<qint32>(params.level);
+
+  if (s->type() == Stream::kVideo) {
+    out << static_cast<qint32>(params.sample_aspect_ratio.num)
+        << static_cast<qint32>(params.sample_aspect_ratio.den)
+        << static_cast<qint32>(params.field_order)
+        << static_cast<qint32>(params.color_range)
+        << static_cast<qint32>(params.color_primaries)
+        << static_cast<qint32>(params.color_trc)
+        << static_cast<qint32>(params.color_space)
+        << static_cast<qint32>(params.chroma_location)
+        << static_cast<qint32>(params.video_delay);
+  } else if (s->type() == Stream::kAudio) {
+    out << static_cast<qint32>(params.block_align)
+        << static_cast<qint32>(params.frame_size)
+        << static_cast<qint32>(params.initial_padding)
+        << static_cast<qint32>(params.seek_preroll);
+  }
+}
+
+void ReadCodecParameters(QDataStream& in, Stream* s)
+{
+  Stream::CodecParameters params;
+
+  QString codec;
+  QString format;
+  quint32 codec_tag;
+  qint64 bit_rate;
+  qint32 bits_per_coded_sample, bits_per_raw_sample, profile, level;
+
+  in >> codec >> format >> codec_tag >> params.extradata >> bit_rate >> bits_per_coded_sample >> bits_per_raw_sample
+     >> profile >> level;
+
+  // A codec this build of FFmpeg doesn't know is left as AV_CODEC_ID_NONE, so the file is analyzed when opened
+  if (!codec.isEmpty()) {
+    const AVCodecDescriptor* descriptor = avcodec_descriptor_get_by_name(codec.toUtf8().constData());
+
+    if (descriptor != nullptr) {
+      params.codec_id = descriptor->id;
+    }
+  }
+
+  if (!format.isEmpty()) {
+    if (s->type() == Stream::kVideo) {
+      params.format = av_get_pix_fmt(format.toUtf8().constData());
+    } else if (s->type() == Stream::kAudio) {
+      params.format = av_get_sample_fmt(format.toUtf8().constData());
+    }
+  }
+
+  params.codec_tag = codec_tag;
+  params.bit_rate = bit_rate;
+  params.bits_per_coded_sample = bits_per_coded_sample;
+  params.bits_per_raw_sample = bits_per_raw_sample;
+  params.profile = profile;
+  params.level = level;
+
+  if (s->type() == Stream::kVideo) {
+    qint32 sar_num, sar_den, field_order, color_range, color_primaries, color_trc, color_space, chroma_location,
+        video_delay;
+
+    in >> sar_num >> sar_den >> field_order >> color_range >> color_primaries >> color_trc >> color_space
+       >> chroma_location >> video_delay;
+
+    params.sample_aspect_ratio = av_make_q(sar_num, sar_den);
+    params.field_order = static_cast<AVFieldOrder>(field_order);
+    params.color_range = static_cast<AVColorRange>(color_range);
+    params.color_primaries = static_cast<AVColorPrimaries>(color_primaries);
+    params.color_trc = static_cast<AVColorTransferCharacteristic>(color_trc);
+    params.color_space = static_cast<AVColorSpace>(color_space);
+    params.chroma_location = static_cast<AVChromaLocation>(chroma_location);
+    params.video_delay = video_delay;
+  } else if (s->type() == Stream::kAudio) {
+    qint32 block_align, frame_size, initial_padding, seek_preroll;
+
+    in >> block_align >> frame_size >> initial_padding >> seek_preroll;
+
+    params.block_align = block_align;
+    params.frame_size = frame_size;
+    params.initial_padding = initial_padding;
+    params.seek_preroll = seek_preroll;
+  }
+
+  s->set_codec_parameters(params);
+}
+
+}
+
+bool ProbeCache::Load(Footage *f)
+{
+  QFile file(GetCacheFilename(f));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_6);
+
+  quint32 magic, version;
+
+  in >> magic >> version;
+
+  if (in.status() != QDataStream::Ok || magic != kProbeCacheMagic || version != kProbeCacheVersion) {
+    return false;
+  }
+
+  if (!ReadStreams(in, f)) {
+    return false;
+  }
+
+  // Only successfully probed Footage is ever cached
+  if (f->status() != Footage::kUnindexed && f->status() != Footage::kReady) {
+    f->Clear();
+    return false;
+  }
+
+  return true;
+}
+
+void ProbeCache::Save(Footage *f)
+{
+  // QSaveFile ensures a partially written cache can never be read by Load()
+  QSaveFile file(GetCacheFilename(f));
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << QStringLiteral("Failed to write probe cache for %1").arg(f->filename());
+    return;
+  }
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_6);
+
+  out << kProbeCacheMagic << kProbeCacheVersion;
+
+  WriteStreams(out, f);
+
+  if (!file.commit()) {
+    qWarning() << QStringLiteral("Failed to write probe cache for %1").arg(f->filename());
+  }
+}
+
+bool ProbeCache::ReadStreams(QDataStream &in, Footage *f, int version)
+{
+  qint32 status, stream_count;
+
+  in >> status >> stream_count;
+
+  if (in.status() != QDataStream::Ok
+      || status < Footage::kUnprobed
+      || status > Footage::kOffline
+      || stream_count < 0) {
+    return false;
+  }
+
+  QList<Stream*> streams;
+
+  for (int i=0;i<stream_count;i++) {
+    qint32 type, index;
+    qint64 timebase_num, timebase_den, duration;
+
+    in >> type >> index >> timebase_num >> timebase_den >> duration;
+
+    if (in.status() != QDataStream::Ok || type < Stream::kUnknown || type > Stream::kAttachment || timebase_den == 0) {
+      break;
+    }
+
+    Stream* s;
+
+    if (type == Stream::kVideo) {
+      qint32 width, height;
+      qint64 frame_rate_num = 0;
+      qint64 frame_rate_den = 1;
+
+      in >> width >> height;
+
+      if (version >= 2) {
+        in >> frame_rate_num >> frame_rate_den;
+      }
+
+      VideoStream* video_stream = new VideoStream();
+      video_stream->set_width(width);
+      video_stream->set_height(height);
+
+      if (frame_rate_den != 0) {
+        video_stream->set_frame_rate(rational(static_cast<int64_t>(frame_rate_num),
+                                              static_cast<int64_t>(frame_rate_den)));
+      }
+      s = video_stream;
+    } else if (type == Stream::kAudio) {
+      qint32 channels, sample_rate;
+      quint64 layout;
+
+      in >> channels >> layout >> sample_rate;
+
+      AudioStream* audio_stream = new AudioStream();
+      audio_stream->set_channels(channels);
+      audio_stream->set_layout(static_cast<uint64_t>(layout));
+      audio_stream->set_sample_rate(sample_rate);
+      s = audio_stream;
+    } else {
+      s = new Stream();
+      s->set_type(static_cast<Stream::Type>(type));
+    }
+
+    s->set_index(index);
+    s->set_timebase(rational(static_cast<int64_t>(timebase_num), static_cast<int64_t>(timebase_den)));
+    s->set_duration(static_cast<int64_t>(duration));
+
+    if (version >= 3) {
+      ReadCodecParameters(in, s);
+    }
+
+    streams.append(s);
+  }
+
+  // Don't use a partially read cache
+  if (in.status() != QDataStream::Ok || streams.size() != stream_count) {
+    qDeleteAll(streams);
+    return false;
+  }
+
+  foreach (Stream* s, streams) {
+    f->add_stream(s);
+  }
+
+  f->set_status(static_cast<Footage::Status>(status));
+
+  return true;
+}
+
+void ProbeCache::WriteStreams(QDataStream &out, Footage *f)
+{
+  out << static_cast<qint32>(f->status()) << f->stream_count();
+
+  for (int i=0;i<f->stream_count();i++) {
+    Stream* s = f->stream(i);
+
+    rational timebase = s->timebase();
+
+    out << static_cast<qint32>(s->type())
+        << s->index()
+        << static_cast<qint64>(timebase.numerator())
+        << static_cast<qint64>(timebase.denominator())
+        << static_cast<qint64>(s->duration());
+
+    if (s->type() == Stream::kVideo) {
+      VideoStream* video_stream = static_cast<VideoStream*>(s);
+
+      rational frame_rate = video_stream->frame_rate();
+
+      out << video_stream->width()
+          << video_stream->height()
+          << static_cast<qint64>(frame_rate.numerator())
+          << static_cast<qint64>(frame_rate.denominator());
+    } else if (s->type() == Stream::kAudio) {
+      AudioStream* audio_stream = static_cast<AudioStream*>(s);
+
+      out << audio_stream->channels()
+          << static_cast<quint64>(audio_stream->layout())
+          << audio_stream->sample_rate();
+    }
+
+    WriteCodecParameters(out, s);
+  }
+}
+
+QString ProbeCache::GetCacheFilename(Footage *f)
+{
+  QFileInfo info(f->filename());
+
+  // Modifying or replacing the file changes its key, so stale metadata is never loaded
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+  // Frames added to or removed from a sequence change its duration
+  if (f->image_sequence().IsValid()) {
+    hash.addData(QByteArray::number(static_cast<qlonglong>(f->image_sequence().first())));
+    hash.addData(QByteArray::number(static_cast<qlonglong>(f->image_sequence().last())));
+  }
+
+  QDir probe_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("probe"));
+  probe_dir.mkpath(".");
+
+  return probe_dir.filePath(QString(hash.result().toHex()));
+}
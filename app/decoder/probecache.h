@@ -0,0 +1,88 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <QDataStream>
+
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief A persistent cache of the metadata Decoders find when probing Footage
+ *
+ * Every probed file gets a small cache file keyed by its absolute path, size and modification time, storing its
+ * status and the metadata of every one of its streams. olive::ProbeMedia() checks here before passing a file through
+ * the Decoders, so re-importing or reopening media that's already been probed doesn't have to open it at all, and a
+ * file that's been modified since is simply probed again.
+ */
+class ProbeCache
+{
+public:
+  /**
+   * @brief Fill a Footage with cached metadata
+   *
+   * The Footage should have been cleared already.
+   *
+   * @return
+   *
+   * TRUE if the file had been probed before and hasn't changed since. FALSE if it needs to be probed.
+   */
+  static bool Load(Footage* f);
+
+  /**
+   * @brief Store a probed Footage's metadata
+   */
+  static void Save(Footage* f);
+
+  /**
+   * @brief Write a Footage's status and the metadata of its streams (used by Save() and project files)
+   */
+  static void WriteStreams(QDataStream& out, Footage* f);
+
+  /**
+   * @brief Read what WriteStreams() wrote into a cleared Footage
+   *
+   * @param version
+   *
+   * The kStreamsVersion the data was written with, older versions are still read for the sake of project files.
+   *
+   * @return
+   *
+   * TRUE on success. On failure the Footage is left untouched.
+   */
+  static bool ReadStreams(QDataStream& in, Footage* f, int version = kStreamsVersion);
+
+  /**
+   * @brief Version of the data written by WriteStreams()
+   *
+   * 2: Video frame rates
+   * 3: Codec parameters (see Stream::CodecParameters)
+   */
+  static const int kStreamsVersion = 3;
+
+private:
+  /**
+   * @brief Cache file of a Footage's file (and its frame range if it's an image sequence)
+   */
+  static QString GetCacheFilename(Footage* f);
+};
+
+#endif // PROBECACHE_H
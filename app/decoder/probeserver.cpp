@@ -25,8 +25,27 @@
 #include <QFileInfo>
 
 #include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "decoder/imagesequence/imagesequencedecoder.h"
+#include "decoder/probecache.h"
 
-bool olive::ProbeMedia(Footage *f)
+bool olive::ProbeMedia(Footage *f, const QAtomicInt *cancel_token)
+{
+  return MediaProber(cancel_token).Probe(f);
+}
+
+olive::MediaProber::MediaProber(const QAtomicInt *cancel_token) :
+  cancel_token_(cancel_token)
+{
+  // Create list of decoders to iterate through, FFmpeg would also accept an image sequence's first frame as a still
+  decoders_.append(std::make_shared<ImageSequenceDecoder>());
+  decoders_.append(std::make_shared<FFmpegDecoder>());
+
+  foreach (DecoderPtr decoder, decoders_) {
+    decoder->set_cancel_token(cancel_token_);
+  }
+}
+
+bool olive::MediaProber::Probe(Footage *f)
 {
   // Check for a valid filename
   if (f->filename().isEmpty()) {
@@ -43,27 +62,68 @@ bool olive::ProbeMedia(Footage *f)
   // Reset Footage state for probing
   f->Clear();
 
-  // Create decoder instance
-  FFmpegDecoder ff_dec;
-
-  // Create list to iterate through
-  QList<Decoder*> decoder_list;
-  decoder_list.append(&ff_dec);
+  // Media that was already probed (by us or on another run) doesn't need to be opened again
+  if (ProbeCache::Load(f)) {
+    return true;
+  }
 
-  // Pass Footage through each Decoder's probe function
-  for (int i=0;i<decoder_list.size();i++) {
-    if (decoder_list.at(i)->Probe(f)) {
+  // Pass Footage through each Decoder's probe function, each one closes itself again afterwards so it can be reused
+  for (int i=0;i<decoders_.size();i++) {
+    if (decoders_.at(i)->Probe(f)) {
 
       // TODO Some way of "attaching" the Footage to the Decoder without having to iterate through Decoders again at
       // render time?
 
-      f->set_status(Footage::kReady);
+      // Metadata may still be incomplete until DeepProbeMedia() runs
+      f->set_status(Footage::kUnindexed);
+
+      ProbeCache::Save(f);
+
       return true;
     }
   }
 
+  // Being cancelled doesn't mean the Footage is unusable, leave it unprobed
+  if (cancel_token_ != nullptr && cancel_token_->load() != 0) {
+    return false;
+  }
+
   // We aren't able to use this Footage
   f->set_status(Footage::kInvalid);
 
   return false;
 }
+
+bool olive::DeepProbeMedia(Footage *f, const QAtomicInt *cancel_token)
+{
+  return MediaProber(cancel_token).DeepProbe(f);
+}
+
+bool olive::MediaProber::DeepProbe(Footage *f)
+{
+  if (f->status() != Footage::kUnindexed) {
+    return (f->status() == Footage::kReady);
+  }
+
+  // FIXME: This should use whichever Decoder probed the Footage, for now only FFmpeg has anything to analyze
+  if (!f->image_sequence().IsValid() && !decoders_.last()->DeepProbe(f)) {
+    return false;
+  }
+
+  f->set_status(Footage::kReady);
+
+  ProbeCache::Save(f);
+
+  return true;
+}
+
+qint64 olive::MediaProber::bytes_read()
+{
+  qint64 bytes = 0;
+
+  foreach (DecoderPtr decoder, decoders_) {
+    bytes += decoder->bytes_read();
+  }
+
+  return bytes;
+}
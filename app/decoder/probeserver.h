@@ -21,6 +21,9 @@
 #ifndef PROBESERVER_H
 #define PROBESERVER_H
 
+#include <QAtomicInt>
+
+#include "decoder/decoder.h"
 #include "project/item/footage/footage.h"
 
 namespace olive {
@@ -33,18 +36,69 @@ namespace olive {
  * functions until one indicates that it can decode this file. That Decoder will then dump information about the file
  * into the Footage object for use throughout the program.
  *
- * Probing may be a lengthy process and it's recommended to run this in a separate thread.
+ * Probing may be a lengthy process and it's recommended to run this in a separate thread. Results are kept in the
+ * ProbeCache, so probing a file that hasn't changed since it was last probed only reads its cached metadata.
  *
  * @param f
  *
  * A Footage object with a valid filename. If the Footage does not have a valid filename (e.g. is empty or file doesn't
  * exist), this function will return FALSE.
  *
+ * @param cancel_token
+ *
+ * Aborts probing as soon as it becomes non-zero (see Decoder::set_cancel_token()).
+ *
  * @return
  *
  * TRUE if a Decoder was successfully able to parse and probe this file. FALSE if not.
  */
-bool ProbeMedia(Footage* f);
+bool ProbeMedia(Footage* f, const QAtomicInt* cancel_token = nullptr);
+
+/**
+ * @brief Probes several Footage files in a row with the same set of Decoders
+ *
+ * ProbeMedia() creates its Decoders for every file it probes. When probing many small files (image sequences, audio
+ * sample libraries), keeping a MediaProber around saves that setup for every file after the first.
+ */
+class MediaProber
+{
+public:
+  MediaProber(const QAtomicInt* cancel_token = nullptr);
+
+  /**
+   * @brief Probe a Footage file, behaves identically to ProbeMedia()
+   */
+  bool Probe(Footage* f);
+
+  /**
+   * @brief Analyze a Footage file, behaves identically to DeepProbeMedia()
+   */
+  bool DeepProbe(Footage* f);
+
+  /**
+   * @brief Total bytes read by every probe so far
+   */
+  qint64 bytes_read();
+
+private:
+  QList<DecoderPtr> decoders_;
+
+  const QAtomicInt* cancel_token_;
+};
+
+/**
+ * @brief Fully analyze a Footage file that has already been probed by ProbeMedia()
+ *
+ * ProbeMedia() only performs a fast, bounded analysis so that imported Footage shows up immediately. This function
+ * runs the Decoder's DeepProbe() to fill in exact metadata and sets the Footage to Footage::kReady. Decoders opened
+ * for kReady Footage can rely on this metadata and skip most of their own stream analysis. Like ProbeMedia(), the
+ * analysis is aborted as soon as cancel_token becomes non-zero.
+ *
+ * @return
+ *
+ * TRUE if the Footage was analyzed. FALSE if it hasn't been successfully probed or the analysis failed.
+ */
+bool DeepProbeMedia(Footage* f, const QAtomicInt* cancel_token = nullptr);
 
 }
 
@@ -0,0 +1,263 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodeworker.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QRunnable>
+
+#include "decodeworkerpool.h"
+#include "decoder/probeserver.h"
+#include "project/item/footage/videostream.h"
+
+namespace {
+
+// Milliseconds to wait for Olive's server
+const int kConnectTimeout = 10000;
+
+rational ReadRational(QDataStream& in)
+{
+  qint64 num, den;
+  in >> num >> den;
+  return rational(num, den);
+}
+
+}
+
+class DecodeWorker::RequestRunnable : public QRunnable
+{
+public:
+  RequestRunnable(DecodeWorker* worker, const QByteArray& message) :
+    worker_(worker),
+    message_(message)
+  {
+  }
+
+  virtual void run() override
+  {
+    // Replies start with the call ID their request started with
+    const int call_size = static_cast<int>(sizeof(quint64));
+
+    QByteArray reply = message_.left(call_size);
+    reply.append(worker_->HandleRequest(message_.mid(call_size)));
+
+    QMetaObject::invokeMethod(worker_, "SendReply", Qt::QueuedConnection, Q_ARG(QByteArray, reply));
+  }
+
+private:
+  DecodeWorker* worker_;
+
+  QByteArray message_;
+};
+
+DecodeWorker::DecodeWorker(QObject *parent) :
+  QObject(parent)
+{
+  connect(&socket_, SIGNAL(readyRead()), this, SLOT(ReadyRead()));
+  connect(&socket_, SIGNAL(disconnected()), this, SLOT(Disconnected()));
+}
+
+DecodeWorker::~DecodeWorker()
+{
+  thread_pool_.clear();
+  thread_pool_.waitForDone();
+}
+
+bool DecodeWorker::Start(const QString &server)
+{
+  socket_.connectToServer(server);
+
+  if (!socket_.waitForConnected(kConnectTimeout)) {
+    qWarning() << "Decode worker failed to connect to" << server << socket_.errorString();
+    return false;
+  }
+
+  // Say hello with our PID so Olive can kill this process if it stops responding
+  QByteArray hello;
+  QDataStream out(&hello, QIODevice::WriteOnly);
+  out << static_cast<quint64>(0) << static_cast<qint64>(QCoreApplication::applicationPid());
+
+  DecodeWorkerPool::WriteMessage(&socket_, hello);
+
+  return true;
+}
+
+QByteArray DecodeWorker::HandleRequest(const QByteArray &request)
+{
+  QDataStream in(request);
+
+  qint32 type, id;
+  in >> type >> id;
+
+  if (type == DecodeWorkerPool::kOpen) {
+    return Open(id, in);
+  }
+
+  SessionPtr session;
+
+  sessions_mutex_.lock();
+
+  if (type == DecodeWorkerPool::kClose) {
+    session = sessions_.take(id);
+  } else {
+    session = sessions_.value(id);
+  }
+
+  sessions_mutex_.unlock();
+
+  if (type == DecodeWorkerPool::kRetrieve) {
+    if (session) {
+      return Retrieve(session, in);
+    }
+
+    qWarning() << "Decode worker received request for unknown session" << id;
+
+    QByteArray reply;
+    QDataStream out(&reply, QIODevice::WriteOnly);
+    out << false;
+    return reply;
+  }
+
+  // The session is freed once it goes out of scope here
+  return QByteArray();
+}
+
+QByteArray DecodeWorker::Open(qint32 id, QDataStream &in)
+{
+  QString filename, proxy_filename;
+  qint32 stream_index, proxy_width, proxy_height, target_width, target_height, purpose, threading, thread_count;
+
+  in >> filename >> stream_index >> proxy_filename >> proxy_width >> proxy_height
+     >> target_width >> target_height >> purpose >> threading >> thread_count;
+
+  SessionPtr session = std::make_shared<Session>();
+  session->footage = std::make_shared<Footage>();
+  session->footage->set_filename(filename);
+
+  Stream* stream = nullptr;
+
+  // The probe cache usually has this file already from when Olive imported it
+  if (olive::ProbeMedia(session->footage.get())) {
+    for (int i=0;i<session->footage->stream_count();i++) {
+      if (session->footage->stream(i)->index() == stream_index) {
+        stream = session->footage->stream(i);
+        break;
+      }
+    }
+  }
+
+  bool ok = false;
+
+  if (stream) {
+    if (stream->type() == Stream::kVideo && !proxy_filename.isEmpty()) {
+      VideoStream* video_stream = static_cast<VideoStream*>(stream);
+
+      video_stream->set_proxy_filename(proxy_filename);
+      video_stream->set_proxy_resolution(proxy_width, proxy_height);
+    }
+
+    session->decoder = std::make_shared<FFmpegDecoder>();
+    session->decoder->set_stream(stream);
+    session->decoder->set_target_resolution(target_width, target_height);
+    session->decoder->set_purpose(static_cast<Decoder::Purpose>(purpose));
+    session->decoder->set_threading(static_cast<Decoder::ThreadingMode>(threading), thread_count);
+
+    ok = session->decoder->Open();
+  } else {
+    qWarning() << "Decode worker failed to find stream" << stream_index << "in" << filename;
+  }
+
+  if (ok) {
+    QMutexLocker locker(&sessions_mutex_);
+    sessions_.insert(id, session);
+  }
+
+  QByteArray reply;
+  QDataStream out(&reply, QIODevice::WriteOnly);
+  out << ok;
+  return reply;
+}
+
+QByteArray DecodeWorker::Retrieve(DecodeWorker::SessionPtr session, QDataStream &in)
+{
+  rational timecode = ReadRational(in);
+  rational length = ReadRational(in);
+
+  qint32 sample_rate;
+  in >> sample_rate;
+
+  session->decoder->set_output_sample_rate(sample_rate);
+
+  FramePtr frame = session->decoder->Retrieve(timecode, length);
+
+  QByteArray reply;
+  QDataStream out(&reply, QIODevice::WriteOnly);
+
+  out << static_cast<bool>(frame);
+
+  if (!frame) {
+    return reply;
+  }
+
+  FrameRing::Metadata meta = FrameRing::GetMetadata(frame.get());
+  int size = FrameRing::FrameSize(meta);
+
+  // Olive attaches to the new ring when the key changes, frames it still has from the old one keep that one alive
+  if (size > session->ring.slot_size() && !session->ring.Create(size)) {
+    qWarning() << "Decode worker failed to create frame ring of" << size << "bytes";
+  }
+
+  qint32 slot = session->ring.Write(frame.get(), meta);
+
+  out << meta << session->ring.key() << slot;
+
+  if (slot < 0) {
+    // Every slot is still in use by Olive (or there's no ring), so the frame goes with the reply
+    QByteArray data(size, Qt::Uninitialized);
+    FrameRing::CopyFrame(frame.get(), meta, reinterpret_cast<uint8_t*>(data.data()));
+    out << data;
+  }
+
+  return reply;
+}
+
+void DecodeWorker::ReadyRead()
+{
+  buffer_.append(socket_.readAll());
+
+  QByteArray message;
+
+  while (DecodeWorkerPool::ReadMessage(&buffer_, &message)) {
+    thread_pool_.start(new RequestRunnable(this, message));
+  }
+}
+
+void DecodeWorker::Disconnected()
+{
+  // Olive has quit, stopped decoding in workers or given up on this one
+  thread_pool_.clear();
+  QCoreApplication::exit(0);
+}
+
+void DecodeWorker::SendReply(const QByteArray &reply)
+{
+  DecodeWorkerPool::WriteMessage(&socket_, reply);
+}
@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODEWORKER_H
+#define DECODEWORKER_H
+
+#include <memory>
+#include <QDataStream>
+#include <QLocalSocket>
+#include <QMap>
+#include <QMutex>
+#include <QThreadPool>
+
+#include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "framering.h"
+
+/**
+ * @brief The decoding side of a decode worker process (olive --decode-worker <server>)
+ *
+ * Connects to the DecodeWorkerPool of the Olive that started this process and runs the sessions RemoteDecoders open
+ * on it, each with an FFmpegDecoder of its own. Requests run on a thread pool so sessions decode in parallel, and
+ * decoded frames are copied into the session's FrameRing for Olive to read. The process quits once Olive disconnects.
+ */
+class DecodeWorker : public QObject
+{
+  Q_OBJECT
+public:
+  DecodeWorker(QObject* parent = nullptr);
+
+  virtual ~DecodeWorker() override;
+
+  /**
+   * @brief Connect to a DecodeWorkerPool's server
+   */
+  bool Start(const QString& server);
+
+private:
+  class RequestRunnable;
+
+  struct Session {
+    FootagePtr footage;
+    std::shared_ptr<FFmpegDecoder> decoder;
+    FrameRing ring;
+  };
+
+  using SessionPtr = std::shared_ptr<Session>;
+
+  /**
+   * @brief Handle a request from a RemoteDecoder (called on the thread pool)
+   *
+   * @return
+   *
+   * The reply.
+   */
+  QByteArray HandleRequest(const QByteArray& request);
+
+  QByteArray Open(qint32 id, QDataStream& in);
+
+  QByteArray Retrieve(SessionPtr session, QDataStream& in);
+
+  QLocalSocket socket_;
+
+  // Received data that isn't a complete message yet
+  QByteArray buffer_;
+
+  QThreadPool thread_pool_;
+
+  QMap<qint32, SessionPtr> sessions_;
+
+  QMutex sessions_mutex_;
+
+private slots:
+  void ReadyRead();
+
+  void Disconnected();
+
+  void SendReply(const QByteArray& reply);
+};
+
+#endif // DECODEWORKER_H
@@ -0,0 +1,470 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodeworkerpool.h"
+
+#include <climits>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtEndian>
+
+DecodeWorkerPool olive::decode_worker_pool;
+
+DecodeWorkerPool::DecodeWorkerPool() :
+  server_(nullptr),
+  worker_count_(0),
+  next_worker_(1),
+  next_call_(1)
+{
+}
+
+DecodeWorkerPool::~DecodeWorkerPool()
+{
+  if (thread_.isRunning()) {
+    thread_.quit();
+    thread_.wait();
+  }
+}
+
+void DecodeWorkerPool::SetWorkerCount(int count)
+{
+  if (count > 0 && !thread_.isRunning()) {
+    moveToThread(&thread_);
+    thread_.start();
+  }
+
+  if (!thread_.isRunning()) {
+    return;
+  }
+
+  QMetaObject::invokeMethod(this, "StartWorkers", Qt::BlockingQueuedConnection, Q_ARG(int, count));
+
+  if (count == 0) {
+    thread_.quit();
+    thread_.wait();
+  }
+}
+
+bool DecodeWorkerPool::IsEnabled()
+{
+  QMutexLocker locker(&mutex_);
+
+  return worker_count_ > 0;
+}
+
+quint64 DecodeWorkerPool::AssignWorker()
+{
+  QMutexLocker locker(&mutex_);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Workers may still be starting up
+  while (worker_count_ > 0 && workers_.isEmpty()) {
+    qint64 remaining = kConnectTimeout - timer.elapsed();
+
+    if (remaining <= 0) {
+      break;
+    }
+
+    changed_.wait(&mutex_, static_cast<unsigned long>(remaining));
+  }
+
+  quint64 best = 0;
+  int fewest = INT_MAX;
+
+  for (QMap<quint64, Worker>::const_iterator i=workers_.constBegin();i!=workers_.constEnd();i++) {
+    if (i->sessions < fewest) {
+      best = i.key();
+      fewest = i->sessions;
+    }
+  }
+
+  if (best > 0) {
+    workers_[best].sessions++;
+  }
+
+  return best;
+}
+
+void DecodeWorkerPool::ReleaseWorker(quint64 worker)
+{
+  QMutexLocker locker(&mutex_);
+
+  QMap<quint64, Worker>::iterator i = workers_.find(worker);
+
+  if (i != workers_.end()) {
+    i->sessions--;
+  }
+}
+
+bool DecodeWorkerPool::Call(quint64 worker, const QByteArray &request, QByteArray *reply)
+{
+  PendingCall pending;
+  pending.worker = worker;
+  pending.done = false;
+  pending.ok = false;
+
+  quint64 call;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    if (!workers_.contains(worker)) {
+      return false;
+    }
+
+    call = next_call_++;
+    pending_.insert(call, &pending);
+  }
+
+  // Every message to a worker starts with the call ID that its reply will start with too
+  QByteArray message;
+  QDataStream out(&message, QIODevice::WriteOnly);
+  out << call;
+  message.append(request);
+
+  QMetaObject::invokeMethod(this,
+                            "SendMessage",
+                            Qt::QueuedConnection,
+                            Q_ARG(quint64, worker),
+                            Q_ARG(QByteArray, message));
+
+  QMutexLocker locker(&mutex_);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  while (!pending.done) {
+    qint64 remaining = kCallTimeout - timer.elapsed();
+
+    if (remaining <= 0) {
+      break;
+    }
+
+    changed_.wait(&mutex_, static_cast<unsigned long>(remaining));
+  }
+
+  pending_.remove(call);
+
+  if (!pending.done) {
+    locker.unlock();
+
+    qWarning() << "Decode worker" << worker << "stopped responding, restarting it";
+
+    QMetaObject::invokeMethod(this, "DropWorker", Qt::QueuedConnection, Q_ARG(quint64, worker));
+
+    return false;
+  }
+
+  if (pending.ok) {
+    *reply = pending.reply;
+  }
+
+  return pending.ok;
+}
+
+void DecodeWorkerPool::WriteMessage(QIODevice *device, const QByteArray &message)
+{
+  uchar length[sizeof(quint32)];
+  qToBigEndian<quint32>(static_cast<quint32>(message.size()), length);
+
+  device->write(reinterpret_cast<const char*>(length), static_cast<qint64>(sizeof(length)));
+  device->write(message);
+}
+
+bool DecodeWorkerPool::ReadMessage(QByteArray *buffer, QByteArray *message)
+{
+  const int header_size = static_cast<int>(sizeof(quint32));
+
+  if (buffer->size() < header_size) {
+    return false;
+  }
+
+  int length = static_cast<int>(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer->constData())));
+
+  if (buffer->size() < header_size + length) {
+    return false;
+  }
+
+  *message = buffer->mid(header_size, length);
+  buffer->remove(0, header_size + length);
+
+  return true;
+}
+
+void DecodeWorkerPool::FailCalls(quint64 worker)
+{
+  foreach (PendingCall* pending, pending_) {
+    if (pending->worker == worker && !pending->done) {
+      pending->done = true;
+      pending->ok = false;
+    }
+  }
+}
+
+void DecodeWorkerPool::StartWorkers(int count)
+{
+  {
+    QMutexLocker locker(&mutex_);
+
+    worker_count_ = count;
+  }
+
+  if (count > 0) {
+    if (!server_) {
+      QString name = QStringLiteral("olive-decode-%1").arg(QCoreApplication::applicationPid());
+
+      // Left behind if a previous Olive with the same PID crashed
+      QLocalServer::removeServer(name);
+
+      server_ = new QLocalServer(this);
+
+      if (!server_->listen(name)) {
+        qWarning() << "Failed to start decode worker server:" << server_->errorString();
+
+        delete server_;
+        server_ = nullptr;
+
+        QMutexLocker locker(&mutex_);
+        worker_count_ = 0;
+
+        return;
+      }
+
+      connect(server_, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+    }
+
+    while (processes_.size() < count) {
+      StartProcess();
+    }
+
+    // Sessions on the workers stopped here are opened again on the others
+    while (processes_.size() > count) {
+      QProcess* process = processes_.takeLast();
+      process->disconnect(this);
+      process->kill();
+      process->waitForFinished();
+      delete process;
+    }
+
+    return;
+  }
+
+  foreach (QProcess* process, processes_) {
+    process->disconnect(this);
+    process->kill();
+    process->waitForFinished();
+    delete process;
+  }
+  processes_.clear();
+
+  for (QHash<QLocalSocket*, quint64>::const_iterator i=socket_workers_.constBegin();
+       i!=socket_workers_.constEnd();
+       i++) {
+    i.key()->disconnect(this);
+    i.key()->abort();
+    delete i.key();
+  }
+  socket_workers_.clear();
+
+  delete server_;
+  server_ = nullptr;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    foreach (PendingCall* pending, pending_) {
+      pending->done = true;
+      pending->ok = false;
+    }
+
+    workers_.clear();
+  }
+
+  changed_.wakeAll();
+
+  // Hand ourselves back to the main thread so SetWorkerCount() can move us to a new thread next time
+  moveToThread(QCoreApplication::instance()->thread());
+}
+
+void DecodeWorkerPool::StartProcess()
+{
+  QProcess* process = new QProcess(this);
+
+  // Warnings from workers are passed on as they are
+  process->setProcessChannelMode(QProcess::ForwardedChannels);
+
+  connect(process,
+          SIGNAL(finished(int, QProcess::ExitStatus)),
+          this,
+          SLOT(ProcessFinished(int, QProcess::ExitStatus)));
+
+  process->start(QCoreApplication::applicationFilePath(),
+                 QStringList() << QStringLiteral("--decode-worker") << server_->serverName());
+
+  processes_.append(process);
+}
+
+void DecodeWorkerPool::DropWorker(quint64 worker)
+{
+  QLocalSocket* socket;
+  qint64 pid;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    QMap<quint64, Worker>::const_iterator i = workers_.constFind(worker);
+
+    if (i == workers_.constEnd()) {
+      return;
+    }
+
+    socket = i->socket;
+    pid = i->pid;
+  }
+
+  // Killing the process restarts it in ProcessFinished()
+  foreach (QProcess* process, processes_) {
+    if (pid > 0 && process->processId() == pid) {
+      process->kill();
+    }
+  }
+
+  socket->abort();
+}
+
+void DecodeWorkerPool::SendMessage(quint64 worker, const QByteArray &message)
+{
+  QMutexLocker locker(&mutex_);
+
+  QMap<quint64, Worker>::const_iterator i = workers_.constFind(worker);
+
+  if (i == workers_.constEnd()) {
+    // Disconnected since the call was made
+    FailCalls(worker);
+    changed_.wakeAll();
+    return;
+  }
+
+  WriteMessage(i->socket, message);
+}
+
+void DecodeWorkerPool::NewConnection()
+{
+  while (server_->hasPendingConnections()) {
+    QLocalSocket* socket = server_->nextPendingConnection();
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(SocketReadyRead()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(SocketDisconnected()));
+
+    Worker w;
+    w.socket = socket;
+    w.pid = 0;
+    w.sessions = 0;
+
+    QMutexLocker locker(&mutex_);
+
+    quint64 id = next_worker_++;
+    workers_.insert(id, w);
+    socket_workers_.insert(socket, id);
+  }
+
+  changed_.wakeAll();
+}
+
+void DecodeWorkerPool::SocketReadyRead()
+{
+  QLocalSocket* socket = static_cast<QLocalSocket*>(sender());
+  quint64 worker = socket_workers_.value(socket);
+
+  QMutexLocker locker(&mutex_);
+
+  QMap<quint64, Worker>::iterator i = workers_.find(worker);
+
+  if (i == workers_.end()) {
+    return;
+  }
+
+  i->buffer.append(socket->readAll());
+
+  QByteArray message;
+
+  while (ReadMessage(&i->buffer, &message)) {
+    QDataStream in(message);
+
+    quint64 call;
+    in >> call;
+
+    if (call == 0) {
+      // Workers say hello with their PID when they connect
+      in >> i->pid;
+      continue;
+    }
+
+    PendingCall* pending = pending_.value(call);
+
+    if (pending && pending->worker == worker) {
+      pending->reply = message.mid(static_cast<int>(sizeof(quint64)));
+      pending->ok = true;
+      pending->done = true;
+    }
+  }
+
+  changed_.wakeAll();
+}
+
+void DecodeWorkerPool::SocketDisconnected()
+{
+  QLocalSocket* socket = static_cast<QLocalSocket*>(sender());
+  quint64 worker = socket_workers_.take(socket);
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    workers_.remove(worker);
+    FailCalls(worker);
+  }
+
+  changed_.wakeAll();
+
+  socket->deleteLater();
+}
+
+void DecodeWorkerPool::ProcessFinished(int exit_code, QProcess::ExitStatus exit_status)
+{
+  QProcess* process = static_cast<QProcess*>(sender());
+
+  if (!processes_.contains(process)) {
+    return;
+  }
+
+  processes_.removeOne(process);
+  process->deleteLater();
+
+  if (exit_status == QProcess::CrashExit) {
+    qWarning() << "Decode worker crashed, restarting it";
+    StartProcess();
+  } else {
+    qWarning() << "Decode worker exited with code" << exit_code;
+  }
+}
@@ -0,0 +1,204 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODEWORKERPOOL_H
+#define DECODEWORKERPOOL_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QMutex>
+#include <QProcess>
+#include <QThread>
+#include <QWaitCondition>
+
+/**
+ * @brief Decode worker processes that RemoteDecoders hand their decoding to
+ *
+ * Off by default. With SetWorkerCount(), Olive starts copies of itself with --decode-worker (see DecodeWorker) that
+ * connect back through a QLocalServer. Each RemoteDecoder opens a session on the worker with the fewest sessions and
+ * sends it requests with Call(). Decoded frames come back through shared memory (see FrameRing).
+ *
+ * Decoding in other processes means a codec that crashes or leaks only takes down a worker (which is restarted, and
+ * the RemoteDecoders using it open their sessions again on another one), codecs with process-wide locks don't
+ * serialize every decoder in Olive, and on workstations with many cores the workers can be given cores of their own
+ * (e.g. with --affinity) without competing with the UI process's threads.
+ *
+ * Sockets are only ever touched on a thread of the pool's own, so Call() can be used from any thread.
+ */
+class DecodeWorkerPool : public QObject
+{
+  Q_OBJECT
+public:
+  enum MessageType {
+    /// Open a decoder for a stream in a new session
+    kOpen,
+
+    /// Retrieve a frame from a session's decoder
+    kRetrieve,
+
+    /// Close a session
+    kClose
+  };
+
+  DecodeWorkerPool();
+
+  virtual ~DecodeWorkerPool() override;
+
+  /**
+   * @brief Start this many worker processes, or stop them all with 0 (the default) to decode in this process
+   *
+   * Must be called from the main thread.
+   */
+  void SetWorkerCount(int count);
+
+  /**
+   * @brief Returns TRUE if decoding should be handed to workers
+   */
+  bool IsEnabled();
+
+  /**
+   * @brief Pick the connected worker with the fewest sessions for a new session
+   *
+   * Waits up to kConnectTimeout for a worker to connect if none has yet.
+   *
+   * @return
+   *
+   * The worker's ID, or 0 if there's none.
+   */
+  quint64 AssignWorker();
+
+  /**
+   * @brief A session assigned with AssignWorker() has been closed
+   */
+  void ReleaseWorker(quint64 worker);
+
+  /**
+   * @brief Send a request to a worker and wait for its reply
+   *
+   * @return
+   *
+   * FALSE if the worker has gone or didn't reply within kCallTimeout (in which case it's restarted).
+   */
+  bool Call(quint64 worker, const QByteArray& request, QByteArray* reply);
+
+  /**
+   * @brief Send a message preceded by its length
+   */
+  static void WriteMessage(QIODevice* device, const QByteArray& message);
+
+  /**
+   * @brief Take a complete message written by WriteMessage() from the start of `buffer`
+   *
+   * @return
+   *
+   * FALSE if the buffer doesn't hold a complete message yet.
+   */
+  static bool ReadMessage(QByteArray* buffer, QByteArray* message);
+
+  /**
+   * @brief Milliseconds a worker has to reply to a request
+   */
+  static const int kCallTimeout = 30000;
+
+  /**
+   * @brief Milliseconds AssignWorker() waits for a worker to connect
+   */
+  static const int kConnectTimeout = 10000;
+
+private:
+  struct Worker {
+    QLocalSocket* socket;
+
+    // Received data that isn't a complete message yet (only used on the pool's thread)
+    QByteArray buffer;
+
+    // Process ID the worker said hello with
+    qint64 pid;
+
+    int sessions;
+  };
+
+  struct PendingCall {
+    quint64 worker;
+    bool done;
+    bool ok;
+    QByteArray reply;
+  };
+
+  /**
+   * @brief Fail every call waiting on a worker (mutex_ must be locked)
+   */
+  void FailCalls(quint64 worker);
+
+  QThread thread_;
+
+  // Only used on the pool's thread
+  QLocalServer* server_;
+  QList<QProcess*> processes_;
+  QHash<QLocalSocket*, quint64> socket_workers_;
+
+  // Protected by mutex_
+  int worker_count_;
+  QMap<quint64, Worker> workers_;
+  QHash<quint64, PendingCall*> pending_;
+  quint64 next_worker_;
+  quint64 next_call_;
+
+  QMutex mutex_;
+
+  // Woken when a worker connects or a call completes
+  QWaitCondition changed_;
+
+private slots:
+  /**
+   * @brief Start the server and worker processes (or stop them if `count` is 0) on the pool's thread
+   */
+  void StartWorkers(int count);
+
+  void StartProcess();
+
+  /**
+   * @brief Kill a worker that stopped responding
+   */
+  void DropWorker(quint64 worker);
+
+  void SendMessage(quint64 worker, const QByteArray& message);
+
+  void NewConnection();
+
+  void SocketReadyRead();
+
+  void SocketDisconnected();
+
+  void ProcessFinished(int exit_code, QProcess::ExitStatus exit_status);
+};
+
+namespace olive {
+/**
+ * @brief Application-wide decode worker pool
+ */
+extern DecodeWorkerPool decode_worker_pool;
+}
+
+#endif // DECODEWORKERPOOL_H
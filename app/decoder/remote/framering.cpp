@@ -0,0 +1,340 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framering.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <cstring>
+
+namespace {
+
+// Makes every segment a worker creates unique, together with its process ID
+QAtomicInt segment_counter;
+
+}
+
+FrameRing::Metadata::Metadata() :
+  audio(false),
+  width(0),
+  height(0),
+  sample_count(0),
+  channels(0),
+  format(-1),
+  colorspace(AVCOL_SPC_UNSPECIFIED),
+  color_range(AVCOL_RANGE_UNSPECIFIED),
+  timestamp_num(0),
+  timestamp_den(1)
+{
+}
+
+FrameRing::FrameRing()
+{
+}
+
+FrameRing::~FrameRing()
+{
+  Detach();
+}
+
+bool FrameRing::Create(int slot_size)
+{
+  Detach();
+
+  slot_size = FFALIGN(slot_size, kAlignment);
+
+  QString key = QStringLiteral("olive-frames-%1-%2").arg(QString::number(QCoreApplication::applicationPid()),
+                                                         QString::number(segment_counter.fetchAndAddRelaxed(1)));
+
+  std::shared_ptr<QSharedMemory> memory = std::make_shared<QSharedMemory>(key);
+
+  if (!memory->create(HeaderSize() + kSlotCount * slot_size)) {
+    return false;
+  }
+
+  memory_ = memory;
+  key_ = key;
+
+  Header* h = header();
+
+  for (int i=0;i<kSlotCount;i++) {
+    h->state[i].store(kSlotFree);
+  }
+
+  h->slot_size = slot_size;
+
+  return true;
+}
+
+bool FrameRing::Attach(const QString &key)
+{
+  Detach();
+
+  std::shared_ptr<QSharedMemory> memory = std::make_shared<QSharedMemory>(key);
+
+  if (!memory->attach()) {
+    return false;
+  }
+
+  memory_ = memory;
+  key_ = key;
+
+  return true;
+}
+
+void FrameRing::Detach()
+{
+  // Frames read from the segment keep it attached until they're destroyed
+  memory_ = nullptr;
+  key_.clear();
+}
+
+bool FrameRing::IsValid() const
+{
+  return memory_ != nullptr;
+}
+
+const QString &FrameRing::key() const
+{
+  return key_;
+}
+
+int FrameRing::slot_size() const
+{
+  return IsValid() ? header()->slot_size : 0;
+}
+
+FrameRing::Metadata FrameRing::GetMetadata(Frame *frame)
+{
+  Metadata meta;
+
+  meta.audio = (frame->width() == 0 && frame->sample_count() > 0);
+  meta.width = frame->width();
+  meta.height = frame->height();
+  meta.sample_count = frame->sample_count();
+  meta.channels = frame->channels();
+  meta.format = frame->format();
+  meta.colorspace = frame->colorspace();
+  meta.color_range = frame->color_range();
+
+  rational timestamp = frame->timestamp();
+  meta.timestamp_num = timestamp.numerator();
+  meta.timestamp_den = timestamp.denominator();
+
+  return meta;
+}
+
+int FrameRing::FrameSize(const FrameRing::Metadata &meta)
+{
+  if (meta.audio) {
+    return av_samples_get_buffer_size(nullptr, meta.channels, meta.sample_count,
+                                      static_cast<AVSampleFormat>(meta.format), kAlignment);
+  }
+
+  return av_image_get_buffer_size(static_cast<AVPixelFormat>(meta.format), meta.width, meta.height, kAlignment);
+}
+
+void FrameRing::CopyFrame(Frame *frame, const FrameRing::Metadata &meta, uint8_t *dst)
+{
+  if (meta.audio) {
+    uint8_t* dst_data[AV_NUM_DATA_POINTERS];
+    int dst_linesize;
+
+    av_samples_fill_arrays(dst_data, &dst_linesize, dst, meta.channels, meta.sample_count,
+                           static_cast<AVSampleFormat>(meta.format), kAlignment);
+
+    av_samples_copy(dst_data, frame->data(), 0, 0, meta.sample_count, meta.channels,
+                    static_cast<AVSampleFormat>(meta.format));
+  } else {
+    av_image_copy_to_buffer(dst, FrameSize(meta), frame->data(), frame->linesize(),
+                            static_cast<AVPixelFormat>(meta.format), meta.width, meta.height, kAlignment);
+  }
+}
+
+FramePtr FrameRing::CopyToFrame(const FrameRing::Metadata &meta, const uint8_t *data)
+{
+  int size = FrameSize(meta);
+
+  if (size <= 0) {
+    return nullptr;
+  }
+
+  AVBufferRef* buffer = av_buffer_alloc(size);
+
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+
+  memcpy(buffer->data, data, static_cast<size_t>(size));
+
+  return WrapFrame(meta, buffer);
+}
+
+int FrameRing::Write(Frame *frame, const FrameRing::Metadata &meta)
+{
+  if (!IsValid()) {
+    return -1;
+  }
+
+  int size = FrameSize(meta);
+
+  if (size <= 0 || size > slot_size()) {
+    return -1;
+  }
+
+  Header* h = header();
+
+  for (int i=0;i<kSlotCount;i++) {
+    // Slots are freed by Olive once it's done with their frame
+    if (h->state[i].testAndSetAcquire(kSlotFree, kSlotInUse)) {
+      CopyFrame(frame, meta, slot_data(i));
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+FramePtr FrameRing::Read(const FrameRing::Metadata &meta, int slot)
+{
+  int size = FrameSize(meta);
+
+  if (!IsValid() || slot < 0 || slot >= kSlotCount || size <= 0 || size > slot_size()) {
+    return nullptr;
+  }
+
+  SlotReference* ref = new SlotReference();
+  ref->memory = memory_;
+  ref->state = &header()->state[slot];
+
+  AVBufferRef* buffer = av_buffer_create(slot_data(slot), size, FreeSlot, ref, 0);
+
+  if (buffer == nullptr) {
+    FreeSlot(ref, nullptr);
+    return nullptr;
+  }
+
+  return WrapFrame(meta, buffer);
+}
+
+int FrameRing::HeaderSize()
+{
+  return FFALIGN(static_cast<int>(sizeof(Header)), kAlignment);
+}
+
+FramePtr FrameRing::WrapFrame(const FrameRing::Metadata &meta, AVBufferRef *buffer)
+{
+  AVFrame* f = av_frame_alloc();
+
+  if (f == nullptr) {
+    av_buffer_unref(&buffer);
+    return nullptr;
+  }
+
+  f->buf[0] = buffer;
+  f->format = meta.format;
+  f->colorspace = meta.colorspace;
+  f->color_range = meta.color_range;
+  f->pts = meta.timestamp_num;
+
+  if (meta.audio) {
+    f->nb_samples = meta.sample_count;
+    f->channels = meta.channels;
+    f->channel_layout = av_get_default_channel_layout(meta.channels);
+
+    av_samples_fill_arrays(f->data, f->linesize, buffer->data, meta.channels, meta.sample_count,
+                           static_cast<AVSampleFormat>(meta.format), kAlignment);
+  } else {
+    f->width = meta.width;
+    f->height = meta.height;
+
+    av_image_fill_arrays(f->data, f->linesize, buffer->data, static_cast<AVPixelFormat>(meta.format), meta.width,
+                         meta.height, kAlignment);
+  }
+
+  FramePtr frame = std::make_shared<Frame>();
+
+  frame->SetAVFrame(f, av_make_q(1, static_cast<int>(meta.timestamp_den)));
+
+  return frame;
+}
+
+void FrameRing::FreeSlot(void *opaque, uint8_t *data)
+{
+  Q_UNUSED(data)
+
+  SlotReference* ref = static_cast<SlotReference*>(opaque);
+
+  ref->state->storeRelease(kSlotFree);
+
+  delete ref;
+}
+
+FrameRing::Header *FrameRing::header() const
+{
+  return static_cast<Header*>(memory_->data());
+}
+
+uint8_t *FrameRing::slot_data(int slot) const
+{
+  return static_cast<uint8_t*>(memory_->data()) + HeaderSize() + slot * header()->slot_size;
+}
+
+QDataStream &operator<<(QDataStream &out, const FrameRing::Metadata &meta)
+{
+  out << meta.audio
+      << static_cast<qint32>(meta.width)
+      << static_cast<qint32>(meta.height)
+      << static_cast<qint32>(meta.sample_count)
+      << static_cast<qint32>(meta.channels)
+      << static_cast<qint32>(meta.format)
+      << static_cast<qint32>(meta.colorspace)
+      << static_cast<qint32>(meta.color_range)
+      << static_cast<qint64>(meta.timestamp_num)
+      << static_cast<qint64>(meta.timestamp_den);
+
+  return out;
+}
+
+QDataStream &operator>>(QDataStream &in, FrameRing::Metadata &meta)
+{
+  qint32 width, height, sample_count, channels, format, colorspace, color_range;
+  qint64 timestamp_num, timestamp_den;
+
+  in >> meta.audio >> width >> height >> sample_count >> channels >> format >> colorspace >> color_range
+     >> timestamp_num >> timestamp_den;
+
+  meta.width = width;
+  meta.height = height;
+  meta.sample_count = sample_count;
+  meta.channels = channels;
+  meta.format = format;
+  meta.colorspace = static_cast<AVColorSpace>(colorspace);
+  meta.color_range = static_cast<AVColorRange>(color_range);
+  meta.timestamp_num = timestamp_num;
+  meta.timestamp_den = (timestamp_den > 0) ? timestamp_den : 1;
+
+  return in;
+}
@@ -0,0 +1,194 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <memory>
+#include <QDataStream>
+#include <QSharedMemory>
+#include <QString>
+
+#include "decoder/frame.h"
+
+/**
+ * @brief A ring of frame slots in shared memory, for handing decoded frames from a decode worker process to Olive
+ *
+ * The worker creates the ring (see Create()) and copies each frame it decodes into a free slot with Write(). Olive
+ * attaches to it (see Attach()) and Read() returns a Frame that points straight into the slot, so the frame's data
+ * is only copied once, by the worker. The slot is handed back to the worker once the last reference to the Frame is
+ * gone, so frames held for a long time (e.g. in a cache) keep their slot busy and the worker falls back to sending
+ * frames through its socket when none are free.
+ *
+ * Which slots are in use is kept in atomics at the start of the segment, so neither side ever waits on the other.
+ * Olive keeps a segment attached while any of its frames are alive, so a worker exiting or crashing never pulls
+ * memory out from under a frame.
+ */
+class FrameRing
+{
+public:
+  /**
+   * @brief What's needed to interpret a frame's data, which is laid out as by av_image_fill_arrays() (video) or
+   * av_samples_fill_arrays() (audio) with kAlignment
+   */
+  struct Metadata {
+    Metadata();
+
+    bool audio;
+
+    int width;
+    int height;
+    int sample_count;
+    int channels;
+    int format;
+
+    AVColorSpace colorspace;
+    AVColorRange color_range;
+
+    // Timestamp in seconds
+    int64_t timestamp_num;
+    int64_t timestamp_den;
+  };
+
+  FrameRing();
+
+  ~FrameRing();
+
+  FrameRing(const FrameRing& other) = delete;
+  FrameRing(FrameRing&& other) = delete;
+  FrameRing& operator=(const FrameRing& other) = delete;
+  FrameRing& operator=(FrameRing&& other) = delete;
+
+  /**
+   * @brief Create a new segment with a unique key (in the worker), freeing any previous one
+   */
+  bool Create(int slot_size);
+
+  /**
+   * @brief Attach to a segment created by a worker, detaching from any previous one (frames keep theirs alive)
+   */
+  bool Attach(const QString& key);
+
+  void Detach();
+
+  bool IsValid() const;
+
+  const QString& key() const;
+
+  /**
+   * @brief Bytes each slot holds
+   */
+  int slot_size() const;
+
+  /**
+   * @brief Describe a Frame so it can be read back on the other side
+   */
+  static Metadata GetMetadata(Frame* frame);
+
+  /**
+   * @brief Bytes a frame's data takes laid out as described by Metadata
+   */
+  static int FrameSize(const Metadata& meta);
+
+  /**
+   * @brief Copy a frame's data into `dst` (which must hold FrameSize() bytes)
+   */
+  static void CopyFrame(Frame* frame, const Metadata& meta, uint8_t* dst);
+
+  /**
+   * @brief Create a Frame with a copy of data laid out as described by Metadata (e.g. received through a socket)
+   */
+  static FramePtr CopyToFrame(const Metadata& meta, const uint8_t* data);
+
+  /**
+   * @brief Copy a frame into a free slot
+   *
+   * @return
+   *
+   * The slot, or -1 if every slot is in use or the frame doesn't fit.
+   */
+  int Write(Frame* frame, const Metadata& meta);
+
+  /**
+   * @brief Returns a Frame referencing the data in a slot, the slot is freed once it's destroyed
+   */
+  FramePtr Read(const Metadata& meta, int slot);
+
+  /**
+   * @brief Number of slots in a ring
+   */
+  static const int kSlotCount = 4;
+
+  /**
+   * @brief Alignment of rows, planes and slots
+   */
+  static const int kAlignment = 64;
+
+private:
+  enum SlotState {
+    kSlotFree,
+    kSlotInUse
+  };
+
+  /**
+   * @brief Start of the segment
+   */
+  struct Header {
+    QBasicAtomicInt state[kSlotCount];
+    qint32 slot_size;
+  };
+
+  /**
+   * @brief What a Frame read from a slot holds on to until its data is freed
+   */
+  struct SlotReference {
+    std::shared_ptr<QSharedMemory> memory;
+    QBasicAtomicInt* state;
+  };
+
+  /**
+   * @brief Bytes before the first slot
+   */
+  static int HeaderSize();
+
+  /**
+   * @brief Fill in an AVFrame for data laid out as described by Metadata and wrap it in a Frame
+   */
+  static FramePtr WrapFrame(const Metadata& meta, AVBufferRef* buffer);
+
+  /**
+   * @brief AVBuffer free callback of frames read from a slot
+   */
+  static void FreeSlot(void* opaque, uint8_t* data);
+
+  Header* header() const;
+
+  uint8_t* slot_data(int slot) const;
+
+  // Shared with the Frames read from it, so the segment stays attached while they're alive
+  std::shared_ptr<QSharedMemory> memory_;
+
+  QString key_;
+};
+
+QDataStream& operator<<(QDataStream& out, const FrameRing::Metadata& meta);
+QDataStream& operator>>(QDataStream& in, FrameRing::Metadata& meta);
+
+#endif // FRAMERING_H
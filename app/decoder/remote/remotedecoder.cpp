@@ -0,0 +1,243 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "remotedecoder.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QMutexLocker>
+
+#include "decodeworkerpool.h"
+#include "render/performancecounters.h"
+#include "project/item/footage/videostream.h"
+
+namespace {
+
+void WriteRational(QDataStream& out, rational r)
+{
+  out << static_cast<qint64>(r.numerator()) << static_cast<qint64>(r.denominator());
+}
+
+}
+
+QAtomicInt RemoteDecoder::next_session_ = 1;
+
+RemoteDecoder::RemoteDecoder() :
+  worker_(0),
+  session_(0)
+{
+}
+
+RemoteDecoder::~RemoteDecoder()
+{
+  Close();
+}
+
+bool RemoteDecoder::Probe(Footage *f)
+{
+  Q_UNUSED(f)
+
+  return false;
+}
+
+bool RemoteDecoder::Open()
+{
+  QMutexLocker locker(&mutex_);
+
+  if (open_) {
+    return true;
+  }
+
+  open_ = OpenSession();
+
+  return open_;
+}
+
+FramePtr RemoteDecoder::Retrieve(const rational &timecode, const rational &length)
+{
+  // Includes the round trip to the worker, which is what decoding costs the caller
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kDecode);
+
+  QMutexLocker locker(&mutex_);
+
+  if (!open_) {
+    return nullptr;
+  }
+
+  FramePtr frame;
+
+  if (RetrieveFromWorker(timecode, length, &frame)) {
+    return frame;
+  }
+
+  // The worker died (and is being restarted), try once more on another one
+  CloseSession();
+
+  if (OpenSession() && RetrieveFromWorker(timecode, length, &frame)) {
+    return frame;
+  }
+
+  qWarning() << "Failed to retrieve frame from decode worker";
+
+  CloseSession();
+  open_ = false;
+
+  return nullptr;
+}
+
+void RemoteDecoder::Close()
+{
+  QMutexLocker locker(&mutex_);
+
+  CloseSession();
+  ring_.Detach();
+
+  open_ = false;
+}
+
+bool RemoteDecoder::OpenSession()
+{
+  worker_ = olive::decode_worker_pool.AssignWorker();
+
+  if (worker_ == 0) {
+    return false;
+  }
+
+  session_ = next_session_.fetchAndAddRelaxed(1);
+
+  Footage* footage = stream()->footage();
+
+  QString proxy_filename;
+  int proxy_width = 0;
+  int proxy_height = 0;
+
+  footage->Lock();
+
+  QString filename = footage->filename();
+
+  // The worker probes the file itself but doesn't know about proxies made here
+  if (stream()->type() == Stream::kVideo) {
+    VideoStream* video_stream = static_cast<VideoStream*>(stream());
+
+    proxy_filename = video_stream->proxy_filename();
+    proxy_width = video_stream->proxy_width();
+    proxy_height = video_stream->proxy_height();
+  }
+
+  footage->Unlock();
+
+  QByteArray request;
+  QDataStream out(&request, QIODevice::WriteOnly);
+
+  out << static_cast<qint32>(DecodeWorkerPool::kOpen)
+      << session_
+      << filename
+      << static_cast<qint32>(stream()->index())
+      << proxy_filename
+      << static_cast<qint32>(proxy_width)
+      << static_cast<qint32>(proxy_height)
+      << static_cast<qint32>(target_width_)
+      << static_cast<qint32>(target_height_)
+      << static_cast<qint32>(purpose_)
+      << static_cast<qint32>(threading_mode_)
+      << static_cast<qint32>(thread_count_);
+
+  QByteArray reply;
+  bool ok = false;
+
+  if (olive::decode_worker_pool.Call(worker_, request, &reply)) {
+    QDataStream in(reply);
+    in >> ok;
+  }
+
+  if (!ok) {
+    olive::decode_worker_pool.ReleaseWorker(worker_);
+    worker_ = 0;
+  }
+
+  return ok;
+}
+
+void RemoteDecoder::CloseSession()
+{
+  if (worker_ == 0) {
+    return;
+  }
+
+  QByteArray request;
+  QDataStream out(&request, QIODevice::WriteOnly);
+  out << static_cast<qint32>(DecodeWorkerPool::kClose) << session_;
+
+  QByteArray reply;
+  olive::decode_worker_pool.Call(worker_, request, &reply);
+  olive::decode_worker_pool.ReleaseWorker(worker_);
+
+  worker_ = 0;
+}
+
+bool RemoteDecoder::RetrieveFromWorker(const rational &timecode, const rational &length, FramePtr *frame)
+{
+  QByteArray request;
+  QDataStream out(&request, QIODevice::WriteOnly);
+
+  out << static_cast<qint32>(DecodeWorkerPool::kRetrieve) << session_;
+  WriteRational(out, timecode);
+  WriteRational(out, length);
+  out << static_cast<qint32>(output_sample_rate_);
+
+  QByteArray reply;
+
+  if (!olive::decode_worker_pool.Call(worker_, request, &reply)) {
+    return false;
+  }
+
+  QDataStream in(reply);
+
+  bool has_frame;
+  in >> has_frame;
+
+  if (!has_frame) {
+    *frame = nullptr;
+    return true;
+  }
+
+  FrameRing::Metadata meta;
+  QString key;
+  qint32 slot;
+
+  in >> meta >> key >> slot;
+
+  if (slot < 0) {
+    // The ring was full, so the frame came with the reply
+    QByteArray data;
+    in >> data;
+
+    *frame = FrameRing::CopyToFrame(meta, reinterpret_cast<const uint8_t*>(data.constData()));
+    return true;
+  }
+
+  if (ring_.key() != key && !ring_.Attach(key)) {
+    return false;
+  }
+
+  *frame = ring_.Read(meta, slot);
+
+  return true;
+}
@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef REMOTEDECODER_H
+#define REMOTEDECODER_H
+
+#include <QAtomicInt>
+#include <QMutex>
+
+#include "decoder/decoder.h"
+#include "framering.h"
+
+/**
+ * @brief A Decoder that has a decode worker process do its decoding
+ *
+ * Used by DecoderPool instead of FFmpegDecoder while olive::decode_worker_pool is enabled. Opening creates a session
+ * on a worker with an FFmpegDecoder set up like this one, and each Retrieve() asks the worker for a frame that arrives
+ * in the worker's FrameRing (or over the socket when the ring is full). If the worker dies, the session is opened
+ * again on another worker and the frame requested again.
+ */
+class RemoteDecoder : public Decoder
+{
+public:
+  RemoteDecoder();
+
+  virtual ~RemoteDecoder() override;
+
+  /**
+   * @brief Probing stays in this process, see ProbeMedia()
+   */
+  virtual bool Probe(Footage *f) override;
+
+  virtual bool Open() override;
+
+  virtual FramePtr Retrieve(const rational &timecode, const rational &length = 0) override;
+
+  virtual void Close() override;
+
+private:
+  /**
+   * @brief Create a session for our stream on the worker with the fewest sessions
+   */
+  bool OpenSession();
+
+  void CloseSession();
+
+  /**
+   * @brief Ask the worker for a frame
+   *
+   * @return
+   *
+   * FALSE if the worker has gone, in which case `frame` is left untouched.
+   */
+  bool RetrieveFromWorker(const rational &timecode, const rational &length, FramePtr* frame);
+
+  quint64 worker_;
+
+  qint32 session_;
+
+  // The worker's ring, attached again whenever it replaces it with a larger one
+  FrameRing ring_;
+
+  QMutex mutex_;
+
+  static QAtomicInt next_session_;
+};
+
+#endif // REMOTEDECODER_H
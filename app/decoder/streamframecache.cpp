@@ -0,0 +1,307 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "streamframecache.h"
+
+#include <QMutexLocker>
+
+#include "decoder/decoderpool.h"
+#include "project/item/footage/videostream.h"
+#include "render/pixelformatconverter.h"
+
+const qint64 StreamFrameCache::kDefaultBudget = Q_INT64_C(512) * 1024 * 1024;
+
+StreamFrameCache olive::stream_frame_cache;
+
+StreamFrameCache::StreamFrameCache() :
+  lru_head_(nullptr),
+  lru_tail_(nullptr),
+  budget_(kDefaultBudget),
+  used_bytes_(0),
+  hits_(0),
+  misses_(0)
+{
+}
+
+StreamFrameCache::~StreamFrameCache()
+{
+  Clear();
+}
+
+StreamFrameCache::BufferPtr StreamFrameCache::Get(VideoStream *stream,
+                                                  const rational &time,
+                                                  const olive::PixelFormat &format,
+                                                  int target_width,
+                                                  int target_height,
+                                                  Decoder::Purpose purpose)
+{
+  Key key = {stream, DecoderPool::WillUseProxy(stream, target_width, target_height), format};
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    Entry* e = Find(key, time);
+
+    if (e != nullptr) {
+      Touch(e);
+      hits_++;
+      return e->buffer;
+    }
+
+    misses_++;
+  }
+
+  DecoderPtr decoder = olive::decoder_pool.Acquire(stream, time, target_width, target_height, purpose);
+
+  if (decoder == nullptr) {
+    return nullptr;
+  }
+
+  FramePtr frame = decoder->Retrieve(time);
+
+  olive::decoder_pool.Release(decoder, time);
+
+  if (frame == nullptr) {
+    return nullptr;
+  }
+
+  std::shared_ptr<MemoryBuffer> buffer = std::make_shared<MemoryBuffer>();
+
+  {
+    AllocationCounters::ScopedTag tag(AllocationCounters::kStreamFrameCache);
+
+    buffer->Create(frame->width(), frame->height(), format);
+  }
+
+  if (!olive::pix_fmt_conv.Convert(frame.get(), format, buffer->data(), buffer->linesize())) {
+    return nullptr;
+  }
+
+  // The frame is the last one at or before the time, so it's shown from its timestamp until the next frame
+  stream->footage()->Lock();
+  rational frame_rate = stream->frame_rate();
+  stream->footage()->Unlock();
+
+  Entry* e = new Entry();
+  e->buffer = buffer;
+  e->key = key;
+  e->start = qMin(frame->timestamp(), time);
+  e->end = (!frame_rate) ? e->start : frame->timestamp() + rational(1) / frame_rate;
+  e->bytes = buffer->size();
+  e->lru_prev = nullptr;
+  e->lru_next = nullptr;
+
+  QMutexLocker locker(&mutex_);
+
+  if (e->bytes > budget_) {
+    delete e;
+    return buffer;
+  }
+
+  // Another thread decoded the same frame in the meantime, share its buffer instead
+  Entry* existing = Find(key, e->start);
+
+  if (existing != nullptr && existing->start == e->start) {
+    delete e;
+
+    Touch(existing);
+    return existing->buffer;
+  }
+
+  FreeForIncoming(e->bytes);
+
+  frames_[key].insert(e->start, e);
+  LRUAppend(e);
+  used_bytes_ += e->bytes;
+
+  return buffer;
+}
+
+void StreamFrameCache::Clear(Stream *stream)
+{
+  QMutexLocker locker(&mutex_);
+
+  Entry* e = lru_head_;
+
+  while (e != nullptr) {
+    Entry* next = e->lru_next;
+
+    if (e->key.stream == stream) {
+      RemoveEntry(e);
+    }
+
+    e = next;
+  }
+}
+
+void StreamFrameCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  while (lru_head_ != nullptr) {
+    RemoveEntry(lru_head_);
+  }
+}
+
+qint64 StreamFrameCache::budget()
+{
+  QMutexLocker locker(&mutex_);
+
+  return budget_;
+}
+
+void StreamFrameCache::set_budget(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  budget_ = bytes;
+
+  FreeForIncoming(0);
+}
+
+CacheStatistics StreamFrameCache::statistics()
+{
+  CacheStatistics s;
+
+  mutex_.lock();
+
+  s.used_bytes = used_bytes_;
+  s.budget = budget_;
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QHash<Stream*, qint64> bytes;
+  QHash<Stream*, int> entries;
+
+  for (Entry* e=lru_head_;e!=nullptr;e=e->lru_next) {
+    bytes[e->key.stream] += e->bytes;
+    entries[e->key.stream]++;
+    s.entries++;
+  }
+
+  mutex_.unlock();
+
+  // Footage can stay locked for a while (e.g. while it is probed), so don't hold up the cache waiting for it
+  QHash<Stream*, qint64>::const_iterator i;
+
+  for (i=bytes.constBegin();i!=bytes.constEnd();i++) {
+    Footage* footage = i.key()->footage();
+
+    footage->Lock();
+    QString filename = footage->filename();
+    footage->Unlock();
+
+    s.AddConsumer(QStringLiteral("%1 #%2").arg(filename, QString::number(i.key()->index())),
+                  i.value(),
+                  entries.value(i.key()));
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+StreamFrameCache::Entry *StreamFrameCache::Find(const Key &key, const rational &time)
+{
+  QHash< Key, QMap<rational, Entry*> >::iterator map = frames_.find(key);
+
+  if (map == frames_.end()) {
+    return nullptr;
+  }
+
+  // The last frame starting at or before the time is the only one that can cover it
+  QMap<rational, Entry*>::iterator i = map->upperBound(time);
+
+  if (i == map->begin()) {
+    return nullptr;
+  }
+
+  i--;
+
+  Entry* e = i.value();
+
+  if (time < e->end || time == e->start) {
+    return e;
+  }
+
+  return nullptr;
+}
+
+void StreamFrameCache::Touch(Entry *e)
+{
+  LRURemove(e);
+  LRUAppend(e);
+}
+
+void StreamFrameCache::LRURemove(Entry *e)
+{
+  if (e->lru_prev != nullptr) {
+    e->lru_prev->lru_next = e->lru_next;
+  } else {
+    lru_head_ = e->lru_next;
+  }
+
+  if (e->lru_next != nullptr) {
+    e->lru_next->lru_prev = e->lru_prev;
+  } else {
+    lru_tail_ = e->lru_prev;
+  }
+
+  e->lru_prev = nullptr;
+  e->lru_next = nullptr;
+}
+
+void StreamFrameCache::LRUAppend(Entry *e)
+{
+  e->lru_prev = lru_tail_;
+  e->lru_next = nullptr;
+
+  if (lru_tail_ != nullptr) {
+    lru_tail_->lru_next = e;
+  } else {
+    lru_head_ = e;
+  }
+
+  lru_tail_ = e;
+}
+
+void StreamFrameCache::FreeForIncoming(qint64 incoming)
+{
+  while (used_bytes_ + incoming > budget_ && lru_head_ != nullptr) {
+    RemoveEntry(lru_head_);
+  }
+}
+
+void StreamFrameCache::RemoveEntry(Entry *e)
+{
+  QHash< Key, QMap<rational, Entry*> >::iterator map = frames_.find(e->key);
+
+  map->remove(e->start);
+
+  if (map->isEmpty()) {
+    frames_.erase(map);
+  }
+
+  LRURemove(e);
+
+  used_bytes_ -= e->bytes;
+
+  delete e;
+}
@@ -0,0 +1,203 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef STREAMFRAMECACHE_H
+#define STREAMFRAMECACHE_H
+
+#include <memory>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+#include "common/cachestatistics.h"
+#include "common/rational.h"
+#include "decoder/decoder.h"
+#include "render/memorybuffer.h"
+
+class VideoStream;
+
+/**
+ * @brief A RAM cache of decoded and converted source frames, shared by everything that shows the same footage
+ *
+ * Frames are cached by Stream and the time span they're shown for, not by the sequence, clip or node that requested
+ * them, so several sequences (e.g. a selects reel and the master edit built from it) or several clips using the same
+ * range of a take only decode it once. A frame covers the times from its timestamp up to the next frame at the
+ * Stream's frame rate, so requests at any time within a frame (e.g. from sequences at different frame rates) share it.
+ *
+ * Frames are kept after pixel format conversion, since that's what every consumer needs before applying anything of
+ * its own. Frames decoded from a proxy and frames converted to different formats are cached separately. Once the cache
+ * exceeds its budget the least recently used frames are freed (buffers still referenced by a consumer stay alive
+ * until it lets go of them).
+ *
+ * Two threads requesting the same frame that isn't cached yet may both decode it, only one of them is kept.
+ *
+ * Use the application-wide olive::stream_frame_cache. All functions are thread-safe.
+ */
+class StreamFrameCache
+{
+public:
+  using BufferPtr = std::shared_ptr<const MemoryBuffer>;
+
+  /**
+   * @brief Bytes of frames kept by default
+   */
+  static const qint64 kDefaultBudget;
+
+  StreamFrameCache();
+
+  /**
+   * @brief Destructor, frees all frames
+   */
+  ~StreamFrameCache();
+
+  StreamFrameCache(const StreamFrameCache& other) = delete;
+  StreamFrameCache(StreamFrameCache&& other) = delete;
+  StreamFrameCache& operator=(const StreamFrameCache& other) = delete;
+  StreamFrameCache& operator=(StreamFrameCache&& other) = delete;
+
+  /**
+   * @brief Get the frame of a Stream shown at a time, decoding it with olive::decoder_pool if it isn't cached
+   *
+   * @param target_width
+   *
+   * Width the frame will be displayed at, which decides whether the Stream's proxy is used (see
+   * DecoderPool::Acquire()).
+   *
+   * @param purpose
+   *
+   * What a Decoder is acquired for if the frame isn't cached.
+   *
+   * @return
+   *
+   * The frame converted to `format`, or nullptr if it couldn't be decoded or converted. The buffer must not be
+   * modified since other consumers share it.
+   */
+  BufferPtr Get(VideoStream* stream, const rational& time, const olive::PixelFormat& format, int target_width = 0,
+                int target_height = 0, Decoder::Purpose purpose = Decoder::kInteractive);
+
+  /**
+   * @brief Free every frame of a certain Stream
+   *
+   * Use this if a Stream is about to be deleted or its file has changed.
+   */
+  void Clear(Stream* stream);
+
+  /**
+   * @brief Free every frame
+   */
+  void Clear();
+
+  qint64 budget();
+
+  /**
+   * @brief Set the maximum number of bytes cached frames may use (defaults to kDefaultBudget), 0 disables the cache
+   */
+  void set_budget(qint64 bytes);
+
+  /**
+   * @brief Cached frames by Stream, and how many Get() calls found one (hits) or had to decode (misses)
+   */
+  CacheStatistics statistics();
+
+private:
+  /**
+   * @brief Identifies frames that are interchangeable
+   */
+  struct Key {
+    Stream* stream;
+    bool proxy;
+    olive::PixelFormat format;
+
+    bool operator==(const Key& other) const
+    {
+      return stream == other.stream && proxy == other.proxy && format == other.format;
+    }
+
+    friend uint qHash(const Key& key, uint seed = 0)
+    {
+      return ::qHash(key.stream, seed) ^ ::qHash(key.proxy, seed + 1) ^ ::qHash(key.format, seed + 2) * 31u;
+    }
+  };
+
+  struct Entry {
+    BufferPtr buffer;
+
+    Key key;
+
+    // Times this frame is shown for, `end` is exclusive (or equal to `start` if the frame rate isn't known, in which
+    // case the frame only covers `start`)
+    rational start;
+    rational end;
+
+    qint64 bytes;
+
+    // Neighbors in the LRU list (head is least recently used)
+    Entry* lru_prev;
+    Entry* lru_next;
+  };
+
+  /**
+   * @brief Find the frame covering `time` (mutex_ must be locked)
+   */
+  Entry* Find(const Key& key, const rational& time);
+
+  /**
+   * @brief Move an entry to the most recently used end of the LRU list (mutex_ must be locked)
+   */
+  void Touch(Entry* e);
+
+  void LRURemove(Entry* e);
+
+  void LRUAppend(Entry* e);
+
+  /**
+   * @brief Free least recently used frames until `incoming` more bytes fit in the budget (mutex_ must be locked)
+   */
+  void FreeForIncoming(qint64 incoming);
+
+  /**
+   * @brief Remove an entry from its map and free it (mutex_ must be locked)
+   */
+  void RemoveEntry(Entry* e);
+
+  // Cached frames by Stream, proxy and format, then by the first time they cover
+  QHash< Key, QMap<rational, Entry*> > frames_;
+
+  Entry* lru_head_;
+  Entry* lru_tail_;
+
+  qint64 budget_;
+
+  qint64 used_bytes_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide cache of decoded source frames
+ */
+extern StreamFrameCache stream_frame_cache;
+}
+
+#endif // STREAMFRAMECACHE_H
@@ -0,0 +1,299 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "thumbnailservice.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "decoder/streamframecache.h"
+#include "project/item/footage/videostream.h"
+
+ThumbnailService olive::thumbnail_service;
+
+/**
+ * @brief Generates one requested thumbnail on the service's thread pool
+ */
+class ThumbnailService::GenerateRunnable : public QRunnable
+{
+public:
+  GenerateRunnable(ThumbnailService* service, FootagePtr footage, const QString& key, const Request& request) :
+    service_(service),
+    footage_(footage),
+    key_(key),
+    request_(request)
+  {
+  }
+
+  virtual void run() override
+  {
+    QImage image;
+    bool unavailable = false;
+
+    // Requests for items that have been scrolled away from are skipped
+    if (request_.cancelled->load() == 0) {
+      image = Generate(footage_, &unavailable);
+    }
+
+    QMetaObject::invokeMethod(service_,
+                              "GenerateFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, key_),
+                              Q_ARG(int, request_.id),
+                              Q_ARG(QImage, image),
+                              Q_ARG(bool, unavailable));
+  }
+
+private:
+  ThumbnailService* service_;
+
+  FootagePtr footage_;
+
+  QString key_;
+
+  Request request_;
+};
+
+ThumbnailService::ThumbnailService() :
+  cache_(kCacheBudget),
+  hits_(0),
+  misses_(0),
+  next_request_id_(0)
+{
+  // Thumbnails are a convenience, leave most of the system for playback and Tasks
+  pool_.setMaxThreadCount(2);
+}
+
+ThumbnailService::~ThumbnailService()
+{
+  CancelPending();
+
+  pool_.waitForDone();
+}
+
+QImage ThumbnailService::Get(FootagePtr footage)
+{
+  QString key = GetKey(footage.get());
+
+  QImage* image = cache_.object(key);
+
+  if (image != nullptr) {
+    hits_++;
+    return *image;
+  }
+
+  if (unavailable_.contains(key) || pending_.contains(key)) {
+    return QImage();
+  }
+
+  misses_++;
+
+  Request request;
+  request.id = next_request_id_++;
+  request.cancelled = std::make_shared<QAtomicInt>(0);
+
+  pending_.insert(key, request);
+
+  pool_.start(new GenerateRunnable(this, footage, key, request));
+
+  return QImage();
+}
+
+void ThumbnailService::CancelPending()
+{
+  foreach (const Request& request, pending_) {
+    request.cancelled->store(1);
+  }
+
+  // Cancelled requests are finished without generating anything, so visible items can be requested again right away
+  pending_.clear();
+}
+
+void ThumbnailService::set_cache_budget(int bytes)
+{
+  cache_.setMaxCost(bytes);
+}
+
+void ThumbnailService::ClearCache()
+{
+  cache_.clear();
+  costs_.clear();
+}
+
+CacheStatistics ThumbnailService::statistics()
+{
+  CacheStatistics s;
+
+  s.used_bytes = cache_.totalCost();
+  s.budget = cache_.maxCost();
+  s.entries = cache_.count();
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QHash<QString, int>::iterator i = costs_.begin();
+
+  while (i != costs_.end()) {
+    // Forget thumbnails QCache has evicted since (contains() doesn't touch the LRU order like object() does)
+    if (!cache_.contains(i.key())) {
+      i = costs_.erase(i);
+      continue;
+    }
+
+    // Keys are unique, so there's no need to merge with AddConsumer()
+    s.consumers.append({i.key().mid(i.key().indexOf(':') + 1), i.value(), 1});
+    i++;
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+QString ThumbnailService::GetKey(Footage *footage)
+{
+  footage->Lock();
+
+  QString key = QStringLiteral("%1:%2").arg(QString::number(footage->timestamp().toMSecsSinceEpoch()),
+                                            footage->filename());
+
+  footage->Unlock();
+
+  return key;
+}
+
+QString ThumbnailService::GetCacheFilename(Footage *footage)
+{
+  // Generate a unique hash for this file
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage->filename().toUtf8());
+  hash.addData(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(QFileInfo(footage->filename()).size()));
+
+  QDir thumbnail_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("thumbnail"));
+  thumbnail_dir.mkpath(".");
+
+  return thumbnail_dir.filePath(QStringLiteral("%1.jpg").arg(QString(hash.result().toHex())));
+}
+
+QImage ThumbnailService::Generate(FootagePtr footage, bool *unavailable)
+{
+  footage->Lock();
+
+  // Footage that hasn't been probed yet may get a thumbnail once it has
+  if (footage->status() == Footage::kUnprobed) {
+    footage->Unlock();
+    return QImage();
+  }
+
+  VideoStream* stream = nullptr;
+
+  for (int i=0;i<footage->stream_count();i++) {
+    if (footage->stream(i)->type() == Stream::kVideo) {
+      stream = static_cast<VideoStream*>(footage->stream(i));
+      break;
+    }
+  }
+
+  if (stream == nullptr) {
+    footage->Unlock();
+    *unavailable = true;
+    return QImage();
+  }
+
+  QString cache_filename = GetCacheFilename(footage.get());
+
+  // A tenth of the way in is less likely to be a black or title frame than the very start
+  rational time;
+
+  if (stream->duration() != AV_NOPTS_VALUE && stream->duration() > 0) {
+    time = rational(stream->duration() / 10) * stream->timebase();
+  }
+
+  footage->Unlock();
+
+  QImage image;
+
+  if (image.load(cache_filename, "JPG")) {
+    return image;
+  }
+
+  // Ask for a small target resolution so the Decoder can use a proxy, the frame is shared with anything else showing
+  // this time of the Stream
+  StreamFrameCache::BufferPtr frame = olive::stream_frame_cache.Get(stream, time, olive::PIX_FMT_RGBA8,
+                                                                    kThumbnailSize, kThumbnailSize);
+
+  if (frame != nullptr) {
+    // Wraps the shared buffer without copying it, Qt's smooth scaling is SIMD accelerated
+    QImage full(frame->const_data(), frame->width(), frame->height(), frame->linesize(), QImage::Format_RGBA8888);
+
+    image = full.scaled(kThumbnailSize, kThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+  }
+
+  if (image.isNull()) {
+    *unavailable = true;
+    return image;
+  }
+
+  // Save to the disk cache, JPEG doesn't support transparency so flatten it first
+  QSaveFile file(cache_filename);
+
+  if (file.open(QFile::WriteOnly)) {
+    QImage opaque = image.convertToFormat(QImage::Format_RGB32);
+
+    if (opaque.save(&file, "JPG", 85)) {
+      file.commit();
+    } else {
+      file.cancelWriting();
+    }
+  }
+
+  return image;
+}
+
+void ThumbnailService::GenerateFinished(const QString &key, int id, const QImage &image, bool unavailable)
+{
+  QHash<QString, Request>::iterator i = pending_.find(key);
+
+  // The request may have been cancelled and requested again since
+  if (i != pending_.end() && i.value().id == id) {
+    pending_.erase(i);
+  }
+
+  if (unavailable) {
+    unavailable_.insert(key);
+    return;
+  }
+
+  if (image.isNull()) {
+    return;
+  }
+
+  int cost = image.bytesPerLine() * image.height();
+
+  if (cache_.insert(key, new QImage(image), cost)) {
+    costs_.insert(key, cost);
+  }
+
+  emit ThumbnailReady();
+}
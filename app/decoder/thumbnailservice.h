@@ -0,0 +1,176 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+
+#include "common/cachestatistics.h"
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief Generates thumbnails of Footage in the background for the project explorer
+ *
+ * A thumbnail is a representative frame of the Footage's first video stream, taken from olive::stream_frame_cache at
+ * low resolution (so proxies are used where they exist) and downscaled to fit kThumbnailSize.
+ * Thumbnails are kept in a RAM cache limited to kCacheBudget and saved as JPEGs in the application cache directory,
+ * so they only need to be decoded once per file.
+ *
+ * Get() never blocks. If a thumbnail isn't cached yet, it's requested and ThumbnailReady() is emitted once it's been
+ * generated. Views should only call Get() for items they're drawing and call CancelPending() when they scroll, so
+ * requests for items that are no longer visible never get decoded.
+ *
+ * Use the application-wide olive::thumbnail_service. All functions must be called from the main thread.
+ */
+class ThumbnailService : public QObject
+{
+  Q_OBJECT
+public:
+  ThumbnailService();
+
+  /**
+   * @brief Destructor, cancels pending requests and waits for the ones that are being generated
+   */
+  virtual ~ThumbnailService() override;
+
+  /**
+   * @brief Largest width and height of a thumbnail
+   */
+  static const int kThumbnailSize = 256;
+
+  /**
+   * @brief Bytes of thumbnails kept in RAM by default
+   */
+  static const int kCacheBudget = 64 * 1024 * 1024;
+
+  /**
+   * @brief Get a Footage's thumbnail, requesting it if it hasn't been generated yet
+   *
+   * @return
+   *
+   * The thumbnail, or a null QImage if it isn't available (yet). Footage without video never has a thumbnail.
+   */
+  QImage Get(FootagePtr footage);
+
+  /**
+   * @brief Cancel every request that hasn't started generating yet
+   */
+  void CancelPending();
+
+  /**
+   * @brief Set the maximum number of bytes of thumbnails kept in RAM (defaults to kCacheBudget)
+   *
+   * Lowering it frees the least recently used thumbnails straight away, they're read back from the disk cache when
+   * they're needed again.
+   */
+  void set_cache_budget(int bytes);
+
+  /**
+   * @brief Free every thumbnail kept in RAM, they're read back from the disk cache when they're needed again
+   */
+  void ClearCache();
+
+  /**
+   * @brief Thumbnails kept in RAM by Footage, and how many Get() calls found one there (hits) or requested one
+   * (misses)
+   */
+  CacheStatistics statistics();
+
+signals:
+  /**
+   * @brief Emitted when a requested thumbnail has been generated and can be retrieved with Get()
+   */
+  void ThumbnailReady();
+
+private:
+  class GenerateRunnable;
+
+  struct Request {
+    int id;
+
+    std::shared_ptr<QAtomicInt> cancelled;
+  };
+
+  /**
+   * @brief Key of a Footage's thumbnail in the RAM cache and request list
+   */
+  static QString GetKey(Footage* footage);
+
+  /**
+   * @brief Get the filename of a Footage's thumbnail in the disk cache
+   *
+   * Unique to the Footage's filename, last modified timestamp and file size, much like WaveformCache::GetCacheFilename().
+   */
+  static QString GetCacheFilename(Footage* footage);
+
+  /**
+   * @brief Load a thumbnail from the disk cache or decode it (called on a worker thread)
+   *
+   * @param unavailable
+   *
+   * Set to TRUE if no thumbnail can be generated for this Footage (it has no video or decoding failed) so it isn't
+   * requested again.
+   */
+  static QImage Generate(FootagePtr footage, bool* unavailable);
+
+  QCache<QString, QImage> cache_;
+
+  // Cost of every thumbnail inserted into cache_ (QCache doesn't say, or when it evicts one)
+  QHash<QString, int> costs_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QHash<QString, Request> pending_;
+
+  // Footage that no thumbnail can be generated for
+  QSet<QString> unavailable_;
+
+  int next_request_id_;
+
+  QThreadPool pool_;
+
+private slots:
+  /**
+   * @brief Receives a generated thumbnail on the main thread
+   *
+   * @param image
+   *
+   * A null QImage if no thumbnail could be generated (or the request was cancelled).
+   */
+  void GenerateFinished(const QString& key, int id, const QImage& image, bool unavailable);
+};
+
+namespace olive {
+/**
+ * @brief Application-wide thumbnail service
+ */
+extern ThumbnailService thumbnail_service;
+}
+
+#endif // THUMBNAILSERVICE_H
@@ -0,0 +1,342 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "waveformcache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+#include "common/clamp.h"
+
+/**
+ * @brief Header of a waveform cache file
+ *
+ * The header is followed by, for each level, an int32_t samples per peak and an int32_t peak count and then
+ * `peak count` Peaks for each channel.
+ */
+struct WaveformHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t channels;
+  int32_t sample_rate;
+  int32_t level_count;
+};
+
+const char kWaveformMagic[4] = {'O', 'V', 'W', 'F'};
+const uint32_t kWaveformVersion = 1;
+
+// Samples per peak in the finest level
+const int kBaseSamplesPerPeak = 256;
+
+// Number of peaks merged into one in each subsequent level
+const int kLevelFactor = 4;
+
+// Total number of levels (finest is 256 samples per peak, coarsest is 65536)
+const int kLevelCount = 5;
+
+WaveformCache::WaveformCache() :
+  channels_(0),
+  sample_rate_(0),
+  pending_count_(0)
+{
+}
+
+void WaveformCache::Create(int channels, int sample_rate)
+{
+  channels_ = channels;
+  sample_rate_ = sample_rate;
+
+  levels_.clear();
+  levels_.resize(1);
+  levels_[0].resize(channels_);
+
+  pending_.resize(channels_);
+  pending_count_ = 0;
+}
+
+void WaveformCache::AddSamples(FramePtr frame)
+{
+  if (frame == nullptr || levels_.isEmpty()) {
+    return;
+  }
+
+  int channels = qMin(channels_, frame->channels());
+  int sample_count = frame->sample_count();
+  int start_count = pending_count_;
+
+  for (int i=0;i<channels;i++) {
+    const float* samples = reinterpret_cast<const float*>(frame->data()[i]);
+
+    QVector<Peak>& peaks = levels_[0][i];
+    Peak& pending = pending_[i];
+    int count = start_count;
+
+    for (int j=0;j<sample_count;j++) {
+      qint16 value = FloatToPeakValue(samples[j]);
+
+      if (count == 0) {
+        pending.min = value;
+        pending.max = value;
+      } else {
+        pending.min = qMin(pending.min, value);
+        pending.max = qMax(pending.max, value);
+      }
+
+      count++;
+
+      if (count == kBaseSamplesPerPeak) {
+        peaks.append(pending);
+        count = 0;
+      }
+    }
+
+    pending_count_ = count;
+  }
+}
+
+void WaveformCache::Finalize()
+{
+  if (levels_.isEmpty()) {
+    return;
+  }
+
+  // Flush any partially accumulated peak
+  if (pending_count_ > 0) {
+    for (int i=0;i<channels_;i++) {
+      levels_[0][i].append(pending_.at(i));
+    }
+
+    pending_count_ = 0;
+  }
+
+  // Generate each coarser level from the one before it
+  levels_.resize(1);
+
+  for (int level=1;level<kLevelCount;level++) {
+    const QVector< QVector<Peak> >& finer = levels_.at(level - 1);
+    QVector< QVector<Peak> > coarser(channels_);
+
+    for (int i=0;i<channels_;i++) {
+      const QVector<Peak>& src = finer.at(i);
+      QVector<Peak>& dst = coarser[i];
+
+      dst.reserve(src.size() / kLevelFactor + 1);
+
+      for (int j=0;j<src.size();j+=kLevelFactor) {
+        Peak p = src.at(j);
+
+        for (int k=j+1;k<qMin(j+kLevelFactor, src.size());k++) {
+          p.min = qMin(p.min, src.at(k).min);
+          p.max = qMax(p.max, src.at(k).max);
+        }
+
+        dst.append(p);
+      }
+    }
+
+    levels_.append(coarser);
+  }
+}
+
+bool WaveformCache::Save(AudioStream *stream)
+{
+  // QSaveFile ensures a partially written cache can never be read by Load()
+  QSaveFile file(GetCacheFilename(stream));
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << QStringLiteral("Failed to write waveform cache for %1").arg(stream->footage()->filename());
+    return false;
+  }
+
+  WaveformHeader header;
+  memcpy(header.magic, kWaveformMagic, sizeof(kWaveformMagic));
+  header.version = kWaveformVersion;
+  header.channels = channels_;
+  header.sample_rate = sample_rate_;
+  header.level_count = levels_.size();
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(WaveformHeader));
+
+  for (int level=0;level<levels_.size();level++) {
+    int32_t level_header[2];
+    level_header[0] = samples_per_peak(level);
+    level_header[1] = (channels_ > 0) ? levels_.at(level).first().size() : 0;
+
+    file.write(reinterpret_cast<const char*>(level_header), sizeof(level_header));
+
+    for (int i=0;i<channels_;i++) {
+      const QVector<Peak>& peaks = levels_.at(level).at(i);
+
+      file.write(reinterpret_cast<const char*>(peaks.constData()),
+                 static_cast<qint64>(peaks.size()) * static_cast<qint64>(sizeof(Peak)));
+    }
+  }
+
+  return file.commit();
+}
+
+bool WaveformCache::Load(AudioStream *stream)
+{
+  QFile file(GetCacheFilename(stream));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  qint64 file_size = file.size();
+
+  if (file_size < static_cast<qint64>(sizeof(WaveformHeader))) {
+    return false;
+  }
+
+  uchar* map = file.map(0, file_size);
+
+  if (map == nullptr) {
+    return false;
+  }
+
+  const WaveformHeader* header = reinterpret_cast<const WaveformHeader*>(map);
+
+  if (memcmp(header->magic, kWaveformMagic, sizeof(kWaveformMagic)) != 0
+      || header->version != kWaveformVersion
+      || header->channels <= 0
+      || header->level_count <= 0) {
+    file.unmap(map);
+    return false;
+  }
+
+  Create(header->channels, header->sample_rate);
+  levels_.resize(header->level_count);
+
+  qint64 offset = static_cast<qint64>(sizeof(WaveformHeader));
+  bool valid = true;
+
+  for (int level=0;level<levels_.size() && valid;level++) {
+    int32_t level_header[2];
+
+    if (offset + static_cast<qint64>(sizeof(level_header)) > file_size) {
+      valid = false;
+      break;
+    }
+
+    memcpy(level_header, map + offset, sizeof(level_header));
+    offset += static_cast<qint64>(sizeof(level_header));
+
+    qint64 level_bytes = static_cast<qint64>(level_header[1]) * static_cast<qint64>(sizeof(Peak));
+
+    if (level_header[1] < 0 || offset + level_bytes * channels_ > file_size) {
+      valid = false;
+      break;
+    }
+
+    levels_[level].resize(channels_);
+
+    for (int i=0;i<channels_;i++) {
+      QVector<Peak>& peaks = levels_[level][i];
+      peaks.resize(level_header[1]);
+      memcpy(peaks.data(), map + offset, static_cast<size_t>(level_bytes));
+      offset += level_bytes;
+    }
+  }
+
+  file.unmap(map);
+
+  if (!valid || offset != file_size) {
+    levels_.clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool WaveformCache::Exists(AudioStream *stream)
+{
+  return QFileInfo::exists(GetCacheFilename(stream));
+}
+
+int WaveformCache::channel_count()
+{
+  return channels_;
+}
+
+int WaveformCache::sample_rate()
+{
+  return sample_rate_;
+}
+
+int WaveformCache::level_count()
+{
+  return levels_.size();
+}
+
+int WaveformCache::samples_per_peak(int level)
+{
+  int spp = kBaseSamplesPerPeak;
+
+  for (int i=0;i<level;i++) {
+    spp *= kLevelFactor;
+  }
+
+  return spp;
+}
+
+int WaveformCache::GetLevelForResolution(double samples_per_pixel)
+{
+  int level = 0;
+
+  while (level + 1 < levels_.size() && samples_per_peak(level + 1) <= samples_per_pixel) {
+    level++;
+  }
+
+  return level;
+}
+
+const QVector<WaveformCache::Peak> &WaveformCache::peaks(int level, int channel)
+{
+  return levels_.at(level).at(channel);
+}
+
+QString WaveformCache::GetCacheFilename(AudioStream *stream)
+{
+  Footage* footage = stream->footage();
+
+  // Generate a unique hash for this file and stream
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage->filename().toUtf8());
+  hash.addData(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(QFileInfo(footage->filename()).size()));
+  hash.addData(QByteArray::number(stream->index()));
+
+  QDir waveform_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("waveform"));
+  waveform_dir.mkpath(".");
+
+  return waveform_dir.filePath(QString(hash.result().toHex()));
+}
+
+qint16 WaveformCache::FloatToPeakValue(float f)
+{
+  return static_cast<qint16>(clamp(f, -1.0f, 1.0f) * 32767.0f);
+}
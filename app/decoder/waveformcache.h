@@ -0,0 +1,130 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef WAVEFORMCACHE_H
+#define WAVEFORMCACHE_H
+
+#include <QVector>
+
+#include "decoder/frame.h"
+#include "project/item/footage/audiostream.h"
+
+/**
+ * @brief Multi-resolution min/max peaks of an AudioStream for drawing waveforms without decoding
+ *
+ * Peaks are generated once by feeding the stream's decoded audio through AddSamples() (see ProbeTask) and stored in
+ * a compact cache file. The finest level has one peak per kBaseSamplesPerPeak samples and each subsequent level
+ * merges kLevelFactor peaks of the one before it, so a view can pick the level closest to its zoom with
+ * GetLevelForResolution() and never has to iterate more peaks than it has pixels (within a factor of kLevelFactor).
+ */
+class WaveformCache
+{
+public:
+  /**
+   * @brief Lowest and highest sample within a peak, normalized to the range of qint16
+   */
+  struct Peak {
+    qint16 min;
+    qint16 max;
+  };
+
+  WaveformCache();
+
+  /**
+   * @brief Clear the cache and prepare it to receive samples with AddSamples()
+   */
+  void Create(int channels, int sample_rate);
+
+  /**
+   * @brief Accumulate a Frame of planar float audio (as returned by Decoder::Retrieve()) into the finest level
+   */
+  void AddSamples(FramePtr frame);
+
+  /**
+   * @brief Finish accumulating samples and generate the lower resolution levels
+   */
+  void Finalize();
+
+  /**
+   * @brief Write the cache to the cache file for this stream
+   */
+  bool Save(AudioStream* stream);
+
+  /**
+   * @brief Load the cache from the cache file for this stream
+   *
+   * @return
+   *
+   * TRUE if a valid cache exists for this stream and was loaded.
+   */
+  bool Load(AudioStream* stream);
+
+  /**
+   * @brief Returns whether a cache file exists for this stream
+   */
+  static bool Exists(AudioStream* stream);
+
+  int channel_count();
+
+  int sample_rate();
+
+  int level_count();
+
+  /**
+   * @brief Number of audio samples (per channel) covered by each peak in `level`
+   */
+  int samples_per_peak(int level);
+
+  /**
+   * @brief Returns the coarsest level that still has at least one peak per `samples_per_pixel`
+   */
+  int GetLevelForResolution(double samples_per_pixel);
+
+  /**
+   * @brief Peaks of one channel at a certain level
+   */
+  const QVector<Peak>& peaks(int level, int channel);
+
+private:
+  static QString GetCacheFilename(AudioStream* stream);
+
+  static qint16 FloatToPeakValue(float f);
+
+  int channels_;
+
+  int sample_rate_;
+
+  /**
+   * @brief levels_[level][channel] peaks
+   */
+  QVector< QVector< QVector<Peak> > > levels_;
+
+  /**
+   * @brief Peak currently being accumulated for each channel in the finest level
+   */
+  QVector<Peak> pending_;
+
+  /**
+   * @brief Number of samples accumulated into pending_
+   */
+  int pending_count_;
+};
+
+#endif // WAVEFORMCACHE_H
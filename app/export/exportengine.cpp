@@ -0,0 +1,755 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "exportengine.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#include <QFile>
+#include <QMap>
+#include <QStringList>
+
+#include "render/allocationcounters.h"
+#include "render/diskframecache.h"
+#include "render/semiplanarpacker.h"
+
+ExportEngine::Params::Params() :
+  output(nullptr),
+  width(0),
+  height(0),
+  in(0),
+  out(0),
+  bit_rate(0),
+  hardware_encoding(false),
+  frames_in_flight(0)
+{
+}
+
+ExportEngine::ExportEngine(QObject *parent) :
+  QObject(parent),
+  encoding_(0),
+  progress_(0),
+  next_delivery_(0),
+  readback_format_(AV_PIX_FMT_RGBA),
+  running_(0),
+  failed_(0),
+  wall_nsecs_(0)
+{
+  for (int i=0;i<kStageCount;i++) {
+    busy_nsecs_[i].store(0);
+    stage_threads_[i] = 1;
+    stage_frames_[i].store(0);
+  }
+
+  // Rendered frames are handed to the conversion threads straight from the render threads
+  connect(&renderer_, SIGNAL(FrameReady(RenderJobPtr)), this, SLOT(FrameReady(RenderJobPtr)), Qt::DirectConnection);
+}
+
+ExportEngine::~ExportEngine()
+{
+  if (IsRunning()) {
+    Cancel();
+    Complete();
+  }
+}
+
+bool ExportEngine::Start(const ExportEngine::Params &params)
+{
+  return Start(QVector<Params>({params}));
+}
+
+bool ExportEngine::Start(const QVector<ExportEngine::Params> &params)
+{
+  if (IsRunning()) {
+    return false;
+  }
+
+  error_mutex_.lock();
+  error_.clear();
+  error_mutex_.unlock();
+
+  if (params.isEmpty()) {
+    error_ = tr("Invalid export parameters");
+    return false;
+  }
+
+  params_ = params.first();
+
+  if (params_.output == nullptr || params_.width <= 0 || params_.height <= 0 || params_.timebase <= rational(0)
+      || params_.in < 0 || params_.out < params_.in) {
+    error_ = tr("Invalid export parameters");
+    return false;
+  }
+
+  foreach (const Params& p, params) {
+    if (!CanShareRender(params_, p)) {
+      error_ = tr("Exports with different frames can't be started together");
+      return false;
+    }
+  }
+
+  int render_threads = qMax(1, QThread::idealThreadCount());
+
+  if (params_.frames_in_flight <= 0) {
+    params_.frames_in_flight = 2 * render_threads;
+  }
+
+  foreach (const Params& p, params) {
+    Destination* destination = new Destination();
+    destination->params = p;
+    destinations_.append(destination);
+
+    if (!destination->encoder.Open(p.filename, params_.width, params_.height, params_.timebase, p.codec,
+                                   p.bit_rate, p.hardware_encoding)) {
+      error_ = destination->encoder.error();
+      ClearDestinations();
+      return false;
+    }
+  }
+
+  // Frames are rendered once for every destination, so they're rendered in the format the most demanding one needs.
+  // Encoders with more than 8 bits per channel get 16-bit frames so the extra precision isn't thrown away.
+  olive::PixelFormat render_format = olive::PIX_FMT_RGBA8;
+  readback_format_ = AV_PIX_FMT_RGBA;
+
+  foreach (Destination* destination, destinations_) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(destination->encoder.pix_fmt());
+
+    if (desc != nullptr && desc->comp[0].depth > 8) {
+      render_format = olive::PIX_FMT_RGBA16;
+      readback_format_ = AV_PIX_FMT_RGBA64;
+    }
+  }
+
+  // Encoders that take 4:2:0 Y'CbCr (at up to 10 bits) get frames converted on the GPU, so only the Y'CbCr samples
+  // are read back and the conversion threads just copy them. That's only done if every destination takes them.
+  bool semi_planar = SemiPlanarPacker::IsSupported(params_.width, params_.height, render_format);
+
+  foreach (Destination* destination, destinations_) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(destination->encoder.pix_fmt());
+
+    semi_planar = semi_planar
+        && desc != nullptr
+        && !(desc->flags & AV_PIX_FMT_FLAG_RGB)
+        && desc->nb_components >= 3
+        && desc->log2_chroma_w == 1
+        && desc->log2_chroma_h == 1
+        && desc->comp[0].depth <= 10;
+  }
+
+  renderer_.SetParameters(params_.width, params_.height, render_format);
+  renderer_.SetFrameDuration(params_.timebase);
+  renderer_.SetReadbackEnabled(true);
+  renderer_.SetReadbackSemiPlanar(semi_planar);
+  renderer_.Start();
+
+  foreach (Destination* destination, destinations_) {
+    destination->convert_queue = new BoundedQueue<Frame>(params_.frames_in_flight);
+    destination->encode_queue = new BoundedQueue<Frame>(params_.frames_in_flight);
+    destination->encoded.store(0);
+  }
+
+  // Reset the slots in case a previous export left some behind
+  slots_.acquire(slots_.available());
+  slots_.release(params_.frames_in_flight * destinations_.size());
+
+  next_delivery_ = params_.in;
+  failed_.store(0);
+  progress_.store(0);
+  encoding_.store(destinations_.size());
+
+  int convert_threads = qBound(1, render_threads / 4, 4);
+
+  for (int i=0;i<kStageCount;i++) {
+    busy_nsecs_[i].store(0);
+    stage_frames_[i].store(0);
+  }
+
+  statistics_.Start(params_.output, params_.timebase, params_.in, params_.out, FindDiskCachedFrames(render_format));
+
+  stage_threads_[kRender] = render_threads;
+  stage_threads_[kReadback] = render_threads;
+  stage_threads_[kConvert] = convert_threads * destinations_.size();
+  stage_threads_[kEncode] = destinations_.size();
+
+  start_counters_ = PerformanceCounters::Take();
+  timer_.start();
+  running_.store(1);
+
+  threads_.append(new StageThread(this, &ExportEngine::QueueLoop));
+
+  foreach (Destination* destination, destinations_) {
+    for (int i=0;i<convert_threads;i++) {
+      threads_.append(new StageThread(this, &ExportEngine::ConvertLoop, destination));
+    }
+
+    threads_.append(new StageThread(this, &ExportEngine::EncodeLoop, destination));
+  }
+
+  foreach (StageThread* thread, threads_) {
+    thread->start();
+  }
+
+  return true;
+}
+
+bool ExportEngine::CanShareRender(const ExportEngine::Params &a, const ExportEngine::Params &b)
+{
+  return a.output == b.output
+      && a.width == b.width
+      && a.height == b.height
+      && a.timebase == b.timebase
+      && a.in == b.in
+      && a.out == b.out;
+}
+
+bool ExportEngine::IsRunning()
+{
+  return running_.load() != 0;
+}
+
+QString ExportEngine::error()
+{
+  QMutexLocker locker(&error_mutex_);
+
+  return error_;
+}
+
+QVector<double> ExportEngine::utilisation()
+{
+  qint64 busy[kStageCount];
+  qint64 wall;
+
+  GetBusyTime(busy, &wall);
+
+  QVector<double> stages(kStageCount, 0.0);
+
+  if (wall > 0) {
+    for (int i=0;i<kStageCount;i++) {
+      stages[i] = qMin(1.0, static_cast<double>(busy[i]) / static_cast<double>(wall * stage_threads_[i]));
+    }
+  }
+
+  return stages;
+}
+
+QString ExportEngine::StageName(ExportEngine::Stage stage)
+{
+  switch (stage) {
+  case kRender:
+    return tr("Render");
+  case kReadback:
+    return tr("Readback");
+  case kConvert:
+    return tr("Convert");
+  case kEncode:
+    return tr("Encode");
+  case kStageCount:
+    break;
+  }
+
+  return QString();
+}
+
+QString ExportEngine::LimitingStage()
+{
+  QVector<double> stages = utilisation();
+
+  int limiting = 0;
+
+  for (int i=1;i<stages.size();i++) {
+    if (stages.at(i) > stages.at(limiting)) {
+      limiting = i;
+    }
+  }
+
+  return StageName(static_cast<Stage>(limiting));
+}
+
+QVector<double> ExportEngine::throughput()
+{
+  qint64 busy[kStageCount];
+  qint64 wall;
+
+  GetBusyTime(busy, &wall);
+
+  QVector<double> stages(kStageCount, 0.0);
+
+  for (int i=0;i<kStageCount;i++) {
+    if (busy[i] > 0) {
+      stages[i] = static_cast<double>(stage_frames_[i].load()) * stage_threads_[i] * 1000000000.0
+          / static_cast<double>(busy[i]);
+    }
+  }
+
+  return stages;
+}
+
+qint64 ExportEngine::EstimatedRemaining()
+{
+  qint64 total = params_.out - params_.in + 1;
+  qint64 remaining_frames = total - progress_.load();
+
+  if (remaining_frames <= 0) {
+    return 0;
+  }
+
+  qint64 busy[kStageCount];
+  qint64 wall;
+
+  GetBusyTime(busy, &wall);
+
+  double remaining = 0;
+
+  // Rendering, with as many frames rendered at once as so far (fewer than there are threads if a later stage is
+  // holding it back). Reading back is part of each frame's render time.
+  qint64 render_nsecs = statistics_.RemainingRenderNsecs();
+
+  if (render_nsecs < 0) {
+    return -1;
+  }
+
+  if (render_nsecs > 0) {
+    double concurrency = stage_threads_[kRender];
+
+    if (wall > 0 && statistics_.rendered_nsecs() > 0) {
+      concurrency = qBound(1.0, static_cast<double>(statistics_.rendered_nsecs()) / static_cast<double>(wall),
+                           static_cast<double>(stage_threads_[kRender]));
+    }
+
+    remaining = static_cast<double>(render_nsecs) / concurrency;
+  }
+
+  // Conversion and encoding can't go faster than they have per frame on all of their threads
+  for (int stage=kConvert;stage<=kEncode;stage++) {
+    qint64 processed = stage_frames_[stage].load();
+    qint64 left = total * destinations_.size() - processed;
+
+    if (processed > 0 && left > 0) {
+      double per_frame = static_cast<double>(busy[stage]) / static_cast<double>(processed);
+
+      remaining = qMax(remaining, static_cast<double>(left) * per_frame / stage_threads_[stage]);
+    }
+  }
+
+  return qRound64(remaining / 1000000.0);
+}
+
+ExportStatistics *ExportEngine::statistics()
+{
+  return &statistics_;
+}
+
+void ExportEngine::Cancel()
+{
+  if (IsRunning()) {
+    Fail(tr("Export was cancelled"));
+  }
+}
+
+ExportEngine::StageThread::StageThread(ExportEngine *engine,
+                                       void (ExportEngine::*loop)(Destination*),
+                                       Destination *destination) :
+  engine_(engine),
+  loop_(loop),
+  destination_(destination)
+{
+}
+
+void ExportEngine::StageThread::run()
+{
+  (engine_->*loop_)(destination_);
+}
+
+void ExportEngine::QueueLoop(Destination*)
+{
+  AllocationCounters::ScopedTag tag(AllocationCounters::kExport);
+
+  rational timebase = params_.timebase;
+
+  for (int64_t i=params_.in;i<=params_.out;i++) {
+    // Wait for an earlier frame to be encoded in every destination
+    slots_.acquire(destinations_.size());
+
+    if (failed_.load()) {
+      return;
+    }
+
+    if (renderer_.QueueFrame(params_.output, rational(i * timebase.numerator(), timebase.denominator())) == nullptr) {
+      Fail(tr("Failed to queue frame %1").arg(i));
+      return;
+    }
+  }
+}
+
+void ExportEngine::ConvertLoop(Destination *destination)
+{
+  AVPixelFormat dst_format = destination->encoder.pix_fmt();
+
+  SwsContext* sws_ctx = nullptr;
+
+  QElapsedTimer timer;
+
+  Frame frame;
+
+  while (destination->convert_queue->Pop(&frame)) {
+    timer.start();
+
+    MemoryBuffer* buffer = frame.job->frame_buffer();
+
+    if (buffer == nullptr || !buffer->IsCreated()) {
+      Fail(tr("Frame %1 wasn't read back").arg(frame.index));
+      break;
+    }
+
+    // Frames that couldn't be packed (e.g. at another size) are read back as RGBA
+    bool semi_planar = frame.job->frame_semi_planar();
+
+    int src_width = buffer->width();
+    int src_height = buffer->height();
+    AVPixelFormat src_format = readback_format_;
+
+    const uint8_t* src_data[4];
+    int src_linesize[4];
+
+    if (semi_planar) {
+      src_width *= 4;
+      src_height = src_height / 3 * 2;
+      src_format = SemiPlanarPacker::GetAVPixelFormat(buffer->format());
+
+      SemiPlanarPacker::GetPlanes(*buffer, src_height, src_data, src_linesize);
+    } else {
+      // Frames are read back with OpenGL's bottom-left origin, so start at the last row and go up to flip them
+      src_data[0] = buffer->const_row(buffer->height() - 1);
+      src_data[1] = nullptr;
+      src_data[2] = nullptr;
+      src_data[3] = nullptr;
+
+      src_linesize[0] = -buffer->linesize();
+      src_linesize[1] = 0;
+      src_linesize[2] = 0;
+      src_linesize[3] = 0;
+    }
+
+    sws_ctx = sws_getCachedContext(sws_ctx,
+                                   src_width,
+                                   src_height,
+                                   src_format,
+                                   params_.width,
+                                   params_.height,
+                                   dst_format,
+                                   SWS_BILINEAR,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+
+    if (sws_ctx == nullptr) {
+      Fail(tr("Failed to create scaler"));
+      break;
+    }
+
+    AVFrame* converted = av_frame_alloc();
+    converted->format = dst_format;
+    converted->width = params_.width;
+    converted->height = params_.height;
+
+    if (av_frame_get_buffer(converted, 0) < 0) {
+      av_frame_free(&converted);
+      Fail(tr("Failed to allocate frame"));
+      break;
+    }
+
+    sws_scale(sws_ctx,
+              src_data,
+              src_linesize,
+              0,
+              src_height,
+              converted->data,
+              converted->linesize);
+
+    converted->pts = frame.index - params_.in;
+
+    // Release the RGBA frame as soon as possible (other destinations may still need it)
+    frame.job = nullptr;
+    frame.converted = converted;
+
+    busy_nsecs_[kConvert].fetchAndAddRelaxed(timer.nsecsElapsed());
+    stage_frames_[kConvert].fetchAndAddRelaxed(1);
+
+    if (!destination->encode_queue->Push(frame)) {
+      av_frame_free(&frame.converted);
+      break;
+    }
+  }
+
+  sws_freeContext(sws_ctx);
+}
+
+void ExportEngine::EncodeLoop(Destination *destination)
+{
+  // Conversion threads may finish frames out of order
+  QMap<int64_t, AVFrame*> pending;
+
+  int64_t next_frame = params_.in;
+
+  QElapsedTimer timer;
+
+  Frame frame;
+
+  bool ok = true;
+
+  while (ok && next_frame <= params_.out && destination->encode_queue->Pop(&frame)) {
+    pending.insert(frame.index, frame.converted);
+
+    QMap<int64_t, AVFrame*>::iterator it;
+
+    while (ok && (it = pending.find(next_frame)) != pending.end()) {
+      AVFrame* converted = it.value();
+      pending.erase(it);
+
+      timer.start();
+      ok = destination->encoder.Encode(converted);
+      busy_nsecs_[kEncode].fetchAndAddRelaxed(timer.nsecsElapsed());
+      stage_frames_[kEncode].fetchAndAddRelaxed(1);
+
+      av_frame_free(&converted);
+
+      if (!ok) {
+        Fail(destination->encoder.error());
+        break;
+      }
+
+      next_frame++;
+
+      // Make room for another frame
+      slots_.release();
+
+      destination->encoded.fetchAndAddOrdered(1);
+      UpdateProgress();
+    }
+  }
+
+  foreach (AVFrame* converted, pending) {
+    av_frame_free(&converted);
+  }
+
+  if (ok && next_frame > params_.out && !failed_.load()) {
+    timer.start();
+
+    if (!destination->encoder.Finish()) {
+      Fail(destination->encoder.error());
+    }
+
+    busy_nsecs_[kEncode].fetchAndAddRelaxed(timer.nsecsElapsed());
+  }
+
+  // Every other stage stops on its own (or because of Fail()), so the last encoding thread to stop is the only place
+  // Complete() is invoked from
+  if (encoding_.fetchAndSubOrdered(1) == 1) {
+    QMetaObject::invokeMethod(this, "Complete", Qt::QueuedConnection);
+  }
+}
+
+void ExportEngine::GetBusyTime(qint64 busy[kStageCount], qint64 *wall)
+{
+  bool running = IsRunning();
+
+  *wall = running ? timer_.nsecsElapsed() : wall_nsecs_;
+  PerformanceCounters::Snapshot counters = running ? PerformanceCounters::Take() : end_counters_;
+
+  for (int i=0;i<kStageCount;i++) {
+    busy[i] = busy_nsecs_[i].load();
+  }
+
+  busy[kReadback] = counters.stage_nsecs[PerformanceCounters::kReadback]
+      - start_counters_.stage_nsecs[PerformanceCounters::kReadback];
+
+  // Render times include reading the frame back
+  busy[kRender] = qMax(static_cast<qint64>(0), busy[kRender] - busy[kReadback]);
+}
+
+FrameRunList ExportEngine::FindDiskCachedFrames(const olive::PixelFormat &format)
+{
+  FrameRunList frames;
+
+  int tile_size = renderer_.GetTileSize();
+
+  if (DiskFrameCache::budget() <= 0 || params_.width > tile_size || params_.height > tile_size) {
+    return frames;
+  }
+
+  const rational& timebase = params_.timebase;
+
+  for (int64_t i=params_.in;i<=params_.out;i++) {
+    QByteArray hash = params_.output->ContentHash(rational(i * timebase.numerator(), timebase.denominator()));
+
+    if (DiskFrameCache::Contains(DiskFrameCache::FrameKey(hash, params_.width, params_.height, format))) {
+      frames.Insert(i);
+    }
+  }
+
+  return frames;
+}
+
+void ExportEngine::UpdateProgress()
+{
+  qint64 completed = params_.out - params_.in + 1;
+
+  foreach (Destination* destination, destinations_) {
+    completed = qMin(completed, destination->encoded.load());
+  }
+
+  qint64 last = progress_.load();
+
+  if (completed > last && progress_.testAndSetOrdered(last, completed)) {
+    emit Progress(completed, params_.out - params_.in + 1);
+  }
+}
+
+void ExportEngine::Fail(const QString &message)
+{
+  if (!failed_.testAndSetOrdered(0, 1)) {
+    return;
+  }
+
+  error_mutex_.lock();
+  error_ = message;
+  error_mutex_.unlock();
+
+  renderer_.CancelAll();
+
+  AbortQueues();
+
+  // Wake up the queueing thread so it sees the failure, the encoding threads invoke Complete() once they stop
+  slots_.release(params_.frames_in_flight * destinations_.size());
+}
+
+void ExportEngine::FreeFrames(const QQueue<ExportEngine::Frame> &frames)
+{
+  foreach (Frame frame, frames) {
+    av_frame_free(&frame.converted);
+  }
+}
+
+void ExportEngine::AbortQueues()
+{
+  foreach (Destination* destination, destinations_) {
+    FreeFrames(destination->convert_queue->Abort());
+    FreeFrames(destination->encode_queue->Abort());
+  }
+}
+
+void ExportEngine::ClearDestinations()
+{
+  foreach (Destination* destination, destinations_) {
+    destination->encoder.Close();
+
+    delete destination->convert_queue;
+    delete destination->encode_queue;
+    delete destination;
+  }
+
+  destinations_.clear();
+}
+
+void ExportEngine::FrameReady(RenderJobPtr job)
+{
+  if (failed_.load()) {
+    return;
+  }
+
+  // Only called by one render thread at a time, in order
+  int64_t index = qRound64((job->time() / params_.timebase).ToDouble());
+
+  if (index != next_delivery_) {
+    Fail(tr("Frame %1 couldn't be rendered").arg(next_delivery_));
+    return;
+  }
+
+  next_delivery_++;
+
+  busy_nsecs_[kRender].fetchAndAddRelaxed(job->render_time() * 1000000);
+
+  // Reading back happens as part of rendering
+  stage_frames_[kRender].fetchAndAddRelaxed(1);
+  stage_frames_[kReadback].fetchAndAddRelaxed(1);
+
+  statistics_.AddFrame(index, job->render_time() * 1000000);
+
+  Frame frame;
+  frame.index = index;
+  frame.job = job;
+  frame.converted = nullptr;
+
+  // Never actually waits, there are never more frames in a destination's pipeline than its queues hold. Every
+  // destination converts from the same readback.
+  foreach (Destination* destination, destinations_) {
+    destination->convert_queue->Push(frame);
+  }
+}
+
+void ExportEngine::Complete()
+{
+  if (!IsRunning()) {
+    return;
+  }
+
+  // Whatever is still waiting on a queue has nothing more to do
+  AbortQueues();
+  slots_.release(params_.frames_in_flight * destinations_.size());
+
+  foreach (StageThread* thread, threads_) {
+    thread->wait();
+    delete thread;
+  }
+
+  threads_.clear();
+
+  renderer_.Stop();
+
+  wall_nsecs_ = timer_.nsecsElapsed();
+  end_counters_ = PerformanceCounters::Take();
+
+  // Even a failed export measured what the frames it rendered cost
+  statistics_.Finish();
+
+  bool ok = !failed_.load();
+
+  QStringList filenames;
+
+  foreach (Destination* destination, destinations_) {
+    filenames.append(destination->params.filename);
+  }
+
+  ClearDestinations();
+
+  // Don't leave half-written files behind
+  if (!ok) {
+    foreach (const QString& filename, filenames) {
+      QFile::remove(filename);
+    }
+  }
+
+  running_.store(0);
+
+  emit Finished(ok);
+}
@@ -0,0 +1,370 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTENGINE_H
+#define EXPORTENGINE_H
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QThread>
+#include <QVector>
+
+#include "common/boundedqueue.h"
+#include "export/exportstatistics.h"
+#include "export/videoencoder.h"
+#include "node/processor/renderer/renderer.h"
+#include "render/performancecounters.h"
+
+/**
+ * @brief Exports a range of a NodeOutput to a video file with every stage of the export running at once
+ *
+ * Rendering runs alongside conversion and encoding, each of which hands frames to the next through a BoundedQueue:
+ *
+ * * The graph is rendered on RendererProcessor's threads. Each frame is read back into RAM through the thread's
+ *   TextureDownloader while the thread renders the next one (see RendererProcessor::SetReadbackEnabled()). For
+ *   encoders that take 4:2:0 Y'CbCr, frames are converted on the GPU and read back as NV12 or P010 (see
+ *   SemiPlanarPacker).
+ * * A pool of conversion threads converts the frames to the encoder's pixel format (only a copy if they're read back
+ *   in it already).
+ * * One thread encodes and writes the frames in order.
+ *
+ * Only a fixed number of frames is ever in the pipeline (see Params::frames_in_flight): a new frame is only queued
+ * for rendering once an earlier one has been encoded, so a slow stage holds back the ones before it instead of
+ * frames piling up in memory. How busy each stage was is available with utilisation() so the stage limiting the
+ * export's throughput can be found, and how long the export has left with EstimatedRemaining(). Frames already in the
+ * disk cache are loaded rather than rendered, and the estimate accounts for them.
+ *
+ * The same frames can be exported to several files at once (e.g. one master delivered in several formats) by passing
+ * Start() a Params for each, as long as they only differ in how they're encoded (see CanShareRender()). Frames are
+ * then rendered and read back once, and every file gets its own conversion threads and encoder fed from the
+ * same readback.
+ *
+ * Start() and the slots must be called from the main thread.
+ */
+class ExportEngine : public QObject
+{
+  Q_OBJECT
+public:
+  struct Params {
+    Params();
+
+    NodeOutput* output;
+
+    int width;
+    int height;
+
+    // Duration of one frame
+    rational timebase;
+
+    // First and last frame to export (inclusive), in timebase
+    int64_t in;
+    int64_t out;
+
+    QString filename;
+
+    // See VideoEncoder::Open()
+    QString codec;
+    int64_t bit_rate;
+    bool hardware_encoding;
+
+    // Most frames in the pipeline at once, 0 for two per render thread
+    int frames_in_flight;
+  };
+
+  enum Stage {
+    kRender,
+    kReadback,
+    kConvert,
+    kEncode,
+    kStageCount
+  };
+
+  ExportEngine(QObject* parent = nullptr);
+
+  virtual ~ExportEngine() override;
+
+  /**
+   * @brief Open the file and start exporting
+   *
+   * @return
+   *
+   * FALSE if the export couldn't be started (see error()), in which case Finished() won't be emitted.
+   */
+  bool Start(const Params& params);
+
+  /**
+   * @brief Open several files and start exporting the same frames to each of them
+   *
+   * Every Params must be able to share a render with the first (see CanShareRender()). Fails if any file can't be
+   * opened. Once started, an error in any file stops them all.
+   */
+  bool Start(const QVector<Params>& params);
+
+  /**
+   * @brief Returns TRUE if two exports render exactly the same frames, so Start() can export them together
+   */
+  static bool CanShareRender(const Params& a, const Params& b);
+
+  bool IsRunning();
+
+  /**
+   * @brief Error message of a failed export
+   */
+  QString error();
+
+  /**
+   * @brief Fraction of the time since the export started each stage's threads were busy (0.0-1.0)
+   *
+   * The stage closest to 1.0 is the one limiting throughput. Readback is measured with PerformanceCounters, so it
+   * includes any other rendering happening in the application.
+   */
+  QVector<double> utilisation();
+
+  static QString StageName(Stage stage);
+
+  /**
+   * @brief Name of the stage with the highest utilisation()
+   */
+  QString LimitingStage();
+
+  /**
+   * @brief Frames per second each stage has processed while it was busy, i.e. how fast it could go if nothing held it
+   * back (0 for stages that haven't processed a frame yet)
+   *
+   * Conversion and encoding are counted over every destination.
+   */
+  QVector<double> throughput();
+
+  /**
+   * @brief Predicted milliseconds until every frame has been encoded, -1 if there's nothing to predict it from yet
+   *
+   * The render time left is predicted from what each part of the range has cost so far and in earlier exports (see
+   * ExportStatistics), rendered as many frames at a time as have been so far. The conversion and encoding left take
+   * at least what they have per frame so far on however many threads they have. Whichever takes longest is the
+   * prediction, as each stage keeps going while the others do.
+   */
+  qint64 EstimatedRemaining();
+
+  /**
+   * @brief Render times of each part of the range being exported
+   */
+  ExportStatistics* statistics();
+
+public slots:
+  /**
+   * @brief Stop exporting, Finished() is emitted with FALSE once every stage has stopped
+   */
+  void Cancel();
+
+signals:
+  /**
+   * @brief Emitted each time a frame has been encoded (into every file, if there are several)
+   */
+  void Progress(qint64 completed, qint64 total);
+
+  /**
+   * @brief Emitted once the file has been finalized or the export has failed or been cancelled
+   */
+  void Finished(bool ok);
+
+private:
+  /**
+   * @brief A frame moving through the pipeline
+   */
+  struct Frame {
+    Frame() :
+      index(0),
+      converted(nullptr)
+    {
+    }
+
+    int64_t index;
+
+    // Set until the frame has been converted
+    RenderJobPtr job;
+
+    // Set once the frame has been converted
+    AVFrame* converted;
+  };
+
+  /**
+   * @brief A file being exported to, with the queues feeding its conversion and encoding threads
+   */
+  struct Destination {
+    Destination() :
+      convert_queue(nullptr),
+      encode_queue(nullptr),
+      encoded(0)
+    {
+    }
+
+    Params params;
+
+    VideoEncoder encoder;
+
+    BoundedQueue<Frame>* convert_queue;
+    BoundedQueue<Frame>* encode_queue;
+
+    // Frames encoded so far
+    QAtomicInteger<qint64> encoded;
+  };
+
+  /**
+   * @brief Runs a stage's loop
+   */
+  class StageThread : public QThread
+  {
+  public:
+    StageThread(ExportEngine* engine, void (ExportEngine::*loop)(Destination*), Destination* destination = nullptr);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    ExportEngine* engine_;
+
+    void (ExportEngine::*loop_)(Destination*);
+
+    Destination* destination_;
+  };
+
+  /**
+   * @brief Queue frames for rendering as long as every destination has room for them in its pipeline
+   */
+  void QueueLoop(Destination*);
+
+  /**
+   * @brief Convert rendered frames to a destination's pixel format
+   */
+  void ConvertLoop(Destination* destination);
+
+  /**
+   * @brief Encode a destination's converted frames in order
+   */
+  void EncodeLoop(Destination* destination);
+
+  /**
+   * @brief Nanoseconds each stage has been busy for and nanoseconds since the export started
+   */
+  void GetBusyTime(qint64 busy[kStageCount], qint64* wall);
+
+  /**
+   * @brief Frames of the range the renderer will load from the DiskFrameCache rather than render
+   *
+   * Hashes every frame of the range (see NodeOutput::ContentHash()), so it's only done when there's a disk cache and
+   * frames fit in one tile, since tiled frames are never loaded from it (see RendererThread::FindCached()).
+   */
+  FrameRunList FindDiskCachedFrames(const olive::PixelFormat& format);
+
+  /**
+   * @brief Emit Progress() if every destination has encoded more frames than last reported
+   */
+  void UpdateProgress();
+
+  /**
+   * @brief Stop every stage because of an error (or a cancel if `message` is empty)
+   */
+  void Fail(const QString& message);
+
+  /**
+   * @brief Free frames that didn't make it through the pipeline
+   */
+  static void FreeFrames(const QQueue<Frame>& frames);
+
+  /**
+   * @brief Abort every destination's queues, freeing the frames on them
+   */
+  void AbortQueues();
+
+  /**
+   * @brief Close and delete every destination
+   */
+  void ClearDestinations();
+
+  // Shared by every destination, except for the filename and how it's encoded
+  Params params_;
+
+  RendererProcessor renderer_;
+
+  QVector<Destination*> destinations_;
+
+  // Frames waiting for rendering, conversion and encoding, see Params::frames_in_flight. A frame takes a slot in each
+  // destination, which releases it once it has encoded the frame.
+  QSemaphore slots_;
+
+  // Encoding threads that haven't stopped yet, the last one to stop invokes Complete()
+  QAtomicInt encoding_;
+
+  // Frames last reported with Progress()
+  QAtomicInteger<qint64> progress_;
+
+  // Index of the next frame RendererProcessor should deliver
+  int64_t next_delivery_;
+
+  // Pixel format frames are read back in
+  AVPixelFormat readback_format_;
+
+  QVector<StageThread*> threads_;
+
+  QAtomicInt running_;
+
+  QAtomicInt failed_;
+
+  QString error_;
+
+  QMutex error_mutex_;
+
+  QElapsedTimer timer_;
+
+  // Duration of the last export, once it's finished
+  qint64 wall_nsecs_;
+
+  // Busy nanoseconds of each stage's threads, and how many threads each stage has
+  QAtomicInteger<qint64> busy_nsecs_[kStageCount];
+  int stage_threads_[kStageCount];
+
+  // Frames each stage has processed (in every destination)
+  QAtomicInteger<qint64> stage_frames_[kStageCount];
+
+  ExportStatistics statistics_;
+
+  PerformanceCounters::Snapshot start_counters_;
+  PerformanceCounters::Snapshot end_counters_;
+
+private slots:
+  /**
+   * @brief Connected to RendererProcessor::FrameReady() directly, hands frames to the conversion threads
+   */
+  void FrameReady(RenderJobPtr job);
+
+  /**
+   * @brief Wait for every stage to stop and emit Finished(), invoked on the main thread
+   */
+  void Complete();
+};
+
+#endif // EXPORTENGINE_H
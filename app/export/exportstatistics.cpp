@@ -0,0 +1,289 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "exportstatistics.h"
+
+#include <QMutexLocker>
+
+QHash<NodeOutput*, ExportStatistics::History> ExportStatistics::history_;
+QMutex ExportStatistics::history_mutex_;
+
+ExportStatistics::ExportStatistics() :
+  output_(nullptr),
+  in_(0),
+  segment_frames_(1),
+  rendered_frames_(0),
+  rendered_nsecs_(0),
+  cached_frames_(0),
+  cached_nsecs_(0)
+{
+}
+
+void ExportStatistics::Start(NodeOutput *output, const rational &timebase, int64_t in, int64_t out,
+                             const FrameRunList &cached)
+{
+  QMutexLocker locker(&mutex_);
+
+  output_ = output;
+  timebase_ = timebase;
+  in_ = in;
+  cached_ = cached;
+
+  segment_frames_ = qMax(1, qRound(kSegmentSeconds / timebase.ToDouble()));
+
+  segments_.clear();
+
+  for (int64_t first=in;first<=out;first+=segment_frames_) {
+    Segment segment;
+
+    segment.first = first;
+    segment.last = qMin(out, first + segment_frames_ - 1);
+    segment.rendered = 0;
+    segment.render_nsecs = 0;
+    segment.cached = 0;
+    segment.cached_rendered = 0;
+    segment.predicted_nsecs = -1;
+
+    foreach (const FrameRunList::Run& run, cached_.RunsBetween(segment.first, segment.last)) {
+      segment.cached += run.last - run.first + 1;
+    }
+
+    segments_.append(segment);
+  }
+
+  rendered_frames_ = 0;
+  rendered_nsecs_ = 0;
+  cached_frames_ = 0;
+  cached_nsecs_ = 0;
+
+  QMutexLocker history_locker(&history_mutex_);
+
+  LookUpHistory(history_.value(output));
+}
+
+void ExportStatistics::AddFrame(int64_t frame, qint64 render_nsecs)
+{
+  QMutexLocker locker(&mutex_);
+
+  int index = static_cast<int>((frame - in_) / segment_frames_);
+
+  if (index < 0 || index >= segments_.size()) {
+    return;
+  }
+
+  Segment& segment = segments_[index];
+
+  if (cached_.Contains(frame)) {
+    segment.cached_rendered++;
+
+    cached_frames_++;
+    cached_nsecs_ += render_nsecs;
+  } else {
+    segment.rendered++;
+    segment.render_nsecs += render_nsecs;
+  }
+
+  rendered_frames_++;
+  rendered_nsecs_ += render_nsecs;
+}
+
+void ExportStatistics::Finish()
+{
+  QMutexLocker locker(&mutex_);
+
+  if (output_ == nullptr) {
+    return;
+  }
+
+  QMutexLocker history_locker(&history_mutex_);
+
+  History& history = history_[output_];
+
+  foreach (const Segment& segment, segments_) {
+    if (segment.rendered == 0) {
+      continue;
+    }
+
+    qint64 start_ms = FrameToMs(segment.first);
+    qint64 end_ms = FrameToMs(segment.last + 1);
+
+    // Replace whatever earlier exports measured for this part of the output
+    History::iterator it = history.begin();
+
+    while (it != history.end()) {
+      if (it.key() < end_ms && it.value().end_ms > start_ms) {
+        it = history.erase(it);
+      } else {
+        it++;
+      }
+    }
+
+    HistoryEntry entry;
+
+    entry.end_ms = end_ms;
+    entry.nsecs_per_frame = static_cast<double>(segment.render_nsecs) / static_cast<double>(segment.rendered);
+
+    history.insert(start_ms, entry);
+  }
+}
+
+QVector<ExportStatistics::Segment> ExportStatistics::segments()
+{
+  QMutexLocker locker(&mutex_);
+
+  Predict();
+
+  return segments_;
+}
+
+int64_t ExportStatistics::rendered_frames()
+{
+  QMutexLocker locker(&mutex_);
+
+  return rendered_frames_;
+}
+
+qint64 ExportStatistics::rendered_nsecs()
+{
+  QMutexLocker locker(&mutex_);
+
+  return rendered_nsecs_;
+}
+
+qint64 ExportStatistics::RemainingRenderNsecs()
+{
+  QMutexLocker locker(&mutex_);
+
+  Predict();
+
+  double remaining = 0;
+
+  // Cached frames only cost loading them, which doesn't depend on what's in them
+  double cached_mean = 0;
+
+  if (cached_frames_ > 0) {
+    cached_mean = static_cast<double>(cached_nsecs_) / static_cast<double>(cached_frames_);
+  }
+
+  foreach (const Segment& segment, segments_) {
+    remaining += static_cast<double>(segment.cached - segment.cached_rendered) * cached_mean;
+
+    int64_t frames = segment.last - segment.first + 1 - segment.cached - segment.rendered;
+
+    if (frames <= 0) {
+      continue;
+    }
+
+    if (segment.predicted_nsecs < 0) {
+      return -1;
+    }
+
+    remaining += static_cast<double>(frames) * segment.predicted_nsecs;
+  }
+
+  return qRound64(remaining);
+}
+
+void ExportStatistics::ClearHistory()
+{
+  QMutexLocker locker(&history_mutex_);
+
+  history_.clear();
+}
+
+qint64 ExportStatistics::FrameToMs(int64_t frame) const
+{
+  return qRound64(static_cast<double>(frame) * timebase_.ToDouble() * 1000.0);
+}
+
+void ExportStatistics::LookUpHistory(const ExportStatistics::History &history)
+{
+  historical_nsecs_.fill(-1, segments_.size());
+
+  if (history.isEmpty()) {
+    return;
+  }
+
+  for (int i=0;i<segments_.size();i++) {
+    qint64 start_ms = FrameToMs(segments_.at(i).first);
+    qint64 end_ms = FrameToMs(segments_.at(i).last + 1);
+
+    // Average every entry overlapping the segment, weighted by how much of it they cover
+    History::const_iterator it = history.upperBound(start_ms);
+
+    if (it != history.constBegin()) {
+      it--;
+    }
+
+    double weighted = 0;
+    qint64 covered = 0;
+
+    for (;it!=history.constEnd() && it.key() < end_ms;it++) {
+      qint64 overlap = qMin(end_ms, it.value().end_ms) - qMax(start_ms, it.key());
+
+      if (overlap > 0) {
+        weighted += it.value().nsecs_per_frame * static_cast<double>(overlap);
+        covered += overlap;
+      }
+    }
+
+    if (covered > 0) {
+      historical_nsecs_[i] = weighted / static_cast<double>(covered);
+    }
+  }
+}
+
+void ExportStatistics::Predict()
+{
+  // How this export compares to earlier ones in segments both have rendered
+  double measured = 0;
+  double historical = 0;
+
+  for (int i=0;i<segments_.size();i++) {
+    const Segment& segment = segments_.at(i);
+
+    if (segment.rendered > 0 && historical_nsecs_.at(i) >= 0) {
+      measured += static_cast<double>(segment.render_nsecs);
+      historical += static_cast<double>(segment.rendered) * historical_nsecs_.at(i);
+    }
+  }
+
+  double scale = (measured > 0 && historical > 0) ? measured / historical : 1.0;
+
+  // Mean of the frames that were actually rendered
+  double mean = -1;
+
+  if (rendered_frames_ > cached_frames_) {
+    mean = static_cast<double>(rendered_nsecs_ - cached_nsecs_)
+        / static_cast<double>(rendered_frames_ - cached_frames_);
+  }
+
+  for (int i=0;i<segments_.size();i++) {
+    Segment& segment = segments_[i];
+
+    if (segment.rendered > 0) {
+      segment.predicted_nsecs = static_cast<double>(segment.render_nsecs) / static_cast<double>(segment.rendered);
+    } else if (historical_nsecs_.at(i) >= 0) {
+      segment.predicted_nsecs = historical_nsecs_.at(i) * scale;
+    } else {
+      segment.predicted_nsecs = mean;
+    }
+  }
+}
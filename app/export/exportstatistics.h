@@ -0,0 +1,185 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTSTATISTICS_H
+#define EXPORTSTATISTICS_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include "common/framerunlist.h"
+#include "common/rational.h"
+
+class NodeOutput;
+
+/**
+ * @brief Records how long an export spends rendering each part of its range and predicts how long the rest will take
+ *
+ * The range is split into segments of kSegmentSeconds and the render time of every frame is added to its segment, so
+ * parts of a timeline that are heavier than others (e.g. a section with effects on it) aren't averaged away. The
+ * render time of frames that haven't been rendered yet is predicted segment by segment, from the first of:
+ *
+ * * The mean of the frames already rendered in the same segment.
+ * * What the same part of the output cost in earlier exports this session, scaled by how this export compares to them
+ *   in segments both have rendered (which accounts for a different resolution or a busier machine).
+ * * The mean of every frame rendered so far.
+ *
+ * Segments are added to the history with Finish(), keyed by the output and the time they cover, so an export of the
+ * same sequence can predict how long it'll take before it's rendered anything.
+ *
+ * Frames that were already in the disk cache when the export started (see Start()) are loaded rather than rendered,
+ * so they're kept out of the segments and the history and predicted at the mean of the cached frames delivered so far.
+ *
+ * All functions are thread-safe.
+ */
+class ExportStatistics
+{
+public:
+  struct Segment {
+    // First and last frame of the segment (inclusive)
+    int64_t first;
+    int64_t last;
+
+    // Frames rendered so far and the nanoseconds spent rendering them
+    int64_t rendered;
+    qint64 render_nsecs;
+
+    // Frames that were in the disk cache when the export started and how many of them have been delivered, neither
+    // is counted in `rendered`
+    int64_t cached;
+    int64_t cached_rendered;
+
+    // Predicted nanoseconds each of the uncached frames that haven't been rendered yet will take, -1 if there's
+    // nothing to predict it from
+    double predicted_nsecs;
+  };
+
+  ExportStatistics();
+
+  /**
+   * @brief Clear the statistics for a new export of frames `in` to `out` (inclusive) of `output`
+   *
+   * @param cached
+   *
+   * Frames the export will load from the disk cache instead of rendering them.
+   */
+  void Start(NodeOutput* output, const rational& timebase, int64_t in, int64_t out,
+             const FrameRunList& cached = FrameRunList());
+
+  /**
+   * @brief Record the time a frame took to render (on one thread, including reading it back or loading it from the
+   * disk cache)
+   */
+  void AddFrame(int64_t frame, qint64 render_nsecs);
+
+  /**
+   * @brief Add the segments rendered so far to the history for later exports
+   */
+  void Finish();
+
+  /**
+   * @brief Every segment of the export in order, with its prediction
+   */
+  QVector<Segment> segments();
+
+  /**
+   * @brief Frames delivered so far and the nanoseconds spent on them, including cached frames
+   */
+  int64_t rendered_frames();
+
+  qint64 rendered_nsecs();
+
+  /**
+   * @brief Predicted nanoseconds of rendering the frames that haven't been rendered yet, -1 if it can't be predicted
+   *
+   * This is thread time, so it's divided by however many frames are rendered at once to get the wall time.
+   */
+  qint64 RemainingRenderNsecs();
+
+  /**
+   * @brief Forget every earlier export
+   */
+  static void ClearHistory();
+
+  /**
+   * @brief Length of each segment
+   */
+  static const int kSegmentSeconds = 2;
+
+private:
+  /**
+   * @brief Nanoseconds per frame an output took to render from start_ms to end_ms in an earlier export
+   */
+  struct HistoryEntry {
+    qint64 end_ms;
+    double nsecs_per_frame;
+  };
+
+  using History = QMap<qint64, HistoryEntry>;
+
+  /**
+   * @brief Milliseconds from the start of the output to a frame
+   */
+  qint64 FrameToMs(int64_t frame) const;
+
+  /**
+   * @brief Fill in every segment's historical cost, -1 for segments the history doesn't cover (history_mutex_ must
+   * be locked)
+   */
+  void LookUpHistory(const History& history);
+
+  /**
+   * @brief Predict each segment's cost per frame (mutex_ must be locked)
+   */
+  void Predict();
+
+  NodeOutput* output_;
+
+  rational timebase_;
+
+  int64_t in_;
+
+  int segment_frames_;
+
+  QVector<Segment> segments_;
+
+  // Nanoseconds per frame each segment took in earlier exports, -1 if it hasn't been exported before
+  QVector<double> historical_nsecs_;
+
+  FrameRunList cached_;
+
+  int64_t rendered_frames_;
+
+  qint64 rendered_nsecs_;
+
+  int64_t cached_frames_;
+
+  qint64 cached_nsecs_;
+
+  QMutex mutex_;
+
+  static QHash<NodeOutput*, History> history_;
+
+  static QMutex history_mutex_;
+};
+
+#endif // EXPORTSTATISTICS_H
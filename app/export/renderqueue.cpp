@@ -0,0 +1,312 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderqueue.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include "task/taskmanager.h"
+
+RenderQueue::RenderQueue(QObject *parent) :
+  QObject(parent),
+  next_id_(0),
+  concurrency_(kDefaultConcurrency),
+  running_(false),
+  cancelling_(false)
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+  // Engines stop (and clean up their files) when they're destroyed
+  QList<ExportEngine*> engines = engines_.keys();
+
+  engines_.clear();
+
+  foreach (std::shared_ptr<ExportTask> task, tasks_) {
+    task->SetFinished(false, tr("Export was cancelled"));
+  }
+
+  tasks_.clear();
+
+  qDeleteAll(engines);
+}
+
+int RenderQueue::AddJob(const ExportEngine::Params &params)
+{
+  Job job;
+  job.id = next_id_++;
+  job.params = params;
+  job.status = kQueued;
+  job.completed = 0;
+  job.total = qMax(static_cast<int64_t>(0), params.out - params.in + 1);
+  job.remaining = -1;
+
+  jobs_.append(job);
+
+  emit JobAdded(job.id);
+
+  if (running_) {
+    StartEngines();
+  }
+
+  return job.id;
+}
+
+bool RenderQueue::RemoveJob(int id)
+{
+  for (int i=0;i<jobs_.size();i++) {
+    if (jobs_.at(i).id == id) {
+      if (jobs_.at(i).status == kRunning) {
+        return false;
+      }
+
+      jobs_.removeAt(i);
+
+      emit JobRemoved(id);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const QList<RenderQueue::Job> &RenderQueue::jobs() const
+{
+  return jobs_;
+}
+
+const RenderQueue::Job *RenderQueue::job(int id) const
+{
+  for (int i=0;i<jobs_.size();i++) {
+    if (jobs_.at(i).id == id) {
+      return &jobs_.at(i);
+    }
+  }
+
+  return nullptr;
+}
+
+int RenderQueue::concurrency() const
+{
+  return concurrency_;
+}
+
+void RenderQueue::SetConcurrency(int engines)
+{
+  concurrency_ = qMax(1, engines);
+
+  if (running_) {
+    StartEngines();
+  }
+}
+
+bool RenderQueue::IsRunning() const
+{
+  return running_;
+}
+
+void RenderQueue::Start()
+{
+  if (running_) {
+    return;
+  }
+
+  running_ = true;
+  cancelling_ = false;
+
+  StartEngines();
+}
+
+void RenderQueue::Cancel()
+{
+  if (!running_) {
+    return;
+  }
+
+  cancelling_ = true;
+
+  // Each engine emits Finished() once it has stopped
+  foreach (ExportEngine* engine, engines_.keys()) {
+    engine->Cancel();
+  }
+}
+
+RenderQueue::Job *RenderQueue::FindJob(int id)
+{
+  for (int i=0;i<jobs_.size();i++) {
+    if (jobs_.at(i).id == id) {
+      return &jobs_[i];
+    }
+  }
+
+  return nullptr;
+}
+
+void RenderQueue::StartEngines()
+{
+  while (!cancelling_ && engines_.size() < concurrency_) {
+    // Start the first queued job along with every other queued job rendering the same frames
+    QVector<int> ids;
+    QVector<ExportEngine::Params> params;
+
+    foreach (const Job& job, jobs_) {
+      if (job.status == kQueued && (params.isEmpty() || ExportEngine::CanShareRender(params.first(), job.params))) {
+        ids.append(job.id);
+        params.append(job.params);
+      }
+    }
+
+    if (ids.isEmpty()) {
+      break;
+    }
+
+    foreach (const ExportEngine::Params& p, params) {
+      QDir().mkpath(QFileInfo(p.filename).absolutePath());
+    }
+
+    ExportEngine* engine = new ExportEngine(this);
+
+    bool started = engine->Start(params);
+
+    foreach (int id, ids) {
+      Job* job = FindJob(id);
+
+      if (started) {
+        job->status = kRunning;
+      } else {
+        job->status = kFailed;
+        job->error = engine->error();
+      }
+
+      emit JobChanged(id);
+    }
+
+    if (started) {
+      connect(engine, SIGNAL(Progress(qint64, qint64)), this, SLOT(EngineProgress(qint64, qint64)));
+      connect(engine, SIGNAL(Finished(bool)), this, SLOT(EngineFinished(bool)));
+
+      engines_.insert(engine, ids);
+
+      QString filename = QFileInfo(params.first().filename).fileName();
+
+      std::shared_ptr<ExportTask> task = std::make_shared<ExportTask>(
+            (params.size() > 1) ? tr("Exporting %1 (and %n more)", nullptr, params.size() - 1).arg(filename)
+                                : tr("Exporting %1").arg(filename));
+
+      connect(task.get(), SIGNAL(CancelRequested()), this, SLOT(TaskCancelRequested()), Qt::QueuedConnection);
+
+      tasks_.insert(engine, task);
+
+      olive::task_manager.AddTask(task);
+    } else {
+      delete engine;
+    }
+  }
+
+  if (engines_.isEmpty()) {
+    running_ = false;
+    cancelling_ = false;
+
+    emit Finished();
+  }
+}
+
+void RenderQueue::EngineProgress(qint64 completed, qint64 total)
+{
+  ExportEngine* engine = static_cast<ExportEngine*>(sender());
+
+  qint64 remaining = engine->EstimatedRemaining();
+
+  foreach (int id, engines_.value(engine)) {
+    Job* job = FindJob(id);
+
+    job->completed = completed;
+    job->total = total;
+    job->remaining = remaining;
+
+    emit JobChanged(id);
+  }
+
+  std::shared_ptr<ExportTask> task = tasks_.value(engine);
+
+  if (task != nullptr) {
+    task->UpdateProgress(completed, total, remaining);
+  }
+}
+
+void RenderQueue::EngineFinished(bool ok)
+{
+  ExportEngine* engine = static_cast<ExportEngine*>(sender());
+
+  if (!engines_.contains(engine)) {
+    return;
+  }
+
+  QVector<int> ids = engines_.take(engine);
+
+  bool cancelled = cancelled_.remove(engine);
+
+  foreach (int id, ids) {
+    Job* job = FindJob(id);
+
+    job->remaining = ok ? 0 : -1;
+
+    if (ok) {
+      job->status = kFinished;
+    } else if (cancelling_ || cancelled) {
+      job->status = kCancelled;
+    } else {
+      job->status = kFailed;
+      job->error = engine->error();
+    }
+
+    emit JobChanged(id);
+  }
+
+  std::shared_ptr<ExportTask> task = tasks_.take(engine);
+
+  if (task != nullptr) {
+    task->SetFinished(ok, engine->error());
+  }
+
+  // Emitted from Complete(), so the engine can't be deleted straight away
+  engine->deleteLater();
+
+  StartEngines();
+}
+
+void RenderQueue::TaskCancelRequested()
+{
+  ExportTask* task = static_cast<ExportTask*>(sender());
+
+  QMap<ExportEngine*, std::shared_ptr<ExportTask> >::const_iterator i;
+
+  for (i=tasks_.constBegin();i!=tasks_.constEnd();i++) {
+    if (i.value().get() == task) {
+      // The engine emits Finished() once it has stopped
+      cancelled_.insert(i.key());
+      i.key()->Cancel();
+      break;
+    }
+  }
+}
@@ -0,0 +1,195 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <memory>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include "export/exportengine.h"
+#include "task/export/export.h"
+
+/**
+ * @brief Runs a list of exports, several at once
+ *
+ * Queued jobs that render exactly the same frames (see ExportEngine::CanShareRender(), e.g. one sequence delivered in
+ * several formats) are started together in one ExportEngine, so each frame is decoded, rendered and read back once
+ * and fanned out to every job's encoder. Up to concurrency() engines run at the same time. Engines share the
+ * application's decoder pools, packet cache and disk frame cache, so footage that several of them use is only read
+ * and decoded once while it stays cached.
+ *
+ * Jobs started together stop together: if one of their files fails, the others are cancelled.
+ *
+ * Each running engine is also shown as an ExportTask in olive::task_manager, with its progress and how long it's
+ * predicted to take. Cancelling the Task cancels every job in the engine.
+ *
+ * Must only be used from the main thread.
+ */
+class RenderQueue : public QObject
+{
+  Q_OBJECT
+public:
+  enum Status {
+    kQueued,
+    kRunning,
+    kFinished,
+    kFailed,
+    kCancelled
+  };
+
+  struct Job {
+    int id;
+
+    ExportEngine::Params params;
+
+    Status status;
+
+    // Frames encoded so far and in total
+    qint64 completed;
+    qint64 total;
+
+    // Predicted milliseconds until the job finishes, -1 if unknown (see ExportEngine::EstimatedRemaining())
+    qint64 remaining;
+
+    // Why the job failed
+    QString error;
+  };
+
+  RenderQueue(QObject* parent = nullptr);
+
+  virtual ~RenderQueue() override;
+
+  /**
+   * @brief Add a job to the end of the queue and return its ID
+   *
+   * If the queue is running, the job is started as soon as an engine is free.
+   */
+  int AddJob(const ExportEngine::Params& params);
+
+  /**
+   * @brief Remove a job that isn't running, returns FALSE if it's running or doesn't exist
+   */
+  bool RemoveJob(int id);
+
+  /**
+   * @brief Returns every job in the order they were added
+   */
+  const QList<Job>& jobs() const;
+
+  /**
+   * @brief Returns the job with an ID, or nullptr if it doesn't exist
+   */
+  const Job* job(int id) const;
+
+  /**
+   * @brief Returns how many engines may run at once
+   */
+  int concurrency() const;
+
+  /**
+   * @brief Set how many engines may run at once (at least 1)
+   *
+   * Lowering it doesn't stop engines that are already running.
+   */
+  void SetConcurrency(int engines);
+
+  bool IsRunning() const;
+
+  /**
+   * @brief Default for concurrency()
+   */
+  static const int kDefaultConcurrency = 2;
+
+public slots:
+  /**
+   * @brief Start queued jobs, the queue keeps running until there are no more queued jobs
+   */
+  void Start();
+
+  /**
+   * @brief Cancel every running job and stop starting queued ones
+   */
+  void Cancel();
+
+signals:
+  void JobAdded(int id);
+
+  void JobRemoved(int id);
+
+  /**
+   * @brief Emitted when a job's status or progress changes
+   */
+  void JobChanged(int id);
+
+  /**
+   * @brief Emitted once the queue has stopped, because it ran out of queued jobs or was cancelled
+   */
+  void Finished();
+
+private:
+  Job* FindJob(int id);
+
+  /**
+   * @brief Start engines for queued jobs until concurrency() are running or there are no more queued jobs
+   */
+  void StartEngines();
+
+  QList<Job> jobs_;
+
+  // Jobs each running engine is exporting
+  QMap<ExportEngine*, QVector<int> > engines_;
+
+  // The Task showing each running engine
+  QMap<ExportEngine*, std::shared_ptr<ExportTask> > tasks_;
+
+  // Engines cancelled through their Task
+  QSet<ExportEngine*> cancelled_;
+
+  int next_id_;
+
+  int concurrency_;
+
+  bool running_;
+
+  bool cancelling_;
+
+private slots:
+  /**
+   * @brief Connected to each engine's ExportEngine::Progress()
+   */
+  void EngineProgress(qint64 completed, qint64 total);
+
+  /**
+   * @brief Connected to each engine's ExportEngine::Finished()
+   */
+  void EngineFinished(bool ok);
+
+  /**
+   * @brief Connected to each engine's ExportTask::CancelRequested()
+   */
+  void TaskCancelRequested();
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,631 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "smartrender.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "export/videoconcat.h"
+#include "export/videoencoder.h"
+
+SmartRender::Segment::Segment() :
+  in(0),
+  out(-1),
+  stream_index(0)
+{
+}
+
+SmartRender::Part::Part() :
+  in(0),
+  out(-1),
+  stream_index(0),
+  first_dts(AV_NOPTS_VALUE),
+  end_dts(AV_NOPTS_VALUE)
+{
+}
+
+SmartRender::WorkerThread::WorkerThread(const std::function<bool ()> &func, QObject *parent) :
+  QThread(parent),
+  func_(func),
+  result_(false)
+{
+}
+
+bool SmartRender::WorkerThread::result() const
+{
+  return result_;
+}
+
+void SmartRender::WorkerThread::run()
+{
+  result_ = func_();
+}
+
+SmartRender::SmartRender(QObject *parent) :
+  QObject(parent),
+  current_part_(0),
+  completed_frames_(0),
+  total_frames_(0),
+  copied_frames_(0),
+  worker_(nullptr),
+  running_(0)
+{
+  connect(&engine_, SIGNAL(Progress(qint64, qint64)), this, SLOT(EngineProgress(qint64, qint64)));
+  connect(&engine_, SIGNAL(Finished(bool)), this, SLOT(EngineFinished(bool)));
+}
+
+SmartRender::~SmartRender()
+{
+  running_ = 0;
+
+  if (worker_ != nullptr) {
+    worker_->wait();
+  }
+}
+
+bool SmartRender::Start(const SmartRender::Params &params)
+{
+  if (IsRunning()) {
+    error_ = tr("An export is already running");
+    return false;
+  }
+
+  params_ = params;
+
+  const ExportEngine::Params& export_params = params_.export_params;
+
+  error_.clear();
+  parts_.clear();
+  current_part_ = 0;
+  completed_frames_ = 0;
+  total_frames_ = export_params.out - export_params.in + 1;
+  copied_frames_ = 0;
+
+  // Find out exactly what the exported stream will look like by opening an encoder with the export's settings
+  QFileInfo output_info(export_params.filename);
+  QString probe_filename = output_info.dir().filePath(QStringLiteral("%1.probe.%2").arg(output_info.completeBaseName(),
+                                                                                        output_info.suffix()));
+
+  AVCodecParameters* target = avcodec_parameters_alloc();
+
+  VideoEncoder probe;
+
+  bool probed = probe.Open(probe_filename,
+                           export_params.width,
+                           export_params.height,
+                           export_params.timebase,
+                           export_params.codec,
+                           export_params.bit_rate,
+                           export_params.hardware_encoding)
+      && avcodec_parameters_copy(target, probe.codecpar()) >= 0;
+
+  probe.Close();
+  QFile::remove(probe_filename);
+
+  QList<Segment> segments = params_.segments;
+
+  std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) {
+    return a.in < b.in;
+  });
+
+  // Split the export into rendered and copied parts, if the encoder couldn't be opened everything is rendered and
+  // ExportEngine reports why
+  int64_t cursor = export_params.in;
+
+  foreach (const Segment& s, segments) {
+    if (!probed) {
+      break;
+    }
+
+    Segment segment = s;
+
+    if (segment.in < cursor) {
+      segment.media_in = segment.media_in + rational(cursor - segment.in) * export_params.timebase;
+      segment.in = cursor;
+    }
+
+    segment.out = qMin(segment.out, export_params.out);
+
+    Part copy;
+
+    if (segment.in > segment.out || !PlanSegment(segment, target, &copy)) {
+      continue;
+    }
+
+    if (copy.in > cursor) {
+      Part render;
+      render.in = cursor;
+      render.out = copy.in - 1;
+      parts_.append(render);
+    }
+
+    parts_.append(copy);
+
+    copied_frames_ += copy.out - copy.in + 1;
+    cursor = copy.out + 1;
+  }
+
+  avcodec_parameters_free(&target);
+
+  if (cursor <= export_params.out) {
+    Part render;
+    render.in = cursor;
+    render.out = export_params.out;
+    parts_.append(render);
+  }
+
+  if (parts_.size() == 1) {
+    parts_.first().filename = export_params.filename;
+  } else {
+    for (int i=0;i<parts_.size();i++) {
+      parts_[i].filename = PartFilename(i);
+    }
+  }
+
+  running_ = 1;
+
+  if (!StartPart()) {
+    running_ = 0;
+    return false;
+  }
+
+  return true;
+}
+
+bool SmartRender::IsRunning()
+{
+  return (running_.load() != 0);
+}
+
+QString SmartRender::error()
+{
+  return error_;
+}
+
+int64_t SmartRender::copied_frames()
+{
+  return copied_frames_;
+}
+
+void SmartRender::Cancel()
+{
+  if (!IsRunning()) {
+    return;
+  }
+
+  error_ = tr("Export was cancelled");
+
+  // Copying notices on its own, ExportEngine emits Finished() once it's stopped
+  running_ = 0;
+
+  if (engine_.IsRunning()) {
+    engine_.Cancel();
+  }
+}
+
+bool SmartRender::Matches(const AVStream *source, const AVCodecParameters *target, const rational &timebase)
+{
+  const AVCodecParameters* par = source->codecpar;
+
+  if (par->codec_type != AVMEDIA_TYPE_VIDEO
+      || par->codec_id != target->codec_id
+      || par->width != target->width
+      || par->height != target->height
+      || par->format != target->format) {
+    return false;
+  }
+
+  AVRational rate = source->avg_frame_rate;
+
+  if (rate.num <= 0 || rate.den <= 0 || rational(rate.den, rate.num) != timebase) {
+    return false;
+  }
+
+  const AVCodecDescriptor* desc = avcodec_descriptor_get(par->codec_id);
+
+  if (desc != nullptr && (desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+    return true;
+  }
+
+  // Long-GOP packets can only be mixed with the encoder's if they're decoded with the same parameter sets
+  return par->extradata_size == target->extradata_size
+      && (par->extradata_size == 0 || memcmp(par->extradata, target->extradata, par->extradata_size) == 0);
+}
+
+bool SmartRender::PlanSegment(const SmartRender::Segment &segment, const AVCodecParameters *target, Part *part)
+{
+  AVFormatContext* ctx = nullptr;
+
+  if (avformat_open_input(&ctx, segment.filename.toUtf8().constData(), nullptr, nullptr) < 0) {
+    return false;
+  }
+
+  if (avformat_find_stream_info(ctx, nullptr) < 0
+      || segment.stream_index < 0
+      || segment.stream_index >= static_cast<int>(ctx->nb_streams)
+      || !Matches(ctx->streams[segment.stream_index], target, params_.export_params.timebase)) {
+    avformat_close_input(&ctx);
+    return false;
+  }
+
+  AVStream* stream = ctx->streams[segment.stream_index];
+
+  double stream_tb = av_q2d(stream->time_base);
+  double frame_duration = params_.export_params.timebase.ToDouble();
+  double media_in = segment.media_in.ToDouble();
+
+  // Start from the keyframe before the segment rather than reading the whole file
+  av_seek_frame(ctx, stream->index, static_cast<int64_t>(media_in / stream_tb), AVSEEK_FLAG_BACKWARD);
+
+  AVPacket* pkt = av_packet_alloc();
+
+  bool have_first = false;
+  int64_t first_frame = 0;
+  int64_t end_frame = 0;
+  int64_t last_key_frame = 0;
+
+  // Packets between the first keyframe and the latest keyframe that could end the copy, and the count up to it
+  int64_t packet_count = 0;
+  int64_t end_packet_count = 0;
+
+  bool usable = true;
+  bool ended = true;
+
+  while (av_read_frame(ctx, pkt) >= 0) {
+    if (pkt->stream_index != stream->index || pkt->pts == AV_NOPTS_VALUE) {
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    int64_t dts = (pkt->dts == AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+    int64_t frame = segment.in + std::llround((pkt->pts * stream_tb - media_in) / frame_duration);
+    bool key = (pkt->flags & AV_PKT_FLAG_KEY);
+
+    av_packet_unref(pkt);
+
+    if (!have_first) {
+      if (key && frame >= segment.in && frame <= segment.out) {
+        have_first = true;
+        first_frame = frame;
+        last_key_frame = frame;
+        end_frame = frame;
+        part->first_dts = dts;
+        packet_count = 1;
+      }
+
+      continue;
+    }
+
+    if (key) {
+      if (frame > segment.out + 1) {
+        ended = false;
+        break;
+      }
+
+      // Everything before this keyframe can be copied
+      end_frame = frame;
+      end_packet_count = packet_count;
+      part->end_dts = dts;
+      last_key_frame = frame;
+
+    } else if (frame < last_key_frame) {
+      // Open GOPs have frames after a keyframe that are shown before it, which can't be cut there
+      usable = false;
+      break;
+    }
+
+    if (frame <= segment.out) {
+      packet_count++;
+    }
+  }
+
+  av_packet_free(&pkt);
+  avformat_close_input(&ctx);
+
+  if (!usable || !have_first) {
+    return false;
+  }
+
+  if (ended) {
+    // The stream ended inside the segment, so the copy can run to its end
+    end_frame = first_frame + packet_count;
+    end_packet_count = packet_count;
+    part->end_dts = AV_NOPTS_VALUE;
+  }
+
+  // Only copy if every frame in the range has exactly one packet (i.e. the stream is constant frame rate)
+  if (end_frame <= first_frame || end_packet_count != end_frame - first_frame) {
+    return false;
+  }
+
+  part->in = first_frame;
+  part->out = end_frame - 1;
+  part->source = segment.filename;
+  part->stream_index = segment.stream_index;
+
+  return true;
+}
+
+bool SmartRender::CopyPart(const SmartRender::Part &part)
+{
+  AVFormatContext* in_ctx = nullptr;
+
+  if (avformat_open_input(&in_ctx, part.source.toUtf8().constData(), nullptr, nullptr) < 0
+      || avformat_find_stream_info(in_ctx, nullptr) < 0) {
+    error_ = tr("Failed to open %1").arg(part.source);
+    avformat_close_input(&in_ctx);
+    return false;
+  }
+
+  AVStream* in_stream = in_ctx->streams[part.stream_index];
+
+  QByteArray output_ba = part.filename.toUtf8();
+
+  AVFormatContext* out_ctx = nullptr;
+  AVStream* out_stream = nullptr;
+
+  bool ok = avformat_alloc_output_context2(&out_ctx, nullptr, nullptr, output_ba.constData()) >= 0
+      && (out_stream = avformat_new_stream(out_ctx, nullptr)) != nullptr
+      && avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) >= 0;
+
+  bool opened = false;
+
+  if (ok) {
+    // Tags are specific to the input's container
+    out_stream->codecpar->codec_tag = 0;
+    out_stream->time_base = in_stream->time_base;
+
+    if (!(out_ctx->oformat->flags & AVFMT_NOFILE)) {
+      ok = opened = (avio_open(&out_ctx->pb, output_ba.constData(), AVIO_FLAG_WRITE) >= 0);
+    }
+  }
+
+  ok = ok && avformat_write_header(out_ctx, nullptr) >= 0;
+
+  if (!ok) {
+    error_ = tr("Failed to create %1").arg(part.filename);
+  }
+
+  if (ok) {
+    av_seek_frame(in_ctx, in_stream->index, part.first_dts, AVSEEK_FLAG_BACKWARD);
+
+    AVPacket* pkt = av_packet_alloc();
+
+    bool started = false;
+    int error_code;
+
+    while ((error_code = av_read_frame(in_ctx, pkt)) >= 0) {
+      if (running_.load() == 0) {
+        av_packet_unref(pkt);
+        ok = false;
+        break;
+      }
+
+      int64_t dts = (pkt->dts == AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+
+      if (pkt->stream_index != in_stream->index || dts == AV_NOPTS_VALUE || (!started && dts < part.first_dts)) {
+        av_packet_unref(pkt);
+        continue;
+      }
+
+      if (part.end_dts != AV_NOPTS_VALUE && dts >= part.end_dts) {
+        av_packet_unref(pkt);
+        break;
+      }
+
+      started = true;
+
+      // Each part starts at zero, VideoConcat moves them into place
+      if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts -= part.first_dts;
+      }
+
+      if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts -= part.first_dts;
+      }
+
+      pkt->stream_index = out_stream->index;
+      pkt->pos = -1;
+
+      // av_interleaved_write_frame() takes ownership of the packet's data
+      if (av_interleaved_write_frame(out_ctx, pkt) < 0) {
+        error_ = tr("Failed to write %1").arg(part.filename);
+        ok = false;
+        break;
+      }
+    }
+
+    if (ok && error_code < 0 && error_code != AVERROR_EOF) {
+      error_ = tr("Failed to read %1").arg(part.source);
+      ok = false;
+    }
+
+    av_packet_free(&pkt);
+
+    if (ok && av_write_trailer(out_ctx) < 0) {
+      error_ = tr("Failed to finalize %1").arg(part.filename);
+      ok = false;
+    }
+  }
+
+  if (out_ctx != nullptr) {
+    if (opened) {
+      avio_closep(&out_ctx->pb);
+    }
+
+    avformat_free_context(out_ctx);
+  }
+
+  avformat_close_input(&in_ctx);
+
+  return ok;
+}
+
+QString SmartRender::PartFilename(int index) const
+{
+  QFileInfo output_info(params_.export_params.filename);
+
+  return output_info.dir().filePath(QStringLiteral("%1.part%2.%3").arg(output_info.completeBaseName(),
+                                                                       QString::number(index).rightJustified(4, '0'),
+                                                                       output_info.suffix()));
+}
+
+bool SmartRender::StartPart()
+{
+  if (current_part_ == parts_.size()) {
+    if (parts_.size() == 1) {
+      // Rendered straight into the output
+      Finish(true);
+      return true;
+    }
+
+    QStringList filenames;
+
+    foreach (const Part& part, parts_) {
+      filenames.append(part.filename);
+    }
+
+    QString output = params_.export_params.filename;
+
+    RunWorker([this, filenames, output]() {
+      VideoConcat concat;
+
+      bool ok = concat.Concatenate(filenames, output);
+
+      if (!ok) {
+        error_ = concat.error();
+      }
+
+      return ok;
+    });
+
+    return true;
+  }
+
+  const Part& part = parts_.at(current_part_);
+
+  if (part.source.isEmpty()) {
+    ExportEngine::Params part_params = params_.export_params;
+    part_params.in = part.in;
+    part_params.out = part.out;
+    part_params.filename = part.filename;
+
+    if (!engine_.Start(part_params)) {
+      error_ = engine_.error();
+      return false;
+    }
+  } else {
+    Part copy = part;
+
+    RunWorker([this, copy]() {
+      return CopyPart(copy);
+    });
+  }
+
+  return true;
+}
+
+void SmartRender::NextPart()
+{
+  const Part& part = parts_.at(current_part_);
+
+  completed_frames_ += part.out - part.in + 1;
+
+  emit Progress(completed_frames_, total_frames_);
+
+  current_part_++;
+
+  if (!StartPart()) {
+    Finish(false);
+  }
+}
+
+void SmartRender::RunWorker(const std::function<bool ()> &func)
+{
+  worker_ = new WorkerThread(func, this);
+
+  connect(worker_, SIGNAL(finished()), this, SLOT(WorkerFinished()));
+
+  worker_->start();
+}
+
+void SmartRender::Finish(bool ok)
+{
+  running_ = 0;
+
+  if (parts_.size() > 1) {
+    foreach (const Part& part, parts_) {
+      QFile::remove(part.filename);
+    }
+  }
+
+  emit Finished(ok);
+}
+
+void SmartRender::EngineProgress(qint64 completed, qint64 total)
+{
+  Q_UNUSED(total)
+
+  emit Progress(completed_frames_ + completed, total_frames_);
+}
+
+void SmartRender::EngineFinished(bool ok)
+{
+  if (!ok || !IsRunning()) {
+    if (error_.isEmpty()) {
+      error_ = engine_.error();
+    }
+
+    Finish(false);
+    return;
+  }
+
+  NextPart();
+}
+
+void SmartRender::WorkerFinished()
+{
+  bool ok = worker_->result();
+
+  worker_->deleteLater();
+  worker_ = nullptr;
+
+  if (!ok || !IsRunning()) {
+    Finish(false);
+    return;
+  }
+
+  if (current_part_ == parts_.size()) {
+    // The parts have been joined
+    Finish(true);
+    return;
+  }
+
+  NextPart();
+}
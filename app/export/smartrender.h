@@ -0,0 +1,241 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SMARTRENDER_H
+#define SMARTRENDER_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QAtomicInt>
+#include <QList>
+#include <QObject>
+#include <QThread>
+#include <functional>
+
+#include "export/exportengine.h"
+
+/**
+ * @brief Exports a range like ExportEngine, but copies segments that show a source stream unmodified
+ *
+ * Callers list the Segments of the export that are a source video stream shown as it is (no effects, no retiming).
+ * If the stream's codec and parameters match what the export is encoded with (see Matches()), its packets are copied
+ * into the file as they are rather than being decoded, rendered and encoded again. Only keyframe-aligned ranges can be
+ * copied, so the frames between a segment's cut and the keyframe after it (and from the last keyframe before the
+ * segment's end to the end) are still rendered.
+ *
+ * The export is split into parts at those boundaries. Rendered parts are exported with ExportEngine and copied parts
+ * are written by stream copy, each into its own file, one after the other. VideoConcat then joins them into the
+ * output and the part files are deleted. An export with nothing to copy is rendered straight into the output.
+ *
+ * Start() and the slots must be called from the main thread.
+ */
+class SmartRender : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief A range of the export that shows a source video stream unmodified
+   */
+  struct Segment {
+    Segment();
+
+    // First and last frame of the export the stream is shown in (inclusive), in the export's timebase
+    int64_t in;
+    int64_t out;
+
+    // Source file and index of the video stream in it
+    QString filename;
+    int stream_index;
+
+    // Timestamp in the stream (in seconds, as its packets' pts) shown at `in`
+    rational media_in;
+  };
+
+  struct Params {
+    // What to export, see ExportEngine::Params
+    ExportEngine::Params export_params;
+
+    QList<Segment> segments;
+  };
+
+  SmartRender(QObject* parent = nullptr);
+
+  virtual ~SmartRender() override;
+
+  /**
+   * @brief Work out which frames can be copied and start exporting
+   *
+   * Checking the segments reads through their packets (without decoding them), which takes a moment for long
+   * segments.
+   *
+   * @return
+   *
+   * FALSE if the export couldn't be started (see error()), in which case Finished() won't be emitted.
+   */
+  bool Start(const Params& params);
+
+  bool IsRunning();
+
+  /**
+   * @brief Error message of a failed export
+   */
+  QString error();
+
+  /**
+   * @brief Number of frames copied rather than rendered (known once Start() has returned)
+   */
+  int64_t copied_frames();
+
+public slots:
+  /**
+   * @brief Stop exporting, Finished() is emitted with FALSE once the current part has stopped
+   */
+  void Cancel();
+
+signals:
+  /**
+   * @brief Emitted as frames are rendered or copied
+   */
+  void Progress(qint64 completed, qint64 total);
+
+  /**
+   * @brief Emitted once the file has been finalized or the export has failed or been cancelled
+   */
+  void Finished(bool ok);
+
+private:
+  /**
+   * @brief Range of the export that's either rendered or copied
+   */
+  struct Part {
+    Part();
+
+    // Frames of the export (inclusive)
+    int64_t in;
+    int64_t out;
+
+    // File the part is written to
+    QString filename;
+
+    // Source of a copied part (empty for rendered parts), packets are copied in decode order from the one with
+    // `first_dts` up to (not including) the one with `end_dts` (or the end of the stream if it's AV_NOPTS_VALUE)
+    QString source;
+    int stream_index;
+    int64_t first_dts;
+    int64_t end_dts;
+  };
+
+  /**
+   * @brief Runs a blocking function (copying or joining parts) off the main thread
+   */
+  class WorkerThread : public QThread
+  {
+  public:
+    WorkerThread(const std::function<bool()>& func, QObject* parent);
+
+    bool result() const;
+
+  protected:
+    virtual void run() override;
+
+  private:
+    std::function<bool()> func_;
+
+    bool result_;
+  };
+
+  /**
+   * @brief Returns whether a source stream's packets can be copied into a stream encoded with `target`
+   *
+   * The codec, dimensions, pixel format and frame rate must be the same. Unless the codec is intra-only, the
+   * extradata (e.g. H.264's parameter sets) must be too, since the rendered parts around the copied ones are decoded
+   * with the same parameters. The bit rate isn't compared.
+   */
+  static bool Matches(const AVStream* source, const AVCodecParameters* target, const rational& timebase);
+
+  /**
+   * @brief Find the keyframe-aligned range of a segment that can be copied
+   *
+   * @return
+   *
+   * FALSE if nothing in it can be copied, otherwise `part` is set up to copy it.
+   */
+  bool PlanSegment(const Segment& segment, const AVCodecParameters* target, Part* part);
+
+  /**
+   * @brief Write a copied part's packets into its file (runs on a WorkerThread)
+   */
+  bool CopyPart(const Part& part);
+
+  /**
+   * @brief Returns the filename of a part of the output
+   */
+  QString PartFilename(int index) const;
+
+  /**
+   * @brief Start the current part, or join the parts once they're all done
+   *
+   * @return
+   *
+   * FALSE if it couldn't be started (see error()).
+   */
+  bool StartPart();
+
+  /**
+   * @brief Count the current part as done and start the next one
+   */
+  void NextPart();
+
+  void RunWorker(const std::function<bool()>& func);
+
+  void Finish(bool ok);
+
+  Params params_;
+
+  QList<Part> parts_;
+
+  int current_part_;
+
+  // Frames in parts that have finished
+  int64_t completed_frames_;
+
+  int64_t total_frames_;
+
+  int64_t copied_frames_;
+
+  ExportEngine engine_;
+
+  WorkerThread* worker_;
+
+  QAtomicInt running_;
+
+  QString error_;
+
+private slots:
+  void EngineProgress(qint64 completed, qint64 total);
+
+  void EngineFinished(bool ok);
+
+  void WorkerFinished();
+};
+
+#endif // SMARTRENDER_H
@@ -0,0 +1,234 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "videoconcat.h"
+
+VideoConcat::VideoConcat()
+{
+}
+
+bool VideoConcat::Concatenate(const QStringList &inputs, const QString &output)
+{
+  if (inputs.isEmpty()) {
+    error_ = tr("Nothing to concatenate");
+    return false;
+  }
+
+  // The first input describes the stream every other one must match
+  AVFormatContext* first_ctx = nullptr;
+  AVStream* first_stream = OpenInput(inputs.first(), &first_ctx);
+
+  if (first_stream == nullptr) {
+    avformat_close_input(&first_ctx);
+    return false;
+  }
+
+  QByteArray output_ba = output.toUtf8();
+
+  AVFormatContext* out_ctx = nullptr;
+
+  int error_code = avformat_alloc_output_context2(&out_ctx, nullptr, nullptr, output_ba.constData());
+
+  AVStream* out_stream = nullptr;
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create output file"), error_code);
+  } else if ((out_stream = avformat_new_stream(out_ctx, nullptr)) == nullptr) {
+    error_ = tr("Failed to create output stream");
+  } else if ((error_code = avcodec_parameters_copy(out_stream->codecpar, first_stream->codecpar)) < 0) {
+    FFmpegError(tr("Failed to copy stream parameters"), error_code);
+    out_stream = nullptr;
+  }
+
+  if (out_stream != nullptr) {
+    // Tags are specific to the input's container
+    out_stream->codecpar->codec_tag = 0;
+    out_stream->time_base = first_stream->time_base;
+  }
+
+  avformat_close_input(&first_ctx);
+
+  bool ok = (out_stream != nullptr);
+
+  bool opened = false;
+
+  if (ok && !(out_ctx->oformat->flags & AVFMT_NOFILE)) {
+    error_code = avio_open(&out_ctx->pb, output_ba.constData(), AVIO_FLAG_WRITE);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to open output file"), error_code);
+      ok = false;
+    } else {
+      opened = true;
+    }
+  }
+
+  if (ok) {
+    error_code = avformat_write_header(out_ctx, nullptr);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to write output header"), error_code);
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    int64_t offset = 0;
+
+    foreach (const QString& input, inputs) {
+      if (!CopyInput(input, out_ctx, out_stream, &offset)) {
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  if (ok) {
+    error_code = av_write_trailer(out_ctx);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to finalize output file"), error_code);
+      ok = false;
+    }
+  }
+
+  if (out_ctx != nullptr) {
+    if (opened) {
+      avio_closep(&out_ctx->pb);
+    }
+
+    avformat_free_context(out_ctx);
+  }
+
+  return ok;
+}
+
+const QString &VideoConcat::error() const
+{
+  return error_;
+}
+
+bool VideoConcat::CopyInput(const QString &filename, AVFormatContext *out_ctx, AVStream *out_stream, int64_t *offset)
+{
+  AVFormatContext* in_ctx = nullptr;
+  AVStream* in_stream = OpenInput(filename, &in_ctx);
+
+  if (in_stream == nullptr) {
+    avformat_close_input(&in_ctx);
+    return false;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+
+  bool ok = true;
+
+  // Encoders with B-frames start their dts below 0, every part starts the same way so the first dts is the part's start
+  bool have_start = false;
+  int64_t shift = 0;
+  int64_t end = *offset;
+
+  int error_code;
+
+  while ((error_code = av_read_frame(in_ctx, pkt)) >= 0) {
+    if (pkt->stream_index == in_stream->index) {
+      av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+
+      int64_t dts = (pkt->dts == AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+
+      if (!have_start && dts != AV_NOPTS_VALUE) {
+        shift = *offset - dts;
+        have_start = true;
+      }
+
+      if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts += shift;
+      }
+
+      if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts += shift;
+      }
+
+      if (dts != AV_NOPTS_VALUE) {
+        end = qMax(end, dts + shift + qMax(pkt->duration, static_cast<int64_t>(1)));
+      }
+
+      pkt->stream_index = out_stream->index;
+      pkt->pos = -1;
+
+      // av_interleaved_write_frame() takes ownership of the packet's data
+      error_code = av_interleaved_write_frame(out_ctx, pkt);
+
+      if (error_code < 0) {
+        FFmpegError(tr("Failed to write packet"), error_code);
+        ok = false;
+        break;
+      }
+    } else {
+      av_packet_unref(pkt);
+    }
+  }
+
+  if (ok && error_code != AVERROR_EOF) {
+    FFmpegError(tr("Failed to read %1").arg(filename), error_code);
+    ok = false;
+  }
+
+  av_packet_free(&pkt);
+  avformat_close_input(&in_ctx);
+
+  *offset = end;
+
+  return ok;
+}
+
+AVStream *VideoConcat::OpenInput(const QString &filename, AVFormatContext **ctx)
+{
+  int error_code = avformat_open_input(ctx, filename.toUtf8().constData(), nullptr, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open %1").arg(filename), error_code);
+    return nullptr;
+  }
+
+  error_code = avformat_find_stream_info(*ctx, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to read %1").arg(filename), error_code);
+    return nullptr;
+  }
+
+  for (unsigned int i=0;i<(*ctx)->nb_streams;i++) {
+    if ((*ctx)->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+      return (*ctx)->streams[i];
+    }
+  }
+
+  error_ = tr("%1 has no video stream").arg(filename);
+
+  return nullptr;
+}
+
+void VideoConcat::FFmpegError(const QString &prefix, int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  error_ = QStringLiteral("%1: %2").arg(prefix, err);
+}
@@ -0,0 +1,81 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIDEOCONCAT_H
+#define VIDEOCONCAT_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QCoreApplication>
+#include <QStringList>
+
+/**
+ * @brief Joins video files that were encoded separately into one file without encoding them again
+ *
+ * Meant for the parts of a render that was split into chunks (see RenderCoordinator). Every part must have been
+ * encoded with the same codec and parameters and start with a keyframe, which is the case for files written by
+ * VideoEncoder with the same settings. Packets are copied as they are, only their timestamps are moved so that each
+ * part starts where the last one ended.
+ */
+class VideoConcat
+{
+  Q_DECLARE_TR_FUNCTIONS(VideoConcat)
+public:
+  VideoConcat();
+
+  /**
+   * @brief Write `inputs` one after the other into `output`
+   *
+   * Only each file's first video stream is copied.
+   *
+   * @return
+   *
+   * FALSE on failure, see error().
+   */
+  bool Concatenate(const QStringList& inputs, const QString& output);
+
+  const QString& error() const;
+
+private:
+  /**
+   * @brief Copy every packet of an input's first video stream into the output
+   *
+   * @param offset
+   *
+   * Where this input should start in the output stream's timebase, set to where it ends.
+   */
+  bool CopyInput(const QString& filename, AVFormatContext* out_ctx, AVStream* out_stream, int64_t* offset);
+
+  /**
+   * @brief Open an input and find its first video stream
+   */
+  AVStream* OpenInput(const QString& filename, AVFormatContext** ctx);
+
+  /**
+   * @brief Sets an error message from an FFmpeg error code
+   */
+  void FFmpegError(const QString& prefix, int error_code);
+
+  QString error_;
+};
+
+#endif // VIDEOCONCAT_H
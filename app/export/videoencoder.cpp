@@ -0,0 +1,423 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "videoencoder.h"
+
+extern "C" {
+#include <libavutil/hwcontext.h>
+}
+
+VideoEncoder::VideoEncoder() :
+  fmt_ctx_(nullptr),
+  stream_(nullptr),
+  enc_ctx_(nullptr),
+  pkt_(nullptr),
+  hw_device_ctx_(nullptr),
+  hw_frames_ctx_(nullptr),
+  hw_frame_(nullptr)
+{
+}
+
+VideoEncoder::~VideoEncoder()
+{
+  Close();
+}
+
+bool VideoEncoder::Open(const QString &filename, int width, int height, const rational &timebase,
+                        const QString &codec, int64_t bit_rate, bool hardware)
+{
+  Close();
+
+  if (hardware) {
+    foreach (const QString& name, GetHardwareEncoders(filename, codec)) {
+      // Encoders without their hardware fail before the file is created, so the next one can simply be tried
+      if (OpenEncoder(filename, width, height, timebase, name, bit_rate)) {
+        return true;
+      }
+
+      Close();
+    }
+  }
+
+  return OpenEncoder(filename, width, height, timebase, codec, bit_rate);
+}
+
+QString VideoEncoder::codec_name() const
+{
+  return QString::fromUtf8(enc_ctx_->codec->name);
+}
+
+bool VideoEncoder::OpenEncoder(const QString &filename, int width, int height, const rational &timebase,
+                               const QString &codec, int64_t bit_rate)
+{
+  int error_code;
+
+  QByteArray filename_ba = filename.toUtf8();
+
+  error_code = avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, filename_ba.constData());
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create output file"), error_code);
+    return false;
+  }
+
+  const AVCodec* encoder;
+
+  if (codec.isEmpty()) {
+    encoder = avcodec_find_encoder(fmt_ctx_->oformat->video_codec);
+  } else {
+    encoder = avcodec_find_encoder_by_name(codec.toUtf8().constData());
+  }
+
+  if (encoder == nullptr || encoder->type != AVMEDIA_TYPE_VIDEO) {
+    error_ = tr("No suitable video encoder is available");
+    return false;
+  }
+
+  enc_ctx_ = avcodec_alloc_context3(encoder);
+  if (enc_ctx_ == nullptr) {
+    error_ = tr("Failed to allocate encoder context");
+    return false;
+  }
+
+  enc_ctx_->width = width;
+  enc_ctx_->height = height;
+
+#ifdef AV_CODEC_CAP_HARDWARE
+  bool hardware = (encoder->capabilities & AV_CODEC_CAP_HARDWARE);
+#else
+  bool hardware = false;
+#endif
+
+  // 4:2:0 plays back virtually everywhere, only use something else if the encoder can't do it. Hardware encoders work
+  // in NV12 natively.
+  AVPixelFormat preferred = hardware ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
+
+  enc_ctx_->pix_fmt = preferred;
+
+  if (encoder->pix_fmts != nullptr) {
+    const AVPixelFormat* supported = encoder->pix_fmts;
+
+    while (*supported != AV_PIX_FMT_NONE && *supported != preferred) {
+      supported++;
+    }
+
+    if (*supported == AV_PIX_FMT_NONE) {
+      if (hardware) {
+        // Only accepts frames in its own memory
+        if (!InitHardwareFrames(encoder, preferred)) {
+          return false;
+        }
+      } else {
+        enc_ctx_->pix_fmt = encoder->pix_fmts[0];
+      }
+    }
+  }
+
+  rational tb = timebase;
+
+  enc_ctx_->time_base = {static_cast<int>(tb.numerator()), static_cast<int>(tb.denominator())};
+  enc_ctx_->framerate = av_inv_q(enc_ctx_->time_base);
+  enc_ctx_->bit_rate = bit_rate;
+
+  if (fmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+    enc_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  enc_ctx_->thread_count = 0;
+
+  error_code = avcodec_open2(enc_ctx_, encoder, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open encoder"), error_code);
+    return false;
+  }
+
+  stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+  if (stream_ == nullptr) {
+    error_ = tr("Failed to create output stream");
+    return false;
+  }
+
+  error_code = avcodec_parameters_from_context(stream_->codecpar, enc_ctx_);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to copy encoder parameters"), error_code);
+    return false;
+  }
+
+  stream_->time_base = enc_ctx_->time_base;
+
+  if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+    error_code = avio_open(&fmt_ctx_->pb, filename_ba.constData(), AVIO_FLAG_WRITE);
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to open output file"), error_code);
+      return false;
+    }
+  }
+
+  error_code = avformat_write_header(fmt_ctx_, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to write output header"), error_code);
+    return false;
+  }
+
+  pkt_ = av_packet_alloc();
+
+  return true;
+}
+
+AVPixelFormat VideoEncoder::pix_fmt() const
+{
+  if (hw_frames_ctx_ != nullptr) {
+    return reinterpret_cast<AVHWFramesContext*>(hw_frames_ctx_->data)->sw_format;
+  }
+
+  return enc_ctx_->pix_fmt;
+}
+
+const AVCodecParameters *VideoEncoder::codecpar() const
+{
+  return stream_->codecpar;
+}
+
+bool VideoEncoder::Encode(AVFrame *frame)
+{
+  if (hw_frames_ctx_ == nullptr) {
+    return SendFrame(frame);
+  }
+
+  // Upload into a frame from the encoder's pool
+  int error_code = av_hwframe_get_buffer(hw_frames_ctx_, hw_frame_, 0);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to allocate hardware frame"), error_code);
+    return false;
+  }
+
+  error_code = av_hwframe_transfer_data(hw_frame_, frame, 0);
+
+  if (error_code >= 0) {
+    error_code = av_frame_copy_props(hw_frame_, frame);
+  }
+
+  bool ok;
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to upload frame"), error_code);
+    ok = false;
+  } else {
+    ok = SendFrame(hw_frame_);
+  }
+
+  av_frame_unref(hw_frame_);
+
+  return ok;
+}
+
+bool VideoEncoder::Finish()
+{
+  if (!SendFrame(nullptr)) {
+    return false;
+  }
+
+  int error_code = av_write_trailer(fmt_ctx_);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to finalize output file"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void VideoEncoder::Close()
+{
+  if (fmt_ctx_ != nullptr) {
+    if (fmt_ctx_->pb != nullptr && !(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&fmt_ctx_->pb);
+    }
+
+    avformat_free_context(fmt_ctx_);
+    fmt_ctx_ = nullptr;
+    stream_ = nullptr;
+  }
+
+  av_packet_free(&pkt_);
+  avcodec_free_context(&enc_ctx_);
+
+  av_frame_free(&hw_frame_);
+  av_buffer_unref(&hw_frames_ctx_);
+  av_buffer_unref(&hw_device_ctx_);
+}
+
+const QString &VideoEncoder::error() const
+{
+  return error_;
+}
+
+bool VideoEncoder::IsVideoFilename(const QString &filename)
+{
+  const AVOutputFormat* format = av_guess_format(nullptr, filename.toUtf8().constData(), nullptr);
+
+  // Image sequence muxers open each file themselves
+  return format != nullptr && format->video_codec != AV_CODEC_ID_NONE && !(format->flags & AVFMT_NOFILE);
+}
+
+QStringList VideoEncoder::GetHardwareEncoders(const QString &filename, const QString &codec)
+{
+  QStringList encoders;
+
+  AVCodecID codec_id = AV_CODEC_ID_NONE;
+
+  if (codec.isEmpty()) {
+    const AVOutputFormat* format = av_guess_format(nullptr, filename.toUtf8().constData(), nullptr);
+
+    if (format != nullptr) {
+      codec_id = format->video_codec;
+    }
+  } else {
+    const AVCodec* encoder = avcodec_find_encoder_by_name(codec.toUtf8().constData());
+
+    if (encoder != nullptr) {
+      codec_id = encoder->id;
+    }
+  }
+
+  if (codec_id == AV_CODEC_ID_NONE) {
+    return encoders;
+  }
+
+  // APIs to try in order of preference for this platform
+  QStringList apis;
+
+#if defined(Q_OS_WIN)
+  apis = QStringList({"nvenc", "qsv", "amf"});
+#elif defined(Q_OS_MAC)
+  apis = QStringList({"videotoolbox"});
+#elif defined(Q_OS_LINUX)
+  apis = QStringList({"nvenc", "vaapi", "qsv"});
+#endif
+
+  // FFmpeg names hardware encoders after the format and the API (e.g. "hevc_nvenc")
+  QString format_name = QString::fromUtf8(avcodec_get_name(codec_id));
+
+  foreach (const QString& api, apis) {
+    QString name = QStringLiteral("%1_%2").arg(format_name, api);
+
+    if (avcodec_find_encoder_by_name(name.toUtf8().constData()) != nullptr) {
+      encoders.append(name);
+    }
+  }
+
+  return encoders;
+}
+
+bool VideoEncoder::InitHardwareFrames(const AVCodec *encoder, AVPixelFormat sw_format)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 0, 0)
+  const AVCodecHWConfig* config;
+
+  for (int i=0;(config = avcodec_get_hw_config(encoder, i)) != nullptr;i++) {
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX) && config->pix_fmt != AV_PIX_FMT_NONE) {
+      break;
+    }
+  }
+
+  if (config == nullptr) {
+    error_ = tr("%1 doesn't accept frames from system memory").arg(encoder->name);
+    return false;
+  }
+
+  // Fails if there's no driver for it on this system
+  int error_code = av_hwdevice_ctx_create(&hw_device_ctx_, config->device_type, nullptr, nullptr, 0);
+  if (error_code < 0) {
+    hw_device_ctx_ = nullptr;
+    FFmpegError(tr("Failed to open hardware encoding device"), error_code);
+    return false;
+  }
+
+  hw_frames_ctx_ = av_hwframe_ctx_alloc(hw_device_ctx_);
+  if (hw_frames_ctx_ == nullptr) {
+    error_ = tr("Failed to allocate hardware frames");
+    return false;
+  }
+
+  AVHWFramesContext* frames = reinterpret_cast<AVHWFramesContext*>(hw_frames_ctx_->data);
+  frames->format = config->pix_fmt;
+  frames->sw_format = sw_format;
+  frames->width = enc_ctx_->width;
+  frames->height = enc_ctx_->height;
+
+  // Some APIs can't grow their pool, leave room for the encoder's reference and lookahead frames
+  frames->initial_pool_size = 20;
+
+  error_code = av_hwframe_ctx_init(hw_frames_ctx_);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to initialize hardware frames"), error_code);
+    return false;
+  }
+
+  enc_ctx_->pix_fmt = config->pix_fmt;
+  enc_ctx_->hw_frames_ctx = av_buffer_ref(hw_frames_ctx_);
+
+  hw_frame_ = av_frame_alloc();
+
+  return true;
+#else
+  Q_UNUSED(sw_format)
+
+  error_ = tr("%1 doesn't accept frames from system memory").arg(encoder->name);
+  return false;
+#endif
+}
+
+bool VideoEncoder::SendFrame(AVFrame *frame)
+{
+  int error_code = avcodec_send_frame(enc_ctx_, frame);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to encode frame"), error_code);
+    return false;
+  }
+
+  while ((error_code = avcodec_receive_packet(enc_ctx_, pkt_)) >= 0) {
+    av_packet_rescale_ts(pkt_, enc_ctx_->time_base, stream_->time_base);
+    pkt_->stream_index = stream_->index;
+
+    // av_interleaved_write_frame() takes ownership of the packet's data
+    error_code = av_interleaved_write_frame(fmt_ctx_, pkt_);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to write packet"), error_code);
+      return false;
+    }
+  }
+
+  if (error_code != AVERROR(EAGAIN) && error_code != AVERROR_EOF) {
+    FFmpegError(tr("Failed to encode frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void VideoEncoder::FFmpegError(const QString &prefix, int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  error_ = QStringLiteral("%1: %2").arg(prefix, err);
+}
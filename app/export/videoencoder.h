@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIDEOENCODER_H
+#define VIDEOENCODER_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <QCoreApplication>
+#include <QString>
+#include <QStringList>
+
+#include "common/rational.h"
+
+/**
+ * @brief Encodes frames to a video file with FFmpeg
+ *
+ * The container is chosen from the filename's extension and, unless a codec is given, so is the codec. Frames are
+ * sent in presentation order in pix_fmt() with Encode(), then Finish() flushes the encoder and finalizes the file.
+ * Not thread-safe, a VideoEncoder should be used from one thread at a time.
+ *
+ * Hardware encoders (NVENC, VAAPI, QSV, VideoToolbox, AMF) are fed NV12. Those that only accept frames in their own
+ * memory (e.g. VAAPI) get a device and frame pool of their own, and frames are uploaded to it in Encode().
+ */
+class VideoEncoder
+{
+  Q_DECLARE_TR_FUNCTIONS(VideoEncoder)
+public:
+  VideoEncoder();
+
+  ~VideoEncoder();
+
+  VideoEncoder(const VideoEncoder& other) = delete;
+  VideoEncoder(VideoEncoder&& other) = delete;
+  VideoEncoder& operator=(const VideoEncoder& other) = delete;
+  VideoEncoder& operator=(VideoEncoder&& other) = delete;
+
+  /**
+   * @brief Create the file and open the encoder
+   *
+   * @param codec
+   *
+   * FFmpeg encoder name (e.g. "libx264"), or empty for the container's default video codec.
+   *
+   * @param bit_rate
+   *
+   * Bits per second, or 0 for the encoder's default.
+   *
+   * @param hardware
+   *
+   * Try the hardware encoders for the same format first (see GetHardwareEncoders()) and only use `codec` if none of
+   * them can be opened on this system.
+   *
+   * @return
+   *
+   * FALSE on failure, see error().
+   */
+  bool Open(const QString& filename, int width, int height, const rational& timebase, const QString& codec = QString(),
+            int64_t bit_rate = 0, bool hardware = false);
+
+  /**
+   * @brief Name of the encoder that was opened (only valid once opened)
+   */
+  QString codec_name() const;
+
+  /**
+   * @brief Pixel format frames must be sent to Encode() in (only valid once opened)
+   */
+  AVPixelFormat pix_fmt() const;
+
+  /**
+   * @brief Parameters of the stream being written (only valid once opened)
+   *
+   * Includes the encoder's extradata, so they can be compared with other streams to see whether their packets could
+   * be mixed with this encoder's (see SmartRender).
+   */
+  const AVCodecParameters* codecpar() const;
+
+  /**
+   * @brief Encode a frame and write any packets the encoder outputs
+   *
+   * The frame's pts must be in the timebase passed to Open(). The encoder takes its own reference to the frame's
+   * data, so the frame can be freed afterwards.
+   *
+   * @return
+   *
+   * FALSE on failure, see error().
+   */
+  bool Encode(AVFrame* frame);
+
+  /**
+   * @brief Flush the encoder and finalize the file
+   */
+  bool Finish();
+
+  /**
+   * @brief Free every FFmpeg context (called automatically on destruction)
+   */
+  void Close();
+
+  const QString& error() const;
+
+  /**
+   * @brief Returns TRUE if FFmpeg would write a filename as a video file rather than as images
+   */
+  static bool IsVideoFilename(const QString& filename);
+
+  /**
+   * @brief Returns the hardware encoders FFmpeg was built with for the format `codec` (or the container's default
+   * codec) encodes to, in order of preference for this platform
+   *
+   * Being listed doesn't mean the hardware is there, Open() tries each until one opens.
+   */
+  static QStringList GetHardwareEncoders(const QString& filename, const QString& codec = QString());
+
+private:
+  /**
+   * @brief Create the file and open one encoder (see Open())
+   */
+  bool OpenEncoder(const QString& filename, int width, int height, const rational& timebase, const QString& codec,
+                   int64_t bit_rate);
+
+  /**
+   * @brief Give a hardware encoder a device and pool of frames to upload into, for encoders that only accept those
+   *
+   * Sets the encoder's pixel format to the pool's, pix_fmt() is then the format frames are uploaded from.
+   */
+  bool InitHardwareFrames(const AVCodec* encoder, AVPixelFormat sw_format);
+
+  /**
+   * @brief Send a frame (or nullptr to flush) and write every packet the encoder outputs
+   */
+  bool SendFrame(AVFrame* frame);
+
+  /**
+   * @brief Sets an error message from an FFmpeg error code
+   */
+  void FFmpegError(const QString& prefix, int error_code);
+
+  AVFormatContext* fmt_ctx_;
+
+  AVStream* stream_;
+
+  AVCodecContext* enc_ctx_;
+
+  AVPacket* pkt_;
+
+  // Set if frames are uploaded to the encoder's device (see InitHardwareFrames())
+  AVBufferRef* hw_device_ctx_;
+  AVBufferRef* hw_frames_ctx_;
+
+  // Frame that uploads are made into
+  AVFrame* hw_frame_;
+
+  QString error_;
+};
+
+#endif // VIDEOENCODER_H
@@ -26,19 +26,67 @@
  * Use the navigation above to find documentation on classes or source files.
  */
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavfilter/avfilter.h>
-}
-
 #include <QApplication>
+#include <QScopedPointer>
 #include <QSurfaceFormat>
 
 #include "core.h"
+#include "render/gl/shadercache.h"
+
+/**
+ * @brief Returns TRUE if an option (e.g. "--render", see Core::Start()) is on the command line
+ *
+ * Some options have to be known before the application instance is created, so they're checked before
+ * QCommandLineParser can.
+ */
+bool HasOption(int argc, char *argv[], const char* option) {
+  uint length = qstrlen(option);
+
+  for (int i=1;i<argc;i++) {
+    if (qstrncmp(argv[i], option, length) == 0 && (argv[i][length] == '\0' || argv[i][length] == '=')) {
+      return true;
+    }
+  }
+
+  return false;
+}
 
 int main(int argc, char *argv[]) {
-  // Create application instance
-  QApplication a(argc, argv);
+  // Decode workers (see DecodeWorker) don't show or render anything at all
+  bool decode_worker = HasOption(argc, argv, "--decode-worker");
+  bool headless = decode_worker || HasOption(argc, argv, "--render");
+
+  // Set OpenGL display profile (3.2 Core)
+  QSurfaceFormat format;
+  format.setVersion(3, 2);
+  format.setDepthBufferSize(24);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+
+  // Ask for 10 bits per channel so viewers can show HDR and wide gamut material without banding (see ViewerGLWidget).
+  // Windows get the deepest format the platform has that's no deeper than this, usually 8 bits.
+  if (!headless) {
+    format.setRedBufferSize(10);
+    format.setGreenBufferSize(10);
+    format.setBlueBufferSize(10);
+  }
+
+  QSurfaceFormat::setDefaultFormat(format);
+
+  // Put every context in one share group so textures rendered on RendererThreads can be shown by viewers directly
+  // (these must both be set before the application instance is created)
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+  // Create application instance, headless renders don't create any widgets so they don't need QApplication, and decode
+  // workers don't need a GUI at all
+  QScopedPointer<QCoreApplication> a;
+
+  if (decode_worker) {
+    a.reset(new QCoreApplication(argc, argv));
+  } else if (headless) {
+    a.reset(new QGuiApplication(argc, argv));
+  } else {
+    a.reset(new QApplication(argc, argv));
+  }
 
   // Set application metadata
   QCoreApplication::setOrganizationName("olivevideoeditor.org");
@@ -54,32 +102,28 @@ int main(int argc, char *argv[]) {
   QCoreApplication::setApplicationVersion(app_version);
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 7, 0))
-  QGuiApplication::setDesktopFileName("org.olivevideoeditor.Olive");
+  if (!decode_worker) {
+    QGuiApplication::setDesktopFileName("org.olivevideoeditor.Olive");
+  }
 #endif
 
-  // Set OpenGL display profile (3.2 Core)
-  QSurfaceFormat format;
-  format.setVersion(3, 2);
-  format.setDepthBufferSize(24);
-  format.setProfile(QSurfaceFormat::CoreProfile);
-  QSurfaceFormat::setDefaultFormat(format);
-
-  // Register FFmpeg codecs and filters (deprecated in 4.0+)
-#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
-  av_register_all();
-#endif
-#if LIBAVFILTER_VERSION_INT < AV_VERSION_INT(7, 14, 100)
-  avfilter_register_all();
-#endif
+  // Compile new shaders in the background so render threads don't wait for them
+  if (!decode_worker) {
+    olive::gl::shader_cache.StartCompiler();
+  }
 
   // Start core
   olive::core.Start();
 
   // Run application loop and receive exit code
-  int exit_code = a.exec();
+  int exit_code = a->exec();
 
   // Clear core memory
   olive::core.Stop();
 
+  if (!decode_worker) {
+    olive::gl::shader_cache.StopCompiler();
+  }
+
   return exit_code;
 }
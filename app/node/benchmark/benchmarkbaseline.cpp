@@ -0,0 +1,169 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "benchmarkbaseline.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+const double BenchmarkBaseline::kDefaultTolerance = 0.25;
+
+const double BenchmarkBaseline::kNoiseFloorMs = 0.01;
+
+bool BenchmarkBaseline::Check(const QJsonObject &results, const QString &filename, double tolerance)
+{
+  QMap<QString, double> current;
+  Flatten(results, QString(), &current);
+
+  QFile file(filename);
+
+  if (!file.exists()) {
+    // Nothing to compare against yet, this run becomes the baseline
+    QJsonObject metrics;
+
+    for (auto it=current.constBegin();it!=current.constEnd();it++) {
+      metrics.insert(it.key(), it.value());
+    }
+
+    QJsonObject baseline;
+    baseline.insert("metrics", metrics);
+
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+
+    QSaveFile save(filename);
+
+    if (!save.open(QIODevice::WriteOnly)
+        || save.write(QJsonDocument(baseline).toJson()) < 0
+        || !save.commit()) {
+      qWarning() << "Failed to record benchmark baseline" << filename;
+      return false;
+    }
+
+    qWarning() << "No benchmark baseline found, recorded" << current.size() << "metrics to" << filename;
+    return true;
+  }
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "Failed to open benchmark baseline" << filename;
+    return false;
+  }
+
+  QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object().value("metrics").toObject();
+
+  if (baseline.isEmpty()) {
+    qWarning() << "Benchmark baseline" << filename << "has no metrics";
+    return false;
+  }
+
+  int regressions = 0;
+
+  for (auto it=baseline.constBegin();it!=baseline.constEnd();it++) {
+    const QString& path = it.key();
+    double expected = it.value().toDouble();
+
+    if (!current.contains(path)) {
+      // Usually a scenario that couldn't run on this machine, which is reported by the benchmark itself
+      qWarning() << "Benchmark metric" << path << "is missing from the results";
+      continue;
+    }
+
+    double actual = current.value(path);
+
+    bool regressed;
+
+    if (GetDirection(path.section('/', -1)) == kLowerIsBetter) {
+      regressed = (actual > expected * (1.0 + tolerance)
+                   && ToMilliseconds(path, actual - expected) > kNoiseFloorMs);
+    } else {
+      regressed = (actual < expected * (1.0 - tolerance));
+    }
+
+    if (regressed) {
+      double change = (expected != 0.0) ? (actual - expected) / expected * 100.0 : 0.0;
+
+      qWarning().nospace() << "Performance regression in " << qPrintable(path) << ": " << actual
+                           << " (baseline " << expected << ", " << (change > 0 ? "+" : "") << change << "%)";
+
+      regressions++;
+    }
+  }
+
+  if (regressions > 0) {
+    qWarning() << regressions << "of" << baseline.size() << "benchmark metrics regressed by more than"
+               << tolerance * 100.0 << "% compared to" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+BenchmarkBaseline::Direction BenchmarkBaseline::GetDirection(const QString &key)
+{
+  if (key == "fps" || key.endsWith("_per_second")) {
+    return kHigherIsBetter;
+  }
+
+  if ((key.endsWith("_ms") || key.endsWith("_ns")) && !key.startsWith("min_") && !key.startsWith("max_")) {
+    return kLowerIsBetter;
+  }
+
+  return kUntracked;
+}
+
+void BenchmarkBaseline::Flatten(const QJsonValue &value, const QString &path, QMap<QString, double> *metrics)
+{
+  QString prefix = path.isEmpty() ? QString() : path + '/';
+
+  if (value.isObject()) {
+    QJsonObject object = value.toObject();
+
+    for (auto it=object.constBegin();it!=object.constEnd();it++) {
+      if (it.value().isDouble()) {
+        if (GetDirection(it.key()) != kUntracked) {
+          metrics->insert(prefix + it.key(), it.value().toDouble());
+        }
+      } else {
+        Flatten(it.value(), prefix + it.key(), metrics);
+      }
+    }
+  } else if (value.isArray()) {
+    QJsonArray array = value.toArray();
+
+    for (int i=0;i<array.size();i++) {
+      QString name = array.at(i).toObject().value("name").toString();
+
+      Flatten(array.at(i), prefix + (name.isEmpty() ? QString::number(i) : name), metrics);
+    }
+  }
+}
+
+double BenchmarkBaseline::ToMilliseconds(const QString &path, double value)
+{
+  if (path.endsWith("_ns")) {
+    return value / 1000000.0;
+  }
+
+  return value;
+}
@@ -0,0 +1,87 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BENCHMARKBASELINE_H
+#define BENCHMARKBASELINE_H
+
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+
+/**
+ * @brief Compares benchmark results with a baseline recorded on the same machine to catch performance regressions
+ *
+ * Only timings are compared: keys ending in "_ms" or "_ns" (lower is better, except the noisy "min_" and "max_"
+ * ones) and "fps" or keys ending in "_per_second" (higher is better). A metric regresses when it's worse than the
+ * baseline by more than the tolerance, a fraction of the baseline value. Differences of less than kNoiseFloorMs are
+ * ignored so that sub-microsecond timings don't fail on jitter.
+ *
+ * Metrics are identified by their path in the results, with the "name" of array entries standing in for their index
+ * (e.g. "scenarios/png_1080p/first_frame_ms"), so adding or reordering scenarios doesn't invalidate a baseline.
+ *
+ * Baselines are machine specific, so there's no point shipping them. If the baseline file doesn't exist yet, the
+ * results are recorded as the baseline instead and the check passes.
+ */
+class BenchmarkBaseline
+{
+public:
+  /**
+   * @brief Default tolerance for Check()
+   */
+  static const double kDefaultTolerance;
+
+  /**
+   * @brief Compare results with the baseline in a file, printing any regressions
+   *
+   * @return
+   *
+   * FALSE if any metric regressed or the baseline couldn't be read or recorded.
+   */
+  static bool Check(const QJsonObject& results, const QString& filename, double tolerance = kDefaultTolerance);
+
+private:
+  /**
+   * @brief Smallest difference in milliseconds counted as a regression
+   */
+  static const double kNoiseFloorMs;
+
+  enum Direction {
+    kUntracked,
+    kLowerIsBetter,
+    kHigherIsBetter
+  };
+
+  /**
+   * @brief Whether a key is compared and which way is better
+   */
+  static Direction GetDirection(const QString& key);
+
+  /**
+   * @brief Collect every compared metric in a JSON value into `metrics`, keyed by path
+   */
+  static void Flatten(const QJsonValue& value, const QString& path, QMap<QString, double>* metrics);
+
+  /**
+   * @brief Convert a metric's value to milliseconds for comparing with kNoiseFloorMs
+   */
+  static double ToMilliseconds(const QString& path, double value);
+};
+
+#endif // BENCHMARKBASELINE_H
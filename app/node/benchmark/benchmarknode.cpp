@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "benchmarknode.h"
+
+#include "node/input.h"
+#include "node/output.h"
+
+QAtomicInt BenchmarkNode::process_count_;
+
+BenchmarkNode::BenchmarkNode()
+{
+  values_input_ = new NodeInput();
+  values_input_->add_data_input(NodeParam::kFloat);
+  values_input_->set_can_accept_multiple_inputs(true);
+  AddParameter(values_input_);
+
+  value_output_ = new NodeOutput();
+  value_output_->set_data_type(NodeParam::kFloat);
+  AddParameter(value_output_);
+}
+
+QString BenchmarkNode::Name()
+{
+  return tr("Benchmark");
+}
+
+QString BenchmarkNode::id()
+{
+  return "org.olivevideoeditor.Olive.benchmark";
+}
+
+QString BenchmarkNode::Category()
+{
+  return tr("Debug");
+}
+
+QString BenchmarkNode::Description()
+{
+  return tr("Add one to the sum of its inputs. Used to benchmark node graph evaluation.");
+}
+
+bool BenchmarkNode::RunsOnCPU()
+{
+  return true;
+}
+
+NodeInput *BenchmarkNode::values_input()
+{
+  return values_input_;
+}
+
+NodeOutput *BenchmarkNode::value_output()
+{
+  return value_output_;
+}
+
+int BenchmarkNode::ProcessCount()
+{
+  return process_count_.load();
+}
+
+void BenchmarkNode::ResetProcessCount()
+{
+  process_count_.store(0);
+}
+
+void BenchmarkNode::Process(const rational &time)
+{
+  process_count_.ref();
+
+  NodeValueList values = values_input_->get_values(time);
+
+  double sum = 1.0;
+
+  for (int i=0;i<values.size();i++) {
+    sum += values.at(i).toDouble();
+  }
+
+  value_output_->set_value(NodeValue(sum));
+}
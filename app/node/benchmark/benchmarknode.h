@@ -0,0 +1,69 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BENCHMARKNODE_H
+#define BENCHMARKNODE_H
+
+#include <QAtomicInt>
+
+#include "node/node.h"
+
+/**
+ * @brief A trivial CPU node used by NodeGraphBenchmark to measure the cost of evaluating a graph itself
+ *
+ * Outputs the sum of every value connected to its input plus one. With nothing connected, the input's own
+ * (optionally keyframed) value is used instead, so keyframing a source node makes the whole graph time dependent.
+ */
+class BenchmarkNode : public Node
+{
+  Q_OBJECT
+public:
+  BenchmarkNode();
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  virtual bool RunsOnCPU() override;
+
+  NodeInput* values_input();
+
+  NodeOutput* value_output();
+
+  /**
+   * @brief Number of times Process() has been called on any BenchmarkNode since the last ResetProcessCount()
+   */
+  static int ProcessCount();
+
+  static void ResetProcessCount();
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  NodeInput* values_input_;
+
+  NodeOutput* value_output_;
+
+  static QAtomicInt process_count_;
+};
+
+#endif // BENCHMARKNODE_H
@@ -0,0 +1,338 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "graphbenchmark.h"
+
+#include <algorithm>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QThreadPool>
+
+#include "node/input.h"
+#include "node/keyframe.h"
+#include "node/output.h"
+
+namespace {
+
+// Frames are evaluated at this rate, starting at 0
+const int kFrameRate = 30;
+
+}
+
+bool NodeGraphBenchmark::Run(int frames, QJsonObject *results)
+{
+  bool ok = true;
+
+  QJsonArray scenarios;
+
+  {
+    NodeGraph graph;
+    QJsonObject scenario = RunScenario("chain", &graph, BuildChain(&graph, 256), frames);
+    ok = ok && !scenario.isEmpty();
+    scenarios.append(scenario);
+  }
+
+  {
+    NodeGraph graph;
+    QJsonObject scenario = RunScenario("diamonds", &graph, BuildDiamonds(&graph, 64), frames);
+    ok = ok && !scenario.isEmpty();
+    scenarios.append(scenario);
+  }
+
+  {
+    NodeGraph graph;
+    QJsonObject scenario = RunScenario("wide_merge", &graph, BuildWideMerge(&graph, 256), frames);
+    ok = ok && !scenario.isEmpty();
+    scenarios.append(scenario);
+  }
+
+  {
+    NodeGraph graph;
+    QJsonObject scenario = RunScenario("keyframes", &graph, BuildKeyframed(&graph, 4096), frames);
+    ok = ok && !scenario.isEmpty();
+    scenarios.append(scenario);
+  }
+
+  results->insert("frames", frames);
+  results->insert("frame_rate", kFrameRate);
+  results->insert("threads", QThreadPool::globalInstance()->maxThreadCount());
+  results->insert("scenarios", scenarios);
+
+  return ok;
+}
+
+bool NodeGraphBenchmark::RunToFile(const QString &filename,
+                                   int frames,
+                                   const QString &baseline,
+                                   double tolerance)
+{
+  QJsonObject results;
+
+  bool ok = Run(frames, &results);
+
+  QFile file;
+
+  if (filename == "-") {
+    file.open(stdout, QIODevice::WriteOnly);
+  } else {
+    file.setFileName(filename);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  }
+
+  if (!file.isOpen()) {
+    qWarning() << "Failed to open" << filename << "for writing benchmark results";
+    return false;
+  }
+
+  file.write(QJsonDocument(results).toJson());
+
+  if (!baseline.isEmpty() && !BenchmarkBaseline::Check(results, baseline, tolerance)) {
+    return false;
+  }
+
+  return ok;
+}
+
+BenchmarkNode *NodeGraphBenchmark::BuildChain(NodeGraph *graph, int length)
+{
+  BenchmarkNode* last = AddNode(graph, true);
+
+  for (int i=1;i<length;i++) {
+    BenchmarkNode* next = AddNode(graph, false);
+
+    NodeParam::ConnectEdge(last->value_output(), next->values_input());
+
+    last = next;
+  }
+
+  return last;
+}
+
+BenchmarkNode *NodeGraphBenchmark::BuildDiamonds(NodeGraph *graph, int count)
+{
+  BenchmarkNode* last = AddNode(graph, true);
+
+  for (int i=0;i<count;i++) {
+    BenchmarkNode* left = AddNode(graph, false);
+    BenchmarkNode* right = AddNode(graph, false);
+    BenchmarkNode* merge = AddNode(graph, false);
+
+    NodeParam::ConnectEdge(last->value_output(), left->values_input());
+    NodeParam::ConnectEdge(last->value_output(), right->values_input());
+    NodeParam::ConnectEdge(left->value_output(), merge->values_input());
+    NodeParam::ConnectEdge(right->value_output(), merge->values_input());
+
+    last = merge;
+  }
+
+  return last;
+}
+
+BenchmarkNode *NodeGraphBenchmark::BuildWideMerge(NodeGraph *graph, int width)
+{
+  BenchmarkNode* merge = AddNode(graph, false);
+
+  for (int i=0;i<width;i++) {
+    BenchmarkNode* source = AddNode(graph, true);
+
+    NodeParam::ConnectEdge(source->value_output(), merge->values_input());
+  }
+
+  return merge;
+}
+
+BenchmarkNode *NodeGraphBenchmark::BuildKeyframed(NodeGraph *graph, int keyframes)
+{
+  BenchmarkNode* source = AddNode(graph, false);
+
+  source->values_input()->set_keyframing(true);
+
+  // One keyframe per frame, cycling through every interpolation method
+  for (int i=0;i<keyframes;i++) {
+    NodeKeyframe key;
+
+    key.set_time(rational(i, kFrameRate));
+    key.set_value(NodeValue(static_cast<double>(i % 100)));
+
+    switch (i % 3) {
+    case 0:
+      key.set_type(NodeKeyframe::kLinear);
+      break;
+    case 1:
+      key.set_type(NodeKeyframe::kBezier);
+      key.set_bezier_control_in(QPointF(-0.5, 0.0));
+      key.set_bezier_control_out(QPointF(0.5, 0.0));
+      break;
+    default:
+      key.set_type(NodeKeyframe::kHold);
+    }
+
+    source->values_input()->insert_keyframe(key);
+  }
+
+  BenchmarkNode* last = source;
+
+  for (int i=0;i<4;i++) {
+    BenchmarkNode* next = AddNode(graph, false);
+
+    NodeParam::ConnectEdge(last->value_output(), next->values_input());
+
+    last = next;
+  }
+
+  return last;
+}
+
+BenchmarkNode *NodeGraphBenchmark::AddNode(NodeGraph *graph, bool animated)
+{
+  BenchmarkNode* node = new BenchmarkNode();
+
+  graph->AddNode(node);
+
+  if (animated) {
+    NodeKeyframe start;
+    start.set_time(0);
+    start.set_value(NodeValue(0.0));
+    start.set_type(NodeKeyframe::kLinear);
+
+    NodeKeyframe end;
+    end.set_time(3600);
+    end.set_value(NodeValue(3600.0));
+    end.set_type(NodeKeyframe::kLinear);
+
+    node->values_input()->set_keyframing(true);
+    node->values_input()->insert_keyframe(start);
+    node->values_input()->insert_keyframe(end);
+  }
+
+  return node;
+}
+
+QJsonObject NodeGraphBenchmark::RunScenario(const QString &name, NodeGraph *graph, BenchmarkNode *target, int frames)
+{
+  QElapsedTimer timer;
+
+  // The first request compiles the plan
+  timer.start();
+  NodeGraphPlanPtr plan = graph->GetPlan(target->value_output());
+  qint64 compile_nsecs = timer.nsecsElapsed();
+
+  if (plan == nullptr) {
+    qWarning() << "Failed to compile a plan for benchmark scenario" << name;
+    return QJsonObject();
+  }
+
+  QVector<qint64> frame_nsecs(frames);
+  double checksum;
+
+  // Evaluate with the plan
+  ClearGraphCache(graph);
+  BenchmarkNode::ResetProcessCount();
+  checksum = 0;
+
+  for (int i=0;i<frames;i++) {
+    rational time(i, kFrameRate);
+
+    timer.restart();
+    NodeValue value = plan->Run(time);
+    frame_nsecs[i] = timer.nsecsElapsed();
+
+    checksum += value.toDouble();
+  }
+
+  QJsonObject plan_results = Summarize(frame_nsecs, BenchmarkNode::ProcessCount(), checksum);
+
+  // Evaluate by pulling from the target, the way nodes request their inputs
+  ClearGraphCache(graph);
+  BenchmarkNode::ResetProcessCount();
+  checksum = 0;
+
+  for (int i=0;i<frames;i++) {
+    rational time(i, kFrameRate);
+
+    timer.restart();
+    NodeValue value = target->value_output()->get_value(time);
+    frame_nsecs[i] = timer.nsecsElapsed();
+
+    checksum += value.toDouble();
+  }
+
+  QJsonObject pull_results = Summarize(frame_nsecs, BenchmarkNode::ProcessCount(), checksum);
+
+  ClearGraphCache(graph);
+
+  QJsonObject scenario;
+  scenario.insert("name", name);
+  scenario.insert("nodes", graph->nodes().size());
+  scenario.insert("steps", plan->StepCount());
+  scenario.insert("compile_ms", static_cast<double>(compile_nsecs) / 1000000.0);
+  scenario.insert("plan", plan_results);
+  scenario.insert("pull", pull_results);
+  return scenario;
+}
+
+QJsonObject NodeGraphBenchmark::Summarize(QVector<qint64> frame_nsecs, int process_calls, double checksum)
+{
+  QJsonObject summary;
+
+  if (frame_nsecs.isEmpty()) {
+    return summary;
+  }
+
+  qint64 total = 0;
+
+  for (int i=0;i<frame_nsecs.size();i++) {
+    total += frame_nsecs.at(i);
+  }
+
+  std::sort(frame_nsecs.begin(), frame_nsecs.end());
+
+  double frames = static_cast<double>(frame_nsecs.size());
+
+  summary.insert("total_ms", static_cast<double>(total) / 1000000.0);
+  summary.insert("mean_ms", static_cast<double>(total) / frames / 1000000.0);
+  summary.insert("median_ms", static_cast<double>(frame_nsecs.at(frame_nsecs.size() / 2)) / 1000000.0);
+  summary.insert("max_ms", static_cast<double>(frame_nsecs.last()) / 1000000.0);
+  summary.insert("process_calls", process_calls);
+  summary.insert("process_calls_per_frame", static_cast<double>(process_calls) / frames);
+
+  // Both modes should agree, a mismatch means one of them evaluated something wrong
+  summary.insert("checksum", checksum);
+
+  return summary;
+}
+
+void NodeGraphBenchmark::ClearGraphCache(NodeGraph *graph)
+{
+  QList<Node*> nodes = graph->nodes();
+
+  foreach (Node* node, nodes) {
+    QList<NodeParam*> params = node->parameters();
+
+    foreach (NodeParam* param, params) {
+      if (param->type() == NodeParam::kOutput) {
+        static_cast<NodeOutput*>(param)->ClearCachedValues();
+      }
+    }
+  }
+}
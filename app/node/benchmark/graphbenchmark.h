@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef GRAPHBENCHMARK_H
+#define GRAPHBENCHMARK_H
+
+#include <QJsonObject>
+#include <QString>
+
+#include "node/benchmark/benchmarkbaseline.h"
+#include "node/benchmark/benchmarknode.h"
+#include "node/graph.h"
+
+/**
+ * @brief Measures node graph evaluation on synthetic graphs
+ *
+ * Builds graphs of BenchmarkNodes with shapes that stress different parts of the evaluator (long chains, fan-out
+ * diamonds, wide merges and heavily keyframed inputs) and evaluates each of them over a range of frames, both through
+ * its compiled NodeGraphPlan and by pulling values from the target output. Results are reported as JSON so runs can
+ * be compared. Started from the command line with --benchmark-graph.
+ */
+class NodeGraphBenchmark
+{
+public:
+  /**
+   * @brief Run every scenario
+   *
+   * @param frames
+   *
+   * Number of consecutive frames each scenario is evaluated at.
+   *
+   * @return
+   *
+   * FALSE if a scenario couldn't be run, in which case results only contain the scenarios that could.
+   */
+  static bool Run(int frames, QJsonObject* results);
+
+  /**
+   * @brief Run every scenario and write the results to a file ("-" for standard output)
+   *
+   * If a baseline filename is given, the results are also compared with it (see BenchmarkBaseline).
+   *
+   * @return
+   *
+   * FALSE if a scenario couldn't be run, the results couldn't be written or they regressed from the baseline.
+   */
+  static bool RunToFile(const QString& filename,
+                        int frames,
+                        const QString& baseline = QString(),
+                        double tolerance = BenchmarkBaseline::kDefaultTolerance);
+
+private:
+  /**
+   * @brief A single node whose output is connected to the next one's input
+   *
+   * @return
+   *
+   * The last node of the chain.
+   */
+  static BenchmarkNode* BuildChain(NodeGraph* graph, int length);
+
+  /**
+   * @brief A source followed by diamonds, each splitting into two nodes that are merged again
+   */
+  static BenchmarkNode* BuildDiamonds(NodeGraph* graph, int count);
+
+  /**
+   * @brief Many sources connected to the input of a single node
+   */
+  static BenchmarkNode* BuildWideMerge(NodeGraph* graph, int width);
+
+  /**
+   * @brief A short chain from a source with a large number of keyframes
+   */
+  static BenchmarkNode* BuildKeyframed(NodeGraph* graph, int keyframes);
+
+  /**
+   * @brief Create a node and add it to a graph
+   *
+   * @param animated
+   *
+   * Keyframe the node's input so it (and everything downstream) changes every frame.
+   */
+  static BenchmarkNode* AddNode(NodeGraph* graph, bool animated);
+
+  /**
+   * @brief Evaluate a graph over the frames with both its plan and by pulling and report the timings
+   */
+  static QJsonObject RunScenario(const QString& name, NodeGraph* graph, BenchmarkNode* target, int frames);
+
+  /**
+   * @brief Summarize per-frame timings
+   */
+  static QJsonObject Summarize(QVector<qint64> frame_nsecs, int process_calls, double checksum);
+
+  /**
+   * @brief Drop every value cached by the graph's outputs so each mode starts cold
+   */
+  static void ClearGraphCache(NodeGraph* graph);
+};
+
+#endif // GRAPHBENCHMARK_H
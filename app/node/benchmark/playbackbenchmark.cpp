@@ -0,0 +1,653 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "playbackbenchmark.h"
+
+#include <algorithm>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "export/exportengine.h"
+#include "node/generator/solid/solid.h"
+#include "node/input/image/image.h"
+#include "node/keyframe.h"
+#include "node/processor/composite/composite.h"
+#include "node/processor/renderer/renderer.h"
+#include "node/processor/transform/transform.h"
+#include "project/item/footage/footage.h"
+#include "project/project.h"
+#include "project/projectviewmodel.h"
+#include "render/diskframecache.h"
+#include "render/playbackengine.h"
+#include "task/import/import.h"
+#include "undo/undostack.h"
+
+namespace {
+
+// Sequences play at this rate
+const int kFrameRate = 30;
+
+// Number of distinct frames generated per scenario, played in a loop
+const int kMediaFrames = 8;
+
+// Number of frames the playhead is scrubbed to
+const int kScrubPositions = 30;
+
+// Number of frames exported
+const int kExportFrames = 2 * kFrameRate;
+
+// Longest a single frame is waited for before the scrub measurement gives up
+const int kScrubTimeout = 10000;
+
+// Sample rate and length (in seconds) of the audio the decoder's audio cache is checked with
+const int kAudioSampleRate = 48000;
+const int kAudioSeconds = 12;
+
+// Value of sample i of that audio, a sawtooth so that samples from the wrong position are noticed
+qint16 AudioSampleValue(int i)
+{
+  return static_cast<qint16>(i % 20000 - 10000);
+}
+
+double NanosecondsToMilliseconds(qint64 nsecs)
+{
+  return static_cast<double>(nsecs) / 1000000.0;
+}
+
+}
+
+bool PlaybackBenchmark::Run(int seconds, QJsonObject *results)
+{
+  QTemporaryDir media_dir;
+
+  if (!media_dir.isValid()) {
+    qWarning() << "Failed to create a directory for playback benchmark media";
+    return false;
+  }
+
+  // Frames from a previous run would be loaded from disk instead of rendered. The budget only deletes files once the
+  // cache has been indexed, which nothing has done yet at this point.
+  qint64 disk_budget = DiskFrameCache::budget();
+  DiskFrameCache::set_budget(0);
+
+  QList<QByteArray> supported_formats = QImageWriter::supportedImageFormats();
+
+  QList<QSize> sizes = {QSize(1920, 1080), QSize(3840, 2160)};
+
+  bool ok = CheckAudioRetrieval(media_dir.path());
+
+  results->insert("audio_retrieval", ok);
+
+  QJsonArray scenarios;
+
+  foreach (const QString& format, QStringList({"png", "jpg", "tiff"})) {
+    if (!supported_formats.contains(format.toLatin1())) {
+      qWarning() << "Skipping playback benchmark scenarios for unsupported image format" << format;
+      continue;
+    }
+
+    foreach (const QSize& size, sizes) {
+      QString name = QStringLiteral("%1_%2p").arg(format, QString::number(size.height()));
+
+      QString scenario_dir = QDir(media_dir.path()).filePath(name);
+      QDir().mkpath(scenario_dir);
+
+      QStringList frames = GenerateMedia(scenario_dir, format, size);
+
+      if (frames.isEmpty()) {
+        qWarning() << "Failed to generate media for playback benchmark scenario" << name;
+        ok = false;
+        continue;
+      }
+
+      Sequence sequence;
+      sequence.set_video_width(size.width());
+      sequence.set_video_height(size.height());
+      sequence.set_video_time_base(rational(1, kFrameRate));
+
+      NodeOutput* output = BuildSequence(&sequence, frames, seconds);
+
+      QJsonObject scenario = RunScenario(name, &sequence, output, seconds);
+
+      if (scenario.isEmpty()) {
+        ok = false;
+        continue;
+      }
+
+      scenario.insert("import_ms", MeasureImport(frames));
+
+      QJsonObject scrub = MeasureScrub(&sequence, output, seconds);
+      ok = ok && !scrub.isEmpty();
+      scenario.insert("scrub", scrub);
+
+      QJsonObject exported = MeasureExport(&sequence, output, QDir(scenario_dir).filePath("export.mp4"));
+      ok = ok && !exported.isEmpty();
+      scenario.insert("export", exported);
+
+      scenarios.append(scenario);
+
+      // Don't keep every scenario's media on disk at once
+      QDir(scenario_dir).removeRecursively();
+    }
+  }
+
+  DiskFrameCache::set_budget(disk_budget);
+
+  results->insert("seconds", seconds);
+  results->insert("frame_rate", kFrameRate);
+  results->insert("threads", QThreadPool::globalInstance()->maxThreadCount());
+  results->insert("scenarios", scenarios);
+
+  return ok;
+}
+
+bool PlaybackBenchmark::RunToFile(const QString &filename,
+                                  int seconds,
+                                  const QString &baseline,
+                                  double tolerance)
+{
+  QJsonObject results;
+
+  bool ok = Run(seconds, &results);
+
+  QFile file;
+
+  if (filename == "-") {
+    file.open(stdout, QIODevice::WriteOnly);
+  } else {
+    file.setFileName(filename);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  }
+
+  if (!file.isOpen()) {
+    qWarning() << "Failed to open" << filename << "for writing benchmark results";
+    return false;
+  }
+
+  file.write(QJsonDocument(results).toJson());
+
+  if (!baseline.isEmpty() && !BenchmarkBaseline::Check(results, baseline, tolerance)) {
+    return false;
+  }
+
+  return ok;
+}
+
+QStringList PlaybackBenchmark::GenerateMedia(const QString &directory, const QString &format, const QSize &size)
+{
+  QStringList filenames;
+
+  QImage image(size, QImage::Format_RGB32);
+
+  // Deterministic noise so every run encodes the same images
+  quint32 seed = 1;
+
+  for (int i=0;i<kMediaFrames;i++) {
+    int offset = i * size.width() / kMediaFrames;
+
+    for (int y=0;y<size.height();y++) {
+      QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+      for (int x=0;x<size.width();x++) {
+        seed = seed * 1664525 + 1013904223;
+
+        int noise = static_cast<int>(seed >> 28);
+
+        line[x] = qRgb(((x + offset) * 255 / size.width()) % 256 ^ noise,
+                       (y * 255 / size.height()) ^ noise,
+                       (i * 255 / kMediaFrames) ^ noise);
+      }
+    }
+
+    QString filename = QDir(directory).filePath(QStringLiteral("%1.%2").arg(QString::number(i), format));
+
+    if (!image.save(filename, format.toLatin1().constData())) {
+      return QStringList();
+    }
+
+    filenames.append(filename);
+  }
+
+  return filenames;
+}
+
+bool PlaybackBenchmark::CheckAudioRetrieval(const QString &directory)
+{
+  QString filename = QDir(directory).filePath("audio.wav");
+
+  {
+    QFile file(filename);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      qWarning() << "Failed to write audio for playback benchmark";
+      return false;
+    }
+
+    quint32 data_size = static_cast<quint32>(kAudioSampleRate * kAudioSeconds * 2);
+
+    // Mono 16-bit PCM WAV
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("RIFF", 4);
+    stream << static_cast<quint32>(36 + data_size);
+    stream.writeRawData("WAVEfmt ", 8);
+    stream << quint32(16) << quint16(1) << quint16(1) << static_cast<quint32>(kAudioSampleRate)
+           << static_cast<quint32>(kAudioSampleRate * 2) << quint16(2) << quint16(16);
+    stream.writeRawData("data", 4);
+    stream << data_size;
+
+    for (int i=0;i<kAudioSampleRate * kAudioSeconds;i++) {
+      stream << AudioSampleValue(i);
+    }
+  }
+
+  Footage footage;
+  footage.set_filename(filename);
+
+  FFmpegDecoder prober;
+
+  if (!prober.Probe(&footage) || footage.stream_count() == 0 || footage.stream(0)->type() != Stream::kAudio) {
+    qWarning() << "Failed to probe audio for playback benchmark";
+    return false;
+  }
+
+  FFmpegDecoder decoder;
+  decoder.set_stream(footage.stream(0));
+
+  // Play the first ten seconds in half second spans so the cache holds all of them, then skip ahead by a little
+  // more than the decoder's frame size. The last request starts past the end of the cache but close enough to be
+  // decoded forward instead of seeking, and far enough from the start of the cache for old audio to be dropped.
+  QVector<int> starts;
+
+  for (int ms=0;ms<10000;ms+=500) {
+    starts.append(ms);
+  }
+
+  starts.append(10600);
+
+  // Step back a little after the skip, which should still be in the cache
+  starts.append(9000);
+
+  foreach (int ms, starts) {
+    FramePtr frame = decoder.Retrieve(rational(ms, 1000), rational(1, 2));
+
+    if (!frame || frame->sample_count() != kAudioSampleRate / 2) {
+      qWarning() << "Failed to retrieve audio at" << ms << "ms for playback benchmark";
+      return false;
+    }
+
+    const float* samples = reinterpret_cast<const float*>(frame->data()[0]);
+    int first = ms * kAudioSampleRate / 1000;
+
+    for (int i=0;i<frame->sample_count();i++) {
+      float expected = static_cast<float>(AudioSampleValue(first + i)) / 32768.0f;
+
+      if (qAbs(samples[i] - expected) > 0.0001f) {
+        qWarning() << "Audio retrieved at" << ms << "ms doesn't match the media for playback benchmark";
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+NodeOutput *PlaybackBenchmark::BuildSequence(Sequence *sequence, const QStringList &frames, int seconds)
+{
+  ImageInput* image = new ImageInput();
+  sequence->AddNode(image);
+
+  // Show the next frame of the media every frame, with some headroom past the end of playback
+  int frame_count = (seconds + 1) * kFrameRate;
+
+  image->filename_input()->set_keyframing(true);
+
+  for (int i=0;i<frame_count;i++) {
+    NodeKeyframe key;
+    key.set_time(rational(i, kFrameRate));
+    key.set_value(NodeValue(frames.at(i % frames.size()), NodeParam::kFile));
+    key.set_type(NodeKeyframe::kHold);
+    image->filename_input()->insert_keyframe(key);
+  }
+
+  // Slowly zoom and rotate the image so the transform does real work every frame
+  TransformNode* transform = new TransformNode();
+  sequence->AddNode(transform);
+
+  NodeParam::ConnectEdge(image->texture_output(), transform->texture_input());
+
+  rational end(frame_count, kFrameRate);
+
+  NodeKeyframe scale_start;
+  scale_start.set_time(0);
+  scale_start.set_value(NodeValue(1.0));
+  scale_start.set_type(NodeKeyframe::kLinear);
+
+  NodeKeyframe scale_end;
+  scale_end.set_time(end);
+  scale_end.set_value(NodeValue(0.5));
+  scale_end.set_type(NodeKeyframe::kLinear);
+
+  transform->scale_input()->set_keyframing(true);
+  transform->scale_input()->insert_keyframe(scale_start);
+  transform->scale_input()->insert_keyframe(scale_end);
+
+  NodeKeyframe rotation_start;
+  rotation_start.set_time(0);
+  rotation_start.set_value(NodeValue(0.0));
+  rotation_start.set_type(NodeKeyframe::kLinear);
+
+  NodeKeyframe rotation_end;
+  rotation_end.set_time(end);
+  rotation_end.set_value(NodeValue(static_cast<double>(frame_count)));
+  rotation_end.set_type(NodeKeyframe::kLinear);
+
+  transform->rotation_input()->set_keyframing(true);
+  transform->rotation_input()->insert_keyframe(rotation_start);
+  transform->rotation_input()->insert_keyframe(rotation_end);
+
+  // Layer it over a background, the way clips usually sit on top of something
+  SolidGenerator* background = new SolidGenerator();
+  sequence->AddNode(background);
+
+  CompositeNode* composite = new CompositeNode();
+  sequence->AddNode(composite);
+
+  NodeParam::ConnectEdge(background->texture_output(), composite->layers_input());
+  NodeParam::ConnectEdge(transform->texture_output(), composite->layers_input());
+
+  return composite->texture_output();
+}
+
+QJsonObject PlaybackBenchmark::RunScenario(const QString &name, Sequence *sequence, NodeOutput *output, int seconds)
+{
+  RendererProcessor renderer;
+  renderer.SetParameters(sequence->video_width(), sequence->video_height(), olive::PIX_FMT_RGBA8);
+  renderer.SetFrameDuration(sequence->video_time_base());
+  renderer.SetProfilingEnabled(true);
+  renderer.Start();
+
+  PlaybackEngine engine;
+  engine.SetTimebase(sequence->video_time_base());
+  engine.SetRenderer(&renderer, output);
+
+  QVector<qint64> queue_nsecs;
+  QVector<qint64> render_nsecs;
+  QVector<qint64> deliver_nsecs;
+  QVector<qint64> total_nsecs;
+  QVector<qint64> late_nsecs;
+
+  qint64 play_start = 0;
+  qint64 first_frame = -1;
+
+  // There's no viewer, so frames are shown the moment they're due or as soon as they arrive if they're late
+  QObject::connect(&engine, &PlaybackEngine::PresentFrame, [&](RenderJobPtr job, qint64 present_time) {
+    qint64 now = PlaybackEngine::PresentationTime();
+    qint64 age = job->age();
+
+    if (first_frame < 0) {
+      first_frame = now - play_start;
+    }
+
+    queue_nsecs.append(job->started_age());
+    render_nsecs.append(job->finished_age() - job->started_age());
+    deliver_nsecs.append(age - job->finished_age());
+    total_nsecs.append(age);
+    late_nsecs.append(qMax(now - present_time, qint64(0)));
+
+    engine.ReportPresentation(present_time, qMax(now, present_time));
+  });
+
+  // Profiles are emitted from the render threads
+  QHash<QString, QVector<qint64> > node_cpu_nsecs;
+  QHash<QString, QVector<qint64> > node_gpu_nsecs;
+
+  QObject::connect(&renderer, &RendererProcessor::ProfileReady, &engine, [&](RenderProfile profile) {
+    foreach (const RenderNodeTiming& timing, profile.nodes) {
+      node_cpu_nsecs[timing.name].append(qRound64(timing.cpu_ms * 1000000.0));
+      node_gpu_nsecs[timing.name].append(qRound64(timing.gpu_ms * 1000000.0));
+    }
+  }, Qt::QueuedConnection);
+
+  QEventLoop loop;
+  QTimer::singleShot(seconds * 1000, &loop, SLOT(quit()));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  play_start = PlaybackEngine::PresentationTime();
+  engine.Play();
+  loop.exec();
+
+  qint64 elapsed = timer.nsecsElapsed();
+
+  engine.Pause();
+  renderer.Stop();
+
+  if (total_nsecs.isEmpty()) {
+    qWarning() << "No frames were presented in playback benchmark scenario" << name;
+    return QJsonObject();
+  }
+
+  QJsonObject stages;
+  stages.insert("queue", Summarize(queue_nsecs));
+  stages.insert("render", Summarize(render_nsecs));
+  stages.insert("deliver", Summarize(deliver_nsecs));
+  stages.insert("total", Summarize(total_nsecs));
+  stages.insert("lateness", Summarize(late_nsecs));
+
+  QJsonArray nodes;
+
+  for (auto it=node_cpu_nsecs.constBegin();it!=node_cpu_nsecs.constEnd();it++) {
+    QJsonObject node;
+    node.insert("name", it.key());
+    node.insert("cpu", Summarize(it.value()));
+    node.insert("gpu", Summarize(node_gpu_nsecs.value(it.key())));
+    nodes.append(node);
+  }
+
+  QJsonObject scenario;
+  scenario.insert("name", name);
+  scenario.insert("width", sequence->video_width());
+  scenario.insert("height", sequence->video_height());
+  scenario.insert("fps", static_cast<double>(engine.rendered_frames()) / (static_cast<double>(elapsed) / 1e9));
+  scenario.insert("rendered_frames", engine.rendered_frames());
+  scenario.insert("dropped_frames", engine.dropped_frames());
+  scenario.insert("late_frames", engine.late_frames());
+  scenario.insert("first_frame_ms", NanosecondsToMilliseconds(first_frame));
+  scenario.insert("stages", stages);
+  scenario.insert("nodes", nodes);
+  return scenario;
+}
+
+double PlaybackBenchmark::MeasureImport(const QStringList &frames)
+{
+  Project project;
+  ProjectViewModel model(nullptr);
+  model.set_project(&project);
+
+  ImportTask task(&model, project.root(), frames);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  task.Action();
+
+  qint64 elapsed = timer.nsecsElapsed();
+
+  // The import's undo command refers to the project, which is about to be destroyed
+  olive::undo_stack.clear();
+
+  return NanosecondsToMilliseconds(elapsed);
+}
+
+QJsonObject PlaybackBenchmark::MeasureScrub(Sequence *sequence, NodeOutput *output, int seconds)
+{
+  // A renderer of its own so that frames rendered during playback aren't in its FrameCache
+  RendererProcessor renderer;
+  renderer.SetParameters(sequence->video_width(), sequence->video_height(), olive::PIX_FMT_RGBA8);
+  renderer.SetFrameDuration(sequence->video_time_base());
+  renderer.Start();
+
+  QVector<qint64> preview_nsecs;
+  QVector<qint64> exact_nsecs;
+
+  RenderJobPtr waiting;
+  QEventLoop loop;
+
+  QObject::connect(&renderer, &RendererProcessor::FrameReady, &loop, [&](RenderJobPtr job) {
+    if (job == waiting) {
+      loop.quit();
+    }
+  }, Qt::QueuedConnection);
+
+  int frame_count = seconds * kFrameRate;
+  bool ok = true;
+
+  for (int i=0;i<kScrubPositions && ok;i++) {
+    // Jump around the sequence rather than moving one frame at a time
+    rational time(static_cast<qint64>(i) * 7919 % frame_count, kFrameRate);
+
+    QVector<RenderJobPtr> jobs = renderer.QueueScrubFrame(output, time);
+
+    if (jobs.isEmpty()) {
+      ok = false;
+      break;
+    }
+
+    waiting = jobs.last();
+
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+    timeout.start(kScrubTimeout);
+
+    loop.exec();
+
+    if (!waiting->IsFinished()) {
+      ok = false;
+      break;
+    }
+
+    exact_nsecs.append(waiting->finished_age());
+
+    // The reduced resolution preview shown until the exact frame is ready, if there was one
+    if (jobs.size() > 1 && jobs.first()->IsFinished()) {
+      preview_nsecs.append(jobs.first()->finished_age());
+    }
+  }
+
+  waiting = nullptr;
+
+  renderer.Stop();
+
+  if (!ok) {
+    qWarning() << "Failed to render scrubbed frames for playback benchmark";
+    return QJsonObject();
+  }
+
+  QJsonObject scrub;
+  scrub.insert("positions", exact_nsecs.size());
+  scrub.insert("exact", Summarize(exact_nsecs));
+
+  if (!preview_nsecs.isEmpty()) {
+    scrub.insert("preview", Summarize(preview_nsecs));
+  }
+
+  return scrub;
+}
+
+QJsonObject PlaybackBenchmark::MeasureExport(Sequence *sequence, NodeOutput *output, const QString &filename)
+{
+  ExportEngine engine;
+
+  ExportEngine::Params params;
+  params.output = output;
+  params.width = sequence->video_width();
+  params.height = sequence->video_height();
+  params.timebase = sequence->video_time_base();
+  params.in = 0;
+  params.out = kExportFrames - 1;
+  params.filename = filename;
+
+  QEventLoop loop;
+  bool finished_ok = false;
+
+  QObject::connect(&engine, &ExportEngine::Finished, &loop, [&](bool ok) {
+    finished_ok = ok;
+    loop.quit();
+  });
+
+  QElapsedTimer timer;
+  timer.start();
+
+  if (!engine.Start(params)) {
+    qWarning() << "Failed to start export for playback benchmark:" << engine.error();
+    return QJsonObject();
+  }
+
+  loop.exec();
+
+  qint64 elapsed = timer.nsecsElapsed();
+
+  if (!finished_ok) {
+    qWarning() << "Failed to export for playback benchmark:" << engine.error();
+    return QJsonObject();
+  }
+
+  QFile::remove(filename);
+
+  QJsonObject exported;
+  exported.insert("frames", kExportFrames);
+  exported.insert("export_ms", NanosecondsToMilliseconds(elapsed));
+  exported.insert("frames_per_second", static_cast<double>(kExportFrames) / (static_cast<double>(elapsed) / 1e9));
+  exported.insert("limiting_stage", engine.LimitingStage());
+  return exported;
+}
+
+QJsonObject PlaybackBenchmark::Summarize(QVector<qint64> nsecs)
+{
+  QJsonObject summary;
+
+  if (nsecs.isEmpty()) {
+    return summary;
+  }
+
+  std::sort(nsecs.begin(), nsecs.end());
+
+  summary.insert("p50_ms", NanosecondsToMilliseconds(nsecs.at(nsecs.size() / 2)));
+  summary.insert("p99_ms", NanosecondsToMilliseconds(nsecs.at(qMin(nsecs.size() * 99 / 100, nsecs.size() - 1))));
+  summary.insert("max_ms", NanosecondsToMilliseconds(nsecs.last()));
+
+  return summary;
+}
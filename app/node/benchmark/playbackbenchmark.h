@@ -0,0 +1,144 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PLAYBACKBENCHMARK_H
+#define PLAYBACKBENCHMARK_H
+
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "node/benchmark/benchmarkbaseline.h"
+#include "project/item/sequence/sequence.h"
+
+/**
+ * @brief Measures real-time playback of synthetic media end to end
+ *
+ * For each combination of image format and resolution, a short loop of distinct frames is generated (a moving
+ * gradient with noise, so it doesn't compress to nothing) and played back from a Sequence whose ImageInput's filename
+ * is keyframed to a different frame every frame. The image is scaled and rotated by a TransformNode and composited
+ * over a SolidGenerator, so every frame decodes, uploads, transforms and blends like a typical edit.
+ *
+ * Each scenario plays for a fixed duration through PlaybackEngine and a RendererProcessor without a viewer (frames
+ * count as shown the moment they're due, or as soon as they arrive if they're late). Reported are the achieved frame
+ * rate, dropped and late frames, the latency of the first frame and the p50/p99 latency of each stage of a frame:
+ * waiting for a render thread, rendering, waiting to be presented, and each node's CPU and GPU time. Each scenario
+ * also reports how long its media takes to import, the latency of scrubbing to frames that haven't been rendered yet
+ * and the throughput of exporting it. Results are reported as JSON so runs can be compared (see BenchmarkBaseline).
+ * Before the scenarios, audio is checked to come back from the decoder intact while its cache is stepped through.
+ * Started from the command line with --benchmark-playback.
+ */
+class PlaybackBenchmark
+{
+public:
+  /**
+   * @brief Run every scenario
+   *
+   * @param seconds
+   *
+   * How long each scenario plays for.
+   *
+   * @return
+   *
+   * FALSE if a scenario couldn't be run, in which case results only contain the scenarios that could.
+   */
+  static bool Run(int seconds, QJsonObject* results);
+
+  /**
+   * @brief Run every scenario and write the results to a file ("-" for standard output)
+   *
+   * If a baseline filename is given, the results are also compared with it (see BenchmarkBaseline).
+   *
+   * @return
+   *
+   * FALSE if a scenario couldn't be run, the results couldn't be written or they regressed from the baseline.
+   */
+  static bool RunToFile(const QString& filename,
+                        int seconds,
+                        const QString& baseline = QString(),
+                        double tolerance = BenchmarkBaseline::kDefaultTolerance);
+
+private:
+  /**
+   * @brief Write the frames of a scenario's media to a directory
+   *
+   * @return
+   *
+   * The filename of each frame, or an empty list if they couldn't be written.
+   */
+  static QStringList GenerateMedia(const QString& directory, const QString& format, const QSize& size);
+
+  /**
+   * @brief Check that audio retrieved from FFmpegDecoder matches its media across its cache's edge cases
+   *
+   * Writes a WAV file to a directory and retrieves consecutive spans of it, then a span starting just past the end of
+   * what's been cached and one a little way back.
+   *
+   * @return
+   *
+   * FALSE if the audio couldn't be retrieved or didn't match.
+   */
+  static bool CheckAudioRetrieval(const QString& directory);
+
+  /**
+   * @brief Build a sequence playing the frames in a loop
+   *
+   * @return
+   *
+   * The output to play.
+   */
+  static NodeOutput* BuildSequence(Sequence* sequence, const QStringList& frames, int seconds);
+
+  /**
+   * @brief Play a sequence's output for a number of seconds and report the statistics
+   */
+  static QJsonObject RunScenario(const QString& name, Sequence* sequence, NodeOutput* output, int seconds);
+
+  /**
+   * @brief Milliseconds taken to import a scenario's media into a new project
+   */
+  static double MeasureImport(const QStringList& frames);
+
+  /**
+   * @brief Scrub a sequence to a series of frames, reporting how long each preview and exact frame took to render
+   *
+   * @return
+   *
+   * The statistics, or an empty object if a frame couldn't be rendered.
+   */
+  static QJsonObject MeasureScrub(Sequence* sequence, NodeOutput* output, int seconds);
+
+  /**
+   * @brief Export the start of a sequence to a file in the container's default codec and report the throughput
+   *
+   * @return
+   *
+   * The statistics, or an empty object if the export failed.
+   */
+  static QJsonObject MeasureExport(Sequence* sequence, NodeOutput* output, const QString& filename);
+
+  /**
+   * @brief p50, p99 and max of a list of nanosecond durations, in milliseconds
+   */
+  static QJsonObject Summarize(QVector<qint64> nsecs);
+};
+
+#endif // PLAYBACKBENCHMARK_H
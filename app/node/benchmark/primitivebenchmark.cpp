@@ -0,0 +1,513 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "primitivebenchmark.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+
+#include "common/rational.h"
+#include "common/tickrescaler.h"
+#include "decoder/frame.h"
+#include "node/benchmark/benchmarknode.h"
+#include "node/input.h"
+#include "node/keyframe.h"
+#include "render/imagecache.h"
+#include "render/memorybuffer.h"
+#include "render/pixelconvertkernels.h"
+#include "render/pixelformat.h"
+
+namespace {
+
+// Each operation is timed in batches until both of these are reached
+const int kMinBatches = 5;
+const qint64 kMinNsecs = Q_INT64_C(200000000);
+
+// Width of the rows the pixel kernels convert (a 1080p row)
+const int kRowWidth = 1920;
+
+// Buffers each ImageCache thread holds Refs to
+const int kRefsPerThread = 4;
+
+// Requests each ImageCache thread makes per batch
+const int kRequestsPerThread = 2000;
+
+// Keyframes are evaluated at this rate
+const int kFrameRate = 30;
+
+/**
+ * @brief Requests buffers from an ImageCache the way render threads do, locking them while they're used
+ */
+class ImageCacheWorker : public QThread
+{
+public:
+  ImageCacheWorker(ImageCache* cache) :
+    cache_(cache),
+    checksum_(0)
+  {
+  }
+
+  qint64 checksum() const
+  {
+    return checksum_;
+  }
+
+protected:
+  virtual void run() override
+  {
+    std::vector< std::unique_ptr<ImageCache::ImgRef> > refs;
+
+    for (int i=0;i<kRefsPerThread;i++) {
+      refs.push_back(std::unique_ptr<ImageCache::ImgRef>(new ImageCache::ImgRef(cache_)));
+    }
+
+    for (int i=0;i<kRequestsPerThread;i++) {
+      ImageCache::ImgRef* ref = refs.at(static_cast<size_t>(i % kRefsPerThread)).get();
+
+      ref->Lock();
+
+      MemoryBuffer* buffer = ref->buffer();
+
+      if (buffer != nullptr) {
+        checksum_ += buffer->width();
+      }
+
+      ref->Unlock();
+
+      // Give every other buffer back so requests alternate between reusing free buffers and taking them from others
+      if (i % 2 == 1) {
+        ref->Relinquish();
+      }
+    }
+  }
+
+private:
+  ImageCache* cache_;
+
+  qint64 checksum_;
+};
+
+}
+
+bool PrimitiveBenchmark::Run(QJsonObject *results)
+{
+  QJsonArray benchmarks;
+
+  BenchmarkRational(&benchmarks);
+  BenchmarkBufferSizes(&benchmarks);
+  BenchmarkPixelKernels(&benchmarks);
+  BenchmarkImageCache(&benchmarks);
+  BenchmarkKeyframes(&benchmarks);
+
+  bool ok = BenchmarkFrameRefs(&benchmarks);
+
+  results->insert("kernels", QString(olive::pixel::GetKernels().name));
+  results->insert("threads", QThread::idealThreadCount());
+  results->insert("benchmarks", benchmarks);
+
+  return ok;
+}
+
+bool PrimitiveBenchmark::RunToFile(const QString &filename, const QString &baseline, double tolerance)
+{
+  QJsonObject results;
+
+  bool ok = Run(&results);
+
+  QFile file;
+
+  if (filename == "-") {
+    file.open(stdout, QIODevice::WriteOnly);
+  } else {
+    file.setFileName(filename);
+    file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  }
+
+  if (!file.isOpen()) {
+    qWarning() << "Failed to open" << filename << "for writing benchmark results";
+    return false;
+  }
+
+  file.write(QJsonDocument(results).toJson());
+
+  if (!baseline.isEmpty() && !BenchmarkBaseline::Check(results, baseline, tolerance)) {
+    return false;
+  }
+
+  return ok;
+}
+
+QJsonObject PrimitiveBenchmark::Measure(const QString &name, int ops_per_batch, const std::function<qint64 ()> &batch)
+{
+  QVector<double> op_nsecs;
+
+  qint64 checksum = 0;
+
+  QElapsedTimer total;
+  QElapsedTimer timer;
+
+  total.start();
+
+  while (op_nsecs.size() < kMinBatches || total.nsecsElapsed() < kMinNsecs) {
+    timer.start();
+    checksum += batch();
+    op_nsecs.append(static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(ops_per_batch));
+  }
+
+  std::sort(op_nsecs.begin(), op_nsecs.end());
+
+  QJsonObject summary;
+  summary.insert("name", name);
+  summary.insert("batches", op_nsecs.size());
+  summary.insert("ops_per_batch", ops_per_batch);
+  summary.insert("median_ns", op_nsecs.at(op_nsecs.size() / 2));
+  summary.insert("min_ns", op_nsecs.first());
+
+  // Only here so the compiler can't drop the work, but a change between runs also means the results changed
+  summary.insert("checksum", static_cast<double>(checksum));
+
+  return summary;
+}
+
+void PrimitiveBenchmark::BenchmarkRational(QJsonArray *results)
+{
+  // Alternate between NTSC frame times and audio sample times so most operations need a common denominator
+  QVector<rational> times(1024);
+
+  for (int i=0;i<times.size();i++) {
+    if (i % 2 == 0) {
+      times[i] = rational(i * 1001, 30000);
+    } else {
+      times[i] = rational(i, 48000);
+    }
+  }
+
+  results->append(Measure("rational_add", times.size(), [&times]() {
+    rational sum;
+
+    for (int i=0;i<times.size();i++) {
+      sum += times.at(i);
+    }
+
+    return static_cast<qint64>(sum.numerator());
+  }));
+
+  results->append(Measure("rational_add_same_denominator", times.size(), [&times]() {
+    rational sum;
+    rational frame(1001, 30000);
+
+    for (int i=0;i<times.size();i++) {
+      sum += frame;
+    }
+
+    return static_cast<qint64>(sum.numerator());
+  }));
+
+  results->append(Measure("rational_multiply", times.size(), [&times]() {
+    qint64 checksum = 0;
+    rational speed(3, 2);
+
+    for (int i=0;i<times.size();i++) {
+      rational scaled = times.at(i) * speed;
+      checksum += scaled.numerator();
+    }
+
+    return checksum;
+  }));
+
+  results->append(Measure("rational_compare", times.size(), [&times]() {
+    qint64 checksum = 0;
+
+    for (int i=0;i<times.size();i++) {
+      if (times.at(i) < times.at((i + 1) % times.size())) {
+        checksum++;
+      }
+    }
+
+    return checksum;
+  }));
+
+  results->append(Measure("rational_time_to_ticks", times.size(), [&times]() {
+    qint64 checksum = 0;
+    rational timebase(1001, 30000);
+
+    for (int i=0;i<times.size();i++) {
+      checksum += olive::TimeToTicks(times.at(i), timebase);
+    }
+
+    return checksum;
+  }));
+}
+
+void PrimitiveBenchmark::BenchmarkBufferSizes(QJsonArray *results)
+{
+  const int widths = 64;
+
+  results->append(Measure("pixel_buffer_size", olive::PIX_FMT_COUNT * widths, []() {
+    qint64 checksum = 0;
+
+    for (int i=0;i<olive::PIX_FMT_COUNT;i++) {
+      olive::PixelFormat format = static_cast<olive::PixelFormat>(i);
+
+      for (int j=0;j<widths;j++) {
+        checksum += PixelService::GetBufferSize(format, kRowWidth + j, 1080);
+      }
+    }
+
+    return checksum;
+  }));
+
+  results->append(Measure("memory_buffer_linesize", olive::PIX_FMT_COUNT * widths, []() {
+    qint64 checksum = 0;
+
+    for (int i=0;i<olive::PIX_FMT_COUNT;i++) {
+      olive::PixelFormat format = static_cast<olive::PixelFormat>(i);
+
+      for (int j=0;j<widths;j++) {
+        checksum += MemoryBuffer::GetLinesize(format, kRowWidth + j);
+      }
+    }
+
+    return checksum;
+  }));
+}
+
+void PrimitiveBenchmark::BenchmarkPixelKernels(QJsonArray *results)
+{
+  const int rows = 64;
+
+  // BT.709
+  const olive::pixel::YUVMatrix matrix = {1.5748f, -0.1873f, -0.4681f, 1.8556f};
+
+  const size_t row_width = static_cast<size_t>(kRowWidth);
+
+  std::vector<float> y(row_width);
+  std::vector<float> u(row_width);
+  std::vector<float> v(row_width);
+  std::vector<float> rgba(row_width * 4);
+
+  // Largest packed format is 8 bytes per pixel
+  std::vector<char> packed(row_width * 8);
+
+  for (size_t i=0;i<y.size();i++) {
+    y[i] = static_cast<float>(i % 256) / 255.0f;
+    u[i] = static_cast<float>((i * 3) % 256) / 255.0f - 0.5f;
+    v[i] = static_cast<float>((i * 7) % 256) / 255.0f - 0.5f;
+  }
+
+  QVector<const olive::pixel::Kernels*> kernel_sets;
+  kernel_sets.append(&olive::pixel::GetScalarKernels());
+
+  if (&olive::pixel::GetKernels() != kernel_sets.first()) {
+    kernel_sets.append(&olive::pixel::GetKernels());
+  }
+
+  foreach (const olive::pixel::Kernels* k, kernel_sets) {
+    QString suffix = QStringLiteral("_%1").arg(QString(k->name));
+
+    results->append(Measure("pixel_yuv_to_rgba" + suffix, rows * kRowWidth, [&]() {
+      for (int i=0;i<rows;i++) {
+        k->yuv_to_rgba(y.data(), u.data(), v.data(), rgba.data(), kRowWidth, matrix);
+      }
+
+      return static_cast<qint64>(rgba.at(4) * 255.0f);
+    }));
+
+    QVector< QPair<QString, olive::pixel::PackFunction> > packs;
+    packs.append({"pixel_pack_rgba8", k->pack_rgba8});
+    packs.append({"pixel_pack_rgba16", k->pack_rgba16});
+    packs.append({"pixel_pack_rgba16f", k->pack_rgba16f});
+
+    for (int i=0;i<packs.size();i++) {
+      olive::pixel::PackFunction pack = packs.at(i).second;
+
+      results->append(Measure(packs.at(i).first + suffix, rows * kRowWidth, [&]() {
+        for (int j=0;j<rows;j++) {
+          pack(rgba.data(), packed.data(), kRowWidth);
+        }
+
+        return static_cast<qint64>(packed.at(5));
+      }));
+    }
+  }
+}
+
+void PrimitiveBenchmark::BenchmarkImageCache(QJsonArray *results)
+{
+  const int width = 256;
+  const int height = 256;
+  const int threads = qMax(2, QThread::idealThreadCount());
+
+  ImageCache cache;
+  cache.SetParameters(nullptr, width, height, olive::PIX_FMT_RGBA8);
+  cache.SetSpillEnabled(false);
+
+  // Room for half the Refs' buffers, so requests keep taking buffers from each other
+  qint64 buffer_size = PixelService::GetBufferSize(olive::PIX_FMT_RGBA8, width, height);
+  cache.SetBudget(ImageCache::kMemBuf, buffer_size * threads * kRefsPerThread / 2);
+
+  results->append(Measure(QStringLiteral("image_cache_request_%1_threads").arg(threads),
+                          threads * kRequestsPerThread,
+                          [&cache, threads]() {
+    std::vector< std::unique_ptr<ImageCacheWorker> > workers;
+
+    for (int i=0;i<threads;i++) {
+      workers.push_back(std::unique_ptr<ImageCacheWorker>(new ImageCacheWorker(&cache)));
+      workers.back()->start();
+    }
+
+    qint64 checksum = 0;
+
+    for (size_t i=0;i<workers.size();i++) {
+      workers.at(i)->wait();
+      checksum += workers.at(i)->checksum();
+    }
+
+    return checksum;
+  }));
+}
+
+void PrimitiveBenchmark::BenchmarkKeyframes(QJsonArray *results)
+{
+  const int keyframes = 1024;
+
+  BenchmarkNode node;
+  NodeInput* input = node.values_input();
+
+  input->set_keyframing(true);
+
+  // One keyframe every other frame, cycling through every interpolation method
+  for (int i=0;i<keyframes;i++) {
+    NodeKeyframe key;
+
+    key.set_time(rational(i * 2, kFrameRate));
+    key.set_value(NodeValue(static_cast<double>(i % 100)));
+
+    switch (i % 3) {
+    case 0:
+      key.set_type(NodeKeyframe::kLinear);
+      break;
+    case 1:
+      key.set_type(NodeKeyframe::kBezier);
+      key.set_bezier_control_in(QPointF(-0.5, 0.0));
+      key.set_bezier_control_out(QPointF(0.5, 0.0));
+      break;
+    default:
+      key.set_type(NodeKeyframe::kHold);
+    }
+
+    input->insert_keyframe(key);
+  }
+
+  const int frames = keyframes * 2;
+
+  results->append(Measure("keyframe_sequential", frames, [input]() {
+    double checksum = 0;
+
+    for (int i=0;i<frames;i++) {
+      checksum += input->get_value(rational(i, kFrameRate)).toDouble();
+    }
+
+    return static_cast<qint64>(checksum);
+  }));
+
+  // Jumping around defeats the segment hint, so every lookup has to search
+  results->append(Measure("keyframe_random", frames, [input]() {
+    double checksum = 0;
+
+    for (int i=0;i<frames;i++) {
+      checksum += input->get_value(rational((i * 7919) % frames, kFrameRate)).toDouble();
+    }
+
+    return static_cast<qint64>(checksum);
+  }));
+
+  QVector<rational> times(frames);
+
+  for (int i=0;i<frames;i++) {
+    times[i] = rational(i, kFrameRate);
+  }
+
+  results->append(Measure("keyframe_batch", frames, [input, &times]() {
+    QVector<NodeValue> values = input->get_value_batch(times);
+
+    double checksum = 0;
+
+    for (int i=0;i<values.size();i++) {
+      checksum += values.at(i).toDouble();
+    }
+
+    return static_cast<qint64>(checksum);
+  }));
+}
+
+bool PrimitiveBenchmark::BenchmarkFrameRefs(QJsonArray *results)
+{
+  AVFrame* av_frame = av_frame_alloc();
+
+  av_frame->format = AV_PIX_FMT_YUV420P;
+  av_frame->width = kRowWidth;
+  av_frame->height = 1080;
+  av_frame->pts = 0;
+
+  if (av_frame_get_buffer(av_frame, 0) < 0) {
+    qWarning() << "Failed to allocate a frame for the Frame benchmark";
+    av_frame_free(&av_frame);
+    return false;
+  }
+
+  Frame frame;
+  frame.SetAVFrame(av_frame, {1, 30});
+
+  const int refs = 1024;
+
+  // Copies take a reference to the same buffers and release it when they're destroyed
+  results->append(Measure("frame_ref_unref", refs, [&frame]() {
+    qint64 checksum = 0;
+
+    for (int i=0;i<refs;i++) {
+      Frame copy(frame);
+      checksum += copy.width();
+    }
+
+    return checksum;
+  }));
+
+  FramePtr shared = std::make_shared<Frame>(frame);
+
+  results->append(Measure("frame_ptr_copy", refs, [&shared]() {
+    qint64 checksum = 0;
+
+    for (int i=0;i<refs;i++) {
+      FramePtr copy = shared;
+      checksum += copy.use_count();
+    }
+
+    return checksum;
+  }));
+
+  return true;
+}
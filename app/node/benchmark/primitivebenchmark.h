@@ -0,0 +1,91 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PRIMITIVEBENCHMARK_H
+#define PRIMITIVEBENCHMARK_H
+
+#include <functional>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+#include "node/benchmark/benchmarkbaseline.h"
+
+/**
+ * @brief Measures the small operations the renderer and decoders perform many times per frame
+ *
+ * Covers rational arithmetic, buffer sizing, the pixel conversion kernels, ImageCache requests from several threads
+ * at once, keyframe interpolation and Frame reference counting. Each operation is repeated in batches until enough
+ * time has passed for stable numbers and its median and fastest time per operation are reported as JSON, in the same
+ * way as NodeGraphBenchmark. Started from the command line with --benchmark-primitives.
+ */
+class PrimitiveBenchmark
+{
+public:
+  /**
+   * @brief Run every benchmark
+   *
+   * @return
+   *
+   * FALSE if a benchmark couldn't be run, in which case results only contain the benchmarks that could.
+   */
+  static bool Run(QJsonObject* results);
+
+  /**
+   * @brief Run every benchmark and write the results to a file ("-" for standard output)
+   *
+   * If a baseline filename is given, the results are also compared with it (see BenchmarkBaseline).
+   *
+   * @return
+   *
+   * FALSE if a benchmark couldn't be run, the results couldn't be written or they regressed from the baseline.
+   */
+  static bool RunToFile(const QString& filename,
+                        const QString& baseline = QString(),
+                        double tolerance = BenchmarkBaseline::kDefaultTolerance);
+
+private:
+  /**
+   * @brief Time a batch of operations repeatedly and summarize the time per operation
+   *
+   * @param ops_per_batch
+   *
+   * Number of operations one call to `batch` performs.
+   *
+   * @param batch
+   *
+   * Performs the operations and returns a value derived from their results, so they can't be optimized away.
+   */
+  static QJsonObject Measure(const QString& name, int ops_per_batch, const std::function<qint64()>& batch);
+
+  static void BenchmarkRational(QJsonArray* results);
+
+  static void BenchmarkBufferSizes(QJsonArray* results);
+
+  static void BenchmarkPixelKernels(QJsonArray* results);
+
+  static void BenchmarkImageCache(QJsonArray* results);
+
+  static void BenchmarkKeyframes(QJsonArray* results);
+
+  static bool BenchmarkFrameRefs(QJsonArray* results);
+};
+
+#endif // PRIMITIVEBENCHMARK_H
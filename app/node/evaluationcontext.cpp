@@ -0,0 +1,286 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "evaluationcontext.h"
+
+#include <QThread>
+
+// Context current on this thread
+static thread_local NodeEvaluationContext* current_context = nullptr;
+
+// Region of the innermost RegionScope on this thread
+static thread_local const QRect* current_region = nullptr;
+
+NodeEvaluationContext::NodeEvaluationContext() :
+  divider_(1),
+  keyframes_only_(false),
+  sample_count_(0),
+  sample_rate_(0),
+  cancel_token_(nullptr),
+  software_(false),
+  provisional_allowed_(false),
+  provisional_(0),
+  snapshot_(nullptr)
+{
+}
+
+const rational &NodeEvaluationContext::time() const
+{
+  return time_;
+}
+
+void NodeEvaluationContext::set_time(const rational &time)
+{
+  time_ = time;
+}
+
+int NodeEvaluationContext::divider() const
+{
+  return divider_;
+}
+
+void NodeEvaluationContext::set_divider(int divider)
+{
+  divider_ = divider;
+}
+
+const QRect &NodeEvaluationContext::tile() const
+{
+  return tile_;
+}
+
+void NodeEvaluationContext::set_tile(const QRect &tile)
+{
+  tile_ = tile;
+}
+
+const QRect &NodeEvaluationContext::frame() const
+{
+  return frame_;
+}
+
+void NodeEvaluationContext::set_frame(const QRect &frame)
+{
+  frame_ = frame;
+}
+
+bool NodeEvaluationContext::keyframes_only() const
+{
+  return keyframes_only_;
+}
+
+void NodeEvaluationContext::set_keyframes_only(bool keyframes_only)
+{
+  keyframes_only_ = keyframes_only;
+}
+
+int NodeEvaluationContext::sample_count() const
+{
+  return sample_count_;
+}
+
+int NodeEvaluationContext::sample_rate() const
+{
+  return sample_rate_;
+}
+
+void NodeEvaluationContext::set_samples(int sample_count, int sample_rate)
+{
+  sample_count_ = sample_count;
+  sample_rate_ = sample_rate;
+}
+
+const QAtomicInt *NodeEvaluationContext::cancel_token() const
+{
+  return cancel_token_;
+}
+
+void NodeEvaluationContext::set_cancel_token(const QAtomicInt *token)
+{
+  cancel_token_ = token;
+}
+
+bool NodeEvaluationContext::software() const
+{
+  return software_;
+}
+
+void NodeEvaluationContext::set_software(bool software)
+{
+  software_ = software;
+}
+
+bool NodeEvaluationContext::provisional_allowed() const
+{
+  return provisional_allowed_;
+}
+
+void NodeEvaluationContext::set_provisional_allowed(bool allowed)
+{
+  provisional_allowed_ = allowed;
+}
+
+bool NodeEvaluationContext::provisional() const
+{
+  return provisional_.load();
+}
+
+void NodeEvaluationContext::set_provisional(bool provisional)
+{
+  provisional_ = provisional;
+}
+
+const NodeGraphSnapshot *NodeEvaluationContext::snapshot() const
+{
+  return snapshot_;
+}
+
+void NodeEvaluationContext::set_snapshot(const NodeGraphSnapshot *snapshot)
+{
+  snapshot_ = snapshot;
+}
+
+NodeEvaluationContext *NodeEvaluationContext::Current()
+{
+  return current_context;
+}
+
+void NodeEvaluationContext::SetCurrent(NodeEvaluationContext *context)
+{
+  current_context = context;
+}
+
+Qt::HANDLE NodeEvaluationContext::CurrentId()
+{
+  if (current_context != nullptr) {
+    return current_context;
+  }
+
+  return QThread::currentThreadId();
+}
+
+int NodeEvaluationContext::CurrentDivider()
+{
+  if (current_context != nullptr) {
+    return current_context->divider_;
+  }
+
+  return 1;
+}
+
+QRect NodeEvaluationContext::CurrentTile()
+{
+  if (current_context != nullptr) {
+    return (current_region != nullptr) ? *current_region : current_context->tile_;
+  }
+
+  return QRect();
+}
+
+QRect NodeEvaluationContext::CurrentFrame()
+{
+  if (current_context != nullptr) {
+    return current_context->frame_;
+  }
+
+  return QRect();
+}
+
+bool NodeEvaluationContext::CurrentKeyframesOnly()
+{
+  if (current_context != nullptr) {
+    return current_context->keyframes_only_;
+  }
+
+  return false;
+}
+
+int NodeEvaluationContext::CurrentSampleCount()
+{
+  if (current_context != nullptr) {
+    return current_context->sample_count_;
+  }
+
+  return 0;
+}
+
+int NodeEvaluationContext::CurrentSampleRate()
+{
+  if (current_context != nullptr) {
+    return current_context->sample_rate_;
+  }
+
+  return 0;
+}
+
+const QAtomicInt *NodeEvaluationContext::CurrentCancelToken()
+{
+  if (current_context != nullptr) {
+    return current_context->cancel_token_;
+  }
+
+  return nullptr;
+}
+
+bool NodeEvaluationContext::CurrentIsSoftware()
+{
+  if (current_context != nullptr) {
+    return current_context->software_;
+  }
+
+  return false;
+}
+
+bool NodeEvaluationContext::CurrentAllowsProvisional()
+{
+  if (current_context != nullptr) {
+    return current_context->provisional_allowed_;
+  }
+
+  return false;
+}
+
+void NodeEvaluationContext::MarkCurrentProvisional()
+{
+  if (current_context != nullptr) {
+    current_context->provisional_ = 1;
+  }
+}
+
+const NodeGraphSnapshot *NodeEvaluationContext::CurrentSnapshot()
+{
+  if (current_context != nullptr) {
+    return current_context->snapshot_;
+  }
+
+  return nullptr;
+}
+
+NodeEvaluationContext::RegionScope::RegionScope(const QRect &region) :
+  region_(region),
+  previous_(current_region)
+{
+  current_region = &region_;
+}
+
+NodeEvaluationContext::RegionScope::~RegionScope()
+{
+  current_region = previous_;
+}
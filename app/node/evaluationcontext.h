@@ -0,0 +1,259 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEEVALUATIONCONTEXT_H
+#define NODEEVALUATIONCONTEXT_H
+
+#include <QAtomicInt>
+#include <QRect>
+
+#include "common/rational.h"
+
+class NodeGraphSnapshot;
+
+/**
+ * @brief Describes one evaluation of a node graph and holds the values its outputs produce
+ *
+ * NodeOutput keeps a separate value for every evaluation context, so the same Node can be processed concurrently for
+ * different frames as long as each evaluation has its own context. A context also carries what's being rendered (the
+ * frame time, resolution divider and tile), which nodes can read through Current().
+ *
+ * A context is made current on a thread with SetCurrent(). Each RendererThread has one that lives as long as the
+ * thread and is updated for every job, so values stay cached between jobs. Workers processing part of a graph for
+ * another thread make that thread's context current so their results land where it'll look for them (see
+ * NodeGraphPlan). Threads without a current context use their own thread ID as a context.
+ */
+class NodeEvaluationContext
+{
+public:
+  NodeEvaluationContext();
+
+  NodeEvaluationContext(const NodeEvaluationContext& other) = delete;
+  NodeEvaluationContext(NodeEvaluationContext&& other) = delete;
+  NodeEvaluationContext& operator=(const NodeEvaluationContext& other) = delete;
+  NodeEvaluationContext& operator=(NodeEvaluationContext&& other) = delete;
+
+  /**
+   * @brief Time of the frame being evaluated
+   */
+  const rational& time() const;
+  void set_time(const rational& time);
+
+  /**
+   * @brief Fraction of full resolution to render at (see RenderJob::divider())
+   */
+  int divider() const;
+  void set_divider(int divider);
+
+  /**
+   * @brief Region of the frame to render (see RenderJob::tile()), or a null rect for the whole frame
+   */
+  const QRect& tile() const;
+  void set_tile(const QRect& tile);
+
+  /**
+   * @brief The whole (divided) frame the tile is part of, or a null rect if unknown
+   *
+   * Nodes pulling their inputs over a different region than their own (see Node::RegionOfInterest()) keep it inside
+   * this, since nothing exists outside the frame.
+   */
+  const QRect& frame() const;
+  void set_frame(const QRect& frame);
+
+  /**
+   * @brief Renders a different region than the context's tile on the calling thread while it exists
+   *
+   * Used to pull an input over the region its consumer needs from it (see Node::RegionOfInterest()), CurrentTile()
+   * returns the region until the scope ends. Scopes nest.
+   */
+  class RegionScope
+  {
+  public:
+    RegionScope(const QRect& region);
+
+    ~RegionScope();
+
+    RegionScope(const RegionScope& other) = delete;
+    RegionScope& operator=(const RegionScope& other) = delete;
+
+  private:
+    QRect region_;
+
+    const QRect* previous_;
+  };
+
+  /**
+   * @brief Whether footage may be shown at its closest keyframe rather than the exact frame (see RenderJob)
+   *
+   * Values evaluated in such a context are approximate, so they're never cached for exact frames. FALSE by default.
+   */
+  bool keyframes_only() const;
+  void set_keyframes_only(bool keyframes_only);
+
+  /**
+   * @brief Length of the block of audio being evaluated (see AudioProcessor), starting at time()
+   *
+   * 0 when evaluating video.
+   */
+  int sample_count() const;
+  int sample_rate() const;
+  void set_samples(int sample_count, int sample_rate);
+
+  /**
+   * @brief Token that becomes non-zero once the evaluation is no longer wanted (see RenderJob::cancel_token())
+   *
+   * Nodes doing lengthy work, such as decoding, should pass this to Decoder::set_cancel_token() or check it
+   * themselves so a stale frame is abandoned mid-render. May be nullptr.
+   */
+  const QAtomicInt* cancel_token() const;
+  void set_cancel_token(const QAtomicInt* token);
+
+  /**
+   * @brief Whether the evaluation has no OpenGL context and renders into MemoryBuffers instead (see olive::cpu)
+   *
+   * Nodes producing textures should return NodeValue::Buffer() values rather than textures in this case.
+   */
+  bool software() const;
+  void set_software(bool software);
+
+  /**
+   * @brief Whether nodes may render an approximation rather than wait for something slow (e.g. a shader compiling)
+   *
+   * FALSE by default. Frames that are only shown can be rendered again once everything's ready, exported frames can't.
+   */
+  bool provisional_allowed() const;
+  void set_provisional_allowed(bool allowed);
+
+  /**
+   * @brief Whether a node rendered an approximation during this evaluation (see MarkCurrentProvisional())
+   *
+   * Reset it before each evaluation. The result should then be rendered again rather than kept.
+   */
+  bool provisional() const;
+  void set_provisional(bool provisional);
+
+  /**
+   * @brief Version of the graph the evaluation reads input values and connections from (see NodeGraph::Snapshot())
+   *
+   * The caller keeps the snapshot alive for as long as it's set. nullptr reads each input's latest state.
+   */
+  const NodeGraphSnapshot* snapshot() const;
+  void set_snapshot(const NodeGraphSnapshot* snapshot);
+
+  /**
+   * @brief Returns the context current on the calling thread, or nullptr if there isn't one
+   */
+  static NodeEvaluationContext* Current();
+
+  /**
+   * @brief Make a context current on the calling thread (or nullptr for none)
+   */
+  static void SetCurrent(NodeEvaluationContext* context);
+
+  /**
+   * @brief Returns the key NodeOutput stores values for the calling thread's current evaluation under
+   */
+  static Qt::HANDLE CurrentId();
+
+  /**
+   * @brief Returns the current context's divider, or 1 if there's no current context
+   */
+  static int CurrentDivider();
+
+  /**
+   * @brief Returns the current context's tile, or a null rect if there's no current context
+   *
+   * Returns the region of the innermost RegionScope on this thread instead if there is one.
+   */
+  static QRect CurrentTile();
+
+  /**
+   * @brief Returns the current context's frame, or a null rect if there's no current context
+   */
+  static QRect CurrentFrame();
+
+  /**
+   * @brief Returns whether the current context only wants keyframes, or false if there's no current context
+   */
+  static bool CurrentKeyframesOnly();
+
+  /**
+   * @brief Returns the current context's audio block length, or 0 if there's no current context
+   */
+  static int CurrentSampleCount();
+
+  /**
+   * @brief Returns the current context's audio sample rate, or 0 if there's no current context
+   */
+  static int CurrentSampleRate();
+
+  /**
+   * @brief Returns the current context's cancel token, or nullptr if there's no current context
+   */
+  static const QAtomicInt* CurrentCancelToken();
+
+  /**
+   * @brief Returns whether the current context renders in software, or false if there's no current context
+   */
+  static bool CurrentIsSoftware();
+
+  /**
+   * @brief Returns whether the current context allows approximations, or false if there's no current context
+   */
+  static bool CurrentAllowsProvisional();
+
+  /**
+   * @brief Record that a node rendered an approximation in the current context (thread-safe)
+   */
+  static void MarkCurrentProvisional();
+
+  /**
+   * @brief Returns the current context's snapshot, or nullptr if there's no current context
+   */
+  static const NodeGraphSnapshot* CurrentSnapshot();
+
+private:
+  rational time_;
+
+  int divider_;
+
+  QRect tile_;
+
+  QRect frame_;
+
+  bool keyframes_only_;
+
+  int sample_count_;
+
+  int sample_rate_;
+
+  const QAtomicInt* cancel_token_;
+
+  bool software_;
+
+  bool provisional_allowed_;
+
+  // Nodes may be processed by workers for another thread's context (see NodeGraphPlan)
+  QAtomicInt provisional_;
+
+  const NodeGraphSnapshot* snapshot_;
+};
+
+#endif // NODEEVALUATIONCONTEXT_H
@@ -0,0 +1,1066 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "expression.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+#include "input.h"
+#include "node.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kE = 2.71828182845904523536;
+
+/**
+ * @brief How many param() references the current thread is evaluating through
+ */
+thread_local int reference_depth = 0;
+
+/**
+ * @brief Numeric value of a referenced input's value (booleans are 0 or 1)
+ */
+double ToNumber(const NodeValue& value)
+{
+  if (value.type() == NodeParam::kBoolean) {
+    return value.toBool() ? 1.0 : 0.0;
+  }
+
+  return value.toDouble();
+}
+
+/**
+ * @brief Results that aren't finite (e.g. dividing by zero) are returned as 0 so integer inputs can convert them
+ */
+double Finite(double value)
+{
+  return std::isfinite(value) ? value : 0.0;
+}
+
+bool IsNumeric(NodeInput* input)
+{
+  return input->inputs().contains(NodeParam::kInt)
+      || input->inputs().contains(NodeParam::kFloat)
+      || input->inputs().contains(NodeParam::kBoolean);
+}
+
+/**
+ * @brief Returns TRUE if `from` is `target` or reads it through its expression's references
+ */
+bool Reaches(NodeInput* from, NodeInput* target, int depth)
+{
+  if (from == target || depth > NodeExpression::kMaxReferenceDepth) {
+    return true;
+  }
+
+  NodeExpressionPtr expression = from->current_state()->expression;
+
+  if (expression != nullptr) {
+    foreach (NodeInput* reference, expression->references()) {
+      if (Reaches(reference, target, depth + 1)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+}
+
+/**
+ * @brief Recursive descent parser emitting NodeExpression bytecode
+ *
+ * Precedence from lowest to highest: ?:, ||, &&, comparisons, + -, * / %, unary - + !, ^ (right associative).
+ */
+class NodeExpression::Compiler
+{
+public:
+  Compiler(NodeExpression* expression, NodeInput* owner) :
+    expression_(expression),
+    owner_(owner),
+    pos_(0),
+    depth_(0)
+  {
+  }
+
+  bool Run(QString* error)
+  {
+    if (!Tokenize() || !ParseTernary()) {
+      *error = error_;
+      return false;
+    }
+
+    if (Peek().type != kEnd) {
+      Fail(tr("Unexpected \"%1\"").arg(Peek().text));
+      *error = error_;
+      return false;
+    }
+
+    if (expression_->stack_size_ > kMaxStack) {
+      *error = tr("Expression is too complex");
+      return false;
+    }
+
+    return true;
+  }
+
+private:
+  enum TokenType {
+    kEnd,
+    kNumber,
+    kIdentifier,
+    kString,
+    kSymbol
+  };
+
+  struct Token {
+    TokenType type;
+    QString text;
+    double number;
+    int position;
+  };
+
+  struct Function {
+    const char* name;
+    Op op;
+  };
+
+  static const Function kFunctions[];
+
+  bool Tokenize()
+  {
+    const QString& source = expression_->source_;
+    int i = 0;
+
+    while (i < source.size()) {
+      QChar c = source.at(i);
+
+      if (c.isSpace()) {
+        i++;
+        continue;
+      }
+
+      Token token;
+      token.position = i;
+      token.number = 0.0;
+
+      if (c.isDigit() || (c == '.' && i + 1 < source.size() && source.at(i + 1).isDigit())) {
+        int start = i;
+
+        while (i < source.size() && (source.at(i).isDigit() || source.at(i) == '.')) {
+          i++;
+        }
+
+        // Only treat an "e" as an exponent if digits follow, so "2e" isn't swallowed
+        if (i < source.size() && (source.at(i) == 'e' || source.at(i) == 'E')) {
+          int exponent = i + 1;
+
+          if (exponent < source.size() && (source.at(exponent) == '+' || source.at(exponent) == '-')) {
+            exponent++;
+          }
+
+          if (exponent < source.size() && source.at(exponent).isDigit()) {
+            i = exponent;
+
+            while (i < source.size() && source.at(i).isDigit()) {
+              i++;
+            }
+          }
+        }
+
+        bool ok;
+
+        token.type = kNumber;
+        token.text = source.mid(start, i - start);
+        token.number = token.text.toDouble(&ok);
+
+        if (!ok) {
+          return Fail(tr("Invalid number \"%1\"").arg(token.text), token.position);
+        }
+      } else if (c.isLetter() || c == '_') {
+        int start = i;
+
+        while (i < source.size() && (source.at(i).isLetterOrNumber() || source.at(i) == '_')) {
+          i++;
+        }
+
+        token.type = kIdentifier;
+        token.text = source.mid(start, i - start);
+      } else if (c == '"') {
+        int end = source.indexOf('"', i + 1);
+
+        if (end < 0) {
+          return Fail(tr("Unterminated string"), token.position);
+        }
+
+        token.type = kString;
+        token.text = source.mid(i + 1, end - i - 1);
+        i = end + 1;
+      } else {
+        static const char* two_char_symbols[] = {"<=", ">=", "==", "!=", "&&", "||"};
+
+        token.type = kSymbol;
+        token.text = c;
+
+        for (const char* symbol : two_char_symbols) {
+          if (source.mid(i, 2) == QLatin1String(symbol)) {
+            token.text = QLatin1String(symbol);
+            break;
+          }
+        }
+
+        if (token.text.size() == 1 && !QStringLiteral("+-*/%^()<>!?:,").contains(c)) {
+          return Fail(tr("Unexpected \"%1\"").arg(token.text), token.position);
+        }
+
+        i += token.text.size();
+      }
+
+      tokens_.append(token);
+    }
+
+    Token end;
+    end.type = kEnd;
+    end.number = 0.0;
+    end.position = source.size();
+    tokens_.append(end);
+
+    return true;
+  }
+
+  const Token& Peek() const
+  {
+    return tokens_.at(pos_);
+  }
+
+  /**
+   * @brief Consume the next token if it's this symbol
+   */
+  bool Accept(const char* symbol)
+  {
+    if (Peek().type == kSymbol && Peek().text == QLatin1String(symbol)) {
+      pos_++;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool Expect(const char* symbol)
+  {
+    if (Accept(symbol)) {
+      return true;
+    }
+
+    if (Peek().type == kEnd) {
+      return Fail(tr("Expected \"%1\" at end").arg(QString::fromLatin1(symbol)));
+    }
+
+    return Fail(tr("Expected \"%1\" but found \"%2\"")
+                .arg(QString::fromLatin1(symbol), Peek().text));
+  }
+
+  bool Fail(const QString& message, int position = -1)
+  {
+    if (position < 0) {
+      position = Peek().position;
+    }
+
+    error_ = tr("%1 (at character %2)").arg(message, QString::number(position + 1));
+    return false;
+  }
+
+  bool ParseTernary()
+  {
+    if (!ParseOr()) {
+      return false;
+    }
+
+    if (!Accept("?")) {
+      return true;
+    }
+
+    // Both branches are evaluated and selected between, expressions have no side effects so that's only a matter of
+    // cost and keeps the bytecode free of jumps
+    if (!ParseTernary() || !Expect(":") || !ParseTernary()) {
+      return false;
+    }
+
+    Emit(kSelect);
+    return true;
+  }
+
+  bool ParseOr()
+  {
+    if (!ParseAnd()) {
+      return false;
+    }
+
+    while (Accept("||")) {
+      if (!ParseAnd()) {
+        return false;
+      }
+
+      Emit(kOr);
+    }
+
+    return true;
+  }
+
+  bool ParseAnd()
+  {
+    if (!ParseComparison()) {
+      return false;
+    }
+
+    while (Accept("&&")) {
+      if (!ParseComparison()) {
+        return false;
+      }
+
+      Emit(kAnd);
+    }
+
+    return true;
+  }
+
+  bool ParseComparison()
+  {
+    if (!ParseAdditive()) {
+      return false;
+    }
+
+    while (true) {
+      Op op;
+
+      if (Accept("<=")) {
+        op = kLessEqual;
+      } else if (Accept(">=")) {
+        op = kGreaterEqual;
+      } else if (Accept("<")) {
+        op = kLess;
+      } else if (Accept(">")) {
+        op = kGreater;
+      } else if (Accept("==")) {
+        op = kEqual;
+      } else if (Accept("!=")) {
+        op = kNotEqual;
+      } else {
+        return true;
+      }
+
+      if (!ParseAdditive()) {
+        return false;
+      }
+
+      Emit(op);
+    }
+  }
+
+  bool ParseAdditive()
+  {
+    if (!ParseMultiplicative()) {
+      return false;
+    }
+
+    while (true) {
+      Op op;
+
+      if (Accept("+")) {
+        op = kAdd;
+      } else if (Accept("-")) {
+        op = kSubtract;
+      } else {
+        return true;
+      }
+
+      if (!ParseMultiplicative()) {
+        return false;
+      }
+
+      Emit(op);
+    }
+  }
+
+  bool ParseMultiplicative()
+  {
+    if (!ParseUnary()) {
+      return false;
+    }
+
+    while (true) {
+      Op op;
+
+      if (Accept("*")) {
+        op = kMultiply;
+      } else if (Accept("/")) {
+        op = kDivide;
+      } else if (Accept("%")) {
+        op = kModulo;
+      } else {
+        return true;
+      }
+
+      if (!ParseUnary()) {
+        return false;
+      }
+
+      Emit(op);
+    }
+  }
+
+  bool ParseUnary()
+  {
+    if (Accept("-")) {
+      if (!ParseUnary()) {
+        return false;
+      }
+
+      Emit(kNegate);
+      return true;
+    }
+
+    if (Accept("!")) {
+      if (!ParseUnary()) {
+        return false;
+      }
+
+      Emit(kNot);
+      return true;
+    }
+
+    if (Accept("+")) {
+      return ParseUnary();
+    }
+
+    return ParsePower();
+  }
+
+  bool ParsePower()
+  {
+    if (!ParsePrimary()) {
+      return false;
+    }
+
+    // Right associative and binding tighter than unary minus, so -2^2 is -4 and 2^-1 is 0.5
+    if (Accept("^")) {
+      if (!ParseUnary()) {
+        return false;
+      }
+
+      Emit(kPower);
+    }
+
+    return true;
+  }
+
+  bool ParsePrimary()
+  {
+    Token token = Peek();
+
+    if (token.type == kNumber) {
+      pos_++;
+      EmitConstant(token.number);
+      return true;
+    }
+
+    if (Accept("(")) {
+      return ParseTernary() && Expect(")");
+    }
+
+    if (token.type != kIdentifier) {
+      if (token.type == kEnd) {
+        return Fail(tr("Unexpected end of expression"));
+      }
+
+      return Fail(tr("Unexpected \"%1\"").arg(token.text));
+    }
+
+    pos_++;
+
+    if (Accept("(")) {
+      if (token.text == QStringLiteral("param")) {
+        return ParseReference();
+      }
+
+      return ParseCall(token);
+    }
+
+    if (token.text == QStringLiteral("time")) {
+      expression_->uses_time_ = true;
+      Emit(kTime);
+    } else if (token.text == QStringLiteral("value")) {
+      expression_->uses_value_ = true;
+      Emit(kValue);
+    } else if (token.text == QStringLiteral("pi")) {
+      EmitConstant(kPi);
+    } else if (token.text == QStringLiteral("e")) {
+      EmitConstant(kE);
+    } else {
+      return Fail(tr("Unknown name \"%1\"").arg(token.text), token.position);
+    }
+
+    return true;
+  }
+
+  bool ParseCall(const Token& name)
+  {
+    const Function* function = nullptr;
+
+    for (const Function* f = kFunctions; f->name != nullptr; f++) {
+      if (name.text == QLatin1String(f->name)) {
+        function = f;
+        break;
+      }
+    }
+
+    if (function == nullptr) {
+      return Fail(tr("Unknown function \"%1\"").arg(name.text), name.position);
+    }
+
+    int count = 0;
+
+    if (!Accept(")")) {
+      do {
+        if (!ParseTernary()) {
+          return false;
+        }
+
+        count++;
+      } while (Accept(","));
+
+      if (!Expect(")")) {
+        return false;
+      }
+    }
+
+    if (count != OperandCount(function->op)) {
+      return Fail(tr("%1() takes %n argument(s)", nullptr, OperandCount(function->op)).arg(name.text), name.position);
+    }
+
+    Emit(function->op);
+    return true;
+  }
+
+  bool ParseReference()
+  {
+    Token name = Peek();
+
+    if (name.type != kString) {
+      return Fail(tr("param() takes the name of an input in quotes"));
+    }
+
+    pos_++;
+
+    if (!Expect(")")) {
+      return false;
+    }
+
+    NodeInput* input = nullptr;
+    Node* node = owner_->parent();
+
+    for (int i=0;node != nullptr && i<node->ParameterCount();i++) {
+      NodeParam* param = node->ParamAt(i);
+
+      if (param->type() == NodeParam::kInput && param->name() == name.text) {
+        input = static_cast<NodeInput*>(param);
+        break;
+      }
+    }
+
+    if (input == nullptr) {
+      return Fail(tr("No input named \"%1\"").arg(name.text), name.position);
+    }
+
+    if (input == owner_) {
+      return Fail(tr("Use \"value\" to read the input's own value"), name.position);
+    }
+
+    if (!IsNumeric(input)) {
+      return Fail(tr("\"%1\" isn't a number").arg(name.text), name.position);
+    }
+
+    if (Reaches(input, owner_, 0)) {
+      return Fail(tr("\"%1\" depends on this input").arg(name.text), name.position);
+    }
+
+    int index = expression_->references_.indexOf(input);
+
+    if (index < 0) {
+      index = expression_->references_.size();
+      expression_->references_.append(input);
+    }
+
+    Emit(kParam, index);
+    return true;
+  }
+
+  void EmitConstant(double value)
+  {
+    expression_->constants_.append(value);
+
+    Push(kConstant, expression_->constants_.size() - 1);
+  }
+
+  /**
+   * @brief Add an instruction, or fold it into a constant if all its operands are constants
+   */
+  void Emit(Op op, int arg = 0)
+  {
+    QVector<Instruction>& code = expression_->code_;
+    int operands = OperandCount(op);
+
+    if (operands > 0 && code.size() >= operands) {
+      // Every instruction pushes exactly one value, so if the last few are constants they're the operands
+      double values[3];
+      bool constant = true;
+
+      for (int i=0;i<operands;i++) {
+        const Instruction& operand = code.at(code.size() - operands + i);
+
+        if (operand.op != kConstant) {
+          constant = false;
+          break;
+        }
+
+        values[i] = expression_->constants_.at(operand.arg);
+      }
+
+      if (constant) {
+        code.resize(code.size() - operands);
+        depth_ -= operands;
+
+        // The folded operands were the last constants added
+        expression_->constants_.resize(expression_->constants_.size() - operands);
+
+        EmitConstant(Apply(op, values));
+        return;
+      }
+    }
+
+    depth_ -= operands;
+    Push(op, arg);
+  }
+
+  void Push(Op op, int arg)
+  {
+    Instruction instruction;
+    instruction.op = op;
+    instruction.arg = arg;
+
+    expression_->code_.append(instruction);
+
+    depth_++;
+    expression_->stack_size_ = qMax(expression_->stack_size_, depth_);
+  }
+
+  NodeExpression* expression_;
+
+  NodeInput* owner_;
+
+  QVector<Token> tokens_;
+
+  int pos_;
+
+  /// Values on the stack after the instructions emitted so far
+  int depth_;
+
+  QString error_;
+};
+
+const NodeExpression::Compiler::Function NodeExpression::Compiler::kFunctions[] = {
+  {"sin", kSin},
+  {"cos", kCos},
+  {"tan", kTan},
+  {"asin", kAsin},
+  {"acos", kAcos},
+  {"atan", kAtan},
+  {"atan2", kAtan2},
+  {"abs", kAbs},
+  {"sign", kSign},
+  {"floor", kFloor},
+  {"ceil", kCeil},
+  {"round", kRound},
+  {"fract", kFract},
+  {"sqrt", kSqrt},
+  {"exp", kExp},
+  {"log", kLog},
+  {"pow", kPower},
+  {"min", kMin},
+  {"max", kMax},
+  {"clamp", kClamp},
+  {"mix", kMix},
+  {"lerp", kMix},
+  {"smoothstep", kSmoothstep},
+  {nullptr, kConstant}
+};
+
+NodeExpression::NodeExpression() :
+  stack_size_(0),
+  uses_time_(false),
+  uses_value_(false)
+{
+}
+
+NodeExpressionPtr NodeExpression::Compile(const QString &source, NodeInput *owner, QString *error)
+{
+  NodeExpression* expression = new NodeExpression();
+  expression->source_ = source;
+
+  QString message;
+
+  if (!Compiler(expression, owner).Run(&message)) {
+    delete expression;
+
+    if (error != nullptr) {
+      *error = message;
+    }
+
+    return nullptr;
+  }
+
+  return NodeExpressionPtr(expression);
+}
+
+const QString &NodeExpression::source() const
+{
+  return source_;
+}
+
+bool NodeExpression::uses_value() const
+{
+  return uses_value_;
+}
+
+const QVector<NodeInput *> &NodeExpression::references() const
+{
+  return references_;
+}
+
+bool NodeExpression::IsAnimated(bool value_animated) const
+{
+  if (uses_time_ || (uses_value_ && value_animated)) {
+    return true;
+  }
+
+  // A reference fed by another node may change at any time
+  foreach (NodeInput* reference, references_) {
+    if (reference->IsAnimated() || !reference->current_state()->outputs.isEmpty()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+double NodeExpression::Evaluate(const rational &time, double value) const
+{
+  if (reference_depth >= kMaxReferenceDepth) {
+    return 0.0;
+  }
+
+  double stack[kMaxStack];
+  int top = 0;
+
+  for (int i=0;i<code_.size();i++) {
+    const Instruction& instruction = code_.at(i);
+
+    switch (instruction.op) {
+    case kConstant:
+      stack[top++] = constants_.at(instruction.arg);
+      break;
+    case kTime:
+      stack[top++] = time.ToDouble();
+      break;
+    case kValue:
+      stack[top++] = value;
+      break;
+    case kParam:
+      reference_depth++;
+      stack[top++] = ToNumber(references_.at(instruction.arg)->get_value(time));
+      reference_depth--;
+      break;
+    default:
+      top -= OperandCount(instruction.op);
+      stack[top] = Apply(instruction.op, stack + top);
+      top++;
+      break;
+    }
+  }
+
+  return Finite(stack[0]);
+}
+
+void NodeExpression::EvaluateBatch(const QVector<rational> &times,
+                                   const QVector<double> &values,
+                                   double *results) const
+{
+  int count = times.size();
+
+  if (count == 0) {
+    return;
+  }
+
+  if (reference_depth >= kMaxReferenceDepth) {
+    std::fill(results, results + count, 0.0);
+    return;
+  }
+
+  // One row of `count` values per stack slot, each instruction runs over the whole row
+  QVector<double> stack(stack_size_ * count);
+  double* rows = stack.data();
+  int top = 0;
+
+  for (int i=0;i<code_.size();i++) {
+    const Instruction& instruction = code_.at(i);
+    double* row = rows + top * count;
+
+    switch (instruction.op) {
+    case kConstant:
+      std::fill(row, row + count, constants_.at(instruction.arg));
+      top++;
+      break;
+    case kTime:
+      for (int j=0;j<count;j++) {
+        row[j] = times.at(j).ToDouble();
+      }
+      top++;
+      break;
+    case kValue:
+      std::copy(values.constBegin(), values.constEnd(), row);
+      top++;
+      break;
+    case kParam:
+    {
+      reference_depth++;
+      QVector<NodeValue> referenced = references_.at(instruction.arg)->get_value_batch(times);
+      reference_depth--;
+
+      for (int j=0;j<count;j++) {
+        row[j] = ToNumber(referenced.at(j));
+      }
+      top++;
+      break;
+    }
+    case kAdd:
+    case kSubtract:
+    case kMultiply:
+    case kDivide:
+    {
+      // The most common operations get tight loops the compiler can vectorize
+      double* a = row - 2 * count;
+      const double* b = row - count;
+
+      if (instruction.op == kAdd) {
+        for (int j=0;j<count;j++) {
+          a[j] += b[j];
+        }
+      } else if (instruction.op == kSubtract) {
+        for (int j=0;j<count;j++) {
+          a[j] -= b[j];
+        }
+      } else if (instruction.op == kMultiply) {
+        for (int j=0;j<count;j++) {
+          a[j] *= b[j];
+        }
+      } else {
+        for (int j=0;j<count;j++) {
+          a[j] /= b[j];
+        }
+      }
+
+      top--;
+      break;
+    }
+    default:
+    {
+      int operands = OperandCount(instruction.op);
+      double* first = rows + (top - operands) * count;
+      double gathered[3];
+
+      for (int j=0;j<count;j++) {
+        for (int k=0;k<operands;k++) {
+          gathered[k] = first[k * count + j];
+        }
+
+        first[j] = Apply(instruction.op, gathered);
+      }
+
+      top -= operands - 1;
+      break;
+    }
+    }
+  }
+
+  for (int j=0;j<count;j++) {
+    results[j] = Finite(rows[j]);
+  }
+}
+
+int NodeExpression::OperandCount(NodeExpression::Op op)
+{
+  switch (op) {
+  case kConstant:
+  case kTime:
+  case kValue:
+  case kParam:
+    return 0;
+  case kNegate:
+  case kNot:
+  case kSin:
+  case kCos:
+  case kTan:
+  case kAsin:
+  case kAcos:
+  case kAtan:
+  case kAbs:
+  case kSign:
+  case kFloor:
+  case kCeil:
+  case kRound:
+  case kFract:
+  case kSqrt:
+  case kExp:
+  case kLog:
+    return 1;
+  case kAdd:
+  case kSubtract:
+  case kMultiply:
+  case kDivide:
+  case kModulo:
+  case kPower:
+  case kLess:
+  case kLessEqual:
+  case kGreater:
+  case kGreaterEqual:
+  case kEqual:
+  case kNotEqual:
+  case kAnd:
+  case kOr:
+  case kAtan2:
+  case kMin:
+  case kMax:
+    return 2;
+  case kClamp:
+  case kMix:
+  case kSmoothstep:
+  case kSelect:
+    return 3;
+  }
+
+  return 0;
+}
+
+double NodeExpression::Apply(NodeExpression::Op op, const double *operands)
+{
+  const double* a = operands;
+
+  switch (op) {
+  case kNegate:
+    return -a[0];
+  case kNot:
+    return (a[0] == 0.0) ? 1.0 : 0.0;
+  case kAdd:
+    return a[0] + a[1];
+  case kSubtract:
+    return a[0] - a[1];
+  case kMultiply:
+    return a[0] * a[1];
+  case kDivide:
+    return a[0] / a[1];
+  case kModulo:
+    return std::fmod(a[0], a[1]);
+  case kPower:
+    return std::pow(a[0], a[1]);
+  case kLess:
+    return (a[0] < a[1]) ? 1.0 : 0.0;
+  case kLessEqual:
+    return (a[0] <= a[1]) ? 1.0 : 0.0;
+  case kGreater:
+    return (a[0] > a[1]) ? 1.0 : 0.0;
+  case kGreaterEqual:
+    return (a[0] >= a[1]) ? 1.0 : 0.0;
+  case kEqual:
+    return (a[0] == a[1]) ? 1.0 : 0.0;
+  case kNotEqual:
+    return (a[0] != a[1]) ? 1.0 : 0.0;
+  case kAnd:
+    return (a[0] != 0.0 && a[1] != 0.0) ? 1.0 : 0.0;
+  case kOr:
+    return (a[0] != 0.0 || a[1] != 0.0) ? 1.0 : 0.0;
+  case kSin:
+    return std::sin(a[0]);
+  case kCos:
+    return std::cos(a[0]);
+  case kTan:
+    return std::tan(a[0]);
+  case kAsin:
+    return std::asin(a[0]);
+  case kAcos:
+    return std::acos(a[0]);
+  case kAtan:
+    return std::atan(a[0]);
+  case kAtan2:
+    return std::atan2(a[0], a[1]);
+  case kAbs:
+    return std::fabs(a[0]);
+  case kSign:
+    return (a[0] > 0.0) ? 1.0 : ((a[0] < 0.0) ? -1.0 : 0.0);
+  case kFloor:
+    return std::floor(a[0]);
+  case kCeil:
+    return std::ceil(a[0]);
+  case kRound:
+    return std::round(a[0]);
+  case kFract:
+    return a[0] - std::floor(a[0]);
+  case kSqrt:
+    return std::sqrt(a[0]);
+  case kExp:
+    return std::exp(a[0]);
+  case kLog:
+    return std::log(a[0]);
+  case kMin:
+    return std::min(a[0], a[1]);
+  case kMax:
+    return std::max(a[0], a[1]);
+  case kClamp:
+    return std::min(std::max(a[0], a[1]), a[2]);
+  case kMix:
+    return a[0] + (a[1] - a[0]) * a[2];
+  case kSmoothstep:
+  {
+    double t = std::min(std::max((a[2] - a[0]) / (a[1] - a[0]), 0.0), 1.0);
+    return t * t * (3.0 - 2.0 * t);
+  }
+  case kSelect:
+    return (a[0] != 0.0) ? a[1] : a[2];
+  case kConstant:
+  case kTime:
+  case kValue:
+  case kParam:
+    break;
+  }
+
+  return 0.0;
+}
@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "factory.h"
+
+#include "node/generator/solid/solid.h"
+#include "node/input/image/image.h"
+#include "node/input/sequence/sequenceinput.h"
+#include "node/output/viewer/viewer.h"
+#include "node/processor/composite/composite.h"
+#include "node/processor/gain/gain.h"
+#include "node/processor/shader/shadernode.h"
+#include "node/processor/transform/transform.h"
+
+#ifdef OLIVE_OFX
+#include "node/ofx/ofxnode.h"
+#endif
+
+namespace {
+
+template<typename T>
+Node* CreateNode()
+{
+  return new T();
+}
+
+using NodeCreator = Node* (*)();
+
+// Every Node that can be saved
+const NodeCreator kNodeCreators[] = {
+  CreateNode<SolidGenerator>,
+  CreateNode<ImageInput>,
+  CreateNode<SequenceInput>,
+  CreateNode<CompositeNode>,
+  CreateNode<TransformNode>,
+  CreateNode<GainNode>,
+  CreateNode<ViewerOutput>
+};
+
+}
+
+Node *NodeFactory::CreateFromID(const QString &id)
+{
+  // IDs are only available from instances, so create each Node until one matches
+  foreach (NodeCreator creator, kNodeCreators) {
+    Node* n = creator();
+
+    if (n->id() == id) {
+      return n;
+    }
+
+    delete n;
+  }
+
+  // Likewise for user shaders
+  Node* shader = ShaderNode::CreateFromID(id);
+
+  if (shader != nullptr) {
+    return shader;
+  }
+
+#ifdef OLIVE_OFX
+  // Plugins are only known once they're loaded, so they have an ID each rather than a creator
+  return OfxNode::CreateFromID(id);
+#else
+  return nullptr;
+#endif
+}
@@ -18,33 +18,27 @@
 
 ***/
 
-#ifndef TASKTHREAD_H
-#define TASKTHREAD_H
+#ifndef NODEFACTORY_H
+#define NODEFACTORY_H
 
-#include <QThread>
-
-class Task;
+#include "node/node.h"
 
 /**
- * @brief An internal class only used by Task.
+ * @brief Creates Nodes from their Node::id()
  *
- * TaskThread is a simple QThread subclass designed to create a thread and run the
- * Task's Action() function. It also stores the result of Action() which can be read using result() when the thread
- * signals that it has finished().
+ * Used to recreate the nodes of a saved graph. Every Node that can be saved must be listed in CreateFromID().
  */
-class TaskThread : public QThread
+class NodeFactory
 {
 public:
-  TaskThread(Task* parent);
-
-  virtual void run() override;
-
-  bool result();
-
-private:
-  Task* parent_;
-
-  bool result_;
+  /**
+   * @brief Create a new instance of the Node with this ID
+   *
+   * @return
+   *
+   * The new Node (owned by the caller) or nullptr if no Node has this ID.
+   */
+  static Node* CreateFromID(const QString& id);
 };
 
-#endif // TASKTHREAD_H
+#endif // NODEFACTORY_H
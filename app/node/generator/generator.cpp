@@ -0,0 +1,199 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "generator.h"
+
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+
+// Name of the subclass's function in the generated shader
+const char* kGeneratorFunctionName = "generator";
+
+GeneratorNode::GeneratorNode() :
+  generation_(0)
+{
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+}
+
+GeneratorNode::~GeneratorNode()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(generated_);
+  qDeleteAll(software_buffers_);
+}
+
+NodeOutput *GeneratorNode::texture_output()
+{
+  return texture_output_;
+}
+
+bool GeneratorNode::GenerateSoftware(const rational &time, MemoryBuffer *buffer)
+{
+  Q_UNUSED(time)
+  Q_UNUSED(buffer)
+
+  return false;
+}
+
+void GeneratorNode::InvalidateCache(const rational &start_range, const rational &end_range)
+{
+  generation_.ref();
+
+  Node::InvalidateCache(start_range, end_range);
+}
+
+void GeneratorNode::Process(const rational &time)
+{
+  // Generate at the size of the tile being rendered (render jobs always have one, covering the whole frame if the
+  // frame isn't tiled)
+  QRect tile = NodeEvaluationContext::CurrentTile();
+
+  int width = qMax(1, tile.width());
+  int height = qMax(1, tile.height());
+
+  if (NodeEvaluationContext::CurrentIsSoftware()) {
+    MemoryBuffer* buffer;
+
+    {
+      QMutexLocker locker(&generated_mutex_);
+
+      buffer = software_buffers_.value(NodeEvaluationContext::CurrentId());
+
+      if (buffer == nullptr) {
+        buffer = new MemoryBuffer();
+        software_buffers_.insert(NodeEvaluationContext::CurrentId(), buffer);
+      }
+    }
+
+    buffer->Create(width, height, olive::PIX_FMT_RGBA32F);
+
+    if (GenerateSoftware(time, buffer)) {
+      texture_output_->set_value(NodeValue::Buffer(buffer));
+    } else {
+      texture_output_->set_value(NodeValue::Texture(0));
+    }
+
+    return;
+  }
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  Generated* generated = GetGenerated(ctx);
+  TextureBuffer* buffer = &generated->buffer;
+
+  int generation = generation_.load();
+
+  if (!buffer->IsCreated() || buffer->width() != width || buffer->height() != height) {
+    buffer->Create(ctx, olive::color::kWorkingFormat, width, height);
+
+    generated->generation = -1;
+  }
+
+  // Only draw again if something has changed since the last time
+  if (generated->generation != generation || (generated->time != time && HasAnimatedInputs())) {
+    // Output nothing while a new shader compiles if this frame can be rendered again once it's ready
+    bool pending = false;
+
+    ShaderPtr pipeline = olive::gl::GetGeneratorPipeline(kGeneratorFunctionName,
+                                                         ShaderFunction(kGeneratorFunctionName),
+                                                         NodeEvaluationContext::CurrentAllowsProvisional() ? &pending
+                                                                                                          : nullptr);
+
+    if (pending) {
+      NodeEvaluationContext::MarkCurrentProvisional();
+    }
+
+    if (pipeline == nullptr) {
+      texture_output_->set_value(NodeValue::Texture(0));
+      return;
+    }
+
+    pipeline->bind();
+    SetUniforms(pipeline.get(), kGeneratorFunctionName, time);
+    pipeline->release();
+
+    QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+    buffer->BindBuffer();
+
+    xf->glViewport(0, 0, width, height);
+
+    olive::gl::Blit(pipeline);
+
+    buffer->ReleaseBuffer();
+
+    generated->generation = generation;
+    generated->time = time;
+  }
+
+  texture_output_->set_value(NodeValue::Texture(buffer->texture()));
+}
+
+GeneratorNode::Generated *GeneratorNode::GetGenerated(QOpenGLContext *ctx)
+{
+  QMutexLocker locker(&generated_mutex_);
+
+  Generated* generated = generated_.value(ctx);
+
+  if (generated == nullptr) {
+    generated = new Generated();
+    generated->generation = -1;
+
+    generated_.insert(ctx, generated);
+
+    // Free the buffer with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      generated_mutex_.lock();
+      Generated* g = generated_.take(ctx);
+      generated_mutex_.unlock();
+
+      delete g;
+    }, Qt::DirectConnection);
+  }
+
+  return generated;
+}
+
+bool GeneratorNode::HasAnimatedInputs()
+{
+  foreach (NodeParam* param, parameters()) {
+    if (param->type() == NodeParam::kInput) {
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      // Connected inputs may change with time however they're set up
+      if (!input->edges().isEmpty() || input->IsAnimated()) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,117 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef GENERATORNODE_H
+#define GENERATORNODE_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+
+#include "node/node.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A base class for nodes that generate an image procedurally rather than from a file or texture
+ *
+ * Subclasses provide a GLSL function computing each pixel, which is drawn straight into a buffer the size of the tile
+ * being rendered, so generators work at any resolution with nothing to upload. A context's buffer is only drawn again
+ * when its size changes, the node's inputs change (see InvalidateCache()), or one of them is animated, so a static
+ * generator costs nothing after its first frame.
+ */
+class GeneratorNode : public Node
+{
+  Q_OBJECT
+public:
+  GeneratorNode();
+
+  virtual ~GeneratorNode() override;
+
+  NodeOutput* texture_output();
+
+  /**
+   * @brief Return GLSL code defining `vec4 function_name(vec2 coord)`
+   *
+   * The function receives a normalized coordinate (0.0-1.0 across the tile) and returns the pixel's color with
+   * associated alpha. Any uniforms it declares must start with function_name.
+   */
+  virtual QString ShaderFunction(const QString& function_name) = 0;
+
+  /**
+   * @brief Set the uniforms used by ShaderFunction() for a time
+   *
+   * The program is bound while this is called.
+   */
+  virtual void SetUniforms(QOpenGLShaderProgram* program, const QString& function_name, const rational& time) = 0;
+
+  /**
+   * @brief Generate into an RGBA32F buffer for rendering without a GPU (see NodeEvaluationContext::software())
+   *
+   * The buffer has already been created at the tile's size. Returns false by default, meaning the generator can't be
+   * rendered in software and produces nothing.
+   */
+  virtual bool GenerateSoftware(const rational& time, MemoryBuffer* buffer);
+
+  virtual void InvalidateCache(const rational& start_range, const rational& end_range) override;
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief A buffer and what was last generated into it
+   */
+  struct Generated {
+    TextureBuffer buffer;
+
+    // Value of generation_ when the buffer was drawn, or -1 if it hasn't been
+    int generation;
+
+    rational time;
+  };
+
+  /**
+   * @brief Returns this node's buffer for the current context, creating it if necessary
+   */
+  Generated* GetGenerated(QOpenGLContext* ctx);
+
+  /**
+   * @brief Returns TRUE if any of this node's inputs is animated
+   */
+  bool HasAnimatedInputs();
+
+  NodeOutput* texture_output_;
+
+  // Incremented every time the node's inputs change
+  QAtomicInt generation_;
+
+  // Last buffer generated in each context this node has rendered in
+  QHash<QOpenGLContext*, Generated*> generated_;
+
+  // Output for each evaluation rendering in software
+  QHash<Qt::HANDLE, MemoryBuffer*> software_buffers_;
+
+  QMutex generated_mutex_;
+};
+
+#endif // GENERATORNODE_H
@@ -1,15 +1,16 @@
 #include "solid.h"
 
-SolidGenerator::SolidGenerator() :
-  texture_(nullptr)
+#include "render/cpurender.h"
+
+SolidGenerator::SolidGenerator()
 {
+  NodeKeyframe red;
+  red.set_value(NodeValue(QColor(Qt::red)));
+
   color_input_ = new NodeInput();
   color_input_->add_data_input(NodeParam::kColor);
+  color_input_->insert_keyframe(red);
   AddParameter(color_input_);
-
-  texture_output_ = new NodeOutput();
-  texture_output_->set_data_type(NodeOutput::kTexture);
-  AddParameter(texture_output_);
 }
 
 QString SolidGenerator::Name()
@@ -32,23 +33,51 @@ QString SolidGenerator::Description()
   return tr("Generate a solid color.");
 }
 
-NodeOutput *SolidGenerator::texture_output()
+olive::PixelPrecision SolidGenerator::OutputPrecision()
+{
+  // A flat color has no gradients to band
+  return olive::PIXEL_PRECISION_8BIT;
+}
+
+olive::PixelChannels SolidGenerator::OutputChannels()
+{
+  return olive::PIXEL_CHANNELS_RGB;
+}
+
+NodeInput *SolidGenerator::color_input()
 {
-  return texture_output_;
+  return color_input_;
 }
 
-void SolidGenerator::Process(const rational &time)
+QString SolidGenerator::ShaderFunction(const QString &function_name)
 {
-  // FIXME: Test code
-  Q_UNUSED(time)
+  return QString("uniform vec4 %1_color;\n"
+                 "\n"
+                 "vec4 %1(vec2 coord) {\n"
+                 "  return %1_color;\n"
+                 "}\n").arg(function_name);
+}
 
-  if (texture_ == nullptr) {
-    QImage img(1920, 1080, QImage::Format_RGBA8888_Premultiplied);
-    img.fill(Qt::red);
+void SolidGenerator::SetUniforms(QOpenGLShaderProgram *program, const QString &function_name, const rational &time)
+{
+  program->setUniformValue(QString("%1_color").arg(function_name).toUtf8().constData(), GetColor(time));
+}
+
+bool SolidGenerator::GenerateSoftware(const rational &time, MemoryBuffer *buffer)
+{
+  olive::cpu::Fill(buffer, GetColor(time));
+
+  return true;
+}
+
+QVector4D SolidGenerator::GetColor(const rational &time)
+{
+  QColor color = color_input_->get_value(time).toColor();
 
-    texture_ = new QOpenGLTexture(img);
-  }
+  float alpha = static_cast<float>(color.alphaF());
 
-  texture_output_->set_value(texture_->textureId());
-  // End test code
+  return QVector4D(static_cast<float>(color.redF()) * alpha,
+                   static_cast<float>(color.greenF()) * alpha,
+                   static_cast<float>(color.blueF()) * alpha,
+                   alpha);
 }
@@ -1,14 +1,14 @@
 #ifndef SOLIDGENERATOR_H
 #define SOLIDGENERATOR_H
 
-#include <QOpenGLTexture>
+#include <QVector4D>
 
-#include "node/node.h"
+#include "node/generator/generator.h"
 
 /**
  * @brief A node that generates a solid color
  */
-class SolidGenerator : public Node
+class SolidGenerator : public GeneratorNode
 {
   Q_OBJECT
 public:
@@ -19,17 +19,24 @@ public:
   virtual QString Category() override;
   virtual QString Description() override;
 
-  NodeOutput* texture_output();
+  virtual olive::PixelPrecision OutputPrecision() override;
+  virtual olive::PixelChannels OutputChannels() override;
 
-public slots:
-  virtual void Process(const rational &time) override;
+  NodeInput* color_input();
 
-private:
-  NodeInput* color_input_;
+  virtual QString ShaderFunction(const QString& function_name) override;
+
+  virtual void SetUniforms(QOpenGLShaderProgram* program, const QString& function_name, const rational& time) override;
 
-  NodeOutput* texture_output_;
+  virtual bool GenerateSoftware(const rational& time, MemoryBuffer* buffer) override;
 
-  QOpenGLTexture* texture_;
+private:
+  /**
+   * @brief Returns the color at a time with associated alpha
+   */
+  QVector4D GetColor(const rational& time);
+
+  NodeInput* color_input_;
 };
 
 #endif // SOLIDGENERATOR_H
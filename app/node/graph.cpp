@@ -22,9 +22,13 @@
 
 #include "common/qobjectlistcast.h"
 
-NodeGraph::NodeGraph()
+NodeGraph::NodeGraph() :
+  snapshot_(std::make_shared<NodeGraphSnapshot>(0, QHash<NodeInput*, NodeInputStatePtr>())),
+  snapshot_dirty_(0)
 {
-
+  connect(this, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(ClearPlans()));
+  connect(this, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(ClearPlans()));
+  connect(this, SIGNAL(EdgesChanged(QVector<NodeEdgePtr>, QVector<NodeEdgePtr>)), this, SLOT(ClearPlans()));
 }
 
 void NodeGraph::AddNode(Node *node)
@@ -33,6 +37,16 @@ void NodeGraph::AddNode(Node *node)
 
   connect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   connect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
+
+  // The node may have been connected before it was added
+  ClearPlans();
+
+  // Its inputs' states were published before they belonged to this graph
+  foreach (NodeParam* param, node->parameters()) {
+    if (param->type() == NodeParam::kInput) {
+      InputChanged(static_cast<NodeInput*>(param));
+    }
+  }
 }
 
 const QString &NodeGraph::name()
@@ -49,3 +63,80 @@ QList<Node *> NodeGraph::nodes()
 {
   return static_qobjectlist_cast<Node>(children());
 }
+
+NodeGraphPlanPtr NodeGraph::GetPlan(NodeOutput *output)
+{
+  QMutexLocker locker(&plans_mutex_);
+
+  QHash<NodeOutput*, NodeGraphPlanPtr>::const_iterator i = plans_.constFind(output);
+
+  if (i != plans_.constEnd()) {
+    return i.value();
+  }
+
+  NodeGraphPlanPtr plan = NodeGraphPlan::Compile(output);
+
+  plans_.insert(output, plan);
+
+  return plan;
+}
+
+NodeGraphSnapshotPtr NodeGraph::Snapshot()
+{
+  if (snapshot_dirty_.load() == 0) {
+    return std::atomic_load(&snapshot_);
+  }
+
+  QMutexLocker locker(&snapshot_mutex_);
+
+  NodeGraphSnapshotPtr current = std::atomic_load(&snapshot_);
+
+  if (pending_states_.isEmpty()) {
+    return current;
+  }
+
+  // Copy the previous version's table (implicitly shared) and only replace the inputs that changed
+  QHash<NodeInput*, NodeInputStatePtr> states = current->states();
+
+  for (QHash<NodeInput*, NodeInputStatePtr>::const_iterator i=pending_states_.constBegin();
+       i!=pending_states_.constEnd();
+       i++) {
+    if (i.value() == nullptr) {
+      states.remove(i.key());
+    } else {
+      states.insert(i.key(), i.value());
+    }
+  }
+
+  pending_states_.clear();
+  snapshot_dirty_ = 0;
+
+  NodeGraphSnapshotPtr next = std::make_shared<NodeGraphSnapshot>(current->version() + 1, states);
+
+  std::atomic_store(&snapshot_, next);
+
+  return next;
+}
+
+void NodeGraph::InputChanged(NodeInput *input)
+{
+  QMutexLocker locker(&snapshot_mutex_);
+
+  pending_states_.insert(input, input->current_state());
+  snapshot_dirty_ = 1;
+}
+
+void NodeGraph::InputRemoved(NodeInput *input)
+{
+  QMutexLocker locker(&snapshot_mutex_);
+
+  pending_states_.insert(input, nullptr);
+  snapshot_dirty_ = 1;
+}
+
+void NodeGraph::ClearPlans()
+{
+  QMutexLocker locker(&plans_mutex_);
+
+  plans_.clear();
+}
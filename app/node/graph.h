@@ -21,8 +21,13 @@
 #ifndef NODEGRAPH_H
 #define NODEGRAPH_H
 
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 
+#include "node/graphplan.h"
+#include "node/graphsnapshot.h"
 #include "node/node.h"
 
 /**
@@ -60,6 +65,35 @@ public:
    */
   QList<Node*> nodes();
 
+  /**
+   * @brief Return the execution plan for an output of a member node
+   *
+   * Plans are compiled the first time they're requested and kept until the graph's connections change. Thread-safe.
+   *
+   * @return
+   *
+   * The plan, or nullptr if the output depends on itself.
+   */
+  NodeGraphPlanPtr GetPlan(NodeOutput* output);
+
+  /**
+   * @brief Return the latest version of every input's state in this graph
+   *
+   * Render with the returned snapshot set on the evaluation context to read a consistent version of the graph while
+   * it's being edited. Thread-safe, and lock-free unless an edit was published since the last call.
+   */
+  NodeGraphSnapshotPtr Snapshot();
+
+  /**
+   * @brief Called by NodeInput when it publishes a new state, so the next Snapshot() includes it
+   */
+  void InputChanged(NodeInput* input);
+
+  /**
+   * @brief Called by NodeInput when it's destroyed, so the next Snapshot() forgets it
+   */
+  void InputRemoved(NodeInput* input);
+
 signals:
   /**
    * @brief Signal emitted when a member node of this graph has been connected to another (creating an "edge")
@@ -71,8 +105,38 @@ signals:
    */
   void EdgeRemoved(NodeEdgePtr edge);
 
+  /**
+   * @brief Signal emitted once for a whole batch of connection changes (see NodeParam::BeginEdgeBatch())
+   *
+   * Edges made during the batch are in `added` and edges broken during it are in `removed`. EdgeAdded() and
+   * EdgeRemoved() are not emitted for edges reported here.
+   */
+  void EdgesChanged(const QVector<NodeEdgePtr>& added, const QVector<NodeEdgePtr>& removed);
+
 private:
   QString name_;
+
+  // Compiled plans keyed by target output
+  QHash<NodeOutput*, NodeGraphPlanPtr> plans_;
+
+  QMutex plans_mutex_;
+
+  // Latest snapshot, only accessed with std::atomic_load() and std::atomic_store()
+  NodeGraphSnapshotPtr snapshot_;
+
+  // States published since snapshot_ was made (nullptr for inputs that were destroyed)
+  QHash<NodeInput*, NodeInputStatePtr> pending_states_;
+
+  // Non-zero while pending_states_ isn't empty, so Snapshot() only locks when there's something to apply
+  QAtomicInt snapshot_dirty_;
+
+  QMutex snapshot_mutex_;
+
+private slots:
+  /**
+   * @brief Discard all compiled plans
+   */
+  void ClearPlans();
 };
 
 #endif // NODEGRAPH_H
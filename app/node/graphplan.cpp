@@ -0,0 +1,594 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "graphplan.h"
+
+#include <algorithm>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "node/node.h"
+#include "node/evaluationcontext.h"
+#include "node/graphsnapshot.h"
+
+/**
+ * @brief Processes a branch of a plan on a worker thread, on behalf of the thread running the plan
+ */
+class NodeGraphPlan::BranchRunnable : public QRunnable
+{
+public:
+  BranchRunnable(const NodeGraphPlan* plan,
+                 const QVector<int>* steps,
+                 const rational& time,
+                 int* remaining,
+                 QSemaphore* done,
+                 NodeEvaluationContext* context,
+                 const QVector<Region>* regions) :
+    plan_(plan),
+    steps_(steps),
+    time_(time),
+    remaining_(remaining),
+    done_(done),
+    context_(context),
+    regions_(regions)
+  {
+  }
+
+  virtual void run() override
+  {
+    // Evaluate in the planning thread's context so values end up where its nodes will look for them
+    NodeEvaluationContext::SetCurrent(context_);
+
+    foreach (int step, *steps_) {
+      plan_->RunStep(step, time_, remaining_, regions_->at(step));
+    }
+
+    NodeEvaluationContext::SetCurrent(nullptr);
+
+    done_->release();
+  }
+
+private:
+  const NodeGraphPlan* plan_;
+
+  // Steps of the branch in use
+  const QVector<int>* steps_;
+
+  rational time_;
+
+  int* remaining_;
+
+  QSemaphore* done_;
+
+  NodeEvaluationContext* context_;
+
+  const QVector<Region>* regions_;
+};
+
+NodeGraphPlan::NodeGraphPlan() :
+  version_input_(nullptr)
+{
+}
+
+NodeGraphPlanPtr NodeGraphPlan::Compile(NodeOutput *target)
+{
+  // Constructor is private so std::make_shared can't be used
+  NodeGraphPlanPtr plan(new NodeGraphPlan());
+
+  QVector<NodeOutput*> visiting;
+
+  if (plan->AddStep(target, visiting) < 0) {
+    return nullptr;
+  }
+
+  plan->FuseSteps();
+  plan->FindBranches();
+
+  for (int i=0;i<plan->steps_.size() && plan->version_input_ == nullptr;i++) {
+    foreach (NodeParam* param, plan->steps_.at(i).output->parent()->parameters()) {
+      if (param->type() == NodeParam::kInput) {
+        plan->version_input_ = static_cast<NodeInput*>(param);
+        break;
+      }
+    }
+  }
+
+  return plan;
+}
+
+NodeOutput *NodeGraphPlan::target()
+{
+  return steps_.last().output;
+}
+
+NodeValue NodeGraphPlan::Run(const rational &time)
+{
+  ActiveSetPtr active = GetActiveSet(time);
+
+  // Consumers in use of each step that haven't been processed yet
+  QVector<int> remaining_counts = active->consumers;
+
+  // Branches only touch the counts of their own steps, so workers can share the array without locking
+  int* remaining = remaining_counts.data();
+
+  // Released by each branch's worker once it's done
+  std::unique_ptr<QSemaphore[]> branch_done;
+  QVector<bool> launched(branches_.size(), false);
+
+  if (!branches_.isEmpty()) {
+    branch_done.reset(new QSemaphore[static_cast<size_t>(branches_.size())]);
+  }
+
+  QVector<Region> regions = PlanRegions(*active, time, NodeEvaluationContext::CurrentTile());
+
+  // Workers need a context to evaluate in, so threads without one get one for the duration of the plan
+  NodeEvaluationContext* context = NodeEvaluationContext::Current();
+  NodeEvaluationContext local_context;
+
+  if (context == nullptr && !branches_.isEmpty()) {
+    context = &local_context;
+    context->set_time(time);
+
+    NodeEvaluationContext::SetCurrent(context);
+  }
+
+  NodeValue value;
+
+  foreach (int i, active->steps) {
+    const Step& step = steps_.at(i);
+
+    if (step.branch >= 0) {
+      // Hand the whole branch to a worker the first time one of its steps comes up
+      if (!launched.at(step.branch)) {
+        launched[step.branch] = true;
+
+        QThreadPool::globalInstance()->start(new BranchRunnable(this,
+                                                                &active->branch_steps.at(step.branch),
+                                                                time,
+                                                                remaining,
+                                                                &branch_done[step.branch],
+                                                                context,
+                                                                &regions));
+      }
+
+      continue;
+    }
+
+    // Wait for branches feeding this step
+    foreach (int j, step.joins) {
+      if (launched.at(j)) {
+        branch_done[j].acquire();
+      }
+    }
+
+    if (step.fused) {
+      continue;
+    }
+
+    value = RunStep(i, time, remaining, regions.at(i));
+  }
+
+  if (context == &local_context) {
+    // Values processed in the temporary context can't be found again once it's gone
+    foreach (int i, active->steps) {
+      steps_.at(i).output->ReleaseValue(true);
+    }
+
+    NodeEvaluationContext::SetCurrent(nullptr);
+  }
+
+  return value;
+}
+
+int NodeGraphPlan::StepCount()
+{
+  return steps_.size();
+}
+
+int NodeGraphPlan::AddStep(NodeOutput *output, QVector<NodeOutput *> &visiting)
+{
+  for (int i=0;i<steps_.size();i++) {
+    if (steps_.at(i).output == output) {
+      return i;
+    }
+  }
+
+  // Reaching an output that's still being added means there's a cycle
+  if (visiting.contains(output)) {
+    return -1;
+  }
+
+  visiting.append(output);
+
+  QVector<int> dependencies;
+
+  QList<NodeParam*> params = output->parent()->parameters();
+
+  foreach (NodeParam* param, params) {
+    if (param->type() != NodeParam::kInput) {
+      continue;
+    }
+
+    foreach (NodeEdgePtr edge, param->edges()) {
+      int dep = AddStep(edge->output(), visiting);
+
+      if (dep < 0) {
+        return -1;
+      }
+
+      if (!dependencies.contains(dep)) {
+        dependencies.append(dep);
+      }
+    }
+  }
+
+  visiting.removeLast();
+
+  foreach (int dep, dependencies) {
+    steps_[dep].consumers++;
+  }
+
+  Step step;
+  step.output = output;
+  step.dependencies = dependencies;
+  step.consumers = 0;
+  step.fused = false;
+  step.branch = -1;
+
+  steps_.append(step);
+
+  step_indices_.insert(output, steps_.size() - 1);
+
+  return steps_.size() - 1;
+}
+
+void NodeGraphPlan::FuseSteps()
+{
+  int last = steps_.size() - 1;
+
+  // Steps are in dependency order, so a chain of fused steps collapses one link at a time into its final consumer
+  for (int i=0;i<last;i++) {
+    Step& step = steps_[i];
+
+    if (step.consumers != 1 || step.output->edges().size() != 1) {
+      continue;
+    }
+
+    NodeInput* input = step.output->edges().first()->input();
+
+    if (!input->parent()->FusesInput(input)) {
+      continue;
+    }
+
+    // Find the consumer and give it this step's dependencies, whose values it'll pull while processing this one
+    for (int j=i+1;j<steps_.size();j++) {
+      Step& consumer = steps_[j];
+
+      if (!consumer.dependencies.contains(i)) {
+        continue;
+      }
+
+      consumer.dependencies.removeAll(i);
+
+      foreach (int dep, step.dependencies) {
+        if (consumer.dependencies.contains(dep)) {
+          // Now only counted once, through the consumer
+          steps_[dep].consumers--;
+        } else {
+          consumer.dependencies.append(dep);
+        }
+      }
+
+      break;
+    }
+
+    step.dependencies.clear();
+    step.consumers = 0;
+    step.fused = true;
+  }
+}
+
+void NodeGraphPlan::FindBranches()
+{
+  // Consumers of each step
+  QVector< QVector<int> > consumers(steps_.size());
+
+  for (int i=0;i<steps_.size();i++) {
+    foreach (int dep, steps_.at(i).dependencies) {
+      consumers[dep].append(i);
+    }
+  }
+
+  // Work downstream first so the largest branches are claimed before the branches nested inside them
+  for (int join=steps_.size()-1;join>=0;join--) {
+    const Step& join_step = steps_.at(join);
+
+    if (join_step.branch >= 0 || join_step.dependencies.size() < 2) {
+      continue;
+    }
+
+    foreach (int root, join_step.dependencies) {
+      // Collect everything the branch depends on
+      QVector<int> branch_steps;
+      QVector<int> stack;
+      stack.append(root);
+
+      while (!stack.isEmpty()) {
+        int s = stack.takeLast();
+
+        if (!branch_steps.contains(s)) {
+          branch_steps.append(s);
+          stack += steps_.at(s).dependencies;
+        }
+      }
+
+      // Every step must run on the CPU and only be needed inside the branch (or by the join)
+      bool independent = true;
+
+      for (int i=0;i<branch_steps.size() && independent;i++) {
+        const Step& s = steps_.at(branch_steps.at(i));
+
+        if (s.branch >= 0 || s.fused || !s.output->parent()->RunsOnCPU()) {
+          independent = false;
+          break;
+        }
+
+        foreach (int consumer, consumers.at(branch_steps.at(i))) {
+          if (consumer != join && !branch_steps.contains(consumer)) {
+            independent = false;
+            break;
+          }
+        }
+      }
+
+      if (!independent) {
+        continue;
+      }
+
+      std::sort(branch_steps.begin(), branch_steps.end());
+
+      Branch branch;
+      branch.steps = branch_steps;
+      branch.join = join;
+
+      foreach (int s, branch_steps) {
+        steps_[s].branch = branches_.size();
+      }
+
+      steps_[join].joins.append(branches_.size());
+
+      branches_.append(branch);
+    }
+  }
+}
+
+NodeGraphPlan::ActiveSetPtr NodeGraphPlan::GetActiveSet(const rational &time)
+{
+  const NodeGraphSnapshot* snapshot = NodeEvaluationContext::CurrentSnapshot();
+
+  // Without a snapshot of this plan's graph, nothing says whether the graph changed since a set was found
+  if (snapshot == nullptr || version_input_ == nullptr || snapshot->state(version_input_) == nullptr) {
+    return FindActiveSet(time, 0);
+  }
+
+  quint64 version = snapshot->version();
+  TimeRange instant(time, time);
+
+  {
+    QMutexLocker locker(&active_sets_mutex_);
+
+    for (int i=0;i<active_sets_.size();i++) {
+      ActiveSetPtr set = active_sets_.at(i);
+
+      if (set->version == version && set->range.Contains(instant)) {
+        active_sets_.move(i, 0);
+
+        return set;
+      }
+    }
+  }
+
+  // Found without the lock, so threads rendering other times aren't held up
+  ActiveSetPtr set = FindActiveSet(time, version);
+
+  QMutexLocker locker(&active_sets_mutex_);
+
+  // Sets found with older versions are only still useful to renders that are about to finish
+  for (int i=active_sets_.size()-1;i>=0;i--) {
+    if (active_sets_.at(i)->version < version) {
+      active_sets_.removeAt(i);
+    }
+  }
+
+  active_sets_.prepend(set);
+
+  while (active_sets_.size() > kMaxActiveSets) {
+    active_sets_.removeLast();
+  }
+
+  return set;
+}
+
+NodeGraphPlan::ActiveSetPtr NodeGraphPlan::FindActiveSet(const rational &time, quint64 version) const
+{
+  std::shared_ptr<ActiveSet> set = std::make_shared<ActiveSet>();
+
+  set->range = TimeRange::All();
+  set->version = version;
+
+  QVector<bool> reached(steps_.size(), false);
+  QVector<int> stack;
+
+  int last = steps_.size() - 1;
+
+  reached[last] = true;
+  stack.append(last);
+
+  // Connections that aren't in use aren't followed, so nothing only they lead to is visited
+  while (!stack.isEmpty()) {
+    int index = stack.takeLast();
+
+    set->steps.append(index);
+
+    Node* node = steps_.at(index).output->parent();
+
+    foreach (NodeParam* param, node->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+      const QVector<NodeEdgePtr>& edges = input->edges();
+
+      for (int j=0;j<edges.size();j++) {
+        // Connections not in use bound the range too, they may come into use outside it
+        set->range = set->range.Intersected(node->InputUseRange(input, j, time));
+
+        if (!node->UsesInput(input, j, time)) {
+          continue;
+        }
+
+        int dep = step_indices_.value(edges.at(j)->output());
+
+        if (!reached.at(dep)) {
+          reached[dep] = true;
+          stack.append(dep);
+        }
+      }
+    }
+  }
+
+  // Steps are indexed in dependency order
+  std::sort(set->steps.begin(), set->steps.end());
+
+  set->consumers.fill(0, steps_.size());
+  set->branch_steps.resize(branches_.size());
+
+  foreach (int index, set->steps) {
+    const Step& step = steps_.at(index);
+
+    foreach (int dep, step.dependencies) {
+      set->consumers[dep]++;
+    }
+
+    if (step.branch >= 0) {
+      set->branch_steps[step.branch].append(index);
+    }
+  }
+
+  return set;
+}
+
+QVector<NodeGraphPlan::Region> NodeGraphPlan::PlanRegions(const ActiveSet &active,
+                                                          const rational &time,
+                                                          const QRect &tile) const
+{
+  QVector<Region> regions(steps_.size());
+
+  for (int i=0;i<regions.size();i++) {
+    regions[i].state = kNotNeeded;
+  }
+
+  regions.last().rect = tile;
+  regions.last().state = kPlanned;
+
+  // Steps are in dependency order, so every consumer of a step has been visited before the step itself
+  for (int k=active.steps.size()-1;k>=0;k--) {
+    int i = active.steps.at(k);
+    const Region& consumer = regions.at(i);
+
+    if (consumer.state == kNotNeeded) {
+      continue;
+    }
+
+    Node* node = steps_.at(i).output->parent();
+
+    foreach (NodeParam* param, node->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+      const QVector<NodeEdgePtr>& edges = input->edges();
+
+      for (int j=0;j<edges.size();j++) {
+        NodeOutput* output = edges.at(j)->output();
+        Region& region = regions[step_indices_.value(output)];
+
+        // What an output pulled on demand needs is only known when it's pulled
+        if (consumer.state == kOnDemand) {
+          region.state = kOnDemand;
+          continue;
+        }
+
+        // Connections the node won't pull at this time aren't processed at all, nor is anything only they need
+        if (!node->UsesInput(input, j, time)) {
+          continue;
+        }
+
+        // Without a tile there's nothing to narrow down
+        QRect needed = consumer.rect;
+
+        if (!tile.isNull()) {
+          needed = input->PullRegion(output, consumer.rect, time);
+
+          if (needed.isEmpty()) {
+            continue;
+          }
+        }
+
+        if (region.state == kNotNeeded) {
+          region.rect = needed;
+          region.state = kPlanned;
+        } else if (region.state == kPlanned && region.rect != needed) {
+          region.state = kOnDemand;
+        }
+      }
+    }
+  }
+
+  return regions;
+}
+
+NodeValue NodeGraphPlan::RunStep(int index, const rational &time, int *remaining, const Region &region) const
+{
+  const Step& step = steps_.at(index);
+
+  NodeValue value;
+
+  if (region.state == kPlanned) {
+    if (region.rect.isNull()) {
+      value = step.output->get_value(time);
+    } else {
+      NodeEvaluationContext::RegionScope scope(region.rect);
+
+      value = step.output->get_value(time);
+    }
+  }
+
+  // Release intermediates nothing else needs
+  foreach (int dep, step.dependencies) {
+    if (--remaining[dep] == 0) {
+      steps_.at(dep).output->ReleaseValue();
+    }
+  }
+
+  return value;
+}
@@ -0,0 +1,233 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEGRAPHPLAN_H
+#define NODEGRAPHPLAN_H
+
+#include <memory>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QRect>
+#include <QSemaphore>
+#include <QVector>
+
+#include "common/timerange.h"
+#include "node/output.h"
+
+class NodeGraphPlan;
+using NodeGraphPlanPtr = std::shared_ptr<NodeGraphPlan>;
+
+/**
+ * @brief A node graph compiled into a topologically sorted list of outputs to process for one target output
+ *
+ * Evaluating a graph by pulling from the target output (NodeOutput::get_value()) recurses through every path to each
+ * node. A plan instead processes every output the target depends on exactly once, in dependency order, so each pull a
+ * node makes while processing is answered from NodeOutput's cache. Once every consumer of an intermediate output has
+ * been processed, its value is released so anything it holds can be freed or reused straight away.
+ *
+ * When a node has several inputs, the branches feeding them are independent. Branches made only of nodes that run on
+ * the CPU (see Node::RunsOnCPU()) and that nothing outside the branch depends on are processed on worker threads in
+ * parallel with the rest of the plan, and the node waits for them before it's processed.
+ *
+ * Each run works out the region of the frame every output is needed over, starting from the tile being rendered and
+ * following Node::RegionOfInterest() upstream, so each step is processed over exactly the region its consumers pull
+ * and steps nothing needs (including connections a node won't use at that time, see Node::UsesInput()) are skipped
+ * along with everything only they depend on. An output whose consumers need different regions of it isn't processed
+ * by the plan (nor is anything it depends on), each consumer pulls it over its own region instead.
+ *
+ * Each run only visits the steps in use at its time: those reached from the target through connections their nodes
+ * use (see Node::UsesInput()). A composite of thousands of layers where only two are visible only walks, launches
+ * and processes those two layers' steps. The steps in use are kept for the range of time over which every node says
+ * its answer holds (see Node::InputUseRange()), so consecutive frames in the same stretch of the edit reuse them
+ * without asking any node again. They're kept per version of the graph (see NodeGraph::Snapshot()), runs without a
+ * snapshot find them every time.
+ *
+ * Plans assume nodes pull their inputs at the time they're processed at. Nodes that pull at other times (e.g. to
+ * retime their inputs) still work, those pulls just aren't answered from the cache.
+ *
+ * A plan is immutable once compiled and can be run by several threads at once, but it must be compiled again whenever
+ * the graph's connections change (see NodeGraph::GetPlan()).
+ */
+class NodeGraphPlan
+{
+public:
+  /**
+   * @brief Compile a plan for an output
+   *
+   * @return
+   *
+   * The plan, or nullptr if the output depends on itself.
+   */
+  static NodeGraphPlanPtr Compile(NodeOutput* target);
+
+  NodeOutput* target();
+
+  /**
+   * @brief Process every output in the plan at a time and return the target's value
+   */
+  NodeValue Run(const rational& time);
+
+  /**
+   * @brief Number of outputs the plan processes
+   */
+  int StepCount();
+
+  /**
+   * @brief Number of sets of steps in use currently kept for reuse
+   */
+  static const int kMaxActiveSets = 16;
+
+private:
+  struct Step {
+    NodeOutput* output;
+
+    // Steps whose outputs are connected to the inputs of this step's node
+    QVector<int> dependencies;
+
+    // Number of steps depending on this one
+    int consumers;
+
+    // Processed as part of its only consumer (see Node::FusesInput()), so not run itself
+    bool fused;
+
+    // Branch processed on a worker this step belongs to (or -1)
+    int branch;
+
+    // Branches this step waits for before it's processed
+    QVector<int> joins;
+  };
+
+  struct Branch {
+    // Steps in the order they're processed
+    QVector<int> steps;
+
+    // Step that waits for this branch before it's processed
+    int join;
+  };
+
+  enum RegionState {
+    // No consumer needs the output in this run
+    kNotNeeded,
+
+    // Processed by the plan over the region
+    kPlanned,
+
+    // Pulled by its consumers over the regions they need
+    kOnDemand
+  };
+
+  /**
+   * @brief The region a step is processed over in one run
+   */
+  struct Region {
+    // Null if the evaluation has no tile
+    QRect rect;
+
+    RegionState state;
+  };
+
+  /**
+   * @brief The steps in use over a range of time
+   */
+  struct ActiveSet {
+    // Range every node's use of its connections is known to stay the same over
+    TimeRange range;
+
+    // Version of the graph snapshot the set was found with
+    quint64 version;
+
+    // Steps in use, in the order they're processed
+    QVector<int> steps;
+
+    // Number of steps in use depending on each step
+    QVector<int> consumers;
+
+    // Steps in use of each branch, in the order they're processed
+    QVector< QVector<int> > branch_steps;
+  };
+
+  using ActiveSetPtr = std::shared_ptr<const ActiveSet>;
+
+  class BranchRunnable;
+
+  NodeGraphPlan();
+
+  /**
+   * @brief Add a step for an output after the steps of everything it depends on
+   *
+   * @return
+   *
+   * The step's index, or -1 if the output depends on itself.
+   */
+  int AddStep(NodeOutput* output, QVector<NodeOutput*>& visiting);
+
+  /**
+   * @brief Mark steps that are processed by their consumer and hand their dependencies to that consumer
+   */
+  void FuseSteps();
+
+  /**
+   * @brief Find independent branches that can be processed on worker threads
+   */
+  void FindBranches();
+
+  /**
+   * @brief Return the steps in use at a time, reusing a kept set if one covers it
+   */
+  ActiveSetPtr GetActiveSet(const rational& time);
+
+  /**
+   * @brief Find the steps in use at a time by walking from the target through connections in use
+   */
+  ActiveSetPtr FindActiveSet(const rational& time, quint64 version) const;
+
+  /**
+   * @brief Work out the region each step in use is needed over when rendering `tile` (null for no tile) at a time
+   */
+  QVector<Region> PlanRegions(const ActiveSet& active, const rational& time, const QRect& tile) const;
+
+  /**
+   * @brief Process a step over its region and release dependencies no other step still needs
+   *
+   * @param remaining
+   *
+   * Number of consumers of each step yet to be processed.
+   */
+  NodeValue RunStep(int index, const rational& time, int* remaining, const Region& region) const;
+
+  // Steps in the order they're processed, the target is always last
+  QVector<Step> steps_;
+
+  QVector<Branch> branches_;
+
+  // Index of each output's step
+  QHash<NodeOutput*, int> step_indices_;
+
+  // An input of a node in the plan, to check a snapshot is of this plan's graph (nullptr if there are no inputs)
+  NodeInput* version_input_;
+
+  // Sets of steps in use, most recently used first
+  QList<ActiveSetPtr> active_sets_;
+
+  QMutex active_sets_mutex_;
+};
+
+#endif // NODEGRAPHPLAN_H
@@ -0,0 +1,42 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "graphsnapshot.h"
+
+NodeGraphSnapshot::NodeGraphSnapshot(quint64 version, const QHash<NodeInput *, NodeInputStatePtr> &states) :
+  version_(version),
+  states_(states)
+{
+}
+
+quint64 NodeGraphSnapshot::version() const
+{
+  return version_;
+}
+
+NodeInputStatePtr NodeGraphSnapshot::state(NodeInput *input) const
+{
+  return states_.value(input);
+}
+
+const QHash<NodeInput *, NodeInputStatePtr> &NodeGraphSnapshot::states() const
+{
+  return states_;
+}
@@ -0,0 +1,70 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEGRAPHSNAPSHOT_H
+#define NODEGRAPHSNAPSHOT_H
+
+#include <QHash>
+#include <memory>
+
+#include "node/input.h"
+
+class NodeGraphSnapshot;
+using NodeGraphSnapshotPtr = std::shared_ptr<const NodeGraphSnapshot>;
+
+/**
+ * @brief An immutable version of the value state of every input in a NodeGraph
+ *
+ * Render threads evaluate a frame against one snapshot (see NodeEvaluationContext::set_snapshot()), so edits made
+ * while the frame renders can't tear it: every input reads its keyframes and connections as they were when the
+ * snapshot was taken, without locking anything. Edits publish new input states and the next snapshot picks them up.
+ *
+ * Snapshots share structure. Each one holds shared pointers to immutable NodeInputStates and a new snapshot only
+ * replaces the states of inputs that changed, so older snapshots still being rendered stay valid for as long as
+ * they're held.
+ */
+class NodeGraphSnapshot
+{
+public:
+  NodeGraphSnapshot(quint64 version, const QHash<NodeInput*, NodeInputStatePtr>& states);
+
+  /**
+   * @brief Increases by one for every snapshot of the same graph that differs from the one before it
+   */
+  quint64 version() const;
+
+  /**
+   * @brief Returns the state of an input in this version, or nullptr if the input wasn't in the graph
+   */
+  NodeInputStatePtr state(NodeInput* input) const;
+
+  /**
+   * @brief Returns the states of every input in this version
+   */
+  const QHash<NodeInput*, NodeInputStatePtr>& states() const;
+
+private:
+  quint64 version_;
+
+  QHash<NodeInput*, NodeInputStatePtr> states_;
+
+};
+
+#endif // NODEGRAPHSNAPSHOT_H
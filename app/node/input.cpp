@@ -20,13 +20,36 @@
 
 #include "input.h"
 
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+
+#include "evaluationcontext.h"
+#include "graph.h"
+#include "node.h"
 #include "output.h"
 
 NodeInput::NodeInput() :
+  last_segment_(0),
   can_accept_multiple_inputs_(false)
 {
   // Have at least one keyframe/value active at any time
-  keyframes_.append(NodeKeyframe());
+  NodeInputState* state = new NodeInputState();
+  state->keyframes.append(NodeKeyframe());
+  state_ = NodeInputStatePtr(state);
+}
+
+NodeInput::~NodeInput()
+{
+  // The graph's snapshots can't hold onto a state keyed by an input that no longer exists
+  if (parent() != nullptr) {
+    NodeGraph* graph = qobject_cast<NodeGraph*>(parent()->parent());
+
+    if (graph != nullptr) {
+      graph->InputRemoved(this);
+    }
+  }
 }
 
 NodeParam::Type NodeInput::type()
@@ -59,45 +82,728 @@ void NodeInput::set_can_accept_multiple_inputs(bool b)
   can_accept_multiple_inputs_ = b;
 }
 
-QVariant NodeInput::get_value(const rational &time)
+NodeValue NodeInput::get_value(const rational &time)
 {
-  /// Determine if this input has any connections to it
-  switch (edges_.size()) {
+  NodeInputStatePtr state = EvaluationState();
+
+  /// Otherwise use the output of the (first) connected Node
+  if (!state->outputs.isEmpty()) {
+    return Pull(state->outputs.first(), time);
+  }
 
   /// No connections - use the internal value
-  case 0:
-    // FIXME: Re-implement keyframing
-    return keyframes_.first().value();
+  return UserValue(*state, time);
+}
 
-  /// One connection - use the output of the connected Node
-  case 1:
-    return edges_.first()->output()->get_value(time);
+QVector<NodeValue> NodeInput::get_value_batch(const QVector<rational> &times)
+{
+  QVector<NodeValue> values(times.size());
 
-  /// Multiple connections - rare, return a list of the outputs of the connected Nodes
-  default:
-  {
-    QList<QVariant> values;
+  NodeInputStatePtr state = EvaluationState();
 
-    for (int i=0;i<edges_.size();i++) {
-      values.append(edges_.at(i)->output()->get_value(time));
-    }
+  if (!state->outputs.isEmpty()) {
+    get_samples(times, [&values](int index, const NodeValue& value) {
+      values[index] = value;
+    });
 
     return values;
   }
+
+  const QVector<NodeKeyframe>& keyframes = state->keyframes;
+
+  if (!state->keyframing || keyframes.size() == 1) {
+    values.fill(keyframes.first().value());
+  } else {
+    int segment = 0;
+
+    for (int i=0;i<times.size();i++) {
+      segment = FindSegment(keyframes, times.at(i), segment);
+
+      values[i] = ValueInSegment(keyframes, segment, times.at(i));
+    }
+  }
+
+  if (state->expression != nullptr) {
+    QVector<double> own(times.size());
+    QVector<double> results(times.size());
+
+    if (state->expression->uses_value()) {
+      for (int i=0;i<times.size();i++) {
+        own[i] = (values.at(i).type() == NodeParam::kBoolean) ? values.at(i).toBool() : values.at(i).toDouble();
+      }
+    }
+
+    state->expression->EvaluateBatch(times, own, results.data());
+
+    for (int i=0;i<times.size();i++) {
+      values[i] = FromExpression(*state, results.at(i));
+    }
   }
+
+  return values;
+}
+
+void NodeInput::get_samples(const QVector<rational> &times, const NodeSampleFunction &consume)
+{
+  NodeInputStatePtr state = EvaluationState();
+
+  if (!state->outputs.isEmpty()) {
+    NodeOutput* output = state->outputs.first();
+    QRect tile = NodeEvaluationContext::CurrentTile();
+
+    bool same_region = true;
+
+    for (int i=0;i<times.size() && same_region && !tile.isNull();i++) {
+      same_region = (PullRegion(output, tile, times.at(i)) == tile);
+    }
+
+    if (same_region) {
+      output->get_samples(times, consume);
+    } else {
+      // Samples needing different regions can't share an evaluation
+      for (int i=0;i<times.size();i++) {
+        consume(i, Pull(output, times.at(i)));
+      }
+    }
+
+    return;
+  }
+
+  QVector<NodeValue> values = get_value_batch(times);
+
+  for (int i=0;i<values.size();i++) {
+    consume(i, values.at(i));
+  }
+}
+
+NodeValueList NodeInput::get_values(const rational &time)
+{
+  NodeValueList values;
+
+  NodeInputStatePtr state = EvaluationState();
+
+  if (state->outputs.isEmpty()) {
+    values.append(UserValue(*state, time));
+  } else {
+    /// Multiple connections - rare, list the outputs of the connected Nodes
+    values.reserve(state->outputs.size());
+
+    for (int i=0;i<state->outputs.size();i++) {
+      if (parent() != nullptr && !parent()->UsesInput(this, i, time)) {
+        values.append(NodeValue());
+      } else {
+        values.append(Pull(state->outputs.at(i), time));
+      }
+    }
+  }
+
+  return values;
+}
+
+QRect NodeInput::PullRegion(NodeOutput *output, const QRect &region, const rational &time)
+{
+  if (output->data_type() != kTexture || parent() == nullptr) {
+    return region;
+  }
+
+  return parent()->RegionOfInterest(this, region, time);
+}
+
+bool NodeInput::DomainOfDefinition(const rational &time, QRect *bounds)
+{
+  NodeInputStatePtr state = EvaluationState();
+
+  QRect united;
+
+  foreach (NodeOutput* output, state->outputs) {
+    QRect output_bounds;
+
+    if (output->data_type() != kTexture || !output->parent()->DomainOfDefinition(output, time, &output_bounds)) {
+      return false;
+    }
+
+    united |= output_bounds;
+  }
+
+  *bounds = united;
+
+  return true;
+}
+
+TimeRange NodeInput::PositiveRange(const rational &time)
+{
+  NodeInputStatePtr state = EvaluationState();
+
+  if (!state->outputs.isEmpty() || state->expression != nullptr) {
+    return TimeRange(time, time);
+  }
+
+  const QVector<NodeKeyframe>& keyframes = state->keyframes;
+
+  if (!state->keyframing || keyframes.size() == 1) {
+    return TimeRange::All();
+  }
+
+  int segment = FindSegment(keyframes, time, last_segment_.load());
+
+  // Before the first and after the last keyframe, its value is held
+  if (segment < 0) {
+    return TimeRange(TimeRange::All().in(), keyframes.first().time());
+  }
+
+  if (segment >= keyframes.size() - 1) {
+    return TimeRange(keyframes.last().time(), TimeRange::All().out());
+  }
+
+  const NodeKeyframe& a = keyframes.at(segment);
+  const NodeKeyframe& b = keyframes.at(segment + 1);
+
+  if (a.type() != NodeKeyframe::kBezier && (a.value().toDouble() > 0.0) == (b.value().toDouble() > 0.0)) {
+    return TimeRange(a.time(), b.time());
+  }
+
+  return TimeRange(time, time);
+}
+
+void NodeInput::Hash(QCryptographicHash *hash, const rational &time)
+{
+  NodeInputStatePtr state = EvaluationState();
+
+  if (!state->outputs.isEmpty()) {
+    foreach (NodeOutput* output, state->outputs) {
+      output->Hash(hash, time);
+    }
+
+    return;
+  }
+
+  HashValue(hash, UserValue(*state, time));
 }
 
 bool NodeInput::keyframing()
 {
-  return keyframing_;
+  return current_state()->keyframing;
 }
 
 void NodeInput::set_keyframing(bool k)
 {
-  keyframing_ = k;
+  Modify([k](NodeInputState* state) {
+    state->keyframing = k;
+  });
+
+  // Every time may have a different value now
+  if (parent() != nullptr) {
+    parent()->ClearCachedValues();
+  }
+}
+
+bool NodeInput::IsAnimated()
+{
+  NodeInputStatePtr state = current_state();
+
+  bool keyframes_animated = state->keyframing && state->keyframes.size() > 1;
+
+  if (state->expression != nullptr) {
+    return state->expression->IsAnimated(keyframes_animated);
+  }
+
+  return keyframes_animated;
+}
+
+bool NodeInput::set_expression(const QString &expression, QString *error)
+{
+  NodeExpressionPtr compiled;
+
+  if (!expression.trimmed().isEmpty()) {
+    if (!inputs_.contains(kInt) && !inputs_.contains(kFloat) && !inputs_.contains(kBoolean)) {
+      if (error != nullptr) {
+        *error = NodeExpression::tr("Only numeric inputs can take expressions");
+      }
+
+      return false;
+    }
+
+    compiled = NodeExpression::Compile(expression, this, error);
+
+    if (compiled == nullptr) {
+      return false;
+    }
+  }
+
+  Modify([&compiled](NodeInputState* state) {
+    state->expression = compiled;
+  });
+
+  // Every time may have a different value now
+  if (parent() != nullptr) {
+    parent()->ClearCachedValues();
+  }
+
+  return true;
+}
+
+QString NodeInput::expression()
+{
+  NodeExpressionPtr expression = current_state()->expression;
+
+  return (expression != nullptr) ? expression->source() : QString();
+}
+
+QVector<NodeKeyframe> NodeInput::keyframes()
+{
+  return current_state()->keyframes;
+}
+
+void NodeInput::insert_keyframe(const NodeKeyframe &key)
+{
+  int index = 0;
+
+  Modify([&key, &index](NodeInputState* state) {
+    // Find the first keyframe at or after this time
+    QVector<NodeKeyframe>::iterator i = std::lower_bound(state->keyframes.begin(),
+                                                         state->keyframes.end(),
+                                                         key.time(),
+                                                         [](const NodeKeyframe& k, const rational& t) {
+      return k.time() < t;
+    });
+
+    index = static_cast<int>(i - state->keyframes.begin());
+
+    if (i != state->keyframes.end() && i->time() == key.time()) {
+      *i = key;
+    } else {
+      state->keyframes.insert(index, key);
+    }
+  });
+
+  InvalidateKeyframe(index);
+}
+
+void NodeInput::remove_keyframe(const rational &time)
+{
+  int index = -1;
+
+  Modify([&time, &index](NodeInputState* state) {
+    if (state->keyframes.size() > 1) {
+      for (int i=0;i<state->keyframes.size();i++) {
+        if (state->keyframes.at(i).time() == time) {
+          state->keyframes.remove(i);
+
+          // The keyframe that moved into its index (or the new last keyframe) spans the affected segments
+          index = qMin(i, state->keyframes.size() - 1);
+          break;
+        }
+      }
+    }
+  });
+
+  if (index >= 0) {
+    InvalidateKeyframe(index);
+  }
+}
+
+void NodeInput::set_keyframes(const QVector<NodeKeyframe> &keyframes)
+{
+  if (keyframes.isEmpty()) {
+    return;
+  }
+
+  Modify([&keyframes](NodeInputState* state) {
+    state->keyframes = keyframes;
+  });
+
+  last_segment_.store(0);
+
+  // Every time may have a different value now
+  if (parent() != nullptr) {
+    parent()->ClearCachedValues();
+  }
 }
 
 const QList<NodeParam::DataType> &NodeInput::inputs()
 {
   return inputs_;
 }
+
+NodeValue NodeInput::Pull(NodeOutput *output, const rational &time)
+{
+  QRect tile = NodeEvaluationContext::CurrentTile();
+
+  if (tile.isNull()) {
+    return output->get_value(time);
+  }
+
+  QRect region = PullRegion(output, tile, time);
+
+  if (region.isEmpty()) {
+    return NodeValue::Texture(0);
+  }
+
+  if (region == tile) {
+    return output->get_value(time);
+  }
+
+  NodeEvaluationContext::RegionScope scope(region);
+
+  return output->get_value(time);
+}
+
+NodeValue NodeInput::UserValue(const NodeInputState &state, const rational &time)
+{
+  if (state.expression == nullptr) {
+    return KeyframeValue(state, time);
+  }
+
+  double value = 0.0;
+
+  if (state.expression->uses_value()) {
+    NodeValue own = KeyframeValue(state, time);
+
+    value = (own.type() == kBoolean) ? own.toBool() : own.toDouble();
+  }
+
+  return FromExpression(state, state.expression->Evaluate(time, value));
+}
+
+NodeValue NodeInput::KeyframeValue(const NodeInputState &state, const rational &time)
+{
+  const QVector<NodeKeyframe>& keyframes = state.keyframes;
+
+  if (!state.keyframing || keyframes.size() == 1) {
+    return keyframes.first().value();
+  }
+
+  int segment = FindSegment(keyframes, time, last_segment_.load());
+
+  last_segment_.store(segment);
+
+  return ValueInSegment(keyframes, segment, time);
+}
+
+NodeValue NodeInput::FromExpression(const NodeInputState &state, double result)
+{
+  switch (state.keyframes.first().value().type()) {
+  case kInt:
+    return NodeValue(qRound(result));
+  case kBoolean:
+    return NodeValue(result != 0.0);
+  default:
+    return NodeValue(result);
+  }
+}
+
+int NodeInput::FindSegment(const QVector<NodeKeyframe> &keyframes, const rational &time, int hint)
+{
+  int last = keyframes.size() - 1;
+
+  if (time < keyframes.first().time()) {
+    return -1;
+  }
+
+  if (time >= keyframes.last().time()) {
+    return last;
+  }
+
+  // During playback the time is usually still in the same segment, or has moved into the next one
+  if (hint >= 0 && hint < last && keyframes.at(hint).time() <= time) {
+    if (time < keyframes.at(hint + 1).time()) {
+      return hint;
+    }
+
+    if (hint + 1 < last && time < keyframes.at(hint + 2).time()) {
+      return hint + 1;
+    }
+  }
+
+  // Find the first keyframe after this time, the segment starts at the one before it
+  QVector<NodeKeyframe>::const_iterator i = std::upper_bound(keyframes.constBegin(),
+                                                             keyframes.constEnd(),
+                                                             time,
+                                                             [](const rational& t, const NodeKeyframe& k) {
+    return t < k.time();
+  });
+
+  return static_cast<int>(i - keyframes.constBegin()) - 1;
+}
+
+NodeValue NodeInput::ValueInSegment(const QVector<NodeKeyframe> &keyframes, int segment, const rational &time)
+{
+  // Before the first or after the last keyframe, hold its value
+  if (segment < 0) {
+    return keyframes.first().value();
+  }
+
+  if (segment >= keyframes.size() - 1) {
+    return keyframes.last().value();
+  }
+
+  return Interpolate(keyframes.at(segment), keyframes.at(segment + 1), time);
+}
+
+NodeValue NodeInput::Interpolate(const NodeKeyframe &a, const NodeKeyframe &b, const rational &time)
+{
+  if (a.type() == NodeKeyframe::kHold) {
+    return a.value();
+  }
+
+  double t0 = a.time().ToDouble();
+  double t1 = b.time().ToDouble();
+  double x = time.ToDouble();
+
+  double duration = t1 - t0;
+  double progress = (x - t0) / duration;
+
+  bool scalar = (a.value().type() == NodeParam::kFloat || a.value().type() == NodeParam::kInt)
+      && a.value().type() == b.value().type();
+
+  if (a.type() != NodeKeyframe::kBezier || !scalar) {
+    return Lerp(a.value(), b.value(), progress);
+  }
+
+  // Solve the curve's X for the parameter (s) where it reaches the time, X is kept monotonic by clamping the control
+  // points inside the segment
+  double v0 = a.value().toDouble();
+  double v1 = b.value().toDouble();
+
+  double x1 = qBound(0.0, a.bezier_control_out().x() / duration, 1.0);
+  double x2 = qBound(0.0, 1.0 + b.bezier_control_in().x() / duration, 1.0);
+  double y1 = v0 + a.bezier_control_out().y();
+  double y2 = v1 + b.bezier_control_in().y();
+
+  // Polynomial coefficients of X(s), as in x = ((cx * s + bx) * s + ax) * s
+  double ax = 3.0 * x1;
+  double bx = 3.0 * (x2 - x1) - ax;
+  double cx = 1.0 - ax - bx;
+
+  double s = progress;
+
+  // Newton's method converges in a few iterations on well-behaved curves...
+  bool solved = false;
+
+  for (int i=0;i<8;i++) {
+    double error = ((cx * s + bx) * s + ax) * s - progress;
+
+    if (std::fabs(error) < 1e-7) {
+      solved = true;
+      break;
+    }
+
+    double slope = (3.0 * cx * s + 2.0 * bx) * s + ax;
+
+    if (std::fabs(slope) < 1e-7) {
+      break;
+    }
+
+    s -= error / slope;
+  }
+
+  // ...but fall back to bisection when it doesn't
+  if (!solved) {
+    double low = 0.0;
+    double high = 1.0;
+
+    s = progress;
+
+    for (int i=0;i<32;i++) {
+      double sx = ((cx * s + bx) * s + ax) * s;
+
+      if (std::fabs(sx - progress) < 1e-7) {
+        break;
+      }
+
+      if (sx < progress) {
+        low = s;
+      } else {
+        high = s;
+      }
+
+      s = (low + high) * 0.5;
+    }
+  }
+
+  double inv = 1.0 - s;
+  double y = inv * inv * inv * v0 + 3.0 * inv * inv * s * y1 + 3.0 * inv * s * s * y2 + s * s * s * v1;
+
+  if (a.value().type() == NodeParam::kInt) {
+    return NodeValue(qRound(y));
+  }
+
+  return NodeValue(y);
+}
+
+NodeValue NodeInput::Lerp(const NodeValue &a, const NodeValue &b, double t)
+{
+  if (a.type() != b.type()) {
+    return a;
+  }
+
+  switch (a.type()) {
+  case NodeParam::kInt:
+    return NodeValue(qRound(a.toInt() + (b.toInt() - a.toInt()) * t));
+  case NodeParam::kFloat:
+    return NodeValue(a.toDouble() + (b.toDouble() - a.toDouble()) * t);
+  case NodeParam::kColor:
+  {
+    QColor ca = a.toColor();
+    QColor cb = b.toColor();
+
+    return NodeValue(QColor::fromRgbF(ca.redF() + (cb.redF() - ca.redF()) * t,
+                                      ca.greenF() + (cb.greenF() - ca.greenF()) * t,
+                                      ca.blueF() + (cb.blueF() - ca.blueF()) * t,
+                                      ca.alphaF() + (cb.alphaF() - ca.alphaF()) * t));
+  }
+  case NodeParam::kMatrix:
+  {
+    // Element-wise, which is fine for the small changes between keyframes but won't preserve rotations
+    QMatrix4x4 ma = a.toMatrix();
+    QMatrix4x4 mb = b.toMatrix();
+
+    return NodeValue(ma + (mb - ma) * static_cast<float>(t));
+  }
+  case NodeParam::kNone:
+  case NodeParam::kString:
+  case NodeParam::kBoolean:
+  case NodeParam::kFont:
+  case NodeParam::kFile:
+  case NodeParam::kTexture:
+  case NodeParam::kBlock:
+  case NodeParam::kSamples:
+  case NodeParam::kAny:
+    break;
+  }
+
+  // Values that can't be interpolated hold until the next keyframe
+  return a;
+}
+
+void NodeInput::HashValue(QCryptographicHash *hash, const NodeValue &value)
+{
+  hash->addData(QByteArray::number(value.type()));
+
+  switch (value.type()) {
+  case NodeParam::kInt:
+    hash->addData(QByteArray::number(value.toInt()));
+    break;
+  case NodeParam::kFloat:
+    hash->addData(QByteArray::number(value.toDouble(), 'g', 17));
+    break;
+  case NodeParam::kBoolean:
+    hash->addData(QByteArray::number(value.toBool()));
+    break;
+  case NodeParam::kColor:
+  {
+    QColor color = value.toColor();
+
+    hash->addData(QByteArray::number(color.redF(), 'g', 17));
+    hash->addData(QByteArray::number(color.greenF(), 'g', 17));
+    hash->addData(QByteArray::number(color.blueF(), 'g', 17));
+    hash->addData(QByteArray::number(color.alphaF(), 'g', 17));
+    break;
+  }
+  case NodeParam::kMatrix:
+  {
+    QMatrix4x4 matrix = value.toMatrix();
+
+    hash->addData(reinterpret_cast<const char*>(matrix.constData()), 16 * static_cast<int>(sizeof(float)));
+    break;
+  }
+  case NodeParam::kString:
+  case NodeParam::kFont:
+    hash->addData(value.toString().toUtf8());
+    break;
+  case NodeParam::kFile:
+    hash->addData(value.toString().toUtf8());
+    hash->addData(QByteArray::number(QFileInfo(value.toString()).lastModified().toMSecsSinceEpoch()));
+    break;
+  case NodeParam::kNone:
+  case NodeParam::kTexture:
+  case NodeParam::kBlock:
+  case NodeParam::kSamples:
+  case NodeParam::kAny:
+    break;
+  }
+}
+
+void NodeInput::InvalidateKeyframe(int index)
+{
+  if (parent() == nullptr) {
+    return;
+  }
+
+  rational start;
+  rational end;
+
+  NodeInputStatePtr state = current_state();
+
+  // Values are held before the first keyframe and after the last, so changing either affects an unbounded range
+  bool unbounded = (!state->keyframing || index <= 0 || index >= state->keyframes.size() - 1);
+
+  // Otherwise only the segments on either side of the keyframe changed
+  if (!unbounded) {
+    start = state->keyframes.at(index - 1).time();
+    end = state->keyframes.at(index + 1).time();
+  }
+
+  if (unbounded) {
+    parent()->ClearCachedValues();
+  } else {
+    parent()->InvalidateCache(start, end);
+  }
+}
+
+NodeInputStatePtr NodeInput::current_state()
+{
+  return std::atomic_load(&state_);
+}
+
+NodeInputStatePtr NodeInput::EvaluationState()
+{
+  // Evaluations read the version of the graph they started with, even if it's been edited since
+  const NodeGraphSnapshot* snapshot = NodeEvaluationContext::CurrentSnapshot();
+
+  if (snapshot != nullptr) {
+    NodeInputStatePtr pinned = snapshot->state(this);
+
+    if (pinned != nullptr) {
+      return pinned;
+    }
+  }
+
+  return current_state();
+}
+
+void NodeInput::Modify(const std::function<void (NodeInputState *)> &edit)
+{
+  modify_lock_.lock();
+
+  NodeInputState* state = new NodeInputState(*current_state());
+
+  edit(state);
+
+  std::atomic_store(&state_, NodeInputStatePtr(state));
+
+  modify_lock_.unlock();
+
+  // Let the graph know its snapshot is out of date
+  if (parent() != nullptr) {
+    NodeGraph* graph = qobject_cast<NodeGraph*>(parent()->parent());
+
+    if (graph != nullptr) {
+      graph->InputChanged(this);
+    }
+  }
+}
+
+void NodeInput::PublishOutputs()
+{
+  QVector<NodeOutput*> outputs;
+  outputs.reserve(edges_.size());
+
+  foreach (NodeEdgePtr edge, edges_) {
+    outputs.append(edge->output());
+  }
+
+  Modify([&outputs](NodeInputState* state) {
+    state->outputs = outputs;
+  });
+}
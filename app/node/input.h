@@ -21,9 +21,48 @@
 #ifndef NODEINPUT_H
 #define NODEINPUT_H
 
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+#include "common/timerange.h"
+#include "expression.h"
 #include "keyframe.h"
 #include "param.h"
 
+class NodeOutput;
+
+/**
+ * @brief One immutable version of everything about a NodeInput that affects its value
+ *
+ * Edits never modify a published state, they copy it, change the copy and publish that instead (see
+ * NodeInput::current_state()). The keyframe and output arrays are implicitly shared, so a copy only duplicates what's
+ * actually changed.
+ */
+struct NodeInputState {
+  NodeInputState() :
+    keyframing(false)
+  {
+  }
+
+  /// Sorted by time, always contains at least one keyframe (whose time is ignored when not keyframing)
+  QVector<NodeKeyframe> keyframes;
+
+  bool keyframing;
+
+  /// Outputs connected to the input, in the order they were connected
+  QVector<NodeOutput*> outputs;
+
+  /// Expression computing the value from the keyframes, time and other inputs, or nullptr to use the keyframes
+  NodeExpressionPtr expression;
+};
+
+using NodeInputStatePtr = std::shared_ptr<const NodeInputState>;
+
 /**
  * @brief A node parameter designed to take either user input or data from another node
  */
@@ -32,6 +71,8 @@ class NodeInput : public NodeParam
 public:
   NodeInput();
 
+  virtual ~NodeInput() override;
+
   /**
    * @brief Returns kInput
    */
@@ -57,8 +98,8 @@ public:
    * @brief Return whether this parameter accepts multiple inputs (false by default)
    *
    * While an input will usually only accept one connection from an output at any given time, NodeInput does support
-   * more than one. By default this is false, but can be set to true on any input object. If this is true, get_value()
-   * returns QList<QVariant> rather than just a QVariant (but casted to QVariant).
+   * more than one. By default this is false, but can be set to true on any input object. If this is true, use
+   * get_values() to retrieve the values of every connected output.
    */
   bool can_accept_multiple_inputs();
 
@@ -73,13 +114,82 @@ public:
    * This function will automatically retrieve the correct value for this input at the given time.
    *
    * If an output is connected to this input, a request is made to that output for its value at this time. If multiple
-   * outputs are connected (\see can_accept_multiple_inputs()), a QList<QVariant> (casted to a QVariant) is returned
-   * instead, listing all the outputs' values currently connected.
+   * outputs are connected (\see can_accept_multiple_inputs()), the first output's value is returned, use get_values()
+   * to retrieve all of them.
    *
    * If no output is connected, this will return a user-defined value, either a static value if this input is not
-   * keyframed, or an interpolated value between the keyframes at this time.
+   * keyframed, or an interpolated value between the keyframes at this time. If an expression is set, it's evaluated
+   * with that as its `value` (\see set_expression()).
+   *
+   * Keyframes are found with a binary search, except that the segment found last time is checked first, so playing
+   * forwards costs O(1) per frame however many keyframes there are.
+   */
+  NodeValue get_value(const rational &time);
+
+  /**
+   * @brief Get the value at several times at once
+   *
+   * Equivalent to calling get_value() for each time, but keyframes are only locked once and consecutive times reuse
+   * the segment found for the previous one, so sorted times are evaluated in O(1) each. Expressions are evaluated for
+   * every time in one pass (see NodeExpression::EvaluateBatch()). Intended for motion blur, curve display and
+   * exporting.
+   */
+  QVector<NodeValue> get_value_batch(const QVector<rational>& times);
+
+  /**
+   * @brief Get the value at several times, passing each to `consume` as soon as it's ready
+   *
+   * Like get_value_batch(), but a connected output is processed with NodeOutput::get_samples(), which shares work
+   * between the samples. Use this rather than get_value_batch() for textures, which are only valid until the next
+   * sample is processed.
+   */
+  void get_samples(const QVector<rational>& times, const NodeSampleFunction& consume);
+
+  /**
+   * @brief Get the values of every output connected to this input at a given time
+   *
+   * Values are listed in the order the outputs were connected. If no output is connected, the list contains the
+   * user-defined value (\see get_value()). Outputs the node doesn't use at this time (see Node::UsesInput()) aren't
+   * evaluated, their values are empty.
+   */
+  NodeValueList get_values(const rational &time);
+
+  /**
+   * @brief Return the region of the frame a connected output is pulled over when this input's node renders `region`
+   *
+   * Textures are pulled over the region returned by the node's Node::RegionOfInterest(), other values over the node's
+   * own region. Returns an empty region if the output isn't needed at all.
+   */
+  QRect PullRegion(NodeOutput* output, const QRect& region, const rational& time);
+
+  /**
+   * @brief Find the bounds of what the textures connected to this input can make visible at a time
+   *
+   * An input with nothing connected has empty bounds.
+   *
+   * @return
+   *
+   * FALSE if a connected output may cover any pixel (see Node::DomainOfDefinition()).
    */
-  QVariant get_value(const rational &time);
+  bool DomainOfDefinition(const rational& time, QRect* bounds);
+
+  /**
+   * @brief Find a range of time around `time` over which this input's value is either above 0 throughout or nowhere
+   *
+   * Lets nodes that skip a connection based on a value (e.g. a layer's opacity) say how long the answer holds (see
+   * Node::InputUseRange()). Only keyframes are analyzed: held and linear segments stay between the values at their
+   * ends, while curves, expressions and connected outputs could cross 0 at any time, so they return just `time`.
+   */
+  TimeRange PositiveRange(const rational& time);
+
+  /**
+   * @brief Add what this input provides at a given time to a hash (see Node::Hash())
+   *
+   * That's the content hash of every connected output at the time, or the user-defined value at the time (after
+   * keyframes are interpolated) if none is connected. File values also add the file's modification time, so replacing
+   * a file on disk changes the hash.
+   */
+  void Hash(QCryptographicHash* hash, const rational& time);
 
   /**
    * @brief Return whether keyframing is enabled on this input or not
@@ -91,12 +201,70 @@ public:
    */
   void set_keyframing(bool k);
 
+  /**
+   * @brief Returns TRUE if this input's own value changes over time
+   *
+   * That's when keyframing is enabled with several keyframes, or an expression is set whose result depends on the time
+   * (see NodeExpression::IsAnimated()).
+   */
+  bool IsAnimated();
+
+  /**
+   * @brief Drive this input's value with an expression (see NodeExpression), or go back to the keyframes
+   *
+   * Only inputs accepting numbers (kInt, kFloat or kBoolean) take expressions. The result is rounded for integer
+   * inputs and is TRUE for booleans if it isn't 0. An empty expression clears it.
+   *
+   * @return
+   *
+   * FALSE, with a description in `error`, if the expression doesn't compile or the input isn't numeric. The input is
+   * left unchanged in that case.
+   */
+  bool set_expression(const QString& expression, QString* error = nullptr);
+
+  /**
+   * @brief The source of the expression driving this input, empty if there isn't one
+   */
+  QString expression();
+
+  /**
+   * @brief Return a copy of this input's keyframes, sorted by time
+   */
+  QVector<NodeKeyframe> keyframes();
+
+  /**
+   * @brief Add a keyframe, replacing any existing keyframe at the same time
+   */
+  void insert_keyframe(const NodeKeyframe& key);
+
+  /**
+   * @brief Remove the keyframe at a time (the last remaining keyframe can't be removed)
+   */
+  void remove_keyframe(const rational& time);
+
+  /**
+   * @brief Replace every keyframe at once (e.g. when loading), ignored if `keyframes` is empty
+   *
+   * The keyframes must be sorted by time.
+   */
+  void set_keyframes(const QVector<NodeKeyframe>& keyframes);
+
   /**
    * @brief A list of input data types accepted by this parameter
    */
   const QList<DataType>& inputs();
 
+  /**
+   * @brief The latest published version of this input's value state (thread-safe, never blocks on edits)
+   *
+   * Evaluations don't use this directly, they read the version pinned by the graph snapshot they run with (see
+   * NodeGraph::Snapshot()) so every input they read comes from the same version of the graph.
+   */
+  NodeInputStatePtr current_state();
+
 private:
+  // ConnectEdge() and DisconnectEdge() publish the new outputs
+  friend class NodeParam;
   /**
    * @brief Internal list of accepted data types
    *
@@ -105,17 +273,95 @@ private:
   QList<DataType> inputs_;
 
   /**
-   * @brief Internal keyframe array
+   * @brief Get a connected output's value, pulled over the region this input's node needs from it (see PullRegion())
+   */
+  NodeValue Pull(NodeOutput* output, const rational& time);
+
+  /**
+   * @brief The value set by the user at a time, i.e. the keyframes and expression without any connected output
+   */
+  NodeValue UserValue(const NodeInputState& state, const rational& time);
+
+  /**
+   * @brief The keyframes' value at a time
+   */
+  NodeValue KeyframeValue(const NodeInputState& state, const rational& time);
+
+  /**
+   * @brief Convert an expression's result to the type of the input's keyframes
+   */
+  static NodeValue FromExpression(const NodeInputState& state, double result);
+
+  /**
+   * @brief Return the index of the keyframe starting the segment a time falls in
+   *
+   * @param hint
+   *
+   * Segment to check first (usually the last one found).
    *
-   * All internal/user-defined data is stored in this array. Even if keyframing is not enabled, this array will contain
-   * one entry which will be used, and its time value will be ignored.
+   * @return
+   *
+   * -1 if the time is before the first keyframe, or the index of the last keyframe if it's after it.
+   */
+  static int FindSegment(const QVector<NodeKeyframe>& keyframes, const rational& time, int hint);
+
+  /**
+   * @brief Evaluate the keyframes at a time in a segment found with FindSegment()
+   */
+  static NodeValue ValueInSegment(const QVector<NodeKeyframe>& keyframes, int segment, const rational& time);
+
+  /**
+   * @brief Interpolate between two neighboring keyframes
+   */
+  static NodeValue Interpolate(const NodeKeyframe& a, const NodeKeyframe& b, const rational& time);
+
+  /**
+   * @brief Linearly interpolate between two values of the same type (other types and mismatches hold at a)
+   */
+  static NodeValue Lerp(const NodeValue& a, const NodeValue& b, double t);
+
+  /**
+   * @brief Add a user-defined value to a hash (types only passed between nodes just add their type)
+   */
+  static void HashValue(QCryptographicHash* hash, const NodeValue& value);
+
+  /**
+   * @brief Invalidate the time range affected by changing the keyframe at index
+   */
+  void InvalidateKeyframe(int index);
+
+  /**
+   * @brief The state to evaluate with, pinned by the current evaluation's snapshot if it has one
+   */
+  NodeInputStatePtr EvaluationState();
+
+  /**
+   * @brief Publish a copy of the current state changed by `edit`
+   *
+   * Readers holding the old state keep using it undisturbed. The input's graph is told so its next snapshot picks the
+   * new state up.
+   */
+  void Modify(const std::function<void(NodeInputState*)>& edit);
+
+  /**
+   * @brief Publish the outputs currently connected through edges_
+   */
+  void PublishOutputs();
+
+  /**
+   * @brief Current published state, only accessed with std::atomic_load() and std::atomic_store()
+   */
+  NodeInputStatePtr state_;
+
+  /**
+   * @brief Serializes edits so none is lost between copying and publishing the state
    */
-  QList<NodeKeyframe> keyframes_;
+  QMutex modify_lock_;
 
   /**
-   * @brief Internal keyframing enabled setting
+   * @brief Segment found by the last call to get_value(), checked first by the next call
    */
-  bool keyframing_;
+  QAtomicInt last_segment_;
 
   /**
    * @brief Internal multiple inputs accepted setting
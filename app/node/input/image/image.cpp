@@ -1,13 +1,36 @@
 #include "image.h"
 
-ImageInput::ImageInput() :
-  texture_(nullptr)
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/cpurender.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+#include "render/renderbackend.h"
+
+ImageInput::ImageInput()
 {
+  filename_input_ = new NodeInput();
+  filename_input_->add_data_input(NodeParam::kFile);
+  AddParameter(filename_input_);
+
+  colorspace_input_ = new NodeInput();
+  colorspace_input_->add_data_input(NodeParam::kString);
+  colorspace_input_->set_name(tr("Color Space"));
+  AddParameter(colorspace_input_);
+
   texture_output_ = new NodeOutput();
   texture_output_->set_data_type(NodeOutput::kTexture);
   AddParameter(texture_output_);
 }
 
+ImageInput::~ImageInput()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(uploads_);
+  qDeleteAll(software_uploads_);
+}
+
 QString ImageInput::Name()
 {
   return tr("Image");
@@ -28,24 +51,228 @@ QString ImageInput::Description()
   return tr("Import an image file.");
 }
 
+olive::PixelPrecision ImageInput::OutputPrecision()
+{
+  // Images are decoded to 8-bit
+  return olive::PIXEL_PRECISION_8BIT;
+}
+
+NodeInput *ImageInput::filename_input()
+{
+  return filename_input_;
+}
+
 NodeOutput *ImageInput::texture_output()
 {
   return texture_output_;
 }
 
+NodeInput *ImageInput::colorspace_input()
+{
+  return colorspace_input_;
+}
+
 void ImageInput::Process(const rational &time)
 {
-  // FIXME: Use OIIO and OCIO here
+  QString filename = filename_input_->get_value(time).toString();
+  QString colorspace = colorspace_input_->get_value(time).toString();
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  bool software = NodeEvaluationContext::CurrentIsSoftware();
+
+  if (filename.isEmpty() || (ctx == nullptr && !software)) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  ImageFilePtr file = ImageFile::Get(filename);
+
+  if (!file->IsValid()) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  // Use the smallest level that's still at least as sharp as the frame being rendered
+  int divider = NodeEvaluationContext::CurrentDivider();
+  int level = file->LevelForDivider(divider);
+  int level_scale = 1 << level;
+
+  QRect level_rect(QPoint(0, 0), file->LevelSize(level));
+  QRect region = level_rect;
+
+  // Only the part of the level under the tile being rendered is uploaded. Tiles are in the divided frame's pixels,
+  // which are `divider / level_scale` level pixels each.
+  QRect tile = NodeEvaluationContext::CurrentTile();
+
+  if (!tile.isNull()) {
+    int left = tile.x() * divider / level_scale;
+    int top = tile.y() * divider / level_scale;
+    int right = ((tile.x() + tile.width()) * divider + level_scale - 1) / level_scale;
+    int bottom = ((tile.y() + tile.height()) * divider + level_scale - 1) / level_scale;
+
+    region = QRect(left, top, right - left, bottom - top) & level_rect;
+  }
+
+  if (region.isEmpty()) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  // Footage enters the working space here, once per upload rather than once per frame
+  OCIO::ConstProcessorRcPtr processor = olive::color::GetInputProcessor(olive::color::GetConfig(), colorspace);
+
+  if (software) {
+    SoftwareUpload* upload = GetSoftwareUpload();
+
+    // Reduced resolution previews are never exported, so they can be converted through a LUT
+    olive::color::ProcessorQuality quality = (divider > 1) ? olive::color::kApproximate : olive::color::kExact;
+
+    if (upload->file != file || upload->level != level || upload->region != region
+        || upload->colorspace != colorspace || upload->quality != quality) {
+      QImage image = file->Level(level);
+
+      if (image.isNull()) {
+        texture_output_->set_value(NodeValue::Texture(0));
+        return;
+      }
+
+      olive::cpu::LoadImage(image, region, &upload->buffer);
+
+      if (processor) {
+        olive::color::ApplyToBuffer(processor, &upload->buffer, file->HasAlpha(), quality);
+      }
+
+      upload->file = file;
+      upload->level = level;
+      upload->region = region;
+      upload->colorspace = colorspace;
+      upload->quality = quality;
+    }
+
+    texture_output_->set_value(NodeValue::Buffer(&upload->buffer));
+    return;
+  }
+
+  Upload* upload = GetUpload(ctx);
+
+  // Stills don't change from frame to frame, so the texture only needs uploading when the region does
+  if (upload->file != file || upload->level != level || upload->region != region || upload->colorspace != colorspace
+      || !upload->buffer.IsCreated()) {
+    QImage image = file->Level(level);
+
+    if (image.isNull()) {
+      texture_output_->set_value(NodeValue::Texture(0));
+      return;
+    }
+
+    if (!upload->buffer.IsCreated()
+        || upload->buffer.width() != region.width()
+        || upload->buffer.height() != region.height()) {
+      upload->buffer.Create(ctx, olive::PIX_FMT_RGBA8, region.width(), region.height());
+    }
+
+    // Upload the region straight out of the level rather than copying it out first
+    olive::render_backend->UploadTexture(upload->buffer.texture(), olive::PIX_FMT_RGBA8,
+                                         image.constScanLine(region.y()) + region.x() * 4, image.bytesPerLine());
+
+    if (processor) {
+      ConvertUpload(ctx, upload, processor, file->HasAlpha());
+    }
+
+    upload->file = file;
+    upload->level = level;
+    upload->region = region;
+    upload->colorspace = colorspace;
+  }
+
+  if (processor) {
+    texture_output_->set_value(NodeValue::Texture(upload->converted.texture()));
+  } else {
+    texture_output_->set_value(NodeValue::Texture(upload->buffer.texture()));
+  }
+}
+
+void ImageInput::ConvertUpload(QOpenGLContext *ctx, ImageInput::Upload *upload, OCIO::ConstProcessorRcPtr processor,
+                               bool has_alpha)
+{
+  GLuint lut = 0;
+
+  // Opaque files don't need their alpha divided out and multiplied back in
+  ShaderPtr pipeline = olive::gl::GetOCIOPipeline(ctx, lut, processor,
+                                                  has_alpha ? olive::gl::kOCIOAlphaAssociated
+                                                            : olive::gl::kOCIOAlphaOpaque);
+
+  if (pipeline == nullptr) {
+    return;
+  }
+
+  int width = upload->buffer.width();
+  int height = upload->buffer.height();
+
+  if (!upload->converted.IsCreated()
+      || upload->converted.width() != width
+      || upload->converted.height() != height) {
+    upload->converted.Create(ctx, olive::color::kWorkingFormat, width, height);
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  upload->converted.BindBuffer();
+
+  xf->glViewport(0, 0, width, height);
+
+  xf->glActiveTexture(GL_TEXTURE1);
+  xf->glBindTexture(GL_TEXTURE_3D, lut);
+  xf->glActiveTexture(GL_TEXTURE0);
+  xf->glBindTexture(GL_TEXTURE_2D, upload->buffer.texture());
+
+  olive::gl::Blit(pipeline);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+  xf->glActiveTexture(GL_TEXTURE1);
+  xf->glBindTexture(GL_TEXTURE_3D, 0);
+  xf->glActiveTexture(GL_TEXTURE0);
+
+  upload->converted.ReleaseBuffer();
+}
+
+ImageInput::Upload *ImageInput::GetUpload(QOpenGLContext *ctx)
+{
+  QMutexLocker locker(&uploads_mutex_);
+
+  Upload* upload = uploads_.value(ctx);
+
+  if (upload == nullptr) {
+    upload = new Upload();
+    upload->level = -1;
+
+    uploads_.insert(ctx, upload);
+
+    // Free the buffer with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      uploads_mutex_.lock();
+      Upload* u = uploads_.take(ctx);
+      uploads_mutex_.unlock();
+
+      delete u;
+    }, Qt::DirectConnection);
+  }
+
+  return upload;
+}
+
+ImageInput::SoftwareUpload *ImageInput::GetSoftwareUpload()
+{
+  QMutexLocker locker(&uploads_mutex_);
 
-  // FIXME: Test code
-  Q_UNUSED(time)
+  SoftwareUpload* upload = software_uploads_.value(NodeEvaluationContext::CurrentId());
 
-  if (texture_ == nullptr) {
-    QImage img("/home/matt/Desktop/oof.png");
+  if (upload == nullptr) {
+    upload = new SoftwareUpload();
+    upload->level = -1;
 
-    texture_ = new QOpenGLTexture(img);
+    software_uploads_.insert(NodeEvaluationContext::CurrentId(), upload);
   }
 
-  texture_output_->set_value(texture_->textureId());
-  // End test code
+  return upload;
 }
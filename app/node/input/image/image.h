@@ -1,13 +1,23 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
-#include <QOpenGLTexture>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
 
+#include "imagefile.h"
 #include "node/node.h"
+#include "render/colormanagement.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
 
 /**
  * @brief A node that imports an image
  *
+ * The file is read through a shared ImageFile so nodes importing the same file share its decoded pixels. Only the MIP
+ * level matching the render's resolution divider is used, and only the part of it under the tile being rendered is
+ * uploaded to the GPU.
+ *
  * FIXME: This will likely be replaced by the Media node as the Media node will be set up to pull from various decoders
  *        from the beginning.
  */
@@ -17,20 +27,92 @@ class ImageInput : public Node
 public:
   ImageInput();
 
+  virtual ~ImageInput() override;
+
   virtual QString Name() override;
   virtual QString id() override;
   virtual QString Category() override;
   virtual QString Description() override;
 
+  virtual olive::PixelPrecision OutputPrecision() override;
+
+  NodeInput* filename_input();
+
+  /**
+   * @brief OCIO color space of the file, or empty if it's already in the working space (see olive::color)
+   */
+  NodeInput* colorspace_input();
+
   NodeOutput* texture_output();
 
 public slots:
   virtual void Process(const rational &time) override;
 
 private:
+  /**
+   * @brief The part of an ImageFile last uploaded in a context
+   */
+  struct Upload {
+    TextureBuffer buffer;
+
+    // The upload converted to the working space, if the file needs converting
+    TextureBuffer converted;
+
+    QString colorspace;
+
+    // Keeps the file open (and its decoded levels in memory) while it's still being rendered
+    ImageFilePtr file;
+
+    int level;
+
+    QRect region;
+  };
+
+  /**
+   * @brief The part of an ImageFile last converted for an evaluation rendering without a GPU
+   */
+  struct SoftwareUpload {
+    MemoryBuffer buffer;
+
+    QString colorspace;
+
+    ImageFilePtr file;
+
+    int level;
+
+    QRect region;
+
+    olive::color::ProcessorQuality quality;
+  };
+
+  /**
+   * @brief Returns this node's upload for the current context, creating it if necessary
+   */
+  Upload* GetUpload(QOpenGLContext* ctx);
+
+  /**
+   * @brief Draw an upload into its converted buffer through an OCIO processor
+   */
+  static void ConvertUpload(QOpenGLContext* ctx, Upload* upload, OCIO::ConstProcessorRcPtr processor, bool has_alpha);
+
+  /**
+   * @brief Returns this node's software upload for the current evaluation, creating it if necessary
+   */
+  SoftwareUpload* GetSoftwareUpload();
+
+  NodeInput* filename_input_;
+
+  NodeInput* colorspace_input_;
+
   NodeOutput* texture_output_;
 
-  QOpenGLTexture* texture_;
+  // Last upload in each context this node has rendered in
+  QHash<QOpenGLContext*, Upload*> uploads_;
+
+  // Last conversion in each evaluation rendering without a GPU (see NodeEvaluationContext::software())
+  QHash<Qt::HANDLE, SoftwareUpload*> software_uploads_;
+
+  QMutex uploads_mutex_;
 };
 
 #endif // IMAGE_H
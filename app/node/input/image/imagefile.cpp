@@ -0,0 +1,179 @@
+#include "imagefile.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QMutexLocker>
+
+#include "common/tracing.h"
+
+namespace {
+
+// Levels stop being halved once they're no larger than this either way
+const int kMinimumLevelSize = 256;
+
+// Every open file, they're removed once the last reference to them is gone
+QHash<QString, std::weak_ptr<ImageFile>> open_files;
+
+QMutex open_files_mutex;
+
+}
+
+ImageFile::ImageFile(const QString &filename, const QDateTime &last_modified) :
+  filename_(filename),
+  last_modified_(last_modified),
+  has_alpha_(true),
+  level_count_(0)
+{
+  // Only reads the header
+  QImageReader reader(filename_);
+  size_ = reader.size();
+
+  if (reader.imageFormat() != QImage::Format_Invalid) {
+    has_alpha_ = (QImage::toPixelFormat(reader.imageFormat()).alphaUsage() == QPixelFormat::UsesAlpha);
+  }
+
+  if (!size_.isValid()) {
+    // Some formats can't tell their size without decoding the image
+    QImage image = reader.read();
+
+    if (image.isNull()) {
+      qWarning() << "Failed to read image" << filename_ << reader.errorString();
+      return;
+    }
+
+    size_ = image.size();
+    has_alpha_ = image.hasAlphaChannel();
+    levels_.append(image.convertToFormat(QImage::Format_RGBA8888_Premultiplied));
+  }
+
+  level_count_ = 1;
+
+  while (LevelSize(level_count_ - 1).width() > kMinimumLevelSize
+         || LevelSize(level_count_ - 1).height() > kMinimumLevelSize) {
+    level_count_++;
+  }
+
+  levels_.resize(level_count_);
+}
+
+ImageFilePtr ImageFile::Get(const QString &filename)
+{
+  QFileInfo info(filename);
+  QString key = info.absoluteFilePath();
+  QDateTime last_modified = info.lastModified();
+
+  QMutexLocker locker(&open_files_mutex);
+
+  ImageFilePtr file = open_files.value(key).lock();
+
+  if (file == nullptr || file->last_modified_ != last_modified) {
+    file = std::make_shared<ImageFile>(key, last_modified);
+
+    open_files.insert(key, file);
+  }
+
+  // Forget files that aren't referenced any more
+  QHash<QString, std::weak_ptr<ImageFile>>::iterator i = open_files.begin();
+
+  while (i != open_files.end()) {
+    if (i.value().expired()) {
+      i = open_files.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  return file;
+}
+
+bool ImageFile::IsValid() const
+{
+  return level_count_ > 0;
+}
+
+const QString &ImageFile::filename() const
+{
+  return filename_;
+}
+
+const QSize &ImageFile::size() const
+{
+  return size_;
+}
+
+bool ImageFile::HasAlpha() const
+{
+  return has_alpha_;
+}
+
+int ImageFile::level_count() const
+{
+  return level_count_;
+}
+
+QSize ImageFile::LevelSize(int level) const
+{
+  return QSize(qMax(1, size_.width() >> level), qMax(1, size_.height() >> level));
+}
+
+int ImageFile::LevelForDivider(int divider) const
+{
+  int level = 0;
+
+  while (level + 1 < level_count_ && (2 << level) <= divider) {
+    level++;
+  }
+
+  return level;
+}
+
+QImage ImageFile::Level(int level)
+{
+  if (level < 0 || level >= level_count_) {
+    return QImage();
+  }
+
+  QMutexLocker locker(&levels_mutex_);
+
+  if (levels_.at(level).isNull()) {
+    levels_[level] = DecodeLevel(level);
+  }
+
+  return levels_.at(level);
+}
+
+QImage ImageFile::DecodeLevel(int level)
+{
+  Tracing::Span span("decoder", "ImageFile::DecodeLevel");
+
+  QSize level_size = LevelSize(level);
+
+  // Downscaling a finer level that's already decoded is cheaper than reading the file again
+  for (int i=level-1;i>=0;i--) {
+    if (!levels_.at(i).isNull()) {
+      return levels_.at(i).scaled(level_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+  }
+
+  // Readers that support it (e.g. JPEG) decode straight to a reduced size, the rest scale after decoding
+  QImageReader reader(filename_);
+
+  if (level > 0) {
+    reader.setScaledSize(level_size);
+  }
+
+  QImage image = reader.read();
+
+  if (image.isNull()) {
+    qWarning() << "Failed to read image" << filename_ << reader.errorString();
+    return image;
+  }
+
+  if (image.size() != level_size) {
+    image = image.scaled(level_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+  }
+
+  return image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+}
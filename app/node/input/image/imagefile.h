@@ -0,0 +1,103 @@
+#ifndef IMAGEFILE_H
+#define IMAGEFILE_H
+
+#include <memory>
+#include <QDateTime>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QVector>
+
+class ImageFile;
+
+using ImageFilePtr = std::shared_ptr<ImageFile>;
+
+/**
+ * @brief A still image file decoded into a lazily built MIP pyramid, shared by everything that reads the same file
+ *
+ * Level 0 is the image at full resolution and every following level is half the size of the one before it, down to
+ * the first level that's no larger than 256 pixels either way. Levels are only decoded once something asks for them,
+ * so a viewer at 1/4 resolution never decodes the full image if it can be read at a reduced size (see
+ * QImageReader::setScaledSize()), and a level is downscaled from a finer one instead if that one is already in memory.
+ *
+ * Every ImageInput referencing the same file gets the same ImageFile from Get(), so each file is only probed and
+ * decoded once however many nodes (and render threads) use it. The file is freed once nothing references it.
+ *
+ * Every function is safe to call from any thread.
+ */
+class ImageFile
+{
+public:
+  ImageFile(const QString& filename, const QDateTime& last_modified);
+
+  ImageFile(const ImageFile& other) = delete;
+  ImageFile(ImageFile&& other) = delete;
+  ImageFile& operator=(const ImageFile& other) = delete;
+  ImageFile& operator=(ImageFile&& other) = delete;
+
+  /**
+   * @brief Returns the shared ImageFile for a filename, opening it if nothing references it yet
+   *
+   * A file that was modified since it was opened is opened again.
+   */
+  static ImageFilePtr Get(const QString& filename);
+
+  /**
+   * @brief Returns FALSE if the file couldn't be read as an image
+   */
+  bool IsValid() const;
+
+  const QString& filename() const;
+
+  /**
+   * @brief Full resolution of the image
+   */
+  const QSize& size() const;
+
+  int level_count() const;
+
+  /**
+   * @brief Returns FALSE if the file's pixel format has no alpha channel (TRUE if it can't be told without decoding)
+   */
+  bool HasAlpha() const;
+
+  /**
+   * @brief Size of a MIP level (half of the previous level, rounded down but never less than 1)
+   */
+  QSize LevelSize(int level) const;
+
+  /**
+   * @brief Coarsest level that still has at least as many pixels as a frame rendered at a resolution divider
+   *
+   * Level `n` is 2^n times smaller than the image so it's chosen for dividers from 2^n up to 2^(n+1)-1.
+   */
+  int LevelForDivider(int divider) const;
+
+  /**
+   * @brief Returns a MIP level in QImage::Format_RGBA8888_Premultiplied, decoding it if necessary
+   *
+   * Threads requesting a level that's being decoded wait for it rather than decoding it again. Returns a null QImage
+   * if the file couldn't be decoded.
+   */
+  QImage Level(int level);
+
+private:
+  QImage DecodeLevel(int level);
+
+  QString filename_;
+
+  QDateTime last_modified_;
+
+  QSize size_;
+
+  bool has_alpha_;
+
+  int level_count_;
+
+  // Decoded levels, null until requested
+  QVector<QImage> levels_;
+
+  QMutex levels_mutex_;
+};
+
+#endif // IMAGEFILE_H
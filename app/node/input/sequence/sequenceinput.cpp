@@ -0,0 +1,316 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "sequenceinput.h"
+
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+#include "render/pixelformat.h"
+#include "render/renderbackend.h"
+
+const qint64 SequenceInput::kFrameBudget = 256 * 1024 * 1024;
+
+// How deep the sequence being processed or hashed on this thread is nested
+static thread_local int nesting_depth = 0;
+
+SequenceInput::SequenceInput() :
+  allocated_(0),
+  access_counter_(0)
+{
+  sequence_input_ = new NodeInput();
+  sequence_input_->add_data_input(NodeParam::kString);
+  sequence_input_->set_name(tr("Sequence"));
+  AddParameter(sequence_input_);
+
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+}
+
+SequenceInput::~SequenceInput()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  ClearFrames();
+}
+
+QString SequenceInput::Name()
+{
+  return tr("Sequence");
+}
+
+QString SequenceInput::id()
+{
+  return "org.olivevideoeditor.Olive.sequenceinput";
+}
+
+QString SequenceInput::Category()
+{
+  return tr("Input");
+}
+
+QString SequenceInput::Description()
+{
+  return tr("Show another sequence inside this one.");
+}
+
+bool SequenceInput::IsTimeDependent()
+{
+  return true;
+}
+
+void SequenceInput::Hash(QCryptographicHash *hash, const rational &time)
+{
+  hash->addData(id().toUtf8());
+
+  NodeOutput* nested = NestedOutput();
+
+  if (nested == nullptr || nesting_depth >= kMaxDepth) {
+    return;
+  }
+
+  // Identical nested content hashes identically wherever it's nested
+  nesting_depth++;
+  nested->Hash(hash, time);
+  nesting_depth--;
+}
+
+NodeInput *SequenceInput::sequence_input()
+{
+  return sequence_input_;
+}
+
+NodeOutput *SequenceInput::texture_output()
+{
+  return texture_output_;
+}
+
+Sequence *SequenceInput::sequence()
+{
+  return sequence_;
+}
+
+void SequenceInput::SetSequence(Sequence *sequence)
+{
+  if (sequence != nullptr && sequence == parent()) {
+    return;
+  }
+
+  if (viewer_) {
+    disconnect(viewer_,
+               SIGNAL(Invalidated(const rational&, const rational&, bool)),
+               this,
+               SLOT(NestedInvalidated(const rational&, const rational&, bool)));
+  }
+
+  sequence_ = sequence;
+  viewer_ = nullptr;
+
+  if (sequence != nullptr) {
+    foreach (Node* n, sequence->nodes()) {
+      ViewerOutput* viewer = qobject_cast<ViewerOutput*>(n);
+
+      if (viewer != nullptr) {
+        viewer_ = viewer;
+        break;
+      }
+    }
+
+    NodeKeyframe key;
+    key.set_time(rational(0));
+    key.set_value(NodeValue(sequence->Item::name()));
+    sequence_input_->set_keyframes({key});
+  }
+
+  if (viewer_) {
+    // Edits inside the nested sequence happen on the main thread along with ours, relay them as they happen
+    connect(viewer_,
+            SIGNAL(Invalidated(const rational&, const rational&, bool)),
+            this,
+            SLOT(NestedInvalidated(const rational&, const rational&, bool)),
+            Qt::DirectConnection);
+  }
+
+  ClearCachedValues();
+}
+
+void SequenceInput::ClearFrames()
+{
+  QMutexLocker locker(&frames_mutex_);
+
+  frames_.clear();
+  shown_.clear();
+  allocated_ = 0;
+}
+
+void SequenceInput::Process(const rational &time)
+{
+  NodeOutput* nested = NestedOutput();
+
+  if (nested == nullptr || nesting_depth >= kMaxDepth) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  // Only whole, exact frames rendered on the GPU are cached (keyframe-only ones are approximations)
+  bool cacheable = (ctx != nullptr
+                    && !NodeEvaluationContext::CurrentIsSoftware()
+                    && NodeEvaluationContext::CurrentTile().isNull()
+                    && !NodeEvaluationContext::CurrentKeyframesOnly());
+
+  if (!cacheable) {
+    nesting_depth++;
+    texture_output_->set_value(nested->get_value(time));
+    nesting_depth--;
+    return;
+  }
+
+  int divider = NodeEvaluationContext::CurrentDivider();
+
+  nesting_depth++;
+  QByteArray key = nested->ContentHash(time);
+  nesting_depth--;
+
+  key.append(reinterpret_cast<const char*>(&divider), sizeof(divider));
+
+  frames_mutex_.lock();
+
+  QHash<QByteArray, CachedFrame>::iterator cached = frames_.find(key);
+
+  if (cached != frames_.end()) {
+    cached->last_access = ++access_counter_;
+
+    std::shared_ptr<TextureBuffer> buffer = cached->buffer;
+    shown_.insert(ctx, buffer);
+
+    frames_mutex_.unlock();
+
+    texture_output_->set_value(NodeValue::Texture(buffer->texture()));
+    return;
+  }
+
+  frames_mutex_.unlock();
+
+  // Render the nested sequence in this evaluation, like any other input
+  nesting_depth++;
+  NodeValue value = nested->get_value(time);
+  nesting_depth--;
+
+  GLuint texture = value.toTexture();
+
+  if (texture == 0) {
+    texture_output_->set_value(value);
+    return;
+  }
+
+  std::shared_ptr<TextureBuffer> buffer = CopyFrame(ctx, texture);
+
+  if (buffer == nullptr) {
+    texture_output_->set_value(value);
+    return;
+  }
+
+  CachedFrame frame;
+  frame.buffer = buffer;
+  frame.bytes = static_cast<qint64>(buffer->width()) * buffer->height()
+      * PixelService::BytesPerPixel(buffer->format());
+
+  frames_mutex_.lock();
+
+  // Free least recently used frames until this one fits
+  while (!frames_.isEmpty() && allocated_ + frame.bytes > kFrameBudget) {
+    QHash<QByteArray, CachedFrame>::iterator oldest = frames_.begin();
+
+    for (QHash<QByteArray, CachedFrame>::iterator it=frames_.begin();it!=frames_.end();it++) {
+      if (it->last_access < oldest->last_access) {
+        oldest = it;
+      }
+    }
+
+    allocated_ -= oldest->bytes;
+    frames_.erase(oldest);
+  }
+
+  frame.last_access = ++access_counter_;
+  allocated_ += frame.bytes;
+
+  frames_.insert(key, frame);
+  shown_.insert(ctx, buffer);
+
+  frames_mutex_.unlock();
+
+  texture_output_->set_value(NodeValue::Texture(buffer->texture()));
+}
+
+NodeOutput *SequenceInput::NestedOutput()
+{
+  if (!viewer_ || viewer_->texture_input()->edges().isEmpty()) {
+    return nullptr;
+  }
+
+  return viewer_->texture_input()->edges().first()->output();
+}
+
+std::shared_ptr<TextureBuffer> SequenceInput::CopyFrame(QOpenGLContext *ctx, GLuint texture)
+{
+  QSize size = olive::render_backend->TextureSize(texture);
+
+  if (size.isEmpty()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<TextureBuffer> buffer = std::make_shared<TextureBuffer>();
+  buffer->Create(ctx, olive::color::kWorkingFormat, size.width(), size.height());
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  buffer->BindBuffer();
+
+  xf->glViewport(0, 0, size.width(), size.height());
+  xf->glBindTexture(GL_TEXTURE_2D, texture);
+
+  olive::gl::Blit(olive::gl::GetDefaultPipeline());
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  buffer->ReleaseBuffer();
+
+  // Other render threads may show the frame as soon as it's cached, so it has to be finished on the GPU first
+  RenderBackend::Fence fence = olive::render_backend->CreateFence();
+  olive::render_backend->WaitFence(fence);
+  olive::render_backend->DestroyFence(fence);
+
+  return buffer;
+}
+
+void SequenceInput::NestedInvalidated(const rational &start_range, const rational &end_range, bool all)
+{
+  // Nested frames are cached by content, so only values cached by time need invalidating
+  if (all) {
+    ClearCachedValues();
+  } else {
+    InvalidateCache(start_range, end_range);
+  }
+}
@@ -0,0 +1,151 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SEQUENCEINPUT_H
+#define SEQUENCEINPUT_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QPointer>
+#include <memory>
+
+#include "node/node.h"
+#include "node/output/viewer/viewer.h"
+#include "project/item/sequence/sequence.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A node that shows another sequence, for nesting sequences inside each other
+ *
+ * The nested sequence is rendered at the same time as this node (whatever is connected to its viewer is pulled in
+ * the same evaluation) and its frames are kept in a cache of their own. They're keyed by the nested output's
+ * NodeOutput::ContentHash() and the resolution divider, so edits to the outer sequence never re-render nested content
+ * that hasn't changed, and identical nested frames (stills, repeated nests) are only rendered once. Only whole frames
+ * rendered on the GPU are cached, tiles and software renders pass straight through.
+ *
+ * Hash() adds the nested output's content rather than anything about this node, so outer frames showing unchanged
+ * nested content keep their own cache entries too. Edits inside the nested sequence are relayed from its viewer to
+ * this node's InvalidateCache() with the ranges they affect, so only those ranges of the outer sequence are
+ * invalidated. Cached nested frames never need invalidating since changed content hashes differently, stale frames
+ * are simply never looked up again and are the first to be evicted.
+ *
+ * The nested sequence is saved by name (see sequence_input()) and found again when the outer sequence's graph is
+ * loaded (see Sequence::LoadGraph()).
+ */
+class SequenceInput : public Node
+{
+  Q_OBJECT
+public:
+  SequenceInput();
+
+  virtual ~SequenceInput() override;
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  /**
+   * @brief Returns TRUE, the nested sequence can change at every time
+   */
+  virtual bool IsTimeDependent() override;
+
+  virtual void Hash(QCryptographicHash* hash, const rational& time) override;
+
+  /**
+   * @brief Name of the nested sequence
+   */
+  NodeInput* sequence_input();
+
+  NodeOutput* texture_output();
+
+  Sequence* sequence();
+
+  /**
+   * @brief Set the sequence to nest, or nullptr for none
+   *
+   * Sequences nesting this node's own graph are refused, since they'd nest themselves forever.
+   */
+  void SetSequence(Sequence* sequence);
+
+  /**
+   * @brief Free every cached frame
+   */
+  void ClearFrames();
+
+  /**
+   * @brief Most bytes of VRAM cached nested frames of one node may use
+   */
+  static const qint64 kFrameBudget;
+
+  /**
+   * @brief Deepest sequences may be nested inside each other before nested content is left out
+   */
+  static const int kMaxDepth = 16;
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief Returns the output connected to the nested sequence's viewer, or nullptr if there is none
+   */
+  NodeOutput* NestedOutput();
+
+  /**
+   * @brief Draw a nested frame into a new buffer for the cache
+   */
+  static std::shared_ptr<TextureBuffer> CopyFrame(QOpenGLContext* ctx, GLuint texture);
+
+  struct CachedFrame {
+    std::shared_ptr<TextureBuffer> buffer;
+    qint64 bytes;
+    qint64 last_access;
+  };
+
+  NodeInput* sequence_input_;
+
+  NodeOutput* texture_output_;
+
+  QPointer<Sequence> sequence_;
+
+  QPointer<ViewerOutput> viewer_;
+
+  // Nested frames by content hash and divider
+  QHash<QByteArray, CachedFrame> frames_;
+
+  // The frame last shown in each context, kept alive until that context moves on even if it's evicted meanwhile
+  QHash<QOpenGLContext*, std::shared_ptr<TextureBuffer> > shown_;
+
+  qint64 allocated_;
+
+  qint64 access_counter_;
+
+  QMutex frames_mutex_;
+
+private slots:
+  /**
+   * @brief Connected to the nested viewer's ViewerOutput::Invalidated()
+   */
+  void NestedInvalidated(const rational& start_range, const rational& end_range, bool all);
+};
+
+#endif // SEQUENCEINPUT_H
@@ -28,7 +28,7 @@ NodeKeyframe::NodeKeyframe() :
 
 }
 
-const rational &NodeKeyframe::time()
+const rational &NodeKeyframe::time() const
 {
   return time_;
 }
@@ -38,17 +38,17 @@ void NodeKeyframe::set_time(const rational &time)
   time_ = time;
 }
 
-const QVariant &NodeKeyframe::value()
+const NodeValue &NodeKeyframe::value() const
 {
   return value_;
 }
 
-void NodeKeyframe::set_value(const QVariant &value)
+void NodeKeyframe::set_value(const NodeValue &value)
 {
   value_ = value;
 }
 
-const NodeKeyframe::Type &NodeKeyframe::type()
+const NodeKeyframe::Type &NodeKeyframe::type() const
 {
   return type_;
 }
@@ -57,3 +57,23 @@ void NodeKeyframe::set_type(const NodeKeyframe::Type &type)
 {
   type_ = type;
 }
+
+const QPointF &NodeKeyframe::bezier_control_in() const
+{
+  return bezier_control_in_;
+}
+
+void NodeKeyframe::set_bezier_control_in(const QPointF &control)
+{
+  bezier_control_in_ = control;
+}
+
+const QPointF &NodeKeyframe::bezier_control_out() const
+{
+  return bezier_control_out_;
+}
+
+void NodeKeyframe::set_bezier_control_out(const QPointF &control)
+{
+  bezier_control_out_ = control;
+}
@@ -21,9 +21,10 @@
 #ifndef NODEKEYFRAME_H
 #define NODEKEYFRAME_H
 
-#include <QVariant>
+#include <QPointF>
 
 #include "common/rational.h"
+#include "node/value.h"
 
 /**
  * @brief A point of data to be used at a certain time and interpolated with other data
@@ -49,27 +50,43 @@ public:
   /**
    * @brief The time this keyframe is set at
    */
-  const rational& time();
+  const rational& time() const;
   void set_time(const rational& time);
 
   /**
    * @brief The value of this keyframe (i.e. the value to use at this keyframe's time)
    */
-  const QVariant& value();
-  void set_value(const QVariant &value);
+  const NodeValue& value() const;
+  void set_value(const NodeValue &value);
 
   /**
    * @brief The method of interpolation to use with this keyframe
    */
-  const Type& type();
+  const Type& type() const;
   void set_type(const Type& type);
 
+  /**
+   * @brief Bezier control points, relative to this keyframe, used with kBezier
+   *
+   * X is in seconds and Y in the keyframe's value units. The "in" control point shapes the curve arriving at this
+   * keyframe (its X is usually negative) and the "out" control point shapes the curve leaving it. Both default to
+   * (0, 0), which makes a bezier segment linear.
+   */
+  const QPointF& bezier_control_in() const;
+  void set_bezier_control_in(const QPointF& control);
+  const QPointF& bezier_control_out() const;
+  void set_bezier_control_out(const QPointF& control);
+
 private:
   rational time_;
 
-  QVariant value_;
+  NodeValue value_;
 
   Type type_;
+
+  QPointF bezier_control_in_;
+
+  QPointF bezier_control_out_;
 };
 
 #endif // NODEKEYFRAME_H
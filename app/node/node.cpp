@@ -20,9 +20,21 @@
 
 #include "node.h"
 
+#include <QAtomicInteger>
+
 #include "common/qobjectlistcast.h"
 
-Node::Node()
+// Identifies the invalidation currently being relayed through the graph, starting from 1 so 0 is never current
+static QAtomicInteger<quint64> last_invalidation_pass(0);
+
+// Depth of nested invalidations on this thread, an invalidation starting at depth 0 starts a new pass
+static thread_local int invalidation_depth = 0;
+static thread_local quint64 current_invalidation_pass = 0;
+
+Node::Node() :
+  invalidated_all_(false),
+  invalidation_pass_(0),
+  pass_all_(false)
 {
 }
 
@@ -38,6 +50,95 @@ QString Node::Description()
   return QString();
 }
 
+olive::PixelPrecision Node::OutputPrecision()
+{
+  return olive::PIXEL_PRECISION_FULL;
+}
+
+olive::PixelChannels Node::OutputChannels()
+{
+  return olive::PIXEL_CHANNELS_RGBA;
+}
+
+bool Node::IsTimeDependent()
+{
+  return false;
+}
+
+bool Node::FusesInput(NodeInput *input)
+{
+  Q_UNUSED(input)
+
+  return false;
+}
+
+bool Node::RunsOnCPU()
+{
+  return false;
+}
+
+QRect Node::RegionOfInterest(NodeInput *input, const QRect &region, const rational &time)
+{
+  Q_UNUSED(input)
+  Q_UNUSED(time)
+
+  return region;
+}
+
+bool Node::UsesInput(NodeInput *input, int index, const rational &time)
+{
+  Q_UNUSED(input)
+  Q_UNUSED(index)
+  Q_UNUSED(time)
+
+  return true;
+}
+
+TimeRange Node::InputUseRange(NodeInput *input, int index, const rational &time)
+{
+  Q_UNUSED(input)
+  Q_UNUSED(index)
+  Q_UNUSED(time)
+
+  return TimeRange::All();
+}
+
+bool Node::DomainOfDefinition(NodeOutput *output, const rational &time, QRect *bounds)
+{
+  Q_UNUSED(output)
+  Q_UNUSED(time)
+  Q_UNUSED(bounds)
+
+  return false;
+}
+
+void Node::ProcessSamples(NodeOutput *output, const QVector<rational> &times, const NodeSampleFunction &consume)
+{
+  for (int i=0;i<times.size();i++) {
+    consume(i, output->get_value(times.at(i)));
+  }
+}
+
+void Node::Hash(QCryptographicHash *hash, const rational &time)
+{
+  hash->addData(id().toUtf8());
+
+  if (IsTimeDependent()) {
+    rational t = time;
+
+    hash->addData(QByteArray::number(static_cast<qint64>(t.numerator())));
+    hash->addData(QByteArray::number(static_cast<qint64>(t.denominator())));
+  }
+
+  QList<NodeParam*> params = parameters();
+
+  foreach (NodeParam* param, params) {
+    if (param->type() == NodeParam::kInput) {
+      static_cast<NodeInput*>(param)->Hash(hash, time);
+    }
+  }
+}
+
 void Node::AddParameter(NodeParam *param)
 {
   param->setParent(this);
@@ -48,6 +149,16 @@ void Node::AddParameter(NodeParam *param)
 
 void Node::InvalidateCache(const rational &start_range, const rational &end_range)
 {
+  if (invalidation_depth == 0) {
+    current_invalidation_pass = ++last_invalidation_pass;
+  }
+
+  if (!RecordInvalidation(TimeRange(start_range, end_range), false)) {
+    return;
+  }
+
+  invalidation_depth++;
+
   QList<NodeParam *> params = parameters();
 
   // Loop through all parameters (there should be no children that are not NodeParams)
@@ -56,11 +167,86 @@ void Node::InvalidateCache(const rational &start_range, const rational &end_rang
 
     // If the Node is an output, relay the signal to any Nodes that are connected to it
     if (param->type() == NodeParam::kOutput) {
+      static_cast<NodeOutput*>(param)->InvalidateCachedValues(start_range, end_range);
+
       for (int i=0;i<param->edges().size();i++) {
         param->edges().at(i)->input()->parent()->InvalidateCache(start_range, end_range);
       }
     }
   }
+
+  invalidation_depth--;
+}
+
+void Node::ClearCachedValues()
+{
+  if (invalidation_depth == 0) {
+    current_invalidation_pass = ++last_invalidation_pass;
+  }
+
+  if (!RecordInvalidation(TimeRange(), true)) {
+    return;
+  }
+
+  invalidation_depth++;
+
+  QList<NodeParam *> params = parameters();
+
+  for (int i=0;i<params.size();i++) {
+    NodeParam* param = params.at(i);
+
+    if (param->type() == NodeParam::kOutput) {
+      static_cast<NodeOutput*>(param)->ClearCachedValues();
+
+      for (int j=0;j<param->edges().size();j++) {
+        param->edges().at(j)->input()->parent()->ClearCachedValues();
+      }
+    }
+  }
+
+  invalidation_depth--;
+}
+
+TimeRangeList Node::TakeInvalidatedRanges(bool *all)
+{
+  QMutexLocker locker(&invalidation_mutex_);
+
+  TimeRangeList ranges = invalidated_ranges_;
+
+  if (all != nullptr) {
+    *all = invalidated_all_;
+  }
+
+  invalidated_ranges_.clear();
+  invalidated_all_ = false;
+
+  return ranges;
+}
+
+bool Node::RecordInvalidation(const TimeRange &range, bool all)
+{
+  QMutexLocker locker(&invalidation_mutex_);
+
+  if (invalidation_pass_ != current_invalidation_pass) {
+    invalidation_pass_ = current_invalidation_pass;
+    pass_ranges_.clear();
+    pass_all_ = false;
+  }
+
+  // Already relayed along another path
+  if (pass_all_ || (!all && pass_ranges_.Contains(range))) {
+    return false;
+  }
+
+  if (all) {
+    pass_all_ = true;
+    invalidated_all_ = true;
+  } else {
+    pass_ranges_.Insert(range);
+    invalidated_ranges_.Insert(range);
+  }
+
+  return true;
 }
 
 NodeParam *Node::ParamAt(int index)
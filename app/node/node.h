@@ -21,11 +21,16 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <QCryptographicHash>
+#include <QMutex>
 #include <QObject>
+#include <QRect>
 
 #include "common/rational.h"
+#include "common/timerange.h"
 #include "node/input.h"
 #include "node/output.h"
+#include "render/pixelformat.h"
 
 /**
  * @brief A single processing unit that can be connected with others to create intricate processing systems
@@ -82,6 +87,112 @@ public:
    */
   virtual QString Description();
 
+  /**
+   * @brief Return the minimum precision this node's output buffer needs (optional for subclassing)
+   *
+   * The renderer uses this with OutputChannels() to pick the cheapest buffer format for this node's output (see
+   * PixelService::NegotiateFormat()). Nodes that produce low precision images (e.g. 8-bit sources or mattes) should
+   * override this to save memory and bandwidth. Defaults to PIXEL_PRECISION_FULL, i.e. whatever precision the renderer
+   * uses.
+   */
+  virtual olive::PixelPrecision OutputPrecision();
+
+  /**
+   * @brief Return the channels this node's output buffer needs (optional for subclassing)
+   *
+   * Defaults to PIXEL_CHANNELS_RGBA. Nodes that only output a matte or are always opaque can override this to save
+   * memory and bandwidth.
+   */
+  virtual olive::PixelChannels OutputChannels();
+
+  /**
+   * @brief Return whether this node's output changes over time by itself (optional for subclassing)
+   *
+   * Defaults to FALSE, i.e. the node's outputs only depend on its inputs, which lets subgraphs with no animated inputs
+   * be processed once and reused at every time (see NodeOutput::IsTimeInvariant()). Nodes that produce different
+   * output at different times regardless of their inputs (e.g. decoding video) must override this to return TRUE.
+   */
+  virtual bool IsTimeDependent();
+
+  /**
+   * @brief Return whether this node evaluates whatever is connected to an input itself (optional for subclassing)
+   *
+   * Defaults to FALSE. A node returning TRUE doesn't pull that input's value, it processes the connected node as part
+   * of its own processing instead (see PointwiseProcessor), so NodeGraphPlan skips processing the connected output
+   * when that node is its only consumer.
+   */
+  virtual bool FusesInput(NodeInput* input);
+
+  /**
+   * @brief Return whether this node's Process() never uses OpenGL (optional for subclassing)
+   *
+   * Defaults to FALSE. Independent branches of a graph made only of nodes returning TRUE (e.g. decoding footage) are
+   * processed on worker threads in parallel with the rest of the graph (see NodeGraphPlan), since workers have no
+   * OpenGL context.
+   */
+  virtual bool RunsOnCPU();
+
+  /**
+   * @brief Add everything that determines this node's output at a time to a hash (optional for subclassing)
+   *
+   * Used to identify frames by their content rather than their time (see NodeOutput::ContentHash()), so two times (or
+   * two copies of a graph) hashing the same are assumed to render the same. The default adds id(), the time if the
+   * node IsTimeDependent() and the value of every input at the time (see NodeInput::Hash()). Nodes whose output
+   * depends on anything else must override this and add it too.
+   */
+  virtual void Hash(QCryptographicHash* hash, const rational& time);
+
+  /**
+   * @brief Return the region of the frame needed from an input to render a region of this node (optional for
+   *        subclassing)
+   *
+   * Regions are in pixels of the divided frame, like tiles (see NodeEvaluationContext::tile()). Connected textures
+   * are pulled over the region returned, so sources only render (and allocate buffers for) what's actually needed, and
+   * the node must expect its input texture to cover that region rather than its own. An empty region means nothing
+   * is needed from the input and it won't be pulled.
+   *
+   * Defaults to `region`. Nodes that move pixels (e.g. TransformNode) should override this.
+   */
+  virtual QRect RegionOfInterest(NodeInput* input, const QRect& region, const rational& time);
+
+  /**
+   * @brief Return whether this node pulls the `index`th output connected to an input at a time (optional for
+   *        subclassing)
+   *
+   * Connections a node doesn't use aren't evaluated at all: NodeInput::get_values() leaves their values empty and
+   * NodeGraphPlan skips them along with everything upstream that nothing else needs. A layer that's fully transparent
+   * costs nothing this way. The answer must not depend on anything connected to `input` itself.
+   *
+   * Defaults to TRUE.
+   */
+  virtual bool UsesInput(NodeInput* input, int index, const rational& time);
+
+  /**
+   * @brief Return a range of time around `time` over which UsesInput() gives the same answer for a connection
+   *        (optional for subclassing)
+   *
+   * NodeGraphPlan reuses the connections it found in use at one time for every time in the range, so it only walks
+   * the parts of the graph that are in use rather than asking every node again for every frame. The range may be
+   * narrower than the truth but never wider.
+   *
+   * Defaults to all time, which is right for nodes using every connection. Nodes overriding UsesInput() must override
+   * this too.
+   */
+  virtual TimeRange InputUseRange(NodeInput* input, int index, const rational& time);
+
+  /**
+   * @brief Find the bounds of the pixels an output can make visible at a time (optional for subclassing)
+   *
+   * The "domain of definition": outside `bounds` (in pixels of the divided frame) the output is transparent, so it
+   * isn't processed at all for tiles outside them (see NodeOutput::get_value()) and consumers can request less of it.
+   *
+   * @return
+   *
+   * FALSE if the output may cover any pixel, which is the default. Nodes whose output is known to be smaller than the
+   * frame (e.g. TransformNode scaling its input down) should override this.
+   */
+  virtual bool DomainOfDefinition(NodeOutput* output, const rational& time, QRect* bounds);
+
   /**
    * @brief Add a parameter to this node
    *
@@ -99,9 +210,30 @@ public:
    * Default behavior is to relay this signal to all connected outputs, which will need to be done as to not break
    * the DAG. Even if the time needs to be transformed somehow (e.g. converting media time to sequence time), you can
    * call this function with transformed time and relay the signal that way.
+   *
+   * Invalidated ranges are merged into a set that caches can take with TakeInvalidatedRanges() to know exactly what to
+   * re-render. When a range reaches a Node along several paths of the same invalidation, it's only relayed the first
+   * time.
    */
   virtual void InvalidateCache(const rational& start_range, const rational& end_range);
 
+  /**
+   * @brief Invalidate every value cached by this Node's outputs (and those of all Nodes depending on them)
+   *
+   * Called when an input of this Node is connected or disconnected, since every time is affected. Like
+   * InvalidateCache(), subclasses overriding this must call the base function at the end.
+   */
+  virtual void ClearCachedValues();
+
+  /**
+   * @brief Take the ranges invalidated since the last call, merged and sorted
+   *
+   * @param all
+   *
+   * Set to TRUE if every time was invalidated (see ClearCachedValues()), in which case the ranges can be ignored.
+   */
+  TimeRangeList TakeInvalidatedRanges(bool* all = nullptr);
+
   /**
    * @brief Return the parameter at a given index
    */
@@ -123,6 +255,16 @@ public:
    */
   int IndexOfParameter(NodeParam* param);
 
+  /**
+   * @brief Process one of this node's outputs at several times (optional for subclassing)
+   *
+   * Called by NodeOutput::get_samples() with distinct times in ascending order. `consume` must be called once for each
+   * time with the output's value, before the next time is processed. The default calls NodeOutput::get_value() for
+   * each time, nodes that can share work between samples (e.g. reading a source once for all of them, or keeping GPU
+   * state bound) should override it.
+   */
+  virtual void ProcessSamples(NodeOutput* output, const QVector<rational>& times, const NodeSampleFunction& consume);
+
 public slots:
   /**
    * @brief The main processing function
@@ -157,6 +299,28 @@ signals:
    * The edge that was removed
    */
   void EdgeRemoved(NodeEdgePtr edge);
+
+private:
+  /**
+   * @brief Record an invalidation of this Node
+   *
+   * @return
+   *
+   * FALSE if the current invalidation already reached this Node with a range covering this one, so there's nothing
+   * left to relay.
+   */
+  bool RecordInvalidation(const TimeRange& range, bool all);
+
+  // Ranges invalidated since TakeInvalidatedRanges() was last called
+  TimeRangeList invalidated_ranges_;
+  bool invalidated_all_;
+
+  // Ranges (or all of time) the invalidation identified by invalidation_pass_ has already relayed through this Node
+  quint64 invalidation_pass_;
+  TimeRangeList pass_ranges_;
+  bool pass_all_;
+
+  QMutex invalidation_mutex_;
 };
 
 #endif // NODE_H
@@ -0,0 +1,612 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ofxnode.h"
+
+#include <QDebug>
+#include <QMatrix4x4>
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/gl/functions.h"
+
+namespace {
+
+const char* kIdPrefix = "org.olivevideoeditor.Olive.ofx.";
+
+// How far past a tile a plugin can sample without leaving seams (RendererProcessor's default tile margin)
+const int kTileMargin = 32;
+
+// Bytes per RGBA32F pixel, for GL_PACK_ROW_LENGTH and GL_UNPACK_ROW_LENGTH
+const int kPixelBytes = 4 * static_cast<int>(sizeof(float));
+
+QVector<int> RenderWindow(const OfxPluginHost::Render* render)
+{
+  return QVector<int>() << render->bounds.x1 << render->bounds.y1 << render->bounds.x2 << render->bounds.y2;
+}
+
+QVector<double> RenderScale(const OfxPluginHost::Render* render)
+{
+  return QVector<double>() << render->render_scale << render->render_scale;
+}
+
+}
+
+OfxNode::OfxNode(OfxPluginHost::Plugin *plugin) :
+  plugin_(plugin),
+  effect_(new OfxPluginHost::Effect(plugin)),
+  frame_varying_(false)
+{
+  effect_->CopyFrom(plugin->descriptor);
+
+  effect_->properties.SetString(kOfxImageEffectPropContext, plugin->context);
+  effect_->properties.SetInt(kOfxPropIsInteractive, 0);
+  effect_->properties.SetPointer(kOfxPropInstanceData, nullptr);
+  effect_->properties.SetDouble(kOfxImageEffectPropFrameRate, 1.0);
+  effect_->properties.SetDouble(kOfxImageEffectPropProjectPixelAspectRatio, 1.0);
+
+  foreach (OfxPluginHost::Clip* c, effect_->clips) {
+    c->properties.SetInt(kOfxImageClipPropConnected,
+                         c->name == kOfxImageEffectSimpleSourceClipName || c->name == kOfxImageEffectOutputClipName);
+  }
+
+  texture_input_ = new NodeInput();
+  texture_input_->add_data_input(NodeParam::kTexture);
+  AddParameter(texture_input_);
+
+  // Inputs are created in the order the plugin defined its parameters, which is how projects save them
+  foreach (OfxPluginHost::Param* p, effect_->params.params) {
+    QString label = QString::fromUtf8(p->properties.GetString(kOfxPropLabel));
+    const OfxPropertySet& props = p->properties;
+
+    if (p->type == kOfxParamTypeInteger || p->type == kOfxParamTypeChoice) {
+      p->inputs.append(AddParamInput(label, NodeParam::kInt, NodeValue(props.GetInt(kOfxParamPropDefault))));
+    } else if (p->type == kOfxParamTypeDouble) {
+      p->inputs.append(AddParamInput(label, NodeParam::kFloat, NodeValue(props.GetDouble(kOfxParamPropDefault))));
+    } else if (p->type == kOfxParamTypeBoolean) {
+      p->inputs.append(AddParamInput(label, NodeParam::kBoolean, NodeValue(props.GetInt(kOfxParamPropDefault) != 0)));
+    } else if (p->type == kOfxParamTypeString) {
+      QString value = QString::fromUtf8(props.GetString(kOfxParamPropDefault));
+      p->inputs.append(AddParamInput(label, NodeParam::kString, NodeValue(value)));
+    } else if (p->type == kOfxParamTypeRGB || p->type == kOfxParamTypeRGBA) {
+      double alpha = (p->type == kOfxParamTypeRGBA) ? props.GetDouble(kOfxParamPropDefault, 3, 1.0) : 1.0;
+      QColor color = QColor::fromRgbF(props.GetDouble(kOfxParamPropDefault, 0),
+                                      props.GetDouble(kOfxParamPropDefault, 1),
+                                      props.GetDouble(kOfxParamPropDefault, 2),
+                                      alpha);
+
+      p->inputs.append(AddParamInput(label, NodeParam::kColor, NodeValue(color)));
+    } else if (p->type == kOfxParamTypeDouble2D || p->type == kOfxParamTypeDouble3D
+               || p->type == kOfxParamTypeInteger2D || p->type == kOfxParamTypeInteger3D) {
+      // Vectors get an input per dimension
+      static const char* dimension_names[] = {"X", "Y", "Z"};
+
+      bool is_3d = (p->type == kOfxParamTypeDouble3D || p->type == kOfxParamTypeInteger3D);
+      bool is_integer = (p->type == kOfxParamTypeInteger2D || p->type == kOfxParamTypeInteger3D);
+
+      for (int i=0;i<(is_3d ? 3 : 2);i++) {
+        QString name = tr("%1 %2").arg(label, QLatin1String(dimension_names[i]));
+
+        if (is_integer) {
+          p->inputs.append(AddParamInput(name, NodeParam::kInt, NodeValue(props.GetInt(kOfxParamPropDefault, i))));
+        } else {
+          p->inputs.append(AddParamInput(name, NodeParam::kFloat,
+                                         NodeValue(props.GetDouble(kOfxParamPropDefault, i))));
+        }
+      }
+    }
+
+    // Groups, pages, push buttons and custom parameters have no value Olive can edit
+  }
+
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+
+  if (!OfxPluginHost::Succeeded(olive::ofx_host.CallAction(plugin_, kOfxActionCreateInstance, effect_->handle()))) {
+    qWarning() << "Failed to create an instance of OpenFX plugin" << plugin_->identifier;
+  }
+
+  // Defaults for everything a plugin may set, Olive only reads whether the output varies over time
+  OfxPropertySet preferences;
+  preferences.SetInt(kOfxImageEffectFrameVarying, 0);
+  preferences.SetInt(kOfxImageClipPropContinuousSamples, 0);
+  preferences.SetDouble(kOfxImageEffectPropFrameRate, 1.0);
+  preferences.SetDouble(kOfxImagePropPixelAspectRatio, 1.0);
+  preferences.SetString(kOfxImageEffectPropPreMultiplication, kOfxImagePreMultiplied);
+  preferences.SetString(kOfxImageClipPropFieldOrder, kOfxImageFieldNone);
+
+  foreach (OfxPluginHost::Clip* c, effect_->clips) {
+    preferences.SetString(QByteArray("OfxImageClipPropComponents_" + c->name).constData(), kOfxImageComponentRGBA);
+    preferences.SetString(QByteArray("OfxImageClipPropDepth_" + c->name).constData(), kOfxBitDepthFloat);
+    preferences.SetDouble(QByteArray("OfxImageClipPropPAR_" + c->name).constData(), 1.0);
+  }
+
+  if (olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionGetClipPreferences, effect_->handle(), nullptr,
+                                 &preferences) == kOfxStatOK) {
+    frame_varying_ = (preferences.GetInt(kOfxImageEffectFrameVarying) != 0);
+  }
+}
+
+OfxNode::~OfxNode()
+{
+  olive::ofx_host.CallAction(plugin_, kOfxActionDestroyInstance, effect_->handle());
+
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(gl_buffers_);
+  qDeleteAll(software_buffers_);
+
+  delete effect_;
+}
+
+OfxNode *OfxNode::CreateFromID(const QString &id)
+{
+  if (!id.startsWith(QLatin1String(kIdPrefix))) {
+    return nullptr;
+  }
+
+  OfxPluginHost::Plugin* plugin = olive::ofx_host.FindPlugin(id.mid(static_cast<int>(qstrlen(kIdPrefix))).toUtf8());
+
+  if (plugin == nullptr) {
+    return nullptr;
+  }
+
+  return new OfxNode(plugin);
+}
+
+QString OfxNode::Name()
+{
+  return plugin_->label;
+}
+
+QString OfxNode::id()
+{
+  return QLatin1String(kIdPrefix) + QString::fromUtf8(plugin_->identifier);
+}
+
+QString OfxNode::Category()
+{
+  if (plugin_->grouping.isEmpty()) {
+    return tr("OpenFX");
+  }
+
+  return tr("OpenFX/%1").arg(plugin_->grouping);
+}
+
+QString OfxNode::Description()
+{
+  return plugin_->description;
+}
+
+bool OfxNode::IsTimeDependent()
+{
+  return frame_varying_;
+}
+
+NodeInput *OfxNode::texture_input()
+{
+  return texture_input_;
+}
+
+NodeOutput *OfxNode::texture_output()
+{
+  return texture_output_;
+}
+
+void OfxNode::Process(const rational &time)
+{
+  NodeValue source = texture_input_->get_value(time);
+
+  if (NodeEvaluationContext::CurrentIsSoftware()) {
+    ProcessSoftware(source.toBuffer(), time);
+  } else {
+    ProcessGL(source.toTexture(), time);
+  }
+}
+
+bool OfxNode::SetUpRender(OfxPluginHost::Render *render, const rational &time, int width, int height)
+{
+  if (width == 0 || height == 0) {
+    return false;
+  }
+
+  // The source covers the tile being rendered, which plugins see as the whole image
+  QRect tile = NodeEvaluationContext::CurrentTile();
+  QPoint offset = tile.isNull() ? QPoint(0, 0) : tile.topLeft();
+
+  render->effect = effect_;
+  render->time = time.ToDouble();
+  render->rational_time = time;
+
+  // Plugins that can't render at reduced resolution are told they're rendering at full resolution, so anything they
+  // size in pixels is relative to the reduced frame
+  render->render_scale = plugin_->supports_multi_resolution ? 1.0 / NodeEvaluationContext::CurrentDivider() : 1.0;
+
+  render->cancel_token = NodeEvaluationContext::CurrentCancelToken();
+
+  // Olive's rows go down from the top of the frame and OFX's go up from the bottom, so Y is negated
+  render->bounds.x1 = offset.x();
+  render->bounds.x2 = offset.x() + width;
+  render->bounds.y1 = -(offset.y() + height);
+  render->bounds.y2 = -offset.y();
+
+  render->source = nullptr;
+  render->output = nullptr;
+  render->source_texture = 0;
+  render->output_texture = 0;
+
+  return true;
+}
+
+bool OfxNode::IsIdentity(OfxPluginHost::Render *render)
+{
+  OfxPropertySet in_args;
+  in_args.SetDouble(kOfxPropTime, render->time);
+  in_args.SetString(kOfxImageEffectPropFieldToRender, kOfxImageFieldNone);
+  in_args.SetInts(kOfxImageEffectPropRenderWindow, RenderWindow(render));
+  in_args.SetDoubles(kOfxImageEffectPropRenderScale, RenderScale(render));
+
+  OfxPropertySet out_args;
+  out_args.SetString(kOfxPropName, QByteArray());
+  out_args.SetDouble(kOfxPropTime, render->time);
+
+  OfxStatus status;
+
+  {
+    QMutexLocker locker(&actions_mutex_);
+
+    OfxPluginHost::SetCurrentRender(render);
+    status = olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionIsIdentity, effect_->handle(), &in_args,
+                                        &out_args);
+    OfxPluginHost::SetCurrentRender(nullptr);
+  }
+
+  // The source is only available at the time being rendered
+  return status == kOfxStatOK
+      && out_args.GetString(kOfxPropName) == kOfxImageEffectSimpleSourceClipName
+      && OfxPluginHost::ToRational(out_args.GetDouble(kOfxPropTime)) == OfxPluginHost::ToRational(render->time);
+}
+
+void OfxNode::CheckRegionOfInterest(OfxPluginHost::Render *render)
+{
+  if (roi_warned_.load()) {
+    return;
+  }
+
+  QVector<double> region;
+  region << render->bounds.x1 / render->render_scale
+         << render->bounds.y1 / render->render_scale
+         << render->bounds.x2 / render->render_scale
+         << render->bounds.y2 / render->render_scale;
+
+  OfxPropertySet in_args;
+  in_args.SetDouble(kOfxPropTime, render->time);
+  in_args.SetDoubles(kOfxImageEffectPropRenderScale, RenderScale(render));
+  in_args.SetDoubles(kOfxImageEffectPropRegionOfInterest, region);
+
+  // Defaults to the region being rendered
+  const char* source_roi = "OfxImageClipPropRoI_" kOfxImageEffectSimpleSourceClipName;
+
+  OfxPropertySet out_args;
+  out_args.SetDoubles(source_roi, region);
+
+  OfxStatus status;
+
+  {
+    QMutexLocker locker(&actions_mutex_);
+
+    OfxPluginHost::SetCurrentRender(render);
+    status = olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionGetRegionsOfInterest, effect_->handle(),
+                                        &in_args, &out_args);
+    OfxPluginHost::SetCurrentRender(nullptr);
+  }
+
+  if (status != kOfxStatOK) {
+    return;
+  }
+
+  double margin = kTileMargin / render->render_scale;
+
+  if (out_args.GetDouble(source_roi, 0) < region.at(0) - margin
+      || out_args.GetDouble(source_roi, 1) < region.at(1) - margin
+      || out_args.GetDouble(source_roi, 2) > region.at(2) + margin
+      || out_args.GetDouble(source_roi, 3) > region.at(3) + margin) {
+    if (roi_warned_.testAndSetRelaxed(0, 1)) {
+      qWarning() << "OpenFX plugin" << plugin_->identifier
+                 << "samples further than tiles overlap, tiled frames may show seams";
+    }
+  }
+}
+
+bool OfxNode::RenderFrame(OfxPluginHost::Render *render, bool opengl)
+{
+  OfxPropertySet sequence_args;
+  sequence_args.SetDoubles(kOfxImageEffectPropFrameRange, QVector<double>() << render->time << render->time);
+  sequence_args.SetDouble(kOfxImageEffectPropFrameStep, 1.0);
+  sequence_args.SetInt(kOfxPropIsInteractive, 0);
+  sequence_args.SetDoubles(kOfxImageEffectPropRenderScale, RenderScale(render));
+  sequence_args.SetInt(kOfxImageEffectPropSequentialRenderStatus, 0);
+  sequence_args.SetInt(kOfxImageEffectPropInteractiveRenderStatus, 0);
+  sequence_args.SetInt(kOfxImageEffectPropOpenGLEnabled, opengl);
+
+  OfxPropertySet render_args;
+  render_args.SetDouble(kOfxPropTime, render->time);
+  render_args.SetString(kOfxImageEffectPropFieldToRender, kOfxImageFieldNone);
+  render_args.SetInts(kOfxImageEffectPropRenderWindow, RenderWindow(render));
+  render_args.SetDoubles(kOfxImageEffectPropRenderScale, RenderScale(render));
+  render_args.SetInt(kOfxImageEffectPropSequentialRenderStatus, 0);
+  render_args.SetInt(kOfxImageEffectPropInteractiveRenderStatus, 0);
+  render_args.SetInt(kOfxImageEffectPropOpenGLEnabled, opengl);
+
+  // Render threads render this node at once unless the plugin says it can't handle it
+  QMutex* lock = nullptr;
+
+  if (plugin_->thread_safety == kOfxImageEffectRenderUnsafe) {
+    lock = &plugin_->render_mutex;
+  } else if (plugin_->thread_safety != kOfxImageEffectRenderFullySafe) {
+    lock = &effect_->render_mutex;
+  }
+
+  if (lock) {
+    lock->lock();
+  }
+
+  OfxPluginHost::SetCurrentRender(render);
+
+  bool rendered = false;
+
+  if (OfxPluginHost::Succeeded(olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionBeginSequenceRender,
+                                                          effect_->handle(), &sequence_args))) {
+    rendered = OfxPluginHost::Succeeded(olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionRender,
+                                                                   effect_->handle(), &render_args));
+
+    olive::ofx_host.CallAction(plugin_, kOfxImageEffectActionEndSequenceRender, effect_->handle(), &sequence_args);
+  }
+
+  OfxPluginHost::SetCurrentRender(nullptr);
+
+  if (lock) {
+    lock->unlock();
+  }
+
+  if (!rendered) {
+    qWarning() << "OpenFX plugin" << plugin_->identifier << "failed to render";
+  }
+
+  return rendered;
+}
+
+void OfxNode::ProcessSoftware(const MemoryBuffer *source, const rational &time)
+{
+  OfxPluginHost::Render render;
+
+  if (source == nullptr || !SetUpRender(&render, time, source->width(), source->height())) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  render.source = source;
+
+  if (IsIdentity(&render)) {
+    texture_output_->set_value(NodeValue::Buffer(source));
+    return;
+  }
+
+  CheckRegionOfInterest(&render);
+
+  MemoryBuffer* output;
+
+  {
+    QMutexLocker locker(&buffers_mutex_);
+
+    output = software_buffers_.value(NodeEvaluationContext::CurrentId());
+
+    if (output == nullptr) {
+      output = new MemoryBuffer();
+      software_buffers_.insert(NodeEvaluationContext::CurrentId(), output);
+    }
+  }
+
+  output->Create(source->width(), source->height(), olive::PIX_FMT_RGBA32F);
+
+  render.output = output;
+
+  if (RenderFrame(&render, false)) {
+    texture_output_->set_value(NodeValue::Buffer(output));
+  } else {
+    texture_output_->set_value(NodeValue::Texture(0));
+  }
+}
+
+void OfxNode::ProcessGL(GLuint source, const rational &time)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (source == 0 || ctx == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  GLint width = 0;
+  GLint height = 0;
+
+  xf->glBindTexture(GL_TEXTURE_2D, source);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  OfxPluginHost::Render render;
+
+  if (!SetUpRender(&render, time, width, height)) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  if (IsIdentity(&render)) {
+    texture_output_->set_value(NodeValue::Texture(source));
+    return;
+  }
+
+  CheckRegionOfInterest(&render);
+
+  GLBuffers* buffers = GetGLBuffers(ctx, width, height);
+
+  bool rendered = false;
+
+  if (plugin_->opengl) {
+    if (!buffers->attached) {
+      QMutexLocker locker(&actions_mutex_);
+      olive::ofx_host.CallAction(plugin_, kOfxActionOpenGLContextAttached, effect_->handle());
+      buffers->attached = true;
+    }
+
+    // Plugins expect textures' first row to be the bottom one, which is the other way up to Olive's
+    if (Flip(source, &buffers->flipped_source)) {
+      render.source_texture = buffers->flipped_source.texture();
+      render.output_texture = buffers->rendered.texture();
+
+      // Plugins draw into whatever framebuffer is bound
+      buffers->rendered.BindBuffer();
+      xf->glViewport(0, 0, width, height);
+
+      rendered = RenderFrame(&render, true);
+
+      buffers->rendered.ReleaseBuffer();
+
+      rendered = rendered && Flip(buffers->rendered.texture(), &buffers->output);
+    }
+  } else {
+    // Download the source, render in RAM and upload the result
+    buffers->download.Create(width, height, olive::PIX_FMT_RGBA32F);
+    buffers->upload.Create(width, height, olive::PIX_FMT_RGBA32F);
+
+    GLuint read_buffer;
+    xf->glGenFramebuffers(1, &read_buffer);
+    xf->glBindFramebuffer(GL_FRAMEBUFFER, read_buffer);
+    xf->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+
+    xf->glPixelStorei(GL_PACK_ROW_LENGTH, buffers->download.linesize() / kPixelBytes);
+    xf->glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, buffers->download.data());
+    xf->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+    xf->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    xf->glDeleteFramebuffers(1, &read_buffer);
+
+    render.source = &buffers->download;
+    render.output = &buffers->upload;
+
+    rendered = RenderFrame(&render, false);
+
+    if (rendered) {
+      buffers->output.BindTexture();
+
+      xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, buffers->upload.linesize() / kPixelBytes);
+      xf->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, buffers->upload.const_data());
+      xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+      buffers->output.ReleaseTexture();
+    }
+  }
+
+  texture_output_->set_value(NodeValue::Texture(rendered ? buffers->output.texture() : 0));
+}
+
+bool OfxNode::Flip(GLuint source, TextureBuffer *destination)
+{
+  ShaderPtr pipeline = olive::gl::GetInstancedPipeline();
+
+  if (pipeline == nullptr) {
+    return false;
+  }
+
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  QMatrix4x4 flip;
+  flip.scale(1.0f, -1.0f);
+
+  destination->BindBuffer();
+
+  f->glViewport(0, 0, destination->width(), destination->height());
+  f->glBindTexture(GL_TEXTURE_2D, source);
+
+  olive::gl::BlitInstanced(pipeline, QVector<QMatrix4x4>() << flip);
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  destination->ReleaseBuffer();
+
+  return true;
+}
+
+OfxNode::GLBuffers *OfxNode::GetGLBuffers(QOpenGLContext *ctx, int width, int height)
+{
+  QMutexLocker locker(&buffers_mutex_);
+
+  GLBuffers* buffers = gl_buffers_.value(ctx);
+
+  if (buffers == nullptr) {
+    buffers = new GLBuffers();
+    buffers->attached = false;
+
+    gl_buffers_.insert(ctx, buffers);
+
+    // Free the buffers with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      buffers_mutex_.lock();
+      GLBuffers* b = gl_buffers_.take(ctx);
+      buffers_mutex_.unlock();
+
+      if (b->attached) {
+        QMutexLocker actions_locker(&actions_mutex_);
+        olive::ofx_host.CallAction(plugin_, kOfxActionOpenGLContextDetached, effect_->handle());
+      }
+
+      delete b;
+    }, Qt::DirectConnection);
+  }
+
+  if (!buffers->output.IsCreated() || buffers->output.width() != width || buffers->output.height() != height) {
+    buffers->output.Create(ctx, olive::color::kWorkingFormat, width, height);
+
+    if (plugin_->opengl) {
+      buffers->flipped_source.Create(ctx, olive::color::kWorkingFormat, width, height);
+      buffers->rendered.Create(ctx, olive::color::kWorkingFormat, width, height);
+    }
+  }
+
+  return buffers;
+}
+
+NodeInput *OfxNode::AddParamInput(const QString &name, NodeParam::DataType type, const NodeValue &value)
+{
+  NodeKeyframe key;
+  key.set_value(value);
+
+  NodeInput* input = new NodeInput();
+  input->add_data_input(type);
+  input->set_name(name);
+  input->insert_keyframe(key);
+  AddParameter(input);
+
+  return input;
+}
@@ -0,0 +1,158 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OFXNODE_H
+#define OFXNODE_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+
+#include "node/node.h"
+#include "ofxpluginhost.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A node running an OpenFX image effect plugin (see OfxPluginHost)
+ *
+ * Each node is an instance of the plugin's effect. The plugin's parameters become the node's inputs, in the order the
+ * plugin defines them so projects can restore them, and its "Source" clip is the node's texture input.
+ *
+ * Renders in software and with OpenGL. Plugins that can render with OpenGL are given the input and output as textures,
+ * others have the input downloaded and their output uploaded when rendering with OpenGL.
+ */
+class OfxNode : public Node
+{
+  Q_OBJECT
+public:
+  OfxNode(OfxPluginHost::Plugin* plugin);
+
+  virtual ~OfxNode() override;
+
+  /**
+   * @brief Create a node for the plugin with a node ID, or return nullptr if there's no such plugin
+   */
+  static OfxNode* CreateFromID(const QString& id);
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+  virtual bool IsTimeDependent() override;
+
+  NodeInput* texture_input();
+
+  NodeOutput* texture_output();
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief Buffers for a context this node renders with OpenGL in
+   */
+  struct GLBuffers {
+    // Source flipped so its first row is the bottom one, and what the plugin renders into (plugins rendering with
+    // OpenGL only)
+    TextureBuffer flipped_source;
+    TextureBuffer rendered;
+
+    // Output handed to the next node
+    TextureBuffer output;
+
+    // Source downloaded and output rendered into (plugins rendering in RAM only)
+    MemoryBuffer download;
+    MemoryBuffer upload;
+
+    // Whether kOfxActionOpenGLContextAttached was sent for this context
+    bool attached;
+  };
+
+  /**
+   * @brief Fill in the render for a time and the source's size, returning FALSE if there's nothing to render
+   */
+  bool SetUpRender(OfxPluginHost::Render* render, const rational& time, int width, int height);
+
+  /**
+   * @brief Returns TRUE if the plugin says its output at this render is its source unchanged
+   */
+  bool IsIdentity(OfxPluginHost::Render* render);
+
+  /**
+   * @brief Log a warning (once) if the plugin needs more of its source than the tile being rendered has
+   *
+   * Nodes only get their input at the size of the tile, so plugins sampling further than RendererProcessor's overlap
+   * margins leave seams between tiles.
+   */
+  void CheckRegionOfInterest(OfxPluginHost::Render* render);
+
+  /**
+   * @brief Send the render actions for a render, locking as the plugin's thread safety requires
+   */
+  bool RenderFrame(OfxPluginHost::Render* render, bool opengl);
+
+  void ProcessSoftware(const MemoryBuffer* source, const rational& time);
+
+  void ProcessGL(GLuint source, const rational& time);
+
+  /**
+   * @brief Flip a texture vertically into a buffer of the same size
+   */
+  static bool Flip(GLuint source, TextureBuffer* destination);
+
+  /**
+   * @brief Returns this node's buffers for the current context, (re)creating them at a size if necessary
+   */
+  GLBuffers* GetGLBuffers(QOpenGLContext* ctx, int width, int height);
+
+  /**
+   * @brief Create an input for a parameter of the plugin's instance
+   */
+  NodeInput* AddParamInput(const QString& name, NodeParam::DataType type, const NodeValue& value);
+
+  OfxPluginHost::Plugin* plugin_;
+
+  OfxPluginHost::Effect* effect_;
+
+  // Whether the plugin's output changes over time with the same inputs (kOfxImageEffectFrameVarying)
+  bool frame_varying_;
+
+  // Whether a warning was logged about the plugin needing more of its input than a tile has
+  QAtomicInt roi_warned_;
+
+  NodeInput* texture_input_;
+
+  NodeOutput* texture_output_;
+
+  // Buffers for each context this node has rendered in
+  QHash<QOpenGLContext*, GLBuffers*> gl_buffers_;
+
+  // Output buffer for each evaluation rendering in software
+  QHash<Qt::HANDLE, MemoryBuffer*> software_buffers_;
+
+  QMutex buffers_mutex_;
+
+  // Held for actions other than rendering, which plugins expect one at a time per instance
+  QMutex actions_mutex_;
+};
+
+#endif // OFXNODE_H
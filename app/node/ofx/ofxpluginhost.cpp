@@ -0,0 +1,1296 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ofxpluginhost.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QThread>
+
+#include "render/cpurender.h"
+
+OfxPluginHost olive::ofx_host;
+
+namespace {
+
+// OFX times are converted to Olive's with this precision
+const int64_t kTimeBase = 1000000;
+
+// Step used to differentiate and integrate parameters (in seconds)
+const double kDerivativeStep = 0.001;
+const int kIntegralSteps = 16;
+
+// Render of the calling thread and, for threads running a plugin's multithread function, the thread's index
+thread_local OfxPluginHost::Render* current_render = nullptr;
+thread_local int current_thread_index = -1;
+
+// Strings returned by paramGetValue() stay valid until the thread's next call
+thread_local QByteArray param_string;
+
+bool SameTime(double a, double b)
+{
+  return std::abs(a - b) < 0.5 / static_cast<double>(kTimeBase);
+}
+
+struct ImageMemory {
+  void* data;
+};
+
+/**
+ * @brief Returns the subdirectory of an OFX bundle's Contents directory with binaries for this platform
+ */
+QString BundleArchitecture()
+{
+#if defined(Q_OS_WIN)
+  return (sizeof(void*) == 8) ? QStringLiteral("Win64") : QStringLiteral("Win32");
+#elif defined(Q_OS_MAC)
+  return QStringLiteral("MacOS");
+#else
+  return (sizeof(void*) == 8) ? QStringLiteral("Linux-x86-64") : QStringLiteral("Linux-x86");
+#endif
+}
+
+/**
+ * @brief Directories searched for plugins
+ */
+QStringList PluginDirectories()
+{
+#if defined(Q_OS_WIN)
+  const char separator = ';';
+#else
+  const char separator = ':';
+#endif
+
+  QStringList dirs = QString::fromLocal8Bit(qgetenv("OFX_PLUGIN_PATH")).split(separator);
+  dirs.removeAll(QString());
+
+#if defined(Q_OS_WIN)
+  dirs.append(QStringLiteral("C:/Program Files/Common Files/OFX/Plugins"));
+#elif defined(Q_OS_MAC)
+  dirs.append(QStringLiteral("/Library/OFX/Plugins"));
+#else
+  dirs.append(QStringLiteral("/usr/OFX/Plugins"));
+#endif
+
+  return dirs;
+}
+
+bool IsIntegerParam(const QByteArray& type)
+{
+  return type == kOfxParamTypeInteger
+      || type == kOfxParamTypeInteger2D
+      || type == kOfxParamTypeInteger3D
+      || type == kOfxParamTypeChoice
+      || type == kOfxParamTypeBoolean;
+}
+
+/**
+ * @brief Write values read by OfxPluginHost::GetParamValues() to a plugin's pointers
+ */
+void WriteParamValues(const QByteArray& type, const double* values, int count, va_list args)
+{
+  for (int i=0;i<count;i++) {
+    if (IsIntegerParam(type)) {
+      *va_arg(args, int*) = static_cast<int>(std::lround(values[i]));
+    } else {
+      *va_arg(args, double*) = values[i];
+    }
+  }
+}
+
+}
+
+OfxPluginHost::ParamSet::ParamSet()
+{
+}
+
+OfxPluginHost::ParamSet::~ParamSet()
+{
+  qDeleteAll(params);
+}
+
+OfxPluginHost::Param *OfxPluginHost::ParamSet::Find(const QByteArray &name) const
+{
+  foreach (Param* p, params) {
+    if (p->name == name) {
+      return p;
+    }
+  }
+
+  return nullptr;
+}
+
+OfxPluginHost::Effect::Effect(OfxPluginHost::Plugin *plugin) :
+  plugin(plugin)
+{
+}
+
+OfxPluginHost::Effect::~Effect()
+{
+  qDeleteAll(clips);
+}
+
+void OfxPluginHost::Effect::CopyFrom(OfxPluginHost::Effect *descriptor)
+{
+  properties = descriptor->properties;
+  params.properties = descriptor->params.properties;
+
+  foreach (Clip* c, descriptor->clips) {
+    Clip* copy = new Clip();
+    copy->name = c->name;
+    copy->properties = c->properties;
+    copy->effect = this;
+    clips.append(copy);
+  }
+
+  foreach (Param* p, descriptor->params.params) {
+    Param* copy = new Param();
+    copy->name = p->name;
+    copy->type = p->type;
+    copy->properties = p->properties;
+    params.params.append(copy);
+  }
+}
+
+OfxPluginHost::Clip *OfxPluginHost::Effect::FindClip(const QByteArray &name) const
+{
+  foreach (Clip* c, clips) {
+    if (c->name == name) {
+      return c;
+    }
+  }
+
+  return nullptr;
+}
+
+OfxImageEffectHandle OfxPluginHost::Effect::handle()
+{
+  return reinterpret_cast<OfxImageEffectHandle>(this);
+}
+
+OfxPluginHost::Effect *OfxPluginHost::Effect::FromHandle(OfxImageEffectHandle handle)
+{
+  return reinterpret_cast<Effect*>(handle);
+}
+
+OfxPluginHost::OfxPluginHost() :
+  scanned_(false)
+{
+  host_properties_.SetInts(kOfxPropAPIVersion, QVector<int>() << 1 << 4);
+  host_properties_.SetString(kOfxPropName, "org.olivevideoeditor.Olive");
+  host_properties_.SetString(kOfxPropLabel, "Olive");
+  host_properties_.SetInts(kOfxPropVersion, QVector<int>() << 0 << 2 << 0);
+  host_properties_.SetString(kOfxPropVersionLabel, "0.2.0");
+  host_properties_.SetInt(kOfxImageEffectHostPropIsBackground, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsOverlays, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultiResolution, 1);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsTiles, 1);
+  host_properties_.SetInt(kOfxImageEffectPropTemporalClipAccess, 0);
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedComponents,
+                              QList<QByteArray>() << kOfxImageComponentRGBA);
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedContexts,
+                              QList<QByteArray>() << kOfxImageEffectContextFilter << kOfxImageEffectContextGeneral);
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedPixelDepths, QList<QByteArray>() << kOfxBitDepthFloat);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultipleClipDepths, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultipleClipPARs, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSetableFrameRate, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSetableFielding, 0);
+  host_properties_.SetInt(kOfxImageEffectInstancePropSequentialRender, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsCustomInteract, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsStringAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsChoiceAnimation, 1);
+  host_properties_.SetInt(kOfxParamHostPropSupportsBooleanAnimation, 1);
+  host_properties_.SetInt(kOfxParamHostPropSupportsCustomAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropMaxParameters, -1);
+  host_properties_.SetInt(kOfxParamHostPropMaxPages, 0);
+  host_properties_.SetInts(kOfxParamHostPropPageRowColumnCount, QVector<int>() << 0 << 0);
+  host_properties_.SetString(kOfxImageEffectPropOpenGLRenderSupported, "true");
+
+  host_.host = host_properties_.handle();
+  host_.fetchSuite = FetchSuite;
+}
+
+QList<OfxPluginHost::Plugin *> OfxPluginHost::plugins()
+{
+  QMutexLocker locker(&mutex_);
+
+  if (!scanned_) {
+    Scan();
+  }
+
+  return plugins_;
+}
+
+OfxPluginHost::Plugin *OfxPluginHost::FindPlugin(const QByteArray &identifier)
+{
+  foreach (Plugin* p, plugins()) {
+    if (p->identifier == identifier) {
+      return p;
+    }
+  }
+
+  return nullptr;
+}
+
+OfxStatus OfxPluginHost::CallAction(OfxPluginHost::Plugin *plugin,
+                                    const char *action,
+                                    const void *handle,
+                                    OfxPropertySet *in_args,
+                                    OfxPropertySet *out_args)
+{
+  return plugin->plugin->mainEntry(action,
+                                   handle,
+                                   in_args ? in_args->handle() : nullptr,
+                                   out_args ? out_args->handle() : nullptr);
+}
+
+bool OfxPluginHost::Succeeded(OfxStatus status)
+{
+  return status == kOfxStatOK || status == kOfxStatReplyDefault;
+}
+
+void OfxPluginHost::SetCurrentRender(OfxPluginHost::Render *render)
+{
+  current_render = render;
+}
+
+OfxPluginHost::Render *OfxPluginHost::CurrentRender()
+{
+  return current_render;
+}
+
+int OfxPluginHost::GetParamValues(OfxPluginHost::Param *param, const rational &time, double values[4])
+{
+  if (param->inputs.isEmpty()) {
+    return 0;
+  }
+
+  if (param->type == kOfxParamTypeRGB || param->type == kOfxParamTypeRGBA) {
+    QColor color = param->inputs.first()->get_value(time).toColor();
+
+    values[0] = color.redF();
+    values[1] = color.greenF();
+    values[2] = color.blueF();
+    values[3] = color.alphaF();
+
+    return (param->type == kOfxParamTypeRGB) ? 3 : 4;
+  }
+
+  for (int i=0;i<param->inputs.size() && i<4;i++) {
+    NodeValue value = param->inputs.at(i)->get_value(time);
+
+    if (param->type == kOfxParamTypeBoolean) {
+      values[i] = value.toBool() ? 1.0 : 0.0;
+    } else if (IsIntegerParam(param->type)) {
+      values[i] = value.toInt();
+    } else {
+      values[i] = value.toDouble();
+    }
+  }
+
+  return qMin(param->inputs.size(), 4);
+}
+
+rational OfxPluginHost::ToRational(double time)
+{
+  return rational(static_cast<int64_t>(std::llround(time * static_cast<double>(kTimeBase))), kTimeBase);
+}
+
+void OfxPluginHost::Scan()
+{
+  scanned_ = true;
+
+  QString architecture = BundleArchitecture();
+
+  foreach (const QString& dir, PluginDirectories()) {
+    QDirIterator it(dir, QStringList() << QStringLiteral("*.ofx.bundle"), QDir::Dirs, QDirIterator::Subdirectories);
+
+    while (it.hasNext()) {
+      QDir binaries(QDir(it.next()).filePath(QStringLiteral("Contents/%1").arg(architecture)));
+
+      foreach (const QString& binary, binaries.entryList(QStringList() << QStringLiteral("*.ofx"), QDir::Files)) {
+        LoadBinary(binaries.filePath(binary));
+      }
+    }
+  }
+}
+
+void OfxPluginHost::LoadBinary(const QString &filename)
+{
+  QLibrary* library = new QLibrary(filename);
+
+  using GetNumberOfPlugins = int (*)();
+  using GetPlugin = OfxPlugin* (*)(int);
+
+  GetNumberOfPlugins get_number_of_plugins = reinterpret_cast<GetNumberOfPlugins>(
+        library->resolve("OfxGetNumberOfPlugins"));
+  GetPlugin get_plugin = reinterpret_cast<GetPlugin>(library->resolve("OfxGetPlugin"));
+
+  if (get_number_of_plugins == nullptr || get_plugin == nullptr) {
+    qWarning() << "Failed to load OpenFX plugin" << filename << library->errorString();
+    delete library;
+    return;
+  }
+
+  int count = get_number_of_plugins();
+  bool used = false;
+
+  for (int i=0;i<count;i++) {
+    OfxPlugin* ofx = get_plugin(i);
+
+    if (ofx == nullptr
+        || qstrcmp(ofx->pluginApi, kOfxImageEffectPluginApi) != 0
+        || ofx->apiVersion != 1) {
+      continue;
+    }
+
+    Plugin* p = new Plugin();
+    p->library = library;
+    p->plugin = ofx;
+    p->identifier = ofx->pluginIdentifier;
+    p->supports_tiles = true;
+    p->supports_multi_resolution = true;
+    p->opengl = false;
+    p->descriptor = nullptr;
+
+    if (Describe(p)) {
+      plugins_.append(p);
+      used = true;
+    } else {
+      delete p->descriptor;
+      delete p;
+    }
+  }
+
+  // Libraries stay loaded for as long as Olive runs, plugins may have left callbacks with other libraries
+  if (!used) {
+    delete library;
+  }
+}
+
+bool OfxPluginHost::Describe(OfxPluginHost::Plugin *plugin)
+{
+  plugin->plugin->setHost(&host_);
+
+  if (!Succeeded(CallAction(plugin, kOfxActionLoad, nullptr))) {
+    qWarning() << "OpenFX plugin" << plugin->identifier << "failed to load";
+    return false;
+  }
+
+  Effect* descriptor = new Effect(plugin);
+  plugin->descriptor = descriptor;
+
+  descriptor->properties.SetString(kOfxPropType, kOfxTypeImageEffect);
+  descriptor->properties.SetString(kOfxPropLabel, plugin->identifier);
+  descriptor->properties.SetString(kOfxImageEffectPluginRenderThreadSafety, kOfxImageEffectRenderInstanceSafe);
+  descriptor->properties.SetInt(kOfxImageEffectPropSupportsTiles, 1);
+  descriptor->properties.SetInt(kOfxImageEffectPropSupportsMultiResolution, 1);
+  descriptor->properties.SetString(kOfxImageEffectPropOpenGLRenderSupported, "false");
+  descriptor->params.properties.SetString(kOfxPropType, kOfxTypeParameterSet);
+
+  if (!Succeeded(CallAction(plugin, kOfxActionDescribe, descriptor->handle()))) {
+    qWarning() << "OpenFX plugin" << plugin->identifier << "failed to describe itself";
+    return false;
+  }
+
+  // A node has one texture input, so effects that work on one clip are the only ones usable
+  QList<QByteArray> contexts = descriptor->properties.GetStrings(kOfxImageEffectPropSupportedContexts);
+
+  if (contexts.contains(kOfxImageEffectContextFilter)) {
+    plugin->context = kOfxImageEffectContextFilter;
+  } else if (contexts.contains(kOfxImageEffectContextGeneral)) {
+    plugin->context = kOfxImageEffectContextGeneral;
+  } else {
+    return false;
+  }
+
+  OfxPropertySet in_args;
+  in_args.SetString(kOfxImageEffectPropContext, plugin->context);
+
+  if (!Succeeded(CallAction(plugin, kOfxImageEffectActionDescribeInContext, descriptor->handle(), &in_args))) {
+    qWarning() << "OpenFX plugin" << plugin->identifier << "failed to describe itself in" << plugin->context;
+    return false;
+  }
+
+  if (!descriptor->FindClip(kOfxImageEffectSimpleSourceClipName)
+      || !descriptor->FindClip(kOfxImageEffectOutputClipName)) {
+    return false;
+  }
+
+  foreach (Clip* c, descriptor->clips) {
+    if (c->name != kOfxImageEffectSimpleSourceClipName
+        && c->name != kOfxImageEffectOutputClipName
+        && !c->properties.GetInt(kOfxImageClipPropOptional)) {
+      return false;
+    }
+  }
+
+  plugin->label = QString::fromUtf8(descriptor->properties.GetString(kOfxPropLabel));
+  plugin->grouping = QString::fromUtf8(descriptor->properties.GetString(kOfxImageEffectPluginPropGrouping));
+  plugin->description = QString::fromUtf8(descriptor->properties.GetString(kOfxPropPluginDescription));
+  plugin->thread_safety = descriptor->properties.GetString(kOfxImageEffectPluginRenderThreadSafety);
+  plugin->supports_tiles = descriptor->properties.GetInt(kOfxImageEffectPropSupportsTiles, 0, 1);
+  plugin->supports_multi_resolution = descriptor->properties.GetInt(kOfxImageEffectPropSupportsMultiResolution, 0, 1);
+
+  QByteArray opengl = descriptor->properties.GetString(kOfxImageEffectPropOpenGLRenderSupported);
+  plugin->opengl = (opengl == "true" || opengl == "needed");
+
+  return true;
+}
+
+const void *OfxPluginHost::FetchSuite(OfxPropertySetHandle host, const char *suite_name, int suite_version)
+{
+  Q_UNUSED(host)
+
+  static const OfxImageEffectSuiteV1 image_effect_suite = {
+    GetPropertySet,
+    GetParamSet,
+    ClipDefine,
+    ClipGetHandle,
+    ClipGetPropertySet,
+    ClipGetImage,
+    ClipReleaseImage,
+    ClipGetRegionOfDefinition,
+    Abort,
+    ImageMemoryAlloc,
+    ImageMemoryFree,
+    ImageMemoryLock,
+    ImageMemoryUnlock
+  };
+
+  static const OfxParameterSuiteV1 parameter_suite = {
+    ParamDefine,
+    ParamGetHandle,
+    ParamSetGetPropertySet,
+    ParamGetPropertySet,
+    ParamGetValue,
+    ParamGetValueAtTime,
+    ParamGetDerivative,
+    ParamGetIntegral,
+    ParamSetValue,
+    ParamSetValueAtTime,
+    ParamGetNumKeys,
+    ParamGetKeyTime,
+    ParamGetKeyIndex,
+    ParamDeleteKey,
+    ParamDeleteAllKeys,
+    ParamCopy,
+    ParamEditBegin,
+    ParamEditEnd
+  };
+
+  static const OfxMemorySuiteV1 memory_suite = {
+    MemoryAlloc,
+    MemoryFree
+  };
+
+  static const OfxMultiThreadSuiteV1 multithread_suite = {
+    MultiThread,
+    MultiThreadNumCPUs,
+    MultiThreadIndex,
+    MultiThreadIsSpawnedThread,
+    MutexCreate,
+    MutexDestroy,
+    MutexLock,
+    MutexUnLock,
+    MutexTryLock
+  };
+
+  static const OfxMessageSuiteV1 message_suite = {
+    Message
+  };
+
+  static const OfxImageEffectOpenGLRenderSuiteV1 opengl_suite = {
+    ClipLoadTexture,
+    ClipFreeTexture,
+    FlushResources
+  };
+
+  if (suite_version != 1) {
+    return nullptr;
+  }
+
+  if (qstrcmp(suite_name, kOfxPropertySuite) == 0) {
+    return OfxPropertySet::Suite();
+  } else if (qstrcmp(suite_name, kOfxImageEffectSuite) == 0) {
+    return &image_effect_suite;
+  } else if (qstrcmp(suite_name, kOfxParameterSuite) == 0) {
+    return &parameter_suite;
+  } else if (qstrcmp(suite_name, kOfxMemorySuite) == 0) {
+    return &memory_suite;
+  } else if (qstrcmp(suite_name, kOfxMultiThreadSuite) == 0) {
+    return &multithread_suite;
+  } else if (qstrcmp(suite_name, kOfxMessageSuite) == 0) {
+    return &message_suite;
+  } else if (qstrcmp(suite_name, kOfxOpenGLRenderSuite) == 0) {
+    return &opengl_suite;
+  }
+
+  return nullptr;
+}
+
+OfxStatus OfxPluginHost::GetPropertySet(OfxImageEffectHandle effect, OfxPropertySetHandle *properties)
+{
+  if (effect == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  *properties = Effect::FromHandle(effect)->properties.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::GetParamSet(OfxImageEffectHandle effect, OfxParamSetHandle *param_set)
+{
+  if (effect == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  *param_set = reinterpret_cast<OfxParamSetHandle>(&Effect::FromHandle(effect)->params);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipDefine(OfxImageEffectHandle effect, const char *name, OfxPropertySetHandle *properties)
+{
+  if (effect == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Effect* e = Effect::FromHandle(effect);
+
+  if (e->FindClip(name)) {
+    return kOfxStatErrExists;
+  }
+
+  Clip* c = new Clip();
+  c->name = name;
+  c->effect = e;
+
+  c->properties.SetString(kOfxPropType, kOfxTypeClip);
+  c->properties.SetString(kOfxPropName, name);
+  c->properties.SetString(kOfxPropLabel, name);
+  c->properties.SetInt(kOfxImageClipPropOptional, 0);
+  c->properties.SetInt(kOfxImageClipPropIsMask, 0);
+  c->properties.SetInt(kOfxImageEffectPropSupportsTiles, 1);
+  c->properties.SetInt(kOfxImageEffectPropTemporalClipAccess, 0);
+
+  // What an instance's clip is set to
+  c->properties.SetInt(kOfxImageClipPropConnected, 0);
+  c->properties.SetString(kOfxImageEffectPropComponents, kOfxImageComponentRGBA);
+  c->properties.SetString(kOfxImageClipPropUnmappedComponents, kOfxImageComponentRGBA);
+  c->properties.SetString(kOfxImageEffectPropPixelDepth, kOfxBitDepthFloat);
+  c->properties.SetString(kOfxImageEffectPropUnmappedPixelDepth, kOfxBitDepthFloat);
+  c->properties.SetString(kOfxImageEffectPropPreMultiplication, kOfxImagePreMultiplied);
+  c->properties.SetDouble(kOfxImagePropPixelAspectRatio, 1.0);
+  c->properties.SetDouble(kOfxImageEffectPropFrameRate, 1.0);
+  c->properties.SetDouble(kOfxImageEffectPropUnmappedFrameRate, 1.0);
+  c->properties.SetString(kOfxImageClipPropFieldOrder, kOfxImageFieldNone);
+  c->properties.SetInt(kOfxImageClipPropContinuousSamples, 1);
+  c->properties.SetInt(kOfxImageEffectFrameVarying, 0);
+
+  e->clips.append(c);
+
+  *properties = c->properties.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipGetHandle(OfxImageEffectHandle effect, const char *name, OfxImageClipHandle *clip,
+                                       OfxPropertySetHandle *properties)
+{
+  if (effect == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Clip* c = Effect::FromHandle(effect)->FindClip(name);
+
+  if (c == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  *clip = reinterpret_cast<OfxImageClipHandle>(c);
+
+  if (properties) {
+    *properties = c->properties.handle();
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipGetPropertySet(OfxImageClipHandle clip, OfxPropertySetHandle *properties)
+{
+  if (clip == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  *properties = reinterpret_cast<Clip*>(clip)->properties.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipGetImage(OfxImageClipHandle clip, OfxTime time, const OfxRectD *region,
+                                      OfxPropertySetHandle *image)
+{
+  Q_UNUSED(time)
+  Q_UNUSED(region)
+
+  if (clip == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Clip* c = reinterpret_cast<Clip*>(clip);
+  Render* r = current_render;
+
+  // Images are only available while rendering, and only at the time being rendered (there's no temporal access)
+  if (r == nullptr || r->effect != c->effect || (c->name != kOfxImageEffectOutputClipName && r->source == nullptr)) {
+    return kOfxStatFailed;
+  }
+
+  if ((c->name == kOfxImageEffectOutputClipName && r->output == nullptr)
+      || (c->name != kOfxImageEffectOutputClipName && c->name != kOfxImageEffectSimpleSourceClipName)) {
+    return kOfxStatFailed;
+  }
+
+  *image = CreateImage(c, r)->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipReleaseImage(OfxPropertySetHandle image)
+{
+  if (image == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  delete OfxPropertySet::FromHandle(image);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipGetRegionOfDefinition(OfxImageClipHandle clip, OfxTime time, OfxRectD *bounds)
+{
+  Q_UNUSED(time)
+
+  if (clip == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Render* r = current_render;
+
+  if (r == nullptr) {
+    bounds->x1 = bounds->y1 = bounds->x2 = bounds->y2 = 0.0;
+    return kOfxStatOK;
+  }
+
+  // Canonical coordinates are full resolution pixels
+  bounds->x1 = r->bounds.x1 / r->render_scale;
+  bounds->y1 = r->bounds.y1 / r->render_scale;
+  bounds->x2 = r->bounds.x2 / r->render_scale;
+  bounds->y2 = r->bounds.y2 / r->render_scale;
+
+  return kOfxStatOK;
+}
+
+int OfxPluginHost::Abort(OfxImageEffectHandle effect)
+{
+  Q_UNUSED(effect)
+
+  Render* r = current_render;
+
+  return (r != nullptr && r->cancel_token != nullptr && r->cancel_token->load()) ? 1 : 0;
+}
+
+OfxStatus OfxPluginHost::ImageMemoryAlloc(OfxImageEffectHandle effect, size_t bytes, OfxImageMemoryHandle *memory)
+{
+  Q_UNUSED(effect)
+
+  ImageMemory* m = new ImageMemory();
+  m->data = std::malloc(bytes);
+
+  if (m->data == nullptr) {
+    delete m;
+    return kOfxStatErrMemory;
+  }
+
+  *memory = reinterpret_cast<OfxImageMemoryHandle>(m);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ImageMemoryFree(OfxImageMemoryHandle memory)
+{
+  if (memory == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  ImageMemory* m = reinterpret_cast<ImageMemory*>(memory);
+  std::free(m->data);
+  delete m;
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ImageMemoryLock(OfxImageMemoryHandle memory, void **data)
+{
+  if (memory == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  // Memory never moves, so locking does nothing
+  *data = reinterpret_cast<ImageMemory*>(memory)->data;
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ImageMemoryUnlock(OfxImageMemoryHandle memory)
+{
+  return memory ? kOfxStatOK : kOfxStatErrBadHandle;
+}
+
+OfxStatus OfxPluginHost::ParamDefine(OfxParamSetHandle param_set, const char *type, const char *name,
+                                     OfxPropertySetHandle *properties)
+{
+  if (param_set == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  ParamSet* set = reinterpret_cast<ParamSet*>(param_set);
+
+  if (set->Find(name)) {
+    return kOfxStatErrExists;
+  }
+
+  Param* p = new Param();
+  p->name = name;
+  p->type = type;
+
+  p->properties.SetString(kOfxPropType, kOfxTypeParameter);
+  p->properties.SetString(kOfxPropName, name);
+  p->properties.SetString(kOfxPropLabel, name);
+  p->properties.SetString(kOfxParamPropType, type);
+  p->properties.SetString(kOfxParamPropScriptName, name);
+  p->properties.SetString(kOfxParamPropHint, QByteArray());
+  p->properties.SetString(kOfxParamPropParent, QByteArray());
+  p->properties.SetInt(kOfxParamPropSecret, 0);
+  p->properties.SetInt(kOfxParamPropEnabled, 1);
+  p->properties.SetInt(kOfxParamPropAnimates, 1);
+  p->properties.SetInt(kOfxParamPropIsAnimating, 0);
+  p->properties.SetInt(kOfxParamPropEvaluateOnChange, 1);
+  p->properties.SetPointer(kOfxParamPropDataPtr, nullptr);
+
+  set->params.append(p);
+
+  if (properties) {
+    *properties = p->properties.handle();
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamGetHandle(OfxParamSetHandle param_set, const char *name, OfxParamHandle *param,
+                                        OfxPropertySetHandle *properties)
+{
+  if (param_set == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Param* p = reinterpret_cast<ParamSet*>(param_set)->Find(name);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  *param = reinterpret_cast<OfxParamHandle>(p);
+
+  if (properties) {
+    *properties = p->properties.handle();
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamSetGetPropertySet(OfxParamSetHandle param_set, OfxPropertySetHandle *properties)
+{
+  if (param_set == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  *properties = reinterpret_cast<ParamSet*>(param_set)->properties.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamGetPropertySet(OfxParamHandle param, OfxPropertySetHandle *properties)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  *properties = reinterpret_cast<Param*>(param)->properties.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamGetValue(OfxParamHandle param, ...)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Render* r = current_render;
+
+  va_list args;
+  va_start(args, param);
+
+  // Outside of renders (e.g. when an instance changes), parameters are read at the start
+  rational time = r ? r->rational_time : rational();
+
+  Param* p = reinterpret_cast<Param*>(param);
+  OfxStatus status = kOfxStatOK;
+
+  if (p->type == kOfxParamTypeString && !p->inputs.isEmpty()) {
+    param_string = p->inputs.first()->get_value(time).toString().toUtf8();
+    *va_arg(args, char**) = param_string.data();
+  } else {
+    double values[4];
+    int count = GetParamValues(p, time, values);
+
+    if (count > 0) {
+      WriteParamValues(p->type, values, count, args);
+    } else {
+      status = kOfxStatErrUnsupported;
+    }
+  }
+
+  va_end(args);
+
+  return status;
+}
+
+OfxStatus OfxPluginHost::ParamGetValueAtTime(OfxParamHandle param, OfxTime time, ...)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  va_list args;
+  va_start(args, time);
+
+  Render* r = current_render;
+  Param* p = reinterpret_cast<Param*>(param);
+  OfxStatus status = kOfxStatOK;
+
+  // Use the exact render time rather than its rounded conversion where possible
+  rational t = (r && SameTime(r->time, time)) ? r->rational_time : ToRational(time);
+
+  if (p->type == kOfxParamTypeString && !p->inputs.isEmpty()) {
+    param_string = p->inputs.first()->get_value(t).toString().toUtf8();
+    *va_arg(args, char**) = param_string.data();
+  } else {
+    double values[4];
+    int count = GetParamValues(p, t, values);
+
+    if (count > 0) {
+      WriteParamValues(p->type, values, count, args);
+    } else {
+      status = kOfxStatErrUnsupported;
+    }
+  }
+
+  va_end(args);
+
+  return status;
+}
+
+OfxStatus OfxPluginHost::ParamGetDerivative(OfxParamHandle param, OfxTime time, ...)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Param* p = reinterpret_cast<Param*>(param);
+
+  if (IsIntegerParam(p->type)) {
+    return kOfxStatErrUnsupported;
+  }
+
+  double before[4];
+  double after[4];
+
+  int count = GetParamValues(p, ToRational(time - kDerivativeStep), before);
+  GetParamValues(p, ToRational(time + kDerivativeStep), after);
+
+  if (count == 0) {
+    return kOfxStatErrUnsupported;
+  }
+
+  va_list args;
+  va_start(args, time);
+
+  for (int i=0;i<count;i++) {
+    *va_arg(args, double*) = (after[i] - before[i]) / (2.0 * kDerivativeStep);
+  }
+
+  va_end(args);
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamGetIntegral(OfxParamHandle param, OfxTime time1, OfxTime time2, ...)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Param* p = reinterpret_cast<Param*>(param);
+
+  if (IsIntegerParam(p->type)) {
+    return kOfxStatErrUnsupported;
+  }
+
+  // Trapezoidal rule, parameters are smooth between keyframes
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+  double step = (time2 - time1) / kIntegralSteps;
+  int count = 0;
+
+  for (int i=0;i<=kIntegralSteps;i++) {
+    double values[4];
+    count = GetParamValues(p, ToRational(time1 + step * i), values);
+
+    double weight = (i == 0 || i == kIntegralSteps) ? 0.5 : 1.0;
+
+    for (int j=0;j<count;j++) {
+      sum[j] += values[j] * weight * step;
+    }
+  }
+
+  if (count == 0) {
+    return kOfxStatErrUnsupported;
+  }
+
+  va_list args;
+  va_start(args, time2);
+
+  for (int i=0;i<count;i++) {
+    *va_arg(args, double*) = sum[i];
+  }
+
+  va_end(args);
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamSetValue(OfxParamHandle param, ...)
+{
+  Q_UNUSED(param)
+
+  // Values come from the node's inputs, which only the user changes
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OfxPluginHost::ParamSetValueAtTime(OfxParamHandle param, OfxTime time, ...)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OfxPluginHost::ParamGetNumKeys(OfxParamHandle param, unsigned int *count)
+{
+  if (param == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  // Keyframes aren't exposed, plugins can still read values at any time
+  *count = 0;
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ParamGetKeyTime(OfxParamHandle param, unsigned int key, OfxTime *time)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(key)
+  Q_UNUSED(time)
+
+  return kOfxStatErrBadIndex;
+}
+
+OfxStatus OfxPluginHost::ParamGetKeyIndex(OfxParamHandle param, OfxTime time, int direction, int *index)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+  Q_UNUSED(direction)
+  Q_UNUSED(index)
+
+  return kOfxStatFailed;
+}
+
+OfxStatus OfxPluginHost::ParamDeleteKey(OfxParamHandle param, OfxTime time)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OfxPluginHost::ParamDeleteAllKeys(OfxParamHandle param)
+{
+  Q_UNUSED(param)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OfxPluginHost::ParamCopy(OfxParamHandle to, OfxParamHandle from, OfxTime offset, const OfxRangeD *range)
+{
+  Q_UNUSED(to)
+  Q_UNUSED(from)
+  Q_UNUSED(offset)
+  Q_UNUSED(range)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OfxPluginHost::ParamEditBegin(OfxParamSetHandle param_set, const char *name)
+{
+  Q_UNUSED(name)
+
+  return param_set ? kOfxStatOK : kOfxStatErrBadHandle;
+}
+
+OfxStatus OfxPluginHost::ParamEditEnd(OfxParamSetHandle param_set)
+{
+  return param_set ? kOfxStatOK : kOfxStatErrBadHandle;
+}
+
+OfxStatus OfxPluginHost::MemoryAlloc(void *handle, size_t bytes, void **data)
+{
+  Q_UNUSED(handle)
+
+  *data = std::malloc(bytes);
+
+  return *data ? kOfxStatOK : kOfxStatErrMemory;
+}
+
+OfxStatus OfxPluginHost::MemoryFree(void *data)
+{
+  std::free(data);
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MultiThread(OfxThreadFunctionV1 func, unsigned int thread_count, void *arg)
+{
+  if (thread_count == 0) {
+    thread_count = static_cast<unsigned int>(QThread::idealThreadCount());
+  }
+
+  // Spawned threads render on behalf of this thread's render
+  Render* render = current_render;
+
+  olive::cpu::ForEachIndex(static_cast<int>(thread_count), [func, thread_count, arg, render](int index) {
+    Render* previous_render = current_render;
+    int previous_index = current_thread_index;
+
+    current_render = render;
+    current_thread_index = index;
+
+    func(static_cast<unsigned int>(index), thread_count, arg);
+
+    current_render = previous_render;
+    current_thread_index = previous_index;
+  });
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MultiThreadNumCPUs(unsigned int *count)
+{
+  *count = static_cast<unsigned int>(QThread::idealThreadCount());
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MultiThreadIndex(unsigned int *index)
+{
+  *index = (current_thread_index >= 0) ? static_cast<unsigned int>(current_thread_index) : 0;
+
+  return kOfxStatOK;
+}
+
+int OfxPluginHost::MultiThreadIsSpawnedThread()
+{
+  return (current_thread_index >= 0) ? 1 : 0;
+}
+
+OfxStatus OfxPluginHost::MutexCreate(OfxMutexHandle *mutex, int lock_count)
+{
+  QMutex* m = new QMutex(QMutex::Recursive);
+
+  for (int i=0;i<lock_count;i++) {
+    m->lock();
+  }
+
+  *mutex = reinterpret_cast<OfxMutexHandle>(m);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MutexDestroy(const OfxMutexHandle mutex)
+{
+  if (mutex == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  delete reinterpret_cast<QMutex*>(mutex);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MutexLock(const OfxMutexHandle mutex)
+{
+  if (mutex == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  reinterpret_cast<QMutex*>(mutex)->lock();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MutexUnLock(const OfxMutexHandle mutex)
+{
+  if (mutex == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  reinterpret_cast<QMutex*>(mutex)->unlock();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::MutexTryLock(const OfxMutexHandle mutex)
+{
+  if (mutex == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  return reinterpret_cast<QMutex*>(mutex)->tryLock() ? kOfxStatOK : kOfxStatFailed;
+}
+
+OfxStatus OfxPluginHost::Message(void *handle, const char *type, const char *id, const char *format, ...)
+{
+  Q_UNUSED(handle)
+  Q_UNUSED(id)
+
+  char message[1024];
+
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  qWarning() << "OpenFX plugin:" << message;
+
+  // There's nobody to ask while rendering
+  if (qstrcmp(type, kOfxMessageQuestion) == 0) {
+    return kOfxStatReplyDefault;
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipLoadTexture(OfxImageClipHandle clip, OfxTime time, const char *format,
+                                         const OfxRectD *region, OfxPropertySetHandle *texture)
+{
+  Q_UNUSED(time)
+  Q_UNUSED(format)
+  Q_UNUSED(region)
+
+  if (clip == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  Clip* c = reinterpret_cast<Clip*>(clip);
+  Render* r = current_render;
+
+  if (r == nullptr || r->effect != c->effect) {
+    return kOfxStatFailed;
+  }
+
+  GLuint texture_id;
+
+  if (c->name == kOfxImageEffectOutputClipName) {
+    texture_id = r->output_texture;
+  } else if (c->name == kOfxImageEffectSimpleSourceClipName) {
+    texture_id = r->source_texture;
+  } else {
+    return kOfxStatFailed;
+  }
+
+  if (texture_id == 0) {
+    return kOfxStatFailed;
+  }
+
+  OfxPropertySet* t = CreateImage(c, r);
+  t->SetInt(kOfxImageEffectPropOpenGLTextureIndex, static_cast<int>(texture_id));
+  t->SetInt(kOfxImageEffectPropOpenGLTextureTarget, GL_TEXTURE_2D);
+
+  *texture = t->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPluginHost::ClipFreeTexture(OfxPropertySetHandle texture)
+{
+  return ClipReleaseImage(texture);
+}
+
+OfxStatus OfxPluginHost::FlushResources()
+{
+  return kOfxStatOK;
+}
+
+OfxPropertySet *OfxPluginHost::CreateImage(OfxPluginHost::Clip *clip, OfxPluginHost::Render *render)
+{
+  OfxPropertySet* image = new OfxPropertySet();
+
+  QVector<int> bounds;
+  bounds << render->bounds.x1 << render->bounds.y1 << render->bounds.x2 << render->bounds.y2;
+
+  image->SetString(kOfxPropType, kOfxTypeImage);
+  image->SetString(kOfxImageEffectPropPixelDepth, kOfxBitDepthFloat);
+  image->SetString(kOfxImageEffectPropComponents, kOfxImageComponentRGBA);
+  image->SetString(kOfxImageEffectPropPreMultiplication, kOfxImagePreMultiplied);
+  image->SetDoubles(kOfxImageEffectPropRenderScale, QVector<double>() << render->render_scale << render->render_scale);
+  image->SetDouble(kOfxImagePropPixelAspectRatio, 1.0);
+  image->SetInts(kOfxImagePropBounds, bounds);
+  image->SetInts(kOfxImagePropRegionOfDefinition, bounds);
+  image->SetString(kOfxImagePropField, kOfxImageFieldNone);
+  image->SetString(kOfxImagePropUniqueIdentifier,
+                   QByteArray::number(reinterpret_cast<quintptr>(render)) + clip->name);
+
+  const MemoryBuffer* buffer = (clip->name == kOfxImageEffectOutputClipName) ? render->output : render->source;
+
+  if (buffer == nullptr) {
+    image->SetPointer(kOfxImagePropData, nullptr);
+    image->SetInt(kOfxImagePropRowBytes, 0);
+  } else {
+    // OFX images start at their bottom row, Olive's at their top
+    int last_row = buffer->height() - 1;
+
+    image->SetPointer(kOfxImagePropData, const_cast<uint8_t*>(buffer->const_row(last_row)));
+    image->SetInt(kOfxImagePropRowBytes, -buffer->linesize());
+  }
+
+  return image;
+}
@@ -0,0 +1,343 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OFXPLUGINHOST_H
+#define OFXPLUGINHOST_H
+
+#include <ofxCore.h>
+#include <ofxImageEffect.h>
+#include <ofxMemory.h>
+#include <ofxMessage.h>
+#include <ofxMultiThread.h>
+#include <ofxOpenGLRender.h>
+#include <ofxParam.h>
+#include <QAtomicInt>
+#include <QLibrary>
+#include <QList>
+#include <QMutex>
+#include <QOpenGLFunctions>
+#include <QVector>
+
+#include "common/rational.h"
+#include "node/input.h"
+#include "ofxpropertyset.h"
+#include "render/memorybuffer.h"
+
+/**
+ * @brief Loads OpenFX image effect plugins and implements the host side of the OFX API for OfxNode
+ *
+ * Plugins are found in the directories listed in OFX_PLUGIN_PATH and the platform's standard OFX directory when
+ * plugins() is first called. Only effects with a filter context (or a general context with a single "Source" clip)
+ * are used, since a node has one texture input.
+ *
+ * Rendering is driven by Olive rather than the plugin: frames are split into tiles by RendererProcessor, every render
+ * thread can render the same instance at once if the plugin declares itself fully thread safe, and the threads a
+ * plugin asks for through the multithread suite come from olive::cpu's pool (see olive::cpu::ForEachIndex()) so
+ * plugins don't oversubscribe the CPU with thread pools of their own.
+ *
+ * OFX time is in seconds. Canonical coordinates are full resolution frame pixels with Y going up, so a frame's rows
+ * are handed to plugins bottom row first.
+ */
+class OfxPluginHost
+{
+public:
+  struct Effect;
+  struct Plugin;
+
+  struct Clip {
+    QByteArray name;
+
+    OfxPropertySet properties;
+
+    Effect* effect;
+  };
+
+  struct Param {
+    QByteArray name;
+
+    QByteArray type;
+
+    OfxPropertySet properties;
+
+    // Inputs holding the value of an instance's parameter, one per dimension except colors which have one input (none
+    // for parameters without a value, e.g. pages, and for every descriptor)
+    QVector<NodeInput*> inputs;
+  };
+
+  struct ParamSet {
+    ParamSet();
+
+    ~ParamSet();
+
+    Param* Find(const QByteArray& name) const;
+
+    OfxPropertySet properties;
+
+    // In the order they were defined
+    QList<Param*> params;
+  };
+
+  /**
+   * @brief An effect descriptor (one per Plugin) or instance (one per OfxNode)
+   */
+  struct Effect {
+    Effect(Plugin* plugin);
+
+    ~Effect();
+
+    /**
+     * @brief Copy the descriptor's properties, clips and parameters into a new instance
+     */
+    void CopyFrom(Effect* descriptor);
+
+    Clip* FindClip(const QByteArray& name) const;
+
+    OfxImageEffectHandle handle();
+
+    static Effect* FromHandle(OfxImageEffectHandle handle);
+
+    Plugin* plugin;
+
+    OfxPropertySet properties;
+
+    ParamSet params;
+
+    QList<Clip*> clips;
+
+    // Held while rendering plugins that can only render one frame at a time per instance
+    QMutex render_mutex;
+  };
+
+  struct Plugin {
+    QLibrary* library;
+
+    OfxPlugin* plugin;
+
+    QByteArray identifier;
+
+    QString label;
+
+    QString grouping;
+
+    QString description;
+
+    // Context the plugin is described and instanced in
+    QByteArray context;
+
+    // kOfxImageEffectRenderUnsafe, kOfxImageEffectRenderInstanceSafe or kOfxImageEffectRenderFullySafe
+    QByteArray thread_safety;
+
+    bool supports_tiles;
+
+    bool supports_multi_resolution;
+
+    // Whether the plugin can render with OpenGL
+    bool opengl;
+
+    Effect* descriptor;
+
+    // Held while rendering plugins that can only render one frame at a time overall
+    QMutex render_mutex;
+  };
+
+  /**
+   * @brief What's being rendered on a thread, for the suite functions plugins call while rendering
+   */
+  struct Render {
+    Effect* effect;
+
+    // In OFX time and in Olive time
+    double time;
+    rational rational_time;
+
+    double render_scale;
+
+    const QAtomicInt* cancel_token;
+
+    // Pixel bounds of the source and output, which always match
+    OfxRectI bounds;
+
+    // Images when rendering in RAM (source is nullptr if nothing is connected)
+    const MemoryBuffer* source;
+    MemoryBuffer* output;
+
+    // Textures when rendering with OpenGL, already flipped so their first row is the bottom one
+    GLuint source_texture;
+    GLuint output_texture;
+  };
+
+  OfxPluginHost();
+
+  /**
+   * @brief Every usable plugin, loading them all the first time this is called
+   */
+  QList<Plugin*> plugins();
+
+  /**
+   * @brief Returns the plugin with this identifier, or nullptr if there's none
+   */
+  Plugin* FindPlugin(const QByteArray& identifier);
+
+  /**
+   * @brief Call a plugin's main entry point
+   */
+  OfxStatus CallAction(Plugin* plugin, const char* action, const void* handle, OfxPropertySet* in_args = nullptr,
+                       OfxPropertySet* out_args = nullptr);
+
+  /**
+   * @brief Returns TRUE if a status returned by CallAction() means the action succeeded (or did the default)
+   */
+  static bool Succeeded(OfxStatus status);
+
+  /**
+   * @brief Set what's being rendered on this thread (or nullptr once it's done)
+   */
+  static void SetCurrentRender(Render* render);
+
+  static Render* CurrentRender();
+
+  /**
+   * @brief Read the value of a parameter of an instance at a time
+   *
+   * @return
+   *
+   * Number of values (dimensions) written to `values`, up to 4. 0 if the parameter has no value.
+   */
+  static int GetParamValues(Param* param, const rational& time, double values[4]);
+
+  /**
+   * @brief Convert an OFX time to Olive's
+   */
+  static rational ToRational(double time);
+
+private:
+  /**
+   * @brief Load every plugin in the plugin directories (mutex_ must be locked)
+   */
+  void Scan();
+
+  /**
+   * @brief Load the plugins in a binary
+   */
+  void LoadBinary(const QString& filename);
+
+  /**
+   * @brief Load and describe a plugin, filling in what Olive needs to know about it
+   */
+  bool Describe(Plugin* plugin);
+
+  static const void* FetchSuite(OfxPropertySetHandle host, const char* suite_name, int suite_version);
+
+  /*
+   * Image effect suite
+   */
+
+  static OfxStatus GetPropertySet(OfxImageEffectHandle effect, OfxPropertySetHandle* properties);
+  static OfxStatus GetParamSet(OfxImageEffectHandle effect, OfxParamSetHandle* param_set);
+  static OfxStatus ClipDefine(OfxImageEffectHandle effect, const char* name, OfxPropertySetHandle* properties);
+  static OfxStatus ClipGetHandle(OfxImageEffectHandle effect, const char* name, OfxImageClipHandle* clip,
+                                 OfxPropertySetHandle* properties);
+  static OfxStatus ClipGetPropertySet(OfxImageClipHandle clip, OfxPropertySetHandle* properties);
+  static OfxStatus ClipGetImage(OfxImageClipHandle clip, OfxTime time, const OfxRectD* region,
+                                OfxPropertySetHandle* image);
+  static OfxStatus ClipReleaseImage(OfxPropertySetHandle image);
+  static OfxStatus ClipGetRegionOfDefinition(OfxImageClipHandle clip, OfxTime time, OfxRectD* bounds);
+  static int Abort(OfxImageEffectHandle effect);
+  static OfxStatus ImageMemoryAlloc(OfxImageEffectHandle effect, size_t bytes, OfxImageMemoryHandle* memory);
+  static OfxStatus ImageMemoryFree(OfxImageMemoryHandle memory);
+  static OfxStatus ImageMemoryLock(OfxImageMemoryHandle memory, void** data);
+  static OfxStatus ImageMemoryUnlock(OfxImageMemoryHandle memory);
+
+  /*
+   * Parameter suite
+   */
+
+  static OfxStatus ParamDefine(OfxParamSetHandle param_set, const char* type, const char* name,
+                               OfxPropertySetHandle* properties);
+  static OfxStatus ParamGetHandle(OfxParamSetHandle param_set, const char* name, OfxParamHandle* param,
+                                  OfxPropertySetHandle* properties);
+  static OfxStatus ParamSetGetPropertySet(OfxParamSetHandle param_set, OfxPropertySetHandle* properties);
+  static OfxStatus ParamGetPropertySet(OfxParamHandle param, OfxPropertySetHandle* properties);
+  static OfxStatus ParamGetValue(OfxParamHandle param, ...);
+  static OfxStatus ParamGetValueAtTime(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetDerivative(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetIntegral(OfxParamHandle param, OfxTime time1, OfxTime time2, ...);
+  static OfxStatus ParamSetValue(OfxParamHandle param, ...);
+  static OfxStatus ParamSetValueAtTime(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetNumKeys(OfxParamHandle param, unsigned int* count);
+  static OfxStatus ParamGetKeyTime(OfxParamHandle param, unsigned int key, OfxTime* time);
+  static OfxStatus ParamGetKeyIndex(OfxParamHandle param, OfxTime time, int direction, int* index);
+  static OfxStatus ParamDeleteKey(OfxParamHandle param, OfxTime time);
+  static OfxStatus ParamDeleteAllKeys(OfxParamHandle param);
+  static OfxStatus ParamCopy(OfxParamHandle to, OfxParamHandle from, OfxTime offset, const OfxRangeD* range);
+  static OfxStatus ParamEditBegin(OfxParamSetHandle param_set, const char* name);
+  static OfxStatus ParamEditEnd(OfxParamSetHandle param_set);
+
+  /*
+   * Memory, multithread and message suites
+   */
+
+  static OfxStatus MemoryAlloc(void* handle, size_t bytes, void** data);
+  static OfxStatus MemoryFree(void* data);
+  static OfxStatus MultiThread(OfxThreadFunctionV1 func, unsigned int thread_count, void* arg);
+  static OfxStatus MultiThreadNumCPUs(unsigned int* count);
+  static OfxStatus MultiThreadIndex(unsigned int* index);
+  static int MultiThreadIsSpawnedThread();
+  static OfxStatus MutexCreate(OfxMutexHandle* mutex, int lock_count);
+  static OfxStatus MutexDestroy(const OfxMutexHandle mutex);
+  static OfxStatus MutexLock(const OfxMutexHandle mutex);
+  static OfxStatus MutexUnLock(const OfxMutexHandle mutex);
+  static OfxStatus MutexTryLock(const OfxMutexHandle mutex);
+  static OfxStatus Message(void* handle, const char* type, const char* id, const char* format, ...);
+
+  /*
+   * OpenGL render suite
+   */
+
+  static OfxStatus ClipLoadTexture(OfxImageClipHandle clip, OfxTime time, const char* format, const OfxRectD* region,
+                                   OfxPropertySetHandle* texture);
+  static OfxStatus ClipFreeTexture(OfxPropertySetHandle texture);
+  static OfxStatus FlushResources();
+
+  /**
+   * @brief Describe an image or texture of a clip being rendered
+   */
+  static OfxPropertySet* CreateImage(Clip* clip, Render* render);
+
+  OfxPropertySet host_properties_;
+
+  // Handed to plugins in setHost()
+  OfxHost host_;
+
+  QList<Plugin*> plugins_;
+
+  bool scanned_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide OpenFX host
+ */
+extern OfxPluginHost ofx_host;
+}
+
+#endif // OFXPLUGINHOST_H
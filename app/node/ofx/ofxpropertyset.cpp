@@ -0,0 +1,627 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ofxpropertyset.h"
+
+OfxPropertySet::OfxPropertySet()
+{
+}
+
+OfxPropertySet::OfxPropertySet(const OfxPropertySet &other)
+{
+  QReadLocker locker(&other.lock_);
+
+  properties_ = other.properties_;
+}
+
+OfxPropertySet &OfxPropertySet::operator=(const OfxPropertySet &other)
+{
+  if (this != &other) {
+    QHash<QByteArray, Property> properties;
+
+    other.lock_.lockForRead();
+    properties = other.properties_;
+    other.lock_.unlock();
+
+    QWriteLocker locker(&lock_);
+    properties_ = properties;
+  }
+
+  return *this;
+}
+
+void OfxPropertySet::SetPointer(const char *name, void *value, int index)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kPointer);
+
+  if (p.pointers.size() <= index) {
+    p.pointers.resize(index + 1);
+  }
+
+  p.pointers[index] = value;
+}
+
+void OfxPropertySet::SetString(const char *name, const QByteArray &value, int index)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kString);
+
+  while (p.strings.size() <= index) {
+    p.strings.append(QByteArray());
+  }
+
+  p.strings[index] = value;
+}
+
+void OfxPropertySet::SetDouble(const char *name, double value, int index)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kDouble);
+
+  // Properties the host created as integers stay integers
+  if (p.type == kInt) {
+    if (p.ints.size() <= index) {
+      p.ints.resize(index + 1);
+    }
+
+    p.ints[index] = qRound(value);
+    return;
+  }
+
+  if (p.doubles.size() <= index) {
+    p.doubles.resize(index + 1);
+  }
+
+  p.doubles[index] = value;
+}
+
+void OfxPropertySet::SetInt(const char *name, int value, int index)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kInt);
+
+  if (p.type == kDouble) {
+    if (p.doubles.size() <= index) {
+      p.doubles.resize(index + 1);
+    }
+
+    p.doubles[index] = value;
+    return;
+  }
+
+  if (p.ints.size() <= index) {
+    p.ints.resize(index + 1);
+  }
+
+  p.ints[index] = value;
+}
+
+void OfxPropertySet::SetStrings(const char *name, const QList<QByteArray> &values)
+{
+  QWriteLocker locker(&lock_);
+
+  Writable(name, kString).strings = values;
+}
+
+void OfxPropertySet::SetDoubles(const char *name, const QVector<double> &values)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kDouble);
+
+  p.type = kDouble;
+  p.ints.clear();
+  p.doubles = values;
+}
+
+void OfxPropertySet::SetInts(const char *name, const QVector<int> &values)
+{
+  QWriteLocker locker(&lock_);
+
+  Property& p = Writable(name, kInt);
+
+  p.type = kInt;
+  p.doubles.clear();
+  p.ints = values;
+}
+
+void *OfxPropertySet::GetPointer(const char *name, int index) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  if (p == nullptr || p->type != kPointer || index >= p->pointers.size()) {
+    return nullptr;
+  }
+
+  return p->pointers.at(index);
+}
+
+QByteArray OfxPropertySet::GetString(const char *name, int index, const QByteArray &default_value) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  if (p == nullptr || p->type != kString || index >= p->strings.size()) {
+    return default_value;
+  }
+
+  return p->strings.at(index);
+}
+
+double OfxPropertySet::GetDouble(const char *name, int index, double default_value) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  if (p != nullptr) {
+    if (p->type == kDouble && index < p->doubles.size()) {
+      return p->doubles.at(index);
+    } else if (p->type == kInt && index < p->ints.size()) {
+      return p->ints.at(index);
+    }
+  }
+
+  return default_value;
+}
+
+int OfxPropertySet::GetInt(const char *name, int index, int default_value) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  if (p != nullptr) {
+    if (p->type == kInt && index < p->ints.size()) {
+      return p->ints.at(index);
+    } else if (p->type == kDouble && index < p->doubles.size()) {
+      return qRound(p->doubles.at(index));
+    }
+  }
+
+  return default_value;
+}
+
+QList<QByteArray> OfxPropertySet::GetStrings(const char *name) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  if (p == nullptr || p->type != kString) {
+    return QList<QByteArray>();
+  }
+
+  return p->strings;
+}
+
+int OfxPropertySet::Dimension(const char *name) const
+{
+  QReadLocker locker(&lock_);
+
+  const Property* p = Readable(name);
+
+  return p ? p->dimension() : 0;
+}
+
+OfxPropertySetHandle OfxPropertySet::handle()
+{
+  return reinterpret_cast<OfxPropertySetHandle>(this);
+}
+
+OfxPropertySet *OfxPropertySet::FromHandle(OfxPropertySetHandle handle)
+{
+  return reinterpret_cast<OfxPropertySet*>(handle);
+}
+
+const OfxPropertySuiteV1 *OfxPropertySet::Suite()
+{
+  static const OfxPropertySuiteV1 suite = {
+    PropSetPointer,
+    PropSetString,
+    PropSetDouble,
+    PropSetInt,
+    PropSetPointerN,
+    PropSetStringN,
+    PropSetDoubleN,
+    PropSetIntN,
+    PropGetPointer,
+    PropGetString,
+    PropGetDouble,
+    PropGetInt,
+    PropGetPointerN,
+    PropGetStringN,
+    PropGetDoubleN,
+    PropGetIntN,
+    PropReset,
+    PropGetDimension
+  };
+
+  return &suite;
+}
+
+int OfxPropertySet::Property::dimension() const
+{
+  switch (type) {
+  case kPointer:
+    return pointers.size();
+  case kString:
+    return strings.size();
+  case kDouble:
+    return doubles.size();
+  case kInt:
+    return ints.size();
+  }
+
+  return 0;
+}
+
+OfxPropertySet::Property &OfxPropertySet::Writable(const char *name, OfxPropertySet::Type type)
+{
+  QHash<QByteArray, Property>::iterator i = properties_.find(name);
+
+  if (i == properties_.end()) {
+    Property p;
+    p.type = type;
+    i = properties_.insert(name, p);
+  } else if (i->type != type && !((i->type == kInt || i->type == kDouble) && (type == kInt || type == kDouble))) {
+    // Anything but a number set as the other kind of number replaces the property
+    *i = Property();
+    i->type = type;
+  }
+
+  return *i;
+}
+
+const OfxPropertySet::Property *OfxPropertySet::Readable(const char *name) const
+{
+  QHash<QByteArray, Property>::const_iterator i = properties_.constFind(name);
+
+  if (i == properties_.constEnd()) {
+    return nullptr;
+  }
+
+  return &i.value();
+}
+
+OfxStatus OfxPropertySet::PropSetPointer(OfxPropertySetHandle properties, const char *property, int index,
+                                         void *value)
+{
+  if (properties == nullptr || index < 0) {
+    return properties ? kOfxStatErrBadIndex : kOfxStatErrBadHandle;
+  }
+
+  FromHandle(properties)->SetPointer(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetString(OfxPropertySetHandle properties, const char *property, int index,
+                                        const char *value)
+{
+  if (properties == nullptr || index < 0) {
+    return properties ? kOfxStatErrBadIndex : kOfxStatErrBadHandle;
+  }
+
+  FromHandle(properties)->SetString(property, QByteArray(value), index);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetDouble(OfxPropertySetHandle properties, const char *property, int index,
+                                        double value)
+{
+  if (properties == nullptr || index < 0) {
+    return properties ? kOfxStatErrBadIndex : kOfxStatErrBadHandle;
+  }
+
+  FromHandle(properties)->SetDouble(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetInt(OfxPropertySetHandle properties, const char *property, int index, int value)
+{
+  if (properties == nullptr || index < 0) {
+    return properties ? kOfxStatErrBadIndex : kOfxStatErrBadHandle;
+  }
+
+  FromHandle(properties)->SetInt(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetPointerN(OfxPropertySetHandle properties, const char *property, int count,
+                                          void * const *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropSetPointer(properties, property, i, value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetStringN(OfxPropertySetHandle properties, const char *property, int count,
+                                         const char * const *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropSetString(properties, property, i, value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetDoubleN(OfxPropertySetHandle properties, const char *property, int count,
+                                         const double *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropSetDouble(properties, property, i, value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropSetIntN(OfxPropertySetHandle properties, const char *property, int count,
+                                      const int *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropSetInt(properties, property, i, value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetPointer(OfxPropertySetHandle properties, const char *property, int index,
+                                         void **value)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QReadLocker locker(&set->lock_);
+
+  const Property* p = set->Readable(property);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  if (index < 0 || index >= p->dimension()) {
+    return kOfxStatErrBadIndex;
+  }
+
+  if (p->type != kPointer) {
+    return kOfxStatErrValue;
+  }
+
+  *value = p->pointers.at(index);
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetString(OfxPropertySetHandle properties, const char *property, int index,
+                                        char **value)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QReadLocker locker(&set->lock_);
+
+  const Property* p = set->Readable(property);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  if (index < 0 || index >= p->dimension()) {
+    return kOfxStatErrBadIndex;
+  }
+
+  if (p->type != kString) {
+    return kOfxStatErrValue;
+  }
+
+  // Points into the stored string, valid until it's set again
+  *value = const_cast<char*>(p->strings.at(index).constData());
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetDouble(OfxPropertySetHandle properties, const char *property, int index,
+                                        double *value)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QReadLocker locker(&set->lock_);
+
+  const Property* p = set->Readable(property);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  if (index < 0 || index >= p->dimension()) {
+    return kOfxStatErrBadIndex;
+  }
+
+  if (p->type == kDouble) {
+    *value = p->doubles.at(index);
+  } else if (p->type == kInt) {
+    *value = p->ints.at(index);
+  } else {
+    return kOfxStatErrValue;
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetInt(OfxPropertySetHandle properties, const char *property, int index, int *value)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QReadLocker locker(&set->lock_);
+
+  const Property* p = set->Readable(property);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  if (index < 0 || index >= p->dimension()) {
+    return kOfxStatErrBadIndex;
+  }
+
+  if (p->type == kInt) {
+    *value = p->ints.at(index);
+  } else if (p->type == kDouble) {
+    *value = qRound(p->doubles.at(index));
+  } else {
+    return kOfxStatErrValue;
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetPointerN(OfxPropertySetHandle properties, const char *property, int count,
+                                          void **value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropGetPointer(properties, property, i, &value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetStringN(OfxPropertySetHandle properties, const char *property, int count,
+                                         char **value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropGetString(properties, property, i, &value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetDoubleN(OfxPropertySetHandle properties, const char *property, int count,
+                                         double *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropGetDouble(properties, property, i, &value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetIntN(OfxPropertySetHandle properties, const char *property, int count, int *value)
+{
+  for (int i=0;i<count;i++) {
+    OfxStatus status = PropGetInt(properties, property, i, &value[i]);
+
+    if (status != kOfxStatOK) {
+      return status;
+    }
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropReset(OfxPropertySetHandle properties, const char *property)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QWriteLocker locker(&set->lock_);
+
+  // There are no defaults to reset to besides what the property was created with, so clear it
+  QHash<QByteArray, Property>::iterator i = set->properties_.find(property);
+
+  if (i == set->properties_.end()) {
+    return kOfxStatErrUnknown;
+  }
+
+  i->pointers.fill(nullptr);
+  for (int j=0;j<i->strings.size();j++) {
+    i->strings[j].clear();
+  }
+  i->doubles.fill(0.0);
+  i->ints.fill(0);
+
+  return kOfxStatOK;
+}
+
+OfxStatus OfxPropertySet::PropGetDimension(OfxPropertySetHandle properties, const char *property, int *count)
+{
+  if (properties == nullptr) {
+    return kOfxStatErrBadHandle;
+  }
+
+  OfxPropertySet* set = FromHandle(properties);
+  QReadLocker locker(&set->lock_);
+
+  const Property* p = set->Readable(property);
+
+  if (p == nullptr) {
+    return kOfxStatErrUnknown;
+  }
+
+  *count = p->dimension();
+  return kOfxStatOK;
+}
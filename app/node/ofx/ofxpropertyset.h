@@ -0,0 +1,139 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OFXPROPERTYSET_H
+#define OFXPROPERTYSET_H
+
+#include <ofxProperty.h>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QVector>
+
+/**
+ * @brief An OpenFX property set, the named and typed values everything in the OFX API is described with
+ *
+ * Plugins read and write these through the property suite (see Suite()) using the handle(), the host uses the C++
+ * functions. Properties that don't exist yet are created by whichever side sets them first, with the type they're set
+ * with (integers and doubles are converted to each other when read as the other).
+ *
+ * Plugins may read an instance's properties from every render thread at once, so access is locked. Strings returned to
+ * plugins stay valid until the property is set again.
+ */
+class OfxPropertySet
+{
+public:
+  OfxPropertySet();
+
+  OfxPropertySet(const OfxPropertySet& other);
+  OfxPropertySet& operator=(const OfxPropertySet& other);
+
+  void SetPointer(const char* name, void* value, int index = 0);
+  void SetString(const char* name, const QByteArray& value, int index = 0);
+  void SetDouble(const char* name, double value, int index = 0);
+  void SetInt(const char* name, int value, int index = 0);
+
+  void SetStrings(const char* name, const QList<QByteArray>& values);
+  void SetDoubles(const char* name, const QVector<double>& values);
+  void SetInts(const char* name, const QVector<int>& values);
+
+  void* GetPointer(const char* name, int index = 0) const;
+  QByteArray GetString(const char* name, int index = 0, const QByteArray& default_value = QByteArray()) const;
+  double GetDouble(const char* name, int index = 0, double default_value = 0.0) const;
+  int GetInt(const char* name, int index = 0, int default_value = 0) const;
+
+  QList<QByteArray> GetStrings(const char* name) const;
+
+  /**
+   * @brief Number of values a property has (0 if it doesn't exist)
+   */
+  int Dimension(const char* name) const;
+
+  OfxPropertySetHandle handle();
+
+  static OfxPropertySet* FromHandle(OfxPropertySetHandle handle);
+
+  /**
+   * @brief The property suite handed to plugins (kOfxPropertySuite version 1)
+   */
+  static const OfxPropertySuiteV1* Suite();
+
+private:
+  enum Type {
+    kPointer,
+    kString,
+    kDouble,
+    kInt
+  };
+
+  struct Property {
+    Type type;
+
+    QVector<void*> pointers;
+    QList<QByteArray> strings;
+    QVector<double> doubles;
+    QVector<int> ints;
+
+    int dimension() const;
+  };
+
+  /**
+   * @brief Returns a property to write to, creating it (or changing its type) if necessary (lock_ must be locked)
+   */
+  Property& Writable(const char* name, Type type);
+
+  /**
+   * @brief Returns a property to read from, or nullptr if it doesn't exist (lock_ must be locked)
+   */
+  const Property* Readable(const char* name) const;
+
+  /*
+   * Property suite
+   */
+
+  static OfxStatus PropSetPointer(OfxPropertySetHandle properties, const char* property, int index, void* value);
+  static OfxStatus PropSetString(OfxPropertySetHandle properties, const char* property, int index, const char* value);
+  static OfxStatus PropSetDouble(OfxPropertySetHandle properties, const char* property, int index, double value);
+  static OfxStatus PropSetInt(OfxPropertySetHandle properties, const char* property, int index, int value);
+  static OfxStatus PropSetPointerN(OfxPropertySetHandle properties, const char* property, int count,
+                                   void* const* value);
+  static OfxStatus PropSetStringN(OfxPropertySetHandle properties, const char* property, int count,
+                                  const char* const* value);
+  static OfxStatus PropSetDoubleN(OfxPropertySetHandle properties, const char* property, int count,
+                                  const double* value);
+  static OfxStatus PropSetIntN(OfxPropertySetHandle properties, const char* property, int count, const int* value);
+  static OfxStatus PropGetPointer(OfxPropertySetHandle properties, const char* property, int index, void** value);
+  static OfxStatus PropGetString(OfxPropertySetHandle properties, const char* property, int index, char** value);
+  static OfxStatus PropGetDouble(OfxPropertySetHandle properties, const char* property, int index, double* value);
+  static OfxStatus PropGetInt(OfxPropertySetHandle properties, const char* property, int index, int* value);
+  static OfxStatus PropGetPointerN(OfxPropertySetHandle properties, const char* property, int count, void** value);
+  static OfxStatus PropGetStringN(OfxPropertySetHandle properties, const char* property, int count, char** value);
+  static OfxStatus PropGetDoubleN(OfxPropertySetHandle properties, const char* property, int count, double* value);
+  static OfxStatus PropGetIntN(OfxPropertySetHandle properties, const char* property, int count, int* value);
+  static OfxStatus PropReset(OfxPropertySetHandle properties, const char* property);
+  static OfxStatus PropGetDimension(OfxPropertySetHandle properties, const char* property, int* count);
+
+  QHash<QByteArray, Property> properties_;
+
+  mutable QReadWriteLock lock_;
+};
+
+#endif // OFXPROPERTYSET_H
@@ -20,9 +20,22 @@
 
 #include "output.h"
 
+#include <algorithm>
+#include <numeric>
+
+#include "common/tracing.h"
+#include "node/evaluationcontext.h"
+#include "node/input.h"
 #include "node/node.h"
+#include "node/processor/renderer/renderprofiler.h"
+
+// Depth of nested Hash() calls on this thread, a cycle in the graph stops recursing past kMaxHashDepth
+static thread_local int hash_depth = 0;
+const int kMaxHashDepth = 256;
 
-NodeOutput::NodeOutput()
+NodeOutput::NodeOutput() :
+  generation_(0),
+  invariance_(kInvarianceUnknown)
 {
 
 }
@@ -47,16 +60,262 @@ void NodeOutput::set_data_type(const NodeParam::DataType &type)
   }
 }
 
-const QVariant &NodeOutput::get_value(const rational& time)
+NodeValue NodeOutput::get_value(const rational& time)
 {
+  Qt::HANDLE context = NodeEvaluationContext::CurrentId();
+
+  // Render jobs at the same time can still differ in resolution and region
+  int divider = NodeEvaluationContext::CurrentDivider();
+  QRect tile = NodeEvaluationContext::CurrentTile();
+  bool keyframes_only = NodeEvaluationContext::CurrentKeyframesOnly();
+
+  bool time_invariant = IsTimeInvariant();
+
+  quint64 generation;
+
+  values_mutex_.lock();
+
+  QHash<Qt::HANDLE, CachedValue>::const_iterator cached = values_.constFind(context);
+
+  if (cached != values_.constEnd()
+      && cached->valid
+      && (cached->time == time || (time_invariant && cached->time_invariant))
+      && cached->divider == divider
+      && cached->tile == tile
+      && cached->keyframes_only == keyframes_only) {
+    NodeValue value = cached->value;
+
+    values_mutex_.unlock();
+
+    return value;
+  }
+
+  generation = generation_;
+
+  values_mutex_.unlock();
+
+  // Nothing this output shows is in the tile, so it's transparent there without processing anything
+  if (data_type_ == kTexture && !tile.isNull()) {
+    QRect bounds;
+
+    if (parent()->DomainOfDefinition(this, time, &bounds) && !bounds.intersects(tile)) {
+      return NodeValue::Texture(0);
+    }
+  }
+
+  RenderProfiler* profiler = RenderProfiler::Current();
+
+  if (profiler != nullptr) {
+    profiler->BeginNode(parent());
+  }
+
   // Node::Process() should put the correct value in this output
-  parent()->Process(time);
+  {
+    Tracing::Span span("node", "Node::Process");
+
+    if (span.IsActive()) {
+      span.SetDetail(parent()->id());
+    }
+
+    parent()->Process(time);
+  }
+
+  if (profiler != nullptr) {
+    profiler->EndNode();
+  }
 
   // The value should be have been set by this point
-  return value_;
+  QMutexLocker locker(&values_mutex_);
+
+  CachedValue& value = values_[context];
+
+  value.time = time;
+  value.divider = divider;
+  value.tile = tile;
+  value.keyframes_only = keyframes_only;
+  value.time_invariant = time_invariant;
+  value.valid = (generation == generation_);
+
+  return value.value;
+}
+
+void NodeOutput::get_samples(const QVector<rational> &times, const NodeSampleFunction &consume)
+{
+  if (times.isEmpty()) {
+    return;
+  }
+
+  if (IsTimeInvariant()) {
+    NodeValue value = get_value(times.first());
+
+    for (int i=0;i<times.size();i++) {
+      consume(i, value);
+    }
+
+    return;
+  }
+
+  QVector<int> order(times.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  std::stable_sort(order.begin(), order.end(), [&times](int a, int b) {
+    return times.at(a) < times.at(b);
+  });
+
+  // Group samples that will have the same value, each group is processed once
+  bool compare_content = (data_type_ == kTexture);
+
+  QVector<rational> group_times;
+  QVector<QVector<int> > groups;
+  QHash<QByteArray, int> content_groups;
+
+  foreach (int index, order) {
+    const rational& time = times.at(index);
+
+    if (!group_times.isEmpty() && group_times.last() == time) {
+      groups.last().append(index);
+      continue;
+    }
+
+    if (compare_content) {
+      QByteArray content = ContentHash(time);
+      QHash<QByteArray, int>::const_iterator group = content_groups.constFind(content);
+
+      if (group != content_groups.constEnd()) {
+        groups[group.value()].append(index);
+        continue;
+      }
+
+      content_groups.insert(content, group_times.size());
+    }
+
+    group_times.append(time);
+    groups.append(QVector<int>({index}));
+  }
+
+  parent()->ProcessSamples(this, group_times, [&groups, &consume](int group, const NodeValue& value) {
+    foreach (int index, groups.at(group)) {
+      consume(index, value);
+    }
+  });
+}
+
+void NodeOutput::set_value(const NodeValue &value)
+{
+  QMutexLocker locker(&values_mutex_);
+
+  values_[NodeEvaluationContext::CurrentId()].value = value;
+}
+
+void NodeOutput::InvalidateCachedValues(const rational &start_range, const rational &end_range)
+{
+  QMutexLocker locker(&values_mutex_);
+
+  generation_++;
+
+  // Whatever changed may have made this output time dependent (or not)
+  invariance_.store(kInvarianceUnknown);
+
+  QHash<Qt::HANDLE, CachedValue>::iterator i;
+
+  for (i=values_.begin();i!=values_.end();i++) {
+    // Time-invariant values stand for every time, so any invalidation affects them
+    if (i->time_invariant || (i->time >= start_range && i->time <= end_range)) {
+      i->valid = false;
+    }
+  }
+}
+
+void NodeOutput::ClearCachedValues()
+{
+  QMutexLocker locker(&values_mutex_);
+
+  generation_++;
+
+  invariance_.store(kInvarianceUnknown);
+
+  QHash<Qt::HANDLE, CachedValue>::iterator i;
+
+  for (i=values_.begin();i!=values_.end();i++) {
+    i->valid = false;
+  }
+}
+
+void NodeOutput::ReleaseValue(bool force)
+{
+  QMutexLocker locker(&values_mutex_);
+
+  QHash<Qt::HANDLE, CachedValue>::iterator i = values_.find(NodeEvaluationContext::CurrentId());
+
+  if (i != values_.end() && (force || !i->time_invariant)) {
+    values_.erase(i);
+  }
+}
+
+bool NodeOutput::IsTimeInvariant()
+{
+  int state = invariance_.load();
+
+  if (state != kInvarianceUnknown) {
+    return state == kTimeInvariant;
+  }
+
+  // Assume time dependence while checking so a cycle can't recurse forever
+  invariance_.store(kTimeDependent);
+
+  bool invariant = !parent()->IsTimeDependent();
+
+  QList<NodeParam*> params = parent()->parameters();
+
+  for (int i=0;i<params.size() && invariant;i++) {
+    NodeParam* param = params.at(i);
+
+    if (param->type() != NodeParam::kInput) {
+      continue;
+    }
+
+    NodeInput* input = static_cast<NodeInput*>(param);
+
+    if (input->edges().isEmpty()) {
+      invariant = !input->IsAnimated();
+    } else {
+      for (int j=0;j<input->edges().size() && invariant;j++) {
+        invariant = input->edges().at(j)->output()->IsTimeInvariant();
+      }
+    }
+  }
+
+  invariance_.store(invariant ? kTimeInvariant : kTimeDependent);
+
+  return invariant;
+}
+
+void NodeOutput::Hash(QCryptographicHash *hash, const rational &time)
+{
+  hash->addData(QByteArray::number(parent()->IndexOfParameter(this)));
+
+  if (hash_depth >= kMaxHashDepth) {
+    return;
+  }
+
+  hash_depth++;
+  parent()->Hash(hash, time);
+  hash_depth--;
+}
+
+QByteArray NodeOutput::ContentHash(const rational &time)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  Hash(&hash, time);
+
+  return hash.result();
 }
 
-void NodeOutput::set_value(const QVariant &value)
+NodeOutput::CachedValue::CachedValue() :
+  divider(1),
+  keyframes_only(false),
+  time_invariant(false),
+  valid(false)
 {
-  value_ = value;
 }
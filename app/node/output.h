@@ -21,7 +21,15 @@
 #ifndef NODEOUTPUT_H
 #define NODEOUTPUT_H
 
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+
 #include "param.h"
+#include "value.h"
 
 /**
  * @brief A node parameter designed to serve data to the input of another node
@@ -60,21 +68,126 @@ public:
    *
    * In many cases for efficiency, the Node can also ignore this request if it knows the output data will not change
    * (i.e. if the time has not changed from the last Process()).
+   *
+   * Values are kept separately for each evaluation context (see NodeEvaluationContext), so several threads (e.g.
+   * RendererThreads) can pull the same node graph at different times without overwriting each other's values.
+   *
+   * Each context's last value is cached along with the time (and divider, tile and whether it only wanted keyframes) it
+   * was processed at, so pulling this output again at the same time (e.g. from several inputs) returns the cached value
+   * without processing the Node again. The cache is invalidated by Node::InvalidateCache() and when the Node's inputs
+   * are reconnected.
+   *
+   * If this output is time-invariant (see IsTimeInvariant()), the cached value is reused at every time until it's
+   * invalidated.
+   *
+   * Texture outputs whose Node::DomainOfDefinition() doesn't reach the tile being rendered return an empty texture
+   * without processing the Node.
    */
-  virtual const QVariant& get_value(const rational &time);
+  virtual NodeValue get_value(const rational &time);
+
+  /**
+   * @brief Get the value of this output at several times, e.g. sub-frame samples for motion blur or frame blending
+   *
+   * Every value is passed to `consume` as soon as it's processed, in no particular order. This costs less than
+   * calling get_value() for each time:
+   *
+   * * A time-invariant output (see IsTimeInvariant()) is processed once and shared by every sample
+   * * Samples are processed in time order, so keyframe lookups upstream find their segment in O(1) and sources read
+   *   forwards
+   * * Samples at the same time, or showing the same content (see ContentHash(), only checked for textures where
+   *   processing is expensive) are processed once and share the value
+   * * The Node can process the samples together (see Node::ProcessSamples())
+   */
+  void get_samples(const QVector<rational>& times, const NodeSampleFunction& consume);
 
   /**
    * @brief Set the current value of this output
    *
    * Intended to only be set by parent Node objects in their Node::Process() function. Whatever result data is intended
-   * for use later in the pipeline should be set here (\see get_value()).
+   * for use later in the pipeline should be set here (\see get_value()). The value is only visible to the calling
+   * thread's current evaluation context.
+   */
+  virtual void set_value(const NodeValue& value);
+
+  /**
+   * @brief Invalidate cached values processed between start_range and end_range (inclusive)
+   *
+   * Called by Node::InvalidateCache().
+   */
+  void InvalidateCachedValues(const rational& start_range, const rational& end_range);
+
+  /**
+   * @brief Invalidate all cached values
+   */
+  void ClearCachedValues();
+
+  /**
+   * @brief Drop the current evaluation context's value once nothing needs it anymore (see NodeGraphPlan)
+   *
+   * Time-invariant values are kept since they're needed again on the next frame, unless `force` is TRUE.
    */
-  virtual void set_value(const QVariant& value);
+  void ReleaseValue(bool force = false);
+
+  /**
+   * @brief Returns TRUE if this output has the same value at every time
+   *
+   * That's the case if its Node isn't time dependent (see Node::IsTimeDependent()) and none of the Node's inputs are
+   * animated (see NodeInput::IsAnimated()) or connected to outputs that aren't time-invariant themselves. The result
+   * is cached until this output is invalidated.
+   */
+  bool IsTimeInvariant();
+
+  /**
+   * @brief Add what determines this output's value at a time to a hash (see Node::Hash())
+   */
+  void Hash(QCryptographicHash* hash, const rational& time);
+
+  /**
+   * @brief A SHA-1 of everything this output's value at a time is made from
+   *
+   * Covers the type and inputs of every node upstream at that time, after keyframes are evaluated, so it's equal at two
+   * times when nothing upstream changes between them (e.g. a still section), for copies of the same graph and after
+   * an edit is undone. Like evaluations, reads the graph snapshot pinned by the current evaluation context if there is
+   * one.
+   */
+  QByteArray ContentHash(const rational& time);
 
 private:
+  struct CachedValue {
+    CachedValue();
+
+    NodeValue value;
+
+    // What the value was processed for (only meaningful if valid is TRUE)
+    rational time;
+    int divider;
+    QRect tile;
+    bool keyframes_only;
+
+    // The value was processed while this output was time-invariant, so it's valid at any time
+    bool time_invariant;
+
+    bool valid;
+  };
+
+  enum Invariance {
+    kInvarianceUnknown,
+    kTimeInvariant,
+    kTimeDependent
+  };
+
   DataType data_type_;
 
-  QVariant value_;
+  // Current value for each evaluation context that has processed this output (see NodeEvaluationContext::CurrentId())
+  QHash<Qt::HANDLE, CachedValue> values_;
+
+  // Incremented whenever values are invalidated so values processed during an invalidation aren't cached
+  quint64 generation_;
+
+  // Cached result of IsTimeInvariant() (an Invariance)
+  QAtomicInt invariance_;
+
+  QMutex values_mutex_;
 };
 
 #endif // NODEOUTPUT_H
@@ -35,28 +35,82 @@ NodeInput *ViewerOutput::texture_input()
   return texture_input_;
 }
 
+void ViewerOutput::InvalidateCache(const rational &start_range, const rational &end_range)
+{
+  emit Invalidated(start_range, end_range, false);
+
+  Node::InvalidateCache(start_range, end_range);
+}
+
+void ViewerOutput::ClearCachedValues()
+{
+  emit Invalidated(rational(), rational(), true);
+
+  Node::ClearCachedValues();
+}
+
 void ViewerOutput::Process(const rational &time)
 {
   if (attached_viewer_ != nullptr) {
     // Get the texture from whatever Node is currently connected (usually a Renderer of some kind)
-    GLuint current_texture = texture_input_->get_value(time).value<GLuint>();
+    GLuint current_texture = texture_input_->get_value(time).toTexture();
 
     // Send the texture to the Viewer
     attached_viewer_->SetTexture(current_texture);
   }
 }
 
+void ViewerOutput::FrameReady(RenderJobPtr job)
+{
+  if (attached_viewer_ != nullptr) {
+    // Render threads share textures with the viewer, so hand it the texture directly along with the fence to wait on
+    attached_viewer_->SetTexture(job->result().toTexture(), job->TakeFence());
+  }
+}
+
+void ViewerOutput::PresentFrame(RenderJobPtr job, qint64 present_time)
+{
+  if (attached_viewer_ != nullptr) {
+    attached_viewer_->QueueTexture(job->result().toTexture(), job->TakeFence(), present_time);
+  }
+}
+
+void ViewerOutput::ProfileReady(RenderProfile profile)
+{
+  if (attached_viewer_ == nullptr) {
+    return;
+  }
+
+  // Number of nodes to list
+  const int kSlowestNodeCount = 5;
+
+  QStringList lines;
+
+  lines.append(tr("Frame %1").arg(profile.time.ToDouble()));
+
+  for (int i=0;i<profile.nodes.size() && i<kSlowestNodeCount;i++) {
+    const RenderNodeTiming& timing = profile.nodes.at(i);
+
+    lines.append(tr("%1: CPU %2 ms, GPU %3 ms").arg(timing.name,
+                                                    QString::number(timing.cpu_ms, 'f', 2),
+                                                    QString::number(timing.gpu_ms, 'f', 2)));
+  }
+
+  attached_viewer_->SetOverlayText(lines);
+}
+
 void ViewerOutput::AttachViewer(ViewerPanel *viewer)
 {
   // Disconnect old viewer if there's one attached
   if (attached_viewer_ != nullptr) {
-    disconnect(attached_viewer_, SIGNAL(TimeChanged(const rational&)), this, SLOT(Process(const rational&)));
+    disconnect(attached_viewer_, &ViewerPanel::TimeChanged, this, &ViewerOutput::Process);
   }
 
   // FIXME: Currently this attaches to ViewerPanels, but should it attached to Viewers instead?
   attached_viewer_ = viewer;
 
   if (attached_viewer_ != nullptr) {
-    connect(attached_viewer_, SIGNAL(TimeChanged(const rational&)), this, SLOT(Process(const rational&)));
+    // A direct connection so the frame is processed as soon as the time changes instead of after a queued hop
+    connect(attached_viewer_, &ViewerPanel::TimeChanged, this, &ViewerOutput::Process, Qt::DirectConnection);
   }
 }
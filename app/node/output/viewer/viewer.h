@@ -2,6 +2,8 @@
 #define VIEWER_H
 
 #include "node/node.h"
+#include "node/processor/renderer/renderjob.h"
+#include "node/processor/renderer/renderprofiler.h"
 #include "panel/viewer/viewer.h"
 
 /**
@@ -24,9 +26,43 @@ public:
 
   void AttachViewer(ViewerPanel* viewer);
 
+  virtual void InvalidateCache(const rational &start_range, const rational &end_range) override;
+
+  virtual void ClearCachedValues() override;
+
 public slots:
   virtual void Process(const rational &time) override;
 
+  /**
+   * @brief Send a frame rendered by RendererProcessor::QueueFrame() to the attached viewer
+   *
+   * Connect to RendererProcessor::FrameReady() (with a queued connection) to show frames in presentation order.
+   */
+  void FrameReady(RenderJobPtr job);
+
+  /**
+   * @brief Queue a frame from PlaybackEngine::PresentFrame() to be shown on the attached viewer at its due time
+   */
+  void PresentFrame(RenderJobPtr job, qint64 present_time);
+
+  /**
+   * @brief Show the slowest nodes of a frame over the attached viewer
+   *
+   * Connect to RendererProcessor::ProfileReady() (with a queued connection) and enable profiling with
+   * RendererProcessor::SetProfilingEnabled().
+   */
+  void ProfileReady(RenderProfile profile);
+
+signals:
+  /**
+   * @brief Emitted whenever anything this viewer shows is invalidated, so sequences nesting it can follow
+   *
+   * @param all
+   *
+   * TRUE if every time was invalidated (see Node::ClearCachedValues()), in which case the range is meaningless.
+   */
+  void Invalidated(const rational& start_range, const rational& end_range, bool all);
+
 private:
   NodeInput* texture_input_;
 
@@ -21,11 +21,18 @@
 #include "param.h"
 
 #include <QDebug>
+#include <QHash>
+#include <QPair>
 
+#include "node/graph.h"
 #include "node/node.h"
 #include "node/input.h"
 #include "node/output.h"
 
+int NodeParam::batch_depth_ = 0;
+QVector<NodeEdgePtr> NodeParam::batch_added_;
+QVector<NodeEdgePtr> NodeParam::batch_removed_;
+
 NodeParam::NodeParam()
 {
 }
@@ -126,9 +133,13 @@ NodeEdgePtr NodeParam::ConnectEdge(NodeOutput *output, NodeInput *input)
 
   output->edges_.append(edge);
   input->edges_.append(edge);
+  input->PublishOutputs();
+
+  // Whatever the input's Node cached was processed with the old connections
+  input->parent()->ClearCachedValues();
 
   // Emit a signal than an edge was added (only one signal needs emitting)
-  emit output->EdgeAdded(edge);
+  NotifyEdgeAdded(edge);
 
   return edge;
 }
@@ -140,8 +151,11 @@ void NodeParam::DisconnectEdge(NodeEdgePtr edge)
 
   output->edges_.removeAll(edge);
   input->edges_.removeAll(edge);
+  input->PublishOutputs();
+
+  input->parent()->ClearCachedValues();
 
-  emit output->EdgeRemoved(edge);
+  NotifyEdgeRemoved(edge);
 }
 
 void NodeParam::DisconnectEdge(NodeOutput *output, NodeInput *input)
@@ -183,8 +197,94 @@ QString NodeParam::GetDefaultDataTypeName(const DataType& type)
   case kTexture: return tr("Texture");
   case kMatrix: return tr("Matrix");
   case kBlock: return tr("Block");
+  case kSamples: return tr("Samples");
   case kAny: return tr("Any");
   }
 
   return QString();
 }
+
+void NodeParam::BeginEdgeBatch()
+{
+  batch_depth_++;
+}
+
+void NodeParam::EndEdgeBatch()
+{
+  Q_ASSERT(batch_depth_ > 0);
+
+  batch_depth_--;
+
+  if (batch_depth_ > 0) {
+    return;
+  }
+
+  QVector<NodeEdgePtr> added = batch_added_;
+  QVector<NodeEdgePtr> removed = batch_removed_;
+
+  batch_added_.clear();
+  batch_removed_.clear();
+
+  // Group the changes by the graph they belong to so each graph gets exactly one notification
+  QHash<NodeGraph*, QPair<QVector<NodeEdgePtr>, QVector<NodeEdgePtr> > > changes;
+  QVector<NodeGraph*> order;
+
+  foreach (NodeEdgePtr edge, removed) {
+    NodeGraph* graph = qobject_cast<NodeGraph*>(edge->output()->parent()->parent());
+
+    if (graph == nullptr) {
+      emit edge->output()->EdgeRemoved(edge);
+      continue;
+    }
+
+    if (!changes.contains(graph)) {
+      order.append(graph);
+    }
+
+    changes[graph].second.append(edge);
+  }
+
+  foreach (NodeEdgePtr edge, added) {
+    NodeGraph* graph = qobject_cast<NodeGraph*>(edge->output()->parent()->parent());
+
+    if (graph == nullptr) {
+      emit edge->output()->EdgeAdded(edge);
+      continue;
+    }
+
+    if (!changes.contains(graph)) {
+      order.append(graph);
+    }
+
+    changes[graph].first.append(edge);
+  }
+
+  foreach (NodeGraph* graph, order) {
+    const QPair<QVector<NodeEdgePtr>, QVector<NodeEdgePtr> >& c = changes.value(graph);
+
+    emit graph->EdgesChanged(c.first, c.second);
+  }
+}
+
+void NodeParam::NotifyEdgeAdded(NodeEdgePtr edge)
+{
+  if (batch_depth_ == 0) {
+    emit edge->output()->EdgeAdded(edge);
+    return;
+  }
+
+  batch_added_.append(edge);
+}
+
+void NodeParam::NotifyEdgeRemoved(NodeEdgePtr edge)
+{
+  if (batch_depth_ == 0) {
+    emit edge->output()->EdgeRemoved(edge);
+    return;
+  }
+
+  // An edge made and broken within the same batch never needs to be seen by listeners
+  if (!batch_added_.removeOne(edge)) {
+    batch_removed_.append(edge);
+  }
+}
@@ -65,6 +65,7 @@ public:
     kTexture,
     kMatrix,
     kBlock,
+    kSamples,
     kAny
   };
 
@@ -185,6 +186,26 @@ public:
    */
   static NodeEdgePtr DisconnectForNewOutput(NodeInput* input);
 
+  /**
+   * @brief Start deferring edge notifications
+   *
+   * Between BeginEdgeBatch() and the matching EndEdgeBatch(), ConnectEdge() and DisconnectEdge() still change the
+   * connections immediately but don't emit EdgeAdded() or EdgeRemoved(). Instead the changes are collected and sent to
+   * each NodeGraph as one NodeGraph::EdgesChanged() when the outermost batch ends. Batches may be nested.
+   *
+   * Use this when making many connections at once (e.g. loading or pasting a graph) so listeners rebuild once rather
+   * than once per edge. Only call from the main thread.
+   */
+  static void BeginEdgeBatch();
+
+  /**
+   * @brief Finish a batch started with BeginEdgeBatch() and emit the coalesced changes
+   *
+   * An edge that was both connected and disconnected inside the batch isn't reported at all. Edges whose nodes don't
+   * belong to a NodeGraph are reported with the usual per-edge signals.
+   */
+  static void EndEdgeBatch();
+
   /**
    * @brief Get a human-readable translated name for a certain data type
    */
@@ -213,6 +234,19 @@ protected:
    */
   QVector<NodeEdgePtr> edges_;
 
+private:
+  /**
+   * @brief Record an edge change, either emitting it now or queuing it for EndEdgeBatch()
+   */
+  static void NotifyEdgeAdded(NodeEdgePtr edge);
+  static void NotifyEdgeRemoved(NodeEdgePtr edge);
+
+  static int batch_depth_;
+
+  static QVector<NodeEdgePtr> batch_added_;
+
+  static QVector<NodeEdgePtr> batch_removed_;
+
 private:
   /**
    * @brief Internal name string
@@ -221,4 +255,23 @@ private:
 
 };
 
+/**
+ * @brief RAII wrapper around NodeParam::BeginEdgeBatch() and NodeParam::EndEdgeBatch()
+ */
+class NodeEdgeBatch
+{
+public:
+  NodeEdgeBatch()
+  {
+    NodeParam::BeginEdgeBatch();
+  }
+
+  ~NodeEdgeBatch()
+  {
+    NodeParam::EndEdgeBatch();
+  }
+
+  Q_DISABLE_COPY(NodeEdgeBatch)
+};
+
 #endif // NODEPARAM_H
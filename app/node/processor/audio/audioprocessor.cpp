@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioprocessor.h"
+
+#include "node/evaluationcontext.h"
+
+AudioProcessor::AudioProcessor()
+{
+  samples_input_ = new NodeInput();
+  samples_input_->add_data_input(NodeParam::kSamples);
+  AddParameter(samples_input_);
+
+  samples_output_ = new NodeOutput();
+  samples_output_->set_data_type(NodeOutput::kSamples);
+  AddParameter(samples_output_);
+}
+
+AudioProcessor::~AudioProcessor()
+{
+  qDeleteAll(buffers_);
+}
+
+QString AudioProcessor::Category()
+{
+  return tr("Audio");
+}
+
+bool AudioProcessor::RunsOnCPU()
+{
+  return true;
+}
+
+NodeInput *AudioProcessor::samples_input()
+{
+  return samples_input_;
+}
+
+NodeOutput *AudioProcessor::samples_output()
+{
+  return samples_output_;
+}
+
+rational AudioProcessor::block_end(const SampleBuffer &block, const rational &time)
+{
+  if (block.sample_rate() <= 0) {
+    return time;
+  }
+
+  return time + rational(block.sample_count(), block.sample_rate());
+}
+
+void AudioProcessor::Process(const rational &time)
+{
+  const SampleBuffer* input = samples_input_->get_value(time).toSamples();
+
+  if (input == nullptr || input->sample_count() == 0) {
+    samples_output_->set_value(NodeValue());
+    return;
+  }
+
+  SampleBuffer* output;
+
+  {
+    QMutexLocker locker(&buffers_mutex_);
+
+    output = buffers_.value(NodeEvaluationContext::CurrentId());
+
+    if (output == nullptr) {
+      output = new SampleBuffer();
+      buffers_.insert(NodeEvaluationContext::CurrentId(), output);
+    }
+  }
+
+  output->Create(input->channels(), input->sample_count(), input->sample_rate());
+
+  ProcessSamples(*input, output, time);
+
+  samples_output_->set_value(NodeValue::Samples(output));
+}
@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOPROCESSOR_H
+#define AUDIOPROCESSOR_H
+
+#include <QHash>
+#include <QMutex>
+
+#include "audio/samplebuffer.h"
+#include "node/node.h"
+
+/**
+ * @brief A base class for nodes that process audio a block of samples at a time
+ *
+ * Video nodes are processed once per frame, but audio can't be processed once per sample (far too slow) or once per
+ * frame (frames don't line up with sample blocks). Audio is instead evaluated in blocks: the evaluation context's
+ * time() is the block's first sample and sample_count() its length (see NodeEvaluationContext::set_samples()), and
+ * audio is passed between nodes as NodeParam::kSamples values holding a SampleBuffer.
+ *
+ * Subclasses only implement ProcessSamples(), which receives the whole block so each channel can be processed in one
+ * vectorised call (see olive::audio). Values of other inputs can be read at the start and end of the block (see
+ * block_end()) to ramp them smoothly across it.
+ */
+class AudioProcessor : public Node
+{
+  Q_OBJECT
+public:
+  AudioProcessor();
+
+  virtual ~AudioProcessor() override;
+
+  virtual QString Category() override;
+
+  /**
+   * @brief Audio never uses OpenGL
+   */
+  virtual bool RunsOnCPU() override;
+
+  NodeInput* samples_input();
+
+  NodeOutput* samples_output();
+
+  /**
+   * @brief Process a block of samples
+   *
+   * @param input
+   *
+   * The block received from samples_input().
+   *
+   * @param output
+   *
+   * Buffer with the same format as `input` to write the processed block to (its samples are undefined beforehand).
+   *
+   * @param time
+   *
+   * Time of the block's first sample.
+   */
+  virtual void ProcessSamples(const SampleBuffer& input, SampleBuffer* output, const rational& time) = 0;
+
+  /**
+   * @brief Returns the time just after the last sample of a block starting at `time`
+   */
+  static rational block_end(const SampleBuffer& block, const rational& time);
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  NodeInput* samples_input_;
+
+  NodeOutput* samples_output_;
+
+  // Output buffer for each evaluation context, since blocks can be processed concurrently
+  QHash<Qt::HANDLE, SampleBuffer*> buffers_;
+
+  QMutex buffers_mutex_;
+};
+
+#endif // AUDIOPROCESSOR_H
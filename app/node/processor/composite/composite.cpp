@@ -0,0 +1,350 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "composite.h"
+
+#include <QDebug>
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/cpurender.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+
+CompositeNode::CompositeNode()
+{
+  layers_input_ = new NodeInput();
+  layers_input_->add_data_input(NodeParam::kTexture);
+  layers_input_->set_can_accept_multiple_inputs(true);
+  layers_input_->set_name(tr("Layers"));
+  AddParameter(layers_input_);
+
+  NodeKeyframe opaque;
+  opaque.set_value(NodeValue(1.0));
+
+  opacity_input_ = new NodeInput();
+  opacity_input_->add_data_input(NodeParam::kFloat);
+  opacity_input_->set_can_accept_multiple_inputs(true);
+  opacity_input_->set_name(tr("Opacity"));
+  opacity_input_->insert_keyframe(opaque);
+  AddParameter(opacity_input_);
+
+  NodeKeyframe normal;
+  normal.set_value(NodeValue(static_cast<int>(olive::gl::kBlendNormal)));
+
+  blend_input_ = new NodeInput();
+  blend_input_->add_data_input(NodeParam::kInt);
+  blend_input_->set_can_accept_multiple_inputs(true);
+  blend_input_->set_name(tr("Blend Mode"));
+  blend_input_->insert_keyframe(normal);
+  AddParameter(blend_input_);
+
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+}
+
+CompositeNode::~CompositeNode()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(buffers_);
+  qDeleteAll(software_buffers_);
+}
+
+QString CompositeNode::Name()
+{
+  return tr("Composite");
+}
+
+QString CompositeNode::id()
+{
+  return "org.olivevideoeditor.Olive.composite";
+}
+
+QString CompositeNode::Category()
+{
+  return tr("Compositing");
+}
+
+QString CompositeNode::Description()
+{
+  return tr("Blend several layers on top of each other.");
+}
+
+NodeInput *CompositeNode::layers_input()
+{
+  return layers_input_;
+}
+
+NodeInput *CompositeNode::opacity_input()
+{
+  return opacity_input_;
+}
+
+NodeInput *CompositeNode::blend_input()
+{
+  return blend_input_;
+}
+
+NodeOutput *CompositeNode::texture_output()
+{
+  return texture_output_;
+}
+
+bool CompositeNode::UsesInput(NodeInput *input, int index, const rational &time)
+{
+  if (input != layers_input_) {
+    return true;
+  }
+
+  NodeValueList opacities = opacity_input_->get_values(time);
+
+  return opacities.at(qMin(index, opacities.size() - 1)).toDouble() > 0.0;
+}
+
+TimeRange CompositeNode::InputUseRange(NodeInput *input, int index, const rational &time)
+{
+  Q_UNUSED(index)
+
+  if (input != layers_input_) {
+    return TimeRange::All();
+  }
+
+  return opacity_input_->PositiveRange(time);
+}
+
+bool CompositeNode::DomainOfDefinition(NodeOutput *output, const rational &time, QRect *bounds)
+{
+  if (output != texture_output_) {
+    return false;
+  }
+
+  return layers_input_->DomainOfDefinition(time, bounds);
+}
+
+void CompositeNode::Process(const rational &time)
+{
+  NodeValueList textures = layers_input_->get_values(time);
+  NodeValueList opacities = opacity_input_->get_values(time);
+  NodeValueList blends = blend_input_->get_values(time);
+
+  QVector<Layer> layers;
+  layers.reserve(textures.size());
+
+  for (int i=0;i<textures.size();i++) {
+    Layer layer;
+
+    layer.texture = textures.at(i).toTexture();
+    layer.buffer = textures.at(i).toBuffer();
+
+    // Empty layers don't contribute anything
+    if (layer.texture == 0 && layer.buffer == nullptr) {
+      continue;
+    }
+
+    layer.opacity = static_cast<float>(opacities.at(qMin(i, opacities.size() - 1)).toDouble());
+    layer.blend = qBound(static_cast<int>(olive::gl::kBlendNormal),
+                         blends.at(qMin(i, blends.size() - 1)).toInt(),
+                         static_cast<int>(olive::gl::kBlendScreen));
+
+    if (layer.opacity > 0.0f) {
+      layers.append(layer);
+    }
+  }
+
+  if (layers.isEmpty()) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  // Any layer blended over nothing is unchanged
+  if (layers.size() == 1 && layers.first().opacity == 1.0f) {
+    if (layers.first().buffer != nullptr) {
+      texture_output_->set_value(NodeValue::Buffer(layers.first().buffer));
+    } else {
+      texture_output_->set_value(NodeValue::Texture(layers.first().texture));
+    }
+    return;
+  }
+
+  if (NodeEvaluationContext::CurrentIsSoftware()) {
+    ProcessSoftware(layers);
+  } else {
+    ProcessGL(layers);
+  }
+}
+
+void CompositeNode::ProcessGL(const QVector<Layer> &layers)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  // Render at the bottom layer's size
+  GLint width = 0;
+  GLint height = 0;
+
+  xf->glBindTexture(GL_TEXTURE_2D, layers.first().texture);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  TextureBuffer* output = nullptr;
+
+  int start = 0;
+  int target = 0;
+
+  while (start < layers.size()) {
+    // Every pass after the first blends on top of the previous pass's result
+    int slots = olive::gl::kMaxCompositeLayers - ((output == nullptr) ? 0 : 1);
+    int count = qMin(slots, layers.size() - start);
+
+    QVector<GLuint> textures;
+    QVector<GLfloat> opacities;
+    QVector<GLint> blends;
+
+    if (output != nullptr) {
+      textures.append(output->texture());
+      opacities.append(1.0f);
+      blends.append(olive::gl::kBlendNormal);
+    }
+
+    for (int i=start;i<start+count;i++) {
+      textures.append(layers.at(i).texture);
+      opacities.append(layers.at(i).opacity);
+      blends.append(layers.at(i).blend);
+    }
+
+    ShaderPtr pipeline = olive::gl::GetCompositePipeline(textures.size());
+
+    if (pipeline == nullptr) {
+      texture_output_->set_value(NodeValue::Texture(0));
+      return;
+    }
+
+    TextureBuffer* buffer = GetBuffer(ctx, target, width, height);
+
+    pipeline->bind();
+    pipeline->setUniformValueArray("layer_opacity", opacities.constData(), opacities.size(), 1);
+    pipeline->setUniformValueArray("layer_blend", blends.constData(), blends.size());
+    pipeline->release();
+
+    // Bind every layer to its unit, finishing on unit 0 so Blit() sees the bottom layer as the bound texture
+    for (int i=textures.size()-1;i>=0;i--) {
+      xf->glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
+      xf->glBindTexture(GL_TEXTURE_2D, textures.at(i));
+    }
+
+    buffer->BindBuffer();
+
+    xf->glViewport(0, 0, width, height);
+
+    olive::gl::Blit(pipeline);
+
+    buffer->ReleaseBuffer();
+
+    for (int i=textures.size()-1;i>=0;i--) {
+      xf->glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
+      xf->glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    output = buffer;
+    start += count;
+    target = 1 - target;
+  }
+
+  texture_output_->set_value(NodeValue::Texture(output->texture()));
+}
+
+void CompositeNode::ProcessSoftware(const QVector<Layer> &layers)
+{
+  const MemoryBuffer* bottom = layers.first().buffer;
+
+  if (bottom == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  MemoryBuffer* buffer;
+
+  {
+    QMutexLocker locker(&buffers_mutex_);
+
+    buffer = software_buffers_.value(NodeEvaluationContext::CurrentId());
+
+    if (buffer == nullptr) {
+      buffer = new MemoryBuffer();
+      software_buffers_.insert(NodeEvaluationContext::CurrentId(), buffer);
+    }
+  }
+
+  buffer->Create(bottom->width(), bottom->height(), olive::PIX_FMT_RGBA32F);
+  olive::cpu::Fill(buffer, QVector4D());
+
+  foreach (const Layer& layer, layers) {
+    if (layer.buffer == nullptr) {
+      continue;
+    }
+
+    if (layer.blend != olive::gl::kBlendNormal) {
+      qWarning() << "Only normal blending is supported without a GPU, layer blended normally";
+    }
+
+    olive::cpu::Blend(*layer.buffer, buffer, QPoint(0, 0), layer.opacity);
+  }
+
+  texture_output_->set_value(NodeValue::Buffer(buffer));
+}
+
+TextureBuffer *CompositeNode::GetBuffer(QOpenGLContext *ctx, int index, int width, int height)
+{
+  QMutexLocker locker(&buffers_mutex_);
+
+  ContextBuffers* context_buffers = buffers_.value(ctx);
+
+  if (context_buffers == nullptr) {
+    context_buffers = new ContextBuffers();
+
+    buffers_.insert(ctx, context_buffers);
+
+    // Free the buffers with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      buffers_mutex_.lock();
+      ContextBuffers* b = buffers_.take(ctx);
+      buffers_mutex_.unlock();
+
+      delete b;
+    }, Qt::DirectConnection);
+  }
+
+  TextureBuffer* buffer = &context_buffers->buffers[index];
+
+  if (!buffer->IsCreated() || buffer->width() != width || buffer->height() != height) {
+    buffer->Create(ctx, olive::color::kWorkingFormat, width, height);
+  }
+
+  return buffer;
+}
@@ -0,0 +1,136 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COMPOSITENODE_H
+#define COMPOSITENODE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+
+#include "node/node.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A node that blends any number of layers on top of each other
+ *
+ * Every texture connected to layers_input() is a layer, from the bottom (connected first) to the top. Layers are
+ * blended in a single pass of a generated shader with every layer bound at once (see olive::gl::GetCompositePipeline()),
+ * so a composite of N layers costs one full-frame pass rather than N-1 passes through intermediate buffers. Only
+ * composites of more than olive::gl::kMaxCompositeLayers layers need more than one pass.
+ *
+ * Values connected to opacity_input() and blend_input() apply to the layer at the same index. Layers past the end of
+ * those lists use the last value, so an unconnected input's own value applies to every layer. The result is the size
+ * of the bottom layer and every other layer is stretched to it.
+ */
+class CompositeNode : public Node
+{
+  Q_OBJECT
+public:
+  CompositeNode();
+
+  virtual ~CompositeNode() override;
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  NodeInput* layers_input();
+
+  NodeInput* opacity_input();
+
+  NodeInput* blend_input();
+
+  NodeOutput* texture_output();
+
+  /**
+   * @brief Returns FALSE for layers with no opacity, which aren't evaluated at all
+   */
+  virtual bool UsesInput(NodeInput* input, int index, const rational& time) override;
+
+  /**
+   * @brief Returns how long a layer's opacity stays above 0 or at 0
+   */
+  virtual TimeRange InputUseRange(NodeInput* input, int index, const rational& time) override;
+
+  /**
+   * @brief Returns the union of every layer's bounds
+   */
+  virtual bool DomainOfDefinition(NodeOutput* output, const rational& time, QRect* bounds) override;
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief One layer to blend
+   */
+  struct Layer {
+    GLuint texture;
+    const MemoryBuffer* buffer;
+    float opacity;
+    int blend;
+  };
+
+  /**
+   * @brief Output buffers in one context
+   *
+   * Composites that need several passes alternate between the buffers, reading the previous pass's result as the
+   * bottom layer of the next.
+   */
+  struct ContextBuffers {
+    TextureBuffer buffers[2];
+  };
+
+  /**
+   * @brief Blend layers with OpenGL
+   */
+  void ProcessGL(const QVector<Layer>& layers);
+
+  /**
+   * @brief Blend layers in software (see NodeEvaluationContext::software())
+   */
+  void ProcessSoftware(const QVector<Layer>& layers);
+
+  /**
+   * @brief Returns one of this node's two buffers for the current context, (re)creating it if necessary
+   */
+  TextureBuffer* GetBuffer(QOpenGLContext* ctx, int index, int width, int height);
+
+  NodeInput* layers_input_;
+
+  NodeInput* opacity_input_;
+
+  NodeInput* blend_input_;
+
+  NodeOutput* texture_output_;
+
+  // Output buffers for each context this node has rendered in
+  QHash<QOpenGLContext*, ContextBuffers*> buffers_;
+
+  // Output buffer for each evaluation rendering in software
+  QHash<Qt::HANDLE, MemoryBuffer*> software_buffers_;
+
+  QMutex buffers_mutex_;
+};
+
+#endif // COMPOSITENODE_H
@@ -0,0 +1,72 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "gain.h"
+
+#include <cmath>
+
+#include "audio/mixkernels.h"
+
+GainNode::GainNode()
+{
+  NodeKeyframe zero;
+  zero.set_value(NodeValue(0.0));
+
+  gain_input_ = new NodeInput();
+  gain_input_->add_data_input(NodeParam::kFloat);
+  gain_input_->set_name(tr("Gain (dB)"));
+  gain_input_->insert_keyframe(zero);
+  AddParameter(gain_input_);
+}
+
+QString GainNode::Name()
+{
+  return tr("Gain");
+}
+
+QString GainNode::id()
+{
+  return "org.olivevideoeditor.Olive.gain";
+}
+
+QString GainNode::Description()
+{
+  return tr("Make audio louder or quieter.");
+}
+
+NodeInput *GainNode::gain_input()
+{
+  return gain_input_;
+}
+
+void GainNode::ProcessSamples(const SampleBuffer &input, SampleBuffer *output, const rational &time)
+{
+  float from = LinearGain(time);
+  float to = LinearGain(block_end(input, time));
+
+  for (int i=0;i<input.channels();i++) {
+    olive::audio::ScaleRamp(input.channel(i), output->channel(i), input.sample_count(), from, to);
+  }
+}
+
+float GainNode::LinearGain(const rational &time)
+{
+  return std::pow(10.0f, static_cast<float>(gain_input_->get_value(time).toDouble()) / 20.0f);
+}
@@ -0,0 +1,55 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef GAINNODE_H
+#define GAINNODE_H
+
+#include "node/processor/audio/audioprocessor.h"
+
+/**
+ * @brief An audio node that changes the volume of its input
+ *
+ * The gain (in decibels) is read at the start and end of each block and ramped across it, so automating it doesn't
+ * produce steps (zipper noise) at block boundaries.
+ */
+class GainNode : public AudioProcessor
+{
+  Q_OBJECT
+public:
+  GainNode();
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Description() override;
+
+  NodeInput* gain_input();
+
+  virtual void ProcessSamples(const SampleBuffer& input, SampleBuffer* output, const rational& time) override;
+
+private:
+  /**
+   * @brief Returns the linear gain at a time
+   */
+  float LinearGain(const rational& time);
+
+  NodeInput* gain_input_;
+};
+
+#endif // GAINNODE_H
@@ -0,0 +1,268 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "pointwise.h"
+
+#include <QDebug>
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/cpurender.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+
+PointwiseProcessor::PointwiseProcessor()
+{
+  texture_input_ = new NodeInput();
+  texture_input_->add_data_input(NodeParam::kTexture);
+  AddParameter(texture_input_);
+
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+}
+
+PointwiseProcessor::~PointwiseProcessor()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(buffers_);
+  qDeleteAll(software_buffers_);
+}
+
+NodeInput *PointwiseProcessor::texture_input()
+{
+  return texture_input_;
+}
+
+NodeOutput *PointwiseProcessor::texture_output()
+{
+  return texture_output_;
+}
+
+bool PointwiseProcessor::ColorMatrix(const rational &time, QMatrix4x4 *matrix, QVector4D *offset)
+{
+  Q_UNUSED(time)
+  Q_UNUSED(matrix)
+  Q_UNUSED(offset)
+
+  return false;
+}
+
+bool PointwiseProcessor::FusesInput(NodeInput *input)
+{
+  return input == texture_input_ && FusedUpstream() != nullptr;
+}
+
+void PointwiseProcessor::Process(const rational &time)
+{
+  // Collect the chain of nodes this pass applies, from the furthest upstream to this one
+  QList<PointwiseProcessor*> chain;
+
+  PointwiseProcessor* head = this;
+
+  while (head != nullptr) {
+    chain.prepend(head);
+
+    if (head->FusedUpstream() == nullptr) {
+      break;
+    }
+
+    head = head->FusedUpstream();
+  }
+
+  NodeValue source_value = chain.first()->texture_input_->get_value(time);
+
+  if (NodeEvaluationContext::CurrentIsSoftware()) {
+    ProcessSoftware(chain, source_value.toBuffer(), time);
+    return;
+  }
+
+  GLuint source = source_value.toTexture();
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (source == 0 || ctx == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(source));
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  // Render at the source's size
+  GLint width = 0;
+  GLint height = 0;
+
+  xf->glBindTexture(GL_TEXTURE_2D, source);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Names only depend on the position in the chain so identical chains generate identical (cached) shaders
+  QStringList names;
+  QString code;
+
+  for (int i=0;i<chain.size();i++) {
+    QString name = QStringLiteral("pointwise_%1").arg(i);
+
+    names.append(name);
+    code.append(chain.at(i)->ShaderFunction(name));
+  }
+
+  // A chain that hasn't been rendered before needs a new shader, pass the source through while it compiles rather than
+  // holding up the frame (if this frame can be rendered again once it's ready)
+  bool pending = false;
+
+  ShaderPtr pipeline = olive::gl::GetFusedPipeline(names, code,
+                                                   NodeEvaluationContext::CurrentAllowsProvisional() ? &pending : nullptr);
+
+  if (pending) {
+    NodeEvaluationContext::MarkCurrentProvisional();
+    texture_output_->set_value(NodeValue::Texture(source));
+    return;
+  }
+
+  if (pipeline == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  TextureBuffer* buffer = GetBuffer(ctx, width, height);
+
+  pipeline->bind();
+
+  for (int i=0;i<chain.size();i++) {
+    chain.at(i)->SetUniforms(pipeline.get(), names.at(i), time);
+  }
+
+  pipeline->release();
+
+  buffer->BindBuffer();
+
+  xf->glViewport(0, 0, width, height);
+  xf->glBindTexture(GL_TEXTURE_2D, source);
+
+  olive::gl::Blit(pipeline);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  buffer->ReleaseBuffer();
+
+  texture_output_->set_value(NodeValue::Texture(buffer->texture()));
+}
+
+void PointwiseProcessor::ProcessSoftware(const QList<PointwiseProcessor *> &chain,
+                                         const MemoryBuffer *source,
+                                         const rational &time)
+{
+  if (source == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  // Combine the chain into one matrix, applied in a single pass like the fused shader
+  QMatrix4x4 matrix;
+  QVector4D offset;
+
+  foreach (PointwiseProcessor* node, chain) {
+    QMatrix4x4 node_matrix;
+    QVector4D node_offset;
+
+    if (!node->ColorMatrix(time, &node_matrix, &node_offset)) {
+      qWarning() << node->Name() << "can't be rendered without a GPU, passing its input through";
+
+      texture_output_->set_value(NodeValue::Buffer(source));
+      return;
+    }
+
+    matrix = node_matrix * matrix;
+    offset = node_matrix * offset + node_offset;
+  }
+
+  MemoryBuffer* buffer;
+
+  {
+    QMutexLocker locker(&buffers_mutex_);
+
+    buffer = software_buffers_.value(NodeEvaluationContext::CurrentId());
+
+    if (buffer == nullptr) {
+      buffer = new MemoryBuffer();
+      software_buffers_.insert(NodeEvaluationContext::CurrentId(), buffer);
+    }
+  }
+
+  buffer->Create(source->width(), source->height(), olive::PIX_FMT_RGBA32F);
+
+  olive::cpu::Blit(*source, QRect(0, 0, source->width(), source->height()), buffer, QPoint(0, 0));
+  olive::cpu::ColorTransform(buffer, matrix, offset);
+
+  texture_output_->set_value(NodeValue::Buffer(buffer));
+}
+
+PointwiseProcessor *PointwiseProcessor::FusedUpstream()
+{
+  if (texture_input_->edges().size() != 1) {
+    return nullptr;
+  }
+
+  NodeOutput* upstream = texture_input_->edges().first()->output();
+
+  // An upstream node with other consumers still needs its own result
+  if (upstream->edges().size() != 1) {
+    return nullptr;
+  }
+
+  PointwiseProcessor* node = dynamic_cast<PointwiseProcessor*>(upstream->parent());
+
+  if (node == nullptr || upstream != node->texture_output_) {
+    return nullptr;
+  }
+
+  return node;
+}
+
+TextureBuffer *PointwiseProcessor::GetBuffer(QOpenGLContext *ctx, int width, int height)
+{
+  QMutexLocker locker(&buffers_mutex_);
+
+  TextureBuffer* buffer = buffers_.value(ctx);
+
+  if (buffer == nullptr) {
+    buffer = new TextureBuffer();
+
+    buffers_.insert(ctx, buffer);
+
+    // Free the buffer with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      buffers_mutex_.lock();
+      TextureBuffer* b = buffers_.take(ctx);
+      buffers_mutex_.unlock();
+
+      delete b;
+    }, Qt::DirectConnection);
+  }
+
+  if (!buffer->IsCreated() || buffer->width() != width || buffer->height() != height) {
+    buffer->Create(ctx, olive::color::kWorkingFormat, width, height);
+  }
+
+  return buffer;
+}
@@ -0,0 +1,115 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef POINTWISEPROCESSOR_H
+#define POINTWISEPROCESSOR_H
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QOpenGLShaderProgram>
+#include <QVector4D>
+
+#include "node/node.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A base class for nodes that change each pixel's color independently of every other pixel
+ *
+ * Subclasses only provide a GLSL function and set its uniforms. Chains of pointwise nodes (each connected only to the
+ * next) are fused into one generated shader that the last node in the chain draws in a single pass, so a stack of
+ * color corrections costs one full-frame pass and one buffer rather than one of each per node. The nodes earlier in
+ * the chain are skipped by NodeGraphPlan (see FusesInput()).
+ */
+class PointwiseProcessor : public Node
+{
+  Q_OBJECT
+public:
+  PointwiseProcessor();
+
+  virtual ~PointwiseProcessor() override;
+
+  NodeInput* texture_input();
+
+  NodeOutput* texture_output();
+
+  /**
+   * @brief Return GLSL code defining `vec4 function_name(vec4 color)`
+   *
+   * The function receives the color of a pixel and returns the new color. Any uniforms it declares must start with
+   * function_name so they don't collide with other functions in the same shader.
+   */
+  virtual QString ShaderFunction(const QString& function_name) = 0;
+
+  /**
+   * @brief Set the uniforms used by ShaderFunction() for a time
+   *
+   * The program is bound while this is called.
+   */
+  virtual void SetUniforms(QOpenGLShaderProgram* program, const QString& function_name, const rational& time) = 0;
+
+  /**
+   * @brief Express ShaderFunction() at a time as `color = matrix * color + offset`, for rendering without a GPU
+   *
+   * Chains whose every node provides a matrix are rendered in software as one combined matrix (see
+   * olive::cpu::ColorTransform()). Returns false by default, meaning the node can't be rendered in software and its
+   * input is passed through unchanged.
+   */
+  virtual bool ColorMatrix(const rational& time, QMatrix4x4* matrix, QVector4D* offset);
+
+  /**
+   * @brief Fuses texture_input() when it's connected to another PointwiseProcessor
+   */
+  virtual bool FusesInput(NodeInput* input) override;
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief Returns the PointwiseProcessor this one processes as part of its own pass, or nullptr if there isn't one
+   */
+  PointwiseProcessor* FusedUpstream();
+
+  /**
+   * @brief Apply a chain in software (see NodeEvaluationContext::software())
+   */
+  void ProcessSoftware(const QList<PointwiseProcessor*>& chain, const MemoryBuffer* source, const rational& time);
+
+  /**
+   * @brief Returns this node's buffer for the current context, (re)creating it if necessary
+   */
+  TextureBuffer* GetBuffer(QOpenGLContext* ctx, int width, int height);
+
+  NodeInput* texture_input_;
+
+  NodeOutput* texture_output_;
+
+  // Output buffer for each context this node has rendered in
+  QHash<QOpenGLContext*, TextureBuffer*> buffers_;
+
+  // Output buffer for each evaluation rendering in software
+  QHash<Qt::HANDLE, MemoryBuffer*> software_buffers_;
+
+  QMutex buffers_mutex_;
+};
+
+#endif // POINTWISEPROCESSOR_H
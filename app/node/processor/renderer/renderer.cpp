@@ -20,10 +20,60 @@
 
 #include "renderer.h"
 
+#include <QMutexLocker>
+
+#include "node/evaluationcontext.h"
+#include "render/allocationcounters.h"
+#include "render/colormanagement.h"
+#include "render/performancecounters.h"
+#include "render/semiplanarpacker.h"
+
+// kPreviewAuto considers the user to be scrubbing if frames are queued less than this many milliseconds apart
+const qint64 kScrubInterval = 250;
+
+// kPreviewAuto renders the last frame at full resolution after this many milliseconds without new frames
+const int kRefineDelay = 300;
+
+// Maximum divider kPreviewAuto will use
+const int kMaxAutoDivider = 8;
+
+// Divider of the preview QueueScrubFrame() shows before the exact frame
+const int kScrubPreviewDivider = 4;
+
+// Minimum divider of frames queued with QueueFrame() to only show keyframes
+const int kKeyframesOnlyDivider = 4;
+
+// Largest tile used when no tile size has been set
+const int kDefaultMaxTileSize = 4096;
+
 RendererProcessor::RendererProcessor() :
-  started_(false)
+  started_(false),
+  queued_jobs_(0),
+  next_thread_(0),
+  wait_mutex_("RendererProcessor::wait"),
+  running_(false),
+  next_sequence_(0),
+  next_delivery_(0),
+  preview_mode_(kPreviewFull),
+  auto_divider_(1),
+  average_frame_time_(0),
+  last_output_(nullptr),
+  last_divider_(1),
+  last_provisional_(false),
+  minimum_divider_(1),
+  tile_size_(0),
+  tile_margin_(32),
+  readback_(false),
+  readback_semi_planar_(false),
+  max_texture_size_(0),
+  profiling_enabled_(0),
+  width_(0),
+  height_(0),
+  format_(olive::color::kWorkingFormat)
 {
-
+  refine_timer_.setSingleShot(true);
+  refine_timer_.setInterval(kRefineDelay);
+  connect(&refine_timer_, SIGNAL(timeout()), this, SLOT(RefinePreview()));
 }
 
 QString RendererProcessor::Name()
@@ -41,17 +91,160 @@ QString RendererProcessor::Description()
   return tr("A multi-threaded OpenGL hardware-accelerated node compositor.");
 }
 
+void RendererProcessor::SetParameters(const int &width,
+                                      const int &height,
+                                      const olive::PixelFormat &format,
+                                      const PreviewMode &preview)
+{
+  width_ = width;
+  height_ = height;
+  format_ = format;
+
+  QMutexLocker locker(&preview_mutex_);
+  preview_mode_ = preview;
+  auto_divider_ = 1;
+  average_frame_time_ = 0;
+}
+
+void RendererProcessor::SetFrameDuration(const rational &duration)
+{
+  QMutexLocker locker(&preview_mutex_);
+
+  frame_duration_ = duration;
+}
+
+void RendererProcessor::SetMinimumDivider(int divider)
+{
+  minimum_divider_ = qMax(1, divider);
+
+  // Zooming in needs the last frame at a higher resolution than it was rendered at
+  preview_mutex_.lock();
+  bool refine = (last_divider_ > minimum_divider_.load());
+  preview_mutex_.unlock();
+
+  if (refine) {
+    refine_timer_.start();
+  }
+}
+
+int RendererProcessor::minimum_divider()
+{
+  return minimum_divider_.load();
+}
+
+int RendererProcessor::width()
+{
+  return width_;
+}
+
+int RendererProcessor::height()
+{
+  return height_;
+}
+
+const olive::PixelFormat &RendererProcessor::format()
+{
+  return format_;
+}
+
+FrameCache *RendererProcessor::frame_cache()
+{
+  return &frame_cache_;
+}
+
+void RendererProcessor::SetTileSize(int size, int margin)
+{
+  tile_size_ = size;
+  tile_margin_ = margin;
+}
+
+void RendererProcessor::SetReadbackEnabled(bool enabled)
+{
+  readback_ = enabled;
+}
+
+bool RendererProcessor::IsReadbackEnabled()
+{
+  return readback_;
+}
+
+void RendererProcessor::SetReadbackSemiPlanar(bool enabled)
+{
+  readback_semi_planar_ = enabled;
+}
+
+bool RendererProcessor::IsReadbackSemiPlanar()
+{
+  return readback_semi_planar_;
+}
+
+QRect RendererProcessor::CurrentTile()
+{
+  return NodeEvaluationContext::CurrentTile();
+}
+
+void RendererProcessor::ReportMaxTextureSize(int size)
+{
+  int current;
+
+  do {
+    current = max_texture_size_.load();
+
+    if (current > 0 && current <= size) {
+      return;
+    }
+  } while (!max_texture_size_.testAndSetOrdered(current, size));
+}
+
+void RendererProcessor::SetProfilingEnabled(bool enabled)
+{
+  profiling_enabled_.store(enabled ? 1 : 0);
+}
+
+bool RendererProcessor::IsProfilingEnabled()
+{
+  return profiling_enabled_.load() != 0;
+}
+
+RenderProfile RendererProcessor::LastProfile()
+{
+  QMutexLocker locker(&profile_mutex_);
+
+  return last_profile_;
+}
+
+void RendererProcessor::ReportProfile(const RenderProfile &profile)
+{
+  profile_mutex_.lock();
+  last_profile_ = profile;
+  profile_mutex_.unlock();
+
+  emit ProfileReady(profile);
+}
+
+int RendererProcessor::CurrentDivider()
+{
+  return NodeEvaluationContext::CurrentDivider();
+}
+
+olive::PixelFormat RendererProcessor::GetIntermediateFormat(Node *n)
+{
+  return PixelService::NegotiateFormat(n->OutputPrecision(), n->OutputChannels(), format_);
+}
+
 void RendererProcessor::Start()
 {
   if (started_) {
     return;
   }
 
-  threads_.resize(QThread::idealThreadCount());
+  running_ = true;
+
+  threads_.resize(qMax(1, QThread::idealThreadCount()));
 
   for (int i=0;i<threads_.size();i++) {
-    threads_[i] = new RendererThread();
-    threads_[i]->run();
+    threads_[i] = new RendererThread(this, i, threads_.size());
+    threads_[i]->start();
   }
 
   started_ = true;
@@ -65,15 +258,559 @@ void RendererProcessor::Stop()
 
   started_ = false;
 
+  // Signal all threads to exit
+  wait_mutex_.lock();
+  running_ = false;
+  wait_cond_.wakeAll();
+  wait_mutex_.unlock();
+
   for (int i=0;i<threads_.size();i++) {
-    threads_[i]->Cancel();
+    threads_[i]->wait();
     delete threads_[i];
   }
 
   threads_.clear();
+
+  queued_jobs_.store(0);
+
+  background_queue_.clear();
+  background_active_.clear();
+
+  reorder_mutex_.lock();
+  reorder_buffer_.clear();
+  undelivered_frames_.clear();
+  next_sequence_ = 0;
+  next_delivery_ = 0;
+  reorder_mutex_.unlock();
 }
 
 RendererThread *RendererProcessor::CurrentThread()
 {
   return dynamic_cast<RendererThread*>(QThread::currentThread());
 }
+
+RenderJobPtr RendererProcessor::Queue(NodeOutput *output, const rational &time)
+{
+  if (!started_) {
+    return nullptr;
+  }
+
+  RenderJobPtr job = std::make_shared<RenderJob>(output, time);
+
+  QueueJob(job);
+
+  return job;
+}
+
+RenderJobPtr RendererProcessor::QueueFrame(NodeOutput *output, const rational &time, bool keyframes_only)
+{
+  if (!started_) {
+    return nullptr;
+  }
+
+  // The user is waiting for this frame, rendering ahead can wait
+  PreemptBackground();
+
+  int divider = qMax(GetPreviewDivider(time), minimum_divider_.load());
+
+  // Skimmed frames are only on screen for a moment, so they don't need much resolution either
+  if (keyframes_only) {
+    divider = qMax(divider, kKeyframesOnlyDivider);
+  }
+
+  RenderJobPtr job = QueueFrameInternal(output, time, divider, keyframes_only);
+
+  preview_mutex_.lock();
+  last_output_ = output;
+  last_time_ = time;
+  last_divider_ = divider;
+  last_provisional_ = false;
+  preview_mutex_.unlock();
+
+  // Refine to full resolution once no more frames are queued for a moment
+  if (divider > minimum_divider_.load() && preview_mode_ == kPreviewAuto) {
+    refine_timer_.start();
+  }
+
+  return job;
+}
+
+QVector<RenderJobPtr> RendererProcessor::QueueScrubFrame(NodeOutput *output, const rational &time)
+{
+  QVector<RenderJobPtr> jobs;
+
+  if (!started_) {
+    return jobs;
+  }
+
+  PreemptBackground();
+
+  // The playhead has moved on from anything still pending
+  foreach (RenderJobPtr job, scrub_jobs_) {
+    job->Cancel();
+  }
+
+  int exact_divider = minimum_divider_.load();
+  int preview_divider = qMax(qMax(kScrubPreviewDivider, GetDividerForMode(preview_mode_)), exact_divider * 2);
+
+  jobs.append(QueueFrameInternal(output, time, preview_divider));
+  jobs.append(QueueFrameInternal(output, time, exact_divider));
+
+  scrub_jobs_ = jobs;
+
+  // The exact frame is already queued, there's nothing to refine
+  refine_timer_.stop();
+
+  preview_mutex_.lock();
+  last_output_ = output;
+  last_time_ = time;
+  last_divider_ = exact_divider;
+  last_provisional_ = false;
+  preview_mutex_.unlock();
+
+  return jobs;
+}
+
+RenderJobPtr RendererProcessor::QueueBackgroundFrame(NodeOutput *output, const rational &time, int divider)
+{
+  if (!started_) {
+    return nullptr;
+  }
+
+  int render_width = (width_ + divider - 1) / divider;
+  int render_height = (height_ + divider - 1) / divider;
+
+  // Tiled frames end up in RAM rather than in a texture the cache could keep
+  if (render_width > GetTileSize() || render_height > GetTileSize()) {
+    return nullptr;
+  }
+
+  RenderJobPtr job = std::make_shared<RenderJob>(output, time, -1, divider);
+
+  QRect frame_rect(0, 0, render_width, render_height);
+  job->SetTile(frame_rect, frame_rect);
+  job->SetBackground(frame_cache_.generation());
+
+  ProfiledMutexLocker locker(&wait_mutex_);
+  background_queue_.append(job);
+  wait_cond_.wakeOne();
+
+  return job;
+}
+
+void RendererProcessor::PreemptBackground()
+{
+  wait_mutex_.lock();
+
+  QList<RenderJobPtr> jobs = background_queue_ + background_active_;
+
+  background_queue_.clear();
+
+  wait_mutex_.unlock();
+
+  // Jobs already rendering are abandoned through their cancel token, and finish (dropped) on their own
+  foreach (RenderJobPtr job, jobs) {
+    job->Abort();
+  }
+
+  emit BackgroundPreempted();
+}
+
+void RendererProcessor::QueueJob(RenderJobPtr job)
+{
+  RendererThread* thread = CurrentThread();
+
+  // Only queue on the current thread if it's one of ours
+  if (thread == nullptr || thread->index() >= threads_.size() || threads_.at(thread->index()) != thread) {
+    thread = threads_.at(static_cast<int>(static_cast<uint>(next_thread_.fetchAndAddRelaxed(1))
+                                          % static_cast<uint>(threads_.size())));
+  }
+
+  thread->PushJob(job);
+
+  // Incrementing under the mutex guarantees a thread about to wait sees the new job
+  ProfiledMutexLocker locker(&wait_mutex_);
+  queued_jobs_.ref();
+  wait_cond_.wakeOne();
+}
+
+void RendererProcessor::CancelAll()
+{
+  for (int i=0;i<threads_.size();i++) {
+    QList<RenderJobPtr> jobs = threads_.at(i)->ClearJobs();
+
+    queued_jobs_.fetchAndAddOrdered(-jobs.size());
+
+    // Let the reorder buffer skip over these jobs, whoever else is sharing them
+    foreach (RenderJobPtr job, jobs) {
+      job->Abort();
+      FinishJob(job);
+    }
+  }
+}
+
+RenderJobPtr RendererProcessor::TakeJob(RendererThread *thread, bool wait)
+{
+  while (true) {
+    RenderJobPtr job = thread->PopJob();
+
+    // Steal from the other threads, starting with the next one along so that thieves spread out
+    for (int i=1;i<threads_.size() && job == nullptr;i++) {
+      job = threads_.at((thread->index() + i) % threads_.size())->StealJob();
+    }
+
+    if (job != nullptr) {
+      queued_jobs_.deref();
+
+      // Tiles of cancelled frames are dropped too
+      if (job->IsCancelled()
+          || (job->tiled_frame() != nullptr && job->sequence() < 0 && job->tiled_frame()->frame->IsCancelled())) {
+        FinishJob(job);
+        continue;
+      }
+
+      return job;
+    }
+
+    ProfiledMutexLocker locker(&wait_mutex_);
+
+    if (!running_) {
+      return nullptr;
+    }
+
+    // A steal may fail because the owner was busy with its deque, so only sleep if there really are no jobs
+    if (queued_jobs_.load() <= 0) {
+      // Nothing the user is waiting for, render ahead
+      while (!background_queue_.isEmpty()) {
+        job = background_queue_.takeFirst();
+
+        if (!job->IsCancelled()) {
+          background_active_.append(job);
+          return job;
+        }
+      }
+
+      if (!wait) {
+        return nullptr;
+      }
+
+      wait_mutex_.Wait(&wait_cond_);
+    }
+  }
+}
+
+bool RendererProcessor::HasQueuedJobs()
+{
+  return queued_jobs_.load() > 0;
+}
+
+void RendererProcessor::FinishJob(RenderJobPtr job)
+{
+  if (job->IsBackground()) {
+    wait_mutex_.lock();
+    background_active_.removeOne(job);
+    wait_mutex_.unlock();
+
+    emit BackgroundFrameFinished(job);
+    return;
+  }
+
+  RenderTiledFramePtr tiled = job->tiled_frame();
+
+  if (tiled != nullptr && job->sequence() < 0) {
+    // This is a tile, a tile that was dropped leaves a hole in the frame so the frame is dropped too
+    if (!job->IsFinished()) {
+      tiled->frame->Abort();
+    }
+
+    tiled->render_time.fetchAndAddOrdered(static_cast<int>(job->render_time()));
+
+    // Once every tile is done, the frame is too
+    if (!tiled->remaining.deref()) {
+      RenderJobPtr frame = tiled->frame;
+      tiled->frame = nullptr;
+
+      frame->SetRenderTime(tiled->render_time.load());
+      frame->SetFinished();
+
+      FinishJob(frame);
+    }
+
+    return;
+  }
+
+  if (job->sequence() < 0) {
+    return;
+  }
+
+  if (job->IsFinished() && job->IsProvisional()) {
+    QMutexLocker locker(&preview_mutex_);
+
+    // Render the frame again once whatever it was waiting for (e.g. a shader compiling) has had a moment
+    if (job->output() == last_output_ && job->time() == last_time_) {
+      last_provisional_ = true;
+
+      QMetaObject::invokeMethod(&refine_timer_, "start", Qt::QueuedConnection);
+    }
+  } else if (job->IsFinished()) {
+    // Moving average of how long frames take, normalized to full resolution (area scales with the divider squared)
+    double full_time = static_cast<double>(job->render_time() * job->divider() * job->divider());
+
+    QMutexLocker locker(&preview_mutex_);
+
+    if (average_frame_time_ <= 0) {
+      average_frame_time_ = full_time;
+    } else {
+      average_frame_time_ = average_frame_time_ * 0.8 + full_time * 0.2;
+    }
+  }
+
+  DeliverFrame(job);
+}
+
+void RendererProcessor::DeliverFrame(RenderJobPtr job)
+{
+  // Signals are emitted with the mutex locked so that frames finishing on different threads are delivered in order
+  QMutexLocker locker(&reorder_mutex_);
+
+  reorder_buffer_.insert(job->sequence(), job);
+
+  QMap<qint64, RenderJobPtr>::iterator next;
+
+  while ((next = reorder_buffer_.find(next_delivery_)) != reorder_buffer_.end()) {
+    RenderJobPtr ready = next.value();
+
+    reorder_buffer_.erase(next);
+    next_delivery_++;
+
+    // Once delivered, a frame can't be shared with anyone who asks for it later
+    undelivered_frames_.removeOne(ready);
+
+    if (!ready->IsCancelled()) {
+      emit FrameReady(ready);
+    } else if (ready->IsFinished() && QOpenGLContext::currentContext() != nullptr) {
+      // Nobody will wait on these fences now. Render threads deliver most frames, so there's usually a current context
+      // in the share group to delete them with.
+      ready->DeleteFences(QOpenGLContext::currentContext()->extraFunctions());
+    }
+  }
+}
+
+int RendererProcessor::GetPreviewDivider(const rational& time)
+{
+  QMutexLocker locker(&preview_mutex_);
+
+  if (preview_mode_ != kPreviewAuto) {
+    return GetDividerForMode(preview_mode_);
+  }
+
+  // Frames queued in quick succession mean the user is either playing or scrubbing
+  bool active = (last_queue_timer_.isValid() && last_queue_timer_.elapsed() < kScrubInterval);
+  last_queue_timer_.start();
+
+  if (!active) {
+    // First frame after being idle, render it at full resolution
+    auto_divider_ = 1;
+    return auto_divider_;
+  }
+
+  double frame_ms = frame_duration_.ToDouble() * 1000.0;
+
+  if (frame_ms > 0 && average_frame_time_ > 0) {
+    // Use the smallest divider that renders frames in time (render time scales with the area)
+    int divider = 1;
+
+    while (divider < kMaxAutoDivider && average_frame_time_ / (divider * divider) > frame_ms) {
+      divider *= 2;
+    }
+
+    auto_divider_ = divider;
+  }
+
+  // Anything other than the next frame in sequence is scrubbing, which always drops to at least half resolution
+  if (last_output_ == nullptr || frame_duration_ == rational(0) || time != last_time_ + frame_duration_) {
+    return qMax(2, auto_divider_);
+  }
+
+  return auto_divider_;
+}
+
+RenderJobPtr RendererProcessor::QueueFrameInternal(NodeOutput *output,
+                                                   const rational &time,
+                                                   int divider,
+                                                   bool keyframes_only)
+{
+  reorder_mutex_.lock();
+
+  // Another viewer showing the same output may already be waiting for this exact frame, share it rather than
+  // rendering the same pixels twice
+  foreach (RenderJobPtr pending, undelivered_frames_) {
+    if (pending->output() == output
+        && pending->time() == time
+        && pending->divider() == divider
+        && pending->keyframes_only() == keyframes_only
+        && pending->Share()) {
+      reorder_mutex_.unlock();
+      return pending;
+    }
+  }
+
+  RenderJobPtr job = std::make_shared<RenderJob>(output, time, next_sequence_, divider);
+  job->SetKeyframesOnly(keyframes_only);
+  next_sequence_++;
+
+  undelivered_frames_.append(job);
+
+  reorder_mutex_.unlock();
+
+  // Frames that have been rendered before are delivered straight from the cache (which only holds textures)
+  if (!readback_) {
+    frame_cache_.Sync(output);
+
+    GLuint cached = frame_cache_.Get(output, time, divider);
+
+    if (cached != 0) {
+      PerformanceCounters::AddEvent(PerformanceCounters::kCacheHit);
+
+      job->SetResult(NodeValue::Texture(cached));
+      job->SetFinished();
+
+      DeliverFrame(job);
+
+      return job;
+    }
+
+    PerformanceCounters::AddEvent(PerformanceCounters::kCacheMiss);
+  }
+
+  // Size of the frame at this divider
+  int render_width = (width_ + divider - 1) / divider;
+  int render_height = (height_ + divider - 1) / divider;
+
+  QRect frame_rect(0, 0, render_width, render_height);
+
+  job->SetTile(frame_rect, frame_rect);
+
+  bool semi_planar = readback_ && readback_semi_planar_
+      && SemiPlanarPacker::IsSupported(render_width, render_height, format_);
+
+  int tile_size = GetTileSize();
+  int inner_size = tile_size - 2 * tile_margin_;
+
+  // Packed tiles have to start on whole packed pixels and chroma rows
+  if (semi_planar && inner_size >= 4) {
+    inner_size &= ~3;
+  }
+
+  if ((render_width <= tile_size && render_height <= tile_size) || inner_size <= 0) {
+    if (!readback_) {
+      QueueJob(job);
+      return job;
+    }
+
+    // Read back as a single tile covering the whole frame
+    inner_size = qMax(render_width, render_height);
+  }
+
+  // Too large for one texture (or being read back), render in tiles
+  RenderTiledFramePtr tiled = std::make_shared<RenderTiledFrame>();
+  tiled->frame = job;
+
+  {
+    // Counted under whoever asked for the frame (e.g. an export), or the renderer if nobody said
+    AllocationCounters::Tag owner = AllocationCounters::CurrentTag();
+    AllocationCounters::ScopedTag tag((owner == AllocationCounters::kOther) ? AllocationCounters::kRenderer : owner);
+
+    if (semi_planar) {
+      QSize packed = SemiPlanarPacker::PackedSize(render_width, render_height);
+
+      tiled->buffer.Create(packed.width(), packed.height(), format_);
+    } else {
+      tiled->buffer.Create(render_width, render_height, format_);
+    }
+  }
+
+  tiled->semi_planar = semi_planar;
+
+  tiled->render_time.store(0);
+
+  job->SetTiledFrame(tiled);
+
+  QVector<RenderJobPtr> tiles;
+
+  for (int y=0;y<render_height;y+=inner_size) {
+    for (int x=0;x<render_width;x+=inner_size) {
+      QRect inner(x, y, qMin(inner_size, render_width - x), qMin(inner_size, render_height - y));
+      QRect tile = inner.adjusted(-tile_margin_, -tile_margin_, tile_margin_, tile_margin_).intersected(frame_rect);
+
+      RenderJobPtr tile_job = std::make_shared<RenderJob>(output, time, -1, divider);
+      tile_job->SetTile(tile, inner);
+      tile_job->SetTiledFrame(tiled);
+      tile_job->SetKeyframesOnly(keyframes_only);
+
+      tiles.append(tile_job);
+    }
+  }
+
+  // Set the count before queueing so a fast tile can't finish the frame early
+  tiled->remaining.store(tiles.size());
+
+  foreach (RenderJobPtr tile_job, tiles) {
+    QueueJob(tile_job);
+  }
+
+  return job;
+}
+
+int RendererProcessor::GetTileSize()
+{
+  if (tile_size_ > 0) {
+    return tile_size_;
+  }
+
+  int max_texture_size = max_texture_size_.load();
+
+  if (max_texture_size > 0) {
+    return qMin(max_texture_size, kDefaultMaxTileSize);
+  }
+
+  return kDefaultMaxTileSize;
+}
+
+int RendererProcessor::GetDividerForMode(const RendererProcessor::PreviewMode &mode)
+{
+  switch (mode) {
+  case kPreviewFull:
+  case kPreviewAuto:
+    return 1;
+  case kPreviewHalf:
+    return 2;
+  case kPreviewQuarter:
+    return 4;
+  case kPreviewEighth:
+    return 8;
+  }
+
+  return 1;
+}
+
+void RendererProcessor::RefinePreview()
+{
+  preview_mutex_.lock();
+  NodeOutput* output = last_output_;
+  rational time = last_time_;
+  int divider = minimum_divider_.load();
+  bool refine = ((last_divider_ > divider || last_provisional_) && output != nullptr);
+  last_provisional_ = false;
+  preview_mutex_.unlock();
+
+  if (!refine || !started_) {
+    return;
+  }
+
+  QueueFrameInternal(output, time, divider);
+
+  preview_mutex_.lock();
+  last_divider_ = divider;
+  preview_mutex_.unlock();
+}
@@ -21,7 +21,16 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include "common/profiledmutex.h"
 #include "node/node.h"
+#include "render/framecache.h"
+#include "renderjob.h"
 #include "rendererthread.h"
 
 /**
@@ -39,6 +48,23 @@ public:
    */
   RendererProcessor();
 
+  /**
+   * @brief Resolution to render previews at
+   */
+  enum PreviewMode {
+    kPreviewFull,     // Full resolution
+    kPreviewHalf,     // 1/2 resolution
+    kPreviewQuarter,  // 1/4 resolution
+    kPreviewEighth,   // 1/8 resolution
+
+    /**
+     * Automatically reduce resolution while scrubbing or when frames take longer to render than they're displayed for,
+     * and render the last frame again at full resolution once the playhead has been idle for a moment. Frames must be
+     * queued from the main thread in this mode.
+     */
+    kPreviewAuto
+  };
+
   virtual QString Name() override;
   virtual QString Category() override;
   virtual QString Description() override;
@@ -60,8 +86,146 @@ public:
    * @param format
    *
    * Buffer pixel format
+   *
+   * @param preview
+   *
+   * Resolution to render frames queued with QueueFrame() at. Each job's RenderJob::divider() tells nodes how much to
+   * divide the width and height by.
+   */
+  void SetParameters(const int& width,
+                     const int& height,
+                     const olive::PixelFormat& format,
+                     const PreviewMode& preview = kPreviewFull);
+
+  /**
+   * @brief Set how long each frame is displayed for (e.g. the sequence's frame duration)
+   *
+   * Used by kPreviewAuto to decide whether rendering at full resolution is keeping up. Defaults to 0 which means only
+   * scrubbing reduces the resolution.
+   */
+  void SetFrameDuration(const rational& duration);
+
+  /**
+   * @brief Never render frames queued with QueueFrame() or QueueScrubFrame() above a certain resolution
+   *
+   * Connect to ViewerGLWidget::DividerChanged() so a viewer zoomed out to a fraction of the full size only renders the
+   * pixels it can show. Defaults to 1. Frames are still rendered at higher dividers than this when previewing. If the
+   * last frame was rendered at a higher divider than the new one, it's rendered again. Only call from the main thread.
+   */
+  void SetMinimumDivider(int divider);
+
+  int minimum_divider();
+
+  /**
+   * @brief Returns the buffer width set in SetParameters()
+   */
+  int width();
+
+  /**
+   * @brief Returns the buffer height set in SetParameters()
    */
-  void SetParameters(const int& width, const int& height, const olive::PixelFormat& format);
+  int height();
+
+  /**
+   * @brief Returns the buffer format set in SetParameters()
+   */
+  const olive::PixelFormat& format();
+
+  /**
+   * @brief Returns the resolution divider of the job being processed on the current thread
+   *
+   * Returns 1 if called outside of a render thread. Equivalent to NodeEvaluationContext::CurrentDivider().
+   */
+  static int CurrentDivider();
+
+  /**
+   * @brief Set the size of tiles that large frames are split into
+   *
+   * Frames queued with QueueFrame() that are wider or taller than `size` (after dividing by the preview divider) are
+   * split into tiles of at most `size` pixels, each overlapping its neighbors by `margin` pixels so that nodes sampling
+   * nearby pixels (e.g. blurs) don't leave seams. Each tile is rendered through the node graph as a separate job and
+   * read back into a MemoryBuffer holding the whole frame (see RenderJob::frame_buffer()), so VRAM use is bounded by
+   * the tile size no matter how large the frame is.
+   *
+   * @param size
+   *
+   * Maximum tile size in pixels, or 0 to use the smaller of GL_MAX_TEXTURE_SIZE and 4096 (the default).
+   */
+  void SetTileSize(int size, int margin = 32);
+
+  /**
+   * @brief Returns the maximum tile size currently in effect, frames larger than this in either dimension are tiled
+   */
+  int GetTileSize();
+
+  /**
+   * @brief Read every frame queued with QueueFrame() back into RAM
+   *
+   * Off by default. When enabled, frames are rendered the same way as tiled frames (in one tile if they fit) so each
+   * delivered frame is in RenderJob::frame_buffer() rather than in a texture, for consumers that don't have an OpenGL
+   * context of their own (e.g. HeadlessRender). Frames aren't delivered from frame_cache() in this mode, but frames
+   * rendered in one tile are still loaded from the DiskFrameCache if they're there. The renderer must be stopped when
+   * calling this function.
+   */
+  void SetReadbackEnabled(bool enabled);
+
+  /**
+   * @brief Returns whether frames are read back into RAM (see SetReadbackEnabled())
+   */
+  bool IsReadbackEnabled();
+
+  /**
+   * @brief Convert frames that are read back to 4:2:0 Y'CbCr on the GPU (see SemiPlanarPacker)
+   *
+   * Off by default, only used when readback is enabled. Frames rendered in PIX_FMT_RGBA8 or PIX_FMT_RGBA16 whose size
+   * SemiPlanarPacker supports are read back packed as NV12 or P010 rather than as RGBA (see
+   * RenderJob::frame_semi_planar()), which is a fraction of the data and leaves nothing for the CPU to convert before
+   * encoding. The renderer must be stopped when calling this function.
+   */
+  void SetReadbackSemiPlanar(bool enabled);
+
+  bool IsReadbackSemiPlanar();
+
+  /**
+   * @brief Returns the region of the frame the job being processed on the current thread renders
+   *
+   * Coordinates are in pixels of the (divided) frame and use OpenGL's bottom-left origin. The region includes the
+   * overlap margins (see SetTileSize()). Returns a null rect if called outside of a render thread. Equivalent to
+   * NodeEvaluationContext::CurrentTile().
+   */
+  static QRect CurrentTile();
+
+  /**
+   * @brief Called by render threads with their context's GL_MAX_TEXTURE_SIZE
+   */
+  void ReportMaxTextureSize(int size);
+
+  /**
+   * @brief Measure how long each node takes to process on the CPU and GPU
+   *
+   * Off by default. Results are delivered with ProfileReady() and LastProfile() once the GPU has finished each frame.
+   */
+  void SetProfilingEnabled(bool enabled);
+
+  bool IsProfilingEnabled();
+
+  /**
+   * @brief Returns the most recent profile (empty if profiling hasn't been enabled)
+   */
+  RenderProfile LastProfile();
+
+  /**
+   * @brief Called by render threads with each job's profile
+   */
+  void ReportProfile(const RenderProfile& profile);
+
+  /**
+   * @brief Return the buffer format to use for a Node's output
+   *
+   * The cheapest format that meets the Node's OutputPrecision() and OutputChannels(), but never more precise than the
+   * format set in SetParameters().
+   */
+  olive::PixelFormat GetIntermediateFormat(Node* n);
 
   /**
    * @brief Allocate and start the multithreaded backend
@@ -81,10 +245,265 @@ public:
    */
   static RendererThread* CurrentThread();
 
+  /**
+   * @brief Queue a NodeOutput to be retrieved at a certain time on one of the render threads
+   *
+   * Jobs are never dropped: if every thread is busy, the job waits in a thread's deque until that thread or an idle one
+   * takes it. When called from a render thread, the job is queued on that same thread, otherwise jobs are distributed
+   * across threads in turn.
+   *
+   * @return
+   *
+   * The queued job, which can be used to cancel it, or nullptr if the renderer isn't started.
+   */
+  RenderJobPtr Queue(NodeOutput* output, const rational& time);
+
+  /**
+   * @brief Queue a frame to be rendered and delivered in presentation order
+   *
+   * Like Queue(), frames are rendered on whichever thread is free so several can be in flight at once, but once
+   * finished they're held back until every frame queued before them has been delivered. Then FrameReady() is emitted
+   * for each, in the order they were queued. Cancelled frames are skipped without holding up later ones. Frames should
+   * therefore be queued in the order they'll be presented (e.g. t, t+1, t+2 during playback).
+   *
+   * If a frame of the same output at the same time and divider is still waiting to be delivered (e.g. queued by
+   * another viewer of the same sequence), that job is shared and returned instead of rendering the frame again (see
+   * RenderJob::Share()).
+   *
+   * @param keyframes_only
+   *
+   * For skimming much faster than real time (e.g. shuttling): footage may be shown at its closest keyframe (see
+   * RenderJob::keyframes_only()) and the frame is rendered at reduced resolution. The exact frame replaces it once
+   * frames stop being queued.
+   */
+  RenderJobPtr QueueFrame(NodeOutput* output, const rational& time, bool keyframes_only = false);
+
+  /**
+   * @brief Queue a frame for while the playhead is being dragged, a fast preview followed by the exact frame
+   *
+   * A reduced resolution preview and a full resolution frame are queued with QueueFrame() ordering, so FrameReady()
+   * delivers the preview first and the exact frame replaces it once it's done. Frames from the previous call that
+   * haven't been delivered yet are cancelled, including ones already rendering (nodes abandon them through
+   * RenderJob::cancel_token()), so the renderer never spends time on positions the playhead has left. Only call from
+   * the main thread.
+   *
+   * @return
+   *
+   * The preview and exact jobs in that order, or an empty vector if the renderer isn't started.
+   */
+  QVector<RenderJobPtr> QueueScrubFrame(NodeOutput* output, const rational& time);
+
+  /**
+   * @brief Queue a frame to render ahead into frame_cache() while the render threads have nothing else to do
+   *
+   * Background frames are only taken once every other queued job has been, and are preempted by the next frame the
+   * user asks for (see PreemptBackground()). Once rendered, the frame is in frame_cache() and
+   * BackgroundFrameFinished() is emitted. Frames that need tiling (see SetTileSize()) can't be cached.
+   *
+   * @return
+   *
+   * The queued job, or nullptr if the renderer isn't started or the frame can't be cached.
+   */
+  RenderJobPtr QueueBackgroundFrame(NodeOutput* output, const rational& time, int divider);
+
+  /**
+   * @brief Abort every background frame, including ones already rendering
+   *
+   * Called by QueueFrame() and QueueScrubFrame() so user interaction never waits for render-ahead. Emits
+   * BackgroundPreempted().
+   */
+  void PreemptBackground();
+
+  /**
+   * @brief Frames that have been rendered ahead, or are kept to be shown again
+   *
+   * QueueFrame() delivers cached frames without rendering them.
+   */
+  FrameCache* frame_cache();
+
+  /**
+   * @brief Remove every job that hasn't started yet from the queue
+   *
+   * Useful when the requested times have become irrelevant (e.g. while scrubbing). To cancel a single job, use
+   * RenderJob::Cancel().
+   */
+  void CancelAll();
+
+  /**
+   * @brief Take the next job a render thread should process, waiting until there is one
+   *
+   * The thread's own deque is checked first, then the other threads' deques are stolen from. Cancelled jobs are
+   * dropped.
+   *
+   * @param wait
+   *
+   * If FALSE, return nullptr straight away instead of waiting when there's no job (e.g. so the thread can finish
+   * reading frames back first).
+   *
+   * @return
+   *
+   * The next job, or nullptr if the renderer is being stopped and the thread should exit (or if there's no job and
+   * `wait` is FALSE).
+   */
+  RenderJobPtr TakeJob(RendererThread* thread, bool wait = true);
+
+  /**
+   * @brief Called by render threads once a job has been processed or dropped
+   */
+  void FinishJob(RenderJobPtr job);
+
+  /**
+   * @brief Returns TRUE if any jobs are waiting to be taken
+   */
+  bool HasQueuedJobs();
+
+signals:
+  /**
+   * @brief Emitted in presentation order for each frame queued with QueueFrame() that wasn't cancelled
+   *
+   * Emitted from a render thread, so connect with a queued connection if the slot isn't thread-safe.
+   */
+  void FrameReady(RenderJobPtr job);
+
+  /**
+   * @brief Emitted from a render thread with each job's profile while profiling is enabled
+   */
+  void ProfileReady(RenderProfile profile);
+
+  /**
+   * @brief Emitted from a render thread once a job from QueueBackgroundFrame() is done (or was dropped)
+   */
+  void BackgroundFrameFinished(RenderJobPtr job);
+
+  /**
+   * @brief Emitted by PreemptBackground()
+   */
+  void BackgroundPreempted();
+
 private:
+  /**
+   * @brief Returns the divider to use for a frame about to be queued with QueueFrame()
+   */
+  int GetPreviewDivider(const rational& time);
+
+  /**
+   * @brief Create a frame job to deliver in order and queue it (or its tiles)
+   */
+  RenderJobPtr QueueFrameInternal(NodeOutput* output, const rational& time, int divider, bool keyframes_only = false);
+
+  /**
+   * @brief Deliver a frame job through the reorder buffer once every frame queued before it has been
+   */
+  void DeliverFrame(RenderJobPtr job);
+
+  /**
+   * @brief Returns the divider of a fixed PreviewMode (1 for kPreviewAuto)
+   */
+  static int GetDividerForMode(const PreviewMode& mode);
+
+  void QueueJob(RenderJobPtr job);
+
   QVector<RendererThread*> threads_;
 
   bool started_;
+
+  // Number of jobs in all threads' deques (may briefly count jobs that were just taken)
+  QAtomicInt queued_jobs_;
+
+  // Incremented for each job queued from outside a render thread to distribute jobs
+  QAtomicInt next_thread_;
+
+  // Idle threads wait on this for jobs to be queued
+  QWaitCondition wait_cond_;
+
+  ProfiledMutex wait_mutex_;
+
+  // Only changed with wait_mutex_ locked
+  bool running_;
+
+  // Jobs from QueueBackgroundFrame() that haven't been taken yet and ones being rendered, protected by wait_mutex_
+  QList<RenderJobPtr> background_queue_;
+  QList<RenderJobPtr> background_active_;
+
+  FrameCache frame_cache_;
+
+  // Finished frames waiting for frames queued before them, keyed by sequence
+  QMap<qint64, RenderJobPtr> reorder_buffer_;
+
+  // Frames queued with QueueFrame() that haven't been delivered yet, and can therefore still be shared
+  QList<RenderJobPtr> undelivered_frames_;
+
+  // Sequence to give the next frame queued with QueueFrame()
+  qint64 next_sequence_;
+
+  // Sequence of the next frame to deliver
+  qint64 next_delivery_;
+
+  QMutex reorder_mutex_;
+
+  PreviewMode preview_mode_;
+
+  // Current divider in kPreviewAuto
+  int auto_divider_;
+
+  // Moving average of frame render times in milliseconds
+  double average_frame_time_;
+
+  // Frame duration (0 if unknown)
+  rational frame_duration_;
+
+  // Time since the last call to QueueFrame() (to detect scrubbing)
+  QElapsedTimer last_queue_timer_;
+
+  // Last frame queued with QueueFrame(), rendered again at full resolution once idle
+  NodeOutput* last_output_;
+  rational last_time_;
+  int last_divider_;
+
+  // Whether the last frame was only an approximation (see RenderJob::IsProvisional())
+  bool last_provisional_;
+
+  QTimer refine_timer_;
+
+  // Jobs queued by the last QueueScrubFrame()
+  QVector<RenderJobPtr> scrub_jobs_;
+
+  // See SetMinimumDivider()
+  QAtomicInt minimum_divider_;
+
+  // See SetTileSize()
+  int tile_size_;
+  int tile_margin_;
+
+  // See SetReadbackEnabled()
+  bool readback_;
+
+  // See SetReadbackSemiPlanar()
+  bool readback_semi_planar_;
+
+  // Smallest GL_MAX_TEXTURE_SIZE of the render threads' contexts (0 until one has reported)
+  QAtomicInt max_texture_size_;
+
+  // Protects the variables above that are used by render threads
+  QMutex preview_mutex_;
+
+  QAtomicInt profiling_enabled_;
+
+  RenderProfile last_profile_;
+
+  QMutex profile_mutex_;
+
+private slots:
+  /**
+   * @brief Render the last frame again at the minimum divider if it was rendered at a higher one or was provisional
+   */
+  void RefinePreview();
+
+  int width_;
+
+  int height_;
+
+  olive::PixelFormat format_;
 };
 
 #endif // RENDERER_H
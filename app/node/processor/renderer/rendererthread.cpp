@@ -21,86 +21,615 @@
 #include "rendererthread.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 
-RendererThread::RendererThread() :
-  cancelled_(false)
+#include "common/threadpolicy.h"
+#include "common/tracing.h"
+#include "node/graph.h"
+#include "render/allocationcounters.h"
+#include "render/cpurender.h"
+#include "render/diskframecache.h"
+#include "render/gl/shadergenerators.h"
+#include "render/performancecounters.h"
+#include "render/renderbackend.h"
+#include "renderer.h"
+
+RendererThread::RendererThread(RendererProcessor *parent, int index, int count) :
+  parent_(parent),
+  index_(index),
+  count_(count),
+  current_job_(nullptr),
+  get_reset_status_(nullptr),
+  cache_buffer_(nullptr),
+  jobs_mutex_("RendererThread::jobs")
 {
+  // QOffscreenSurface must be created in the main thread
+  surface_.create();
+
+  // The context is made current in run() so it has to live in this thread
+  ctx_.moveToThread(this);
 }
 
-bool RendererThread::Queue(Node *n, const rational& time)
+RendererThread::~RendererThread()
 {
-  // If the thread is inactive, tryLock() will succeed
-  if (mutex_.tryLock()) {
+  surface_.destroy();
+}
 
-    // The mutex is locked in the calling thread now, so we can change the active Node
-    node_ = n;
-    time_ = time;
+QOpenGLContext *RendererThread::context()
+{
+  return &ctx_;
+}
 
-    // We can now wake up our main thread
-    wait_cond_.wakeAll();
-    mutex_.unlock();
+int RendererThread::index()
+{
+  return index_;
+}
 
-    // Wait for thread to start before returning
-    caller_mutex_.lock();
-    caller_mutex_.unlock();
+RenderJob *RendererThread::current_job()
+{
+  return current_job_;
+}
 
-    return true;
+void RendererThread::PushJob(RenderJobPtr job)
+{
+  ProfiledMutexLocker locker(&jobs_mutex_);
+
+  jobs_.append(job);
+}
+
+RenderJobPtr RendererThread::PopJob()
+{
+  ProfiledMutexLocker locker(&jobs_mutex_);
+
+  if (jobs_.isEmpty()) {
+    return nullptr;
+  }
+
+  return jobs_.takeLast();
+}
+
+RenderJobPtr RendererThread::StealJob()
+{
+  // Don't wait for the owner, we'll just try another thread
+  if (!jobs_mutex_.tryLock()) {
+    return nullptr;
+  }
+
+  RenderJobPtr job;
+
+  if (!jobs_.isEmpty()) {
+    job = jobs_.takeFirst();
   }
 
-  return false;
+  jobs_mutex_.unlock();
+
+  return job;
 }
 
-void RendererThread::Cancel()
+QList<RenderJobPtr> RendererThread::ClearJobs()
 {
-  // Escape main loop
-  cancelled_ = true;
+  ProfiledMutexLocker locker(&jobs_mutex_);
+
+  QList<RenderJobPtr> jobs = jobs_;
+
+  jobs_.clear();
 
-  // Wait until thread is finished before returning
-  wait();
+  return jobs;
 }
 
 void RendererThread::run()
 {
+  ThreadPolicy::Apply(ThreadPolicy::kRoleRender, index_, count_);
+
+  bool has_context = CreateContext();
+
+  if (!has_context) {
+    // Frames that are read back into RAM never need to be shown, so they can still be rendered on the CPU (e.g.
+    // exporting on a headless machine). Viewers can only show textures.
+    if (!parent_->IsReadbackEnabled()) {
+      return;
+    }
+
+    qWarning() << tr("Rendering without a GPU (%1) in thread %2").arg(olive::cpu::InstructionSet(),
+                                                                      QString::number(reinterpret_cast<quintptr>(this)));
+  }
+
+  eval_context_.set_software(!has_context);
+
+  QOpenGLExtraFunctions* xf = nullptr;
+
+  if (has_context) {
+    xf = ctx_.extraFunctions();
+
+    // Let the renderer know how large frames can be before they need tiling
+    GLint max_texture_size = 0;
+    xf->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    parent_->ReportMaxTextureSize(max_texture_size);
+
+    WarmUp();
+  }
+
+  NodeEvaluationContext::SetCurrent(&eval_context_);
+
+  // Anything nodes allocate while rendering is the renderer's unless it says otherwise
+  AllocationCounters::ScopedTag tag(AllocationCounters::kRenderer);
+
+  if (has_context) {
+    downloader_.Create(&ctx_);
+
+    profiler_.Create(&ctx_, [this](const RenderProfile& profile) {
+      parent_->ReportProfile(profile);
+    });
+  }
+
+  // Main loop, TakeJob() returns nullptr once the RendererProcessor is stopped
+  RenderJobPtr job;
+
+  QElapsedTimer timer;
+
+  while (true) {
+    // Nothing else to do, so it's fine to wait for the GPU to finish the profiled frames
+    if (profiler_.HasPending() && !parent_->HasQueuedJobs()) {
+      profiler_.Poll(true);
+    }
+
+    job = nullptr;
+
+    // Render the next job while earlier ones are read back, but finish them rather than wait with them in flight
+    if (downloader_.Poll() > 0) {
+      job = parent_->TakeJob(this, false);
+
+      if (job == nullptr) {
+        downloader_.Finish();
+      }
+    }
+
+    if (job == nullptr && (job = parent_->TakeJob(this)) == nullptr) {
+      break;
+    }
+
+    current_job_ = job.get();
+    timer.start();
+    job->SetStarted();
+
+    eval_context_.set_time(job->time());
+    eval_context_.set_divider(job->divider());
+    eval_context_.set_tile(job->tile());
+    eval_context_.set_frame(QRect(0,
+                                  0,
+                                  (parent_->width() + job->divider() - 1) / job->divider(),
+                                  (parent_->height() + job->divider() - 1) / job->divider()));
+    eval_context_.set_keyframes_only(job->keyframes_only());
+
+    // Only frames that are shown straight away can be rendered again later, ones that are read back or cached can't
+    eval_context_.set_provisional_allowed(!parent_->IsReadbackEnabled() && !job->IsBackground());
+    eval_context_.set_provisional(false);
+
+    // Tiles are abandoned along with the frame they belong to
+    if (job->tiled_frame() != nullptr && job->sequence() < 0) {
+      eval_context_.set_cancel_token(job->tiled_frame()->frame->cancel_token());
+    } else {
+      eval_context_.set_cancel_token(job->cancel_token());
+    }
+
+    profiler_.SetEnabled(parent_->IsProfilingEnabled());
+    profiler_.BeginFrame(job->time());
+
+    job->SetResult(Render(job.get()));
+    job->SetProvisional(eval_context_.provisional());
+
+    profiler_.EndFrame();
+
+    // Whatever was rendered on a lost context is garbage, drop it (background frames are queued again later)
+    bool lost = (has_context && IsContextLost());
+
+    if (lost) {
+      qWarning() << tr("OpenGL context lost in thread %1, restarting it").arg(reinterpret_cast<quintptr>(this));
+
+      job->Cancel();
+
+      if (job->tiled_frame() != nullptr && job->sequence() < 0) {
+        job->tiled_frame()->frame->Abort();
+      }
+    }
+
+    // Software results are in RAM already, so there's nothing to fence or cache
+    if (has_context && !lost) {
+      if (job->IsBackground()) {
+        // Nobody waits on background jobs, they're only seen through the cache
+        if (!job->IsCancelled()) {
+          CacheResult(job.get());
+        }
+      } else {
+        // Fence the result so other contexts can wait for it on the GPU, and flush so the fence is actually submitted
+        job->CreateFences(xf);
+        xf->glFlush();
+      }
+    }
+
+    job->SetRenderTime(timer.elapsed());
+    PerformanceCounters::AddTime(PerformanceCounters::kRender, timer.nsecsElapsed());
+    current_job_ = nullptr;
+    eval_context_.set_cancel_token(nullptr);
+
+    if (job->tiled_frame() != nullptr && !lost) {
+      StitchTile(job);
+    } else {
+      job->SetFinished();
+
+      parent_->FinishJob(job);
+    }
+
+    if (lost) {
+      // Whatever was still being read back came from the lost context too
+      downloader_.Discard();
+      downloader_.Destroy();
+
+      profiler_.Destroy();
+      packer_.Destroy();
+      disk_frame_.Destroy();
+
+      // Recreating the context frees everything nodes had cached for it, they create it again as needed
+      if (!CreateContext()) {
+        qWarning() << tr("Failed to restore OpenGL context in thread %1").arg(reinterpret_cast<quintptr>(this));
+        break;
+      }
+
+      xf = ctx_.extraFunctions();
+
+      WarmUp();
+
+      downloader_.Create(&ctx_);
+
+      profiler_.Create(&ctx_, [this](const RenderProfile& profile) {
+        parent_->ReportProfile(profile);
+      });
+    }
+
+    profiler_.Poll(false);
+  }
+
+  downloader_.Destroy();
+  profiler_.Destroy();
+  packer_.Destroy();
+  disk_frame_.Destroy();
+
+  delete cache_buffer_;
+  cache_buffer_ = nullptr;
+
+  NodeEvaluationContext::SetCurrent(nullptr);
+
+  // Release OpenGL context
+  if (has_context && ctx_.isValid()) {
+    ctx_.doneCurrent();
+  }
+}
+
+bool RendererThread::CreateContext()
+{
+  // Share textures with every other context so finished frames can be drawn without copying them. Ask to be notified
+  // of resets so a lost context can be detected (see IsContextLost()).
+  QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+  format.setOption(QSurfaceFormat::ResetNotification);
+
+  ctx_.setFormat(format);
+  ctx_.setShareContext(QOpenGLContext::globalShareContext());
+
   // Create OpenGL context (automatically destroys any existing if there is one)
   if (!ctx_.create()) {
     qWarning() << tr("Failed to create OpenGL context in thread %1").arg(reinterpret_cast<quintptr>(this));
-    return;
+    return false;
   }
 
-  // Create offscreen surface
-  surface_.create();
-
   // Make context current on that surface
   if (!ctx_.makeCurrent(&surface_)) {
     qWarning() << tr("Failed to makeCurrent() on offscreen surface in thread %1").arg(reinterpret_cast<quintptr>(this));
-    surface_.destroy();
+    return false;
+  }
+
+  // Core in 4.5, otherwise from GL_ARB_robustness or GL_KHR_robustness (resolves to nullptr if unsupported)
+  get_reset_status_ = reinterpret_cast<GetGraphicsResetStatus>(ctx_.getProcAddress("glGetGraphicsResetStatus"));
+
+  if (get_reset_status_ == nullptr) {
+    get_reset_status_ = reinterpret_cast<GetGraphicsResetStatus>(ctx_.getProcAddress("glGetGraphicsResetStatusARB"));
+  }
+
+  if (get_reset_status_ == nullptr) {
+    get_reset_status_ = reinterpret_cast<GetGraphicsResetStatus>(ctx_.getProcAddress("glGetGraphicsResetStatusKHR"));
+  }
+
+  return true;
+}
+
+void RendererThread::WarmUp()
+{
+  // Build (or load the binaries of) the pipelines most frames use, so the first frame doesn't wait for them
+  olive::gl::GetDefaultPipeline();
+  olive::gl::GetCompositePipeline(2);
+  olive::gl::GetInstancedPipeline();
+
+  // The first background frame at full resolution can be copied straight away
+  delete cache_buffer_;
+  cache_buffer_ = nullptr;
+
+  if (parent_->width() > 0 && parent_->height() > 0) {
+    AllocationCounters::ScopedTag tag(AllocationCounters::kFrameCache);
+
+    cache_buffer_ = new TextureBuffer();
+    cache_buffer_->Create(&ctx_, parent_->format(), parent_->width(), parent_->height());
+  }
+
+  // Make sure it's all done before the first job, rather than during it
+  ctx_.functions()->glFinish();
+}
+
+bool RendererThread::IsContextLost()
+{
+  // Qt notices resets when making a context current, the driver can tell us in between
+  return !ctx_.isValid() || (get_reset_status_ != nullptr && get_reset_status_() != GL_NO_ERROR);
+}
+
+NodeValue RendererThread::Render(RenderJob *job)
+{
+  NodeGraph* graph = qobject_cast<NodeGraph*>(job->output()->parent()->parent());
+
+  NodeValue value;
+
+  if (graph == nullptr) {
+    if (FindCached(job, &value)) {
+      return value;
+    }
+
+    // Not in a graph, just pull from the output
+    return job->output()->get_value(job->time());
+  }
+
+  // Evaluate one consistent version of the graph, edits made from now on are picked up by the next job
+  NodeGraphSnapshotPtr snapshot = graph->Snapshot();
+
+  eval_context_.set_snapshot(snapshot.get());
+
+  // Hashed with the same snapshot the frame would be rendered with
+  if (FindCached(job, &value)) {
+    eval_context_.set_snapshot(nullptr);
+    return value;
+  }
+
+  NodeGraphPlanPtr plan = graph->GetPlan(job->output());
+
+  if (plan != nullptr) {
+    value = plan->Run(job->time());
+  } else {
+    // The graph has a cycle, just pull from the output
+    value = job->output()->get_value(job->time());
+  }
+
+  eval_context_.set_snapshot(nullptr);
+
+  return value;
+}
+
+bool RendererThread::FindCached(RenderJob *job, NodeValue *value)
+{
+  bool background = job->IsBackground();
+
+  if (eval_context_.software()) {
+    return false;
+  }
+
+  // Only whole frames are cached. Frames shown from a texture can come from VRAM or disk, frames being read back (e.g.
+  // by an export) only from disk and only if they're rendered as a single tile.
+  if (!background) {
+    bool whole = parent_->IsReadbackEnabled() ? (job->tile() == eval_context_.frame())
+                                              : (job->tiled_frame() == nullptr);
+
+    if (!whole) {
+      return false;
+    }
+  }
+
+  bool use_disk = (DiskFrameCache::budget() > 0);
+
+  if (!background && !use_disk) {
+    return false;
+  }
+
+  job->SetCacheKey(job->output()->ContentHash(job->time()));
+
+  if (background && parent_->frame_cache()->Bind(job->output(), job->time(), job->divider(), job->cache_key(),
+                                                 job->cache_generation())) {
+    return true;
+  }
+
+  if (!use_disk) {
+    return false;
+  }
+
+  // Rendered in an earlier session (or evicted from VRAM since)
+  const QRect& frame = job->tile();
+
+  MemoryBuffer loaded;
+
+  if (!DiskFrameCache::Load(DiskFrameCache::FrameKey(job->cache_key(), frame.width(), frame.height(),
+                                                     parent_->format()),
+                            &loaded)) {
+    return false;
+  }
+
+  if (background) {
+    AllocationCounters::ScopedTag tag(AllocationCounters::kFrameCache);
+
+    TextureBuffer* buffer = new TextureBuffer();
+    buffer->Create(&ctx_, loaded.format(), loaded.width(), loaded.height());
+
+    olive::render_backend->UploadTexture(buffer->texture(), loaded.format(), loaded.const_data(), loaded.linesize());
+
+    delete InsertIntoCache(job, buffer);
+  } else {
+    // Like a node's output texture, this is reused by the next frame shown from disk
+    if (!disk_frame_.IsCreated()
+        || disk_frame_.width() != loaded.width()
+        || disk_frame_.height() != loaded.height()
+        || disk_frame_.format() != loaded.format()) {
+      disk_frame_.Create(&ctx_, loaded.format(), loaded.width(), loaded.height());
+    }
+
+    olive::render_backend->UploadTexture(disk_frame_.texture(), loaded.format(), loaded.const_data(),
+                                         loaded.linesize());
+
+    *value = NodeValue::Texture(disk_frame_.texture());
+  }
+
+  return true;
+}
+
+void RendererThread::CacheResult(RenderJob *job)
+{
+  GLuint texture = job->result().toTexture();
+
+  if (texture == 0) {
     return;
   }
 
-  // Lock mutex for main loop
-  mutex_.lock();
+  const QRect& frame = job->tile();
+
+  AllocationCounters::ScopedTag tag(AllocationCounters::kFrameCache);
+
+  // Use the buffer allocated ahead of time if it's the right size (see WarmUp())
+  TextureBuffer* buffer = cache_buffer_;
 
-  // Main loop (use Cancel() to exit it)
-  while (!cancelled_) {
-    // Lock the caller mutex (used in Queue() for thread synchronization)
-    caller_mutex_.lock();
+  if (buffer != nullptr && buffer->width() == frame.width() && buffer->height() == frame.height()) {
+    cache_buffer_ = nullptr;
+  } else {
+    buffer = new TextureBuffer();
+    buffer->Create(&ctx_, parent_->format(), frame.width(), frame.height());
+  }
 
-    // Main waiting condition
-    wait_cond_.wait(&mutex_);
+  // Keep the frame for later sessions too, read back before the cache can take (and delete) the copy
+  if (DiskFrameCache::budget() > 0) {
+    QString disk_key = DiskFrameCache::FrameKey(job->cache_key(), frame.width(), frame.height(), parent_->format());
 
-    // Unlock the caller mutex
-    caller_mutex_.unlock();
+    if (!DiskFrameCache::Contains(disk_key)) {
+      std::shared_ptr<MemoryBuffer> download = std::make_shared<MemoryBuffer>();
+      download->Create(frame.width(), frame.height(), parent_->format());
 
-    // Process the Node
-    node_->Process(time_);
+      // Saved once it arrives, GL commands run in order so the next job can draw over the texture straight away
+      downloader_.Download(texture, parent_->format(), QRect(0, 0, frame.width(), frame.height()),
+                           download->data(), download->linesize(), [disk_key, download](bool ok) {
+        if (ok) {
+          DiskFrameCache::Save(disk_key, std::move(*download));
+        }
+      });
+    }
   }
 
-  // Release OpenGL context
-  ctx_.doneCurrent();
+  // The result texture is reused by the next job, so the cache needs its own copy
+  olive::render_backend->CopyTexture(texture, buffer->texture(), QRect(0, 0, frame.width(), frame.height()));
 
-  // Destroy offscreen surface
-  surface_.destroy();
+  TextureBuffer* spare = InsertIntoCache(job, buffer);
+
+  // A full resolution copy that was only compressed from can take the next frame
+  if (spare != nullptr && cache_buffer_ == nullptr && job->divider() == 1) {
+    cache_buffer_ = spare;
+  } else {
+    delete spare;
+  }
+
+  // Allocate the next full resolution buffer now that the frame is in the cache, rather than before the next one is
+  if (cache_buffer_ == nullptr && job->divider() == 1) {
+    cache_buffer_ = new TextureBuffer();
+    cache_buffer_->Create(&ctx_, parent_->format(), frame.width(), frame.height());
+  }
+}
+
+TextureBuffer *RendererThread::InsertIntoCache(RenderJob *job, TextureBuffer *buffer)
+{
+  CompressedTexture* compressed = nullptr;
+
+  if (FrameCache::compression_enabled()) {
+    compressed = new CompressedTexture();
+
+    // Frames that can't be compressed (or don't fit, e.g. HDR highlights) are kept as they are
+    if (!compressed->Create(&ctx_, buffer->texture(), buffer->width(), buffer->height())) {
+      delete compressed;
+      compressed = nullptr;
+    }
+  }
+
+  // Cached frames must be ready to show the moment they're looked up, this thread has nothing more urgent to do
+  RenderBackend::Fence fence = olive::render_backend->CreateFence();
+  olive::render_backend->WaitFence(fence);
+  olive::render_backend->DestroyFence(fence);
+
+  if (compressed != nullptr) {
+    parent_->frame_cache()->Insert(job->output(), job->time(), job->divider(), job->cache_key(), compressed,
+                                   job->cache_generation());
+
+    return buffer;
+  }
+
+  parent_->frame_cache()->Insert(job->output(), job->time(), job->divider(), job->cache_key(), buffer,
+                                 job->cache_generation());
+
+  return nullptr;
+}
+
+void RendererThread::StitchTile(RenderJobPtr job)
+{
+  const MemoryBuffer* result = job->result().toBuffer();
+  GLuint texture = job->result().toTexture();
+
+  // Finished once the tile's pixels are in the frame, a tile that couldn't be read back drops the frame
+  TextureDownloader::Callback finish = [this, job](bool ok) {
+    if (ok) {
+      job->SetFinished();
+    }
+
+    parent_->FinishJob(job);
+  };
+
+  if (result == nullptr && texture == 0) {
+    finish(true);
+    return;
+  }
+
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kReadback);
+  Tracing::Span span("readback", "RendererThread::StitchTile");
+
+  MemoryBuffer& frame = job->tiled_frame()->buffer;
+
+  const QRect& tile = job->tile();
+  const QRect& inner = job->tile_inner();
+
+  if (job->tiled_frame()->semi_planar) {
+    // Packed frames are a plane and a half high (see SemiPlanarPacker::PackedSize())
+    int frame_height = frame.height() / 3 * 2;
+
+    if (result != nullptr) {
+      SemiPlanarPacker::PackBuffer(*result, inner.translated(-tile.topLeft()), &frame, inner.topLeft(), frame_height);
+      finish(true);
+    } else {
+      packer_.Pack(&ctx_, texture, tile.size(), inner.translated(-tile.topLeft()), &frame, inner.topLeft(),
+                   frame_height, &downloader_, finish);
+    }
+
+    return;
+  }
+
+  const PixelFormatInfo& info = PixelService::GetPixelFormatInfo(frame.format());
+
+  if (result != nullptr) {
+    // Rendered in software, convert the inside of the tile into the frame's format
+    olive::cpu::Blit(*result, inner.translated(-tile.topLeft()), &frame, inner.topLeft());
+    finish(true);
+    return;
+  }
 
-  // Unlock mutex before exiting
-  mutex_.unlock();
+  // Read the inside of the tile (without margins) straight into its place in the frame
+  downloader_.Download(texture,
+                       frame.format(),
+                       inner.translated(-tile.topLeft()),
+                       frame.row(inner.y()) + inner.x() * info.bytes_per_pixel,
+                       frame.linesize(),
+                       finish);
 }
@@ -24,45 +24,198 @@
 #include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QThread>
-#include <QWaitCondition>
 
+#include "common/profiledmutex.h"
+#include "node/evaluationcontext.h"
 #include "node/node.h"
+#include "render/semiplanarpacker.h"
 #include "render/texturebuffer.h"
-
+#include "render/texturedownloader.h"
+#include "renderjob.h"
+#include "renderprofiler.h"
+
+class RendererProcessor;
+
+/**
+ * @brief A worker thread with its own OpenGL context that processes RenderJobs for a RendererProcessor
+ *
+ * Each thread has its own deque of jobs. The thread takes the newest job from its own deque first (it's most likely to
+ * still be relevant and its data is most likely still cached), and when that's empty steals the oldest job from
+ * another thread's deque (see RendererProcessor::TakeJob()).
+ *
+ * Every thread's context shares with QOpenGLContext::globalShareContext() (enabled with Qt::AA_ShareOpenGLContexts in
+ * main()), so textures rendered here are valid in the viewers' contexts too.
+ *
+ * Threads live as long as the RendererProcessor is started. Each one creates its context and builds the common
+ * pipelines before taking its first job (see WarmUp()), so no frame waits for them. If the context is lost (e.g. after
+ * a driver reset), the job is dropped and the context is created again.
+ *
+ * Frames that are read back (exported or saved to the DiskFrameCache) are transferred through a TextureDownloader, so
+ * the next job renders while the previous one's pixels cross the bus. A tile job is only finished once its pixels are
+ * in the frame. The thread waits for its downloads before it waits for another job.
+ *
+ * If no context can be created and the renderer reads frames back (see RendererProcessor::SetReadbackEnabled()), the
+ * thread renders on the CPU instead (see NodeEvaluationContext::software() and olive::cpu).
+ */
 class RendererThread : public QThread
 {
 public:
-  RendererThread();
-
-  QOpenGLContext* context();
+  /**
+   * @brief RendererThread Constructor
+   *
+   * Must be called from the main thread since the offscreen surface is created here.
+   */
+  RendererThread(RendererProcessor* parent, int index, int count);
 
-  TextureBuffer* buffer();
+  virtual ~RendererThread() override;
 
-  bool Queue(Node* n, const rational &time);
+  QOpenGLContext* context();
 
-  void Cancel();
+  /**
+   * @brief Index of this thread in its RendererProcessor
+   */
+  int index();
+
+  /**
+   * @brief The job this thread is processing (or nullptr if it's idle)
+   */
+  RenderJob* current_job();
+
+  /**
+   * @brief Add a job to the back of this thread's deque
+   */
+  void PushJob(RenderJobPtr job);
+
+  /**
+   * @brief Take the newest job from this thread's deque (called by this thread)
+   *
+   * @return
+   *
+   * The job or nullptr if the deque is empty.
+   */
+  RenderJobPtr PopJob();
+
+  /**
+   * @brief Take the oldest job from this thread's deque (called by other threads)
+   *
+   * @return
+   *
+   * The job or nullptr if the deque is empty.
+   */
+  RenderJobPtr StealJob();
+
+  /**
+   * @brief Remove all jobs from this thread's deque
+   *
+   * @return
+   *
+   * The jobs that were removed.
+   */
+  QList<RenderJobPtr> ClearJobs();
 
   virtual void run() override;
 
 private:
+  /**
+   * @brief Create the context (again) and make it current on this thread
+   */
+  bool CreateContext();
+
+  /**
+   * @brief Prepare a new context for rendering
+   *
+   * Builds the pipelines nearly every frame uses and allocates a frame for CacheResult() at the size and format set
+   * with RendererProcessor::SetParameters().
+   */
+  void WarmUp();
+
+  /**
+   * @brief Returns TRUE if the context has been lost and has to be created again
+   */
+  bool IsContextLost();
+
+  /**
+   * @brief Process a job's output with its graph's execution plan and return the result
+   */
+  NodeValue Render(RenderJob* job);
+
+  /**
+   * @brief Read a rendered tile job's result back into its part of the tiled frame, then finish the job
+   *
+   * Results in textures are read back through downloader_, so the job is only finished once that has completed.
+   */
+  void StitchTile(RenderJobPtr job);
+
+  /**
+   * @brief Look a job's frame up by its content hash before rendering it
+   *
+   * A background job's time is bound to a frame with the same content in the FrameCache, or the frame is read from
+   * the DiskFrameCache into the FrameCache. A foreground job that shows a whole frame (or reads back a whole frame in
+   * one tile) is read from the DiskFrameCache into `value`.
+   *
+   * @return
+   *
+   * TRUE if the frame was found, in which case there's nothing to render.
+   */
+  bool FindCached(RenderJob* job, NodeValue* value);
+
+  /**
+   * @brief Copy a finished background job's result texture into the FrameCache
+   *
+   * Waits for the GPU to finish the copy, so the cached frame can be shown straight away.
+   */
+  void CacheResult(RenderJob* job);
+
+  /**
+   * @brief Hand a finished frame to the FrameCache, compressing it first if that's enabled
+   *
+   * Waits for the GPU to finish, so the cached frame can be shown straight away.
+   *
+   * @return
+   *
+   * `buffer` if it's free to reuse because the cache took a compressed copy, otherwise nullptr (the cache took it).
+   */
+  TextureBuffer* InsertIntoCache(RenderJob* job, TextureBuffer* buffer);
+
+  RendererProcessor* parent_;
+
+  int index_;
+
+  // Number of threads in the RendererProcessor
+  int count_;
+
+  RenderJob* current_job_;
+
+  RenderProfiler profiler_;
+
+  // Current on this thread while it runs, and updated for each job
+  NodeEvaluationContext eval_context_;
+
   QOpenGLContext ctx_;
 
   QOffscreenSurface surface_;
 
-  TextureBuffer buffer_;
+  // glGetGraphicsResetStatus() if the context supports it
+  typedef GLenum (QOPENGLF_APIENTRYP GetGraphicsResetStatus)();
+  GetGraphicsResetStatus get_reset_status_;
 
-  QWaitCondition wait_cond_;
+  // Full resolution buffer the next background frame is copied into (or nullptr to allocate one)
+  TextureBuffer* cache_buffer_;
 
-  QMutex mutex_;
+  // Frame most recently shown from the DiskFrameCache by a foreground job
+  TextureBuffer disk_frame_;
 
-  QMutex caller_mutex_;
+  // Converts tiles of frames read back as Y'CbCr (see RendererProcessor::SetReadbackSemiPlanar())
+  SemiPlanarPacker packer_;
 
-  Node* node_;
+  // Reads tiles and frames for the DiskFrameCache back while the next job renders
+  TextureDownloader downloader_;
 
-  rational time_;
+  QList<RenderJobPtr> jobs_;
 
-  bool cancelled_;
+  ProfiledMutex jobs_mutex_;
 };
 
 #endif // RENDERTHREAD_H
@@ -0,0 +1,281 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderjob.h"
+
+RenderJob::RenderJob(NodeOutput *output, const rational &time, qint64 sequence, int divider) :
+  output_(output),
+  time_(time),
+  sequence_(sequence),
+  divider_(divider),
+  keyframes_only_(false),
+  render_time_(0),
+  started_age_(0),
+  finished_age_(0),
+  sharers_(1),
+  fenced_(false),
+  background_(false),
+  cache_generation_(0),
+  provisional_(false),
+  cancelled_(0),
+  finished_(0)
+{
+  created_.start();
+}
+
+NodeOutput *RenderJob::output()
+{
+  return output_;
+}
+
+const rational &RenderJob::time()
+{
+  return time_;
+}
+
+qint64 RenderJob::sequence()
+{
+  return sequence_;
+}
+
+int RenderJob::divider()
+{
+  return divider_;
+}
+
+bool RenderJob::keyframes_only()
+{
+  return keyframes_only_;
+}
+
+void RenderJob::SetKeyframesOnly(bool keyframes_only)
+{
+  keyframes_only_ = keyframes_only;
+}
+
+qint64 RenderJob::render_time()
+{
+  return render_time_;
+}
+
+void RenderJob::SetRenderTime(qint64 ms)
+{
+  render_time_ = ms;
+}
+
+qint64 RenderJob::age()
+{
+  return created_.nsecsElapsed();
+}
+
+qint64 RenderJob::started_age()
+{
+  return started_age_;
+}
+
+qint64 RenderJob::finished_age()
+{
+  return finished_age_;
+}
+
+void RenderJob::SetStarted()
+{
+  started_age_ = age();
+}
+
+const QRect &RenderJob::tile()
+{
+  return tile_;
+}
+
+const QRect &RenderJob::tile_inner()
+{
+  return tile_inner_;
+}
+
+void RenderJob::SetTile(const QRect &tile, const QRect &inner)
+{
+  tile_ = tile;
+  tile_inner_ = inner;
+}
+
+RenderTiledFramePtr RenderJob::tiled_frame()
+{
+  return tiled_frame_;
+}
+
+void RenderJob::SetTiledFrame(RenderTiledFramePtr frame)
+{
+  tiled_frame_ = frame;
+}
+
+MemoryBuffer *RenderJob::frame_buffer()
+{
+  // Tile jobs are never delivered in order, so only the frame job has a sequence
+  if (tiled_frame_ == nullptr || sequence_ < 0) {
+    return nullptr;
+  }
+
+  return &tiled_frame_->buffer;
+}
+
+bool RenderJob::frame_semi_planar()
+{
+  return frame_buffer() != nullptr && tiled_frame_->semi_planar;
+}
+
+const NodeValue &RenderJob::result()
+{
+  return result_;
+}
+
+void RenderJob::SetResult(const NodeValue &result)
+{
+  result_ = result;
+}
+
+bool RenderJob::Share()
+{
+  QMutexLocker locker(&share_mutex_);
+
+  // Nobody's waiting for a cancelled job any more, and a fenced one has no fence left for another sharer
+  if (IsCancelled() || fenced_) {
+    return false;
+  }
+
+  sharers_++;
+
+  return true;
+}
+
+void RenderJob::Cancel()
+{
+  QMutexLocker locker(&share_mutex_);
+
+  if (sharers_ > 1) {
+    sharers_--;
+    return;
+  }
+
+  cancelled_.storeRelease(1);
+}
+
+void RenderJob::Abort()
+{
+  cancelled_.storeRelease(1);
+}
+
+const QAtomicInt *RenderJob::cancel_token()
+{
+  return &cancelled_;
+}
+
+bool RenderJob::IsCancelled()
+{
+  return cancelled_.loadAcquire();
+}
+
+void RenderJob::SetBackground(int cache_generation)
+{
+  background_ = true;
+  cache_generation_ = cache_generation;
+}
+
+bool RenderJob::IsBackground()
+{
+  return background_;
+}
+
+int RenderJob::cache_generation()
+{
+  return cache_generation_;
+}
+
+void RenderJob::SetCacheKey(const QByteArray &key)
+{
+  cache_key_ = key;
+}
+
+const QByteArray &RenderJob::cache_key()
+{
+  return cache_key_;
+}
+
+bool RenderJob::IsProvisional()
+{
+  return provisional_;
+}
+
+void RenderJob::SetProvisional(bool provisional)
+{
+  provisional_ = provisional;
+}
+
+bool RenderJob::IsFinished()
+{
+  return finished_.loadAcquire();
+}
+
+void RenderJob::SetFinished()
+{
+  finished_age_ = age();
+
+  if (started_age_ == 0) {
+    started_age_ = finished_age_;
+  }
+
+  finished_.storeRelease(1);
+}
+
+GLsync RenderJob::TakeFence()
+{
+  QMutexLocker locker(&share_mutex_);
+
+  if (fences_.isEmpty()) {
+    return nullptr;
+  }
+
+  GLsync fence = fences_.last();
+  fences_.removeLast();
+
+  return fence;
+}
+
+void RenderJob::CreateFences(QOpenGLExtraFunctions *xf)
+{
+  QMutexLocker locker(&share_mutex_);
+
+  for (int i=0;i<sharers_;i++) {
+    fences_.append(xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  }
+
+  fenced_ = true;
+}
+
+void RenderJob::DeleteFences(QOpenGLExtraFunctions *xf)
+{
+  QMutexLocker locker(&share_mutex_);
+
+  foreach (GLsync fence, fences_) {
+    xf->glDeleteSync(fence);
+  }
+
+  fences_.clear();
+}
@@ -0,0 +1,326 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERJOB_H
+#define RENDERJOB_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QMutex>
+#include <QOpenGLExtraFunctions>
+#include <QRect>
+#include <QVector>
+
+#include "node/node.h"
+#include "node/value.h"
+#include "render/memorybuffer.h"
+
+class RenderJob;
+
+/**
+ * @brief A frame too large to render in one piece, rendered as several tile jobs and stitched in RAM
+ */
+struct RenderTiledFrame {
+  // Job delivered once every tile is stitched (reset once it's finished to break the reference cycle)
+  std::shared_ptr<RenderJob> frame;
+
+  // Whole frame, each tile job reads its tile back into its part of this buffer
+  MemoryBuffer buffer;
+
+  // Whether `buffer` holds the frame packed by SemiPlanarPacker (see RendererProcessor::SetReadbackSemiPlanar())
+  bool semi_planar;
+
+  // Tiles that haven't been stitched or dropped yet
+  QAtomicInt remaining;
+
+  // Sum of the tiles' render times in milliseconds
+  QAtomicInt render_time;
+};
+
+using RenderTiledFramePtr = std::shared_ptr<RenderTiledFrame>;
+
+/**
+ * @brief A request to retrieve a NodeOutput's value at a certain time on one of RendererProcessor's threads
+ *
+ * Jobs are created by RendererProcessor::Queue() and RendererProcessor::QueueFrame(). Cancelling a job only sets a
+ * flag, the thread that would have processed it drops it when it's taken from the queue. A job that's already being
+ * processed is abandoned early by any node that watches cancel_token().
+ *
+ * A frame requested by several viewers at once is rendered once and shared between them (see Share()). Each viewer
+ * sharing it cancels it and takes its fence separately.
+ */
+class RenderJob
+{
+public:
+  /**
+   * @brief RenderJob Constructor
+   *
+   * @param sequence
+   *
+   * Position of this job in presentation order, or -1 if it isn't delivered in order (see
+   * RendererProcessor::QueueFrame()).
+   */
+  RenderJob(NodeOutput* output, const rational& time, qint64 sequence = -1, int divider = 1);
+
+  RenderJob(const RenderJob& other) = delete;
+  RenderJob(RenderJob&& other) = delete;
+  RenderJob& operator=(const RenderJob& other) = delete;
+  RenderJob& operator=(RenderJob&& other) = delete;
+
+  NodeOutput* output();
+
+  const rational& time();
+
+  qint64 sequence();
+
+  /**
+   * @brief Resolution divider to render this job at (1 for full resolution, 2 for half, etc.)
+   *
+   * Nodes should render at the RendererProcessor's width and height divided by this. Retrieve it while processing
+   * with RendererProcessor::CurrentDivider().
+   */
+  int divider();
+
+  /**
+   * @brief Whether footage may be shown at its closest keyframe instead of the exact frame (e.g. for fast shuttling)
+   *
+   * Nodes see this through NodeEvaluationContext::CurrentKeyframesOnly().
+   */
+  bool keyframes_only();
+  void SetKeyframesOnly(bool keyframes_only);
+
+  /**
+   * @brief Milliseconds the render thread spent processing this job (only valid once IsFinished() returns TRUE)
+   */
+  qint64 render_time();
+
+  void SetRenderTime(qint64 ms);
+
+  /**
+   * @brief Nanoseconds since this job was created (e.g. for measuring how long each stage of a frame takes)
+   */
+  qint64 age();
+
+  /**
+   * @brief age() when a render thread started processing this job, or 0 if none has yet
+   *
+   * Jobs finished without being rendered (e.g. delivered from the FrameCache) start when they finish.
+   */
+  qint64 started_age();
+
+  /**
+   * @brief age() when this job finished, or 0 if it hasn't yet
+   */
+  qint64 finished_age();
+
+  /**
+   * @brief Called by RendererThread before processing this job
+   */
+  void SetStarted();
+
+  /**
+   * @brief Area of the (divided) frame this job renders, including overlap margins
+   *
+   * Nodes should render this region only (see RendererProcessor::CurrentTile()). For untiled jobs, this is the whole
+   * frame.
+   */
+  const QRect& tile();
+
+  /**
+   * @brief Area of tile() that's kept when stitching (tile() without the margins)
+   */
+  const QRect& tile_inner();
+
+  void SetTile(const QRect& tile, const QRect& inner);
+
+  /**
+   * @brief The tiled frame this job belongs to or is (nullptr if this job isn't tiled)
+   */
+  RenderTiledFramePtr tiled_frame();
+
+  void SetTiledFrame(RenderTiledFramePtr frame);
+
+  /**
+   * @brief For frames rendered in tiles, the stitched frame (nullptr otherwise, use result() instead)
+   */
+  MemoryBuffer* frame_buffer();
+
+  /**
+   * @brief Returns TRUE if frame_buffer() holds the frame packed by SemiPlanarPacker rather than as RGBA
+   */
+  bool frame_semi_planar();
+
+  /**
+   * @brief The output's value at this job's time (only valid once IsFinished() returns TRUE)
+   */
+  const NodeValue& result();
+
+  void SetResult(const NodeValue& result);
+
+  /**
+   * @brief Take a fence signalled once the GPU has finished rendering the result, or nullptr if there is none
+   *
+   * Render threads share their textures with every other context (see RendererThread), so a texture result can be
+   * drawn in another context directly, as long as that context waits on this fence first (e.g. with glWaitSync()).
+   * Whoever takes the fence is responsible for deleting it. There's one fence for every sharer of the job, so each
+   * should only take one.
+   */
+  GLsync TakeFence();
+
+  /**
+   * @brief Called by RendererThread with its context current to fence the result for every sharer
+   *
+   * Once fenced, the job can't be shared any more.
+   */
+  void CreateFences(QOpenGLExtraFunctions* xf);
+
+  /**
+   * @brief Delete the fences nobody took (requires a current context in the render threads' share group)
+   */
+  void DeleteFences(QOpenGLExtraFunctions* xf);
+
+  /**
+   * @brief Add another requester of this job's result
+   *
+   * @return
+   *
+   * TRUE if the job can be shared. FALSE if it's already been cancelled or fenced, in which case a new job is needed.
+   */
+  bool Share();
+
+  /**
+   * @brief Prevent this job from being processed if it hasn't started yet
+   *
+   * If the job is shared, this only withdraws one sharer and the job is cancelled once every sharer has cancelled it.
+   * Safe to call from any thread.
+   */
+  void Cancel();
+
+  /**
+   * @brief Cancel the job for every sharer
+   */
+  void Abort();
+
+  bool IsCancelled();
+
+  /**
+   * @brief Becomes non-zero once Cancel() is called, suitable for Decoder::set_cancel_token()
+   *
+   * Render threads make this available to nodes with NodeEvaluationContext::CurrentCancelToken().
+   */
+  const QAtomicInt* cancel_token();
+
+  /**
+   * @brief Mark this job as rendering ahead into the FrameCache (see RendererProcessor::QueueBackgroundFrame())
+   *
+   * @param cache_generation
+   *
+   * FrameCache::generation() when the job was queued.
+   */
+  void SetBackground(int cache_generation);
+
+  bool IsBackground();
+
+  int cache_generation();
+
+  /**
+   * @brief The NodeOutput::ContentHash() of the frame, set by the render thread of a background job before rendering
+   */
+  void SetCacheKey(const QByteArray& key);
+
+  const QByteArray& cache_key();
+
+  /**
+   * @brief Whether the result is an approximation that should be rendered again (see
+   * NodeEvaluationContext::provisional())
+   */
+  bool IsProvisional();
+
+  void SetProvisional(bool provisional);
+
+  /**
+   * @brief Returns TRUE once a thread has finished processing this job
+   */
+  bool IsFinished();
+
+  /**
+   * @brief Called by RendererThread after processing this job
+   */
+  void SetFinished();
+
+private:
+  NodeOutput* output_;
+
+  rational time_;
+
+  qint64 sequence_;
+
+  int divider_;
+
+  bool keyframes_only_;
+
+  qint64 render_time_;
+
+  // Started on creation, see age()
+  QElapsedTimer created_;
+
+  qint64 started_age_;
+
+  qint64 finished_age_;
+
+  QRect tile_;
+
+  QRect tile_inner_;
+
+  RenderTiledFramePtr tiled_frame_;
+
+  NodeValue result_;
+
+  // One per sharer, created in CreateFences()
+  QVector<GLsync> fences_;
+
+  // Number of requesters that haven't cancelled, see Share()
+  int sharers_;
+
+  bool fenced_;
+
+  // Protects fences_, sharers_ and fenced_
+  QMutex share_mutex_;
+
+  bool background_;
+
+  int cache_generation_;
+
+  QByteArray cache_key_;
+
+  bool provisional_;
+
+  QAtomicInt cancelled_;
+
+  QAtomicInt finished_;
+};
+
+using RenderJobPtr = std::shared_ptr<RenderJob>;
+
+Q_DECLARE_METATYPE(RenderJobPtr)
+
+#endif // RENDERJOB_H
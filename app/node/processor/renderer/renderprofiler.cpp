@@ -0,0 +1,283 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderprofiler.h"
+
+#include <algorithm>
+#include <QOpenGLExtraFunctions>
+
+// Not in the OpenGL ES 3 headers Qt may have been built with
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+// Profiler of the current render thread
+static thread_local RenderProfiler* current_profiler = nullptr;
+
+RenderProfiler::RenderProfiler() :
+  ctx_(nullptr),
+  enabled_(false),
+  timer_queries_(false),
+  in_frame_(false),
+  query_active_(false)
+{
+}
+
+void RenderProfiler::Create(QOpenGLContext *ctx, const Callback &callback)
+{
+  ctx_ = ctx;
+  callback_ = callback;
+
+  timer_queries_ = (ctx->format().version() >= qMakePair(3, 3) || ctx->hasExtension("GL_ARB_timer_query"));
+
+  current_profiler = this;
+}
+
+void RenderProfiler::Destroy()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  foreach (const PendingFrame& frame, pending_) {
+    foreach (const Query& q, frame.queries) {
+      free_queries_.append(q.id);
+    }
+  }
+
+  pending_.clear();
+
+  if (!free_queries_.isEmpty()) {
+    xf->glDeleteQueries(free_queries_.size(), free_queries_.constData());
+    free_queries_.clear();
+  }
+
+  if (current_profiler == this) {
+    current_profiler = nullptr;
+  }
+
+  ctx_ = nullptr;
+}
+
+RenderProfiler *RenderProfiler::Current()
+{
+  return current_profiler;
+}
+
+void RenderProfiler::SetEnabled(bool enabled)
+{
+  enabled_ = enabled;
+}
+
+void RenderProfiler::BeginFrame(const rational &time)
+{
+  if (!enabled_ || ctx_ == nullptr) {
+    return;
+  }
+
+  current_.time = time;
+  current_.nodes.clear();
+  current_.queries.clear();
+
+  stack_.clear();
+
+  in_frame_ = true;
+}
+
+void RenderProfiler::EndFrame()
+{
+  if (!in_frame_) {
+    return;
+  }
+
+  in_frame_ = false;
+
+  if (current_.queries.isEmpty()) {
+    Publish(current_);
+  } else {
+    pending_.append(current_);
+  }
+}
+
+void RenderProfiler::BeginNode(Node *node)
+{
+  if (!in_frame_) {
+    return;
+  }
+
+  // Whatever was processing is paused while this node processes
+  StopQuery();
+
+  StackEntry entry;
+  entry.node = NodeIndex(node);
+  entry.child_ns = 0;
+  entry.timer.start();
+
+  stack_.append(entry);
+
+  StartQuery(entry.node);
+}
+
+void RenderProfiler::EndNode()
+{
+  if (!in_frame_ || stack_.isEmpty()) {
+    return;
+  }
+
+  StopQuery();
+
+  StackEntry entry = stack_.takeLast();
+
+  qint64 elapsed = entry.timer.nsecsElapsed();
+
+  current_.nodes[entry.node].cpu_ms += static_cast<double>(elapsed - entry.child_ns) * 0.000001;
+
+  // Resume the node that pulled from this one
+  if (!stack_.isEmpty()) {
+    stack_.last().child_ns += elapsed;
+
+    StartQuery(stack_.last().node);
+  }
+}
+
+void RenderProfiler::Poll(bool wait)
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  // Frames finish in order, so stop at the first one that isn't ready
+  while (!pending_.isEmpty()) {
+    PendingFrame& frame = pending_.first();
+
+    if (!wait) {
+      GLuint available = GL_FALSE;
+      xf->glGetQueryObjectuiv(frame.queries.last().id, GL_QUERY_RESULT_AVAILABLE, &available);
+
+      if (!available) {
+        return;
+      }
+    }
+
+    foreach (const Query& q, frame.queries) {
+      GLuint ns = 0;
+      xf->glGetQueryObjectuiv(q.id, GL_QUERY_RESULT, &ns);
+
+      frame.nodes[q.node].gpu_ms += static_cast<double>(ns) * 0.000001;
+
+      free_queries_.append(q.id);
+    }
+
+    frame.queries.clear();
+
+    Publish(frame);
+
+    pending_.removeFirst();
+  }
+}
+
+bool RenderProfiler::HasPending()
+{
+  return !pending_.isEmpty();
+}
+
+int RenderProfiler::NodeIndex(Node *node)
+{
+  for (int i=0;i<current_.nodes.size();i++) {
+    if (current_.nodes.at(i).node == node) {
+      return i;
+    }
+  }
+
+  NodeEntry entry;
+  entry.node = node;
+  entry.cpu_ms = 0;
+  entry.gpu_ms = 0;
+
+  current_.nodes.append(entry);
+
+  return current_.nodes.size() - 1;
+}
+
+void RenderProfiler::StartQuery(int node)
+{
+  if (!timer_queries_) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  Query q;
+  q.node = node;
+
+  if (free_queries_.isEmpty()) {
+    xf->glGenQueries(1, &q.id);
+  } else {
+    q.id = free_queries_.takeLast();
+  }
+
+  xf->glBeginQuery(GL_TIME_ELAPSED, q.id);
+
+  current_.queries.append(q);
+
+  query_active_ = true;
+}
+
+void RenderProfiler::StopQuery()
+{
+  if (!query_active_) {
+    return;
+  }
+
+  ctx_->extraFunctions()->glEndQuery(GL_TIME_ELAPSED);
+
+  query_active_ = false;
+}
+
+void RenderProfiler::Publish(RenderProfiler::PendingFrame &frame)
+{
+  if (!callback_) {
+    return;
+  }
+
+  RenderProfile profile;
+  profile.time = frame.time;
+
+  foreach (const NodeEntry& entry, frame.nodes) {
+    RenderNodeTiming timing;
+    timing.node = entry.node;
+    timing.name = entry.node->Name();
+    timing.cpu_ms = entry.cpu_ms;
+    timing.gpu_ms = entry.gpu_ms;
+
+    profile.nodes.append(timing);
+  }
+
+  // Slowest first, whichever of the CPU or GPU took longer
+  std::sort(profile.nodes.begin(), profile.nodes.end(), [](const RenderNodeTiming& a, const RenderNodeTiming& b) {
+    return qMax(a.cpu_ms, a.gpu_ms) > qMax(b.cpu_ms, b.gpu_ms);
+  });
+
+  callback_(profile);
+}
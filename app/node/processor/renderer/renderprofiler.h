@@ -0,0 +1,180 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERPROFILER_H
+#define RENDERPROFILER_H
+
+#include <functional>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QOpenGLContext>
+#include <QVector>
+
+#include "node/node.h"
+
+/**
+ * @brief Time a node spent processing one frame
+ *
+ * Times are exclusive: time spent in the nodes it pulled values from is counted towards those nodes instead.
+ */
+struct RenderNodeTiming {
+  Node* node;
+  QString name;
+  double cpu_ms;
+  double gpu_ms;
+};
+
+/**
+ * @brief Per-node timings of one rendered frame, sorted slowest first
+ */
+struct RenderProfile {
+  rational time;
+  QVector<RenderNodeTiming> nodes;
+};
+
+Q_DECLARE_METATYPE(RenderProfile)
+
+/**
+ * @brief Measures how long each node's Process() takes on a render thread, on the CPU and the GPU
+ *
+ * NodeOutput::get_value() calls BeginNode() and EndNode() around Process() whenever a profiler is active on the current
+ * thread. CPU time is measured with QElapsedTimer and GPU time with GL_TIME_ELAPSED queries. Queries can't be nested,
+ * so when a node pulls a value from another node, its query is ended and a new one is started once the other node
+ * returns, with every query attributed to whichever node was processing at the time.
+ *
+ * Query results are collected with Poll() without waiting, so measuring never stalls the pipeline. A frame's profile
+ * is published once every one of its queries has a result.
+ *
+ * If the context doesn't support timer queries (OpenGL 3.3 or GL_ARB_timer_query), only CPU times are measured.
+ */
+class RenderProfiler
+{
+public:
+  using Callback = std::function<void(const RenderProfile&)>;
+
+  RenderProfiler();
+
+  RenderProfiler(const RenderProfiler& other) = delete;
+  RenderProfiler(RenderProfiler&& other) = delete;
+  RenderProfiler& operator=(const RenderProfiler& other) = delete;
+  RenderProfiler& operator=(RenderProfiler&& other) = delete;
+
+  /**
+   * @brief Start profiling in a context (which must be current) and make this the current thread's profiler
+   *
+   * @param callback
+   *
+   * Called from this thread with each frame's profile once it's complete.
+   */
+  void Create(QOpenGLContext* ctx, const Callback& callback);
+
+  /**
+   * @brief Stop profiling and free all queries (the context must be current)
+   */
+  void Destroy();
+
+  /**
+   * @brief Returns the profiler active on the current thread, or nullptr if there is none
+   */
+  static RenderProfiler* Current();
+
+  void SetEnabled(bool enabled);
+
+  void BeginFrame(const rational& time);
+  void EndFrame();
+
+  void BeginNode(Node* node);
+  void EndNode();
+
+  /**
+   * @brief Collect available query results and publish complete profiles
+   *
+   * @param wait
+   *
+   * Wait for every pending result rather than only collecting the ones that are available. Only use this when the
+   * thread has nothing else to do.
+   */
+  void Poll(bool wait);
+
+  /**
+   * @brief Returns TRUE if any frames are waiting for query results
+   */
+  bool HasPending();
+
+private:
+  struct Query {
+    GLuint id;
+    int node;
+  };
+
+  struct NodeEntry {
+    Node* node;
+    double cpu_ms;
+    double gpu_ms;
+  };
+
+  struct PendingFrame {
+    rational time;
+    QVector<NodeEntry> nodes;
+    QVector<Query> queries;
+  };
+
+  struct StackEntry {
+    int node;
+    QElapsedTimer timer;
+
+    // CPU time spent in nodes this node pulled from
+    qint64 child_ns;
+  };
+
+  /**
+   * @brief Returns the index of a node in the current frame, adding it if necessary
+   */
+  int NodeIndex(Node* node);
+
+  void StartQuery(int node);
+  void StopQuery();
+
+  void Publish(PendingFrame& frame);
+
+  QOpenGLContext* ctx_;
+
+  Callback callback_;
+
+  bool enabled_;
+
+  bool timer_queries_;
+
+  // Frame currently being rendered (valid between BeginFrame() and EndFrame())
+  PendingFrame current_;
+  bool in_frame_;
+
+  QVector<StackEntry> stack_;
+
+  bool query_active_;
+
+  // Frames waiting for query results, oldest first
+  QList<PendingFrame> pending_;
+
+  // Query objects that can be reused
+  QVector<GLuint> free_queries_;
+};
+
+#endif // RENDERPROFILER_H
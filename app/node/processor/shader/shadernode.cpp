@@ -0,0 +1,209 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shadernode.h"
+
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <QVector2D>
+#include <QVector3D>
+
+namespace {
+
+const char* kIdPrefix = "org.olivevideoeditor.Olive.glsl.";
+
+QColor ToColor(const QVector<double>& value)
+{
+  return QColor::fromRgbF(qBound(0.0, value.at(0), 1.0),
+                          qBound(0.0, value.at(1), 1.0),
+                          qBound(0.0, value.at(2), 1.0),
+                          (value.size() > 3) ? qBound(0.0, value.at(3), 1.0) : 1.0);
+}
+
+}
+
+ShaderNode::ShaderNode(const QString &shader_name) :
+  shader_name_(shader_name)
+{
+  UserShaderLibrary::Shader shader;
+  olive::user_shaders.Get(shader_name_, &shader);
+
+  foreach (const UserShaderLibrary::Uniform& u, shader.uniforms) {
+    UniformInput ui;
+    ui.uniform = u;
+
+    switch (u.type) {
+    case UserShaderLibrary::Uniform::kFloat:
+      ui.inputs.append(AddUniformInput(u.name, NodeParam::kFloat, NodeValue(u.default_value.at(0))));
+      break;
+    case UserShaderLibrary::Uniform::kInt:
+      ui.inputs.append(AddUniformInput(u.name, NodeParam::kInt,
+                                       NodeValue(static_cast<int>(u.default_value.at(0)))));
+      break;
+    case UserShaderLibrary::Uniform::kBool:
+      ui.inputs.append(AddUniformInput(u.name, NodeParam::kBoolean, NodeValue(u.default_value.at(0) != 0.0)));
+      break;
+    case UserShaderLibrary::Uniform::kVec2:
+      ui.inputs.append(AddUniformInput(tr("%1 X").arg(u.name), NodeParam::kFloat, NodeValue(u.default_value.at(0))));
+      ui.inputs.append(AddUniformInput(tr("%1 Y").arg(u.name), NodeParam::kFloat, NodeValue(u.default_value.at(1))));
+      break;
+    case UserShaderLibrary::Uniform::kVec3:
+    case UserShaderLibrary::Uniform::kVec4:
+      ui.inputs.append(AddUniformInput(u.name, NodeParam::kColor, NodeValue(ToColor(u.default_value))));
+      break;
+    }
+
+    uniforms_.append(ui);
+  }
+
+  connect(&olive::user_shaders, SIGNAL(ShaderChanged(const QString&)), this, SLOT(ShaderChanged(const QString&)));
+}
+
+ShaderNode *ShaderNode::CreateFromID(const QString &id)
+{
+  if (!id.startsWith(QLatin1String(kIdPrefix))) {
+    return nullptr;
+  }
+
+  QString name = id.mid(static_cast<int>(qstrlen(kIdPrefix)));
+
+  if (!olive::user_shaders.names().contains(name)) {
+    return nullptr;
+  }
+
+  return new ShaderNode(name);
+}
+
+QString ShaderNode::Name()
+{
+  return shader_name_;
+}
+
+QString ShaderNode::id()
+{
+  return QLatin1String(kIdPrefix) + shader_name_;
+}
+
+QString ShaderNode::Category()
+{
+  return tr("Shader");
+}
+
+QString ShaderNode::Description()
+{
+  return tr("Apply the user shader \"%1\".").arg(shader_name_);
+}
+
+void ShaderNode::Hash(QCryptographicHash *hash, const rational &time)
+{
+  PointwiseProcessor::Hash(hash, time);
+
+  // Frames cached before the shader changed shouldn't be reused
+  UserShaderLibrary::Shader shader;
+
+  if (olive::user_shaders.Get(shader_name_, &shader)) {
+    hash->addData(shader.hash);
+  }
+}
+
+QString ShaderNode::ShaderFunction(const QString &function_name)
+{
+  UserShaderLibrary::Shader shader;
+
+  if (!olive::user_shaders.Get(shader_name_, &shader)) {
+    // Passes colors through if the shader is gone
+    return QString("vec4 %1(vec4 color) {\n"
+                   "  return color;\n"
+                   "}\n").arg(function_name);
+  }
+
+  QString code = shader.source;
+
+  // Uniforms are prefixed with the function's name so the same shader can appear more than once in a fused pass
+  foreach (const UserShaderLibrary::Uniform& u, shader.uniforms) {
+    code.replace(QRegularExpression(QStringLiteral("(?<![\\w.])%1\\b").arg(QRegularExpression::escape(u.name))),
+                 QStringLiteral("%1_%2").arg(function_name, u.name));
+  }
+
+  code.replace(QRegularExpression(QStringLiteral("\\bfunction_name")), function_name);
+
+  return code;
+}
+
+void ShaderNode::SetUniforms(QOpenGLShaderProgram *program, const QString &function_name, const rational &time)
+{
+  foreach (const UniformInput& ui, uniforms_) {
+    QByteArray name = QStringLiteral("%1_%2").arg(function_name, ui.uniform.name).toUtf8();
+
+    switch (ui.uniform.type) {
+    case UserShaderLibrary::Uniform::kFloat:
+      program->setUniformValue(name.constData(), static_cast<GLfloat>(ui.inputs.at(0)->get_value(time).toDouble()));
+      break;
+    case UserShaderLibrary::Uniform::kInt:
+      program->setUniformValue(name.constData(), static_cast<GLint>(ui.inputs.at(0)->get_value(time).toInt()));
+      break;
+    case UserShaderLibrary::Uniform::kBool:
+      program->setUniformValue(name.constData(), static_cast<GLint>(ui.inputs.at(0)->get_value(time).toBool()));
+      break;
+    case UserShaderLibrary::Uniform::kVec2:
+      program->setUniformValue(name.constData(),
+                               QVector2D(static_cast<float>(ui.inputs.at(0)->get_value(time).toDouble()),
+                                         static_cast<float>(ui.inputs.at(1)->get_value(time).toDouble())));
+      break;
+    case UserShaderLibrary::Uniform::kVec3:
+    {
+      QColor color = ui.inputs.at(0)->get_value(time).toColor();
+
+      program->setUniformValue(name.constData(),
+                               QVector3D(static_cast<float>(color.redF()),
+                                         static_cast<float>(color.greenF()),
+                                         static_cast<float>(color.blueF())));
+      break;
+    }
+    case UserShaderLibrary::Uniform::kVec4:
+      program->setUniformValue(name.constData(), ui.inputs.at(0)->get_value(time).toColor());
+      break;
+    }
+  }
+}
+
+NodeInput *ShaderNode::AddUniformInput(const QString &name, NodeParam::DataType type, const NodeValue &value)
+{
+  NodeKeyframe key;
+  key.set_value(value);
+
+  NodeInput* input = new NodeInput();
+  input->add_data_input(type);
+  input->set_name(name);
+  input->insert_keyframe(key);
+  AddParameter(input);
+
+  return input;
+}
+
+void ShaderNode::ShaderChanged(const QString &name)
+{
+  if (name != shader_name_) {
+    return;
+  }
+
+  // Every frame this node has rendered is out of date
+  ClearCachedValues();
+}
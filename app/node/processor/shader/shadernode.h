@@ -0,0 +1,79 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERNODE_H
+#define SHADERNODE_H
+
+#include "node/processor/pointwise/pointwise.h"
+#include "usershaderlibrary.h"
+
+/**
+ * @brief A node applying a user GLSL shader from UserShaderLibrary
+ *
+ * Each shader is a node type of its own. The shader's uniforms become the node's inputs when it's created, in the
+ * order they're declared: floats, ints and bools get an input of their type, vec2s an input per component and vec3s
+ * and vec4s a color (passed as picked, not multiplied by alpha). Uniforms added to the shader later aren't set until
+ * the node is created again.
+ *
+ * Like any PointwiseProcessor, chains of shader nodes and other pointwise nodes render in a single pass. Shaders can't
+ * be run without a GPU, so software renders pass the input through.
+ */
+class ShaderNode : public PointwiseProcessor
+{
+  Q_OBJECT
+public:
+  ShaderNode(const QString& shader_name);
+
+  /**
+   * @brief Create a node for the shader with a node ID, or return nullptr if there's no such shader
+   */
+  static ShaderNode* CreateFromID(const QString& id);
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  virtual void Hash(QCryptographicHash* hash, const rational& time) override;
+
+  virtual QString ShaderFunction(const QString& function_name) override;
+
+  virtual void SetUniforms(QOpenGLShaderProgram* program, const QString& function_name, const rational& time) override;
+
+private:
+  struct UniformInput {
+    UserShaderLibrary::Uniform uniform;
+
+    // One per component for vec2s, one otherwise
+    QVector<NodeInput*> inputs;
+  };
+
+  NodeInput* AddUniformInput(const QString& name, NodeParam::DataType type, const NodeValue& value);
+
+  QString shader_name_;
+
+  QVector<UniformInput> uniforms_;
+
+private slots:
+  void ShaderChanged(const QString& name);
+
+};
+
+#endif // SHADERNODE_H
@@ -0,0 +1,210 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "usershaderlibrary.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStandardPaths>
+
+UserShaderLibrary olive::user_shaders;
+
+namespace {
+
+int ComponentCount(UserShaderLibrary::Uniform::Type type)
+{
+  switch (type) {
+  case UserShaderLibrary::Uniform::kVec2:
+    return 2;
+  case UserShaderLibrary::Uniform::kVec3:
+    return 3;
+  case UserShaderLibrary::Uniform::kVec4:
+    return 4;
+  case UserShaderLibrary::Uniform::kFloat:
+  case UserShaderLibrary::Uniform::kInt:
+  case UserShaderLibrary::Uniform::kBool:
+    break;
+  }
+
+  return 1;
+}
+
+}
+
+UserShaderLibrary::UserShaderLibrary()
+{
+  reload_timer_.setSingleShot(true);
+  reload_timer_.setInterval(kReloadDelay);
+
+  connect(&watcher_, SIGNAL(directoryChanged(const QString&)), this, SLOT(PathChanged()));
+  connect(&watcher_, SIGNAL(fileChanged(const QString&)), this, SLOT(PathChanged()));
+  connect(&reload_timer_, SIGNAL(timeout()), this, SLOT(Reload()));
+}
+
+void UserShaderLibrary::Start()
+{
+  QString dir = directory();
+
+  // Create the directory so there's somewhere obvious to put shaders
+  QDir().mkpath(dir);
+
+  watcher_.addPath(dir);
+
+  Reload();
+}
+
+QString UserShaderLibrary::directory()
+{
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("shaders");
+}
+
+QStringList UserShaderLibrary::names()
+{
+  QMutexLocker locker(&mutex_);
+
+  return shaders_.keys();
+}
+
+bool UserShaderLibrary::Get(const QString &name, UserShaderLibrary::Shader *shader)
+{
+  QMutexLocker locker(&mutex_);
+
+  if (!shaders_.contains(name)) {
+    return false;
+  }
+
+  *shader = shaders_.value(name);
+  return true;
+}
+
+QVector<UserShaderLibrary::Uniform> UserShaderLibrary::Reflect(const QString &source)
+{
+  static const QRegularExpression declaration(
+        QStringLiteral("^[ \\t]*uniform\\s+(\\w+)\\s+(\\w+)\\s*;[ \\t]*(?://[ \\t]*default:([^\\n]*))?"),
+        QRegularExpression::MultilineOption);
+
+  QHash<QString, Uniform::Type> types;
+  types.insert(QStringLiteral("float"), Uniform::kFloat);
+  types.insert(QStringLiteral("int"), Uniform::kInt);
+  types.insert(QStringLiteral("bool"), Uniform::kBool);
+  types.insert(QStringLiteral("vec2"), Uniform::kVec2);
+  types.insert(QStringLiteral("vec3"), Uniform::kVec3);
+  types.insert(QStringLiteral("vec4"), Uniform::kVec4);
+
+  QVector<Uniform> uniforms;
+
+  QRegularExpressionMatchIterator it = declaration.globalMatch(source);
+
+  while (it.hasNext()) {
+    QRegularExpressionMatch match = it.next();
+
+    if (!types.contains(match.captured(1))) {
+      qWarning() << "User shader uniforms of type" << match.captured(1) << "aren't supported, skipping"
+                 << match.captured(2);
+      continue;
+    }
+
+    Uniform u;
+    u.type = types.value(match.captured(1));
+    u.name = match.captured(2);
+
+    int components = ComponentCount(u.type);
+
+    QStringList values = match.captured(3).split(',');
+
+    for (int i=0;i<components;i++) {
+      bool ok = false;
+      double value = (i < values.size()) ? values.at(i).trimmed().toDouble(&ok) : 0.0;
+
+      if (!ok) {
+        value = (u.type == Uniform::kVec4 && i == 3) ? 1.0 : 0.0;
+      }
+
+      u.default_value.append(value);
+    }
+
+    uniforms.append(u);
+  }
+
+  return uniforms;
+}
+
+void UserShaderLibrary::PathChanged()
+{
+  // Restart the timer so a file being written in several steps is only read once it's done
+  reload_timer_.start();
+}
+
+void UserShaderLibrary::Reload()
+{
+  QDir dir(directory());
+
+  QStringList files = dir.entryList(QStringList() << QStringLiteral("*.glsl"), QDir::Files);
+  QStringList watched = watcher_.files();
+
+  QStringList changed;
+
+  foreach (const QString& file, files) {
+    QString filename = dir.filePath(file);
+
+    // Files that are replaced (written elsewhere and renamed over) lose their watch, so add them again
+    if (!watched.contains(filename)) {
+      watcher_.addPath(filename);
+    }
+
+    QFile f(filename);
+
+    if (!f.open(QFile::ReadOnly)) {
+      continue;
+    }
+
+    QString source = QString::fromUtf8(f.readAll());
+
+    f.close();
+
+    QString name = QFileInfo(file).completeBaseName();
+
+    QMutexLocker locker(&mutex_);
+
+    // Removed shaders are kept, nodes using them keep working until the project is closed
+    if (shaders_.contains(name) && shaders_.value(name).source == source) {
+      continue;
+    }
+
+    Shader s;
+    s.name = name;
+    s.filename = filename;
+    s.source = source;
+    s.hash = QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Sha1);
+    s.uniforms = Reflect(source);
+
+    shaders_.insert(name, s);
+
+    changed.append(name);
+  }
+
+  foreach (const QString& name, changed) {
+    emit ShaderChanged(name);
+  }
+}
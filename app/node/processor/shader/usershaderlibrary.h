@@ -0,0 +1,154 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef USERSHADERLIBRARY_H
+#define USERSHADERLIBRARY_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * @brief GLSL snippets written by the user, each available as a ShaderNode
+ *
+ * Every `*.glsl` file in directory() is a shader. A shader defines `vec4 function_name(vec4 color)` like
+ * PointwiseProcessor::ShaderFunction(), with `function_name` written literally (it's replaced with the name the
+ * function gets in the fused shader, as is `function_name` at the start of any other identifier, so helper functions
+ * named e.g. `function_name_luma` don't collide either). Uniforms of the types in Uniform::Type become the node's
+ * inputs, and may be given default values with a comment on the same line:
+ *
+ *     uniform float amount; // default: 0.5
+ *     uniform vec3 tint; // default: 1.0, 0.8, 0.6
+ *
+ * The directory is watched, and shaders are read again when their files change. Nodes clear their cached frames when
+ * their shader changes, and the new program is then compiled without holding up playback (see
+ * ShaderCache::GetAsync()). Start() must be called from the main thread once the application instance exists. Get()
+ * and names() are thread-safe.
+ *
+ * Use the application-wide olive::user_shaders.
+ */
+class UserShaderLibrary : public QObject
+{
+  Q_OBJECT
+public:
+  struct Uniform {
+    enum Type {
+      kFloat,
+      kInt,
+      kBool,
+      kVec2,
+      kVec3,
+      kVec4
+    };
+
+    Type type;
+
+    QString name;
+
+    // Values from the `default:` comment, missing values are 0 (1 for the alpha of a vec4)
+    QVector<double> default_value;
+  };
+
+  struct Shader {
+    QString name;
+
+    QString filename;
+
+    QString source;
+
+    // SHA-1 of the source, for node hashes
+    QByteArray hash;
+
+    // In the order they're declared
+    QVector<Uniform> uniforms;
+  };
+
+  UserShaderLibrary();
+
+  /**
+   * @brief Read every shader and start watching the directory
+   */
+  void Start();
+
+  /**
+   * @brief Directory shaders are read from (`shaders` in the application's data directory)
+   */
+  static QString directory();
+
+  /**
+   * @brief Names of every shader (the file names without `.glsl`)
+   */
+  QStringList names();
+
+  /**
+   * @brief Copy the shader with this name, returning FALSE if there's none
+   */
+  bool Get(const QString& name, Shader* shader);
+
+  /**
+   * @brief Find the uniforms a shader's source declares
+   *
+   * Uniforms of other types (e.g. samplers) are skipped with a warning.
+   */
+  static QVector<Uniform> Reflect(const QString& source);
+
+signals:
+  /**
+   * @brief Emitted on the main thread when a shader is added or its file changes
+   */
+  void ShaderChanged(const QString& name);
+
+private:
+  /**
+   * @brief How long to wait after a change before reading shaders again (milliseconds)
+   *
+   * Editors often write a file in several steps (e.g. truncate and then write), which shouldn't each be compiled.
+   */
+  static const int kReloadDelay = 200;
+
+  QFileSystemWatcher watcher_;
+
+  QTimer reload_timer_;
+
+  QHash<QString, Shader> shaders_;
+
+  QMutex mutex_;
+
+private slots:
+  void PathChanged();
+
+  /**
+   * @brief Read every shader file, updating the ones that changed
+   */
+  void Reload();
+
+};
+
+namespace olive {
+/**
+ * @brief Application-wide user shader library
+ */
+extern UserShaderLibrary user_shaders;
+}
+
+#endif // USERSHADERLIBRARY_H
@@ -0,0 +1,480 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "transform.h"
+
+#include <QOpenGLExtraFunctions>
+
+#include "node/evaluationcontext.h"
+#include "render/colormanagement.h"
+#include "render/cpurender.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+
+TransformNode::TransformNode()
+{
+  texture_input_ = new NodeInput();
+  texture_input_->add_data_input(NodeParam::kTexture);
+  AddParameter(texture_input_);
+
+  position_x_input_ = AddFloatInput(tr("Position X"), 0.0);
+  position_y_input_ = AddFloatInput(tr("Position Y"), 0.0);
+  scale_input_ = AddFloatInput(tr("Scale"), 1.0);
+  rotation_input_ = AddFloatInput(tr("Rotation"), 0.0);
+  anchor_x_input_ = AddFloatInput(tr("Anchor X"), 0.0);
+  anchor_y_input_ = AddFloatInput(tr("Anchor Y"), 0.0);
+
+  NodeKeyframe one;
+  one.set_value(NodeValue(1));
+
+  count_input_ = new NodeInput();
+  count_input_->add_data_input(NodeParam::kInt);
+  count_input_->set_name(tr("Count"));
+  count_input_->insert_keyframe(one);
+  AddParameter(count_input_);
+
+  columns_input_ = new NodeInput();
+  columns_input_->add_data_input(NodeParam::kInt);
+  columns_input_->set_name(tr("Columns"));
+  columns_input_->insert_keyframe(one);
+  AddParameter(columns_input_);
+
+  spacing_x_input_ = AddFloatInput(tr("Spacing X"), 0.0);
+  spacing_y_input_ = AddFloatInput(tr("Spacing Y"), 0.0);
+
+  texture_output_ = new NodeOutput();
+  texture_output_->set_data_type(NodeOutput::kTexture);
+  AddParameter(texture_output_);
+}
+
+TransformNode::~TransformNode()
+{
+  // Every context shares objects, so buffers can be freed from any of them
+  qDeleteAll(buffers_);
+  qDeleteAll(software_buffers_);
+}
+
+QString TransformNode::Name()
+{
+  return tr("Transform");
+}
+
+QString TransformNode::id()
+{
+  return "org.olivevideoeditor.Olive.transform";
+}
+
+QString TransformNode::Category()
+{
+  return tr("Distort");
+}
+
+QString TransformNode::Description()
+{
+  return tr("Move, scale and rotate an image, or draw a grid of copies of it.");
+}
+
+NodeInput *TransformNode::texture_input()
+{
+  return texture_input_;
+}
+
+NodeInput *TransformNode::position_x_input()
+{
+  return position_x_input_;
+}
+
+NodeInput *TransformNode::position_y_input()
+{
+  return position_y_input_;
+}
+
+NodeInput *TransformNode::scale_input()
+{
+  return scale_input_;
+}
+
+NodeInput *TransformNode::rotation_input()
+{
+  return rotation_input_;
+}
+
+NodeInput *TransformNode::anchor_x_input()
+{
+  return anchor_x_input_;
+}
+
+NodeInput *TransformNode::anchor_y_input()
+{
+  return anchor_y_input_;
+}
+
+NodeInput *TransformNode::count_input()
+{
+  return count_input_;
+}
+
+NodeInput *TransformNode::columns_input()
+{
+  return columns_input_;
+}
+
+NodeInput *TransformNode::spacing_x_input()
+{
+  return spacing_x_input_;
+}
+
+NodeInput *TransformNode::spacing_y_input()
+{
+  return spacing_y_input_;
+}
+
+NodeOutput *TransformNode::texture_output()
+{
+  return texture_output_;
+}
+
+bool TransformNode::UsesInput(NodeInput *input, int index, const rational &time)
+{
+  Q_UNUSED(index)
+
+  return input != texture_input_ || count_input_->get_value(time).toInt() > 0;
+}
+
+TimeRange TransformNode::InputUseRange(NodeInput *input, int index, const rational &time)
+{
+  Q_UNUSED(index)
+
+  if (input != texture_input_) {
+    return TimeRange::All();
+  }
+
+  return count_input_->PositiveRange(time);
+}
+
+QRect TransformNode::RegionOfInterest(NodeInput *input, const QRect &region, const rational &time)
+{
+  if (input != texture_input_ || region.isEmpty()) {
+    return Node::RegionOfInterest(input, region, time);
+  }
+
+  QVector<QTransform> transforms = GetTransforms(time);
+
+  // A single untransformed copy passes the input straight through
+  if (transforms.size() == 1 && transforms.first().isIdentity()) {
+    return region;
+  }
+
+  QRect needed;
+
+  foreach (const QTransform& t, transforms) {
+    bool invertible;
+    QTransform inverse = t.inverted(&invertible);
+
+    if (!invertible) {
+      continue;
+    }
+
+    QRect mapped = inverse.mapRect(QRectF(region)).toAlignedRect();
+
+    // Sampling between pixels reads their neighbors too, whole pixel moves don't
+    if (t.type() > QTransform::TxTranslate || t.dx() != qRound(t.dx()) || t.dy() != qRound(t.dy())) {
+      mapped.adjust(-1, -1, 1, 1);
+    }
+
+    needed |= mapped;
+  }
+
+  QRect frame = NodeEvaluationContext::CurrentFrame();
+
+  if (!frame.isNull()) {
+    needed &= frame;
+  }
+
+  QRect input_bounds;
+
+  if (texture_input_->DomainOfDefinition(time, &input_bounds)) {
+    needed &= input_bounds;
+  }
+
+  return needed;
+}
+
+bool TransformNode::DomainOfDefinition(NodeOutput *output, const rational &time, QRect *bounds)
+{
+  if (output != texture_output_) {
+    return false;
+  }
+
+  QRect input_bounds;
+
+  // Textures never reach outside the frame, so that bounds an input that could cover any of it
+  if (!texture_input_->DomainOfDefinition(time, &input_bounds)) {
+    input_bounds = NodeEvaluationContext::CurrentFrame();
+
+    if (input_bounds.isNull()) {
+      return false;
+    }
+  }
+
+  QRect united;
+
+  if (!input_bounds.isEmpty()) {
+    foreach (const QTransform& t, GetTransforms(time)) {
+      // Pixels sampled at the edges spill into the next pixel along
+      united |= t.mapRect(QRectF(input_bounds)).toAlignedRect().adjusted(-1, -1, 1, 1);
+    }
+  }
+
+  *bounds = united;
+
+  return true;
+}
+
+void TransformNode::Process(const rational &time)
+{
+  QVector<QTransform> transforms = GetTransforms(time);
+
+  QRect tile = NodeEvaluationContext::CurrentTile();
+  QRect source_region = RegionOfInterest(texture_input_, tile, time);
+
+  // Nothing of the input lands in the tile
+  if (transforms.isEmpty() || (!tile.isNull() && source_region.isEmpty())) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  NodeValue source = texture_input_->get_value(time);
+
+  // A single untransformed copy is just the input
+  if (transforms.size() == 1 && transforms.first().isIdentity()) {
+    texture_output_->set_value(source);
+    return;
+  }
+
+  // The input covers the region pulled and the output covers the tile, so convert from and to frame pixels
+  for (int i=0;i<transforms.size();i++) {
+    transforms[i] = QTransform::fromTranslate(source_region.x(), source_region.y())
+        * transforms.at(i)
+        * QTransform::fromTranslate(-tile.x(), -tile.y());
+  }
+
+  if (NodeEvaluationContext::CurrentIsSoftware()) {
+    ProcessSoftware(source.toBuffer(), transforms, tile.size());
+  } else {
+    ProcessGL(source.toTexture(), transforms, tile.size());
+  }
+}
+
+QVector<QTransform> TransformNode::GetTransforms(const rational &time)
+{
+  int count = count_input_->get_value(time).toInt();
+  int columns = qMax(1, columns_input_->get_value(time).toInt());
+
+  QVector<QTransform> transforms;
+
+  if (count < 1) {
+    return transforms;
+  }
+
+  transforms.reserve(count);
+
+  // Parameters are in full resolution pixels, the input is divided
+  double divider = NodeEvaluationContext::CurrentDivider();
+
+  double position_x = position_x_input_->get_value(time).toDouble() / divider;
+  double position_y = position_y_input_->get_value(time).toDouble() / divider;
+  double scale = scale_input_->get_value(time).toDouble();
+  double rotation = rotation_input_->get_value(time).toDouble();
+  double anchor_x = anchor_x_input_->get_value(time).toDouble() / divider;
+  double anchor_y = anchor_y_input_->get_value(time).toDouble() / divider;
+  double spacing_x = spacing_x_input_->get_value(time).toDouble() / divider;
+  double spacing_y = spacing_y_input_->get_value(time).toDouble() / divider;
+
+  for (int i=0;i<count;i++) {
+    QTransform t;
+
+    t.translate(position_x + (i % columns) * spacing_x, position_y + (i / columns) * spacing_y);
+    t.rotate(rotation);
+    t.scale(scale, scale);
+    t.translate(-anchor_x, -anchor_y);
+
+    transforms.append(t);
+  }
+
+  return transforms;
+}
+
+void TransformNode::ProcessGL(GLuint source, const QVector<QTransform> &transforms, const QSize &size)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (source == 0 || ctx == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  GLint width = 0;
+  GLint height = 0;
+
+  xf->glBindTexture(GL_TEXTURE_2D, source);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+  // Render at the tile's size, or the input's without a tile
+  int output_width = size.isEmpty() ? width : size.width();
+  int output_height = size.isEmpty() ? height : size.height();
+
+  ShaderPtr pipeline = olive::gl::GetInstancedPipeline();
+
+  if (pipeline == nullptr || width == 0 || height == 0) {
+    xf->glBindTexture(GL_TEXTURE_2D, 0);
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  // The blit quad spans -1.0 to 1.0, so convert each pixel transform from the input quad's coordinates and to the
+  // output quad's
+  QMatrix4x4 quad_to_pixels;
+  quad_to_pixels.translate(width * 0.5f, height * 0.5f);
+  quad_to_pixels.scale(width * 0.5f, height * 0.5f);
+
+  QMatrix4x4 output_quad_to_pixels;
+  output_quad_to_pixels.translate(output_width * 0.5f, output_height * 0.5f);
+  output_quad_to_pixels.scale(output_width * 0.5f, output_height * 0.5f);
+
+  QMatrix4x4 pixels_to_quad = output_quad_to_pixels.inverted();
+
+  QVector<QMatrix4x4> matrices;
+  matrices.reserve(transforms.size());
+
+  foreach (const QTransform& t, transforms) {
+    matrices.append(pixels_to_quad * QMatrix4x4(t) * quad_to_pixels);
+  }
+
+  TextureBuffer* buffer = GetBuffer(ctx, output_width, output_height);
+
+  buffer->BindBuffer();
+
+  xf->glViewport(0, 0, output_width, output_height);
+  xf->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  xf->glClear(GL_COLOR_BUFFER_BIT);
+
+  // Overlapping copies composite "over" with associated alpha
+  xf->glEnable(GL_BLEND);
+  xf->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  olive::gl::BlitInstanced(pipeline, matrices);
+
+  xf->glDisable(GL_BLEND);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  buffer->ReleaseBuffer();
+
+  texture_output_->set_value(NodeValue::Texture(buffer->texture()));
+}
+
+void TransformNode::ProcessSoftware(const MemoryBuffer *source, const QVector<QTransform> &transforms,
+                                    const QSize &size)
+{
+  if (source == nullptr) {
+    texture_output_->set_value(NodeValue::Texture(0));
+    return;
+  }
+
+  SoftwareBuffers* buffers;
+
+  {
+    QMutexLocker locker(&buffers_mutex_);
+
+    buffers = software_buffers_.value(NodeEvaluationContext::CurrentId());
+
+    if (buffers == nullptr) {
+      buffers = new SoftwareBuffers();
+      software_buffers_.insert(NodeEvaluationContext::CurrentId(), buffers);
+    }
+  }
+
+  // Render at the tile's size, or the input's without a tile
+  QSize output_size = size.isEmpty() ? QSize(source->width(), source->height()) : size;
+
+  buffers->output.Create(output_size.width(), output_size.height(), olive::PIX_FMT_RGBA32F);
+
+  if (transforms.size() == 1) {
+    // Nothing to blend with, resample straight into the output
+    olive::cpu::TransformResample(*source, &buffers->output, transforms.first());
+  } else {
+    buffers->scratch.Create(output_size.width(), output_size.height(), olive::PIX_FMT_RGBA32F);
+
+    olive::cpu::Fill(&buffers->output, QVector4D());
+
+    foreach (const QTransform& t, transforms) {
+      olive::cpu::TransformResample(*source, &buffers->scratch, t);
+      olive::cpu::Blend(buffers->scratch, &buffers->output, QPoint(0, 0));
+    }
+  }
+
+  texture_output_->set_value(NodeValue::Buffer(&buffers->output));
+}
+
+TextureBuffer *TransformNode::GetBuffer(QOpenGLContext *ctx, int width, int height)
+{
+  QMutexLocker locker(&buffers_mutex_);
+
+  TextureBuffer* buffer = buffers_.value(ctx);
+
+  if (buffer == nullptr) {
+    buffer = new TextureBuffer();
+
+    buffers_.insert(ctx, buffer);
+
+    // Free the buffer with the context (which is current while this signal is emitted)
+    connect(ctx, &QOpenGLContext::aboutToBeDestroyed, this, [this, ctx]() {
+      buffers_mutex_.lock();
+      TextureBuffer* b = buffers_.take(ctx);
+      buffers_mutex_.unlock();
+
+      delete b;
+    }, Qt::DirectConnection);
+  }
+
+  if (!buffer->IsCreated() || buffer->width() != width || buffer->height() != height) {
+    buffer->Create(ctx, olive::color::kWorkingFormat, width, height);
+  }
+
+  return buffer;
+}
+
+NodeInput *TransformNode::AddFloatInput(const QString &name, double value)
+{
+  NodeKeyframe key;
+  key.set_value(NodeValue(value));
+
+  NodeInput* input = new NodeInput();
+  input->add_data_input(NodeParam::kFloat);
+  input->set_name(name);
+  input->insert_keyframe(key);
+  AddParameter(input);
+
+  return input;
+}
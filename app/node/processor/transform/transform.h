@@ -0,0 +1,163 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRANSFORMNODE_H
+#define TRANSFORMNODE_H
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QTransform>
+#include <QVector>
+
+#include "node/node.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+
+/**
+ * @brief A node that moves, scales and rotates its input, optionally drawing a grid of copies of it
+ *
+ * Positions and the anchor are in pixels of the full resolution frame, with the origin at the input's first pixel. The
+ * anchor is the point of the input that's placed at the position and that scaling and rotation happen around, so with
+ * the default position and anchor of (0, 0) the input is unchanged.
+ *
+ * With a count above one, copies of the input are laid out in rows of `columns` copies, each `spacing` pixels from the
+ * last, which suits lower thirds and picture-in-picture grids. Every copy is drawn in the same instanced draw call
+ * (see olive::gl::BlitInstanced()) rather than one pass per copy.
+ *
+ * Only the part of the input that lands in the region being rendered is pulled (see RegionOfInterest()), and the
+ * output is known to be transparent outside the transformed input (see DomainOfDefinition()), so a small
+ * picture-in-picture or an element moved mostly out of frame only renders the pixels that are seen.
+ */
+class TransformNode : public Node
+{
+  Q_OBJECT
+public:
+  TransformNode();
+
+  virtual ~TransformNode() override;
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  NodeInput* texture_input();
+  NodeInput* position_x_input();
+  NodeInput* position_y_input();
+  NodeInput* scale_input();
+  NodeInput* rotation_input();
+  NodeInput* anchor_x_input();
+  NodeInput* anchor_y_input();
+  NodeInput* count_input();
+  NodeInput* columns_input();
+  NodeInput* spacing_x_input();
+  NodeInput* spacing_y_input();
+
+  NodeOutput* texture_output();
+
+  /**
+   * @brief Returns FALSE for the texture input when there are no copies to draw
+   */
+  virtual bool UsesInput(NodeInput* input, int index, const rational& time) override;
+
+  /**
+   * @brief Returns how long the number of copies stays above 0 or at 0
+   */
+  virtual TimeRange InputUseRange(NodeInput* input, int index, const rational& time) override;
+
+  /**
+   * @brief Returns the bounds of `region` mapped back through every copy's transform, within the input's bounds
+   */
+  virtual QRect RegionOfInterest(NodeInput* input, const QRect& region, const rational& time) override;
+
+  /**
+   * @brief Returns the bounds of every copy of the input (or of the frame if the input's bounds aren't known)
+   */
+  virtual bool DomainOfDefinition(NodeOutput* output, const rational& time, QRect* bounds) override;
+
+public slots:
+  virtual void Process(const rational &time) override;
+
+private:
+  /**
+   * @brief Buffers for an evaluation rendering in software
+   */
+  struct SoftwareBuffers {
+    MemoryBuffer output;
+
+    // Each copy is resampled into this before being blended into the output
+    MemoryBuffer scratch;
+  };
+
+  /**
+   * @brief Returns the transform of every copy at a time, mapping pixels of the (divided) frame to frame pixels
+   */
+  QVector<QTransform> GetTransforms(const rational& time);
+
+  /**
+   * @brief Draw the copies with OpenGL into a buffer of `size` (or the source's size if `size` is empty)
+   *
+   * `transforms` map source pixels to output pixels.
+   */
+  void ProcessGL(GLuint source, const QVector<QTransform>& transforms, const QSize& size);
+
+  /**
+   * @brief Draw the copies in software (see NodeEvaluationContext::software())
+   */
+  void ProcessSoftware(const MemoryBuffer* source, const QVector<QTransform>& transforms, const QSize& size);
+
+  /**
+   * @brief Returns this node's buffer for the current context, (re)creating it if necessary
+   */
+  TextureBuffer* GetBuffer(QOpenGLContext* ctx, int width, int height);
+
+  /**
+   * @brief Returns a float input with a default value
+   */
+  NodeInput* AddFloatInput(const QString& name, double value);
+
+  NodeInput* texture_input_;
+
+  NodeInput* position_x_input_;
+  NodeInput* position_y_input_;
+  NodeInput* scale_input_;
+  NodeInput* rotation_input_;
+  NodeInput* anchor_x_input_;
+  NodeInput* anchor_y_input_;
+
+  NodeInput* count_input_;
+  NodeInput* columns_input_;
+  NodeInput* spacing_x_input_;
+  NodeInput* spacing_y_input_;
+
+  NodeOutput* texture_output_;
+
+  // Output buffer for each context this node has rendered in
+  QHash<QOpenGLContext*, TextureBuffer*> buffers_;
+
+  // Output and scratch buffers for each evaluation rendering in software
+  QHash<Qt::HANDLE, SoftwareBuffers*> software_buffers_;
+
+  QMutex buffers_mutex_;
+};
+
+#endif // TRANSFORMNODE_H
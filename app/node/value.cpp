@@ -0,0 +1,316 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "value.h"
+
+#include <cstring>
+
+NodeValue::NodeValue() :
+  type_(NodeParam::kNone)
+{
+  data_.int_ = 0;
+}
+
+NodeValue::NodeValue(int i) :
+  type_(NodeParam::kInt)
+{
+  data_.int_ = i;
+}
+
+NodeValue::NodeValue(double d) :
+  type_(NodeParam::kFloat)
+{
+  data_.double_ = d;
+}
+
+NodeValue::NodeValue(bool b) :
+  type_(NodeParam::kBoolean)
+{
+  data_.bool_ = b;
+}
+
+NodeValue::NodeValue(const QColor &color) :
+  type_(NodeParam::kColor)
+{
+  data_.color_[0] = static_cast<float>(color.redF());
+  data_.color_[1] = static_cast<float>(color.greenF());
+  data_.color_[2] = static_cast<float>(color.blueF());
+  data_.color_[3] = static_cast<float>(color.alphaF());
+}
+
+NodeValue::NodeValue(const QMatrix4x4 &matrix) :
+  type_(NodeParam::kMatrix)
+{
+  memcpy(data_.matrix_, matrix.constData(), sizeof(data_.matrix_));
+}
+
+NodeValue::NodeValue(const QString &string, const NodeParam::DataType &type) :
+  type_(type)
+{
+  Q_ASSERT(IsString());
+
+  new (&data_.string_) QString(string);
+}
+
+NodeValue NodeValue::Texture(GLuint texture)
+{
+  NodeValue v;
+
+  v.type_ = NodeParam::kTexture;
+  v.data_.texture_.id = texture;
+  v.data_.texture_.buffer = nullptr;
+
+  return v;
+}
+
+NodeValue NodeValue::Buffer(const MemoryBuffer *buffer)
+{
+  NodeValue v;
+
+  v.type_ = NodeParam::kTexture;
+  v.data_.texture_.id = 0;
+  v.data_.texture_.buffer = buffer;
+
+  return v;
+}
+
+NodeValue NodeValue::Block(void *block)
+{
+  NodeValue v;
+
+  v.type_ = NodeParam::kBlock;
+  v.data_.block_ = block;
+
+  return v;
+}
+
+NodeValue NodeValue::Samples(const SampleBuffer *samples)
+{
+  NodeValue v;
+
+  v.type_ = NodeParam::kSamples;
+  v.data_.samples_ = samples;
+
+  return v;
+}
+
+NodeValue::NodeValue(const NodeValue &other) :
+  type_(NodeParam::kNone)
+{
+  CopyFrom(other);
+}
+
+NodeValue::NodeValue(NodeValue &&other) :
+  type_(NodeParam::kNone)
+{
+  if (other.IsString()) {
+    type_ = other.type_;
+    new (&data_.string_) QString(std::move(*other.string()));
+  } else {
+    CopyFrom(other);
+  }
+}
+
+NodeValue &NodeValue::operator=(const NodeValue &other)
+{
+  if (&other != this) {
+    if (IsString() && other.IsString()) {
+      // Both hold strings, so just assign rather than destroying and constructing
+      *string() = *other.string();
+      type_ = other.type_;
+    } else {
+      Reset();
+      CopyFrom(other);
+    }
+  }
+
+  return *this;
+}
+
+NodeValue &NodeValue::operator=(NodeValue &&other)
+{
+  if (&other != this) {
+    if (other.IsString()) {
+      if (IsString()) {
+        *string() = std::move(*other.string());
+      } else {
+        new (&data_.string_) QString(std::move(*other.string()));
+      }
+
+      type_ = other.type_;
+    } else {
+      Reset();
+      CopyFrom(other);
+    }
+  }
+
+  return *this;
+}
+
+NodeValue::~NodeValue()
+{
+  Reset();
+}
+
+const NodeParam::DataType &NodeValue::type() const
+{
+  return type_;
+}
+
+bool NodeValue::isNull() const
+{
+  return type_ == NodeParam::kNone;
+}
+
+int NodeValue::toInt() const
+{
+  if (type_ == NodeParam::kInt) {
+    return data_.int_;
+  }
+
+  return 0;
+}
+
+double NodeValue::toDouble() const
+{
+  if (type_ == NodeParam::kFloat) {
+    return data_.double_;
+  }
+
+  // Integers can be up-converted to floats
+  if (type_ == NodeParam::kInt) {
+    return data_.int_;
+  }
+
+  return 0.0;
+}
+
+bool NodeValue::toBool() const
+{
+  if (type_ == NodeParam::kBoolean) {
+    return data_.bool_;
+  }
+
+  return false;
+}
+
+QColor NodeValue::toColor() const
+{
+  if (type_ == NodeParam::kColor) {
+    return QColor::fromRgbF(static_cast<qreal>(data_.color_[0]),
+                            static_cast<qreal>(data_.color_[1]),
+                            static_cast<qreal>(data_.color_[2]),
+                            static_cast<qreal>(data_.color_[3]));
+  }
+
+  return QColor();
+}
+
+QMatrix4x4 NodeValue::toMatrix() const
+{
+  QMatrix4x4 matrix;
+
+  if (type_ == NodeParam::kMatrix) {
+    memcpy(matrix.data(), data_.matrix_, sizeof(data_.matrix_));
+  }
+
+  return matrix;
+}
+
+QString NodeValue::toString() const
+{
+  if (IsString()) {
+    return *string();
+  }
+
+  return QString();
+}
+
+GLuint NodeValue::toTexture() const
+{
+  if (type_ == NodeParam::kTexture) {
+    return data_.texture_.id;
+  }
+
+  return 0;
+}
+
+const MemoryBuffer *NodeValue::toBuffer() const
+{
+  if (type_ == NodeParam::kTexture) {
+    return data_.texture_.buffer;
+  }
+
+  return nullptr;
+}
+
+void *NodeValue::toBlock() const
+{
+  if (type_ == NodeParam::kBlock) {
+    return data_.block_;
+  }
+
+  return nullptr;
+}
+
+const SampleBuffer *NodeValue::toSamples() const
+{
+  if (type_ == NodeParam::kSamples) {
+    return data_.samples_;
+  }
+
+  return nullptr;
+}
+
+bool NodeValue::IsString() const
+{
+  return type_ == NodeParam::kString || type_ == NodeParam::kFont || type_ == NodeParam::kFile;
+}
+
+void NodeValue::CopyFrom(const NodeValue &other)
+{
+  type_ = other.type_;
+
+  if (other.IsString()) {
+    new (&data_.string_) QString(*other.string());
+  } else {
+    // Everything else is plain data
+    memcpy(&data_, &other.data_, sizeof(data_));
+  }
+}
+
+void NodeValue::Reset()
+{
+  if (IsString()) {
+    string()->~QString();
+  }
+
+  type_ = NodeParam::kNone;
+}
+
+QString *NodeValue::string()
+{
+  return reinterpret_cast<QString*>(&data_.string_);
+}
+
+const QString *NodeValue::string() const
+{
+  return reinterpret_cast<const QString*>(&data_.string_);
+}
@@ -0,0 +1,168 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEVALUE_H
+#define NODEVALUE_H
+
+#include <QColor>
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <QString>
+#include <QVarLengthArray>
+#include <functional>
+#include <type_traits>
+
+#include "node/param.h"
+
+class MemoryBuffer;
+class SampleBuffer;
+
+/**
+ * @brief A value passed between Nodes, tagged with its NodeParam::DataType
+ *
+ * Replaces QVariant for node parameters. Every type is stored inline (strings as a QString, which is itself a single
+ * implicitly shared pointer), so creating, copying and reading values never allocates. Reading a value as a different
+ * type than it holds returns a default value, except integers, which can be read as floats (matching
+ * NodeParam::AreDataTypesCompatible()).
+ */
+class NodeValue
+{
+public:
+  /**
+   * @brief Construct a kNone value
+   */
+  NodeValue();
+
+  NodeValue(int i);
+  NodeValue(double d);
+  NodeValue(bool b);
+  NodeValue(const QColor& color);
+  NodeValue(const QMatrix4x4& matrix);
+
+  /**
+   * @brief Construct a string value
+   *
+   * @param type
+   *
+   * kString, kFont or kFile.
+   */
+  NodeValue(const QString& string, const NodeParam::DataType& type = NodeParam::kString);
+
+  /**
+   * @brief Construct a kTexture value (not a constructor since GLuint would be ambiguous with int)
+   */
+  static NodeValue Texture(GLuint texture);
+
+  /**
+   * @brief Construct a kTexture value backed by an RGBA32F MemoryBuffer (rendering without a GPU, see olive::cpu)
+   *
+   * The buffer belongs to the node that created it and must stay valid until the render thread's current frame is
+   * finished.
+   */
+  static NodeValue Buffer(const MemoryBuffer* buffer);
+
+  /**
+   * @brief Construct a kBlock value
+   */
+  static NodeValue Block(void* block);
+
+  /**
+   * @brief Construct a kSamples value
+   *
+   * The buffer belongs to the node that created it and must stay valid until the current evaluation is finished.
+   */
+  static NodeValue Samples(const SampleBuffer* samples);
+
+  NodeValue(const NodeValue& other);
+  NodeValue(NodeValue&& other);
+  NodeValue& operator=(const NodeValue& other);
+  NodeValue& operator=(NodeValue&& other);
+
+  ~NodeValue();
+
+  const NodeParam::DataType& type() const;
+
+  bool isNull() const;
+
+  int toInt() const;
+  double toDouble() const;
+  bool toBool() const;
+  QColor toColor() const;
+  QMatrix4x4 toMatrix() const;
+  QString toString() const;
+  GLuint toTexture() const;
+  const MemoryBuffer* toBuffer() const;
+  void* toBlock() const;
+  const SampleBuffer* toSamples() const;
+
+private:
+  bool IsString() const;
+
+  /**
+   * @brief Copy another value into this one (which must not hold a string)
+   */
+  void CopyFrom(const NodeValue& other);
+
+  void Reset();
+
+  QString* string();
+  const QString* string() const;
+
+  NodeParam::DataType type_;
+
+  union {
+    int int_;
+    double double_;
+    bool bool_;
+
+    // RGBA
+    float color_[4];
+
+    // Column-major, as QMatrix4x4::constData()
+    float matrix_[16];
+
+    // A kTexture holds either an OpenGL texture or a MemoryBuffer, never both
+    struct {
+      GLuint id;
+      const MemoryBuffer* buffer;
+    } texture_;
+
+    void* block_;
+
+    const SampleBuffer* samples_;
+
+    std::aligned_storage<sizeof(QString), alignof(QString)>::type string_;
+  } data_;
+};
+
+/**
+ * @brief Values gathered from an input with several connections, stored inline for the usual few connections
+ */
+using NodeValueList = QVarLengthArray<NodeValue, 4>;
+
+/**
+ * @brief Receives the value of one of several samples requested at once (see NodeOutput::get_samples())
+ *
+ * `index` is the sample's index in the list of times requested. Values like textures are only valid until the
+ * function returns, the next sample may reuse the same buffer.
+ */
+using NodeSampleFunction = std::function<void(int index, const NodeValue& value)>;
+
+#endif // NODEVALUE_H
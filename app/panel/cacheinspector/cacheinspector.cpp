@@ -0,0 +1,352 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "cacheinspector.h"
+
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+#include "decoder/decoderpool.h"
+#include "decoder/ffmpeg/ffmpegpacketcache.h"
+#include "decoder/streamframecache.h"
+#include "decoder/thumbnailservice.h"
+#include "render/allocationcounters.h"
+#include "render/gl/shadercache.h"
+#include "render/memorypool.h"
+#include "render/texturepool.h"
+#include "widget/taskview/taskviewitem.h"
+
+namespace {
+
+enum Column {
+  kNameColumn,
+  kUsedColumn,
+  kBudgetColumn,
+  kEntriesColumn,
+  kHitRateColumn,
+  kColumnCount
+};
+
+// Milliseconds between refreshes while the panel is visible
+const int kRefreshInterval = 1000;
+
+/**
+ * @brief Live allocations of a kind by the subsystem that allocated them
+ */
+CacheStatistics GetAllocationStatistics(AllocationCounters::Kind kind)
+{
+  CacheStatistics s;
+
+  for (int i=0;i<AllocationCounters::kTagCount;i++) {
+    AllocationCounters::Tag tag = static_cast<AllocationCounters::Tag>(i);
+    AllocationCounters::Usage usage = AllocationCounters::Get(kind, tag);
+
+    if (usage.live_count == 0) {
+      continue;
+    }
+
+    s.used_bytes += usage.live_bytes;
+    s.entries += static_cast<int>(usage.live_count);
+    s.AddConsumer(QString::fromLatin1(AllocationCounters::TagName(tag)),
+                  usage.live_bytes,
+                  static_cast<int>(usage.live_count));
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+}
+
+CacheInspectorPanel::CacheInspectorPanel(QWidget *parent) :
+  PanelWidget(parent)
+{
+  // Create main widget and its layout
+  QWidget* central_widget = new QWidget(this);
+  QVBoxLayout* layout = new QVBoxLayout(central_widget);
+  layout->setMargin(0);
+  setWidget(central_widget);
+
+  // Create cache list, with a row for every cache that consumers are listed under
+  view_ = new QTreeWidget(this);
+  view_->setColumnCount(kColumnCount);
+  layout->addWidget(view_);
+  connect(view_, SIGNAL(itemSelectionChanged()), this, SLOT(UpdateButtons()));
+
+  for (int i=0;i<kCacheCount;i++) {
+    items_[i] = new QTreeWidgetItem(view_);
+  }
+
+  // Create buttons
+  QHBoxLayout* button_layout = new QHBoxLayout();
+  layout->addLayout(button_layout);
+
+  button_layout->addStretch();
+
+  purge_btn_ = new QPushButton(this);
+  button_layout->addWidget(purge_btn_);
+  connect(purge_btn_, SIGNAL(clicked(bool)), this, SLOT(PurgeSelected()));
+
+  purge_all_btn_ = new QPushButton(this);
+  button_layout->addWidget(purge_all_btn_);
+  connect(purge_all_btn_, SIGNAL(clicked(bool)), this, SLOT(PurgeAll()));
+
+  refresh_timer_.setInterval(kRefreshInterval);
+  connect(&refresh_timer_, SIGNAL(timeout()), this, SLOT(Refresh()));
+
+  // Set strings
+  Retranslate();
+}
+
+void CacheInspectorPanel::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::LanguageChange) {
+    Retranslate();
+  }
+  QDockWidget::changeEvent(e);
+}
+
+void CacheInspectorPanel::showEvent(QShowEvent *e)
+{
+  QDockWidget::showEvent(e);
+
+  Refresh();
+  refresh_timer_.start();
+}
+
+void CacheInspectorPanel::hideEvent(QHideEvent *e)
+{
+  QDockWidget::hideEvent(e);
+
+  refresh_timer_.stop();
+}
+
+void CacheInspectorPanel::Retranslate()
+{
+  SetTitle(tr("Cache Inspector"));
+
+  view_->setHeaderLabels({tr("Cache"), tr("Used"), tr("Budget"), tr("Entries"), tr("Hit Rate")});
+
+  items_[kImageMemory]->setText(kNameColumn, tr("Image Buffers (RAM)"));
+  items_[kImageTexture]->setText(kNameColumn, tr("Image Buffers (VRAM)"));
+  items_[kDecodedFrames]->setText(kNameColumn, tr("Decoded Frames"));
+  items_[kMemoryPool]->setText(kNameColumn, tr("Buffer Pool (RAM)"));
+  items_[kTexturePool]->setText(kNameColumn, tr("Texture Pool (VRAM)"));
+  items_[kPacketCache]->setText(kNameColumn, tr("Packet Cache"));
+  items_[kStreamFrames]->setText(kNameColumn, tr("Source Frames"));
+  items_[kThumbnails]->setText(kNameColumn, tr("Thumbnails"));
+  items_[kDecoderPool]->setText(kNameColumn, tr("Decoder Pool"));
+  items_[kShaderCache]->setText(kNameColumn, tr("Shader Cache"));
+
+  purge_btn_->setText(tr("Purge"));
+  purge_all_btn_->setText(tr("Purge All"));
+
+  Refresh();
+}
+
+CacheStatistics CacheInspectorPanel::GetStatistics(Cache cache)
+{
+  switch (cache) {
+  case kImageMemory:
+    return GetAllocationStatistics(AllocationCounters::kMemoryBuffer);
+  case kImageTexture:
+    return GetAllocationStatistics(AllocationCounters::kTextureBuffer);
+  case kDecodedFrames:
+    return GetAllocationStatistics(AllocationCounters::kFrame);
+  case kMemoryPool:
+    return olive::memory_pool.statistics();
+  case kTexturePool:
+    return olive::texture_pool.statistics();
+  case kPacketCache:
+    return olive::packet_cache.statistics();
+  case kStreamFrames:
+    return olive::stream_frame_cache.statistics();
+  case kThumbnails:
+    return olive::thumbnail_service.statistics();
+  case kDecoderPool:
+    return olive::decoder_pool.statistics();
+  case kShaderCache:
+    return olive::gl::shader_cache.statistics();
+  case kCacheCount:
+    break;
+  }
+
+  return CacheStatistics();
+}
+
+bool CacheInspectorPanel::CanPurge(Cache cache)
+{
+  switch (cache) {
+  case kImageMemory:
+  case kImageTexture:
+  case kDecodedFrames:
+  case kCacheCount:
+    return false;
+  case kMemoryPool:
+  case kTexturePool:
+  case kPacketCache:
+  case kStreamFrames:
+  case kThumbnails:
+  case kDecoderPool:
+  case kShaderCache:
+    break;
+  }
+
+  return true;
+}
+
+void CacheInspectorPanel::Purge(Cache cache)
+{
+  switch (cache) {
+  case kMemoryPool:
+    olive::memory_pool.Clear();
+    break;
+  case kTexturePool:
+    // Textures of other context groups are deleted once one of their contexts is current
+    olive::texture_pool.Purge();
+    break;
+  case kPacketCache:
+    olive::packet_cache.Clear();
+    break;
+  case kStreamFrames:
+    olive::stream_frame_cache.Clear();
+    break;
+  case kThumbnails:
+    olive::thumbnail_service.ClearCache();
+    break;
+  case kDecoderPool:
+    // Decoders in use are kept
+    olive::decoder_pool.Clear();
+    break;
+  case kShaderCache:
+    olive::gl::shader_cache.ClearBinaries();
+    break;
+  case kImageMemory:
+  case kImageTexture:
+  case kDecodedFrames:
+  case kCacheCount:
+    break;
+  }
+}
+
+CacheInspectorPanel::Cache CacheInspectorPanel::SelectedCache()
+{
+  QList<QTreeWidgetItem*> selected = view_->selectedItems();
+
+  if (selected.isEmpty()) {
+    return kCacheCount;
+  }
+
+  QTreeWidgetItem* item = selected.first();
+
+  if (item->parent() != nullptr) {
+    item = item->parent();
+  }
+
+  int index = view_->indexOfTopLevelItem(item);
+
+  if (index < 0) {
+    return kCacheCount;
+  }
+
+  return static_cast<Cache>(index);
+}
+
+QString CacheInspectorPanel::FormatBytes(qint64 bytes)
+{
+  if (bytes < 0) {
+    return tr("-");
+  }
+
+  return TaskViewItem::FormatBytes(bytes);
+}
+
+QString CacheInspectorPanel::FormatHitRate(const CacheStatistics &s)
+{
+  double rate = s.hit_rate();
+
+  if (rate < 0.0) {
+    return tr("-");
+  }
+
+  return tr("%1% (%2 of %3)").arg(QString::number(rate * 100.0, 'f', 1),
+                                   QString::number(s.hits),
+                                   QString::number(s.hits + s.misses));
+}
+
+void CacheInspectorPanel::Refresh()
+{
+  for (int i=0;i<kCacheCount;i++) {
+    CacheStatistics s = GetStatistics(static_cast<Cache>(i));
+    QTreeWidgetItem* item = items_[i];
+
+    item->setText(kUsedColumn, FormatBytes(s.used_bytes));
+    item->setText(kBudgetColumn, FormatBytes(s.budget));
+    item->setText(kEntriesColumn, QString::number(s.entries));
+    item->setText(kHitRateColumn, FormatHitRate(s));
+
+    // Consumers come and go, so their rows are rebuilt rather than matched up (the cache's row stays expanded)
+    bool consumer_selected = false;
+
+    for (int j=0;j<item->childCount();j++) {
+      consumer_selected |= item->child(j)->isSelected();
+    }
+
+    qDeleteAll(item->takeChildren());
+
+    foreach (const CacheStatistics::Consumer& c, s.consumers) {
+      QTreeWidgetItem* child = new QTreeWidgetItem(item);
+
+      child->setText(kNameColumn, c.name);
+      child->setToolTip(kNameColumn, c.name);
+      child->setText(kUsedColumn, FormatBytes(c.bytes));
+      child->setText(kEntriesColumn, QString::number(c.entries));
+    }
+
+    // Keep the selection on this cache so the purge buttons don't change under the cursor
+    if (consumer_selected) {
+      item->setSelected(true);
+    }
+  }
+
+  UpdateButtons();
+}
+
+void CacheInspectorPanel::UpdateButtons()
+{
+  purge_btn_->setEnabled(CanPurge(SelectedCache()));
+}
+
+void CacheInspectorPanel::PurgeSelected()
+{
+  Purge(SelectedCache());
+
+  Refresh();
+}
+
+void CacheInspectorPanel::PurgeAll()
+{
+  for (int i=0;i<kCacheCount;i++) {
+    Purge(static_cast<Cache>(i));
+  }
+
+  Refresh();
+}
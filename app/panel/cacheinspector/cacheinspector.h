@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CACHEINSPECTOR_PANEL_H
+#define CACHEINSPECTOR_PANEL_H
+
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+
+#include "common/cachestatistics.h"
+#include "widget/panel/panel.h"
+
+/**
+ * @brief A PanelWidget showing how full the application-wide caches are and how well they're doing
+ *
+ * Lists the image buffers allocated in RAM and VRAM (see AllocationCounters), the pools those buffers are recycled
+ * through, the packet cache, the decoded source frame cache, the thumbnail cache, the decoder pool and the shader
+ * cache. Each row shows how much the cache holds against its budget and its hit rate, and can be expanded to show its
+ * biggest consumers. Caches can be purged one at a time, e.g. to check how much a workflow depends on one of them.
+ *
+ * The statistics are refreshed every second while the panel is visible.
+ */
+class CacheInspectorPanel : public PanelWidget
+{
+  Q_OBJECT
+public:
+  CacheInspectorPanel(QWidget* parent);
+
+protected:
+  virtual void changeEvent(QEvent* e) override;
+
+  virtual void showEvent(QShowEvent* e) override;
+
+  virtual void hideEvent(QHideEvent* e) override;
+
+private:
+  enum Cache {
+    kImageMemory,
+    kImageTexture,
+    kDecodedFrames,
+    kMemoryPool,
+    kTexturePool,
+    kPacketCache,
+    kStreamFrames,
+    kThumbnails,
+    kDecoderPool,
+    kShaderCache,
+    kCacheCount
+  };
+
+  void Retranslate();
+
+  static CacheStatistics GetStatistics(Cache cache);
+
+  /**
+   * @brief Returns whether a cache can be purged (buffers that are allocated are in use, so they can't be)
+   */
+  static bool CanPurge(Cache cache);
+
+  static void Purge(Cache cache);
+
+  /**
+   * @brief Returns the cache of the selected row (or of the row a selected consumer belongs to), or kCacheCount
+   */
+  Cache SelectedCache();
+
+  /**
+   * @brief Format a number of bytes for display, or a placeholder if it's unknown (-1)
+   */
+  static QString FormatBytes(qint64 bytes);
+
+  static QString FormatHitRate(const CacheStatistics& s);
+
+  QTreeWidget* view_;
+
+  QTreeWidgetItem* items_[kCacheCount];
+
+  QPushButton* purge_btn_;
+
+  QPushButton* purge_all_btn_;
+
+  QTimer refresh_timer_;
+
+private slots:
+  void Refresh();
+
+  void UpdateButtons();
+
+  void PurgeSelected();
+
+  void PurgeAll();
+};
+
+#endif // CACHEINSPECTOR_PANEL_H
@@ -0,0 +1,353 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderqueue.h"
+
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QVBoxLayout>
+#include <climits>
+
+#include "node/output/viewer/viewer.h"
+#include "panel/panelfocusmanager.h"
+#include "panel/project/project.h"
+
+namespace {
+
+enum Column {
+  kFileColumn,
+  kCodecColumn,
+  kFramesColumn,
+  kStatusColumn,
+  kColumnCount
+};
+
+}
+
+RenderQueuePanel::RenderQueuePanel(QWidget *parent) :
+  PanelWidget(parent)
+{
+  // Create main widget and its layout
+  QWidget* central_widget = new QWidget(this);
+  QVBoxLayout* layout = new QVBoxLayout(central_widget);
+  layout->setMargin(0);
+  setWidget(central_widget);
+
+  // Create settings for the jobs that are added
+  QGridLayout* settings_layout = new QGridLayout();
+  layout->addLayout(settings_layout);
+
+  codec_lbl_ = new QLabel(this);
+  settings_layout->addWidget(codec_lbl_, 0, 0);
+
+  codec_edit_ = new QLineEdit(this);
+  settings_layout->addWidget(codec_edit_, 0, 1);
+
+  hardware_chk_ = new QCheckBox(this);
+  settings_layout->addWidget(hardware_chk_, 0, 2);
+
+  range_lbl_ = new QLabel(this);
+  settings_layout->addWidget(range_lbl_, 1, 0);
+
+  QHBoxLayout* range_layout = new QHBoxLayout();
+  settings_layout->addLayout(range_layout, 1, 1);
+
+  in_spin_ = new QSpinBox(this);
+  in_spin_->setRange(0, INT_MAX);
+  range_layout->addWidget(in_spin_);
+
+  // Sequences don't have a length to default to, so the last frame has to be given
+  out_spin_ = new QSpinBox(this);
+  out_spin_->setRange(0, INT_MAX);
+  range_layout->addWidget(out_spin_);
+
+  concurrency_lbl_ = new QLabel(this);
+  settings_layout->addWidget(concurrency_lbl_, 2, 0);
+
+  concurrency_spin_ = new QSpinBox(this);
+  concurrency_spin_->setRange(1, 16);
+  concurrency_spin_->setValue(queue_.concurrency());
+  settings_layout->addWidget(concurrency_spin_, 2, 1);
+  connect(concurrency_spin_, SIGNAL(valueChanged(int)), this, SLOT(ConcurrencyChanged(int)));
+
+  // Create job list
+  view_ = new QTreeWidget(this);
+  view_->setColumnCount(kColumnCount);
+  view_->setRootIsDecorated(false);
+  view_->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  layout->addWidget(view_);
+  connect(view_, SIGNAL(itemSelectionChanged()), this, SLOT(UpdateButtons()));
+
+  // Create buttons
+  QHBoxLayout* button_layout = new QHBoxLayout();
+  layout->addLayout(button_layout);
+
+  add_btn_ = new QPushButton(this);
+  button_layout->addWidget(add_btn_);
+  connect(add_btn_, SIGNAL(clicked(bool)), this, SLOT(AddSelectedSequences()));
+
+  remove_btn_ = new QPushButton(this);
+  button_layout->addWidget(remove_btn_);
+  connect(remove_btn_, SIGNAL(clicked(bool)), this, SLOT(RemoveSelectedJobs()));
+
+  button_layout->addStretch();
+
+  start_btn_ = new QPushButton(this);
+  button_layout->addWidget(start_btn_);
+  connect(start_btn_, SIGNAL(clicked(bool)), &queue_, SLOT(Start()));
+
+  cancel_btn_ = new QPushButton(this);
+  button_layout->addWidget(cancel_btn_);
+  connect(cancel_btn_, SIGNAL(clicked(bool)), &queue_, SLOT(Cancel()));
+
+  // Connect job list to the queue
+  connect(&queue_, SIGNAL(JobAdded(int)), this, SLOT(JobAdded(int)));
+  connect(&queue_, SIGNAL(JobRemoved(int)), this, SLOT(JobRemoved(int)));
+  connect(&queue_, SIGNAL(JobChanged(int)), this, SLOT(JobChanged(int)));
+  connect(&queue_, SIGNAL(Finished()), this, SLOT(UpdateButtons()));
+
+  // Set strings
+  Retranslate();
+}
+
+RenderQueue *RenderQueuePanel::queue()
+{
+  return &queue_;
+}
+
+bool RenderQueuePanel::AddSequence(Sequence *sequence)
+{
+  if (!sequence->LoadGraph()) {
+    QMessageBox::critical(this,
+                          tr("Failed to Add Sequence"),
+                          tr("Failed to load the graph of sequence \"%1\".").arg(sequence->name()));
+    return false;
+  }
+
+  // Export whatever is connected to the sequence's viewer
+  NodeOutput* output = nullptr;
+
+  foreach (Node* n, sequence->nodes()) {
+    ViewerOutput* viewer = qobject_cast<ViewerOutput*>(n);
+
+    if (viewer != nullptr && !viewer->texture_input()->edges().isEmpty()) {
+      output = viewer->texture_input()->edges().first()->output();
+      break;
+    }
+  }
+
+  const rational& timebase = sequence->video_time_base();
+
+  if (output == nullptr || sequence->video_width() <= 0 || sequence->video_height() <= 0
+      || timebase <= rational(0)) {
+    QMessageBox::critical(this,
+                          tr("Failed to Add Sequence"),
+                          tr("Sequence \"%1\" has nothing to export.").arg(sequence->name()));
+    return false;
+  }
+
+  ExportEngine::Params params;
+  params.output = output;
+  params.width = sequence->video_width();
+  params.height = sequence->video_height();
+  params.timebase = timebase;
+  params.in = in_spin_->value();
+  params.out = out_spin_->value();
+  params.codec = codec_edit_->text().trimmed();
+  params.hardware_encoding = hardware_chk_->isChecked();
+
+  if (params.out < params.in) {
+    QMessageBox::critical(this,
+                          tr("Failed to Add Sequence"),
+                          tr("Sequence \"%1\" has no frames in the range to export.").arg(sequence->name()));
+    return false;
+  }
+
+  params.filename = QFileDialog::getSaveFileName(this,
+                                                 tr("Export \"%1\"").arg(sequence->name()),
+                                                 QString(),
+                                                 tr("Video Files (*.mp4 *.mov *.mkv *.mxf *.avi)"));
+
+  if (params.filename.isEmpty()) {
+    return false;
+  }
+
+  queue_.AddJob(params);
+
+  return true;
+}
+
+void RenderQueuePanel::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::LanguageChange) {
+    Retranslate();
+  }
+  QDockWidget::changeEvent(e);
+}
+
+void RenderQueuePanel::Retranslate()
+{
+  SetTitle(tr("Render Queue"));
+
+  codec_lbl_->setText(tr("Codec:"));
+  codec_edit_->setPlaceholderText(tr("Default for the file type"));
+  hardware_chk_->setText(tr("Hardware Encoding"));
+
+  range_lbl_->setText(tr("Frames:"));
+
+  concurrency_lbl_->setText(tr("Simultaneous Renders:"));
+
+  view_->setHeaderLabels({tr("File"), tr("Codec"), tr("Frames"), tr("Status")});
+
+  add_btn_->setText(tr("Add Selected Sequences..."));
+  remove_btn_->setText(tr("Remove"));
+  start_btn_->setText(tr("Start"));
+  cancel_btn_->setText(tr("Cancel"));
+
+  foreach (int id, items_.keys()) {
+    JobChanged(id);
+  }
+
+  UpdateButtons();
+}
+
+QString RenderQueuePanel::StatusText(const RenderQueue::Job &job)
+{
+  switch (job.status) {
+  case RenderQueue::kQueued:
+    return tr("Queued");
+  case RenderQueue::kRunning:
+    return tr("Rendering (%1%)").arg(job.total > 0 ? job.completed * 100 / job.total : 0);
+  case RenderQueue::kFinished:
+    return tr("Done");
+  case RenderQueue::kFailed:
+    return tr("Failed: %1").arg(job.error);
+  case RenderQueue::kCancelled:
+    return tr("Cancelled");
+  }
+
+  return QString();
+}
+
+void RenderQueuePanel::UpdateButtons()
+{
+  bool has_queued = false;
+
+  foreach (const RenderQueue::Job& job, queue_.jobs()) {
+    if (job.status == RenderQueue::kQueued) {
+      has_queued = true;
+      break;
+    }
+  }
+
+  bool can_remove = false;
+
+  foreach (QTreeWidgetItem* item, view_->selectedItems()) {
+    const RenderQueue::Job* job = queue_.job(item->data(kFileColumn, Qt::UserRole).toInt());
+
+    if (job != nullptr && job->status != RenderQueue::kRunning) {
+      can_remove = true;
+      break;
+    }
+  }
+
+  remove_btn_->setEnabled(can_remove);
+  start_btn_->setEnabled(has_queued && !queue_.IsRunning());
+  cancel_btn_->setEnabled(queue_.IsRunning());
+}
+
+void RenderQueuePanel::AddSelectedSequences()
+{
+  ProjectPanel* project_panel = olive::panel_focus_manager->MostRecentlyFocused<ProjectPanel>();
+
+  if (project_panel == nullptr) {
+    return;
+  }
+
+  bool found = false;
+
+  foreach (Item* item, project_panel->SelectedItems()) {
+    if (item->type() == Item::kSequence) {
+      found = true;
+
+      // Stop asking if one is skipped, to make cancelling easy
+      if (!AddSequence(static_cast<Sequence*>(item))) {
+        break;
+      }
+    }
+  }
+
+  if (!found) {
+    QMessageBox::information(this,
+                             tr("No Sequences Selected"),
+                             tr("Select the sequences to export in the Project panel first."));
+  }
+}
+
+void RenderQueuePanel::RemoveSelectedJobs()
+{
+  foreach (QTreeWidgetItem* item, view_->selectedItems()) {
+    queue_.RemoveJob(item->data(kFileColumn, Qt::UserRole).toInt());
+  }
+}
+
+void RenderQueuePanel::JobAdded(int id)
+{
+  QTreeWidgetItem* item = new QTreeWidgetItem(view_);
+  item->setData(kFileColumn, Qt::UserRole, id);
+
+  items_.insert(id, item);
+
+  JobChanged(id);
+}
+
+void RenderQueuePanel::JobRemoved(int id)
+{
+  delete items_.take(id);
+
+  UpdateButtons();
+}
+
+void RenderQueuePanel::JobChanged(int id)
+{
+  const RenderQueue::Job* job = queue_.job(id);
+  QTreeWidgetItem* item = items_.value(id);
+
+  if (job == nullptr || item == nullptr) {
+    return;
+  }
+
+  item->setText(kFileColumn, QFileInfo(job->params.filename).fileName());
+  item->setToolTip(kFileColumn, job->params.filename);
+  item->setText(kCodecColumn, job->params.codec.isEmpty() ? tr("Default") : job->params.codec);
+  item->setText(kFramesColumn, tr("%1-%2").arg(job->params.in).arg(job->params.out));
+  item->setText(kStatusColumn, StatusText(*job));
+  item->setToolTip(kStatusColumn, job->error);
+
+  UpdateButtons();
+}
+
+void RenderQueuePanel::ConcurrencyChanged(int engines)
+{
+  queue_.SetConcurrency(engines);
+}
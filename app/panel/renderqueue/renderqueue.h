@@ -0,0 +1,108 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERQUEUE_PANEL_H
+#define RENDERQUEUE_PANEL_H
+
+#include <QCheckBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMap>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTreeWidget>
+
+#include "export/renderqueue.h"
+#include "project/item/sequence/sequence.h"
+#include "widget/panel/panel.h"
+
+/**
+ * @brief A PanelWidget showing a RenderQueue, for delivering several exports at once
+ *
+ * Sequences selected in the most recently focused Project panel are added with the codec and range set above the
+ * list. Adding the same sequence again with another filename or codec delivers it in another format, and the queue
+ * renders its frames once for every format (see RenderQueue).
+ */
+class RenderQueuePanel : public PanelWidget
+{
+  Q_OBJECT
+public:
+  RenderQueuePanel(QWidget* parent);
+
+  RenderQueue* queue();
+
+  /**
+   * @brief Ask for a filename and add a job exporting a sequence to it
+   *
+   * @return
+   *
+   * FALSE if the sequence can't be exported (an error is shown) or no filename was chosen.
+   */
+  bool AddSequence(Sequence* sequence);
+
+protected:
+  virtual void changeEvent(QEvent* e) override;
+
+private:
+  void Retranslate();
+
+  static QString StatusText(const RenderQueue::Job& job);
+
+  RenderQueue queue_;
+
+  QTreeWidget* view_;
+
+  // Rows of each job by ID
+  QMap<int, QTreeWidgetItem*> items_;
+
+  QLabel* codec_lbl_;
+  QLineEdit* codec_edit_;
+
+  QCheckBox* hardware_chk_;
+
+  QLabel* range_lbl_;
+  QSpinBox* in_spin_;
+  QSpinBox* out_spin_;
+
+  QLabel* concurrency_lbl_;
+  QSpinBox* concurrency_spin_;
+
+  QPushButton* add_btn_;
+  QPushButton* remove_btn_;
+  QPushButton* start_btn_;
+  QPushButton* cancel_btn_;
+
+private slots:
+  void UpdateButtons();
+
+  void AddSelectedSequences();
+
+  void RemoveSelectedJobs();
+
+  void JobAdded(int id);
+
+  void JobRemoved(int id);
+
+  void JobChanged(int id);
+
+  void ConcurrencyChanged(int engines);
+};
+
+#endif // RENDERQUEUE_PANEL_H
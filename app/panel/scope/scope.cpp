@@ -0,0 +1,71 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scope.h"
+
+#include <QVBoxLayout>
+
+ScopePanel::ScopePanel(QWidget *parent) :
+  PanelWidget(parent)
+{
+  QWidget* central_widget = new QWidget(this);
+  QVBoxLayout* layout = new QVBoxLayout(central_widget);
+  layout->setMargin(0);
+  setWidget(central_widget);
+
+  // Items are added in Retranslate(), in the order of ScopeWidget::Type
+  type_combo_ = new QComboBox(this);
+  layout->addWidget(type_combo_);
+
+  scope_ = new ScopeWidget(this);
+  layout->addWidget(scope_, 1);
+
+  Retranslate();
+
+  connect(type_combo_, SIGNAL(currentIndexChanged(int)), scope_, SLOT(SetType(int)));
+}
+
+void ScopePanel::SetTexture(GLuint texture, GLsync fence)
+{
+  scope_->SetTexture(texture, fence);
+}
+
+void ScopePanel::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::LanguageChange) {
+    Retranslate();
+  }
+  QDockWidget::changeEvent(e);
+}
+
+void ScopePanel::Retranslate()
+{
+  SetTitle(tr("Scopes"));
+
+  int index = type_combo_->currentIndex();
+
+  type_combo_->blockSignals(true);
+  type_combo_->clear();
+  type_combo_->addItem(tr("Waveform"));
+  type_combo_->addItem(tr("Vectorscope"));
+  type_combo_->addItem(tr("Histogram"));
+  type_combo_->setCurrentIndex(qMax(0, index));
+  type_combo_->blockSignals(false);
+}
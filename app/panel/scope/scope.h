@@ -0,0 +1,57 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPE_PANEL_H
+#define SCOPE_PANEL_H
+
+#include <QComboBox>
+
+#include "widget/panel/panel.h"
+#include "widget/scope/scopewidget.h"
+
+/**
+ * @brief Dockable wrapper around a ScopeWidget with a selector for the type of scope
+ *
+ * Connect ViewerPanel::TextureShown() to SetTexture() to analyze what that viewer shows.
+ */
+class ScopePanel : public PanelWidget
+{
+  Q_OBJECT
+public:
+  ScopePanel(QWidget* parent);
+
+public slots:
+  /**
+   * @brief Wrapper function for ScopeWidget::SetTexture()
+   */
+  void SetTexture(GLuint texture, GLsync fence);
+
+protected:
+  virtual void changeEvent(QEvent* e) override;
+
+private:
+  void Retranslate();
+
+  QComboBox* type_combo_;
+
+  ScopeWidget* scope_;
+};
+
+#endif // SCOPE_PANEL_H
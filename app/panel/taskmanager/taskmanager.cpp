@@ -20,19 +20,41 @@
 
 #include "taskmanager.h"
 
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QVBoxLayout>
+
 #include "task/taskmanager.h"
 
 TaskManagerPanel::TaskManagerPanel(QWidget* parent) :
   PanelWidget(parent)
 {
+  // Create main widget and its layout
+  QWidget* central_widget = new QWidget(this);
+  QVBoxLayout* layout = new QVBoxLayout(central_widget);
+  layout->setMargin(0);
+  setWidget(central_widget);
+
   // Create task view
   view_ = new TaskView(this);
+  layout->addWidget(view_);
+
+  // Create statistics summary and export button
+  QHBoxLayout* statistics_layout = new QHBoxLayout();
+  layout->addLayout(statistics_layout);
 
-  // Set it as the main widget
-  setWidget(view_);
+  statistics_lbl_ = new QLabel(this);
+  statistics_lbl_->setWordWrap(true);
+  statistics_layout->addWidget(statistics_lbl_, 1);
+
+  export_btn_ = new QPushButton(this);
+  statistics_layout->addWidget(export_btn_);
+  connect(export_btn_, SIGNAL(clicked(bool)), this, SLOT(ExportStatistics()));
 
   // Connect task view to the task manager
   connect(&olive::task_manager, SIGNAL(TaskAdded(Task*)), view_, SLOT(AddTask(Task*)));
+  connect(&olive::task_manager, SIGNAL(StatisticsChanged()), this, SLOT(UpdateStatistics()));
 
   // Set strings
   Retranslate();
@@ -49,4 +71,41 @@ void TaskManagerPanel::changeEvent(QEvent *e)
 void TaskManagerPanel::Retranslate()
 {
   SetTitle(tr("Task Manager"));
+
+  export_btn_->setText(tr("Export Statistics..."));
+
+  UpdateStatistics();
+}
+
+void TaskManagerPanel::UpdateStatistics()
+{
+  const TaskStatistics& statistics = olive::task_manager.statistics();
+
+  statistics_lbl_->setText(tr("%n task(s) run - queued %1, running %2, CPU %3, read %4",
+                              nullptr,
+                              statistics.count()).arg(
+                             TaskViewItem::FormatDuration(statistics.total(TaskStatistics::kQueueWait)),
+                             TaskViewItem::FormatDuration(statistics.total(TaskStatistics::kWallTime)),
+                             TaskViewItem::FormatDuration(statistics.total(TaskStatistics::kCpuTime)),
+                             TaskViewItem::FormatBytes(statistics.total(TaskStatistics::kBytesRead))));
+
+  export_btn_->setEnabled(statistics.count() > 0);
+}
+
+void TaskManagerPanel::ExportStatistics()
+{
+  QString filename = QFileDialog::getSaveFileName(this,
+                                                  tr("Export Task Statistics"),
+                                                  QString(),
+                                                  tr("CSV Files (*.csv)"));
+
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  if (!olive::task_manager.statistics().ExportCsv(filename)) {
+    QMessageBox::critical(this,
+                          tr("Export Failed"),
+                          tr("Failed to write task statistics to \"%1\".").arg(filename));
+  }
 }
@@ -21,11 +21,17 @@
 #ifndef TASKMANAGER_PANEL_H
 #define TASKMANAGER_PANEL_H
 
+#include <QLabel>
+#include <QPushButton>
+
 #include "widget/taskview/taskview.h"
 #include "widget/panel/panel.h"
 
 /**
  * @brief A PanelWidget wrapper around a TaskView widget
+ *
+ * Also shows a summary of TaskManager::statistics() which can be exported as CSV for finding out whether slow Tasks
+ * are spending their time waiting, reading or decoding.
  */
 class TaskManagerPanel : public PanelWidget
 {
@@ -40,6 +46,15 @@ private:
   void Retranslate();
 
   TaskView* view_;
+
+  QLabel* statistics_lbl_;
+
+  QPushButton* export_btn_;
+
+private slots:
+  void UpdateStatistics();
+
+  void ExportStatistics();
 };
 
 #endif // TASKMANAGER_H
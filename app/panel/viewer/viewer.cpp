@@ -26,6 +26,8 @@ ViewerPanel::ViewerPanel(QWidget *parent) :
   // QObject system handles deleting this
   viewer_ = new ViewerWidget(this);
   connect(viewer_, SIGNAL(TimeChanged(const rational&)), this, SIGNAL(TimeChanged(const rational&)));
+  connect(viewer_, SIGNAL(DividerChanged(int)), this, SIGNAL(DividerChanged(int)));
+  connect(viewer_, SIGNAL(TextureShown(GLuint, GLsync)), this, SIGNAL(TextureShown(GLuint, GLsync)));
 
   // Set ViewerWidget as the central widget
   setWidget(viewer_);
@@ -34,9 +36,29 @@ ViewerPanel::ViewerPanel(QWidget *parent) :
   Retranslate();
 }
 
-void ViewerPanel::SetTexture(GLuint tex)
+void ViewerPanel::SetTexture(GLuint tex, GLsync fence)
 {
-  viewer_->SetTexture(tex);
+  viewer_->SetTexture(tex, fence);
+}
+
+void ViewerPanel::QueueTexture(GLuint tex, GLsync fence, qint64 present_time)
+{
+  viewer_->QueueTexture(tex, fence, present_time);
+}
+
+void ViewerPanel::SetImageSize(int width, int height)
+{
+  viewer_->SetImageSize(width, height);
+}
+
+void ViewerPanel::SetPerformanceHudEnabled(bool enabled)
+{
+  viewer_->SetPerformanceHudEnabled(enabled);
+}
+
+void ViewerPanel::SetOverlayText(const QStringList &lines)
+{
+  viewer_->SetOverlayText(lines);
 }
 
 void ViewerPanel::changeEvent(QEvent *e)
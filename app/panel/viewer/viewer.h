@@ -41,8 +41,32 @@ public slots:
    * Wrapper function for Viewer::SetTexture().
    *
    * @param tex
+   *
+   * @param fence
+   *
+   * Optional fence to wait on before drawing the texture (see ViewerGLWidget::SetTexture()).
+   */
+  void SetTexture(GLuint tex, GLsync fence = nullptr);
+
+  /**
+   * @brief Wrapper function for ViewerWidget::QueueTexture()
+   */
+  void QueueTexture(GLuint tex, GLsync fence, qint64 present_time);
+
+  /**
+   * @brief Wrapper function for ViewerWidget::SetImageSize()
+   */
+  void SetImageSize(int width, int height);
+
+  /**
+   * @brief Wrapper function for ViewerWidget::SetPerformanceHudEnabled()
    */
-  void SetTexture(GLuint tex);
+  void SetPerformanceHudEnabled(bool enabled);
+
+  /**
+   * @brief Wrapper function for ViewerWidget::SetOverlayText()
+   */
+  void SetOverlayText(const QStringList& lines);
 
 protected:
   virtual void changeEvent(QEvent* e) override;
@@ -50,6 +74,16 @@ protected:
 signals:
   void TimeChanged(const rational&);
 
+  /**
+   * @brief Forwarded from ViewerWidget::DividerChanged()
+   */
+  void DividerChanged(int divider);
+
+  /**
+   * @brief Forwarded from ViewerWidget::TextureShown()
+   */
+  void TextureShown(GLuint texture, GLsync fence);
+
 private:
   void Retranslate();
 
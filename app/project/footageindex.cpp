@@ -0,0 +1,172 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footageindex.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+namespace {
+
+// How much of the start and end of a file is read by FootageIndex::Fingerprint()
+const qint64 kFingerprintBlockSize = 4096;
+
+}
+
+FootageIndex::FootageIndex() :
+  watcher_(nullptr)
+{
+}
+
+void FootageIndex::set_watcher(FootageWatcher *watcher)
+{
+  watcher_ = watcher;
+}
+
+void FootageIndex::AddTree(Item *item)
+{
+  if (item->type() == Item::kFootage) {
+    Add(static_cast<Footage*>(item));
+  }
+
+  for (int i=0;i<item->child_count();i++) {
+    AddTree(item->child(i));
+  }
+}
+
+void FootageIndex::RemoveTree(Item *item)
+{
+  if (item->type() == Item::kFootage) {
+    Remove(static_cast<Footage*>(item));
+  }
+
+  for (int i=0;i<item->child_count();i++) {
+    RemoveTree(item->child(i));
+  }
+}
+
+Footage *FootageIndex::FindByPath(const QString &filename)
+{
+  QString path = CanonicalPath(filename);
+
+  QMutexLocker locker(&lock_);
+
+  return by_path_.value(path, nullptr);
+}
+
+QList<Footage *> FootageIndex::FindByFingerprint(const QByteArray &fingerprint)
+{
+  if (fingerprint.isEmpty()) {
+    return QList<Footage*>();
+  }
+
+  QMutexLocker locker(&lock_);
+
+  return by_fingerprint_.values(fingerprint);
+}
+
+QString FootageIndex::CanonicalPath(const QString &filename)
+{
+  QFileInfo info(filename);
+
+  // Missing files have no canonical path
+  QString canonical = info.canonicalFilePath();
+
+  return canonical.isEmpty() ? info.absoluteFilePath() : canonical;
+}
+
+QByteArray FootageIndex::Fingerprint(const QString &filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+
+  qint64 size = file.size();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(QByteArray::number(size));
+  hash.addData(file.read(kFingerprintBlockSize));
+
+  // Small files have already been read completely
+  if (size > kFingerprintBlockSize) {
+    if (!file.seek(qMax(kFingerprintBlockSize, size - kFingerprintBlockSize))) {
+      return QByteArray();
+    }
+
+    hash.addData(file.read(kFingerprintBlockSize));
+  }
+
+  return hash.result();
+}
+
+void FootageIndex::Add(Footage *footage)
+{
+  Keys keys;
+  keys.path = CanonicalPath(footage->filename());
+  keys.fingerprint = footage->fingerprint();
+
+  {
+    QMutexLocker locker(&lock_);
+
+    if (keys_.contains(footage)) {
+      return;
+    }
+
+    keys_.insert(footage, keys);
+
+    by_path_.insert(keys.path, footage);
+
+    if (!keys.fingerprint.isEmpty()) {
+      by_fingerprint_.insert(keys.fingerprint, footage);
+    }
+  }
+
+  if (watcher_ != nullptr) {
+    watcher_->Watch(footage);
+  }
+}
+
+void FootageIndex::Remove(Footage *footage)
+{
+  {
+    QMutexLocker locker(&lock_);
+
+    if (!keys_.contains(footage)) {
+      return;
+    }
+
+    Keys keys = keys_.take(footage);
+
+    by_path_.remove(keys.path, footage);
+
+    if (!keys.fingerprint.isEmpty()) {
+      by_fingerprint_.remove(keys.fingerprint, footage);
+    }
+  }
+
+  if (watcher_ != nullptr) {
+    watcher_->Unwatch(footage);
+  }
+}
@@ -0,0 +1,116 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGEINDEX_H
+#define FOOTAGEINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include "project/footagewatcher.h"
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief A project-wide lookup of Footage by file and by content
+ *
+ * Every Footage in a Project is indexed by the canonical path of its file and, if it has one, by its
+ * Footage::fingerprint(). Checking whether a file has already been imported, or finding Footage with the same content
+ * as a moved file, is then a hash lookup instead of a walk through the whole Item tree.
+ *
+ * The index is kept up to date by ProjectViewModel as Items are added and removed, and by ProjectFile when a project
+ * is opened. Lookups are thread-safe so they can be used from Tasks (e.g. ImportTask).
+ *
+ * Indexed Footage is also passed on to a FootageWatcher if one has been set with set_watcher().
+ */
+class FootageIndex
+{
+public:
+  FootageIndex();
+
+  /**
+   * @brief Set a FootageWatcher to watch every Footage added to this index (not owned by the index)
+   */
+  void set_watcher(FootageWatcher* watcher);
+
+  /**
+   * @brief Index every Footage in an Item and its children
+   */
+  void AddTree(Item* item);
+
+  /**
+   * @brief Remove every Footage in an Item and its children from the index
+   */
+  void RemoveTree(Item* item);
+
+  /**
+   * @brief Return the Footage of a file, or nullptr if it isn't in the project
+   *
+   * If the file was imported more than once, the most recently indexed Footage is returned.
+   */
+  Footage* FindByPath(const QString& filename);
+
+  /**
+   * @brief Return every Footage with this content fingerprint (see Fingerprint())
+   */
+  QList<Footage*> FindByFingerprint(const QByteArray& fingerprint);
+
+  /**
+   * @brief Return the key a file is indexed by (its canonical path, or absolute path if it doesn't exist)
+   */
+  static QString CanonicalPath(const QString& filename);
+
+  /**
+   * @brief Calculate a content fingerprint for a file
+   *
+   * The fingerprint covers the file's size and its first and last 4 KiB (where media containers keep their headers and
+   * indexes), so it's cheap enough to calculate for every imported file. Files with the same fingerprint are treated as
+   * having the same content.
+   *
+   * @return
+   *
+   * The fingerprint or an empty array if the file couldn't be read.
+   */
+  static QByteArray Fingerprint(const QString& filename);
+
+private:
+  void Add(Footage* footage);
+
+  void Remove(Footage* footage);
+
+  struct Keys {
+    QString path;
+    QByteArray fingerprint;
+  };
+
+  // Keys each Footage was indexed under, in case its filename has changed since
+  QHash<Footage*, Keys> keys_;
+
+  QMultiHash<QString, Footage*> by_path_;
+
+  QMultiHash<QByteArray, Footage*> by_fingerprint_;
+
+  QMutex lock_;
+
+  FootageWatcher* watcher_;
+};
+
+#endif // FOOTAGEINDEX_H
@@ -0,0 +1,196 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footagewatcher.h"
+
+#include <QApplication>
+#include <QFileInfo>
+
+#include "decoder/decoderpool.h"
+#include "decoder/streamframecache.h"
+#include "task/analyze/analyze.h"
+#include "task/index/index.h"
+#include "task/probe/probe.h"
+#include "task/taskmanager.h"
+
+FootageWatcher::FootageWatcher()
+{
+  batch_timer_.setSingleShot(true);
+  batch_timer_.setInterval(kBatchInterval);
+
+  connect(&watcher_, SIGNAL(directoryChanged(const QString&)), this, SLOT(PathChanged(const QString&)));
+  connect(&watcher_, SIGNAL(fileChanged(const QString&)), this, SLOT(PathChanged(const QString&)));
+  connect(&batch_timer_, SIGNAL(timeout()), this, SLOT(HandleBatch()));
+}
+
+void FootageWatcher::Watch(Footage *footage)
+{
+  if (sizes_.contains(footage)) {
+    return;
+  }
+
+  QFileInfo info(footage->filename());
+
+  QString directory = info.absolutePath();
+
+  QList<Footage*>& list = directories_[directory];
+
+  if (list.isEmpty()) {
+    watcher_.addPath(directory);
+  }
+
+  list.append(footage);
+
+  // Files that are replaced (written elsewhere and renamed over) are noticed through their directory, files that are
+  // rewritten in place through their own watch
+  if (info.exists()) {
+    watcher_.addPath(info.absoluteFilePath());
+  }
+
+  sizes_.insert(footage, info.size());
+}
+
+void FootageWatcher::Unwatch(Footage *footage)
+{
+  if (!sizes_.contains(footage)) {
+    return;
+  }
+
+  sizes_.remove(footage);
+
+  QFileInfo info(footage->filename());
+
+  QString directory = info.absolutePath();
+
+  QList<Footage*>& list = directories_[directory];
+
+  list.removeOne(footage);
+
+  bool file_still_used = false;
+
+  foreach (Footage* f, list) {
+    if (f->filename() == footage->filename()) {
+      file_still_used = true;
+      break;
+    }
+  }
+
+  if (!file_still_used) {
+    watcher_.removePath(info.absoluteFilePath());
+  }
+
+  if (list.isEmpty()) {
+    watcher_.removePath(directory);
+    directories_.remove(directory);
+    pending_.remove(directory);
+  }
+}
+
+void FootageWatcher::Invalidate(const QList<Footage *> &footage)
+{
+  QList<FootagePtr> probe_footage;
+
+  foreach (Footage* f, footage) {
+    // Decoders still using the old file are freed once they're released
+    for (int i=0;i<f->stream_count();i++) {
+      olive::decoder_pool.Clear(f->stream(i));
+      olive::stream_frame_cache.Clear(f->stream(i));
+    }
+
+    QFileInfo info(f->filename());
+
+    f->set_timestamp(info.lastModified());
+    sizes_.insert(f, info.size());
+
+    // ProbeTask needs to share ownership of the Footage
+    probe_footage.append(std::static_pointer_cast<Footage>(f->parent()->shared_ptr_from_raw(f)));
+  }
+
+  TaskPtr pt = std::make_shared<ProbeTask>(probe_footage);
+  olive::task_manager.AddTask(pt);
+
+  foreach (FootagePtr f, probe_footage) {
+    TaskPtr at = std::make_shared<AnalyzeTask>(f);
+    at->AddDependency(pt.get());
+    olive::task_manager.AddTask(at);
+
+    // The old index was for the old file
+    TaskPtr it = std::make_shared<IndexTask>(f);
+    it->AddDependency(pt.get());
+    olive::task_manager.AddTask(it);
+  }
+}
+
+void FootageWatcher::PathChanged(const QString &path)
+{
+  // Files are handled with the rest of their directory
+  QString directory = directories_.contains(path) ? path : QFileInfo(path).absolutePath();
+
+  if (!directories_.contains(directory)) {
+    return;
+  }
+
+  pending_.insert(directory);
+
+  // Don't restart the timer so constantly changing directories are still handled regularly
+  if (!batch_timer_.isActive()) {
+    batch_timer_.start();
+  }
+}
+
+void FootageWatcher::HandleBatch()
+{
+  QList<Footage*> changed;
+
+  QSet<QString> watched_files;
+
+  foreach (const QString& file, watcher_.files()) {
+    watched_files.insert(file);
+  }
+
+  foreach (const QString& directory, pending_) {
+    foreach (Footage* f, directories_.value(directory)) {
+      QFileInfo info(f->filename());
+
+      // Missing files can't be probed, they'll be noticed again if they come back
+      if (!info.exists()) {
+        continue;
+      }
+
+      // Watches are dropped when files are replaced, so add them again
+      if (!watched_files.contains(info.absoluteFilePath())) {
+        watcher_.addPath(info.absoluteFilePath());
+        watched_files.insert(info.absoluteFilePath());
+      }
+
+      if (info.lastModified() != f->timestamp() || info.size() != sizes_.value(f)) {
+        changed.append(f);
+      }
+    }
+  }
+
+  pending_.clear();
+
+  if (!changed.isEmpty()) {
+    Invalidate(changed);
+
+    emit FootageChanged(changed);
+  }
+}
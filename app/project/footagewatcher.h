@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGEWATCHER_H
+#define FOOTAGEWATCHER_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief Notices when the files of a Project's Footage change on disk
+ *
+ * Footage files and their directories are watched with QFileSystemWatcher, which uses the OS's own notifications
+ * (inotify, FSEvents or ReadDirectoryChangesW) instead of polling. Notifications are collected for kBatchInterval and
+ * then handled together, so a render writing thousands of frames into a directory is only rescanned a few times.
+ *
+ * When a file's modification time or size no longer matches, its Footage gets the new timestamp and is probed again.
+ * Every cache of Footage data (probe metadata, frame indexes, waveforms and thumbnails) is keyed by the timestamp and
+ * size, so this is enough for them to stop using their stale entries. The Footage's idle pooled Decoders and cached
+ * decoded frames are freed.
+ *
+ * Footage is added and removed by FootageIndex. Must only be used from the main thread.
+ */
+class FootageWatcher : public QObject
+{
+  Q_OBJECT
+public:
+  FootageWatcher();
+
+  /**
+   * @brief Start watching a Footage's file
+   */
+  void Watch(Footage* footage);
+
+  /**
+   * @brief Stop watching a Footage's file
+   */
+  void Unwatch(Footage* footage);
+
+signals:
+  /**
+   * @brief Emitted after a batch of Footage has been found to have changed and has been queued to be probed again
+   */
+  void FootageChanged(const QList<Footage*>& footage);
+
+private:
+  /**
+   * @brief How long notifications are collected before they're handled (milliseconds)
+   */
+  static const int kBatchInterval = 500;
+
+  /**
+   * @brief Re-probe Footage whose file has changed
+   */
+  void Invalidate(const QList<Footage*>& footage);
+
+  QFileSystemWatcher watcher_;
+
+  QTimer batch_timer_;
+
+  // Footage in each watched directory
+  QHash<QString, QList<Footage*> > directories_;
+
+  // File size each Footage was last seen with (Footage only stores the timestamp)
+  QHash<Footage*, qint64> sizes_;
+
+  // Directories with notifications that haven't been handled yet
+  QSet<QString> pending_;
+
+private slots:
+  void PathChanged(const QString& path);
+
+  void HandleBatch();
+};
+
+#endif // FOOTAGEWATCHER_H
@@ -21,6 +21,7 @@
 #include "footage.h"
 
 #include <QCoreApplication>
+#include <cmath>
 
 #include "ui/icons/icons.h"
 
@@ -43,6 +44,8 @@ void Footage::set_status(const Footage::Status &status)
 {
   status_ = status;
 
+  UpdateMetadata();
+
   UpdateIcon();
 
   UpdateTooltip();
@@ -77,6 +80,26 @@ void Footage::set_timestamp(const QDateTime &t)
   timestamp_ = t;
 }
 
+const QByteArray &Footage::fingerprint()
+{
+  return fingerprint_;
+}
+
+void Footage::set_fingerprint(const QByteArray &fingerprint)
+{
+  fingerprint_ = fingerprint;
+}
+
+const ImageSequence &Footage::image_sequence()
+{
+  return image_sequence_;
+}
+
+void Footage::set_image_sequence(const ImageSequence &sequence)
+{
+  image_sequence_ = sequence;
+}
+
 void Footage::add_stream(Stream *s)
 {
   // Add a copy of this stream to the list
@@ -86,7 +109,7 @@ void Footage::add_stream(Stream *s)
   streams_.last()->set_footage(this);
 }
 
-const Stream *Footage::stream(int index)
+Stream *Footage::stream(int index)
 {
   return streams_.at(index);
 }
@@ -132,11 +155,12 @@ void Footage::UpdateIcon()
 {
   switch (status_) {
   case kUnprobed:
-  case kUnindexed:
     // FIXME Set a waiting icon
     set_icon(QIcon());
     break;
+  case kUnindexed:
   case kReady:
+    // Footage is usable as soon as the fast probe is done, the deep probe only refines its metadata
     if (HasStreamsOfType(Stream::kVideo)) {
 
       // Prioritize the video icon
@@ -158,11 +182,32 @@ void Footage::UpdateIcon()
     }
     break;
   case kInvalid:
+  case kOffline:
     set_icon(olive::icon::Error);
     break;
   }
 }
 
+const rational &Footage::length()
+{
+  return length_;
+}
+
+const QString &Footage::length_text()
+{
+  return length_text_;
+}
+
+const rational &Footage::rate()
+{
+  return rate_;
+}
+
+const QString &Footage::rate_text()
+{
+  return rate_text_;
+}
+
 void Footage::UpdateTooltip()
 {
   switch (status_) {
@@ -170,12 +215,14 @@ void Footage::UpdateTooltip()
     set_tooltip(QCoreApplication::translate("Footage", "Waiting for probe"));
     break;
   case kUnindexed:
-    set_tooltip(QCoreApplication::translate("Footage", "Waiting for index"));
-    break;
   case kReady:
   {
     QString tip = QCoreApplication::translate("Footage", "Filename: %1").arg(filename());
 
+    if (status_ == kUnindexed) {
+      tip.append(QCoreApplication::translate("Footage", "\nAnalyzing..."));
+    }
+
     if (!streams_.isEmpty()) {
       tip.append("\n");
 
@@ -211,5 +258,87 @@ void Footage::UpdateTooltip()
   case kInvalid:
     set_tooltip(QCoreApplication::translate("Footage", "An error occurred probing this footage"));
     break;
+  case kOffline:
+    set_tooltip(QCoreApplication::translate("Footage", "File is missing: %1").arg(filename()));
+    break;
+  }
+}
+
+void Footage::UpdateMetadata()
+{
+  length_ = 0;
+  length_text_.clear();
+  rate_ = 0;
+  rate_text_.clear();
+
+  if (status_ != kUnindexed && status_ != kReady) {
+    return;
+  }
+
+  VideoStream* first_video = nullptr;
+  AudioStream* first_audio = nullptr;
+
+  foreach (Stream* s, streams_) {
+    rational timebase = s->timebase();
+
+    // Durations are unknown if they aren't positive (e.g. AV_NOPTS_VALUE)
+    if (s->duration() > 0 && timebase.denominator() != 0) {
+      rational stream_length = rational(s->duration()) * timebase;
+
+      if (stream_length > length_) {
+        length_ = stream_length;
+      }
+    }
+
+    if (s->type() == Stream::kVideo && first_video == nullptr) {
+      first_video = static_cast<VideoStream*>(s);
+    } else if (s->type() == Stream::kAudio && first_audio == nullptr) {
+      first_audio = static_cast<AudioStream*>(s);
+    }
+  }
+
+  double fps = 0.0;
+
+  if (first_video != nullptr && first_video->frame_rate() > 0) {
+    rate_ = first_video->frame_rate();
+    fps = rate_.ToDouble();
+
+    // Show up to 3 decimal places without trailing zeros (e.g. "29.97", "25")
+    QString fps_text = QString::number(fps, 'f', 3);
+
+    while (fps_text.endsWith('0')) {
+      fps_text.chop(1);
+    }
+
+    if (fps_text.endsWith('.')) {
+      fps_text.chop(1);
+    }
+
+    rate_text_ = QCoreApplication::translate("Footage", "%1 FPS").arg(fps_text);
+  } else if (first_audio != nullptr && first_audio->sample_rate() > 0) {
+    rate_ = first_audio->sample_rate();
+    rate_text_ = QCoreApplication::translate("Footage", "%1 Hz").arg(first_audio->sample_rate());
+  }
+
+  if (length_ > 0) {
+    double seconds = length_.ToDouble();
+
+    qint64 whole_seconds = static_cast<qint64>(std::floor(seconds));
+    double fraction = seconds - static_cast<double>(whole_seconds);
+
+    QString hms = QStringLiteral("%1:%2:%3").arg(whole_seconds / 3600, 2, 10, QChar('0'))
+        .arg((whole_seconds / 60) % 60, 2, 10, QChar('0'))
+        .arg(whole_seconds % 60, 2, 10, QChar('0'));
+
+    if (fps > 0.0) {
+      // Frames into the last second
+      int frames = static_cast<int>(std::floor(fraction * fps));
+
+      length_text_ = QStringLiteral("%1:%2").arg(hms).arg(frames, 2, 10, QChar('0'));
+    } else {
+      int milliseconds = static_cast<int>(std::floor(fraction * 1000.0));
+
+      length_text_ = QStringLiteral("%1.%2").arg(hms).arg(milliseconds, 3, 10, QChar('0'));
+    }
   }
 }
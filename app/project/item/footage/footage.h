@@ -21,9 +21,11 @@
 #ifndef FOOTAGE_H
 #define FOOTAGE_H
 
+#include <QByteArray>
 #include <QList>
 #include <QDateTime>
 
+#include "common/imagesequence.h"
 #include "common/rational.h"
 #include "project/item/item.h"
 #include "project/item/footage/audiostream.h"
@@ -40,10 +42,20 @@ class Footage : public Item
 {
 public:
   enum Status {
+    /// Not probed yet
     kUnprobed,
+
+    /// A fast probe has filled in the streams, but their metadata may be incomplete until olive::DeepProbeMedia()
     kUnindexed,
+
+    /// Streams have been fully analyzed
     kReady,
-    kInvalid
+
+    /// No Decoder can use this file
+    kInvalid,
+
+    /// The file is missing, the Footage keeps the metadata it had in case it comes back
+    kOffline
   };
 
   /**
@@ -90,7 +102,7 @@ public:
   /**
    * @brief Set ready state
    *
-   * This should only be set by olive::ProbeMedia. Sets the Footage's current status to a member of enum
+   * This should only be set by olive::ProbeMedia and olive::DeepProbeMedia. Sets the Footage's current status to a member of enum
    * Footage::Status.
    *
    * This function also runs UpdateIcon() and UpdateTooltip(). If you need to override the tooltip (e.g. for an error
@@ -146,6 +158,30 @@ public:
    */
   void set_timestamp(const QDateTime& t);
 
+  /**
+   * @brief Retrieve the content fingerprint of the file (see FootageIndex::Fingerprint())
+   *
+   * Empty if it hasn't been calculated.
+   */
+  const QByteArray& fingerprint();
+
+  /**
+   * @brief Set the content fingerprint, usually on import
+   */
+  void set_fingerprint(const QByteArray& fingerprint);
+
+  /**
+   * @brief The image sequence this Footage consists of, invalid if it's a single file
+   *
+   * For sequences, filename() is the first frame's file. Like the filename, this is kept by Clear().
+   */
+  const ImageSequence& image_sequence();
+
+  /**
+   * @brief Set the image sequence, usually on import (this doesn't re-probe the Footage either)
+   */
+  void set_image_sequence(const ImageSequence& sequence);
+
   /**
    * @brief Add a stream metadata object to this footage
    *
@@ -171,13 +207,38 @@ public:
    *
    * The stream at the index provided
    */
-  const Stream* stream(int index);
+  Stream* stream(int index);
 
   /**
    * @brief Retrieve total number of streams in this Footage file
    */
   int stream_count();
 
+  /**
+   * @brief Length of the longest stream in seconds, or 0 if it isn't known
+   *
+   * This, frame_rate() and their texts are calculated whenever the status is set (i.e. once probing finishes), so they
+   * can be shown and sorted by without looking through the streams every time.
+   */
+  const rational& length();
+
+  /**
+   * @brief length() formatted as a timecode (or empty if it isn't known)
+   */
+  const QString& length_text();
+
+  /**
+   * @brief Frame rate of the first video stream, or the sample rate of the first audio stream if there is no video
+   *
+   * 0 if neither is known.
+   */
+  const rational& rate();
+
+  /**
+   * @brief rate() formatted for display (or empty if it isn't known)
+   */
+  const QString& rate_text();
+
   /**
    * @brief Item::Type() override
    *
@@ -216,6 +277,11 @@ private:
    */
   void UpdateTooltip();
 
+  /**
+   * @brief Update length() and rate() (and their texts) from the streams
+   */
+  void UpdateMetadata();
+
   /**
    * @brief Internal filename string
    */
@@ -226,6 +292,16 @@ private:
    */
   QDateTime timestamp_;
 
+  /**
+   * @brief Internal fingerprint
+   */
+  QByteArray fingerprint_;
+
+  /**
+   * @brief Internal image sequence
+   */
+  ImageSequence image_sequence_;
+
   /**
    * @brief Internal streams array
    */
@@ -236,6 +312,12 @@ private:
    */
   Status status_;
 
+  rational length_;
+  QString length_text_;
+
+  rational rate_;
+  QString rate_text_;
+
 };
 
 using FootagePtr = std::shared_ptr<Footage>;
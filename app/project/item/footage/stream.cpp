@@ -27,6 +27,30 @@ Stream::Stream() :
 
 }
 
+Stream::CodecParameters::CodecParameters() :
+  codec_id(AV_CODEC_ID_NONE),
+  codec_tag(0),
+  format(-1),
+  bit_rate(0),
+  bits_per_coded_sample(0),
+  bits_per_raw_sample(0),
+  profile(FF_PROFILE_UNKNOWN),
+  level(FF_LEVEL_UNKNOWN),
+  sample_aspect_ratio(av_make_q(0, 1)),
+  field_order(AV_FIELD_UNKNOWN),
+  color_range(AVCOL_RANGE_UNSPECIFIED),
+  color_primaries(AVCOL_PRI_UNSPECIFIED),
+  color_trc(AVCOL_TRC_UNSPECIFIED),
+  color_space(AVCOL_SPC_UNSPECIFIED),
+  chroma_location(AVCHROMA_LOC_UNSPECIFIED),
+  video_delay(0),
+  block_align(0),
+  frame_size(0),
+  initial_padding(0),
+  seek_preroll(0)
+{
+}
+
 Stream::~Stream()
 {
 }
@@ -80,3 +104,13 @@ void Stream::set_duration(const int64_t &duration)
 {
   duration_ = duration;
 }
+
+const Stream::CodecParameters &Stream::codec_parameters()
+{
+  return codec_parameters_;
+}
+
+void Stream::set_codec_parameters(const Stream::CodecParameters &parameters)
+{
+  codec_parameters_ = parameters;
+}
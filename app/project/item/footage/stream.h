@@ -21,6 +21,12 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <QByteArray>
+
 #include "common/rational.h"
 
 class Footage;
@@ -51,6 +57,47 @@ public:
    */
   Stream();
 
+  /**
+   * @brief What a decoder needs to be set up for a stream without analyzing the file again
+   *
+   * Filled in from the AVCodecParameters the stream was probed with (the dimensions, channels and sample rate are kept
+   * on VideoStream and AudioStream). Fields that only apply to one type of stream are left at their defaults for the
+   * others.
+   */
+  struct CodecParameters {
+    CodecParameters();
+
+    // AV_CODEC_ID_NONE if the stream hasn't been probed
+    AVCodecID codec_id;
+    uint32_t codec_tag;
+    QByteArray extradata;
+
+    // AVPixelFormat or AVSampleFormat, -1 if unknown
+    int format;
+
+    int64_t bit_rate;
+    int bits_per_coded_sample;
+    int bits_per_raw_sample;
+    int profile;
+    int level;
+
+    // Video
+    AVRational sample_aspect_ratio;
+    AVFieldOrder field_order;
+    AVColorRange color_range;
+    AVColorPrimaries color_primaries;
+    AVColorTransferCharacteristic color_trc;
+    AVColorSpace color_space;
+    AVChromaLocation chroma_location;
+    int video_delay;
+
+    // Audio
+    int block_align;
+    int frame_size;
+    int initial_padding;
+    int seek_preroll;
+  };
+
   /**
    * @brief Required virtual destructor, serves no purpose
    */
@@ -71,6 +118,9 @@ public:
   const int64_t& duration();
   void set_duration(const int64_t& duration);
 
+  const CodecParameters& codec_parameters();
+  void set_codec_parameters(const CodecParameters& parameters);
+
 private:
   Footage* footage_;
 
@@ -78,6 +128,8 @@ private:
 
   int64_t duration_;
 
+  CodecParameters codec_parameters_;
+
   int index_;
 
   Type type_;
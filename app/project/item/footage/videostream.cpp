@@ -20,7 +20,9 @@
 
 #include "videostream.h"
 
-VideoStream::VideoStream()
+VideoStream::VideoStream() :
+  proxy_width_(0),
+  proxy_height_(0)
 {
   set_type(kVideo);
 }
@@ -44,3 +46,48 @@ void VideoStream::set_height(const int &height)
 {
   height_ = height;
 }
+
+const rational &VideoStream::frame_rate()
+{
+  return frame_rate_;
+}
+
+void VideoStream::set_frame_rate(const rational &frame_rate)
+{
+  frame_rate_ = frame_rate;
+}
+
+const QString &VideoStream::proxy_filename()
+{
+  return proxy_filename_;
+}
+
+void VideoStream::set_proxy_filename(const QString &filename)
+{
+  proxy_filename_ = filename;
+}
+
+const int &VideoStream::proxy_width()
+{
+  return proxy_width_;
+}
+
+const int &VideoStream::proxy_height()
+{
+  return proxy_height_;
+}
+
+void VideoStream::set_proxy_resolution(const int &width, const int &height)
+{
+  proxy_width_ = width;
+  proxy_height_ = height;
+}
+
+bool VideoStream::CanUseProxy(const int &width, const int &height)
+{
+  if (proxy_filename_.isEmpty() || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  return (proxy_width_ >= width && proxy_height_ >= height);
+}
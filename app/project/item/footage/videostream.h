@@ -21,6 +21,8 @@
 #ifndef VIDEOSTREAM_H
 #define VIDEOSTREAM_H
 
+#include <QString>
+
 #include "common/rational.h"
 #include "stream.h"
 
@@ -38,9 +40,53 @@ public:
   const int& height();
   void set_height(const int& height);
 
+  /**
+   * @brief Average frame rate of this stream (0 if unknown)
+   */
+  const rational& frame_rate();
+  void set_frame_rate(const rational& frame_rate);
+
+  /**
+   * @brief Filename of a lower resolution proxy of this stream (empty if there is none)
+   *
+   * Proxies are generated by ProxyTask. The proxy file contains this stream's video as its first stream.
+   */
+  const QString& proxy_filename();
+  void set_proxy_filename(const QString& filename);
+
+  /**
+   * @brief Resolution of the proxy file (only valid if proxy_filename() is not empty)
+   */
+  const int& proxy_width();
+  const int& proxy_height();
+  void set_proxy_resolution(const int& width, const int& height);
+
+  /**
+   * @brief Determine whether the proxy has enough resolution to be shown at a certain size
+   *
+   * @param width
+   *
+   * Width the frames will be displayed at. 0 means the full resolution is needed, so the proxy will never be used.
+   *
+   * @param height
+   *
+   * Height the frames will be displayed at.
+   *
+   * @return
+   *
+   * TRUE if a proxy exists and is at least as large as the requested resolution.
+   */
+  bool CanUseProxy(const int& width, const int& height);
+
 private:
   int width_;
   int height_;
+
+  rational frame_rate_;
+
+  QString proxy_filename_;
+  int proxy_width_;
+  int proxy_height_;
 };
 
 #endif // VIDEOSTREAM_H
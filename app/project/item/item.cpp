@@ -20,13 +20,19 @@
 
 #include "item.h"
 
+#include "itemupdatequeue.h"
+
 Item::Item() :
-  parent_(nullptr)
+  parent_(nullptr),
+  row_(-1),
+  child_rows_dirty_(false),
+  mutex_("Item")
 {
 }
 
 Item::~Item()
 {
+  olive::item_updates.Dequeue(this);
 }
 
 void Item::add_child(ItemPtr c)
@@ -41,6 +47,7 @@ void Item::add_child(ItemPtr c)
 
   children_.append(c);
   c->parent_ = this;
+  c->row_ = children_.size() - 1;
 }
 
 void Item::remove_child(Item *c)
@@ -49,15 +56,30 @@ void Item::remove_child(Item *c)
     return;
   }
 
-  // Remove all instances of this child in the list
-  for (int i=0;i<children_.size();i++) {
-    if (children_.at(i).get() == c) {
-      children_.removeAt(i);
-      i--;
-    }
-  }
+  children_.removeAt(c->row());
 
   c->parent_ = nullptr;
+  c->row_ = -1;
+
+  // Children after this one have moved up a row
+  child_rows_dirty_ = true;
+}
+
+void Item::remove_children(int index, int count)
+{
+  for (int i=0;i<count;i++) {
+    Item* c = children_.at(index + i).get();
+
+    c->parent_ = nullptr;
+    c->row_ = -1;
+  }
+
+  children_.erase(children_.begin() + index, children_.begin() + index + count);
+
+  // Nothing needs renumbering if these were the last children
+  if (index < children_.size()) {
+    child_rows_dirty_ = true;
+  }
 }
 
 int Item::child_count()
@@ -70,15 +92,30 @@ Item *Item::child(int i)
   return children_.at(i).get();
 }
 
-ItemPtr Item::shared_ptr_from_raw(Item *item)
+int Item::row()
 {
-  for (int i=0;i<children_.size();i++) {
-    if (children_.at(i).get() == item) {
-      return children_.at(i);
+  if (parent_ == nullptr) {
+    return -1;
+  }
+
+  if (parent_->child_rows_dirty_) {
+    for (int i=0;i<parent_->children_.size();i++) {
+      parent_->children_.at(i)->row_ = i;
     }
+
+    parent_->child_rows_dirty_ = false;
+  }
+
+  return row_;
+}
+
+ItemPtr Item::shared_ptr_from_raw(Item *item)
+{
+  if (item->parent_ != this) {
+    return nullptr;
   }
 
-  return nullptr;
+  return children_.at(item->row());
 }
 
 const QString &Item::name() const
@@ -99,6 +136,8 @@ const QString &Item::tooltip() const
 void Item::set_tooltip(const QString &t)
 {
   tooltip_ = t;
+
+  olive::item_updates.Queue(this);
 }
 
 const QIcon &Item::icon()
@@ -109,6 +148,8 @@ const QIcon &Item::icon()
 void Item::set_icon(const QIcon &icon)
 {
   icon_ = icon;
+
+  olive::item_updates.Queue(this);
 }
 
 Item *Item::parent() const
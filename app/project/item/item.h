@@ -27,6 +27,8 @@
 #include <QMutex>
 #include <QString>
 
+#include "common/profiledmutex.h"
+
 class Item;
 using ItemPtr = std::shared_ptr<Item>;
 
@@ -79,18 +81,39 @@ public:
 
   void add_child(ItemPtr c);
   void remove_child(Item* c);
+
+  /**
+   * @brief Remove count children starting at index without searching for them
+   */
+  void remove_children(int index, int count);
   int child_count();
   Item* child(int i);
 
+  /**
+   * @brief Index of this Item in its parent's children or -1 if it has no parent
+   *
+   * Rows are cached, so this is constant time except for the first call after children were removed from the parent,
+   * which renumbers its children once.
+   */
+  int row();
+
   ItemPtr shared_ptr_from_raw(Item* item);
 
   const QString& name() const;
   void set_name(const QString& n);
 
   const QString& tooltip() const;
+
+  /**
+   * @brief Set the tooltip, views are updated through olive::item_updates
+   */
   void set_tooltip(const QString& t);
 
   const QIcon& icon();
+
+  /**
+   * @brief Set the icon, views are updated through olive::item_updates
+   */
   void set_icon(const QIcon& icon);
 
   Item *parent() const;
@@ -105,13 +128,19 @@ private:
 
   Item* parent_;
 
+  // Index in parent_->children_, only valid while parent_->child_rows_dirty_ is FALSE
+  int row_;
+
+  // Set when removing children has shifted the rows of the ones after them
+  bool child_rows_dirty_;
+
   QString name_;
 
   QIcon icon_;
 
   QString tooltip_;
 
-  QMutex mutex_;
+  ProfiledMutex mutex_;
 
 };
 
@@ -0,0 +1,70 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "itemupdatequeue.h"
+
+ItemUpdateQueue olive::item_updates;
+
+ItemUpdateQueue::ItemUpdateQueue() :
+  flush_pending_(false)
+{
+}
+
+void ItemUpdateQueue::Queue(Item *item)
+{
+  QMutexLocker locker(&mutex_);
+
+  queued_.insert(item);
+
+  if (!flush_pending_) {
+    flush_pending_ = true;
+
+    QMetaObject::invokeMethod(this, "Flush", Qt::QueuedConnection);
+  }
+}
+
+void ItemUpdateQueue::Dequeue(Item *item)
+{
+  QMutexLocker locker(&mutex_);
+
+  queued_.remove(item);
+}
+
+void ItemUpdateQueue::Flush()
+{
+  QVector<Item*> items;
+
+  mutex_.lock();
+
+  items.reserve(queued_.size());
+
+  foreach (Item* item, queued_) {
+    items.append(item);
+  }
+
+  queued_.clear();
+  flush_pending_ = false;
+
+  mutex_.unlock();
+
+  if (!items.isEmpty()) {
+    emit ItemsUpdated(items);
+  }
+}
@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ITEMUPDATEQUEUE_H
+#define ITEMUPDATEQUEUE_H
+
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+class Item;
+
+/**
+ * @brief Collects Items whose icon or tooltip changed and reports them once per event loop iteration
+ *
+ * Items change from worker threads (e.g. ProbeTask setting a Footage's status) far more often than views need to
+ * repaint: probing a large import changes thousands of Items in quick succession. Queue() only adds the Item to a set,
+ * and the first Queue() after a flush schedules one ItemsUpdated() on the main thread with everything queued since,
+ * each Item once. ProjectViewModel turns that into one dataChanged() per contiguous range of rows.
+ *
+ * Use the application-wide olive::item_updates. Queue() and Dequeue() can be called from any thread.
+ */
+class ItemUpdateQueue : public QObject
+{
+  Q_OBJECT
+public:
+  ItemUpdateQueue();
+
+  /**
+   * @brief Report that an Item's data changed
+   */
+  void Queue(Item* item);
+
+  /**
+   * @brief Forget an Item that's being destroyed
+   */
+  void Dequeue(Item* item);
+
+signals:
+  /**
+   * @brief Emitted on the main thread with every Item queued since the last time
+   */
+  void ItemsUpdated(const QVector<Item*>& items);
+
+private:
+  QMutex mutex_;
+
+  QSet<Item*> queued_;
+
+  // Set while a Flush() is scheduled
+  bool flush_pending_;
+
+private slots:
+  void Flush();
+};
+
+namespace olive {
+/**
+ * @brief Application-wide Item update queue
+ */
+extern ItemUpdateQueue item_updates;
+}
+
+#endif // ITEMUPDATEQUEUE_H
@@ -20,6 +20,8 @@
 
 #include "sequence.h"
 
+#include "node/input/sequence/sequenceinput.h"
+#include "project/projectfile.h"
 #include "ui/icons/icons.h"
 
 Sequence::Sequence()
@@ -81,3 +83,92 @@ void Sequence::set_audio_time_base(const rational &time_base)
 {
   audio_time_base_ = time_base;
 }
+
+bool Sequence::graph_loaded()
+{
+  return pending_graph_.isEmpty();
+}
+
+bool Sequence::LoadGraph()
+{
+  if (graph_loaded()) {
+    return true;
+  }
+
+  bool result = ProjectFile::ReadGraph(this, pending_graph_);
+
+  pending_graph_.clear();
+  pending_file_.reset();
+
+  if (result) {
+    // Nested sequences are saved by name, find them in this sequence's project (this graph counts as loaded by now,
+    // so sequences nesting each other don't load each other forever)
+    Item* root = this;
+
+    while (root->parent() != nullptr) {
+      root = root->parent();
+    }
+
+    foreach (Node* n, nodes()) {
+      SequenceInput* nested = qobject_cast<SequenceInput*>(n);
+
+      if (nested == nullptr) {
+        continue;
+      }
+
+      Sequence* sequence = FindSequence(root, nested->sequence_input()->get_value(rational(0)).toString());
+
+      if (sequence != nullptr && sequence->LoadGraph()) {
+        nested->SetSequence(sequence);
+      }
+    }
+  }
+
+  return result;
+}
+
+Sequence *Sequence::FindSequence(Item *item, const QString &name)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence && child->name() == name) {
+      return static_cast<Sequence*>(child);
+    }
+
+    Sequence* found = FindSequence(child, name);
+
+    if (found != nullptr) {
+      return found;
+    }
+  }
+
+  return nullptr;
+}
+
+void Sequence::set_pending_graph(std::shared_ptr<ProjectFile> file, const QByteArray &data)
+{
+  pending_file_ = file;
+  pending_graph_ = data;
+}
+
+const QByteArray &Sequence::pending_graph()
+{
+  return pending_graph_;
+}
+
+void Sequence::DetachPendingGraph()
+{
+  if (pending_file_ == nullptr) {
+    return;
+  }
+
+  // The data points into the file's memory, so make a deep copy before letting go of it
+  pending_graph_ = QByteArray(pending_graph_.constData(), pending_graph_.size());
+  pending_file_.reset();
+}
+
+std::shared_ptr<ProjectFile> Sequence::pending_file()
+{
+  return pending_file_;
+}
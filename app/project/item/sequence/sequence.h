@@ -21,12 +21,20 @@
 #ifndef SEQUENCE_H
 #define SEQUENCE_H
 
+#include <memory>
+#include <QByteArray>
+
 #include "common/rational.h"
 #include "node/graph.h"
 #include "project/item/item.h"
 
+class ProjectFile;
+
 /**
  * @brief The main timeline object, an graph of edited clips that forms a complete edit
+ *
+ * A Sequence opened from a project file starts with an empty graph and only reads its nodes the first time
+ * LoadGraph() is called, so projects with many Sequences open quickly (see ProjectFile).
  */
 class Sequence : public Item, public NodeGraph
 {
@@ -57,13 +65,63 @@ public:
   const rational& audio_time_base();
   void set_audio_time_base(const rational& time_base);
 
+  /* GRAPH LOADING FUNCTIONS */
+
+  /**
+   * @brief Returns FALSE until a graph set with set_pending_graph() has been read
+   */
+  bool graph_loaded();
+
+  /**
+   * @brief Read the graph from the project file this Sequence was opened from, if it hasn't been already
+   *
+   * Anything that uses this Sequence's nodes should call this first.
+   *
+   * @return
+   *
+   * FALSE if the graph couldn't be read completely.
+   */
+  bool LoadGraph();
+
+  /**
+   * @brief Set the serialized graph for LoadGraph() to read (see ProjectFile)
+   *
+   * @param file
+   *
+   * The file `data` points into, kept open until the graph has been read or DetachPendingGraph() is called.
+   */
+  void set_pending_graph(std::shared_ptr<ProjectFile> file, const QByteArray& data);
+
+  /**
+   * @brief The serialized graph that hasn't been read yet, empty once graph_loaded() is TRUE
+   */
+  const QByteArray& pending_graph();
+
+  /**
+   * @brief Copy pending_graph() into memory so the project file it came from can be closed
+   */
+  void DetachPendingGraph();
+
+  /**
+   * @brief The project file pending_graph() points into, or nullptr if it doesn't point into one
+   */
+  std::shared_ptr<ProjectFile> pending_file();
+
 private:
+  /**
+   * @brief Find a sequence by name among an item's descendants, or nullptr if there's none
+   */
+  static Sequence* FindSequence(Item* item, const QString& name);
+
   int video_width_;
   int video_height_;
   rational video_time_base_;
 
   int audio_sampling_rate_;
   rational audio_time_base_;
+
+  std::shared_ptr<ProjectFile> pending_file_;
+  QByteArray pending_graph_;
 };
 
 #endif // SEQUENCE_H
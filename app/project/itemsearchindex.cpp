@@ -0,0 +1,174 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "itemsearchindex.h"
+
+#include <QFileInfo>
+#include <algorithm>
+
+#include "project/item/footage/footage.h"
+
+ItemSearchIndex::ItemSearchIndex()
+{
+}
+
+void ItemSearchIndex::AddTree(Item *item)
+{
+  Add(item);
+
+  for (int i=0;i<item->child_count();i++) {
+    AddTree(item->child(i));
+  }
+}
+
+void ItemSearchIndex::RemoveTree(Item *item)
+{
+  Remove(item);
+
+  for (int i=0;i<item->child_count();i++) {
+    RemoveTree(item->child(i));
+  }
+}
+
+void ItemSearchIndex::Update(Item *item)
+{
+  if (!texts_.contains(item)) {
+    return;
+  }
+
+  Remove(item);
+  Add(item);
+}
+
+QVector<Item *> ItemSearchIndex::Find(const QString &query)
+{
+  QString text = query.toLower();
+
+  QVector<Item*> results;
+
+  if (text.isEmpty()) {
+    return results;
+  }
+
+  QSet<quint64> query_trigrams = Trigrams(text);
+
+  if (query_trigrams.isEmpty()) {
+    // Queries shorter than a trigram have to check everything, which is still only a simple scan
+    QHash<Item*, QString>::const_iterator i;
+
+    for (i=texts_.constBegin();i!=texts_.constEnd();i++) {
+      if (i.value().contains(text)) {
+        results.append(i.key());
+      }
+    }
+  } else {
+    // Only the Items containing the rarest trigram can match
+    const QSet<Item*>* candidates = nullptr;
+
+    foreach (quint64 trigram, query_trigrams) {
+      QHash<quint64, QSet<Item*> >::const_iterator i = trigrams_.constFind(trigram);
+
+      if (i == trigrams_.constEnd()) {
+        // Nothing contains this trigram at all
+        return results;
+      }
+
+      if (candidates == nullptr || i.value().size() < candidates->size()) {
+        candidates = &i.value();
+      }
+    }
+
+    foreach (Item* item, *candidates) {
+      if (texts_.value(item).contains(text)) {
+        results.append(item);
+      }
+    }
+  }
+
+  std::sort(results.begin(), results.end(), [](Item* a, Item* b) {
+    return a->name().compare(b->name(), Qt::CaseInsensitive) < 0;
+  });
+
+  return results;
+}
+
+QString ItemSearchIndex::SearchText(Item *item)
+{
+  QString text = item->name();
+
+  if (item->type() == Item::kFootage) {
+    // Footage can also be found by its file's name, which may differ from the Item's name
+    text.append('\n');
+    text.append(QFileInfo(static_cast<Footage*>(item)->filename()).fileName());
+  }
+
+  return text.toLower();
+}
+
+QSet<quint64> ItemSearchIndex::Trigrams(const QString &text)
+{
+  QSet<quint64> trigrams;
+
+  for (int i=0;i+2<text.size();i++) {
+    quint64 trigram = (static_cast<quint64>(text.at(i).unicode()) << 32)
+        | (static_cast<quint64>(text.at(i + 1).unicode()) << 16)
+        | static_cast<quint64>(text.at(i + 2).unicode());
+
+    trigrams.insert(trigram);
+  }
+
+  return trigrams;
+}
+
+void ItemSearchIndex::Add(Item *item)
+{
+  if (texts_.contains(item)) {
+    return;
+  }
+
+  QString text = SearchText(item);
+
+  texts_.insert(item, text);
+
+  foreach (quint64 trigram, Trigrams(text)) {
+    trigrams_[trigram].insert(item);
+  }
+}
+
+void ItemSearchIndex::Remove(Item *item)
+{
+  if (!texts_.contains(item)) {
+    return;
+  }
+
+  QString text = texts_.take(item);
+
+  foreach (quint64 trigram, Trigrams(text)) {
+    QHash<quint64, QSet<Item*> >::iterator i = trigrams_.find(trigram);
+
+    if (i != trigrams_.end()) {
+      i.value().remove(item);
+
+      if (i.value().isEmpty()) {
+        trigrams_.erase(i);
+      }
+    }
+  }
+}
@@ -0,0 +1,86 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ITEMSEARCHINDEX_H
+#define ITEMSEARCHINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "project/item/item.h"
+
+/**
+ * @brief A trigram index for finding Items whose name (or Footage filename) contains some text
+ *
+ * Every Item's search text is split into overlapping three character sequences ("trigrams"), and each trigram maps to
+ * the set of Items containing it. A query only has to check the Items containing its rarest trigram instead of every
+ * Item in the project, so searching stays fast in projects with hundreds of thousands of Items.
+ *
+ * Kept up to date by ProjectViewModel as Items are added, removed and renamed, and by ProjectFile when a project is
+ * opened. Must only be used from the main thread.
+ */
+class ItemSearchIndex
+{
+public:
+  ItemSearchIndex();
+
+  /**
+   * @brief Index an Item and all of its children
+   */
+  void AddTree(Item* item);
+
+  /**
+   * @brief Remove an Item and all of its children from the index
+   */
+  void RemoveTree(Item* item);
+
+  /**
+   * @brief Update the index after an Item has been renamed
+   */
+  void Update(Item* item);
+
+  /**
+   * @brief Return every Item whose search text contains `query` (case-insensitive), sorted by name
+   */
+  QVector<Item*> Find(const QString& query);
+
+private:
+  /**
+   * @brief The text an Item is found by (lower case)
+   */
+  static QString SearchText(Item* item);
+
+  /**
+   * @brief Return the (unique) trigrams of a string, each packed into an integer
+   */
+  static QSet<quint64> Trigrams(const QString& text);
+
+  void Add(Item* item);
+
+  void Remove(Item* item);
+
+  QHash<Item*, QString> texts_;
+
+  QHash<quint64, QSet<Item*> > trigrams_;
+};
+
+#endif // ITEMSEARCHINDEX_H
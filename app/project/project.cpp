@@ -23,6 +23,8 @@
 Project::Project()
 {
   name_ = tr("(untitled)");
+
+  footage_index_.set_watcher(&footage_watcher_);
 }
 
 Folder *Project::root()
@@ -39,3 +41,23 @@ void Project::set_name(const QString &s)
 {
   name_ = s;
 }
+
+const QString &Project::filename()
+{
+  return filename_;
+}
+
+void Project::set_filename(const QString &s)
+{
+  filename_ = s;
+}
+
+FootageIndex *Project::footage_index()
+{
+  return &footage_index_;
+}
+
+ItemSearchIndex *Project::search_index()
+{
+  return &search_index_;
+}
@@ -24,6 +24,8 @@
 #include <QObject>
 #include <memory>
 
+#include "project/footageindex.h"
+#include "project/itemsearchindex.h"
 #include "project/item/folder/folder.h"
 
 /**
@@ -48,10 +50,34 @@ public:
   const QString& name();
   void set_name(const QString& s);
 
+  /**
+   * @brief The file this Project was last opened from or saved to, empty if it hasn't been saved yet
+   */
+  const QString& filename();
+  void set_filename(const QString& s);
+
+  /**
+   * @brief The index of every Footage in this Project
+   */
+  FootageIndex* footage_index();
+
+  /**
+   * @brief The search index of every Item in this Project
+   */
+  ItemSearchIndex* search_index();
+
 private:
   Folder root_;
 
+  FootageIndex footage_index_;
+
+  FootageWatcher footage_watcher_;
+
+  ItemSearchIndex search_index_;
+
   QString name_;
+
+  QString filename_;
 };
 
 using ProjectPtr = std::shared_ptr<Project>;
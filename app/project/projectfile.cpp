@@ -0,0 +1,994 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectfile.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <limits>
+
+#include "decoder/probecache.h"
+#include "node/factory.h"
+#include "node/input.h"
+#include "node/output.h"
+#include "project/item/folder/folder.h"
+
+namespace {
+
+// "OVPJ"
+const quint32 kMagic = 0x4F56504A;
+
+// 2: Footage fingerprints
+// 3: Video frame rates
+// 4: Image sequences
+// 5: Codec parameters
+// 6: Parameter expressions
+const quint32 kVersion = 6;
+
+// Magic, version and chunk count
+const qint64 kHeaderSize = 12;
+
+// Type, offset and size
+const qint64 kChunkEntrySize = 20;
+
+void SetupStream(QDataStream& stream)
+{
+  stream.setVersion(QDataStream::Qt_5_6);
+}
+
+}
+
+ProjectPtr ProjectFile::Open(const QString &filename)
+{
+  ProjectFilePtr file(new ProjectFile(filename));
+
+  if (!file->Read()) {
+    return nullptr;
+  }
+
+  ProjectPtr project = std::make_shared<Project>();
+
+  // Project settings
+  QDataStream project_stream(file->chunk(kProjectChunk));
+  SetupStream(project_stream);
+
+  QString name;
+  project_stream >> name;
+
+  if (project_stream.status() != QDataStream::Ok) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Project file \"%1\" has no valid project chunk")
+                  .arg(filename);
+    return nullptr;
+  }
+
+  project->set_name(name);
+
+  // Item tree
+  QDataStream tree_stream(file->chunk(kTreeChunk));
+  SetupStream(tree_stream);
+
+  QVector<int> sequence_chunks;
+  QList<Sequence*> sequences;
+
+  if (!ReadItems(tree_stream, file->version_, project->root(), &sequence_chunks, &sequences)) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Project file \"%1\" has an invalid item tree")
+                  .arg(filename);
+    return nullptr;
+  }
+
+  // Sequences keep their graph chunk (and therefore the file) until they're first used
+  for (int i=0;i<sequences.size();i++) {
+    int index = sequence_chunks.at(i);
+
+    if (index < 0
+        || index >= file->chunks_.size()
+        || file->chunks_.at(index).type != static_cast<quint32>(kGraphChunk)) {
+      qWarning() << QCoreApplication::translate("ProjectFile", "Sequence \"%1\" in \"%2\" has no graph")
+                    .arg(sequences.at(i)->Item::name(), filename);
+      continue;
+    }
+
+    const ChunkEntry& entry = file->chunks_.at(index);
+
+    sequences.at(i)->set_pending_graph(file,
+                                       QByteArray::fromRawData(file->contents_.constData() + entry.offset,
+                                                               static_cast<int>(entry.size)));
+  }
+
+  project->footage_index()->AddTree(project->root());
+
+  // The root itself isn't searchable
+  for (int i=0;i<project->root()->child_count();i++) {
+    project->search_index()->AddTree(project->root()->child(i));
+  }
+
+  project->set_filename(filename);
+
+  return project;
+}
+
+bool ProjectFile::Save(Project *project, const QString &filename)
+{
+  // Sequences that haven't been loaded yet may still point into the file we're about to replace
+  QString canonical_filename = CanonicalFilename(filename);
+
+  QByteArray tree_chunk;
+  QList<Sequence*> sequences;
+
+  {
+    QDataStream tree_stream(&tree_chunk, QIODevice::WriteOnly);
+    SetupStream(tree_stream);
+
+    int item_count = 0;
+
+    // Written after the items, so count them first
+    QByteArray items;
+    QDataStream item_stream(&items, QIODevice::WriteOnly);
+    SetupStream(item_stream);
+    WriteItems(item_stream, project->root(), -1, &item_count, &sequences);
+
+    tree_stream << static_cast<qint32>(item_count);
+    tree_stream.writeRawData(items.constData(), items.size());
+  }
+
+  foreach (Sequence* s, sequences) {
+    if (s->pending_file() != nullptr && CanonicalFilename(s->pending_file()->filename()) == canonical_filename) {
+      s->DetachPendingGraph();
+    }
+  }
+
+  QList<QPair<ChunkType, QByteArray> > chunks;
+
+  {
+    QByteArray project_chunk;
+    QDataStream project_stream(&project_chunk, QIODevice::WriteOnly);
+    SetupStream(project_stream);
+    project_stream << project->name();
+
+    chunks.append(qMakePair(kProjectChunk, project_chunk));
+  }
+
+  chunks.append(qMakePair(kTreeChunk, tree_chunk));
+
+  foreach (Sequence* s, sequences) {
+    chunks.append(qMakePair(kGraphChunk, GraphChunk(s)));
+  }
+
+  QSaveFile file(filename);
+
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Failed to open \"%1\" for writing: %2")
+                  .arg(filename, file.errorString());
+    return false;
+  }
+
+  QDataStream out(&file);
+  SetupStream(out);
+
+  out << kMagic << kVersion << static_cast<quint32>(chunks.size());
+
+  quint64 offset = static_cast<quint64>(kHeaderSize + kChunkEntrySize * chunks.size());
+
+  for (int i=0;i<chunks.size();i++) {
+    quint64 size = static_cast<quint64>(chunks.at(i).second.size());
+
+    out << static_cast<quint32>(chunks.at(i).first) << offset << size;
+
+    offset += size;
+  }
+
+  for (int i=0;i<chunks.size();i++) {
+    out.writeRawData(chunks.at(i).second.constData(), chunks.at(i).second.size());
+  }
+
+  if (out.status() != QDataStream::Ok || !file.commit()) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Failed to write \"%1\": %2")
+                  .arg(filename, file.errorString());
+    return false;
+  }
+
+  project->set_filename(filename);
+
+  return true;
+}
+
+bool ProjectFile::ReadGraph(Sequence *sequence, const QByteArray &data)
+{
+  QDataStream in(data);
+  SetupStream(in);
+
+  QString name;
+  qint32 node_count = 0;
+
+  in >> name >> node_count;
+
+  if (in.status() != QDataStream::Ok || node_count < 0) {
+    return false;
+  }
+
+  QVector<Node*> nodes;
+  bool valid = true;
+
+  for (int i=0;i<node_count && valid;i++) {
+    QString id;
+    qint32 param_count = 0;
+
+    in >> id >> param_count;
+
+    Node* node = NodeFactory::CreateFromID(id);
+
+    if (node == nullptr) {
+      qWarning() << QCoreApplication::translate("ProjectFile", "Sequence \"%1\" uses an unknown node \"%2\"")
+                    .arg(sequence->Item::name(), id);
+      valid = false;
+      break;
+    }
+
+    nodes.append(node);
+
+    // Nodes create their own parameters, so the saved ones must match
+    if (param_count != node->ParameterCount()) {
+      valid = false;
+      break;
+    }
+
+    for (int j=0;j<param_count && valid;j++) {
+      NodeParam* param = node->ParamAt(j);
+
+      bool is_input = false;
+      in >> is_input;
+
+      if (is_input != (param->type() == NodeParam::kInput)) {
+        valid = false;
+        break;
+      }
+
+      if (!is_input) {
+        continue;
+      }
+
+      bool keyframing = false;
+      qint32 keyframe_count = 0;
+
+      in >> keyframing >> keyframe_count;
+
+      if (keyframe_count < 0) {
+        valid = false;
+        break;
+      }
+
+      QVector<NodeKeyframe> keyframes;
+
+      for (int k=0;k<keyframe_count && valid;k++) {
+        qint64 time_num = 0;
+        qint64 time_den = 1;
+        NodeValue value;
+        qint32 type = 0;
+        QPointF bezier_in;
+        QPointF bezier_out;
+
+        in >> time_num >> time_den;
+        valid = ReadValue(in, &value);
+        in >> type >> bezier_in >> bezier_out;
+
+        if (time_den == 0 || type < NodeKeyframe::kLinear || type > NodeKeyframe::kBezier) {
+          valid = false;
+        }
+
+        NodeKeyframe key;
+        key.set_time(rational(time_num, time_den));
+        key.set_value(value);
+        key.set_type(static_cast<NodeKeyframe::Type>(type));
+        key.set_bezier_control_in(bezier_in);
+        key.set_bezier_control_out(bezier_out);
+
+        keyframes.append(key);
+      }
+
+      if (valid) {
+        NodeInput* input = static_cast<NodeInput*>(param);
+        input->set_keyframing(keyframing);
+        input->set_keyframes(keyframes);
+      }
+    }
+  }
+
+  qint32 edge_count = 0;
+
+  if (valid) {
+    in >> edge_count;
+  }
+
+  QList<QPair<NodeOutput*, NodeInput*> > edges;
+
+  for (int i=0;i<edge_count && valid;i++) {
+    qint32 output_node = 0;
+    qint32 output_param = 0;
+    qint32 input_node = 0;
+    qint32 input_param = 0;
+
+    in >> output_node >> output_param >> input_node >> input_param;
+
+    if (output_node < 0 || output_node >= nodes.size() || input_node < 0 || input_node >= nodes.size()
+        || output_param < 0 || output_param >= nodes.at(output_node)->ParameterCount()
+        || input_param < 0 || input_param >= nodes.at(input_node)->ParameterCount()) {
+      valid = false;
+      break;
+    }
+
+    NodeParam* output = nodes.at(output_node)->ParamAt(output_param);
+    NodeParam* input = nodes.at(input_node)->ParamAt(input_param);
+
+    if (output->type() != NodeParam::kOutput || input->type() != NodeParam::kInput) {
+      valid = false;
+      break;
+    }
+
+    edges.append(qMakePair(static_cast<NodeOutput*>(output), static_cast<NodeInput*>(input)));
+  }
+
+  // Set once the graph is connected, since expressions can reference other inputs
+  QList<QPair<NodeInput*, QString> > expressions;
+  qint32 expression_count = 0;
+
+  if (valid && !in.atEnd()) {
+    in >> expression_count;
+  }
+
+  for (int i=0;i<expression_count && valid;i++) {
+    qint32 node_index = 0;
+    qint32 param_index = 0;
+    QString expression;
+
+    in >> node_index >> param_index >> expression;
+
+    if (node_index < 0 || node_index >= nodes.size()
+        || param_index < 0 || param_index >= nodes.at(node_index)->ParameterCount()
+        || nodes.at(node_index)->ParamAt(param_index)->type() != NodeParam::kInput) {
+      valid = false;
+      break;
+    }
+
+    expressions.append(qMakePair(static_cast<NodeInput*>(nodes.at(node_index)->ParamAt(param_index)), expression));
+  }
+
+  if (!valid || in.status() != QDataStream::Ok) {
+    qDeleteAll(nodes);
+    return false;
+  }
+
+  sequence->NodeGraph::set_name(name);
+
+  foreach (Node* node, nodes) {
+    sequence->AddNode(node);
+  }
+
+  // Connect everything as one batch so the graph and its views only rebuild once
+  NodeParam::BeginEdgeBatch();
+
+  for (int i=0;i<edges.size();i++) {
+    NodeParam::ConnectEdge(edges.at(i).first, edges.at(i).second);
+  }
+
+  NodeParam::EndEdgeBatch();
+
+  for (int i=0;i<expressions.size();i++) {
+    QString error;
+
+    // A broken expression only loses itself, the input falls back to its keyframes
+    if (!expressions.at(i).first->set_expression(expressions.at(i).second, &error)) {
+      qWarning() << QCoreApplication::translate("ProjectFile", "Couldn't restore expression \"%1\": %2")
+                    .arg(expressions.at(i).second, error);
+    }
+  }
+
+  return true;
+}
+
+QByteArray ProjectFile::WriteItemTree(Item *item)
+{
+  int item_count = 0;
+  QList<Sequence*> sequences;
+
+  QByteArray items;
+  QDataStream item_stream(&items, QIODevice::WriteOnly);
+  SetupStream(item_stream);
+  WriteItem(item_stream, item, -1, &item_count, &sequences);
+
+  QByteArray data;
+  QDataStream out(&data, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << kVersion << static_cast<qint32>(item_count);
+  out.writeRawData(items.constData(), items.size());
+
+  // Sequences refer to their graphs as if they were chunks after the project and tree chunks
+  out << static_cast<qint32>(sequences.size());
+
+  foreach (Sequence* s, sequences) {
+    out << GraphChunk(s);
+  }
+
+  return data;
+}
+
+ItemPtr ProjectFile::ReadItemTree(const QByteArray &data, Item *parent)
+{
+  QDataStream in(data);
+  SetupStream(in);
+
+  quint32 version = 0;
+  in >> version;
+
+  if (in.status() != QDataStream::Ok || version > kVersion) {
+    return nullptr;
+  }
+
+  // Read into a folder of our own so nothing reaches `parent` unless it's all valid
+  Folder staging;
+  QVector<int> sequence_chunks;
+  QList<Sequence*> sequences;
+
+  if (!ReadItems(in, version, &staging, &sequence_chunks, &sequences) || staging.child_count() != 1) {
+    return nullptr;
+  }
+
+  qint32 graph_count = 0;
+  in >> graph_count;
+
+  QVector<QByteArray> graphs;
+
+  for (int i=0;i<graph_count && in.status() == QDataStream::Ok;i++) {
+    QByteArray graph;
+    in >> graph;
+    graphs.append(graph);
+  }
+
+  if (in.status() != QDataStream::Ok) {
+    return nullptr;
+  }
+
+  for (int i=0;i<sequences.size();i++) {
+    int index = sequence_chunks.at(i) - 2;
+
+    if (index < 0 || index >= graphs.size()) {
+      return nullptr;
+    }
+
+    sequences.at(i)->set_pending_graph(nullptr, graphs.at(index));
+  }
+
+  ItemPtr item = staging.shared_ptr_from_raw(staging.child(0));
+
+  parent->add_child(item);
+
+  return item;
+}
+
+QString ProjectFile::filename() const
+{
+  return file_.fileName();
+}
+
+ProjectFile::ProjectFile(const QString &filename) :
+  file_(filename),
+  version_(0)
+{
+}
+
+bool ProjectFile::Read()
+{
+  if (!file_.open(QIODevice::ReadOnly)) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Failed to open \"%1\": %2")
+                  .arg(file_.fileName(), file_.errorString());
+    return false;
+  }
+
+  qint64 size = file_.size();
+
+  // QByteArray can only address this much
+  if (size > std::numeric_limits<int>::max()) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "Project file \"%1\" is too large")
+                  .arg(file_.fileName());
+    return false;
+  }
+
+  uchar* map = file_.map(0, size);
+
+  if (map != nullptr) {
+    contents_ = QByteArray::fromRawData(reinterpret_cast<const char*>(map), static_cast<int>(size));
+  } else {
+    // Some files (e.g. on network shares) can't be mapped
+    contents_ = file_.readAll();
+  }
+
+  QDataStream in(contents_);
+  SetupStream(in);
+
+  quint32 magic = 0;
+  quint32 chunk_count = 0;
+
+  in >> magic >> version_ >> chunk_count;
+
+  if (in.status() != QDataStream::Ok || magic != kMagic) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "\"%1\" is not an Olive project")
+                  .arg(file_.fileName());
+    return false;
+  }
+
+  if (version_ > kVersion) {
+    qWarning() << QCoreApplication::translate("ProjectFile", "\"%1\" was saved by a newer version of Olive")
+                  .arg(file_.fileName());
+    return false;
+  }
+
+  for (quint32 i=0;i<chunk_count;i++) {
+    ChunkEntry entry = {0, 0, 0};
+
+    in >> entry.type >> entry.offset >> entry.size;
+
+    if (in.status() != QDataStream::Ok
+        || entry.offset > static_cast<quint64>(contents_.size())
+        || entry.size > static_cast<quint64>(contents_.size()) - entry.offset) {
+      qWarning() << QCoreApplication::translate("ProjectFile", "Project file \"%1\" is truncated")
+                    .arg(file_.fileName());
+      return false;
+    }
+
+    chunks_.append(entry);
+  }
+
+  return true;
+}
+
+QByteArray ProjectFile::chunk(ProjectFile::ChunkType type)
+{
+  foreach (const ChunkEntry& entry, chunks_) {
+    if (entry.type == static_cast<quint32>(type)) {
+      return QByteArray::fromRawData(contents_.constData() + entry.offset, static_cast<int>(entry.size));
+    }
+  }
+
+  return QByteArray();
+}
+
+void ProjectFile::WriteItems(QDataStream &out, Item *parent, int parent_index, int *item_count,
+                             QList<Sequence *> *sequences)
+{
+  for (int i=0;i<parent->child_count();i++) {
+    WriteItem(out, parent->child(i), parent_index, item_count, sequences);
+  }
+}
+
+void ProjectFile::WriteItem(QDataStream &out, Item *item, int parent_index, int *item_count,
+                            QList<Sequence *> *sequences)
+{
+  int index = *item_count;
+  (*item_count)++;
+
+  out << static_cast<qint32>(item->type()) << static_cast<qint32>(parent_index) << item->name();
+
+  switch (item->type()) {
+  case Item::kFolder:
+    break;
+  case Item::kFootage:
+  {
+    Footage* footage = static_cast<Footage*>(item);
+
+    out << footage->filename() << footage->timestamp() << footage->fingerprint();
+
+    // Invalid (0, -1) for anything that isn't a sequence
+    out << static_cast<qint64>(footage->image_sequence().first())
+        << static_cast<qint64>(footage->image_sequence().last());
+
+    ProbeCache::WriteStreams(out, footage);
+    break;
+  }
+  case Item::kSequence:
+  {
+    Sequence* sequence = static_cast<Sequence*>(item);
+
+    rational video_time_base = sequence->video_time_base();
+    rational audio_time_base = sequence->audio_time_base();
+
+    out << static_cast<qint32>(sequence->video_width())
+        << static_cast<qint32>(sequence->video_height())
+        << static_cast<qint64>(video_time_base.numerator())
+        << static_cast<qint64>(video_time_base.denominator())
+        << static_cast<qint32>(sequence->audio_sampling_rate())
+        << static_cast<qint64>(audio_time_base.numerator())
+        << static_cast<qint64>(audio_time_base.denominator())
+        // Graph chunks follow the project and tree chunks
+        << static_cast<qint32>(2 + sequences->size());
+
+    sequences->append(sequence);
+    break;
+  }
+  }
+
+  if (item->CanHaveChildren()) {
+    WriteItems(out, item, index, item_count, sequences);
+  }
+}
+
+bool ProjectFile::ReadItems(QDataStream &in, quint32 version, Item *root, QVector<int> *sequence_chunks,
+                            QList<Sequence *> *sequences)
+{
+  qint32 item_count = 0;
+
+  in >> item_count;
+
+  if (in.status() != QDataStream::Ok || item_count < 0) {
+    return false;
+  }
+
+  QVector<Item*> items;
+
+  for (int i=0;i<item_count;i++) {
+    qint32 type = 0;
+    qint32 parent_index = 0;
+    QString name;
+
+    in >> type >> parent_index >> name;
+
+    // Items are listed depth-first, so parents always come before their children
+    if (in.status() != QDataStream::Ok || parent_index < -1 || parent_index >= items.size()) {
+      return false;
+    }
+
+    Item* parent = (parent_index == -1) ? root : items.at(parent_index);
+
+    if (!parent->CanHaveChildren()) {
+      return false;
+    }
+
+    ItemPtr item;
+
+    switch (static_cast<Item::Type>(type)) {
+    case Item::kFolder:
+      item = std::make_shared<Folder>();
+      break;
+    case Item::kFootage:
+    {
+      FootagePtr footage = std::make_shared<Footage>();
+
+      QString filename;
+      QDateTime timestamp;
+
+      in >> filename >> timestamp;
+
+      if (version >= 2) {
+        QByteArray fingerprint;
+        in >> fingerprint;
+        footage->set_fingerprint(fingerprint);
+      }
+
+      if (version >= 4) {
+        qint64 sequence_first, sequence_last;
+        in >> sequence_first >> sequence_last;
+
+        ImageSequence sequence = ImageSequence::FromFilename(filename);
+
+        if (sequence.IsValid() && sequence_last >= sequence_first) {
+          sequence.SetRange(static_cast<int64_t>(sequence_first), static_cast<int64_t>(sequence_last));
+          footage->set_image_sequence(sequence);
+        }
+      }
+
+      footage->set_filename(filename);
+      footage->set_timestamp(timestamp);
+
+      // Stream data has its own version (see ProbeCache::kStreamsVersion), version 2 came with project version 3 and
+      // version 3 with project version 5
+      int streams_version = 1;
+
+      if (version >= 5) {
+        streams_version = 3;
+      } else if (version >= 3) {
+        streams_version = 2;
+      }
+
+      if (!ProbeCache::ReadStreams(in, footage.get(), streams_version)) {
+        return false;
+      }
+
+      // Files aren't checked here, media that changed since the project was saved is found by a ValidateTask once
+      // the project is open
+      item = footage;
+      break;
+    }
+    case Item::kSequence:
+    {
+      std::shared_ptr<Sequence> sequence = std::make_shared<Sequence>();
+
+      qint32 video_width = 0;
+      qint32 video_height = 0;
+      qint64 video_time_base_num = 0;
+      qint64 video_time_base_den = 1;
+      qint32 audio_sampling_rate = 0;
+      qint64 audio_time_base_num = 0;
+      qint64 audio_time_base_den = 1;
+      qint32 graph_chunk = -1;
+
+      in >> video_width >> video_height >> video_time_base_num >> video_time_base_den >> audio_sampling_rate
+         >> audio_time_base_num >> audio_time_base_den >> graph_chunk;
+
+      if (video_time_base_den == 0 || audio_time_base_den == 0) {
+        return false;
+      }
+
+      sequence->set_video_width(video_width);
+      sequence->set_video_height(video_height);
+      sequence->set_video_time_base(rational(video_time_base_num, video_time_base_den));
+      sequence->set_audio_sampling_rate(audio_sampling_rate);
+      sequence->set_audio_time_base(rational(audio_time_base_num, audio_time_base_den));
+
+      sequence_chunks->append(graph_chunk);
+      sequences->append(sequence.get());
+
+      item = sequence;
+      break;
+    }
+    default:
+      return false;
+    }
+
+    item->set_name(name);
+
+    parent->add_child(item);
+
+    items.append(item.get());
+  }
+
+  return (in.status() == QDataStream::Ok);
+}
+
+QByteArray ProjectFile::GraphChunk(Sequence *sequence)
+{
+  if (!sequence->graph_loaded()) {
+    // Graphs that were never loaded are copied as they are
+    return QByteArray(sequence->pending_graph().constData(), sequence->pending_graph().size());
+  }
+
+  QByteArray graph_chunk;
+  QDataStream graph_stream(&graph_chunk, QIODevice::WriteOnly);
+  SetupStream(graph_stream);
+  WriteGraph(graph_stream, sequence);
+
+  return graph_chunk;
+}
+
+void ProjectFile::WriteGraph(QDataStream &out, Sequence *sequence)
+{
+  QList<Node*> nodes = sequence->nodes();
+
+  QHash<Node*, int> node_indices;
+
+  out << sequence->NodeGraph::name() << static_cast<qint32>(nodes.size());
+
+  for (int i=0;i<nodes.size();i++) {
+    Node* node = nodes.at(i);
+
+    node_indices.insert(node, i);
+
+    out << node->id() << static_cast<qint32>(node->ParameterCount());
+
+    for (int j=0;j<node->ParameterCount();j++) {
+      NodeParam* param = node->ParamAt(j);
+
+      bool is_input = (param->type() == NodeParam::kInput);
+
+      out << is_input;
+
+      if (!is_input) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+      QVector<NodeKeyframe> keyframes = input->keyframes();
+
+      out << input->keyframing() << static_cast<qint32>(keyframes.size());
+
+      foreach (const NodeKeyframe& key, keyframes) {
+        rational time = key.time();
+
+        out << static_cast<qint64>(time.numerator()) << static_cast<qint64>(time.denominator());
+        WriteValue(out, key.value());
+        out << static_cast<qint32>(key.type()) << key.bezier_control_in() << key.bezier_control_out();
+      }
+    }
+  }
+
+  // Edges are written from their outputs, skipping any leading to nodes outside this graph
+  QByteArray edges;
+  QDataStream edge_stream(&edges, QIODevice::WriteOnly);
+  SetupStream(edge_stream);
+
+  int edge_count = 0;
+
+  for (int i=0;i<nodes.size();i++) {
+    Node* node = nodes.at(i);
+
+    for (int j=0;j<node->ParameterCount();j++) {
+      NodeParam* param = node->ParamAt(j);
+
+      if (param->type() != NodeParam::kOutput) {
+        continue;
+      }
+
+      foreach (NodeEdgePtr edge, param->edges()) {
+        Node* input_node = edge->input()->parent();
+
+        if (!node_indices.contains(input_node)) {
+          continue;
+        }
+
+        edge_stream << static_cast<qint32>(i)
+                    << static_cast<qint32>(j)
+                    << static_cast<qint32>(node_indices.value(input_node))
+                    << static_cast<qint32>(input_node->IndexOfParameter(edge->input()));
+
+        edge_count++;
+      }
+    }
+  }
+
+  out << static_cast<qint32>(edge_count);
+  out.writeRawData(edges.constData(), edges.size());
+
+  // Expressions come last so graphs written before they existed still read
+  QList<QPair<int, int> > expression_params;
+
+  for (int i=0;i<nodes.size();i++) {
+    Node* node = nodes.at(i);
+
+    for (int j=0;j<node->ParameterCount();j++) {
+      NodeParam* param = node->ParamAt(j);
+
+      if (param->type() == NodeParam::kInput && !static_cast<NodeInput*>(param)->expression().isEmpty()) {
+        expression_params.append(qMakePair(i, j));
+      }
+    }
+  }
+
+  out << static_cast<qint32>(expression_params.size());
+
+  for (int i=0;i<expression_params.size();i++) {
+    const QPair<int, int>& p = expression_params.at(i);
+
+    out << static_cast<qint32>(p.first)
+        << static_cast<qint32>(p.second)
+        << static_cast<NodeInput*>(nodes.at(p.first)->ParamAt(p.second))->expression();
+  }
+}
+
+void ProjectFile::WriteValue(QDataStream &out, const NodeValue &value)
+{
+  out << static_cast<qint32>(value.type());
+
+  switch (value.type()) {
+  case NodeParam::kInt:
+    out << static_cast<qint32>(value.toInt());
+    break;
+  case NodeParam::kFloat:
+    out << value.toDouble();
+    break;
+  case NodeParam::kColor:
+    out << value.toColor();
+    break;
+  case NodeParam::kString:
+  case NodeParam::kFont:
+  case NodeParam::kFile:
+    out << value.toString();
+    break;
+  case NodeParam::kBoolean:
+    out << value.toBool();
+    break;
+  case NodeParam::kMatrix:
+    out << value.toMatrix();
+    break;
+  case NodeParam::kNone:
+  case NodeParam::kTexture:
+  case NodeParam::kBlock:
+  case NodeParam::kSamples:
+  case NodeParam::kAny:
+    // Runtime-only values aren't saved
+    break;
+  }
+}
+
+bool ProjectFile::ReadValue(QDataStream &in, NodeValue *value)
+{
+  qint32 type = 0;
+
+  in >> type;
+
+  switch (static_cast<NodeParam::DataType>(type)) {
+  case NodeParam::kInt:
+  {
+    qint32 i = 0;
+    in >> i;
+    *value = NodeValue(static_cast<int>(i));
+    break;
+  }
+  case NodeParam::kFloat:
+  {
+    double d = 0.0;
+    in >> d;
+    *value = NodeValue(d);
+    break;
+  }
+  case NodeParam::kColor:
+  {
+    QColor color;
+    in >> color;
+    *value = NodeValue(color);
+    break;
+  }
+  case NodeParam::kString:
+  case NodeParam::kFont:
+  case NodeParam::kFile:
+  {
+    QString string;
+    in >> string;
+    *value = NodeValue(string, static_cast<NodeParam::DataType>(type));
+    break;
+  }
+  case NodeParam::kBoolean:
+  {
+    bool b = false;
+    in >> b;
+    *value = NodeValue(b);
+    break;
+  }
+  case NodeParam::kMatrix:
+  {
+    QMatrix4x4 matrix;
+    in >> matrix;
+    *value = NodeValue(matrix);
+    break;
+  }
+  case NodeParam::kNone:
+  case NodeParam::kTexture:
+  case NodeParam::kBlock:
+  case NodeParam::kSamples:
+  case NodeParam::kAny:
+    *value = NodeValue();
+    break;
+  default:
+    return false;
+  }
+
+  return (in.status() == QDataStream::Ok);
+}
+
+QString ProjectFile::CanonicalFilename(const QString &filename)
+{
+  QFileInfo info(filename);
+
+  // Files that don't exist yet have no canonical path
+  QString canonical = info.canonicalFilePath();
+
+  return canonical.isEmpty() ? info.absoluteFilePath() : canonical;
+}
@@ -0,0 +1,160 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <memory>
+
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+
+class ProjectFile;
+using ProjectFilePtr = std::shared_ptr<ProjectFile>;
+
+/**
+ * @brief Reads and writes Olive's binary project files
+ *
+ * A project file is a small header followed by a table of chunks, each a self-contained block that can be read on its
+ * own:
+ *
+ * * A project chunk with the Project's own settings
+ * * A tree chunk listing every Item (depth-first) with the metadata needed to show it in the project explorer
+ * * One graph chunk per Sequence containing its nodes, their keyframes and their connections
+ *
+ * Opening a project only reads the project and tree chunks. The file is memory-mapped and each Sequence keeps a
+ * reference to its graph chunk (see Sequence::set_pending_graph()), which isn't parsed until the Sequence is first
+ * used. Large projects therefore open in time proportional to their item count rather than their total size.
+ */
+class ProjectFile
+{
+public:
+  /**
+   * @brief Open a project file
+   *
+   * @return
+   *
+   * The Project or nullptr if the file couldn't be read, in which case a warning explaining why has been printed.
+   */
+  static ProjectPtr Open(const QString& filename);
+
+  /**
+   * @brief Save a Project to a file
+   *
+   * The file is written atomically, so a failed save leaves any previous file intact. On success, the Project's
+   * filename is set to `filename`.
+   *
+   * @return
+   *
+   * TRUE on success.
+   */
+  static bool Save(Project* project, const QString& filename);
+
+  /**
+   * @brief Read a graph chunk into a Sequence (used by Sequence::LoadGraph())
+   *
+   * @return
+   *
+   * TRUE on success. On failure, none of the chunk's nodes are added to the Sequence.
+   */
+  static bool ReadGraph(Sequence* sequence, const QByteArray& data);
+
+  /**
+   * @brief Serialize an Item and everything under it, including the graphs of any Sequences (see ReadItemTree())
+   */
+  static QByteArray WriteItemTree(Item* item);
+
+  /**
+   * @brief Read an Item serialized with WriteItemTree() and add it as the last child of `parent`
+   *
+   * Sequence graphs are read the first time they're used, as they are when opening a project.
+   *
+   * @return
+   *
+   * The Item, or nullptr if the data couldn't be read, in which case nothing is added.
+   */
+  static ItemPtr ReadItemTree(const QByteArray& data, Item* parent);
+
+  /**
+   * @brief The filename this file was opened from
+   */
+  QString filename() const;
+
+private:
+  enum ChunkType {
+    kProjectChunk,
+    kTreeChunk,
+    kGraphChunk
+  };
+
+  ProjectFile(const QString& filename);
+
+  /**
+   * @brief Open and map the file, reading its chunk table
+   */
+  bool Read();
+
+  /**
+   * @brief Return the first chunk of a type, or an empty array if there isn't one
+   */
+  QByteArray chunk(ChunkType type);
+
+  static void WriteItems(QDataStream& out, Item* parent, int parent_index, int* item_count,
+                         QList<Sequence*>* sequences);
+
+  static void WriteItem(QDataStream& out, Item* item, int parent_index, int* item_count,
+                        QList<Sequence*>* sequences);
+
+  static bool ReadItems(QDataStream& in, quint32 version, Item* root, QVector<int>* sequence_chunks,
+                        QList<Sequence*>* sequences);
+
+  /**
+   * @brief A Sequence's graph chunk, written from its nodes or copied if they were never loaded
+   */
+  static QByteArray GraphChunk(Sequence* sequence);
+
+  static void WriteGraph(QDataStream& out, Sequence* sequence);
+
+  static void WriteValue(QDataStream& out, const NodeValue& value);
+
+  static bool ReadValue(QDataStream& in, NodeValue* value);
+
+  static QString CanonicalFilename(const QString& filename);
+
+  struct ChunkEntry {
+    quint32 type;
+    quint64 offset;
+    quint64 size;
+  };
+
+  QFile file_;
+
+  // Points into the file's mapped memory, so it must be released before file_
+  QByteArray contents_;
+
+  QList<ChunkEntry> chunks_;
+
+  quint32 version_;
+};
+
+#endif // PROJECTFILE_H
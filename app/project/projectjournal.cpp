@@ -0,0 +1,626 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectjournal.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "common/threadpolicy.h"
+#include "project/item/sequence/sequence.h"
+#include "project/projectfile.h"
+#include "undo/undocommand.h"
+#include "undo/undostack.h"
+
+namespace {
+
+// "OVJL"
+const quint32 kMagic = 0x4F564A4C;
+
+const quint32 kVersion = 1;
+
+void SetupStream(QDataStream& stream)
+{
+  stream.setVersion(QDataStream::Qt_5_6);
+}
+
+/**
+ * @brief Make sure everything written to a file has reached the disk, not just the OS
+ */
+void SyncFile(QFile& file)
+{
+#ifdef Q_OS_WIN
+  _commit(file.handle());
+#else
+  fsync(file.handle());
+#endif
+}
+
+}
+
+ProjectJournalWriter::ProjectJournalWriter(const QString &filename) :
+  filename_(filename),
+  restart_(false),
+  stop_(false)
+{
+}
+
+void ProjectJournalWriter::Restart(const QByteArray &header)
+{
+  QMutexLocker locker(&lock_);
+
+  pending_.clear();
+  header_ = header;
+  restart_ = true;
+
+  wait_.wakeAll();
+}
+
+void ProjectJournalWriter::Append(const QByteArray &data)
+{
+  QMutexLocker locker(&lock_);
+
+  pending_.append(data);
+
+  wait_.wakeAll();
+}
+
+void ProjectJournalWriter::Stop()
+{
+  QMutexLocker locker(&lock_);
+
+  stop_ = true;
+
+  wait_.wakeAll();
+}
+
+void ProjectJournalWriter::run()
+{
+  ThreadPolicy::Apply(ThreadPolicy::kRoleBackground);
+
+  QFile file(filename_);
+
+  forever {
+    lock_.lock();
+
+    while (pending_.isEmpty() && !restart_ && !stop_) {
+      wait_.wait(&lock_);
+    }
+
+    bool restart = restart_;
+    bool stop = stop_;
+    QByteArray header = header_;
+    QByteArray data = pending_;
+
+    restart_ = false;
+    pending_.clear();
+
+    lock_.unlock();
+
+    if (restart) {
+      file.close();
+
+      if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(header);
+      }
+    } else if (!file.isOpen() && !data.isEmpty()) {
+      file.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+
+    if (file.isOpen()) {
+      if (!data.isEmpty() && file.write(data) != data.size()) {
+        qWarning() << QCoreApplication::translate("ProjectJournal", "Failed to write autosave journal \"%1\": %2")
+                      .arg(filename_, file.errorString());
+      }
+
+      file.flush();
+      SyncFile(file);
+    }
+
+    if (stop) {
+      break;
+    }
+  }
+}
+
+ProjectJournal::ProjectJournal(Project *project, QObject *parent) :
+  QObject(parent),
+  project_(project),
+  writer_(nullptr),
+  blocked_(false)
+{
+  connect(&olive::undo_stack,
+          SIGNAL(AboutToApply(const QUndoCommand*, bool)),
+          this,
+          SLOT(CommandAboutToApply(const QUndoCommand*, bool)));
+}
+
+ProjectJournal::~ProjectJournal()
+{
+  if (writer_ != nullptr) {
+    writer_->Stop();
+    writer_->wait();
+    delete writer_;
+  }
+}
+
+Project *ProjectJournal::project()
+{
+  return project_;
+}
+
+QString ProjectJournal::Filename(const QString &project_filename)
+{
+  return project_filename + QStringLiteral(".journal");
+}
+
+bool ProjectJournal::HasChanges(const QString &project_filename)
+{
+  QFile file(Filename(project_filename));
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  QByteArray journal = file.readAll();
+
+  int offset = RecordsStart(journal, project_filename);
+  QByteArray record;
+
+  return (offset >= 0 && ReadRecord(journal, &offset, &record));
+}
+
+void ProjectJournal::Start()
+{
+  StartWriter();
+
+  writer_->Restart(Header(project_->filename()));
+
+  blocked_ = false;
+}
+
+int ProjectJournal::Recover()
+{
+  QString filename = Filename(project_->filename());
+  QFile file(filename);
+
+  if (!file.open(QIODevice::ReadOnly)) {
+    Start();
+    return 0;
+  }
+
+  QByteArray journal = file.readAll();
+  file.close();
+
+  int offset = RecordsStart(journal, project_->filename());
+
+  if (offset < 0) {
+    Start();
+    return 0;
+  }
+
+  int count = 0;
+  int end = offset;
+  QByteArray record;
+
+  while (ReadRecord(journal, &offset, &record) && Apply(record)) {
+    count++;
+    end = offset;
+  }
+
+  // Continue after the last change that was replayed, dropping anything torn or unrecoverable after it
+  if (!file.resize(end)) {
+    qWarning() << tr("Failed to continue autosave journal \"%1\": %2").arg(filename, file.errorString());
+    Start();
+    return count;
+  }
+
+  blocked_ = false;
+
+  StartWriter();
+
+  return count;
+}
+
+void ProjectJournal::RenameItem(Item *item, const QString &name)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kRenameItem);
+
+  if (WriteItem(out, item)) {
+    out << name;
+
+    Append(record);
+  }
+}
+
+void ProjectJournal::MoveItem(Item *item, Item *destination)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kMoveItem);
+
+  if (WriteItem(out, item) && WriteItem(out, destination)) {
+    Append(record);
+  }
+}
+
+void ProjectJournal::AddItem(Item *parent, Item *item)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kAddItem);
+
+  if (WriteItem(out, parent)) {
+    out << ProjectFile::WriteItemTree(item);
+
+    Append(record);
+  }
+}
+
+void ProjectJournal::RemoveItem(Item *item)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kRemoveItem);
+
+  if (WriteItem(out, item)) {
+    Append(record);
+  }
+}
+
+void ProjectJournal::ConnectEdge(NodeOutput *output, NodeInput *input)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kConnectEdge);
+
+  if (WriteParam(out, output) && WriteParam(out, input)) {
+    Append(record);
+  }
+}
+
+void ProjectJournal::DisconnectEdge(NodeOutput *output, NodeInput *input)
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kDisconnectEdge);
+
+  if (WriteParam(out, output) && WriteParam(out, input)) {
+    Append(record);
+  }
+}
+
+void ProjectJournal::Barrier()
+{
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint8>(kBarrier);
+
+  Append(record);
+
+  blocked_ = true;
+}
+
+QByteArray ProjectJournal::Header(const QString &project_filename)
+{
+  QFileInfo info(project_filename);
+
+  QByteArray header;
+  QDataStream out(&header, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  // The project file is replaced on every save, so its size and modification time identify the save
+  out << kMagic << kVersion << static_cast<qint64>(info.size()) << info.lastModified().toMSecsSinceEpoch();
+
+  return header;
+}
+
+int ProjectJournal::RecordsStart(const QByteArray &journal, const QString &project_filename)
+{
+  QByteArray header = Header(project_filename);
+
+  if (!journal.startsWith(header)) {
+    return -1;
+  }
+
+  return header.size();
+}
+
+bool ProjectJournal::ReadRecord(const QByteArray &journal, int *offset, QByteArray *record)
+{
+  if (journal.size() - *offset < kRecordHeaderSize) {
+    return false;
+  }
+
+  const uchar* data = reinterpret_cast<const uchar*>(journal.constData()) + *offset;
+
+  quint32 size = qFromBigEndian<quint32>(data);
+  quint16 checksum = qFromBigEndian<quint16>(data + 4);
+
+  if (size > static_cast<quint32>(journal.size() - *offset - kRecordHeaderSize)) {
+    return false;
+  }
+
+  const char* record_data = journal.constData() + *offset + kRecordHeaderSize;
+
+  if (qChecksum(record_data, size) != checksum) {
+    return false;
+  }
+
+  *record = QByteArray(record_data, static_cast<int>(size));
+  *offset += kRecordHeaderSize + static_cast<int>(size);
+
+  return true;
+}
+
+bool ProjectJournal::WriteItem(QDataStream &out, Item *item)
+{
+  QVector<qint32> path;
+
+  while (item->parent() != nullptr) {
+    path.prepend(item->row());
+    item = item->parent();
+  }
+
+  if (item != project_->root()) {
+    return false;
+  }
+
+  out << path;
+
+  return true;
+}
+
+Item *ProjectJournal::ReadItem(QDataStream &in)
+{
+  QVector<qint32> path;
+  in >> path;
+
+  if (in.status() != QDataStream::Ok) {
+    return nullptr;
+  }
+
+  Item* item = project_->root();
+
+  foreach (qint32 index, path) {
+    if (index < 0 || index >= item->child_count()) {
+      return nullptr;
+    }
+
+    item = item->child(index);
+  }
+
+  return item;
+}
+
+bool ProjectJournal::WriteParam(QDataStream &out, NodeParam *param)
+{
+  Node* node = param->parent();
+
+  if (node == nullptr) {
+    return false;
+  }
+
+  Sequence* sequence = dynamic_cast<Sequence*>(node->QObject::parent());
+
+  if (sequence == nullptr || !WriteItem(out, sequence)) {
+    return false;
+  }
+
+  // Nodes are saved and loaded in graph order, so their indices are the same in the project file
+  out << static_cast<qint32>(sequence->nodes().indexOf(node)) << static_cast<qint32>(node->IndexOfParameter(param));
+
+  return true;
+}
+
+NodeParam *ProjectJournal::ReadParam(QDataStream &in)
+{
+  Item* item = ReadItem(in);
+
+  qint32 node_index = -1;
+  qint32 param_index = -1;
+
+  in >> node_index >> param_index;
+
+  if (item == nullptr || in.status() != QDataStream::Ok || item->type() != Item::kSequence) {
+    return nullptr;
+  }
+
+  Sequence* sequence = static_cast<Sequence*>(item);
+
+  if (!sequence->LoadGraph()) {
+    return nullptr;
+  }
+
+  QList<Node*> nodes = sequence->nodes();
+
+  if (node_index < 0 || node_index >= nodes.size()
+      || param_index < 0 || param_index >= nodes.at(node_index)->ParameterCount()) {
+    return nullptr;
+  }
+
+  return nodes.at(node_index)->ParamAt(param_index);
+}
+
+void ProjectJournal::Append(const QByteArray &record)
+{
+  if (writer_ == nullptr || blocked_) {
+    return;
+  }
+
+  QByteArray framed;
+  QDataStream out(&framed, QIODevice::WriteOnly);
+  SetupStream(out);
+
+  out << static_cast<quint32>(record.size()) << qChecksum(record.constData(), static_cast<uint>(record.size()));
+  out.writeRawData(record.constData(), record.size());
+
+  writer_->Append(framed);
+}
+
+bool ProjectJournal::Apply(const QByteArray &record)
+{
+  QDataStream in(record);
+  SetupStream(in);
+
+  quint8 type = kBarrier;
+  in >> type;
+
+  switch (static_cast<RecordType>(type)) {
+  case kRenameItem:
+  {
+    Item* item = ReadItem(in);
+    QString name;
+    in >> name;
+
+    if (item == nullptr || in.status() != QDataStream::Ok) {
+      return false;
+    }
+
+    item->set_name(name);
+    project_->search_index()->Update(item);
+    return true;
+  }
+  case kMoveItem:
+  {
+    Item* item = ReadItem(in);
+    Item* destination = ReadItem(in);
+
+    if (item == nullptr || destination == nullptr || item->parent() == nullptr || !destination->CanHaveChildren()) {
+      return false;
+    }
+
+    destination->add_child(item->parent()->shared_ptr_from_raw(item));
+    return true;
+  }
+  case kAddItem:
+  {
+    Item* parent = ReadItem(in);
+    QByteArray data;
+    in >> data;
+
+    if (parent == nullptr || in.status() != QDataStream::Ok || !parent->CanHaveChildren()) {
+      return false;
+    }
+
+    ItemPtr item = ProjectFile::ReadItemTree(data, parent);
+
+    if (item == nullptr) {
+      return false;
+    }
+
+    project_->footage_index()->AddTree(item.get());
+    project_->search_index()->AddTree(item.get());
+    return true;
+  }
+  case kRemoveItem:
+  {
+    Item* item = ReadItem(in);
+
+    if (item == nullptr || item->parent() == nullptr) {
+      return false;
+    }
+
+    project_->footage_index()->RemoveTree(item);
+    project_->search_index()->RemoveTree(item);
+
+    item->parent()->remove_child(item);
+    return true;
+  }
+  case kConnectEdge:
+  case kDisconnectEdge:
+  {
+    NodeParam* output = ReadParam(in);
+    NodeParam* input = ReadParam(in);
+
+    if (output == nullptr || input == nullptr
+        || output->type() != NodeParam::kOutput || input->type() != NodeParam::kInput) {
+      return false;
+    }
+
+    if (type == kConnectEdge) {
+      NodeParam::ConnectEdge(static_cast<NodeOutput*>(output), static_cast<NodeInput*>(input));
+    } else {
+      NodeParam::DisconnectEdge(static_cast<NodeOutput*>(output), static_cast<NodeInput*>(input));
+    }
+    return true;
+  }
+  case kBarrier:
+    break;
+  }
+
+  return false;
+}
+
+void ProjectJournal::StartWriter()
+{
+  if (writer_ != nullptr) {
+    writer_->Stop();
+    writer_->wait();
+    delete writer_;
+  }
+
+  writer_ = new ProjectJournalWriter(Filename(project_->filename()));
+  writer_->start();
+}
+
+void ProjectJournal::CommandAboutToApply(const QUndoCommand *command, bool undo)
+{
+  if (writer_ == nullptr || blocked_) {
+    return;
+  }
+
+  const UndoCommand* undo_command = dynamic_cast<const UndoCommand*>(command);
+
+  if (undo_command == nullptr) {
+    // Plain QUndoCommands can't describe what they change
+    Barrier();
+    return;
+  }
+
+  undo_command->Journal(this, undo);
+}
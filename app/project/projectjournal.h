@@ -0,0 +1,261 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTJOURNAL_H
+#define PROJECTJOURNAL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QUndoCommand>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "node/input.h"
+#include "node/output.h"
+#include "project/project.h"
+
+/**
+ * @brief An internal class only used by ProjectJournal
+ *
+ * Appends records to the journal file on its own thread and flushes them to disk, so the UI never waits on I/O.
+ */
+class ProjectJournalWriter : public QThread
+{
+public:
+  ProjectJournalWriter(const QString& filename);
+
+  /**
+   * @brief Replace the whole file with `header`, discarding anything not written yet
+   */
+  void Restart(const QByteArray& header);
+
+  /**
+   * @brief Queue bytes to append to the file
+   */
+  void Append(const QByteArray& data);
+
+  /**
+   * @brief Write everything queued and stop the thread
+   */
+  void Stop();
+
+  virtual void run() override;
+
+private:
+  QString filename_;
+
+  QMutex lock_;
+
+  QWaitCondition wait_;
+
+  QByteArray pending_;
+
+  QByteArray header_;
+
+  bool restart_;
+
+  bool stop_;
+};
+
+/**
+ * @brief Autosaves a project incrementally as a journal of the changes made since it was last saved
+ *
+ * Rewriting a whole project every few minutes stalls the UI on large projects. Instead, every undoable change is
+ * appended to a journal file next to the project (see Filename()) as it's made: the journal listens to
+ * UndoStack::AboutToApply() and asks each UndoCommand to describe its change (see UndoCommand::Journal()). Records are
+ * written and flushed to disk on a background thread.
+ *
+ * Each record carries its length and a checksum, so a record cut short by a crash is detected and everything before it
+ * is still recovered. The journal header identifies the project file it applies on top of, so a journal left behind by
+ * an older save is never replayed onto a newer one.
+ *
+ * Changes a command can't describe are recorded as a barrier (see Barrier()). Recovery stops there, since nothing after
+ * it could be replayed consistently, and nothing more is journaled until the project is saved again.
+ */
+class ProjectJournal : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief Create a journal for a project, which must already have been saved (see Project::filename())
+   *
+   * Nothing is journaled until Start() or Recover() is called.
+   */
+  ProjectJournal(Project* project, QObject* parent = nullptr);
+
+  /**
+   * @brief Destructor, writes out anything still queued
+   */
+  virtual ~ProjectJournal() override;
+
+  Project* project();
+
+  /**
+   * @brief The journal file used for a project file
+   */
+  static QString Filename(const QString& project_filename);
+
+  /**
+   * @brief Returns TRUE if a project file has a journal with changes that can be recovered
+   */
+  static bool HasChanges(const QString& project_filename);
+
+  /**
+   * @brief Begin a new, empty journal on top of the project file as it is now (e.g. right after saving it)
+   */
+  void Start();
+
+  /**
+   * @brief Replay the journal onto the project and keep journaling after it
+   *
+   * Must be called on a project that was just opened and isn't shown anywhere yet, since changes are applied to its
+   * Items and nodes directly. If the journal doesn't belong to the project file, a new one is started instead.
+   *
+   * @return
+   *
+   * The number of changes replayed.
+   */
+  int Recover();
+
+  /**
+   * @brief Record that an Item is about to be renamed
+   */
+  void RenameItem(Item* item, const QString& name);
+
+  /**
+   * @brief Record that an Item is about to be moved to the end of a folder
+   */
+  void MoveItem(Item* item, Item* destination);
+
+  /**
+   * @brief Record that an Item (and everything under it) is about to be added to the end of a folder
+   */
+  void AddItem(Item* parent, Item* item);
+
+  /**
+   * @brief Record that an Item is about to be removed from its folder
+   */
+  void RemoveItem(Item* item);
+
+  /**
+   * @brief Record that an output is about to be connected to an input (see NodeParam::ConnectEdge())
+   */
+  void ConnectEdge(NodeOutput* output, NodeInput* input);
+
+  /**
+   * @brief Record that an output is about to be disconnected from an input (see NodeParam::DisconnectEdge())
+   */
+  void DisconnectEdge(NodeOutput* output, NodeInput* input);
+
+  /**
+   * @brief Record a change the journal can't describe, ending what can be recovered until the next Start()
+   */
+  void Barrier();
+
+private:
+  enum RecordType {
+    kRenameItem,
+    kMoveItem,
+    kAddItem,
+    kRemoveItem,
+    kConnectEdge,
+    kDisconnectEdge,
+    kBarrier
+  };
+
+  /**
+   * @brief Length and checksum before each record's data
+   */
+  static const int kRecordHeaderSize = 6;
+
+  /**
+   * @brief Header identifying the project file as it is on disk now
+   */
+  static QByteArray Header(const QString& project_filename);
+
+  /**
+   * @brief Find where the records in a journal start
+   *
+   * @return
+   *
+   * The offset of the first record, or -1 if the journal doesn't apply to the project file.
+   */
+  static int RecordsStart(const QByteArray& journal, const QString& project_filename);
+
+  /**
+   * @brief Read the record at `offset` and move `offset` past it
+   *
+   * @return
+   *
+   * FALSE if there's no complete, intact record there.
+   */
+  static bool ReadRecord(const QByteArray& journal, int* offset, QByteArray* record);
+
+  /**
+   * @brief Write the indices leading from the project's root to an Item
+   *
+   * @return
+   *
+   * FALSE if the Item doesn't belong to this project.
+   */
+  bool WriteItem(QDataStream& out, Item* item);
+
+  Item* ReadItem(QDataStream& in);
+
+  bool WriteParam(QDataStream& out, NodeParam* param);
+
+  NodeParam* ReadParam(QDataStream& in);
+
+  /**
+   * @brief Queue a record for the writer
+   */
+  void Append(const QByteArray& record);
+
+  /**
+   * @brief Apply one record to the project
+   *
+   * @return
+   *
+   * FALSE if the record couldn't be applied (or is a barrier), in which case recovery stops.
+   */
+  bool Apply(const QByteArray& record);
+
+  /**
+   * @brief Start the writer if it isn't running yet
+   */
+  void StartWriter();
+
+  Project* project_;
+
+  ProjectJournalWriter* writer_;
+
+  // Set once a barrier has been written, nothing more is recorded until Start()
+  bool blocked_;
+
+private slots:
+  /**
+   * @brief Connected to UndoStack::AboutToApply()
+   */
+  void CommandAboutToApply(const QUndoCommand* command, bool undo);
+};
+
+#endif // PROJECTJOURNAL_H
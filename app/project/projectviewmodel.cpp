@@ -23,10 +23,17 @@
 #include <QDebug>
 #include <QMimeData>
 #include <QUrl>
+#include <algorithm>
 
 #include "core.h"
+#include "project/item/footage/footage.h"
+#include "project/item/itemupdatequeue.h"
+#include "project/item/sequence/sequence.h"
+#include "project/projectjournal.h"
 #include "undo/undostack.h"
 
+const int ProjectViewModel::kFetchBatchSize;
+
 ProjectViewModel::ProjectViewModel(QObject *parent) :
   QAbstractItemModel(parent),
   project_(nullptr)
@@ -35,6 +42,11 @@ ProjectViewModel::ProjectViewModel(QObject *parent) :
   columns_.append(kName);
   columns_.append(kDuration);
   columns_.append(kRate);
+
+  connect(&olive::item_updates,
+          SIGNAL(ItemsUpdated(const QVector<Item*>&)),
+          this,
+          SLOT(ItemsUpdated(const QVector<Item*>&)));
 }
 
 Project *ProjectViewModel::project()
@@ -48,6 +60,8 @@ void ProjectViewModel::set_project(Project *p)
 
   project_ = p;
 
+  fetched_.clear();
+
   endResetModel();
 }
 
@@ -95,13 +109,8 @@ int ProjectViewModel::rowCount(const QModelIndex &parent) const
     return 0;
   }
 
-  // If the index is the root, return the root child count
-  if (parent == QModelIndex()) {
-    return project_->root()->child_count();
-  }
-
-  // Otherwise, the index must contain a valid pointer, so we just return its child count
-  return GetItemObjectFromIndex(parent)->child_count();
+  // Only the children that have been fetched exist as far as views are concerned
+  return FetchedCount(GetItemObjectFromIndex(parent));
 }
 
 int ProjectViewModel::columnCount(const QModelIndex &parent) const
@@ -131,14 +140,36 @@ QVariant ProjectViewModel::data(const QModelIndex &index, int role) const
     case kName:
       return internal_item->name();
     case kDuration:
-      // FIXME Return actual information
-      return "00:00:00;00";
+      // Footage formats these once when it's probed
+      if (internal_item->type() == Item::kFootage) {
+        return static_cast<Footage*>(internal_item)->length_text();
+      }
+      break;
     case kRate:
-      // FIXME Return actual information
-      return "29.97 FPS";
+      if (internal_item->type() == Item::kFootage) {
+        return static_cast<Footage*>(internal_item)->rate_text();
+      }
+      break;
     }
   }
     break;
+  case kSortRole:
+    // Raw values so sorting doesn't have to parse the display text
+    switch (column_type) {
+    case kName:
+      return internal_item->name();
+    case kDuration:
+      if (internal_item->type() == Item::kFootage) {
+        return static_cast<Footage*>(internal_item)->length().ToDouble();
+      }
+      break;
+    case kRate:
+      if (internal_item->type() == Item::kFootage) {
+        return static_cast<Footage*>(internal_item)->rate().ToDouble();
+      }
+      break;
+    }
+    break;
   case Qt::DecorationRole:
     // If this is the first column, return the Item's icon
     if (column_type == kName) {
@@ -209,20 +240,36 @@ bool ProjectViewModel::setData(const QModelIndex &index, const QVariant &value,
 
 bool ProjectViewModel::canFetchMore(const QModelIndex &parent) const
 {
-  // Check if this is a valid index
-  if (parent.isValid()) {
-    Item* item = GetItemObjectFromIndex(parent);
+  if (project_ == nullptr) {
+    return false;
+  }
 
-    // Check if this item is a kFolder type
-    // If it's a folder, we always return TRUE in order to always show the "expand triangle" icon,
-    // even when there are no "physical" children
-    if (item->CanHaveChildren()) {
-      return true;
-    }
+  Item* item = GetItemObjectFromIndex(parent);
+
+  // The "expand triangle" for empty folders is handled by hasChildren()
+  return FetchedCount(item) < item->child_count();
+}
+
+void ProjectViewModel::fetchMore(const QModelIndex &parent)
+{
+  if (project_ == nullptr) {
+    return;
   }
 
-  // Otherwise, return default behavior
-  return QAbstractItemModel::canFetchMore(parent);
+  Item* item = GetItemObjectFromIndex(parent);
+
+  int fetched = FetchedCount(item);
+  int count = qMin(item->child_count() - fetched, kFetchBatchSize);
+
+  if (count <= 0) {
+    return;
+  }
+
+  beginInsertRows(parent, fetched, fetched + count - 1);
+
+  fetched_.insert(item, fetched + count);
+
+  endInsertRows();
 }
 
 Qt::ItemFlags ProjectViewModel::flags(const QModelIndex &index) const
@@ -382,65 +429,255 @@ bool ProjectViewModel::dropMimeData(const QMimeData *data, Qt::DropAction action
 
 void ProjectViewModel::AddChild(Item *parent, ItemPtr child)
 {
-  QModelIndex parent_index;
+  AddChildren(parent, {child});
+}
+
+void ProjectViewModel::RemoveChild(Item *parent, Item *child)
+{
+  project_->footage_index()->RemoveTree(child);
+  project_->search_index()->RemoveTree(child);
 
-  if (parent != project_->root()) {
-    parent_index = CreateIndexFromItem(parent);
+  int child_row = IndexOfChild(child);
+  int fetched = FetchedCount(parent);
+
+  // Views only need to know if they've fetched this child
+  if (child_row < fetched) {
+    beginRemoveRows(ParentIndex(parent), child_row, child_row);
+
+    parent->remove_child(child);
+    fetched_.insert(parent, fetched - 1);
+
+    endRemoveRows();
+  } else {
+    parent->remove_child(child);
+    fetched_.insert(parent, fetched);
   }
 
-  beginInsertRows(parent_index, parent->child_count(), parent->child_count());
+  ForgetFetched(child);
 
-  parent->add_child(child);
+  emit ItemsChanged();
+}
+
+void ProjectViewModel::AddChildren(Item *parent, const QList<ItemPtr> &children)
+{
+  if (children.isEmpty()) {
+    return;
+  }
+
+  foreach (ItemPtr child, children) {
+    project_->footage_index()->AddTree(child.get());
+    project_->search_index()->AddTree(child.get());
+  }
+
+  int count = parent->child_count();
+  int fetched = FetchedCount(parent);
+
+  // If views haven't fetched every child yet, they'll get these with the rest
+  if (fetched < count) {
+    fetched_.insert(parent, fetched);
+
+    foreach (ItemPtr child, children) {
+      parent->add_child(child);
+    }
+
+    emit ItemsChanged();
+
+    return;
+  }
+
+  beginInsertRows(ParentIndex(parent), count, count + children.size() - 1);
+
+  foreach (ItemPtr child, children) {
+    parent->add_child(child);
+  }
+
+  fetched_.insert(parent, count + children.size());
 
   endInsertRows();
+
+  emit ItemsChanged();
 }
 
-void ProjectViewModel::RemoveChild(Item *parent, Item *child)
+void ProjectViewModel::RemoveChildren(Item *parent, const QList<ItemPtr> &children)
 {
-  QModelIndex parent_index;
+  int count = parent->child_count();
+  int first_row = count - children.size();
+
+  // Children added with AddChildren() are usually still the last ones, check so they can be removed in one go
+  bool trailing = (first_row >= 0);
 
-  if (parent != project_->root()) {
-    parent_index = CreateIndexFromItem(parent);
+  for (int i=0;i<children.size() && trailing;i++) {
+    trailing = (parent->child(first_row + i) == children.at(i).get());
   }
 
-  int child_row = IndexOfChild(child);
+  if (!trailing) {
+    foreach (ItemPtr child, children) {
+      RemoveChild(parent, child.get());
+    }
+    return;
+  }
+
+  foreach (ItemPtr child, children) {
+    project_->footage_index()->RemoveTree(child.get());
+    project_->search_index()->RemoveTree(child.get());
+  }
+
+  int fetched = FetchedCount(parent);
+
+  // Views only need to know about the children they've fetched
+  if (first_row < fetched) {
+    beginRemoveRows(ParentIndex(parent), first_row, fetched - 1);
 
-  beginRemoveRows(parent_index, child_row, child_row);
+    parent->remove_children(first_row, children.size());
+    fetched_.insert(parent, first_row);
 
-  parent->remove_child(child);
+    endRemoveRows();
+  } else {
+    parent->remove_children(first_row, children.size());
+    fetched_.insert(parent, fetched);
+  }
+
+  foreach (ItemPtr child, children) {
+    ForgetFetched(child.get());
+  }
 
-  endRemoveRows();
+  emit ItemsChanged();
 }
 
 void ProjectViewModel::RenameChild(Item *item, const QString &name)
 {
   item->set_name(name);
 
+  project_->search_index()->Update(item);
+
+  emit ItemsChanged();
+
+  // Views that haven't fetched this item will see the new name when they do
+  if (IndexOfChild(item) >= FetchedCount(item->parent())) {
+    return;
+  }
+
   QModelIndex index = CreateIndexFromItem(item, columns_.indexOf(kName));
 
   emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
 }
 
-int ProjectViewModel::IndexOfChild(Item *item) const
+void ProjectViewModel::ItemsUpdated(const QVector<Item *> &items)
 {
-  // Find parent's index within its own parent
-  // (TODO: this model should handle sorting, which means it'll have to "know" the indices)
+  if (project_ == nullptr) {
+    return;
+  }
 
-  if (item == project_->root()) {
-    return -1;
+  // Rows of the updated Items, by folder
+  QHash<Item*, QVector<int> > rows;
+
+  foreach (Item* item, items) {
+    Item* parent = item->parent();
+
+    // Skip Items that aren't in this model's project
+    Item* ancestor = parent;
+
+    while (ancestor != nullptr && ancestor != project_->root()) {
+      ancestor = ancestor->parent();
+    }
+
+    if (ancestor == nullptr) {
+      continue;
+    }
+
+    // Views that haven't fetched this item will see the new data when they do
+    int row = IndexOfChild(item);
+
+    if (row < FetchedCount(parent)) {
+      rows[parent].append(row);
+    }
   }
 
-  Item* parent = item->parent();
+  int last_column = columns_.size() - 1;
+
+  for (QHash<Item*, QVector<int> >::iterator i=rows.begin();i!=rows.end();i++) {
+    Item* parent = i.key();
+    QVector<int>& parent_rows = i.value();
+
+    std::sort(parent_rows.begin(), parent_rows.end());
+
+    int range_start = 0;
 
-  if (parent != nullptr) {
-    for (int i=0;i<parent->child_count();i++) {
-      if (parent->child(i) == item) {
-        return i;
+    for (int j=1;j<=parent_rows.size();j++) {
+      if (j < parent_rows.size() && parent_rows.at(j) == parent_rows.at(j - 1) + 1) {
+        continue;
       }
+
+      emit dataChanged(CreateIndexFromItem(parent->child(parent_rows.at(range_start)), 0),
+                       CreateIndexFromItem(parent->child(parent_rows.at(j - 1)), last_column));
+
+      range_start = j;
     }
   }
+}
+
+int ProjectViewModel::FetchedCount(Item *parent) const
+{
+  return qMin(parent->child_count(), fetched_.value(parent, kFetchBatchSize));
+}
+
+QModelIndex ProjectViewModel::ParentIndex(Item *parent)
+{
+  if (parent == project_->root()) {
+    return QModelIndex();
+  }
+
+  return CreateIndexFromItem(parent);
+}
+
+qint64 ProjectViewModel::ItemCost(Item *item)
+{
+  qint64 cost = (item->name().size() + item->tooltip().size()) * static_cast<qint64>(sizeof(QChar));
+
+  switch (item->type()) {
+  case Item::kFolder:
+    cost += static_cast<qint64>(sizeof(Folder));
+    break;
+  case Item::kFootage:
+  {
+    Footage* footage = static_cast<Footage*>(item);
+
+    cost += static_cast<qint64>(sizeof(Footage))
+        + footage->filename().size() * static_cast<qint64>(sizeof(QChar))
+        + footage->stream_count() * static_cast<qint64>(sizeof(VideoStream));
+    break;
+  }
+  case Item::kSequence:
+    cost += static_cast<qint64>(sizeof(Sequence));
+    break;
+  }
+
+  return cost;
+}
+
+void ProjectViewModel::ForgetFetched(Item *item)
+{
+  if (!item->CanHaveChildren()) {
+    return;
+  }
 
-  return -1;
+  fetched_.remove(item);
+
+  for (int i=0;i<item->child_count();i++) {
+    ForgetFetched(item->child(i));
+  }
+}
+
+int ProjectViewModel::IndexOfChild(Item *item) const
+{
+  // Rows are cached by the Items themselves
+  // (TODO: this model should handle sorting, which means it'll have to "know" the indices)
+
+  if (item == project_->root()) {
+    return -1;
+  }
+
+  return item->row();
 }
 
 int ProjectViewModel::ChildCount(const QModelIndex &index)
@@ -475,17 +712,38 @@ bool ProjectViewModel::ItemIsParentOfChild(Item *parent, Item *child) const
 
 void ProjectViewModel::MoveItemInternal(Item *item, Item *destination)
 {
-  QModelIndex item_index = CreateIndexFromItem(item);
-
-  QModelIndex destination_index = CreateIndexFromItem(destination);
-
-  beginMoveRows(item_index.parent(), item_index.row(), item_index.row(), destination_index, destination->child_count());
+  Item* source = item->parent();
+  int source_row = IndexOfChild(item);
+  int source_fetched = FetchedCount(source);
+  int destination_count = destination->child_count();
+  int destination_fetched = FetchedCount(destination);
+
+  // Views may have fetched the item without having fetched the end of the destination or vice versa
+  bool source_visible = (source_row < source_fetched);
+  bool destination_visible = (destination_fetched == destination_count);
+
+  if (source_visible && destination_visible) {
+    beginMoveRows(ParentIndex(source), source_row, source_row, ParentIndex(destination), destination_count);
+  } else if (source_visible) {
+    beginRemoveRows(ParentIndex(source), source_row, source_row);
+  } else if (destination_visible) {
+    beginInsertRows(ParentIndex(destination), destination_count, destination_count);
+  }
 
-  ItemPtr item_ptr = item->parent()->shared_ptr_from_raw(item);
+  ItemPtr item_ptr = source->shared_ptr_from_raw(item);
 
   destination->add_child(item_ptr);
 
-  endMoveRows();
+  fetched_.insert(source, source_visible ? source_fetched - 1 : source_fetched);
+  fetched_.insert(destination, destination_visible ? destination_count + 1 : destination_fetched);
+
+  if (source_visible && destination_visible) {
+    endMoveRows();
+  } else if (source_visible) {
+    endRemoveRows();
+  } else if (destination_visible) {
+    endInsertRows();
+  }
 }
 
 QModelIndex ProjectViewModel::CreateIndexFromItem(Item *item, int column)
@@ -497,7 +755,7 @@ ProjectViewModel::MoveItemCommand::MoveItemCommand(ProjectViewModel *model,
                                                    Item *item,
                                                    Folder *destination,
                                                    QUndoCommand *parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   model_(model),
   item_(item),
   destination_(destination)
@@ -517,8 +775,13 @@ void ProjectViewModel::MoveItemCommand::undo()
   model_->MoveItemInternal(item_, source_);
 }
 
+void ProjectViewModel::MoveItemCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  journal->MoveItem(item_, undo ? source_ : destination_);
+}
+
 ProjectViewModel::RenameItemCommand::RenameItemCommand(ProjectViewModel* model, Item *item, const QString &name, QUndoCommand *parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   model_(model),
   item_(item),
   new_name_(name)
@@ -538,8 +801,39 @@ void ProjectViewModel::RenameItemCommand::undo()
   model_->RenameChild(item_, old_name_);
 }
 
+int ProjectViewModel::RenameItemCommand::id() const
+{
+  return kRenameItemMergeID;
+}
+
+bool ProjectViewModel::RenameItemCommand::mergeWith(const QUndoCommand *other)
+{
+  const RenameItemCommand* rename = static_cast<const RenameItemCommand*>(other);
+
+  if (rename->item_ != item_) {
+    return false;
+  }
+
+  // Keep our old name so undoing goes back to before the first rename
+  new_name_ = rename->new_name_;
+
+  return true;
+}
+
+qint64 ProjectViewModel::RenameItemCommand::memory_cost() const
+{
+  qint64 characters = old_name_.size() + new_name_.size();
+
+  return static_cast<qint64>(sizeof(*this)) + characters * static_cast<qint64>(sizeof(QChar));
+}
+
+void ProjectViewModel::RenameItemCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  journal->RenameItem(item_, undo ? old_name_ : new_name_);
+}
+
 ProjectViewModel::AddItemCommand::AddItemCommand(ProjectViewModel* model, Item* folder, ItemPtr child, QUndoCommand* parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   model_(model),
   parent_(folder),
   child_(child),
@@ -564,3 +858,72 @@ void ProjectViewModel::AddItemCommand::undo()
 
   done_ = false;
 }
+
+qint64 ProjectViewModel::AddItemCommand::memory_cost() const
+{
+  return static_cast<qint64>(sizeof(*this)) + ItemCost(child_.get());
+}
+
+void ProjectViewModel::AddItemCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  if (undo) {
+    journal->RemoveItem(child_.get());
+  } else {
+    journal->AddItem(parent_, child_.get());
+  }
+}
+
+ProjectViewModel::AddItemsCommand::AddItemsCommand(ProjectViewModel *model, Item *folder,
+                                                   const QList<ItemPtr> &children, QUndoCommand *parent) :
+  UndoCommand(parent),
+  model_(model),
+  parent_(folder),
+  children_(children)
+{
+}
+
+void ProjectViewModel::AddItemsCommand::redo()
+{
+  model_->AddChildren(parent_, children_);
+}
+
+void ProjectViewModel::AddItemsCommand::undo()
+{
+  model_->RemoveChildren(parent_, children_);
+}
+
+qint64 ProjectViewModel::AddItemsCommand::memory_cost() const
+{
+  qint64 cost = static_cast<qint64>(sizeof(*this));
+
+  foreach (ItemPtr child, children_) {
+    cost += static_cast<qint64>(sizeof(ItemPtr)) + ItemCost(child.get());
+  }
+
+  return cost;
+}
+
+void ProjectViewModel::AddItemsCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  if (!undo) {
+    foreach (ItemPtr child, children_) {
+      journal->AddItem(parent_, child.get());
+    }
+    return;
+  }
+
+  // Each removal is replayed before the next, so remove from the last row first to keep the others' rows valid
+  QList<Item*> children;
+
+  foreach (ItemPtr child, children_) {
+    children.append(child.get());
+  }
+
+  std::sort(children.begin(), children.end(), [](Item* a, Item* b) {
+    return a->row() > b->row();
+  });
+
+  foreach (Item* child, children) {
+    journal->RemoveItem(child);
+  }
+}
@@ -22,9 +22,9 @@
 #define VIEWMODEL_H
 
 #include <QAbstractItemModel>
-#include <QUndoCommand>
-
+#include <QHash>
 #include "project.h"
+#include "undo/undocommand.h"
 
 /**
  * @brief An adapter that interprets the data in a Project into a Qt item model for usage in ViewModel Views.
@@ -33,9 +33,15 @@
  * a ProjectViewModel), it may be better to make modifications (e.g. additions/removals/renames) through the
  * ProjectViewModel so that the views can be efficiently and correctly updated. ProjectViewModel contains several
  * "wrapper" functions for Project and Item functions that also signal any connected views to update accordingly.
+ *
+ * To keep very large projects responsive, folders are populated lazily: views are only shown the first
+ * kFetchBatchSize children of a folder and request the rest a batch at a time through canFetchMore()/fetchMore() as
+ * they scroll. Children that haven't been fetched can still be added, removed and moved, views just aren't told about
+ * them until they're fetched.
  */
 class ProjectViewModel : public QAbstractItemModel
 {
+  Q_OBJECT
 public:
   enum ColumnType {
     /// Media name
@@ -48,6 +54,13 @@ public:
     kRate
   };
 
+  /**
+   * @brief Data role returning a column's raw value (e.g. the length in seconds), for sorting
+   */
+  enum Role {
+    kSortRole = Qt::UserRole
+  };
+
   /**
    * @brief ProjectViewModel Constructor
    *
@@ -88,6 +101,7 @@ public:
   virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
   virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
   virtual bool canFetchMore(const QModelIndex &parent) const override;
+  virtual void fetchMore(const QModelIndex &parent) override;
 
   /** Drag and drop support */
   virtual Qt::ItemFlags flags(const QModelIndex &index) const override;
@@ -98,6 +112,16 @@ public:
   /** Other model functions */
   void AddChild(Item* parent, ItemPtr child);
   void RemoveChild(Item* parent, Item* child);
+
+  /**
+   * @brief Add several children to a parent with a single row insertion
+   */
+  void AddChildren(Item* parent, const QList<ItemPtr>& children);
+
+  /**
+   * @brief Remove several children from a parent, with a single row removal if they're its last children
+   */
+  void RemoveChildren(Item* parent, const QList<ItemPtr>& children);
   void RenameChild(Item* item, const QString& name);
 
   /**
@@ -108,7 +132,7 @@ public:
   /**
    * @brief A QUndoCommand for moving an item from one folder to another folder
    */
-  class MoveItemCommand : public QUndoCommand {
+  class MoveItemCommand : public UndoCommand {
   public:
     MoveItemCommand(ProjectViewModel* model, Item* item, Folder* destination, QUndoCommand* parent = nullptr);
 
@@ -116,6 +140,8 @@ public:
 
     virtual void undo() override;
 
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
   private:
     ProjectViewModel* model_;
     Item* item_;
@@ -127,7 +153,7 @@ public:
   /**
    * @brief A QUndoCommand for renaming an item
    */
-  class RenameItemCommand : public QUndoCommand {
+  class RenameItemCommand : public UndoCommand {
   public:
     RenameItemCommand(ProjectViewModel* model, Item* item, const QString& name, QUndoCommand* parent = nullptr);
 
@@ -135,6 +161,16 @@ public:
 
     virtual void undo() override;
 
+    /**
+     * @brief Renames of the same Item in quick succession are merged into one
+     */
+    virtual int id() const override;
+    virtual bool mergeWith(const QUndoCommand* other) override;
+
+    virtual qint64 memory_cost() const override;
+
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
   private:
     ProjectViewModel* model_;
     Item* item_;
@@ -145,7 +181,7 @@ public:
   /**
    * @brief A QUndoCommand for adding an item
    */
-  class AddItemCommand : public QUndoCommand {
+  class AddItemCommand : public UndoCommand {
   public:
     AddItemCommand(ProjectViewModel* model, Item* folder, ItemPtr child, QUndoCommand* parent = nullptr);
 
@@ -155,13 +191,82 @@ public:
 
     virtual void undo() override;
 
+    virtual qint64 memory_cost() const override;
+
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
   private:
     ProjectViewModel* model_;
     Item* parent_;
     ItemPtr child_;
     bool done_;
   };
+
+  /**
+   * @brief A QUndoCommand for adding several items to the same folder at once
+   *
+   * Views are only notified of one insertion, which is much faster than an AddItemCommand per item when importing
+   * large folders.
+   */
+  class AddItemsCommand : public UndoCommand {
+  public:
+    AddItemsCommand(ProjectViewModel* model, Item* folder, const QList<ItemPtr>& children,
+                    QUndoCommand* parent = nullptr);
+
+    virtual void redo() override;
+
+    virtual void undo() override;
+
+    virtual qint64 memory_cost() const override;
+
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
+  private:
+    ProjectViewModel* model_;
+    Item* parent_;
+    QList<ItemPtr> children_;
+  };
+
+signals:
+  /**
+   * @brief Emitted after Items have been added, removed or renamed (whether or not views have fetched them)
+   */
+  void ItemsChanged();
+
+private slots:
+  /**
+   * @brief Tell views about Items whose icon or tooltip changed (see ItemUpdateQueue)
+   *
+   * Emits one dataChanged() per contiguous range of fetched rows in each folder rather than one per Item.
+   */
+  void ItemsUpdated(const QVector<Item*>& items);
+
 private:
+  /**
+   * @brief Number of children views are shown at first and with every fetchMore()
+   */
+  static const int kFetchBatchSize = 1000;
+
+  /**
+   * @brief Number of a folder's children that views have been told about (see fetchMore())
+   */
+  int FetchedCount(Item* parent) const;
+
+  /**
+   * @brief Index to use as the parent of a folder's children in row change signals
+   */
+  QModelIndex ParentIndex(Item* parent);
+
+  /**
+   * @brief Estimate the memory used by an Item itself (not its children), for UndoCommand::memory_cost()
+   */
+  static qint64 ItemCost(Item* item);
+
+  /**
+   * @brief Forget the fetched counts of an Item and of everything under it once it's been removed
+   */
+  void ForgetFetched(Item* item);
+
   /**
    * @brief Retrieve the index of `item` in its parent
    *
@@ -213,6 +318,11 @@ private:
 
   Project* project_;
 
+  /**
+   * @brief Folders whose fetched count isn't the default (see FetchedCount())
+   */
+  QHash<Item*, int> fetched_;
+
   QVector<ColumnType> columns_;
 };
 
@@ -0,0 +1,184 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "allocationcounters.h"
+
+#include <QAtomicInteger>
+#include <QStringList>
+
+namespace {
+
+struct Counter {
+  QAtomicInteger<qint64> live_bytes;
+  QAtomicInteger<qint64> peak_bytes;
+  QAtomicInteger<qint64> live_count;
+};
+
+Counter counters[AllocationCounters::kKindCount][AllocationCounters::kTagCount];
+
+Counter total;
+
+thread_local AllocationCounters::Tag current_tag = AllocationCounters::kOther;
+
+void Add(Counter& c, qint64 bytes, qint64 count)
+{
+  qint64 live = c.live_bytes.fetchAndAddRelaxed(bytes) + bytes;
+
+  c.live_count.fetchAndAddRelaxed(count);
+
+  qint64 peak = c.peak_bytes.load();
+
+  while (live > peak && !c.peak_bytes.testAndSetRelaxed(peak, live)) {
+    peak = c.peak_bytes.load();
+  }
+}
+
+AllocationCounters::Usage Read(const Counter& c)
+{
+  AllocationCounters::Usage u;
+
+  u.live_bytes = c.live_bytes.load();
+  u.peak_bytes = c.peak_bytes.load();
+  u.live_count = c.live_count.load();
+
+  return u;
+}
+
+QString Megabytes(qint64 bytes)
+{
+  return QString::number(static_cast<double>(bytes) / 1048576.0, 'f', 1);
+}
+
+}
+
+AllocationCounters::Usage::Usage() :
+  live_bytes(0),
+  peak_bytes(0),
+  live_count(0)
+{
+}
+
+void AllocationCounters::Allocated(AllocationCounters::Kind kind, AllocationCounters::Tag tag, qint64 bytes)
+{
+  Add(counters[kind][tag], bytes, 1);
+  Add(total, bytes, 1);
+}
+
+void AllocationCounters::Freed(AllocationCounters::Kind kind, AllocationCounters::Tag tag, qint64 bytes)
+{
+  Add(counters[kind][tag], -bytes, -1);
+  Add(total, -bytes, -1);
+}
+
+AllocationCounters::Usage AllocationCounters::Get(AllocationCounters::Kind kind, AllocationCounters::Tag tag)
+{
+  return Read(counters[kind][tag]);
+}
+
+AllocationCounters::Usage AllocationCounters::Total()
+{
+  return Read(total);
+}
+
+QString AllocationCounters::Dump()
+{
+  QStringList lines;
+
+  for (int i=0;i<kTagCount;i++) {
+    for (int j=0;j<kKindCount;j++) {
+      Usage u = Get(static_cast<Kind>(j), static_cast<Tag>(i));
+
+      // Skip what's never been used
+      if (u.peak_bytes == 0) {
+        continue;
+      }
+
+      lines.append(QStringLiteral("%1/%2: %3 MiB in %4 (peak %5 MiB)").arg(TagName(static_cast<Tag>(i)),
+                                                                          KindName(static_cast<Kind>(j)),
+                                                                          Megabytes(u.live_bytes),
+                                                                          QString::number(u.live_count),
+                                                                          Megabytes(u.peak_bytes)));
+    }
+  }
+
+  Usage t = Total();
+
+  lines.append(QStringLiteral("Total: %1 MiB in %2 (peak %3 MiB)").arg(Megabytes(t.live_bytes),
+                                                                      QString::number(t.live_count),
+                                                                      Megabytes(t.peak_bytes)));
+
+  return lines.join('\n');
+}
+
+const char *AllocationCounters::KindName(AllocationCounters::Kind kind)
+{
+  switch (kind) {
+  case kFrame:
+    return "Frame";
+  case kMemoryBuffer:
+    return "MemoryBuffer";
+  case kTextureBuffer:
+    return "TextureBuffer";
+  case kKindCount:
+    break;
+  }
+
+  return "";
+}
+
+const char *AllocationCounters::TagName(AllocationCounters::Tag tag)
+{
+  switch (tag) {
+  case kOther:
+    return "Other";
+  case kDecoder:
+    return "Decoder";
+  case kImageCache:
+    return "ImageCache";
+  case kFrameCache:
+    return "FrameCache";
+  case kStreamFrameCache:
+    return "StreamFrameCache";
+  case kRenderer:
+    return "Renderer";
+  case kExport:
+    return "Export";
+  case kTagCount:
+    break;
+  }
+
+  return "";
+}
+
+AllocationCounters::Tag AllocationCounters::CurrentTag()
+{
+  return current_tag;
+}
+
+AllocationCounters::ScopedTag::ScopedTag(AllocationCounters::Tag tag) :
+  previous_(current_tag)
+{
+  current_tag = tag;
+}
+
+AllocationCounters::ScopedTag::~ScopedTag()
+{
+  current_tag = previous_;
+}
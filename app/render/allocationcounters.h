@@ -0,0 +1,125 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ALLOCATIONCOUNTERS_H
+#define ALLOCATIONCOUNTERS_H
+
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Application-wide counts of the memory held by frames and image buffers, by subsystem
+ *
+ * Frame, MemoryBuffer and TextureBuffer report their allocations here, tagged with the subsystem that was current on
+ * the allocating thread (see ScopedTag), so it's possible to tell which cache is holding memory during a long session
+ * (or leaking it). Like PerformanceCounters, reporting is a couple of relaxed atomic operations, so it's always on.
+ *
+ * Frames count the buffers they reference, so a decoded frame referenced by two Frame objects counts twice. Textures
+ * count their base level only.
+ */
+class AllocationCounters
+{
+public:
+  enum Kind {
+    /// Decoded footage (Frame)
+    kFrame,
+
+    /// Images in system memory (MemoryBuffer)
+    kMemoryBuffer,
+
+    /// Textures in VRAM (TextureBuffer)
+    kTextureBuffer,
+
+    kKindCount
+  };
+
+  enum Tag {
+    /// Allocated outside of any ScopedTag
+    kOther,
+
+    /// Decoders and their look-ahead
+    kDecoder,
+
+    /// ImageCache
+    kImageCache,
+
+    /// FrameCache
+    kFrameCache,
+
+    /// StreamFrameCache
+    kStreamFrameCache,
+
+    /// Render threads (node processing, tiles and stitched frames)
+    kRenderer,
+
+    /// Exports and headless renders
+    kExport,
+
+    kTagCount
+  };
+
+  struct Usage {
+    Usage();
+
+    qint64 live_bytes;
+    qint64 peak_bytes;
+    qint64 live_count;
+  };
+
+  static void Allocated(Kind kind, Tag tag, qint64 bytes);
+
+  static void Freed(Kind kind, Tag tag, qint64 bytes);
+
+  static Usage Get(Kind kind, Tag tag);
+
+  /**
+   * @brief Usage of every kind and tag together (the peak is the highest total, not a sum of peaks)
+   */
+  static Usage Total();
+
+  /**
+   * @brief A human-readable table of every kind and tag that has allocated something
+   */
+  static QString Dump();
+
+  static const char* KindName(Kind kind);
+
+  static const char* TagName(Tag tag);
+
+  /**
+   * @brief The tag allocations on this thread are counted under
+   */
+  static Tag CurrentTag();
+
+  /**
+   * @brief Counts allocations on this thread under a tag until it's destroyed
+   */
+  class ScopedTag {
+  public:
+    ScopedTag(Tag tag);
+
+    ~ScopedTag();
+
+  private:
+    Tag previous_;
+  };
+};
+
+#endif // ALLOCATIONCOUNTERS_H
@@ -0,0 +1,215 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "channelpacker.h"
+
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief Check whether alpha is the same everywhere and whether R, G and B are equal everywhere
+ *
+ * T is an unsigned integer the size of a channel, so float channels are compared by their exact bits.
+ */
+template<typename T>
+void Analyze(const MemoryBuffer& buffer, bool* constant_alpha, bool* grey)
+{
+  T alpha = reinterpret_cast<const T*>(buffer.const_row(0))[3];
+
+  *constant_alpha = true;
+  *grey = true;
+
+  for (int y=0;y<buffer.height();y++) {
+    const T* pixel = reinterpret_cast<const T*>(buffer.const_row(y));
+
+    for (int x=0;x<buffer.width();x++) {
+      if (pixel[3] != alpha) {
+        // Nothing can be dropped without a constant alpha, so there's no point looking further
+        *constant_alpha = false;
+        return;
+      }
+
+      if (pixel[0] != pixel[1] || pixel[0] != pixel[2]) {
+        *grey = false;
+      }
+
+      pixel += 4;
+    }
+  }
+}
+
+template<typename T>
+void PackPixels(const MemoryBuffer& buffer, int channels, T* out)
+{
+  // The constant alpha value goes first
+  *out = reinterpret_cast<const T*>(buffer.const_row(0))[3];
+  out++;
+
+  for (int y=0;y<buffer.height();y++) {
+    const T* pixel = reinterpret_cast<const T*>(buffer.const_row(y));
+
+    for (int x=0;x<buffer.width();x++) {
+      for (int c=0;c<channels;c++) {
+        out[c] = pixel[c];
+      }
+
+      out += channels;
+      pixel += 4;
+    }
+  }
+}
+
+template<typename T>
+void UnpackPixels(const T* in, int channels, MemoryBuffer* buffer)
+{
+  T alpha = *in;
+  in++;
+
+  for (int y=0;y<buffer->height();y++) {
+    T* pixel = reinterpret_cast<T*>(buffer->row(y));
+
+    for (int x=0;x<buffer->width();x++) {
+      pixel[0] = in[0];
+      pixel[1] = in[channels == 1 ? 0 : 1];
+      pixel[2] = in[channels == 1 ? 0 : 2];
+      pixel[3] = alpha;
+
+      in += channels;
+      pixel += 4;
+    }
+  }
+}
+
+}
+
+QByteArray ChannelPacker::Pack(const MemoryBuffer &buffer, ChannelPacker::Layout *layout)
+{
+  *layout = kRGBA;
+
+  QByteArray unpacked = QByteArray::fromRawData(reinterpret_cast<const char*>(buffer.const_data()), buffer.size());
+
+  int channel_size = BytesPerChannel(buffer.format());
+
+  if (channel_size == 0 || !buffer.IsCreated() || buffer.width() <= 0 || buffer.height() <= 0) {
+    return unpacked;
+  }
+
+  bool constant_alpha = false;
+  bool grey = false;
+
+  switch (channel_size) {
+  case 1:
+    Analyze<quint8>(buffer, &constant_alpha, &grey);
+    break;
+  case 2:
+    Analyze<quint16>(buffer, &constant_alpha, &grey);
+    break;
+  case 4:
+    Analyze<quint32>(buffer, &constant_alpha, &grey);
+    break;
+  }
+
+  if (!constant_alpha) {
+    return unpacked;
+  }
+
+  *layout = grey ? kGrey : kRGB;
+
+  int channels = grey ? 1 : 3;
+
+  QByteArray packed;
+  packed.resize(channel_size * (1 + buffer.width() * buffer.height() * channels));
+
+  switch (channel_size) {
+  case 1:
+    PackPixels<quint8>(buffer, channels, reinterpret_cast<quint8*>(packed.data()));
+    break;
+  case 2:
+    PackPixels<quint16>(buffer, channels, reinterpret_cast<quint16*>(packed.data()));
+    break;
+  case 4:
+    PackPixels<quint32>(buffer, channels, reinterpret_cast<quint32*>(packed.data()));
+    break;
+  }
+
+  return packed;
+}
+
+bool ChannelPacker::Unpack(const QByteArray &data, ChannelPacker::Layout layout, MemoryBuffer *buffer)
+{
+  if (!buffer->IsCreated()) {
+    return false;
+  }
+
+  if (layout == kRGBA) {
+    if (data.size() != buffer->size()) {
+      return false;
+    }
+
+    memcpy(buffer->data(), data.constData(), static_cast<size_t>(data.size()));
+
+    return true;
+  }
+
+  int channel_size = BytesPerChannel(buffer->format());
+  int channels = (layout == kGrey) ? 1 : 3;
+
+  if (channel_size == 0
+      || (layout != kRGB && layout != kGrey)
+      || data.size() != channel_size * (1 + buffer->width() * buffer->height() * channels)) {
+    return false;
+  }
+
+  switch (channel_size) {
+  case 1:
+    UnpackPixels<quint8>(reinterpret_cast<const quint8*>(data.constData()), channels, buffer);
+    break;
+  case 2:
+    UnpackPixels<quint16>(reinterpret_cast<const quint16*>(data.constData()), channels, buffer);
+    break;
+  case 4:
+    UnpackPixels<quint32>(reinterpret_cast<const quint32*>(data.constData()), channels, buffer);
+    break;
+  }
+
+  return true;
+}
+
+int ChannelPacker::BytesPerChannel(const olive::PixelFormat &format)
+{
+  switch (format) {
+  case olive::PIX_FMT_RGBA8:
+    return 1;
+  case olive::PIX_FMT_RGBA16:
+  case olive::PIX_FMT_RGBA16F:
+    return 2;
+  case olive::PIX_FMT_RGBA32F:
+    return 4;
+  case olive::PIX_FMT_RGB10A2:
+  case olive::PIX_FMT_RG11B10F:
+  case olive::PIX_FMT_R8:
+  case olive::PIX_FMT_R16F:
+  case olive::PIX_FMT_COUNT:
+    break;
+  }
+
+  return 0;
+}
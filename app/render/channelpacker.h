@@ -0,0 +1,87 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CHANNELPACKER_H
+#define CHANNELPACKER_H
+
+#include <QByteArray>
+
+#include "render/memorybuffer.h"
+
+/**
+ * @brief Stores RGBA frames without the channels that carry no information, for caches that keep frames as bytes
+ *
+ * Many cached frames are opaque (alpha is the same everywhere) and many of those are greyscale mattes (R, G and B
+ * are equal too), so storing every channel of them is mostly storing the same value over and over. Pack() checks a
+ * frame and stores its constant alpha value once followed by only the RGB or single grey channel of each pixel, which
+ * for a matte in RGBA16F is a quarter of the size. Unpack() rebuilds the exact RGBA values, the packing is lossless.
+ *
+ * Only the RGBA formats are packed, frames in other formats are always stored as kRGBA.
+ */
+class ChannelPacker
+{
+public:
+  /**
+   * @brief How packed data is laid out (stored in file headers, so values mustn't change)
+   */
+  enum Layout {
+    /// Every channel of every pixel, rows padded exactly as in the MemoryBuffer
+    kRGBA = 0,
+
+    /// The alpha value followed by the R, G and B channels of every pixel, no row padding
+    kRGB = 1,
+
+    /// The alpha value followed by one channel of every pixel (R, G and B are equal), no row padding
+    kGrey = 2,
+
+    kLayoutCount
+  };
+
+  /**
+   * @brief Pack a buffer into the smallest layout that stores it losslessly
+   *
+   * @param layout
+   *
+   * Set to the layout the returned data is in.
+   *
+   * @return
+   *
+   * The packed data. For kRGBA it's the buffer's own data (not copied), so it's only valid while the buffer is
+   * unchanged.
+   */
+  static QByteArray Pack(const MemoryBuffer& buffer, Layout* layout);
+
+  /**
+   * @brief Restore data returned by Pack() into a buffer created with the packed buffer's size and format
+   *
+   * @return
+   *
+   * FALSE if the data doesn't fit the buffer (e.g. it's corrupt).
+   */
+  static bool Unpack(const QByteArray& data, Layout layout, MemoryBuffer* buffer);
+
+private:
+  /**
+   * @brief Bytes in each channel of a format, or 0 if its channels can't be dropped individually
+   */
+  static int BytesPerChannel(const olive::PixelFormat& format);
+};
+
+#endif // CHANNELPACKER_H
@@ -0,0 +1,286 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "colormanagement.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+#include "cpurender.h"
+#include "gl/shadergenerators.h"
+
+namespace {
+
+// Input processors by config and input color space (null for inputs that need no conversion)
+QHash<QString, OCIO::ConstProcessorRcPtr> input_processors;
+
+QMutex input_processors_mutex;
+
+/**
+ * @brief A 3D LUT baked from a processor for olive::color::kApproximate
+ *
+ * Holds a reference to the processor so its address can't be reused by another one while the LUT is cached.
+ */
+struct BakedLut {
+  OCIO::ConstProcessorRcPtr processor;
+  QVector<float> lut;
+};
+
+QHash<const OCIO::Processor*, std::shared_ptr<BakedLut> > baked_luts;
+
+QMutex baked_luts_mutex;
+
+// Displays assigned with olive::color::SetScreenDisplay() by screen name
+QHash<QString, olive::color::DisplayView> screen_displays;
+
+QMutex screen_displays_mutex;
+
+std::shared_ptr<BakedLut> GetBakedLut(OCIO::ConstProcessorRcPtr processor)
+{
+  QMutexLocker locker(&baked_luts_mutex);
+
+  std::shared_ptr<BakedLut> baked = baked_luts.value(processor.get());
+
+  if (baked) {
+    return baked;
+  }
+
+  const int size = olive::color::kLutSize;
+  const int entries = size * size * size;
+
+  baked = std::make_shared<BakedLut>();
+  baked->processor = processor;
+  baked->lut.resize(entries * 4);
+
+  float* lut = baked->lut.data();
+
+  for (int b=0;b<size;b++) {
+    for (int g=0;g<size;g++) {
+      for (int r=0;r<size;r++) {
+        float* entry = lut + (r + g * size + b * size * size) * 4;
+
+        entry[0] = static_cast<float>(r) / static_cast<float>(size - 1);
+        entry[1] = static_cast<float>(g) / static_cast<float>(size - 1);
+        entry[2] = static_cast<float>(b) / static_cast<float>(size - 1);
+        entry[3] = 1.0f;
+      }
+    }
+  }
+
+  // The whole lattice goes through the processor as one image
+  OCIO::PackedImageDesc desc(lut, entries, 1, 4);
+  processor->apply(desc);
+
+  baked_luts.insert(processor.get(), baked);
+
+  return baked;
+}
+
+}
+
+OCIO::ConstConfigRcPtr olive::color::GetConfig()
+{
+  return OCIO::GetCurrentConfig();
+}
+
+QString olive::color::GetWorkingSpace(OCIO::ConstConfigRcPtr config)
+{
+  OCIO::ConstColorSpaceRcPtr space = config->getColorSpace(OCIO::ROLE_SCENE_LINEAR);
+
+  if (!space) {
+    return QString();
+  }
+
+  return space->getName();
+}
+
+OCIO::ConstProcessorRcPtr olive::color::GetInputProcessor(OCIO::ConstConfigRcPtr config, const QString &input_space)
+{
+  QString working_space = GetWorkingSpace(config);
+
+  if (input_space.isEmpty() || working_space.isEmpty() || input_space == working_space) {
+    return nullptr;
+  }
+
+  QString key = QStringList({config->getCacheID(), input_space}).join('\n');
+
+  QMutexLocker locker(&input_processors_mutex);
+
+  if (input_processors.contains(key)) {
+    return input_processors.value(key);
+  }
+
+  OCIO::ConstProcessorRcPtr processor;
+
+  try {
+    processor = config->getProcessor(input_space.toUtf8().constData(), working_space.toUtf8().constData());
+  } catch (OCIO::Exception& e) {
+    qWarning() << "Failed to create OCIO processor:" << e.what();
+  }
+
+  // Spaces that are aliases of each other need no conversion either
+  if (processor && processor->isNoOp()) {
+    processor = nullptr;
+  }
+
+  input_processors.insert(key, processor);
+
+  return processor;
+}
+
+OCIO::ConstProcessorRcPtr olive::color::GetDisplayProcessor(OCIO::ConstConfigRcPtr config,
+                                                            const QString &display,
+                                                            const QString &view)
+{
+  QString working_space = GetWorkingSpace(config);
+
+  if (working_space.isEmpty()) {
+    return nullptr;
+  }
+
+  QString display_name = display.isEmpty() ? QString(config->getDefaultDisplay()) : display;
+  QString view_name = view.isEmpty() ? QString(config->getDefaultView(display_name.toUtf8().constData())) : view;
+
+  OCIO::ConstProcessorRcPtr processor = olive::gl::GetOCIODisplayProcessor(config,
+                                                                           working_space,
+                                                                           display_name,
+                                                                           view_name);
+
+  if (processor && processor->isNoOp()) {
+    return nullptr;
+  }
+
+  return processor;
+}
+
+void olive::color::SetScreenDisplay(const QString &screen, const QString &display, const QString &view)
+{
+  QMutexLocker locker(&screen_displays_mutex);
+
+  DisplayView assignment;
+  assignment.display = display;
+  assignment.view = view;
+
+  screen_displays.insert(screen, assignment);
+}
+
+olive::color::DisplayView olive::color::GetScreenDisplay(OCIO::ConstConfigRcPtr config, QScreen *screen)
+{
+  DisplayView result;
+
+  if (screen != nullptr) {
+    QMutexLocker locker(&screen_displays_mutex);
+
+    result = screen_displays.value(screen->name());
+  }
+
+  if (result.display.isEmpty() && screen != nullptr) {
+    // Look for a display named after the screen itself
+    QStringList screen_names({screen->name()});
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    if (!screen->model().isEmpty()) {
+      screen_names.append(screen->model());
+    }
+#endif
+
+    for (int i=0;i<config->getNumDisplays() && result.display.isEmpty();i++) {
+      QString display = config->getDisplay(i);
+
+      if (screen_names.contains(display, Qt::CaseInsensitive)) {
+        result.display = display;
+      }
+    }
+  }
+
+  if (result.display.isEmpty()) {
+    result.display = config->getDefaultDisplay();
+  }
+
+  if (result.view.isEmpty()) {
+    result.view = config->getDefaultView(result.display.toUtf8().constData());
+  }
+
+  return result;
+}
+
+void olive::color::ApplyToBuffer(OCIO::ConstProcessorRcPtr processor,
+                                 MemoryBuffer *buffer,
+                                 bool associated,
+                                 ProcessorQuality quality)
+{
+  Q_ASSERT(buffer->format() == olive::PIX_FMT_RGBA32F);
+
+  if (quality == kApproximate) {
+    std::shared_ptr<BakedLut> baked = GetBakedLut(processor);
+
+    olive::cpu::ApplyLut3D(buffer, baked->lut.constData(), kLutSize, associated);
+    return;
+  }
+
+  int width = buffer->width();
+
+  olive::cpu::ForEachStripe(buffer->height(), width, [&](int start, int end) {
+    if (associated) {
+      for (int y=start;y<end;y++) {
+        float* row = reinterpret_cast<float*>(buffer->row(y));
+
+        for (int x=0;x<width;x++) {
+          float* px = row + x * 4;
+
+          if (px[3] > 0.0f) {
+            float inv = 1.0f / px[3];
+
+            px[0] *= inv;
+            px[1] *= inv;
+            px[2] *= inv;
+          }
+        }
+      }
+    }
+
+    // Processors are thread-safe, each stripe is applied as one image with the buffer's row padding as its stride
+    OCIO::PackedImageDesc desc(reinterpret_cast<float*>(buffer->row(start)),
+                               width,
+                               end - start,
+                               4,
+                               static_cast<ptrdiff_t>(sizeof(float)),
+                               static_cast<ptrdiff_t>(sizeof(float) * 4),
+                               static_cast<ptrdiff_t>(buffer->linesize()));
+    processor->apply(desc);
+
+    if (associated) {
+      for (int y=start;y<end;y++) {
+        float* row = reinterpret_cast<float*>(buffer->row(y));
+
+        for (int x=0;x<width;x++) {
+          float* px = row + x * 4;
+
+          px[0] *= px[3];
+          px[1] *= px[3];
+          px[2] *= px[3];
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,141 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COLORMANAGEMENT_H
+#define COLORMANAGEMENT_H
+
+#include <QScreen>
+#include <QString>
+
+#include <OpenColorIO/OpenColorIO.h>
+namespace OCIO = OCIO_NAMESPACE::v1;
+
+#include "memorybuffer.h"
+#include "pixelformat.h"
+
+namespace olive {
+namespace color {
+
+/**
+ * @brief The renderer's working configuration
+ *
+ * Nodes pass images to each other in one space: the OCIO config's scene linear role, in RGBA16F with associated alpha.
+ * Footage is converted into it exactly once where it enters the graph (see GetInputProcessor()) and the result is
+ * converted for the display exactly once where it's shown (see GetDisplayProcessor()). Nodes in between never
+ * convert, so chains of nodes don't pay for color transforms between every pair of them.
+ */
+
+/**
+ * @brief Pixel format of every image passed between nodes
+ */
+const olive::PixelFormat kWorkingFormat = olive::PIX_FMT_RGBA16F;
+
+/**
+ * @brief Returns the OCIO config in use (from the OCIO environment variable, or OCIO's built-in raw config)
+ */
+OCIO::ConstConfigRcPtr GetConfig();
+
+/**
+ * @brief Returns the name of the working space in a config (its scene linear role), or an empty string if it has none
+ */
+QString GetWorkingSpace(OCIO::ConstConfigRcPtr config);
+
+/**
+ * @brief Returns a processor converting footage in a color space to the working space
+ *
+ * Processors are cached. Returns nullptr if no conversion is needed, i.e. `input_space` is empty, is already the
+ * working space or converts to it without changing anything, so callers can skip drawing the footage through OCIO.
+ */
+OCIO::ConstProcessorRcPtr GetInputProcessor(OCIO::ConstConfigRcPtr config, const QString& input_space);
+
+/**
+ * @brief Returns a processor converting the working space to a display and view
+ *
+ * Empty names use the config's default display and that display's default view. Returns nullptr if no conversion is
+ * needed (see GetInputProcessor()).
+ */
+OCIO::ConstProcessorRcPtr GetDisplayProcessor(OCIO::ConstConfigRcPtr config,
+                                              const QString& display = QString(),
+                                              const QString& view = QString());
+
+/**
+ * @brief A display and view of an OCIO config
+ */
+struct DisplayView {
+  QString display;
+  QString view;
+};
+
+/**
+ * @brief Assign a display and view to the screen called `screen` (see QScreen::name())
+ *
+ * Empty names use the config's default display or that display's default view. Assignments only affect
+ * GetScreenDisplay(), so viewers pick them up the next time they're shown or moved to another screen.
+ */
+void SetScreenDisplay(const QString& screen, const QString& display, const QString& view = QString());
+
+/**
+ * @brief Returns the display and view to show images on a screen with
+ *
+ * Uses the screen's assignment from SetScreenDisplay() if it has one. Otherwise it uses the config's display named
+ * after the screen or its model (so a config can carry a display for each calibrated monitor), falling back to the
+ * config's default display. Both names are always filled in, so the result identifies the transform and can be
+ * passed straight to GetDisplayProcessor().
+ */
+DisplayView GetScreenDisplay(OCIO::ConstConfigRcPtr config, QScreen* screen);
+
+/**
+ * @brief How ApplyToBuffer() applies a processor
+ */
+enum ProcessorQuality {
+  /// Every pixel goes through the processor itself
+  kExact,
+
+  /// Pixels are looked up in a kLutSize 3D LUT baked from the processor (and cached with it), which is many times
+  /// faster for complex transforms. Colors are clamped to 0.0-1.0 first, so it's only suitable for display-referred
+  /// images (e.g. 8-bit footage) and for previews that are never exported.
+  kApproximate
+};
+
+/**
+ * @brief Number of entries along each axis of the LUTs kApproximate uses
+ */
+const int kLutSize = 33;
+
+/**
+ * @brief Apply a processor to an RGBA32F buffer on the CPU, for rendering without a GPU
+ *
+ * The buffer is split into stripes of rows converted in parallel (see olive::cpu::ForEachStripe()), each passed to
+ * OCIO as a single packed image so its own optimized loops handle whole stripes rather than single rows.
+ *
+ * @param associated
+ *
+ * Whether the buffer's color is multiplied by alpha (it's divided before applying the processor and multiplied again
+ * after). Pass FALSE for opaque images to skip that.
+ */
+void ApplyToBuffer(OCIO::ConstProcessorRcPtr processor,
+                   MemoryBuffer* buffer,
+                   bool associated,
+                   ProcessorQuality quality = kExact);
+
+}
+}
+
+#endif // COLORMANAGEMENT_H
@@ -0,0 +1,345 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "compressedtexture.h"
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFunctions>
+#include <QVector>
+
+#include "render/gl/compute.h"
+#include "render/gl/functions.h"
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Bytes of one encoded 4x4 block
+const int kBlockBytes = 16;
+
+// Texels are allowed this far past 1.0 before a frame is refused, rendering leaves a little float noise
+const double kRangeTolerance = 1.002;
+
+const char* kEncodeShader =
+    "layout(local_size_x = %1, local_size_y = %1) in;\n"
+    "\n"
+    "uniform sampler2D tex;\n"
+    "uniform ivec2 size;\n"
+    "uniform int level;\n"
+    "uniform ivec2 level_size;\n"
+    "uniform int first_block;\n"
+    "\n"
+    "layout(std430, binding = 0) writeonly buffer Blocks {\n"
+    "  uvec4 blocks[];\n"
+    "};\n"
+    "\n"
+    "layout(std430, binding = 1) buffer Range {\n"
+    "  uint out_of_range;\n"
+    "};\n"
+    "\n"
+    "float srgb(float c) {\n"
+    "  return (c <= 0.0031308) ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;\n"
+    "}\n"
+    "\n"
+    "uint pack565(vec3 c) {\n"
+    "  uvec3 q = uvec3(round(clamp(c, 0.0, 1.0) * vec3(31.0, 63.0, 31.0)));\n"
+    "  return (q.r << 11) | (q.g << 5) | q.b;\n"
+    "}\n"
+    "\n"
+    "vec3 unpack565(uint p) {\n"
+    "  return vec3(float((p >> 11) & 31u), float((p >> 5) & 63u), float(p & 31u)) / vec3(31.0, 63.0, 31.0);\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "  ivec2 block = ivec2(gl_GlobalInvocationID.xy);\n"
+    "\n"
+    "  if (block.x >= size.x || block.y >= size.y) {\n"
+    "    return;\n"
+    "  }\n"
+    "\n"
+    "  vec4 texels[16];\n"
+    "  vec4 lo = vec4(1.0);\n"
+    "  vec4 hi = vec4(0.0);\n"
+    "  bool outside = false;\n"
+    "\n"
+    "  for (int i = 0; i < 16; i++) {\n"
+    "    // Blocks hanging over the edge of the level repeat its last row and column\n"
+    "    ivec2 pos = min(block * 4 + ivec2(i & 3, i >> 2), level_size - 1);\n"
+    "    vec4 c = texelFetch(tex, pos, level);\n"
+    "\n"
+    "    outside = outside || any(greaterThan(c, vec4(%2)));\n"
+    "\n"
+    "    c = clamp(c, 0.0, 1.0);\n"
+    "    c.rgb = vec3(srgb(c.r), srgb(c.g), srgb(c.b));\n"
+    "\n"
+    "    texels[i] = c;\n"
+    "    lo = min(lo, c);\n"
+    "    hi = max(hi, c);\n"
+    "  }\n"
+    "\n"
+    "  if (outside) {\n"
+    "    atomicOr(out_of_range, 1u);\n"
+    "  }\n"
+    "\n"
+    "  // Color: the bounding box diagonal, inset slightly so the palette covers the block more evenly\n"
+    "  vec3 inset = (hi.rgb - lo.rgb) / 16.0;\n"
+    "  uint c0 = pack565(hi.rgb - inset);\n"
+    "  uint c1 = pack565(lo.rgb + inset);\n"
+    "\n"
+    "  // Larger endpoint first, BC1 reads that as its four color mode and some decoders treat BC3 the same\n"
+    "  if (c0 < c1) {\n"
+    "    uint swap = c0;\n"
+    "    c0 = c1;\n"
+    "    c1 = swap;\n"
+    "  }\n"
+    "\n"
+    "  uint color_indices = 0u;\n"
+    "\n"
+    "  if (c0 != c1) {\n"
+    "    vec3 e0 = unpack565(c0);\n"
+    "    vec3 e1 = unpack565(c1);\n"
+    "    vec3 palette[4] = vec3[4](e0, e1, (2.0 * e0 + e1) / 3.0, (e0 + 2.0 * e1) / 3.0);\n"
+    "\n"
+    "    for (int i = 0; i < 16; i++) {\n"
+    "      uint best = 0u;\n"
+    "      float best_distance = 4.0;\n"
+    "\n"
+    "      for (uint j = 0u; j < 4u; j++) {\n"
+    "        vec3 d = texels[i].rgb - palette[j];\n"
+    "        float distance = dot(d, d);\n"
+    "\n"
+    "        if (distance < best_distance) {\n"
+    "          best = j;\n"
+    "          best_distance = distance;\n"
+    "        }\n"
+    "      }\n"
+    "\n"
+    "      color_indices |= best << uint(i * 2);\n"
+    "    }\n"
+    "  }\n"
+    "\n"
+    "  // Alpha: eight levels between the extremes, 3 bits per texel\n"
+    "  uint a0 = uint(round(hi.a * 255.0));\n"
+    "  uint a1 = uint(round(lo.a * 255.0));\n"
+    "  uint alpha_bits[2] = uint[2](0u, 0u);\n"
+    "\n"
+    "  if (a0 != a1) {\n"
+    "    for (int i = 0; i < 16; i++) {\n"
+    "      // Steps from a1 (0) to a0 (7), index 0 is a0, 1 is a1 and 2 to 7 run from a0 towards a1\n"
+    "      uint step = uint(round((texels[i].a * 255.0 - float(a1)) / float(a0 - a1) * 7.0));\n"
+    "      uint index = (step == 7u) ? 0u : ((step == 0u) ? 1u : 8u - step);\n"
+    "      uint bit = uint(i * 3);\n"
+    "\n"
+    "      if (bit < 32u) {\n"
+    "        alpha_bits[0] |= index << bit;\n"
+    "      }\n"
+    "\n"
+    "      if (bit + 3u > 32u) {\n"
+    "        alpha_bits[1] |= (bit < 32u) ? (index >> (32u - bit)) : (index << (bit - 32u));\n"
+    "      }\n"
+    "    }\n"
+    "  }\n"
+    "\n"
+    "  blocks[first_block + block.y * size.x + block.x] = uvec4(a0 | (a1 << 8) | (alpha_bits[0] << 16),\n"
+    "                                                           (alpha_bits[0] >> 16) | (alpha_bits[1] << 16),\n"
+    "                                                           c0 | (c1 << 16),\n"
+    "                                                           color_indices);\n"
+    "}\n";
+
+CompressedTexture::CompressedTexture() :
+  ctx_(nullptr),
+  texture_(0),
+  width_(0),
+  height_(0),
+  bytes_(0),
+  tag_(AllocationCounters::kOther)
+{
+}
+
+CompressedTexture::~CompressedTexture()
+{
+  Destroy();
+}
+
+bool CompressedTexture::IsSupported(QOpenGLContext *ctx)
+{
+  return olive::gl::SupportsCompute(ctx)
+      && ctx->hasExtension("GL_EXT_texture_compression_s3tc")
+      && (ctx->hasExtension("GL_EXT_texture_sRGB") || ctx->hasExtension("GL_EXT_texture_compression_s3tc_srgb"));
+}
+
+bool CompressedTexture::Create(QOpenGLContext *ctx, GLuint source, int width, int height)
+{
+  Destroy();
+
+  if (width <= 0 || height <= 0 || !IsSupported(ctx)) {
+    return false;
+  }
+
+  ShaderPtr pipeline = olive::gl::GetComputePipeline(QString::fromLatin1(kEncodeShader)
+                                                     .arg(olive::gl::kComputeTileSize)
+                                                     .arg(kRangeTolerance));
+
+  if (pipeline == nullptr) {
+    return false;
+  }
+
+  QOpenGLFunctions* f = ctx->functions();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  int levels = LevelCount(width, height);
+
+  // Where each level's blocks start in the storage buffer
+  QVector<int> first_blocks(levels + 1);
+  first_blocks[0] = 0;
+
+  for (int i=0;i<levels;i++) {
+    first_blocks[i + 1] = first_blocks.at(i) + BlockCount(width, i) * BlockCount(height, i);
+  }
+
+  olive::gl::StorageBuffer blocks;
+  blocks.Reserve(first_blocks.last() * kBlockBytes);
+  blocks.Bind(0);
+
+  olive::gl::StorageBuffer range;
+  range.Allocate(static_cast<int>(sizeof(quint32)));
+  range.Bind(1);
+
+  // Every level is encoded from the source's own mipmaps
+  f->glBindTexture(GL_TEXTURE_2D, source);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  f->glGenerateMipmap(GL_TEXTURE_2D);
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  for (int i=0;i<levels;i++) {
+    pipeline->bind();
+    pipeline->setUniformValue("level", i);
+    pipeline->setUniformValue("level_size", qMax(1, width >> i), qMax(1, height >> i));
+    pipeline->setUniformValue("first_block", first_blocks.at(i));
+    pipeline->release();
+
+    // One invocation per block, so it's dispatched over the block grid
+    olive::gl::DispatchOverTexture(pipeline, source, BlockCount(width, i), BlockCount(height, i));
+  }
+
+  quint32 out_of_range = 0;
+
+  if (!range.Read(&out_of_range, static_cast<int>(sizeof(quint32))) || out_of_range != 0) {
+    return false;
+  }
+
+  xf->glMemoryBarrier(GL_PIXEL_BUFFER_BARRIER_BIT);
+
+  f->glGenTextures(1, &texture_);
+  f->glBindTexture(GL_TEXTURE_2D, texture_);
+
+  // Upload straight from the storage buffer, the blocks never leave the GPU
+  f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, blocks.id());
+
+  for (int i=0;i<levels;i++) {
+    int level_bytes = (first_blocks.at(i + 1) - first_blocks.at(i)) * kBlockBytes;
+
+    f->glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+                              qMax(1, width >> i), qMax(1, height >> i), 0, level_bytes,
+                              reinterpret_cast<const void*>(static_cast<quintptr>(first_blocks.at(i) * kBlockBytes)));
+  }
+
+  f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  // The buffers go away with this scope, the upload was queued before they're deleted
+  blocks.Destroy();
+  range.Destroy();
+
+  ctx_ = ctx;
+  width_ = width;
+  height_ = height;
+  bytes_ = static_cast<qint64>(first_blocks.last()) * kBlockBytes;
+  tag_ = AllocationCounters::CurrentTag();
+
+  AllocationCounters::Allocated(AllocationCounters::kTextureBuffer, tag_, bytes_);
+
+  olive::gl::MarkMipmapsComplete(texture_);
+
+  return true;
+}
+
+void CompressedTexture::Destroy()
+{
+  if (ctx_ != nullptr) {
+    AllocationCounters::Freed(AllocationCounters::kTextureBuffer, tag_, bytes_);
+
+    olive::gl::ForgetTexture(texture_);
+
+    // Textures can only be deleted with a context of their group current, otherwise they go with the group
+    QOpenGLContext* current = QOpenGLContext::currentContext();
+
+    if (current != nullptr && current->shareGroup() == ctx_->shareGroup()) {
+      current->functions()->glDeleteTextures(1, &texture_);
+    }
+
+    ctx_ = nullptr;
+    texture_ = 0;
+    bytes_ = 0;
+  }
+}
+
+bool CompressedTexture::IsCreated() const
+{
+  return (ctx_ != nullptr);
+}
+
+GLuint CompressedTexture::texture() const
+{
+  return texture_;
+}
+
+int CompressedTexture::width() const
+{
+  return width_;
+}
+
+int CompressedTexture::height() const
+{
+  return height_;
+}
+
+qint64 CompressedTexture::bytes() const
+{
+  return bytes_;
+}
+
+int CompressedTexture::LevelCount(int width, int height)
+{
+  int levels = 1;
+
+  while ((width >> levels) > 0 || (height >> levels) > 0) {
+    levels++;
+  }
+
+  return levels;
+}
+
+int CompressedTexture::BlockCount(int size, int level)
+{
+  return (qMax(1, size >> level) + 3) / 4;
+}
@@ -0,0 +1,104 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COMPRESSEDTEXTURE_H
+#define COMPRESSEDTEXTURE_H
+
+#include <QOpenGLContext>
+
+#include "allocationcounters.h"
+
+/**
+ * @brief A block-compressed (BC3, also known as DXT5) copy of a texture with its whole mipmap chain
+ *
+ * Takes a quarter of the VRAM of an RGBA8 texture and an eighth of a half float one, so the FrameCache can hold
+ * several times as many frames when compression is enabled (see FrameCache::set_compression_enabled()). The blocks
+ * are encoded on the GPU by a compute shader in a single pass per mipmap level, which is cheap next to rendering the
+ * frame, and the texture is sampled like any other, e.g. by olive::gl::Blit().
+ *
+ * Colors are stored sRGB-encoded (GL_EXT_texture_sRGB), the sampler decodes them back to linear, so 8-bit blocks don't
+ * band in the shadows of linear frames. Values above 1.0 can't be stored, Create() refuses frames containing them.
+ * Quality is meant for previews, not for anything exported.
+ */
+class CompressedTexture
+{
+public:
+  CompressedTexture();
+  ~CompressedTexture();
+
+  CompressedTexture(const CompressedTexture& other) = delete;
+  CompressedTexture(CompressedTexture&& other) = delete;
+  CompressedTexture& operator=(const CompressedTexture& other) = delete;
+  CompressedTexture& operator=(CompressedTexture&& other) = delete;
+
+  /**
+   * @brief Returns TRUE if a context can encode and sample compressed textures
+   *
+   * Needs compute shaders (see olive::gl::SupportsCompute()), S3TC and sRGB textures.
+   */
+  static bool IsSupported(QOpenGLContext* ctx);
+
+  /**
+   * @brief Encode a texture (in the current context)
+   *
+   * Generates the mipmaps of `source` to encode each level from. Waits for the GPU to check the values fit.
+   *
+   * @return
+   *
+   * FALSE if compression isn't supported or `source` has values above 1.0, in which case nothing is allocated.
+   */
+  bool Create(QOpenGLContext* ctx, GLuint source, int width, int height);
+
+  void Destroy();
+
+  bool IsCreated() const;
+
+  GLuint texture() const;
+
+  int width() const;
+  int height() const;
+
+  /**
+   * @brief Bytes of VRAM the texture takes, including its mipmaps
+   */
+  qint64 bytes() const;
+
+private:
+  /**
+   * @brief Number of mipmap levels of a texture down to 1x1
+   */
+  static int LevelCount(int width, int height);
+
+  /**
+   * @brief Number of 4x4 blocks along one dimension of a mipmap level
+   */
+  static int BlockCount(int size, int level);
+
+  QOpenGLContext* ctx_;
+  GLuint texture_;
+  int width_;
+  int height_;
+  qint64 bytes_;
+
+  // What the texture is counted under in AllocationCounters
+  AllocationCounters::Tag tag_;
+};
+
+#endif // COMPRESSEDTEXTURE_H
@@ -0,0 +1,467 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "cpurender.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+#include "pixelconvertkernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_CPU_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_CPU_NEON
+#include <arm_neon.h>
+#endif
+
+// Images are never split into stripes of fewer pixels than this, smaller stripes aren't worth the threading overhead
+const int kMinimumStripePixels = 64 * 1024;
+
+/*
+ * One RGBA32F pixel in a SIMD register
+ */
+
+#if defined(OLIVE_CPU_SSE2)
+
+using Pixel = __m128;
+
+inline Pixel Load(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, Pixel v) { _mm_storeu_ps(p, v); }
+inline Pixel Splat(float f) { return _mm_set1_ps(f); }
+inline Pixel LoadRGBA8(const uint8_t* p)
+{
+  int packed;
+  memcpy(&packed, p, sizeof(packed));
+
+  __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+
+  return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255.0f));
+}
+inline Pixel Set(const QVector4D& v) { return _mm_setr_ps(v.x(), v.y(), v.z(), v.w()); }
+inline Pixel Add(Pixel a, Pixel b) { return _mm_add_ps(a, b); }
+inline Pixel Sub(Pixel a, Pixel b) { return _mm_sub_ps(a, b); }
+inline Pixel Mul(Pixel a, Pixel b) { return _mm_mul_ps(a, b); }
+template<int lane> inline Pixel Broadcast(Pixel v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(lane, lane, lane, lane)); }
+
+#elif defined(OLIVE_CPU_NEON)
+
+using Pixel = float32x4_t;
+
+inline Pixel Load(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, Pixel v) { vst1q_f32(p, v); }
+inline Pixel Splat(float f) { return vdupq_n_f32(f); }
+inline Pixel LoadRGBA8(const uint8_t* p)
+{
+  float f[4] = {float(p[0]), float(p[1]), float(p[2]), float(p[3])};
+  return vmulq_n_f32(vld1q_f32(f), 1.0f / 255.0f);
+}
+inline Pixel Set(const QVector4D& v) { float f[4] = {v.x(), v.y(), v.z(), v.w()}; return vld1q_f32(f); }
+inline Pixel Add(Pixel a, Pixel b) { return vaddq_f32(a, b); }
+inline Pixel Sub(Pixel a, Pixel b) { return vsubq_f32(a, b); }
+inline Pixel Mul(Pixel a, Pixel b) { return vmulq_f32(a, b); }
+template<int lane> inline Pixel Broadcast(Pixel v) { return vdupq_n_f32(vgetq_lane_f32(v, lane)); }
+
+#else
+
+struct Pixel {
+  float v[4];
+};
+
+inline Pixel Load(const float* p) { Pixel r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void Store(float* p, Pixel v) { memcpy(p, v.v, sizeof(v.v)); }
+inline Pixel Splat(float f) { Pixel r = {{f, f, f, f}}; return r; }
+inline Pixel LoadRGBA8(const uint8_t* p) { Pixel r; for (int i=0;i<4;i++) r.v[i] = p[i] / 255.0f; return r; }
+inline Pixel Set(const QVector4D& v) { Pixel r = {{v.x(), v.y(), v.z(), v.w()}}; return r; }
+inline Pixel Add(Pixel a, Pixel b) { for (int i=0;i<4;i++) a.v[i] += b.v[i]; return a; }
+inline Pixel Sub(Pixel a, Pixel b) { for (int i=0;i<4;i++) a.v[i] -= b.v[i]; return a; }
+inline Pixel Mul(Pixel a, Pixel b) { for (int i=0;i<4;i++) a.v[i] *= b.v[i]; return a; }
+template<int lane> inline Pixel Broadcast(Pixel v) { return Splat(v.v[lane]); }
+
+#endif
+
+/**
+ * @brief Runs one stripe of an operation on the shared pool
+ */
+class StripeRunnable : public QRunnable
+{
+public:
+  StripeRunnable(const std::function<void(int, int)>& func, int start, int end, QSemaphore* done) :
+    func_(func),
+    start_(start),
+    end_(end),
+    done_(done)
+  {
+  }
+
+  virtual void run() override
+  {
+    func_(start_, end_);
+    done_->release();
+  }
+
+private:
+  const std::function<void(int, int)>& func_;
+
+  int start_;
+
+  int end_;
+
+  QSemaphore* done_;
+};
+
+static QThreadPool* StripePool()
+{
+  static QThreadPool pool;
+  return &pool;
+}
+
+void olive::cpu::ForEachStripe(int rows, int width, const std::function<void(int, int)>& func)
+{
+  int stripe_count = qBound(1, (rows * width) / kMinimumStripePixels, QThread::idealThreadCount());
+  int stripe_height = (rows + stripe_count - 1) / stripe_count;
+
+  QThreadPool* pool = StripePool();
+  QSemaphore done;
+  int queued = 0;
+
+  for (int start=stripe_height;start<rows;start+=stripe_height) {
+    int end = qMin(rows, start + stripe_height);
+
+    StripeRunnable* runnable = new StripeRunnable(func, start, end, &done);
+
+    if (pool->tryStart(runnable)) {
+      queued++;
+    } else {
+      // Nothing idle to hand it to
+      delete runnable;
+      func(start, end);
+    }
+  }
+
+  func(0, qMin(rows, stripe_height));
+
+  done.acquire(queued);
+}
+
+void olive::cpu::ForEachIndex(int count, const std::function<void(int)> &func)
+{
+  // Every index is a stripe of the minimum size, so there's one per thread
+  ForEachStripe(count, kMinimumStripePixels, [&func](int start, int end) {
+    for (int i=start;i<end;i++) {
+      func(i);
+    }
+  });
+}
+
+static inline float* PixelAt(MemoryBuffer* buffer, int x, int y)
+{
+  return reinterpret_cast<float*>(buffer->row(y)) + x * 4;
+}
+
+static inline const float* PixelAt(const MemoryBuffer& buffer, int x, int y)
+{
+  return reinterpret_cast<const float*>(buffer.const_row(y)) + x * 4;
+}
+
+const char *olive::cpu::InstructionSet()
+{
+#if defined(OLIVE_CPU_SSE2)
+  return "SSE2";
+#elif defined(OLIVE_CPU_NEON)
+  return "NEON";
+#else
+  return "C++";
+#endif
+}
+
+void olive::cpu::Fill(MemoryBuffer *dst, const QVector4D &color)
+{
+  Q_ASSERT(dst->format() == olive::PIX_FMT_RGBA32F);
+
+  Pixel c = Set(color);
+
+  ForEachStripe(dst->height(), dst->width(), [dst, c](int start, int end) {
+    for (int y=start;y<end;y++) {
+      float* px = PixelAt(dst, 0, y);
+
+      for (int x=0;x<dst->width();x++) {
+        Store(px + x * 4, c);
+      }
+    }
+  });
+}
+
+void olive::cpu::LoadImage(const QImage &image, const QRect &region, MemoryBuffer *dst)
+{
+  Q_ASSERT(image.format() == QImage::Format_RGBA8888_Premultiplied);
+
+  QRect from = region & image.rect();
+
+  dst->Create(from.width(), from.height(), olive::PIX_FMT_RGBA32F);
+
+  ForEachStripe(from.height(), from.width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      const uint8_t* in = image.constScanLine(from.y() + y) + from.x() * 4;
+      float* out = PixelAt(dst, 0, y);
+
+      for (int x=0;x<from.width();x++) {
+        Store(out + x * 4, LoadRGBA8(in + x * 4));
+      }
+    }
+  });
+}
+
+void olive::cpu::Blit(const MemoryBuffer &src, const QRect &src_rect, MemoryBuffer *dst, const QPoint &pos)
+{
+  Q_ASSERT(src.format() == olive::PIX_FMT_RGBA32F);
+
+  // Clip to both buffers
+  QRect from = src_rect & QRect(0, 0, src.width(), src.height());
+  QRect to = from.translated(pos - src_rect.topLeft()) & QRect(0, 0, dst->width(), dst->height());
+  from = to.translated(src_rect.topLeft() - pos);
+
+  if (to.isEmpty()) {
+    return;
+  }
+
+  const olive::pixel::Kernels& kernels = olive::pixel::GetKernels();
+  olive::pixel::PackFunction pack = nullptr;
+
+  switch (dst->format()) {
+  case olive::PIX_FMT_RGBA8:
+    pack = kernels.pack_rgba8;
+    break;
+  case olive::PIX_FMT_RGBA16:
+    pack = kernels.pack_rgba16;
+    break;
+  case olive::PIX_FMT_RGBA16F:
+    pack = kernels.pack_rgba16f;
+    break;
+  case olive::PIX_FMT_RGBA32F:
+    break;
+  default:
+    qWarning("Blitting to an unsupported format");
+    return;
+  }
+
+  int bytes_per_pixel = PixelService::BytesPerPixel(dst->format());
+
+  ForEachStripe(to.height(), to.width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      const float* in = PixelAt(src, from.x(), from.y() + y);
+      uint8_t* out = dst->row(to.y() + y) + to.x() * bytes_per_pixel;
+
+      if (pack == nullptr) {
+        memcpy(out, in, static_cast<size_t>(to.width()) * 4 * sizeof(float));
+      } else {
+        pack(in, out, to.width());
+      }
+    }
+  });
+}
+
+void olive::cpu::Blend(const MemoryBuffer &src, MemoryBuffer *dst, const QPoint &pos, float opacity)
+{
+  Q_ASSERT(src.format() == olive::PIX_FMT_RGBA32F && dst->format() == olive::PIX_FMT_RGBA32F);
+
+  QRect to = QRect(pos, QSize(src.width(), src.height())) & QRect(0, 0, dst->width(), dst->height());
+
+  if (to.isEmpty()) {
+    return;
+  }
+
+  Pixel o = Splat(opacity);
+  Pixel one = Splat(1.0f);
+
+  ForEachStripe(to.height(), to.width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      const float* in = PixelAt(src, to.x() - pos.x(), to.y() - pos.y() + y);
+      float* out = PixelAt(dst, to.x(), to.y() + y);
+
+      for (int x=0;x<to.width();x++) {
+        Pixel s = Mul(Load(in + x * 4), o);
+        Pixel d = Load(out + x * 4);
+
+        // d = s + d * (1 - s.a)
+        Store(out + x * 4, Add(s, Mul(d, Sub(one, Broadcast<3>(s)))));
+      }
+    }
+  });
+}
+
+void olive::cpu::ColorTransform(MemoryBuffer *buffer, const QMatrix4x4 &matrix, const QVector4D &offset)
+{
+  Q_ASSERT(buffer->format() == olive::PIX_FMT_RGBA32F);
+
+  Pixel c0 = Set(matrix.column(0));
+  Pixel c1 = Set(matrix.column(1));
+  Pixel c2 = Set(matrix.column(2));
+  Pixel c3 = Set(matrix.column(3));
+  Pixel off = Set(offset);
+
+  ForEachStripe(buffer->height(), buffer->width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      float* px = PixelAt(buffer, 0, y);
+
+      for (int x=0;x<buffer->width();x++) {
+        Pixel in = Load(px + x * 4);
+
+        Pixel out = Add(off, Mul(c0, Broadcast<0>(in)));
+        out = Add(out, Mul(c1, Broadcast<1>(in)));
+        out = Add(out, Mul(c2, Broadcast<2>(in)));
+        out = Add(out, Mul(c3, Broadcast<3>(in)));
+
+        Store(px + x * 4, out);
+      }
+    }
+  });
+}
+
+void olive::cpu::ApplyLut3D(MemoryBuffer *buffer, const float *lut, int size, bool associated)
+{
+  Q_ASSERT(buffer->format() == olive::PIX_FMT_RGBA32F && size >= 2);
+
+  float scale = static_cast<float>(size - 1);
+  int last = size - 2;
+
+  // Offsets to the next entry along each axis
+  int step_g = size * 4;
+  int step_b = size * size * 4;
+
+  ForEachStripe(buffer->height(), buffer->width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      float* px = PixelAt(buffer, 0, y);
+
+      for (int x=0;x<buffer->width();x++) {
+        float* p = px + x * 4;
+        float alpha = p[3];
+        bool divide = associated && alpha > 0.0f;
+
+        float pos[3];
+        int index[3];
+        float frac[3];
+
+        for (int i=0;i<3;i++) {
+          float c = divide ? p[i] / alpha : p[i];
+
+          pos[i] = qBound(0.0f, c, 1.0f) * scale;
+          index[i] = qMin(static_cast<int>(pos[i]), last);
+          frac[i] = pos[i] - static_cast<float>(index[i]);
+        }
+
+        const float* c000 = lut + (index[0] + index[1] * size + index[2] * size * size) * 4;
+
+        Pixel fr = Splat(frac[0]);
+        Pixel fg = Splat(frac[1]);
+        Pixel fb = Splat(frac[2]);
+
+        // Interpolate along red, then green, then blue
+        Pixel c00 = Load(c000);
+        c00 = Add(c00, Mul(Sub(Load(c000 + 4), c00), fr));
+        Pixel c10 = Load(c000 + step_g);
+        c10 = Add(c10, Mul(Sub(Load(c000 + step_g + 4), c10), fr));
+        Pixel c01 = Load(c000 + step_b);
+        c01 = Add(c01, Mul(Sub(Load(c000 + step_b + 4), c01), fr));
+        Pixel c11 = Load(c000 + step_b + step_g);
+        c11 = Add(c11, Mul(Sub(Load(c000 + step_b + step_g + 4), c11), fr));
+
+        Pixel c0 = Add(c00, Mul(Sub(c10, c00), fg));
+        Pixel c1 = Add(c01, Mul(Sub(c11, c01), fg));
+
+        Pixel out = Add(c0, Mul(Sub(c1, c0), fb));
+
+        if (associated) {
+          out = Mul(out, Splat(alpha));
+        }
+
+        Store(p, out);
+
+        p[3] = alpha;
+      }
+    }
+  });
+}
+
+void olive::cpu::TransformResample(const MemoryBuffer &src, MemoryBuffer *dst, const QTransform &transform)
+{
+  Q_ASSERT(src.format() == olive::PIX_FMT_RGBA32F && dst->format() == olive::PIX_FMT_RGBA32F);
+
+  bool invertible = false;
+  QTransform inverse = transform.inverted(&invertible);
+
+  Pixel transparent = Splat(0.0f);
+
+  if (!invertible) {
+    Fill(dst, QVector4D());
+    return;
+  }
+
+  int max_x = src.width() - 1;
+  int max_y = src.height() - 1;
+
+  ForEachStripe(dst->height(), dst->width(), [&](int start, int end) {
+    for (int y=start;y<end;y++) {
+      float* out = PixelAt(dst, 0, y);
+
+      // Step along the row in source coordinates rather than mapping every pixel
+      QPointF row_start = inverse.map(QPointF(0.5, y + 0.5));
+      QPointF step = inverse.map(QPointF(1.5, y + 0.5)) - row_start;
+
+      for (int x=0;x<dst->width();x++) {
+        // Sample position relative to pixel centers
+        double sx = row_start.x() + step.x() * x - 0.5;
+        double sy = row_start.y() + step.y() * x - 0.5;
+
+        double fx = std::floor(sx);
+        double fy = std::floor(sy);
+
+        int x0 = static_cast<int>(fx);
+        int y0 = static_cast<int>(fy);
+
+        if (x0 < -1 || y0 < -1 || x0 > max_x || y0 > max_y) {
+          Store(out + x * 4, transparent);
+          continue;
+        }
+
+        float wx = static_cast<float>(sx - fx);
+        float wy = static_cast<float>(sy - fy);
+
+        // Pixels outside the source are transparent, so edges fade out over one pixel
+        Pixel p00 = (x0 >= 0 && y0 >= 0) ? Load(PixelAt(src, x0, y0)) : transparent;
+        Pixel p10 = (x0 < max_x && y0 >= 0) ? Load(PixelAt(src, x0 + 1, y0)) : transparent;
+        Pixel p01 = (x0 >= 0 && y0 < max_y) ? Load(PixelAt(src, x0, y0 + 1)) : transparent;
+        Pixel p11 = (x0 < max_x && y0 < max_y) ? Load(PixelAt(src, x0 + 1, y0 + 1)) : transparent;
+
+        Pixel top = Add(p00, Mul(Sub(p10, p00), Splat(wx)));
+        Pixel bottom = Add(p01, Mul(Sub(p11, p01), Splat(wx)));
+
+        Store(out + x * 4, Add(top, Mul(Sub(bottom, top), Splat(wy))));
+      }
+    }
+  });
+}
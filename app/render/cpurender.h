@@ -0,0 +1,122 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CPURENDER_H
+#define CPURENDER_H
+
+#include <QImage>
+#include <QMatrix4x4>
+#include <QPoint>
+#include <QRect>
+#include <QTransform>
+#include <QVector4D>
+#include <functional>
+
+#include "memorybuffer.h"
+
+namespace olive {
+namespace cpu {
+
+/**
+ * @brief Image operations for rendering without a GPU
+ *
+ * Render threads that can't create an OpenGL context fall back to rendering into MemoryBuffers with these functions
+ * (see RendererThread). Images are RGBA32F with associated alpha, one pixel per SIMD register (SSE2 on x86, NEON on
+ * ARM, plain C++ elsewhere). Large images are split into stripes of rows that run on idle threads of a shared pool; if
+ * every thread is busy (e.g. every render thread is rendering its own frame), the calling thread does all the work
+ * rather than oversubscribing the CPU.
+ */
+
+/**
+ * @brief Name of the instruction set the functions were built for
+ */
+const char* InstructionSet();
+
+/**
+ * @brief Call `func(start, end)` for stripes of rows covering 0 to `rows`, on idle pool threads where possible
+ *
+ * `width` is only used to decide how many stripes are worth it. Returns once every stripe is done.
+ */
+void ForEachStripe(int rows, int width, const std::function<void(int, int)>& func);
+
+/**
+ * @brief Call `func(i)` for every `i` from 0 to `count` on the same pool, with the same fallback as ForEachStripe()
+ *
+ * For work that's already split into pieces that are each worth a thread (e.g. by a plugin).
+ */
+void ForEachIndex(int count, const std::function<void(int)>& func);
+
+/**
+ * @brief Set every pixel of an RGBA32F buffer to a color
+ */
+void Fill(MemoryBuffer* dst, const QVector4D& color);
+
+/**
+ * @brief Convert a region of a QImage in Format_RGBA8888_Premultiplied to RGBA32F, (re)creating `dst` at its size
+ *
+ * Rows are copied in the image's order, so scanline `region.y()` becomes row 0 (matching a glTexSubImage2D() upload).
+ */
+void LoadImage(const QImage& image, const QRect& region, MemoryBuffer* dst);
+
+/**
+ * @brief Copy a region of an RGBA32F buffer into another buffer at `pos`
+ *
+ * `dst` may be in any of the RGBA formats (RGBA8, RGBA16, RGBA16F or RGBA32F), values are converted as they're copied.
+ * The region is clipped to both buffers.
+ */
+void Blit(const MemoryBuffer& src, const QRect& src_rect, MemoryBuffer* dst, const QPoint& pos);
+
+/**
+ * @brief Composite an RGBA32F buffer over another at `pos` ("over" with associated alpha)
+ */
+void Blend(const MemoryBuffer& src, MemoryBuffer* dst, const QPoint& pos, float opacity = 1.0f);
+
+/**
+ * @brief Transform every pixel of an RGBA32F buffer's color by a matrix and offset: rgba = matrix * rgba + offset
+ */
+void ColorTransform(MemoryBuffer* buffer, const QMatrix4x4& matrix, const QVector4D& offset = QVector4D());
+
+/**
+ * @brief Map every pixel of an RGBA32F buffer's color through a 3D LUT with trilinear interpolation
+ *
+ * @param lut
+ *
+ * `size` cubed entries of 4 floats (RGB and one unused, so each entry loads as one pixel), red varying fastest and
+ * blue slowest, covering 0.0-1.0 on each axis. Colors outside of that are clamped to it. Alpha is left unchanged.
+ *
+ * @param associated
+ *
+ * Whether the buffer's color is multiplied by alpha, in which case it's divided by alpha before the lookup and
+ * multiplied again after.
+ */
+void ApplyLut3D(MemoryBuffer* buffer, const float* lut, int size, bool associated);
+
+/**
+ * @brief Draw an RGBA32F buffer into another with an affine transform, sampling bilinearly
+ *
+ * `transform` maps source pixel coordinates to destination pixel coordinates. Destination pixels that don't map onto
+ * the source become transparent.
+ */
+void TransformResample(const MemoryBuffer& src, MemoryBuffer* dst, const QTransform& transform);
+
+}
+}
+
+#endif // CPURENDER_H
@@ -0,0 +1,381 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "diskframecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMultiMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <cstring>
+
+#include "render/channelpacker.h"
+
+namespace {
+
+/**
+ * @brief Header of a cached frame file, followed by the qCompress()'d pixels packed in `layout`
+ */
+struct FrameHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t format;
+  int32_t linesize;
+
+  // ChannelPacker::Layout
+  int32_t layout;
+};
+
+const char kFrameMagic[4] = {'O', 'V', 'F', 'C'};
+const uint32_t kFrameVersion = 2;
+
+// Default disk budget
+const qint64 kDefaultFrameCacheBudget = Q_INT64_C(10) * 1024 * 1024 * 1024;
+
+// Length of a key, a SHA-1 in hex
+const int kKeyLength = 40;
+
+// Frames waiting to be written are held in RAM, past this many new ones are dropped rather than queued
+const int kMaximumPendingWrites = 8;
+
+struct FrameEntry {
+  qint64 size;
+
+  // Higher is more recently used
+  quint64 last_access;
+};
+
+QMutex cache_mutex;
+
+// Every cached frame by key, protected by cache_mutex
+QHash<QString, FrameEntry> entries;
+bool entries_loaded = false;
+qint64 used_bytes = 0;
+quint64 access_counter = 0;
+
+// Frames passed to Save() that haven't been written yet, protected by cache_mutex
+QSet<QString> pending;
+
+qint64 cache_budget = kDefaultFrameCacheBudget;
+
+QThreadPool* WritePool()
+{
+  // One thread is enough to keep up with rendering ahead and keeps writes sequential on disk
+  static QThreadPool pool;
+
+  if (pool.maxThreadCount() != 1) {
+    pool.setMaxThreadCount(1);
+  }
+
+  return &pool;
+}
+
+}
+
+class DiskFrameCache::WriteRunnable : public QRunnable
+{
+public:
+  WriteRunnable(const QString& key, MemoryBuffer buffer) :
+    key_(key),
+    buffer_(std::move(buffer))
+  {
+  }
+
+  virtual void run() override
+  {
+    DiskFrameCache::Write(key_, buffer_);
+  }
+
+private:
+  QString key_;
+
+  MemoryBuffer buffer_;
+};
+
+QString DiskFrameCache::FrameKey(const QByteArray &content_key, int width, int height,
+                                 const olive::PixelFormat &format)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(content_key);
+  hash.addData(QByteArray::number(width));
+  hash.addData(QByteArray::number(height));
+  hash.addData(QByteArray::number(format));
+
+  return QString(hash.result().toHex());
+}
+
+bool DiskFrameCache::Contains(const QString &key)
+{
+  QMutexLocker locker(&cache_mutex);
+
+  LoadEntries();
+
+  return entries.contains(key) || pending.contains(key);
+}
+
+bool DiskFrameCache::Load(const QString &key, MemoryBuffer *buffer)
+{
+  QMutexLocker locker(&cache_mutex);
+
+  LoadEntries();
+
+  QHash<QString, FrameEntry>::iterator entry = entries.find(key);
+
+  if (entry == entries.end()) {
+    return false;
+  }
+
+  entry->last_access = ++access_counter;
+
+  locker.unlock();
+
+  QFile file(GetFilename(key));
+
+  bool ok = false;
+
+  if (file.open(QFile::ReadOnly) && file.size() > static_cast<qint64>(sizeof(FrameHeader))) {
+    uchar* map = file.map(0, file.size());
+
+    if (map != nullptr) {
+      const FrameHeader* header = reinterpret_cast<const FrameHeader*>(map);
+
+      if (memcmp(header->magic, kFrameMagic, sizeof(kFrameMagic)) == 0
+          && header->version == kFrameVersion
+          && header->format >= 0
+          && header->format < olive::PIX_FMT_COUNT
+          && header->layout >= 0
+          && header->layout < ChannelPacker::kLayoutCount) {
+        QByteArray data = qUncompress(map + sizeof(FrameHeader),
+                                      static_cast<int>(file.size() - static_cast<qint64>(sizeof(FrameHeader))));
+
+        buffer->Create(header->width, header->height, static_cast<olive::PixelFormat>(header->format));
+
+        // The linesize only changes if the padding rules changed, which makes the frame useless
+        ok = (buffer->IsCreated()
+              && buffer->linesize() == header->linesize
+              && ChannelPacker::Unpack(data, static_cast<ChannelPacker::Layout>(header->layout), buffer));
+      }
+
+      file.unmap(map);
+    }
+
+    file.close();
+  }
+
+  if (!ok) {
+    qWarning() << "Failed to read cached frame" << file.fileName();
+
+    locker.relock();
+
+    QHash<QString, FrameEntry>::iterator removed = entries.find(key);
+
+    if (removed != entries.end()) {
+      QFile::remove(file.fileName());
+
+      used_bytes -= removed->size;
+
+      entries.erase(removed);
+    }
+  }
+
+  return ok;
+}
+
+void DiskFrameCache::Save(const QString &key, MemoryBuffer buffer)
+{
+  if (!buffer.IsCreated()) {
+    return;
+  }
+
+  QMutexLocker locker(&cache_mutex);
+
+  if (cache_budget == 0 || pending.size() >= kMaximumPendingWrites) {
+    return;
+  }
+
+  LoadEntries();
+
+  if (entries.contains(key) || pending.contains(key)) {
+    return;
+  }
+
+  pending.insert(key);
+
+  locker.unlock();
+
+  WritePool()->start(new WriteRunnable(key, std::move(buffer)));
+}
+
+void DiskFrameCache::WaitForWrites()
+{
+  WritePool()->waitForDone();
+}
+
+qint64 DiskFrameCache::budget()
+{
+  QMutexLocker locker(&cache_mutex);
+
+  return cache_budget;
+}
+
+void DiskFrameCache::set_budget(qint64 bytes)
+{
+  QMutexLocker locker(&cache_mutex);
+
+  cache_budget = bytes;
+
+  if (entries_loaded) {
+    MakeSpace(0);
+  }
+}
+
+QString DiskFrameCache::GetDirectory()
+{
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("frames");
+}
+
+QString DiskFrameCache::GetFilename(const QString &key)
+{
+  // Spread frames over 256 directories so no single directory gets too large
+  return QDir(GetDirectory()).filePath(QStringLiteral("%1/%2").arg(key.left(2), key));
+}
+
+void DiskFrameCache::Write(const QString &key, const MemoryBuffer &buffer)
+{
+  // Opaque and greyscale frames are stored without the channels that are the same everywhere
+  ChannelPacker::Layout layout;
+  QByteArray compressed = qCompress(ChannelPacker::Pack(buffer, &layout), 1);
+
+  qint64 size = static_cast<qint64>(sizeof(FrameHeader)) + compressed.size();
+
+  QMutexLocker locker(&cache_mutex);
+
+  pending.remove(key);
+
+  if (size > cache_budget) {
+    return;
+  }
+
+  MakeSpace(size);
+
+  // Count the frame straight away so Contains() doesn't report it missing in between
+  entries.insert(key, {size, ++access_counter});
+  used_bytes += size;
+
+  locker.unlock();
+
+  QString filename = GetFilename(key);
+
+  QDir().mkpath(QFileInfo(filename).path());
+
+  FrameHeader header;
+  memcpy(header.magic, kFrameMagic, sizeof(kFrameMagic));
+  header.version = kFrameVersion;
+  header.width = buffer.width();
+  header.height = buffer.height();
+  header.format = buffer.format();
+  header.linesize = buffer.linesize();
+  header.layout = layout;
+
+  // QSaveFile ensures a partially written frame can never be read by Load()
+  QSaveFile file(filename);
+
+  if (file.open(QFile::WriteOnly)
+      && file.write(reinterpret_cast<const char*>(&header), sizeof(FrameHeader))
+      == static_cast<qint64>(sizeof(FrameHeader))
+      && file.write(compressed) == compressed.size()
+      && file.commit()) {
+    return;
+  }
+
+  qWarning() << "Failed to write cached frame" << filename;
+
+  locker.relock();
+
+  if (entries.remove(key) > 0) {
+    used_bytes -= size;
+  }
+}
+
+void DiskFrameCache::LoadEntries()
+{
+  if (entries_loaded) {
+    return;
+  }
+
+  entries_loaded = true;
+
+  // Frames from previous sessions are ordered by when they were written
+  QMultiMap<QDateTime, QFileInfo> existing;
+
+  QDirIterator it(GetDirectory(), QDir::Files, QDirIterator::Subdirectories);
+
+  while (it.hasNext()) {
+    it.next();
+
+    // Anything else is left over from a write that was interrupted
+    if (it.fileName().size() != kKeyLength) {
+      QFile::remove(it.filePath());
+      continue;
+    }
+
+    existing.insert(it.fileInfo().lastModified(), it.fileInfo());
+  }
+
+  foreach (const QFileInfo& info, existing) {
+    entries.insert(info.fileName(), {info.size(), ++access_counter});
+    used_bytes += info.size();
+  }
+
+  MakeSpace(0);
+}
+
+void DiskFrameCache::MakeSpace(qint64 incoming)
+{
+  while (used_bytes + incoming > cache_budget && !entries.isEmpty()) {
+    QHash<QString, FrameEntry>::iterator oldest = entries.begin();
+
+    for (QHash<QString, FrameEntry>::iterator i=entries.begin();i!=entries.end();i++) {
+      if (i->last_access < oldest->last_access) {
+        oldest = i;
+      }
+    }
+
+    QFile::remove(GetFilename(oldest.key()));
+
+    used_bytes -= oldest->size;
+
+    entries.erase(oldest);
+  }
+}
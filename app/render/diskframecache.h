@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DISKFRAMECACHE_H
+#define DISKFRAMECACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "render/memorybuffer.h"
+
+/**
+ * @brief A persistent cache of rendered frames on local disk
+ *
+ * Frames rendered ahead into the FrameCache are also written here, keyed by the content hash they're cached under
+ * (see NodeOutput::ContentHash()) along with their size and format (see FrameKey()). Content hashes only depend on
+ * the graph, so after a project is reopened, frames of parts that haven't changed since are read back from here
+ * instead of being rendered again.
+ *
+ * Opaque frames are stored without their alpha channel and grey ones with a single channel (see ChannelPacker).
+ * Frames are compressed with zlib at its fastest level (qCompress()) and written on a background thread, so Save()
+ * returns straight away. The least recently used frames are deleted once the cache exceeds its budget, frames from
+ * previous sessions count towards it in the order they were written. All functions are thread-safe.
+ */
+class DiskFrameCache
+{
+public:
+  /**
+   * @brief Identity of a frame, combining its content hash with the size and format it was rendered at
+   */
+  static QString FrameKey(const QByteArray& content_key, int width, int height, const olive::PixelFormat& format);
+
+  /**
+   * @brief Returns TRUE if a frame is cached (or is being written)
+   */
+  static bool Contains(const QString& key);
+
+  /**
+   * @brief Read a cached frame into `buffer`
+   *
+   * @return
+   *
+   * TRUE if the frame was cached and read. FALSE if it isn't cached (yet) or couldn't be read, in which case it's
+   * removed from the cache.
+   */
+  static bool Load(const QString& key, MemoryBuffer* buffer);
+
+  /**
+   * @brief Cache a frame, evicting the least recently used frames if this exceeds the budget
+   *
+   * The frame is compressed and written in the background. Does nothing if the cache is disabled (budget of 0) or the
+   * frame is already cached.
+   */
+  static void Save(const QString& key, MemoryBuffer buffer);
+
+  /**
+   * @brief Block until every frame passed to Save() has been written
+   */
+  static void WaitForWrites();
+
+  static qint64 budget();
+
+  /**
+   * @brief Set the maximum number of bytes cached frames may use on disk, 0 disables the cache
+   */
+  static void set_budget(qint64 bytes);
+
+private:
+  class WriteRunnable;
+
+  static QString GetDirectory();
+
+  static QString GetFilename(const QString& key);
+
+  /**
+   * @brief Compress a frame and write it, then count it towards the budget (runs on the write thread)
+   */
+  static void Write(const QString& key, const MemoryBuffer& buffer);
+
+  /**
+   * @brief Scan the cache directory once so frames cached by previous sessions can be found and count towards the
+   * budget
+   *
+   * Must be called with the cache mutex held.
+   */
+  static void LoadEntries();
+
+  /**
+   * @brief Remove least recently used frames until `incoming` more bytes fit in the budget
+   *
+   * Must be called with the cache mutex held.
+   */
+  static void MakeSpace(qint64 incoming);
+};
+
+#endif // DISKFRAMECACHE_H
@@ -0,0 +1,468 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framecache.h"
+
+#include <QAtomicInt>
+#include <QMutexLocker>
+
+#include "common/tickrescaler.h"
+#include "node/node.h"
+#include "render/pixelformat.h"
+
+// Budget used until SetBudget() is called
+const qint64 kDefaultBudget = Q_INT64_C(1024) * 1024 * 1024;
+
+// Non-zero if frames should be compressed, see FrameCache::set_compression_enabled()
+QAtomicInt compression_enabled_flag(0);
+
+FrameCache::FrameCache() :
+  budget_(kDefaultBudget),
+  allocated_(0),
+  access_counter_(0),
+  generation_(0),
+  mutex_("FrameCache")
+{
+}
+
+FrameCache::~FrameCache()
+{
+  Clear();
+}
+
+void FrameCache::SetBudget(qint64 bytes)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  budget_ = bytes;
+
+  FreeForIncoming(0);
+}
+
+qint64 FrameCache::budget()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  return budget_;
+}
+
+qint64 FrameCache::allocated_bytes()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  return allocated_;
+}
+
+void FrameCache::Sync(NodeOutput *output)
+{
+  bool all;
+  TimeRangeList ranges = output->parent()->TakeInvalidatedRanges(&all);
+
+  if (!all && ranges.isEmpty()) {
+    return;
+  }
+
+  ProfiledMutexLocker locker(&mutex_);
+
+  generation_++;
+
+  if (all && validity_.contains(output)) {
+    validity_[output].dividers.clear();
+  }
+
+  QHash< NodeOutput*, QMap<rational, QByteArray> >::iterator frames = frames_.find(output);
+
+  if (frames == frames_.end()) {
+    return;
+  }
+
+  // Only the bindings are dropped, the frames may match the graph again later (e.g. once the edit is undone)
+  QMap<rational, QByteArray>::iterator i = frames->begin();
+
+  while (i != frames->end()) {
+    if (all || ranges.Overlaps(TimeRange(i.key(), i.key()))) {
+      DropBinding(output, i.key(), i.value());
+      i = frames->erase(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+GLuint FrameCache::Get(NodeOutput *output, const rational &time, int divider)
+{
+  Entry* e = Find(output, time, divider);
+
+  GLuint texture = 0;
+
+  if (e != nullptr) {
+    e->last_access = ++access_counter_;
+    texture = (e->buffer != nullptr) ? e->buffer->texture() : e->compressed->texture();
+  }
+
+  mutex_.unlock();
+
+  return texture;
+}
+
+bool FrameCache::Contains(NodeOutput *output, const rational &time, int divider)
+{
+  bool found = (Find(output, time, divider) != nullptr);
+
+  mutex_.unlock();
+
+  return found;
+}
+
+bool FrameCache::Bind(NodeOutput *output, const rational &time, int divider, const QByteArray &key, int generation)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  if (generation != generation_) {
+    return false;
+  }
+
+  EntryIterator entry = entries_.find(key);
+
+  if (entry == entries_.end() || entry->divider > divider) {
+    return false;
+  }
+
+  entry->last_access = ++access_counter_;
+
+  BindEntry(output, time, entry);
+
+  return true;
+}
+
+QList<rational> FrameCache::frames(NodeOutput *output)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  return frames_.value(output).keys();
+}
+
+void FrameCache::SetTimebase(NodeOutput *output, const rational &timebase)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  Validity& validity = validity_[output];
+
+  if (validity.timebase == timebase) {
+    return;
+  }
+
+  // Renumber the frames already cached
+  validity.timebase = timebase;
+  validity.dividers.clear();
+
+  QHash< NodeOutput*, QMap<rational, QByteArray> >::const_iterator frames = frames_.constFind(output);
+
+  if (frames == frames_.constEnd()) {
+    return;
+  }
+
+  QMap<rational, QByteArray>::const_iterator i;
+
+  for (i=frames->constBegin();i!=frames->constEnd();i++) {
+    SetValid(output, i.key(), entries_.value(i.value()).divider, true);
+  }
+}
+
+FrameRunList FrameCache::valid_frames(NodeOutput *output, int divider)
+{
+  Sync(output);
+
+  ProfiledMutexLocker locker(&mutex_);
+
+  FrameRunList frames;
+
+  QHash<NodeOutput*, Validity>::const_iterator validity = validity_.constFind(output);
+
+  if (validity == validity_.constEnd()) {
+    return frames;
+  }
+
+  // A frame rendered at a lower divider also satisfies this one
+  QMap<int, FrameRunList>::const_iterator i;
+
+  for (i=validity->dividers.constBegin();i!=validity->dividers.constEnd() && i.key() <= divider;i++) {
+    if (frames.isEmpty()) {
+      frames = i.value();
+    } else {
+      frames.Insert(i.value());
+    }
+  }
+
+  return frames;
+}
+
+int FrameCache::generation()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  return generation_;
+}
+
+bool FrameCache::Insert(NodeOutput *output, const rational &time, int divider, const QByteArray &key,
+                        TextureBuffer *buffer, int generation)
+{
+  Entry e;
+  e.buffer = buffer;
+  e.compressed = nullptr;
+  e.divider = divider;
+  e.bytes = static_cast<qint64>(buffer->width())
+      * static_cast<qint64>(buffer->height())
+      * PixelService::GetPixelFormatInfo(buffer->format()).bytes_per_pixel;
+
+  return InsertEntry(output, time, key, e, generation);
+}
+
+bool FrameCache::Insert(NodeOutput *output, const rational &time, int divider, const QByteArray &key,
+                        CompressedTexture *texture, int generation)
+{
+  Entry e;
+  e.buffer = nullptr;
+  e.compressed = texture;
+  e.divider = divider;
+  e.bytes = texture->bytes();
+
+  return InsertEntry(output, time, key, e, generation);
+}
+
+bool FrameCache::compression_enabled()
+{
+  return (compression_enabled_flag.load() != 0);
+}
+
+void FrameCache::set_compression_enabled(bool enabled)
+{
+  compression_enabled_flag.store(enabled ? 1 : 0);
+}
+
+bool FrameCache::InsertEntry(NodeOutput *output, const rational &time, const QByteArray &key,
+                             const FrameCache::Entry &e, int generation)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  if (generation != generation_) {
+    DeleteTextures(e);
+    return false;
+  }
+
+  EntryIterator existing = entries_.find(key);
+
+  if (existing != entries_.end()) {
+    if (existing->divider <= e.divider) {
+      // Another time with the same content was rendered first
+      DeleteTextures(e);
+
+      existing->last_access = ++access_counter_;
+      BindEntry(output, time, existing);
+
+      return true;
+    }
+
+    // The new frame is sharper, it replaces the old one for every time bound to it
+    DestroyEntry(existing);
+  }
+
+  FreeForIncoming(e.bytes);
+
+  allocated_ += e.bytes;
+
+  EntryIterator inserted = entries_.insert(key, e);
+  inserted->last_access = ++access_counter_;
+
+  BindEntry(output, time, inserted);
+
+  return true;
+}
+
+void FrameCache::DeleteTextures(const FrameCache::Entry &e)
+{
+  delete e.buffer;
+  delete e.compressed;
+}
+
+void FrameCache::Clear()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  foreach (const Entry& e, entries_) {
+    DeleteTextures(e);
+  }
+
+  entries_.clear();
+  frames_.clear();
+  allocated_ = 0;
+
+  // Keep the timebases, nothing is valid any more
+  QHash<NodeOutput*, Validity>::iterator j;
+
+  for (j=validity_.begin();j!=validity_.end();j++) {
+    j->dividers.clear();
+  }
+}
+
+FrameCache::Entry *FrameCache::Find(NodeOutput *output, const rational &time, int divider)
+{
+  mutex_.lock();
+
+  QHash< NodeOutput*, QMap<rational, QByteArray> >::const_iterator frames = frames_.constFind(output);
+
+  if (frames != frames_.constEnd()) {
+    QMap<rational, QByteArray>::const_iterator bound = frames->constFind(time);
+
+    if (bound != frames->constEnd()) {
+      // The content of a bound time can't have changed since Sync() would have unbound it
+      EntryIterator entry = entries_.find(bound.value());
+
+      return (entry->divider <= divider) ? &entry.value() : nullptr;
+    }
+  }
+
+  // Hashing walks the graph upstream of the output, so don't block other threads meanwhile
+  int generation = generation_;
+
+  mutex_.unlock();
+
+  QByteArray key = output->ContentHash(time);
+
+  mutex_.lock();
+
+  if (generation != generation_) {
+    return nullptr;
+  }
+
+  EntryIterator entry = entries_.find(key);
+
+  if (entry == entries_.end() || entry->divider > divider) {
+    return nullptr;
+  }
+
+  BindEntry(output, time, entry);
+
+  return &entry.value();
+}
+
+void FrameCache::BindEntry(NodeOutput *output, const rational &time, FrameCache::EntryIterator entry)
+{
+  QMap<rational, QByteArray>& frames = frames_[output];
+
+  QMap<rational, QByteArray>::iterator existing = frames.find(time);
+
+  if (existing != frames.end()) {
+    if (existing.value() == entry.key()) {
+      return;
+    }
+
+    DropBinding(output, time, existing.value());
+    frames.erase(existing);
+  }
+
+  frames.insert(time, entry.key());
+  entry->bindings.append({output, time});
+
+  SetValid(output, time, entry->divider, true);
+}
+
+void FrameCache::DropBinding(NodeOutput *output, const rational &time, const QByteArray &key)
+{
+  EntryIterator entry = entries_.find(key);
+
+  if (entry == entries_.end()) {
+    return;
+  }
+
+  for (int i=0;i<entry->bindings.size();i++) {
+    const Binding& b = entry->bindings.at(i);
+
+    if (b.output == output && b.time == time) {
+      entry->bindings.remove(i);
+      break;
+    }
+  }
+
+  SetValid(output, time, entry->divider, false);
+}
+
+void FrameCache::FreeForIncoming(qint64 incoming)
+{
+  while (allocated_ > 0 && allocated_ + incoming > budget_) {
+    // Find the least recently used frame
+    EntryIterator oldest = entries_.end();
+    EntryIterator i;
+
+    for (i=entries_.begin();i!=entries_.end();i++) {
+      if (oldest == entries_.end() || i->last_access < oldest->last_access) {
+        oldest = i;
+      }
+    }
+
+    if (oldest == entries_.end()) {
+      break;
+    }
+
+    DestroyEntry(oldest);
+  }
+}
+
+void FrameCache::DestroyEntry(FrameCache::EntryIterator entry)
+{
+  foreach (const Binding& b, entry->bindings) {
+    frames_[b.output].remove(b.time);
+
+    SetValid(b.output, b.time, entry->divider, false);
+  }
+
+  // Every context shares objects, so buffers can be freed from any of them
+  DeleteTextures(entry.value());
+
+  allocated_ -= entry->bytes;
+
+  entries_.erase(entry);
+}
+
+void FrameCache::SetValid(NodeOutput *output, const rational &time, int divider, bool valid)
+{
+  QHash<NodeOutput*, Validity>::iterator validity = validity_.find(output);
+
+  if (validity == validity_.end() || validity->timebase == rational()) {
+    return;
+  }
+
+  int64_t frame = olive::TimeToTicks(time, validity->timebase);
+
+  // Only times that are exactly on a frame count
+  if (olive::TicksToTime(frame, validity->timebase) != time) {
+    return;
+  }
+
+  if (valid) {
+    validity->dividers[divider].Insert(frame);
+  } else {
+    QMap<int, FrameRunList>::iterator runs = validity->dividers.find(divider);
+
+    if (runs != validity->dividers.end()) {
+      runs->Remove(frame);
+    }
+  }
+}
@@ -0,0 +1,274 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include "common/framerunlist.h"
+#include "common/profiledmutex.h"
+#include "common/rational.h"
+#include "render/compressedtexture.h"
+#include "render/texturebuffer.h"
+
+class NodeOutput;
+
+/**
+ * @brief Finished frames kept in VRAM so they can be shown again without rendering them
+ *
+ * Frames are stored by content, i.e. by the NodeOutput::ContentHash() of the output and time they were rendered for,
+ * along with the divider they were rendered at, and a frame satisfies any request at that divider or a higher one (a
+ * full resolution frame can stand in for a preview). Each output and time a frame was requested or rendered for is
+ * bound to it, so looking up a time again is a single lookup. A time that isn't bound yet is hashed and bound to the
+ * frame with the same content if there is one: a still section only renders once, and a duplicated timeline or an
+ * edit that's undone shows frames that were already rendered. Only frames whose rendering has completed on the GPU
+ * are inserted, so every frame contains() reports can be shown immediately: e.g. a segment that's been rendered ahead
+ * (see RenderAhead) plays back in real time however heavy it is.
+ *
+ * The parts of the graph that change are reported through Node::TakeInvalidatedRanges(), Sync() unbinds the times
+ * they affect. Their frames are kept in case the content comes back. When the budget is exceeded, the least recently
+ * used frames are freed.
+ *
+ * Frames can be kept block-compressed (see CompressedTexture) to fit several times as many in the same budget, at
+ * preview quality. Compression is off by default, see set_compression_enabled().
+ *
+ * For outputs given a timebase with SetTimebase(), which frames are cached is also kept as runs of frame numbers (see
+ * valid_frames()), so the state of a whole timeline can be read without looking up every frame.
+ *
+ * All functions are thread-safe.
+ */
+class FrameCache
+{
+public:
+  FrameCache();
+
+  ~FrameCache();
+
+  FrameCache(const FrameCache& other) = delete;
+  FrameCache(FrameCache&& other) = delete;
+  FrameCache& operator=(const FrameCache& other) = delete;
+  FrameCache& operator=(FrameCache&& other) = delete;
+
+  /**
+   * @brief Set the maximum number of bytes of VRAM cached frames may use (defaults to 1 GiB)
+   */
+  void SetBudget(qint64 bytes);
+
+  qint64 budget();
+
+  qint64 allocated_bytes();
+
+  /**
+   * @brief Unbind the times of an output that changes to the graph have made invalid
+   *
+   * Call before looking up frames of an output.
+   */
+  void Sync(NodeOutput* output);
+
+  /**
+   * @brief Returns the texture of a frame rendered at `divider` or better, or 0 if there is none
+   *
+   * If the time isn't bound to a frame, it's hashed (outside the lock) and bound to a frame with the same content if
+   * there is one. The texture stays valid until the frame is evicted by a later Insert().
+   */
+  GLuint Get(NodeOutput* output, const rational& time, int divider);
+
+  /**
+   * @brief Returns TRUE if a frame rendered at `divider` or better is cached, binding it like Get()
+   */
+  bool Contains(NodeOutput* output, const rational& time, int divider);
+
+  /**
+   * @brief Bind a time to the frame with content `key` if one rendered at `divider` or better is cached
+   *
+   * For callers that already have the time's NodeOutput::ContentHash() (e.g. a render thread that's about to render
+   * it). Returns FALSE without binding anything if there's no such frame or the graph was invalidated since
+   * `generation` was taken.
+   */
+  bool Bind(NodeOutput* output, const rational& time, int divider, const QByteArray& key, int generation);
+
+  /**
+   * @brief Returns the times of an output bound to a cached frame, sorted
+   */
+  QList<rational> frames(NodeOutput* output);
+
+  /**
+   * @brief Set the timebase frames of an output are numbered in for valid_frames() (usually the sequence's)
+   */
+  void SetTimebase(NodeOutput* output, const rational& timebase);
+
+  /**
+   * @brief The frame numbers of an output that are cached at `divider` or better (Sync()s the output first)
+   *
+   * Kept up to date as frames are inserted, invalidated and evicted, e.g. for drawing which parts of a timeline are
+   * rendered or skipping frames that don't need rendering. Times that aren't on a frame of the output's timebase (e.g.
+   * while scrubbing) aren't included, and nothing is if SetTimebase() hasn't been called for the output.
+   */
+  FrameRunList valid_frames(NodeOutput* output, int divider);
+
+  /**
+   * @brief Incremented every time Sync() unbinds frames
+   *
+   * Frames started before an invalidation may show the old state of the graph, so record this when starting a frame
+   * and pass it to Insert().
+   */
+  int generation();
+
+  /**
+   * @brief Add a frame whose rendering has finished on the GPU, taking ownership of its buffer
+   *
+   * `key` is the NodeOutput::ContentHash() of the output at `time`, taken from the graph the frame was rendered with.
+   * The frame is bound to this time (replacing any frame bound to it before), and least recently used frames are
+   * freed until it fits in the budget. If a frame with the same content is already cached at `divider` or better, the
+   * time is bound to it instead and the buffer is deleted.
+   *
+   * @return
+   *
+   * TRUE if the frame was inserted. FALSE if the graph was invalidated since `generation` was taken, in which case the
+   * buffer is deleted.
+   */
+  bool Insert(NodeOutput* output, const rational& time, int divider, const QByteArray& key, TextureBuffer* buffer,
+              int generation);
+
+  /**
+   * @brief Add a compressed frame, taking ownership of it (see the other overload)
+   */
+  bool Insert(NodeOutput* output, const rational& time, int divider, const QByteArray& key,
+              CompressedTexture* texture, int generation);
+
+  /**
+   * @brief Whether renderers should compress the frames they cache where the GPU supports it (application-wide)
+   *
+   * Only affects frames inserted from now on.
+   */
+  static bool compression_enabled();
+
+  static void set_compression_enabled(bool enabled);
+
+  /**
+   * @brief Free every frame
+   */
+  void Clear();
+
+private:
+  /**
+   * @brief An output and time bound to a frame
+   */
+  struct Binding {
+    NodeOutput* output;
+    rational time;
+  };
+
+  struct Entry {
+    // Exactly one of these is set
+    TextureBuffer* buffer;
+    CompressedTexture* compressed;
+
+    int divider;
+    qint64 bytes;
+    qint64 last_access;
+
+    // Every output and time this frame is shown for
+    QVector<Binding> bindings;
+  };
+
+  using EntryIterator = QHash<QByteArray, Entry>::iterator;
+
+  /**
+   * @brief Add a frame whose textures are in `e`, see Insert()
+   */
+  bool InsertEntry(NodeOutput* output, const rational& time, const QByteArray& key, const Entry& e, int generation);
+
+  /**
+   * @brief Delete the textures of a frame
+   */
+  static void DeleteTextures(const Entry& e);
+
+  /**
+   * @brief Find the frame bound to a time, or bind one with the same content (see Get())
+   *
+   * Locks mutex_ and returns with it locked, the mutex is unlocked while hashing.
+   */
+  Entry* Find(NodeOutput* output, const rational& time, int divider);
+
+  /**
+   * @brief Bind a time to a frame, replacing whatever was bound to it (mutex_ must be locked)
+   */
+  void BindEntry(NodeOutput* output, const rational& time, EntryIterator entry);
+
+  /**
+   * @brief Remove a time from the bindings of the frame `key` and from its output's Validity (mutex_ must be locked)
+   *
+   * The caller removes it from frames_.
+   */
+  void DropBinding(NodeOutput* output, const rational& time, const QByteArray& key);
+
+  /**
+   * @brief Free least recently used frames until `incoming` more bytes fit in the budget (mutex_ must be locked)
+   */
+  void FreeForIncoming(qint64 incoming);
+
+  /**
+   * @brief Unbind every time bound to a frame and free it (mutex_ must be locked)
+   */
+  void DestroyEntry(EntryIterator entry);
+
+  /**
+   * @brief Which frames of an output are cached, see valid_frames()
+   */
+  struct Validity {
+    rational timebase;
+
+    // Frames cached at each divider
+    QMap<int, FrameRunList> dividers;
+  };
+
+  /**
+   * @brief Add or remove a frame from its output's Validity (mutex_ must be locked)
+   */
+  void SetValid(NodeOutput* output, const rational& time, int divider, bool valid);
+
+  // Frames by content hash
+  QHash<QByteArray, Entry> entries_;
+
+  // The content hash of the frame each output's times are bound to
+  QHash< NodeOutput*, QMap<rational, QByteArray> > frames_;
+
+  QHash<NodeOutput*, Validity> validity_;
+
+  qint64 budget_;
+
+  qint64 allocated_;
+
+  // Incremented on every access to order frames by how recently they were used
+  qint64 access_counter_;
+
+  int generation_;
+
+  ProfiledMutex mutex_;
+};
+
+#endif // FRAMECACHE_H
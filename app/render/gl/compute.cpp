@@ -0,0 +1,386 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "compute.h"
+
+#include <cstring>
+#include <QtMath>
+
+#include "shadercache.h"
+
+// Workgroups (of kStatisticsGroupSize invocations) ComputeStatistics() reduces the texture in
+const int kStatisticsGroups = 256;
+const int kStatisticsGroupSize = 256;
+
+// Partial results each ComputeStatistics() workgroup writes (min, max and sum)
+const int kStatisticsPartials = 3;
+
+// Most bins ComputeHistogram() supports, limited by the shared memory each workgroup needs for its own histogram
+const int kMaxHistogramBins = 1024;
+
+const char* kStatisticsShader =
+    "layout(local_size_x = %1) in;\n"
+    "\n"
+    "uniform sampler2D tex;\n"
+    "uniform ivec2 size;\n"
+    "\n"
+    "layout(std430, binding = 0) writeonly buffer Partials {\n"
+    "  vec4 partials[];\n"
+    "};\n"
+    "\n"
+    "shared vec4 s_min[%1];\n"
+    "shared vec4 s_max[%1];\n"
+    "shared vec4 s_sum[%1];\n"
+    "\n"
+    "void main() {\n"
+    "  uint index = gl_LocalInvocationIndex;\n"
+    "  uint total = uint(size.x * size.y);\n"
+    "  uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;\n"
+    "\n"
+    "  vec4 lo = vec4(3.402823e38);\n"
+    "  vec4 hi = vec4(-3.402823e38);\n"
+    "  vec4 sum = vec4(0.0);\n"
+    "\n"
+    "  for (uint i = gl_GlobalInvocationID.x; i < total; i += stride) {\n"
+    "    vec4 c = texelFetch(tex, ivec2(int(i % uint(size.x)), int(i / uint(size.x))), 0);\n"
+    "    lo = min(lo, c);\n"
+    "    hi = max(hi, c);\n"
+    "    sum += c;\n"
+    "  }\n"
+    "\n"
+    "  s_min[index] = lo;\n"
+    "  s_max[index] = hi;\n"
+    "  s_sum[index] = sum;\n"
+    "\n"
+    "  barrier();\n"
+    "\n"
+    "  for (uint s = gl_WorkGroupSize.x / 2u; s > 0u; s >>= 1u) {\n"
+    "    if (index < s) {\n"
+    "      s_min[index] = min(s_min[index], s_min[index + s]);\n"
+    "      s_max[index] = max(s_max[index], s_max[index + s]);\n"
+    "      s_sum[index] += s_sum[index + s];\n"
+    "    }\n"
+    "\n"
+    "    barrier();\n"
+    "  }\n"
+    "\n"
+    "  if (index == 0u) {\n"
+    "    uint base = gl_WorkGroupID.x * %2u;\n"
+    "    partials[base] = s_min[0];\n"
+    "    partials[base + 1u] = s_max[0];\n"
+    "    partials[base + 2u] = s_sum[0];\n"
+    "  }\n"
+    "}\n";
+
+const char* kHistogramShader =
+    "#define BINS %2\n"
+    "\n"
+    "layout(local_size_x = %1, local_size_y = %1) in;\n"
+    "\n"
+    "uniform sampler2D tex;\n"
+    "uniform ivec2 size;\n"
+    "\n"
+    "layout(std430, binding = 0) buffer Histogram {\n"
+    "  uint counts[];\n"
+    "};\n"
+    "\n"
+    "shared uint s_counts[BINS * 4];\n"
+    "\n"
+    "uint bin(float v) {\n"
+    "  return uint(clamp(int(v * float(BINS)), 0, BINS - 1));\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "  uint index = gl_LocalInvocationIndex;\n"
+    "  uint group_size = gl_WorkGroupSize.x * gl_WorkGroupSize.y;\n"
+    "\n"
+    "  for (uint i = index; i < uint(BINS * 4); i += group_size) {\n"
+    "    s_counts[i] = 0u;\n"
+    "  }\n"
+    "\n"
+    "  barrier();\n"
+    "\n"
+    "  ivec2 pos = ivec2(gl_GlobalInvocationID.xy);\n"
+    "\n"
+    "  if (pos.x < size.x && pos.y < size.y) {\n"
+    "    vec4 c = texelFetch(tex, pos, 0);\n"
+    "    float luma = dot(c.rgb, vec3(0.2126, 0.7152, 0.0722));\n"
+    "\n"
+    "    atomicAdd(s_counts[bin(c.r)], 1u);\n"
+    "    atomicAdd(s_counts[BINS + bin(c.g)], 1u);\n"
+    "    atomicAdd(s_counts[BINS * 2 + bin(c.b)], 1u);\n"
+    "    atomicAdd(s_counts[BINS * 3 + bin(luma)], 1u);\n"
+    "  }\n"
+    "\n"
+    "  barrier();\n"
+    "\n"
+    "  // Only touch the global histogram once per bin per workgroup\n"
+    "  for (uint i = index; i < uint(BINS * 4); i += group_size) {\n"
+    "    if (s_counts[i] > 0u) {\n"
+    "      atomicAdd(counts[i], s_counts[i]);\n"
+    "    }\n"
+    "  }\n"
+    "}\n";
+
+bool olive::gl::SupportsCompute(QOpenGLContext *ctx)
+{
+  return ctx->format().version() >= qMakePair(4, 3) || ctx->hasExtension("GL_ARB_compute_shader");
+}
+
+ShaderPtr olive::gl::GetComputePipeline(const QString &source)
+{
+  QString versioned = QStringLiteral("#version 430 core\n\n");
+  versioned.append(source);
+
+  return shader_cache.GetCompute(versioned);
+}
+
+void olive::gl::DispatchOverTexture(ShaderPtr pipeline, GLuint texture, int width, int height)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  xf->glActiveTexture(GL_TEXTURE0);
+  xf->glBindTexture(GL_TEXTURE_2D, texture);
+
+  pipeline->bind();
+  pipeline->setUniformValue("tex", 0);
+  pipeline->setUniformValue("size", width, height);
+
+  xf->glDispatchCompute(static_cast<GLuint>((width + kComputeTileSize - 1) / kComputeTileSize),
+                        static_cast<GLuint>((height + kComputeTileSize - 1) / kComputeTileSize),
+                        1);
+
+  xf->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  pipeline->release();
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+olive::gl::StorageBuffer::StorageBuffer() :
+  buffer_(0),
+  size_(0)
+{
+}
+
+olive::gl::StorageBuffer::~StorageBuffer()
+{
+  Destroy();
+}
+
+void olive::gl::StorageBuffer::Allocate(int size, const void *data)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  if (buffer_ == 0) {
+    xf->glGenBuffers(1, &buffer_);
+  }
+
+  QByteArray zeroes;
+
+  if (data == nullptr) {
+    zeroes.fill('\0', size);
+    data = zeroes.constData();
+  }
+
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+
+  if (size == size_) {
+    xf->glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+  } else {
+    xf->glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+    size_ = size;
+  }
+
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void olive::gl::StorageBuffer::Reserve(int size)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  if (buffer_ == 0) {
+    xf->glGenBuffers(1, &buffer_);
+  } else if (size == size_) {
+    return;
+  }
+
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+  xf->glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  size_ = size;
+}
+
+void olive::gl::StorageBuffer::Clear()
+{
+  Allocate(size_);
+}
+
+void olive::gl::StorageBuffer::Bind(GLuint binding)
+{
+  QOpenGLContext::currentContext()->extraFunctions()->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer_);
+}
+
+bool olive::gl::StorageBuffer::Read(void *dst, int size)
+{
+  if (buffer_ == 0 || size > size_) {
+    return false;
+  }
+
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_);
+
+  void* mapped = xf->glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, GL_MAP_READ_BIT);
+
+  bool ok = (mapped != nullptr);
+
+  if (ok) {
+    memcpy(dst, mapped, static_cast<size_t>(size));
+    xf->glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  }
+
+  xf->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  return ok;
+}
+
+void olive::gl::StorageBuffer::Destroy()
+{
+  if (buffer_ != 0) {
+    QOpenGLContext::currentContext()->functions()->glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    size_ = 0;
+  }
+}
+
+bool olive::gl::ComputeStatistics(GLuint texture, int width, int height, TextureStatistics *stats)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (!SupportsCompute(ctx) || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  ShaderPtr pipeline = GetComputePipeline(QString::fromLatin1(kStatisticsShader)
+                                          .arg(kStatisticsGroupSize)
+                                          .arg(kStatisticsPartials));
+
+  if (pipeline == nullptr) {
+    return false;
+  }
+
+  // Small textures don't need every group
+  int groups = qMin(kStatisticsGroups, (width * height + kStatisticsGroupSize - 1) / kStatisticsGroupSize);
+
+  QVector<QVector4D> partials(groups * kStatisticsPartials);
+  int partials_size = partials.size() * static_cast<int>(sizeof(QVector4D));
+
+  StorageBuffer buffer;
+  buffer.Allocate(partials_size);
+  buffer.Bind(0);
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  xf->glActiveTexture(GL_TEXTURE0);
+  xf->glBindTexture(GL_TEXTURE_2D, texture);
+
+  pipeline->bind();
+  pipeline->setUniformValue("tex", 0);
+  pipeline->setUniformValue("size", width, height);
+
+  xf->glDispatchCompute(static_cast<GLuint>(groups), 1, 1);
+  xf->glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  pipeline->release();
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  bool ok = buffer.Read(partials.data(), partials_size);
+
+  buffer.Destroy();
+
+  if (!ok) {
+    return false;
+  }
+
+  // Combine the partial results, summing in double precision
+  QVector4D min = partials.at(0);
+  QVector4D max = partials.at(1);
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+
+  for (int i=0;i<groups;i++) {
+    const QVector4D& group_min = partials.at(i * kStatisticsPartials);
+    const QVector4D& group_max = partials.at(i * kStatisticsPartials + 1);
+    const QVector4D& group_sum = partials.at(i * kStatisticsPartials + 2);
+
+    for (int j=0;j<4;j++) {
+      min[j] = qMin(min[j], group_min[j]);
+      max[j] = qMax(max[j], group_max[j]);
+      sum[j] += group_sum[j];
+    }
+  }
+
+  double pixel_count = static_cast<double>(width) * static_cast<double>(height);
+
+  stats->min = min;
+  stats->max = max;
+
+  for (int j=0;j<4;j++) {
+    stats->average[j] = static_cast<float>(sum[j] / pixel_count);
+  }
+
+  return true;
+}
+
+bool olive::gl::ComputeHistogram(GLuint texture, int width, int height, int bins, QVector<quint32> *histogram)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (!SupportsCompute(ctx) || width <= 0 || height <= 0 || bins <= 0 || bins > kMaxHistogramBins) {
+    return false;
+  }
+
+  ShaderPtr pipeline = GetComputePipeline(QString::fromLatin1(kHistogramShader).arg(kComputeTileSize).arg(bins));
+
+  if (pipeline == nullptr) {
+    return false;
+  }
+
+  QVector<quint32> counts(bins * 4);
+  int counts_size = counts.size() * static_cast<int>(sizeof(quint32));
+
+  StorageBuffer buffer;
+  buffer.Allocate(counts_size);
+  buffer.Bind(0);
+
+  DispatchOverTexture(pipeline, texture, width, height);
+
+  bool ok = buffer.Read(counts.data(), counts_size);
+
+  buffer.Destroy();
+
+  if (ok) {
+    *histogram = counts;
+  }
+
+  return ok;
+}
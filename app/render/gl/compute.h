@@ -0,0 +1,172 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef GLCOMPUTE_H
+#define GLCOMPUTE_H
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QVector>
+#include <QVector4D>
+
+#include "shaderptr.h"
+
+namespace olive {
+namespace gl {
+
+/**
+ * @brief Returns TRUE if a context can run compute shaders (OpenGL 4.3 or GL_ARB_compute_shader)
+ *
+ * Olive only requires OpenGL 3.2, so every user of the functions below needs a fallback (usually reading the texture
+ * back and analyzing it on the CPU) for when this returns FALSE.
+ */
+bool SupportsCompute(QOpenGLContext* ctx);
+
+/**
+ * @brief Returns a compute program built from `source`, compiled once per context through the ShaderCache
+ *
+ * The source doesn't need a #version line, it's prepended automatically. By convention, analysis shaders sample the
+ * input texture `tex` (unit 0) with texelFetch(), read its dimensions from the ivec2 uniform `size` and have a local
+ * size of kComputeTileSize x kComputeTileSize, so they can be run with DispatchOverTexture().
+ */
+ShaderPtr GetComputePipeline(const QString& source);
+
+/**
+ * @brief Width and height of the workgroups DispatchOverTexture() expects
+ */
+const int kComputeTileSize = 16;
+
+/**
+ * @brief Run a compute program once for every pixel of a texture
+ *
+ * Binds `texture` to unit 0, sets the `tex` and `size` uniforms, dispatches enough kComputeTileSize x kComputeTileSize
+ * workgroups to cover the texture and places a barrier so storage buffer writes are visible to whatever reads them next.
+ * Storage buffers used by the program must already be bound.
+ */
+void DispatchOverTexture(ShaderPtr pipeline, GLuint texture, int width, int height);
+
+/**
+ * @brief A shader storage buffer object (SSBO) for compute shader input and output
+ *
+ * The buffer belongs to the context that was current when it was allocated, and must be destroyed (or go out of scope)
+ * with that context current.
+ */
+class StorageBuffer
+{
+public:
+  StorageBuffer();
+
+  ~StorageBuffer();
+
+  StorageBuffer(const StorageBuffer& other) = delete;
+  StorageBuffer(StorageBuffer&& other) = delete;
+  StorageBuffer& operator=(const StorageBuffer& other) = delete;
+  StorageBuffer& operator=(StorageBuffer&& other) = delete;
+
+  /**
+   * @brief (Re)allocate the buffer with `size` bytes, initialized to `data` or zeroes if it's nullptr
+   *
+   * The existing buffer object is reused if it's already this size.
+   */
+  void Allocate(int size, const void* data = nullptr);
+
+  /**
+   * @brief (Re)allocate the buffer with `size` bytes without initializing them, for buffers a dispatch fills entirely
+   *
+   * The existing buffer object is kept as it is if it's already this size.
+   */
+  void Reserve(int size);
+
+  /**
+   * @brief Set the whole buffer to zero without reallocating it
+   */
+  void Clear();
+
+  /**
+   * @brief Bind to an indexed binding point (the `binding` in the shader's layout qualifier)
+   */
+  void Bind(GLuint binding);
+
+  /**
+   * @brief Copy the start of the buffer into `dst` (waits for any dispatches writing to it to finish)
+   */
+  bool Read(void* dst, int size);
+
+  /**
+   * @brief Free the buffer
+   */
+  void Destroy();
+
+  GLuint id() const
+  {
+    return buffer_;
+  }
+
+  int size() const
+  {
+    return size_;
+  }
+
+private:
+  GLuint buffer_;
+
+  int size_;
+};
+
+/**
+ * @brief Per channel statistics of a texture, see ComputeStatistics()
+ */
+struct TextureStatistics {
+  QVector4D min;
+  QVector4D max;
+  QVector4D average;
+};
+
+/**
+ * @brief Calculate the minimum, maximum and average of each channel of a texture on the GPU
+ *
+ * Reduces the texture in a few hundred workgroups that each write one partial result, so only a few kilobytes are read
+ * back instead of the whole frame.
+ *
+ * @return
+ *
+ * FALSE if compute shaders aren't supported, in which case `stats` is untouched.
+ */
+bool ComputeStatistics(GLuint texture, int width, int height, TextureStatistics* stats);
+
+/**
+ * @brief Calculate histograms of a texture's red, green, blue and luma (Rec. 709) on the GPU
+ *
+ * Values from 0.0 to 1.0 are spread over `bins` bins. Out of range values are counted in the first or last bin.
+ *
+ * @param histogram
+ *
+ * Receives 4 * `bins` counts: all red bins, then green, blue and luma.
+ *
+ * @return
+ *
+ * FALSE if compute shaders aren't supported, in which case `histogram` is untouched.
+ */
+bool ComputeHistogram(GLuint texture, int width, int height, int bins, QVector<quint32>* histogram);
+
+}
+}
+
+#endif // GLCOMPUTE_H
@@ -20,9 +20,18 @@
 
 #include "functions.h"
 
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLVertexArrayObject>
-#include <QOpenGLBuffer>
+#include <QVector2D>
+#include <QtMath>
 
 const GLfloat blit_vertices[] = {
   -1.0f, -1.0f, 0.0f,
@@ -54,63 +63,428 @@ const GLfloat flipped_blit_texcoords[] = {
   1.0, 0.0
 };
 
+/**
+ * @brief Mipmap state of a texture that reports its modifications (see olive::gl::MarkTextureModified())
+ */
+struct MipmapRecord {
+  // Incremented every time the texture is modified
+  quint64 version;
+
+  // Value of version when mipmaps were last generated
+  quint64 mipmapped_version;
+
+  // Highest mipmap level generated
+  int mipmapped_level;
+};
+
+QHash<GLuint, MipmapRecord> mipmap_records;
+QMutex mipmap_records_mutex;
+
+// Mipmap levels to generate for a complete chain
+const int kFullMipmapChain = 1000;
+
+void olive::gl::MarkTextureModified(GLuint texture)
+{
+  QMutexLocker locker(&mipmap_records_mutex);
+
+  QHash<GLuint, MipmapRecord>::iterator it = mipmap_records.find(texture);
+
+  if (it == mipmap_records.end()) {
+    MipmapRecord record;
+    record.version = 1;
+    record.mipmapped_version = 0;
+    record.mipmapped_level = 0;
+    mipmap_records.insert(texture, record);
+  } else {
+    it->version++;
+  }
+}
+
+void olive::gl::MarkMipmapsComplete(GLuint texture)
+{
+  QMutexLocker locker(&mipmap_records_mutex);
+
+  MipmapRecord record;
+  record.version = 1;
+  record.mipmapped_version = 1;
+  record.mipmapped_level = kFullMipmapChain;
+  mipmap_records.insert(texture, record);
+}
+
+void olive::gl::ForgetTexture(GLuint texture)
+{
+  QMutexLocker locker(&mipmap_records_mutex);
+
+  mipmap_records.remove(texture);
+}
+
+/**
+ * @brief Returns TRUE if a texture needs its mipmaps (re)generating up to a certain level, and records that it has
+ *
+ * Textures that don't report their modifications always need generating.
+ */
+bool NeedsMipmaps(GLuint texture, int level)
+{
+  QMutexLocker locker(&mipmap_records_mutex);
+
+  QHash<GLuint, MipmapRecord>::iterator it = mipmap_records.find(texture);
+
+  if (it == mipmap_records.end()) {
+    return true;
+  }
+
+  if (it->mipmapped_version == it->version && it->mipmapped_level >= level) {
+    return false;
+  }
+
+  it->mipmapped_version = it->version;
+  it->mipmapped_level = level;
+
+  return true;
+}
+
 /**
  * @brief Set up texture parameters and mipmap for drawing
  *
- * Internal function used just before drawing to allow mipmapped bilinear filtering when drawing textures small.
+ * Internal function used just before drawing the texture bound to the active unit. Mipmaps are only generated if the
+ * texture is drawn smaller than it is (minified), and only once for each modification of the texture. When it isn't
+ * minified, plain bilinear filtering is used.
+ *
+ * @param ctx
+ *
+ * Current context
+ *
+ * @param matrix
  *
- * @param f
+ * Transformation the texture will be drawn with (the quad spans the whole viewport without one)
  *
- * Currently active QOpenGLFunctions object (use context()->functions() if unsure).
+ * @param quality
+ *
+ * With kMipmapPreview, only the levels needed for this draw are generated and the nearest level is sampled.
+ */
+void PrepareToDraw(QOpenGLContext* ctx, const QMatrix4x4& matrix, olive::gl::MipmapQuality quality) {
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+  GLint texture = 0;
+  xf->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+
+  GLint tex_width = 0;
+  GLint tex_height = 0;
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &tex_width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &tex_height);
+
+  GLint viewport[4];
+  xf->glGetIntegerv(GL_VIEWPORT, viewport);
+
+  // Size of the quad on screen in pixels (the matrix's scale applied to the viewport)
+  float draw_width = viewport[2] * QVector2D(matrix(0, 0), matrix(1, 0)).length();
+  float draw_height = viewport[3] * QVector2D(matrix(0, 1), matrix(1, 1)).length();
+
+  float ratio = 0.0f;
+
+  if (draw_width > 0.0f && draw_height > 0.0f) {
+    ratio = qMax(static_cast<float>(tex_width) / draw_width, static_cast<float>(tex_height) / draw_height);
+  }
+
+  // Drawn at 1:1 or magnified, mipmaps wouldn't be sampled anyway
+  if (texture == 0 || ratio <= 1.0f) {
+    xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    return;
+  }
+
+  int level;
+
+  if (quality == olive::gl::kMipmapPreview) {
+    // Only the level closest to the drawn size (and the one above it for rounding) is sampled
+    level = qCeil(std::log2(ratio));
+  } else {
+    level = kFullMipmapChain;
+  }
+
+  if (NeedsMipmaps(static_cast<GLuint>(texture), level)) {
+    xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+    xf->glGenerateMipmap(GL_TEXTURE_2D);
+  }
+
+  xf->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      (quality == olive::gl::kMipmapPreview) ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
+}
+
+// Floats per vertex for each attribute, and where each attribute starts in the blit VBO
+const int kBlitVertexSize = 3;
+const int kBlitTexcoordSize = 2;
+const int kBlitVertexCount = 6;
+const int kBlitTexcoordOffset = kBlitVertexSize * kBlitVertexCount;
+const int kBlitFlippedTexcoordOffset = kBlitTexcoordOffset + kBlitTexcoordSize * kBlitVertexCount;
+const int kBlitTotalFloats = kBlitFlippedTexcoordOffset + kBlitTexcoordSize * kBlitVertexCount;
+
+/**
+ * @brief Locations used by the blit functions in a pipeline, looked up once per shader
+ */
+struct BlitLocations {
+  int position;
+  int texcoord;
+  int mvp_matrix;
+  int texture;
+  int opacity;
+};
+
+/**
+ * @brief Quad geometry for blitting, created once per context (VAOs can't be shared between contexts)
+ */
+struct BlitGeometry {
+  QOpenGLVertexArrayObject vao;
+  QOpenGLBuffer vbo;
+
+  // Attribute locations and texcoords the VAO is currently set up with (-1 if it isn't set up)
+  int configured_position;
+  int configured_texcoord;
+  bool configured_flipped;
+};
+
+QHash<QOpenGLContext*, BlitGeometry*> blit_geometry;
+QMutex blit_geometry_mutex;
+
+QHash<QOpenGLShaderProgram*, BlitLocations> blit_locations;
+QMutex blit_locations_mutex;
+
+/**
+ * @brief Return the blit geometry for the current context, creating it if necessary
+ */
+BlitGeometry* GetBlitGeometry(QOpenGLContext* ctx)
+{
+  QMutexLocker locker(&blit_geometry_mutex);
+
+  BlitGeometry* geom = blit_geometry.value(ctx);
+
+  if (geom != nullptr) {
+    return geom;
+  }
+
+  geom = new BlitGeometry();
+  geom->configured_position = -1;
+  geom->configured_texcoord = -1;
+  geom->configured_flipped = false;
+
+  GLfloat data[kBlitTotalFloats];
+  memcpy(data, blit_vertices, sizeof(blit_vertices));
+  memcpy(data + kBlitTexcoordOffset, blit_texcoords, sizeof(blit_texcoords));
+  memcpy(data + kBlitFlippedTexcoordOffset, flipped_blit_texcoords, sizeof(flipped_blit_texcoords));
+
+  geom->vao.create();
+
+  geom->vbo.create();
+  geom->vbo.bind();
+  geom->vbo.allocate(data, static_cast<int>(sizeof(data)));
+  geom->vbo.release();
+
+  blit_geometry.insert(ctx, geom);
+
+  // Free the geometry with the context (which is current while this signal is emitted)
+  QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [ctx]() {
+    blit_geometry_mutex.lock();
+    BlitGeometry* g = blit_geometry.take(ctx);
+    blit_geometry_mutex.unlock();
+
+    g->vao.destroy();
+    g->vbo.destroy();
+    delete g;
+  });
+
+  return geom;
+}
+
+/**
+ * @brief Return the blit locations of a pipeline, looking them up if necessary
  */
-void PrepareToDraw(QOpenGLFunctions* f) {
-  f->glGenerateMipmap(GL_TEXTURE_2D);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+BlitLocations GetBlitLocations(QOpenGLShaderProgram* pipeline)
+{
+  QMutexLocker locker(&blit_locations_mutex);
+
+  QHash<QOpenGLShaderProgram*, BlitLocations>::const_iterator it = blit_locations.constFind(pipeline);
+
+  if (it != blit_locations.constEnd()) {
+    return it.value();
+  }
+
+  BlitLocations loc;
+  loc.position = pipeline->attributeLocation("a_position");
+  loc.texcoord = pipeline->attributeLocation("a_texcoord");
+  loc.mvp_matrix = pipeline->uniformLocation("mvp_matrix");
+  loc.texture = pipeline->uniformLocation("texture");
+  loc.opacity = pipeline->uniformLocation("opacity");
+
+  blit_locations.insert(pipeline, loc);
+
+  // Forget the locations with the shader (its address may be reused)
+  QObject::connect(pipeline, &QObject::destroyed, [pipeline]() {
+    QMutexLocker l(&blit_locations_mutex);
+    blit_locations.remove(pipeline);
+  });
+
+  return loc;
 }
 
-void olive::gl::Blit(ShaderPtr pipeline, bool flipped, QMatrix4x4 matrix) {
+/**
+ * @brief Point the VAO's attributes at the pipeline's locations and the right texcoords (the VAO must be bound)
+ */
+void ConfigureBlitGeometry(QOpenGLFunctions* func, BlitGeometry* geom, const BlitLocations& loc, bool flipped)
+{
+  if (geom->configured_position == loc.position
+      && geom->configured_texcoord == loc.texcoord
+      && geom->configured_flipped == flipped) {
+    return;
+  }
+
+  // Disable attributes of pipelines with other locations
+  if (geom->configured_position > -1 && geom->configured_position != loc.position) {
+    func->glDisableVertexAttribArray(static_cast<GLuint>(geom->configured_position));
+  }
+
+  if (geom->configured_texcoord > -1 && geom->configured_texcoord != loc.texcoord) {
+    func->glDisableVertexAttribArray(static_cast<GLuint>(geom->configured_texcoord));
+  }
+
+  geom->vbo.bind();
+
+  if (loc.position > -1) {
+    func->glEnableVertexAttribArray(static_cast<GLuint>(loc.position));
+    func->glVertexAttribPointer(static_cast<GLuint>(loc.position), kBlitVertexSize, GL_FLOAT, GL_FALSE, 0, nullptr);
+  }
+
+  if (loc.texcoord > -1) {
+    size_t offset = static_cast<size_t>(flipped ? kBlitFlippedTexcoordOffset : kBlitTexcoordOffset) * sizeof(GLfloat);
+
+    func->glEnableVertexAttribArray(static_cast<GLuint>(loc.texcoord));
+    func->glVertexAttribPointer(static_cast<GLuint>(loc.texcoord), kBlitTexcoordSize, GL_FLOAT, GL_FALSE, 0,
+                                reinterpret_cast<const void*>(offset));
+  }
+
+  geom->vbo.release();
+
+  geom->configured_position = loc.position;
+  geom->configured_texcoord = loc.texcoord;
+  geom->configured_flipped = flipped;
+}
+
+void olive::gl::Blit(ShaderPtr pipeline, bool flipped, QMatrix4x4 matrix, MipmapQuality quality) {
   // FIXME: is currentContext() reliable here?
-  QOpenGLFunctions* func = QOpenGLContext::currentContext()->functions();
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLFunctions* func = ctx->functions();
+
+  PrepareToDraw(ctx, matrix, quality);
+
+  BlitGeometry* geom = GetBlitGeometry(ctx);
+  BlitLocations loc = GetBlitLocations(pipeline.get());
+
+  pipeline->bind();
 
-  PrepareToDraw(func);
+  pipeline->setUniformValue(loc.mvp_matrix, matrix);
+  pipeline->setUniformValue(loc.texture, 0);
 
-  QOpenGLVertexArrayObject m_vao;
-  m_vao.create();
-  m_vao.bind();
+  geom->vao.bind();
 
-  QOpenGLBuffer m_vbo;
-  m_vbo.create();
-  m_vbo.bind();
-  m_vbo.allocate(blit_vertices, 18 * sizeof(GLfloat));
-  m_vbo.release();
+  ConfigureBlitGeometry(func, geom, loc, flipped);
 
-  QOpenGLBuffer m_vbo2;
-  m_vbo2.create();
-  m_vbo2.bind();
-  m_vbo2.allocate(flipped ? flipped_blit_texcoords : blit_texcoords, 12 * sizeof(GLfloat));
-  m_vbo2.release();
+  func->glDrawArrays(GL_TRIANGLES, 0, kBlitVertexCount);
+
+  geom->vao.release();
+
+  pipeline->release();
+}
+
+void olive::gl::BlitLayers(ShaderPtr pipeline, const QVector<BlitLayer> &layers, MipmapQuality quality)
+{
+  if (layers.isEmpty()) {
+    return;
+  }
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLFunctions* func = ctx->functions();
+
+  BlitGeometry* geom = GetBlitGeometry(ctx);
+  BlitLocations loc = GetBlitLocations(pipeline.get());
+
+  func->glActiveTexture(GL_TEXTURE0);
+
+  pipeline->bind();
+  pipeline->setUniformValue(loc.texture, 0);
+
+  geom->vao.bind();
+
+  for (int i=0;i<layers.size();i++) {
+    const BlitLayer& layer = layers.at(i);
+
+    func->glBindTexture(GL_TEXTURE_2D, layer.texture);
+
+    PrepareToDraw(ctx, layer.matrix, quality);
+
+    pipeline->setUniformValue(loc.mvp_matrix, layer.matrix);
+    pipeline->setUniformValue(loc.opacity, layer.opacity);
+
+    ConfigureBlitGeometry(func, geom, loc, layer.flipped);
+
+    func->glDrawArrays(GL_TRIANGLES, 0, kBlitVertexCount);
+  }
+
+  geom->vao.release();
+
+  func->glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Restore the pipeline's default opacity (see GetDefaultPipeline())
+  pipeline->setUniformValue(loc.opacity, 1.0f);
+
+  pipeline->release();
+}
+
+void olive::gl::BlitInstanced(ShaderPtr pipeline, const QVector<QMatrix4x4> &matrices, MipmapQuality quality)
+{
+  if (matrices.isEmpty()) {
+    return;
+  }
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  // Every copy samples the same texture, so prepare it for the one drawn smallest
+  int smallest = 0;
+  float smallest_area = std::numeric_limits<float>::max();
+
+  for (int i=0;i<matrices.size();i++) {
+    const QMatrix4x4& m = matrices.at(i);
+    float area = qAbs(m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0));
+
+    if (area < smallest_area) {
+      smallest = i;
+      smallest_area = area;
+    }
+  }
+
+  PrepareToDraw(ctx, matrices.at(smallest), quality);
+
+  BlitGeometry* geom = GetBlitGeometry(ctx);
+  BlitLocations loc = GetBlitLocations(pipeline.get());
+  int matrices_loc = pipeline->uniformLocation("instance_matrix");
 
   pipeline->bind();
 
-  pipeline->setUniformValue("mvp_matrix", matrix);
-  pipeline->setUniformValue("texture", 0);
+  geom->vao.bind();
+
+  ConfigureBlitGeometry(xf, geom, loc, false);
+
+  for (int start=0;start<matrices.size();start+=kMaxBlitInstances) {
+    int count = qMin(kMaxBlitInstances, matrices.size() - start);
 
-  GLuint vertex_location = static_cast<GLuint>(pipeline->attributeLocation("a_position"));
-  m_vbo.bind();
-  func->glEnableVertexAttribArray(vertex_location);
-  func->glVertexAttribPointer(vertex_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  m_vbo.release();
+    pipeline->setUniformValueArray(matrices_loc, matrices.constData() + start, count);
 
-  GLuint tex_location = static_cast<GLuint>(pipeline->attributeLocation("a_texcoord"));
-  m_vbo2.bind();
-  func->glEnableVertexAttribArray(tex_location);
-  func->glVertexAttribPointer(tex_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-  m_vbo2.release();
+    xf->glDrawArraysInstanced(GL_TRIANGLES, 0, kBlitVertexCount, count);
+  }
 
-  func->glDrawArrays(GL_TRIANGLES, 0, 6);
+  geom->vao.release();
 
   pipeline->release();
 }
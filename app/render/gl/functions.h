@@ -22,15 +22,63 @@
 #define GLFUNC_H
 
 #include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <QVector>
 
 #include "shaderptr.h"
 
 namespace olive {
 namespace gl {
 
+/**
+ * @brief How much effort to spend on mipmaps when drawing textures smaller than their size
+ */
+enum MipmapQuality {
+  /// Generate the full mipmap chain and sample with trilinear filtering
+  kMipmapFull,
+
+  /// Only generate the levels needed for the draw and sample the nearest one, for previews where speed matters more
+  kMipmapPreview
+};
+
+/**
+ * @brief Report that a texture's contents have changed
+ *
+ * Blit() only generates mipmaps for textures reported here when they've changed since their mipmaps were last
+ * generated. Textures that are never reported have their mipmaps generated on every minified draw. TextureBuffer and
+ * TextureUploader report their textures automatically.
+ */
+void MarkTextureModified(GLuint texture);
+
+/**
+ * @brief Report that a texture's owner has filled in its whole mipmap chain, so Blit() never generates them
+ *
+ * For textures that can't generate their own, e.g. compressed ones (see CompressedTexture).
+ */
+void MarkMipmapsComplete(GLuint texture);
+
+/**
+ * @brief Stop tracking a texture reported with MarkTextureModified() (e.g. when it's deleted)
+ */
+void ForgetTexture(GLuint texture);
+
+/**
+ * @brief A texture to draw with BlitLayers()
+ */
+struct BlitLayer {
+  GLuint texture;
+  QMatrix4x4 matrix;
+  bool flipped;
+  float opacity;
+};
+
 /**
  * @brief Draw texture on screen
  *
+ * Draws whichever texture is bound to the active texture unit. The quad geometry is created once per context and the
+ * pipeline's attribute and uniform locations are looked up once per shader, so this is cheap to call repeatedly.
+ * Mipmaps are only generated when the texture is minified (see MarkTextureModified()).
+ *
  * @param pipeline
  *
  * Shader to use for the texture drawing
@@ -42,8 +90,41 @@ namespace gl {
  * @param matrix
  *
  * Transformation matrix to use when drawing (defaults to no transform)
+ *
+ * @param quality
+ *
+ * Mipmap quality if the texture is minified (defaults to kMipmapFull)
+ */
+void Blit(ShaderPtr pipeline,
+          bool flipped = false,
+          QMatrix4x4 matrix = QMatrix4x4(),
+          MipmapQuality quality = kMipmapFull);
+
+/**
+ * @brief Draw several textures on top of each other with one pipeline
+ *
+ * Equivalent to binding each layer's texture and calling Blit() with its opacity set, but binds the pipeline and quad
+ * geometry once for all layers. Layers are drawn in order, so for a composite, pass them from bottom to top.
+ *
+ * Textures are drawn on texture unit 0, which is left unbound afterwards.
+ */
+void BlitLayers(ShaderPtr pipeline, const QVector<BlitLayer>& layers, MipmapQuality quality = kMipmapFull);
+
+/**
+ * @brief Most copies BlitInstanced() draws per draw call (the size of the pipeline's matrix array)
+ *
+ * Small enough for the matrices to fit in the vertex uniforms OpenGL 3.2 guarantees.
+ */
+const int kMaxBlitInstances = 48;
+
+/**
+ * @brief Draw copies of the texture bound to the active unit with one instanced draw call, one copy for each matrix
+ *
+ * Like calling Blit() once per matrix but the geometry and pipeline are only set up once and up to kMaxBlitInstances
+ * copies are drawn per call. Requires a pipeline from GetInstancedPipeline(). Copies are drawn in order, so enable
+ * blending for overlapping copies to composite. Mipmaps are generated for the smallest copy.
  */
-void Blit(ShaderPtr pipeline, bool flipped = false, QMatrix4x4 matrix = QMatrix4x4());
+void BlitInstanced(ShaderPtr pipeline, const QVector<QMatrix4x4>& matrices, MipmapQuality quality = kMipmapFull);
 
 }
 }
@@ -0,0 +1,393 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openglbackend.h"
+
+#include <QColor>
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "compute.h"
+#include "functions.h"
+#include "render/textureuploader.h"
+#include "shadergenerators.h"
+
+/**
+ * @brief Framebuffers textures are copied and read back through, created once per context (they can't be shared)
+ */
+struct CopyFramebuffers {
+  GLuint read;
+  GLuint draw;
+};
+
+QHash<QOpenGLContext*, CopyFramebuffers> copy_framebuffers;
+QMutex copy_framebuffers_mutex;
+
+/**
+ * @brief Return the copy framebuffers of the current context, creating them if necessary
+ */
+CopyFramebuffers GetCopyFramebuffers(QOpenGLContext* ctx)
+{
+  QMutexLocker locker(&copy_framebuffers_mutex);
+
+  QHash<QOpenGLContext*, CopyFramebuffers>::const_iterator it = copy_framebuffers.constFind(ctx);
+
+  if (it != copy_framebuffers.constEnd()) {
+    return it.value();
+  }
+
+  CopyFramebuffers fbs;
+  ctx->functions()->glGenFramebuffers(1, &fbs.read);
+  ctx->functions()->glGenFramebuffers(1, &fbs.draw);
+
+  copy_framebuffers.insert(ctx, fbs);
+
+  // Free them with the context (which is current while this signal is emitted)
+  QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [ctx]() {
+    copy_framebuffers_mutex.lock();
+    CopyFramebuffers f = copy_framebuffers.take(ctx);
+    copy_framebuffers_mutex.unlock();
+
+    ctx->functions()->glDeleteFramebuffers(1, &f.read);
+    ctx->functions()->glDeleteFramebuffers(1, &f.draw);
+  });
+
+  return fbs;
+}
+
+QHash<QOpenGLContext*, TextureUploader*> uploaders;
+QMutex uploaders_mutex;
+
+/**
+ * @brief Return the pixel buffer ring textures are uploaded through in the current context, creating it if necessary
+ */
+TextureUploader* GetUploader(QOpenGLContext* ctx)
+{
+  QMutexLocker locker(&uploaders_mutex);
+
+  TextureUploader* uploader = uploaders.value(ctx);
+
+  if (uploader != nullptr) {
+    return uploader;
+  }
+
+  uploader = new TextureUploader();
+  uploader->Create(ctx);
+
+  uploaders.insert(ctx, uploader);
+
+  // Free it with the context (which is current while this signal is emitted)
+  QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [ctx]() {
+    uploaders_mutex.lock();
+    TextureUploader* u = uploaders.take(ctx);
+    uploaders_mutex.unlock();
+
+    delete u;
+  });
+
+  return uploader;
+}
+
+QString olive::gl::OpenGLBackend::name()
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  return QStringLiteral("OpenGL %1 (%2)").arg(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)),
+                                              reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+}
+
+RenderBackend::Handle olive::gl::OpenGLBackend::CreateTexture(olive::PixelFormat format, int width, int height)
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  const PixelFormatInfo& info = PixelService::GetPixelFormatInfo(format);
+
+  GLuint texture = 0;
+  f->glGenTextures(1, &texture);
+
+  f->glBindTexture(GL_TEXTURE_2D, texture);
+
+  f->glTexImage2D(GL_TEXTURE_2D, 0, info.internal_format, width, height, 0, info.pixel_format, info.pixel_type, nullptr);
+
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  return texture;
+}
+
+void olive::gl::OpenGLBackend::UploadTexture(Handle texture, olive::PixelFormat format, const void *data, int linesize)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  QSize size = TextureSize(texture);
+
+  // Through a PBO so the transfer doesn't stall this thread, or directly if one couldn't be mapped
+  if (GetUploader(ctx)->Upload(static_cast<GLuint>(texture), format, size.width(), size.height(), data, linesize)) {
+    return;
+  }
+
+  const PixelFormatInfo& info = PixelService::GetPixelFormatInfo(format);
+
+  xf->glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture));
+
+  xf->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / info.bytes_per_pixel);
+
+  xf->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), info.pixel_format, info.pixel_type, data);
+
+  xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  xf->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  MarkTextureModified(static_cast<GLuint>(texture));
+}
+
+void olive::gl::OpenGLBackend::DownloadTexture(Handle texture,
+                                               olive::PixelFormat format,
+                                               const QRect &rect,
+                                               void *data,
+                                               int linesize)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  const PixelFormatInfo& info = PixelService::GetPixelFormatInfo(format);
+
+  CopyFramebuffers fbs = GetCopyFramebuffers(ctx);
+
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbs.read);
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, static_cast<GLuint>(texture), 0);
+
+  xf->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  xf->glPixelStorei(GL_PACK_ROW_LENGTH, linesize / info.bytes_per_pixel);
+
+  xf->glReadPixels(rect.x(), rect.y(), rect.width(), rect.height(), info.pixel_format, info.pixel_type, data);
+
+  xf->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+  xf->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void olive::gl::OpenGLBackend::CopyTexture(Handle source, Handle destination, const QRect &rect)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  CopyFramebuffers fbs = GetCopyFramebuffers(ctx);
+
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbs.read);
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, static_cast<GLuint>(source), 0);
+
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbs.draw);
+  xf->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                             static_cast<GLuint>(destination), 0);
+
+  xf->glBlitFramebuffer(rect.x(), rect.y(), rect.right() + 1, rect.bottom() + 1,
+                        rect.x(), rect.y(), rect.right() + 1, rect.bottom() + 1,
+                        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+  xf->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  MarkTextureModified(static_cast<GLuint>(destination));
+}
+
+QSize olive::gl::OpenGLBackend::TextureSize(Handle texture)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  GLint width = 0;
+  GLint height = 0;
+
+  xf->glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture));
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  return QSize(width, height);
+}
+
+void olive::gl::OpenGLBackend::DestroyTexture(Handle texture)
+{
+  GLuint name = static_cast<GLuint>(texture);
+
+  ForgetTexture(name);
+
+  QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &name);
+}
+
+RenderBackend::Handle olive::gl::OpenGLBackend::CreateRenderTarget(Handle texture)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  GLuint framebuffer = 0;
+  xf->glGenFramebuffers(1, &framebuffer);
+
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+  xf->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                             static_cast<GLuint>(texture), 0);
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  return framebuffer;
+}
+
+void olive::gl::OpenGLBackend::DestroyRenderTarget(Handle target)
+{
+  GLuint name = static_cast<GLuint>(target);
+
+  QOpenGLContext::currentContext()->functions()->glDeleteFramebuffers(1, &name);
+}
+
+RenderBackend::Pipeline olive::gl::OpenGLBackend::GetPipeline(const QStringList &function_names,
+                                                              const QString &shader_code)
+{
+  return GetFusedPipeline(function_names, shader_code);
+}
+
+void olive::gl::OpenGLBackend::SetUniform(Pipeline pipeline, const char *name, const QVariant &value)
+{
+  QOpenGLShaderProgram* program = static_cast<QOpenGLShaderProgram*>(pipeline.get());
+
+  program->bind();
+
+  switch (static_cast<QMetaType::Type>(value.type())) {
+  case QMetaType::Bool:
+    program->setUniformValue(name, value.toBool());
+    break;
+  case QMetaType::Int:
+  case QMetaType::UInt:
+    program->setUniformValue(name, value.toInt());
+    break;
+  case QMetaType::Float:
+  case QMetaType::Double:
+    program->setUniformValue(name, value.toFloat());
+    break;
+  case QMetaType::QVector2D:
+    program->setUniformValue(name, value.value<QVector2D>());
+    break;
+  case QMetaType::QVector3D:
+    program->setUniformValue(name, value.value<QVector3D>());
+    break;
+  case QMetaType::QVector4D:
+    program->setUniformValue(name, value.value<QVector4D>());
+    break;
+  case QMetaType::QColor:
+    program->setUniformValue(name, value.value<QColor>());
+    break;
+  case QMetaType::QMatrix4x4:
+    program->setUniformValue(name, value.value<QMatrix4x4>());
+    break;
+  default:
+    qWarning() << "Unsupported uniform type for" << name << value.typeName();
+  }
+
+  program->release();
+}
+
+void olive::gl::OpenGLBackend::Draw(Pipeline pipeline, Handle texture, Handle target, const QMatrix4x4 &matrix)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(target));
+
+  // Draw over the whole of the texture the target draws onto
+  GLint target_texture = 0;
+  xf->glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                            GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &target_texture);
+
+  QSize size = TextureSize(static_cast<Handle>(target_texture));
+  xf->glViewport(0, 0, size.width(), size.height());
+
+  xf->glActiveTexture(GL_TEXTURE0);
+  xf->glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture));
+
+  Blit(std::static_pointer_cast<QOpenGLShaderProgram>(pipeline), false, matrix);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  xf->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  MarkTextureModified(static_cast<GLuint>(target_texture));
+}
+
+bool olive::gl::OpenGLBackend::SupportsCompute()
+{
+  return olive::gl::SupportsCompute(QOpenGLContext::currentContext());
+}
+
+RenderBackend::Pipeline olive::gl::OpenGLBackend::GetComputePipeline(const QString &source)
+{
+  if (!SupportsCompute()) {
+    return nullptr;
+  }
+
+  return olive::gl::GetComputePipeline(source);
+}
+
+void olive::gl::OpenGLBackend::Dispatch(Pipeline pipeline, Handle texture, int width, int height)
+{
+  DispatchOverTexture(std::static_pointer_cast<QOpenGLShaderProgram>(pipeline),
+                      static_cast<GLuint>(texture),
+                      width,
+                      height);
+}
+
+RenderBackend::Fence olive::gl::OpenGLBackend::CreateFence()
+{
+  return QOpenGLContext::currentContext()->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void olive::gl::OpenGLBackend::WaitFenceOnGPU(Fence fence)
+{
+  QOpenGLContext::currentContext()->extraFunctions()->glWaitSync(static_cast<GLsync>(fence), 0, GL_TIMEOUT_IGNORED);
+}
+
+void olive::gl::OpenGLBackend::WaitFence(Fence fence)
+{
+  // Flush so the fence is actually submitted, otherwise this could wait forever
+  QOpenGLContext::currentContext()->extraFunctions()->glClientWaitSync(static_cast<GLsync>(fence),
+                                                                       GL_SYNC_FLUSH_COMMANDS_BIT,
+                                                                       GL_TIMEOUT_IGNORED);
+}
+
+void olive::gl::OpenGLBackend::DestroyFence(Fence fence)
+{
+  QOpenGLContext::currentContext()->extraFunctions()->glDeleteSync(static_cast<GLsync>(fence));
+}
+
+void olive::gl::OpenGLBackend::Flush()
+{
+  QOpenGLContext::currentContext()->functions()->glFlush();
+}
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENGLBACKEND_H
+#define OPENGLBACKEND_H
+
+#include "render/renderbackend.h"
+
+namespace olive {
+namespace gl {
+
+/**
+ * @brief RenderBackend implementation wrapping Olive's OpenGL code
+ *
+ * Handles are OpenGL object names: textures are texture names, render targets are framebuffer names and fences are
+ * GLsync objects, so they can be passed to code that still uses OpenGL directly (and the other way around). Pipelines
+ * hold a ShaderPtr. Everything uses QOpenGLContext::currentContext().
+ */
+class OpenGLBackend : public RenderBackend
+{
+public:
+  OpenGLBackend() = default;
+
+  virtual QString name() override;
+
+  virtual Handle CreateTexture(olive::PixelFormat format, int width, int height) override;
+
+  virtual void UploadTexture(Handle texture, olive::PixelFormat format, const void* data, int linesize) override;
+
+  virtual void DownloadTexture(Handle texture,
+                               olive::PixelFormat format,
+                               const QRect& rect,
+                               void* data,
+                               int linesize) override;
+
+  virtual void CopyTexture(Handle source, Handle destination, const QRect& rect) override;
+
+  virtual QSize TextureSize(Handle texture) override;
+
+  virtual void DestroyTexture(Handle texture) override;
+
+  virtual Handle CreateRenderTarget(Handle texture) override;
+
+  virtual void DestroyRenderTarget(Handle target) override;
+
+  virtual Pipeline GetPipeline(const QStringList& function_names, const QString& shader_code) override;
+
+  virtual void SetUniform(Pipeline pipeline, const char* name, const QVariant& value) override;
+
+  virtual void Draw(Pipeline pipeline, Handle texture, Handle target, const QMatrix4x4& matrix) override;
+
+  virtual bool SupportsCompute() override;
+
+  virtual Pipeline GetComputePipeline(const QString& source) override;
+
+  virtual void Dispatch(Pipeline pipeline, Handle texture, int width, int height) override;
+
+  virtual Fence CreateFence() override;
+
+  virtual void WaitFenceOnGPU(Fence fence) override;
+
+  virtual void WaitFence(Fence fence) override;
+
+  virtual void DestroyFence(Fence fence) override;
+
+  virtual void Flush() override;
+};
+
+}
+}
+
+#endif // OPENGLBACKEND_H
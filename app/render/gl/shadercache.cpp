@@ -0,0 +1,670 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shadercache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Identifies program binary files written by ShaderCache, increase the version if the layout changes
+const quint32 kBinaryMagic = 0x4F565348; // "OVSH"
+const quint32 kBinaryVersion = 1;
+
+// From GL_KHR_parallel_shader_compile (GL_ARB_parallel_shader_compile uses the same value)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+olive::gl::ShaderCache olive::gl::shader_cache;
+
+const qint64 olive::gl::ShaderCache::kWarmUpBudget = Q_INT64_C(32) * 1024 * 1024;
+
+olive::gl::ShaderCache::ShaderCache() :
+  compiler_(nullptr),
+  hits_(0),
+  misses_(0)
+{
+}
+
+ShaderPtr olive::gl::ShaderCache::Get(const QString &vertex_source, const QString &fragment_source)
+{
+  return GetProgram({{QOpenGLShader::Vertex, vertex_source}, {QOpenGLShader::Fragment, fragment_source}});
+}
+
+ShaderPtr olive::gl::ShaderCache::GetCompute(const QString &compute_source)
+{
+  return GetProgram({{QOpenGLShader::Compute, compute_source}});
+}
+
+ShaderPtr olive::gl::ShaderCache::GetProgram(const QVector<ShaderStage> &stages)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  Q_ASSERT(ctx != nullptr);
+
+  QByteArray key = GetKey(ctx, stages);
+  QPair<QOpenGLContext*, QByteArray> program_key(ctx, key);
+
+  mutex_.lock();
+  ShaderPtr program = programs_.value(program_key);
+  if (program != nullptr) {
+    hits_++;
+  }
+  mutex_.unlock();
+
+  if (program != nullptr) {
+    return program;
+  }
+
+  program = std::make_shared<QOpenGLShaderProgram>();
+
+  if (!LoadBinary(ctx, program.get(), key)) {
+    mutex_.lock();
+    misses_++;
+    mutex_.unlock();
+
+    bool binaries = SupportsBinaries(ctx);
+
+    if (binaries) {
+      // Ask the driver to keep the binary around so we can retrieve it after linking
+      ctx->extraFunctions()->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    foreach (const ShaderStage& stage, stages) {
+      if (!program->addShaderFromSourceCode(stage.type, stage.source)) {
+        return nullptr;
+      }
+    }
+
+    if (!program->link()) {
+      return nullptr;
+    }
+
+    if (binaries) {
+      SaveBinary(ctx, program.get(), key);
+    }
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  return InsertProgram(ctx, key, program);
+}
+
+ShaderPtr olive::gl::ShaderCache::GetAsync(const QString &vertex_source, const QString &fragment_source, bool *pending)
+{
+  *pending = false;
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  Q_ASSERT(ctx != nullptr);
+
+  QVector<ShaderStage> stages = {{QOpenGLShader::Vertex, vertex_source}, {QOpenGLShader::Fragment, fragment_source}};
+
+  QByteArray key = GetKey(ctx, stages);
+
+  mutex_.lock();
+  ShaderPtr program = programs_.value(qMakePair(ctx, key));
+  bool failed = failed_.contains(key);
+  bool compiler = (compiler_ != nullptr);
+  if (program != nullptr) {
+    hits_++;
+  }
+  mutex_.unlock();
+
+  if (program != nullptr || failed) {
+    return program;
+  }
+
+  if (SupportsParallelCompile(ctx)) {
+    return GetParallel(ctx, key, stages, pending);
+  }
+
+  if (compiler && SupportsBinaries(ctx)) {
+    return GetBackground(ctx, key, stages, pending);
+  }
+
+  return GetProgram(stages);
+}
+
+void olive::gl::ShaderCache::StartCompiler()
+{
+  QMutexLocker locker(&mutex_);
+
+  if (compiler_ == nullptr) {
+    compiler_ = new ShaderCompilerThread();
+    compiler_->start(QThread::LowPriority);
+  }
+}
+
+void olive::gl::ShaderCache::StopCompiler()
+{
+  // Tasks lock the mutex too, so don't hold it while waiting for them
+  mutex_.lock();
+  ShaderCompilerThread* compiler = compiler_;
+  compiler_ = nullptr;
+  mutex_.unlock();
+
+  delete compiler;
+}
+
+void olive::gl::ShaderCache::ClearBinaries()
+{
+  QMutexLocker locker(&mutex_);
+
+  binaries_.clear();
+
+  QDir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("shaders")).removeRecursively();
+}
+
+void olive::gl::ShaderCache::WarmUp()
+{
+  QDir dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("shaders"));
+
+  // Programs used in the last session are the most likely to be needed again
+  QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time);
+
+  qint64 total = 0;
+
+  foreach (const QFileInfo& info, files) {
+    if (total + info.size() > kWarmUpBudget) {
+      break;
+    }
+
+    QByteArray key = info.fileName().toLatin1();
+
+    mutex_.lock();
+    bool loaded = binaries_.contains(key);
+    mutex_.unlock();
+
+    if (loaded) {
+      continue;
+    }
+
+    QFile file(info.absoluteFilePath());
+
+    if (!file.open(QFile::ReadOnly)) {
+      continue;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 format = 0;
+
+    ProgramBinary binary;
+
+    stream >> magic >> version >> format >> binary.data;
+
+    if (stream.status() != QDataStream::Ok || magic != kBinaryMagic || version != kBinaryVersion) {
+      continue;
+    }
+
+    binary.format = format;
+
+    total += info.size();
+
+    QMutexLocker locker(&mutex_);
+
+    // A context may have loaded or linked it in the meantime
+    if (!binaries_.contains(key)) {
+      binaries_.insert(key, binary);
+    }
+  }
+}
+
+CacheStatistics olive::gl::ShaderCache::statistics()
+{
+  QMutexLocker locker(&mutex_);
+
+  CacheStatistics s;
+
+  s.used_bytes = 0;
+  s.entries = binaries_.size();
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QHash<QByteArray, ProgramBinary>::const_iterator i;
+
+  for (i=binaries_.constBegin();i!=binaries_.constEnd();i++) {
+    s.used_bytes += i->data.size();
+
+    // Programs are only identified by their hash, which is enough to find the file in the disk cache
+    s.consumers.append({QString::fromLatin1(i.key().left(12)), i->data.size(), 1});
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+bool olive::gl::ShaderCache::SupportsBinaries(QOpenGLContext *ctx)
+{
+  QSurfaceFormat format = ctx->format();
+
+  if (format.version() < qMakePair(4, 1) && !ctx->hasExtension("GL_ARB_get_program_binary")) {
+    return false;
+  }
+
+  // Some drivers support the functions without supporting any binary formats
+  GLint format_count = 0;
+  ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+  return format_count > 0;
+}
+
+QByteArray olive::gl::ShaderCache::GetKey(QOpenGLContext* ctx, const QVector<ShaderStage> &stages)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  // Binaries are only valid for the driver that created them
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+
+  for (int i=0;i<stages.size();i++) {
+    if (i > 0) {
+      hash.addData(QByteArray(1, '\0'));
+    }
+
+    hash.addData(stages.at(i).source.toUtf8());
+  }
+
+  return hash.result().toHex();
+}
+
+bool olive::gl::ShaderCache::LoadBinary(QOpenGLContext* ctx, QOpenGLShaderProgram *program, const QByteArray &key)
+{
+  if (!SupportsBinaries(ctx)) {
+    return false;
+  }
+
+  mutex_.lock();
+  QHash<QByteArray, ProgramBinary>::const_iterator it = binaries_.constFind(key);
+  bool in_memory = (it != binaries_.constEnd());
+  ProgramBinary binary;
+  binary.format = 0;
+  if (in_memory) {
+    binary = it.value();
+  }
+  mutex_.unlock();
+
+  if (!in_memory) {
+    QFile file(GetBinaryFilename(key));
+
+    if (!file.open(QFile::ReadOnly)) {
+      return false;
+    }
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 format = 0;
+
+    stream >> magic >> version >> format >> binary.data;
+
+    if (stream.status() != QDataStream::Ok || magic != kBinaryMagic || version != kBinaryVersion) {
+      return false;
+    }
+
+    binary.format = format;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  xf->glProgramBinary(program->programId(), binary.format, binary.data.constData(), binary.data.size());
+
+  // With no shaders added, link() only checks whether the binary was accepted
+  if (!program->link()) {
+    // The driver may reject binaries at any time (e.g. after an update), fall back to compiling
+    QMutexLocker locker(&mutex_);
+    binaries_.remove(key);
+    QFile::remove(GetBinaryFilename(key));
+
+    return false;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  if (!in_memory) {
+    binaries_.insert(key, binary);
+  }
+
+  hits_++;
+
+  return true;
+}
+
+void olive::gl::ShaderCache::SaveBinary(QOpenGLContext *ctx, QOpenGLShaderProgram *program, const QByteArray &key)
+{
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  GLint length = 0;
+  xf->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if (length <= 0) {
+    return;
+  }
+
+  ProgramBinary binary;
+  binary.format = 0;
+  binary.data.resize(length);
+
+  GLsizei written = 0;
+  xf->glGetProgramBinary(program->programId(), length, &written, &binary.format, binary.data.data());
+
+  if (written <= 0) {
+    return;
+  }
+
+  binary.data.resize(written);
+
+  QMutexLocker locker(&mutex_);
+
+  binaries_.insert(key, binary);
+
+  // Write to disk for the next launch
+  QString filename = GetBinaryFilename(key);
+
+  if (!QDir().mkpath(QFileInfo(filename).absolutePath())) {
+    return;
+  }
+
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open shader cache file" << filename;
+    return;
+  }
+
+  QDataStream stream(&file);
+
+  stream << kBinaryMagic << kBinaryVersion << static_cast<quint32>(binary.format) << binary.data;
+
+  if (!file.commit()) {
+    qWarning() << "Failed to write shader cache file" << filename;
+  }
+}
+
+QString olive::gl::ShaderCache::GetBinaryFilename(const QByteArray &key)
+{
+  QDir dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("shaders"));
+
+  return dir.filePath(QString::fromLatin1(key));
+}
+
+bool olive::gl::ShaderCache::SupportsParallelCompile(QOpenGLContext *ctx)
+{
+  return ctx->hasExtension("GL_KHR_parallel_shader_compile") || ctx->hasExtension("GL_ARB_parallel_shader_compile");
+}
+
+ShaderPtr olive::gl::ShaderCache::InsertProgram(QOpenGLContext *ctx, const QByteArray &key, ShaderPtr program)
+{
+  QPair<QOpenGLContext*, QByteArray> program_key(ctx, key);
+
+  // Another thread using the same context may have beaten us to it
+  ShaderPtr existing = programs_.value(program_key);
+  if (existing != nullptr) {
+    return existing;
+  }
+
+  programs_.insert(program_key, program);
+
+  WatchContext(ctx);
+
+  return program;
+}
+
+void olive::gl::ShaderCache::WatchContext(QOpenGLContext *ctx)
+{
+  if (contexts_.contains(ctx)) {
+    return;
+  }
+
+  contexts_.insert(ctx);
+
+  // Programs are destroyed with their context (which is current while this signal is emitted)
+  QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [this, ctx]() {
+    QMutexLocker l(&mutex_);
+
+    contexts_.remove(ctx);
+
+    QHash<QPair<QOpenGLContext*, QByteArray>, ShaderPtr>::iterator it = programs_.begin();
+
+    while (it != programs_.end()) {
+      if (it.key().first == ctx) {
+        it = programs_.erase(it);
+      } else {
+        it++;
+      }
+    }
+
+    QHash<QPair<QOpenGLContext*, QByteArray>, PendingProgram>::iterator pending = pending_.begin();
+
+    while (pending != pending_.end()) {
+      if (pending.key().first == ctx) {
+        foreach (GLuint shader, pending.value().shaders) {
+          ctx->extraFunctions()->glDeleteShader(shader);
+        }
+
+        pending = pending_.erase(pending);
+      } else {
+        pending++;
+      }
+    }
+  });
+}
+
+ShaderPtr olive::gl::ShaderCache::GetParallel(QOpenGLContext *ctx,
+                                              const QByteArray &key,
+                                              const QVector<ShaderStage> &stages,
+                                              bool *pending)
+{
+  QPair<QOpenGLContext*, QByteArray> program_key(ctx, key);
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  // Contexts are only used by one thread, so nobody else can start or finish this context's program
+  mutex_.lock();
+  bool started = pending_.contains(program_key);
+  PendingProgram linking = pending_.value(program_key);
+  mutex_.unlock();
+
+  if (!started) {
+    ShaderPtr program = std::make_shared<QOpenGLShaderProgram>();
+
+    // Binaries load quickly, so there's no need to wait for anything if there's one already
+    if (LoadBinary(ctx, program.get(), key)) {
+      QMutexLocker locker(&mutex_);
+      return InsertProgram(ctx, key, program);
+    }
+
+    if (!program->create()) {
+      return nullptr;
+    }
+
+    mutex_.lock();
+    misses_++;
+    mutex_.unlock();
+
+    if (SupportsBinaries(ctx)) {
+      xf->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    linking.program = program;
+
+    // QOpenGLShader checks the compile status straight away, which would wait for the compiler, so these are raw
+    foreach (const ShaderStage& stage, stages) {
+      GLuint shader = xf->glCreateShader(stage.type == QOpenGLShader::Vertex ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
+
+      QByteArray source = stage.source.toUtf8();
+      const char* source_data = source.constData();
+
+      xf->glShaderSource(shader, 1, &source_data, nullptr);
+      xf->glCompileShader(shader);
+      xf->glAttachShader(program->programId(), shader);
+
+      linking.shaders.append(shader);
+    }
+
+    // Returns straight away, the driver links on its own threads
+    xf->glLinkProgram(program->programId());
+
+    QMutexLocker locker(&mutex_);
+    pending_.insert(program_key, linking);
+    WatchContext(ctx);
+
+    *pending = true;
+    return nullptr;
+  }
+
+  GLint complete = GL_FALSE;
+  xf->glGetProgramiv(linking.program->programId(), GL_COMPLETION_STATUS_KHR, &complete);
+
+  if (!complete) {
+    *pending = true;
+    return nullptr;
+  }
+
+  foreach (GLuint shader, linking.shaders) {
+    xf->glDetachShader(linking.program->programId(), shader);
+    xf->glDeleteShader(shader);
+  }
+
+  mutex_.lock();
+  pending_.remove(program_key);
+  mutex_.unlock();
+
+  // With no shaders added, link() only checks whether the program we linked ourselves succeeded
+  if (!linking.program->link()) {
+    qWarning() << "Failed to link shader program:" << linking.program->log();
+
+    QMutexLocker locker(&mutex_);
+    failed_.insert(key);
+
+    return nullptr;
+  }
+
+  if (SupportsBinaries(ctx)) {
+    SaveBinary(ctx, linking.program.get(), key);
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  return InsertProgram(ctx, key, linking.program);
+}
+
+ShaderPtr olive::gl::ShaderCache::GetBackground(QOpenGLContext *ctx,
+                                                const QByteArray &key,
+                                                const QVector<ShaderStage> &stages,
+                                                bool *pending)
+{
+  mutex_.lock();
+  bool queued = background_.contains(key);
+  BackgroundState state = background_.value(key);
+  mutex_.unlock();
+
+  if (queued && state == kBackgroundCompiling) {
+    *pending = true;
+    return nullptr;
+  }
+
+  if (!queued || state == kBackgroundCompiled) {
+    // Once the compiler thread is done, its binary is in memory (there may also be one on disk from a previous launch)
+    ShaderPtr program = std::make_shared<QOpenGLShaderProgram>();
+
+    if (LoadBinary(ctx, program.get(), key)) {
+      QMutexLocker locker(&mutex_);
+      return InsertProgram(ctx, key, program);
+    }
+  }
+
+  if (!queued) {
+    QMutexLocker locker(&mutex_);
+
+    // Another context may have queued the same program in the meantime
+    if (!background_.contains(key) && compiler_ != nullptr) {
+      background_.insert(key, kBackgroundCompiling);
+
+      compiler_->Queue([this, key, stages]() {
+        CompileBackground(key, stages);
+      });
+    }
+
+    *pending = true;
+    return nullptr;
+  }
+
+  // The compiler thread couldn't help (or its binary was rejected), build the program here
+  return GetProgram(stages);
+}
+
+void olive::gl::ShaderCache::CompileBackground(const QByteArray &key, const QVector<ShaderStage> &stages)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  BackgroundState state = kBackgroundUnavailable;
+
+  if (ctx != nullptr && SupportsBinaries(ctx)) {
+    QOpenGLShaderProgram program;
+
+    if (program.create()) {
+      mutex_.lock();
+      misses_++;
+      mutex_.unlock();
+
+      ctx->extraFunctions()->glProgramParameteri(program.programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+      bool linked = true;
+
+      foreach (const ShaderStage& stage, stages) {
+        if (!program.addShaderFromSourceCode(stage.type, stage.source)) {
+          linked = false;
+          break;
+        }
+      }
+
+      if (linked && program.link()) {
+        SaveBinary(ctx, &program, key);
+
+        state = kBackgroundCompiled;
+      } else {
+        // The source is broken, compiling it again elsewhere won't help
+        QMutexLocker locker(&mutex_);
+        background_.remove(key);
+        failed_.insert(key);
+        return;
+      }
+    }
+  }
+
+  QMutexLocker locker(&mutex_);
+  background_.insert(key, state);
+}
@@ -0,0 +1,259 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+
+#include "common/cachestatistics.h"
+#include "shadercompilerthread.h"
+#include "shaderptr.h"
+
+namespace olive {
+namespace gl {
+
+/**
+ * @brief Cache of linked shader programs and their program binaries
+ *
+ * Get() returns a program for a given vertex and fragment shader source. Programs are identified by a SHA-1 hash of
+ * their source and the driver (vendor, renderer and version string), so identical generated shaders are only built
+ * once.
+ *
+ * Programs are cached per context. Although programs could be shared within a context group, uniform values are part
+ * of the program object, and render threads setting uniforms on the same program at the same time would overwrite
+ * each other. Instead, the program binary (glGetProgramBinary()) of every program linked is kept in memory and on disk
+ * (in QStandardPaths::CacheLocation), and other contexts and later launches load the binary rather than compiling the
+ * source. If the driver doesn't support program binaries or rejects one, the program is compiled from source as usual.
+ *
+ * Linking a new program can take long enough to drop frames, so GetAsync() builds programs without blocking the
+ * caller, either with the driver's own compiler threads (GL_KHR_parallel_shader_compile) or on a ShaderCompilerThread
+ * whose program binary the caller's context then loads.
+ *
+ * All functions are thread-safe.
+ */
+class ShaderCache
+{
+public:
+  ShaderCache();
+
+  ShaderCache(const ShaderCache& other) = delete;
+  ShaderCache(ShaderCache&& other) = delete;
+  ShaderCache& operator=(const ShaderCache& other) = delete;
+  ShaderCache& operator=(ShaderCache&& other) = delete;
+
+  /**
+   * @brief Return a linked program for the current context built from this source
+   *
+   * @return
+   *
+   * The program or nullptr if it failed to compile or link (the error is printed by QOpenGLShaderProgram).
+   */
+  ShaderPtr Get(const QString& vertex_source, const QString& fragment_source);
+
+  /**
+   * @brief Like Get() but returns straight away if the program has to be built
+   *
+   * Call again later (e.g. for the next frame) to check whether it's ready. If the driver supports
+   * GL_KHR_parallel_shader_compile, the program is linked in the current context and polled. Otherwise it's linked on
+   * the compiler thread (see StartCompiler()) and the current context loads its program binary once it's done. Without
+   * either (or a compiler thread), this is the same as Get().
+   *
+   * @param pending
+   *
+   * Set to TRUE if nullptr was returned because the program is still being built, or FALSE otherwise.
+   *
+   * @return
+   *
+   * The program, or nullptr if it's still being built or failed to compile or link.
+   */
+  ShaderPtr GetAsync(const QString& vertex_source, const QString& fragment_source, bool* pending);
+
+  /**
+   * @brief Return a linked compute program for the current context built from this source
+   *
+   * The context must support compute shaders (see olive::gl::SupportsCompute()).
+   *
+   * @return
+   *
+   * The program or nullptr if it failed to compile or link.
+   */
+  ShaderPtr GetCompute(const QString& compute_source);
+
+  /**
+   * @brief Remove all program binaries from memory and disk (programs already in use are unaffected)
+   */
+  void ClearBinaries();
+
+  /**
+   * @brief Read the most recently written program binaries on disk into memory, up to kWarmUpBudget bytes
+   *
+   * So the first programs contexts need after launching don't each wait for a file read. Meant to be run in the
+   * background during startup (it doesn't need a context). Binaries for other drivers are read too, they're just never
+   * asked for.
+   */
+  void WarmUp();
+
+  /**
+   * @brief Maximum size of the program binaries WarmUp() reads
+   */
+  static const qint64 kWarmUpBudget;
+
+  /**
+   * @brief Program binaries kept in memory, and how many programs were found linked or loaded from a binary (hits) or
+   * had to be compiled from source (misses)
+   *
+   * A program compiled on the compiler thread counts as a miss there and a hit once a context loads its binary.
+   */
+  CacheStatistics statistics();
+
+  /**
+   * @brief Start the thread GetAsync() compiles on when the driver can't compile in parallel
+   *
+   * Must be called from the main thread once the application instance exists.
+   */
+  void StartCompiler();
+
+  /**
+   * @brief Finish compiling anything queued and stop the thread started by StartCompiler()
+   */
+  void StopCompiler();
+
+private:
+  struct ShaderStage {
+    QOpenGLShader::ShaderType type;
+    QString source;
+  };
+
+  /**
+   * @brief Shared implementation of Get() and GetCompute()
+   */
+  ShaderPtr GetProgram(const QVector<ShaderStage>& stages);
+
+  struct ProgramBinary {
+    GLenum format;
+    QByteArray data;
+  };
+
+  /**
+   * @brief Returns TRUE if a context can load and retrieve program binaries
+   */
+  static bool SupportsBinaries(QOpenGLContext* ctx);
+
+  /**
+   * @brief Hash identifying a program on the current driver
+   */
+  static QByteArray GetKey(QOpenGLContext* ctx, const QVector<ShaderStage>& stages);
+
+  /**
+   * @brief Try to load a program from its binary, first from memory then from disk
+   */
+  bool LoadBinary(QOpenGLContext* ctx, QOpenGLShaderProgram* program, const QByteArray& key);
+
+  /**
+   * @brief Retrieve a linked program's binary and store it in memory and on disk
+   */
+  void SaveBinary(QOpenGLContext* ctx, QOpenGLShaderProgram* program, const QByteArray& key);
+
+  QString GetBinaryFilename(const QByteArray& key);
+
+  /**
+   * @brief Returns TRUE if a context can link programs without waiting for them (GL_KHR_parallel_shader_compile)
+   */
+  static bool SupportsParallelCompile(QOpenGLContext* ctx);
+
+  /**
+   * @brief Add a program for a context and free it with the context (call with mutex_ locked)
+   *
+   * @return
+   *
+   * The program to use, which is a different one if another thread added it first.
+   */
+  ShaderPtr InsertProgram(QOpenGLContext* ctx, const QByteArray& key, ShaderPtr program);
+
+  /**
+   * @brief Clean up after a context when it's destroyed (call with mutex_ locked)
+   */
+  void WatchContext(QOpenGLContext* ctx);
+
+  /**
+   * @brief GetAsync() with GL_KHR_parallel_shader_compile
+   */
+  ShaderPtr GetParallel(QOpenGLContext* ctx, const QByteArray& key, const QVector<ShaderStage>& stages, bool* pending);
+
+  /**
+   * @brief GetAsync() with the compiler thread
+   */
+  ShaderPtr GetBackground(QOpenGLContext* ctx, const QByteArray& key, const QVector<ShaderStage>& stages,
+                          bool* pending);
+
+  /**
+   * @brief Link a program on the compiler thread and keep its binary (runs on the compiler thread)
+   */
+  void CompileBackground(const QByteArray& key, const QVector<ShaderStage>& stages);
+
+  QHash<QPair<QOpenGLContext*, QByteArray>, ShaderPtr> programs_;
+
+  // A program linking in parallel and the shaders attached to it, which are deleted once it's linked
+  struct PendingProgram {
+    ShaderPtr program;
+    QVector<GLuint> shaders;
+  };
+
+  QHash<QPair<QOpenGLContext*, QByteArray>, PendingProgram> pending_;
+
+  // Progress of programs handed to the compiler thread
+  enum BackgroundState {
+    kBackgroundCompiling,
+    kBackgroundCompiled,
+
+    // The compiler thread couldn't produce a binary (e.g. it has no context), so build it the usual way
+    kBackgroundUnavailable
+  };
+
+  QHash<QByteArray, BackgroundState> background_;
+
+  // Programs GetAsync() failed to build, so they aren't tried again for every frame
+  QSet<QByteArray> failed_;
+
+  ShaderCompilerThread* compiler_;
+
+  // Contexts we're listening to for destruction
+  QSet<QOpenGLContext*> contexts_;
+
+  QHash<QByteArray, ProgramBinary> binaries_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+extern ShaderCache shader_cache;
+
+}
+}
+
+#endif // SHADERCACHE_H
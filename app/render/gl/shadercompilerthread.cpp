@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shadercompilerthread.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+olive::gl::ShaderCompilerThread::ShaderCompilerThread() :
+  running_(true)
+{
+  // QOffscreenSurface must be created in the main thread
+  surface_.create();
+
+  // The context is made current in run() so it has to live in this thread
+  ctx_.moveToThread(this);
+}
+
+olive::gl::ShaderCompilerThread::~ShaderCompilerThread()
+{
+  Stop();
+
+  surface_.destroy();
+}
+
+void olive::gl::ShaderCompilerThread::Queue(const std::function<void ()> &task)
+{
+  QMutexLocker locker(&mutex_);
+
+  tasks_.append(task);
+
+  wait_cond_.wakeAll();
+}
+
+void olive::gl::ShaderCompilerThread::Stop()
+{
+  mutex_.lock();
+  running_ = false;
+  wait_cond_.wakeAll();
+  mutex_.unlock();
+
+  wait();
+}
+
+void olive::gl::ShaderCompilerThread::run()
+{
+  ctx_.setFormat(QSurfaceFormat::defaultFormat());
+  ctx_.setShareContext(QOpenGLContext::globalShareContext());
+
+  bool has_context = ctx_.create();
+
+  if (!has_context) {
+    qWarning() << "Failed to create OpenGL context for compiling shaders";
+  } else if (!(has_context = ctx_.makeCurrent(&surface_))) {
+    qWarning() << "Failed to makeCurrent() on offscreen surface for compiling shaders";
+  }
+
+  while (true) {
+    mutex_.lock();
+
+    while (running_ && tasks_.isEmpty()) {
+      wait_cond_.wait(&mutex_);
+    }
+
+    if (tasks_.isEmpty()) {
+      // Stopped with nothing left to do
+      mutex_.unlock();
+      break;
+    }
+
+    std::function<void()> task = tasks_.takeFirst();
+
+    mutex_.unlock();
+
+    task();
+  }
+
+  if (has_context) {
+    ctx_.doneCurrent();
+  }
+}
@@ -0,0 +1,84 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERCOMPILERTHREAD_H
+#define SHADERCOMPILERTHREAD_H
+
+#include <functional>
+#include <QList>
+#include <QMutex>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+#include <QWaitCondition>
+
+namespace olive {
+namespace gl {
+
+/**
+ * @brief A thread with its own OpenGL context that runs tasks in the order they're queued
+ *
+ * Used by ShaderCache to compile shaders without blocking render threads on drivers that can't compile in parallel
+ * themselves. The context shares with QOpenGLContext::globalShareContext() like every other context in Olive. Tasks
+ * run with the context current, or with no current context at all if it couldn't be created, so tasks should check
+ * QOpenGLContext::currentContext().
+ */
+class ShaderCompilerThread : public QThread
+{
+public:
+  /**
+   * @brief ShaderCompilerThread Constructor
+   *
+   * Must be called from the main thread since the offscreen surface is created here.
+   */
+  ShaderCompilerThread();
+
+  virtual ~ShaderCompilerThread() override;
+
+  /**
+   * @brief Add a task to the back of the queue (thread-safe)
+   */
+  void Queue(const std::function<void()>& task);
+
+  /**
+   * @brief Run the tasks already queued, then stop the thread and wait for it to finish
+   */
+  void Stop();
+
+  virtual void run() override;
+
+private:
+  QOpenGLContext ctx_;
+
+  QOffscreenSurface surface_;
+
+  QList<std::function<void()> > tasks_;
+
+  bool running_;
+
+  QMutex mutex_;
+
+  QWaitCondition wait_cond_;
+};
+
+}
+}
+
+#endif // SHADERCOMPILERTHREAD_H
@@ -20,31 +20,57 @@
 
 #include "shadergenerators.h"
 
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
 #include <QOpenGLExtraFunctions>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+#include "functions.h"
+#include "shadercache.h"
+
+/**
+ * @brief Vertex shader shared by all pipelines, expected by olive::gl::Blit()
+ */
+QString GetDefaultVertexShader()
+{
+  return "#version 110\n"
+         "\n"
+         "#ifdef GL_ES\n"
+         "precision mediump int;\n"
+         "precision mediump float;\n"
+         "#endif\n"
+         "\n"
+         "uniform mat4 mvp_matrix;\n"
+         "\n"
+         "attribute vec4 a_position;\n"
+         "attribute vec2 a_texcoord;\n"
+         "\n"
+         "varying vec2 v_texcoord;\n"
+         "\n"
+         "void main() {\n"
+         "  gl_Position = mvp_matrix * a_position;\n"
+         "  v_texcoord = a_texcoord;\n"
+         "}\n";
+}
 
 ShaderPtr olive::gl::GetDefaultPipeline(const QString& function_name, const QString& shader_code)
 {
-  ShaderPtr program = std::make_shared<QOpenGLShaderProgram>();
+  if (shader_code.isEmpty()) {
+    return GetFusedPipeline(QStringList(), QString());
+  }
+
+  // The function in the additional code is expected to be `vec4 function_name(vec4 color)`. The texture coordinate can
+  // be acquired through `v_texcoord`.
+  return GetFusedPipeline(QStringList(function_name), shader_code);
+}
 
+ShaderPtr olive::gl::GetFusedPipeline(const QStringList &function_names, const QString &shader_code, bool *pending)
+{
   // Generate vertex shader
-  QString vert_shader = "#version 110\n"
-                        "\n"
-                        "#ifdef GL_ES\n"
-                        "precision mediump int;\n"
-                        "precision mediump float;\n"
-                        "#endif\n"
-                        "\n"
-                        "uniform mat4 mvp_matrix;\n"
-                        "\n"
-                        "attribute vec4 a_position;\n"
-                        "attribute vec2 a_texcoord;\n"
-                        "\n"
-                        "varying vec2 v_texcoord;\n"
-                        "\n"
-                        "void main() {\n"
-                        "  gl_Position = mvp_matrix * a_position;\n"
-                        "  v_texcoord = a_texcoord;\n"
-                        "}\n";
+  QString vert_shader = GetDefaultVertexShader();
 
   // Generate fragment shader
   QString frag_shader = "#version 110\n"
@@ -64,10 +90,9 @@ ShaderPtr olive::gl::GetDefaultPipeline(const QString& function_name, const QStr
   // Finish the function with the main function
 
   // Check if additional code was passed to this function, add it here
-  if (shader_code.isEmpty()) {
+  if (function_names.isEmpty()) {
 
     // If not, just add a pure main() function
-
     frag_shader.append("\n"
                        "void main() {\n"
                        "  if (color_only) {\n"
@@ -80,28 +105,29 @@ ShaderPtr olive::gl::GetDefaultPipeline(const QString& function_name, const QStr
 
   } else {
 
-    // If additional code was passed, add it and reference it in main().
-    //
-    // The function in the additional code is expected to be `vec4 function_name(vec4 color)`. The texture coordinate can be
-    // acquired through `v_texcoord`.
-
+    // If additional code was passed, add it and call each function in main() on the result of the one before
     frag_shader.append(shader_code);
 
-    frag_shader.append(QString("\n"
+    frag_shader.append("\n"
                        "void main() {\n"
-                       "  vec4 color = %1(texture2D(texture, v_texcoord))*opacity;\n"
-                       "  gl_FragColor = color;\n"
-                       "}\n").arg(function_name));
+                       "  vec4 color = texture2D(texture, v_texcoord);\n");
 
-  }
+    foreach (const QString& function_name, function_names) {
+      frag_shader.append(QString("  color = %1(color);\n").arg(function_name));
+    }
 
+    frag_shader.append("  gl_FragColor = color*opacity;\n"
+                       "}\n");
 
+  }
 
+  // Build program (or retrieve it if the same source has been built before)
+  ShaderPtr program = pending ? olive::gl::shader_cache.GetAsync(vert_shader, frag_shader, pending)
+                              : olive::gl::shader_cache.Get(vert_shader, frag_shader);
 
-  // Add shaders to program
-  program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_shader);
-  program->addShaderFromSourceCode(QOpenGLShader::Fragment, frag_shader);
-  program->link();
+  if (program == nullptr) {
+    return nullptr;
+  }
 
   // Set opacity default to 100%
   program->bind();
@@ -111,6 +137,224 @@ ShaderPtr olive::gl::GetDefaultPipeline(const QString& function_name, const QStr
   return program;
 }
 
+ShaderPtr olive::gl::GetGeneratorPipeline(const QString &function_name, const QString &shader_code, bool *pending)
+{
+  QString frag_shader = "#version 110\n"
+                        "\n"
+                        "#ifdef GL_ES\n"
+                        "precision mediump int;\n"
+                        "precision mediump float;\n"
+                        "#endif\n"
+                        "\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n";
+
+  frag_shader.append(shader_code);
+
+  frag_shader.append(QString("\n"
+                             "void main() {\n"
+                             "  gl_FragColor = %1(v_texcoord);\n"
+                             "}\n").arg(function_name));
+
+  // Build program (or retrieve it if the same source has been built before)
+  if (pending) {
+    return olive::gl::shader_cache.GetAsync(GetDefaultVertexShader(), frag_shader, pending);
+  }
+
+  return olive::gl::shader_cache.Get(GetDefaultVertexShader(), frag_shader);
+}
+
+ShaderPtr olive::gl::GetInstancedPipeline()
+{
+  // gl_InstanceID needs GLSL 1.40, so unlike the other pipelines this one doesn't use the default vertex shader
+  QString vert_shader = QString("#version 150\n"
+                                "\n"
+                                "uniform mat4 instance_matrix[%1];\n"
+                                "\n"
+                                "in vec4 a_position;\n"
+                                "in vec2 a_texcoord;\n"
+                                "\n"
+                                "out vec2 v_texcoord;\n"
+                                "\n"
+                                "void main() {\n"
+                                "  gl_Position = instance_matrix[gl_InstanceID] * a_position;\n"
+                                "  v_texcoord = a_texcoord;\n"
+                                "}\n").arg(kMaxBlitInstances);
+
+  QString frag_shader = "#version 150\n"
+                        "\n"
+                        "uniform sampler2D tex;\n"
+                        "uniform float opacity;\n"
+                        "\n"
+                        "in vec2 v_texcoord;\n"
+                        "\n"
+                        "out vec4 frag_color;\n"
+                        "\n"
+                        "void main() {\n"
+                        "  frag_color = texture(tex, v_texcoord) * opacity;\n"
+                        "}\n";
+
+  // Build program (or retrieve it if the same source has been built before)
+  ShaderPtr program = olive::gl::shader_cache.Get(vert_shader, frag_shader);
+
+  if (program == nullptr) {
+    return nullptr;
+  }
+
+  // Set texture unit and opacity default to 100%
+  program->bind();
+  program->setUniformValue("tex", 0);
+  program->setUniformValue("opacity", 1.0f);
+  program->release();
+
+  return program;
+}
+
+ShaderPtr olive::gl::GetCompositePipeline(int layer_count)
+{
+  Q_ASSERT(layer_count > 0 && layer_count <= kMaxCompositeLayers);
+
+  QString frag_shader = QString("#version 110\n"
+                                "\n"
+                                "#ifdef GL_ES\n"
+                                "precision mediump int;\n"
+                                "precision mediump float;\n"
+                                "#endif\n"
+                                "\n"
+                                "uniform float layer_opacity[%1];\n"
+                                "uniform int layer_blend[%1];\n"
+                                "varying vec2 v_texcoord;\n").arg(layer_count);
+
+  for (int i=0;i<layer_count;i++) {
+    frag_shader.append(QString("uniform sampler2D layer%1;\n").arg(i));
+  }
+
+  // Separable blend modes with associated alpha, where the top layer's color is blended with the one below where
+  // they overlap and kept as is where only one of them covers the pixel
+  frag_shader.append(QString("\n"
+                             "vec4 blend(vec4 dst, vec4 src, int mode) {\n"
+                             "  vec3 mixed;\n"
+                             "  if (mode == %1) {\n"
+                             "    mixed = src.rgb * dst.a + dst.rgb * src.a;\n"
+                             "  } else if (mode == %2) {\n"
+                             "    mixed = src.rgb * dst.rgb;\n"
+                             "  } else if (mode == %3) {\n"
+                             "    mixed = src.rgb * dst.a + dst.rgb * src.a - src.rgb * dst.rgb;\n"
+                             "  } else {\n"
+                             "    mixed = src.rgb * dst.a;\n"
+                             "  }\n"
+                             "  return vec4(mixed + src.rgb * (1.0 - dst.a) + dst.rgb * (1.0 - src.a),\n"
+                             "              src.a + dst.a * (1.0 - src.a));\n"
+                             "}\n"
+                             "\n"
+                             "void main() {\n"
+                             "  vec4 color = vec4(0.0);\n").arg(QString::number(kBlendAdd),
+                                                                  QString::number(kBlendMultiply),
+                                                                  QString::number(kBlendScreen)));
+
+  // Unrolled so every sampler is indexed with a constant
+  for (int i=0;i<layer_count;i++) {
+    frag_shader.append(QString("  color = blend(color, texture2D(layer%1, v_texcoord) * layer_opacity[%1], "
+                               "layer_blend[%1]);\n").arg(i));
+  }
+
+  frag_shader.append("  gl_FragColor = color;\n"
+                     "}\n");
+
+  // Build program (or retrieve it if the same source has been built before)
+  ShaderPtr program = olive::gl::shader_cache.Get(GetDefaultVertexShader(), frag_shader);
+
+  if (program == nullptr) {
+    return nullptr;
+  }
+
+  // Set texture units
+  program->bind();
+  for (int i=0;i<layer_count;i++) {
+    program->setUniformValue(QString("layer%1").arg(i).toUtf8().constData(), i);
+  }
+  program->release();
+
+  return program;
+}
+
+ShaderPtr olive::gl::GetSemiPlanarPackPipeline()
+{
+  // Texel coordinates go past what mediump can address on large frames
+  QString frag_shader = "#version 110\n"
+                        "\n"
+                        "#ifdef GL_ES\n"
+                        "precision highp int;\n"
+                        "precision highp float;\n"
+                        "#endif\n"
+                        "\n"
+                        "uniform sampler2D source;\n"
+                        "uniform vec2 texture_size;\n"
+                        "uniform vec2 source_origin;\n"
+                        "uniform vec2 viewport_origin;\n"
+                        "uniform float chroma;\n"
+                        "uniform vec3 luma_coefficients;\n"
+                        "uniform vec2 chroma_coefficients;\n"
+                        "uniform vec4 sample_range;\n"
+                        "uniform float max_sample;\n"
+                        "uniform float sample_to_output;\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n"
+                        "vec3 fetch(vec2 texel) {\n"
+                        "  return texture2D(source, (texel + 0.5) / texture_size).rgb;\n"
+                        "}\n"
+                        "\n"
+                        "float quantize(float value, float scale, float offset) {\n"
+                        "  return clamp(floor(value * scale + offset + 0.5), 0.0, max_sample) * sample_to_output;\n"
+                        "}\n"
+                        "\n"
+                        "float luma(vec3 rgb) {\n"
+                        "  return quantize(dot(rgb, luma_coefficients), sample_range.x, sample_range.y);\n"
+                        "}\n"
+                        "\n"
+                        "vec2 cbcr(vec3 rgb) {\n"
+                        "  float y = dot(rgb, luma_coefficients);\n"
+                        "  vec2 c = vec2(rgb.b - y, rgb.r - y) * chroma_coefficients;\n"
+                        "  return vec2(quantize(c.x, sample_range.z, sample_range.w),\n"
+                        "              quantize(c.y, sample_range.z, sample_range.w));\n"
+                        "}\n"
+                        "\n"
+                        "void main() {\n"
+                        "  vec2 pixel = floor(gl_FragCoord.xy - viewport_origin);\n"
+                        "\n"
+                        "  if (chroma < 0.5) {\n"
+                        "    vec2 texel = source_origin + vec2(pixel.x * 4.0, pixel.y);\n"
+                        "\n"
+                        "    gl_FragColor = vec4(luma(fetch(texel)),\n"
+                        "                        luma(fetch(texel + vec2(1.0, 0.0))),\n"
+                        "                        luma(fetch(texel + vec2(2.0, 0.0))),\n"
+                        "                        luma(fetch(texel + vec2(3.0, 0.0))));\n"
+                        "  } else {\n"
+                        "    vec2 texel = source_origin + pixel * vec2(4.0, 2.0);\n"
+                        "\n"
+                        "    vec3 left = fetch(texel) + fetch(texel + vec2(1.0, 0.0))\n"
+                        "              + fetch(texel + vec2(0.0, 1.0)) + fetch(texel + vec2(1.0, 1.0));\n"
+                        "    vec3 right = fetch(texel + vec2(2.0, 0.0)) + fetch(texel + vec2(3.0, 0.0))\n"
+                        "               + fetch(texel + vec2(2.0, 1.0)) + fetch(texel + vec2(3.0, 1.0));\n"
+                        "\n"
+                        "    gl_FragColor = vec4(cbcr(left * 0.25), cbcr(right * 0.25));\n"
+                        "  }\n"
+                        "}\n";
+
+  // Build program (or retrieve it if the same source has been built before)
+  ShaderPtr program = olive::gl::shader_cache.Get(GetDefaultVertexShader(), frag_shader);
+
+  if (program == nullptr) {
+    return nullptr;
+  }
+
+  program->bind();
+  program->setUniformValue("source", 1);
+  program->release();
+
+  return program;
+}
+
 QString olive::gl::GetAlphaDisassociateFunction(const QString &function_name)
 {
   return QString("vec4 %1(vec4 col) {\n"
@@ -138,38 +382,63 @@ QString olive::gl::GetAlphaAssociateFunction(const QString &function_name)
                  "}\n").arg(function_name);
 }
 
-// copied from source code to OCIODisplay
-const int OCIO_LUT3D_EDGE_SIZE = 32;
+/**
+ * @brief A baked OCIO LUT and the shader code that samples it
+ */
+struct OCIOBake {
+  QVector<GLfloat> lut;
+  QString shader_text;
+};
 
-// copied from source code to OCIODisplay, expanded from 3*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE
-const int OCIO_NUM_3D_ENTRIES = 98304;
+// Baked LUTs by processor, alpha mode and LUT size (see GetOCIOPipeline())
+QHash<QString, OCIOBake> ocio_bakes;
 
-ShaderPtr olive::gl::GetOCIOPipeline(QOpenGLContext* ctx,
-                                                 GLuint& lut_texture,
-                                                 OCIO::ConstProcessorRcPtr processor,
-                                                 bool alpha_is_associated)
+// LUT textures for each context group (textures are shared between the contexts in a group)
+QHash<QPair<QOpenGLContextGroup*, QString>, GLuint> ocio_lut_textures;
+
+// Display processors by config, input color space, display and view
+QHash<QString, OCIO::ConstProcessorRcPtr> ocio_processors;
+
+QMutex ocio_mutex;
+
+OCIO::ConstProcessorRcPtr olive::gl::GetOCIODisplayProcessor(OCIO::ConstConfigRcPtr config,
+                                                             const QString &input_space,
+                                                             const QString &display,
+                                                             const QString &view)
 {
+  QString key = QStringList({config->getCacheID(), input_space, display, view}).join('\n');
+
+  QMutexLocker locker(&ocio_mutex);
+
+  OCIO::ConstProcessorRcPtr processor = ocio_processors.value(key);
 
-  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+  if (processor) {
+    return processor;
+  }
 
-  // Create LUT texture
-  xf->glGenTextures(1, &lut_texture);
+  try {
+    OCIO::DisplayTransformRcPtr transform = OCIO::DisplayTransform::Create();
+    transform->setInputColorSpaceName(input_space.toUtf8().constData());
+    transform->setDisplay(display.toUtf8().constData());
+    transform->setView(view.toUtf8().constData());
 
-  // Bind LUT
-  xf->glBindTexture(GL_TEXTURE_3D, lut_texture);
+    processor = config->getProcessor(transform);
+  } catch (OCIO::Exception& e) {
+    qWarning() << "Failed to create OCIO processor:" << e.what();
+    return nullptr;
+  }
 
-  // Set texture parameters
-  xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  ocio_processors.insert(key, processor);
 
-  // Allocate storage for texture
-  xf->glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F_ARB,
-                   OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE,
-                   0, GL_RGB,GL_FLOAT, nullptr);
+  return processor;
+}
 
+ShaderPtr olive::gl::GetOCIOPipeline(QOpenGLContext* ctx,
+                                     GLuint& lut_texture,
+                                     OCIO::ConstProcessorRcPtr processor,
+                                     OCIOAlpha alpha,
+                                     int lut_size)
+{
   //
   // SET UP GLSL SHADER
   //
@@ -178,73 +447,156 @@ ShaderPtr olive::gl::GetOCIOPipeline(QOpenGLContext* ctx,
   const char* ocio_func_name = "OCIODisplay";
   shaderDesc.setLanguage(OCIO::GPU_LANGUAGE_GLSL_1_0);
   shaderDesc.setFunctionName(ocio_func_name);
-  shaderDesc.setLut3DEdgeLen(OCIO_LUT3D_EDGE_SIZE);
+  shaderDesc.setLut3DEdgeLen(lut_size);
 
-  //
-  // COMPUTE 3D LUT
-  //
+  // Identical processors have identical cache IDs, so this identifies the LUT and shader text we're about to generate
+  QString key = QStringList({processor->getGpuLut3DCacheID(shaderDesc),
+                             processor->getGpuShaderTextCacheID(shaderDesc),
+                             QString::number(alpha),
+                             QString::number(lut_size)}).join('\n');
 
-  GLfloat* ocio_lut_data = new GLfloat[OCIO_NUM_3D_ENTRIES];
-  processor->getGpuLut3D(ocio_lut_data, shaderDesc);
+  // Add process() function, which GetPipeline() will call if specified
+  QString process_function_name = "process";
 
-  // Upload LUT data to texture
-  xf->glTexSubImage3D(GL_TEXTURE_3D, 0,
-                      0, 0, 0,
-                      OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE,
-                      GL_RGB, GL_FLOAT, ocio_lut_data);
+  QMutexLocker locker(&ocio_mutex);
 
-  delete [] ocio_lut_data;
+  QHash<QString, OCIOBake>::iterator bake = ocio_bakes.find(key);
 
-  // Create OCIO shader code
-  QString shader_text(processor->getGpuShaderText(shaderDesc));
+  if (bake == ocio_bakes.end()) {
+    OCIOBake new_bake;
 
-  QString shader_call;
+    //
+    // COMPUTE 3D LUT
+    //
 
-  // Enforce alpha association
-  if (alpha_is_associated) {
+    new_bake.lut.resize(3 * lut_size * lut_size * lut_size);
+    processor->getGpuLut3D(new_bake.lut.data(), shaderDesc);
 
-    // If alpha is already associated, we'll need to disassociate and reassociate
-    shader_text.append("\n");
+    // Create OCIO shader code
+    QString shader_text(processor->getGpuShaderText(shaderDesc));
 
-    QString disassociate_func_name = "disassoc";
-    shader_text.append(GetAlphaDisassociateFunction(disassociate_func_name));
+    QString shader_call;
 
-    QString reassociate_func_name = "reassoc";
-    shader_text.append(GetAlphaReassociateFunction(reassociate_func_name));
+    // Enforce alpha association
+    if (alpha == kOCIOAlphaOpaque) {
 
-    // Make OCIO call pass through disassociate and reassociate function
-    shader_call = QString("%3(%1(%2(col), tex2));").arg(ocio_func_name,
-                                                        disassociate_func_name,
-                                                        reassociate_func_name);
+      // Nothing to divide or multiply by
+      shader_call = QString("%1(col, tex2);").arg(ocio_func_name);
 
-  } else {
+    } else if (alpha == kOCIOAlphaAssociated) {
+
+      // If alpha is already associated, we'll need to disassociate and reassociate
+      shader_text.append("\n");
+
+      QString disassociate_func_name = "disassoc";
+      shader_text.append(GetAlphaDisassociateFunction(disassociate_func_name));
+
+      QString reassociate_func_name = "reassoc";
+      shader_text.append(GetAlphaReassociateFunction(reassociate_func_name));
+
+      // Make OCIO call pass through disassociate and reassociate function
+      shader_call = QString("%3(%1(%2(col), tex2));").arg(ocio_func_name,
+                                                          disassociate_func_name,
+                                                          reassociate_func_name);
+
+    } else {
+
+      // If alpha is not already associated, we can just associate after OCIO
 
-    // If alpha is not already associated, we can just associate after OCIO
+      // Add associate function
+      QString associate_func_name = "assoc";
+      shader_text.append(GetAlphaAssociateFunction(associate_func_name));
 
-    // Add associate function
-    QString associate_func_name = "assoc";
-    shader_text.append(GetAlphaAssociateFunction(associate_func_name));
+      // Make OCIO call pass through associate function
+      shader_call = QString("%2(%1(col, tex2));").arg(ocio_func_name, associate_func_name);
 
-    // Make OCIO call pass through associate function
-    shader_call = QString("%2(%1(col, tex2));").arg(ocio_func_name, associate_func_name);
+    }
 
+    shader_text.append(QString("\n"
+                               "uniform sampler3D tex2;\n"
+                               "\n"
+                               "vec4 %2(vec4 col) {\n"
+                               "  return %1\n"
+                               "}\n").arg(shader_call, process_function_name));
+
+    new_bake.shader_text = shader_text;
+
+    bake = ocio_bakes.insert(key, new_bake);
   }
 
-  // Add process() function, which GetPipeline() will call if specified
-  QString process_function_name = "process";
-  shader_text.append(QString("\n"
-                             "uniform sampler3D tex2;\n"
-                             "\n"
-                             "vec4 %2(vec4 col) {\n"
-                             "  return %1\n"
-                             "}\n").arg(shader_call, process_function_name));
+  // Create the LUT texture if this context group doesn't have it yet
+  QOpenGLContextGroup* group = ctx->shareGroup();
+  QPair<QOpenGLContextGroup*, QString> texture_key(group, key);
+
+  lut_texture = ocio_lut_textures.value(texture_key, 0);
+
+  if (lut_texture == 0) {
+    QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+    // Create LUT texture
+    xf->glGenTextures(1, &lut_texture);
+
+    // Bind LUT
+    xf->glBindTexture(GL_TEXTURE_3D, lut_texture);
+
+    // Set texture parameters
+    xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Upload LUT data to texture
+    xf->glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F_ARB,
+                     lut_size, lut_size, lut_size,
+                     0, GL_RGB, GL_FLOAT, bake->lut.constData());
+
+    // Release LUT
+    xf->glBindTexture(GL_TEXTURE_3D, 0);
+
+    // Textures are destroyed with their group, forget them when that happens
+    bool first_for_group = true;
+
+    for (QHash<QPair<QOpenGLContextGroup*, QString>, GLuint>::const_iterator it = ocio_lut_textures.constBegin();
+         it != ocio_lut_textures.constEnd();
+         it++) {
+      if (it.key().first == group) {
+        first_for_group = false;
+        break;
+      }
+    }
+
+    if (first_for_group) {
+      QObject::connect(group, &QObject::destroyed, [group]() {
+        QMutexLocker l(&ocio_mutex);
+
+        QHash<QPair<QOpenGLContextGroup*, QString>, GLuint>::iterator it = ocio_lut_textures.begin();
+
+        while (it != ocio_lut_textures.end()) {
+          if (it.key().first == group) {
+            it = ocio_lut_textures.erase(it);
+          } else {
+            it++;
+          }
+        }
+      });
+    }
+
+    ocio_lut_textures.insert(texture_key, lut_texture);
+  }
 
+  QString shader_text = bake->shader_text;
+
+  locker.unlock();
 
   // Get pipeline-based shader to inject OCIO shader into
   ShaderPtr shader = olive::gl::GetDefaultPipeline(process_function_name, shader_text);
 
-  // Release LUT
-  xf->glBindTexture(GL_TEXTURE_3D, 0);
+  if (shader != nullptr) {
+    shader->bind();
+    shader->setUniformValue("tex2", 1);
+    shader->release();
+  }
 
   return shader;
 }
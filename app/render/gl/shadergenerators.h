@@ -21,6 +21,8 @@
 #ifndef SHADERGENERATORS_H
 #define SHADERGENERATORS_H
 
+#include <QStringList>
+
 #include <OpenColorIO/OpenColorIO.h>
 namespace OCIO = OCIO_NAMESPACE::v1;
 
@@ -39,10 +41,124 @@ namespace gl {
 
 ShaderPtr GetDefaultPipeline(const QString &function_name = QString(), const QString &shader_code = QString());
 
+/**
+ * @brief Returns a pipeline that applies several `vec4 function_name(vec4 color)` functions in one pass
+ *
+ * Like GetDefaultPipeline() but calls each function in order on the output of the one before, so a chain of
+ * per-pixel effects costs a single draw. `shader_code` must define every function (and any uniforms they use, which
+ * must have unique names).
+ *
+ * If `pending` isn't nullptr, the pipeline is built without blocking (see ShaderCache::GetAsync()): until it's ready,
+ * nullptr is returned and `pending` is set to TRUE.
+ */
+ShaderPtr GetFusedPipeline(const QStringList &function_names, const QString &shader_code, bool* pending = nullptr);
+
+/**
+ * @brief Returns a pipeline that computes each pixel with a `vec4 function_name(vec2 coord)` function
+ *
+ * For generating images procedurally (see GeneratorNode). No texture is sampled, the function receives the quad's
+ * texture coordinate (0.0-1.0 across the viewport).
+ *
+ * `pending` works like it does for GetFusedPipeline().
+ */
+ShaderPtr GetGeneratorPipeline(const QString& function_name, const QString& shader_code, bool* pending = nullptr);
+
+/**
+ * @brief Returns a pipeline for drawing copies of a texture with olive::gl::BlitInstanced()
+ *
+ * Samples texture unit 0. The uniform `opacity` (1.0 by default) applies to every copy.
+ */
+ShaderPtr GetInstancedPipeline();
+
+/**
+ * @brief How a layer drawn with GetCompositePipeline() combines with the layers below it
+ *
+ * Every mode composites alpha "over", modes only differ in how colors mix where layers overlap.
+ */
+enum BlendMode {
+  kBlendNormal,
+  kBlendAdd,
+  kBlendMultiply,
+  kBlendScreen
+};
+
+/**
+ * @brief Most layers GetCompositePipeline() can blend in one pass (the minimum texture units OpenGL 3.2 guarantees)
+ */
+const int kMaxCompositeLayers = 16;
+
+/**
+ * @brief Returns a pipeline that blends several textures (with associated alpha) in one pass, bottom to top
+ *
+ * Layer i is bound to texture unit i (uniform `layer<i>`, set by this function). Before drawing, set the uniform arrays
+ * `layer_opacity` (float) and `layer_blend` (int, a BlendMode) for every layer. Pipelines are generated and cached for
+ * each layer count up to kMaxCompositeLayers.
+ */
+ShaderPtr GetCompositePipeline(int layer_count);
+
+/**
+ * @brief Returns a processor converting an input color space to a display and view
+ *
+ * Processors are cached, so identical requests (e.g. from several viewers) share one processor.
+ *
+ * @return
+ *
+ * The processor or nullptr if OCIO couldn't create it (e.g. if a name isn't in the config).
+ */
+OCIO::ConstProcessorRcPtr GetOCIODisplayProcessor(OCIO::ConstConfigRcPtr config,
+                                                  const QString& input_space,
+                                                  const QString& display,
+                                                  const QString& view);
+
+/**
+ * @brief How the alpha of colors passed to an OCIO pipeline relates to their color
+ */
+enum OCIOAlpha {
+  /// Color is multiplied by alpha (the working space), so it's divided before OCIO and multiplied again after
+  kOCIOAlphaAssociated,
+
+  /// Color isn't multiplied by alpha, so it's multiplied after OCIO
+  kOCIOAlphaUnassociated,
+
+  /// Alpha is always 1.0, so OCIO is applied directly without dividing or multiplying anything
+  kOCIOAlphaOpaque
+};
+
+/**
+ * @brief Returns a pipeline that applies an OCIO processor with a 3D LUT
+ *
+ * The LUT is baked once for each processor, alpha mode and LUT size, and uploaded once per context group. The shared
+ * texture is returned in `lut_texture` and must be bound to texture unit 1 (uniform `tex2`) when drawing. It's owned by
+ * the cache, so don't delete it.
+ *
+ * @param alpha
+ *
+ * Alpha of the colors being converted. Pass kOCIOAlphaOpaque wherever it's known there's no transparency, which skips
+ * the alpha wrappers around the OCIO function.
+ *
+ * @param lut_size
+ *
+ * Edge length of the 3D LUT. Smaller LUTs are faster to bake and sample but less precise.
+ */
 ShaderPtr GetOCIOPipeline(QOpenGLContext *ctx,
                           GLuint &lut_texture,
                           OCIO::ConstProcessorRcPtr processor,
-                          bool alpha_is_associated);
+                          OCIOAlpha alpha,
+                          int lut_size = 32);
+
+/**
+ * @brief Returns a pipeline that converts RGBA to Y'CbCr samples packed four to a pixel (see SemiPlanarPacker)
+ *
+ * The source texture is bound to texture unit 1 and read texel by texel, so it should use nearest filtering. Each
+ * output pixel holds four Y' samples from a row of the source, or if the uniform `chroma` is 1.0, two CbCr pairs each
+ * averaged from a 2x2 block.
+ *
+ * Before drawing, set `texture_size` (vec2, the source's size), `source_origin` (vec2, the first source texel) and
+ * `viewport_origin` (vec2, the first output pixel), the conversion's `luma_coefficients` (vec3, Kr Kg Kb) and
+ * `chroma_coefficients` (vec2, the Cb and Cr scales), and `sample_range` (vec4, Y' scale and offset then Cb/Cr scale
+ * and offset in integer samples), `max_sample` (float) and `sample_to_output` (float) to quantize them.
+ */
+ShaderPtr GetSemiPlanarPackPipeline();
 
 QString GetAlphaDisassociateFunction(const QString& function_name);
 QString GetAlphaReassociateFunction(const QString& function_name);
@@ -0,0 +1,471 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "headlessrender.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+
+#include "node/output/viewer/viewer.h"
+#include "project/projectfile.h"
+#include "render/allocationcounters.h"
+
+HeadlessRender::HeadlessRender(QObject *parent) :
+  QObject(parent),
+  sequence_(nullptr),
+  output_(nullptr),
+  next_frame_(0),
+  written_frames_(0),
+  exporting_(false),
+  smart_rendering_(false)
+{
+  stdout_.open(stdout, QIODevice::WriteOnly);
+
+  connect(&renderer_, SIGNAL(FrameReady(RenderJobPtr)), this, SLOT(FrameReady(RenderJobPtr)), Qt::QueuedConnection);
+  connect(&export_engine_, SIGNAL(Progress(qint64, qint64)), this, SLOT(ExportProgress(qint64, qint64)));
+  connect(&export_engine_, SIGNAL(Finished(bool)), this, SLOT(ExportFinished(bool)));
+  connect(&smart_render_, SIGNAL(Progress(qint64, qint64)), this, SLOT(ExportProgress(qint64, qint64)));
+  connect(&smart_render_, SIGNAL(Finished(bool)), this, SLOT(ExportFinished(bool)));
+}
+
+HeadlessRender::~HeadlessRender()
+{
+  renderer_.Stop();
+}
+
+bool HeadlessRender::Start(const HeadlessRender::Params &params)
+{
+  params_ = params;
+
+  if (params_.project.isEmpty()) {
+    PrintError(tr("No project to render"));
+    return false;
+  }
+
+  if (params_.output.isEmpty()) {
+    PrintError(tr("No output filename"));
+    return false;
+  }
+
+  // Sequences don't have a length to default to, so the range has to be given
+  if (params_.out < 0) {
+    PrintError(tr("No last frame to render"));
+    return false;
+  }
+
+  if (params_.in < 0 || params_.out < params_.in) {
+    PrintError(tr("Invalid range %1-%2").arg(params_.in).arg(params_.out));
+    return false;
+  }
+
+  project_ = ProjectFile::Open(params_.project);
+
+  if (project_ == nullptr) {
+    PrintError(tr("Failed to open project %1").arg(params_.project));
+    return false;
+  }
+
+  sequence_ = FindSequence(project_->root(), params_.sequence);
+
+  if (sequence_ == nullptr) {
+    if (params_.sequence.isEmpty()) {
+      PrintError(tr("Project has no sequences"));
+    } else {
+      PrintError(tr("Project has no sequence named %1").arg(params_.sequence));
+    }
+    return false;
+  }
+
+  if (!sequence_->LoadGraph()) {
+    PrintError(tr("Failed to load the graph of sequence %1").arg(sequence_->name()));
+    return false;
+  }
+
+  // Render whatever is connected to the sequence's viewer
+  foreach (Node* n, sequence_->nodes()) {
+    ViewerOutput* viewer = qobject_cast<ViewerOutput*>(n);
+
+    if (viewer != nullptr && !viewer->texture_input()->edges().isEmpty()) {
+      output_ = viewer->texture_input()->edges().first()->output();
+      break;
+    }
+  }
+
+  if (output_ == nullptr) {
+    PrintError(tr("Nothing is connected to the viewer of sequence %1").arg(sequence_->name()));
+    return false;
+  }
+
+  if (sequence_->video_width() <= 0 || sequence_->video_height() <= 0 || sequence_->video_time_base() <= rational(0)) {
+    PrintError(tr("Sequence %1 has no valid video parameters").arg(sequence_->name()));
+    return false;
+  }
+
+  exporting_ = (!params_.output.contains('#') && VideoEncoder::IsVideoFilename(params_.output));
+  smart_rendering_ = (exporting_ && !params_.passthrough.isEmpty());
+
+  if (!exporting_ && !params_.passthrough.isEmpty()) {
+    qWarning() << "Passthrough segments are ignored when rendering image files";
+  }
+
+  if (exporting_) {
+    ExportEngine::Params export_params;
+    export_params.output = output_;
+    export_params.width = sequence_->video_width();
+    export_params.height = sequence_->video_height();
+    export_params.timebase = sequence_->video_time_base();
+    export_params.in = params_.in;
+    export_params.out = params_.out;
+    export_params.filename = params_.output;
+    export_params.codec = params_.codec;
+    export_params.hardware_encoding = params_.hardware_encoding;
+
+    QDir().mkpath(QFileInfo(params_.output).absolutePath());
+
+    if (smart_rendering_) {
+      SmartRender::Params smart_params;
+      smart_params.export_params = export_params;
+      smart_params.segments = params_.passthrough;
+
+      if (!smart_render_.Start(smart_params)) {
+        PrintError(smart_render_.error());
+        return false;
+      }
+    } else if (!export_engine_.Start(export_params)) {
+      PrintError(export_engine_.error());
+      return false;
+    }
+  } else {
+    // Qt5's image writers only handle 8-bit images, so there's no point rendering more than that
+    renderer_.SetParameters(sequence_->video_width(), sequence_->video_height(), olive::PIX_FMT_RGBA8);
+    renderer_.SetFrameDuration(sequence_->video_time_base());
+    renderer_.SetReadbackEnabled(true);
+    renderer_.Start();
+  }
+
+  QJsonObject start;
+  start.insert("sequence", sequence_->name());
+  start.insert("width", sequence_->video_width());
+  start.insert("height", sequence_->video_height());
+  start.insert("in", static_cast<double>(params_.in));
+  start.insert("out", static_cast<double>(params_.out));
+  start.insert("frames", static_cast<double>(params_.out - params_.in + 1));
+  if (smart_rendering_) {
+    start.insert("copied_frames", static_cast<double>(smart_render_.copied_frames()));
+  }
+  Print("start", start);
+
+  next_frame_ = params_.in;
+  written_frames_ = 0;
+  timer_.start();
+
+  if (!exporting_) {
+    QueueFrames();
+  }
+
+  return true;
+}
+
+QString HeadlessRender::FrameFilename(const QString &pattern, int64_t frame)
+{
+  int end = pattern.lastIndexOf('#');
+
+  if (end < 0) {
+    // No placeholder, number the frames before the extension
+    QString suffix = QFileInfo(pattern).suffix();
+
+    if (suffix.isEmpty()) {
+      return QStringLiteral("%1_%2").arg(pattern, QString::number(frame).rightJustified(6, '0'));
+    }
+
+    return QStringLiteral("%1_%2.%3").arg(pattern.left(pattern.size() - suffix.size() - 1),
+                                          QString::number(frame).rightJustified(6, '0'),
+                                          suffix);
+  }
+
+  int start = end;
+
+  while (start > 0 && pattern.at(start - 1) == '#') {
+    start--;
+  }
+
+  return pattern.left(start)
+      + QString::number(frame).rightJustified(end - start + 1, '0')
+      + pattern.mid(end + 1);
+}
+
+bool HeadlessRender::ReadSegments(const QString &filename, QList<SmartRender::Segment> *segments, QString *error)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly | QFile::Text)) {
+    *error = tr("Failed to open passthrough list %1").arg(filename);
+    return false;
+  }
+
+  QRegularExpression regex(QStringLiteral("^(\\d+)\\s+(\\d+)\\s+(\\d+)(?:/(\\d+))?\\s+(\\d+)\\s+(.+)$"));
+
+  QTextStream stream(&file);
+  int line_number = 0;
+
+  while (!stream.atEnd()) {
+    QString line = stream.readLine().trimmed();
+    line_number++;
+
+    if (line.isEmpty() || line.startsWith('#')) {
+      continue;
+    }
+
+    QRegularExpressionMatch match = regex.match(line);
+
+    SmartRender::Segment segment;
+    int64_t media_in_den = 1;
+
+    if (match.hasMatch()) {
+      segment.in = match.captured(1).toLongLong();
+      segment.out = match.captured(2).toLongLong();
+      segment.stream_index = match.captured(5).toInt();
+      segment.filename = match.captured(6);
+
+      if (!match.captured(4).isEmpty()) {
+        media_in_den = match.captured(4).toLongLong();
+      }
+    }
+
+    if (!match.hasMatch() || segment.out < segment.in || media_in_den == 0) {
+      *error = tr("Invalid passthrough segment on line %1 of %2").arg(line_number).arg(filename);
+      return false;
+    }
+
+    segment.media_in = rational(match.captured(3).toLongLong(), media_in_den);
+
+    segments->append(segment);
+  }
+
+  return true;
+}
+
+Sequence *HeadlessRender::FindSequence(Item *item, const QString &name)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence && (name.isEmpty() || child->name() == name)) {
+      return static_cast<Sequence*>(child);
+    }
+
+    Sequence* found = FindSequence(child, name);
+
+    if (found != nullptr) {
+      return found;
+    }
+  }
+
+  return nullptr;
+}
+
+void HeadlessRender::QueueFrames()
+{
+  AllocationCounters::ScopedTag tag(AllocationCounters::kExport);
+
+  // Two frames per thread so a thread never waits for the next frame to be queued
+  int max_in_flight = 2 * qMax(1, QThread::idealThreadCount());
+
+  const rational& timebase = sequence_->video_time_base();
+
+  while (in_flight_.size() < max_in_flight && next_frame_ <= params_.out) {
+    RenderJobPtr job = renderer_.QueueFrame(output_,
+                                            rational(next_frame_ * timebase.numerator(), timebase.denominator()));
+
+    if (job == nullptr) {
+      PrintError(tr("Failed to queue frame %1").arg(next_frame_));
+      Finish(false);
+      return;
+    }
+
+    in_flight_.append(job);
+    next_frame_++;
+  }
+}
+
+bool HeadlessRender::WriteFrame(RenderJob *job, int64_t frame)
+{
+  MemoryBuffer* buffer = job->frame_buffer();
+
+  if (buffer == nullptr || !buffer->IsCreated()) {
+    PrintError(tr("Frame %1 wasn't read back").arg(frame));
+    return false;
+  }
+
+  // Frames are read back with OpenGL's bottom-left origin, mirrored() also makes the deep copy the writer needs
+  QImage image = QImage(buffer->const_data(),
+                        buffer->width(),
+                        buffer->height(),
+                        buffer->linesize(),
+                        QImage::Format_RGBA8888).mirrored();
+
+  QString filename = FrameFilename(params_.output, frame);
+
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+
+  QImageWriter writer(filename);
+
+  if (!writer.write(image)) {
+    PrintError(tr("Failed to write %1: %2").arg(filename, writer.errorString()));
+    return false;
+  }
+
+  return true;
+}
+
+void HeadlessRender::PrintProgress(int64_t frame)
+{
+  int64_t total = params_.out - params_.in + 1;
+  double seconds = static_cast<double>(timer_.elapsed()) / 1000.0;
+  double fps = (seconds > 0) ? static_cast<double>(written_frames_) / seconds : 0;
+
+  QJsonObject progress;
+  progress.insert("frame", static_cast<double>(frame));
+  progress.insert("completed", static_cast<double>(written_frames_));
+  progress.insert("total", static_cast<double>(total));
+  progress.insert("percent", 100.0 * static_cast<double>(written_frames_) / static_cast<double>(total));
+  progress.insert("fps", fps);
+
+  // The export predicts from what each part of the range costs, otherwise assume the rest goes as fast as so far
+  double eta = (fps > 0) ? static_cast<double>(total - written_frames_) / fps : 0;
+
+  if (exporting_ && !smart_rendering_) {
+    qint64 remaining = export_engine_.EstimatedRemaining();
+
+    if (remaining >= 0) {
+      eta = static_cast<double>(remaining) / 1000.0;
+    }
+  }
+
+  progress.insert("eta", eta);
+  Print("progress", progress);
+}
+
+void HeadlessRender::Print(const QString &type, QJsonObject obj)
+{
+  obj.insert("type", type);
+
+  stdout_.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+  stdout_.write("\n");
+  stdout_.flush();
+}
+
+void HeadlessRender::PrintError(const QString &message)
+{
+  QJsonObject error;
+  error.insert("message", message);
+  Print("error", error);
+}
+
+void HeadlessRender::Finish(bool ok)
+{
+  renderer_.CancelAll();
+  in_flight_.clear();
+  renderer_.Stop();
+
+  QJsonObject finished;
+  finished.insert("ok", ok);
+  finished.insert("frames", static_cast<double>(written_frames_));
+  finished.insert("seconds", static_cast<double>(timer_.elapsed()) / 1000.0);
+
+  if (smart_rendering_) {
+    finished.insert("copied_frames", static_cast<double>(smart_render_.copied_frames()));
+  } else if (exporting_) {
+    QVector<double> utilisation = export_engine_.utilisation();
+
+    QJsonObject stages;
+
+    for (int i=0;i<utilisation.size();i++) {
+      stages.insert(ExportEngine::StageName(static_cast<ExportEngine::Stage>(i)).toLower(), utilisation.at(i));
+    }
+
+    finished.insert("utilisation", stages);
+    finished.insert("limited_by", export_engine_.LimitingStage().toLower());
+  }
+
+  Print("finished", finished);
+
+  emit Finished(ok);
+}
+
+void HeadlessRender::FrameReady(RenderJobPtr job)
+{
+  // Frames are delivered in order, so any frame queued before this one was dropped
+  bool dropped = false;
+
+  while (!in_flight_.isEmpty() && in_flight_.first() != job) {
+    PrintError(tr("Frame %1 couldn't be rendered").arg(next_frame_ - in_flight_.size()));
+    in_flight_.removeFirst();
+    dropped = true;
+  }
+
+  if (in_flight_.isEmpty()) {
+    // Left over from a render that has already finished
+    return;
+  }
+
+  int64_t frame = next_frame_ - in_flight_.size();
+  in_flight_.removeFirst();
+
+  if (dropped || !WriteFrame(job.get(), frame)) {
+    Finish(false);
+    return;
+  }
+
+  written_frames_++;
+
+  PrintProgress(frame);
+
+  if (in_flight_.isEmpty() && next_frame_ > params_.out) {
+    Finish(true);
+  } else {
+    QueueFrames();
+  }
+}
+
+void HeadlessRender::ExportProgress(qint64 completed, qint64 total)
+{
+  Q_UNUSED(total)
+
+  written_frames_ = completed;
+
+  PrintProgress(params_.in + completed - 1);
+}
+
+void HeadlessRender::ExportFinished(bool ok)
+{
+  if (!ok) {
+    PrintError(smart_rendering_ ? smart_render_.error() : export_engine_.error());
+  }
+
+  Finish(ok);
+}
@@ -0,0 +1,202 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef HEADLESSRENDER_H
+#define HEADLESSRENDER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+
+#include "export/exportengine.h"
+#include "export/smartrender.h"
+#include "node/processor/renderer/renderer.h"
+#include "project/project.h"
+
+/**
+ * @brief Renders a range of a Sequence to image files or a video file without any UI
+ *
+ * Opens a project, finds a Sequence by name and renders every frame between an in and out point through the node
+ * graph on RendererProcessor's offscreen contexts (with RendererProcessor::SetReadbackEnabled()), so no window or
+ * widget is ever created. Started from the command line with --render.
+ *
+ * Progress is printed to standard output as one compact JSON object per line, with a "type" of "start", "progress",
+ * "error" or "finished", so scripts and render farms can follow it. Warnings go to standard error as usual.
+ *
+ * Video files can be smart rendered (see SmartRender) by listing the ranges that show a source stream unmodified with
+ * --passthrough.
+ *
+ * Machines without a display need a platform plugin that provides OpenGL without one (e.g. -platform eglfs).
+ */
+class HeadlessRender : public QObject
+{
+  Q_OBJECT
+public:
+  struct Params {
+    // Project file to open
+    QString project;
+
+    // Name of the Sequence to render, or empty for the first Sequence in the project
+    QString sequence;
+
+    // Filename of each frame, the last run of '#' characters is replaced by the zero-padded frame number (if there
+    // isn't one, the frame number is added before the extension). The extension chooses the image format. Filenames
+    // without '#' that FFmpeg writes as video files (see VideoEncoder::IsVideoFilename()) are exported with
+    // ExportEngine instead.
+    QString output;
+
+    // Encoder for video files, and whether to try hardware encoders first, see VideoEncoder::Open()
+    QString codec;
+    bool hardware_encoding;
+
+    // First and last frame to render (inclusive), in the Sequence's timebase
+    int64_t in;
+    int64_t out;
+
+    // Ranges of a video file export that show a source stream unmodified and may be copied rather than rendered,
+    // see ReadSegments()
+    QList<SmartRender::Segment> passthrough;
+  };
+
+  HeadlessRender(QObject* parent = nullptr);
+
+  virtual ~HeadlessRender() override;
+
+  /**
+   * @brief Open the project and start rendering
+   *
+   * @return
+   *
+   * FALSE if the render couldn't be started, in which case an error has been printed and Finished() won't be
+   * emitted.
+   */
+  bool Start(const Params& params);
+
+  /**
+   * @brief Returns the filename a frame is written to for an output pattern (see Params::output)
+   */
+  static QString FrameFilename(const QString& pattern, int64_t frame);
+
+  /**
+   * @brief Read SmartRender segments from a file, one per line (empty lines and lines starting with # are skipped)
+   *
+   * Each line is "<in> <out> <media in> <stream index> <filename>": the first and last frame of the export the stream
+   * is shown in, the time in seconds (an integer or a fraction like 1001/30000) of the stream shown at <in>, and the
+   * source file, which may contain spaces.
+   *
+   * @return
+   *
+   * FALSE if the file couldn't be read or a line is invalid, in which case `error` is set.
+   */
+  static bool ReadSegments(const QString& filename, QList<SmartRender::Segment>* segments, QString* error);
+
+signals:
+  /**
+   * @brief Emitted once every frame has been written or the render has failed
+   */
+  void Finished(bool ok);
+
+private:
+  /**
+   * @brief Find a Sequence by name (or the first one if `name` is empty) anywhere under `item`
+   */
+  static Sequence* FindSequence(Item* item, const QString& name);
+
+  /**
+   * @brief Queue frames until enough are in flight to keep every render thread busy
+   */
+  void QueueFrames();
+
+  /**
+   * @brief Write a delivered frame to its file
+   */
+  bool WriteFrame(RenderJob* job, int64_t frame);
+
+  /**
+   * @brief Print the progress of a frame that's been written
+   */
+  void PrintProgress(int64_t frame);
+
+  /**
+   * @brief Print a line of progress with a certain type
+   */
+  void Print(const QString& type, QJsonObject obj);
+
+  /**
+   * @brief Print an error
+   */
+  void PrintError(const QString& message);
+
+  /**
+   * @brief Stop the renderer and emit Finished()
+   */
+  void Finish(bool ok);
+
+  Params params_;
+
+  ProjectPtr project_;
+
+  Sequence* sequence_;
+
+  NodeOutput* output_;
+
+  RendererProcessor renderer_;
+
+  ExportEngine export_engine_;
+
+  SmartRender smart_render_;
+
+  // Frames queued and not delivered yet, in presentation order
+  QList<RenderJobPtr> in_flight_;
+
+  int64_t next_frame_;
+
+  int64_t written_frames_;
+
+  // TRUE if the output is a video file being written by export_engine_ (or smart_render_)
+  bool exporting_;
+
+  // TRUE if the video file is being written by smart_render_
+  bool smart_rendering_;
+
+  QElapsedTimer timer_;
+
+  QFile stdout_;
+
+private slots:
+  /**
+   * @brief Connected to RendererProcessor::FrameReady() with a queued connection
+   */
+  void FrameReady(RenderJobPtr job);
+
+  /**
+   * @brief Connected to ExportEngine::Progress() and SmartRender::Progress()
+   */
+  void ExportProgress(qint64 completed, qint64 total);
+
+  /**
+   * @brief Connected to ExportEngine::Finished() and SmartRender::Finished()
+   */
+  void ExportFinished(bool ok);
+};
+
+#endif // HEADLESSRENDER_H
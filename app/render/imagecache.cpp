@@ -21,26 +21,48 @@
 #include "imagecache.h"
 
 #include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#include "allocationcounters.h"
+#include "common/tracing.h"
+
+// Default budgets for each buffer type
+const qint64 kDefaultMemoryBudget = Q_INT64_C(2048) * 1024 * 1024;
+const qint64 kDefaultTextureBudget = Q_INT64_C(1024) * 1024 * 1024;
 
 ImageCache::ImageCache() :
+  generation_(0),
+  spill_enabled_(1),
   ctx_(nullptr),
   width_(0),
-  height_(0)
+  height_(0),
+  format_(olive::PIX_FMT_RGBA16F)
 {
+  for (int i=0;i<kShardCount;i++) {
+    for (int j=0;j<2;j++) {
+      shards_[i].in_use[j] = {nullptr, nullptr, 0};
+      shards_[i].relinquished_lru[j] = {nullptr, nullptr, 0};
+    }
+  }
+
+  allocated_[TypeIndex(kMemBuf)].store(0);
+  allocated_[TypeIndex(kTexBuf)].store(0);
+
+  budget_[TypeIndex(kMemBuf)].store(kDefaultMemoryBudget);
+  budget_[TypeIndex(kTexBuf)].store(kDefaultTextureBudget);
+
+  clock_.start();
 }
 
 ImageCache::~ImageCache()
 {
-  buffer_array_mutex_.lock();
-
   Clear();
-
-  buffer_array_mutex_.unlock();
 }
 
-void ImageCache::SetParameters(QOpenGLContext *ctx, int width, int height)
+void ImageCache::SetParameters(QOpenGLContext *ctx, int width, int height, const olive::PixelFormat &format)
 {
-  buffer_array_mutex_.lock();
+  Clear();
 
   ctx_ = ctx;
 
@@ -49,189 +71,416 @@ void ImageCache::SetParameters(QOpenGLContext *ctx, int width, int height)
 
     width_ = width;
     height_ = height;
+    format_ = format;
   }
+}
 
-  Clear();
+void ImageCache::SetBudget(const ImageCache::BufferType &type, qint64 bytes)
+{
+  budget_[TypeIndex(type)].store(bytes);
+
+  FreeForIncoming(type, 0, nullptr, nullptr);
+}
+
+qint64 ImageCache::GetBudget(const ImageCache::BufferType &type)
+{
+  return budget_[TypeIndex(type)].load();
+}
+
+qint64 ImageCache::GetAllocatedBytes(const ImageCache::BufferType &type)
+{
+  return allocated_[TypeIndex(type)].load();
+}
+
+void ImageCache::SetSpillEnabled(bool enabled)
+{
+  spill_enabled_.store(enabled ? 1 : 0);
+}
+
+SpillCache *ImageCache::spill_cache()
+{
+  return &spill_cache_;
+}
+
+ImageCache::Entry* ImageCache::RequestBuffer(Ref* r)
+{
+  Tracing::Span span("imagecache", "ImageCache::RequestBuffer");
+
+  if (r->width_ <= 0 || r->height_ <= 0 || (r->buffer_type_ == kTexBuf && ctx_ == nullptr)) {
+    qWarning() << tr("Cache request made without valid parameters (%1: %2, %3").arg(QString::number(reinterpret_cast<quintptr>(ctx_)),
+                                                                                    QString::number(r->width_),
+                                                                                    QString::number(r->height_));
+    return nullptr;
+  }
+
+  BufferKey key;
+  key.type = r->buffer_type_;
+  key.format = r->format_;
+  key.width = r->width_;
+  key.height = r->height_;
+
+  int home = CurrentShard();
+
+  // Try to return a relinquished buffer of the same type, format, and size. Other shards are only checked if they're
+  // not busy.
+  for (int i=0;i<kShardCount;i++) {
+    Shard& shard = shards_[(home + i) % kShardCount];
+
+    if (i == 0) {
+      shard.mutex.lock();
+    } else if (!shard.mutex.tryLock()) {
+      continue;
+    }
+
+    Entry* e = TakeRelinquished(shard, r, key);
+
+    shard.mutex.unlock();
+
+    if (e != nullptr) {
+      return e;
+    }
+  }
+
+  // If no buffer was available, we'll have to create a new one. Make room for it in the budget first, which may give
+  // us a buffer to reuse instead.
+  qint64 size = GetBufferBytes(key);
 
-  buffer_array_mutex_.unlock();
+  Entry* reuse = FreeForIncoming(key.type, size, &key, r);
+
+  if (reuse != nullptr) {
+    return reuse;
+  }
+
+  // Otherwise, just generate a new buffer (outside of the lock since this may take a while)
+  allocated_[TypeIndex(key.type)].fetchAndAddOrdered(size);
+
+  MemoryBuffer* mem = nullptr;
+  TextureBuffer* tex = nullptr;
+
+  AllocationCounters::ScopedTag tag(AllocationCounters::kImageCache);
+
+  switch (key.type) {
+  case kMemBuf:
+    mem = new MemoryBuffer();
+    mem->Create(key.width, key.height, key.format);
+    break;
+  case kTexBuf:
+    tex = new TextureBuffer();
+    tex->Create(ctx_, key.format, key.width, key.height);
+    break;
+  default:
+    Q_ASSERT(false);
+  }
+
+  Shard& shard = shards_[home];
+
+  ProfiledMutexLocker locker(&shard.mutex);
+
+  Entry* e;
+
+  if (shard.unused.isEmpty()) {
+    e = new Entry();
+    shard.entries.append(e);
+  } else {
+    e = shard.unused.takeLast();
+  }
+
+  e->key = key;
+  e->mem = mem;
+  e->tex = tex;
+  e->ref = r;
+  e->size = size;
+  e->access_time.store(clock_.elapsed());
+  e->listed_time = e->access_time.load();
+  e->lru_prev = nullptr;
+  e->lru_next = nullptr;
+  e->free_position = -1;
+  e->shard = home;
+
+  ListAppend(shard.in_use[TypeIndex(key.type)], e);
+
+  return e;
 }
 
-int ImageCache::RequestBuffer(Ref* r, const BufferType& type, const olive::PixelFormat& format, int width, int height)
+ImageCache::Entry *ImageCache::TakeRelinquished(ImageCache::Shard &shard, Ref *r, const BufferKey &key)
 {
-  if (type == kTexBuf && (ctx_ == nullptr || width_ == 0 || height_ == 0)) {
-    qWarning() << tr("Texture cache request made without valid parameters (%1: %2, %3").arg(QString::number(reinterpret_cast<quintptr>(ctx_)),
-                                                                                            QString::number(width_),
-                                                                                            QString::number(height_));
-    return -1;
+  QHash<BufferKey, QVector<Entry*> >::iterator free_list = shard.relinquished.find(key);
+
+  if (free_list == shard.relinquished.end() || free_list->isEmpty()) {
+    return nullptr;
   }
 
-  buffer_array_mutex_.lock();
+  Entry* e = free_list->last();
+  int type = TypeIndex(key.type);
 
-  int buffer = RequestBufferInternal(r, type, format, width, height);
+  RemoveFromFreeList(shard, e);
+  ListRemove(shard.relinquished_lru[type], e);
+  ListAppend(shard.in_use[type], e);
 
-  buffer_array_mutex_.unlock();
+  e->ref = r;
+  e->access_time.store(clock_.elapsed());
+  e->listed_time = e->access_time.load();
 
-  return buffer;
+  return e;
 }
 
-int ImageCache::RequestBufferInternal(Ref *r, const BufferType& type, const olive::PixelFormat& format, int width, int height)
+void ImageCache::RelinquishBuffer(Entry* e)
 {
-  Q_ASSERT(type != kInvalidBuf);
+  Shard& shard = shards_[e->shard];
 
-  QList<int>& relinquished = (type == kMemBuf) ? img_relinquished_ : tex_relinquished_;
-  QList<Ref*>& refs = (type == kMemBuf) ? img_refs_ : tex_refs_;
-  QList<time_t>& access_times = (type == kMemBuf) ? img_access_times_ : tex_access_times_;
+  ProfiledMutexLocker locker(&shard.mutex);
 
-  // Try to return a relinquished buffer
-  if (!relinquished.isEmpty()) {
+  int type = TypeIndex(e->key.type);
 
-    if (type == kTexBuf) {
+  e->ref = nullptr;
 
-      int buf_index = relinquished.takeFirst();
+  QVector<Entry*>& free_list = shard.relinquished[e->key];
+  e->free_position = free_list.size();
+  free_list.append(e);
 
-      refs.replace(buf_index, r);
+  ListRemove(shard.in_use[type], e);
+  ListAppend(shard.relinquished_lru[type], e);
+}
 
-      return buf_index;
+ImageCache::Entry* ImageCache::FreeForIncoming(const ImageCache::BufferType &type,
+                                               qint64 incoming,
+                                               const BufferKey *reuse_key,
+                                               Ref* r)
+{
+  int type_index = TypeIndex(type);
+  int home = CurrentShard();
+
+  // Free from this thread's shard first, only one shard is ever locked at a time
+  for (int i=0;i<kShardCount && OverBudget(type, incoming);i++) {
+    Shard& shard = shards_[(home + i) % kShardCount];
+
+    ProfiledMutexLocker locker(&shard.mutex);
+
+    LRUList& relinquished = shard.relinquished_lru[type_index];
+    LRUList& in_use = shard.in_use[type_index];
+
+    // Buffers nobody is using go first
+    while (relinquished.head != nullptr && OverBudget(type, incoming)) {
+      DestroyEntry(shard, relinquished.head);
+    }
 
-    } else if (type == kMemBuf) {
+    // Then take the least recently accessed buffers from their Refs. Buffers that were accessed since they were last
+    // moved in the list, or whose Refs are busy or locked, get a second chance at the back of the list.
+    int candidates = in_use.count * 2;
 
-      // Check for a relinquished buffer with the desired size
+    while (in_use.head != nullptr && candidates > 0 && OverBudget(type, incoming)) {
+      candidates--;
 
-      //
-      // TODO consider a database for sorting through these buffers
-      //
-      for (int i=0;i<relinquished.size();i++) {
+      Entry* e = in_use.head;
+      qint64 accessed = e->access_time.load();
+      Ref* owner = e->ref;
 
-        const MemoryBuffer& b = img_buffers_.at(relinquished.at(i));
+      bool take = false;
 
-        if (b.width() == width && b.height() == height) {
-          // This buffer fits, we'll use it
-          int buffer_index = relinquished.takeAt(i);
+      if (accessed == e->listed_time && owner->mutex_.tryLock()) {
+        take = (owner->locks_ == 0);
 
-          refs.replace(buffer_index, r);
+        if (take) {
+          if (spill_enabled_.load() && type == kMemBuf) {
+            // Write the contents to disk so the Ref can get them back
+            owner->spill_ = spill_cache_.Write(e->mem, nullptr);
+          }
 
-          return buffer_index;
+          owner->entry_ = nullptr;
         }
+
+        owner->mutex_.unlock();
+      }
+
+      if (!take) {
+        ListRemove(in_use, e);
+        ListAppend(in_use, e);
+        e->listed_time = accessed;
+        continue;
       }
 
+      e->ref = nullptr;
+
+      if (r != nullptr && reuse_key != nullptr && e->key == *reuse_key) {
+        // Give this buffer straight to the requesting Ref
+        ListRemove(in_use, e);
+        ListAppend(in_use, e);
+
+        e->ref = r;
+        e->access_time.store(clock_.elapsed());
+        e->listed_time = e->access_time.load();
+
+        return e;
+      }
+
+      DestroyEntry(shard, e);
     }
   }
 
-  // If no buffer was available, we may have to create a new one
+  // If we're still over budget, the budget is smaller than what's in use, allocate anyway
+  return nullptr;
+}
+
+void ImageCache::DestroyEntry(Shard& shard, Entry* e)
+{
+  int type = TypeIndex(e->key.type);
 
-  // Check if we have enough memory (according to user-defined limits in the Config), if we don't, try to relinquish an
-  // old buffer and return that.
-  if (OutOfMemory()) {
+  if (e->ref == nullptr && e->free_position > -1) {
+    RemoveFromFreeList(shard, e);
+    ListRemove(shard.relinquished_lru[type], e);
+  } else {
+    ListRemove(shard.in_use[type], e);
+  }
 
-    //
-    // TODO no support for a MemBuf's variable size
-    //
+  delete e->mem;
+  delete e->tex;
 
-    int least_recent_access = 0;
+  e->mem = nullptr;
+  e->tex = nullptr;
+  e->ref = nullptr;
 
-    // Loop through buffers for the oldest accessed buffer
-    for (int i=1;i<access_times.size();i++) {
-      if (access_times.at(i) < access_times.at(least_recent_access)
-          && refs.at(i) != nullptr) { // ensure this buffer has not been relinquished
-        least_recent_access = i;
-      }
-    }
+  allocated_[type].fetchAndAddOrdered(-e->size);
+
+  shard.unused.append(e);
+}
+
+void ImageCache::RemoveFromFreeList(Shard& shard, Entry* e)
+{
+  QHash<BufferKey, QVector<Entry*> >::iterator free_list = shard.relinquished.find(e->key);
+
+  // Swap with the last entry in the list so removal is constant time
+  Entry* last = free_list->last();
+
+  free_list->replace(e->free_position, last);
+  last->free_position = e->free_position;
+
+  free_list->removeLast();
 
-    // Relinquish this buffer
-    refs.at(least_recent_access)->Relinquish();
-    refs.replace(least_recent_access, r);
-    return least_recent_access;
+  if (free_list->isEmpty()) {
+    shard.relinquished.erase(free_list);
   }
 
-  // Otherwise, just generate a new buffer
-  int index = -1;
-  switch (type) {
-  case kMemBuf:
-    index = img_buffers_.size();
-    img_buffers_.append(MemoryBuffer());
-    img_buffers_.last().Create(width_, height_, format);
-    break;
-  case kTexBuf:
-    index = tex_buffers_.size();
-    tex_buffers_.append(TextureBuffer());
-    tex_buffers_.last().Create(ctx_, format, width_, height_);
-    break;
-  default:
-    Q_ASSERT(false);
+  e->free_position = -1;
+}
+
+void ImageCache::ListRemove(ImageCache::LRUList &list, Entry* e)
+{
+  if (e->lru_prev != nullptr) {
+    e->lru_prev->lru_next = e->lru_next;
+  } else {
+    list.head = e->lru_next;
+  }
+
+  if (e->lru_next != nullptr) {
+    e->lru_next->lru_prev = e->lru_prev;
+  } else {
+    list.tail = e->lru_prev;
   }
 
-  refs.append(r);
-  access_times.append(time(nullptr));
+  e->lru_prev = nullptr;
+  e->lru_next = nullptr;
 
-  return index;
+  list.count--;
 }
 
-void ImageCache::RelinquishBuffer(int index, const BufferType &type)
+void ImageCache::ListAppend(ImageCache::LRUList &list, Entry* e)
 {
-  buffer_array_mutex_.lock();
+  e->lru_prev = list.tail;
+  e->lru_next = nullptr;
 
-  switch (type) {
-  case kMemBuf:
-    img_refs_.replace(index, nullptr);
-    img_relinquished_.append(index);
-    break;
-  case kTexBuf:
-    tex_refs_.replace(index, nullptr);
-    tex_relinquished_.append(index);
-    break;
-  default:
-    qFatal("Invalid buffer type on ImageCache::RelinquishBuffer");
+  if (list.tail != nullptr) {
+    list.tail->lru_next = e;
+  } else {
+    list.head = e;
   }
 
-  buffer_array_mutex_.unlock();
+  list.tail = e;
+
+  list.count++;
 }
 
-void *ImageCache::Buffer(int index, const BufferType &type)
+int ImageCache::TypeIndex(const ImageCache::BufferType &type)
 {
-  switch (type) {
-  case kMemBuf:
-    img_access_times_.replace(index, time(nullptr));
-    return &img_buffers_[index];
-  case kTexBuf:
-    tex_access_times_.replace(index, time(nullptr));
-    return &tex_buffers_[index];
-  default:
-    qFatal("Invalid buffer type on ImageCache::Buffer");
+  return (type == kTexBuf) ? 1 : 0;
+}
+
+qint64 ImageCache::GetBufferBytes(const ImageCache::BufferKey &key)
+{
+  if (key.type == kMemBuf) {
+    // Rows of MemoryBuffers are padded
+    return static_cast<qint64>(MemoryBuffer::GetLinesize(key.format, key.width)) * key.height;
   }
+
+  return static_cast<qint64>(PixelService::BytesPerPixel(key.format)) * key.width * key.height;
 }
 
-bool ImageCache::OutOfMemory()
+int ImageCache::CurrentShard()
 {
-  // TODO actually check if we have any memory or not
-  return false;
+  quintptr thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+
+  return static_cast<int>(qHash(thread) % static_cast<uint>(kShardCount));
+}
+
+bool ImageCache::OverBudget(const ImageCache::BufferType &type, qint64 incoming)
+{
+  int index = TypeIndex(type);
+
+  return allocated_[index].load() + incoming > budget_[index].load();
 }
 
 void ImageCache::Clear()
 {
-  for (int i=0;i<img_refs_.size();i++) {
-    img_refs_.at(i)->Relinquish();
+  // Invalidate every Ref's entry (see Ref::BufferInternal())
+  generation_.fetchAndAddOrdered(1);
+
+  // Clear() is the only function that locks more than one shard so locking them in order can't deadlock
+  for (int i=0;i<kShardCount;i++) {
+    shards_[i].mutex.lock();
   }
 
-  for (int i=0;i<tex_refs_.size();i++) {
-    tex_refs_.at(i)->Relinquish();
+  for (int i=0;i<kShardCount;i++) {
+    Shard& shard = shards_[i];
+
+    for (int j=0;j<shard.entries.size();j++) {
+      Entry* e = shard.entries.at(j);
+
+      delete e->mem;
+      delete e->tex;
+      delete e;
+    }
+
+    shard.entries.clear();
+    shard.unused.clear();
+    shard.relinquished.clear();
+
+    for (int j=0;j<2;j++) {
+      shard.in_use[j] = {nullptr, nullptr, 0};
+      shard.relinquished_lru[j] = {nullptr, nullptr, 0};
+    }
   }
 
-  img_refs_.clear();
-  tex_refs_.clear();
+  allocated_[TypeIndex(kMemBuf)].store(0);
+  allocated_[TypeIndex(kTexBuf)].store(0);
 
-  img_buffers_.clear();
-  tex_buffers_.clear();
+  // Spilled contents belong to buffers that no longer exist, Refs will find their spill IDs are gone
+  spill_cache_.Clear();
 
-  img_relinquished_.clear();
-  tex_relinquished_.clear();
+  for (int i=kShardCount-1;i>=0;i--) {
+    shards_[i].mutex.unlock();
+  }
 }
 
 ImageCache::Ref::Ref(ImageCache *cache) :
   buffer_type_(kInvalidBuf),
   width_(cache->width_),
   height_(cache->height_),
+  format_(cache->format_),
   cache_(cache),
-  buffer_(-1)
+  entry_(nullptr),
+  generation_(0),
+  spill_(-1),
+  locks_(0),
+  mutex_("ImageCache::Ref")
 {
 }
 
@@ -242,44 +491,101 @@ ImageCache::Ref::~Ref()
 
 void *ImageCache::Ref::BufferInternal()
 {
-  // If we don't have a buffer yet, request one
-  if (buffer_ == -1) {
-    Request();
+  ProfiledMutexLocker locker(&mutex_);
+
+  // Forget entries from before the cache was cleared
+  if (entry_ != nullptr && generation_ != cache_->generation_.load()) {
+    entry_ = nullptr;
   }
 
-  // If we didn't receive one, return null
-  if (buffer_ == -1) {
-    return nullptr;
+  // If we don't have a buffer yet, request one
+  if (entry_ == nullptr) {
+
+    // Check if we have a valid buffer type to request
+    if (buffer_type_ == kInvalidBuf) {
+      qWarning() << tr("Tried to request an invalid buffer type");
+      return nullptr;
+    }
+
+    generation_ = cache_->generation_.load();
+    entry_ = cache_->RequestBuffer(this);
+
+    // If we didn't receive one, return null
+    if (entry_ == nullptr) {
+      return nullptr;
+    }
+
+    // If this Ref's contents were spilled to disk when its last buffer was taken, restore them (this fails quietly if
+    // the spill was deleted to make space on disk)
+    if (spill_ > -1) {
+      if (entry_->mem != nullptr) {
+        cache_->spill_cache_.Read(spill_, entry_->mem);
+      }
+
+      spill_ = -1;
+    }
   }
 
-  // Otherwise, return the buffer we received
-  return cache_->Buffer(buffer_, buffer_type_);
+  // Stamp the access time without touching any of the cache's locks
+  entry_->access_time.store(cache_->clock_.elapsed());
+
+  return (buffer_type_ == kMemBuf) ? static_cast<void*>(entry_->mem) : static_cast<void*>(entry_->tex);
 }
 
 void ImageCache::Ref::Relinquish()
 {
-  if (buffer_ == -1) {
-    return;
-  }
+  ProfiledMutexLocker locker(&mutex_);
+
+  RelinquishInternal();
+}
+
+void ImageCache::Ref::SetSize(int w, int h)
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  width_ = w;
+  height_ = h;
 
-  cache_->RelinquishBuffer(buffer_, buffer_type_);
-  buffer_ = -1;
+  RelinquishInternal();
 }
 
-void ImageCache::Ref::Request()
+void ImageCache::Ref::SetFormat(const olive::PixelFormat &format)
 {
-  // Check if we already have a buffer, in which case we don't need to request a new one
-  if (buffer_ != -1) {
-    return;
+  ProfiledMutexLocker locker(&mutex_);
+
+  format_ = format;
+
+  RelinquishInternal();
+}
+
+void ImageCache::Ref::Lock()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  locks_++;
+}
+
+void ImageCache::Ref::Unlock()
+{
+  ProfiledMutexLocker locker(&mutex_);
+
+  Q_ASSERT(locks_ > 0);
+
+  locks_--;
+}
+
+void ImageCache::Ref::RelinquishInternal()
+{
+  if (spill_ > -1) {
+    cache_->spill_cache_.Remove(spill_);
+    spill_ = -1;
   }
 
-  // Check if we have a valid buffer type to request
-  if (buffer_type_ == kInvalidBuf) {
-    qWarning() << tr("Tried to request an invalid buffer type");
-    return;
+  if (entry_ != nullptr && generation_ == cache_->generation_.load()) {
+    cache_->RelinquishBuffer(entry_);
   }
 
-  buffer_ = cache_->RequestBuffer(this, buffer_type_, width_, height_);
+  entry_ = nullptr;
 }
 
 ImageCache::ImgRef::ImgRef(ImageCache *cache) :
@@ -288,14 +594,6 @@ ImageCache::ImgRef::ImgRef(ImageCache *cache) :
   buffer_type_ = kMemBuf;
 }
 
-void ImageCache::ImgRef::SetSize(int w, int h)
-{
-  width_ = w;
-  height_ = h;
-
-  Relinquish();
-}
-
 MemoryBuffer *ImageCache::ImgRef::buffer()
 {
   return static_cast<MemoryBuffer*>(BufferInternal());
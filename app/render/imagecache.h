@@ -21,14 +21,44 @@
 #ifndef MEMORYCACHE_H
 #define MEMORYCACHE_H
 
-#include <QList>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMutex>
+#include <QVector>
 
+#include "common/profiledmutex.h"
 #include "texturebuffer.h"
 #include "memorybuffer.h"
-
+#include "spillcache.h"
+
+/**
+ * @brief A cache of reusable RAM and VRAM image buffers
+ *
+ * Rather than allocating buffers directly, consumers hold a Ref (ImgRef for a MemoryBuffer, TexRef for a
+ * TextureBuffer) which requests a buffer from the cache the first time it's accessed. Once the Ref relinquishes it
+ * (or is destroyed), the buffer is kept and handed to the next Ref that requests the same type, format and size.
+ *
+ * Relinquished buffers are kept in free lists keyed by (type, format, width, height) so a fitting buffer is found in
+ * constant time, and a buffer is never handed out with a different format or size than was requested.
+ *
+ * Each buffer type has a budget in bytes (see SetBudget()). When a new buffer would exceed it, relinquished buffers are
+ * freed first, least recently used first. If that isn't enough, the least recently accessed buffers still held by Refs
+ * are taken from them (the Ref will request a new buffer the next time it's accessed). Buffers of Refs that are locked
+ * (see Ref::Lock()) are never taken.
+ *
+ * When a MemoryBuffer is taken from a Ref, its contents are written to a SpillCache on disk (unless disabled with
+ * SetSpillEnabled()) and restored into the Ref's new buffer the next time it's accessed.
+ *
+ * The cache is split into shards, each with its own lock, free lists and LRU lists. Threads request buffers from their
+ * own shard first so concurrent RendererThreads rarely contend, and accessing a buffer through a Ref only touches that
+ * Ref's own lock and an atomic timestamp. Buffers never move in memory while they're held by a Ref.
+ */
 class ImageCache : public QObject
 {
+private:
+  struct Entry;
+
 public:
 
   enum BufferType {
@@ -40,9 +70,33 @@ public:
   class Ref {
   public:
     Ref(ImageCache* cache);
-    ~Ref();
+    virtual ~Ref();
 
     void Relinquish();
+
+    /**
+     * @brief Set the size of the buffer to request (defaults to the size set in ImageCache::SetParameters())
+     *
+     * Relinquishes the current buffer if there is one.
+     */
+    void SetSize(int w, int h);
+
+    /**
+     * @brief Set the format of the buffer to request (defaults to the format set in ImageCache::SetParameters())
+     *
+     * Relinquishes the current buffer if there is one.
+     */
+    void SetFormat(const olive::PixelFormat& format);
+
+    /**
+     * @brief Prevent the cache from taking this Ref's buffer until Unlock() is called
+     *
+     * Hold a lock while using the pointer returned by buffer() if other threads may be requesting buffers at the same
+     * time. Locks may be nested.
+     */
+    void Lock();
+
+    void Unlock();
   protected:
     void* BufferInternal();
 
@@ -50,19 +104,32 @@ public:
 
     int width_;
     int height_;
+    olive::PixelFormat format_;
   private:
-    void Request();
+    friend class ImageCache;
+
+    void RelinquishInternal();
 
     ImageCache* cache_;
-    int buffer_;
+
+    // Current buffer or nullptr, only valid if generation_ matches the cache's (see ImageCache::Clear())
+    Entry* entry_;
+    int generation_;
+
+    // ID of this Ref's contents in the SpillCache, or -1 if nothing is spilled
+    int spill_;
+
+    // Number of nested Lock() calls
+    int locks_;
+
+    // Protects all of the above, the cache only ever try-locks this
+    ProfiledMutex mutex_;
   };
 
   class ImgRef : public Ref {
   public:
     ImgRef(ImageCache* cache);
 
-    void SetSize(int w, int h);
-
     MemoryBuffer* buffer();
 
   };
@@ -76,36 +143,202 @@ public:
   ImageCache();
   ~ImageCache();
 
-  void SetParameters(QOpenGLContext* ctx, int width, int height);
+  /**
+   * @brief Set the context textures are created in and the default buffer parameters for new Refs
+   *
+   * Clears the cache, any Refs holding buffers will request new ones. Must not be called while any buffers are in use.
+   */
+  void SetParameters(QOpenGLContext* ctx,
+                     int width,
+                     int height,
+                     const olive::PixelFormat& format = olive::PIX_FMT_RGBA16F);
+
+  /**
+   * @brief Set the maximum number of bytes buffers of a certain type may use
+   *
+   * If the cache is already using more than this, buffers are freed straight away.
+   */
+  void SetBudget(const BufferType& type, qint64 bytes);
+
+  /**
+   * @brief Returns the maximum number of bytes buffers of a certain type may use
+   */
+  qint64 GetBudget(const BufferType& type);
+
+  /**
+   * @brief Returns the number of bytes currently allocated for buffers of a certain type
+   */
+  qint64 GetAllocatedBytes(const BufferType& type);
+
+  /**
+   * @brief Set whether MemoryBuffers taken from Refs are spilled to disk (defaults to TRUE)
+   */
+  void SetSpillEnabled(bool enabled);
+
+  /**
+   * @brief Access the disk tier (e.g. to set its budget)
+   */
+  SpillCache* spill_cache();
 
 private:
-  int RequestBuffer(Ref *r, const BufferType& type, const olive::PixelFormat &format, int width, int height);
-  int RequestBufferInternal(Ref *r, const BufferType& type, const olive::PixelFormat &format, int width, int height);
+  /**
+   * @brief Identifies buffers that are interchangeable
+   */
+  struct BufferKey {
+    BufferType type;
+    olive::PixelFormat format;
+    int width;
+    int height;
+
+    bool operator==(const BufferKey& other) const
+    {
+      return type == other.type && format == other.format && width == other.width && height == other.height;
+    }
+
+    friend uint qHash(const BufferKey& key, uint seed = 0)
+    {
+      return ::qHash(key.type, seed)
+          ^ ::qHash(key.format, seed + 1)
+          ^ ::qHash(key.width, seed + 2) * 31u
+          ^ ::qHash(key.height, seed + 3) * 131u;
+    }
+  };
+
+  /**
+   * @brief A buffer owned by the cache
+   *
+   * Entries are allocated once and recycled until the cache is cleared, so pointers to them stay valid.
+   */
+  struct Entry {
+    BufferKey key;
+
+    // Only one of these is set depending on key.type (neither if this entry is unused)
+    MemoryBuffer* mem;
+    TextureBuffer* tex;
+
+    // Ref currently using this buffer, or nullptr if it's relinquished
+    Ref* ref;
+
+    // Bytes this buffer uses
+    qint64 size;
 
-  void RelinquishBuffer(int index, const BufferType& type);
+    // Last access in milliseconds since the cache was constructed, stamped by Refs without locking
+    QAtomicInteger<qint64> access_time;
 
-  void *Buffer(int index, const BufferType &type);
+    // Value of access_time when this entry was last moved in its LRU list
+    qint64 listed_time;
+
+    // Neighbors in the LRU list this entry is in
+    Entry* lru_prev;
+    Entry* lru_next;
+
+    // Position in its free list (if relinquished)
+    int free_position;
+
+    // Shard this entry belongs to
+    int shard;
+  };
+
+  /**
+   * @brief Doubly linked list of entries, from least to most recently used
+   */
+  struct LRUList {
+    Entry* head;
+    Entry* tail;
+    int count;
+  };
 
-  bool OutOfMemory();
+  /**
+   * @brief An independently locked part of the cache
+   */
+  struct Shard {
+    Shard() :
+      mutex("ImageCache::Shard")
+    {
+    }
+
+    ProfiledMutex mutex;
+
+    // Every entry this shard owns (used or not)
+    QVector<Entry*> entries;
+
+    // Entries without a buffer that can be recycled
+    QVector<Entry*> unused;
+
+    QHash<BufferKey, QVector<Entry*> > relinquished;
+
+    // Indexed by TypeIndex()
+    LRUList in_use[2];
+    LRUList relinquished_lru[2];
+  };
+
+  static const int kShardCount = 8;
+
+  Entry* RequestBuffer(Ref *r);
+
+  /**
+   * @brief Take a relinquished buffer matching `key` from a shard (whose mutex must be locked)
+   */
+  Entry* TakeRelinquished(Shard& shard, Ref* r, const BufferKey& key);
+
+  void RelinquishBuffer(Entry* e);
+
+  /**
+   * @brief Free buffers of a certain type until `incoming` more bytes fit in the budget
+   *
+   * @param reuse_key
+   *
+   * If a buffer held by a Ref has to be taken and it matches this key, it's given to `r` rather than freed.
+   *
+   * @return
+   *
+   * Buffer given to `r`, or nullptr if a new one should be allocated.
+   */
+  Entry* FreeForIncoming(const BufferType& type, qint64 incoming, const BufferKey* reuse_key, Ref* r);
+
+  /**
+   * @brief Free a buffer and remove it from all bookkeeping (its shard's mutex must be locked)
+   */
+  void DestroyEntry(Shard& shard, Entry* e);
+
+  void RemoveFromFreeList(Shard& shard, Entry* e);
+
+  static void ListRemove(LRUList& list, Entry* e);
+  static void ListAppend(LRUList& list, Entry* e);
+
+  static int TypeIndex(const BufferType& type);
+
+  static qint64 GetBufferBytes(const BufferKey& key);
+
+  /**
+   * @brief Returns the shard the current thread prefers
+   */
+  static int CurrentShard();
+
+  bool OverBudget(const BufferType& type, qint64 incoming);
 
   void Clear();
 
-  QList<MemoryBuffer> img_buffers_;
-  QList<Ref*> img_refs_;
-  QList<time_t> img_access_times_;
-  QList<int> img_relinquished_;
+  Shard shards_[kShardCount];
 
-  QList<TextureBuffer> tex_buffers_;
-  QList<Ref*> tex_refs_;
-  QList<time_t> tex_access_times_;
-  QList<int> tex_relinquished_;
+  // Indexed by TypeIndex()
+  QAtomicInteger<qint64> allocated_[2];
+  QAtomicInteger<qint64> budget_[2];
+
+  // Incremented by Clear() to invalidate every Ref's entry
+  QAtomicInt generation_;
+
+  SpillCache spill_cache_;
+
+  QAtomicInt spill_enabled_;
+
+  QElapsedTimer clock_;
 
   QOpenGLContext* ctx_;
 
   int width_;
   int height_;
-
-  QMutex buffer_array_mutex_;
+  olive::PixelFormat format_;
 };
 
 #endif // MEMORYCACHE_H
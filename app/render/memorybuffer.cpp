@@ -20,17 +20,129 @@
 
 #include "memorybuffer.h"
 
-MemoryBuffer::MemoryBuffer()
+#include <cstring>
+#include <utility>
+
+#include "memorypool.h"
+
+MemoryBuffer::MemoryBuffer() :
+  data_(nullptr),
+  capacity_(0),
+  width_(0),
+  height_(0),
+  linesize_(0),
+  format_(olive::PIX_FMT_RGBA8),
+  tag_(AllocationCounters::kOther)
+{
+}
+
+MemoryBuffer::~MemoryBuffer()
+{
+  Destroy();
+}
+
+MemoryBuffer::MemoryBuffer(const MemoryBuffer &other) :
+  MemoryBuffer()
+{
+  *this = other;
+}
+
+MemoryBuffer::MemoryBuffer(MemoryBuffer &&other) :
+  MemoryBuffer()
 {
+  *this = std::move(other);
+}
+
+MemoryBuffer &MemoryBuffer::operator=(const MemoryBuffer &other)
+{
+  if (this == &other) {
+    return *this;
+  }
+
+  if (!other.IsCreated()) {
+    Destroy();
+    return *this;
+  }
+
+  Create(other.width_, other.height_, other.format_);
+
+  if (data_ != nullptr) {
+    memcpy(data_, other.data_, static_cast<size_t>(size()));
+  }
+
+  return *this;
+}
+
+MemoryBuffer &MemoryBuffer::operator=(MemoryBuffer &&other)
+{
+  if (this == &other) {
+    return *this;
+  }
+
+  Destroy();
+
+  data_ = other.data_;
+  capacity_ = other.capacity_;
+  width_ = other.width_;
+  height_ = other.height_;
+  linesize_ = other.linesize_;
+  format_ = other.format_;
+  tag_ = other.tag_;
+
+  other.data_ = nullptr;
+  other.capacity_ = 0;
+  other.width_ = 0;
+  other.height_ = 0;
+  other.linesize_ = 0;
+
+  return *this;
 }
 
 void MemoryBuffer::Create(int width, int height, const olive::PixelFormat &format)
 {
+  int linesize = GetLinesize(format, width);
+  int size = linesize * height;
+
+  // Reuse the current allocation if it's big enough, otherwise swap it for one from the pool
+  if (data_ == nullptr || size > capacity_) {
+    Destroy();
+
+    data_ = olive::memory_pool.Allocate(size, &capacity_);
+
+    if (data_ == nullptr) {
+      capacity_ = 0;
+      return;
+    }
+
+    tag_ = AllocationCounters::CurrentTag();
+    AllocationCounters::Allocated(AllocationCounters::kMemoryBuffer, tag_, capacity_);
+  }
+
   width_ = width;
   height_ = height;
+  linesize_ = linesize;
   format_ = format;
+}
+
+void MemoryBuffer::Destroy()
+{
+  if (data_ != nullptr) {
+    AllocationCounters::Freed(AllocationCounters::kMemoryBuffer, tag_, capacity_);
+
+    olive::memory_pool.Release(data_, capacity_);
 
-  data_.resize(PixelService::GetBufferSize(format, width, height));
+    data_ = nullptr;
+  }
+
+  capacity_ = 0;
+  width_ = 0;
+  height_ = 0;
+  linesize_ = 0;
+}
+
+bool MemoryBuffer::IsCreated() const
+{
+  return (data_ != nullptr);
 }
 
 const int &MemoryBuffer::width() const
@@ -48,12 +160,39 @@ const olive::PixelFormat &MemoryBuffer::format() const
   return format_;
 }
 
+const int &MemoryBuffer::linesize() const
+{
+  return linesize_;
+}
+
+int MemoryBuffer::size() const
+{
+  return linesize_ * height_;
+}
+
 uint8_t *MemoryBuffer::data()
 {
-  return data_.data();
+  return data_;
 }
 
 const uint8_t *MemoryBuffer::const_data() const
 {
-  return data_.constData();
+  return data_;
+}
+
+uint8_t *MemoryBuffer::row(int y)
+{
+  return data_ + y * linesize_;
+}
+
+const uint8_t *MemoryBuffer::const_row(int y) const
+{
+  return data_ + y * linesize_;
+}
+
+int MemoryBuffer::GetLinesize(const olive::PixelFormat &format, int width)
+{
+  int unpadded = PixelService::BytesPerPixel(format) * width;
+
+  return ((unpadded + MemoryPool::kAlignment - 1) / MemoryPool::kAlignment) * MemoryPool::kAlignment;
 }
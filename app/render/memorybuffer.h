@@ -21,28 +21,77 @@
 #ifndef MEMORYBUFFER_H
 #define MEMORYBUFFER_H
 
-#include <QVector>
-
+#include "allocationcounters.h"
 #include "pixelformat.h"
 
+/**
+ * @brief An image buffer in system memory
+ *
+ * The memory comes from olive::memory_pool, so it's aligned to MemoryPool::kAlignment and is NOT zero-initialized.
+ * Each row is padded to a multiple of the alignment too (see linesize()), so SIMD kernels can process every row from
+ * an aligned address.
+ *
+ * Calling Create() again reuses the existing allocation if it's large enough.
+ */
 class MemoryBuffer
 {
 public:
   MemoryBuffer();
 
+  ~MemoryBuffer();
+
+  MemoryBuffer(const MemoryBuffer& other);
+  MemoryBuffer(MemoryBuffer&& other);
+  MemoryBuffer& operator=(const MemoryBuffer& other);
+  MemoryBuffer& operator=(MemoryBuffer&& other);
+
   void Create(int width, int height, const olive::PixelFormat &format);
 
+  /**
+   * @brief Free the buffer's memory (back to the pool)
+   */
+  void Destroy();
+
+  bool IsCreated() const;
+
   const int& width() const;
   const int& height() const;
   const olive::PixelFormat& format() const;
+
+  /**
+   * @brief Bytes per row, including padding
+   */
+  const int& linesize() const;
+
+  /**
+   * @brief Size of the image data in bytes (linesize() * height())
+   */
+  int size() const;
+
   uint8_t* data();
   const uint8_t* const_data() const;
 
+  /**
+   * @brief Returns a pointer to the start of a row
+   */
+  uint8_t* row(int y);
+  const uint8_t* const_row(int y) const;
+
+  /**
+   * @brief Returns the padded linesize for a row of `width` pixels in a certain format
+   */
+  static int GetLinesize(const olive::PixelFormat& format, int width);
+
 private:
-  QVector<uint8_t> data_;
+  uint8_t* data_;
+  int capacity_;
   int width_;
   int height_;
+  int linesize_;
   olive::PixelFormat format_;
+
+  // What the allocation is counted under in AllocationCounters
+  AllocationCounters::Tag tag_;
 };
 
 #endif // MEMORYBUFFER_H
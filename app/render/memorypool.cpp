@@ -0,0 +1,191 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorypool.h"
+
+#include <QMutexLocker>
+
+MemoryPool olive::memory_pool;
+
+// Allocations smaller than this are rounded up to it
+const int kMinimumBlockSize = 4096;
+
+// Default limit of cached blocks
+const qint64 kDefaultMaxCachedBytes = Q_INT64_C(512) * 1024 * 1024;
+
+MemoryPool::MemoryPool() :
+  cached_bytes_(0),
+  max_cached_bytes_(kDefaultMaxCachedBytes),
+  hits_(0),
+  misses_(0)
+{
+}
+
+MemoryPool::~MemoryPool()
+{
+  Clear();
+}
+
+uint8_t *MemoryPool::Allocate(int size, int *capacity)
+{
+  int size_class = GetSizeClass(size);
+
+  *capacity = size_class;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    QMap<int, QVector<uint8_t*> >::iterator blocks = free_blocks_.find(size_class);
+
+    if (blocks != free_blocks_.end() && !blocks->isEmpty()) {
+      uint8_t* block = blocks->takeLast();
+
+      cached_bytes_ -= size_class;
+      hits_++;
+
+      return block;
+    }
+
+    misses_++;
+  }
+
+  // Nothing to reuse, allocate a new block (deliberately not zeroed)
+  return static_cast<uint8_t*>(qMallocAligned(static_cast<size_t>(size_class), kAlignment));
+}
+
+void MemoryPool::Release(uint8_t *block, int capacity)
+{
+  if (block == nullptr) {
+    return;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  if (cached_bytes_ + capacity > max_cached_bytes_) {
+    locker.unlock();
+
+    qFreeAligned(block);
+    return;
+  }
+
+  free_blocks_[capacity].append(block);
+  cached_bytes_ += capacity;
+}
+
+void MemoryPool::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QMap<int, QVector<uint8_t*> >::iterator i;
+
+  for (i=free_blocks_.begin();i!=free_blocks_.end();i++) {
+    for (int j=0;j<i->size();j++) {
+      qFreeAligned(i->at(j));
+    }
+  }
+
+  free_blocks_.clear();
+  cached_bytes_ = 0;
+}
+
+qint64 MemoryPool::cached_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return cached_bytes_;
+}
+
+qint64 MemoryPool::max_cached_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return max_cached_bytes_;
+}
+
+void MemoryPool::set_max_cached_bytes(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  max_cached_bytes_ = bytes;
+
+  TrimInternal();
+}
+
+CacheStatistics MemoryPool::statistics()
+{
+  QMutexLocker locker(&mutex_);
+
+  CacheStatistics s;
+
+  s.used_bytes = cached_bytes_;
+  s.budget = max_cached_bytes_;
+  s.hits = hits_;
+  s.misses = misses_;
+
+  QMap<int, QVector<uint8_t*> >::const_iterator i;
+
+  for (i=free_blocks_.constBegin();i!=free_blocks_.constEnd();i++) {
+    if (i->isEmpty()) {
+      continue;
+    }
+
+    s.entries += i->size();
+    s.consumers.append({QStringLiteral("%1 KiB blocks").arg(i.key() / 1024),
+                        static_cast<qint64>(i.key()) * i->size(),
+                        i->size()});
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+int MemoryPool::GetSizeClass(int size)
+{
+  if (size <= kMinimumBlockSize) {
+    return kMinimumBlockSize;
+  }
+
+  // Round up to a multiple of an eighth of the highest power of two below the size, so a block is never more than
+  // 12.5% larger than requested
+  int step = 1;
+
+  while (step <= size / 16) {
+    step <<= 1;
+  }
+
+  return ((size + step - 1) / step) * step;
+}
+
+void MemoryPool::TrimInternal()
+{
+  // Free the largest blocks first since they're the least likely to fit another allocation
+  while (cached_bytes_ > max_cached_bytes_ && !free_blocks_.isEmpty()) {
+    QMap<int, QVector<uint8_t*> >::iterator largest = free_blocks_.end() - 1;
+
+    if (largest->isEmpty()) {
+      free_blocks_.erase(largest);
+      continue;
+    }
+
+    qFreeAligned(largest->takeLast());
+    cached_bytes_ -= largest.key();
+  }
+}
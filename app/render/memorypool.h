@@ -0,0 +1,131 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#include "common/cachestatistics.h"
+
+/**
+ * @brief A pool of large, aligned memory blocks for frame-sized buffers
+ *
+ * Allocating a frame-sized buffer from the system for every frame is expensive: fresh pages have to be faulted in and
+ * usually zeroed. The MemoryPool keeps released blocks around and hands them out again for later allocations of a
+ * similar size.
+ *
+ * Sizes are rounded up to size classes (at most 12.5% larger than requested) so that buffers of slightly different
+ * sizes share blocks. Every block is aligned to kAlignment bytes for SIMD kernels. Blocks are NOT zero-initialized.
+ *
+ * Use the application-wide olive::memory_pool. All functions are thread-safe.
+ */
+class MemoryPool
+{
+public:
+  /**
+   * @brief Alignment (in bytes) of every block, suitable for any SIMD instruction set and cache lines
+   */
+  static const int kAlignment = 64;
+
+  MemoryPool();
+
+  /**
+   * @brief Destructor, frees all cached blocks
+   */
+  ~MemoryPool();
+
+  MemoryPool(const MemoryPool& other) = delete;
+  MemoryPool(MemoryPool&& other) = delete;
+  MemoryPool& operator=(const MemoryPool& other) = delete;
+  MemoryPool& operator=(MemoryPool&& other) = delete;
+
+  /**
+   * @brief Allocate a block of at least `size` bytes
+   *
+   * @param capacity
+   *
+   * Set to the actual size of the block, which must be passed to Release().
+   *
+   * @return
+   *
+   * A block aligned to kAlignment, or nullptr if the allocation failed.
+   */
+  uint8_t* Allocate(int size, int* capacity);
+
+  /**
+   * @brief Return a block from Allocate() to the pool
+   *
+   * The block is kept for reuse unless the pool already holds max_cached_bytes(), in which case it's freed.
+   */
+  void Release(uint8_t* block, int capacity);
+
+  /**
+   * @brief Free all blocks that aren't in use
+   */
+  void Clear();
+
+  /**
+   * @brief Returns the total size of the blocks waiting to be reused
+   */
+  qint64 cached_bytes();
+
+  qint64 max_cached_bytes();
+
+  /**
+   * @brief Set the maximum size of the blocks waiting to be reused, any over this are freed
+   */
+  void set_max_cached_bytes(qint64 bytes);
+
+  /**
+   * @brief Blocks waiting to be reused by size class, and how many allocations reused one (hits) or didn't (misses)
+   */
+  CacheStatistics statistics();
+
+  /**
+   * @brief Returns the size class `size` is rounded up to
+   */
+  static int GetSizeClass(int size);
+
+private:
+  void TrimInternal();
+
+  QMap<int, QVector<uint8_t*> > free_blocks_;
+
+  qint64 cached_bytes_;
+
+  qint64 max_cached_bytes_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide memory pool for frame buffers
+ */
+extern MemoryPool memory_pool;
+}
+
+#endif // MEMORYPOOL_H
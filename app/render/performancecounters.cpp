@@ -0,0 +1,101 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "performancecounters.h"
+
+#include <QAtomicInteger>
+
+namespace {
+
+QAtomicInteger<qint64> total_stage_nsecs[PerformanceCounters::kStageCount];
+QAtomicInteger<qint64> total_stage_count[PerformanceCounters::kStageCount];
+QAtomicInteger<qint64> total_events[PerformanceCounters::kEventCount];
+
+}
+
+PerformanceCounters::Snapshot::Snapshot()
+{
+  for (int i=0;i<kStageCount;i++) {
+    stage_nsecs[i] = 0;
+    stage_count[i] = 0;
+  }
+
+  for (int i=0;i<kEventCount;i++) {
+    events[i] = 0;
+  }
+}
+
+double PerformanceCounters::Snapshot::AverageMs(PerformanceCounters::Stage stage, const Snapshot &since) const
+{
+  qint64 count = stage_count[stage] - since.stage_count[stage];
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  return static_cast<double>(stage_nsecs[stage] - since.stage_nsecs[stage]) / static_cast<double>(count) / 1000000.0;
+}
+
+qint64 PerformanceCounters::Snapshot::Count(PerformanceCounters::Event event, const Snapshot &since) const
+{
+  return events[event] - since.events[event];
+}
+
+void PerformanceCounters::AddTime(PerformanceCounters::Stage stage, qint64 nsecs, int count)
+{
+  total_stage_nsecs[stage].fetchAndAddRelaxed(nsecs);
+
+  if (count != 0) {
+    total_stage_count[stage].fetchAndAddRelaxed(count);
+  }
+}
+
+void PerformanceCounters::AddEvent(PerformanceCounters::Event event, qint64 count)
+{
+  total_events[event].fetchAndAddRelaxed(count);
+}
+
+PerformanceCounters::Snapshot PerformanceCounters::Take()
+{
+  Snapshot s;
+
+  for (int i=0;i<kStageCount;i++) {
+    s.stage_nsecs[i] = total_stage_nsecs[i].load();
+    s.stage_count[i] = total_stage_count[i].load();
+  }
+
+  for (int i=0;i<kEventCount;i++) {
+    s.events[i] = total_events[i].load();
+  }
+
+  return s;
+}
+
+PerformanceCounters::ScopedTimer::ScopedTimer(PerformanceCounters::Stage stage, int count) :
+  stage_(stage),
+  count_(count)
+{
+  timer_.start();
+}
+
+PerformanceCounters::ScopedTimer::~ScopedTimer()
+{
+  AddTime(stage_, timer_.nsecsElapsed(), count_);
+}
@@ -0,0 +1,120 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PERFORMANCECOUNTERS_H
+#define PERFORMANCECOUNTERS_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+/**
+ * @brief Lightweight application-wide counters of where playback time is spent
+ *
+ * Each pipeline stage adds its own timings and events from whichever thread it runs on. Adding is a single relaxed
+ * atomic add, so stages can be counted unconditionally. Counters only ever increase: consumers (e.g. the viewer's
+ * performance HUD) Take() a Snapshot every so often and compare it to an older one to get figures for that window.
+ */
+class PerformanceCounters
+{
+public:
+  enum Stage {
+    /// Decoding frames of footage (one Decoder::Retrieve)
+    kDecode,
+
+    /// Running a node graph for a frame (one RenderJob)
+    kRender,
+
+    /// Copying pixels into textures
+    kUpload,
+
+    /// Reading rendered pixels back into memory
+    kReadback,
+
+    kStageCount
+  };
+
+  enum Event {
+    /// A frame the viewer asked for was delivered straight from the renderer's frame cache
+    kCacheHit,
+
+    /// A frame the viewer asked for had to be rendered
+    kCacheMiss,
+
+    /// A frame was skipped during playback
+    kDroppedFrame,
+
+    kEventCount
+  };
+
+  struct Snapshot {
+    Snapshot();
+
+    /// Total nanoseconds spent in each stage and how many times each stage ran
+    qint64 stage_nsecs[kStageCount];
+    qint64 stage_count[kStageCount];
+
+    qint64 events[kEventCount];
+
+    /**
+     * @brief Average milliseconds a stage took between an older snapshot and this one (0 if it didn't run)
+     */
+    double AverageMs(Stage stage, const Snapshot& since) const;
+
+    /**
+     * @brief Number of events between an older snapshot and this one
+     */
+    qint64 Count(Event event, const Snapshot& since) const;
+  };
+
+  /**
+   * @brief Add time spent in a stage
+   *
+   * @param count
+   *
+   * How many times the stage ran. Pass 0 to add time to the last run (e.g. a stage measured in several parts).
+   */
+  static void AddTime(Stage stage, qint64 nsecs, int count = 1);
+
+  static void AddEvent(Event event, qint64 count = 1);
+
+  /**
+   * @brief Returns the current value of every counter
+   */
+  static Snapshot Take();
+
+  /**
+   * @brief Adds the time from its construction to its destruction to a stage
+   */
+  class ScopedTimer {
+  public:
+    ScopedTimer(Stage stage, int count = 1);
+
+    ~ScopedTimer();
+
+  private:
+    Stage stage_;
+
+    int count_;
+
+    QElapsedTimer timer_;
+  };
+};
+
+#endif // PERFORMANCECOUNTERS_H
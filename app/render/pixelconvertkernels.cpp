@@ -0,0 +1,540 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "pixelconvertkernels.h"
+
+#include <cstring>
+
+#include "common/clamp.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OLIVE_PIXEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define OLIVE_TARGET(x)
+#else
+#include <cpuid.h>
+#define OLIVE_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_PIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace olive {
+namespace pixel {
+
+/*
+ * Plain C++ kernels, used on CPUs without SIMD support and for the remaining pixels at the end of each row
+ */
+
+void YUVToRGBAScalar(const float* y, const float* u, const float* v, float* rgba, int count, const YUVMatrix& m)
+{
+  for (int i=0;i<count;i++) {
+    float* px = rgba + i*4;
+
+    px[0] = y[i] + m.cr_r * v[i];
+    px[1] = y[i] + m.cb_g * u[i] + m.cr_g * v[i];
+    px[2] = y[i] + m.cb_b * u[i];
+    px[3] = 1.0f;
+  }
+}
+
+void PackRGBA8Scalar(const float* rgba, void* dst, int count)
+{
+  uint8_t* out = static_cast<uint8_t*>(dst);
+
+  for (int i=0;i<count*4;i++) {
+    out[i] = static_cast<uint8_t>(clamp(rgba[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+  }
+}
+
+void PackRGBA16Scalar(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+
+  for (int i=0;i<count*4;i++) {
+    out[i] = static_cast<uint16_t>(clamp(rgba[i], 0.0f, 1.0f) * 65535.0f + 0.5f);
+  }
+}
+
+void PackRGBA16FScalar(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+
+  for (int i=0;i<count*4;i++) {
+    out[i] = FloatToHalf(rgba[i]);
+  }
+}
+
+uint16_t FloatToHalf(float f)
+{
+  uint32_t x;
+  memcpy(&x, &f, sizeof(float));
+
+  uint32_t sign = (x >> 16) & 0x8000u;
+  uint32_t float_exponent = (x >> 23) & 0xFFu;
+  uint32_t mantissa = x & 0x7FFFFFu;
+
+  // Infinity and NaN
+  if (float_exponent == 0xFFu) {
+    return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+  }
+
+  int exponent = static_cast<int>(float_exponent) - 127 + 15;
+
+  // Too large for a half, becomes infinity
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7C00u);
+  }
+
+  // Too small for a normal half, becomes a denormal or zero
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+
+    mantissa |= 0x800000u;
+
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+
+    if ((mantissa >> (shift - 1)) & 1u) {
+      half_mantissa++;
+    }
+
+    return static_cast<uint16_t>(sign | half_mantissa);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+
+  // Round to nearest, a carry into the exponent is still correct
+  if (mantissa & 0x1000u) {
+    half++;
+  }
+
+  return static_cast<uint16_t>(half);
+}
+
+const Kernels kScalarKernels = {
+  "C++",
+  YUVToRGBAScalar,
+  PackRGBA8Scalar,
+  PackRGBA16Scalar,
+  PackRGBA16FScalar
+};
+
+#ifdef OLIVE_PIXEL_X86
+
+/*
+ * SSE4.1 kernels (4 pixels per iteration)
+ */
+
+OLIVE_TARGET("sse4.1")
+void YUVToRGBASSE41(const float* y, const float* u, const float* v, float* rgba, int count, const YUVMatrix& m)
+{
+  const __m128 cr_r = _mm_set1_ps(m.cr_r);
+  const __m128 cb_g = _mm_set1_ps(m.cb_g);
+  const __m128 cr_g = _mm_set1_ps(m.cr_g);
+  const __m128 cb_b = _mm_set1_ps(m.cb_b);
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    __m128 luma = _mm_loadu_ps(y + i);
+    __m128 cb = _mm_loadu_ps(u + i);
+    __m128 cr = _mm_loadu_ps(v + i);
+
+    __m128 r = _mm_add_ps(luma, _mm_mul_ps(cr, cr_r));
+    __m128 g = _mm_add_ps(luma, _mm_add_ps(_mm_mul_ps(cb, cb_g), _mm_mul_ps(cr, cr_g)));
+    __m128 b = _mm_add_ps(luma, _mm_mul_ps(cb, cb_b));
+    __m128 a = one;
+
+    // Planar to interleaved
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+
+    float* px = rgba + i*4;
+    _mm_storeu_ps(px, r);
+    _mm_storeu_ps(px + 4, g);
+    _mm_storeu_ps(px + 8, b);
+    _mm_storeu_ps(px + 12, a);
+  }
+
+  YUVToRGBAScalar(y + i, u + i, v + i, rgba + i*4, count - i, m);
+}
+
+OLIVE_TARGET("sse4.1")
+void PackRGBA8SSE41(const float* rgba, void* dst, int count)
+{
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  const __m128 scale = _mm_set1_ps(255.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    const float* src = rgba + i*4;
+
+    __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src), scale));
+    __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + 4), scale));
+    __m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + 8), scale));
+    __m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + 12), scale));
+
+    // Saturating packs clamp to 0-255
+    __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i*4), bytes);
+  }
+
+  PackRGBA8Scalar(rgba + i*4, out + i*4, count - i);
+}
+
+OLIVE_TARGET("sse4.1")
+void PackRGBA16SSE41(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+  const __m128 scale = _mm_set1_ps(65535.0f);
+
+  int i = 0;
+
+  for (;i+2<=count;i+=2) {
+    const float* src = rgba + i*4;
+
+    __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src), scale));
+    __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + 4), scale));
+
+    // Saturating pack clamps to 0-65535
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i*4), _mm_packus_epi32(a, b));
+  }
+
+  PackRGBA16Scalar(rgba + i*4, out + i*4, count - i);
+}
+
+const Kernels kSSE41Kernels = {
+  "SSE4.1",
+  YUVToRGBASSE41,
+  PackRGBA8SSE41,
+  PackRGBA16SSE41,
+  PackRGBA16FScalar
+};
+
+/*
+ * AVX2 kernels (8 pixels per iteration)
+ */
+
+OLIVE_TARGET("avx2,fma")
+void YUVToRGBAAVX2(const float* y, const float* u, const float* v, float* rgba, int count, const YUVMatrix& m)
+{
+  const __m256 cr_r = _mm256_set1_ps(m.cr_r);
+  const __m256 cb_g = _mm256_set1_ps(m.cb_g);
+  const __m256 cr_g = _mm256_set1_ps(m.cr_g);
+  const __m256 cb_b = _mm256_set1_ps(m.cb_b);
+
+  int i = 0;
+
+  for (;i+8<=count;i+=8) {
+    __m256 luma = _mm256_loadu_ps(y + i);
+    __m256 cb = _mm256_loadu_ps(u + i);
+    __m256 cr = _mm256_loadu_ps(v + i);
+
+    __m256 r = _mm256_fmadd_ps(cr, cr_r, luma);
+    __m256 g = _mm256_fmadd_ps(cb, cb_g, _mm256_fmadd_ps(cr, cr_g, luma));
+    __m256 b = _mm256_fmadd_ps(cb, cb_b, luma);
+
+    // Planar to interleaved, one 128-bit half at a time
+    for (int half=0;half<2;half++) {
+      __m128 hr = (half == 0) ? _mm256_castps256_ps128(r) : _mm256_extractf128_ps(r, 1);
+      __m128 hg = (half == 0) ? _mm256_castps256_ps128(g) : _mm256_extractf128_ps(g, 1);
+      __m128 hb = (half == 0) ? _mm256_castps256_ps128(b) : _mm256_extractf128_ps(b, 1);
+      __m128 ha = _mm_set1_ps(1.0f);
+
+      _MM_TRANSPOSE4_PS(hr, hg, hb, ha);
+
+      float* px = rgba + (i + half*4)*4;
+      _mm_storeu_ps(px, hr);
+      _mm_storeu_ps(px + 4, hg);
+      _mm_storeu_ps(px + 8, hb);
+      _mm_storeu_ps(px + 12, ha);
+    }
+  }
+
+  YUVToRGBAScalar(y + i, u + i, v + i, rgba + i*4, count - i, m);
+}
+
+OLIVE_TARGET("avx2,fma")
+void PackRGBA8AVX2(const float* rgba, void* dst, int count)
+{
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  const __m256 scale = _mm256_set1_ps(255.0f);
+
+  // Packing works within 128-bit lanes, this puts the pixels back in order afterwards
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  int i = 0;
+
+  for (;i+8<=count;i+=8) {
+    const float* src = rgba + i*4;
+
+    __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src), scale));
+    __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 8), scale));
+    __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 16), scale));
+    __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 24), scale));
+
+    __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+
+    bytes = _mm256_permutevar8x32_epi32(bytes, order);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i*4), bytes);
+  }
+
+  PackRGBA8SSE41(rgba + i*4, out + i*4, count - i);
+}
+
+OLIVE_TARGET("avx2,fma")
+void PackRGBA16AVX2(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+  const __m256 scale = _mm256_set1_ps(65535.0f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    const float* src = rgba + i*4;
+
+    __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src), scale));
+    __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + 8), scale));
+
+    // Packing works within 128-bit lanes, swap the middle pixels back into order
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i*4), words);
+  }
+
+  PackRGBA16SSE41(rgba + i*4, out + i*4, count - i);
+}
+
+// Every CPU with AVX2 also supports F16C
+OLIVE_TARGET("avx2,fma,f16c")
+void PackRGBA16FAVX2(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+
+  int i = 0;
+
+  for (;i+2<=count;i+=2) {
+    __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(rgba + i*4), _MM_FROUND_TO_NEAREST_INT);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i*4), halves);
+  }
+
+  PackRGBA16FScalar(rgba + i*4, out + i*4, count - i);
+}
+
+const Kernels kAVX2Kernels = {
+  "AVX2",
+  YUVToRGBAAVX2,
+  PackRGBA8AVX2,
+  PackRGBA16AVX2,
+  PackRGBA16FAVX2
+};
+
+/**
+ * @brief Returns 0 for no SIMD, 1 for SSE4.1 and 2 for AVX2 (with FMA and OS support for YMM registers)
+ */
+int DetectX86Level()
+{
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+#if defined(_MSC_VER)
+  int info[4];
+
+  __cpuid(info, 1);
+  ecx = static_cast<unsigned int>(info[2]);
+#else
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+#endif
+
+  const unsigned int kSSE41 = 1u << 19;
+  const unsigned int kFMA = 1u << 12;
+  const unsigned int kOSXSAVE = 1u << 27;
+  const unsigned int kAVX = 1u << 28;
+  const unsigned int kF16C = 1u << 29;
+  const unsigned int kAVX2 = 1u << 5;
+
+  if (!(ecx & kSSE41)) {
+    return 0;
+  }
+
+  if ((ecx & kFMA) && (ecx & kOSXSAVE) && (ecx & kAVX) && (ecx & kF16C)) {
+
+    // Make sure the OS saves YMM registers
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    unsigned long long xcr0 = xcr0_lo;
+#endif
+
+    if ((xcr0 & 0x6) == 0x6) {
+#if defined(_MSC_VER)
+      __cpuidex(info, 7, 0);
+      ebx = static_cast<unsigned int>(info[1]);
+#else
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+
+      if (ebx & kAVX2) {
+        return 2;
+      }
+    }
+  }
+
+  return 1;
+}
+
+#endif // OLIVE_PIXEL_X86
+
+#ifdef OLIVE_PIXEL_NEON
+
+/*
+ * NEON kernels (4 pixels per iteration)
+ */
+
+void YUVToRGBANEON(const float* y, const float* u, const float* v, float* rgba, int count, const YUVMatrix& m)
+{
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    float32x4_t luma = vld1q_f32(y + i);
+    float32x4_t cb = vld1q_f32(u + i);
+    float32x4_t cr = vld1q_f32(v + i);
+
+    float32x4x4_t px;
+    px.val[0] = vmlaq_n_f32(luma, cr, m.cr_r);
+    px.val[1] = vmlaq_n_f32(vmlaq_n_f32(luma, cb, m.cb_g), cr, m.cr_g);
+    px.val[2] = vmlaq_n_f32(luma, cb, m.cb_b);
+    px.val[3] = vdupq_n_f32(1.0f);
+
+    // Interleaving store
+    vst4q_f32(rgba + i*4, px);
+  }
+
+  YUVToRGBAScalar(y + i, u + i, v + i, rgba + i*4, count - i, m);
+}
+
+void PackRGBA8NEON(const float* rgba, void* dst, int count)
+{
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  const float32x4_t scale = vdupq_n_f32(255.0f);
+  const float32x4_t round = vdupq_n_f32(0.5f);
+
+  int i = 0;
+
+  for (;i+4<=count;i+=4) {
+    const float* src = rgba + i*4;
+
+    // Float to unsigned conversion saturates negative values to 0, the narrowing moves saturate the top
+    uint32x4_t a = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src), scale));
+    uint32x4_t b = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src + 4), scale));
+    uint32x4_t c = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src + 8), scale));
+    uint32x4_t d = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src + 12), scale));
+
+    uint16x8_t ab = vcombine_u16(vqmovn_u32(a), vqmovn_u32(b));
+    uint16x8_t cd = vcombine_u16(vqmovn_u32(c), vqmovn_u32(d));
+
+    vst1q_u8(out + i*4, vcombine_u8(vqmovn_u16(ab), vqmovn_u16(cd)));
+  }
+
+  PackRGBA8Scalar(rgba + i*4, out + i*4, count - i);
+}
+
+void PackRGBA16NEON(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+  const float32x4_t scale = vdupq_n_f32(65535.0f);
+  const float32x4_t round = vdupq_n_f32(0.5f);
+
+  int i = 0;
+
+  for (;i+2<=count;i+=2) {
+    const float* src = rgba + i*4;
+
+    uint32x4_t a = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src), scale));
+    uint32x4_t b = vcvtq_u32_f32(vmlaq_f32(round, vld1q_f32(src + 4), scale));
+
+    vst1q_u16(out + i*4, vcombine_u16(vqmovn_u32(a), vqmovn_u32(b)));
+  }
+
+  PackRGBA16Scalar(rgba + i*4, out + i*4, count - i);
+}
+
+#if defined(__aarch64__)
+void PackRGBA16FNEON(const float* rgba, void* dst, int count)
+{
+  uint16_t* out = static_cast<uint16_t*>(dst);
+
+  for (int i=0;i<count;i++) {
+    vst1_u16(out + i*4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(rgba + i*4))));
+  }
+}
+#endif
+
+const Kernels kNEONKernels = {
+  "NEON",
+  YUVToRGBANEON,
+  PackRGBA8NEON,
+  PackRGBA16NEON,
+#if defined(__aarch64__)
+  PackRGBA16FNEON
+#else
+  PackRGBA16FScalar
+#endif
+};
+
+#endif // OLIVE_PIXEL_NEON
+
+const Kernels& GetKernels()
+{
+#if defined(OLIVE_PIXEL_X86)
+  static const int level = DetectX86Level();
+
+  if (level == 2) {
+    return kAVX2Kernels;
+  } else if (level == 1) {
+    return kSSE41Kernels;
+  }
+#elif defined(OLIVE_PIXEL_NEON)
+  return kNEONKernels;
+#endif
+
+  return kScalarKernels;
+}
+
+const Kernels& GetScalarKernels()
+{
+  return kScalarKernels;
+}
+
+}
+}
@@ -0,0 +1,104 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PIXELCONVERTKERNELS_H
+#define PIXELCONVERTKERNELS_H
+
+#include <stdint.h>
+
+namespace olive {
+namespace pixel {
+
+/**
+ * @brief Coefficients for converting normalized Y'CbCr (Y' 0.0-1.0, Cb/Cr -0.5-0.5) to R'G'B'
+ *
+ * R' = Y' + cr_r * Cr
+ * G' = Y' + cb_g * Cb + cr_g * Cr
+ * B' = Y' + cb_b * Cb
+ */
+struct YUVMatrix {
+  float cr_r;
+  float cb_g;
+  float cr_g;
+  float cb_b;
+};
+
+/**
+ * @brief Normalization of integer Y'CbCr samples
+ *
+ * Y' = (Y - y_offset) * y_scale
+ * Cb/Cr = (C - c_offset) * c_scale
+ */
+struct YUVRange {
+  float y_offset;
+  float y_scale;
+  float c_offset;
+  float c_scale;
+};
+
+/**
+ * @brief Convert a row of planar Y'CbCr floats to interleaved RGBA floats (alpha is always 1.0)
+ */
+using YUVToRGBAFunction = void(*)(const float* y, const float* u, const float* v, float* rgba, int count,
+                                  const YUVMatrix& m);
+
+/**
+ * @brief Convert a row of interleaved RGBA floats to another RGBA format
+ *
+ * Integer formats are clamped to 0.0-1.0, float formats are not clamped.
+ */
+using PackFunction = void(*)(const float* rgba, void* dst, int count);
+
+/**
+ * @brief Set of conversion kernels for a certain instruction set
+ */
+struct Kernels {
+  const char* name;
+
+  YUVToRGBAFunction yuv_to_rgba;
+
+  PackFunction pack_rgba8;
+  PackFunction pack_rgba16;
+  PackFunction pack_rgba16f;
+};
+
+/**
+ * @brief Returns the fastest set of kernels the CPU supports
+ *
+ * Every build contains plain C++ kernels. x86 builds additionally contain SSE4.1 and AVX2 kernels (compiled with
+ * function-level target attributes, so no special compiler flags are needed) and the CPU is checked at runtime. ARM
+ * builds with NEON use NEON kernels.
+ */
+const Kernels& GetKernels();
+
+/**
+ * @brief Returns the plain C++ kernels regardless of CPU support (mostly useful for verifying the SIMD kernels)
+ */
+const Kernels& GetScalarKernels();
+
+/**
+ * @brief Convert a 32-bit float to a 16-bit half float (round to nearest)
+ */
+uint16_t FloatToHalf(float f);
+
+}
+}
+
+#endif // PIXELCONVERTKERNELS_H
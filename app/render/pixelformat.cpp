@@ -36,28 +36,55 @@ PixelFormatInfo PixelService::GetPixelFormatInfo(const olive::PixelFormat &forma
   case olive::PIX_FMT_RGBA8:
     info.name = tr("8-bit");
     info.internal_format = GL_RGBA8;
+    info.pixel_format = GL_RGBA;
     info.pixel_type = GL_UNSIGNED_BYTE;
     break;
   case olive::PIX_FMT_RGBA16:
     info.name = tr("16-bit Integer");
     info.internal_format = GL_RGBA16;
+    info.pixel_format = GL_RGBA;
     info.pixel_type = GL_UNSIGNED_SHORT;
     break;
   case olive::PIX_FMT_RGBA16F:
     info.name = tr("Half-Float (16-bit)");
     info.internal_format = GL_RGBA16F;
+    info.pixel_format = GL_RGBA;
     info.pixel_type = GL_HALF_FLOAT;
     break;
   case olive::PIX_FMT_RGBA32F:
     info.name = tr("Full-Float (32-bit)");
     info.internal_format = GL_RGBA32F;
+    info.pixel_format = GL_RGBA;
     info.pixel_type = GL_FLOAT;
     break;
+  case olive::PIX_FMT_RGB10A2:
+    info.name = tr("10-bit Packed");
+    info.internal_format = GL_RGB10_A2;
+    info.pixel_format = GL_RGBA;
+    info.pixel_type = GL_UNSIGNED_INT_2_10_10_10_REV;
+    break;
+  case olive::PIX_FMT_RG11B10F:
+    info.name = tr("Packed Float (11/11/10-bit)");
+    info.internal_format = GL_R11F_G11F_B10F;
+    info.pixel_format = GL_RGB;
+    info.pixel_type = GL_UNSIGNED_INT_10F_11F_11F_REV;
+    break;
+  case olive::PIX_FMT_R8:
+    info.name = tr("8-bit Single Channel");
+    info.internal_format = GL_R8;
+    info.pixel_format = GL_RED;
+    info.pixel_type = GL_UNSIGNED_BYTE;
+    break;
+  case olive::PIX_FMT_R16F:
+    info.name = tr("Half-Float Single Channel");
+    info.internal_format = GL_R16F;
+    info.pixel_format = GL_RED;
+    info.pixel_type = GL_HALF_FLOAT;
+    break;
   default:
     qFatal("Invalid pixel format requested");
   }
 
-  info.pixel_format = GL_RGBA;
   info.bytes_per_pixel = BytesPerPixel(format);
 
   return info;
@@ -78,7 +105,81 @@ int PixelService::BytesPerPixel(const olive::PixelFormat &format)
     return 2 * kRGBAChannels;
   case olive::PIX_FMT_RGBA32F:
     return 4 * kRGBAChannels;
+  case olive::PIX_FMT_RGB10A2:
+  case olive::PIX_FMT_RG11B10F:
+    return 4;
+  case olive::PIX_FMT_R8:
+    return 1;
+  case olive::PIX_FMT_R16F:
+    return 2;
   default:
     qFatal("Invalid pixel format requested");
   }
 }
+
+int PixelService::ChannelCount(const olive::PixelFormat &format)
+{
+  switch (format) {
+  case olive::PIX_FMT_R8:
+  case olive::PIX_FMT_R16F:
+    return 1;
+  case olive::PIX_FMT_RG11B10F:
+    return 3;
+  default:
+    return kRGBAChannels;
+  }
+}
+
+olive::PixelPrecision PixelService::GetFormatPrecision(const olive::PixelFormat &format)
+{
+  switch (format) {
+  case olive::PIX_FMT_RGBA8:
+  case olive::PIX_FMT_R8:
+    return olive::PIXEL_PRECISION_8BIT;
+  case olive::PIX_FMT_RGBA16:
+  case olive::PIX_FMT_RGB10A2:
+    return olive::PIXEL_PRECISION_10BIT;
+  case olive::PIX_FMT_RG11B10F:
+    return olive::PIXEL_PRECISION_HDR;
+  case olive::PIX_FMT_RGBA16F:
+  case olive::PIX_FMT_R16F:
+    return olive::PIXEL_PRECISION_HALF;
+  default:
+    return olive::PIXEL_PRECISION_FULL;
+  }
+}
+
+olive::PixelFormat PixelService::GetCheapestFormat(const olive::PixelPrecision &precision,
+                                                   const olive::PixelChannels &channels)
+{
+  switch (precision) {
+  case olive::PIXEL_PRECISION_8BIT:
+    return (channels == olive::PIXEL_CHANNELS_R) ? olive::PIX_FMT_R8 : olive::PIX_FMT_RGBA8;
+  case olive::PIXEL_PRECISION_10BIT:
+    if (channels == olive::PIXEL_CHANNELS_R) {
+      return olive::PIX_FMT_R16F;
+    }
+
+    // RGB10A2's 2-bit alpha is only good enough if there's no alpha
+    return (channels == olive::PIXEL_CHANNELS_RGB) ? olive::PIX_FMT_RGB10A2 : olive::PIX_FMT_RGBA16;
+  case olive::PIXEL_PRECISION_HDR:
+    if (channels == olive::PIXEL_CHANNELS_R) {
+      return olive::PIX_FMT_R16F;
+    }
+
+    return (channels == olive::PIXEL_CHANNELS_RGB) ? olive::PIX_FMT_RG11B10F : olive::PIX_FMT_RGBA16F;
+  case olive::PIXEL_PRECISION_HALF:
+    return (channels == olive::PIXEL_CHANNELS_R) ? olive::PIX_FMT_R16F : olive::PIX_FMT_RGBA16F;
+  case olive::PIXEL_PRECISION_FULL:
+    break;
+  }
+
+  return olive::PIX_FMT_RGBA32F;
+}
+
+olive::PixelFormat PixelService::NegotiateFormat(const olive::PixelPrecision &precision,
+                                                 const olive::PixelChannels &channels,
+                                                 const olive::PixelFormat &ceiling)
+{
+  return GetCheapestFormat(qMin(precision, GetFormatPrecision(ceiling)), channels);
+}
@@ -47,15 +47,65 @@ namespace olive {
 
 /**
  * @brief Olive's internal supported pixel formats.
+ *
+ * The RGBA formats are used for footage and final output. The packed and single channel formats are only useful for
+ * intermediate buffers that don't need the full precision or all channels (see PixelService::NegotiateFormat()).
  */
 enum PixelFormat {
   PIX_FMT_RGBA8,
   PIX_FMT_RGBA16,
   PIX_FMT_RGBA16F,
   PIX_FMT_RGBA32F,
+
+  /// 10-bit RGB with 2-bit alpha packed into 32 bits
+  PIX_FMT_RGB10A2,
+
+  /// Unsigned 11/11/10-bit float RGB packed into 32 bits, no alpha
+  PIX_FMT_RG11B10F,
+
+  /// Single channel 8-bit, for mattes
+  PIX_FMT_R8,
+
+  /// Single channel half-float, for mattes
+  PIX_FMT_R16F,
+
   PIX_FMT_COUNT
 };
 
+/**
+ * @brief Minimum precision a buffer needs, from cheapest to most expensive
+ */
+enum PixelPrecision {
+  /// 8-bit values from 0.0 to 1.0
+  PIXEL_PRECISION_8BIT,
+
+  /// 10-bit values from 0.0 to 1.0 (avoids banding in gradients)
+  PIXEL_PRECISION_10BIT,
+
+  /// Positive values over 1.0 at low precision (e.g. light or blur passes)
+  PIXEL_PRECISION_HDR,
+
+  /// Half-float
+  PIXEL_PRECISION_HALF,
+
+  /// Full float
+  PIXEL_PRECISION_FULL
+};
+
+/**
+ * @brief Channels a buffer needs
+ */
+enum PixelChannels {
+  /// One channel (e.g. a matte)
+  PIXEL_CHANNELS_R,
+
+  /// Color with no alpha (alpha is always 1.0)
+  PIXEL_CHANNELS_RGB,
+
+  /// Color and alpha
+  PIXEL_CHANNELS_RGBA
+};
+
 }
 
 class PixelService : public QObject {
@@ -91,11 +141,38 @@ public:
    * @brief Returns the number of bytes per pixel for a certain format
    *
    * Different formats use different sizes of data for pixels. Use this function to determine how many bytes a pixel
-   * requires for a certain format. The number of bytes will always be a multiple of 4 since all formats use RGBA and
-   * are at least 1 bpc.
+   * requires for a certain format. The number of bytes will always be a multiple of 4 for RGBA and packed formats, but
+   * single channel formats may be 1 or 2 bytes.
    */
   static int BytesPerPixel(const olive::PixelFormat& format);
 
+  /**
+   * @brief Returns the number of channels stored in a certain format (1, 3 or 4)
+   */
+  static int ChannelCount(const olive::PixelFormat& format);
+
+  /**
+   * @brief Returns the highest precision a certain format can store
+   */
+  static olive::PixelPrecision GetFormatPrecision(const olive::PixelFormat& format);
+
+  /**
+   * @brief Returns the format that uses the least memory while meeting a certain precision and channels
+   */
+  static olive::PixelFormat GetCheapestFormat(const olive::PixelPrecision& precision,
+                                              const olive::PixelChannels& channels);
+
+  /**
+   * @brief Negotiate the format of an intermediate buffer
+   *
+   * Returns the cheapest format meeting a Node's required precision and channels, without exceeding the precision of
+   * `ceiling` (usually the format the renderer was set to), since there's no point in intermediates being more
+   * precise than the final result.
+   */
+  static olive::PixelFormat NegotiateFormat(const olive::PixelPrecision& precision,
+                                            const olive::PixelChannels& channels,
+                                            const olive::PixelFormat& ceiling);
+
 private:
 };
 
@@ -0,0 +1,433 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "pixelformatconverter.h"
+
+#include <functional>
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+
+PixelFormatConverter olive::pix_fmt_conv;
+
+// Frames are never split into stripes of fewer rows than this, smaller stripes aren't worth the threading overhead
+const int kMinimumStripeHeight = 32;
+
+/**
+ * @brief Runs one stripe of a conversion on the PixelFormatConverter thread pool
+ */
+class ConvertStripeRunnable : public QRunnable
+{
+public:
+  ConvertStripeRunnable(std::function<void()> func, QSemaphore* done) :
+    func_(func),
+    done_(done)
+  {
+  }
+
+  virtual void run() override
+  {
+    func_();
+    done_->release();
+  }
+
+private:
+  std::function<void()> func_;
+
+  QSemaphore* done_;
+};
+
+PixelFormatConverter::PixelFormatConverter() :
+  sws_ctx_(nullptr)
+{
+  // The calling thread converts a stripe too
+  pool_.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+PixelFormatConverter::~PixelFormatConverter()
+{
+  pool_.waitForDone();
+
+  sws_freeContext(sws_ctx_);
+}
+
+bool PixelFormatConverter::Convert(Frame *frame, const olive::PixelFormat &format, void *dst, int dst_linesize)
+{
+  if (frame == nullptr || dst == nullptr) {
+    return false;
+  }
+
+  // Only the RGBA formats are supported
+  if (format != olive::PIX_FMT_RGBA8 && format != olive::PIX_FMT_RGBA16
+      && format != olive::PIX_FMT_RGBA16F && format != olive::PIX_FMT_RGBA32F) {
+    return false;
+  }
+
+  int width = frame->width();
+  int height = frame->height();
+
+  if (dst_linesize == 0) {
+    dst_linesize = PixelService::BytesPerPixel(format) * width;
+  }
+
+  AVPixelFormat src_format = static_cast<AVPixelFormat>(frame->format());
+
+  if (!HasFastPath(src_format)) {
+    return ConvertWithSwscale(frame, format, static_cast<uint8_t*>(dst), dst_linesize);
+  }
+
+  Job job;
+  job.src_format = src_format;
+  job.src_data = frame->data();
+  job.src_linesize = frame->linesize();
+  job.width = width;
+  job.height = height;
+  job.dst_format = format;
+  job.dst = static_cast<uint8_t*>(dst);
+  job.dst_linesize = dst_linesize;
+  job.matrix = GetYUVMatrix(frame->colorspace(), height);
+  job.range = GetYUVRange(GetBitDepth(src_format), IsFullRange(frame));
+  job.kernels = &olive::pixel::GetKernels();
+
+  // Split the frame into stripes of rows, chroma subsampled formats need stripes to start on even rows
+  int stripe_count = qBound(1, height / kMinimumStripeHeight, pool_.maxThreadCount() + 1);
+  int stripe_height = ((height / stripe_count) + 1) & ~1;
+
+  QSemaphore done;
+  int queued = 0;
+
+  for (int i=1;i<stripe_count;i++) {
+    int start = i * stripe_height;
+    int end = qMin(height, start + stripe_height);
+
+    if (start >= end) {
+      break;
+    }
+
+    pool_.start(new ConvertStripeRunnable([job, start, end]() {
+      ConvertRows(job, start, end);
+    }, &done));
+
+    queued++;
+  }
+
+  ConvertRows(job, 0, qMin(height, stripe_height));
+
+  done.acquire(queued);
+
+  return true;
+}
+
+bool PixelFormatConverter::HasFastPath(int av_pix_fmt)
+{
+  switch (av_pix_fmt) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+  case AV_PIX_FMT_YUV422P10LE:
+  case AV_PIX_FMT_NV12:
+  case AV_PIX_FMT_P010LE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+olive::pixel::YUVMatrix PixelFormatConverter::GetYUVMatrix(AVColorSpace colorspace, int height)
+{
+  // Luma coefficients of the red and blue primaries
+  float kr;
+  float kb;
+
+  switch (colorspace) {
+  case AVCOL_SPC_BT709:
+    kr = 0.2126f;
+    kb = 0.0722f;
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+  case AVCOL_SPC_BT2020_CL:
+    kr = 0.2627f;
+    kb = 0.0593f;
+    break;
+  case AVCOL_SPC_BT470BG:
+  case AVCOL_SPC_SMPTE170M:
+    kr = 0.299f;
+    kb = 0.114f;
+    break;
+  default:
+    // Guess based on the resolution like most players do
+    if (height >= 720) {
+      kr = 0.2126f;
+      kb = 0.0722f;
+    } else {
+      kr = 0.299f;
+      kb = 0.114f;
+    }
+  }
+
+  float kg = 1.0f - kr - kb;
+
+  olive::pixel::YUVMatrix m;
+  m.cr_r = 2.0f * (1.0f - kr);
+  m.cb_g = -2.0f * kb * (1.0f - kb) / kg;
+  m.cr_g = -2.0f * kr * (1.0f - kr) / kg;
+  m.cb_b = 2.0f * (1.0f - kb);
+
+  return m;
+}
+
+olive::pixel::YUVRange PixelFormatConverter::GetYUVRange(int bit_depth, bool full_range)
+{
+  float depth_scale = static_cast<float>(1 << (bit_depth - 8));
+  float max_value = static_cast<float>((1 << bit_depth) - 1);
+
+  olive::pixel::YUVRange range;
+
+  if (full_range) {
+    range.y_offset = 0.0f;
+    range.y_scale = 1.0f / max_value;
+    range.c_offset = 128.0f * depth_scale;
+    range.c_scale = 1.0f / max_value;
+  } else {
+    range.y_offset = 16.0f * depth_scale;
+    range.y_scale = 1.0f / (219.0f * depth_scale);
+    range.c_offset = 128.0f * depth_scale;
+    range.c_scale = 1.0f / (224.0f * depth_scale);
+  }
+
+  return range;
+}
+
+int PixelFormatConverter::GetBitDepth(int av_pix_fmt)
+{
+  switch (av_pix_fmt) {
+  case AV_PIX_FMT_YUV422P10LE:
+  case AV_PIX_FMT_P010LE:
+    return 10;
+  default:
+    return 8;
+  }
+}
+
+bool PixelFormatConverter::IsFullRange(Frame *frame)
+{
+  return (frame->color_range() == AVCOL_RANGE_JPEG || frame->format() == AV_PIX_FMT_YUVJ420P);
+}
+
+const char *PixelFormatConverter::kernel_name()
+{
+  return olive::pixel::GetKernels().name;
+}
+
+void PixelFormatConverter::ConvertRows(const PixelFormatConverter::Job &job, int start_row, int end_row)
+{
+  int width = job.width;
+
+  // Planar float Y'CbCr, and interleaved float RGBA for the integer/half output formats
+  QVector<float> scratch(width * 7);
+  float* y = scratch.data();
+  float* u = y + width;
+  float* v = u + width;
+  float* rgba = v + width;
+
+  for (int row=start_row;row<end_row;row++) {
+    int chroma_row = (job.src_format == AV_PIX_FMT_YUV422P10LE) ? row : row / 2;
+
+    // Unpack this row to normalized planar floats, chroma is upsampled horizontally by repetition
+    switch (job.src_format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+    {
+      const uint8_t* src_y = job.src_data[0] + row * job.src_linesize[0];
+      const uint8_t* src_u = job.src_data[1] + chroma_row * job.src_linesize[1];
+      const uint8_t* src_v = job.src_data[2] + chroma_row * job.src_linesize[2];
+
+      for (int x=0;x<width;x++) {
+        y[x] = (static_cast<float>(src_y[x]) - job.range.y_offset) * job.range.y_scale;
+        u[x] = (static_cast<float>(src_u[x >> 1]) - job.range.c_offset) * job.range.c_scale;
+        v[x] = (static_cast<float>(src_v[x >> 1]) - job.range.c_offset) * job.range.c_scale;
+      }
+      break;
+    }
+    case AV_PIX_FMT_YUV422P10LE:
+    {
+      const uint16_t* src_y = reinterpret_cast<const uint16_t*>(job.src_data[0] + row * job.src_linesize[0]);
+      const uint16_t* src_u = reinterpret_cast<const uint16_t*>(job.src_data[1] + chroma_row * job.src_linesize[1]);
+      const uint16_t* src_v = reinterpret_cast<const uint16_t*>(job.src_data[2] + chroma_row * job.src_linesize[2]);
+
+      for (int x=0;x<width;x++) {
+        y[x] = (static_cast<float>(src_y[x]) - job.range.y_offset) * job.range.y_scale;
+        u[x] = (static_cast<float>(src_u[x >> 1]) - job.range.c_offset) * job.range.c_scale;
+        v[x] = (static_cast<float>(src_v[x >> 1]) - job.range.c_offset) * job.range.c_scale;
+      }
+      break;
+    }
+    case AV_PIX_FMT_NV12:
+    {
+      const uint8_t* src_y = job.src_data[0] + row * job.src_linesize[0];
+      const uint8_t* src_uv = job.src_data[1] + chroma_row * job.src_linesize[1];
+
+      for (int x=0;x<width;x++) {
+        int c = (x >> 1) * 2;
+
+        y[x] = (static_cast<float>(src_y[x]) - job.range.y_offset) * job.range.y_scale;
+        u[x] = (static_cast<float>(src_uv[c]) - job.range.c_offset) * job.range.c_scale;
+        v[x] = (static_cast<float>(src_uv[c + 1]) - job.range.c_offset) * job.range.c_scale;
+      }
+      break;
+    }
+    case AV_PIX_FMT_P010LE:
+    {
+      // P010 stores 10-bit samples in the high bits of each 16-bit word
+      const uint16_t* src_y = reinterpret_cast<const uint16_t*>(job.src_data[0] + row * job.src_linesize[0]);
+      const uint16_t* src_uv = reinterpret_cast<const uint16_t*>(job.src_data[1] + chroma_row * job.src_linesize[1]);
+
+      for (int x=0;x<width;x++) {
+        int c = (x >> 1) * 2;
+
+        y[x] = (static_cast<float>(src_y[x] >> 6) - job.range.y_offset) * job.range.y_scale;
+        u[x] = (static_cast<float>(src_uv[c] >> 6) - job.range.c_offset) * job.range.c_scale;
+        v[x] = (static_cast<float>(src_uv[c + 1] >> 6) - job.range.c_offset) * job.range.c_scale;
+      }
+      break;
+    }
+    default:
+      return;
+    }
+
+    uint8_t* dst_row = job.dst + row * job.dst_linesize;
+
+    // Full float output is written directly, everything else is packed from the float row
+    if (job.dst_format == olive::PIX_FMT_RGBA32F) {
+      job.kernels->yuv_to_rgba(y, u, v, reinterpret_cast<float*>(dst_row), width, job.matrix);
+      continue;
+    }
+
+    job.kernels->yuv_to_rgba(y, u, v, rgba, width, job.matrix);
+
+    switch (job.dst_format) {
+    case olive::PIX_FMT_RGBA8:
+      job.kernels->pack_rgba8(rgba, dst_row, width);
+      break;
+    case olive::PIX_FMT_RGBA16:
+      job.kernels->pack_rgba16(rgba, dst_row, width);
+      break;
+    case olive::PIX_FMT_RGBA16F:
+      job.kernels->pack_rgba16f(rgba, dst_row, width);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+bool PixelFormatConverter::ConvertWithSwscale(Frame *frame, const olive::PixelFormat &format, uint8_t *dst,
+                                              int dst_linesize)
+{
+  int width = frame->width();
+  int height = frame->height();
+
+  bool integer_format = (format == olive::PIX_FMT_RGBA8 || format == olive::PIX_FMT_RGBA16);
+
+  // Float formats are converted through a 16-bit intermediate
+  AVPixelFormat sws_format = (format == olive::PIX_FMT_RGBA8) ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGBA64;
+
+  QMutexLocker locker(&sws_mutex_);
+
+  sws_ctx_ = sws_getCachedContext(sws_ctx_,
+                                  width,
+                                  height,
+                                  static_cast<AVPixelFormat>(frame->format()),
+                                  width,
+                                  height,
+                                  sws_format,
+                                  SWS_POINT,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr);
+
+  if (sws_ctx_ == nullptr) {
+    return false;
+  }
+
+  // Use the frame's own matrix and range (this fails harmlessly for RGB sources)
+  int sws_colorspace;
+
+  switch (frame->colorspace()) {
+  case AVCOL_SPC_BT709:
+    sws_colorspace = SWS_CS_ITU709;
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+  case AVCOL_SPC_BT2020_CL:
+    sws_colorspace = SWS_CS_BT2020;
+    break;
+  case AVCOL_SPC_BT470BG:
+  case AVCOL_SPC_SMPTE170M:
+    sws_colorspace = SWS_CS_ITU601;
+    break;
+  default:
+    sws_colorspace = (height >= 720) ? SWS_CS_ITU709 : SWS_CS_ITU601;
+  }
+
+  const int* coefficients = sws_getCoefficients(sws_colorspace);
+
+  sws_setColorspaceDetails(sws_ctx_,
+                           coefficients,
+                           IsFullRange(frame) ? 1 : 0,
+                           coefficients,
+                           1,
+                           0,
+                           1 << 16,
+                           1 << 16);
+
+  if (integer_format) {
+    sws_scale(sws_ctx_, frame->data(), frame->linesize(), 0, height, &dst, &dst_linesize);
+
+    return true;
+  }
+
+  sws_buffer_.resize(width * height * 4);
+
+  uint8_t* intermediate = reinterpret_cast<uint8_t*>(sws_buffer_.data());
+  int intermediate_linesize = width * 4 * static_cast<int>(sizeof(uint16_t));
+
+  sws_scale(sws_ctx_, frame->data(), frame->linesize(), 0, height, &intermediate, &intermediate_linesize);
+
+  QVector<float> row_buffer(width * 4);
+  const olive::pixel::Kernels& kernels = olive::pixel::GetKernels();
+
+  for (int row=0;row<height;row++) {
+    const uint16_t* src = sws_buffer_.constData() + row * width * 4;
+    uint8_t* dst_row = dst + row * dst_linesize;
+
+    float* float_row = (format == olive::PIX_FMT_RGBA32F) ? reinterpret_cast<float*>(dst_row) : row_buffer.data();
+
+    for (int i=0;i<width*4;i++) {
+      float_row[i] = static_cast<float>(src[i]) / 65535.0f;
+    }
+
+    if (format == olive::PIX_FMT_RGBA16F) {
+      kernels.pack_rgba16f(float_row, dst_row, width);
+    }
+  }
+
+  return true;
+}
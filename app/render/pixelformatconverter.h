@@ -0,0 +1,172 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PIXELFORMATCONVERTER_H
+#define PIXELFORMATCONVERTER_H
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+
+#include "decoder/frame.h"
+#include "render/pixelconvertkernels.h"
+#include "render/pixelformat.h"
+
+/**
+ * @brief Converts decoded Frames into Olive's internal RGBA pixel formats
+ *
+ * Decoders output frames in whatever format the codec uses (see Decoder). This class converts them to one of the RGBA
+ * formats in olive::PixelFormat, ready to be uploaded to the GPU or processed further.
+ *
+ * The most common decoder layouts (see HasFastPath()) are converted with SIMD kernels (see olive::pixel::GetKernels()),
+ * split across a thread pool in stripes of rows. Any other format falls back to swscale.
+ *
+ * Use the application-wide olive::pix_fmt_conv. All functions are thread-safe.
+ */
+class PixelFormatConverter
+{
+public:
+  PixelFormatConverter();
+
+  ~PixelFormatConverter();
+
+  PixelFormatConverter(const PixelFormatConverter& other) = delete;
+  PixelFormatConverter(PixelFormatConverter&& other) = delete;
+  PixelFormatConverter& operator=(const PixelFormatConverter& other) = delete;
+  PixelFormatConverter& operator=(PixelFormatConverter&& other) = delete;
+
+  /**
+   * @brief Convert a video Frame to an RGBA buffer
+   *
+   * @param frame
+   *
+   * A video Frame in system memory (as returned by Decoder::Retrieve()).
+   *
+   * @param format
+   *
+   * The format to convert to, must be one of the RGBA formats.
+   *
+   * @param dst
+   *
+   * Destination buffer, must be at least `dst_linesize * frame->height()` bytes.
+   *
+   * @param dst_linesize
+   *
+   * Bytes per row in `dst`. 0 means the rows are tightly packed (see PixelService::GetBufferSize()).
+   *
+   * @return
+   *
+   * TRUE if the frame was converted, FALSE if its format is not supported.
+   */
+  bool Convert(Frame* frame, const olive::PixelFormat& format, void* dst, int dst_linesize = 0);
+
+  /**
+   * @brief Returns TRUE if frames in this AVPixelFormat are converted by the SIMD kernels rather than swscale
+   */
+  static bool HasFastPath(int av_pix_fmt);
+
+  /**
+   * @brief Returns the coefficients to convert Y'CbCr in this colorspace to R'G'B'
+   *
+   * Supports BT.601, BT.709 and BT.2020. If the colorspace is unspecified, BT.709 is assumed for HD frames (height of
+   * 720 or more) and BT.601 otherwise.
+   */
+  static olive::pixel::YUVMatrix GetYUVMatrix(AVColorSpace colorspace, int height);
+
+  /**
+   * @brief Returns the normalization for samples of this bit depth in full (JPEG) or limited (MPEG) range
+   */
+  static olive::pixel::YUVRange GetYUVRange(int bit_depth, bool full_range);
+
+  /**
+   * @brief Returns the number of significant bits per sample of a fast path AVPixelFormat
+   */
+  static int GetBitDepth(int av_pix_fmt);
+
+  /**
+   * @brief Returns TRUE if this Frame's samples use the full range rather than the limited "studio" range
+   */
+  static bool IsFullRange(Frame* frame);
+
+  /**
+   * @brief Name of the instruction set the SIMD kernels are using (for debugging/benchmarking)
+   */
+  const char* kernel_name();
+
+private:
+  /**
+   * @brief Everything needed to convert part of a frame with the SIMD kernels
+   */
+  struct Job {
+    AVPixelFormat src_format;
+    uint8_t** src_data;
+    int* src_linesize;
+    int width;
+    int height;
+    olive::PixelFormat dst_format;
+    uint8_t* dst;
+    int dst_linesize;
+
+    olive::pixel::YUVRange range;
+
+    olive::pixel::YUVMatrix matrix;
+    const olive::pixel::Kernels* kernels;
+  };
+
+  /**
+   * @brief Convert rows [start_row, end_row) of a Job
+   */
+  static void ConvertRows(const Job& job, int start_row, int end_row);
+
+  /**
+   * @brief Conversion path for formats without a fast path
+   */
+  bool ConvertWithSwscale(Frame* frame, const olive::PixelFormat& format, uint8_t* dst, int dst_linesize);
+
+  /**
+   * @brief Threads to convert stripes on (the calling thread also converts one stripe)
+   */
+  QThreadPool pool_;
+
+  /**
+   * @brief Protects sws_ctx_ and sws_buffer_
+   */
+  QMutex sws_mutex_;
+
+  SwsContext* sws_ctx_;
+
+  /**
+   * @brief 16-bit intermediate for converting to float formats with swscale
+   */
+  QVector<uint16_t> sws_buffer_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide pixel format converter
+ */
+extern PixelFormatConverter pix_fmt_conv;
+}
+
+#endif // PIXELFORMATCONVERTER_H
@@ -0,0 +1,674 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "playbackengine.h"
+
+#include <QDebug>
+#include <QMutex>
+#include <cmath>
+
+#include "common/clamp.h"
+#include "common/tickrescaler.h"
+#include "render/performancecounters.h"
+
+PlaybackEngine::PlaybackEngine(QObject *parent) :
+  QObject(parent),
+  timebase_(1001, 30000),
+  policy_(kDropLateFrames),
+  lookahead_(kDefaultLookahead),
+  renderer_(nullptr),
+  output_(nullptr),
+  audio_(nullptr),
+  playing_(false),
+  speed_(1),
+  speed_origin_(0),
+  frame_(0),
+  clock_frame_(0),
+  clock_start_ns_(0),
+  next_queue_frame_(0),
+  rendered_frames_(0),
+  dropped_frames_(0),
+  late_frames_(0),
+  average_presentation_error_(0)
+{
+  // Ticks are scheduled for the exact moment each frame is due, coarse timers could be off by several milliseconds
+  tick_timer_.setSingleShot(true);
+  tick_timer_.setTimerType(Qt::PreciseTimer);
+  connect(&tick_timer_, SIGNAL(timeout()), this, SLOT(Tick()));
+}
+
+void PlaybackEngine::SetTimebase(const rational &timebase)
+{
+  if (timebase.ToDouble() <= 0) {
+    return;
+  }
+
+  bool was_playing = playing_;
+
+  Pause();
+
+  // Keep the playhead at the same time in the new timebase
+  rational current_time = time();
+  timebase_ = timebase;
+  SetPlayhead(TimeToFrame(current_time));
+
+  if (was_playing) {
+    Play();
+  }
+}
+
+const rational &PlaybackEngine::timebase()
+{
+  return timebase_;
+}
+
+void PlaybackEngine::SetLateFramePolicy(const PlaybackEngine::LateFramePolicy &policy)
+{
+  policy_ = policy;
+}
+
+PlaybackEngine::LateFramePolicy PlaybackEngine::late_frame_policy()
+{
+  return policy_;
+}
+
+void PlaybackEngine::SetLookahead(int frames)
+{
+  lookahead_ = qMax(1, frames);
+}
+
+int PlaybackEngine::lookahead()
+{
+  return lookahead_;
+}
+
+void PlaybackEngine::SetRenderer(RendererProcessor *renderer, NodeOutput *output)
+{
+  Pause();
+
+  if (renderer_ != nullptr) {
+    disconnect(renderer_, SIGNAL(FrameReady(RenderJobPtr)), this, SLOT(FrameRendered(RenderJobPtr)));
+  }
+
+  renderer_ = renderer;
+  output_ = output;
+
+  if (renderer_ != nullptr) {
+    // FrameReady() is emitted from render threads
+    connect(renderer_,
+            SIGNAL(FrameReady(RenderJobPtr)),
+            this,
+            SLOT(FrameRendered(RenderJobPtr)),
+            Qt::QueuedConnection);
+  }
+}
+
+void PlaybackEngine::SetAudioPlayback(AudioPlayback *audio)
+{
+  Pause();
+
+  audio_ = audio;
+}
+
+int PlaybackEngine::speed()
+{
+  return speed_;
+}
+
+void PlaybackEngine::SetSpeed(int speed)
+{
+  speed = clamp(speed, -kMaxShuttleSpeed, kMaxShuttleSpeed);
+
+  if (speed == 0 || speed == speed_) {
+    return;
+  }
+
+  bool was_playing = playing_;
+
+  Pause();
+
+  // Carry on from the frame the playhead is on
+  int64_t current = TickToFrame(frame_);
+  speed_ = speed;
+  SetPlayhead(current);
+
+  if (was_playing) {
+    Play();
+  }
+}
+
+bool PlaybackEngine::IsPlaying()
+{
+  return playing_;
+}
+
+rational PlaybackEngine::time()
+{
+  return FrameToTime(TickToFrame(frame_));
+}
+
+qint64 PlaybackEngine::rendered_frames()
+{
+  return rendered_frames_;
+}
+
+qint64 PlaybackEngine::dropped_frames()
+{
+  return dropped_frames_;
+}
+
+qint64 PlaybackEngine::late_frames()
+{
+  return late_frames_;
+}
+
+TimeSource *PlaybackEngine::time_source()
+{
+  return &time_source_;
+}
+
+qint64 PlaybackEngine::PresentationTime()
+{
+  static QElapsedTimer timer;
+  static QMutex timer_lock;
+
+  QMutexLocker locker(&timer_lock);
+
+  if (!timer.isValid()) {
+    timer.start();
+  }
+
+  return timer.nsecsElapsed();
+}
+
+void PlaybackEngine::Play()
+{
+  if (playing_) {
+    return;
+  }
+
+  playing_ = true;
+
+  // Playback takes over from any scrub frames still pending
+  foreach (RenderJobPtr job, scrub_jobs_) {
+    job->Cancel();
+  }
+  scrub_jobs_.clear();
+
+  rendered_frames_ = 0;
+  dropped_frames_ = 0;
+  late_frames_ = 0;
+
+  clock_.start();
+  StartAudio();
+  Rebase(frame_, Now());
+
+  next_queue_frame_ = frame_ + 1;
+  QueueAhead(frame_);
+
+  ScheduleTick();
+
+  emit PlaybackStateChanged(true);
+}
+
+void PlaybackEngine::Pause()
+{
+  if (!playing_) {
+    return;
+  }
+
+  playing_ = false;
+
+  tick_timer_.stop();
+
+  if (audio_ != nullptr) {
+    audio_->Stop();
+  }
+
+  ClearFrames();
+
+  emit PlaybackStateChanged(false);
+}
+
+void PlaybackEngine::TogglePlayback()
+{
+  if (playing_) {
+    Pause();
+  } else {
+    Play();
+  }
+}
+
+void PlaybackEngine::Seek(const rational &time)
+{
+  SetPlayhead(TimeToFrame(time));
+
+  if (playing_) {
+    // Anything rendered or queued is for the old position
+    ClearFrames();
+
+    // The audio has to be mixed again from the new position, which restarts its clock too
+    if (audio_ != nullptr) {
+      StartAudio();
+    }
+
+    Rebase(frame_, Now());
+
+    next_queue_frame_ = frame_ + 1;
+    QueueAhead(frame_);
+
+    ScheduleTick();
+  }
+
+  PublishTime();
+}
+
+void PlaybackEngine::ReportPresentation(qint64 due, qint64 presented)
+{
+  // Errors larger than a frame are stalls (e.g. the window being moved) rather than something to adapt to
+  double error = static_cast<double>(presented - due);
+
+  if (qAbs(error) < FrameNanoseconds()) {
+    average_presentation_error_ = average_presentation_error_ * 0.9 + error * 0.1;
+  }
+}
+
+void PlaybackEngine::Scrub(const rational &time)
+{
+  Pause();
+
+  SetPlayhead(TimeToFrame(time));
+
+  if (renderer_ != nullptr && output_ != nullptr) {
+    // QueueScrubFrame() cancels the previous scrub's frames itself
+    scrub_jobs_ = renderer_->QueueScrubFrame(output_, this->time());
+  }
+
+  // Audio follows the mouse exactly rather than snapping to frames
+  if (audio_ != nullptr) {
+    audio_->Scrub(time);
+  }
+
+  PublishTime();
+}
+
+void PlaybackEngine::PrevFrame()
+{
+  Pause();
+
+  Seek(FrameToTime(TickToFrame(frame_) - 1));
+}
+
+void PlaybackEngine::NextFrame()
+{
+  Pause();
+
+  Seek(FrameToTime(TickToFrame(frame_) + 1));
+}
+
+void PlaybackEngine::ShuttleForward()
+{
+  // Each press doubles the speed, pressing it while stopped or going backwards starts at normal speed
+  int speed = (playing_ && speed_ > 0) ? qMin(speed_ * 2, static_cast<int>(kMaxShuttleSpeed)) : 1;
+
+  SetSpeed(speed);
+  Play();
+}
+
+void PlaybackEngine::ShuttleBackward()
+{
+  int speed = (playing_ && speed_ < 0) ? qMax(speed_ * 2, -kMaxShuttleSpeed) : -1;
+
+  SetSpeed(speed);
+  Play();
+}
+
+void PlaybackEngine::ShuttleStop()
+{
+  Pause();
+  SetSpeed(1);
+}
+
+double PlaybackEngine::FrameNanoseconds()
+{
+  return timebase_.ToDouble() * 1000000000.0;
+}
+
+qint64 PlaybackEngine::Now()
+{
+  if (IsAudioClockRunning()) {
+    return audio_->elapsed_nsecs();
+  }
+
+  return clock_.nsecsElapsed();
+}
+
+bool PlaybackEngine::IsAudioClockRunning()
+{
+  return (audio_ != nullptr && audio_->IsRunning());
+}
+
+PlaybackEngine::LateFramePolicy PlaybackEngine::EffectivePolicy()
+{
+  if (IsAudioClockRunning()) {
+    return kDropLateFrames;
+  }
+
+  return policy_;
+}
+
+void PlaybackEngine::StartAudio()
+{
+  // Shuttling is silent (and timed with the system clock)
+  if (audio_ != nullptr && speed_ == 1 && !audio_->Start(time())) {
+    qWarning() << tr("Audio playback failed to start, timing playback with the system clock instead");
+
+    // Timing continues from wherever the system clock is
+    clock_.start();
+  }
+}
+
+rational PlaybackEngine::FrameToTime(int64_t frame)
+{
+  return olive::TicksToTime(frame, timebase_);
+}
+
+int64_t PlaybackEngine::TimeToFrame(const rational &time)
+{
+  return olive::TimeToTicks(time, timebase_);
+}
+
+int64_t PlaybackEngine::TickToFrame(int64_t tick)
+{
+  return speed_origin_ + (tick - speed_origin_) * speed_;
+}
+
+void PlaybackEngine::SetPlayhead(int64_t frame)
+{
+  frame_ = frame;
+  speed_origin_ = frame;
+}
+
+int64_t PlaybackEngine::DueFrame(qint64 now)
+{
+  return clock_frame_ + static_cast<int64_t>(std::floor(static_cast<double>(now - clock_start_ns_)
+                                                        / FrameNanoseconds()));
+}
+
+qint64 PlaybackEngine::FrameDue(int64_t frame)
+{
+  return clock_start_ns_ + static_cast<qint64>(std::ceil(static_cast<double>(frame - clock_frame_)
+                                                         * FrameNanoseconds()));
+}
+
+qint64 PlaybackEngine::PresentationLead()
+{
+  if (renderer_ == nullptr || output_ == nullptr) {
+    return 0;
+  }
+
+  // Frames shown late on average should be sent earlier, but never more than a frame early
+  double lead = static_cast<double>(kDefaultPresentationLead) + average_presentation_error_;
+
+  return static_cast<qint64>(clamp(lead, 0.0, FrameNanoseconds()));
+}
+
+void PlaybackEngine::Rebase(int64_t frame, qint64 now)
+{
+  clock_frame_ = frame;
+  clock_start_ns_ = now;
+}
+
+void PlaybackEngine::Present(int64_t frame, RenderJobPtr job)
+{
+  frame_ = frame;
+
+  rendered_frames_++;
+
+  if (job != nullptr) {
+    emit PresentFrame(job, PresentationTime() + FrameDue(frame) - Now());
+  }
+
+  // Playing backwards stops at the start
+  bool at_start = (speed_ < 0 && TickToFrame(frame_) <= 0);
+
+  if (at_start) {
+    SetPlayhead(0);
+  }
+
+  PublishTime();
+
+  if (at_start) {
+    Pause();
+  }
+}
+
+void PlaybackEngine::PublishTime()
+{
+  rational current_time = time();
+
+  // Direct subscribers first, they shouldn't wait on whatever the signal's receivers do
+  time_source_.Publish(current_time);
+
+  emit TimeChanged(current_time);
+}
+
+void PlaybackEngine::QueueAhead(int64_t from)
+{
+  if (!playing_ || renderer_ == nullptr || output_ == nullptr) {
+    return;
+  }
+
+  bool keyframes_only = (qAbs(speed_) >= kKeyframesOnlySpeed);
+
+  // Frames are queued in presentation order, which is what QueueFrame() delivers them in
+  while (next_queue_frame_ <= from + lookahead_ && TickToFrame(next_queue_frame_) >= 0) {
+    RenderJobPtr job = renderer_->QueueFrame(output_, FrameToTime(TickToFrame(next_queue_frame_)), keyframes_only);
+
+    if (job == nullptr) {
+      break;
+    }
+
+    in_flight_.insert(next_queue_frame_, job);
+
+    next_queue_frame_++;
+  }
+}
+
+void PlaybackEngine::CancelBefore(int64_t frame)
+{
+  QMap<int64_t, RenderJobPtr>::iterator it = in_flight_.begin();
+
+  while (it != in_flight_.end() && it.key() < frame) {
+    it.value()->Cancel();
+    it = in_flight_.erase(it);
+
+    DropFrames(1);
+  }
+}
+
+void PlaybackEngine::DropFrames(int64_t count)
+{
+  dropped_frames_ += count;
+
+  PerformanceCounters::AddEvent(PerformanceCounters::kDroppedFrame, count);
+}
+
+void PlaybackEngine::ClearFrames()
+{
+  foreach (RenderJobPtr job, in_flight_) {
+    job->Cancel();
+  }
+
+  in_flight_.clear();
+  ready_frames_.clear();
+}
+
+void PlaybackEngine::ScheduleTick()
+{
+  qint64 now = Now();
+
+  qint64 lead = PresentationLead();
+
+  // If the playhead has fallen behind, the next tick is for the frame after the one that's due now
+  int64_t next_frame = qMax(frame_, DueFrame(now + lead)) + 1;
+
+  qint64 next_ns = FrameDue(next_frame) - lead;
+
+  qint64 wait_ms = qMax(Q_INT64_C(0), (next_ns - now + 999999) / 1000000);
+
+  tick_timer_.start(static_cast<int>(wait_ms));
+}
+
+void PlaybackEngine::Tick()
+{
+  if (!playing_) {
+    return;
+  }
+
+  // Frames are sent to the display a little before they're due
+  qint64 now = Now() + PresentationLead();
+
+  int64_t due = DueFrame(now);
+
+  if (due > frame_) {
+    if (renderer_ == nullptr || output_ == nullptr) {
+
+      // Without a renderer, presenting a frame only means moving the playhead
+      if (EffectivePolicy() == kDropLateFrames) {
+        DropFrames(due - frame_ - 1);
+        Present(due, nullptr);
+      } else {
+        if (due > frame_ + 1) {
+          late_frames_++;
+          Rebase(frame_ + 1, now);
+        }
+        Present(frame_ + 1, nullptr);
+      }
+
+    } else if (EffectivePolicy() == kDropLateFrames) {
+
+      // Show the newest frame that's due, any older ones that are ready were skipped over
+      RenderJobPtr job = nullptr;
+      int64_t job_frame = 0;
+
+      QMap<int64_t, RenderJobPtr>::iterator it = ready_frames_.begin();
+
+      while (it != ready_frames_.end() && it.key() <= due) {
+        if (job != nullptr) {
+          DropFrames(1);
+        }
+
+        job = it.value();
+        job_frame = it.key();
+
+        it = ready_frames_.erase(it);
+      }
+
+      if (job != nullptr) {
+        if (job_frame < due) {
+          late_frames_++;
+        }
+
+        Present(job_frame, job);
+      }
+
+      // Frames before the one that's due can no longer be shown in time, don't spend time rendering them
+      CancelBefore(due);
+
+      if (next_queue_frame_ < due) {
+        DropFrames(due - next_queue_frame_);
+        next_queue_frame_ = due;
+      }
+
+      QueueAhead(due);
+
+    } else {
+
+      // Only the next frame is ever shown, waiting for it holds the clock back
+      RenderJobPtr job = ready_frames_.take(frame_ + 1);
+
+      if (job == nullptr) {
+        // FrameRendered() ticks again once it arrives
+        return;
+      }
+
+      if (due > frame_ + 1) {
+        late_frames_++;
+        Rebase(frame_ + 1, now);
+      }
+
+      Present(frame_ + 1, job);
+
+      QueueAhead(frame_);
+
+    }
+  }
+
+  // Presenting the first frame while playing backwards stops playback
+  if (playing_) {
+    ScheduleTick();
+  }
+}
+
+void PlaybackEngine::FrameRendered(RenderJobPtr job)
+{
+  // Scrub frames are shown as soon as they arrive, the exact frame replacing the preview
+  int scrub_index = scrub_jobs_.indexOf(job);
+
+  if (scrub_index >= 0) {
+    scrub_jobs_.remove(0, scrub_index + 1);
+
+    if (!playing_) {
+      emit PresentFrame(job, PresentationTime());
+    }
+
+    return;
+  }
+
+  // Ignore frames that were queued by someone else or that we've since cancelled
+  QMap<int64_t, RenderJobPtr>::iterator queued = in_flight_.begin();
+
+  while (queued != in_flight_.end() && queued.value() != job) {
+    queued++;
+  }
+
+  if (queued == in_flight_.end()) {
+    return;
+  }
+
+  // Jobs are queued by tick, which isn't the frame's time when shuttling
+  int64_t frame = queued.key();
+
+  in_flight_.erase(queued);
+
+  if (frame <= frame_) {
+    // A later frame has already been shown
+    DropFrames(1);
+    return;
+  }
+
+  ready_frames_.insert(frame, job);
+
+  // Present it straight away if we're already waiting for it
+  if (frame <= DueFrame(Now() + PresentationLead())) {
+    Tick();
+  }
+}
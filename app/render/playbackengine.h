@@ -0,0 +1,402 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PLAYBACKENGINE_H
+#define PLAYBACKENGINE_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+
+#include "audio/audioplayback.h"
+#include "common/rational.h"
+#include "node/processor/renderer/renderer.h"
+#include "render/timesource.h"
+
+/**
+ * @brief Clock-driven playback of a sequence at its frame rate
+ *
+ * Playback is timed with a monotonic QElapsedTimer rather than by counting timer ticks, so timer jitter never
+ * accumulates into drift: every tick works out which frame is due from the time elapsed since playback started.
+ * TimeChanged() is emitted each time the playhead moves to a new frame. The same time is published to time_source()
+ * first, so render scheduling can follow the playhead directly without waiting on the event loop.
+ *
+ * If a RendererProcessor is set with SetRenderer(), frames are queued with RendererProcessor::QueueFrame() up to
+ * lookahead() frames ahead of the playhead and sent through PresentFrame() shortly before they're due, along with the
+ * PresentationTime() they should be shown at, so the display can pace them to its refresh. What happens when a
+ * frame hasn't finished rendering by the time it's due is decided by the LateFramePolicy.
+ *
+ * If an AudioPlayback is set with SetAudioPlayback(), it's started along with playback and becomes the master clock:
+ * video frames are presented against how much audio has been heard rather than the system clock, so the two can't
+ * drift apart. Since audio can't wait for video, late frames are always dropped while the audio clock is running.
+ *
+ * How early frames are sent adapts to how late the display reports actually showing them (see
+ * ReportPresentation()), so frames reach the display in time for the refresh they're due on.
+ *
+ * Playback can also run at a multiple of the frame rate, backwards or forwards, for J/K/L shuttling (see SetSpeed()).
+ * Audio is only played at normal speed.
+ *
+ * Statistics are reset every time playback starts.
+ */
+class PlaybackEngine : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief What to do when frames can't be rendered as fast as they should be presented
+   */
+  enum LateFramePolicy {
+    /// Keep the playhead in sync with the clock, skipping frames that would be shown late
+    kDropLateFrames,
+
+    /// Show every frame, holding the clock back until each late frame is ready
+    kSlowDown
+  };
+
+  PlaybackEngine(QObject* parent = nullptr);
+
+  /**
+   * @brief Set the duration of one frame (usually Sequence::video_time_base())
+   */
+  void SetTimebase(const rational& timebase);
+
+  const rational& timebase();
+
+  void SetLateFramePolicy(const LateFramePolicy& policy);
+
+  LateFramePolicy late_frame_policy();
+
+  /**
+   * @brief Set how many frames ahead of the playhead are queued for rendering
+   */
+  void SetLookahead(int frames);
+
+  int lookahead();
+
+  /**
+   * @brief Set the renderer and output to render frames with during playback
+   *
+   * Set both to nullptr to only drive the playhead with TimeChanged(). Playback is paused when this is changed.
+   */
+  void SetRenderer(RendererProcessor* renderer, NodeOutput* output);
+
+  /**
+   * @brief Set the audio to play along with video and use as the master clock (or nullptr for none)
+   *
+   * If the audio fails to start, playback falls back to the system clock. Playback is paused when this is changed.
+   */
+  void SetAudioPlayback(AudioPlayback* audio);
+
+  int speed();
+
+  /**
+   * @brief Set how many frames the playhead moves every frame period, negative to play backwards (1 by default)
+   *
+   * From kKeyframesOnlySpeed up (in either direction), frames are rendered at reduced resolution from their closest
+   * keyframes (see RendererProcessor::QueueFrame()), since decoding every frame in between would make shuttling through
+   * long footage decode-bound. Playback carries on from the same frame if it's running.
+   */
+  void SetSpeed(int speed);
+
+  bool IsPlaying();
+
+  /**
+   * @brief The time of the frame the playhead is currently on
+   */
+  rational time();
+
+  /**
+   * @brief Number of frames presented since playback started (including late ones)
+   */
+  qint64 rendered_frames();
+
+  /**
+   * @brief Number of frames skipped since playback started
+   */
+  qint64 dropped_frames();
+
+  /**
+   * @brief Number of frames presented after they were due since playback started
+   */
+  qint64 late_frames();
+
+  /**
+   * @brief Direct-call source of the playhead time, published just before TimeChanged() is emitted
+   */
+  TimeSource* time_source();
+
+  /**
+   * @brief Nanoseconds on a monotonic clock shared by the whole process, used to timestamp frame presentation
+   */
+  static qint64 PresentationTime();
+
+public slots:
+  void Play();
+
+  void Pause();
+
+  void TogglePlayback();
+
+  /**
+   * @brief Move the playhead to the frame at a certain time
+   */
+  void Seek(const rational& time);
+
+  /**
+   * @brief Pause and move the playhead to a frame while it's being dragged
+   *
+   * With a renderer, a reduced resolution preview is shown as soon as it's ready and replaced by the exact frame
+   * once that's done (see RendererProcessor::QueueScrubFrame()). Moving on cancels both if they're still pending.
+   * With an AudioPlayback, a short grain of audio around the time is played too (see AudioPlayback::Scrub()).
+   */
+  void Scrub(const rational& time);
+
+  /**
+   * @brief Pause and move the playhead one frame back
+   */
+  void PrevFrame();
+
+  /**
+   * @brief Pause and move the playhead one frame forward
+   */
+  void NextFrame();
+
+  /**
+   * @brief Shuttle forward (L): play forwards at normal speed, or twice as fast if already shuttling forwards
+   */
+  void ShuttleForward();
+
+  /**
+   * @brief Shuttle backward (J): play backwards at normal speed, or twice as fast if already shuttling backwards
+   */
+  void ShuttleBackward();
+
+  /**
+   * @brief Stop shuttling (K): pause and go back to normal speed
+   */
+  void ShuttleStop();
+
+  /**
+   * @brief Report when a frame sent with PresentFrame() was actually shown (both in PresentationTime())
+   */
+  void ReportPresentation(qint64 due, qint64 presented);
+
+signals:
+  /**
+   * @brief Emitted whenever the playhead moves to a new frame
+   */
+  void TimeChanged(const rational& time);
+
+  /**
+   * @brief Emitted during playback with each rendered frame shortly before it's due (only if a renderer is set)
+   *
+   * @param present_time
+   *
+   * The PresentationTime() the frame should be shown at. This may already have passed if the frame is late.
+   */
+  void PresentFrame(RenderJobPtr job, qint64 present_time);
+
+  /**
+   * @brief Emitted when playback starts or stops
+   */
+  void PlaybackStateChanged(bool playing);
+
+private:
+  /**
+   * @brief Default number of frames to render ahead of the playhead
+   */
+  static const int kDefaultLookahead = 4;
+
+  /**
+   * @brief Fastest shuttle speed (in either direction)
+   */
+  static const int kMaxShuttleSpeed = 32;
+
+  /**
+   * @brief Slowest shuttle speed (in either direction) at which only keyframes are shown, see SetSpeed()
+   */
+  static const int kKeyframesOnlySpeed = 4;
+
+  /**
+   * @brief How early frames are sent before presentation errors have been measured in nanoseconds
+   */
+  static const qint64 kDefaultPresentationLead = 8000000;
+
+  /**
+   * @brief Duration of one frame in nanoseconds
+   */
+  double FrameNanoseconds();
+
+  /**
+   * @brief Nanoseconds since playback started according to the master clock
+   */
+  qint64 Now();
+
+  /**
+   * @brief Returns TRUE if playback is being timed by the audio clock
+   */
+  bool IsAudioClockRunning();
+
+  /**
+   * @brief The policy actually in effect (late frames are always dropped when following the audio clock)
+   */
+  LateFramePolicy EffectivePolicy();
+
+  /**
+   * @brief Start the audio (if any) from the current frame
+   */
+  void StartAudio();
+
+  rational FrameToTime(int64_t frame);
+
+  int64_t TimeToFrame(const rational& time);
+
+  /**
+   * @brief Returns the frame shown at a playback tick (one frame period each) at the current speed
+   */
+  int64_t TickToFrame(int64_t tick);
+
+  /**
+   * @brief Put the playhead on `frame`, which becomes the tick that speed changes count from
+   */
+  void SetPlayhead(int64_t frame);
+
+  /**
+   * @brief Returns the frame the clock says should be shown at `now` (nanoseconds since playback started)
+   */
+  int64_t DueFrame(qint64 now);
+
+  /**
+   * @brief Returns when `frame` is due in nanoseconds since playback started
+   */
+  qint64 FrameDue(int64_t frame);
+
+  /**
+   * @brief How long before they're due frames are sent to the display
+   *
+   * Only frames from the renderer are sent early, without one the playhead is moved exactly when frames are due.
+   */
+  qint64 PresentationLead();
+
+  /**
+   * @brief Make `frame` due at `now`, used when starting, seeking or slowing down
+   */
+  void Rebase(int64_t frame, qint64 now);
+
+  /**
+   * @brief Move the playhead to `frame`, sending `job` to be displayed if it's valid
+   */
+  void Present(int64_t frame, RenderJobPtr job);
+
+  /**
+   * @brief Publish the playhead's time to time_source() and emit TimeChanged()
+   */
+  void PublishTime();
+
+  /**
+   * @brief Queue frames for rendering up to lookahead() frames after `from`
+   */
+  void QueueAhead(int64_t from);
+
+  /**
+   * @brief Cancel jobs for frames before `frame`, counting them as dropped
+   */
+  void CancelBefore(int64_t frame);
+
+  /**
+   * @brief Count frames that were skipped
+   */
+  void DropFrames(int64_t count);
+
+  /**
+   * @brief Cancel all jobs in flight and forget about frames waiting to be presented
+   */
+  void ClearFrames();
+
+  /**
+   * @brief Start the tick timer for when the next frame is due
+   */
+  void ScheduleTick();
+
+  rational timebase_;
+
+  LateFramePolicy policy_;
+
+  int lookahead_;
+
+  RendererProcessor* renderer_;
+
+  NodeOutput* output_;
+
+  AudioPlayback* audio_;
+
+  bool playing_;
+
+  int speed_;
+
+  // Tick (and frame) the current speed counts from, see TickToFrame()
+  int64_t speed_origin_;
+
+  // Tick the playhead is on, ticks and frames are the same at normal speed (everything below counts in ticks)
+  int64_t frame_;
+
+  // Frame that was due when clock_start_ns_ elapsed
+  int64_t clock_frame_;
+
+  qint64 clock_start_ns_;
+
+  QElapsedTimer clock_;
+
+  QTimer tick_timer_;
+
+  // Next frame to queue for rendering
+  int64_t next_queue_frame_;
+
+  // Frames queued for rendering that haven't been delivered yet
+  QMap<int64_t, RenderJobPtr> in_flight_;
+
+  // Frames that have been rendered but aren't due yet
+  QMap<int64_t, RenderJobPtr> ready_frames_;
+
+  // Preview and exact frame of the last Scrub() that haven't been shown yet
+  QVector<RenderJobPtr> scrub_jobs_;
+
+  qint64 rendered_frames_;
+
+  qint64 dropped_frames_;
+
+  qint64 late_frames_;
+
+  // Moving average of how late frames were shown compared to when they were due
+  double average_presentation_error_;
+
+  TimeSource time_source_;
+
+private slots:
+  void Tick();
+
+  /**
+   * @brief Connected to RendererProcessor::FrameReady()
+   */
+  void FrameRendered(RenderJobPtr job);
+};
+
+#endif // PLAYBACKENGINE_H
@@ -0,0 +1,345 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderahead.h"
+
+#include <QThread>
+
+#include "common/tickrescaler.h"
+
+RenderAhead::RenderAhead(QObject *parent) :
+  QObject(parent),
+  renderer_(nullptr),
+  output_(nullptr),
+  timebase_(1001, 30000),
+  playhead_(0),
+  time_source_(nullptr),
+  time_source_id_(0),
+  frames_behind_(kDefaultFramesBehind),
+  frames_ahead_(kDefaultFramesAhead),
+  speculative_enabled_(true),
+  range_active_(false),
+  range_in_(0),
+  range_out_(0),
+  next_range_frame_(0),
+  range_finished_(0),
+  idle_(false)
+{
+  idle_timer_.setSingleShot(true);
+  idle_timer_.setInterval(kIdleDelay);
+  connect(&idle_timer_, SIGNAL(timeout()), this, SLOT(IdleTimeout()));
+}
+
+RenderAhead::~RenderAhead()
+{
+  SetTimeSource(nullptr);
+}
+
+void RenderAhead::SetTimeSource(TimeSource *source)
+{
+  if (time_source_ != nullptr) {
+    time_source_->Unsubscribe(time_source_id_);
+  }
+
+  time_source_ = source;
+
+  if (time_source_ != nullptr) {
+    SetPlayhead(time_source_->time());
+
+    time_source_id_ = time_source_->Subscribe([this](const rational& time) {
+      SetPlayhead(time);
+    });
+  }
+}
+
+void RenderAhead::SetRenderer(RendererProcessor *renderer, NodeOutput *output)
+{
+  if (renderer_ != nullptr) {
+    disconnect(renderer_, SIGNAL(BackgroundPreempted()), this, SLOT(Preempted()));
+    disconnect(renderer_, SIGNAL(BackgroundFrameFinished(RenderJobPtr)), this, SLOT(FrameFinished(RenderJobPtr)));
+
+    renderer_->PreemptBackground();
+  }
+
+  Reset();
+
+  renderer_ = renderer;
+  output_ = output;
+  valid_.clear();
+
+  if (renderer_ != nullptr && output_ != nullptr) {
+    renderer_->frame_cache()->SetTimebase(output_, timebase_);
+  }
+
+  if (renderer_ != nullptr) {
+    connect(renderer_, SIGNAL(BackgroundPreempted()), this, SLOT(Preempted()));
+
+    // Finished frames are reported from render threads
+    connect(renderer_,
+            SIGNAL(BackgroundFrameFinished(RenderJobPtr)),
+            this,
+            SLOT(FrameFinished(RenderJobPtr)),
+            Qt::QueuedConnection);
+
+    idle_timer_.start();
+  }
+}
+
+void RenderAhead::SetTimebase(const rational &timebase)
+{
+  timebase_ = timebase;
+
+  if (renderer_ != nullptr) {
+    if (output_ != nullptr) {
+      renderer_->frame_cache()->SetTimebase(output_, timebase_);
+    }
+
+    renderer_->PreemptBackground();
+  }
+}
+
+void RenderAhead::SetSpeculativeRange(int frames_behind, int frames_ahead)
+{
+  frames_behind_ = frames_behind;
+  frames_ahead_ = frames_ahead;
+
+  Fill();
+}
+
+void RenderAhead::SetSpeculativeEnabled(bool enabled)
+{
+  speculative_enabled_ = enabled;
+
+  Fill();
+}
+
+void RenderAhead::RenderRange(const rational &in, const rational &out)
+{
+  range_active_ = true;
+  range_in_ = TimeToFrame(in);
+  range_out_ = qMax(range_in_, TimeToFrame(out));
+  next_range_frame_ = range_in_;
+  range_finished_ = 0;
+  range_retry_.clear();
+
+  emit RangeProgress(0);
+
+  Fill();
+}
+
+void RenderAhead::CancelRange()
+{
+  range_active_ = false;
+}
+
+bool RenderAhead::IsRenderingRange()
+{
+  return range_active_;
+}
+
+void RenderAhead::SetPlayhead(const rational &time)
+{
+  playhead_ = TimeToFrame(time);
+}
+
+rational RenderAhead::FrameToTime(int64_t frame)
+{
+  // Same calculation as PlaybackEngine so cached frames are found at exactly the times playback asks for
+  return olive::TicksToTime(frame, timebase_);
+}
+
+int64_t RenderAhead::TimeToFrame(const rational &time)
+{
+  return olive::TimeToTicks(time, timebase_);
+}
+
+bool RenderAhead::NextFrame(int64_t *frame)
+{
+  // The range the user asked for comes first
+  if (range_active_) {
+    while (!range_retry_.isEmpty() || next_range_frame_ <= range_out_) {
+      int64_t f;
+
+      if (!range_retry_.isEmpty()) {
+        f = range_retry_.takeFirst();
+      } else {
+        // Skip a whole run of frames that are already cached at once
+        int64_t cached_end = qMin(valid_.RunEnd(next_range_frame_), range_out_);
+
+        if (cached_end >= next_range_frame_) {
+          range_finished_ += cached_end - next_range_frame_ + 1;
+          next_range_frame_ = cached_end + 1;
+          continue;
+        }
+
+        f = next_range_frame_;
+        next_range_frame_++;
+      }
+
+      if (IsMissing(f)) {
+        *frame = f;
+        return true;
+      }
+
+      // Already cached, count it as done
+      range_finished_++;
+    }
+  }
+
+  if (!speculative_enabled_) {
+    return false;
+  }
+
+  // Speculative frames must never push out frames that are already cached
+  FrameCache* cache = renderer_->frame_cache();
+
+  if (cache->allocated_bytes() >= cache->budget()) {
+    return false;
+  }
+
+  // The playhead can move while searching, so work around one position
+  int64_t playhead = playhead_;
+
+  // Ahead of the playhead first since that's where playback goes, then just behind it
+  for (int64_t f=playhead;f<=playhead+frames_ahead_;f++) {
+    if (IsMissing(f)) {
+      *frame = f;
+      return true;
+    }
+  }
+
+  for (int64_t f=playhead-1;f>=qMax(static_cast<int64_t>(0), playhead-frames_behind_);f--) {
+    if (IsMissing(f)) {
+      *frame = f;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool RenderAhead::IsMissing(int64_t frame)
+{
+  return !in_flight_.contains(frame)
+      && !uncacheable_.contains(frame)
+      && !valid_.Contains(frame);
+}
+
+void RenderAhead::Reset()
+{
+  in_flight_.clear();
+  idle_ = false;
+  idle_timer_.stop();
+}
+
+void RenderAhead::Preempted()
+{
+  // Every background job has been aborted, range frames that didn't finish have to be queued again
+  if (range_active_) {
+    QMap<int64_t, RenderJobPtr>::const_iterator i;
+
+    for (i=in_flight_.constBegin();i!=in_flight_.constEnd();i++) {
+      if (i.key() >= range_in_ && i.key() <= range_out_) {
+        range_retry_.append(i.key());
+      }
+    }
+  }
+
+  Reset();
+
+  // Something may have changed that lets these frames be cached now
+  uncacheable_.clear();
+
+  if (renderer_ != nullptr) {
+    idle_timer_.start();
+  }
+}
+
+void RenderAhead::FrameFinished(RenderJobPtr job)
+{
+  int64_t frame = TimeToFrame(job->time());
+
+  // Ignore jobs that were aborted, they're queued again once the user is idle
+  if (in_flight_.value(frame) != job) {
+    return;
+  }
+
+  in_flight_.remove(frame);
+
+  if (!renderer_->frame_cache()->Contains(output_, job->time(), job->divider())) {
+    uncacheable_.insert(frame);
+  }
+
+  if (range_active_ && frame >= range_in_ && frame <= range_out_) {
+    range_finished_++;
+
+    int64_t total = range_out_ - range_in_ + 1;
+
+    emit RangeProgress(static_cast<int>(100 * range_finished_ / total));
+
+    if (range_finished_ >= total) {
+      range_active_ = false;
+      emit RangeFinished();
+    }
+  }
+
+  Fill();
+}
+
+void RenderAhead::IdleTimeout()
+{
+  idle_ = true;
+
+  Fill();
+}
+
+void RenderAhead::Fill()
+{
+  if (!idle_ || renderer_ == nullptr || output_ == nullptr) {
+    return;
+  }
+
+  // Reading all the cached frames at once is far cheaper than looking them up one by one
+  valid_ = renderer_->frame_cache()->valid_frames(output_, renderer_->minimum_divider());
+
+  // One frame per thread is enough to keep idle threads busy without a backlog to abort when the user returns
+  int max_in_flight = qMax(1, QThread::idealThreadCount());
+
+  int64_t frame;
+
+  while (in_flight_.size() < max_in_flight && NextFrame(&frame)) {
+    RenderJobPtr job = renderer_->QueueBackgroundFrame(output_, FrameToTime(frame), renderer_->minimum_divider());
+
+    if (job == nullptr) {
+      // The renderer isn't started or frames are too large to cache
+      break;
+    }
+
+    in_flight_.insert(frame, job);
+  }
+
+  // Every range frame may already have been cached
+  if (range_active_ && range_retry_.isEmpty() && next_range_frame_ > range_out_
+      && range_finished_ >= range_out_ - range_in_ + 1) {
+    range_active_ = false;
+    emit RangeProgress(100);
+    emit RangeFinished();
+  }
+}
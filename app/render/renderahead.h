@@ -0,0 +1,218 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERAHEAD_H
+#define RENDERAHEAD_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <atomic>
+
+#include "common/framerunlist.h"
+#include "common/rational.h"
+#include "node/processor/renderer/renderer.h"
+#include "render/timesource.h"
+
+/**
+ * @brief Fills a RendererProcessor's FrameCache with frames before they're needed
+ *
+ * Two kinds of render-ahead are scheduled on the renderer's background queue (see
+ * RendererProcessor::QueueBackgroundFrame()), so they only use render threads that would otherwise be idle:
+ *
+ * * RenderRange() renders every frame between an in and out point once, reporting its progress, so that a heavy
+ *   segment plays back in real time afterwards.
+ * * While the user is idle, frames around the playhead that aren't cached yet are rendered speculatively, as long as
+ *   they fit in the cache's budget without evicting anything.
+ *
+ * Any frame the user asks for preempts render-ahead immediately (see RendererProcessor::PreemptBackground()), and
+ * nothing is scheduled again until the user has been idle for a moment.
+ */
+class RenderAhead : public QObject
+{
+  Q_OBJECT
+public:
+  RenderAhead(QObject* parent = nullptr);
+
+  virtual ~RenderAhead() override;
+
+  /**
+   * @brief Follow the playhead published by a TimeSource (e.g. PlaybackEngine::time_source()), or nullptr to stop
+   *
+   * The playhead is updated directly from whichever thread publishes, so a busy event loop never leaves speculative
+   * rendering working around a stale position.
+   */
+  void SetTimeSource(TimeSource* source);
+
+  /**
+   * @brief Set the renderer to render ahead with and the output whose frames to render
+   */
+  void SetRenderer(RendererProcessor* renderer, NodeOutput* output);
+
+  /**
+   * @brief Set the duration of one frame (usually Sequence::video_time_base())
+   */
+  void SetTimebase(const rational& timebase);
+
+  /**
+   * @brief Set how many frames behind and ahead of the playhead are rendered speculatively
+   */
+  void SetSpeculativeRange(int frames_behind, int frames_ahead);
+
+  /**
+   * @brief Enable or disable speculative rendering around the playhead (enabled by default)
+   */
+  void SetSpeculativeEnabled(bool enabled);
+
+  /**
+   * @brief Render every frame from `in` to `out` (inclusive) into the cache, replacing any range already rendering
+   *
+   * Ranges larger than the cache's budget can't be kept whole, frames rendered first are evicted by later ones.
+   */
+  void RenderRange(const rational& in, const rational& out);
+
+  /**
+   * @brief Stop rendering the range set with RenderRange()
+   */
+  void CancelRange();
+
+  bool IsRenderingRange();
+
+public slots:
+  /**
+   * @brief Move the position speculative rendering happens around
+   *
+   * Prefer SetTimeSource() when following playback. Thread-safe.
+   */
+  void SetPlayhead(const rational& time);
+
+signals:
+  /**
+   * @brief Emitted as frames of the range set with RenderRange() finish
+   */
+  void RangeProgress(int percent);
+
+  /**
+   * @brief Emitted once every frame of the range set with RenderRange() has been rendered
+   */
+  void RangeFinished();
+
+private:
+  /**
+   * @brief How long the user has to be idle before rendering ahead (in milliseconds)
+   */
+  static const int kIdleDelay = 500;
+
+  static const int kDefaultFramesBehind = 8;
+  static const int kDefaultFramesAhead = 48;
+
+  rational FrameToTime(int64_t frame);
+
+  int64_t TimeToFrame(const rational& time);
+
+  /**
+   * @brief Find the next frame to render ahead
+   *
+   * @return
+   *
+   * TRUE if a frame was found and written to `frame`.
+   */
+  bool NextFrame(int64_t* frame);
+
+  /**
+   * @brief Returns TRUE if a frame is neither cached nor being rendered (and could be cached)
+   */
+  bool IsMissing(int64_t frame);
+
+  /**
+   * @brief Forget about the background jobs in flight (they're aborted or finished)
+   */
+  void Reset();
+
+  RendererProcessor* renderer_;
+
+  NodeOutput* output_;
+
+  rational timebase_;
+
+  // Written by SetPlayhead() from the TimeSource's thread
+  std::atomic<int64_t> playhead_;
+
+  TimeSource* time_source_;
+
+  int time_source_id_;
+
+  int frames_behind_;
+
+  int frames_ahead_;
+
+  bool speculative_enabled_;
+
+  // Range set with RenderRange(), next_range_frame_ is the next one to queue (range_out_ + 1 once all are queued)
+  bool range_active_;
+  int64_t range_in_;
+  int64_t range_out_;
+  int64_t next_range_frame_;
+
+  // Number of range frames that have finished
+  int64_t range_finished_;
+
+  // Range frames that were preempted before they finished, queued again before next_range_frame_
+  QList<int64_t> range_retry_;
+
+  // Background jobs queued and not finished yet, keyed by frame
+  QMap<int64_t, RenderJobPtr> in_flight_;
+
+  // Frames in the cache when Fill() started
+  FrameRunList valid_;
+
+  // Frames that finished without ending up in the cache (e.g. nothing to render), not tried again until Preempted()
+  QSet<int64_t> uncacheable_;
+
+  // Started whenever the user does something, render-ahead resumes once it times out
+  QTimer idle_timer_;
+
+  bool idle_;
+
+private slots:
+  /**
+   * @brief Connected to RendererProcessor::BackgroundPreempted(), waits for the user to be idle again
+   */
+  void Preempted();
+
+  /**
+   * @brief Connected to RendererProcessor::BackgroundFrameFinished()
+   */
+  void FrameFinished(RenderJobPtr job);
+
+  /**
+   * @brief The user has been idle for kIdleDelay
+   */
+  void IdleTimeout();
+
+  /**
+   * @brief Queue background frames until every render thread has one
+   */
+  void Fill();
+};
+
+#endif // RENDERAHEAD_H
@@ -18,22 +18,15 @@
 
 ***/
 
-#include "taskthread.h"
+#include "renderbackend.h"
 
-#include "task/task.h"
+#include "render/gl/openglbackend.h"
 
-TaskThread::TaskThread(Task *parent) :
-  parent_(parent),
-  result_(false)
-{
-}
+// Olive only runs on OpenGL so far
+olive::gl::OpenGLBackend opengl_backend;
 
-void TaskThread::run()
-{
-  result_ = parent_->Action();
-}
+RenderBackend* olive::render_backend = &opengl_backend;
 
-bool TaskThread::result()
+RenderBackend::~RenderBackend()
 {
-  return result_;
 }
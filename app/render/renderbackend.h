@@ -0,0 +1,190 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERBACKEND_H
+#define RENDERBACKEND_H
+
+#include <QMatrix4x4>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <memory>
+
+#include "pixelformat.h"
+
+/**
+ * @brief Interface to the GPU API the renderer runs on
+ *
+ * Covers what rendering needs from the GPU: textures, render targets, pipelines (including compute) and fences. Code
+ * written against it doesn't depend on OpenGL, so another backend (e.g. Vulkan or Metal) can be added later by
+ * implementing this class. olive::gl::OpenGLBackend is the only implementation so far, and most of the renderer still
+ * uses OpenGL directly. Move code over to this interface as it's touched.
+ *
+ * Objects are referred to by opaque handles whose meaning is up to the backend (0 or nullptr is always "none"). Like
+ * OpenGL, every function works on the calling thread's current device context (e.g. a RendererThread's), and handles
+ * can be used on any context sharing resources with the one that created them.
+ *
+ * Shader sources are GLSL, as written for olive::gl. Backends for other APIs are expected to cross-compile them.
+ */
+class RenderBackend
+{
+public:
+  /**
+   * @brief A texture or render target
+   */
+  using Handle = quintptr;
+
+  /**
+   * @brief Marks a point in the GPU's command stream, see CreateFence()
+   */
+  using Fence = void*;
+
+  /**
+   * @brief A compiled pipeline, shared between everything that requests identical source
+   */
+  using Pipeline = std::shared_ptr<void>;
+
+  virtual ~RenderBackend();
+
+  /**
+   * @brief Human-readable name of the backend and device (e.g. for logs and bug reports)
+   */
+  virtual QString name() = 0;
+
+  /**
+   * @brief Create an uninitialized texture
+   */
+  virtual Handle CreateTexture(olive::PixelFormat format, int width, int height) = 0;
+
+  /**
+   * @brief Replace the whole contents of a texture with an image in memory, `linesize` bytes per row
+   */
+  virtual void UploadTexture(Handle texture, olive::PixelFormat format, const void* data, int linesize) = 0;
+
+  /**
+   * @brief Read part of a texture into memory, `linesize` bytes per row (waits for the GPU to finish the texture)
+   */
+  virtual void DownloadTexture(Handle texture,
+                               olive::PixelFormat format,
+                               const QRect& rect,
+                               void* data,
+                               int linesize) = 0;
+
+  /**
+   * @brief Copy part of one texture into the same place in another of the same format
+   */
+  virtual void CopyTexture(Handle source, Handle destination, const QRect& rect) = 0;
+
+  /**
+   * @brief Returns the size of a texture
+   */
+  virtual QSize TextureSize(Handle texture) = 0;
+
+  virtual void DestroyTexture(Handle texture) = 0;
+
+  /**
+   * @brief Create a render target drawing onto a texture
+   *
+   * The texture must outlive the render target. Unlike other handles, render targets can only be used on the context
+   * that created them (OpenGL framebuffers aren't shared).
+   */
+  virtual Handle CreateRenderTarget(Handle texture) = 0;
+
+  virtual void DestroyRenderTarget(Handle target) = 0;
+
+  /**
+   * @brief Returns a pipeline applying `vec4 function_name(vec4 color)` functions in order to a texture
+   *
+   * See olive::gl::GetFusedPipeline() for what `shader_code` must contain.
+   *
+   * @return
+   *
+   * The pipeline or nullptr if it couldn't be built.
+   */
+  virtual Pipeline GetPipeline(const QStringList& function_names, const QString& shader_code) = 0;
+
+  /**
+   * @brief Set a uniform of a pipeline (int, float, bool, QVector2D/3D/4D, QColor and QMatrix4x4 values)
+   *
+   * Uniforms keep their values until they're set again.
+   */
+  virtual void SetUniform(Pipeline pipeline, const char* name, const QVariant& value) = 0;
+
+  /**
+   * @brief Draw a texture onto the whole of a render target through a pipeline
+   */
+  virtual void Draw(Pipeline pipeline, Handle texture, Handle target, const QMatrix4x4& matrix = QMatrix4x4()) = 0;
+
+  /**
+   * @brief Returns TRUE if compute pipelines can be used with this device
+   */
+  virtual bool SupportsCompute() = 0;
+
+  /**
+   * @brief Returns a compute pipeline (see olive::gl::GetComputePipeline() for the source conventions)
+   *
+   * @return
+   *
+   * The pipeline or nullptr if compute isn't supported or it couldn't be built.
+   */
+  virtual Pipeline GetComputePipeline(const QString& source) = 0;
+
+  /**
+   * @brief Run a compute pipeline once for every pixel of a texture (see olive::gl::DispatchOverTexture())
+   */
+  virtual void Dispatch(Pipeline pipeline, Handle texture, int width, int height) = 0;
+
+  /**
+   * @brief Create a fence that's signalled once everything submitted before it has finished
+   *
+   * The fence can be waited on by any context sharing resources with this one.
+   */
+  virtual Fence CreateFence() = 0;
+
+  /**
+   * @brief Make the GPU wait for a fence before running anything submitted after this, without blocking the CPU
+   */
+  virtual void WaitFenceOnGPU(Fence fence) = 0;
+
+  /**
+   * @brief Block the calling thread until a fence is signalled
+   */
+  virtual void WaitFence(Fence fence) = 0;
+
+  virtual void DestroyFence(Fence fence) = 0;
+
+  /**
+   * @brief Submit everything queued so far to the GPU
+   */
+  virtual void Flush() = 0;
+};
+
+namespace olive {
+
+/**
+ * @brief The backend the renderer uses
+ */
+extern RenderBackend* render_backend;
+
+}
+
+#endif // RENDERBACKEND_H
@@ -0,0 +1,520 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "rendercoordinator.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#include "export/videoconcat.h"
+#include "export/videoencoder.h"
+
+RenderCoordinator::RenderCoordinator(QObject *parent) :
+  QObject(parent),
+  joining_(false),
+  finished_(false)
+{
+  stdout_.open(stdout, QIODevice::WriteOnly);
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+  finished_ = true;
+
+  for (int i=0;i<workers_.size();i++) {
+    QProcess* process = workers_.at(i).process;
+
+    if (process->state() != QProcess::NotRunning) {
+      process->kill();
+      process->waitForFinished();
+    }
+  }
+}
+
+bool RenderCoordinator::Start(const RenderCoordinator::Params &params)
+{
+  params_ = params;
+
+  const HeadlessRender::Params& render = params_.render;
+
+  if (render.project.isEmpty()) {
+    PrintError(tr("No project to render"));
+    return false;
+  }
+
+  if (render.output.isEmpty()) {
+    PrintError(tr("No output filename"));
+    return false;
+  }
+
+  if (render.out < 0) {
+    PrintError(tr("No last frame to render"));
+    return false;
+  }
+
+  if (render.in < 0 || render.out < render.in) {
+    PrintError(tr("Invalid range %1-%2").arg(render.in).arg(render.out));
+    return false;
+  }
+
+  if (params_.workers.isEmpty()) {
+    PrintError(tr("No workers to render with"));
+    return false;
+  }
+
+  if (params_.chunk_frames <= 0) {
+    PrintError(tr("Invalid chunk size %1").arg(params_.chunk_frames));
+    return false;
+  }
+
+  // Workers may be started in other directories (or on other machines), so they're given absolute paths
+  params_.render.project = QFileInfo(render.project).absoluteFilePath();
+  params_.render.output = QFileInfo(render.output).absoluteFilePath();
+
+  joining_ = (!params_.render.output.contains('#') && VideoEncoder::IsVideoFilename(params_.render.output));
+
+  QFileInfo output_info(params_.render.output);
+
+  for (int64_t in=params_.render.in;in<=params_.render.out;in+=params_.chunk_frames) {
+    Chunk c;
+
+    c.in = in;
+    c.out = qMin(in + params_.chunk_frames - 1, params_.render.out);
+    c.attempts = 0;
+    c.running = false;
+    c.completed = 0;
+    c.done = false;
+
+    if (joining_) {
+      c.output = output_info.dir().filePath(QStringLiteral("%1.part%2.%3").arg(output_info.completeBaseName(),
+                                                                               QString::number(chunks_.size())
+                                                                               .rightJustified(4, '0'),
+                                                                               output_info.suffix()));
+    } else {
+      // Frames are numbered by the Sequence, so every chunk can write to the same pattern
+      c.output = params_.render.output;
+    }
+
+    chunks_.append(c);
+  }
+
+  if (joining_) {
+    QDir().mkpath(output_info.absolutePath());
+  }
+
+  foreach (const QString& command, params_.workers) {
+    Worker w;
+
+    w.command = command;
+    w.process = new QProcess(this);
+    w.chunk = -1;
+    w.failures = 0;
+
+    // Warnings from workers are passed on as they are
+    w.process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+    connect(w.process, SIGNAL(readyReadStandardOutput()), this, SLOT(WorkerOutput()));
+    connect(w.process,
+            SIGNAL(finished(int, QProcess::ExitStatus)),
+            this,
+            SLOT(WorkerFinished(int, QProcess::ExitStatus)));
+    connect(w.process,
+            SIGNAL(errorOccurred(QProcess::ProcessError)),
+            this,
+            SLOT(WorkerError(QProcess::ProcessError)));
+
+    workers_.append(w);
+  }
+
+  QJsonObject start;
+  start.insert("in", static_cast<double>(params_.render.in));
+  start.insert("out", static_cast<double>(params_.render.out));
+  start.insert("frames", static_cast<double>(params_.render.out - params_.render.in + 1));
+  start.insert("chunks", chunks_.size());
+  start.insert("workers", workers_.size());
+  Print("start", start);
+
+  timer_.start();
+
+  Dispatch();
+
+  return true;
+}
+
+QStringList RenderCoordinator::ReadWorkers(const QString &filename)
+{
+  QStringList workers;
+
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly | QFile::Text)) {
+    return workers;
+  }
+
+  QTextStream stream(&file);
+
+  while (!stream.atEnd()) {
+    QString line = stream.readLine().trimmed();
+
+    if (!line.isEmpty() && !line.startsWith('#')) {
+      workers.append(line);
+    }
+  }
+
+  return workers;
+}
+
+void RenderCoordinator::Dispatch()
+{
+  if (finished_) {
+    return;
+  }
+
+  bool all_done = true;
+  bool any_running = false;
+
+  foreach (const Chunk& c, chunks_) {
+    all_done &= c.done;
+    any_running |= c.running;
+  }
+
+  if (all_done) {
+    Finish(JoinParts());
+    return;
+  }
+
+  int next_chunk = 0;
+
+  for (int i=0;i<workers_.size();i++) {
+    Worker* worker = &workers_[i];
+
+    if (worker->chunk >= 0 || worker->failures >= kMaxWorkerFailures) {
+      continue;
+    }
+
+    while (next_chunk < chunks_.size() && (chunks_.at(next_chunk).done || chunks_.at(next_chunk).running)) {
+      next_chunk++;
+    }
+
+    if (next_chunk == chunks_.size()) {
+      break;
+    }
+
+    StartChunk(worker, next_chunk);
+    any_running = true;
+  }
+
+  if (!any_running) {
+    PrintError(tr("No workers are left to render with"));
+    Finish(false);
+  }
+}
+
+void RenderCoordinator::StartChunk(RenderCoordinator::Worker *worker, int chunk)
+{
+  Chunk& c = chunks_[chunk];
+
+  c.running = true;
+  c.completed = 0;
+  c.attempts++;
+
+  worker->chunk = chunk;
+  worker->buffer.clear();
+  worker->error.clear();
+
+  QStringList arguments = SplitCommand(worker->command);
+  QString program = arguments.takeFirst();
+
+  arguments.append(params_.render.project);
+  arguments.append({"--render", c.output});
+  arguments.append({"--in", QString::number(c.in)});
+  arguments.append({"--out", QString::number(c.out)});
+
+  if (!params_.render.sequence.isEmpty()) {
+    arguments.append({"--sequence", params_.render.sequence});
+  }
+
+  if (!params_.render.codec.isEmpty()) {
+    arguments.append({"--codec", params_.render.codec});
+  }
+
+  if (params_.render.hardware_encoding) {
+    arguments.append("--hardware-encode");
+  }
+
+  worker->process->start(program, arguments);
+}
+
+void RenderCoordinator::ChunkFinished(RenderCoordinator::Worker *worker, bool ok, const QString &message)
+{
+  if (worker->chunk < 0) {
+    return;
+  }
+
+  Chunk& c = chunks_[worker->chunk];
+
+  QJsonObject chunk;
+  chunk.insert("chunk", worker->chunk);
+  chunk.insert("in", static_cast<double>(c.in));
+  chunk.insert("out", static_cast<double>(c.out));
+  chunk.insert("worker", worker->command);
+  chunk.insert("attempt", c.attempts);
+  chunk.insert("ok", ok);
+
+  c.running = false;
+  worker->chunk = -1;
+
+  if (ok) {
+    c.done = true;
+    c.completed = c.out - c.in + 1;
+    worker->failures = 0;
+  } else {
+    c.completed = 0;
+    worker->failures++;
+    chunk.insert("message", message);
+  }
+
+  Print("chunk", chunk);
+
+  if (!ok && c.attempts >= kMaxAttempts) {
+    PrintError(tr("Frames %1-%2 failed to render %n times", nullptr, c.attempts).arg(c.in).arg(c.out));
+    Finish(false);
+    return;
+  }
+
+  PrintProgress();
+
+  Dispatch();
+}
+
+void RenderCoordinator::WorkerLine(RenderCoordinator::Worker *worker, const QByteArray &line)
+{
+  QJsonObject obj = QJsonDocument::fromJson(line).object();
+
+  QString type = obj.value("type").toString();
+
+  if (type == QStringLiteral("progress")) {
+    if (worker->chunk >= 0) {
+      chunks_[worker->chunk].completed = static_cast<int64_t>(obj.value("completed").toDouble());
+      PrintProgress();
+    }
+  } else if (type == QStringLiteral("error")) {
+    worker->error = obj.value("message").toString();
+  }
+}
+
+bool RenderCoordinator::JoinParts()
+{
+  if (!joining_) {
+    return true;
+  }
+
+  QStringList parts;
+
+  foreach (const Chunk& c, chunks_) {
+    parts.append(c.output);
+  }
+
+  VideoConcat concat;
+
+  if (!concat.Concatenate(parts, params_.render.output)) {
+    // The parts are kept so they can be joined some other way
+    PrintError(concat.error());
+    return false;
+  }
+
+  foreach (const QString& part, parts) {
+    QFile::remove(part);
+  }
+
+  return true;
+}
+
+RenderCoordinator::Worker *RenderCoordinator::WorkerOf(QObject *process)
+{
+  for (int i=0;i<workers_.size();i++) {
+    if (workers_.at(i).process == process) {
+      return &workers_[i];
+    }
+  }
+
+  return nullptr;
+}
+
+QStringList RenderCoordinator::SplitCommand(const QString &command)
+{
+  QStringList arguments;
+  QString argument;
+  bool quoted = false;
+  bool has_argument = false;
+
+  foreach (const QChar& c, command) {
+    if (c == '"') {
+      quoted = !quoted;
+      has_argument = true;
+    } else if (c.isSpace() && !quoted) {
+      if (has_argument) {
+        arguments.append(argument);
+        argument.clear();
+        has_argument = false;
+      }
+    } else {
+      argument.append(c);
+      has_argument = true;
+    }
+  }
+
+  if (has_argument) {
+    arguments.append(argument);
+  }
+
+  return arguments;
+}
+
+void RenderCoordinator::PrintProgress()
+{
+  int64_t total = params_.render.out - params_.render.in + 1;
+  int64_t completed = 0;
+
+  foreach (const Chunk& c, chunks_) {
+    completed += c.completed;
+  }
+
+  double seconds = static_cast<double>(timer_.elapsed()) / 1000.0;
+  double fps = (seconds > 0) ? static_cast<double>(completed) / seconds : 0;
+
+  QJsonObject progress;
+  progress.insert("completed", static_cast<double>(completed));
+  progress.insert("total", static_cast<double>(total));
+  progress.insert("percent", 100.0 * static_cast<double>(completed) / static_cast<double>(total));
+  progress.insert("fps", fps);
+  progress.insert("eta", (fps > 0) ? static_cast<double>(total - completed) / fps : 0);
+  Print("progress", progress);
+}
+
+void RenderCoordinator::Print(const QString &type, QJsonObject obj)
+{
+  obj.insert("type", type);
+
+  stdout_.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+  stdout_.write("\n");
+  stdout_.flush();
+}
+
+void RenderCoordinator::PrintError(const QString &message)
+{
+  QJsonObject error;
+  error.insert("message", message);
+  Print("error", error);
+}
+
+void RenderCoordinator::Finish(bool ok)
+{
+  finished_ = true;
+
+  // Chunks still rendering are no use any more
+  for (int i=0;i<workers_.size();i++) {
+    QProcess* process = workers_.at(i).process;
+
+    if (process->state() != QProcess::NotRunning) {
+      process->kill();
+    }
+  }
+
+  int64_t frames = 0;
+
+  foreach (const Chunk& c, chunks_) {
+    if (c.done) {
+      frames += c.out - c.in + 1;
+    }
+  }
+
+  QJsonObject finished;
+  finished.insert("ok", ok);
+  finished.insert("frames", static_cast<double>(frames));
+  finished.insert("seconds", static_cast<double>(timer_.elapsed()) / 1000.0);
+  Print("finished", finished);
+
+  emit Finished(ok);
+}
+
+void RenderCoordinator::WorkerOutput()
+{
+  Worker* worker = WorkerOf(sender());
+
+  if (worker == nullptr || finished_) {
+    return;
+  }
+
+  worker->buffer.append(worker->process->readAllStandardOutput());
+
+  int newline;
+
+  while ((newline = worker->buffer.indexOf('\n')) >= 0) {
+    WorkerLine(worker, worker->buffer.left(newline));
+    worker->buffer.remove(0, newline + 1);
+  }
+}
+
+void RenderCoordinator::WorkerFinished(int exit_code, QProcess::ExitStatus exit_status)
+{
+  Worker* worker = WorkerOf(sender());
+
+  if (worker == nullptr || finished_) {
+    return;
+  }
+
+  // Pick up anything printed right before exiting
+  WorkerOutput();
+
+  bool ok = (exit_status == QProcess::NormalExit && exit_code == 0);
+
+  QString message;
+
+  if (!ok) {
+    if (!worker->error.isEmpty()) {
+      message = worker->error;
+    } else if (exit_status == QProcess::CrashExit) {
+      message = tr("Worker crashed");
+    } else {
+      message = tr("Worker exited with code %1").arg(exit_code);
+    }
+  }
+
+  ChunkFinished(worker, ok, message);
+}
+
+void RenderCoordinator::WorkerError(QProcess::ProcessError error)
+{
+  // Every other error is followed by finished()
+  if (error != QProcess::FailedToStart) {
+    return;
+  }
+
+  Worker* worker = WorkerOf(sender());
+
+  if (worker == nullptr || finished_) {
+    return;
+  }
+
+  ChunkFinished(worker, false, worker->process->errorString());
+}
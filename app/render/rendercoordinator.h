@@ -0,0 +1,203 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERCOORDINATOR_H
+#define RENDERCOORDINATOR_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QProcess>
+
+#include "render/headlessrender.h"
+
+/**
+ * @brief Splits a headless render into chunks of frames and renders them with worker processes
+ *
+ * Every worker is a command that starts Olive, usually on another machine (e.g. "ssh render01 olive"). The project,
+ * media and output must be at the same paths on every machine. Each chunk is rendered by giving a worker command the
+ * same options as a headless render (see HeadlessRender) with the chunk's range. Whichever worker is idle gets the
+ * next chunk, and a chunk that fails is given out again up to kMaxAttempts times. A worker that fails
+ * kMaxWorkerFailures chunks in a row isn't used any more.
+ *
+ * Image sequences are written by the workers straight to their final filenames. Video files are rendered to one file
+ * per chunk next to the output and joined with VideoConcat once every chunk is done. Every chunk is encoded on its own,
+ * so every chunk starts with a keyframe and the parts can be joined without encoding them again.
+ *
+ * Progress is printed like HeadlessRender's, as JSON lines on standard output, with an extra "chunk" type for each
+ * chunk that finishes or fails.
+ */
+class RenderCoordinator : public QObject
+{
+  Q_OBJECT
+public:
+  struct Params {
+    // What to render, chunks are rendered with the same parameters
+    HeadlessRender::Params render;
+
+    // Command line starting each worker, the render options are added to its arguments
+    QStringList workers;
+
+    // Number of frames in each chunk
+    int64_t chunk_frames;
+  };
+
+  RenderCoordinator(QObject* parent = nullptr);
+
+  virtual ~RenderCoordinator() override;
+
+  /**
+   * @brief Split the render into chunks and start a chunk on every worker
+   *
+   * @return
+   *
+   * FALSE if the render couldn't be started, in which case an error has been printed and Finished() won't be
+   * emitted.
+   */
+  bool Start(const Params& params);
+
+  /**
+   * @brief Read worker commands from a file, one per line (empty lines and lines starting with # are skipped)
+   */
+  static QStringList ReadWorkers(const QString& filename);
+
+  /**
+   * @brief How many times a chunk is rendered before the render fails
+   */
+  static const int kMaxAttempts = 3;
+
+  /**
+   * @brief How many chunks in a row a worker can fail before it's no longer used
+   */
+  static const int kMaxWorkerFailures = 2;
+
+signals:
+  /**
+   * @brief Emitted once every chunk has been rendered (and joined) or the render has failed
+   */
+  void Finished(bool ok);
+
+private:
+  struct Chunk {
+    int64_t in;
+    int64_t out;
+
+    // Output the worker is given
+    QString output;
+
+    int attempts;
+
+    bool running;
+
+    // Frames the worker rendering this chunk has reported as completed
+    int64_t completed;
+
+    bool done;
+  };
+
+  struct Worker {
+    QString command;
+
+    QProcess* process;
+
+    // Index of the chunk being rendered, or -1 if the worker is idle
+    int chunk;
+
+    int failures;
+
+    // Standard output that hasn't made up a complete line yet
+    QByteArray buffer;
+
+    // Last error the worker printed, reported if its chunk fails
+    QString error;
+  };
+
+  /**
+   * @brief Give every idle worker the next chunk that hasn't been started, and finish if every chunk is done
+   */
+  void Dispatch();
+
+  /**
+   * @brief Start a chunk on a worker
+   */
+  void StartChunk(Worker* worker, int chunk);
+
+  /**
+   * @brief Mark a worker's chunk as done or failed and make the worker idle
+   */
+  void ChunkFinished(Worker* worker, bool ok, const QString& message);
+
+  /**
+   * @brief Handle a line of JSON printed by a worker
+   */
+  void WorkerLine(Worker* worker, const QByteArray& line);
+
+  /**
+   * @brief Join the parts of a video file (if there are any) and remove them
+   */
+  bool JoinParts();
+
+  /**
+   * @brief Returns the worker running a process
+   */
+  Worker* WorkerOf(QObject* process);
+
+  /**
+   * @brief Split a command line into its program and arguments (arguments can be quoted with ")
+   */
+  static QStringList SplitCommand(const QString& command);
+
+  void PrintProgress();
+
+  void Print(const QString& type, QJsonObject obj);
+
+  void PrintError(const QString& message);
+
+  /**
+   * @brief Stop every worker and emit Finished()
+   */
+  void Finish(bool ok);
+
+  Params params_;
+
+  QList<Chunk> chunks_;
+
+  QList<Worker> workers_;
+
+  // TRUE if the output is a video file that's rendered in parts
+  bool joining_;
+
+  bool finished_;
+
+  QElapsedTimer timer_;
+
+  QFile stdout_;
+
+private slots:
+  void WorkerOutput();
+
+  void WorkerFinished(int exit_code, QProcess::ExitStatus exit_status);
+
+  void WorkerError(QProcess::ProcessError error);
+};
+
+#endif // RENDERCOORDINATOR_H
@@ -0,0 +1,269 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "semiplanarpacker.h"
+
+#include <QOpenGLFunctions>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <cmath>
+
+#include "render/cpurender.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+#include "render/pixelformatconverter.h"
+
+SemiPlanarPacker::SemiPlanarPacker() :
+  ctx_(nullptr)
+{
+}
+
+SemiPlanarPacker::~SemiPlanarPacker()
+{
+  Destroy();
+}
+
+bool SemiPlanarPacker::IsSupported(int width, int height, olive::PixelFormat format)
+{
+  return width > 0 && height > 0 && width % 4 == 0 && height % 2 == 0 && GetAVPixelFormat(format) != AV_PIX_FMT_NONE;
+}
+
+AVPixelFormat SemiPlanarPacker::GetAVPixelFormat(olive::PixelFormat format)
+{
+  switch (format) {
+  case olive::PIX_FMT_RGBA8:
+    return AV_PIX_FMT_NV12;
+  case olive::PIX_FMT_RGBA16:
+    return AV_PIX_FMT_P010LE;
+  default:
+    return AV_PIX_FMT_NONE;
+  }
+}
+
+QSize SemiPlanarPacker::PackedSize(int width, int height)
+{
+  return QSize(width / 4, height + height / 2);
+}
+
+void SemiPlanarPacker::Pack(QOpenGLContext *ctx, GLuint texture, const QSize &texture_size, const QRect &src_rect,
+                            MemoryBuffer *dst, const QPoint &pos, int frame_height, TextureDownloader *downloader,
+                            const TextureDownloader::Callback &callback)
+{
+  if (ctx != ctx_) {
+    Destroy();
+
+    ctx_ = ctx;
+    pipeline_ = olive::gl::GetSemiPlanarPackPipeline();
+  }
+
+  QSize packed = PackedSize(src_rect.width(), src_rect.height());
+  int luma_rows = src_rect.height();
+  int chroma_rows = luma_rows / 2;
+
+  // Tiles at the frame's edges are smaller, so keep the largest buffer needed so far
+  if (!buffer_.IsCreated()
+      || buffer_.format() != dst->format()
+      || buffer_.width() < packed.width()
+      || buffer_.height() < packed.height()) {
+    int width = packed.width();
+    int height = packed.height();
+
+    if (buffer_.IsCreated() && buffer_.format() == dst->format()) {
+      width = qMax(width, buffer_.width());
+      height = qMax(height, buffer_.height());
+    }
+
+    buffer_.Destroy();
+    buffer_.Create(ctx, dst->format(), width, height);
+  }
+
+  Conversion c = GetConversion(dst->format(), frame_height);
+
+  QOpenGLFunctions* f = ctx->functions();
+
+  // The source is read texel by texel on unit 1, leave unit 0 empty so Blit() doesn't build mipmaps for it
+  f->glActiveTexture(GL_TEXTURE1);
+  f->glBindTexture(GL_TEXTURE_2D, texture);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  f->glActiveTexture(GL_TEXTURE0);
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  pipeline_->bind();
+  pipeline_->setUniformValue("texture_size", QVector2D(texture_size.width(), texture_size.height()));
+  pipeline_->setUniformValue("source_origin", QVector2D(src_rect.x(), src_rect.y()));
+  pipeline_->setUniformValue("luma_coefficients", QVector3D(c.kr, c.kg, c.kb));
+  pipeline_->setUniformValue("chroma_coefficients", QVector2D(0.5f / (1.0f - c.kb), 0.5f / (1.0f - c.kr)));
+  pipeline_->setUniformValue("sample_range", QVector4D(c.y_scale, c.y_offset, c.c_scale, c.c_offset));
+  pipeline_->setUniformValue("max_sample", static_cast<float>(c.max_sample));
+  pipeline_->setUniformValue("sample_to_output", c.sample_to_output);
+
+  buffer_.BindBuffer();
+
+  // Y' plane at the bottom of the buffer, CbCr plane above it
+  f->glViewport(0, 0, packed.width(), luma_rows);
+  pipeline_->setUniformValue("viewport_origin", QVector2D(0, 0));
+  pipeline_->setUniformValue("chroma", 0.0f);
+  olive::gl::Blit(pipeline_);
+
+  f->glViewport(0, luma_rows, packed.width(), chroma_rows);
+  pipeline_->bind();
+  pipeline_->setUniformValue("viewport_origin", QVector2D(0, luma_rows));
+  pipeline_->setUniformValue("chroma", 1.0f);
+  olive::gl::Blit(pipeline_);
+
+  buffer_.ReleaseBuffer();
+
+  pipeline_->release();
+
+  f->glActiveTexture(GL_TEXTURE1);
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+  f->glActiveTexture(GL_TEXTURE0);
+
+  // Read both planes straight into their places in the frame, they finish in order so the callback goes on the last
+  int sample_size = PixelService::BytesPerPixel(dst->format()) / 4;
+
+  downloader->Download(buffer_.texture(),
+                       dst->format(),
+                       QRect(0, 0, packed.width(), luma_rows),
+                       dst->row(pos.y()) + pos.x() * sample_size,
+                       dst->linesize());
+
+  downloader->Download(buffer_.texture(),
+                       dst->format(),
+                       QRect(0, luma_rows, packed.width(), chroma_rows),
+                       dst->row(frame_height + pos.y() / 2) + pos.x() * sample_size,
+                       dst->linesize(),
+                       callback);
+}
+
+void SemiPlanarPacker::PackBuffer(const MemoryBuffer &src, const QRect &src_rect, MemoryBuffer *dst,
+                                  const QPoint &pos, int frame_height)
+{
+  Conversion c = GetConversion(dst->format(), frame_height);
+
+  bool wide = (dst->format() == olive::PIX_FMT_RGBA16);
+  int sample_size = wide ? 2 : 1;
+
+  float cb_scale = 0.5f / (1.0f - c.kb);
+  float cr_scale = 0.5f / (1.0f - c.kr);
+
+  auto store = [&c, wide](uint8_t* samples, int index, float value) {
+    int sample = qBound(0, static_cast<int>(std::floor(value + 0.5f)), c.max_sample);
+
+    if (wide) {
+      // P010 keeps its 10 bits at the top of each word
+      reinterpret_cast<uint16_t*>(samples)[index] = static_cast<uint16_t>(sample << 6);
+    } else {
+      samples[index] = static_cast<uint8_t>(sample);
+    }
+  };
+
+  olive::cpu::ForEachStripe(src_rect.height() / 2, src_rect.width(), [&](int start, int end) {
+    for (int j=start;j<end;j++) {
+      const float* rows[2];
+
+      // Two rows of Y' for each row of CbCr
+      for (int k=0;k<2;k++) {
+        int y = 2 * j + k;
+
+        rows[k] = reinterpret_cast<const float*>(src.const_row(src_rect.y() + y)) + src_rect.x() * 4;
+
+        uint8_t* luma = dst->row(pos.y() + y) + pos.x() * sample_size;
+
+        for (int x=0;x<src_rect.width();x++) {
+          const float* px = rows[k] + x * 4;
+
+          store(luma, x, (px[0] * c.kr + px[1] * c.kg + px[2] * c.kb) * c.y_scale + c.y_offset);
+        }
+      }
+
+      uint8_t* chroma = dst->row(frame_height + pos.y() / 2 + j) + pos.x() * sample_size;
+
+      for (int x=0;x<src_rect.width()/2;x++) {
+        float rgb[3];
+
+        // Average each 2x2 block before converting (the conversion is linear, so it's the same either way)
+        for (int i=0;i<3;i++) {
+          rgb[i] = 0.25f * (rows[0][x * 8 + i] + rows[0][x * 8 + 4 + i] + rows[1][x * 8 + i] + rows[1][x * 8 + 4 + i]);
+        }
+
+        float y = rgb[0] * c.kr + rgb[1] * c.kg + rgb[2] * c.kb;
+
+        store(chroma, x * 2, (rgb[2] - y) * cb_scale * c.c_scale + c.c_offset);
+        store(chroma, x * 2 + 1, (rgb[0] - y) * cr_scale * c.c_scale + c.c_offset);
+      }
+    }
+  });
+}
+
+void SemiPlanarPacker::GetPlanes(const MemoryBuffer &src, int frame_height, const uint8_t *data[4], int linesize[4])
+{
+  int chroma_rows = frame_height / 2;
+
+  data[0] = src.const_row(frame_height - 1);
+  data[1] = src.const_row(frame_height + chroma_rows - 1);
+  data[2] = nullptr;
+  data[3] = nullptr;
+
+  linesize[0] = -src.linesize();
+  linesize[1] = -src.linesize();
+  linesize[2] = 0;
+  linesize[3] = 0;
+}
+
+void SemiPlanarPacker::Destroy()
+{
+  if (ctx_ != nullptr) {
+    buffer_.Destroy();
+
+    pipeline_ = nullptr;
+
+    ctx_ = nullptr;
+  }
+}
+
+SemiPlanarPacker::Conversion SemiPlanarPacker::GetConversion(olive::PixelFormat format, int frame_height)
+{
+  // The same matrix the frame would be decoded with if it were imported again
+  olive::pixel::YUVMatrix matrix = PixelFormatConverter::GetYUVMatrix(AVCOL_SPC_UNSPECIFIED, frame_height);
+
+  Conversion c;
+
+  // Work the luma coefficients back out of the decoding matrix (cr_r = 2 - 2Kr and cb_b = 2 - 2Kb)
+  c.kr = 1.0f - 0.5f * matrix.cr_r;
+  c.kb = 1.0f - 0.5f * matrix.cb_b;
+  c.kg = 1.0f - c.kr - c.kb;
+
+  int bit_depth = (format == olive::PIX_FMT_RGBA16) ? 10 : 8;
+  float depth_scale = static_cast<float>(1 << (bit_depth - 8));
+
+  c.y_scale = 219.0f * depth_scale;
+  c.y_offset = 16.0f * depth_scale;
+  c.c_scale = 224.0f * depth_scale;
+  c.c_offset = 128.0f * depth_scale;
+
+  c.max_sample = (1 << bit_depth) - 1;
+  c.sample_to_output = (bit_depth > 8) ? 64.0f / 65535.0f : 1.0f / 255.0f;
+
+  return c;
+}
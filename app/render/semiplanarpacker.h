@@ -0,0 +1,177 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SEMIPLANARPACKER_H
+#define SEMIPLANARPACKER_H
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+#include <QOpenGLContext>
+#include <QRect>
+
+#include "render/gl/shaderptr.h"
+#include "render/memorybuffer.h"
+#include "render/texturebuffer.h"
+#include "render/texturedownloader.h"
+
+/**
+ * @brief Converts rendered RGBA frames to 4:2:0 semi-planar Y'CbCr for encoding
+ *
+ * Rather than reading frames back as RGBA and converting them on the CPU, the conversion is drawn on the GPU and only
+ * the Y'CbCr samples are read back: 1.5 bytes per pixel for NV12 compared to 4 for RGBA8, or 3 for P010 compared to 8
+ * for RGBA16.
+ *
+ * The samples are packed into a MemoryBuffer of the frame's RGBA format so they can be read back like any other
+ * frame: each RGBA pixel holds four samples, so the buffer is a quarter of the frame's width (see PackedSize()). Rows
+ * 0 to height-1 hold the Y' plane and the rows after them hold the interleaved CbCr plane, both with OpenGL's
+ * bottom-left origin like every other frame read back. GetPlanes() hands it to FFmpeg.
+ *
+ * PIX_FMT_RGBA8 frames become NV12 and PIX_FMT_RGBA16 frames become P010, using the matrix Olive assumes for untagged
+ * footage of the same height (see PixelFormatConverter::GetYUVMatrix()) at limited range. Frames must be a multiple of
+ * 4 pixels wide and 2 pixels high (see IsSupported()).
+ *
+ * One instance should be used per OpenGL context.
+ */
+class SemiPlanarPacker
+{
+public:
+  SemiPlanarPacker();
+
+  ~SemiPlanarPacker();
+
+  SemiPlanarPacker(const SemiPlanarPacker& other) = delete;
+  SemiPlanarPacker(SemiPlanarPacker&& other) = delete;
+  SemiPlanarPacker& operator=(const SemiPlanarPacker& other) = delete;
+  SemiPlanarPacker& operator=(SemiPlanarPacker&& other) = delete;
+
+  /**
+   * @brief Returns TRUE if frames of this size and format can be packed
+   */
+  static bool IsSupported(int width, int height, olive::PixelFormat format);
+
+  /**
+   * @brief Returns the FFmpeg pixel format frames of an olive::PixelFormat are packed into
+   */
+  static AVPixelFormat GetAVPixelFormat(olive::PixelFormat format);
+
+  /**
+   * @brief Returns the size of the MemoryBuffer a frame is packed into
+   */
+  static QSize PackedSize(int width, int height);
+
+  /**
+   * @brief Convert part of a texture and read it back into its place in a packed frame
+   *
+   * `ctx` must be current. Only the samples are read back, the conversion is drawn on the GPU.
+   *
+   * @param texture
+   *
+   * Texture holding the region (e.g. a tile with its margins), in the same format as `dst`.
+   *
+   * @param texture_size
+   *
+   * Size of `texture`.
+   *
+   * @param src_rect
+   *
+   * Region of `texture` to convert. Its width must be a multiple of 4 and its height a multiple of 2.
+   *
+   * @param dst
+   *
+   * Packed frame created at PackedSize().
+   *
+   * @param pos
+   *
+   * Where the region is in the frame, must be a multiple of 4 horizontally and 2 vertically.
+   *
+   * @param frame_height
+   *
+   * Height of the whole frame.
+   *
+   * @param downloader
+   *
+   * Downloader the samples are read back through. `dst` doesn't contain them until `callback` has been called.
+   *
+   * @param callback
+   *
+   * Called by `downloader` once both planes have been read back.
+   */
+  void Pack(QOpenGLContext* ctx, GLuint texture, const QSize& texture_size, const QRect& src_rect, MemoryBuffer* dst,
+            const QPoint& pos, int frame_height, TextureDownloader* downloader,
+            const TextureDownloader::Callback& callback);
+
+  /**
+   * @brief Convert part of an RGBA32F buffer into its place in a packed frame on the CPU
+   *
+   * The software equivalent of Pack(), for frames rendered without a GPU. Same requirements as Pack().
+   */
+  static void PackBuffer(const MemoryBuffer& src, const QRect& src_rect, MemoryBuffer* dst, const QPoint& pos,
+                         int frame_height);
+
+  /**
+   * @brief Point FFmpeg plane pointers at a packed frame
+   *
+   * The pointers start at the top row of each plane with negative linesizes, so the frame reads with FFmpeg's top-left
+   * origin (e.g. as the source of sws_scale()).
+   */
+  static void GetPlanes(const MemoryBuffer& src, int frame_height, const uint8_t* data[4], int linesize[4]);
+
+  /**
+   * @brief Free the conversion buffer and pipeline
+   *
+   * Must be called with the context used for Pack() current. Also called automatically on destruction.
+   */
+  void Destroy();
+
+private:
+  /**
+   * @brief Coefficients and sample ranges of a conversion
+   */
+  struct Conversion {
+    // Luma coefficients of R', G' and B'
+    float kr;
+    float kg;
+    float kb;
+
+    // Integer sample = normalized value * scale + offset
+    float y_scale;
+    float y_offset;
+    float c_scale;
+    float c_offset;
+
+    // Largest integer sample, and the multiplier from an integer sample to the normalized value stored in the
+    // buffer's format (P010 stores samples in the high bits)
+    int max_sample;
+    float sample_to_output;
+  };
+
+  static Conversion GetConversion(olive::PixelFormat format, int frame_height);
+
+  QOpenGLContext* ctx_;
+
+  // Packed region, reallocated when a larger one comes along
+  TextureBuffer buffer_;
+
+  ShaderPtr pipeline_;
+};
+
+#endif // SEMIPLANARPACKER_H
@@ -0,0 +1,251 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "spillcache.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <cstring>
+
+#include "channelpacker.h"
+
+/**
+ * @brief Header of a spill file, followed by the qCompress()'d pixels packed in `layout`
+ */
+struct SpillHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t format;
+  int32_t linesize;
+
+  // ChannelPacker::Layout
+  int32_t layout;
+};
+
+const char kSpillMagic[4] = {'O', 'V', 'S', 'P'};
+const uint32_t kSpillVersion = 2;
+
+// Default disk budget
+const qint64 kDefaultSpillBudget = Q_INT64_C(16) * 1024 * 1024 * 1024;
+
+SpillCache::SpillCache() :
+  next_id_(0),
+  used_bytes_(0),
+  budget_(kDefaultSpillBudget)
+{
+  // Separate directory for each process so multiple instances don't collide
+  QDir spill_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("spill"));
+  directory_ = spill_dir.filePath(QString::number(QCoreApplication::applicationPid()));
+}
+
+SpillCache::~SpillCache()
+{
+  Clear();
+
+  QDir(directory_).removeRecursively();
+}
+
+int SpillCache::Write(MemoryBuffer *buffer, QVector<int> *evicted)
+{
+  if (!buffer->IsCreated()) {
+    return -1;
+  }
+
+  // Opaque and greyscale buffers are stored without the channels that are the same everywhere
+  ChannelPacker::Layout layout;
+  QByteArray compressed = qCompress(ChannelPacker::Pack(*buffer, &layout), 1);
+
+  qint64 file_size = static_cast<qint64>(sizeof(SpillHeader)) + compressed.size();
+
+  QMutexLocker locker(&mutex_);
+
+  // Make space within the budget
+  while (used_bytes_ + file_size > budget_ && !spills_.isEmpty()) {
+    int oldest = spills_.firstKey();
+
+    RemoveInternal(oldest);
+
+    if (evicted != nullptr) {
+      evicted->append(oldest);
+    }
+  }
+
+  if (file_size > budget_) {
+    return -1;
+  }
+
+  int id = next_id_;
+  next_id_++;
+
+  locker.unlock();
+
+  QDir().mkpath(directory_);
+
+  QFile file(GetFilename(id));
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open spill file" << file.fileName();
+    return -1;
+  }
+
+  SpillHeader header;
+  memcpy(header.magic, kSpillMagic, sizeof(kSpillMagic));
+  header.version = kSpillVersion;
+  header.width = buffer->width();
+  header.height = buffer->height();
+  header.format = buffer->format();
+  header.linesize = buffer->linesize();
+  header.layout = layout;
+
+  bool ok = (file.write(reinterpret_cast<const char*>(&header), sizeof(SpillHeader))
+             == static_cast<qint64>(sizeof(SpillHeader)))
+      && (file.write(compressed) == compressed.size());
+
+  file.close();
+
+  if (!ok) {
+    qWarning() << "Failed to write spill file" << file.fileName();
+    file.remove();
+    return -1;
+  }
+
+  locker.relock();
+
+  spills_.insert(id, file_size);
+  used_bytes_ += file_size;
+
+  return id;
+}
+
+bool SpillCache::Read(int id, MemoryBuffer *buffer)
+{
+  {
+    // Take the spill out of the bookkeeping so the file can be read without holding the lock
+    QMutexLocker locker(&mutex_);
+
+    QMap<int, qint64>::iterator spill = spills_.find(id);
+
+    if (spill == spills_.end()) {
+      return false;
+    }
+
+    used_bytes_ -= spill.value();
+    spills_.erase(spill);
+  }
+
+  QFile file(GetFilename(id));
+
+  bool ok = false;
+
+  if (file.open(QFile::ReadOnly) && file.size() > static_cast<qint64>(sizeof(SpillHeader))) {
+    uchar* map = file.map(0, file.size());
+
+    if (map != nullptr) {
+      const SpillHeader* header = reinterpret_cast<const SpillHeader*>(map);
+
+      if (memcmp(header->magic, kSpillMagic, sizeof(kSpillMagic)) == 0
+          && header->version == kSpillVersion
+          && header->format >= 0
+          && header->format < olive::PIX_FMT_COUNT
+          && header->layout >= 0
+          && header->layout < ChannelPacker::kLayoutCount) {
+        QByteArray data = qUncompress(map + sizeof(SpillHeader),
+                                      static_cast<int>(file.size() - static_cast<qint64>(sizeof(SpillHeader))));
+
+        buffer->Create(header->width, header->height, static_cast<olive::PixelFormat>(header->format));
+
+        // The linesize only changes if the padding rules changed, which makes the spill useless
+        ok = (buffer->IsCreated()
+              && buffer->linesize() == header->linesize
+              && ChannelPacker::Unpack(data, static_cast<ChannelPacker::Layout>(header->layout), buffer));
+      }
+
+      file.unmap(map);
+    }
+
+    file.close();
+  }
+
+  file.remove();
+
+  return ok;
+}
+
+void SpillCache::Remove(int id)
+{
+  QMutexLocker locker(&mutex_);
+
+  RemoveInternal(id);
+}
+
+void SpillCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  while (!spills_.isEmpty()) {
+    RemoveInternal(spills_.firstKey());
+  }
+}
+
+qint64 SpillCache::used_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return used_bytes_;
+}
+
+qint64 SpillCache::budget()
+{
+  QMutexLocker locker(&mutex_);
+
+  return budget_;
+}
+
+void SpillCache::set_budget(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  budget_ = bytes;
+}
+
+QString SpillCache::GetFilename(int id)
+{
+  return QDir(directory_).filePath(QString::number(id));
+}
+
+void SpillCache::RemoveInternal(int id)
+{
+  QMap<int, qint64>::iterator spill = spills_.find(id);
+
+  if (spill == spills_.end()) {
+    return;
+  }
+
+  QFile::remove(GetFilename(id));
+
+  used_bytes_ -= spill.value();
+  spills_.erase(spill);
+}
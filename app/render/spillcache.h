@@ -0,0 +1,126 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SPILLCACHE_H
+#define SPILLCACHE_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "memorybuffer.h"
+
+/**
+ * @brief Disk tier for MemoryBuffers evicted from the ImageCache
+ *
+ * Rendering a frame is often far more expensive than reading it back from disk, so rather than discarding the
+ * contents of a MemoryBuffer when RAM runs out, the ImageCache writes it here and reads it back the next time it's
+ * needed.
+ *
+ * Opaque buffers are stored without their alpha channel and grey ones with a single channel (see ChannelPacker).
+ * Buffers are compressed with zlib at its fastest level (qCompress()) and read back through memory-mapped files. Each
+ * spill is identified by an integer ID returned from Write(). Spills are one-shot: Read() and Remove() both delete the
+ * file.
+ *
+ * The directory is private to this process and is deleted on destruction. All functions are thread-safe.
+ */
+class SpillCache
+{
+public:
+  SpillCache();
+
+  /**
+   * @brief Destructor, deletes all spill files
+   */
+  ~SpillCache();
+
+  SpillCache(const SpillCache& other) = delete;
+  SpillCache(SpillCache&& other) = delete;
+  SpillCache& operator=(const SpillCache& other) = delete;
+  SpillCache& operator=(SpillCache&& other) = delete;
+
+  /**
+   * @brief Write a MemoryBuffer's contents to disk
+   *
+   * @param evicted
+   *
+   * If writing this buffer exceeded the disk budget, the IDs of the older spills that were removed to make space are
+   * appended here (may be nullptr).
+   *
+   * @return
+   *
+   * ID to pass to Read() or Remove(), or -1 if the buffer couldn't be written.
+   */
+  int Write(MemoryBuffer* buffer, QVector<int>* evicted);
+
+  /**
+   * @brief Read a spill back into a MemoryBuffer and delete it
+   *
+   * The buffer is (re)created with the spilled format and size.
+   *
+   * @return
+   *
+   * TRUE on success, FALSE if the spill no longer exists or couldn't be read.
+   */
+  bool Read(int id, MemoryBuffer* buffer);
+
+  /**
+   * @brief Delete a spill without reading it
+   */
+  void Remove(int id);
+
+  /**
+   * @brief Delete all spills
+   */
+  void Clear();
+
+  /**
+   * @brief Returns the number of bytes the spill files use on disk
+   */
+  qint64 used_bytes();
+
+  qint64 budget();
+
+  /**
+   * @brief Set the maximum number of bytes the spill files may use on disk, the oldest spills are deleted first
+   */
+  void set_budget(qint64 bytes);
+
+private:
+  QString GetFilename(int id);
+
+  void RemoveInternal(int id);
+
+  QString directory_;
+
+  // Size on disk of each spill, IDs only ever increase so the first is always the oldest
+  QMap<int, qint64> spills_;
+
+  int next_id_;
+
+  qint64 used_bytes_;
+
+  qint64 budget_;
+
+  QMutex mutex_;
+};
+
+#endif // SPILLCACHE_H
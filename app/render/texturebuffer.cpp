@@ -23,10 +23,17 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLExtraFunctions>
 
+#include "render/gl/functions.h"
+#include "render/texturepool.h"
+
 TextureBuffer::TextureBuffer() :
   ctx_(nullptr),
   buffer_(0),
-  texture_(0)
+  texture_(0),
+  width_(0),
+  height_(0),
+  format_(olive::PIX_FMT_RGBA8),
+  tag_(AllocationCounters::kOther)
 {}
 
 TextureBuffer::~TextureBuffer()
@@ -46,52 +53,31 @@ void TextureBuffer::Create(QOpenGLContext *ctx, const olive::PixelFormat &format
 
   // set context to new context provided
   ctx_ = ctx;
+  width_ = width;
+  height_ = height;
+  format_ = format;
+  tag_ = AllocationCounters::CurrentTag();
 
-  QOpenGLFunctions* f = ctx->functions();
+  AllocationCounters::Allocated(AllocationCounters::kTextureBuffer, tag_, bytes());
 
-  // create framebuffer object
-  f->glGenFramebuffers(1, &buffer_);
+  QOpenGLFunctions* f = ctx->functions();
 
-  // create texture
-  f->glGenTextures(1, &texture_);
+  // get framebuffer object and texture, reusing ones that were released earlier where possible
+  buffer_ = olive::texture_pool.AcquireFramebuffer(ctx);
+  texture_ = olive::texture_pool.AcquireTexture(ctx, format, width, height);
 
   // bind framebuffer for attaching
   f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, buffer_);
 
-  // bind texture
-  f->glBindTexture(GL_TEXTURE_2D, texture_);
-
-  // allocate storage for texture
-  const PixelFormatInfo& bit_depth = PixelService::GetPixelFormatInfo(format);
-
-  ctx->functions()->glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        bit_depth.internal_format,
-        width,
-        height,
-        0,
-        bit_depth.pixel_format,
-        bit_depth.pixel_type,
-        nullptr
-        );
-
-  // set texture filtering to bilinear
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
   // attach texture to framebuffer
   ctx->extraFunctions()->glFramebufferTexture2D(
         GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0
         );
 
-  // clear new texture
+  // clear new texture (a reused one still has whatever was drawn on it last)
   ctx->functions()->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   ctx->functions()->glClear(GL_COLOR_BUFFER_BIT);
 
-  // release texture
-  f->glBindTexture(GL_TEXTURE_2D, 0);
-
   // release framebuffer
   f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
@@ -99,9 +85,14 @@ void TextureBuffer::Create(QOpenGLContext *ctx, const olive::PixelFormat &format
 void TextureBuffer::Destroy()
 {
   if (ctx_ != nullptr) {
-    ctx_->functions()->glDeleteFramebuffers(1, &buffer_);
+    AllocationCounters::Freed(AllocationCounters::kTextureBuffer, tag_, bytes());
+
+    olive::gl::ForgetTexture(texture_);
+
+    // hand both back to the pool for the next buffer of this size to use
+    olive::texture_pool.ReleaseFramebuffer(ctx_, buffer_);
 
-    ctx_->functions()->glDeleteTextures(1, &texture_);
+    olive::texture_pool.ReleaseTexture(ctx_, format_, width_, height_, texture_);
 
     ctx_ = nullptr;
   }
@@ -113,6 +104,9 @@ void TextureBuffer::BindBuffer() const
     return;
   }
   ctx_->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, buffer_);
+
+  // Anything drawn now modifies the texture, so its mipmaps will need regenerating
+  olive::gl::MarkTextureModified(texture_);
 }
 
 void TextureBuffer::ReleaseBuffer() const
@@ -148,3 +142,23 @@ const GLuint &TextureBuffer::texture() const
 {
   return texture_;
 }
+
+const int &TextureBuffer::width() const
+{
+  return width_;
+}
+
+const int &TextureBuffer::height() const
+{
+  return height_;
+}
+
+const olive::PixelFormat &TextureBuffer::format() const
+{
+  return format_;
+}
+
+qint64 TextureBuffer::bytes() const
+{
+  return static_cast<qint64>(width_) * static_cast<qint64>(height_) * PixelService::BytesPerPixel(format_);
+}
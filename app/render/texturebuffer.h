@@ -23,6 +23,7 @@
 
 #include <QOpenGLContext>
 
+#include "allocationcounters.h"
 #include "pixelformat.h"
 
 /**
@@ -46,15 +47,30 @@ public:
   const GLuint& buffer() const;
   const GLuint& texture() const;
 
+  const int& width() const;
+  const int& height() const;
+  const olive::PixelFormat& format() const;
+
   void BindBuffer() const;
   void ReleaseBuffer() const;
 
   void BindTexture() const;
   void ReleaseTexture() const;
 private:
+  /**
+   * @brief Bytes of VRAM the texture's base level takes
+   */
+  qint64 bytes() const;
+
   QOpenGLContext* ctx_;
   GLuint buffer_;
   GLuint texture_;
+  int width_;
+  int height_;
+  olive::PixelFormat format_;
+
+  // What the texture is counted under in AllocationCounters
+  AllocationCounters::Tag tag_;
 };
 
 #endif // FRAMEBUFFEROBJECT_H
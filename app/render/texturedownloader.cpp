@@ -0,0 +1,267 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "texturedownloader.h"
+
+#include <cstring>
+
+#include <QDebug>
+#include <QOpenGLFunctions>
+
+#include "common/tracing.h"
+#include "render/performancecounters.h"
+
+// Amount of time (in nanoseconds) to wait for a fence at once before checking again
+const GLuint64 kFenceTimeout = 1000000000;
+
+TextureDownloader::TextureDownloader() :
+  ctx_(nullptr),
+  next_slot_(0),
+  framebuffer_(0)
+{
+}
+
+TextureDownloader::~TextureDownloader()
+{
+  Destroy();
+}
+
+bool TextureDownloader::IsCreated()
+{
+  return (ctx_ != nullptr);
+}
+
+void TextureDownloader::Create(QOpenGLContext *ctx, int ring_size)
+{
+  Destroy();
+
+  ctx_ = ctx;
+
+  ring_.resize(ring_size);
+
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[i];
+
+    ctx_->functions()->glGenBuffers(1, &pbo.buffer);
+    pbo.fence = nullptr;
+    pbo.size = 0;
+    pbo.row_size = 0;
+    pbo.rows = 0;
+    pbo.dst = nullptr;
+    pbo.linesize = 0;
+  }
+
+  ctx_->functions()->glGenFramebuffers(1, &framebuffer_);
+
+  next_slot_ = 0;
+}
+
+void TextureDownloader::Destroy()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  Finish();
+
+  for (int i=0;i<ring_.size();i++) {
+    ctx_->functions()->glDeleteBuffers(1, &ring_[i].buffer);
+  }
+
+  ring_.clear();
+
+  ctx_->functions()->glDeleteFramebuffers(1, &framebuffer_);
+  framebuffer_ = 0;
+
+  ctx_ = nullptr;
+}
+
+void TextureDownloader::Discard()
+{
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[(next_slot_ + i) % ring_.size()];
+
+    if (pbo.fence != nullptr) {
+      ctx_->extraFunctions()->glDeleteSync(pbo.fence);
+      pbo.fence = nullptr;
+
+      EndDownload(pbo, false);
+    }
+  }
+}
+
+void TextureDownloader::Download(GLuint texture, olive::PixelFormat format, const QRect &rect, uint8_t *dst,
+                                 int linesize, const TextureDownloader::Callback &callback)
+{
+  Tracing::Span span("readback", "TextureDownloader::Download");
+
+  if (ctx_ == nullptr) {
+    if (callback) {
+      callback(false);
+    }
+    return;
+  }
+
+  // Downloads finish in order so the next slot is always the oldest, wait for it if it's still in flight
+  PixelBuffer& pbo = ring_[next_slot_];
+  next_slot_ = (next_slot_ + 1) % ring_.size();
+
+  if (pbo.fence != nullptr) {
+    FinishDownload(pbo, true);
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  const PixelFormatInfo& info = PixelService::GetPixelFormatInfo(format);
+
+  // Rows are packed tightly in the PBO and spread out to the destination's linesize when they're copied
+  int row_size = rect.width() * info.bytes_per_pixel;
+  int size = row_size * rect.height();
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.buffer);
+
+  if (pbo.size < size) {
+    xf->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    pbo.size = size;
+  }
+
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+  xf->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  // Queue the read into the PBO, with a PBO bound the data pointer is an offset into it
+  xf->glReadPixels(rect.x(), rect.y(), rect.width(), rect.height(), info.pixel_format, info.pixel_type, nullptr);
+
+  xf->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+  xf->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  pbo.fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  pbo.row_size = row_size;
+  pbo.rows = rect.height();
+  pbo.dst = dst;
+  pbo.linesize = linesize;
+  pbo.callback = callback;
+
+  // Make sure the commands start executing now rather than whenever the driver decides to flush
+  xf->glFlush();
+}
+
+int TextureDownloader::Poll()
+{
+  int in_flight = 0;
+
+  // Start from the oldest download, later ones can't finish before it
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[(next_slot_ + i) % ring_.size()];
+
+    if (pbo.fence == nullptr) {
+      continue;
+    }
+
+    if (in_flight > 0 || !FinishDownload(pbo, false)) {
+      in_flight++;
+    }
+  }
+
+  return in_flight;
+}
+
+void TextureDownloader::Finish()
+{
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[(next_slot_ + i) % ring_.size()];
+
+    if (pbo.fence != nullptr) {
+      FinishDownload(pbo, true);
+    }
+  }
+}
+
+bool TextureDownloader::FinishDownload(TextureDownloader::PixelBuffer &pbo, bool wait)
+{
+  Tracing::Span span("readback", "TextureDownloader::FinishDownload");
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  GLenum status;
+
+  do {
+    status = xf->glClientWaitSync(pbo.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? kFenceTimeout : 0);
+  } while (wait && status == GL_TIMEOUT_EXPIRED);
+
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+
+  xf->glDeleteSync(pbo.fence);
+  pbo.fence = nullptr;
+
+  bool ok = false;
+
+  if (status == GL_WAIT_FAILED) {
+    qWarning() << "Failed to wait for texture download";
+  } else {
+    // Counted as part of the readback that queued it
+    PerformanceCounters::ScopedTimer timer(PerformanceCounters::kReadback, 0);
+
+    xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.buffer);
+
+    const uint8_t* memory = static_cast<const uint8_t*>(xf->glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                                                              0,
+                                                                              pbo.row_size * pbo.rows,
+                                                                              GL_MAP_READ_BIT));
+
+    if (memory == nullptr) {
+      qWarning() << "Failed to map pixel buffer";
+    } else {
+      for (int i=0;i<pbo.rows;i++) {
+        memcpy(pbo.dst + i * pbo.linesize, memory + i * pbo.row_size, static_cast<size_t>(pbo.row_size));
+      }
+
+      xf->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+      ok = true;
+    }
+
+    xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  EndDownload(pbo, ok);
+
+  return true;
+}
+
+void TextureDownloader::EndDownload(TextureDownloader::PixelBuffer &pbo, bool ok)
+{
+  // Clear the download before running the callback in case it queues another
+  Callback callback = pbo.callback;
+
+  pbo.dst = nullptr;
+  pbo.callback = nullptr;
+
+  if (callback) {
+    callback(ok);
+  }
+}
@@ -0,0 +1,159 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TEXTUREDOWNLOADER_H
+#define TEXTUREDOWNLOADER_H
+
+#include <functional>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QRect>
+#include <QVector>
+
+#include "pixelformat.h"
+
+/**
+ * @brief Asynchronously reads textures back into memory through a ring of pixel buffer objects
+ *
+ * The counterpart to TextureUploader. A plain glReadPixels into system memory blocks until the GPU has finished
+ * rendering and the pixels have crossed the bus. Reading into a pixel buffer object (PBO) instead returns immediately,
+ * so the next frame can be rendered while the previous one is transferred. RendererThread reads frames back through
+ * this when they're exported (see RendererProcessor::SetReadbackEnabled()) or saved to the DiskFrameCache.
+ *
+ * Queue a download with Download(), then call Poll() regularly (e.g. after rendering each frame) to finish any
+ * downloads that are ready. Downloads finish in the order they were queued, and each one's callback is run from
+ * Poll() (or Finish()) once its pixels are in memory. Since GL commands run in order, the texture can be drawn to
+ * again as soon as Download() returns.
+ *
+ * After creating a new TextureDownloader, call Create() when a valid OpenGL context is available. All functions must
+ * be called with that context current.
+ */
+class TextureDownloader
+{
+public:
+  /**
+   * @brief Called when a download has finished, with FALSE if the pixels couldn't be read (e.g. see Discard())
+   */
+  using Callback = std::function<void(bool ok)>;
+
+  TextureDownloader();
+  ~TextureDownloader();
+
+  TextureDownloader(const TextureDownloader& other) = delete;
+  TextureDownloader(TextureDownloader&& other) = delete;
+  TextureDownloader& operator=(const TextureDownloader& other) = delete;
+  TextureDownloader& operator=(TextureDownloader&& other) = delete;
+
+  bool IsCreated();
+
+  /**
+   * @brief Create the PBO ring
+   *
+   * @param ring_size
+   *
+   * Number of PBOs to cycle through, and therefore the number of downloads that can be in flight at once.
+   */
+  void Create(QOpenGLContext* ctx, int ring_size = 4);
+
+  /**
+   * @brief Free the PBO ring, any downloads still in flight are finished first
+   */
+  void Destroy();
+
+  /**
+   * @brief Drop every download in flight without reading it, their callbacks are run with FALSE
+   *
+   * For when the context has been lost and whatever is in the PBOs is garbage.
+   */
+  void Discard();
+
+  /**
+   * @brief Queue a read of part of a texture
+   *
+   * If every PBO in the ring is in flight, this waits for the oldest download to finish.
+   *
+   * @param rect
+   *
+   * Region of the texture to read.
+   *
+   * @param dst
+   *
+   * Where the first row of `rect` goes, with the rows after it `linesize` bytes apart. Must stay valid until
+   * `callback` is called.
+   *
+   * @param callback
+   *
+   * Called from Poll() (or Finish()) once `dst` contains the pixels.
+   */
+  void Download(GLuint texture, olive::PixelFormat format, const QRect& rect, uint8_t* dst, int linesize,
+                const Callback& callback = nullptr);
+
+  /**
+   * @brief Finish any downloads that the GPU has completed without waiting
+   *
+   * @return
+   *
+   * Number of downloads that are still in flight.
+   */
+  int Poll();
+
+  /**
+   * @brief Wait for every download in flight to finish
+   */
+  void Finish();
+
+private:
+  struct PixelBuffer {
+    GLuint buffer;
+    GLsync fence;
+    int size;
+    int row_size;
+    int rows;
+    uint8_t* dst;
+    int linesize;
+    Callback callback;
+  };
+
+  /**
+   * @brief Copy a PBO into its destination and run the callback, waiting for the GPU if `wait` is TRUE
+   *
+   * @return
+   *
+   * TRUE if the download finished, FALSE if it's still in flight (only if `wait` is FALSE).
+   */
+  bool FinishDownload(PixelBuffer& pbo, bool wait);
+
+  /**
+   * @brief Clear a finished (or discarded) download and run its callback
+   */
+  static void EndDownload(PixelBuffer& pbo, bool ok);
+
+  QOpenGLContext* ctx_;
+
+  QVector<PixelBuffer> ring_;
+
+  int next_slot_;
+
+  // Framebuffer textures are attached to for reading
+  GLuint framebuffer_;
+};
+
+#endif // TEXTUREDOWNLOADER_H
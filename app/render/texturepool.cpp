@@ -0,0 +1,312 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "texturepool.h"
+
+#include <QMutexLocker>
+#include <QOpenGLFunctions>
+
+TexturePool olive::texture_pool;
+
+const qint64 TexturePool::kDefaultMaxCachedBytes = Q_INT64_C(512) * 1024 * 1024;
+
+TexturePool::TexturePool() :
+  cached_bytes_(0),
+  max_cached_bytes_(kDefaultMaxCachedBytes),
+  hits_(0),
+  misses_(0)
+{
+}
+
+GLuint TexturePool::AcquireTexture(QOpenGLContext *ctx, const olive::PixelFormat &format, int width, int height)
+{
+  QOpenGLContextGroup* group = ctx->shareGroup();
+
+  QMutexLocker locker(&mutex_);
+
+  // Take the most recently released match, it's the most likely to still be resident
+  for (int i=free_textures_.size()-1;i>=0;i--) {
+    const FreeTexture& t = free_textures_.at(i);
+
+    if (t.group == group && !t.purged && t.format == format && t.width == width && t.height == height) {
+      GLuint texture = t.texture;
+
+      cached_bytes_ -= t.bytes;
+      free_textures_.removeAt(i);
+      hits_++;
+
+      // Anything released from another thread while over budget can be deleted now
+      TrimInternal();
+
+      return texture;
+    }
+  }
+
+  misses_++;
+
+  TrimInternal();
+
+  locker.unlock();
+
+  // Nothing to reuse, allocate a new texture
+  QOpenGLFunctions* f = ctx->functions();
+
+  GLuint texture;
+
+  f->glGenTextures(1, &texture);
+
+  f->glBindTexture(GL_TEXTURE_2D, texture);
+
+  const PixelFormatInfo& bit_depth = PixelService::GetPixelFormatInfo(format);
+
+  f->glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        bit_depth.internal_format,
+        width,
+        height,
+        0,
+        bit_depth.pixel_format,
+        bit_depth.pixel_type,
+        nullptr
+        );
+
+  // set texture filtering to bilinear
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  return texture;
+}
+
+void TexturePool::ReleaseTexture(QOpenGLContext *ctx,
+                                 const olive::PixelFormat &format,
+                                 int width,
+                                 int height,
+                                 GLuint texture)
+{
+  QOpenGLContextGroup* group = ctx->shareGroup();
+
+  QMutexLocker locker(&mutex_);
+
+  // Textures are destroyed with their group, forget them when that happens
+  if (!groups_.contains(group)) {
+    groups_.insert(group);
+
+    QObject::connect(group, &QObject::destroyed, [this, group]() {
+      QMutexLocker l(&mutex_);
+
+      groups_.remove(group);
+
+      QList<FreeTexture>::iterator it = free_textures_.begin();
+
+      while (it != free_textures_.end()) {
+        if (it->group == group) {
+          cached_bytes_ -= it->bytes;
+          it = free_textures_.erase(it);
+        } else {
+          it++;
+        }
+      }
+    });
+  }
+
+  FreeTexture t;
+
+  t.group = group;
+  t.format = format;
+  t.width = width;
+  t.height = height;
+  t.texture = texture;
+  t.bytes = TextureBytes(format, width, height);
+  t.purged = false;
+
+  free_textures_.append(t);
+  cached_bytes_ += t.bytes;
+
+  TrimInternal();
+}
+
+GLuint TexturePool::AcquireFramebuffer(QOpenGLContext *ctx)
+{
+  {
+    QMutexLocker locker(&mutex_);
+
+    WatchContext(ctx);
+
+    QVector<GLuint>& buffers = free_buffers_[ctx];
+
+    if (!buffers.isEmpty()) {
+      return buffers.takeLast();
+    }
+  }
+
+  GLuint buffer;
+
+  ctx->functions()->glGenFramebuffers(1, &buffer);
+
+  return buffer;
+}
+
+void TexturePool::ReleaseFramebuffer(QOpenGLContext *ctx, GLuint buffer)
+{
+  QMutexLocker locker(&mutex_);
+
+  if (contexts_.contains(ctx)) {
+    free_buffers_[ctx].append(buffer);
+  } else {
+    // The context is being destroyed (and is current), so there's nothing to reuse this with
+    locker.unlock();
+
+    ctx->functions()->glDeleteFramebuffers(1, &buffer);
+  }
+}
+
+void TexturePool::Clear()
+{
+  QOpenGLContext* current = QOpenGLContext::currentContext();
+
+  if (current == nullptr) {
+    return;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  QList<FreeTexture>::iterator it = free_textures_.begin();
+
+  while (it != free_textures_.end()) {
+    if (it->group == current->shareGroup()) {
+      current->functions()->glDeleteTextures(1, &it->texture);
+
+      cached_bytes_ -= it->bytes;
+      it = free_textures_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void TexturePool::Purge()
+{
+  QMutexLocker locker(&mutex_);
+
+  for (int i=0;i<free_textures_.size();i++) {
+    free_textures_[i].purged = true;
+  }
+
+  TrimInternal();
+}
+
+qint64 TexturePool::cached_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return cached_bytes_;
+}
+
+qint64 TexturePool::max_cached_bytes()
+{
+  QMutexLocker locker(&mutex_);
+
+  return max_cached_bytes_;
+}
+
+void TexturePool::set_max_cached_bytes(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  max_cached_bytes_ = bytes;
+
+  TrimInternal();
+}
+
+CacheStatistics TexturePool::statistics()
+{
+  QMutexLocker locker(&mutex_);
+
+  CacheStatistics s;
+
+  s.used_bytes = cached_bytes_;
+  s.budget = max_cached_bytes_;
+  s.entries = free_textures_.size();
+  s.hits = hits_;
+  s.misses = misses_;
+
+  foreach (const FreeTexture& t, free_textures_) {
+    s.AddConsumer(QStringLiteral("%1x%2").arg(QString::number(t.width), QString::number(t.height)), t.bytes);
+  }
+
+  s.SortConsumers();
+
+  return s;
+}
+
+void TexturePool::TrimInternal()
+{
+  // Textures can only be deleted with a context of their group current
+  QOpenGLContext* current = QOpenGLContext::currentContext();
+
+  if (current == nullptr) {
+    return;
+  }
+
+  QOpenGLContextGroup* group = current->shareGroup();
+
+  QList<FreeTexture>::iterator it = free_textures_.begin();
+
+  while (it != free_textures_.end()) {
+    if (it->group == group && (it->purged || cached_bytes_ > max_cached_bytes_)) {
+      current->functions()->glDeleteTextures(1, &it->texture);
+
+      cached_bytes_ -= it->bytes;
+      it = free_textures_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void TexturePool::WatchContext(QOpenGLContext *ctx)
+{
+  if (contexts_.contains(ctx)) {
+    return;
+  }
+
+  contexts_.insert(ctx);
+
+  // Framebuffers are destroyed with their context (which is current while this signal is emitted)
+  QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [this, ctx]() {
+    QMutexLocker l(&mutex_);
+
+    contexts_.remove(ctx);
+
+    QVector<GLuint> buffers = free_buffers_.take(ctx);
+
+    if (!buffers.isEmpty()) {
+      ctx->functions()->glDeleteFramebuffers(buffers.size(), buffers.constData());
+    }
+  });
+}
+
+qint64 TexturePool::TextureBytes(const olive::PixelFormat &format, int width, int height)
+{
+  return static_cast<qint64>(width) * static_cast<qint64>(height) * PixelService::BytesPerPixel(format);
+}
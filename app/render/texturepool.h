@@ -0,0 +1,169 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TEXTUREPOOL_H
+#define TEXTUREPOOL_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QSet>
+#include <QVector>
+
+#include "common/cachestatistics.h"
+#include "pixelformat.h"
+
+/**
+ * @brief A pool of render target textures and framebuffers shared by every OpenGL context
+ *
+ * Nodes and renderers create a TextureBuffer for almost every frame they draw. Generating a texture and allocating its
+ * storage each time is slow (and fragments VRAM), so TextureBuffer takes its texture and framebuffer from here and
+ * gives them back when it's destroyed.
+ *
+ * Textures are shared by all contexts in a share group, so they're pooled per group and bucketed by format and size.
+ * Released textures are kept until the pool holds more than max_cached_bytes(), at which point the least recently
+ * used are deleted. Framebuffer objects can't be shared between contexts, so they're pooled per context instead (they
+ * don't take any VRAM and are only deleted with their context).
+ *
+ * GL objects are only ever created or deleted with a context of the right group current, so anything over the budget
+ * after a release from another thread is deleted on the next acquire from that group.
+ *
+ * Use the application-wide olive::texture_pool. All functions are thread-safe.
+ */
+class TexturePool
+{
+public:
+  TexturePool();
+
+  TexturePool(const TexturePool& other) = delete;
+  TexturePool(TexturePool&& other) = delete;
+  TexturePool& operator=(const TexturePool& other) = delete;
+  TexturePool& operator=(TexturePool&& other) = delete;
+
+  /**
+   * @brief Get a texture of this format and size, allocating one if there's none to reuse
+   *
+   * `ctx` must be current. The texture's contents are undefined.
+   */
+  GLuint AcquireTexture(QOpenGLContext* ctx, const olive::PixelFormat& format, int width, int height);
+
+  /**
+   * @brief Return a texture from AcquireTexture() to the pool
+   *
+   * `ctx` can be any context in the group the texture was acquired in, and doesn't need to be current.
+   */
+  void ReleaseTexture(QOpenGLContext* ctx, const olive::PixelFormat& format, int width, int height, GLuint texture);
+
+  /**
+   * @brief Get a framebuffer object for `ctx`, which must be current
+   */
+  GLuint AcquireFramebuffer(QOpenGLContext* ctx);
+
+  /**
+   * @brief Return a framebuffer object from AcquireFramebuffer() with the same context
+   */
+  void ReleaseFramebuffer(QOpenGLContext* ctx, GLuint buffer);
+
+  /**
+   * @brief Delete the textures waiting to be reused in the current context's group
+   */
+  void Clear();
+
+  /**
+   * @brief Delete the textures waiting to be reused in every group
+   *
+   * Textures of the current context's group (if any) are deleted straight away, the others the next time a context of
+   * their group acquires or releases a texture.
+   */
+  void Purge();
+
+  /**
+   * @brief Returns the total size of the textures waiting to be reused
+   */
+  qint64 cached_bytes();
+
+  qint64 max_cached_bytes();
+
+  /**
+   * @brief Set the maximum size of the textures waiting to be reused, any over this are deleted
+   */
+  void set_max_cached_bytes(qint64 bytes);
+
+  /**
+   * @brief Textures waiting to be reused by size, and how many acquires reused one (hits) or didn't (misses)
+   */
+  CacheStatistics statistics();
+
+  /**
+   * @brief Default maximum size of the textures waiting to be reused
+   */
+  static const qint64 kDefaultMaxCachedBytes;
+
+private:
+  struct FreeTexture {
+    QOpenGLContextGroup* group;
+    olive::PixelFormat format;
+    int width;
+    int height;
+    GLuint texture;
+    qint64 bytes;
+
+    // Set by Purge(), deleted by the next TrimInternal() in its group rather than reused
+    bool purged;
+  };
+
+  /**
+   * @brief Delete purged textures of the current context's group, then the least recently used until the pool is in
+   * budget
+   */
+  void TrimInternal();
+
+  void WatchContext(QOpenGLContext* ctx);
+
+  static qint64 TextureBytes(const olive::PixelFormat& format, int width, int height);
+
+  // Least recently released first
+  QList<FreeTexture> free_textures_;
+
+  QHash<QOpenGLContext*, QVector<GLuint> > free_buffers_;
+
+  QSet<QOpenGLContext*> contexts_;
+
+  QSet<QOpenGLContextGroup*> groups_;
+
+  qint64 cached_bytes_;
+
+  qint64 max_cached_bytes_;
+
+  qint64 hits_;
+  qint64 misses_;
+
+  QMutex mutex_;
+};
+
+namespace olive {
+/**
+ * @brief Application-wide pool of render target textures
+ */
+extern TexturePool texture_pool;
+}
+
+#endif // TEXTUREPOOL_H
@@ -0,0 +1,246 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "textureuploader.h"
+
+#include <cstring>
+
+#include <QDebug>
+#include <QOpenGLFunctions>
+
+#include "common/tracing.h"
+#include "render/gl/functions.h"
+#include "render/performancecounters.h"
+
+TextureUploader::TextureUploader() :
+  ctx_(nullptr),
+  next_slot_(0)
+{
+}
+
+TextureUploader::~TextureUploader()
+{
+  Destroy();
+}
+
+bool TextureUploader::IsCreated()
+{
+  return (ctx_ != nullptr);
+}
+
+void TextureUploader::Create(QOpenGLContext *ctx, int ring_size)
+{
+  Destroy();
+
+  ctx_ = ctx;
+
+  ring_.resize(ring_size);
+
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[i];
+
+    ctx_->functions()->glGenBuffers(1, &pbo.buffer);
+    pbo.fence = nullptr;
+    pbo.size = 0;
+    pbo.mapped = false;
+  }
+
+  next_slot_ = 0;
+}
+
+void TextureUploader::Destroy()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  for (int i=0;i<ring_.size();i++) {
+    PixelBuffer& pbo = ring_[i];
+
+    if (pbo.mapped) {
+      xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.buffer);
+      xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    if (pbo.fence != nullptr) {
+      xf->glDeleteSync(pbo.fence);
+    }
+
+    xf->glDeleteBuffers(1, &pbo.buffer);
+  }
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  ring_.clear();
+
+  ctx_ = nullptr;
+}
+
+uint8_t *TextureUploader::BeginUpload(int size, int *slot)
+{
+  if (ctx_ == nullptr || size <= 0) {
+    return nullptr;
+  }
+
+  // Find the next PBO that isn't waiting for FinishUpload()
+  int index = -1;
+
+  for (int i=0;i<ring_.size();i++) {
+    int test = (next_slot_ + i) % ring_.size();
+
+    if (!ring_.at(test).mapped) {
+      index = test;
+      break;
+    }
+  }
+
+  if (index == -1) {
+    qWarning() << "TextureUploader has no free pixel buffers, is FinishUpload() being called?";
+    return nullptr;
+  }
+
+  next_slot_ = (index + 1) % ring_.size();
+
+  // Mapping is part of the upload FinishUpload() counts
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kUpload, 0);
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+  PixelBuffer& pbo = ring_[index];
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.buffer);
+
+  // Check if the GPU is still reading from a previous upload
+  bool in_use = false;
+
+  if (pbo.fence != nullptr) {
+    in_use = (xf->glClientWaitSync(pbo.fence, 0, 0) == GL_TIMEOUT_EXPIRED);
+
+    xf->glDeleteSync(pbo.fence);
+    pbo.fence = nullptr;
+  }
+
+  // If the PBO is in use (or too small), orphan its storage rather than wait. The driver will free the old storage once
+  // the GPU is done with it.
+  if (in_use || pbo.size != size) {
+    xf->glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    pbo.size = size;
+  }
+
+  // Either way, nothing can be reading this storage now so it's safe to map without synchronizing
+  void* memory = xf->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                      0,
+                                      size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (memory == nullptr) {
+    qWarning() << "Failed to map pixel buffer";
+    return nullptr;
+  }
+
+  pbo.mapped = true;
+
+  *slot = index;
+
+  return static_cast<uint8_t*>(memory);
+}
+
+void TextureUploader::FinishUpload(int slot, GLuint texture, olive::PixelFormat format, int width, int height,
+                                   int linesize)
+{
+  if (ctx_ == nullptr || slot < 0 || slot >= ring_.size() || !ring_.at(slot).mapped) {
+    return;
+  }
+
+  PerformanceCounters::ScopedTimer timer(PerformanceCounters::kUpload);
+  Tracing::Span span("upload", "TextureUploader::FinishUpload");
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+  PixelBuffer& pbo = ring_[slot];
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.buffer);
+  xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  pbo.mapped = false;
+
+  // With a PBO bound, the data pointer is an offset into the PBO
+  const PixelFormatInfo info = PixelService::GetPixelFormatInfo(format);
+
+  xf->glBindTexture(GL_TEXTURE_2D, texture);
+
+  xf->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / info.bytes_per_pixel);
+
+  xf->glTexSubImage2D(GL_TEXTURE_2D,
+                      0,
+                      0,
+                      0,
+                      width,
+                      height,
+                      info.pixel_format,
+                      info.pixel_type,
+                      nullptr);
+
+  xf->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  xf->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  olive::gl::MarkTextureModified(texture);
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // Fence the transfer so BeginUpload() knows when this PBO is free again
+  pbo.fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool TextureUploader::Upload(GLuint texture, olive::PixelFormat format, int width, int height, const void *data,
+                             int linesize)
+{
+  int row_size = width * PixelService::BytesPerPixel(format);
+  int slot = -1;
+
+  uint8_t* memory = BeginUpload(row_size * height, &slot);
+
+  if (memory == nullptr) {
+    return false;
+  }
+
+  {
+    PerformanceCounters::ScopedTimer timer(PerformanceCounters::kUpload, 0);
+    Tracing::Span span("upload", "TextureUploader::Upload (copy)");
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    if (linesize == row_size) {
+      memcpy(memory, src, static_cast<size_t>(row_size * height));
+    } else {
+      for (int i=0;i<height;i++) {
+        memcpy(memory + i * row_size, src + i * linesize, static_cast<size_t>(row_size));
+      }
+    }
+  }
+
+  FinishUpload(slot, texture, format, width, height);
+
+  return true;
+}
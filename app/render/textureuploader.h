@@ -0,0 +1,129 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TEXTUREUPLOADER_H
+#define TEXTUREUPLOADER_H
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QVector>
+
+#include "pixelformat.h"
+
+/**
+ * @brief Asynchronously uploads pixels to textures through a ring of pixel buffer objects
+ *
+ * A plain glTexImage2D/glTexSubImage2D from system memory blocks until the driver has copied the pixels. Uploading
+ * through a pixel buffer object (PBO) instead lets the copy into driver memory happen from any thread and the transfer
+ * to the texture happen asynchronously on the GPU.
+ *
+ * Uploads are split in two so that the copy can happen on another thread (e.g. a decoder thread):
+ *
+ * 1. BeginUpload() (render thread) returns a pointer to mapped PBO memory.
+ * 2. Any thread fills the memory.
+ * 3. FinishUpload() (render thread) unmaps the PBO and queues the transfer into the texture.
+ *
+ * Each PBO in the ring is fenced after its transfer is queued. If a PBO is reused before the GPU has finished reading
+ * it, its storage is orphaned so the caller never waits for the GPU.
+ *
+ * olive::gl::OpenGLBackend::UploadTexture() uploads through one of these per context with Upload(), so frames loaded
+ * from the DiskFrameCache and images read by ImageInput don't stall the render thread.
+ *
+ * After creating a new TextureUploader, call Create() when a valid OpenGL context is available. All functions except
+ * for filling mapped memory must be called with that context current.
+ */
+class TextureUploader
+{
+public:
+  TextureUploader();
+  ~TextureUploader();
+
+  TextureUploader(const TextureUploader& other) = delete;
+  TextureUploader(TextureUploader&& other) = delete;
+  TextureUploader& operator=(const TextureUploader& other) = delete;
+  TextureUploader& operator=(TextureUploader&& other) = delete;
+
+  bool IsCreated();
+
+  /**
+   * @brief Create the PBO ring
+   *
+   * @param ring_size
+   *
+   * Number of PBOs to cycle through, and therefore the number of uploads that can be in flight at once.
+   */
+  void Create(QOpenGLContext* ctx, int ring_size = 3);
+
+  void Destroy();
+
+  /**
+   * @brief Map memory for an upload of `size` bytes
+   *
+   * @param slot
+   *
+   * Set to the PBO used for this upload, pass it to FinishUpload().
+   *
+   * @return
+   *
+   * Mapped memory that can be written from any thread until FinishUpload() is called, or nullptr if every PBO in the
+   * ring is already waiting for FinishUpload().
+   */
+  uint8_t* BeginUpload(int size, int* slot);
+
+  /**
+   * @brief Unmap a PBO mapped with BeginUpload() and queue its transfer into a texture
+   *
+   * The mapped memory must contain `width` x `height` pixels in `format`, which replace the top left of `texture`.
+   *
+   * @param linesize
+   *
+   * Bytes per row in the mapped memory (e.g. MemoryBuffer::linesize()). 0 means the rows are tightly packed.
+   */
+  void FinishUpload(int slot, GLuint texture, olive::PixelFormat format, int width, int height, int linesize = 0);
+
+  /**
+   * @brief Convenience function to upload pixels in memory to a texture
+   *
+   * @param linesize
+   *
+   * Bytes per row in `data`, the rows are packed tightly in the PBO.
+   *
+   * @return
+   *
+   * TRUE on success, FALSE if no PBO was available.
+   */
+  bool Upload(GLuint texture, olive::PixelFormat format, int width, int height, const void* data, int linesize);
+
+private:
+  struct PixelBuffer {
+    GLuint buffer;
+    GLsync fence;
+    int size;
+    bool mapped;
+  };
+
+  QOpenGLContext* ctx_;
+
+  QVector<PixelBuffer> ring_;
+
+  int next_slot_;
+};
+
+#endif // TEXTUREUPLOADER_H
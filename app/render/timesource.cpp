@@ -0,0 +1,63 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "timesource.h"
+
+TimeSource::TimeSource() :
+  next_id_(0)
+{
+}
+
+int TimeSource::Subscribe(const TimeSource::Callback &callback)
+{
+  QMutexLocker locker(&lock_);
+
+  int id = next_id_;
+  next_id_++;
+
+  subscribers_.insert(id, callback);
+
+  return id;
+}
+
+void TimeSource::Unsubscribe(int id)
+{
+  QMutexLocker locker(&lock_);
+
+  subscribers_.remove(id);
+}
+
+void TimeSource::Publish(const rational &time)
+{
+  QMutexLocker locker(&lock_);
+
+  time_ = time;
+
+  foreach (const Callback& callback, subscribers_) {
+    callback(time);
+  }
+}
+
+rational TimeSource::time()
+{
+  QMutexLocker locker(&lock_);
+
+  return time_;
+}
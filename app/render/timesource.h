@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#include <QMap>
+#include <QMutex>
+#include <functional>
+
+#include "common/rational.h"
+
+/**
+ * @brief A playhead time that can be followed without going through an event loop
+ *
+ * PlaybackEngine::TimeChanged() is a signal, so anything in another thread (or just connected through several relays)
+ * only hears about the playhead once the GUI event loop gets around to it. Render scheduling needs to know sooner than
+ * that, so the engine also publishes every playhead move here and subscribers are called directly on the publishing
+ * thread, before the signal is even emitted.
+ *
+ * Callbacks are run with the source locked. They should be quick (e.g. storing the time in an atomic) and must not
+ * Subscribe() or Unsubscribe() themselves. Thread-safe.
+ */
+class TimeSource
+{
+public:
+  typedef std::function<void(const rational&)> Callback;
+
+  TimeSource();
+
+  /**
+   * @brief Call `callback` with every time published from now on
+   *
+   * @return
+   *
+   * An ID to pass to Unsubscribe().
+   */
+  int Subscribe(const Callback& callback);
+
+  /**
+   * @brief Stop calling a callback added with Subscribe()
+   *
+   * Once this returns, the callback is not being run and won't be again.
+   */
+  void Unsubscribe(int id);
+
+  /**
+   * @brief Set the current time and call every subscriber with it
+   */
+  void Publish(const rational& time);
+
+  /**
+   * @brief The last time published
+   */
+  rational time();
+
+private:
+  QMutex lock_;
+
+  rational time_;
+
+  QMap<int, Callback> subscribers_;
+
+  int next_id_;
+
+};
+
+#endif // TIMESOURCE_H
@@ -0,0 +1,134 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "analyze.h"
+
+#include <QFileInfo>
+
+#include "decoder/decoderpool.h"
+#include "decoder/probeserver.h"
+#include "decoder/waveformcache.h"
+
+AnalyzeTask::AnalyzeTask(FootagePtr footage, bool generate_waveforms) :
+  footage_(footage),
+  generate_waveforms_(generate_waveforms)
+{
+  QString base_filename = QFileInfo(footage_->filename()).fileName();
+
+  set_text(tr("Analyzing \"%1\"").arg(base_filename));
+
+  set_priority(kBackgroundPriority);
+}
+
+bool AnalyzeTask::Action()
+{
+  footage_->Lock();
+
+  olive::MediaProber prober(cancel_token());
+
+  bool analyzed = prober.DeepProbe(footage_.get());
+
+  add_bytes_read(prober.bytes_read());
+
+  QList<AudioStream*> audio_streams;
+
+  if (analyzed && generate_waveforms_) {
+    for (int i=0;i<footage_->stream_count();i++) {
+      if (footage_->stream(i)->type() == Stream::kAudio) {
+        audio_streams.append(static_cast<AudioStream*>(footage_->stream(i)));
+      }
+    }
+  }
+
+  footage_->Unlock();
+
+  // Generating waveforms can take a while, so it's done without holding the Footage lock
+  foreach (AudioStream* stream, audio_streams) {
+    if (!Checkpoint()) {
+      break;
+    }
+
+    GenerateWaveform(stream);
+  }
+
+  return true;
+}
+
+void AnalyzeTask::GenerateWaveform(AudioStream *stream)
+{
+  // Don't regenerate a waveform we already have
+  if (WaveformCache::Exists(stream)) {
+    return;
+  }
+
+  rational timebase = stream->timebase();
+  int64_t duration = stream->duration();
+  int sample_rate = stream->sample_rate();
+
+  if (duration == AV_NOPTS_VALUE || duration <= 0 || sample_rate <= 0 || timebase.denominator() == 0) {
+    return;
+  }
+
+  int64_t total_samples = av_rescale(duration * timebase.numerator(), sample_rate, timebase.denominator());
+
+  DecoderPtr decoder = olive::decoder_pool.Acquire(stream, 0);
+
+  if (decoder == nullptr) {
+    return;
+  }
+
+  // Peaks are calculated at the stream's own sample rate
+  decoder->set_output_sample_rate(0);
+
+  WaveformCache waveform;
+  waveform.Create(stream->channels(), sample_rate);
+
+  int64_t position = 0;
+
+  qint64 bytes_read = decoder->bytes_read();
+
+  // Decode in one second chunks, sequential requests are decoded forward without seeking
+  while (position < total_samples && Checkpoint()) {
+    int64_t chunk = qMin(static_cast<int64_t>(sample_rate), total_samples - position);
+
+    FramePtr frame = decoder->Retrieve(rational(position, sample_rate), rational(chunk, sample_rate));
+
+    if (frame == nullptr) {
+      break;
+    }
+
+    waveform.AddSamples(frame);
+
+    position += chunk;
+
+    set_progress(static_cast<int>(100 * position / total_samples));
+  }
+
+  // Pooled decoders may have been used before, only count what was read for this waveform
+  add_bytes_read(decoder->bytes_read() - bytes_read);
+
+  olive::decoder_pool.Release(decoder, rational(position, sample_rate));
+
+  // Only save complete waveforms
+  if (position == total_samples) {
+    waveform.Finalize();
+    waveform.Save(stream);
+  }
+}
@@ -0,0 +1,56 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ANALYZETASK_H
+#define ANALYZETASK_H
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A low priority background task for fully analyzing Footage that has already been probed by a ProbeTask
+ *
+ * ProbeTask only performs a fast probe so that imported Footage is available immediately. AnalyzeTask then calls
+ * olive::DeepProbeMedia() to fill in exact metadata, which means Decoders opened later can skip most of their own
+ * stream analysis.
+ *
+ * Optionally, the AnalyzeTask will also stream through every audio stream and store its peaks in a WaveformCache, so
+ * views can draw waveforms without ever decoding the audio again.
+ */
+class AnalyzeTask : public Task
+{
+  Q_OBJECT
+public:
+  AnalyzeTask(FootagePtr footage, bool generate_waveforms = true);
+
+  virtual bool Action() override;
+
+private:
+  /**
+   * @brief Decode an audio stream from start to finish and save its WaveformCache
+   */
+  void GenerateWaveform(AudioStream* stream);
+
+  FootagePtr footage_;
+
+  bool generate_waveforms_;
+};
+
+#endif // ANALYZETASK_H
@@ -0,0 +1,129 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "conform.h"
+
+#include <QFileInfo>
+
+#include "decoder/conformcache.h"
+#include "decoder/decoderpool.h"
+#include "task/taskmanager.h"
+
+QSet<QString> ConformTask::queued_;
+
+ConformTask::ConformTask(FootagePtr footage, AudioStream *stream, int sample_rate, int channels) :
+  footage_(footage),
+  stream_(stream),
+  sample_rate_(sample_rate),
+  channels_(channels)
+{
+  QString base_filename = QFileInfo(footage_->filename()).fileName();
+
+  set_text(tr("Conforming audio of \"%1\"").arg(base_filename));
+
+  set_priority(kBackgroundPriority);
+}
+
+bool ConformTask::Action()
+{
+  rational timebase = stream_->timebase();
+  int64_t duration = stream_->duration();
+
+  if (duration == AV_NOPTS_VALUE || duration <= 0 || timebase.denominator() == 0) {
+    return false;
+  }
+
+  int64_t total_samples = av_rescale(duration * timebase.numerator(), sample_rate_, timebase.denominator());
+
+  DecoderPtr decoder = olive::decoder_pool.Acquire(stream_, 0, 0, 0, Decoder::kExport);
+
+  if (decoder == nullptr) {
+    return false;
+  }
+
+  decoder->set_output_sample_rate(sample_rate_);
+
+  ConformCache cache;
+
+  bool ok = cache.Create(stream_, sample_rate_, channels_);
+
+  int64_t position = 0;
+
+  qint64 bytes_read = decoder->bytes_read();
+
+  // Decode in one second chunks, sequential requests are decoded forward without seeking
+  while (ok && position < total_samples && Checkpoint()) {
+    int64_t chunk = qMin(static_cast<int64_t>(sample_rate_), total_samples - position);
+
+    FramePtr frame = decoder->Retrieve(rational(position, sample_rate_), rational(chunk, sample_rate_));
+
+    if (frame == nullptr || frame->sample_count() <= 0) {
+      break;
+    }
+
+    ok = cache.AddSamples(reinterpret_cast<const float* const*>(frame->data()),
+                          frame->channels(),
+                          qMin(frame->sample_count(), static_cast<int>(chunk)));
+
+    position += chunk;
+
+    set_progress(static_cast<int>(100 * position / total_samples));
+  }
+
+  add_bytes_read(decoder->bytes_read() - bytes_read);
+
+  olive::decoder_pool.Release(decoder, rational(position, sample_rate_));
+
+  // Only save complete streams, an incomplete cache is discarded with the ConformCache
+  if (ok && position == total_samples) {
+    return cache.Commit();
+  }
+
+  return false;
+}
+
+void ConformTask::Queue(AudioStream *stream, int sample_rate, int channels)
+{
+  if (!ConformCache::NeedsConform(stream, sample_rate, channels)
+      || ConformCache::Exists(stream, sample_rate, channels)) {
+    return;
+  }
+
+  QString filename = ConformCache::GetCacheFilename(stream, sample_rate, channels);
+
+  Footage* footage = stream->footage();
+
+  if (queued_.contains(filename) || footage->parent() == nullptr) {
+    return;
+  }
+
+  // The task needs to share ownership of the Footage
+  FootagePtr footage_ptr = std::static_pointer_cast<Footage>(footage->parent()->shared_ptr_from_raw(footage));
+
+  TaskPtr task = std::make_shared<ConformTask>(footage_ptr, stream, sample_rate, channels);
+
+  queued_.insert(filename);
+
+  connect(task.get(), &Task::Finished, [filename]() {
+    queued_.remove(filename);
+  });
+
+  olive::task_manager.AddTask(task);
+}
@@ -0,0 +1,65 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CONFORMTASK_H
+#define CONFORMTASK_H
+
+#include <QSet>
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A background task that decodes an AudioStream at another sample rate and channel count into a ConformCache
+ *
+ * Streams that don't match the format they're played at would otherwise be resampled in real time for as long as
+ * they play. Conforming them once at a low priority means playback (see AudioMixer) reads plain samples instead.
+ */
+class ConformTask : public Task
+{
+  Q_OBJECT
+public:
+  ConformTask(FootagePtr footage, AudioStream* stream, int sample_rate, int channels);
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Queue a ConformTask for a stream unless it doesn't need one, is already conformed or is already queued
+   *
+   * Must be called from the main thread.
+   */
+  static void Queue(AudioStream* stream, int sample_rate, int channels);
+
+private:
+  FootagePtr footage_;
+
+  AudioStream* stream_;
+
+  int sample_rate_;
+
+  int channels_;
+
+  /**
+   * @brief Cache filenames of every ConformTask that hasn't finished yet
+   */
+  static QSet<QString> queued_;
+};
+
+#endif // CONFORMTASK_H
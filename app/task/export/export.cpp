@@ -0,0 +1,81 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "export.h"
+
+#include <QMutexLocker>
+
+ExportTask::ExportTask(const QString &text) :
+  completed_(0),
+  total_(0),
+  remaining_(-1),
+  finished_(false),
+  ok_(false)
+{
+  set_text(text);
+}
+
+bool ExportTask::Action()
+{
+  QMutexLocker locker(&mutex_);
+
+  while (!finished_) {
+    // The main thread may be waiting for this to return, so don't wait for the export to stop
+    if (cancelled()) {
+      emit CancelRequested();
+      return false;
+    }
+
+    changed_.wait(&mutex_, kPollInterval);
+
+    if (total_ > 0) {
+      set_remaining_time(remaining_);
+      set_progress(static_cast<int>(completed_ * 100 / total_));
+    }
+  }
+
+  if (ok_) {
+    set_remaining_time(0);
+  } else {
+    set_error(error_);
+  }
+
+  return ok_;
+}
+
+void ExportTask::UpdateProgress(qint64 completed, qint64 total, qint64 remaining)
+{
+  QMutexLocker locker(&mutex_);
+
+  completed_ = completed;
+  total_ = total;
+  remaining_ = remaining;
+}
+
+void ExportTask::SetFinished(bool ok, const QString &error)
+{
+  QMutexLocker locker(&mutex_);
+
+  finished_ = true;
+  ok_ = ok;
+  error_ = error;
+
+  changed_.wakeAll();
+}
@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTTASK_H
+#define EXPORTTASK_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "task/task.h"
+
+/**
+ * @brief A Task showing an export that RenderQueue runs, with how long it's predicted to take
+ *
+ * The export runs on its ExportEngine's own threads, so jobs that share a render stay in one engine. RenderQueue
+ * reports the engine's progress and ExportEngine::EstimatedRemaining() with UpdateProgress(), and Action() passes them
+ * on through set_progress() and set_remaining_time(), so anything watching Tasks sees exports like any other Task.
+ *
+ * Action() mostly waits, but it keeps a kCPU slot while the export runs since the export's conversion threads use
+ * the CPU. Cancelling the Task emits CancelRequested() and returns straight away, the export stops shortly after.
+ *
+ * UpdateProgress() and SetFinished() must be called from the main thread.
+ */
+class ExportTask : public Task
+{
+  Q_OBJECT
+public:
+  ExportTask(const QString& text);
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Report the frames the export has encoded so far and its predicted milliseconds left (-1 if unknown)
+   */
+  void UpdateProgress(qint64 completed, qint64 total, qint64 remaining);
+
+  /**
+   * @brief Report that the export has stopped, Action() returns `ok` once it sees this
+   */
+  void SetFinished(bool ok, const QString& error);
+
+signals:
+  /**
+   * @brief Emitted from the thread running Action() when the Task is cancelled
+   *
+   * Connect with a queued connection, the main thread may be waiting for Action() to return.
+   */
+  void CancelRequested();
+
+private:
+  // Milliseconds between progress updates
+  static const int kPollInterval = 100;
+
+  // Everything below is protected by mutex_
+  qint64 completed_;
+  qint64 total_;
+  qint64 remaining_;
+
+  bool finished_;
+  bool ok_;
+  QString error_;
+
+  QMutex mutex_;
+
+  QWaitCondition changed_;
+};
+
+#endif // EXPORTTASK_H
@@ -25,13 +25,20 @@
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QHash>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 
 // FIXME: Only used for test code
 #include "panel/panelfocusmanager.h"
 #include "panel/project/project.h"
 // End test code
 
+#include "common/imagesequence.h"
 #include "project/item/footage/footage.h"
+#include "task/analyze/analyze.h"
+#include "task/index/index.h"
 #include "task/probe/probe.h"
 #include "task/taskmanager.h"
 #include "undo/undostack.h"
@@ -42,13 +49,37 @@ ImportTask::ImportTask(ProjectViewModel *model, Folder *parent, const QStringLis
   parent_(parent)
 {
   set_text(tr("Importing %1 files").arg(urls.size()));
+
+  // Importing mostly waits on listing directories
+  if (!urls.isEmpty()) {
+    set_resource_class(GetIOClass(urls.first()));
+  }
 }
 
+class ImportTask::ListRunnable : public QRunnable
+{
+public:
+  ListRunnable(Directory* directory) :
+    directory_(directory)
+  {
+  }
+
+  virtual void run() override
+  {
+    directory_->entries = QDir(directory_->path).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+  }
+
+private:
+  Directory* directory_;
+};
+
 bool ImportTask::Action()
 {
   QUndoCommand* command = new QUndoCommand();
 
-  Import(urls_, parent_, command);
+  QVector<Directory> directories = ListDirectories();
+
+  Import(directories, command);
 
   // If this task was cancelled, we won't bother pushing an undo command (we don't end up with anything undoable since
   // the undo command executes the final import anyway)
@@ -63,86 +94,184 @@ bool ImportTask::Action()
   return true;
 }
 
-void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *parent_command)
+QVector<ImportTask::Directory> ImportTask::ListDirectories()
+{
+  QVector<Directory> directories(1);
+
+  directories[0].folder = parent_;
+
+  foreach (const QString& url, urls_) {
+    directories[0].entries.append(QFileInfo(url));
+  }
+
+  QThreadPool pool;
+
+  // Directories of the current level of the tree still to be listed
+  int level_start = 0;
+  int level_end = 1;
+
+  while (level_start < level_end && Checkpoint()) {
+    // Add a Directory for every directory found on the last level
+    for (int i=level_start;i<level_end;i++) {
+      for (int j=0;j<directories.at(i).entries.size();j++) {
+        const QFileInfo& info = directories.at(i).entries.at(j);
+
+        if (info.isDir()) {
+          Directory subdirectory;
+          subdirectory.path = info.absoluteFilePath();
+          subdirectory.folder = nullptr;
+
+          directories[i].subdirectories.append(directories.size());
+          directories.append(subdirectory);
+        }
+      }
+    }
+
+    level_start = level_end;
+    level_end = directories.size();
+
+    // List them all at once (directories won't be resized until they're all done)
+    for (int i=level_start;i<level_end;i++) {
+      pool.start(new ListRunnable(&directories[i]));
+    }
+
+    pool.waitForDone();
+  }
+
+  return directories;
+}
+
+void ImportTask::Import(QVector<Directory> &directories, QUndoCommand *parent_command)
 {
-  for (int i=0;i<files.size();i++) {
+  FootageIndex* index = model_->project()->footage_index();
+
+  // Canonical paths of the files imported so far, the same file may be reached through several URLs or links
+  QSet<QString> imported;
+
+  // Queued together with a single command once every item has been added
+  QVector<TaskPtr> tasks;
+
+  // Parents come before their children, so each Directory's folder has been created by the time it's reached
+  for (int i=0;i<directories.size();i++) {
 
     // Stop here if the Task has been cancelled
-    if (cancelled()) {
+    if (!Checkpoint()) {
       break;
     }
 
-    const QString& url = files.at(i);
+    Directory& directory = directories[i];
 
-    QFileInfo file_info(url);
+    QList<ItemPtr> items;
+    QList<FootagePtr> footage;
+    int next_subdirectory = 0;
 
-    // Check if this file is a diretory
-    if (file_info.isDir()) {
+    // Numbered stills are imported as one Footage per sequence, find which sequence (if any) each file belongs to
+    QList<ImageSequence> sequences = ImageSequence::Detect(directory.entries);
+    QHash<QString, int> sequence_frames;
 
-      // Use QDir to get a list of all the files in the directory
-      QDir dir(url);
+    for (int j=0;j<sequences.size();j++) {
+      for (int64_t k=sequences.at(j).first();k<=sequences.at(j).last();k++) {
+        sequence_frames.insert(sequences.at(j).FrameFilename(k), j);
+      }
+    }
 
-      // QDir::entryList only returns filenames, we can use entryInfoList() to get full paths
-      QFileInfoList entry_list = dir.entryInfoList();
+    foreach (const QFileInfo& file_info, directory.entries) {
 
-      // Only proceed if the empty actually has files in it
-      if (!entry_list.isEmpty()) {
-        // Create a folder corresponding to the directory
+      if (file_info.isDir()) {
 
+        // Create a folder corresponding to the directory
         ItemPtr f = std::make_shared<Folder>();
 
         f->set_name(file_info.fileName());
 
-        // Create undoable command that adds the items to the model
-        new ProjectViewModel::AddItemCommand(model_,
-                                             folder,
-                                             f,
-                                             parent_command);
+        items.append(f);
+
+        directories[directory.subdirectories.at(next_subdirectory)].folder = static_cast<Folder*>(f.get());
+        next_subdirectory++;
+
+      } else {
+
+        ImageSequence sequence;
 
-        // Convert QFileInfoList into QStringList
-        QStringList full_urls;
+        QHash<QString, int>::const_iterator sequence_frame = sequence_frames.constFind(file_info.absoluteFilePath());
 
-        foreach (QFileInfo info, entry_list) {
-          if (info.fileName() != ".." && info.fileName() != ".") {
-            full_urls.append(info.absoluteFilePath());
+        if (sequence_frame != sequence_frames.constEnd()) {
+          sequence = sequences.at(sequence_frame.value());
+
+          // The whole sequence is imported along with its first frame
+          if (file_info.absoluteFilePath() != sequence.FrameFilename(sequence.first())) {
+            continue;
           }
         }
 
-        // Recursively follow this path
-        Import(full_urls, static_cast<Folder*>(f.get()), parent_command);
-      }
+        QString path = FootageIndex::CanonicalPath(file_info.absoluteFilePath());
+
+        // Skip files that are already in the project
+        if (imported.contains(path) || index->FindByPath(path) != nullptr) {
+          continue;
+        }
+
+        imported.insert(path);
+
+        FootagePtr f = std::make_shared<Footage>();
+
+        // FIXME: Is it possible for a file to go missing between the Import dialog and here?
+        //        And what is the behavior/result of that?
 
-    } else {
+        f->set_filename(file_info.absoluteFilePath());
+        f->set_name(sequence.IsValid() ? sequence.Name() : file_info.fileName());
+        f->set_image_sequence(sequence);
+        f->set_timestamp(file_info.lastModified());
+        f->set_fingerprint(FootageIndex::Fingerprint(path));
 
-      FootagePtr f = std::make_shared<Footage>();
+        items.append(f);
+        footage.append(f);
 
-      // FIXME: Is it possible for a file to go missing between the Import dialog and here?
-      //        And what is the behavior/result of that?
+      }
+
+    }
 
-      f->set_filename(url);
-      f->set_name(file_info.fileName());
-      f->set_timestamp(file_info.lastModified());
+    // Add everything in this folder with a single insertion, before the commands adding the contents of its folders
+    if (!items.isEmpty()) {
+      new ProjectViewModel::AddItemsCommand(model_, directory.folder, items, parent_command);
+    }
 
-      // Create undoable command that adds the items to the model
-      new ProjectViewModel::AddItemCommand(model_,
-                                           folder,
-                                           f,
-                                           parent_command);
+    for (int j=0;j<footage.size();j+=kProbeBatchSize) {
+      QList<FootagePtr> batch = footage.mid(j, kProbeBatchSize);
 
-      // Create ProbeTask to analyze this media
-      TaskPtr pt = std::make_shared<ProbeTask>(f);
+      // Create ProbeTask to analyze this media, probing small files one by one would mostly spend its time on the
+      // overhead of each Task
+      TaskPtr pt = std::make_shared<ProbeTask>(batch);
 
       // The task won't work unless it's in the main thread and we're definitely not
       // FIXME: Should Tasks check what thread they're in and move themselves to the main thread?
       pt->moveToThread(qApp->thread());
 
-      // Queue task in task manager
-      new TaskManager::AddTaskCommand(pt, parent_command);
-      //olive::task_manager.AddTask(pt);
+      tasks.append(pt);
+
+      foreach (FootagePtr f, batch) {
+        // Create a low priority AnalyzeTask to fill in exact metadata once the fast probe is done
+        TaskPtr at = std::make_shared<AnalyzeTask>(f);
+        at->AddDependency(pt.get());
+        at->moveToThread(qApp->thread());
+
+        tasks.append(at);
+
+        // Index video in the background too, so the first seek into it doesn't have to
+        TaskPtr it = std::make_shared<IndexTask>(f);
+        it->AddDependency(pt.get());
+        it->moveToThread(qApp->thread());
 
+        tasks.append(it);
+      }
     }
 
-    emit ProgressChanged(i * 100 / files.size());
+    set_progress(i * 100 / directories.size());
+
+  }
 
+  // Queue tasks in task manager
+  if (!tasks.isEmpty()) {
+    new TaskManager::AddTasksCommand(tasks, parent_command);
   }
 }
@@ -21,6 +21,9 @@
 #ifndef IMPORT_H
 #define IMPORT_H
 
+#include <QFileInfoList>
+#include <QVector>
+
 #include "project/projectviewmodel.h"
 #include "project/item/folder/folder.h"
 #include "task/task.h"
@@ -32,6 +35,10 @@
  *
  * Using this Task is the best way to import media into a project since it will run in the background/multithreaded
  * without pausing the main thread.
+ *
+ * Directories are listed in parallel, one level of the tree at a time, and every folder's contents are added to the
+ * model with a single AddItemsCommand so views only see one insertion per folder. Files that are already in the project
+ * (see FootageIndex) are skipped.
  */
 class ImportTask : public Task
 {
@@ -42,7 +49,43 @@ public:
   virtual bool Action() override;
 
 private:
-  void Import(const QStringList& files, Folder* folder, QUndoCommand* parent_command);
+  /**
+   * @brief Maximum number of files in the same directory that are probed by one ProbeTask
+   */
+  static const int kProbeBatchSize = 64;
+
+  /**
+   * @brief A directory found while walking the URLs
+   */
+  struct Directory {
+    // Empty for the list of URLs itself
+    QString path;
+
+    // Filled in by ListDirectories()
+    QFileInfoList entries;
+
+    // Indices of the Directories of the entries that are directories, in the same order
+    QVector<int> subdirectories;
+
+    // Folder the entries are added to, set once the Directory's own entry has been added to its parent
+    Folder* folder;
+  };
+
+  class ListRunnable;
+
+  /**
+   * @brief Find every file and directory under the URLs
+   *
+   * @return
+   *
+   * Every Directory found, parents always before their children. The first one holds the URLs themselves.
+   */
+  QVector<Directory> ListDirectories();
+
+  /**
+   * @brief Create the items for the files and directories that were found and the commands that add them
+   */
+  void Import(QVector<Directory>& directories, QUndoCommand* parent_command);
 
   ProjectViewModel* model_;
   QStringList urls_;
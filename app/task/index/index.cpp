@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "index.h"
+
+#include <QFileInfo>
+
+#include "decoder/ffmpeg/ffmpegdecoder.h"
+
+IndexTask::IndexTask(FootagePtr footage) :
+  footage_(footage)
+{
+  QString base_filename = QFileInfo(footage_->filename()).fileName();
+
+  set_text(tr("Indexing \"%1\"").arg(base_filename));
+
+  set_priority(kBackgroundPriority);
+}
+
+bool IndexTask::Action()
+{
+  QList<Stream*> video_streams;
+
+  footage_->Lock();
+
+  // Image sequences are read frame by frame from their own files, they have nothing to index
+  if ((footage_->status() == Footage::kUnindexed || footage_->status() == Footage::kReady)
+      && !footage_->image_sequence().IsValid()) {
+    for (int i=0;i<footage_->stream_count();i++) {
+      if (footage_->stream(i)->type() == Stream::kVideo) {
+        video_streams.append(footage_->stream(i));
+      }
+    }
+  }
+
+  footage_->Unlock();
+
+  foreach (Stream* stream, video_streams) {
+    if (!Checkpoint()) {
+      break;
+    }
+
+    FFmpegDecoder decoder;
+    decoder.set_stream(stream);
+    decoder.set_cancel_token(cancel_token());
+
+    // Nothing is decoded, so there's no point setting up a hardware device
+    decoder.SetHardwareAccelerationEnabled(false);
+
+    // Opening loads the index if there is one, or indexes the stream and saves it
+    decoder.Analyze();
+
+    add_bytes_read(decoder.bytes_read());
+  }
+
+  return true;
+}
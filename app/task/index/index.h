@@ -0,0 +1,47 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef INDEXTASK_H
+#define INDEXTASK_H
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A low priority background task that indexes the video streams of Footage that has been probed
+ *
+ * Each stream's packets are read through once (without decoding anything) to build the seek index, keyframe positions
+ * and GOP length that decoders otherwise build the first time they're opened (see FFmpegDecoder::Analyze()). It's
+ * stored in the on-disk index cache, so the first seek into the footage in an editing session is already fast and the
+ * reading happens while it's being organized instead. Streams that already have an index are skipped.
+ */
+class IndexTask : public Task
+{
+  Q_OBJECT
+public:
+  IndexTask(FootagePtr footage);
+
+  virtual bool Action() override;
+
+private:
+  FootagePtr footage_;
+};
+
+#endif // INDEXTASK_H
@@ -0,0 +1,126 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "loudness.h"
+
+#include <QFileInfo>
+
+#include "audio/loudnessmeter.h"
+#include "decoder/decoderpool.h"
+#include "decoder/loudnesscache.h"
+#include "task/taskmanager.h"
+
+QSet<AudioStream*> LoudnessTask::queued_;
+
+LoudnessTask::LoudnessTask(FootagePtr footage, AudioStream *stream) :
+  footage_(footage),
+  stream_(stream)
+{
+  QString base_filename = QFileInfo(footage_->filename()).fileName();
+
+  set_text(tr("Measuring loudness of \"%1\"").arg(base_filename));
+
+  set_priority(kBackgroundPriority);
+}
+
+bool LoudnessTask::Action()
+{
+  rational timebase = stream_->timebase();
+  int64_t duration = stream_->duration();
+  int sample_rate = stream_->sample_rate();
+
+  if (duration == AV_NOPTS_VALUE || duration <= 0 || sample_rate <= 0 || timebase.denominator() == 0) {
+    return false;
+  }
+
+  int64_t total_samples = av_rescale(duration * timebase.numerator(), sample_rate, timebase.denominator());
+
+  DecoderPtr decoder = olive::decoder_pool.Acquire(stream_, 0, 0, 0, Decoder::kExport);
+
+  if (decoder == nullptr) {
+    return false;
+  }
+
+  // Loudness is measured at the stream's own sample rate
+  decoder->set_output_sample_rate(0);
+
+  LoudnessMeter meter;
+  meter.Create(stream_->channels(), sample_rate);
+
+  int64_t position = 0;
+
+  qint64 bytes_read = decoder->bytes_read();
+
+  // Decode in one second chunks, sequential requests are decoded forward without seeking
+  while (position < total_samples && Checkpoint()) {
+    int64_t chunk = qMin(static_cast<int64_t>(sample_rate), total_samples - position);
+
+    FramePtr frame = decoder->Retrieve(rational(position, sample_rate), rational(chunk, sample_rate));
+
+    if (frame == nullptr || frame->sample_count() <= 0 || frame->channels() != stream_->channels()) {
+      break;
+    }
+
+    meter.AddSamples(reinterpret_cast<const float* const*>(frame->data()),
+                     qMin(frame->sample_count(), static_cast<int>(chunk)));
+
+    position += chunk;
+
+    set_progress(static_cast<int>(100 * position / total_samples));
+  }
+
+  add_bytes_read(decoder->bytes_read() - bytes_read);
+
+  olive::decoder_pool.Release(decoder, rational(position, sample_rate));
+
+  // Integrated loudness is only meaningful for the whole stream
+  if (position != total_samples) {
+    return false;
+  }
+
+  meter.Finalize();
+
+  LoudnessCache cache;
+  cache.Set(meter);
+
+  return cache.Save(stream_);
+}
+
+void LoudnessTask::Queue(AudioStream *stream)
+{
+  Footage* footage = stream->footage();
+
+  if (LoudnessCache::Exists(stream) || queued_.contains(stream) || footage->parent() == nullptr) {
+    return;
+  }
+
+  // The task needs to share ownership of the Footage
+  FootagePtr footage_ptr = std::static_pointer_cast<Footage>(footage->parent()->shared_ptr_from_raw(footage));
+
+  TaskPtr task = std::make_shared<LoudnessTask>(footage_ptr, stream);
+
+  queued_.insert(stream);
+
+  connect(task.get(), &Task::Finished, [stream]() {
+    queued_.remove(stream);
+  });
+
+  olive::task_manager.AddTask(task);
+}
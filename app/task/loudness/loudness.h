@@ -0,0 +1,61 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef LOUDNESSTASK_H
+#define LOUDNESSTASK_H
+
+#include <QSet>
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A background task that measures the EBU R128 loudness of an AudioStream and stores it in a LoudnessCache
+ *
+ * The stream is decoded once at its own sample rate and fed through a LoudnessMeter, so meters and delivery checks
+ * can read the results from the cache instead of measuring again.
+ */
+class LoudnessTask : public Task
+{
+  Q_OBJECT
+public:
+  LoudnessTask(FootagePtr footage, AudioStream* stream);
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Queue a LoudnessTask for a stream unless it's already been measured or is already queued
+   *
+   * Must be called from the main thread.
+   */
+  static void Queue(AudioStream* stream);
+
+private:
+  FootagePtr footage_;
+
+  AudioStream* stream_;
+
+  /**
+   * @brief Streams of every LoudnessTask that hasn't finished yet
+   */
+  static QSet<AudioStream*> queued_;
+};
+
+#endif // LOUDNESSTASK_H
@@ -25,20 +25,54 @@
 #include "decoder/probeserver.h"
 
 ProbeTask::ProbeTask(FootagePtr footage) :
+  ProbeTask(QList<FootagePtr>({footage}))
+{
+}
+
+ProbeTask::ProbeTask(const QList<FootagePtr> &footage) :
   footage_(footage)
 {
-  QString base_filename = QFileInfo(footage_->filename()).fileName();
+  Q_ASSERT(!footage_.isEmpty());
+
+  if (footage_.size() == 1) {
+    QString base_filename = QFileInfo(footage_.first()->filename()).fileName();
+
+    set_text(tr("Probing \"%1\"").arg(base_filename));
+  } else {
+    set_text(tr("Probing %n files", nullptr, footage_.size()));
+  }
+
+  // The user is usually waiting to work with what they just imported
+  set_priority(kInteractivePriority);
 
-  set_text(tr("Probing \"%1\"").arg(base_filename));
+  // Probing mostly waits on reading the file's headers
+  // Batches are made of files from the same directory so the first one represents them all
+  set_resource_class(GetIOClass(footage_.first()->filename()));
 }
 
 bool ProbeTask::Action()
 {
-  footage_->Lock();
+  olive::MediaProber prober(cancel_token());
+
+  for (int i=0;i<footage_.size();i++) {
+    if (!Checkpoint()) {
+      break;
+    }
+
+    FootagePtr footage = footage_.at(i);
+
+    footage->Lock();
+
+    prober.Probe(footage.get());
+
+    footage->Unlock();
 
-  olive::ProbeMedia(footage_.get());
+    if (footage_.size() > 1) {
+      set_progress((i + 1) * 100 / footage_.size());
+    }
+  }
 
-  footage_->Unlock();
+  add_bytes_read(prober.bytes_read());
 
   return true;
 }
@@ -33,6 +33,13 @@
  * Currently this function just calls olive::ProbeMedia() which will call Footage::Clear(), clearing the Footage of
  * any previous metadata before passing it through the available decoders until it finds one that can parse it.
  * The ProbeTask mostly functions as a background/multithreaded wrapper for this functionality.
+ *
+ * Probing is deliberately fast and bounded so imported Footage is usable straight away. A lower priority AnalyzeTask
+ * should follow it to fill in exact metadata.
+ *
+ * A ProbeTask can also probe a batch of Footage in sequence. For many small files, the per-Task overhead (scheduling,
+ * signals, undo commands) outweighs the probe itself, so batching them shares that overhead and the Decoders (see
+ * olive::MediaProber) between the whole batch.
  */
 class ProbeTask : public Task
 {
@@ -40,10 +47,12 @@ class ProbeTask : public Task
 public:
   ProbeTask(FootagePtr footage);
 
+  ProbeTask(const QList<FootagePtr>& footage);
+
   virtual bool Action() override;
 
 private:
-  FootagePtr footage_;
+  QList<FootagePtr> footage_;
 };
 
 #endif // PROBE_H
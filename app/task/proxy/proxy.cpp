@@ -0,0 +1,534 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "proxy.h"
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+namespace {
+
+// Aborts FFmpeg's blocking IO once the Task's cancel token is set
+int InterruptCallback(void* opaque)
+{
+  return (static_cast<const QAtomicInt*>(opaque)->load() != 0) ? 1 : 0;
+}
+
+}
+
+ProxyTask::ProxyTask(FootagePtr footage, int stream_index, int divider) :
+  footage_(footage),
+  stream_index_(stream_index),
+  divider_(qMax(1, divider)),
+  proxy_width_(0),
+  proxy_height_(0),
+  in_fmt_ctx_(nullptr),
+  in_stream_(nullptr),
+  dec_ctx_(nullptr),
+  out_fmt_ctx_(nullptr),
+  out_stream_(nullptr),
+  enc_ctx_(nullptr),
+  sws_ctx_(nullptr),
+  scaled_frame_(nullptr)
+{
+  QString base_filename = QFileInfo(footage_->filename()).fileName();
+
+  set_text(tr("Generating proxy for \"%1\"").arg(base_filename));
+
+  set_priority(kBackgroundPriority);
+}
+
+bool ProxyTask::Action()
+{
+  footage_->Lock();
+
+  if (stream_index_ < 0
+      || stream_index_ >= footage_->stream_count()
+      || footage_->stream(stream_index_)->type() != Stream::kVideo) {
+    footage_->Unlock();
+    set_error(tr("Stream %1 is not a video stream").arg(stream_index_));
+    return false;
+  }
+
+  // Transcode() reads the file with FFmpeg, which would only see a sequence's first frame
+  if (footage_->image_sequence().IsValid()) {
+    footage_->Unlock();
+    set_error(tr("Proxies can't be generated for image sequences yet"));
+    return false;
+  }
+
+  VideoStream* video_stream = static_cast<VideoStream*>(footage_->stream(stream_index_));
+
+  QString in_filename = footage_->filename();
+
+  // Most pixel formats and encoders require even dimensions
+  proxy_width_ = qMax(2, (video_stream->width() / divider_) & ~1);
+  proxy_height_ = qMax(2, (video_stream->height() / divider_) & ~1);
+
+  QString out_filename = GetProxyFilename();
+
+  footage_->Unlock();
+
+  // A proxy generated earlier for this exact file can be used as-is
+  if (!QFileInfo::exists(out_filename)) {
+    // Transcode to a temporary file so an incomplete proxy is never mistaken for a finished one
+    QString temp_filename = out_filename;
+    temp_filename.append(".part");
+
+    bool ok = Transcode(in_filename, temp_filename);
+
+    if (!ok || cancelled()) {
+      QFile::remove(temp_filename);
+      return (ok || cancelled());
+    }
+
+    if (!QFile::rename(temp_filename, out_filename)) {
+      QFile::remove(temp_filename);
+      set_error(tr("Failed to save proxy file \"%1\"").arg(out_filename));
+      return false;
+    }
+  }
+
+  footage_->Lock();
+
+  video_stream->set_proxy_filename(out_filename);
+  video_stream->set_proxy_resolution(proxy_width_, proxy_height_);
+
+  footage_->Unlock();
+
+  return true;
+}
+
+bool ProxyTask::Transcode(const QString &in_filename, const QString &out_filename)
+{
+  int error_code;
+
+  // Open the original file
+  QByteArray in_ba = in_filename.toUtf8();
+
+  // Set up the context ourselves so reading from unresponsive storage can be interrupted by cancelling
+  in_fmt_ctx_ = avformat_alloc_context();
+  in_fmt_ctx_->interrupt_callback.callback = InterruptCallback;
+  in_fmt_ctx_->interrupt_callback.opaque = const_cast<QAtomicInt*>(cancel_token());
+
+  error_code = avformat_open_input(&in_fmt_ctx_, in_ba.constData(), nullptr, nullptr);
+  if (error_code != 0) {
+    FFmpegError(tr("Failed to open input file"), error_code);
+    CleanUp();
+    return false;
+  }
+
+  error_code = avformat_find_stream_info(in_fmt_ctx_, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to find stream information"), error_code);
+    CleanUp();
+    return false;
+  }
+
+  if (static_cast<unsigned int>(stream_index_) >= in_fmt_ctx_->nb_streams) {
+    set_error(tr("Stream %1 doesn't exist in \"%2\"").arg(QString::number(stream_index_), in_filename));
+    CleanUp();
+    return false;
+  }
+
+  in_stream_ = in_fmt_ctx_->streams[stream_index_];
+
+  // Discard every other stream so the demuxer doesn't waste time on them
+  for (unsigned int i=0;i<in_fmt_ctx_->nb_streams;i++) {
+    if (in_fmt_ctx_->streams[i] != in_stream_) {
+      in_fmt_ctx_->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  // Open the decoder
+  AVCodec* decoder = avcodec_find_decoder(in_stream_->codecpar->codec_id);
+  if (decoder == nullptr) {
+    set_error(tr("Failed to find appropriate decoder for this codec"));
+    CleanUp();
+    return false;
+  }
+
+  dec_ctx_ = avcodec_alloc_context3(decoder);
+  if (dec_ctx_ == nullptr) {
+    set_error(tr("Failed to allocate decoder context"));
+    CleanUp();
+    return false;
+  }
+
+  error_code = avcodec_parameters_to_context(dec_ctx_, in_stream_->codecpar);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to copy decoder parameters"), error_code);
+    CleanUp();
+    return false;
+  }
+
+  // Let FFmpeg decide how many threads to decode with
+  dec_ctx_->thread_count = 0;
+
+  error_code = avcodec_open2(dec_ctx_, decoder, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open decoder"), error_code);
+    CleanUp();
+    return false;
+  }
+
+  if (!OpenEncoder(out_filename)) {
+    CleanUp();
+    return false;
+  }
+
+  // Determine the stream's range for progress reporting
+  int64_t start_time = (in_stream_->start_time == AV_NOPTS_VALUE) ? 0 : in_stream_->start_time;
+  int64_t duration = in_stream_->duration;
+
+  if (duration == AV_NOPTS_VALUE || duration <= 0) {
+    duration = av_rescale_q(in_fmt_ctx_->duration, AV_TIME_BASE_Q, in_stream_->time_base);
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+
+  bool ok = true;
+
+  while (Checkpoint()) {
+    error_code = av_read_frame(in_fmt_ctx_, pkt);
+
+    if (error_code == AVERROR_EOF) {
+      break;
+    } else if (error_code < 0) {
+      FFmpegError(tr("Failed to read packet"), error_code);
+      ok = false;
+      break;
+    }
+
+    if (pkt->stream_index == in_stream_->index) {
+      if (pkt->pts != AV_NOPTS_VALUE && duration > 0) {
+        int progress = qBound(0,
+                              qRound(100.0 * static_cast<double>(pkt->pts - start_time) / static_cast<double>(duration)),
+                              100);
+
+        set_progress(progress);
+      }
+
+      ok = DecodePacket(pkt, frame);
+    }
+
+    av_packet_unref(pkt);
+
+    if (!ok) {
+      break;
+    }
+  }
+
+  // Flush the decoder and encoder and finish the file
+  if (ok && !cancelled()) {
+    ok = DecodePacket(nullptr, frame) && EncodeFrame(nullptr);
+
+    if (ok) {
+      error_code = av_write_trailer(out_fmt_ctx_);
+
+      if (error_code < 0) {
+        FFmpegError(tr("Failed to finalize proxy file"), error_code);
+        ok = false;
+      }
+    }
+  }
+
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+
+  CleanUp();
+
+  return ok;
+}
+
+bool ProxyTask::OpenEncoder(const QString &out_filename)
+{
+  int error_code;
+
+  QByteArray out_ba = out_filename.toUtf8();
+
+  // The filename has a temporary extension so the muxer needs to be specified explicitly
+  error_code = avformat_alloc_output_context2(&out_fmt_ctx_, nullptr, "mov", out_ba.constData());
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create output file"), error_code);
+    return false;
+  }
+
+  // Prefer ProRes Proxy, fall back to Motion JPEG which is available in virtually every FFmpeg build
+  AVPixelFormat pix_fmt = AV_PIX_FMT_YUV422P10LE;
+  AVCodec* encoder = avcodec_find_encoder_by_name("prores_ks");
+
+  if (encoder == nullptr) {
+    pix_fmt = AV_PIX_FMT_YUVJ422P;
+    encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+  }
+
+  if (encoder == nullptr) {
+    set_error(tr("No suitable encoder for proxies is available"));
+    return false;
+  }
+
+  enc_ctx_ = avcodec_alloc_context3(encoder);
+  if (enc_ctx_ == nullptr) {
+    set_error(tr("Failed to allocate encoder context"));
+    return false;
+  }
+
+  enc_ctx_->width = proxy_width_;
+  enc_ctx_->height = proxy_height_;
+  enc_ctx_->pix_fmt = pix_fmt;
+  enc_ctx_->sample_aspect_ratio = in_stream_->codecpar->sample_aspect_ratio;
+
+  // Keep the original timebase so timestamps are identical between the original and the proxy
+  enc_ctx_->time_base = in_stream_->time_base;
+  enc_ctx_->framerate = in_stream_->avg_frame_rate;
+
+  if (encoder->id == AV_CODEC_ID_MJPEG) {
+    enc_ctx_->flags |= AV_CODEC_FLAG_QSCALE;
+    enc_ctx_->global_quality = FF_QP2LAMBDA * 4;
+  } else {
+    av_opt_set(enc_ctx_->priv_data, "profile", "proxy", 0);
+  }
+
+  if (out_fmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+    enc_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  enc_ctx_->thread_count = 0;
+
+  error_code = avcodec_open2(enc_ctx_, encoder, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open encoder"), error_code);
+    return false;
+  }
+
+  out_stream_ = avformat_new_stream(out_fmt_ctx_, nullptr);
+  if (out_stream_ == nullptr) {
+    set_error(tr("Failed to create output stream"));
+    return false;
+  }
+
+  error_code = avcodec_parameters_from_context(out_stream_->codecpar, enc_ctx_);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to copy encoder parameters"), error_code);
+    return false;
+  }
+
+  out_stream_->time_base = enc_ctx_->time_base;
+
+  out_fmt_ctx_->interrupt_callback.callback = InterruptCallback;
+  out_fmt_ctx_->interrupt_callback.opaque = const_cast<QAtomicInt*>(cancel_token());
+
+  error_code = avio_open2(&out_fmt_ctx_->pb, out_ba.constData(), AVIO_FLAG_WRITE, &out_fmt_ctx_->interrupt_callback,
+                          nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open output file"), error_code);
+    return false;
+  }
+
+  error_code = avformat_write_header(out_fmt_ctx_, nullptr);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to write output header"), error_code);
+    return false;
+  }
+
+  // Allocate the frame decoded frames will be scaled into
+  scaled_frame_ = av_frame_alloc();
+  scaled_frame_->format = enc_ctx_->pix_fmt;
+  scaled_frame_->width = proxy_width_;
+  scaled_frame_->height = proxy_height_;
+
+  error_code = av_frame_get_buffer(scaled_frame_, 0);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to allocate frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool ProxyTask::DecodePacket(AVPacket *pkt, AVFrame *frame)
+{
+  int error_code = avcodec_send_packet(dec_ctx_, pkt);
+
+  // A corrupt packet isn't worth failing the whole proxy over, the frame will just be missing
+  if (error_code == AVERROR_INVALIDDATA) {
+    return true;
+  } else if (error_code < 0) {
+    FFmpegError(tr("Failed to decode frame"), error_code);
+    return false;
+  }
+
+  while ((error_code = avcodec_receive_frame(dec_ctx_, frame)) >= 0) {
+    bool encoded = EncodeFrame(frame);
+
+    av_frame_unref(frame);
+
+    if (!encoded) {
+      return false;
+    }
+  }
+
+  if (error_code != AVERROR(EAGAIN) && error_code != AVERROR_EOF) {
+    FFmpegError(tr("Failed to decode frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool ProxyTask::EncodeFrame(AVFrame *frame)
+{
+  int error_code;
+  AVFrame* encode_frame = nullptr;
+
+  if (frame != nullptr) {
+    // The scaler is created here since the decoded pixel format is only reliable once a frame has been decoded
+    if (sws_ctx_ == nullptr) {
+      sws_ctx_ = sws_getContext(frame->width,
+                                frame->height,
+                                static_cast<AVPixelFormat>(frame->format),
+                                proxy_width_,
+                                proxy_height_,
+                                enc_ctx_->pix_fmt,
+                                SWS_BILINEAR,
+                                nullptr,
+                                nullptr,
+                                nullptr);
+
+      if (sws_ctx_ == nullptr) {
+        set_error(tr("Failed to create scaler"));
+        return false;
+      }
+    }
+
+    // The encoder may still be holding a reference to the previous frame's buffer
+    error_code = av_frame_make_writable(scaled_frame_);
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to allocate frame"), error_code);
+      return false;
+    }
+
+    sws_scale(sws_ctx_,
+              frame->data,
+              frame->linesize,
+              0,
+              frame->height,
+              scaled_frame_->data,
+              scaled_frame_->linesize);
+
+    scaled_frame_->pts = frame->best_effort_timestamp;
+
+    encode_frame = scaled_frame_;
+  }
+
+  error_code = avcodec_send_frame(enc_ctx_, encode_frame);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to encode frame"), error_code);
+    return false;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+
+  while ((error_code = avcodec_receive_packet(enc_ctx_, pkt)) >= 0) {
+    av_packet_rescale_ts(pkt, enc_ctx_->time_base, out_stream_->time_base);
+    pkt->stream_index = out_stream_->index;
+
+    // av_interleaved_write_frame() takes ownership of the packet's data
+    error_code = av_interleaved_write_frame(out_fmt_ctx_, pkt);
+
+    if (error_code < 0) {
+      av_packet_free(&pkt);
+      FFmpegError(tr("Failed to write packet"), error_code);
+      return false;
+    }
+  }
+
+  av_packet_free(&pkt);
+
+  if (error_code != AVERROR(EAGAIN) && error_code != AVERROR_EOF) {
+    FFmpegError(tr("Failed to encode frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void ProxyTask::CleanUp()
+{
+  if (out_fmt_ctx_ != nullptr) {
+    if (out_fmt_ctx_->pb != nullptr && !(out_fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&out_fmt_ctx_->pb);
+    }
+
+    avformat_free_context(out_fmt_ctx_);
+    out_fmt_ctx_ = nullptr;
+    out_stream_ = nullptr;
+  }
+
+  if (sws_ctx_ != nullptr) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+  }
+
+  av_frame_free(&scaled_frame_);
+  avcodec_free_context(&enc_ctx_);
+  avcodec_free_context(&dec_ctx_);
+
+  if (in_fmt_ctx_ != nullptr) {
+    if (in_fmt_ctx_->pb != nullptr) {
+      add_bytes_read(in_fmt_ctx_->pb->bytes_read);
+    }
+
+    avformat_close_input(&in_fmt_ctx_);
+    in_stream_ = nullptr;
+  }
+}
+
+void ProxyTask::FFmpegError(const QString &prefix, int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  set_error(QStringLiteral("%1: %2").arg(prefix, err));
+}
+
+QString ProxyTask::GetProxyFilename()
+{
+  // Generate a unique hash for this file, stream, and proxy size
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(footage_->filename().toUtf8());
+  hash.addData(QByteArray::number(footage_->timestamp().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(stream_index_));
+  hash.addData(QByteArray::number(divider_));
+
+  QDir proxy_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("proxy"));
+  proxy_dir.mkpath(".");
+
+  return proxy_dir.filePath(QStringLiteral("%1.mov").arg(QString(hash.result().toHex())));
+}
@@ -0,0 +1,135 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROXYTASK_H
+#define PROXYTASK_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A background task for generating a lower resolution proxy of a Footage's video stream
+ *
+ * The stream is transcoded to an intra-frame codec (ProRes Proxy, or Motion JPEG if ProRes isn't available) at a
+ * fraction of its original resolution. Intra-frame codecs seek and scrub far faster than the long-GOP codecs most
+ * cameras record to, and decoding fewer pixels is cheaper too.
+ *
+ * Once finished, the proxy is registered on the VideoStream (see VideoStream::set_proxy_filename()) and Decoders
+ * opened with a target resolution the proxy can satisfy will automatically decode it instead of the original (see
+ * Decoder::set_target_resolution()).
+ *
+ * Proxies are stored in the cache directory and named after the original file, so a proxy that already exists is
+ * registered without transcoding it again.
+ */
+class ProxyTask : public Task
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief ProxyTask Constructor
+   *
+   * @param footage
+   *
+   * The Footage containing the stream to generate a proxy for.
+   *
+   * @param stream_index
+   *
+   * Index of a video stream in the Footage.
+   *
+   * @param divider
+   *
+   * The proxy's width and height will be the original's divided by this.
+   */
+  ProxyTask(FootagePtr footage, int stream_index, int divider = 4);
+
+  virtual bool Action() override;
+
+private:
+  /**
+   * @brief Transcode the original stream to out_filename
+   *
+   * Calls set_error() and returns FALSE on failure. Always leaves all FFmpeg contexts freed.
+   */
+  bool Transcode(const QString& in_filename, const QString& out_filename);
+
+  /**
+   * @brief Initialize the output file and encoder
+   */
+  bool OpenEncoder(const QString& out_filename);
+
+  /**
+   * @brief Send a packet to the decoder (or flush it if pkt is nullptr) and encode every frame it outputs
+   */
+  bool DecodePacket(AVPacket* pkt, AVFrame* frame);
+
+  /**
+   * @brief Scale a decoded frame and send it to the encoder (or flush the encoder if frame is nullptr)
+   */
+  bool EncodeFrame(AVFrame* frame);
+
+  /**
+   * @brief Free all FFmpeg contexts
+   */
+  void CleanUp();
+
+  /**
+   * @brief Sets an error message from an FFmpeg error code
+   */
+  void FFmpegError(const QString& prefix, int error_code);
+
+  /**
+   * @brief Filename the proxy for this Footage stream will be stored at
+   */
+  QString GetProxyFilename();
+
+  FootagePtr footage_;
+
+  int stream_index_;
+
+  int divider_;
+
+  int proxy_width_;
+
+  int proxy_height_;
+
+  AVFormatContext* in_fmt_ctx_;
+
+  AVStream* in_stream_;
+
+  AVCodecContext* dec_ctx_;
+
+  AVFormatContext* out_fmt_ctx_;
+
+  AVStream* out_stream_;
+
+  AVCodecContext* enc_ctx_;
+
+  SwsContext* sws_ctx_;
+
+  AVFrame* scaled_frame_;
+};
+
+#endif // PROXYTASK_H
@@ -20,13 +20,72 @@
 
 #include "task.h"
 
+#include <QStorageInfo>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "common/threadpolicy.h"
+#include "common/tracing.h"
+#include "task/taskmanager.h"
+
+namespace {
+
+// CPU time used by the calling thread so far in milliseconds
+qint64 GetThreadCpuTime()
+{
+#if defined(Q_OS_WIN)
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+
+  if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+    return 0;
+  }
+
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+
+  // FILETIMEs are in 100 nanosecond units
+  return static_cast<qint64>((kernel.QuadPart + user.QuadPart) / 10000);
+#else
+  timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+
+  return static_cast<qint64>(ts.tv_sec) * 1000 + static_cast<qint64>(ts.tv_nsec) / 1000000;
+#endif
+}
+
+}
+
 Task::Task() :
   status_(kWaiting),
-  thread_(this),
+  priority_(kNormalPriority),
+  resource_class_(kCPU),
+  remaining_time_(-1),
+  emitted_progress_(0),
+  result_(false),
+  running_(false),
   text_(tr("Task")),
-  cancelled_(false)
+  cancelled_(0),
+  paused_(false)
+{
+  ResetTiming();
+}
+
+Task::~Task()
 {
-  connect(&thread_, SIGNAL(finished()), this, SLOT(ThreadComplete()));
+  SetCancelled();
+
+  WaitForRun();
 }
 
 bool Task::Start()
@@ -56,11 +115,22 @@ bool Task::Start()
     }
   }
 
-  cancelled_ = false;
+  cancelled_.store(0);
+
+  progress_.store(0);
+  remaining_time_.store(-1);
+  emitted_progress_ = 0;
+  progress_timer_.invalidate();
+
+  ResetTiming();
 
   set_status(kWorking);
 
-  thread_.start();
+  running_lock_.lock();
+  running_ = true;
+  running_lock_.unlock();
+
+  olive::task_manager.pool()->Submit(this);
 
   return true;
 }
@@ -75,6 +145,31 @@ const Task::Status &Task::status()
   return status_;
 }
 
+const Task::Priority &Task::priority()
+{
+  return priority_;
+}
+
+const Task::ResourceClass &Task::resource_class()
+{
+  return resource_class_;
+}
+
+int Task::progress()
+{
+  return progress_.load();
+}
+
+qint64 Task::remaining_time()
+{
+  return remaining_time_.load();
+}
+
+const Task::Timing &Task::timing()
+{
+  return timing_;
+}
+
 const QString &Task::text()
 {
   return text_;
@@ -93,6 +188,16 @@ void Task::AddDependency(Task *dependency)
   dependencies_.append(dependency);
 }
 
+const QList<Task *> &Task::dependencies()
+{
+  return dependencies_;
+}
+
+void Task::StartQueueTimer()
+{
+  queue_timer_.start();
+}
+
 void Task::EmitRemovedSignal()
 {
   emit Removed();
@@ -108,13 +213,42 @@ void Task::ResetState()
     Cancel();
   }
 
-  cancelled_ = false;
+  cancelled_.store(0);
+
+  pause_lock_.lock();
+  paused_ = false;
+  pause_lock_.unlock();
 
   set_error(QString());
 
+  ResetTiming();
+
   set_status(kWaiting);
 }
 
+void Task::Pause()
+{
+  QMutexLocker locker(&pause_lock_);
+
+  paused_ = true;
+}
+
+void Task::Resume()
+{
+  QMutexLocker locker(&pause_lock_);
+
+  paused_ = false;
+
+  pause_wake_.wakeAll();
+}
+
+bool Task::paused()
+{
+  QMutexLocker locker(&pause_lock_);
+
+  return paused_;
+}
+
 void Task::Cancel()
 {
   if (status_ == kWaiting) {
@@ -125,10 +259,10 @@ void Task::Cancel()
     return;
   }
 
-  cancelled_ = true;
+  SetCancelled();
 
   // FIXME: Should we limit the wait time?
-  thread_.wait();
+  WaitForRun();
 }
 
 void Task::set_error(const QString &s)
@@ -141,9 +275,78 @@ void Task::set_text(const QString &s)
   text_ = s;
 }
 
+void Task::set_priority(const Task::Priority &priority)
+{
+  priority_ = priority;
+}
+
+void Task::set_resource_class(const Task::ResourceClass &resource_class)
+{
+  resource_class_ = resource_class;
+}
+
+Task::ResourceClass Task::GetIOClass(const QString &filename)
+{
+  QByteArray type = QStorageInfo(filename).fileSystemType();
+
+  if (type.startsWith("nfs")
+      || type.startsWith("cifs")
+      || type.startsWith("smb")
+      || type.contains("sshfs")
+      || type == "afpfs"
+      || type == "webdav"
+      || type == "davfs") {
+    return kNetworkIO;
+  }
+
+  return kDiskIO;
+}
+
+void Task::set_progress(int p)
+{
+  if (progress_.fetchAndStoreRelaxed(p) == p) {
+    return;
+  }
+
+  if (progress_timer_.isValid() && progress_timer_.elapsed() < kProgressInterval) {
+    return;
+  }
+
+  progress_timer_.start();
+
+  emitted_progress_ = p;
+  emit ProgressChanged(p);
+}
+
+void Task::set_remaining_time(qint64 msecs)
+{
+  remaining_time_.store(msecs);
+}
+
+void Task::add_bytes_read(qint64 bytes)
+{
+  timing_.bytes_read += bytes;
+}
+
 bool Task::cancelled()
 {
-  return cancelled_;
+  return cancelled_.load() != 0;
+}
+
+const QAtomicInt *Task::cancel_token()
+{
+  return &cancelled_;
+}
+
+bool Task::Checkpoint()
+{
+  QMutexLocker locker(&pause_lock_);
+
+  while (paused_ && !cancelled()) {
+    pause_wake_.wait(&pause_lock_);
+  }
+
+  return !cancelled();
 }
 
 void Task::set_status(const Task::Status &status)
@@ -153,11 +356,97 @@ void Task::set_status(const Task::Status &status)
   emit StatusChanged(status_);
 }
 
+void Task::Run()
+{
+  bool result = false;
+
+  // A Task cancelled while it was still queued doesn't need to run at all
+  if (!cancelled()) {
+    // Keep background work (e.g. generating proxies) from taking time away from playback
+    if (priority_ == kBackgroundPriority) {
+      ThreadPolicy::Apply(ThreadPolicy::kRoleBackground);
+    }
+
+    timing_.queue_wait = queue_timer_.isValid() ? queue_timer_.elapsed() : 0;
+
+    QElapsedTimer wall_timer;
+    wall_timer.start();
+
+    qint64 cpu_start = GetThreadCpuTime();
+
+    {
+      Tracing::Span span("task", "Task::Action");
+
+      if (span.IsActive()) {
+        span.SetDetail(text());
+      }
+
+      result = Action();
+    }
+
+    timing_.cpu_time = GetThreadCpuTime() - cpu_start;
+    timing_.wall_time = wall_timer.elapsed();
+
+    if (priority_ == kBackgroundPriority) {
+      ThreadPolicy::Apply(ThreadPolicy::kRoleWorker);
+    }
+
+    // Make sure the last progress reported is seen even if it came too soon after the previous one
+    int progress = progress_.load();
+
+    if (progress != emitted_progress_) {
+      emitted_progress_ = progress;
+      emit ProgressChanged(progress);
+    }
+  }
+
+  result_ = result;
+
+  // Queue the status change before anything waiting on this Task (e.g. its destructor) is woken up
+  QMetaObject::invokeMethod(this, "ThreadComplete", Qt::QueuedConnection);
+
+  QMutexLocker locker(&running_lock_);
+  running_ = false;
+  running_done_.wakeAll();
+}
+
+void Task::SetCancelled()
+{
+  cancelled_.store(1);
+
+  // Taking the lock makes sure a Checkpoint() either sees cancelled_ or is already waiting to be woken
+  QMutexLocker locker(&pause_lock_);
+
+  pause_wake_.wakeAll();
+}
+
+void Task::ResetTiming()
+{
+  timing_.queue_wait = 0;
+  timing_.wall_time = -1;
+  timing_.cpu_time = 0;
+  timing_.bytes_read = 0;
+}
+
+void Task::WaitForRun()
+{
+  QMutexLocker locker(&running_lock_);
+
+  while (running_) {
+    running_done_.wait(&running_lock_);
+  }
+}
+
 void Task::ThreadComplete()
 {
-  // thread_.result() will be set to the return value of Action()
+  // The Task may have been reset since Action() returned
+  if (status_ != kWorking) {
+    return;
+  }
+
+  // result_ will be set to the return value of Action()
 
-  if (thread_.result()) {
+  if (result_) {
     set_status(kFinished);
   } else {
     set_status(kError);
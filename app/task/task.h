@@ -22,15 +22,17 @@
 #define TASK_H
 
 #include <memory>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QObject>
-
-#include "task/taskthread.h"
+#include <QWaitCondition>
 
 /**
  * @brief A base class for background tasks running in Olive.
  *
- * Tasks are multithreaded by design (i.e. they will always spawn
- * a new thread and run in it).
+ * Tasks are multithreaded by design (i.e. Action() always runs on one of the threads of TaskManager's TaskPool).
  *
  * To subclass your own Task, override Action() and return TRUE on success or FALSE on failure. Note that a Task can
  * provide a "negative" output and still have succeeded. For example, the ProbeTask's role is to determine whether a
@@ -67,16 +69,81 @@ public:
     kError
   };
 
+  /**
+   * @brief The Priority enum
+   *
+   * TaskManager always starts waiting Tasks in this order, and background Tasks also run in a low priority thread.
+   *
+   * Use kInteractivePriority for short work the user is waiting on right now (e.g. probing media that was just
+   * imported) and kBackgroundPriority for long work that refines something the user can already work with (e.g. deep
+   * probing, waveforms and proxies). If a higher priority Task is waiting and no thread is available, TaskManager
+   * pauses a background Task at its next Checkpoint() to make room.
+   */
+  enum Priority {
+    kInteractivePriority,
+    kNormalPriority,
+    kBackgroundPriority
+  };
+
+  /**
+   * @brief The ResourceClass enum
+   *
+   * The resource a Task mostly waits on. TaskManager limits how many Tasks of each class run at once separately, so
+   * e.g. Tasks stuck reading from a slow network share don't keep CPU bound Tasks from running.
+   */
+  enum ResourceClass {
+    /// Reading or writing local storage
+    kDiskIO,
+
+    /// Reading or writing network storage
+    kNetworkIO,
+
+    /// Computation (the default)
+    kCPU,
+
+    /// Rendering on the graphics card
+    kGPU,
+
+    /// Hardware encoding, which usually supports very few simultaneous sessions
+    kEncoder,
+
+    kResourceClassCount
+  };
+
+  /**
+   * @brief Where a Task's time went the last time it ran
+   */
+  struct Timing {
+    /// Milliseconds between being queued by TaskManager and Action() starting, including waiting on dependencies
+    qint64 queue_wait;
+
+    /// Milliseconds Action() ran for (including any time spent paused), -1 if it never ran
+    qint64 wall_time;
+
+    /// Milliseconds of CPU time the thread running Action() used
+    qint64 cpu_time;
+
+    /// Bytes Action() read from storage (see add_bytes_read())
+    qint64 bytes_read;
+  };
+
   /**
    * @brief Task Constructor
    */
   Task();
 
+  /**
+   * @brief Task Destructor
+   *
+   * Waits for Action() to return if the Task is still running.
+   */
+  virtual ~Task() override;
+
   /**
    * @brief Try to start this Task
    *
-   * The main function for starting this Task. If this task is currently waiting, this function will start a new thread
-   * and set the status to kWorking.
+   * The main function for starting this Task. If this task is currently waiting, this function will queue it on
+   * TaskManager's TaskPool and set the status to kWorking.
    *
    * This function also checks its dependency Tasks and will only start if all of them are complete. If they are still
    * working, this function will return FALSE and the status will continue to be kWaiting. If any of them failed, this
@@ -91,10 +158,10 @@ public:
   /**
    * @brief The main Task function
    *
-   * Action() is the function that gets called once another thread has been created. This function should be overridden
-   * in subclasses.
+   * Action() is the function that gets called on a pool thread once the Task has started. This function should be
+   * overridden in subclasses.
    *
-   * It's also recommended to emit ProgressChanged() throughout your Action() so that any attached ProgressBars can
+   * It's also recommended to call set_progress() throughout your Action() so that any attached ProgressBars can
    * show accurate progress information.
    *
    * @return
@@ -114,6 +181,38 @@ public:
    */
   const Status& status();
 
+  /**
+   * @brief Priority of this Task (defaults to kNormalPriority)
+   */
+  const Priority& priority();
+
+  /**
+   * @brief Resource class of this Task (defaults to kCPU)
+   */
+  const ResourceClass& resource_class();
+
+  /**
+   * @brief Latest progress set by set_progress() (a percentage between 0 and 100)
+   *
+   * Cheap and thread-safe, so it can be polled instead of waiting on ProgressChanged().
+   */
+  int progress();
+
+  /**
+   * @brief Milliseconds the Task expects Action() to keep running for, -1 if it can't tell (the default)
+   *
+   * Set by Tasks that can predict it with set_remaining_time(). Cheap and thread-safe like progress(), it's up to date
+   * whenever ProgressChanged() is emitted.
+   */
+  qint64 remaining_time();
+
+  /**
+   * @brief Timing of the last run
+   *
+   * Only valid once the Task has finished or failed.
+   */
+  const Timing& timing();
+
   /**
    * @brief Retrieve the current title of this Task
    */
@@ -140,6 +239,16 @@ public:
    */
   void AddDependency(Task* dependency);
 
+  /**
+   * @brief Tasks added with AddDependency()
+   */
+  const QList<Task*>& dependencies();
+
+  /**
+   * @brief Start measuring Timing::queue_wait, called by TaskManager when the Task is queued
+   */
+  void StartQueueTimer();
+
   /**
    * @brief Emit the Removed() signal when this Task is about to get removed
    */
@@ -150,6 +259,24 @@ public:
    */
   void ResetState();
 
+  /**
+   * @brief Ask a working Task to wait at its next Checkpoint() until Resume() is called
+   *
+   * Used by TaskManager to make room for higher priority Tasks. Tasks that never call Checkpoint() keep running.
+   * Thread-safe.
+   */
+  void Pause();
+
+  /**
+   * @brief Let a paused Task continue
+   */
+  void Resume();
+
+  /**
+   * @brief Returns TRUE between Pause() and Resume()
+   */
+  bool paused();
+
 public slots:
   /**
    * @brief Cancel the Task
@@ -157,8 +284,9 @@ public slots:
    * Sends a signal to the Task to stop and waits for the Task to finish before returning. Tasks must be responsive to
    * cancelling so that the main thread doesn't halt for too long.
    *
-   * Cancel()'s function is fairly simple, it sets cancelled_ to TRUE and waits for the thread to return. It's the
-   * responsibility of the code in Action() to be able to respond quickly to cancelled_ changing.
+   * Cancel()'s function is fairly simple, it sets cancelled_ to TRUE and waits for Action() to return. It's the
+   * responsibility of the code in Action() to be able to respond quickly to cancelled_ changing (see cancel_token()
+   * for work that blocks outside of the Task).
    */
   void Cancel();
 
@@ -180,11 +308,78 @@ protected:
    */
   void set_text(const QString& s);
 
+  /**
+   * @brief Set the Task priority
+   *
+   * Generally this should be set in the constructor. Changing it while the Task is working has no effect until the
+   * Task is started again.
+   */
+  void set_priority(const Priority& priority);
+
+  /**
+   * @brief Set the Task's resource class
+   *
+   * Must be set before the Task is added to TaskManager, generally in the constructor.
+   */
+  void set_resource_class(const ResourceClass& resource_class);
+
+  /**
+   * @brief Returns kNetworkIO if a file is on network storage, kDiskIO if not
+   */
+  static ResourceClass GetIOClass(const QString& filename);
+
+  /**
+   * @brief Report progress from Action()
+   *
+   * Can be called as often as is convenient. ProgressChanged() is emitted at most every kProgressInterval
+   * milliseconds (and once more when Action() returns if the last value wasn't emitted), so reporting never costs
+   * more than the work being reported on.
+   *
+   * @param p
+   *
+   * A value (percentage) between 0 and 100.
+   */
+  void set_progress(int p);
+
+  /**
+   * @brief Report how many more milliseconds Action() expects to run for, or -1 if it can't tell
+   *
+   * Set it before the set_progress() it goes with so the two are seen together.
+   */
+  void set_remaining_time(qint64 msecs);
+
+  /**
+   * @brief Report bytes read from storage by Action() for Timing::bytes_read
+   *
+   * Only call this from Action().
+   */
+  void add_bytes_read(qint64 bytes);
+
   /**
    * @brief Returns whether the thread has been explicitly cancelled or not
    */
   bool cancelled();
 
+  /**
+   * @brief Non-zero once the Task has been cancelled
+   *
+   * Pass this to code that can block for a long time outside of Action()'s control (e.g. Decoder::set_cancel_token()
+   * or an FFmpeg interrupt callback) so cancelling aborts it too. Valid for the lifetime of the Task.
+   */
+  const QAtomicInt* cancel_token();
+
+  /**
+   * @brief A point in Action() where the Task can safely be paused
+   *
+   * Blocks while the Task is paused (see Pause()). Long running Tasks, especially background ones, should call this
+   * regularly instead of only checking cancelled().
+   *
+   * @return
+   *
+   * FALSE if the Task has been cancelled and Action() should return.
+   */
+  bool Checkpoint();
+
 signals:
   /**
    * @brief Signal emitted whenever the Task status changes
@@ -194,7 +389,7 @@ signals:
   /**
    * @brief Signal emitted whenever progress is made
    *
-   * Emit this throughout Action() to update any attached ProgressBars on the progress of this Task.
+   * Emitted by set_progress() from the thread running Action(), rate limited so receivers aren't flooded.
    *
    * @param p
    *
@@ -218,9 +413,58 @@ private:
    */
   void set_status(const Task::Status& status);
 
+  /**
+   * @brief Run Action() on the calling pool thread (unless the Task was cancelled before it got there)
+   */
+  void Run();
+
+  /**
+   * @brief Wait until Run() has returned, if the Task was started
+   */
+  void WaitForRun();
+
+  /**
+   * @brief Set cancelled_ and wake the Task up if it's waiting at a Checkpoint()
+   */
+  void SetCancelled();
+
+  /**
+   * @brief Clear timing_ before the Task (re)starts
+   */
+  void ResetTiming();
+
   Status status_;
 
-  TaskThread thread_;
+  Priority priority_;
+
+  ResourceClass resource_class_;
+
+  // Most frequently ProgressChanged() is emitted (in milliseconds)
+  static const qint64 kProgressInterval = 33;
+
+  QAtomicInt progress_;
+
+  QAtomicInteger<qint64> remaining_time_;
+
+  // Only used by the thread running Action()
+  int emitted_progress_;
+
+  QElapsedTimer progress_timer_;
+
+  // Written by the thread running Action() before ThreadComplete() is queued
+  Timing timing_;
+
+  QElapsedTimer queue_timer_;
+
+  // Return value of Action()
+  bool result_;
+
+  // TRUE from Start() until Run() returns, protected by running_lock_
+  bool running_;
+
+  QMutex running_lock_;
+
+  QWaitCondition running_done_;
 
   QString text_;
 
@@ -228,13 +472,22 @@ private:
 
   QList<Task*> dependencies_;
 
-  bool cancelled_;
+  QAtomicInt cancelled_;
+
+  // Protected by pause_lock_
+  bool paused_;
+
+  QMutex pause_lock_;
+
+  QWaitCondition pause_wake_;
 
 private slots:
   /**
-   * @brief A slot when the inner thread completes either successfully or unsuccessfully
+   * @brief A slot when Action() completes either successfully or unsuccessfully
    */
   void ThreadComplete();
+
+  friend class TaskPool;
 };
 
 using TaskPtr = std::shared_ptr<Task>;
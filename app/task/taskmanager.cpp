@@ -25,9 +25,55 @@
 
 TaskManager olive::task_manager;
 
-TaskManager::TaskManager()
+namespace {
+
+int GetDefaultResourceLimit(Task::ResourceClass resource_class)
+{
+  switch (resource_class) {
+  case Task::kDiskIO:
+    // A few requests in flight keep a disk busy, more just make it seek
+    return 4;
+  case Task::kNetworkIO:
+    // Network storage is mostly latency, so more requests can be in flight
+    return 8;
+  case Task::kCPU:
+    return QThread::idealThreadCount();
+  case Task::kGPU:
+    return 1;
+  case Task::kEncoder:
+    return 2;
+  case Task::kResourceClassCount:
+    break;
+  }
+
+  return 1;
+}
+
+int GetDefaultPoolSize()
+{
+  int running = 0;
+
+  for (int i=0;i<Task::kResourceClassCount;i++) {
+    running += GetDefaultResourceLimit(static_cast<Task::ResourceClass>(i));
+  }
+
+  // Every class can have as many paused Tasks as running ones
+  return running * 2 + 1;
+}
+
+}
+
+TaskManager::TaskManager() :
+  resources_(Task::kResourceClassCount),
+  pool_(GetDefaultPoolSize())
 {
-  maximum_task_count_ = QThread::idealThreadCount();
+  for (int i=0;i<resources_.size();i++) {
+    ResourceQueue& resource = resources_[i];
+
+    resource.maximum = GetDefaultResourceLimit(static_cast<Task::ResourceClass>(i));
+    resource.ready.resize(Task::kBackgroundPriority + 1);
+    resource.paused.resize(Task::kBackgroundPriority + 1);
+  }
 }
 
 TaskManager::~TaskManager()
@@ -41,50 +87,189 @@ void TaskManager::AddTask(TaskPtr t)
   connect(t.get(), SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskCallback(Task::Status)));
 
   // Add the Task to the queue
-  tasks_.append(t);
+  tasks_.insert(t.get(), t);
+
+  QueueTask(t.get());
 
   // Emit signal that a Task was added
   emit TaskAdded(t.get());
 
-  // Scan through queue and start any Tasks that can (including this one)
+  // Start any Tasks that can (including this one)
   StartNextWaiting();
 }
 
 void TaskManager::Clear()
 {
-  // Delete Tasks from memory
-  for (int i=0;i<tasks_.size();i++) {
-    tasks_.at(i)->Cancel();
-  }
+  QList<TaskPtr> tasks = tasks_.values();
+
   tasks_.clear();
+  finished_.clear();
+  outstanding_dependencies_.clear();
+  dependents_.clear();
+
+  for (int i=0;i<resources_.size();i++) {
+    ResourceQueue& resource = resources_[i];
+
+    for (int j=0;j<resource.ready.size();j++) {
+      resource.ready[j].clear();
+      resource.paused[j].clear();
+    }
+
+    resource.running.clear();
+  }
+
+  // Delete Tasks from memory, without cancelling one starting another
+  foreach (TaskPtr t, tasks) {
+    disconnect(t.get(), SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskCallback(Task::Status)));
+
+    t->Cancel();
+  }
+}
+
+int TaskManager::resource_limit(Task::ResourceClass resource_class)
+{
+  return resources_.at(resource_class).maximum;
+}
+
+const TaskStatistics &TaskManager::statistics()
+{
+  return statistics_;
+}
+
+void TaskManager::ClearStatistics()
+{
+  statistics_.Clear();
+
+  emit StatisticsChanged();
 }
 
 void TaskManager::StartNextWaiting()
 {
-  // Count the tasks that are currently active
-  int working_count = 0;
+  // Resume or start Tasks in order of priority while their class is below its limit, paused Tasks don't count
+  for (int p=Task::kInteractivePriority;p<=Task::kBackgroundPriority;p++) {
+    for (int r=0;r<resources_.size();r++) {
+      ResourceQueue& resource = resources_[r];
+      QList<Task*>& paused = resource.paused[p];
+      QList<Task*>& ready = resource.ready[p];
+
+      // Paused Tasks were started before anything waiting at the same priority, so they continue first
+      while (!paused.isEmpty() && resource.running.size() < resource.maximum) {
+        Task* t = paused.takeFirst();
+
+        t->Resume();
+        resource.running.append(t);
+      }
 
-  for (int i=0;i<tasks_.size();i++) {
-    TaskPtr t = tasks_.at(i);
+      while (!ready.isEmpty()) {
+        Task* background = nullptr;
 
-    if (t->status() == Task::kWorking) {
+        if (resource.running.size() >= resource.maximum) {
+          // Class is at its limit, make room by pausing a background Task if this one is more important
+          if (p != Task::kBackgroundPriority) {
+            background = GetPausableTask(resource);
+          }
 
-      // Task is active, add it to the count
-      working_count++;
+          if (background == nullptr) {
+            break;
+          }
+        }
 
-    } else if (t->status() == Task::kWaiting) {
+        Task* t = ready.takeFirst();
 
-      // Task is waiting and we have available threads, try to start it
-      if (t->Start()) {
-        // If it started, add it to the working count
-        working_count++;
+        // Start() also fails the Task if one of its dependencies failed
+        if (t->Start()) {
+          resource.running.append(t);
+
+          if (background != nullptr) {
+            background->Pause();
+            resource.running.removeOne(background);
+            resource.paused[Task::kBackgroundPriority].append(background);
+          }
+        }
       }
+    }
+  }
+}
+
+Task *TaskManager::GetPausableTask(const ResourceQueue &queue)
+{
+  // Prefer the most recently started Task, which has done the least work so far
+  for (int i=queue.running.size()-1;i>=0;i--) {
+    Task* t = queue.running.at(i);
+
+    if (t->priority() == Task::kBackgroundPriority) {
+      return t;
+    }
+  }
+
+  return nullptr;
+}
+
+TaskManager::ResourceQueue &TaskManager::queue(Task *t)
+{
+  return resources_[t->resource_class()];
+}
+
+void TaskManager::QueueTask(Task *t)
+{
+  if (t->status() != Task::kWaiting) {
+    return;
+  }
+
+  int outstanding = 0;
+
+  foreach (Task* dependency, t->dependencies()) {
+    if (dependency->status() == Task::kWaiting || dependency->status() == Task::kWorking) {
+      dependents_[dependency].append(t);
+      outstanding++;
+    }
+  }
+
+  t->StartQueueTimer();
+
+  if (outstanding == 0) {
+    queue(t).ready[t->priority()].append(t);
+  } else {
+    outstanding_dependencies_.insert(t, outstanding);
+  }
+}
+
+void TaskManager::ReleaseDependents(Task *t)
+{
+  QVector<Task*> dependents = dependents_.take(t);
+
+  foreach (Task* dependent, dependents) {
+    QHash<Task*, int>::iterator outstanding = outstanding_dependencies_.find(dependent);
+
+    if (outstanding == outstanding_dependencies_.end()) {
+      continue;
+    }
+
+    outstanding.value()--;
+
+    if (outstanding.value() == 0) {
+      outstanding_dependencies_.erase(outstanding);
 
+      queue(dependent).ready[dependent->priority()].append(dependent);
     }
+  }
+}
+
+void TaskManager::UnqueueTask(Task *t)
+{
+  ResourceQueue& resource = queue(t);
 
-    // Check if the count exceeds our maximum threads, if so stop here
-    if (working_count == maximum_task_count_) {
-      break;
+  resource.running.removeOne(t);
+  resource.ready[t->priority()].removeOne(t);
+  resource.paused[t->priority()].removeOne(t);
+
+  if (outstanding_dependencies_.remove(t) > 0) {
+    foreach (Task* dependency, t->dependencies()) {
+      QHash<Task*, QVector<Task*> >::iterator dependents = dependents_.find(dependency);
+
+      if (dependents != dependents_.end()) {
+        dependents.value().removeAll(t);
+      }
     }
   }
 }
@@ -95,30 +280,79 @@ void TaskManager::DeleteTask(Task *t)
   t->Cancel();
 
   // Remove instances of Task from queue
-  for (int i=0;i<tasks_.size();i++) {
-    if (tasks_.at(i).get() == t) {
-      t->EmitRemovedSignal();
-      tasks_.removeAt(i);
-      break;
-    }
+  UnqueueTask(t);
+  finished_.removeAll(t);
+
+  QHash<Task*, TaskPtr>::iterator i = tasks_.find(t);
+
+  if (i != tasks_.end()) {
+    t->EmitRemovedSignal();
+
+    // Tasks still waiting on this one would otherwise never become ready
+    ReleaseDependents(t);
+
+    tasks_.erase(i);
   }
 }
 
 void TaskManager::TaskCallback(Task::Status status)
 {
   if (status == Task::kFinished || status == Task::kError) {
-    // The Task has finished, we can start a new one
-    StartNextWaiting();
+    // Only the first Task to finish in this event loop iteration needs to schedule the batch
+    if (finished_.isEmpty()) {
+      QMetaObject::invokeMethod(this, "ProcessFinishedTasks", Qt::QueuedConnection);
+    }
+
+    finished_.append(static_cast<Task*>(sender()));
+  }
+}
+
+void TaskManager::ProcessFinishedTasks()
+{
+  QVector<Task*> finished = finished_;
+  finished_.clear();
+
+  bool statistics_changed = false;
+
+  foreach (Task* t, finished) {
+    ResourceQueue& resource = queue(t);
+
+    // Both are bounded by the class's limit, so removing from them stays cheap however many Tasks are queued
+    resource.running.removeOne(t);
+    resource.paused[t->priority()].removeOne(t);
+
+    // Only Tasks that actually ran say anything about where time goes
+    if (t->timing().wall_time >= 0) {
+      statistics_.Add(t->metaObject()->className(), t->timing());
+
+      statistics_changed = true;
+    }
 
-    if (status == Task::kFinished) {
+    // Tasks depending on this one can now start (or fail)
+    ReleaseDependents(t);
+
+    if (t->status() == Task::kFinished) {
       // The Task was successful, remove this Task from the queue
-      DeleteTask(static_cast<Task*>(sender()));
+      QHash<Task*, TaskPtr>::iterator i = tasks_.find(t);
+
+      if (i != tasks_.end()) {
+        t->EmitRemovedSignal();
+
+        tasks_.erase(i);
+      }
     }
   }
+
+  if (statistics_changed) {
+    emit StatisticsChanged();
+  }
+
+  // Start replacements for everything that finished in one pass
+  StartNextWaiting();
 }
 
 TaskManager::AddTaskCommand::AddTaskCommand(TaskPtr t, QUndoCommand *parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   task_(t)
 {
 }
@@ -134,3 +368,47 @@ void TaskManager::AddTaskCommand::undo()
 
   task_->ResetState();
 }
+
+qint64 TaskManager::AddTaskCommand::memory_cost() const
+{
+  return static_cast<qint64>(sizeof(*this) + sizeof(Task));
+}
+
+void TaskManager::AddTaskCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  Q_UNUSED(journal)
+  Q_UNUSED(undo)
+}
+
+TaskManager::AddTasksCommand::AddTasksCommand(const QVector<TaskPtr> &tasks, QUndoCommand *parent) :
+  UndoCommand(parent),
+  tasks_(tasks)
+{
+}
+
+void TaskManager::AddTasksCommand::redo()
+{
+  foreach (TaskPtr task, tasks_) {
+    olive::task_manager.AddTask(task);
+  }
+}
+
+void TaskManager::AddTasksCommand::undo()
+{
+  for (int i=tasks_.size()-1;i>=0;i--) {
+    olive::task_manager.DeleteTask(tasks_.at(i).get());
+
+    tasks_.at(i)->ResetState();
+  }
+}
+
+qint64 TaskManager::AddTasksCommand::memory_cost() const
+{
+  return static_cast<qint64>(sizeof(*this)) + tasks_.size() * static_cast<qint64>(sizeof(TaskPtr) + sizeof(Task));
+}
+
+void TaskManager::AddTasksCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  Q_UNUSED(journal)
+  Q_UNUSED(undo)
+}
@@ -21,18 +21,23 @@
 #ifndef TASKMANAGER_H
 #define TASKMANAGER_H
 
+#include <QHash>
 #include <QVector>
-#include <QUndoCommand>
-
 #include "task/task.h"
+#include "task/taskpool.h"
+#include "task/taskstatistics.h"
+#include "undo/undocommand.h"
 
 /**
  * @brief An object that manages background Task objects, handling their start and end
  *
  * TaskManager handles the life of a Task object. After a new Task is created, it should be sent to TaskManager through
  * AddTask(). TaskManager will take ownership of the task and add it to a queue until it system resources are available
- * for it to run. Currently, TaskManager will run no more Tasks than there are threads on the system (one task per
- * thread). As Tasks finished, TaskManager will start the next in the queue.
+ * for it to run. TaskManager limits how many Tasks run at once separately for each Task::ResourceClass, e.g. no more CPU
+ * bound Tasks than there are threads on the system and a single GPU bound Task. As Tasks finished, TaskManager will
+ * start the next in the queue.
+ *
+ * Started Tasks run on a TaskPool owned by TaskManager, so threads are reused rather than created for every Task.
  */
 class TaskManager : public QObject
 {
@@ -92,10 +97,33 @@ public:
    */
   void Clear();
 
+  /**
+   * @brief The threads Tasks run on once they've started
+   *
+   * Has room for every running Task of every class, every paused Task and one more so a Task started directly (e.g. with
+   * Core::StartModalTask()) never waits behind a full queue. Paused Tasks keep their thread while they wait.
+   */
+  TaskPool* pool();
+
+  /**
+   * @brief How many Tasks of a resource class can run at once
+   */
+  int resource_limit(Task::ResourceClass resource_class);
+
+  /**
+   * @brief Timing of every Task that has run since the application started (or ClearStatistics() was called)
+   */
+  const TaskStatistics& statistics();
+
+  /**
+   * @brief Clear statistics()
+   */
+  void ClearStatistics();
+
   /**
    * @brief Undoable command for adding a Task to the TaskManager
    */
-  class AddTaskCommand : public QUndoCommand {
+  class AddTaskCommand : public UndoCommand {
   public:
     AddTaskCommand(TaskPtr t, QUndoCommand* parent = nullptr);
 
@@ -114,10 +142,40 @@ public:
      */
     virtual void undo() override;
 
+    virtual qint64 memory_cost() const override;
+
+    /**
+     * @brief Tasks don't change the project themselves, so there's nothing to journal
+     */
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
   private:
     TaskPtr task_;
   };
 
+  /**
+   * @brief Undoable command for adding several Tasks to the TaskManager at once
+   *
+   * Stores the Tasks in a single list, which takes much less memory than an AddTaskCommand for each of them when
+   * importing thousands of files. Tasks are added in order (dependencies should come before their dependents) and
+   * removed in reverse order.
+   */
+  class AddTasksCommand : public UndoCommand {
+  public:
+    AddTasksCommand(const QVector<TaskPtr>& tasks, QUndoCommand* parent = nullptr);
+
+    virtual void redo() override;
+
+    virtual void undo() override;
+
+    virtual qint64 memory_cost() const override;
+
+    virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
+  private:
+    QVector<TaskPtr> tasks_;
+  };
+
 signals:
   /**
    * @brief Signal emitted when a Task is added by AddTask()
@@ -128,20 +186,73 @@ signals:
    */
   void TaskAdded(Task* t);
 
+  /**
+   * @brief Signal emitted whenever statistics() changes
+   */
+  void StatisticsChanged();
+
 private:
   /**
-   * @brief Scan through the task queue and start any Tasks that are able to start
+   * @brief Scheduling state of one Task::ResourceClass
+   */
+  struct ResourceQueue {
+    // Most Tasks of this class that can run at once
+    int maximum;
+
+    // Tasks whose dependencies have all finished, in the order they became ready, indexed by Task::Priority
+    QVector< QList<Task*> > ready;
+
+    // Paused Tasks in the order they were paused, indexed by Task::Priority
+    QVector< QList<Task*> > paused;
+
+    // Working Tasks that aren't paused, in the order they were started (or resumed)
+    QList<Task*> running;
+  };
+  /**
+   * @brief Start any ready Tasks that there are threads available for
    *
-   * This function is run whenever a Task is added and whenever a Task finishes. It determines how many Tasks are
-   * currently running and therefore how many Tasks can be started (if any). It will then start ones that can.
+   * This function is run whenever a Task is added and after each batch of Tasks finishes. A Task is ready once every
+   * one of its "dependency Tasks" has finished (see ReleaseDependents()), so only Tasks that can actually start are
+   * looked at and the cost doesn't grow with the number of Tasks waiting on dependencies.
    *
-   * This function is aware of "dependency Tasks" and if a Task is waiting but has a dependency that hasn't finished,
-   * it will skip to the next one.
+   * Tasks are started in order of priority (see Task::Priority) while their resource class is below its limit. If the
+   * limit has been reached, a waiting interactive or normal priority Task is started anyway and a running background
+   * Task of the same class is paused in its place. Paused Tasks are resumed before waiting Tasks of the same priority
+   * are started.
    *
    * Like AddTask, this function is NOT thread-safe and currently only intended to be run from the main thread.
    */
   void StartNextWaiting();
 
+  /**
+   * @brief Find a working background Task that can be paused to make room for a higher priority one
+   *
+   * @return
+   *
+   * The Task or nullptr if there are none.
+   */
+  static Task* GetPausableTask(const ResourceQueue& queue);
+
+  /**
+   * @brief Scheduling state of a Task's resource class
+   */
+  ResourceQueue& queue(Task* t);
+
+  /**
+   * @brief Count a Task's unfinished dependencies and queue it as ready if there are none
+   */
+  void QueueTask(Task* t);
+
+  /**
+   * @brief Called when a Task finishes or fails, queues Tasks that were only waiting on it as ready
+   */
+  void ReleaseDependents(Task* t);
+
+  /**
+   * @brief Remove a Task from the scheduling state (but not from tasks_)
+   */
+  void UnqueueTask(Task* t);
+
   /**
    * @brief Removes the Task from the queue and deletes it
    *
@@ -156,14 +267,36 @@ private:
   /**
    * @brief Internal task array
    */
-  QVector<TaskPtr> tasks_;
+  QHash<Task*, TaskPtr> tasks_;
+
+  /**
+   * @brief Number of unfinished dependencies of each Task that isn't ready yet
+   */
+  QHash<Task*, int> outstanding_dependencies_;
 
   /**
-   * @brief Constant set at run-time of how many Tasks can run concurrently
+   * @brief Tasks waiting on each unfinished Task
+   */
+  QHash<Task*, QVector<Task*> > dependents_;
+
+  /**
+   * @brief Ready, paused and running Tasks, indexed by Task::ResourceClass
+   */
+  QVector<ResourceQueue> resources_;
+
+  /**
+   * @brief Tasks that finished or failed since ProcessFinishedTasks() last ran, in the order they did
+   */
+  QVector<Task*> finished_;
+
+  TaskStatistics statistics_;
+
+  /**
+   * @brief Threads running the started Tasks
    *
-   * Currently set in the Constructor to QThread::idealThreadCount()
+   * The destructor's Clear() has waited for every running Task by the time this is destroyed.
    */
-  int maximum_task_count_;
+  TaskPool pool_;
 
 private slots:
   /**
@@ -178,6 +311,16 @@ private slots:
    */
   void TaskCallback(Task::Status status);
 
+  /**
+   * @brief Handle every Task in finished_ and then start whatever can replace them
+   *
+   * Short Tasks (e.g. importing a folder of stills) can finish hundreds at a time. Rather than doing a scheduling pass
+   * for each one, TaskCallback() only collects them and this runs once per event loop iteration for all of them.
+   * Finished Tasks are dropped from tasks_ directly instead of going through DeleteTask(), they're already out of
+   * every ready queue so there's nothing to cancel or search for.
+   */
+  void ProcessFinishedTasks();
+
 };
 
 namespace olive {
@@ -0,0 +1,161 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "taskpool.h"
+
+#include <QThread>
+
+#include "common/threadpolicy.h"
+#include "task/task.h"
+
+// Pool and queue index of the worker running on this thread
+static thread_local TaskPool* current_pool = nullptr;
+static thread_local int current_worker = -1;
+
+class TaskPool::Worker : public QThread
+{
+public:
+  Worker(TaskPool* pool, int index) :
+    pool_(pool),
+    index_(index)
+  {
+  }
+
+  virtual void run() override
+  {
+    current_pool = pool_;
+    current_worker = index_;
+
+    ThreadPolicy::Apply(ThreadPolicy::kRoleWorker);
+
+    forever {
+      pool_->idle_.ref();
+      pool_->available_.acquire();
+      pool_->idle_.deref();
+
+      Task* task;
+
+      // Counts without a Task are only released when the pool is destroyed
+      if (!pool_->TakeNext(index_, &task)) {
+        return;
+      }
+
+      RunTask(task);
+    }
+  }
+
+private:
+  TaskPool* pool_;
+
+  int index_;
+};
+
+TaskPool::TaskPool(int maximum_threads) :
+  maximum_threads_(qMax(1, maximum_threads)),
+  queues_(new Queue[static_cast<size_t>(qMax(1, maximum_threads))])
+{
+}
+
+TaskPool::~TaskPool()
+{
+  QMutexLocker locker(&workers_lock_);
+
+  // Wake every worker once more, each one exits when it finds nothing left to run
+  available_.release(workers_.size());
+
+  foreach (Worker* worker, workers_) {
+    worker->wait();
+  }
+
+  qDeleteAll(workers_);
+}
+
+void TaskPool::Submit(Task *task)
+{
+  int queue;
+
+  if (current_pool == this) {
+    // Tasks started from a worker go to that worker's queue, others can steal them if it's busy
+    queue = current_worker;
+  } else {
+    QMutexLocker locker(&workers_lock_);
+
+    // Start a new worker if every idle one already has a Task waiting for it
+    if (idle_.load() <= available_.available() && workers_.size() < maximum_threads_) {
+      queue = workers_.size();
+
+      Worker* worker = new Worker(this, queue);
+      workers_.append(worker);
+      started_.store(workers_.size());
+      worker->start();
+    } else {
+      queue = static_cast<int>(static_cast<uint>(next_queue_.fetchAndAddRelaxed(1))
+                               % static_cast<uint>(started_.load()));
+    }
+  }
+
+  {
+    QMutexLocker locker(&queues_[static_cast<size_t>(queue)].lock);
+    queues_[static_cast<size_t>(queue)].tasks.push_back(task);
+  }
+
+  available_.release();
+}
+
+int TaskPool::thread_count()
+{
+  return started_.load();
+}
+
+bool TaskPool::TakeNext(int worker, Task **task)
+{
+  // Most recently queued first from our own queue, while its Task's data is likely still in cache
+  {
+    Queue& own = queues_[static_cast<size_t>(worker)];
+
+    QMutexLocker locker(&own.lock);
+
+    if (!own.tasks.empty()) {
+      *task = own.tasks.back();
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Otherwise steal the oldest Task of another worker
+  for (int i=1;i<maximum_threads_;i++) {
+    Queue& other = queues_[static_cast<size_t>((worker + i) % maximum_threads_)];
+
+    QMutexLocker locker(&other.lock);
+
+    if (!other.tasks.empty()) {
+      *task = other.tasks.front();
+      other.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TaskPool::RunTask(Task *task)
+{
+  task->Run();
+}
@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <deque>
+#include <memory>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+
+class Task;
+
+/**
+ * @brief A set of reusable worker threads that run Tasks
+ *
+ * Threads are only created when a Task is submitted while every existing thread is busy, up to a maximum, and are then
+ * kept for later Tasks instead of being torn down. Each thread has its own queue which it takes its most recently
+ * queued Task from first, and an idle thread steals the oldest Task from another thread's queue when its own is empty.
+ *
+ * Only used by Task::Start(), which submits the Task here. Thread-safe.
+ */
+class TaskPool
+{
+public:
+  /**
+   * @brief TaskPool Constructor
+   *
+   * @param maximum_threads
+   *
+   * Most threads the pool will create.
+   */
+  TaskPool(int maximum_threads);
+
+  /**
+   * @brief TaskPool Destructor
+   *
+   * Runs any Tasks still queued and waits for every thread to finish.
+   */
+  ~TaskPool();
+
+  TaskPool(const TaskPool& other) = delete;
+  TaskPool& operator=(const TaskPool& other) = delete;
+
+  /**
+   * @brief Queue a Task to run its Action() on a pool thread
+   */
+  void Submit(Task* task);
+
+  /**
+   * @brief Number of threads created so far
+   */
+  int thread_count();
+
+private:
+  class Worker;
+
+  struct Queue {
+    QMutex lock;
+
+    std::deque<Task*> tasks;
+  };
+
+  /**
+   * @brief Take a Task from a worker's own queue, or steal one from another queue
+   *
+   * @return
+   *
+   * FALSE if every queue is empty.
+   */
+  bool TakeNext(int worker, Task** task);
+
+  /**
+   * @brief Run a Task on the calling worker
+   */
+  static void RunTask(Task* task);
+
+  int maximum_threads_;
+
+  // One queue per potential worker, so queues never move while workers use them
+  std::unique_ptr<Queue[]> queues_;
+
+  QVector<Worker*> workers_;
+
+  QMutex workers_lock_;
+
+  // Number of started workers, only increases
+  QAtomicInt started_;
+
+  // Number of workers waiting for a Task
+  QAtomicInt idle_;
+
+  // Queue the next Task submitted from outside the pool goes into
+  QAtomicInt next_queue_;
+
+  // Counts queued Tasks, plus one per worker when the pool is being destroyed
+  QSemaphore available_;
+};
+
+#endif // TASKPOOL_H
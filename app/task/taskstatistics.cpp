@@ -0,0 +1,160 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "taskstatistics.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QTextStream>
+
+TaskStatistics::Histogram::Histogram() :
+  total(0),
+  buckets(kBucketCount, 0)
+{
+}
+
+void TaskStatistics::Add(const QString &type, const Task::Timing &timing)
+{
+  QVector<Histogram>& histograms = types_[type];
+
+  if (histograms.isEmpty()) {
+    histograms.resize(kMetricCount);
+  }
+
+  qint64 values[kMetricCount];
+  values[kQueueWait] = timing.queue_wait;
+  values[kWallTime] = timing.wall_time;
+  values[kCpuTime] = timing.cpu_time;
+  values[kBytesRead] = timing.bytes_read;
+
+  for (int i=0;i<kMetricCount;i++) {
+    Histogram& histogram = histograms[i];
+
+    histogram.total += values[i];
+    histogram.buckets[GetBucket(values[i])]++;
+  }
+
+  counts_[type]++;
+}
+
+void TaskStatistics::Clear()
+{
+  types_.clear();
+  counts_.clear();
+}
+
+int TaskStatistics::count() const
+{
+  int count = 0;
+
+  foreach (int type_count, counts_) {
+    count += type_count;
+  }
+
+  return count;
+}
+
+qint64 TaskStatistics::total(TaskStatistics::Metric metric) const
+{
+  qint64 total = 0;
+
+  foreach (const QVector<Histogram>& histograms, types_) {
+    total += histograms.at(metric).total;
+  }
+
+  return total;
+}
+
+bool TaskStatistics::ExportCsv(const QString &filename) const
+{
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly | QFile::Text)) {
+    qWarning() << "Failed to open" << filename << "for writing";
+    return false;
+  }
+
+  QTextStream stream(&file);
+
+  // Header, buckets are named after their lower bound
+  stream << "type,metric,count,total";
+
+  for (int i=0;i<kBucketCount;i++) {
+    stream << "," << ((i == 0) ? 0 : (Q_INT64_C(1) << (i - 1)));
+  }
+
+  stream << "\n";
+
+  QMap< QString, QVector<Histogram> >::const_iterator i;
+
+  for (i=types_.constBegin();i!=types_.constEnd();i++) {
+    for (int j=0;j<kMetricCount;j++) {
+      const Histogram& histogram = i.value().at(j);
+
+      stream << i.key() << "," << GetMetricName(static_cast<Metric>(j)) << "," << counts_.value(i.key()) << ","
+             << histogram.total;
+
+      foreach (int bucket, histogram.buckets) {
+        stream << "," << bucket;
+      }
+
+      stream << "\n";
+    }
+  }
+
+  stream.flush();
+
+  if (!file.commit()) {
+    qWarning() << "Failed to write" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+int TaskStatistics::GetBucket(qint64 value)
+{
+  int bucket = 0;
+
+  while (value >= 1 && bucket < kBucketCount - 1) {
+    value >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+const char *TaskStatistics::GetMetricName(TaskStatistics::Metric metric)
+{
+  switch (metric) {
+  case kQueueWait:
+    return "queue_wait_ms";
+  case kWallTime:
+    return "wall_time_ms";
+  case kCpuTime:
+    return "cpu_time_ms";
+  case kBytesRead:
+    return "bytes_read";
+  case kMetricCount:
+    break;
+  }
+
+  return "";
+}
@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TASKSTATISTICS_H
+#define TASKSTATISTICS_H
+
+#include <QMap>
+#include <QVector>
+
+#include "task/task.h"
+
+/**
+ * @brief Aggregated Task::Timing of every Task that has run, grouped by type of Task
+ *
+ * Each type keeps a histogram of every metric so it's possible to tell whether e.g. imports are slow because Tasks
+ * wait in the queue, wait on IO or spend their time decoding. Histogram buckets are powers of two (bucket 0 holds
+ * values below 1, bucket n holds values from 2^(n-1) up to 2^n and the last bucket holds everything above).
+ */
+class TaskStatistics
+{
+public:
+  enum Metric {
+    kQueueWait,
+    kWallTime,
+    kCpuTime,
+    kBytesRead,
+
+    kMetricCount
+  };
+
+  /**
+   * @brief Add a Task that has finished running
+   *
+   * @param type
+   *
+   * Usually the Task's class name.
+   */
+  void Add(const QString& type, const Task::Timing& timing);
+
+  /**
+   * @brief Remove everything that was added
+   */
+  void Clear();
+
+  /**
+   * @brief Number of Tasks added
+   */
+  int count() const;
+
+  /**
+   * @brief Sum of a metric over every Task added (in milliseconds or bytes)
+   */
+  qint64 total(Metric metric) const;
+
+  /**
+   * @brief Write a row for every type and metric with its count, total and histogram
+   *
+   * @return
+   *
+   * TRUE if the file was written successfully.
+   */
+  bool ExportCsv(const QString& filename) const;
+
+private:
+  struct Histogram {
+    Histogram();
+
+    qint64 total;
+
+    QVector<int> buckets;
+  };
+
+  static const int kBucketCount = 32;
+
+  static int GetBucket(qint64 value);
+
+  static const char* GetMetricName(Metric metric);
+
+  // Indexed by Metric
+  QMap< QString, QVector<Histogram> > types_;
+
+  QMap<QString, int> counts_;
+};
+
+#endif // TASKSTATISTICS_H
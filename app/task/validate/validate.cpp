@@ -0,0 +1,86 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "validate.h"
+
+#include <QFileInfo>
+
+#include "decoder/probeserver.h"
+
+ValidateTask::ValidateTask(const QList<FootagePtr> &footage) :
+  footage_(footage)
+{
+  Q_ASSERT(!footage_.isEmpty());
+
+  set_text(tr("Checking %n files", nullptr, footage_.size()));
+
+  // Media that turns out to be missing should be flagged before the user starts working with it
+  set_priority(kInteractivePriority);
+
+  // Batches are made of files from the same directory so the first one represents them all
+  set_resource_class(GetIOClass(footage_.first()->filename()));
+}
+
+bool ValidateTask::Action()
+{
+  olive::MediaProber prober(cancel_token());
+
+  for (int i=0;i<footage_.size();i++) {
+    if (!Checkpoint()) {
+      break;
+    }
+
+    FootagePtr footage = footage_.at(i);
+
+    QFileInfo info(footage->filename());
+
+    footage->Lock();
+
+    if (!info.exists()) {
+
+      // Keep the metadata in case the file comes back
+      if (footage->status() != Footage::kOffline) {
+        footage->set_status(Footage::kOffline);
+      }
+
+    } else if (info.lastModified() != footage->timestamp() || footage->status() == Footage::kOffline) {
+
+      footage->set_timestamp(info.lastModified());
+
+      prober.Probe(footage.get());
+
+      reprobed_.append(footage);
+
+    }
+
+    footage->Unlock();
+
+    set_progress((i + 1) * 100 / footage_.size());
+  }
+
+  add_bytes_read(prober.bytes_read());
+
+  return true;
+}
+
+const QList<FootagePtr> &ValidateTask::reprobed()
+{
+  return reprobed_;
+}
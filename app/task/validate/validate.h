@@ -0,0 +1,62 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+/**
+ * @brief A background task for checking whether a batch of a Project's Footage still matches its files
+ *
+ * Footage opened with a project already has the metadata it was saved with. Each Footage's file is checked against
+ * the timestamp it was saved with. Unchanged files are skipped entirely, changed files are probed again (which will use
+ * the ProbeCache if they've been probed before) and missing files are set to Footage::kOffline.
+ *
+ * Checking is done here rather than when the project is read because checking thousands of files one after the other
+ * (especially on network storage) would keep the project from opening for minutes. Batches are made of files from the
+ * same directory, and TaskManager runs batches in parallel so Footage is flagged progressively.
+ */
+class ValidateTask : public Task
+{
+  Q_OBJECT
+public:
+  ValidateTask(const QList<FootagePtr>& footage);
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Footage that was probed again and needs an AnalyzeTask, only valid once the Task has finished
+   */
+  const QList<FootagePtr>& reprobed();
+
+  /**
+   * @brief How many Footage are checked per ValidateTask
+   */
+  static const int kBatchSize = 64;
+
+private:
+  QList<FootagePtr> footage_;
+
+  QList<FootagePtr> reprobed_;
+};
+
+#endif // VALIDATE_H
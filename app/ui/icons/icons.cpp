@@ -20,6 +20,8 @@
 
 #include "icons.h"
 
+#include <QHash>
+
 /// Works in conjunction with `genicons.sh` to generate and utilize icons of specific sizes
 const int ICON_SIZE_COUNT = 4;
 const int ICON_SIZES[] = {
@@ -29,6 +31,10 @@ const int ICON_SIZES[] = {
   128
 };
 
+/// Every icon created so far keyed by theme and name, so switching back to a theme reuses the pixmaps its icons
+/// have already loaded (QIcon is implicitly shared, so copies share them)
+QHash<QString, QIcon> created_icons;
+
 /// Internal icon library for use throughout Olive without having to regenerate constantly
 QIcon olive::icon::GoToStart;
 QIcon olive::icon::PrevFrame;
@@ -120,6 +126,14 @@ void olive::icon::LoadAll(const QString& theme)
 
 QIcon olive::icon::Create(const QString& theme, const QString &name)
 {
+  QString key = QStringLiteral("%1/%2").arg(theme, name);
+
+  QHash<QString, QIcon>::const_iterator existing = created_icons.constFind(key);
+
+  if (existing != created_icons.constEnd()) {
+    return existing.value();
+  }
+
   QIcon icon;
 
   for (int i=0;i<ICON_SIZE_COUNT;i++) {
@@ -127,5 +141,7 @@ QIcon olive::icon::Create(const QString& theme, const QString &name)
                  QSize(ICON_SIZES[i], ICON_SIZES[i]));
   }
 
+  created_icons.insert(key, icon);
+
   return icon;
 }
@@ -104,7 +104,8 @@ extern QIcon DirUp;
  *
  * @return
  *
- * A QIcon object containing the various icon sizes loaded from resource
+ * A QIcon object containing the various icon sizes loaded from resource. Icons are created once per theme and name,
+ * later calls return the same (shared) icon along with any sizes it has already rasterized.
  */
 QIcon Create(const QString &theme, const QString& name);
 
@@ -0,0 +1,63 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef UNDOCOMMAND_H
+#define UNDOCOMMAND_H
+
+#include <QUndoCommand>
+
+class ProjectJournal;
+
+/**
+ * @brief A QUndoCommand that can tell UndoStack how much memory it's keeping alive
+ *
+ * UndoStack drops its oldest commands once they use more memory than its budget allows. Plain QUndoCommands are
+ * counted as just their own size, so commands holding shared pointers to Items, Tasks or large buffers should derive
+ * from this instead and estimate what they hold in memory_cost().
+ */
+class UndoCommand : public QUndoCommand
+{
+public:
+  /**
+   * @brief IDs for commands that merge with the previous one (see QUndoCommand::id())
+   */
+  enum MergeID {
+    kRenameItemMergeID = 1
+  };
+
+  UndoCommand(QUndoCommand* parent = nullptr);
+
+  /**
+   * @brief Approximate number of bytes this command keeps in memory (not including child commands)
+   */
+  virtual qint64 memory_cost() const;
+
+  /**
+   * @brief Record what redo() (or undo() if `undo` is TRUE) is about to change in a project's autosave journal
+   *
+   * Called before the command is applied. ProjectJournal ignores anything outside its own project, so commands just
+   * describe their change. By default the command is recorded as one the journal can't replay (see
+   * ProjectJournal::Barrier()), so commands that change a project should override this. Commands that never touch a
+   * project can override it to do nothing.
+   */
+  virtual void Journal(ProjectJournal* journal, bool undo) const;
+};
+
+#endif // UNDOCOMMAND_H
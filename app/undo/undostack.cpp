@@ -1,3 +1,255 @@
 #include "undostack.h"
 
-QUndoStack olive::undo_stack;
+#include "undo/undocommand.h"
+
+UndoStack olive::undo_stack;
+
+UndoStack::UndoStack() :
+  index_(0),
+  memory_usage_(0),
+  step_limit_(kDefaultStepLimit),
+  memory_limit_(kDefaultMemoryLimit)
+{
+}
+
+UndoStack::~UndoStack()
+{
+  foreach (const Entry& entry, commands_) {
+    delete entry.command;
+  }
+}
+
+void UndoStack::push(QUndoCommand *command)
+{
+  DeleteRedoable();
+
+  emit AboutToApply(command, false);
+
+  command->redo();
+
+  bool recent = (last_push_.isValid() && last_push_.elapsed() < kMergeInterval);
+
+  last_push_.start();
+
+  // Try to merge with the previous command (which must still be done since the redoable ones were deleted)
+  if (recent && !commands_.isEmpty() && command->id() != -1) {
+    Entry& previous = commands_.last();
+
+    if (previous.command->id() == command->id() && previous.command->mergeWith(command)) {
+      delete command;
+
+      memory_usage_ -= previous.cost;
+      previous.cost = MemoryCost(previous.command);
+      memory_usage_ += previous.cost;
+
+      EmitChanged();
+
+      return;
+    }
+  }
+
+  Entry entry;
+  entry.command = command;
+  entry.cost = MemoryCost(command);
+
+  commands_.append(entry);
+  index_ = commands_.size();
+  memory_usage_ += entry.cost;
+
+  Trim();
+
+  EmitChanged();
+}
+
+bool UndoStack::canUndo() const
+{
+  return index_ > 0;
+}
+
+bool UndoStack::canRedo() const
+{
+  return index_ < commands_.size();
+}
+
+QString UndoStack::undoText() const
+{
+  return canUndo() ? commands_.at(index_ - 1).command->actionText() : QString();
+}
+
+QString UndoStack::redoText() const
+{
+  return canRedo() ? commands_.at(index_).command->actionText() : QString();
+}
+
+int UndoStack::count() const
+{
+  return commands_.size();
+}
+
+void UndoStack::clear()
+{
+  foreach (const Entry& entry, commands_) {
+    delete entry.command;
+  }
+
+  commands_.clear();
+  index_ = 0;
+  memory_usage_ = 0;
+
+  EmitChanged();
+}
+
+QAction *UndoStack::createUndoAction(QObject *parent)
+{
+  QAction* action = new QAction(parent);
+
+  action->setEnabled(canUndo());
+  action->setText(tr("Undo %1").arg(undoText()).trimmed());
+
+  connect(this, SIGNAL(canUndoChanged(bool)), action, SLOT(setEnabled(bool)));
+  connect(this, &UndoStack::undoTextChanged, action, [action](const QString& text) {
+    action->setText(tr("Undo %1").arg(text).trimmed());
+  });
+  connect(action, SIGNAL(triggered()), this, SLOT(undo()));
+
+  return action;
+}
+
+QAction *UndoStack::createRedoAction(QObject *parent)
+{
+  QAction* action = new QAction(parent);
+
+  action->setEnabled(canRedo());
+  action->setText(tr("Redo %1").arg(redoText()).trimmed());
+
+  connect(this, SIGNAL(canRedoChanged(bool)), action, SLOT(setEnabled(bool)));
+  connect(this, &UndoStack::redoTextChanged, action, [action](const QString& text) {
+    action->setText(tr("Redo %1").arg(text).trimmed());
+  });
+  connect(action, SIGNAL(triggered()), this, SLOT(redo()));
+
+  return action;
+}
+
+int UndoStack::step_limit() const
+{
+  return step_limit_;
+}
+
+void UndoStack::set_step_limit(int limit)
+{
+  step_limit_ = limit;
+
+  Trim();
+
+  EmitChanged();
+}
+
+qint64 UndoStack::memory_limit() const
+{
+  return memory_limit_;
+}
+
+void UndoStack::set_memory_limit(qint64 limit)
+{
+  memory_limit_ = limit;
+
+  Trim();
+
+  EmitChanged();
+}
+
+qint64 UndoStack::memory_usage() const
+{
+  return memory_usage_;
+}
+
+qint64 UndoStack::MemoryCost(const QUndoCommand *command)
+{
+  const UndoCommand* undo_command = dynamic_cast<const UndoCommand*>(command);
+
+  qint64 cost;
+
+  if (undo_command != nullptr) {
+    cost = undo_command->memory_cost();
+  } else {
+    cost = static_cast<qint64>(sizeof(QUndoCommand));
+  }
+
+  cost += command->text().size() * static_cast<qint64>(sizeof(QChar));
+
+  for (int i=0;i<command->childCount();i++) {
+    cost += MemoryCost(command->child(i));
+  }
+
+  return cost;
+}
+
+void UndoStack::undo()
+{
+  if (!canUndo()) {
+    return;
+  }
+
+  index_--;
+
+  emit AboutToApply(commands_.at(index_).command, true);
+
+  commands_.at(index_).command->undo();
+
+  // Don't merge with a command that's been undone
+  last_push_.invalidate();
+
+  EmitChanged();
+}
+
+void UndoStack::redo()
+{
+  if (!canRedo()) {
+    return;
+  }
+
+  emit AboutToApply(commands_.at(index_).command, false);
+
+  commands_.at(index_).command->redo();
+
+  index_++;
+
+  last_push_.invalidate();
+
+  EmitChanged();
+}
+
+void UndoStack::DeleteRedoable()
+{
+  while (commands_.size() > index_) {
+    Entry entry = commands_.takeLast();
+
+    memory_usage_ -= entry.cost;
+
+    delete entry.command;
+  }
+}
+
+void UndoStack::Trim()
+{
+  // Only done commands are ever trimmed, undone ones would be deleted by the next push() anyway
+  while (index_ > 1
+         && ((step_limit_ > 0 && commands_.size() > step_limit_)
+             || (memory_limit_ > 0 && memory_usage_ > memory_limit_))) {
+    Entry entry = commands_.takeFirst();
+
+    memory_usage_ -= entry.cost;
+    index_--;
+
+    delete entry.command;
+  }
+}
+
+void UndoStack::EmitChanged()
+{
+  emit canUndoChanged(canUndo());
+  emit canRedoChanged(canRedo());
+  emit undoTextChanged(undoText());
+  emit redoTextChanged(redoText());
+}
@@ -1,13 +1,166 @@
 #ifndef UNDOSTACK_H
 #define UNDOSTACK_H
 
-#include <QUndoStack>
+#include <QAction>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QUndoCommand>
+
+/**
+ * @brief A stack of undoable commands with a limit on how many steps and how much memory it keeps
+ *
+ * Works like QUndoStack (commands are executed with redo() when pushed, and consecutive commands with the same
+ * QUndoCommand::id() are merged with QUndoCommand::mergeWith()), but the oldest commands are deleted whenever the
+ * stack holds more than step_limit() commands or more than memory_limit() bytes (see UndoCommand::memory_cost()).
+ * QUndoStack can only limit steps, and only before anything has been pushed.
+ *
+ * Commands are only merged if they're pushed within kMergeInterval of each other, so something done repeatedly in
+ * quick succession (e.g. dragging or scrubbing a value) becomes a single step, while the same thing done again later
+ * can still be undone separately.
+ */
+class UndoStack : public QObject
+{
+  Q_OBJECT
+public:
+  UndoStack();
+
+  /**
+   * @brief Destructor, deletes every command
+   */
+  virtual ~UndoStack() override;
+
+  /**
+   * @brief Execute a command and add it to the stack, which takes ownership of it
+   *
+   * Any commands that were undone are deleted first. The command may be merged into the previous one and deleted.
+   */
+  void push(QUndoCommand* command);
+
+  bool canUndo() const;
+  bool canRedo() const;
+
+  QString undoText() const;
+  QString redoText() const;
+
+  /**
+   * @brief Number of commands on the stack
+   */
+  int count() const;
+
+  /**
+   * @brief Delete every command
+   */
+  void clear();
+
+  /**
+   * @brief Create an action that undoes the last command, kept up to date with its text
+   */
+  QAction* createUndoAction(QObject* parent);
+
+  /**
+   * @brief Create an action that redoes the last undone command, kept up to date with its text
+   */
+  QAction* createRedoAction(QObject* parent);
+
+  /**
+   * @brief Maximum number of commands to keep (0 for no limit)
+   */
+  int step_limit() const;
+  void set_step_limit(int limit);
+
+  /**
+   * @brief Maximum number of bytes the commands may use (0 for no limit)
+   *
+   * The most recent command is always kept, even if it uses more than this by itself.
+   */
+  qint64 memory_limit() const;
+  void set_memory_limit(qint64 limit);
+
+  /**
+   * @brief Bytes currently used by the commands
+   */
+  qint64 memory_usage() const;
+
+  /**
+   * @brief Estimate the memory used by a command and all of its children
+   */
+  static qint64 MemoryCost(const QUndoCommand* command);
+
+public slots:
+  void undo();
+
+  void redo();
+
+signals:
+  /**
+   * @brief Emitted just before a command is done (pushed or redone) or undone
+   *
+   * Everything the command refers to is still as it was before, so listeners (e.g. ProjectJournal) can record what's
+   * about to change.
+   */
+  void AboutToApply(const QUndoCommand* command, bool undo);
+
+  void canUndoChanged(bool can_undo);
+  void canRedoChanged(bool can_redo);
+  void undoTextChanged(const QString& text);
+  void redoTextChanged(const QString& text);
+
+private:
+  /**
+   * @brief Default step_limit()
+   */
+  static const int kDefaultStepLimit = 1000;
+
+  /**
+   * @brief Default memory_limit() (256 MiB)
+   */
+  static const qint64 kDefaultMemoryLimit = 256 * 1024 * 1024;
+
+  /**
+   * @brief Maximum milliseconds between two commands for them to be merged
+   */
+  static const qint64 kMergeInterval = 1000;
+
+  struct Entry {
+    QUndoCommand* command;
+    qint64 cost;
+  };
+
+  /**
+   * @brief Delete every command that has been undone
+   */
+  void DeleteRedoable();
+
+  /**
+   * @brief Delete the oldest commands until the stack is within its limits
+   */
+  void Trim();
+
+  /**
+   * @brief Emit the change signals
+   */
+  void EmitChanged();
+
+  QList<Entry> commands_;
+
+  // Number of commands that are currently done
+  int index_;
+
+  qint64 memory_usage_;
+
+  int step_limit_;
+
+  qint64 memory_limit_;
+
+  QElapsedTimer last_push_;
+};
 
 namespace olive {
 /**
  * @brief A static undo stack for undoable commands throughout Olive
  */
-extern QUndoStack undo_stack;
+extern UndoStack undo_stack;
 }
 
 #endif // UNDOSTACK_H
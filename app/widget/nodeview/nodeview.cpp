@@ -28,7 +28,19 @@ NodeView::NodeView(QWidget *parent) :
 
   setDragMode(RubberBandDrag);
 
-  connect(&scene_, SIGNAL(changed(const QList<QRectF>&)), this, SLOT(ItemsChanged()));
+  // Nodes rarely move compared to how often the view is panned, so a BSP index pays off by letting the scene only visit
+  // items inside the exposed area. Its depth is left to Qt, which rebalances it as the item count grows.
+  scene_.setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+
+  // Dragging a selection of nodes dirties many small rects, coalesce them rather than repainting each one
+  setViewportUpdateMode(SmartViewportUpdate);
+
+  // Nothing here is drawn anti-aliased so items never paint outside their bounding rects
+  setOptimizationFlag(DontAdjustForAntialiasing);
+
+  edge_adjust_timer_.setSingleShot(true);
+  edge_adjust_timer_.setInterval(kEdgeAdjustInterval);
+  connect(&edge_adjust_timer_, SIGNAL(timeout()), this, SLOT(AdjustQueuedEdges()));
 }
 
 void NodeView::SetGraph(NodeGraph *graph)
@@ -36,10 +48,15 @@ void NodeView::SetGraph(NodeGraph *graph)
   if (graph_ != nullptr) {
     disconnect(graph_, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(AddEdge(NodeEdgePtr)));
     disconnect(graph_, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(RemoveEdge(NodeEdgePtr)));
+    disconnect(graph_, SIGNAL(EdgesChanged(QVector<NodeEdgePtr>, QVector<NodeEdgePtr>)),
+              this, SLOT(ApplyEdgeChanges(QVector<NodeEdgePtr>, QVector<NodeEdgePtr>)));
   }
 
   // Clear the scene of all UI objects
   scene_.clear();
+  item_map_.clear();
+  edge_map_.clear();
+  queued_edges_.clear();
 
   // Set reference to the graph
   graph_ = graph;
@@ -48,6 +65,8 @@ void NodeView::SetGraph(NodeGraph *graph)
   if (graph_ != nullptr) {
     connect(graph_, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(AddEdge(NodeEdgePtr)));
     connect(graph_, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(RemoveEdge(NodeEdgePtr)));
+    connect(graph_, SIGNAL(EdgesChanged(QVector<NodeEdgePtr>, QVector<NodeEdgePtr>)),
+           this, SLOT(ApplyEdgeChanges(QVector<NodeEdgePtr>, QVector<NodeEdgePtr>)));
 
     QList<Node*> graph_nodes = graph_->nodes();
 
@@ -58,6 +77,11 @@ void NodeView::SetGraph(NodeGraph *graph)
 
       scene_.addItem(item);
 
+      item_map_.insert(node, item);
+    }
+
+    // Edges are positioned using both nodes' UI objects, so these are only added once every node has one
+    foreach (Node* node, graph_nodes) {
       // Add a NodeViewEdge for each connection
       QList<NodeParam*> node_params = node->parameters();
 
@@ -79,73 +103,106 @@ void NodeView::SetGraph(NodeGraph *graph)
 
 NodeViewItem *NodeView::NodeToUIObject(QGraphicsScene *scene, Node *n)
 {
-  QList<QGraphicsItem*> graphics_items = scene->items();
+  NodeView* view = SceneToView(scene);
 
-  for (int i=0;i<graphics_items.size();i++) {
-    NodeViewItem* item = dynamic_cast<NodeViewItem*>(graphics_items.at(i));
-
-    if (item != nullptr) {
-      if (item->node() == n) {
-        return item;
-      }
-    }
+  if (view == nullptr) {
+    return nullptr;
   }
 
-  return nullptr;
+  return view->NodeToUIObject(n);
 }
 
 NodeViewEdge *NodeView::EdgeToUIObject(QGraphicsScene *scene, NodeEdgePtr n)
 {
-  QList<QGraphicsItem*> graphics_items = scene->items();
-
-  for (int i=0;i<graphics_items.size();i++) {
-    NodeViewEdge* edge = dynamic_cast<NodeViewEdge*>(graphics_items.at(i));
+  NodeView* view = SceneToView(scene);
 
-    if (edge != nullptr) {
-      if (edge->edge() == n) {
-        return edge;
-      }
-    }
+  if (view == nullptr) {
+    return nullptr;
   }
 
-  return nullptr;
+  return view->EdgeToUIObject(n);
 }
 
 NodeViewItem *NodeView::NodeToUIObject(Node *n)
 {
-  return NodeToUIObject(&scene_, n);
+  return item_map_.value(n, nullptr);
 }
 
 NodeViewEdge *NodeView::EdgeToUIObject(NodeEdgePtr n)
 {
-  return EdgeToUIObject(&scene_, n);
+  return edge_map_.value(n.get(), nullptr);
+}
+
+void NodeView::QueueEdgeAdjust(QGraphicsScene *scene, NodeViewEdge *edge)
+{
+  NodeView* view = SceneToView(scene);
+
+  if (view == nullptr) {
+    edge->Adjust();
+    return;
+  }
+
+  view->queued_edges_.insert(edge);
+
+  if (!view->edge_adjust_timer_.isActive()) {
+    view->edge_adjust_timer_.start();
+  }
+}
+
+NodeView *NodeView::SceneToView(QGraphicsScene *scene)
+{
+  QList<QGraphicsView*> views = scene->views();
+
+  foreach (QGraphicsView* view, views) {
+    NodeView* node_view = dynamic_cast<NodeView*>(view);
+
+    if (node_view != nullptr) {
+      return node_view;
+    }
+  }
+
+  return nullptr;
 }
 
 void NodeView::AddEdge(NodeEdgePtr edge)
 {
   NodeViewEdge* edge_ui = new NodeViewEdge();
 
-  edge_ui->SetEdge(edge);
-
+  // The edge looks up its nodes through the scene, so it's added before it's positioned
   scene_.addItem(edge_ui);
+
+  edge_map_.insert(edge.get(), edge_ui);
+
+  edge_ui->SetEdge(edge);
 }
 
 void NodeView::RemoveEdge(NodeEdgePtr edge)
 {
-  NodeViewEdge* edge_ui = EdgeToUIObject(scene(), edge);
+  NodeViewEdge* edge_ui = edge_map_.take(edge.get());
 
-  scene_.removeItem(edge_ui);
+  if (edge_ui != nullptr) {
+    queued_edges_.remove(edge_ui);
+    scene_.removeItem(edge_ui);
+    delete edge_ui;
+  }
 }
 
-void NodeView::ItemsChanged()
+void NodeView::ApplyEdgeChanges(const QVector<NodeEdgePtr> &added, const QVector<NodeEdgePtr> &removed)
 {
-  QList<QGraphicsItem*> items = scene_.items();
+  foreach (NodeEdgePtr edge, removed) {
+    RemoveEdge(edge);
+  }
 
-  foreach (QGraphicsItem* item, items) {
-    NodeViewEdge* edge = dynamic_cast<NodeViewEdge*>(item);
+  foreach (NodeEdgePtr edge, added) {
+    AddEdge(edge);
+  }
+}
 
-    if (edge != nullptr) {
-      edge->Adjust();
-    }
+void NodeView::AdjustQueuedEdges()
+{
+  foreach (NodeViewEdge* edge, queued_edges_) {
+    edge->Adjust();
   }
+
+  queued_edges_.clear();
 }
@@ -22,6 +22,9 @@
 #define NODEVIEW_H
 
 #include <QGraphicsView>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 
 #include "node/graph.h"
 #include "widget/nodeview/nodeviewedge.h"
@@ -32,6 +35,10 @@
  *
  * This widget takes a NodeGraph object and constructs a QGraphicsScene representing its data, viewing and allowing
  * the user to make modifications to it.
+ *
+ * Graphs can contain thousands of nodes, so UI objects are looked up through hashes rather than by searching the
+ * scene, and edges are only re-adjusted when one of the nodes they connect moves or resizes (see
+ * NodeViewItem::AdjustEdges()).
  */
 class NodeView : public QGraphicsView
 {
@@ -53,7 +60,7 @@ public:
    * through QGraphicsItem::scene().
    *
    * If the scene does not contain a widget for this node (usually meaning the node's graph is not the active graph
-   * in this view/scene), this function returns nullptr.
+   * in this view/scene) or the scene isn't shown in a NodeView, this function returns nullptr.
    */
   static NodeViewItem* NodeToUIObject(QGraphicsScene* scene, Node* n);
 
@@ -74,11 +81,38 @@ public:
    */
   NodeViewEdge* EdgeToUIObject(NodeEdgePtr n);
 
+  /**
+   * @brief Queue a NodeViewEdge to be re-adjusted
+   *
+   * Queued edges are adjusted together once kEdgeAdjustInterval has passed, so dragging a large selection adjusts each
+   * attached edge once per frame rather than once for every node that moved on every mouse event. If the scene isn't
+   * shown in a NodeView, the edge is adjusted immediately.
+   */
+  static void QueueEdgeAdjust(QGraphicsScene* scene, NodeViewEdge* edge);
+
 private:
+  /**
+   * @brief Interval in milliseconds that queued edge adjustments are collected for (roughly one 60Hz frame)
+   */
+  static const int kEdgeAdjustInterval = 16;
+
+  /**
+   * @brief Retrieve the NodeView showing a certain scene, or nullptr if it isn't shown in one
+   */
+  static NodeView* SceneToView(QGraphicsScene* scene);
+
   NodeGraph* graph_;
 
   QGraphicsScene scene_;
 
+  QHash<Node*, NodeViewItem*> item_map_;
+
+  QHash<NodeEdge*, NodeViewEdge*> edge_map_;
+
+  QSet<NodeViewEdge*> queued_edges_;
+
+  QTimer edge_adjust_timer_;
+
 private slots:
   /**
    * @brief Slot when an edge is added to a graph (SetGraph() connects this)
@@ -97,11 +131,16 @@ private slots:
   void RemoveEdge(NodeEdgePtr edge);
 
   /**
-   * @brief Internal function triggered when any change is signalled from the QGraphicsScene
+   * @brief Slot when a batch of edges changes at once (SetGraph() connects this)
    *
-   * Current primary function is to inform all NodeViewEdges to re-adjust in case any Nodes have moved
+   * Removes and adds the UI objects for every edge in the change set in one pass.
+   */
+  void ApplyEdgeChanges(const QVector<NodeEdgePtr>& added, const QVector<NodeEdgePtr>& removed);
+
+  /**
+   * @brief Adjust every edge queued by QueueEdgeAdjust()
    */
-  void ItemsChanged();
+  void AdjustQueuedEdges();
 
 };
 
@@ -22,6 +22,7 @@
 
 #include <QDebug>
 #include <QGraphicsSceneMouseEvent>
+#include <QPainter>
 
 #include "common/clamp.h"
 #include "common/lerp.h"
@@ -37,6 +38,9 @@ NodeViewEdge::NodeViewEdge(QGraphicsItem *parent) :
 
   // Use font metrics to set edge width for basic high DPI support
   edge_width_ = QFontMetrics(QFont()).height() / 12;
+
+  // The pen's color is chosen when painting, but its width is set here so the bounding rect accounts for it
+  setPen(QPen(Qt::white, edge_width_));
 }
 
 void NodeViewEdge::SetEdge(NodeEdgePtr edge)
@@ -83,6 +87,10 @@ void NodeViewEdge::Adjust()
   NodeViewItem* output = NodeView::NodeToUIObject(scene(), edge_->output()->parent());
   NodeViewItem* input = NodeView::NodeToUIObject(scene(), edge_->input()->parent());
 
+  if (output == nullptr || input == nullptr) {
+    return;
+  }
+
   // Create initial values
   QPointF output_point = QPointF(output->pos().x() + output->rect().width(), 0);
   QPointF input_point = QPointF(input->pos().x(), 0);
@@ -101,9 +109,11 @@ void NodeViewEdge::Adjust()
 void NodeViewEdge::SetConnected(bool c)
 {
   connected_ = c;
+
+  update();
 }
 
-void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *widget)
 {
   QPalette::ColorGroup color_mode;
 
@@ -113,8 +123,12 @@ void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
     color_mode = QPalette::Disabled;
   }
 
-  setPen(QPen(widget->palette().color(color_mode, QPalette::Text), edge_width_));
+  // Calling setPen() here would invalidate the item's geometry and schedule another repaint on every paint, so the
+  // pen is only applied to the painter
+  QPen edge_pen = pen();
+  edge_pen.setColor(widget->palette().color(color_mode, QPalette::Text));
 
-  QGraphicsLineItem::paint(painter, option, widget);
+  painter->setPen(edge_pen);
+  painter->drawLine(line());
 }
 
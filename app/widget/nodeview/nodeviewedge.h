@@ -52,7 +52,7 @@ public:
    * it accordingly.
    *
    * This should be set any time the NodeEdge changes (see SetEdge()), and any time the nodes move in the NodeGraph
-   * (see NodeView::ItemsChanged()). This will keep the nodes visually connected at all times.
+   * (see NodeViewItem::AdjustEdges()). This will keep the nodes visually connected at all times.
    */
   void Adjust();
 
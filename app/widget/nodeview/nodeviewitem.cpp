@@ -33,6 +33,11 @@
 #include "undo/undostack.h"
 #include "window/mainwindow/mainwindow.h"
 
+/**
+ * @brief Zoom level below which nodes are drawn as plain boxes without any text, icons or connectors
+ */
+const qreal kSimplifiedDetailLevel = 0.4;
+
 NodeViewItem::NodeViewItem(QGraphicsItem *parent) :
   QGraphicsRectItem(parent),
   node_(nullptr),
@@ -47,6 +52,12 @@ NodeViewItem::NodeViewItem(QGraphicsItem *parent) :
   setFlag(QGraphicsItem::ItemIsMovable);
   setFlag(QGraphicsItem::ItemIsSelectable);
 
+  // Notifies itemChange() of moves so connected edges can follow
+  setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+
+  // Provides QStyleOptionGraphicsItem::exposedRect so parameters that weren't exposed can be skipped
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
   //
   // We use font metrics to set all the UI measurements for DPI-awareness
   //
@@ -120,6 +131,8 @@ void NodeViewItem::SetExpanded(bool e)
   update();
 
   setRect(new_rect);
+
+  AdjustEdges();
 }
 
 QRectF NodeViewItem::GetParameterConnectorRect(int index)
@@ -146,6 +159,27 @@ QRectF NodeViewItem::GetParameterConnectorRect(int index)
   return connector_rect;
 }
 
+void NodeViewItem::AdjustEdges()
+{
+  if (node_ == nullptr || scene() == nullptr) {
+    return;
+  }
+
+  QList<NodeParam*> node_params = node_->parameters();
+
+  foreach (NodeParam* param, node_params) {
+    const QVector<NodeEdgePtr>& edges = param->edges();
+
+    foreach (NodeEdgePtr edge, edges) {
+      NodeViewEdge* edge_ui = NodeView::EdgeToUIObject(scene(), edge);
+
+      if (edge_ui != nullptr) {
+        NodeView::QueueEdgeAdjust(scene(), edge_ui);
+      }
+    }
+  }
+}
+
 QPointF NodeViewItem::GetParameterTextPoint(int index)
 {
   if (node_ == nullptr) {
@@ -178,6 +212,18 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
 
   painter->setPen(border_pen);
 
+  // When zoomed out too far to read anything, just draw a box the size of the node
+  if (option->levelOfDetailFromTransform(painter->worldTransform()) < kSimplifiedDetailLevel) {
+    if (option->state & QStyle::State_Selected) {
+      border_pen.setColor(app_pal.color(QPalette::Highlight));
+      painter->setPen(border_pen);
+    }
+
+    painter->setBrush(css_proxy_.TitleBarColor());
+    painter->drawRect(rect());
+    return;
+  }
+
   if (expanded_ && node_ != nullptr) {
 
     // Use main widget color for node contents
@@ -198,6 +244,16 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
     for (int i=0;i<node_params.size();i++) {
       NodeParam* param = node_params.at(i);
 
+      // Skip parameters outside the area being repainted
+      QRectF param_rect(content_rect_.x(),
+                        content_rect_.y() + node_text_padding_ + font_metrics.height() * i,
+                        content_rect_.width(),
+                        font_metrics.height());
+
+      if (!option->exposedRect.intersects(param_rect)) {
+        continue;
+      }
+
       // Draw connector square
       painter->fillRect(GetParameterConnectorRect(i), connector_brush);
 
@@ -262,6 +318,15 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
   }
 }
 
+QVariant NodeViewItem::itemChange(QGraphicsItem::GraphicsItemChange change, const QVariant &value)
+{
+  if (change == ItemPositionHasChanged) {
+    AdjustEdges();
+  }
+
+  return QGraphicsRectItem::itemChange(change, value);
+}
+
 void NodeViewItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
   // We override standard mouse behavior in some cases. In these cases, we don't want the standard "move" and "release"
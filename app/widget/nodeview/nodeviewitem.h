@@ -34,7 +34,9 @@
 /**
  * @brief A visual widget representation of a Node object to be used in a NodeView
  *
- * This widget can be collapsed or expanded to show/hide the node's various parameters.
+ * This widget can be collapsed or expanded to show/hide the node's various parameters. When the view is zoomed out
+ * far enough that text would be unreadable, it's drawn as a plain box instead, and parameters outside the exposed
+ * area are skipped.
  *
  * To retrieve the NodeViewItem for a certain Node, use NodeView::NodeToUIObject().
  */
@@ -75,9 +77,18 @@ public:
    */
   QRectF GetParameterConnectorRect(int index);
 
+  /**
+   * @brief Queue every NodeViewEdge connected to this node to be re-adjusted
+   *
+   * Called automatically whenever this item moves or is expanded/collapsed. See NodeView::QueueEdgeAdjust().
+   */
+  void AdjustEdges();
+
 protected:
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
+  virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
   virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
   virtual void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
   virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
@@ -1,7 +1,9 @@
 #include "nodeviewundo.h"
 
+#include "project/projectjournal.h"
+
 NodeEdgeAddCommand::NodeEdgeAddCommand(NodeOutput *output, NodeInput *input, QUndoCommand *parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   output_(output),
   input_(input),
   old_edge_(nullptr),
@@ -37,8 +39,27 @@ void NodeEdgeAddCommand::undo()
   done_ = false;
 }
 
+void NodeEdgeAddCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  // Nothing happens if the command is already in the state it's being put in
+  if (undo == !done_) {
+    return;
+  }
+
+  if (undo) {
+    journal->DisconnectEdge(output_, input_);
+
+    if (old_edge_ != nullptr) {
+      journal->ConnectEdge(old_edge_->output(), old_edge_->input());
+    }
+  } else {
+    // Connecting replaces whatever the input was connected to, which replaying does too
+    journal->ConnectEdge(output_, input_);
+  }
+}
+
 NodeEdgeRemoveCommand::NodeEdgeRemoveCommand(NodeOutput *output, NodeInput *input, QUndoCommand *parent) :
-  QUndoCommand(parent),
+  UndoCommand(parent),
   output_(output),
   input_(input),
   done_(false)
@@ -64,3 +85,16 @@ void NodeEdgeRemoveCommand::undo()
   NodeParam::ConnectEdge(output_, input_);
   done_ = false;
 }
+
+void NodeEdgeRemoveCommand::Journal(ProjectJournal *journal, bool undo) const
+{
+  if (undo == !done_) {
+    return;
+  }
+
+  if (undo) {
+    journal->ConnectEdge(output_, input_);
+  } else {
+    journal->DisconnectEdge(output_, input_);
+  }
+}
@@ -1,22 +1,23 @@
 #ifndef NODEVIEWUNDO_H
 #define NODEVIEWUNDO_H
 
-#include <QUndoCommand>
-
 #include "node/node.h"
+#include "undo/undocommand.h"
 
 /**
  * @brief An undoable commnd for connecting two NodeParams together
  *
  * Can be considered a QUndoCommand wrapper for NodeParam::ConnectEdge()/
  */
-class NodeEdgeAddCommand : public QUndoCommand {
+class NodeEdgeAddCommand : public UndoCommand {
 public:
   NodeEdgeAddCommand(NodeOutput* output, NodeInput* input, QUndoCommand* parent = nullptr);
 
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
 private:
   NodeOutput* output_;
   NodeInput* input_;
@@ -31,13 +32,15 @@ private:
  *
  * Can be considered a QUndoCommand wrapper for NodeParam::DisonnectEdge()/
  */
-class NodeEdgeRemoveCommand : public QUndoCommand {
+class NodeEdgeRemoveCommand : public UndoCommand {
 public:
   NodeEdgeRemoveCommand(NodeOutput* output, NodeInput* input, QUndoCommand* parent = nullptr);
 
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual void Journal(ProjectJournal* journal, bool undo) const override;
+
 private:
   NodeOutput* output_;
   NodeInput* input_;
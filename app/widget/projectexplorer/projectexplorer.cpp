@@ -21,20 +21,33 @@
 #include "projectexplorer.h"
 
 #include <QDebug>
+#include <QMenu>
 #include <QVBoxLayout>
 
 #include "projectexplorerdefines.h"
+#include "task/loudness/loudness.h"
+#include "task/proxy/proxy.h"
+#include "task/taskmanager.h"
+#include "undo/undostack.h"
 
 ProjectExplorer::ProjectExplorer(QWidget *parent) :
   QWidget(parent),
   view_type_(olive::TreeView),
-  model_(this)
+  model_(this),
+  search_model_(this)
 {
   // Create layout
   QVBoxLayout* layout = new QVBoxLayout(this);
   layout->setSpacing(0);
   layout->setMargin(0);
 
+  // Set up search field
+  search_edit_ = new QLineEdit(this);
+  search_edit_->setPlaceholderText(tr("Search..."));
+  search_edit_->setClearButtonEnabled(true);
+  connect(search_edit_, SIGNAL(textChanged(const QString&)), this, SLOT(UpdateSearch()));
+  layout->addWidget(search_edit_);
+
   // Set up navigation bar
   nav_bar_ = new ProjectExplorerNavigation(this);
   connect(nav_bar_, SIGNAL(SizeChanged(int)), this, SLOT(SizeChangedSlot(int)));
@@ -57,6 +70,19 @@ ProjectExplorer::ProjectExplorer(QWidget *parent) :
   icon_view_ = new ProjectExplorerIconView(stacked_widget_);
   AddView(icon_view_);
 
+  // Add search results to stacked widget
+  search_view_ = new ProjectExplorerListView(stacked_widget_);
+  search_view_->setModel(&search_model_);
+  search_view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  search_view_->setContextMenuPolicy(Qt::CustomContextMenu);
+  connect(search_view_,
+          SIGNAL(DoubleClickedView(const QModelIndex&)),
+          this,
+          SLOT(DoubleClickViewSlot(const QModelIndex&)));
+  connect(search_view_, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(ShowContextMenu(const QPoint&)));
+  stacked_widget_->addWidget(search_view_);
+  connect(&model_, SIGNAL(ItemsChanged()), this, SLOT(ItemsChangedSlot()));
+
   // Set default view to tree view
   set_view_type(olive::TreeView);
 
@@ -77,6 +103,11 @@ void ProjectExplorer::set_view_type(olive::ProjectViewType type)
 {
   view_type_ = type;
 
+  // Search results stay up until the search is cleared
+  if (searching()) {
+    return;
+  }
+
   // Set widget based on view type
   switch (view_type_) {
   case olive::TreeView:
@@ -103,8 +134,10 @@ void ProjectExplorer::AddView(QAbstractItemView *view)
 {
   view->setModel(&model_);
   view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  view->setContextMenuPolicy(Qt::CustomContextMenu);
   connect(view, SIGNAL(DoubleClickedView(const QModelIndex&)), this, SLOT(DoubleClickViewSlot(const QModelIndex&)));
   connect(view, SIGNAL(clicked(const QModelIndex&)), this, SLOT(ItemClickedSlot(const QModelIndex&)));
+  connect(view, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(ShowContextMenu(const QPoint&)));
   stacked_widget_->addWidget(view);
 }
 
@@ -135,6 +168,31 @@ QAbstractItemView *ProjectExplorer::CurrentView()
   return static_cast<QAbstractItemView*>(stacked_widget_->currentWidget());
 }
 
+bool ProjectExplorer::searching()
+{
+  return !search_edit_->text().isEmpty();
+}
+
+QList<FootagePtr> ProjectExplorer::SelectedFootage()
+{
+  QList<FootagePtr> footage;
+
+  foreach (Item* item, SelectedItems()) {
+    if (item->type() != Item::kFootage) {
+      continue;
+    }
+
+    Footage* f = static_cast<Footage*>(item);
+
+    if (f->status() == Footage::kUnindexed || f->status() == Footage::kReady) {
+      // Tasks need to share ownership of the Footage
+      footage.append(std::static_pointer_cast<Footage>(f->parent()->shared_ptr_from_raw(f)));
+    }
+  }
+
+  return footage;
+}
+
 void ProjectExplorer::ItemClickedSlot(const QModelIndex &index)
 {
   if (index.isValid()) {
@@ -161,6 +219,19 @@ void ProjectExplorer::DoubleClickViewSlot(const QModelIndex &index)
     // Retrieve source item from index
     Item* i = static_cast<Item*>(index.internalPointer());
 
+    // Folders found by a search are opened in the project
+    if (searching() && i->CanHaveChildren()) {
+      search_edit_->clear();
+
+      if (view_type() == olive::ListView || view_type() == olive::IconView) {
+        BrowseToFolder(model_.CreateIndexFromItem(i));
+      }
+
+      emit DoubleClickedItem(i);
+
+      return;
+    }
+
     // If the item is a folder, browse to it
     if (i->CanHaveChildren()
         && (view_type() == olive::ListView || view_type() == olive::IconView)) {
@@ -210,6 +281,63 @@ void ProjectExplorer::RenameTimerSlot()
   rename_timer_.stop();
 }
 
+void ProjectExplorer::ShowContextMenu(const QPoint &pos)
+{
+  bool has_video = false;
+  bool has_audio = false;
+
+  foreach (FootagePtr f, SelectedFootage()) {
+    has_video = has_video || f->HasStreamsOfType(Stream::kVideo);
+    has_audio = has_audio || f->HasStreamsOfType(Stream::kAudio);
+  }
+
+  if (!has_video && !has_audio) {
+    return;
+  }
+
+  QMenu menu(this);
+
+  if (has_video) {
+    menu.addAction(tr("Create Proxy"), this, SLOT(CreateProxySlot()));
+  }
+
+  if (has_audio) {
+    menu.addAction(tr("Analyze Loudness"), this, SLOT(AnalyzeLoudnessSlot()));
+  }
+
+  QAbstractItemView* view = static_cast<QAbstractItemView*>(sender());
+  menu.exec(view->viewport()->mapToGlobal(pos));
+}
+
+void ProjectExplorer::CreateProxySlot()
+{
+  QVector<TaskPtr> tasks;
+
+  foreach (FootagePtr f, SelectedFootage()) {
+    for (int i=0;i<f->stream_count();i++) {
+      if (f->stream(i)->type() == Stream::kVideo) {
+        tasks.append(std::make_shared<ProxyTask>(f, i));
+      }
+    }
+  }
+
+  if (!tasks.isEmpty()) {
+    olive::undo_stack.push(new TaskManager::AddTasksCommand(tasks));
+  }
+}
+
+void ProjectExplorer::AnalyzeLoudnessSlot()
+{
+  foreach (FootagePtr f, SelectedFootage()) {
+    for (int i=0;i<f->stream_count();i++) {
+      if (f->stream(i)->type() == Stream::kAudio) {
+        // Streams that have already been measured are skipped
+        LoudnessTask::Queue(static_cast<AudioStream*>(f->stream(i)));
+      }
+    }
+  }
+}
+
 Project *ProjectExplorer::project()
 {
   return model_.project();
@@ -218,6 +346,32 @@ Project *ProjectExplorer::project()
 void ProjectExplorer::set_project(Project *p)
 {
   model_.set_project(p);
+
+  UpdateSearch();
+}
+
+void ProjectExplorer::UpdateSearch()
+{
+  if (!searching() || project() == nullptr) {
+    search_model_.set_results(QVector<Item*>());
+
+    // Show the project again
+    set_view_type(view_type_);
+    return;
+  }
+
+  search_model_.set_results(project()->search_index()->Find(search_edit_->text()));
+
+  rename_timer_.stop();
+  stacked_widget_->setCurrentWidget(search_view_);
+  nav_bar_->setVisible(false);
+}
+
+void ProjectExplorer::ItemsChangedSlot()
+{
+  if (searching()) {
+    UpdateSearch();
+  }
 }
 
 QList<Item *> ProjectExplorer::SelectedItems()
@@ -21,10 +21,12 @@
 #ifndef PROJECTEXPLORER_H
 #define PROJECTEXPLORER_H
 
+#include <QLineEdit>
 #include <QStackedWidget>
 #include <QTimer>
 #include <QTreeView>
 
+#include "project/item/footage/footage.h"
 #include "project/project.h"
 #include "project/projectviewmodel.h"
 #include "project/projectviewtype.h"
@@ -32,6 +34,7 @@
 #include "widget/projectexplorer/projectexplorerlistview.h"
 #include "widget/projectexplorer/projectexplorertreeview.h"
 #include "widget/projectexplorer/projectexplorernavigation.h"
+#include "widget/projectexplorer/projectexplorersearchmodel.h"
 
 /**
  * @brief A widget for browsing through a Project structure.
@@ -40,6 +43,9 @@
  * be provided is the Project structure itself.
  *
  * This widget contains three views, tree view, list view, and icon view. These can be switched at any time.
+ *
+ * Typing in the search field replaces the view with a flat list of every Item matching the text, found with the
+ * Project's ItemSearchIndex.
  */
 class ProjectExplorer : public QWidget
 {
@@ -116,6 +122,16 @@ private:
    */
   QAbstractItemView* CurrentView();
 
+  /**
+   * @brief Returns TRUE if search results are being shown instead of the project
+   */
+  bool searching();
+
+  /**
+   * @brief Returns the selected Footage that has been probed and is still online
+   */
+  QList<FootagePtr> SelectedFootage();
+
   QStackedWidget* stacked_widget_;
 
   ProjectExplorerNavigation* nav_bar_;
@@ -124,6 +140,10 @@ private:
   ProjectExplorerListView* list_view_;
   ProjectExplorerTreeView* tree_view_;
 
+  QLineEdit* search_edit_;
+  ProjectExplorerListView* search_view_;
+  ProjectExplorerSearchModel search_model_;
+
   olive::ProjectViewType view_type_;
 
   ProjectViewModel model_;
@@ -142,6 +162,31 @@ private slots:
   void DirUpSlot();
 
   void RenameTimerSlot();
+
+  /**
+   * @brief Show actions for the selected Items at a position in the view that sent the signal
+   */
+  void ShowContextMenu(const QPoint& pos);
+
+  /**
+   * @brief Queue a ProxyTask for every video stream in the selected Footage
+   */
+  void CreateProxySlot();
+
+  /**
+   * @brief Queue a LoudnessTask for every audio stream in the selected Footage that hasn't been measured yet
+   */
+  void AnalyzeLoudnessSlot();
+
+  /**
+   * @brief Run the search in search_edit_ again and show its results (or the project again if it's empty)
+   */
+  void UpdateSearch();
+
+  /**
+   * @brief Run UpdateSearch() if a search is being shown, so results never point to Items that have been removed
+   */
+  void ItemsChangedSlot();
 };
 
 #endif // PROJECTEXPLORER_H
@@ -20,10 +20,22 @@
 
 #include "projectexplorericonview.h"
 
+#include "decoder/thumbnailservice.h"
+
 ProjectExplorerIconView::ProjectExplorerIconView(QWidget *parent) :
   ProjectExplorerListViewBase(parent)
 {
   setViewMode(QListView::IconMode);
 
   setItemDelegate(&delegate_);
+
+  // Redraw when thumbnails become available
+  connect(&olive::thumbnail_service, SIGNAL(ThumbnailReady()), viewport(), SLOT(update()));
+}
+
+void ProjectExplorerIconView::scrollContentsBy(int dx, int dy)
+{
+  olive::thumbnail_service.CancelPending();
+
+  ProjectExplorerListViewBase::scrollContentsBy(dx, dy);
 }
@@ -26,6 +26,9 @@
 
 /**
  * @brief The view widget used when ProjectExplorer is in Icon View
+ *
+ * Scrolling cancels thumbnails that were requested but haven't started generating yet, the items that are still
+ * visible request theirs again when they're repainted.
  */
 class ProjectExplorerIconView : public ProjectExplorerListViewBase
 {
@@ -33,6 +36,9 @@ class ProjectExplorerIconView : public ProjectExplorerListViewBase
 public:
   ProjectExplorerIconView(QWidget* parent);
 
+protected:
+  virtual void scrollContentsBy(int dx, int dy) override;
+
 private:
   ProjectExplorerIconViewItemDelegate delegate_;
 };
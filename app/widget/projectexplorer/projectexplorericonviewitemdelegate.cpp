@@ -22,6 +22,9 @@
 
 #include <QPainter>
 
+#include "decoder/thumbnailservice.h"
+#include "project/item/footage/footage.h"
+
 ProjectExplorerIconViewItemDelegate::ProjectExplorerIconViewItemDelegate(QObject *parent) :
   QStyledItemDelegate (parent)
 {
@@ -81,14 +84,33 @@ void ProjectExplorerIconViewItemDelegate::paint(QPainter *painter, const QStyleO
 
   }
 
+  // Only items being drawn request thumbnails, so thumbnails are only generated for visible items
+  QImage thumbnail;
+  Item* item = static_cast<Item*>(index.internalPointer());
+
+  if (item->type() == Item::kFootage && item->parent() != nullptr) {
+    ItemPtr footage = item->parent()->shared_ptr_from_raw(item);
+
+    thumbnail = olive::thumbnail_service.Get(std::static_pointer_cast<Footage>(footage));
+  }
+
   // Draw image
-  QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
-  QSize icon_size = ico.actualSize(img_rect.size());
-  img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
-                   img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
-                   icon_size.width(),
-                   icon_size.height());
-  painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  if (thumbnail.isNull()) {
+    QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
+    QSize icon_size = ico.actualSize(img_rect.size());
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
+                     icon_size.width(),
+                     icon_size.height());
+    painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  } else {
+    QSize thumbnail_size = thumbnail.size().scaled(img_rect.size(), Qt::KeepAspectRatio);
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - thumbnail_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - thumbnail_size.height() / 2),
+                     thumbnail_size.width(),
+                     thumbnail_size.height());
+    painter->drawImage(img_rect, thumbnail);
+  }
 
   if (option.state & QStyle::State_Selected) {
     QColor highlight_color = option.palette.highlight().color();
@@ -25,6 +25,8 @@
 
 /**
  * @brief The delegate that's used to draw items when ProjectExplorer is in Icon view
+ *
+ * Footage is drawn with its thumbnail from olive::thumbnail_service once it's available, and with its icon until then.
  */
 class ProjectExplorerIconViewItemDelegate : public QStyledItemDelegate {
 public:
@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectexplorersearchmodel.h"
+
+ProjectExplorerSearchModel::ProjectExplorerSearchModel(QObject *parent) :
+  QAbstractListModel(parent)
+{
+}
+
+void ProjectExplorerSearchModel::set_results(const QVector<Item *> &results)
+{
+  beginResetModel();
+
+  results_ = results;
+
+  endResetModel();
+}
+
+QModelIndex ProjectExplorerSearchModel::index(int row, int column, const QModelIndex &parent) const
+{
+  if (!hasIndex(row, column, parent)) {
+    return QModelIndex();
+  }
+
+  return createIndex(row, column, results_.at(row));
+}
+
+int ProjectExplorerSearchModel::rowCount(const QModelIndex &parent) const
+{
+  // Results have no children
+  if (parent.isValid()) {
+    return 0;
+  }
+
+  return results_.size();
+}
+
+QVariant ProjectExplorerSearchModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid()) {
+    return QVariant();
+  }
+
+  Item* item = results_.at(index.row());
+
+  switch (role) {
+  case Qt::DisplayRole:
+    return item->name();
+  case Qt::DecorationRole:
+    return item->icon();
+  case Qt::ToolTipRole:
+    return item->tooltip();
+  }
+
+  return QVariant();
+}
@@ -0,0 +1,54 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTEXPLORERSEARCHMODEL_H
+#define PROJECTEXPLORERSEARCHMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "project/item/item.h"
+
+/**
+ * @brief A flat list of the Items found by a search in ProjectExplorer
+ *
+ * Indexes point to their Item like ProjectViewModel's (QModelIndex::internalPointer()), so code handling selections can
+ * use either model.
+ */
+class ProjectExplorerSearchModel : public QAbstractListModel
+{
+  Q_OBJECT
+public:
+  ProjectExplorerSearchModel(QObject* parent);
+
+  /**
+   * @brief Replace the results being shown
+   */
+  void set_results(const QVector<Item*>& results);
+
+  virtual QModelIndex index(int row, int column = 0, const QModelIndex &parent = QModelIndex()) const override;
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+  QVector<Item*> results_;
+};
+
+#endif // PROJECTEXPLORERSEARCHMODEL_H
@@ -0,0 +1,357 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scopewidget.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QPainter>
+#include <QPainterPath>
+
+#include "common/tracing.h"
+#include "render/gl/compute.h"
+#include "render/gl/shadercache.h"
+
+// Rec. 709 Cb and Cr coefficients, also used to place the vectorscope's targets
+const float kCbCoefficients[] = {-0.1146f, -0.3854f, 0.5f};
+const float kCrCoefficients[] = {0.5f, -0.4542f, -0.0458f};
+
+// Shortest time between updates in milliseconds
+const int kMinUpdateInterval = 33;
+
+// Most rows (and vectorscope columns) of the image that are plotted
+const int kMaxSamples = 256;
+
+// Number of bins in each channel of the histogram
+const int kHistogramBins = 256;
+
+// How bright plotted points are, scaled by how many points land on each scope pixel on average
+const float kPointBrightness = 2.0f;
+
+const char* kScopeVertexShader =
+    "#version 150\n"
+    "\n"
+    "uniform sampler2D tex;\n"
+    "uniform ivec2 tex_size;\n"
+    "uniform ivec2 samples;\n"
+    "uniform bool vectorscope;\n"
+    "uniform vec3 cb_coefficients;\n"
+    "uniform vec3 cr_coefficients;\n"
+    "uniform float intensity;\n"
+    "\n"
+    "out vec4 v_color;\n"
+    "\n"
+    "void main() {\n"
+    "  ivec2 cell = ivec2(gl_VertexID % samples.x, gl_VertexID / samples.x);\n"
+    "  vec4 c = texelFetch(tex, (cell * tex_size) / samples, 0);\n"
+    "\n"
+    "  if (vectorscope) {\n"
+    "    // Cb and Cr range from -0.5 to 0.5\n"
+    "    gl_Position = vec4(dot(c.rgb, cb_coefficients) * 2.0, dot(c.rgb, cr_coefficients) * 2.0, 0.0, 1.0);\n"
+    "    v_color = vec4(vec3(intensity), 1.0);\n"
+    "  } else {\n"
+    "    // One instance per channel, each plotted in its own color\n"
+    "    float x = (float(cell.x) + 0.5) / float(samples.x) * 2.0 - 1.0;\n"
+    "    float value = c[gl_InstanceID];\n"
+    "    vec3 color = vec3(0.0);\n"
+    "    color[gl_InstanceID] = intensity;\n"
+    "    gl_Position = vec4(x, value * 2.0 - 1.0, 0.0, 1.0);\n"
+    "    v_color = vec4(color, 1.0);\n"
+    "  }\n"
+    "}\n";
+
+const char* kScopeFragmentShader =
+    "#version 150\n"
+    "\n"
+    "in vec4 v_color;\n"
+    "out vec4 frag_color;\n"
+    "\n"
+    "void main() {\n"
+    "  frag_color = v_color;\n"
+    "}\n";
+
+ScopeWidget::ScopeWidget(QWidget *parent) :
+  QOpenGLWidget(parent),
+  type_(kWaveform),
+  texture_(0),
+  histogram_unsupported_(false)
+{
+  update_timer_.setSingleShot(true);
+  connect(&update_timer_, SIGNAL(timeout()), this, SLOT(update()));
+
+  last_update_.start();
+}
+
+ScopeWidget::~ScopeWidget()
+{
+  makeCurrent();
+  vao_.destroy();
+  doneCurrent();
+}
+
+ScopeWidget::Type ScopeWidget::type() const
+{
+  return type_;
+}
+
+void ScopeWidget::SetType(int type)
+{
+  type_ = static_cast<Type>(type);
+
+  update();
+}
+
+void ScopeWidget::SetTexture(GLuint texture, GLsync fence)
+{
+  // Nobody is looking, don't spend any time on it
+  if (!isVisible()) {
+    return;
+  }
+
+  if (fence != nullptr) {
+    // Make our reads of the texture wait for it to finish rendering
+    makeCurrent();
+    context()->extraFunctions()->glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+    doneCurrent();
+  }
+
+  texture_ = texture;
+
+  // Only update as often as kMinUpdateInterval allows, showing whichever texture is newest by then
+  if (!update_timer_.isActive()) {
+    update_timer_.start(qMax(0, kMinUpdateInterval - static_cast<int>(last_update_.elapsed())));
+  }
+}
+
+void ScopeWidget::initializeGL()
+{
+  pipeline_ = olive::gl::shader_cache.Get(kScopeVertexShader, kScopeFragmentShader);
+
+  vao_.create();
+
+  histogram_unsupported_ = !olive::gl::SupportsCompute(context());
+}
+
+void ScopeWidget::paintGL()
+{
+  Tracing::Span span("scope", "ScopeWidget::paintGL");
+
+  last_update_.restart();
+
+  QOpenGLFunctions* f = context()->functions();
+
+  f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  GLint texture_width = 0;
+  GLint texture_height = 0;
+
+  if (texture_ > 0) {
+    f->glBindTexture(GL_TEXTURE_2D, texture_);
+    context()->extraFunctions()->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texture_width);
+    context()->extraFunctions()->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texture_height);
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  bool have_image = (texture_width > 0 && texture_height > 0);
+
+  if (type_ == kHistogram) {
+    if (have_image && !histogram_unsupported_) {
+      olive::gl::ComputeHistogram(texture_, texture_width, texture_height, kHistogramBins, &histogram_);
+    }
+  } else if (have_image && pipeline_ != nullptr) {
+    DrawPoints(texture_width, texture_height);
+  }
+
+  QPainter p(this);
+
+  if (type_ == kHistogram) {
+    DrawHistogram(&p);
+  } else {
+    DrawGraticule(&p);
+  }
+}
+
+void ScopeWidget::DrawPoints(int texture_width, int texture_height)
+{
+  QOpenGLFunctions* f = context()->functions();
+  QOpenGLExtraFunctions* xf = context()->extraFunctions();
+
+  qreal dpr = devicePixelRatioF();
+
+  QRect area;
+
+  if (type_ == kVectorscope) {
+    QRect square = GetVectorscopeRect();
+
+    // GL's origin is at the bottom
+    area = QRect(qRound(square.x() * dpr),
+                 qRound((height() - square.bottom() - 1) * dpr),
+                 qRound(square.width() * dpr),
+                 qRound(square.height() * dpr));
+  } else {
+    area = QRect(0, 0, qRound(width() * dpr), qRound(height() * dpr));
+  }
+
+  if (area.width() <= 0 || area.height() <= 0) {
+    return;
+  }
+
+  // Decimate to at most one column per scope pixel (the vectorscope has no columns) and kMaxSamples rows
+  int sample_columns = qMin(texture_width, (type_ == kVectorscope) ? kMaxSamples : area.width());
+  int sample_rows = qMin(texture_height, kMaxSamples);
+
+  float intensity;
+
+  if (type_ == kVectorscope) {
+    intensity = kPointBrightness * area.width() * area.height() / (sample_columns * sample_rows);
+  } else {
+    intensity = kPointBrightness * area.height() * sample_columns / (area.width() * sample_rows);
+  }
+
+  intensity = qBound(0.01f, intensity, 1.0f);
+
+  f->glViewport(area.x(), area.y(), area.width(), area.height());
+
+  f->glEnable(GL_BLEND);
+  f->glBlendFunc(GL_ONE, GL_ONE);
+
+  f->glActiveTexture(GL_TEXTURE0);
+  f->glBindTexture(GL_TEXTURE_2D, texture_);
+
+  pipeline_->bind();
+  pipeline_->setUniformValue("tex", 0);
+  pipeline_->setUniformValue("tex_size", texture_width, texture_height);
+  pipeline_->setUniformValue("samples", sample_columns, sample_rows);
+  pipeline_->setUniformValue("vectorscope", type_ == kVectorscope);
+  pipeline_->setUniformValue("cb_coefficients", kCbCoefficients[0], kCbCoefficients[1], kCbCoefficients[2]);
+  pipeline_->setUniformValue("cr_coefficients", kCrCoefficients[0], kCrCoefficients[1], kCrCoefficients[2]);
+  pipeline_->setUniformValue("intensity", intensity);
+
+  // Points are generated entirely from gl_VertexID, but core profiles still need a VAO bound to draw
+  vao_.bind();
+
+  xf->glDrawArraysInstanced(GL_POINTS, 0, sample_columns * sample_rows, (type_ == kVectorscope) ? 1 : 3);
+
+  vao_.release();
+
+  pipeline_->release();
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  f->glDisable(GL_BLEND);
+
+  f->glViewport(0, 0, qRound(width() * dpr), qRound(height() * dpr));
+}
+
+void ScopeWidget::DrawHistogram(QPainter *p)
+{
+  if (histogram_unsupported_) {
+    p->setPen(Qt::white);
+    p->drawText(rect(), Qt::AlignCenter, tr("The histogram requires OpenGL 4.3"));
+    return;
+  }
+
+  if (histogram_.size() != kHistogramBins * 4) {
+    return;
+  }
+
+  // Scale to the tallest bin
+  quint32 max = 1;
+  foreach (quint32 count, histogram_) {
+    max = qMax(max, count);
+  }
+
+  const QColor colors[] = {QColor(255, 0, 0, 96), QColor(0, 255, 0, 96), QColor(0, 0, 255, 96), QColor(255, 255, 255, 96)};
+
+  p->setRenderHint(QPainter::Antialiasing);
+  p->setPen(Qt::NoPen);
+  p->setCompositionMode(QPainter::CompositionMode_Plus);
+
+  qreal bin_width = static_cast<qreal>(width()) / kHistogramBins;
+
+  for (int channel=0;channel<4;channel++) {
+    QPainterPath path;
+    path.moveTo(0, height());
+
+    for (int i=0;i<kHistogramBins;i++) {
+      qreal y = height() - height() * static_cast<qreal>(histogram_.at(channel * kHistogramBins + i)) / max;
+
+      path.lineTo(i * bin_width, y);
+      path.lineTo((i + 1) * bin_width, y);
+    }
+
+    path.lineTo(width(), height());
+    path.closeSubpath();
+
+    p->fillPath(path, colors[channel]);
+  }
+}
+
+void ScopeWidget::DrawGraticule(QPainter *p)
+{
+  p->setPen(QColor(255, 255, 255, 64));
+
+  if (type_ == kVectorscope) {
+    QRect square = GetVectorscopeRect();
+    QPointF center = QRectF(square).center();
+    qreal radius = square.width() * 0.5;
+
+    p->setRenderHint(QPainter::Antialiasing);
+    p->drawEllipse(center, radius, radius);
+    p->drawLine(QPointF(center.x() - radius, center.y()), QPointF(center.x() + radius, center.y()));
+    p->drawLine(QPointF(center.x(), center.y() - radius), QPointF(center.x(), center.y() + radius));
+
+    // Targets for 75% color bars
+    const char* names[] = {"R", "G", "B", "Cy", "Mg", "Yl"};
+    const float primaries[][3] = {{0.75f, 0, 0}, {0, 0.75f, 0}, {0, 0, 0.75f},
+                                  {0, 0.75f, 0.75f}, {0.75f, 0, 0.75f}, {0.75f, 0.75f, 0}};
+
+    for (int i=0;i<6;i++) {
+      float cb = 0;
+      float cr = 0;
+
+      for (int j=0;j<3;j++) {
+        cb += primaries[i][j] * kCbCoefficients[j];
+        cr += primaries[i][j] * kCrCoefficients[j];
+      }
+
+      // Cb/Cr of +-0.5 reaches the edge of the circle
+      QPointF target(center.x() + cb * 2.0 * radius, center.y() - cr * 2.0 * radius);
+
+      p->drawRect(QRectF(target.x() - 4, target.y() - 4, 8, 8));
+      p->drawText(target + QPointF(6, -6), QString::fromLatin1(names[i]));
+    }
+  } else {
+    for (int i=0;i<=4;i++) {
+      int y = qRound((height() - 1) * (1.0 - i * 0.25));
+
+      p->drawLine(0, y, width(), y);
+      p->drawText(2, qMax(y - 2, p->fontMetrics().ascent()), QString::number(i * 25));
+    }
+  }
+}
+
+QRect ScopeWidget::GetVectorscopeRect()
+{
+  int size = qMin(width(), height());
+
+  return QRect((width() - size) / 2, (height() - size) / 2, size, size);
+}
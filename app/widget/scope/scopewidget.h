@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPEWIDGET_H
+#define SCOPEWIDGET_H
+
+#include <QElapsedTimer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLWidget>
+#include <QTimer>
+#include <QVector>
+
+#include "render/gl/shaderptr.h"
+
+/**
+ * @brief Waveform, vectorscope or histogram of the textures a viewer shows
+ *
+ * Connect ViewerGLWidget::TextureShown() (or one of the signals forwarding it) to SetTexture(). The scope reads the
+ * texture directly from the shared context group, so no image ever leaves the GPU:
+ *
+ * * The waveform and vectorscope are drawn by a vertex shader that fetches a decimated grid of pixels (at most one
+ *   column per scope pixel for the waveform and a few hundred rows) and plots each as a point with additive blending.
+ * * The histogram is counted with olive::gl::ComputeHistogram(), which only reads back the bin counts. It needs
+ *   compute shader support (see olive::gl::SupportsCompute()).
+ *
+ * Updates are limited to about 30 per second and skipped entirely while the scope is hidden, so
+ * keeping a scope open doesn't hold back playback.
+ */
+class ScopeWidget : public QOpenGLWidget
+{
+  Q_OBJECT
+public:
+  enum Type {
+    kWaveform,
+    kVectorscope,
+    kHistogram
+  };
+
+  ScopeWidget(QWidget* parent);
+
+  virtual ~ScopeWidget() override;
+
+  Type type() const;
+
+public slots:
+  /**
+   * @brief Set which scope to show
+   */
+  void SetType(int type);
+
+  /**
+   * @brief Analyze a texture the next time the scope updates (see ViewerGLWidget::TextureShown())
+   */
+  void SetTexture(GLuint texture, GLsync fence);
+
+protected:
+  virtual void initializeGL() override;
+
+  virtual void paintGL() override;
+
+private:
+  /**
+   * @brief Plot the decimated pixels of texture_ as points (waveform or vectorscope)
+   */
+  void DrawPoints(int texture_width, int texture_height);
+
+  /**
+   * @brief Draw the histogram_ counted in paintGL()
+   */
+  void DrawHistogram(QPainter* p);
+
+  /**
+   * @brief Draw scale lines and labels over the waveform or vectorscope
+   */
+  void DrawGraticule(QPainter* p);
+
+  /**
+   * @brief Area of the widget the vectorscope is drawn in (a centered square)
+   */
+  QRect GetVectorscopeRect();
+
+  Type type_;
+
+  GLuint texture_;
+
+  ShaderPtr pipeline_;
+
+  QOpenGLVertexArrayObject vao_;
+
+  QVector<quint32> histogram_;
+
+  /**
+   * @brief Set if this context can't run compute shaders, so there's no histogram
+   */
+  bool histogram_unsupported_;
+
+  QElapsedTimer last_update_;
+
+  QTimer update_timer_;
+};
+
+#endif // SCOPEWIDGET_H
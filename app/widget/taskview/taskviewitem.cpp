@@ -63,6 +63,7 @@ void TaskViewItem::SetTask(Task *t)
   if (task_ != nullptr) {
     disconnect(task_, SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskStatusChange(Task::Status)));
     disconnect(task_, SIGNAL(ProgressChanged(int)), progress_bar_, SLOT(setValue(int)));
+    disconnect(task_, SIGNAL(ProgressChanged(int)), this, SLOT(TaskProgressChange(int)));
     disconnect(task_, SIGNAL(destroyed()), this, SLOT(deleteLater()));
   }
 
@@ -75,10 +76,21 @@ void TaskViewItem::SetTask(Task *t)
   // Connect to the task
   connect(task_, SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskStatusChange(Task::Status)));
   connect(task_, SIGNAL(ProgressChanged(int)), progress_bar_, SLOT(setValue(int)));
+  connect(task_, SIGNAL(ProgressChanged(int)), this, SLOT(TaskProgressChange(int)));
   connect(task_, SIGNAL(Removed()), this, SLOT(deleteLater()));
   connect(cancel_btn_, SIGNAL(clicked(bool)), task_, SLOT(Cancel()));
 }
 
+QString TaskViewItem::FormatDuration(qint64 ms)
+{
+  return tr("%1 s").arg(static_cast<double>(ms) / 1000.0, 0, 'f', 2);
+}
+
+QString TaskViewItem::FormatBytes(qint64 bytes)
+{
+  return tr("%1 MB").arg(static_cast<double>(bytes) / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
 void TaskViewItem::TaskStatusChange(Task::Status status)
 {
   switch (status) {
@@ -105,4 +117,37 @@ void TaskViewItem::TaskStatusChange(Task::Status status)
     cancel_btn_->setEnabled(false);
     break;
   }
+
+  // Show where the time went once the Task has run
+  if (status == Task::kFinished || status == Task::kError) {
+    const Task::Timing& timing = static_cast<Task*>(sender())->timing();
+
+    if (timing.wall_time >= 0) {
+      setToolTip(tr("Queued: %1\nRunning: %2\nCPU: %3\nRead: %4").arg(FormatDuration(timing.queue_wait),
+                                                                       FormatDuration(timing.wall_time),
+                                                                       FormatDuration(timing.cpu_time),
+                                                                       FormatBytes(timing.bytes_read)));
+    }
+  } else {
+    setToolTip(QString());
+  }
+}
+
+void TaskViewItem::TaskProgressChange(int progress)
+{
+  Q_UNUSED(progress)
+
+  Task* task = static_cast<Task*>(sender());
+
+  if (task->status() != Task::kWorking) {
+    return;
+  }
+
+  qint64 remaining = task->remaining_time();
+
+  if (remaining >= 0) {
+    task_status_lbl_->setText(tr("Working... (%1 left)").arg(FormatDuration(remaining)));
+  } else {
+    task_status_lbl_->setText(tr("Working..."));
+  }
 }
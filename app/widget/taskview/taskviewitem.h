@@ -32,8 +32,9 @@
  * @brief A widget that visually represents the status of a Task
  *
  * The TaskViewItem widget shows a description of the Task (Task::text(), a progress bar (updated by
- * Task::ProgressChanged), the Task's status (text generated from Task::status() or Task::error()), and provides
- * a cancel button (triggering Task::Cancel()) for cancelling a Task before it finishes.
+ * Task::ProgressChanged), the Task's status (text generated from Task::status() or Task::error(), along with
+ * Task::remaining_time() if the Task predicts it), and provides a cancel button (triggering Task::Cancel()) for
+ * cancelling a Task before it finishes. Once the Task has run, its Task::Timing is shown in the tooltip.
  *
  * The main entry point is SetTask() after a Task and TaskViewItem objects are created.
  */
@@ -52,6 +53,16 @@ public:
    */
   void SetTask(Task* t);
 
+  /**
+   * @brief Format a duration in milliseconds for display
+   */
+  static QString FormatDuration(qint64 ms);
+
+  /**
+   * @brief Format a number of bytes for display
+   */
+  static QString FormatBytes(qint64 bytes);
+
 private:
   QLabel* task_name_lbl_;
   QProgressBar* progress_bar_;
@@ -63,6 +74,8 @@ private:
 private slots:
   void TaskStatusChange(Task::Status status);
 
+  void TaskProgressChange(int progress);
+
 };
 
 #endif // TASKVIEWITEM_H
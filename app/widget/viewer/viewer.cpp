@@ -20,8 +20,11 @@
 
 #include "viewer.h"
 
-#include <QVBoxLayout>
+#include <QHideEvent>
 #include <QLabel>
+#include <QShortcut>
+#include <QShowEvent>
+#include <QVBoxLayout>
 
 ViewerWidget::ViewerWidget(QWidget *parent) :
   QWidget(parent)
@@ -41,17 +44,110 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   controls_->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Maximum);
   layout->addWidget(controls_);
 
-  // FIXME: Test code
-  connect(controls_, SIGNAL(PlayClicked()), this, SLOT(TemporaryTestFunction()));
-  // End test code
+  // Drive the playhead with the playback engine, following the audio clock
+  playback_engine_.SetAudioPlayback(&audio_playback_);
+  connect(controls_, SIGNAL(PlayClicked()), &playback_engine_, SLOT(TogglePlayback()));
+  connect(controls_, SIGNAL(PrevFrameClicked()), &playback_engine_, SLOT(PrevFrame()));
+  connect(controls_, SIGNAL(NextFrameClicked()), &playback_engine_, SLOT(NextFrame()));
+  connect(controls_, SIGNAL(BeginClicked()), this, SLOT(GoToStart()));
+  connect(&playback_engine_, SIGNAL(TimeChanged(const rational&)), this, SIGNAL(TimeChanged(const rational&)));
+
+  // J/K/L shuttle while the viewer has focus
+  QShortcut* shuttle_backward = new QShortcut(Qt::Key_J, this, nullptr, nullptr, Qt::WidgetWithChildrenShortcut);
+  connect(shuttle_backward, SIGNAL(activated()), &playback_engine_, SLOT(ShuttleBackward()));
+
+  QShortcut* shuttle_stop = new QShortcut(Qt::Key_K, this, nullptr, nullptr, Qt::WidgetWithChildrenShortcut);
+  connect(shuttle_stop, SIGNAL(activated()), &playback_engine_, SLOT(ShuttleStop()));
+
+  QShortcut* shuttle_forward = new QShortcut(Qt::Key_L, this, nullptr, nullptr, Qt::WidgetWithChildrenShortcut);
+  connect(shuttle_forward, SIGNAL(activated()), &playback_engine_, SLOT(ShuttleForward()));
+
+  // Render-ahead follows the playhead directly rather than through the event loop
+  render_ahead_.SetTimeSource(playback_engine_.time_source());
+
+  connect(gl_widget_, SIGNAL(DividerChanged(int)), this, SIGNAL(DividerChanged(int)));
+  connect(gl_widget_, SIGNAL(TextureShown(GLuint, GLsync)), this, SIGNAL(TextureShown(GLuint, GLsync)));
+
+  // Let the engine know how closely frames are being shown to when they're due
+  connect(gl_widget_,
+          SIGNAL(FramePresented(qint64, qint64)),
+          &playback_engine_,
+          SLOT(ReportPresentation(qint64, qint64)));
+
+  // Enabled once the viewer is first shown
+  render_ahead_.SetSpeculativeEnabled(false);
+}
+
+void ViewerWidget::showEvent(QShowEvent *e)
+{
+  QWidget::showEvent(e);
+
+  if (!e->spontaneous()) {
+    render_ahead_.SetSpeculativeEnabled(true);
+  }
+}
+
+void ViewerWidget::hideEvent(QHideEvent *e)
+{
+  QWidget::hideEvent(e);
+
+  if (!e->spontaneous()) {
+    render_ahead_.SetSpeculativeEnabled(false);
+  }
+}
+
+void ViewerWidget::SetTimebase(const rational &timebase)
+{
+  playback_engine_.SetTimebase(timebase);
+  render_ahead_.SetTimebase(timebase);
+
+  double frame_duration = timebase.ToDouble();
+
+  gl_widget_->SetTargetFrameRate(frame_duration > 0 ? 1.0 / frame_duration : 0);
+}
+
+PlaybackEngine *ViewerWidget::playback_engine()
+{
+  return &playback_engine_;
+}
+
+AudioPlayback *ViewerWidget::audio_playback()
+{
+  return &audio_playback_;
+}
+
+RenderAhead *ViewerWidget::render_ahead()
+{
+  return &render_ahead_;
+}
+
+void ViewerWidget::SetTexture(GLuint tex, GLsync fence)
+{
+  gl_widget_->SetTexture(tex, fence);
+}
+
+void ViewerWidget::QueueTexture(GLuint tex, GLsync fence, qint64 present_time)
+{
+  gl_widget_->QueueTexture(tex, fence, present_time);
+}
+
+void ViewerWidget::SetImageSize(int width, int height)
+{
+  gl_widget_->SetImageSize(width, height);
+}
+
+void ViewerWidget::SetPerformanceHudEnabled(bool enabled)
+{
+  gl_widget_->SetPerformanceHudEnabled(enabled);
 }
 
-void ViewerWidget::SetTexture(GLuint tex)
+void ViewerWidget::SetOverlayText(const QStringList &lines)
 {
-  gl_widget_->SetTexture(tex);
+  gl_widget_->SetOverlayText(lines);
 }
 
-void ViewerWidget::TemporaryTestFunction()
+void ViewerWidget::GoToStart()
 {
-  emit TimeChanged(69);
+  playback_engine_.Pause();
+  playback_engine_.Seek(0);
 }
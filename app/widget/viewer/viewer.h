@@ -25,7 +25,10 @@
 #include <QPushButton>
 #include <QLabel>
 
+#include "audio/audioplayback.h"
 #include "common/rational.h"
+#include "render/playbackengine.h"
+#include "render/renderahead.h"
 #include "viewerglwidget.h"
 #include "widget/playbackcontrols/playbackcontrols.h"
 
@@ -40,6 +43,27 @@ public:
 
   void SetPlaybackControlsEnabled(bool enabled);
 
+  /**
+   * @brief Set the duration of one frame of playback (usually Sequence::video_time_base())
+   */
+  void SetTimebase(const rational& timebase);
+
+  /**
+   * @brief Access the PlaybackEngine driving this viewer (e.g. to attach a renderer or read playback statistics)
+   */
+  PlaybackEngine* playback_engine();
+
+  /**
+   * @brief Access the AudioPlayback this viewer's playback is timed by (e.g. to add streams or set the buffer size)
+   */
+  AudioPlayback* audio_playback();
+
+  /**
+   * @brief Access the RenderAhead filling the frame cache around this viewer's playhead (e.g. to attach a renderer or
+   * render an in/out range)
+   */
+  RenderAhead* render_ahead();
+
 public slots:
   /**
    * @brief Set the texture to draw and draw it
@@ -47,18 +71,72 @@ public slots:
    * Wrapper function for ViewerGLWidget::SetTexture().
    *
    * @param tex
+   *
+   * @param fence
+   *
+   * Optional fence to wait on before drawing the texture (see ViewerGLWidget::SetTexture()).
+   */
+  void SetTexture(GLuint tex, GLsync fence = nullptr);
+
+  /**
+   * @brief Wrapper function for ViewerGLWidget::QueueTexture()
+   */
+  void QueueTexture(GLuint tex, GLsync fence, qint64 present_time);
+
+  /**
+   * @brief Wrapper function for ViewerGLWidget::SetImageSize()
+   */
+  void SetImageSize(int width, int height);
+
+  /**
+   * @brief Wrapper function for ViewerGLWidget::SetPerformanceHudEnabled()
+   */
+  void SetPerformanceHudEnabled(bool enabled);
+
+  /**
+   * @brief Wrapper function for ViewerGLWidget::SetOverlayText()
    */
-  void SetTexture(GLuint tex);
+  void SetOverlayText(const QStringList& lines);
+
+protected:
+  /**
+   * @brief Only render ahead around the playhead while this viewer can be seen
+   *
+   * Hidden viewers (e.g. in a dock tabbed behind another panel) would otherwise keep rendering frames nobody looks
+   * at. Spontaneous events (the whole window being minimized) are ignored.
+   */
+  virtual void showEvent(QShowEvent* e) override;
+
+  virtual void hideEvent(QHideEvent* e) override;
 
 signals:
   void TimeChanged(const rational&);
 
+  /**
+   * @brief Forwarded from ViewerGLWidget::DividerChanged()
+   */
+  void DividerChanged(int divider);
+
+  /**
+   * @brief Forwarded from ViewerGLWidget::TextureShown()
+   */
+  void TextureShown(GLuint texture, GLsync fence);
+
 private:
   ViewerGLWidget* gl_widget_;
   PlaybackControls* controls_;
 
+  AudioPlayback audio_playback_;
+
+  PlaybackEngine playback_engine_;
+
+  RenderAhead render_ahead_;
+
 private slots:
-  void TemporaryTestFunction();
+  /**
+   * @brief Go to the first frame
+   */
+  void GoToStart();
 };
 
 #endif // VIEWER_WIDGET_H
@@ -20,52 +20,664 @@
 
 #include "viewerglwidget.h"
 
+#include <QGuiApplication>
+#include <QMouseEvent>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
+#include <QPainter>
+#include <QScreen>
+#include <QWheelEvent>
+#include <cmath>
 
+#include "common/clamp.h"
+#include "common/tracing.h"
+#include "render/allocationcounters.h"
+#include "render/colormanagement.h"
 #include "render/gl/functions.h"
 #include "render/gl/shadergenerators.h"
+#include "render/playbackengine.h"
+
+// How much each step of the mouse wheel zooms by
+const double kWheelZoomFactor = 1.25;
+
+// Zoom limits
+const double kMinimumZoom = 0.01;
+const double kMaximumZoom = 64.0;
 
 ViewerGLWidget::ViewerGLWidget(QWidget *parent) :
   QOpenGLWidget(parent),
-  texture_(0)
+  image_width_(0),
+  image_height_(0),
+  zoom_(0),
+  panning_(false),
+  divider_(1),
+  presenting_due_(-1),
+  last_swap_(-1),
+  refresh_interval_(1000000000.0 / 60.0),
+  texture_(0),
+  fence_(nullptr),
+  shown_fence_(nullptr),
+  ocio_lut_(0),
+  target_frame_rate_(0),
+  displayed_frames_(0),
+  new_frame_(false)
 {
+  connect(this, SIGNAL(frameSwapped()), this, SLOT(FrameSwapped()));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  // The display transform in paintGL() is the last step before the screen. When the window is deeper than 8 bits,
+  // draw into a framebuffer just as deep so its output isn't rounded to 8 bits on the way there.
+  if (format().redBufferSize() > 8) {
+    setTextureFormat(GL_RGB10_A2);
+  }
+#endif
+
+  hud_timer_.setInterval(kHudInterval);
+  connect(&hud_timer_, SIGNAL(timeout()), this, SLOT(UpdateHud()));
 }
 
-void ViewerGLWidget::SetTexture(GLuint tex)
+ViewerGLWidget::~ViewerGLWidget()
 {
+  if (fence_ != nullptr || shown_fence_ != nullptr || !queue_.isEmpty()) {
+    makeCurrent();
+    ClearQueue();
+    if (fence_ != nullptr) {
+      DeleteFence();
+    }
+    if (shown_fence_ != nullptr) {
+      context()->extraFunctions()->glDeleteSync(shown_fence_);
+    }
+    doneCurrent();
+  }
+}
+
+void ViewerGLWidget::SetTexture(GLuint tex, GLsync fence)
+{
+  // If the last texture was never drawn, nothing will wait on its fence now
+  if (fence_ != nullptr || !queue_.isEmpty()) {
+    makeCurrent();
+    ClearQueue();
+    if (fence_ != nullptr) {
+      DeleteFence();
+    }
+    doneCurrent();
+  }
+
+  presenting_due_ = -1;
+
   // Update the texture
   texture_ = tex;
+  fence_ = fence;
+  new_frame_ = true;
 
   // Paint the texture
   update();
 }
 
+void ViewerGLWidget::QueueTexture(GLuint tex, GLsync fence, qint64 present_time)
+{
+  QueuedTexture queued;
+  queued.texture = tex;
+  queued.fence = fence;
+  queued.due = present_time;
+
+  queue_.append(queued);
+
+  // Repaints keep being requested after each swap until the queue is empty (see FrameSwapped())
+  update();
+}
+
+void ViewerGLWidget::SetOverlayText(const QStringList &lines)
+{
+  overlay_text_ = lines;
+
+  update();
+}
+
+void ViewerGLWidget::SetPerformanceHudEnabled(bool enabled)
+{
+  if (enabled == hud_timer_.isActive()) {
+    return;
+  }
+
+  hud_samples_.clear();
+  hud_text_.clear();
+
+  if (enabled) {
+    hud_timer_.start();
+    UpdateHud();
+  } else {
+    hud_timer_.stop();
+    update();
+  }
+}
+
+void ViewerGLWidget::SetTargetFrameRate(double fps)
+{
+  target_frame_rate_ = fps;
+}
+
 void ViewerGLWidget::initializeGL()
 {
-  // Re-retrieve pipeline pertaining to this context
-  pipeline_ = olive::gl::GetDefaultPipeline();
+  // Re-retrieve pipelines pertaining to this context
+  pipeline_ = nullptr;
+  ocio_lut_ = 0;
+  display_pipelines_.clear();
+  display_key_.clear();
+
+  UpdateDisplay();
+}
+
+void ViewerGLWidget::UpdateDisplay()
+{
+  OCIO::ConstConfigRcPtr config = olive::color::GetConfig();
+
+  QWindow* window_handle = window()->windowHandle();
+  QScreen* screen = window_handle ? window_handle->screen() : QGuiApplication::primaryScreen();
+
+  olive::color::DisplayView display_view = olive::color::GetScreenDisplay(config, screen);
+  QString key = QStringList({display_view.display, display_view.view}).join('\n');
+
+  if (pipeline_ != nullptr && key == display_key_) {
+    return;
+  }
+
+  QHash<QString, DisplayPipeline>::const_iterator it = display_pipelines_.constFind(key);
+
+  if (it == display_pipelines_.constEnd()) {
+    DisplayPipeline display_pipeline;
+    display_pipeline.lut = 0;
+
+    // Frames are in the working space, this is the one place they're converted for the display
+    OCIO::ConstProcessorRcPtr display = olive::color::GetDisplayProcessor(config,
+                                                                          display_view.display,
+                                                                          display_view.view);
+
+    if (display) {
+      display_pipeline.shader = olive::gl::GetOCIOPipeline(context(),
+                                                           display_pipeline.lut,
+                                                           display,
+                                                           olive::gl::kOCIOAlphaAssociated);
+    }
+
+    if (display_pipeline.shader == nullptr) {
+      display_pipeline.lut = 0;
+      display_pipeline.shader = olive::gl::GetDefaultPipeline();
+    }
+
+    it = display_pipelines_.insert(key, display_pipeline);
+  }
+
+  pipeline_ = it->shader;
+  ocio_lut_ = it->lut;
+  display_key_ = key;
+
+  update();
+}
+
+void ViewerGLWidget::ScreenChanged()
+{
+  // initializeGL() will pick the screen up if there's no context yet
+  if (!isValid()) {
+    return;
+  }
+
+  makeCurrent();
+  UpdateDisplay();
+  doneCurrent();
+}
+
+void ViewerGLWidget::showEvent(QShowEvent *event)
+{
+  QOpenGLWidget::showEvent(event);
+
+  // The widget may have been moved into another window (e.g. a panel that was undocked), follow that one's screen
+  QWindow* window_handle = window()->windowHandle();
+
+  if (window_handle != screen_window_) {
+    if (screen_window_) {
+      disconnect(screen_window_, SIGNAL(screenChanged(QScreen*)), this, SLOT(ScreenChanged()));
+    }
+
+    screen_window_ = window_handle;
+
+    if (screen_window_) {
+      connect(screen_window_, SIGNAL(screenChanged(QScreen*)), this, SLOT(ScreenChanged()));
+    }
+
+    ScreenChanged();
+  }
 }
 
 void ViewerGLWidget::paintGL()
 {
+  Tracing::Span span("viewer", "ViewerGLWidget::paintGL");
+
   // Get functions attached to this context (they will already be initialized)
   QOpenGLFunctions* f = context()->functions();
 
+  TakeQueuedTexture();
+
   // Clear background to empty
   f->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   f->glClear(GL_COLOR_BUFFER_BIT);
 
   // Check if we have a texture to draw
   if (texture_ > 0) {
+    // Have the GPU wait until the texture has finished rendering in its own context
+    if (fence_ != nullptr) {
+      context()->extraFunctions()->glWaitSync(fence_, 0, GL_TIMEOUT_IGNORED);
+
+      if (new_frame_ && shown_fence_ == nullptr) {
+        // Keep it for whatever receives TextureShown()
+        shown_fence_ = fence_;
+        fence_ = nullptr;
+      } else {
+        DeleteFence();
+      }
+    }
+
+    if (ocio_lut_ != 0) {
+      f->glActiveTexture(GL_TEXTURE1);
+      f->glBindTexture(GL_TEXTURE_3D, ocio_lut_);
+      f->glActiveTexture(GL_TEXTURE0);
+    }
+
     // Bind retrieved texture
     f->glBindTexture(GL_TEXTURE_2D, texture_);
 
-    // Blit using the pipeline retrieved in initializeGL()
-    olive::gl::Blit(pipeline_, true);
+    // Blit using the pipeline retrieved in initializeGL(), the viewer is a preview so cheaper mipmaps will do
+    olive::gl::Blit(pipeline_, true, GetPresentationMatrix(), olive::gl::kMipmapPreview);
 
     // Release retrieved texture
     f->glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (ocio_lut_ != 0) {
+      f->glActiveTexture(GL_TEXTURE1);
+      f->glBindTexture(GL_TEXTURE_3D, 0);
+      f->glActiveTexture(GL_TEXTURE0);
+    }
   }
+
+  QStringList text = hud_text_ + overlay_text_;
+
+  if (!text.isEmpty()) {
+    QPainter p(this);
+
+    QFontMetrics fm = p.fontMetrics();
+    int line_height = fm.height();
+    int width = 0;
+
+    foreach (const QString& line, text) {
+      width = qMax(width, fm.width(line));
+    }
+
+    QRect box(0, 0, width + line_height, line_height * (text.size() + 1));
+
+    p.fillRect(box, QColor(0, 0, 0, 160));
+    p.setPen(Qt::white);
+
+    for (int i=0;i<text.size();i++) {
+      p.drawText(line_height / 2, line_height / 2 + fm.ascent() + line_height * i, text.at(i));
+    }
+  }
+}
+
+void ViewerGLWidget::resizeGL(int, int)
+{
+  // The fitted zoom depends on the widget's size
+  UpdateDivider();
+}
+
+void ViewerGLWidget::SetImageSize(int width, int height)
+{
+  image_width_ = width;
+  image_height_ = height;
+
+  UpdateDivider();
+
+  update();
+}
+
+void ViewerGLWidget::SetZoom(double zoom)
+{
+  if (zoom <= 0) {
+    ZoomToFit();
+    return;
+  }
+
+  zoom_ = clamp(zoom, kMinimumZoom, kMaximumZoom);
+
+  UpdateDivider();
+
+  update();
+}
+
+void ViewerGLWidget::ZoomToFit()
+{
+  zoom_ = 0;
+  pan_ = QPointF();
+
+  UpdateDivider();
+
+  update();
+}
+
+double ViewerGLWidget::zoom()
+{
+  if (zoom_ > 0) {
+    return zoom_;
+  }
+
+  if (image_width_ <= 0 || image_height_ <= 0) {
+    return 1.0;
+  }
+
+  qreal dpr = devicePixelRatioF();
+
+  return qMin(width() * dpr / image_width_, height() * dpr / image_height_);
+}
+
+int ViewerGLWidget::divider()
+{
+  return divider_;
+}
+
+void ViewerGLWidget::wheelEvent(QWheelEvent *event)
+{
+  if (image_width_ <= 0 || image_height_ <= 0) {
+    QOpenGLWidget::wheelEvent(event);
+    return;
+  }
+
+  double steps = event->angleDelta().y() / 120.0;
+
+  if (steps == 0.0) {
+    return;
+  }
+
+  double old_zoom = zoom();
+  double new_zoom = clamp(old_zoom * std::pow(kWheelZoomFactor, steps), kMinimumZoom, kMaximumZoom);
+
+  // Keep the image point under the cursor where it is
+  qreal dpr = devicePixelRatioF();
+  QPointF cursor = QPointF(event->pos()) * dpr - QPointF(width(), height()) * dpr / 2;
+  QPointF image_point = (cursor - pan_) / old_zoom;
+
+  pan_ = cursor - image_point * new_zoom;
+
+  SetZoom(new_zoom);
+}
+
+void ViewerGLWidget::mousePressEvent(QMouseEvent *event)
+{
+  if (event->button() == Qt::MiddleButton) {
+    panning_ = true;
+    pan_last_pos_ = event->pos();
+    return;
+  }
+
+  QOpenGLWidget::mousePressEvent(event);
+}
+
+void ViewerGLWidget::mouseMoveEvent(QMouseEvent *event)
+{
+  if (panning_) {
+    pan_ += QPointF(event->pos() - pan_last_pos_) * devicePixelRatioF();
+    pan_last_pos_ = event->pos();
+
+    // Only the presentation matrix changes, the frame doesn't need to be rendered again
+    update();
+    return;
+  }
+
+  QOpenGLWidget::mouseMoveEvent(event);
+}
+
+void ViewerGLWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+  if (panning_ && event->button() == Qt::MiddleButton) {
+    panning_ = false;
+    return;
+  }
+
+  QOpenGLWidget::mouseReleaseEvent(event);
+}
+
+QMatrix4x4 ViewerGLWidget::GetPresentationMatrix()
+{
+  QMatrix4x4 matrix;
+
+  // Without an image size, the texture covers the entire widget
+  if (image_width_ <= 0 || image_height_ <= 0 || width() <= 0 || height() <= 0) {
+    return matrix;
+  }
+
+  qreal dpr = devicePixelRatioF();
+  double widget_width = width() * dpr;
+  double widget_height = height() * dpr;
+  double z = zoom();
+
+  // The blit quad covers -1 to 1, scale it to the image's size on screen and offset it by the pan (Y points up)
+  matrix.translate(static_cast<float>(2.0 * pan_.x() / widget_width),
+                   static_cast<float>(-2.0 * pan_.y() / widget_height));
+  matrix.scale(static_cast<float>(image_width_ * z / widget_width),
+               static_cast<float>(image_height_ * z / widget_height));
+
+  return matrix;
+}
+
+void ViewerGLWidget::UpdateDivider()
+{
+  double z = zoom();
+
+  // Every halving of the resolution that still has at least one image pixel per screen pixel
+  int divider = 1;
+
+  while (divider < kMaxDivider && z * divider * 2 <= 1.0) {
+    divider *= 2;
+  }
+
+  if (divider != divider_) {
+    divider_ = divider;
+    emit DividerChanged(divider_);
+  }
+}
+
+void ViewerGLWidget::DeleteFence()
+{
+  context()->extraFunctions()->glDeleteSync(fence_);
+  fence_ = nullptr;
+}
+
+void ViewerGLWidget::TakeQueuedTexture()
+{
+  if (queue_.isEmpty()) {
+    return;
+  }
+
+  qint64 now = PlaybackEngine::PresentationTime();
+
+  // What's drawn now is shown on the next refresh, predict when that will be from the last swap
+  qint64 next_refresh = now;
+
+  if (last_swap_ >= 0 && now > last_swap_) {
+    double refreshes = std::ceil(static_cast<double>(now - last_swap_) / refresh_interval_);
+    next_refresh = last_swap_ + static_cast<qint64>(refreshes * refresh_interval_);
+  }
+
+  // Show the last texture whose closest refresh is this one (or has already passed)
+  qint64 deadline = next_refresh + static_cast<qint64>(refresh_interval_ / 2);
+
+  int index = -1;
+
+  for (int i=0;i<queue_.size();i++) {
+    if (queue_.at(i).due > deadline) {
+      break;
+    }
+
+    index = i;
+  }
+
+  if (index < 0) {
+    return;
+  }
+
+  // Textures before it were due too close together to each get a refresh of their own
+  for (int i=0;i<index;i++) {
+    if (queue_.at(i).fence != nullptr) {
+      context()->extraFunctions()->glDeleteSync(queue_.at(i).fence);
+    }
+  }
+
+  QueuedTexture taken = queue_.at(index);
+  queue_.erase(queue_.begin(), queue_.begin() + index + 1);
+
+  if (fence_ != nullptr) {
+    DeleteFence();
+  }
+
+  texture_ = taken.texture;
+  fence_ = taken.fence;
+  presenting_due_ = taken.due;
+  new_frame_ = true;
+}
+
+void ViewerGLWidget::ClearQueue()
+{
+  foreach (const QueuedTexture& queued, queue_) {
+    if (queued.fence != nullptr) {
+      context()->extraFunctions()->glDeleteSync(queued.fence);
+    }
+  }
+
+  queue_.clear();
+}
+
+void ViewerGLWidget::FrameSwapped()
+{
+  qint64 now = PlaybackEngine::PresentationTime();
+
+  // Refine the refresh interval from consecutive swaps, anything much longer means some refreshes weren't drawn
+  if (last_swap_ >= 0) {
+    double interval = static_cast<double>(now - last_swap_);
+
+    if (interval > refresh_interval_ * 0.5 && interval < refresh_interval_ * 1.5) {
+      refresh_interval_ = refresh_interval_ * 0.9 + interval * 0.1;
+    }
+  } else {
+    // Start from the screen's nominal refresh rate
+    QWindow* win = window()->windowHandle();
+
+    if (win != nullptr && win->screen() != nullptr && win->screen()->refreshRate() > 0) {
+      refresh_interval_ = 1000000000.0 / win->screen()->refreshRate();
+    }
+  }
+
+  last_swap_ = now;
+
+  if (new_frame_) {
+    displayed_frames_++;
+    new_frame_ = false;
+
+    emit TextureShown(texture_, shown_fence_);
+
+    if (shown_fence_ != nullptr) {
+      makeCurrent();
+      context()->extraFunctions()->glDeleteSync(shown_fence_);
+      shown_fence_ = nullptr;
+      doneCurrent();
+    }
+  }
+
+  if (presenting_due_ >= 0) {
+    emit FramePresented(presenting_due_, now);
+    presenting_due_ = -1;
+  }
+
+  // Keep painting every refresh while there are textures waiting
+  if (!queue_.isEmpty()) {
+    update();
+  }
+}
+
+void ViewerGLWidget::UpdateHud()
+{
+  HudSample sample;
+  sample.time = PlaybackEngine::PresentationTime();
+  sample.counters = PerformanceCounters::Take();
+  sample.displayed_frames = displayed_frames_;
+
+  hud_samples_.append(sample);
+
+  // Keep the newest sample that's at least a window old to compare against
+  while (hud_samples_.size() > 2 && hud_samples_.at(1).time <= sample.time - Q_INT64_C(1000000) * kHudWindow) {
+    hud_samples_.removeFirst();
+  }
+
+  const HudSample& oldest = hud_samples_.first();
+  const PerformanceCounters::Snapshot& now = sample.counters;
+  const PerformanceCounters::Snapshot& then = oldest.counters;
+
+  double seconds = static_cast<double>(sample.time - oldest.time) / 1000000000.0;
+  double fps = 0;
+
+  if (seconds > 0) {
+    fps = static_cast<double>(sample.displayed_frames - oldest.displayed_frames) / seconds;
+  }
+
+  double decode_ms = now.AverageMs(PerformanceCounters::kDecode, then);
+  double render_ms = now.AverageMs(PerformanceCounters::kRender, then);
+  double upload_ms = now.AverageMs(PerformanceCounters::kUpload, then);
+
+  qint64 hits = now.Count(PerformanceCounters::kCacheHit, then);
+  qint64 lookups = hits + now.Count(PerformanceCounters::kCacheMiss, then);
+
+  hud_text_.clear();
+
+  if (target_frame_rate_ > 0) {
+    hud_text_.append(tr("FPS: %1 / %2").arg(QString::number(fps, 'f', 1),
+                                            QString::number(target_frame_rate_, 'f', 3)));
+  } else {
+    hud_text_.append(tr("FPS: %1").arg(QString::number(fps, 'f', 1)));
+  }
+
+  hud_text_.append(tr("Decode: %1 ms").arg(QString::number(decode_ms, 'f', 2)));
+  hud_text_.append(tr("Render: %1 ms").arg(QString::number(render_ms, 'f', 2)));
+  hud_text_.append(tr("Upload: %1 ms").arg(QString::number(upload_ms, 'f', 2)));
+
+  if (lookups > 0) {
+    hud_text_.append(tr("Cache hits: %1%").arg(QString::number(100.0 * static_cast<double>(hits)
+                                                               / static_cast<double>(lookups), 'f', 0)));
+  } else {
+    hud_text_.append(tr("Cache hits: -"));
+  }
+
+  hud_text_.append(tr("Dropped: %1").arg(now.Count(PerformanceCounters::kDroppedFrame, then)));
+
+  // Everything held in frames and buffers, see AllocationCounters::Dump() for the breakdown
+  double allocated_mib = static_cast<double>(AllocationCounters::Total().live_bytes) / 1048576.0;
+  hud_text_.append(tr("Memory: %1 MiB").arg(QString::number(allocated_mib, 'f', 0)));
+
+  // When falling short of the target, name the stage that doesn't fit in a frame (or the display if they all do)
+  if (target_frame_rate_ > 0 && fps > 0 && fps < target_frame_rate_ * 0.95) {
+    double budget_ms = 1000.0 / target_frame_rate_;
+    double slowest_ms = qMax(decode_ms, qMax(render_ms, upload_ms));
+    QString stage;
+
+    if (slowest_ms <= budget_ms) {
+      stage = tr("display");
+    } else if (slowest_ms == decode_ms) {
+      stage = tr("decode");
+    } else if (slowest_ms == render_ms) {
+      stage = tr("render");
+    } else {
+      stage = tr("upload");
+    }
+
+    hud_text_.append(tr("Limited by: %1").arg(stage));
+  }
+
+  update();
 }
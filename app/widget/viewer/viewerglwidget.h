@@ -21,9 +21,18 @@
 #ifndef VIEWERGLWIDGET_H
 #define VIEWERGLWIDGET_H
 
+#include <QHash>
+#include <QList>
+#include <QMatrix4x4>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLWidget>
+#include <QPointer>
+#include <QStringList>
+#include <QTimer>
+#include <QWindow>
 
 #include "render/gl/shaderptr.h"
+#include "render/performancecounters.h"
 
 /**
  * @brief The inner display/rendering widget of a Viewer class.
@@ -39,9 +48,37 @@
  * to call update() directly to trigger a repaint, however this is not recommended. If you are not 100% sure it'll be
  * the same texture object, use SetTexture() since it will nearly always be faster to just set it than to check *and*
  * set it.
+ *
+ * Textures rendered in other contexts can be drawn directly since all contexts are in one share group (see
+ * Qt::AA_ShareOpenGLContexts in main()). Pass the fence the rendering context created after rendering to SetTexture()
+ * and the GPU will wait for rendering to finish before drawing, without blocking the main thread or copying the
+ * texture.
+ *
+ * During playback, frames should be queued with QueueTexture() instead, along with when they're due. Each is shown on
+ * the display refresh closest to its due time (e.g. 3:2 pulldown for 23.976 content on a 60Hz display), rather than
+ * whenever the event loop gets around to repainting. FramePresented() reports when each was actually shown so the
+ * sender can adjust its timing (see PlaybackEngine::ReportPresentation()).
+ *
+ * Zooming (mouse wheel, or SetZoom()) and panning (middle mouse button) only change the matrix the texture is drawn
+ * with, so neither needs the frame to be rendered again. When zoomed out far enough that the image has fewer screen
+ * pixels than image pixels, divider() suggests rendering at a lower resolution and DividerChanged() is emitted (see
+ * RendererProcessor::SetMinimumDivider()).
+ *
+ * The display transform is applied in paintGL() while drawing the texture, straight into the widget's framebuffer.
+ * When the application asks for a 10-bit window (see main()), that framebuffer is 10-bit too (Qt 5.10 and later),
+ * so frames reach the screen at 10 bits per channel without an 8-bit intermediate in between.
+ *
+ * The display and view come from the screen the widget is on (see olive::color::GetScreenDisplay()). The pipeline of
+ * each one used is kept, so moving the window to another screen just switches pipelines rather than generating a
+ * shader or baking a LUT again.
+ *
+ * SetPerformanceHudEnabled() shows the frame rate actually reaching the display along with the PerformanceCounters of
+ * every stage over the last couple of seconds, so it's easy to see whether playback is held back by decoding,
+ * rendering or the display itself.
  */
 class ViewerGLWidget : public QOpenGLWidget
 {
+  Q_OBJECT
 public:
   /**
    * @brief ViewerGLWidget Constructor
@@ -52,6 +89,8 @@ public:
    */
   ViewerGLWidget(QWidget* parent);
 
+  virtual ~ViewerGLWidget() override;
+
 public slots:
   /**
    * @brief Set the texture to draw and draw it
@@ -59,8 +98,88 @@ public slots:
    * Use this function to update the viewer.
    *
    * @param tex
+   *
+   * @param fence
+   *
+   * Optional fence to wait on before drawing the texture. The widget takes ownership of the fence and deletes it once
+   * it has been waited on (or replaced by another call to SetTexture()).
+   */
+  void SetTexture(GLuint tex, GLsync fence = nullptr);
+
+  /**
+   * @brief Queue a texture to be shown at a certain time
+   *
+   * Textures must be queued in the order they're due. If several are due by the same refresh, only the last one is
+   * shown. Calling SetTexture() clears the queue.
+   *
+   * @param present_time
+   *
+   * When to show the texture in PlaybackEngine::PresentationTime().
+   */
+  void QueueTexture(GLuint tex, GLsync fence, qint64 present_time);
+
+  /**
+   * @brief Set lines of text to draw over the image (e.g. render statistics), or an empty list for none
+   */
+  void SetOverlayText(const QStringList& lines);
+
+  /**
+   * @brief Show or hide the performance HUD (hidden by default)
+   */
+  void SetPerformanceHudEnabled(bool enabled);
+
+  /**
+   * @brief Set the frame rate playback should reach, shown in the performance HUD
+   */
+  void SetTargetFrameRate(double fps);
+
+  /**
+   * @brief Set the full resolution size of the images being shown (e.g. the sequence's)
+   *
+   * Needed for zooming, without it the texture is stretched over the whole widget.
+   */
+  void SetImageSize(int width, int height);
+
+  /**
+   * @brief Set the zoom level (1.0 shows one image pixel per screen pixel), or 0 to fit the image to the widget
+   */
+  void SetZoom(double zoom);
+
+  /**
+   * @brief Fit the image to the widget and center it
+   */
+  void ZoomToFit();
+
+  /**
+   * @brief Returns the zoom level in effect (the fitted zoom if fitting)
    */
-  void SetTexture(GLuint tex);
+  double zoom();
+
+  /**
+   * @brief Returns the resolution divider the current zoom level can be rendered at without visible loss
+   */
+  int divider();
+
+signals:
+  /**
+   * @brief Emitted once a texture from QueueTexture() has been shown
+   *
+   * Both times are in PlaybackEngine::PresentationTime().
+   */
+  void FramePresented(qint64 due, qint64 presented);
+
+  /**
+   * @brief Emitted when zooming changes divider()
+   */
+  void DividerChanged(int divider);
+
+  /**
+   * @brief Emitted once a new texture has reached the display, for anything that analyzes what's shown (e.g. scopes)
+   *
+   * Receivers that read the texture must make their own context current and wait on `fence` (if it isn't nullptr) with
+   * glWaitSync() before returning, as it's deleted straight afterwards.
+   */
+  void TextureShown(GLuint texture, GLsync fence);
 
 protected:
   /**
@@ -76,18 +195,204 @@ protected:
    * Simple OpenGL drawing function for painting the texture on screen. Standardized around OpenGL ES 3.2 Core.
    */
   virtual void paintGL() override;
+
+  virtual void resizeGL(int w, int h) override;
+
+  virtual void showEvent(QShowEvent* event) override;
+
+  virtual void wheelEvent(QWheelEvent* event) override;
+
+  virtual void mousePressEvent(QMouseEvent* event) override;
+  virtual void mouseMoveEvent(QMouseEvent* event) override;
+  virtual void mouseReleaseEvent(QMouseEvent* event) override;
+
 private:
+  /**
+   * @brief How often the performance HUD is updated (in milliseconds)
+   */
+  static const int kHudInterval = 250;
+
+  /**
+   * @brief How far back the performance HUD averages over (in milliseconds)
+   */
+  static const int kHudWindow = 2000;
+
+  /**
+   * @brief Largest divider() suggested however far out the view is zoomed
+   */
+  static const int kMaxDivider = 8;
+
+  /**
+   * @brief Returns the matrix to draw the texture with for the current zoom and pan
+   */
+  QMatrix4x4 GetPresentationMatrix();
+
+  /**
+   * @brief Recalculate divider() and emit DividerChanged() if it changed
+   */
+  void UpdateDivider();
+
+  /// Full resolution image size (0x0 if unknown)
+  int image_width_;
+  int image_height_;
+
+  /// Zoom set with SetZoom() (0 when fitting)
+  double zoom_;
+
+  /// Offset of the image's center from the widget's center in device pixels
+  QPointF pan_;
+
+  /// Whether the middle mouse button is dragging the image and where it last was
+  bool panning_;
+  QPoint pan_last_pos_;
+
+  /// Current divider()
+  int divider_;
+
+  struct QueuedTexture {
+    GLuint texture;
+    GLsync fence;
+    qint64 due;
+  };
+
+  /**
+   * @brief Take the texture to show on the next refresh from the queue (if one's due) and make it current
+   */
+  void TakeQueuedTexture();
+
+  /**
+   * @brief Delete the fences of every queued texture and empty the queue (the context must be current)
+   */
+  void ClearQueue();
+
+  /**
+   * @brief Textures waiting to be shown. Set in QueueTexture().
+   */
+  QList<QueuedTexture> queue_;
+
+  /**
+   * @brief Due time of the texture about to be swapped onto the display (-1 if none)
+   */
+  qint64 presenting_due_;
+
+  /**
+   * @brief When the last frame was swapped onto the display (-1 if never)
+   */
+  qint64 last_swap_;
+
+  /**
+   * @brief Estimated duration of one display refresh in nanoseconds
+   */
+  double refresh_interval_;
+
   /**
    * @brief Internal reference to the OpenGL texture to draw. Set in SetTexture() and used in paintGL().
    */
   GLuint texture_;
 
+  /**
+   * @brief Fence to wait on before drawing texture_ (or nullptr if it's ready). Set in SetTexture().
+   */
+  GLsync fence_;
+
+  /**
+   * @brief Delete fence_ (the context must be current)
+   */
+  void DeleteFence();
+
+  /**
+   * @brief Fence of the texture being swapped onto the display, kept for TextureShown() and deleted in FrameSwapped()
+   */
+  GLsync shown_fence_;
+
   /**
    * @brief Internal shader object to use as the pipeline shader
    *
-   * Retrieved every initializeGL() in order to stay up to date when new contexts are generated.
+   * Retrieved every initializeGL() in order to stay up to date when new contexts are generated, and whenever the
+   * widget moves to another screen.
    */
   ShaderPtr pipeline_;
+
+  /**
+   * @brief LUT texture of pipeline_ if it converts to the display (see olive::color::GetDisplayProcessor()), or 0
+   */
+  GLuint ocio_lut_;
+
+  struct DisplayPipeline {
+    ShaderPtr shader;
+    GLuint lut;
+  };
+
+  /**
+   * @brief Pipelines for each display and view this context has drawn with, so screens can be switched between freely
+   */
+  QHash<QString, DisplayPipeline> display_pipelines_;
+
+  /**
+   * @brief Display and view of pipeline_ (see UpdateDisplay())
+   */
+  QString display_key_;
+
+  /**
+   * @brief Window whose screenChanged() signal we're connected to
+   */
+  QPointer<QWindow> screen_window_;
+
+  /**
+   * @brief Make pipeline_ the one for the screen the widget is on (the context must be current)
+   */
+  void UpdateDisplay();
+
+  /**
+   * @brief Text drawn over the image. Set in SetOverlayText().
+   */
+  QStringList overlay_text_;
+
+  struct HudSample {
+    qint64 time;
+    PerformanceCounters::Snapshot counters;
+    qint64 displayed_frames;
+  };
+
+  /**
+   * @brief Samples covering the HUD's window, oldest first
+   */
+  QList<HudSample> hud_samples_;
+
+  /**
+   * @brief Performance HUD lines, drawn above overlay_text_. Set in UpdateHud().
+   */
+  QStringList hud_text_;
+
+  QTimer hud_timer_;
+
+  double target_frame_rate_;
+
+  /**
+   * @brief Number of new frames that have reached the display
+   */
+  qint64 displayed_frames_;
+
+  /**
+   * @brief Set when the next swap shows a different texture than the last one
+   */
+  bool new_frame_;
+
+private slots:
+  /**
+   * @brief Connected to QOpenGLWidget::frameSwapped() to time refreshes and report presented textures
+   */
+  void FrameSwapped();
+
+  /**
+   * @brief Switch to the pipeline of the display the window was moved to
+   */
+  void ScreenChanged();
+
+  /**
+   * @brief Take a new sample of the counters and regenerate the performance HUD
+   */
+  void UpdateHud();
 };
 
 #endif // VIEWERGLWIDGET_H
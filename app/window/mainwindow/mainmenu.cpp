@@ -20,9 +20,11 @@
 
 #include "mainmenu.h"
 
+#include <QDebug>
 #include <QEvent>
 
 #include "core.h"
+#include "render/allocationcounters.h"
 #include "tool/tool.h"
 #include "ui/style/style.h"
 #include "undo/undostack.h"
@@ -37,11 +39,11 @@ MainMenu::MainMenu(QWidget *parent) :
   file_menu_ = new Menu(this);
   file_new_menu_ = new Menu(file_menu_);
   olive::menu_shared.AddItemsForNewMenu(file_new_menu_);
-  file_open_item_ = file_menu_->AddItem("openproj", nullptr, nullptr, "Ctrl+O");
+  file_open_item_ = file_menu_->AddItem("openproj", &olive::core, SLOT(DialogOpenProject()), "Ctrl+O");
   file_open_recent_menu_ = new Menu(file_menu_);
   file_open_recent_clear_item_ = file_open_recent_menu_->AddItem("clearopenrecent", nullptr, nullptr);
-  file_save_item_ = file_menu_->AddItem("saveproj", nullptr, nullptr, "Ctrl+S");
-  file_save_as_item_ = file_menu_->AddItem("saveprojas", nullptr, nullptr, "Ctrl+Shift+S");
+  file_save_item_ = file_menu_->AddItem("saveproj", &olive::core, SLOT(SaveActiveProject()), "Ctrl+S");
+  file_save_as_item_ = file_menu_->AddItem("saveprojas", &olive::core, SLOT(SaveActiveProjectAs()), "Ctrl+Shift+S");
   file_menu_->addSeparator();
   file_import_item_ = file_menu_->AddItem("import", &olive::core, SLOT(DialogImportShow()), "Ctrl+I");
   file_menu_->addSeparator();
@@ -292,6 +294,7 @@ MainMenu::MainMenu(QWidget *parent) :
   help_action_search_item_ = help_menu_->AddItem("actionsearch", nullptr, nullptr, "/");
   help_menu_->addSeparator();
   help_debug_log_item_ = help_menu_->AddItem("debuglog", nullptr, nullptr);
+  help_memory_usage_item_ = help_menu_->AddItem("memoryusage", this, SLOT(DumpMemoryUsage()));
   help_menu_->addSeparator();
   help_about_item_ = help_menu_->AddItem("about", nullptr, nullptr);
 
@@ -333,6 +336,11 @@ void MainMenu::ToolsMenuAboutToShow()
   tools_snapping_item_->setChecked(olive::core.snapping());
 }
 
+void MainMenu::DumpMemoryUsage()
+{
+  qDebug().noquote() << AllocationCounters::Dump();
+}
+
 void MainMenu::Retranslate()
 { 
   // MenuShared is not a QWidget and therefore does not receive a LanguageEvent, we use MainMenu's to update it
@@ -434,5 +442,6 @@ void MainMenu::Retranslate()
   help_menu_->setTitle(tr("&Help"));
   help_action_search_item_->setText(tr("A&ction Search"));
   help_debug_log_item_->setText(tr("Debug Log"));
+  help_memory_usage_item_->setText(tr("Log Memory Usage"));
   help_about_item_->setText(tr("&About..."));
 }
@@ -60,6 +60,11 @@ private slots:
    */
   void ToolsMenuAboutToShow();
 
+  /**
+   * @brief Write AllocationCounters::Dump() to the debug log
+   */
+  void DumpMemoryUsage();
+
 private:
   /**
    * @brief Set strings based on the current application language.
@@ -152,6 +157,7 @@ private:
   Menu* help_menu_;
   QAction* help_action_search_item_;
   QAction* help_debug_log_item_;
+  QAction* help_memory_usage_item_;
   QAction* help_about_item_;
 };
 
@@ -23,7 +23,10 @@
 #include <QDebug>
 
 // Panel objects
+#include "panel/cacheinspector/cacheinspector.h"
 #include "panel/project/project.h"
+#include "panel/renderqueue/renderqueue.h"
+#include "panel/scope/scope.h"
 #include "panel/node/node.h"
 #include "panel/timeline/timeline.h"
 #include "panel/tool/tool.h"
@@ -71,6 +74,10 @@ void olive::MainWindow::ProjectOpen(Project* p)
   ViewerPanel* viewer_panel2 = new ViewerPanel(this);
   addDockWidget(Qt::TopDockWidgetArea, viewer_panel2);
 
+  ScopePanel* scope_panel = new ScopePanel(this);
+  addDockWidget(Qt::TopDockWidgetArea, scope_panel);
+  connect(viewer_panel2, SIGNAL(TextureShown(GLuint, GLsync)), scope_panel, SLOT(SetTexture(GLuint, GLsync)));
+
   ToolPanel* tool_panel = new ToolPanel(this);
   addDockWidget(Qt::BottomDockWidgetArea, tool_panel);
 
@@ -80,6 +87,12 @@ void olive::MainWindow::ProjectOpen(Project* p)
   TimelinePanel* timeline_panel = new TimelinePanel(this);
   addDockWidget(Qt::BottomDockWidgetArea, timeline_panel);
 
+  RenderQueuePanel* render_queue_panel = new RenderQueuePanel(this);
+  addDockWidget(Qt::BottomDockWidgetArea, render_queue_panel);
+
+  CacheInspectorPanel* cache_inspector_panel = new CacheInspectorPanel(this);
+  addDockWidget(Qt::BottomDockWidgetArea, cache_inspector_panel);
+
   // FIXME: Test code
   NodeGraph* graph = new NodeGraph();
   graph->setParent(this);
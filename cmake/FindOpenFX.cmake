@@ -0,0 +1,33 @@
+# - Find the OpenFX headers
+# OpenFX plugins are loaded at runtime, so only the API's headers are needed.
+# This module defines
+#  OPENFX_INCLUDE_DIRS, where to find ofxImageEffect.h, set when
+#                       OPENFX_INCLUDE_DIR is found.
+#  OPENFX_ROOT_DIR, The base directory to search for the headers.
+#                   This can also be an environment variable.
+#  OPENFX_FOUND, If false, do not try to use OpenFX.
+
+if(NOT OPENFX_ROOT_DIR AND NOT $ENV{OPENFX_ROOT_DIR} STREQUAL "")
+  set(OPENFX_ROOT_DIR $ENV{OPENFX_ROOT_DIR})
+endif()
+
+find_path(OPENFX_INCLUDE_DIR
+  NAMES
+    ofxImageEffect.h
+  HINTS
+    ${OPENFX_ROOT_DIR}
+    /usr/local
+  PATH_SUFFIXES
+    include
+    include/openfx
+    openfx/include
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(OpenFX DEFAULT_MSG OPENFX_INCLUDE_DIR)
+
+if(OPENFX_FOUND)
+  set(OPENFX_INCLUDE_DIRS ${OPENFX_INCLUDE_DIR})
+endif()
+
+mark_as_advanced(OPENFX_INCLUDE_DIR)